@@ -16,9 +16,13 @@
  *
  */
 
+#include <cstdlib>
+#include <utility>
+
 #include "asylo/bazel/application_wrapper/application_wrapper_driver_main.h"
 #include "asylo/client.h"
 #include "asylo/enclave_manager.h"
+#include "asylo/platform/primitives/sgx/loader.pb.h"
 #include "asylo/util/logging.h"
 #include "asylo/util/statusor.h"
 
@@ -31,6 +35,11 @@ constexpr char kSectionName[] = "enclave";
 // The name to use for the whole-application wrapper enclave.
 constexpr char kEnclaveName[] = "application_enclave";
 
+// The environment variable naming the file to write the exit profile of the
+// application enclave to. The command-line arguments all belong to the
+// application, so the driver takes its own options from the environment.
+constexpr char kExitProfilePathVariable[] = "ASYLO_EXIT_PROFILE_PATH";
+
 }  // namespace
 }  // namespace asylo
 
@@ -41,12 +50,22 @@ int main(int argc, char *argv[]) {
   LOG_IF(FATAL, !status.ok())
       << "Failed to configure EnclaveManager: " << status;
 
-  // Create a loader for the application enclave.
-  asylo::SgxEmbeddedLoader loader(asylo::kSectionName, /*debug=*/true);
+  // Configure loading the application enclave.
+  asylo::EnclaveLoadConfig load_config;
+  load_config.set_name(asylo::kEnclaveName);
+  asylo::SgxLoadConfig *sgx_config =
+      load_config.MutableExtension(asylo::sgx_load_config);
+  sgx_config->mutable_embedded_enclave_config()->set_section_name(
+      asylo::kSectionName);
+  sgx_config->set_debug(true);
+  const char *exit_profile_path = getenv(asylo::kExitProfilePathVariable);
+  if (exit_profile_path) {
+    load_config.set_exit_profile_path(exit_profile_path);
+  }
 
   // Run the application driver workflow.
-  auto main_return = asylo::ApplicationWrapperDriverMain(
-      loader, asylo::kEnclaveName, argc, argv);
+  auto main_return =
+      asylo::ApplicationWrapperDriverMain(std::move(load_config), argc, argv);
   LOG_IF(FATAL, !main_return.ok())
       << "Failed to run the whole-application wrapper: "
       << main_return.status();
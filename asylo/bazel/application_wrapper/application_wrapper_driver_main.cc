@@ -27,23 +27,23 @@
 #include "asylo/util/status_macros.h"
 
 namespace asylo {
+namespace {
 
-StatusOr<int> ApplicationWrapperDriverMain(const EnclaveLoader &loader,
-                                           const std::string &enclave_name,
-                                           int argc, char *argv[]) {
-  // Retrieve the EnclaveManager instance.
-  EnclaveManager *manager;
-  ASYLO_ASSIGN_OR_RETURN(manager, EnclaveManager::Instance());
-
-  // Marshal the command-line arguments into the EnclaveConfig.
+// Returns the EnclaveConfig of the application enclave, holding the
+// command-line arguments |argc| and |argv|.
+EnclaveConfig GetApplicationConfigWithArgv(int argc, char *argv[]) {
   EnclaveConfig config = GetApplicationConfig();
   Argv::WriteArgvToRepeatedStringField(
       argc, argv,
       config.MutableExtension(command_line_args)->mutable_arguments());
   config.set_enable_fork(true);
+  return config;
+}
 
-  // Load the enclave.
-  ASYLO_RETURN_IF_ERROR(manager->LoadEnclave(enclave_name, loader, config));
+// Runs the application in the loaded enclave |enclave_name|, then destroys the
+// enclave. Returns the main_return_value from the enclave's output.
+StatusOr<int> RunApplicationEnclave(EnclaveManager *manager,
+                                    const std::string &enclave_name) {
   EnclaveClient *client = manager->GetClient(enclave_name);
 
   // Ensure that the enclave is properly destroyed in the event of an early
@@ -72,4 +72,31 @@ StatusOr<int> ApplicationWrapperDriverMain(const EnclaveLoader &loader,
   return main_return;
 }
 
+}  // namespace
+
+StatusOr<int> ApplicationWrapperDriverMain(const EnclaveLoader &loader,
+                                           const std::string &enclave_name,
+                                           int argc, char *argv[]) {
+  // Retrieve the EnclaveManager instance.
+  EnclaveManager *manager;
+  ASYLO_ASSIGN_OR_RETURN(manager, EnclaveManager::Instance());
+
+  // Load the enclave.
+  ASYLO_RETURN_IF_ERROR(manager->LoadEnclave(
+      enclave_name, loader, GetApplicationConfigWithArgv(argc, argv)));
+  return RunApplicationEnclave(manager, enclave_name);
+}
+
+StatusOr<int> ApplicationWrapperDriverMain(EnclaveLoadConfig load_config,
+                                           int argc, char *argv[]) {
+  // Retrieve the EnclaveManager instance.
+  EnclaveManager *manager;
+  ASYLO_ASSIGN_OR_RETURN(manager, EnclaveManager::Instance());
+
+  // Load the enclave.
+  *load_config.mutable_config() = GetApplicationConfigWithArgv(argc, argv);
+  ASYLO_RETURN_IF_ERROR(manager->LoadEnclave(load_config));
+  return RunApplicationEnclave(manager, load_config.name());
+}
+
 }  // namespace asylo
@@ -41,6 +41,11 @@ StatusOr<int> ApplicationWrapperDriverMain(const EnclaveLoader &loader,
                                            const std::string &enclave_name,
                                            int argc, char *argv[]);
 
+// Behaves as above, but loads the application enclave from |load_config|, whose
+// config is replaced by that of the application.
+StatusOr<int> ApplicationWrapperDriverMain(EnclaveLoadConfig load_config,
+                                           int argc, char *argv[]);
+
 }  // namespace asylo
 
 #endif  // ASYLO_BAZEL_APPLICATION_WRAPPER_APPLICATION_WRAPPER_DRIVER_MAIN_H_
@@ -135,6 +135,17 @@ def asylo_testonly_deps():
             strip_prefix = "redis-5.0.7",
         )
 
+    # SQLite example dependency, only needed if running SQLite tests or
+    # benchmarks with Asylo.
+    if not native.existing_rule("org_sqlite"):
+        http_archive(
+            name = "org_sqlite",
+            build_file = "@com_google_asylo//asylo/distrib:sqlite.BUILD",
+            urls = ["https://www.sqlite.org/2019/sqlite-autoconf-3300100.tar.gz"],
+            sha256 = "8c5a50db089bd2a1b08dbc5b00d2027602ca7ff238ba7658fabca454d4298e60",
+            strip_prefix = "sqlite-autoconf-3300100",
+        )
+
 def _instantiate_crosstool_impl(repository_ctx):
     """Instantiates the Asylo crosstool template with the installation path.
 
@@ -0,0 +1,68 @@
+#
+# Copyright 2020 Asylo authors
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+"""Rule definitions for profile-guided optimization of Asylo enclaves.
+
+Profile-guided optimization (PGO) of an enclave takes three steps:
+
+1.  Build a workload that loads the enclave with
+    `--config=asylo-pgo-instrument`, which instruments the enclave and its host
+    with profile counters. The enclave runtime flushes the counters of the
+    enclave when it is finalized.
+2.  Run an `enclave_pgo_profile` target of the workload with the same config,
+    which collects the profile into a single file:
+
+        bazel run --config=asylo-pgo-instrument --config=sgx-sim \
+            //pkg:workload_profile -- workload.zip
+
+3.  Rebuild the enclave with
+    `--config=asylo-pgo-optimize --fdo_optimize=$PWD/workload.zip`.
+
+The profile is a zip archive of the .gcda files of the GCC toolchain, or an
+indexed .profdata file if the enclave was built with LLVM. It can be checked
+into the source tree so that release builds are optimized with it.
+"""
+
+# The directory into which instrumented code writes its profile counters. Must
+# match --fdo_instrument in the asylo-pgo-instrument config.
+PGO_PROFILE_DIRECTORY = "/tmp/asylo-pgo"
+
+def enclave_pgo_profile(name, workload, workload_args = [], **kwargs):
+    """Defines a target that runs a workload to collect the profile of enclaves.
+
+    The target takes the path of the profile to write, relative to the
+    directory of `bazel run`, followed by additional arguments to the
+    workload. The workload, typically a test or a benchmark
+    loading the enclaves to optimize, must be built with
+    --config=asylo-pgo-instrument.
+
+    Args:
+      name: The rule name.
+      workload: The label of the executable that runs the enclaves.
+      workload_args: Arguments to the workload, before those of the command
+        line.
+      **kwargs: Generic rule arguments like tags and visibility.
+    """
+    native.sh_binary(
+        name = name,
+        srcs = ["//asylo/bazel:pgo_collect.sh"],
+        args = [
+            "$(rootpath %s)" % workload,
+            PGO_PROFILE_DIRECTORY,
+        ] + workload_args + ["--"],
+        data = [workload],
+        **kwargs
+    )
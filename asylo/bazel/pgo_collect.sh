@@ -0,0 +1,71 @@
+#!/bin/bash
+#
+# Copyright 2020 Asylo authors
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+# Runs an instrumented workload and collects the profile counters it writes
+# into a single profile for --fdo_optimize. See pgo.bzl.
+#
+# Usage: pgo_collect.sh <workload> <profile directory> [target arguments...] --
+#            <output profile> [command line arguments...]
+
+set -eu
+
+if [[ $# -lt 4 ]]; then
+  echo "Usage: $0 <workload> <profile directory> [args...] --" \
+       "<output profile> [args...]" >&2
+  exit 1
+fi
+
+WORKLOAD=$(realpath "$1")
+PROFILE_DIR=$2
+shift 2
+
+WORKLOAD_ARGS=()
+while [[ "$1" != "--" ]]; do
+  WORKLOAD_ARGS+=("$1")
+  shift
+done
+shift
+
+# Relative output paths are resolved against the directory of `bazel run`.
+OUTPUT=$1
+shift
+if [[ "${OUTPUT}" != /* ]]; then
+  OUTPUT="${BUILD_WORKING_DIRECTORY:-$PWD}/${OUTPUT}"
+fi
+
+rm -rf "${PROFILE_DIR}"
+mkdir -p "${PROFILE_DIR}"
+
+# Host binaries and enclaves built with LLVM write .profraw files named after
+# LLVM_PROFILE_FILE, while GCC writes .gcda files under PROFILE_DIR.
+LLVM_PROFILE_FILE="${PROFILE_DIR}/asylo-%p.profraw" \
+  "${WORKLOAD}" "${WORKLOAD_ARGS[@]+"${WORKLOAD_ARGS[@]}"}" "$@"
+
+cd "${PROFILE_DIR}"
+shopt -s nullglob
+RAW_PROFILES=(*.profraw)
+if [[ ${#RAW_PROFILES[@]} -gt 0 ]]; then
+  llvm-profdata merge -output="${OUTPUT}" "${RAW_PROFILES[@]}"
+elif [[ -n "$(find . -name '*.gcda' -print -quit)" ]]; then
+  rm -f "${OUTPUT}"
+  find . -name '*.gcda' | zip -q "${OUTPUT}" -@
+else
+  echo "No profile counters were written to ${PROFILE_DIR}; was the workload" \
+       "built with --config=asylo-pgo-instrument?" >&2
+  exit 1
+fi
+echo "Wrote profile ${OUTPUT}"
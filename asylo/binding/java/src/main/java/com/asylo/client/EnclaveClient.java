@@ -21,7 +21,9 @@ package com.asylo.client;
 import com.asylo.EnclaveInput;
 import com.asylo.EnclaveOutput;
 import com.google.protobuf.ExtensionRegistry;
+import java.nio.ByteBuffer;
 import java.util.Objects;
+import java.util.concurrent.CompletableFuture;
 
 /** EnclaveClient class which provides methods for invoking enclave's entry points. */
 public class EnclaveClient extends AutoCloseablePointer {
@@ -70,6 +72,100 @@ public class EnclaveClient extends AutoCloseablePointer {
     return enterAndRun(getPointer(), enclaveInput, registry);
   }
 
+  /**
+   * Asynchronously enters the enclave and invokes its execution entry point, using a default
+   * protobuf {@link ExtensionRegistry}.
+   *
+   * @param enclaveInput Input to the enclave which will be used in invoking entry point method.
+   * @return A future completed with the output from the enclave.
+   * @see #enterAndRunAsync(EnclaveInput, ExtensionRegistry)
+   */
+  public CompletableFuture<EnclaveOutput> enterAndRunAsync(EnclaveInput enclaveInput) {
+    Objects.requireNonNull(enclaveInput);
+    return enterAndRunAsync(enclaveInput, ExtensionRegistry.getEmptyRegistry());
+  }
+
+  /**
+   * Asynchronously enters the enclave and invokes its execution entry point. The call runs on a
+   * fixed pool of native threads shared by all enclaves, so the calling thread is not blocked for
+   * the duration of the call, and many calls can be in flight without dedicating a JVM thread to
+   * each of them. Calls beyond the size of the pool wait for a free thread. Futures are completed
+   * on the native threads, so dependent stages that block should be run on another executor.
+   *
+   * <p>Every returned future must be completed before the enclave is destroyed.
+   *
+   * @param enclaveInput Input to the enclave which will be used in invoking entry point method.
+   * @param registry A user protobuf registry which will be used generate EnclaveOutput.
+   * @return A future completed with the output from the enclave, or exceptionally with an {@link
+   *     EnclaveException} if any exception occurs in native execution.
+   */
+  public CompletableFuture<EnclaveOutput> enterAndRunAsync(
+      EnclaveInput enclaveInput, ExtensionRegistry registry) {
+    Objects.requireNonNull(enclaveInput);
+    Objects.requireNonNull(registry);
+
+    CompletableFuture<EnclaveOutput> future = new CompletableFuture<>();
+    enterAndRunAsync(getPointer(), enclaveInput.toByteArray(), registry, future);
+    return future;
+  }
+
+  /**
+   * Enters the enclave and invokes its execution entry point, exchanging serialized protobufs
+   * through direct buffers. Unlike the other overloads, this method makes no copy of the input or
+   * output in the Java heap and no protobuf conversion in Java, which makes it the cheapest way to
+   * call an enclave at high rates.
+   *
+   * <p>The bytes between the position and the limit of {@code input} must hold a serialized {@link
+   * EnclaveInput}. On return, the position of {@code input} is its limit, and the serialized {@link
+   * EnclaveOutput} is stored in {@code output} starting at its position, which is advanced past
+   * it.
+   *
+   * @param input Direct buffer holding the serialized input to the enclave.
+   * @param output Direct buffer receiving the serialized output from the enclave.
+   * @return Size of the serialized output, in bytes.
+   * @throws IllegalArgumentException if either buffer is not direct, or {@code output} is read-only.
+   * @throws EnclaveException if any exception occurs in native execution, including when the
+   *     output does not fit in the remaining bytes of {@code output}.
+   */
+  public int enterAndRun(ByteBuffer input, ByteBuffer output) {
+    Objects.requireNonNull(input);
+    Objects.requireNonNull(output);
+    if (!input.isDirect() || !output.isDirect()) {
+      throw new IllegalArgumentException("Enclave buffers must be direct");
+    }
+    if (output.isReadOnly()) {
+      throw new IllegalArgumentException("Enclave output buffer must be writable");
+    }
+
+    int outputSize =
+        enterAndRunDirect(
+            getPointer(),
+            input,
+            input.position(),
+            input.remaining(),
+            output,
+            output.position(),
+            output.remaining());
+    input.position(input.limit());
+    output.position(output.position() + outputSize);
+    return outputSize;
+  }
+
   private native EnclaveOutput enterAndRun(
       long pointer, EnclaveInput enclaveInput, ExtensionRegistry registry);
+
+  private native void enterAndRunAsync(
+      long pointer,
+      byte[] enclaveInput,
+      ExtensionRegistry registry,
+      CompletableFuture<EnclaveOutput> future);
+
+  private native int enterAndRunDirect(
+      long pointer,
+      ByteBuffer input,
+      int inputPosition,
+      int inputLength,
+      ByteBuffer output,
+      int outputPosition,
+      int outputLength);
 }
@@ -18,8 +18,89 @@
 
 #include "asylo/binding/java/src/main/native/enclave_client.h"
 
+#include <cstdint>
+#include <string>
+#include <utility>
+
 #include "asylo/binding/java/src/main/native/jni_utils.h"
 #include "asylo/client.h"
+#include "asylo/platform/core/generic_enclave_client.h"
+#include "asylo/platform/primitives/util/entry_thread_pool.h"
+#include "asylo/util/logging.h"
+
+namespace {
+
+// Number of threads running asynchronous enclave calls, which bounds the
+// number of such calls running in enclaves at once.
+constexpr size_t kAsyncThreads = 8;
+
+// Returns the pool of threads running asynchronous enclave calls, created on
+// first use. The threads are attached to the JVM as daemon threads and live
+// until the process exits.
+asylo::primitives::EntryThreadPool *AsyncThreads() {
+  static auto *const pool =
+      new asylo::primitives::EntryThreadPool(kAsyncThreads);
+  return pool;
+}
+
+// Returns the JNI environment of the calling pool thread, attaching it to |vm|
+// on first use, or nullptr if it cannot be attached.
+JNIEnv *AttachAsyncThread(JavaVM *vm) {
+  thread_local JNIEnv *env = nullptr;
+  if (!env) {
+    void *attached_env = nullptr;
+    if (vm->AttachCurrentThreadAsDaemon(&attached_env, nullptr) != JNI_OK) {
+      return nullptr;
+    }
+    env = static_cast<JNIEnv *>(attached_env);
+  }
+  return env;
+}
+
+// Runs |client| on the EnclaveInput serialized in the |size| bytes at |input|.
+// The bytes are passed to the enclave as they are when the client supports
+// it, and parsed first otherwise.
+asylo::Status EnterAndRunSerialized(asylo::EnclaveClient *client,
+                                    const void *input, size_t size,
+                                    asylo::EnclaveOutput *output) {
+  auto *generic_client = dynamic_cast<asylo::GenericEnclaveClient *>(client);
+  if (generic_client) {
+    return generic_client->EnterAndRunSerialized(
+        asylo::primitives::Extent{const_cast<void *>(input), size}, output);
+  }
+  asylo::EnclaveInput parsed_input;
+  if (!parsed_input.ParseFromArray(input, size)) {
+    return asylo::Status(asylo::error::GoogleError::INVALID_ARGUMENT,
+                         "Not able to parse buffer to create native protobuf "
+                         "object.");
+  }
+  return client->EnterAndRun(parsed_input, output);
+}
+
+// Completes the Java |future| with the result of an asynchronous call, given
+// its |status| and |output|. Runs on a pool thread.
+void CompleteAsyncCall(JNIEnv *env, const asylo::Status &status,
+                       asylo::EnclaveOutput *output, jobject registry,
+                       jobject future) {
+  jthrowable failure = nullptr;
+  if (status.ok()) {
+    jobject java_output =
+        asylo::jni::ConvertNativeToJavaProto(env, output, registry);
+    if (java_output) {
+      asylo::jni::CompleteFuture(env, future, java_output);
+      return;
+    }
+  } else {
+    failure = asylo::jni::NewEnclaveException(env, status.ToString());
+  }
+  if (!failure) {
+    failure = env->ExceptionOccurred();
+    env->ExceptionClear();
+  }
+  asylo::jni::CompleteFutureExceptionally(env, future, failure);
+}
+
+}  // namespace
 
 // Executes the enclave with given input and return the result.
 JNIEXPORT jobject JNICALL Java_com_asylo_client_EnclaveClient_enterAndRun(
@@ -44,3 +125,98 @@ JNIEXPORT jobject JNICALL Java_com_asylo_client_EnclaveClient_enterAndRun(
 
   return asylo::jni::ConvertNativeToJavaProto(env, &output, registry);
 }
+
+// Executes the enclave with the serialized input in a direct buffer and
+// serializes the result into another, returning the size of the result.
+JNIEXPORT jint JNICALL Java_com_asylo_client_EnclaveClient_enterAndRunDirect(
+    JNIEnv *env, jobject this_object, jlong client_pointer, jobject input,
+    jint input_position, jint input_length, jobject output,
+    jint output_position, jint output_length) {
+  asylo::EnclaveClient *client =
+      reinterpret_cast<asylo::EnclaveClient *>(client_pointer);
+
+  const uint8_t *input_bytes = asylo::jni::GetDirectBufferRegion(
+      env, input, input_position, input_length);
+  if (!input_bytes) {
+    return 0;
+  }
+  uint8_t *output_bytes = asylo::jni::GetDirectBufferRegion(
+      env, output, output_position, output_length);
+  if (!output_bytes) {
+    return 0;
+  }
+
+  asylo::EnclaveOutput enclave_native_output;
+  asylo::Status status = EnterAndRunSerialized(
+      client, input_bytes, input_length, &enclave_native_output);
+  if (!status.ok()) {
+    asylo::jni::ThrowEnclaveException(env, status);
+    return 0;
+  }
+
+  size_t output_size = enclave_native_output.ByteSizeLong();
+  if (output_size > static_cast<size_t>(output_length)) {
+    asylo::jni::ThrowEnclaveException(
+        env, "Enclave output of " + std::to_string(output_size) +
+                 " bytes does not fit in the output buffer.");
+    return 0;
+  }
+  enclave_native_output.SerializeWithCachedSizesToArray(output_bytes);
+  return static_cast<jint>(output_size);
+}
+
+// Schedules the enclave to run with the given serialized input on a native
+// thread, which completes |future| with the result.
+JNIEXPORT void JNICALL Java_com_asylo_client_EnclaveClient_enterAndRunAsync(
+    JNIEnv *env, jobject this_object, jlong client_pointer,
+    jbyteArray enclave_input, jobject registry, jobject future) {
+  asylo::EnclaveClient *client =
+      reinterpret_cast<asylo::EnclaveClient *>(client_pointer);
+
+  // Pool threads are not called from Java, so they cannot look up the Java
+  // classes themselves.
+  if (!asylo::jni::LoadJavaIds(env)) {
+    return;
+  }
+  JavaVM *vm = nullptr;
+  if (env->GetJavaVM(&vm) != JNI_OK) {
+    asylo::jni::ThrowEnclaveException(env, "Not able to get the Java VM.");
+    return;
+  }
+
+  std::string serialized_input(env->GetArrayLength(enclave_input), '\0');
+  env->GetByteArrayRegion(enclave_input, 0, serialized_input.size(),
+                          reinterpret_cast<jbyte *>(&serialized_input[0]));
+  if (asylo::jni::CheckForPendingException(env)) {
+    return;
+  }
+
+  jobject global_registry = env->NewGlobalRef(registry);
+  jobject global_future = env->NewGlobalRef(future);
+  AsyncThreads()->Schedule([vm, client,
+                            serialized_input = std::move(serialized_input),
+                            global_registry, global_future] {
+    JNIEnv *pool_env = AttachAsyncThread(vm);
+    if (!pool_env) {
+      LOG(ERROR) << "Not able to attach an enclave call thread to the Java VM";
+      return;
+    }
+    // Local references are only released on return to Java, which never
+    // happens on pool threads.
+    if (pool_env->PushLocalFrame(/*capacity=*/16) == JNI_OK) {
+      asylo::EnclaveOutput output;
+      asylo::Status status =
+          EnterAndRunSerialized(client, serialized_input.data(),
+                                serialized_input.size(), &output);
+      CompleteAsyncCall(pool_env, status, &output, global_registry,
+                        global_future);
+      pool_env->ExceptionClear();
+      pool_env->PopLocalFrame(nullptr);
+    } else {
+      pool_env->ExceptionClear();
+      LOG(ERROR) << "Not able to complete an asynchronous enclave call";
+    }
+    pool_env->DeleteGlobalRef(global_registry);
+    pool_env->DeleteGlobalRef(global_future);
+  });
+}
@@ -33,6 +33,12 @@ extern "C" {
 JNIEXPORT jobject JNICALL Java_com_asylo_client_EnclaveClient_enterAndRun(
     JNIEnv *, jobject, jlong, jobject, jobject);
 
+JNIEXPORT jint JNICALL Java_com_asylo_client_EnclaveClient_enterAndRunDirect(
+    JNIEnv *, jobject, jlong, jobject, jint, jint, jobject, jint, jint);
+
+JNIEXPORT void JNICALL Java_com_asylo_client_EnclaveClient_enterAndRunAsync(
+    JNIEnv *, jobject, jlong, jbyteArray, jobject, jobject);
+
 #ifdef __cplusplus
 }
 #endif  // __cplusplus
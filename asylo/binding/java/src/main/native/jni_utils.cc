@@ -18,10 +18,117 @@
 
 #include "asylo/binding/java/src/main/native/jni_utils.h"
 
+#include <atomic>
+
 #include "absl/memory/memory.h"
 
 namespace asylo {
 namespace jni {
+namespace {
+
+// Classes and methods used on every enclave call, looked up once and kept for
+// the lifetime of the JVM.
+struct JavaIds {
+  jclass enclave_exception_class;
+  jmethodID enclave_exception_init;
+  jclass enclave_output_class;
+  jmethodID enclave_output_parse_from;
+  jclass completable_future_class;
+  jmethodID completable_future_complete;
+  jmethodID completable_future_complete_exceptionally;
+};
+
+std::atomic<const JavaIds *> java_ids{nullptr};
+
+// Returns a global reference to the class named |name|, or nullptr with a
+// pending exception.
+jclass FindGlobalClass(JNIEnv *env, const char *name) {
+  jclass local_class = env->FindClass(name);
+  if (CheckForPendingException(env)) {
+    return nullptr;
+  }
+  jclass global_class = static_cast<jclass>(env->NewGlobalRef(local_class));
+  env->DeleteLocalRef(local_class);
+  return global_class;
+}
+
+// Deletes the global references held by |ids|.
+void DeleteJavaIds(JNIEnv *env, JavaIds *ids) {
+  for (jclass java_class :
+       {ids->enclave_exception_class, ids->enclave_output_class,
+        ids->completable_future_class}) {
+    if (java_class) {
+      env->DeleteGlobalRef(java_class);
+    }
+  }
+}
+
+// Looks up the classes and methods into |ids|. Returns false with a pending
+// exception on failure.
+bool LookUpJavaIds(JNIEnv *env, JavaIds *ids) {
+  ids->enclave_exception_class =
+      FindGlobalClass(env, "com/asylo/client/EnclaveException");
+  if (!ids->enclave_exception_class) {
+    return false;
+  }
+  ids->enclave_exception_init = env->GetMethodID(
+      ids->enclave_exception_class, "<init>", "(Ljava/lang/String;)V");
+  if (CheckForPendingException(env)) {
+    return false;
+  }
+  ids->enclave_output_class = FindGlobalClass(env, "com/asylo/EnclaveOutput");
+  if (!ids->enclave_output_class) {
+    return false;
+  }
+  ids->enclave_output_parse_from = env->GetStaticMethodID(
+      ids->enclave_output_class, "parseFrom",
+      "([BLcom/google/protobuf/ExtensionRegistryLite;)Lcom/asylo/"
+      "EnclaveOutput;");
+  if (CheckForPendingException(env)) {
+    return false;
+  }
+  ids->completable_future_class =
+      FindGlobalClass(env, "java/util/concurrent/CompletableFuture");
+  if (!ids->completable_future_class) {
+    return false;
+  }
+  ids->completable_future_complete = env->GetMethodID(
+      ids->completable_future_class, "complete", "(Ljava/lang/Object;)Z");
+  if (CheckForPendingException(env)) {
+    return false;
+  }
+  ids->completable_future_complete_exceptionally =
+      env->GetMethodID(ids->completable_future_class, "completeExceptionally",
+                       "(Ljava/lang/Throwable;)Z");
+  return !CheckForPendingException(env);
+}
+
+// Returns the cached classes and methods, looking them up on first use.
+// Returns nullptr with a pending exception if a lookup fails, in which case
+// the next call tries again.
+const JavaIds *GetJavaIds(JNIEnv *env) {
+  const JavaIds *ids = java_ids.load(std::memory_order_acquire);
+  if (ids) {
+    return ids;
+  }
+  auto new_ids = absl::make_unique<JavaIds>();
+  if (!LookUpJavaIds(env, new_ids.get())) {
+    DeleteJavaIds(env, new_ids.get());
+    return nullptr;
+  }
+  // Threads racing on the first call all look the ids up, and all but one
+  // drop theirs.
+  if (java_ids.compare_exchange_strong(ids, new_ids.get(),
+                                       std::memory_order_acq_rel)) {
+    return new_ids.release();
+  }
+  DeleteJavaIds(env, new_ids.get());
+  return ids;
+}
+
+}  // namespace
+
+bool LoadJavaIds(JNIEnv *env) { return GetJavaIds(env) != nullptr; }
 
 bool CheckForPendingException(JNIEnv *env) {
   return env->ExceptionCheck() == JNI_TRUE;
@@ -32,11 +139,11 @@ void ThrowEnclaveException(JNIEnv *env, const asylo::Status &status) {
 }
 
 void ThrowEnclaveException(JNIEnv *env, const std::string &message) {
-  jclass exception_class = env->FindClass("com/asylo/client/EnclaveException");
-  if (env->ExceptionCheck()) {
+  const JavaIds *ids = GetJavaIds(env);
+  if (!ids) {
     return;
   }
-  env->ThrowNew(exception_class, message.c_str());
+  env->ThrowNew(ids->enclave_exception_class, message.c_str());
 }
 
 bool ConvertJavaToNativeProto(JNIEnv *env, const jobject java_object,
@@ -76,16 +183,8 @@ bool ConvertJavaToNativeProto(JNIEnv *env, const jobject java_object,
 jobject ConvertNativeToJavaProto(JNIEnv *env,
                                  google::protobuf::MessageLite *native_object,
                                  const jobject &registry) {
-  jclass enclave_output_class = env->FindClass("com/asylo/EnclaveOutput");
-  if (CheckForPendingException(env)) {
-    return nullptr;
-  }
-
-  jmethodID parseMethodId = env->GetStaticMethodID(
-      enclave_output_class, "parseFrom",
-      "([BLcom/google/protobuf/ExtensionRegistryLite;)Lcom/asylo/"
-      "EnclaveOutput;");
-  if (CheckForPendingException(env)) {
+  const JavaIds *ids = GetJavaIds(env);
+  if (!ids) {
     return nullptr;
   }
   auto native_object_length = native_object->ByteSizeLong();
@@ -100,13 +199,62 @@ jobject ConvertNativeToJavaProto(JNIEnv *env,
     return nullptr;
   }
 
-  jobject output_java_obj = env->CallStaticObjectMethod(
-      enclave_output_class, parseMethodId, java_byte_array, registry);
+  jobject output_java_obj =
+      env->CallStaticObjectMethod(ids->enclave_output_class,
+                                  ids->enclave_output_parse_from,
+                                  java_byte_array, registry);
   if (CheckForPendingException(env)) {
     return nullptr;
   }
 
   return output_java_obj;
 }
+
+uint8_t *GetDirectBufferRegion(JNIEnv *env, jobject buffer, jint position,
+                               jint length) {
+  auto address = static_cast<uint8_t *>(env->GetDirectBufferAddress(buffer));
+  jlong capacity = env->GetDirectBufferCapacity(buffer);
+  if (!address || capacity < 0) {
+    ThrowEnclaveException(env, "Enclave buffers must be direct buffers.");
+    return nullptr;
+  }
+  if (position < 0 || length < 0 ||
+      static_cast<jlong>(position) + length > capacity) {
+    ThrowEnclaveException(env, "Enclave buffer region is out of bounds.");
+    return nullptr;
+  }
+  return address + position;
+}
+
+jthrowable NewEnclaveException(JNIEnv *env, const std::string &message) {
+  const JavaIds *ids = GetJavaIds(env);
+  if (!ids) {
+    return nullptr;
+  }
+  jstring java_message = env->NewStringUTF(message.c_str());
+  if (!java_message) {
+    return nullptr;
+  }
+  return static_cast<jthrowable>(env->NewObject(
+      ids->enclave_exception_class, ids->enclave_exception_init, java_message));
+}
+
+void CompleteFuture(JNIEnv *env, jobject future, jobject value) {
+  const JavaIds *ids = GetJavaIds(env);
+  if (!ids) {
+    return;
+  }
+  env->CallBooleanMethod(future, ids->completable_future_complete, value);
+}
+
+void CompleteFutureExceptionally(JNIEnv *env, jobject future,
+                                 jthrowable throwable) {
+  const JavaIds *ids = GetJavaIds(env);
+  if (!ids) {
+    return;
+  }
+  env->CallBooleanMethod(future, ids->completable_future_complete_exceptionally,
+                         throwable);
+}
 }  // namespace jni
 }  // namespace asylo
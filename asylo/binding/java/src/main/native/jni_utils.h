@@ -21,6 +21,7 @@
 
 #include <jni.h>
 
+#include <cstdint>
 #include <string>
 
 #include <google/protobuf/message_lite.h>
@@ -29,6 +30,12 @@
 namespace asylo {
 namespace jni {
 
+// Looks up the Java classes and methods used by the functions below, which
+// must first happen on a thread called from Java since those classes may live
+// in an application class loader. Returns false with a pending exception on
+// failure.
+bool LoadJavaIds(JNIEnv *env);
+
 // Checks if there is a pending exception in JVM.
 bool CheckForPendingException(JNIEnv *env);
 
@@ -51,6 +58,24 @@ bool ConvertJavaToNativeProto(JNIEnv *env, const jobject java_object,
 jobject ConvertNativeToJavaProto(JNIEnv *env,
                                  google::protobuf::MessageLite *native_object,
                                  const jobject &registry);
+
+// Returns the address of the |length| bytes at |position| in the direct
+// buffer |buffer|, queuing a JVM exception and returning nullptr if |buffer|
+// is not a direct buffer or the range lies outside of it.
+uint8_t *GetDirectBufferRegion(JNIEnv *env, jobject buffer, jint position,
+                               jint length);
+
+// Returns a new EnclaveException with |message|, or nullptr with a pending
+// exception on failure.
+jthrowable NewEnclaveException(JNIEnv *env, const std::string &message);
+
+// Completes the java.util.concurrent.CompletableFuture |future| with |value|.
+void CompleteFuture(JNIEnv *env, jobject future, jobject value);
+
+// Completes the java.util.concurrent.CompletableFuture |future| exceptionally
+// with |throwable|.
+void CompleteFutureExceptionally(JNIEnv *env, jobject future,
+                                 jthrowable throwable);
 }  // namespace jni
 }  // namespace asylo
 
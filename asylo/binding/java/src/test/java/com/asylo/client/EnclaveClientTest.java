@@ -5,6 +5,7 @@ import static org.junit.Assert.assertThrows;
 import com.asylo.EnclaveInput;
 import java.lang.reflect.Constructor;
 import java.lang.reflect.InvocationTargetException;
+import java.nio.ByteBuffer;
 import org.junit.Before;
 import org.junit.Test;
 import org.junit.runner.RunWith;
@@ -36,4 +37,38 @@ public class EnclaveClientTest {
     EnclaveInput input = EnclaveInput.newBuilder().build();
     assertThrows(NullPointerException.class, () -> enclaveClient.enterAndRun(input, null));
   }
+
+  @Test
+  public void testEnterAndRunBufferNullCheck() {
+    ByteBuffer buffer = ByteBuffer.allocateDirect(16);
+    assertThrows(NullPointerException.class, () -> enclaveClient.enterAndRun(null, buffer));
+    assertThrows(NullPointerException.class, () -> enclaveClient.enterAndRun(buffer, null));
+  }
+
+  @Test
+  public void testEnterAndRunBufferDirectCheck() {
+    ByteBuffer direct = ByteBuffer.allocateDirect(16);
+    ByteBuffer heap = ByteBuffer.allocate(16);
+    assertThrows(IllegalArgumentException.class, () -> enclaveClient.enterAndRun(heap, direct));
+    assertThrows(IllegalArgumentException.class, () -> enclaveClient.enterAndRun(direct, heap));
+  }
+
+  @Test
+  public void testEnterAndRunOutputBufferWritableCheck() {
+    ByteBuffer direct = ByteBuffer.allocateDirect(16);
+    assertThrows(
+        IllegalArgumentException.class,
+        () -> enclaveClient.enterAndRun(direct, direct.asReadOnlyBuffer()));
+  }
+
+  @Test
+  public void testEnterAndRunAsyncEnclaveInputNullCheck() {
+    assertThrows(NullPointerException.class, () -> enclaveClient.enterAndRunAsync(null));
+  }
+
+  @Test
+  public void testEnterAndRunAsyncExtensionRegistryNullCheck() {
+    EnclaveInput input = EnclaveInput.newBuilder().build();
+    assertThrows(NullPointerException.class, () -> enclaveClient.enterAndRunAsync(input, null));
+  }
 }
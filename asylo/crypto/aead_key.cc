@@ -19,13 +19,14 @@
 #include "asylo/crypto/aead_key.h"
 
 #include <openssl/aead.h>
+#include <openssl/mem.h>
 #include <memory>
+#include <utility>
 
 #include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
 #include "asylo/crypto/algorithms.pb.h"
 #include "asylo/crypto/util/bssl_util.h"
-#include "asylo/util/cleanup.h"
 #include "asylo/util/status_macros.h"
 
 namespace asylo {
@@ -81,7 +82,7 @@ StatusOr<std::unique_ptr<AeadKey>> AeadKey::CreateAesGcmKey(
                   absl::StrCat("Invalid AES-GCM key length: ", key.size(),
                                " (must be 16 or 32 bytes)"));
   }
-  return absl::WrapUnique<AeadKey>(new AeadKey(scheme, key));
+  return Create(scheme, key);
 }
 
 StatusOr<std::unique_ptr<AeadKey>> AeadKey::CreateAesGcmSivKey(
@@ -92,7 +93,14 @@ StatusOr<std::unique_ptr<AeadKey>> AeadKey::CreateAesGcmSivKey(
                   absl::StrCat("Invalid AES-GCM-SIV key length: ", key.size(),
                                " (must be 16 or 32 bytes)"));
   }
-  return absl::WrapUnique<AeadKey>(new AeadKey(scheme, key));
+  return Create(scheme, key);
+}
+
+AeadKey::~AeadKey() {
+  EVP_AEAD_CTX_cleanup(&context_);
+  // The key schedule of some AEADs is held within the context itself, which
+  // EVP_AEAD_CTX_cleanup() does not clear.
+  OPENSSL_cleanse(&context_, sizeof(context_));
 }
 
 AeadScheme AeadKey::GetAeadScheme() const { return aead_scheme_; }
@@ -110,18 +118,7 @@ Status AeadKey::Seal(ByteContainerView plaintext,
                                " (must be ", nonce_size_, " bytes)"));
   }
 
-  EVP_AEAD_CTX context;
-  Cleanup cleanup_context([&context]() { EVP_AEAD_CTX_cleanup(&context); });
-
-  if (EVP_AEAD_CTX_init(&context, aead_, key_.data(), key_.size(),
-                        EVP_AEAD_max_tag_len(aead_),
-                        /*impl=*/nullptr) != 1) {
-    return Status(
-        error::GoogleError::INTERNAL,
-        absl::StrCat("EVP_AEAD_CTX_init failed: ", BsslLastErrorString()));
-  }
-
-  if (EVP_AEAD_CTX_seal(&context, ciphertext.data(), ciphertext_size,
+  if (EVP_AEAD_CTX_seal(&context_, ciphertext.data(), ciphertext_size,
                         ciphertext.size(), nonce.data(), nonce.size(),
                         plaintext.data(), plaintext.size(),
                         associated_data.data(), associated_data.size()) != 1) {
@@ -142,17 +139,7 @@ Status AeadKey::Open(ByteContainerView ciphertext,
                                " (must be ", nonce_size_, " bytes)"));
   }
 
-  EVP_AEAD_CTX context;
-  Cleanup cleanup_context([&context]() { EVP_AEAD_CTX_cleanup(&context); });
-  if (EVP_AEAD_CTX_init(&context, aead_, key_.data(), key_.size(),
-                        EVP_AEAD_max_tag_len(aead_),
-                        /*impl=*/nullptr) != 1) {
-    return Status(
-        error::GoogleError::INTERNAL,
-        absl::StrCat("EVP_AEAD_CTX_init failed: ", BsslLastErrorString()));
-  }
-
-  if (EVP_AEAD_CTX_open(&context, plaintext.data(), plaintext_size,
+  if (EVP_AEAD_CTX_open(&context_, plaintext.data(), plaintext_size,
                         plaintext.size(), nonce.data(), nonce.size(),
                         ciphertext.data(), ciphertext.size(),
                         associated_data.data(), associated_data.size()) != 1) {
@@ -164,11 +151,25 @@ Status AeadKey::Open(ByteContainerView ciphertext,
   return Status::OkStatus();
 }
 
-AeadKey::AeadKey(AeadScheme aead_scheme, ByteContainerView key)
+StatusOr<std::unique_ptr<AeadKey>> AeadKey::Create(AeadScheme scheme,
+                                                  ByteContainerView key) {
+  auto aead_key = absl::WrapUnique<AeadKey>(new AeadKey(scheme));
+  if (EVP_AEAD_CTX_init(&aead_key->context_, aead_key->aead_, key.data(),
+                        key.size(), EVP_AEAD_max_tag_len(aead_key->aead_),
+                        /*impl=*/nullptr) != 1) {
+    return Status(
+        error::GoogleError::INTERNAL,
+        absl::StrCat("EVP_AEAD_CTX_init failed: ", BsslLastErrorString()));
+  }
+  return std::move(aead_key);
+}
+
+AeadKey::AeadKey(AeadScheme aead_scheme)
     : aead_(GetEvpAead(aead_scheme)),
       aead_scheme_(aead_scheme),
-      key_(key.cbegin(), key.cend()),
       max_seal_overhead_(EVP_AEAD_max_overhead(aead_)),
-      nonce_size_(EVP_AEAD_nonce_length(aead_)) {}
+      nonce_size_(EVP_AEAD_nonce_length(aead_)) {
+  EVP_AEAD_CTX_zero(&context_);
+}
 
 }  // namespace asylo
@@ -26,13 +26,16 @@
 
 #include "asylo/crypto/algorithms.pb.h"
 #include "asylo/crypto/util/byte_container_view.h"
-#include "asylo/util/cleansing_types.h"
 #include "asylo/util/status.h"
 #include "asylo/util/statusor.h"
 
 namespace asylo {
 
 // Key used for AEAD (Authenticated Encryption with Associated Data) operations.
+//
+// The key schedule of the AEAD algorithm is set up once, when the AeadKey is
+// created, and cleansed when it is destroyed. Seal() and Open() may be called
+// concurrently from multiple threads.
 class AeadKey {
  public:
   // Creates an instance of AeadKey using |key| with AES-GCM. |key| must be
@@ -47,6 +50,11 @@ class AeadKey {
   static StatusOr<std::unique_ptr<AeadKey>> CreateAesGcmSivKey(
       ByteContainerView key);
 
+  AeadKey(const AeadKey &other) = delete;
+  AeadKey &operator=(const AeadKey &other) = delete;
+
+  ~AeadKey();
+
   // Gets the AEAD scheme used by this AeadKey.
   AeadScheme GetAeadScheme() const;
 
@@ -73,7 +81,11 @@ class AeadKey {
               size_t *plaintext_size);
 
  private:
-  AeadKey(AeadScheme scheme, ByteContainerView key);
+  explicit AeadKey(AeadScheme scheme);
+
+  // Creates an instance of AeadKey using |key| with |scheme|.
+  static StatusOr<std::unique_ptr<AeadKey>> Create(AeadScheme scheme,
+                                                   ByteContainerView key);
 
   // The object that encapsulates the AEAD algorithm.
   const EVP_AEAD *const aead_;
@@ -81,8 +93,9 @@ class AeadKey {
   // The Asylo enum representation of the AEAD algorithm used by this object.
   const AeadScheme aead_scheme_;
 
-  // The AEAD key.
-  const CleansingVector<uint8_t> key_;
+  // The AEAD context holding the expanded key. It is only read by Seal() and
+  // Open().
+  EVP_AEAD_CTX context_;
 
   // The max size of the spatial overhead for this object's Seal() operation.
   const size_t max_seal_overhead_;
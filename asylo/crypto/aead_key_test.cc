@@ -19,6 +19,7 @@
 #include "asylo/crypto/aead_key.h"
 
 #include <memory>
+#include <thread>
 #include <vector>
 
 #include <gmock/gmock.h>
@@ -154,6 +155,40 @@ TEST_P(AeadKeyTest, AeadKeyTestVector) {
             ByteContainerView(actual_plaintext));
 }
 
+// Verifies that the Seal and Open methods of a single key may be called
+// concurrently.
+TEST_P(AeadKeyTest, AeadKeyTestConcurrentSealAndOpen) {
+  constexpr int kNumThreads = 8;
+  constexpr int kNumIterations = 100;
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back([this] {
+      std::vector<uint8_t> ciphertext(test_vector_.plaintext.size() +
+                                      test_key_->MaxSealOverhead());
+      std::vector<uint8_t> plaintext(ciphertext.size());
+      for (int j = 0; j < kNumIterations; ++j) {
+        size_t ciphertext_size;
+        ASYLO_ASSERT_OK(test_key_->Seal(
+            test_vector_.plaintext, test_vector_.aad, test_vector_.nonce,
+            absl::MakeSpan(ciphertext), &ciphertext_size));
+        ASSERT_EQ(ByteContainerView(test_vector_.authenticated_ciphertext),
+                  ByteContainerView(ciphertext.data(), ciphertext_size));
+
+        size_t plaintext_size;
+        ASYLO_ASSERT_OK(test_key_->Open(
+            test_vector_.authenticated_ciphertext, test_vector_.aad,
+            test_vector_.nonce, absl::MakeSpan(plaintext), &plaintext_size));
+        ASSERT_EQ(ByteContainerView(test_vector_.plaintext),
+                  ByteContainerView(plaintext.data(), plaintext_size));
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+}
+
 // Verifies that Seal returns a non-OK Status with invalid inputs.
 TEST_P(AeadKeyTest, AeadKeyTestInvalidInputSeal) {
   std::vector<uint8_t> actual_ciphertext(test_vector_.plaintext.size() +
@@ -21,6 +21,7 @@
 #include <openssl/asn1.h>
 #include <openssl/base.h>
 #include <openssl/bn.h>
+#include <openssl/bytestring.h>
 #include <openssl/obj.h>
 
 #include <cstdint>
@@ -158,6 +159,18 @@ std::string OpensslTypeName(int openssl_type) {
   }
 }
 
+// Converts a CBS ASN.1 tag to an OpenSSL ASN.1 type code. Returns V_ASN1_UNDEF
+// for tags that do not correspond to a universal type supported by Asn1View.
+int OpensslTypeFromCbsTag(unsigned tag) {
+  if (tag == CBS_ASN1_SEQUENCE) {
+    return V_ASN1_SEQUENCE;
+  }
+  if ((tag & ~CBS_ASN1_TAG_NUMBER_MASK) != 0) {
+    return V_ASN1_UNDEF;
+  }
+  return static_cast<int>(tag);
+}
+
 // Returns a copy of |object|. This function uses CHECK()s instead of returning
 // a StatusOr<> because it is only used in the copy constructor and
 // copy-assignment operator of ObjectId, which cannot return Statuses. In
@@ -804,4 +817,116 @@ bool operator!=(const Asn1Value &lhs, const Asn1Value &rhs) {
   return !(lhs == rhs);
 }
 
+StatusOr<Asn1View> Asn1View::Create(ByteContainerView asn1_der) {
+  CBS input;
+  CBS_init(&input, asn1_der.data(), asn1_der.size());
+  CBS element;
+  unsigned tag;
+  size_t header_size;
+  if (!CBS_get_any_asn1_element(&input, &element, &tag, &header_size)) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Malformed DER-encoded ASN.1 value");
+  }
+  if (CBS_len(&input) != 0) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  absl::StrFormat("Found %d trailing bytes after ASN.1 value",
+                                  CBS_len(&input)));
+  }
+  return Asn1View(ByteContainerView(CBS_data(&element), CBS_len(&element)),
+                  ByteContainerView(CBS_data(&element) + header_size,
+                                    CBS_len(&element) - header_size),
+                  tag);
+}
+
+absl::optional<Asn1Type> Asn1View::Type() const {
+  return FromOpensslType(OpensslTypeFromCbsTag(tag_));
+}
+
+StatusOr<bool> Asn1View::GetBoolean() const {
+  ASYLO_RETURN_IF_ERROR(CheckIsType(Asn1Type::kBoolean));
+  if (contents_.size() != 1 || (contents_[0] != 0x00 && contents_[0] != 0xff)) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Malformed DER-encoded BOOLEAN");
+  }
+  return contents_[0] != 0x00;
+}
+
+StatusOr<ByteContainerView> Asn1View::GetOctetString() const {
+  ASYLO_RETURN_IF_ERROR(CheckIsType(Asn1Type::kOctetString));
+  return contents_;
+}
+
+StatusOr<ObjectId> Asn1View::GetObjectId() const {
+  ASYLO_RETURN_IF_ERROR(CheckIsType(Asn1Type::kObjectId));
+  const uint8_t *der_data = der_.data();
+  bssl::UniquePtr<ASN1_OBJECT> object(
+      d2i_ASN1_OBJECT(/*a=*/nullptr, &der_data, der_.size()));
+  if (object == nullptr) {
+    return Status(error::GoogleError::INVALID_ARGUMENT, BsslLastErrorString());
+  }
+  return ObjectId::CreateFromBsslObject(*object);
+}
+
+StatusOr<std::vector<Asn1View>> Asn1View::GetSequence() const {
+  ASYLO_RETURN_IF_ERROR(CheckIsType(Asn1Type::kSequence));
+  CBS contents;
+  CBS_init(&contents, contents_.data(), contents_.size());
+  std::vector<Asn1View> elements;
+  while (CBS_len(&contents) != 0) {
+    CBS element;
+    unsigned tag;
+    size_t header_size;
+    if (!CBS_get_any_asn1_element(&contents, &element, &tag, &header_size)) {
+      return Status(error::GoogleError::INVALID_ARGUMENT,
+                    "Malformed DER-encoded SEQUENCE element");
+    }
+    elements.push_back(
+        Asn1View(ByteContainerView(CBS_data(&element), CBS_len(&element)),
+                 ByteContainerView(CBS_data(&element) + header_size,
+                                   CBS_len(&element) - header_size),
+                 tag));
+  }
+  return elements;
+}
+
+bool Asn1View::IsObjectId(const ObjectId &oid) const {
+  if (!CheckIsType(Asn1Type::kObjectId).ok()) {
+    return false;
+  }
+  const ASN1_OBJECT &object = oid.GetBsslObject();
+  return contents_ ==
+         ByteContainerView(OBJ_get0_data(&object), OBJ_length(&object));
+}
+
+StatusOr<Asn1Value> Asn1View::ToAsn1Value() const {
+  return Asn1Value::CreateFromDer(der_);
+}
+
+Status Asn1View::CheckIsType(Asn1Type type) const {
+  int openssl_type = OpensslTypeFromCbsTag(tag_);
+  int expected_openssl_type = ToOpensslType(type);
+  if (openssl_type != expected_openssl_type) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  absl::StrFormat("Asn1View is a %s, not a %s",
+                                  OpensslTypeName(openssl_type),
+                                  OpensslTypeName(expected_openssl_type)));
+  }
+
+  return Status::OkStatus();
+}
+
+StatusOr<ByteContainerView> Asn1View::GetIntegerContents(Asn1Type type) const {
+  ASYLO_RETURN_IF_ERROR(CheckIsType(type));
+  // DER requires a non-empty, minimal two's complement encoding.
+  if (contents_.empty() ||
+      (contents_.size() > 1 &&
+       ((contents_[0] == 0x00 && (contents_[1] & 0x80) == 0) ||
+        (contents_[0] == 0xff && (contents_[1] & 0x80) != 0)))) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  absl::StrFormat("Malformed DER-encoded %s",
+                                  OpensslTypeName(ToOpensslType(type))));
+  }
+  return contents_;
+}
+
 }  // namespace asylo
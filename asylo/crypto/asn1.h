@@ -306,6 +306,113 @@ class Asn1Value {
 bool operator==(const Asn1Value &lhs, const Asn1Value &rhs);
 bool operator!=(const Asn1Value &lhs, const Asn1Value &rhs);
 
+// A read-only view of a single DER-encoded ASN.1 value. Unlike Asn1Value, an
+// Asn1View does not own or copy its data: it references the DER buffer it was
+// created from, and so do all the views and byte ranges obtained from it. The
+// buffer must outlive the Asn1View and everything derived from it.
+//
+// Asn1View is intended for parsing large structures, such as certificate
+// extensions, without building an owned tree of Asn1Values. Like Asn1Value, it
+// may represent a value of an unsupported type. In that case, Type() returns
+// absl::nullopt and every Get() method returns an error.
+class Asn1View {
+ public:
+  // No guarantees are made about the type and value of a default-constructed
+  // Asn1View.
+  Asn1View() : der_(nullptr, 0), contents_(nullptr, 0) {}
+
+  // Creates an Asn1View of the DER-encoded value in |asn1_der|. Fails if
+  // |asn1_der| is not exactly one DER-encoded value.
+  static StatusOr<Asn1View> Create(ByteContainerView asn1_der);
+
+  // Returns the type of this value, or absl::nullopt if the contained value has
+  // an unsupported type.
+  absl::optional<Asn1Type> Type() const;
+
+  // Returns the complete DER encoding of this value.
+  ByteContainerView der() const { return der_; }
+
+  // Each getter returns the contained value in the appropriate C++ type. Fails
+  // if the Asn1View does not have the appropriate type or is malformed.
+  //
+  // GetOctetString() and GetSequence() return views into the underlying DER
+  // buffer instead of copies.
+  StatusOr<bool> GetBoolean() const;
+  StatusOr<ByteContainerView> GetOctetString() const;
+  StatusOr<ObjectId> GetObjectId() const;
+  StatusOr<std::vector<Asn1View>> GetSequence() const;
+
+  // Returns true if this value is an OBJECT IDENTIFIER equal to |oid|. Unlike
+  // GetObjectId(), does not allocate.
+  bool IsObjectId(const ObjectId &oid) const;
+
+  // Getters that get an INTEGER or ENUMERATED value directly as an integral
+  // type. Fail if the value does not fit in an IntT.
+  template <typename IntT>
+  StatusOr<IntT> GetIntegerAsInt() const {
+    StatusOr<ByteContainerView> contents_result =
+        GetIntegerContents(Asn1Type::kInteger);
+    if (!contents_result.ok()) {
+      return contents_result.status();
+    }
+    return IntFromContents<IntT>(contents_result.ValueOrDie());
+  }
+  template <typename IntT>
+  StatusOr<IntT> GetEnumeratedAsInt() const {
+    StatusOr<ByteContainerView> contents_result =
+        GetIntegerContents(Asn1Type::kEnumerated);
+    if (!contents_result.ok()) {
+      return contents_result.status();
+    }
+    return IntFromContents<IntT>(contents_result.ValueOrDie());
+  }
+
+  // Returns an owned Asn1Value holding a copy of this value.
+  StatusOr<Asn1Value> ToAsn1Value() const;
+
+ private:
+  Asn1View(ByteContainerView der, ByteContainerView contents, unsigned tag)
+      : der_(der), contents_(contents), tag_(tag) {}
+
+  // Returns an OK status if this Asn1View's type is the same as |type|.
+  // Otherwise, returns an INVALID_ARGUMENT status describing the mismatch.
+  Status CheckIsType(Asn1Type type) const;
+
+  // Returns the minimally-encoded two's complement contents of an INTEGER or
+  // ENUMERATED value, depending on |type|.
+  StatusOr<ByteContainerView> GetIntegerContents(Asn1Type type) const;
+
+  // Decodes the two's complement big-endian |contents| as an IntT.
+  template <typename IntT>
+  static StatusOr<IntT> IntFromContents(ByteContainerView contents) {
+    static_assert(std::is_integral<IntT>::value,
+                  "IntT must be an integral type");
+    using UnsignedIntT = typename std::make_unsigned<IntT>::type;
+    bool negative = (contents[0] & 0x80) != 0;
+    size_t start = (!negative && contents.size() > 1 && contents[0] == 0) ? 1
+                                                                          : 0;
+    if ((negative && std::is_unsigned<IntT>::value) ||
+        contents.size() - start > sizeof(IntT)) {
+      return Status(error::GoogleError::OUT_OF_RANGE,
+                    "ASN.1 integer value is out of range");
+    }
+    UnsignedIntT bits = negative ? ~UnsignedIntT{0} : UnsignedIntT{0};
+    for (size_t i = start; i < contents.size(); ++i) {
+      bits = static_cast<UnsignedIntT>(bits << 8) | contents[i];
+    }
+    IntT value = static_cast<IntT>(bits);
+    if (std::is_signed<IntT>::value && !negative && value < 0) {
+      return Status(error::GoogleError::OUT_OF_RANGE,
+                    "ASN.1 integer value is out of range");
+    }
+    return value;
+  }
+
+  ByteContainerView der_;
+  ByteContainerView contents_;
+  unsigned tag_ = 0;
+};
+
 }  // namespace asylo
 
 #endif  // ASYLO_CRYPTO_ASN1_H_
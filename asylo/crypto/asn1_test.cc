@@ -25,6 +25,7 @@
 
 #include <cstdint>
 #include <iterator>
+#include <limits>
 #include <sstream>
 #include <string>
 #include <type_traits>
@@ -1151,5 +1152,157 @@ TYPED_TEST(Asn1Test, ValuesOfUnsupportedTypesCanBeSerialized) {
                   absl::HexStringToBytes(kUnsupportedValueDerHex))));
 }
 
+TEST(Asn1ViewTest, ReadsSequenceElementsInPlace) {
+  ObjectId oid;
+  ASYLO_ASSERT_OK_AND_ASSIGN(oid, ObjectId::CreateFromOidString("1.2.3.4"));
+  Asn1Value sequence;
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      sequence, Asn1Value::CreateSequenceFromStatusOrs(
+                    {Asn1Value::CreateBoolean(true),
+                     Asn1Value::CreateIntegerFromInt<int>(300),
+                     Asn1Value::CreateOctetString("octets"),
+                     Asn1Value::CreateObjectId(oid),
+                     Asn1Value::CreateEnumeratedFromInt<int>(5)}));
+  std::vector<uint8_t> der;
+  ASYLO_ASSERT_OK_AND_ASSIGN(der, sequence.SerializeToDer());
+
+  Asn1View view;
+  ASYLO_ASSERT_OK_AND_ASSIGN(view, Asn1View::Create(der));
+  EXPECT_THAT(view.Type(), Optional(Asn1Type::kSequence));
+  EXPECT_THAT(view.der(), Eq(ByteContainerView(der)));
+
+  std::vector<Asn1View> elements;
+  ASYLO_ASSERT_OK_AND_ASSIGN(elements, view.GetSequence());
+  ASSERT_THAT(elements, SizeIs(5));
+  EXPECT_THAT(elements[0].GetBoolean(), IsOkAndHolds(true));
+  EXPECT_THAT(elements[1].GetIntegerAsInt<int>(), IsOkAndHolds(300));
+  EXPECT_THAT(elements[3].GetObjectId(), IsOkAndHolds(oid));
+  EXPECT_TRUE(elements[3].IsObjectId(oid));
+  EXPECT_THAT(elements[4].GetEnumeratedAsInt<int>(), IsOkAndHolds(5));
+
+  StatusOr<ByteContainerView> octets_result = elements[2].GetOctetString();
+  ASSERT_THAT(octets_result, IsOk());
+  ByteContainerView octets = octets_result.ValueOrDie();
+  EXPECT_THAT(octets, Eq(ByteContainerView("octets")));
+  EXPECT_GE(octets.data(), der.data());
+  EXPECT_LE(octets.data() + octets.size(), der.data() + der.size());
+}
+
+TEST(Asn1ViewTest, GettersFailOnTypeMismatch) {
+  std::vector<uint8_t> der;
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      der, Asn1Value::CreateBoolean(false).ValueOrDie().SerializeToDer());
+  Asn1View view;
+  ASYLO_ASSERT_OK_AND_ASSIGN(view, Asn1View::Create(der));
+  EXPECT_THAT(view.GetBoolean(), IsOkAndHolds(false));
+  EXPECT_THAT(view.GetIntegerAsInt<int>(),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+  EXPECT_THAT(view.GetOctetString(),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+  EXPECT_THAT(view.GetSequence(),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+  EXPECT_FALSE(view.IsObjectId(
+      ObjectId::CreateFromOidString("1.2.3.4").ValueOrDie()));
+}
+
+TEST(Asn1ViewTest, IntegerGettersCheckRange) {
+  struct {
+    int64_t value;
+    bool fits_int8;
+    bool fits_uint8;
+  } test_cases[] = {{0, true, true},       {-1, true, false},
+                    {127, true, true},     {128, false, true},
+                    {-128, true, false},   {-129, false, false},
+                    {255, false, true},    {256, false, false}};
+  for (const auto &test_case : test_cases) {
+    std::vector<uint8_t> der;
+    ASYLO_ASSERT_OK_AND_ASSIGN(
+        der, Asn1Value::CreateIntegerFromInt(test_case.value)
+                 .ValueOrDie()
+                 .SerializeToDer());
+    Asn1View view;
+    ASYLO_ASSERT_OK_AND_ASSIGN(view, Asn1View::Create(der));
+    EXPECT_THAT(view.GetIntegerAsInt<int64_t>(),
+                IsOkAndHolds(test_case.value));
+    if (test_case.fits_int8) {
+      EXPECT_THAT(view.GetIntegerAsInt<int8_t>(),
+                  IsOkAndHolds(static_cast<int8_t>(test_case.value)));
+    } else {
+      EXPECT_THAT(view.GetIntegerAsInt<int8_t>(),
+                  StatusIs(error::GoogleError::OUT_OF_RANGE));
+    }
+    if (test_case.fits_uint8) {
+      EXPECT_THAT(view.GetIntegerAsInt<uint8_t>(),
+                  IsOkAndHolds(static_cast<uint8_t>(test_case.value)));
+    } else {
+      EXPECT_THAT(view.GetIntegerAsInt<uint8_t>(),
+                  StatusIs(error::GoogleError::OUT_OF_RANGE));
+    }
+  }
+}
+
+TEST(Asn1ViewTest, IntegerGettersHandleExtremeValues) {
+  for (int64_t value : {std::numeric_limits<int64_t>::min(),
+                        std::numeric_limits<int64_t>::max()}) {
+    std::vector<uint8_t> der;
+    ASYLO_ASSERT_OK_AND_ASSIGN(
+        der,
+        Asn1Value::CreateIntegerFromInt(value).ValueOrDie().SerializeToDer());
+    Asn1View view;
+    ASYLO_ASSERT_OK_AND_ASSIGN(view, Asn1View::Create(der));
+    EXPECT_THAT(view.GetIntegerAsInt<int64_t>(), IsOkAndHolds(value));
+  }
+
+  uint64_t max = std::numeric_limits<uint64_t>::max();
+  std::vector<uint8_t> der;
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      der, Asn1Value::CreateIntegerFromInt(max).ValueOrDie().SerializeToDer());
+  Asn1View view;
+  ASYLO_ASSERT_OK_AND_ASSIGN(view, Asn1View::Create(der));
+  EXPECT_THAT(view.GetIntegerAsInt<uint64_t>(), IsOkAndHolds(max));
+  EXPECT_THAT(view.GetIntegerAsInt<int64_t>(),
+              StatusIs(error::GoogleError::OUT_OF_RANGE));
+}
+
+TEST(Asn1ViewTest, RejectsNonMinimalIntegers) {
+  // An INTEGER 1 encoded with a redundant leading zero byte.
+  std::string der = absl::HexStringToBytes("02020001");
+  Asn1View view;
+  ASYLO_ASSERT_OK_AND_ASSIGN(view, Asn1View::Create(der));
+  EXPECT_THAT(view.GetIntegerAsInt<int>(),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+}
+
+TEST(Asn1ViewTest, CreateFailsWithMalformedInput) {
+  // Truncated OCTET STRING.
+  EXPECT_THAT(Asn1View::Create(absl::HexStringToBytes("0405616263")),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+  // BOOLEAN followed by a trailing byte.
+  EXPECT_THAT(Asn1View::Create(absl::HexStringToBytes("0101ff00")),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+}
+
+TEST(Asn1ViewTest, ValuesOfUnsupportedTypesHaveNulloptType) {
+  std::string der = absl::HexStringToBytes(kUnsupportedValueDerHex);
+  Asn1View view;
+  ASYLO_ASSERT_OK_AND_ASSIGN(view, Asn1View::Create(der));
+  EXPECT_THAT(view.Type(), Eq(absl::nullopt));
+  EXPECT_THAT(view.GetOctetString(),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+}
+
+TEST(Asn1ViewTest, ToAsn1ValueCopiesValue) {
+  Asn1Value original;
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      original, Asn1Value::CreateSequenceFromStatusOrs(
+                    {Asn1Value::CreateIntegerFromInt<int>(-7),
+                     Asn1Value::CreateOctetString("data")}));
+  std::vector<uint8_t> der;
+  ASYLO_ASSERT_OK_AND_ASSIGN(der, original.SerializeToDer());
+  Asn1View view;
+  ASYLO_ASSERT_OK_AND_ASSIGN(view, Asn1View::Create(der));
+  EXPECT_THAT(view.ToAsn1Value(), IsOkAndHolds(original));
+}
+
 }  // namespace
 }  // namespace asylo
@@ -0,0 +1,188 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/crypto/certificate_chain_cache.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "asylo/crypto/sha256_hash.h"
+#include "asylo/crypto/util/byte_container_view.h"
+#include "asylo/util/status.h"
+#include "asylo/util/status_macros.h"
+
+namespace asylo {
+namespace {
+
+// Appends |value| to |hash| as eight little-endian bytes.
+void UpdateWithUint64(uint64_t value, Sha256Hash *hash) {
+  uint8_t bytes[sizeof(value)];
+  for (size_t i = 0; i < sizeof(value); ++i) {
+    bytes[i] = static_cast<uint8_t>(value >> (8 * i));
+  }
+  hash->Update(ByteContainerView(bytes, sizeof(bytes)));
+}
+
+// Returns the cache key of |chain| verified with |verification_config|. The
+// time in |verification_config| is left out, since validity periods are checked
+// on every lookup.
+StatusOr<std::string> CacheKey(const CertificateChain &chain,
+                               const VerificationConfig &verification_config) {
+  Sha256Hash hash;
+  UpdateWithUint64(chain.certificates_size(), &hash);
+  for (const Certificate &certificate : chain.certificates()) {
+    UpdateWithUint64(certificate.format(), &hash);
+    UpdateWithUint64(certificate.data().size(), &hash);
+    hash.Update(certificate.data());
+  }
+  uint8_t checks[] = {
+      verification_config.issuer_ca,
+      verification_config.max_pathlen,
+      verification_config.issuer_key_usage,
+      verification_config.subject_validity_period.has_value(),
+      verification_config.revocation_checker != nullptr,
+  };
+  hash.Update(ByteContainerView(checks, sizeof(checks)));
+
+  std::vector<uint8_t> digest;
+  ASYLO_RETURN_IF_ERROR(hash.CumulativeHash(&digest));
+  return std::string(digest.begin(), digest.end());
+}
+
+// Returns whether every certificate in |chain| is valid at the time given by
+// |verification_config|, if the config checks validity periods, and has not
+// been revoked, if the config has a revocation checker.
+bool StillValid(const CertificateInterfaceVector &chain,
+                const VerificationConfig &verification_config) {
+  if (verification_config.subject_validity_period.has_value()) {
+    for (const auto &certificate : chain) {
+      StatusOr<bool> within_period = certificate->WithinValidityPeriod(
+          verification_config.subject_validity_period.value());
+      if (!within_period.ok() || !within_period.ValueOrDie()) {
+        return false;
+      }
+    }
+  }
+  if (verification_config.revocation_checker != nullptr) {
+    absl::Time time =
+        verification_config.subject_validity_period.value_or(absl::Now());
+    for (size_t i = 0; i + 1 < chain.size(); ++i) {
+      if (!verification_config.revocation_checker
+               ->CheckNotRevoked(*chain[i], *chain[i + 1], time)
+               .ok()) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+VerifiedCertificateChainCache::VerifiedCertificateChainCache(
+    CertificateFactoryMap factory_map, size_t capacity)
+    : factory_map_(std::move(factory_map)),
+      capacity_(capacity) {}
+
+StatusOr<std::shared_ptr<const CertificateInterfaceVector>>
+VerifiedCertificateChainCache::ParseAndVerify(
+    const CertificateChain &chain,
+    const VerificationConfig &verification_config) {
+  std::string key;
+  ASYLO_ASSIGN_OR_RETURN(key, CacheKey(chain, verification_config));
+
+  std::shared_ptr<const CertificateInterfaceVector> cached = Lookup(key);
+  if (cached) {
+    if (StillValid(*cached, verification_config)) {
+      return cached;
+    }
+    // Let the full verification below report which certificate expired or was
+    // revoked.
+    Erase(key);
+  }
+
+  CertificateInterfaceVector certificate_chain;
+  ASYLO_ASSIGN_OR_RETURN(certificate_chain,
+                         CreateCertificateChain(factory_map_, chain));
+  ASYLO_RETURN_IF_ERROR(
+      VerifyCertificateChain(certificate_chain, verification_config));
+
+  auto verified = std::make_shared<const CertificateInterfaceVector>(
+      std::move(certificate_chain));
+  Insert(key, verified);
+  return verified;
+}
+
+void VerifiedCertificateChainCache::Clear() {
+  auto members_view = members_.Lock();
+  members_view->entries.clear();
+  members_view->index.clear();
+}
+
+size_t VerifiedCertificateChainCache::size() const {
+  return members_.ReaderLock()->entries.size();
+}
+
+std::shared_ptr<const CertificateInterfaceVector>
+VerifiedCertificateChainCache::Lookup(const std::string &key) {
+  auto members_view = members_.Lock();
+  auto it = members_view->index.find(key);
+  if (it == members_view->index.end()) {
+    return nullptr;
+  }
+  members_view->entries.splice(members_view->entries.begin(),
+                               members_view->entries, it->second);
+  return it->second->chain;
+}
+
+void VerifiedCertificateChainCache::Erase(const std::string &key) {
+  auto members_view = members_.Lock();
+  auto it = members_view->index.find(key);
+  if (it != members_view->index.end()) {
+    members_view->entries.erase(it->second);
+    members_view->index.erase(it);
+  }
+}
+
+void VerifiedCertificateChainCache::Insert(
+    const std::string &key,
+    std::shared_ptr<const CertificateInterfaceVector> chain) {
+  if (capacity_ == 0) {
+    return;
+  }
+  auto members_view = members_.Lock();
+  auto it = members_view->index.find(key);
+  if (it != members_view->index.end()) {
+    // Another thread verified the same chain concurrently.
+    it->second->chain = std::move(chain);
+    members_view->entries.splice(members_view->entries.begin(),
+                                 members_view->entries, it->second);
+    return;
+  }
+  if (members_view->entries.size() >= capacity_) {
+    members_view->index.erase(members_view->entries.back().key);
+    members_view->entries.pop_back();
+  }
+  members_view->entries.push_front({key, std::move(chain)});
+  members_view->index.emplace(key, members_view->entries.begin());
+}
+
+}  // namespace asylo
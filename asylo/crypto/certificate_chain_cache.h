@@ -0,0 +1,113 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_CRYPTO_CERTIFICATE_CHAIN_CACHE_H_
+#define ASYLO_CRYPTO_CERTIFICATE_CHAIN_CACHE_H_
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+#include "asylo/crypto/certificate.pb.h"
+#include "asylo/crypto/certificate_interface.h"
+#include "asylo/crypto/certificate_util.h"
+#include "asylo/util/mutex_guarded.h"
+#include "asylo/util/statusor.h"
+
+namespace asylo {
+
+// A bounded cache of certificate chains which were parsed and verified
+// successfully. Chains such as the Intel PCK chain recur in every assertion of
+// a platform, and the cache lets them be parsed and have their signatures
+// checked once instead of on every verification.
+//
+// Entries are keyed by a digest of the encoded chain and of the checks
+// requested by the VerificationConfig. The validity periods of a cached chain
+// are checked again against the time in the VerificationConfig on every hit,
+// so an entry stops being used once any of its certificates expires. Likewise,
+// the revocation checker of the VerificationConfig, if any, is consulted again
+// on every hit. Failed verifications are not cached. When the set of revoked
+// certificates changes and the VerificationConfig has no revocation checker,
+// the caller must Clear() the cache.
+//
+// When the cache is full, the least-recently-used entry is evicted.
+//
+// This class is thread-safe.
+class VerifiedCertificateChainCache {
+ public:
+  // Creates a cache holding up to |capacity| chains, which parses certificates
+  // with |factory_map|.
+  VerifiedCertificateChainCache(CertificateFactoryMap factory_map,
+                                size_t capacity);
+
+  VerifiedCertificateChainCache(const VerifiedCertificateChainCache &) =
+      delete;
+  VerifiedCertificateChainCache &operator=(
+      const VerifiedCertificateChainCache &) = delete;
+
+  // Parses |chain| and verifies it with |verification_config|, as
+  // CreateCertificateChain() followed by VerifyCertificateChain() would, and
+  // returns the parsed chain. Returns the cached chain if an equal chain was
+  // already verified with the same checks and all its certificates are valid
+  // at the time given by |verification_config|.
+  StatusOr<std::shared_ptr<const CertificateInterfaceVector>> ParseAndVerify(
+      const CertificateChain &chain,
+      const VerificationConfig &verification_config);
+
+  // Removes all entries.
+  void Clear();
+
+  // Returns the number of cached chains.
+  size_t size() const;
+
+ private:
+  struct Entry {
+    std::string key;
+    std::shared_ptr<const CertificateInterfaceVector> chain;
+  };
+
+  // Type that holds members for mutex-synchronized access.
+  struct Members {
+    // Entries from most to least recently used.
+    std::list<Entry> entries;
+    absl::flat_hash_map<std::string, std::list<Entry>::iterator> index;
+  };
+
+  // Returns the cached chain for |key|, or nullptr if there is none, and marks
+  // the entry as most recently used.
+  std::shared_ptr<const CertificateInterfaceVector> Lookup(
+      const std::string &key);
+
+  // Removes the entry for |key|, if there is one.
+  void Erase(const std::string &key);
+
+  // Adds |chain| under |key|, evicting the least-recently-used entry if the
+  // cache is full.
+  void Insert(const std::string &key,
+              std::shared_ptr<const CertificateInterfaceVector> chain);
+
+  const CertificateFactoryMap factory_map_;
+  const size_t capacity_;
+  MutexGuarded<Members> members_;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_CRYPTO_CERTIFICATE_CHAIN_CACHE_H_
@@ -0,0 +1,239 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/crypto/certificate_chain_cache.h"
+
+#include <memory>
+#include <string>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/memory/memory.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "absl/types/optional.h"
+#include "asylo/crypto/certificate.pb.h"
+#include "asylo/crypto/certificate_interface.h"
+#include "asylo/crypto/fake_certificate.h"
+#include "asylo/crypto/fake_certificate.pb.h"
+#include "asylo/test/util/status_matchers.h"
+#include "asylo/util/status.h"
+#include "asylo/util/status_macros.h"
+#include "asylo/util/statusor.h"
+
+namespace asylo {
+namespace {
+
+using ::testing::Eq;
+using ::testing::Ne;
+using ::testing::Not;
+
+constexpr char kRootKey[] = "f00d";
+constexpr char kIntermediateKey[] = "c0ff33";
+
+// A FakeCertificate which is valid until a given time.
+class ExpiringCertificate : public FakeCertificate {
+ public:
+  ExpiringCertificate(const FakeCertificate &certificate, absl::Time not_after)
+      : FakeCertificate(certificate), not_after_(not_after) {}
+
+  StatusOr<bool> WithinValidityPeriod(const absl::Time &time) const override {
+    return time <= not_after_;
+  }
+
+ private:
+  absl::Time not_after_;
+};
+
+// A RevocationChecker which revokes every certificate issued to a given key.
+class FakeRevocationChecker : public RevocationChecker {
+ public:
+  Status CheckNotRevoked(const CertificateInterface &subject,
+                         const CertificateInterface &issuer,
+                         absl::Time time) const override {
+    StatusOr<std::string> subject_key = subject.SubjectKeyDer();
+    if (subject_key.ok() && subject_key.ValueOrDie() == revoked_key_) {
+      return Status(error::GoogleError::UNAUTHENTICATED, "Revoked");
+    }
+    return Status::OkStatus();
+  }
+
+  void Revoke(absl::string_view subject_key) {
+    revoked_key_ = std::string(subject_key);
+  }
+
+ private:
+  std::string revoked_key_;
+};
+
+// Adds a fake certificate for |subject_key| issued by |issuer_key| to |chain|.
+void AddCertificate(absl::string_view subject_key, absl::string_view issuer_key,
+                    CertificateChain *chain) {
+  FakeCertificateProto fake_cert;
+  fake_cert.set_subject_key(subject_key.data(), subject_key.size());
+  fake_cert.set_issuer_key(issuer_key.data(), issuer_key.size());
+  fake_cert.set_is_ca(true);
+
+  Certificate *certificate = chain->add_certificates();
+  certificate->set_format(Certificate::X509_PEM);
+  fake_cert.SerializeToString(certificate->mutable_data());
+}
+
+// Returns a chain from a certificate for |end_user_key| to the test root.
+CertificateChain CreateChain(absl::string_view end_user_key) {
+  CertificateChain chain;
+  AddCertificate(end_user_key, kIntermediateKey, &chain);
+  AddCertificate(kIntermediateKey, kRootKey, &chain);
+  AddCertificate(kRootKey, kRootKey, &chain);
+  return chain;
+}
+
+class VerifiedCertificateChainCacheTest : public ::testing::Test {
+ protected:
+  // Returns a cache of |capacity| chains whose certificates expire at
+  // |not_after_| and which counts parsed certificates in |parse_count_|.
+  std::unique_ptr<VerifiedCertificateChainCache> CreateCache(size_t capacity) {
+    CertificateFactoryMap factory_map;
+    factory_map.emplace(
+        Certificate::X509_PEM,
+        [this](Certificate certificate)
+            -> StatusOr<std::unique_ptr<CertificateInterface>> {
+          ++parse_count_;
+          std::unique_ptr<FakeCertificate> fake;
+          ASYLO_ASSIGN_OR_RETURN(fake, FakeCertificate::Create(certificate));
+          return absl::make_unique<ExpiringCertificate>(*fake, not_after_);
+        });
+    return absl::make_unique<VerifiedCertificateChainCache>(
+        std::move(factory_map), capacity);
+  }
+
+  int parse_count_ = 0;
+  absl::Time not_after_ = absl::InfiniteFuture();
+};
+
+TEST_F(VerifiedCertificateChainCacheTest, ReusesVerifiedChain) {
+  auto cache = CreateCache(/*capacity=*/4);
+  VerificationConfig config(/*all_fields=*/true);
+
+  std::shared_ptr<const CertificateInterfaceVector> first;
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      first, cache->ParseAndVerify(CreateChain("user"), config));
+  EXPECT_THAT(first->size(), Eq(3));
+  EXPECT_THAT(parse_count_, Eq(3));
+
+  std::shared_ptr<const CertificateInterfaceVector> second;
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      second, cache->ParseAndVerify(CreateChain("user"), config));
+  EXPECT_THAT(second, Eq(first));
+  EXPECT_THAT(parse_count_, Eq(3));
+  EXPECT_THAT(cache->size(), Eq(1));
+}
+
+TEST_F(VerifiedCertificateChainCacheTest, DoesNotCacheFailures) {
+  auto cache = CreateCache(/*capacity=*/4);
+  VerificationConfig config(/*all_fields=*/true);
+  CertificateChain chain;
+  AddCertificate("user", "unknown issuer", &chain);
+  AddCertificate(kRootKey, kRootKey, &chain);
+
+  EXPECT_THAT(cache->ParseAndVerify(chain, config), Not(IsOk()));
+  EXPECT_THAT(cache->ParseAndVerify(chain, config), Not(IsOk()));
+  EXPECT_THAT(cache->size(), Eq(0));
+  EXPECT_THAT(parse_count_, Eq(4));
+}
+
+TEST_F(VerifiedCertificateChainCacheTest, KeysOnRequestedChecks) {
+  auto cache = CreateCache(/*capacity=*/4);
+
+  ASYLO_ASSERT_OK(cache->ParseAndVerify(CreateChain("user"),
+                                        VerificationConfig(true)));
+  ASYLO_ASSERT_OK(cache->ParseAndVerify(CreateChain("user"),
+                                        VerificationConfig(false)));
+  EXPECT_THAT(cache->size(), Eq(2));
+  EXPECT_THAT(parse_count_, Eq(6));
+}
+
+TEST_F(VerifiedCertificateChainCacheTest, DropsExpiredChain) {
+  auto cache = CreateCache(/*capacity=*/4);
+  absl::Time now = absl::Now();
+  not_after_ = now + absl::Hours(1);
+
+  std::shared_ptr<const CertificateInterfaceVector> first;
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      first, cache->ParseAndVerify(CreateChain("user"),
+                                   VerificationConfig(true, now)));
+
+  // Once the cached certificates expire the chain is parsed and verified
+  // again.
+  not_after_ = absl::InfiniteFuture();
+  std::shared_ptr<const CertificateInterfaceVector> second;
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      second, cache->ParseAndVerify(
+                  CreateChain("user"),
+                  VerificationConfig(true, now + absl::Hours(2))));
+  EXPECT_THAT(second, Ne(first));
+  EXPECT_THAT(parse_count_, Eq(6));
+  EXPECT_THAT(cache->size(), Eq(1));
+}
+
+TEST_F(VerifiedCertificateChainCacheTest, ChecksRevocationOnEveryHit) {
+  auto cache = CreateCache(/*capacity=*/4);
+  FakeRevocationChecker revocation_checker;
+  VerificationConfig config(/*all_fields=*/true);
+  config.revocation_checker = &revocation_checker;
+
+  ASYLO_ASSERT_OK(cache->ParseAndVerify(CreateChain("user"), config).status());
+  EXPECT_THAT(cache->size(), Eq(1));
+
+  revocation_checker.Revoke(kIntermediateKey);
+  EXPECT_THAT(cache->ParseAndVerify(CreateChain("user"), config).status(),
+              StatusIs(error::GoogleError::UNAUTHENTICATED));
+  EXPECT_THAT(cache->size(), Eq(0));
+}
+
+TEST_F(VerifiedCertificateChainCacheTest, EvictsLeastRecentlyUsedChain) {
+  auto cache = CreateCache(/*capacity=*/2);
+  VerificationConfig config(/*all_fields=*/false);
+
+  ASYLO_ASSERT_OK(cache->ParseAndVerify(CreateChain("user1"), config));
+  ASYLO_ASSERT_OK(cache->ParseAndVerify(CreateChain("user2"), config));
+  ASYLO_ASSERT_OK(cache->ParseAndVerify(CreateChain("user1"), config));
+  ASYLO_ASSERT_OK(cache->ParseAndVerify(CreateChain("user3"), config));
+  EXPECT_THAT(cache->size(), Eq(2));
+  EXPECT_THAT(parse_count_, Eq(9));
+
+  // "user2" was evicted, "user1" was not.
+  ASYLO_ASSERT_OK(cache->ParseAndVerify(CreateChain("user1"), config));
+  EXPECT_THAT(parse_count_, Eq(9));
+  ASYLO_ASSERT_OK(cache->ParseAndVerify(CreateChain("user2"), config));
+  EXPECT_THAT(parse_count_, Eq(12));
+}
+
+TEST_F(VerifiedCertificateChainCacheTest, ClearRemovesAllChains) {
+  auto cache = CreateCache(/*capacity=*/4);
+  VerificationConfig config(/*all_fields=*/true);
+
+  ASYLO_ASSERT_OK(cache->ParseAndVerify(CreateChain("user"), config));
+  cache->Clear();
+  EXPECT_THAT(cache->size(), Eq(0));
+  ASYLO_ASSERT_OK(cache->ParseAndVerify(CreateChain("user"), config));
+  EXPECT_THAT(parse_count_, Eq(6));
+}
+
+}  // namespace
+}  // namespace asylo
@@ -31,6 +31,22 @@
 
 namespace asylo {
 
+class CertificateInterface;
+
+// Checks whether certificates have been revoked by their issuers, for instance
+// against the certificate revocation lists published by those issuers.
+class RevocationChecker {
+ public:
+  virtual ~RevocationChecker() = default;
+
+  // Returns an UNAUTHENTICATED error if |issuer| has revoked |subject| at
+  // |time|. Returns an OK Status if |subject| is not revoked, or if the checker
+  // has no revocation information about certificates issued by |issuer|.
+  virtual Status CheckNotRevoked(const CertificateInterface &subject,
+                                 const CertificateInterface &issuer,
+                                 absl::Time time) const = 0;
+};
+
 // Options for additional verification logic. Even if a field is set, if the
 // concept does not apply for a CertificateInterface implementation, the
 // implementation may ignore that check.
@@ -49,6 +65,10 @@ struct VerificationConfig {
   // Checks that the validity period of the subject certificate is valid at the
   // given time.
   absl::optional<absl::Time> subject_validity_period;
+  // If not null, checks that no certificate in a chain has been revoked by its
+  // issuer, at |subject_validity_period| if it is set and at the current time
+  // otherwise. The checker must outlive the verification.
+  const RevocationChecker *revocation_checker = nullptr;
 
   VerificationConfig() = default;
 
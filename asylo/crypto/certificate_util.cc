@@ -20,10 +20,14 @@
 
 #include <cstdint>
 #include <utility>
+#include <vector>
 
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "absl/types/optional.h"
+#include "absl/types/span.h"
 #include "asylo/crypto/x509_certificate.h"
 #include "asylo/identity/attestation/sgx/internal/attestation_key_certificate_impl.h"
 #include "asylo/util/proto_enum_util.h"
@@ -148,8 +152,46 @@ StatusOr<CertificateInterfaceVector> CreateCertificateChain(
   return std::move(certificate_interface_chain);
 }
 
-Status VerifyCertificateChain(CertificateInterfaceSpan certificate_chain,
-                              const VerificationConfig &verification_config) {
+namespace {
+
+// The result of verifying |subject| with |issuer|.
+struct VerifiedLink {
+  const CertificateInterface *subject;
+  const CertificateInterface *issuer;
+  Status status;
+};
+
+// Verifies |subject| with |issuer|. If |verified_links| is not null, reuses the
+// result for an equal pair of certificates from |verified_links| if there is
+// one, and otherwise records the result there when |subject| may be a CA.
+// End-entity certificates are rarely shared between chains, so they are not
+// cached.
+Status VerifyLink(const CertificateInterface &subject,
+                  const CertificateInterface &issuer,
+                  const VerificationConfig &verification_config,
+                  std::vector<VerifiedLink> *verified_links) {
+  bool cacheable = verified_links && subject.IsCa().value_or(true);
+  if (cacheable) {
+    for (const VerifiedLink &link : *verified_links) {
+      if (*link.subject == subject && *link.issuer == issuer) {
+        return link.status;
+      }
+    }
+  }
+
+  Status status = subject.Verify(issuer, verification_config);
+  if (cacheable) {
+    verified_links->push_back({&subject, &issuer, status});
+  }
+  return status;
+}
+
+// Verifies |certificate_chain| as VerifyCertificateChain() does. If
+// |verified_links| is not null, it caches the results of verifying CA
+// certificates, which chains verified together usually share.
+Status VerifyChainWithCache(CertificateInterfaceSpan certificate_chain,
+                            const VerificationConfig &verification_config,
+                            std::vector<VerifiedLink> *verified_links) {
   if (certificate_chain.empty()) {
     return Status(error::GoogleError::INVALID_ARGUMENT,
                   "Certificate chain must include at least one certificate");
@@ -179,7 +221,13 @@ Status VerifyCertificateChain(CertificateInterfaceSpan certificate_chain,
       ca_count++;
     }
 
-    Status status = subject->Verify(*issuer, verification_config);
+    Status status =
+        VerifyLink(*subject, *issuer, verification_config, verified_links);
+    if (status.ok() && verification_config.revocation_checker != nullptr) {
+      status = verification_config.revocation_checker->CheckNotRevoked(
+          *subject, *issuer,
+          verification_config.subject_validity_period.value_or(absl::Now()));
+    }
     if (!status.ok()) {
       return status.WithPrependedContext(
           absl::StrCat("Failed to verify certificate at index ", i));
@@ -189,7 +237,8 @@ Status VerifyCertificateChain(CertificateInterfaceSpan certificate_chain,
   const CertificateInterface *root = certificate_chain.rbegin()->get();
 
   // Root certificate should be self-signed.
-  Status status = root->Verify(*root, verification_config);
+  Status status =
+      VerifyLink(*root, *root, verification_config, verified_links);
   if (!status.ok()) {
     return status.WithPrependedContext("Failed to verify root certificate");
   }
@@ -197,6 +246,27 @@ Status VerifyCertificateChain(CertificateInterfaceSpan certificate_chain,
   return Status::OkStatus();
 }
 
+}  // namespace
+
+Status VerifyCertificateChain(CertificateInterfaceSpan certificate_chain,
+                              const VerificationConfig &verification_config) {
+  return VerifyChainWithCache(certificate_chain, verification_config,
+                              /*verified_links=*/nullptr);
+}
+
+std::vector<Status> VerifyCertificateChains(
+    absl::Span<const CertificateInterfaceSpan> certificate_chains,
+    const VerificationConfig &verification_config) {
+  std::vector<VerifiedLink> verified_links;
+  std::vector<Status> results;
+  results.reserve(certificate_chains.size());
+  for (CertificateInterfaceSpan certificate_chain : certificate_chains) {
+    results.push_back(VerifyChainWithCache(
+        certificate_chain, verification_config, &verified_links));
+  }
+  return results;
+}
+
 StatusOr<Certificate> GetCertificateFromPem(absl::string_view pem_cert) {
   std::unique_ptr<X509Certificate> cert;
   ASYLO_ASSIGN_OR_RETURN(cert, X509Certificate::CreateFromPem(pem_cert));
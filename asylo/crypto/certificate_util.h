@@ -103,6 +103,14 @@ StatusOr<CertificateInterfaceVector> CreateCertificateChain(
 Status VerifyCertificateChain(CertificateInterfaceSpan certificate_chain,
                               const VerificationConfig &verification_config);
 
+// Verifies each of |certificate_chains| as VerifyCertificateChain() does and
+// returns one Status per chain. Links between CA certificates which appear in
+// more than one chain, such as a common root and intermediate, are verified
+// only once.
+std::vector<Status> VerifyCertificateChains(
+    absl::Span<const CertificateInterfaceSpan> certificate_chains,
+    const VerificationConfig &verification_config);
+
 // Parses PEM-encoded certificate |pem_cert| into Certificate protobuf.
 // Returns a non-OK Status if |pem_cert| is not X.509 PEM encoded.
 StatusOr<Certificate> GetCertificateFromPem(absl::string_view pem_cert);
@@ -25,6 +25,7 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include "absl/memory/memory.h"
+#include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
 #include "absl/types/span.h"
 #include "asylo/crypto/certificate.pb.h"
@@ -741,6 +742,82 @@ TEST(CertificateUtilTest, VerifyCertificateChainCaValuesSet) {
   ASYLO_EXPECT_OK(VerifyCertificateChain(absl::MakeConstSpan(chain), config));
 }
 
+// A FakeCertificate which counts the calls to Verify() on all its instances.
+class CountingCertificate : public FakeCertificate {
+ public:
+  CountingCertificate(absl::string_view subject_key,
+                      absl::string_view issuer_key, absl::optional<bool> is_ca,
+                      int *verify_count)
+      : FakeCertificate(subject_key, issuer_key, is_ca,
+                        /*pathlength=*/absl::nullopt,
+                        /*subject_name=*/absl::nullopt),
+        verify_count_(verify_count) {}
+
+  Status Verify(const CertificateInterface &issuer_certificate,
+                const VerificationConfig &config) const override {
+    ++*verify_count_;
+    return FakeCertificate::Verify(issuer_certificate, config);
+  }
+
+ private:
+  int *verify_count_;
+};
+
+// Returns a chain from an end-user certificate for |end_user_key| through a
+// common intermediate to a common root.
+CertificateInterfaceVector CreateCountingChain(absl::string_view end_user_key,
+                                               absl::string_view issuer_key,
+                                               int *verify_count) {
+  CertificateInterfaceVector chain;
+  chain.emplace_back(absl::make_unique<CountingCertificate>(
+      end_user_key, issuer_key, /*is_ca=*/false, verify_count));
+  chain.emplace_back(absl::make_unique<CountingCertificate>(
+      kIntermediateKey, kRootKey, /*is_ca=*/true, verify_count));
+  chain.emplace_back(absl::make_unique<CountingCertificate>(
+      kRootKey, kRootKey, /*is_ca=*/true, verify_count));
+  return chain;
+}
+
+TEST(CertificateUtilTest, VerifyCertificateChainsSharesCaLinks) {
+  int verify_count = 0;
+  std::vector<CertificateInterfaceVector> chains;
+  chains.push_back(
+      CreateCountingChain("user1", kIntermediateKey, &verify_count));
+  chains.push_back(
+      CreateCountingChain("user2", kIntermediateKey, &verify_count));
+  chains.push_back(
+      CreateCountingChain("user3", kIntermediateKey, &verify_count));
+  std::vector<CertificateInterfaceSpan> spans(chains.begin(), chains.end());
+
+  VerificationConfig config(/*all_fields=*/true);
+  std::vector<Status> results = VerifyCertificateChains(spans, config);
+  ASSERT_EQ(results.size(), 3);
+  for (const Status &result : results) {
+    ASYLO_EXPECT_OK(result);
+  }
+
+  // Three end-user links plus one intermediate link and one root link.
+  EXPECT_EQ(verify_count, 5);
+}
+
+TEST(CertificateUtilTest, VerifyCertificateChainsReportsEachChain) {
+  int verify_count = 0;
+  std::vector<CertificateInterfaceVector> chains;
+  chains.push_back(
+      CreateCountingChain("user1", kIntermediateKey, &verify_count));
+  chains.push_back(
+      CreateCountingChain("user2", kExtraIntermediateKey, &verify_count));
+  chains.emplace_back();
+  std::vector<CertificateInterfaceSpan> spans(chains.begin(), chains.end());
+
+  VerificationConfig config(/*all_fields=*/true);
+  std::vector<Status> results = VerifyCertificateChains(spans, config);
+  ASSERT_EQ(results.size(), 3);
+  ASYLO_EXPECT_OK(results[0]);
+  EXPECT_THAT(results[1], StatusIs(error::GoogleError::UNAUTHENTICATED));
+  EXPECT_THAT(results[2], StatusIs(error::GoogleError::INVALID_ARGUMENT));
+}
+
 TEST(CertificateUtilTest, CreateCertificateInterfaceMissingFormat) {
   FakeCertificateProto cert_proto;
   cert_proto.set_subject_key(kRootKey);
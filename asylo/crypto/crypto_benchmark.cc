@@ -0,0 +1,396 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Benchmarks of the crypto primitives, used to choose schemes and buffer sizes.
+// The same suite runs natively and inside an enclave, so the enclave overhead
+// of each primitive is the difference between the two. Inside an enclave the
+// benchmarks only run when the test is passed --benchmarks=all, or
+// --benchmarks=<regex> to select some of them.
+
+#include <openssl/bn.h>
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "asylo/crypto/aead_cryptor.h"
+#include "asylo/crypto/algorithms.pb.h"
+#include "asylo/crypto/asn1.h"
+#include "asylo/crypto/certificate.pb.h"
+#include "asylo/crypto/certificate_interface.h"
+#include "asylo/crypto/certificate_util.h"
+#include "asylo/crypto/ecdsa_p256_sha256_signing_key.h"
+#include "asylo/crypto/rsa_oaep_encryption_key.h"
+#include "asylo/crypto/sha256_hash.h"
+#include "asylo/crypto/util/byte_container_view.h"
+#include "asylo/crypto/x509_certificate.h"
+#include "asylo/util/cleansing_types.h"
+#include "asylo/util/status.h"
+#include "asylo/util/status_macros.h"
+#include "asylo/util/statusor.h"
+
+namespace asylo {
+namespace {
+
+// Message sizes of the AEAD and hash benchmarks, from a small RPC to a large
+// sealed blob.
+constexpr int64_t kMinMessageSize = 64;
+constexpr int64_t kMaxMessageSize = 1 << 20;
+
+// Size of the messages signed and encrypted by the asymmetric benchmarks.
+constexpr size_t kAsymmetricMessageSize = 32;
+
+constexpr uint8_t kAes256Key[32] = {};
+
+StatusOr<std::unique_ptr<AeadCryptor>> CreateCryptor(AeadScheme scheme) {
+  switch (scheme) {
+    case AeadScheme::AES256_GCM:
+      return AeadCryptor::CreateAesGcmCryptor(kAes256Key);
+    case AeadScheme::AES256_GCM_SIV:
+      return AeadCryptor::CreateAesGcmSivCryptor(kAes256Key);
+    default:
+      return Status(error::GoogleError::INVALID_ARGUMENT,
+                    "Unsupported AEAD scheme");
+  }
+}
+
+// Creates a certificate for |subject_key| named |subject_name|, issued by
+// |issuer_name| and signed with |issuer_key|.
+StatusOr<std::unique_ptr<CertificateInterface>> CreateCertificate(
+    const SigningKey &subject_key, const std::string &subject_name,
+    const SigningKey &issuer_key, const std::string &issuer_name, bool is_ca) {
+  X509CertificateBuilder builder;
+  builder.serial_number.reset(BN_new());
+  if (!builder.serial_number || !BN_set_word(builder.serial_number.get(), 1)) {
+    return Status(error::GoogleError::INTERNAL, "Failed to set serial number");
+  }
+
+  X509NameEntry issuer_entry;
+  ASYLO_ASSIGN_OR_RETURN(issuer_entry.field,
+                         ObjectId::CreateFromShortName("CN"));
+  issuer_entry.value = issuer_name;
+  builder.issuer = {issuer_entry};
+
+  X509NameEntry subject_entry;
+  ASYLO_ASSIGN_OR_RETURN(subject_entry.field,
+                         ObjectId::CreateFromShortName("CN"));
+  subject_entry.value = subject_name;
+  builder.subject = {subject_entry};
+
+  builder.validity = {absl::Now() - absl::Hours(1),
+                      absl::Now() + absl::Hours(24)};
+  builder.basic_constraints = BasicConstraints{is_ca, absl::nullopt};
+
+  std::unique_ptr<VerifyingKey> verifying_key;
+  ASYLO_ASSIGN_OR_RETURN(verifying_key, subject_key.GetVerifyingKey());
+  ASYLO_ASSIGN_OR_RETURN(builder.subject_public_key_der,
+                         verifying_key->SerializeToDer());
+
+  std::unique_ptr<X509Certificate> certificate;
+  ASYLO_ASSIGN_OR_RETURN(certificate, builder.SignAndBuild(issuer_key));
+  return std::unique_ptr<CertificateInterface>(std::move(certificate));
+}
+
+// Creates a chain of an end-user certificate, an intermediate CA certificate
+// and a self-signed root CA certificate.
+StatusOr<CertificateInterfaceVector> CreateCertificateChain() {
+  std::unique_ptr<SigningKey> root_key;
+  std::unique_ptr<SigningKey> intermediate_key;
+  std::unique_ptr<SigningKey> end_user_key;
+  ASYLO_ASSIGN_OR_RETURN(root_key, EcdsaP256Sha256SigningKey::Create());
+  ASYLO_ASSIGN_OR_RETURN(intermediate_key, EcdsaP256Sha256SigningKey::Create());
+  ASYLO_ASSIGN_OR_RETURN(end_user_key, EcdsaP256Sha256SigningKey::Create());
+
+  CertificateInterfaceVector chain(3);
+  ASYLO_ASSIGN_OR_RETURN(chain[0],
+                         CreateCertificate(*end_user_key, "End user",
+                                           *intermediate_key, "Intermediate",
+                                           /*is_ca=*/false));
+  ASYLO_ASSIGN_OR_RETURN(
+      chain[1], CreateCertificate(*intermediate_key, "Intermediate", *root_key,
+                                  "Root", /*is_ca=*/true));
+  ASYLO_ASSIGN_OR_RETURN(chain[2],
+                         CreateCertificate(*root_key, "Root", *root_key, "Root",
+                                           /*is_ca=*/true));
+  return std::move(chain);
+}
+
+// Returns the DER encoding of an end-user certificate, or an empty string on
+// failure.
+std::string CertificateDer() {
+  StatusOr<CertificateInterfaceVector> chain_result = CreateCertificateChain();
+  if (!chain_result.ok()) {
+    return "";
+  }
+  StatusOr<Certificate> proto_result =
+      chain_result.ValueOrDie()[0]->ToCertificateProto(Certificate::X509_DER);
+  return proto_result.ok() ? proto_result.ValueOrDie().data() : "";
+}
+
+// Measures sealing a message of state.range(0) bytes with |scheme|.
+template <AeadScheme scheme>
+void BM_AeadSeal(benchmark::State &state) {
+  StatusOr<std::unique_ptr<AeadCryptor>> cryptor_result = CreateCryptor(scheme);
+  if (!cryptor_result.ok()) {
+    state.SkipWithError("Failed to create cryptor");
+    return;
+  }
+  AeadCryptor *cryptor = cryptor_result.ValueOrDie().get();
+  std::vector<uint8_t> plaintext(state.range(0), 'a');
+  std::vector<uint8_t> nonce(cryptor->NonceSize());
+  std::vector<uint8_t> ciphertext(plaintext.size() +
+                                  cryptor->MaxSealOverhead());
+  size_t ciphertext_size;
+  for (auto _ : state) {
+    if (!cryptor
+             ->Seal(plaintext, /*associated_data=*/"", absl::MakeSpan(nonce),
+                    absl::MakeSpan(ciphertext), &ciphertext_size)
+             .ok()) {
+      state.SkipWithError("Seal failed");
+      break;
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_TEMPLATE(BM_AeadSeal, AeadScheme::AES256_GCM)
+    ->RangeMultiplier(16)
+    ->Range(kMinMessageSize, kMaxMessageSize);
+BENCHMARK_TEMPLATE(BM_AeadSeal, AeadScheme::AES256_GCM_SIV)
+    ->RangeMultiplier(16)
+    ->Range(kMinMessageSize, kMaxMessageSize);
+
+// Measures opening a message of state.range(0) bytes sealed with |scheme|.
+template <AeadScheme scheme>
+void BM_AeadOpen(benchmark::State &state) {
+  StatusOr<std::unique_ptr<AeadCryptor>> cryptor_result = CreateCryptor(scheme);
+  if (!cryptor_result.ok()) {
+    state.SkipWithError("Failed to create cryptor");
+    return;
+  }
+  AeadCryptor *cryptor = cryptor_result.ValueOrDie().get();
+  std::vector<uint8_t> plaintext(state.range(0), 'a');
+  std::vector<uint8_t> nonce(cryptor->NonceSize());
+  std::vector<uint8_t> ciphertext(plaintext.size() +
+                                  cryptor->MaxSealOverhead());
+  size_t ciphertext_size;
+  if (!cryptor
+           ->Seal(plaintext, /*associated_data=*/"", absl::MakeSpan(nonce),
+                  absl::MakeSpan(ciphertext), &ciphertext_size)
+           .ok()) {
+    state.SkipWithError("Seal failed");
+    return;
+  }
+  ciphertext.resize(ciphertext_size);
+  size_t plaintext_size;
+  for (auto _ : state) {
+    if (!cryptor
+             ->Open(ciphertext, /*associated_data=*/"", nonce,
+                    absl::MakeSpan(plaintext), &plaintext_size)
+             .ok()) {
+      state.SkipWithError("Open failed");
+      break;
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_TEMPLATE(BM_AeadOpen, AeadScheme::AES256_GCM)
+    ->RangeMultiplier(16)
+    ->Range(kMinMessageSize, kMaxMessageSize);
+BENCHMARK_TEMPLATE(BM_AeadOpen, AeadScheme::AES256_GCM_SIV)
+    ->RangeMultiplier(16)
+    ->Range(kMinMessageSize, kMaxMessageSize);
+
+void BM_EcdsaP256Sign(benchmark::State &state) {
+  StatusOr<std::unique_ptr<EcdsaP256Sha256SigningKey>> key_result =
+      EcdsaP256Sha256SigningKey::Create();
+  if (!key_result.ok()) {
+    state.SkipWithError("Failed to create signing key");
+    return;
+  }
+  const std::vector<uint8_t> message(kAsymmetricMessageSize, 'a');
+  std::vector<uint8_t> signature;
+  for (auto _ : state) {
+    if (!key_result.ValueOrDie()->Sign(message, &signature).ok()) {
+      state.SkipWithError("Sign failed");
+      break;
+    }
+  }
+}
+BENCHMARK(BM_EcdsaP256Sign);
+
+void BM_EcdsaP256Verify(benchmark::State &state) {
+  StatusOr<std::unique_ptr<EcdsaP256Sha256SigningKey>> key_result =
+      EcdsaP256Sha256SigningKey::Create();
+  if (!key_result.ok()) {
+    state.SkipWithError("Failed to create signing key");
+    return;
+  }
+  StatusOr<std::unique_ptr<VerifyingKey>> verifying_key_result =
+      key_result.ValueOrDie()->GetVerifyingKey();
+  const std::vector<uint8_t> message(kAsymmetricMessageSize, 'a');
+  std::vector<uint8_t> signature;
+  if (!verifying_key_result.ok() ||
+      !key_result.ValueOrDie()->Sign(message, &signature).ok()) {
+    state.SkipWithError("Failed to create signature");
+    return;
+  }
+  for (auto _ : state) {
+    if (!verifying_key_result.ValueOrDie()->Verify(message, signature).ok()) {
+      state.SkipWithError("Verify failed");
+      break;
+    }
+  }
+}
+BENCHMARK(BM_EcdsaP256Verify);
+
+void BM_RsaOaepEncrypt(benchmark::State &state) {
+  StatusOr<std::unique_ptr<RsaOaepDecryptionKey>> key_result =
+      RsaOaepDecryptionKey::CreateRsa3072OaepDecryptionKey(
+          HashAlgorithm::SHA256);
+  if (!key_result.ok()) {
+    state.SkipWithError("Failed to create decryption key");
+    return;
+  }
+  StatusOr<std::unique_ptr<AsymmetricEncryptionKey>> encryption_key_result =
+      key_result.ValueOrDie()->GetEncryptionKey();
+  if (!encryption_key_result.ok()) {
+    state.SkipWithError("Failed to get encryption key");
+    return;
+  }
+  const std::vector<uint8_t> plaintext(kAsymmetricMessageSize, 'a');
+  std::vector<uint8_t> ciphertext;
+  for (auto _ : state) {
+    if (!encryption_key_result.ValueOrDie()
+             ->Encrypt(plaintext, &ciphertext)
+             .ok()) {
+      state.SkipWithError("Encrypt failed");
+      break;
+    }
+  }
+}
+BENCHMARK(BM_RsaOaepEncrypt);
+
+void BM_RsaOaepDecrypt(benchmark::State &state) {
+  StatusOr<std::unique_ptr<RsaOaepDecryptionKey>> key_result =
+      RsaOaepDecryptionKey::CreateRsa3072OaepDecryptionKey(
+          HashAlgorithm::SHA256);
+  if (!key_result.ok()) {
+    state.SkipWithError("Failed to create decryption key");
+    return;
+  }
+  StatusOr<std::unique_ptr<AsymmetricEncryptionKey>> encryption_key_result =
+      key_result.ValueOrDie()->GetEncryptionKey();
+  const std::vector<uint8_t> plaintext(kAsymmetricMessageSize, 'a');
+  std::vector<uint8_t> ciphertext;
+  if (!encryption_key_result.ok() || !encryption_key_result.ValueOrDie()
+                                          ->Encrypt(plaintext, &ciphertext)
+                                          .ok()) {
+    state.SkipWithError("Failed to create ciphertext");
+    return;
+  }
+  CleansingVector<uint8_t> decrypted;
+  for (auto _ : state) {
+    if (!key_result.ValueOrDie()->Decrypt(ciphertext, &decrypted).ok()) {
+      state.SkipWithError("Decrypt failed");
+      break;
+    }
+  }
+}
+BENCHMARK(BM_RsaOaepDecrypt);
+
+// Measures verifying a chain of three ECDSA P-256 X.509 certificates.
+void BM_X509ChainVerify(benchmark::State &state) {
+  StatusOr<CertificateInterfaceVector> chain_result = CreateCertificateChain();
+  if (!chain_result.ok()) {
+    state.SkipWithError("Failed to create certificate chain");
+    return;
+  }
+  const VerificationConfig config(/*all_fields=*/true);
+  for (auto _ : state) {
+    if (!VerifyCertificateChain(chain_result.ValueOrDie(), config).ok()) {
+      state.SkipWithError("Chain verification failed");
+      break;
+    }
+  }
+}
+BENCHMARK(BM_X509ChainVerify);
+
+// Measures hashing a message of state.range(0) bytes.
+void BM_Sha256Hash(benchmark::State &state) {
+  const std::vector<uint8_t> message(state.range(0), 'a');
+  Sha256Hash hash;
+  std::vector<uint8_t> digest;
+  for (auto _ : state) {
+    hash.Init();
+    hash.Update(message);
+    if (!hash.CumulativeHash(&digest).ok()) {
+      state.SkipWithError("Hash failed");
+      break;
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Sha256Hash)
+    ->RangeMultiplier(16)
+    ->Range(kMinMessageSize, kMaxMessageSize);
+
+// Measures parsing the DER of an X.509 certificate into an Asn1Value, which
+// copies it into a BoringSSL ASN1_TYPE.
+void BM_Asn1ValueParse(benchmark::State &state) {
+  const std::string der = CertificateDer();
+  if (der.empty()) {
+    state.SkipWithError("Failed to create certificate");
+    return;
+  }
+  for (auto _ : state) {
+    if (!Asn1Value::CreateFromDer(der).ok()) {
+      state.SkipWithError("Parse failed");
+      break;
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * der.size());
+}
+BENCHMARK(BM_Asn1ValueParse);
+
+// Measures parsing the DER of an X.509 certificate into an Asn1View and
+// walking its top-level sequence without copying.
+void BM_Asn1ViewParse(benchmark::State &state) {
+  const std::string der = CertificateDer();
+  if (der.empty()) {
+    state.SkipWithError("Failed to create certificate");
+    return;
+  }
+  for (auto _ : state) {
+    StatusOr<Asn1View> view_result = Asn1View::Create(der);
+    if (!view_result.ok() || !view_result.ValueOrDie().GetSequence().ok()) {
+      state.SkipWithError("Parse failed");
+      break;
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * der.size());
+}
+BENCHMARK(BM_Asn1ViewParse);
+
+}  // namespace
+}  // namespace asylo
@@ -39,6 +39,7 @@
 #include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
+#include "absl/types/span.h"
 #include "asylo/crypto/algorithms.pb.h"
 #include "asylo/crypto/bignum_util.h"
 #include "asylo/crypto/keys.pb.h"
@@ -46,6 +47,7 @@
 #include "asylo/crypto/signing_key.h"
 #include "asylo/crypto/util/bssl_util.h"
 #include "asylo/crypto/util/byte_container_view.h"
+#include "asylo/crypto/util/bytes.h"
 #include "asylo/util/proto_enum_util.h"
 #include "asylo/util/status.h"
 #include "asylo/util/status_macros.h"
@@ -72,10 +74,10 @@ StatusOr<bssl::UniquePtr<EC_KEY>> CreatePublicKeyFromPrivateKey(
 }
 
 Status DoSha256Hash(ByteContainerView message, std::vector<uint8_t> *digest) {
-  Sha256Hash hasher;
-  hasher.Init();
-  hasher.Update(message);
-  return hasher.CumulativeHash(digest);
+  UnsafeBytes<kSha256DigestLength> sha256;
+  Sha256Hash::Digest(message, &sha256);
+  digest->assign(sha256.begin(), sha256.end());
+  return Status::OkStatus();
 }
 
 Status CheckKeyProtoValues(const AsymmetricSigningKeyProto &key_proto,
@@ -314,6 +316,37 @@ Status EcdsaP256Sha256VerifyingKey::Verify(ByteContainerView message,
   return Status::OkStatus();
 }
 
+template <typename SignatureT>
+StatusOr<std::vector<Status>> EcdsaP256Sha256VerifyingKey::VerifyEach(
+    absl::Span<const ByteContainerView> messages,
+    absl::Span<const SignatureT> signatures) const {
+  if (messages.size() != signatures.size()) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  absl::StrCat("Batch has ", messages.size(),
+                               " messages but ", signatures.size(),
+                               " signatures"));
+  }
+
+  std::vector<Status> results;
+  results.reserve(signatures.size());
+  for (size_t i = 0; i < signatures.size(); ++i) {
+    results.push_back(Verify(messages[i], signatures[i]));
+  }
+  return results;
+}
+
+StatusOr<std::vector<Status>> EcdsaP256Sha256VerifyingKey::VerifyBatch(
+    absl::Span<const ByteContainerView> messages,
+    absl::Span<const ByteContainerView> signatures) const {
+  return VerifyEach(messages, signatures);
+}
+
+StatusOr<std::vector<Status>> EcdsaP256Sha256VerifyingKey::VerifyBatch(
+    absl::Span<const ByteContainerView> messages,
+    absl::Span<const Signature> signatures) const {
+  return VerifyEach(messages, signatures);
+}
+
 EcdsaP256Sha256VerifyingKey::EcdsaP256Sha256VerifyingKey(
     bssl::UniquePtr<EC_KEY> public_key)
     : public_key_(std::move(public_key)) {}
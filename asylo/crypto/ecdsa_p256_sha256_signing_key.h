@@ -25,11 +25,14 @@
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <vector>
 
+#include "absl/types/span.h"
 #include "asylo/crypto/keys.pb.h"
 #include "asylo/crypto/signing_key.h"
 #include "asylo/crypto/util/byte_container_view.h"
 #include "asylo/crypto/util/bytes.h"
+#include "asylo/util/status.h"
 #include "asylo/util/statusor.h"
 
 namespace asylo {
@@ -84,9 +87,29 @@ class EcdsaP256Sha256VerifyingKey : public VerifyingKey {
   Status Verify(ByteContainerView message,
                 const Signature &signature) const override;
 
+  // Verifies each of |signatures| over the message at the same index in
+  // |messages|. Returns one Status per signature, which is the result Verify()
+  // would give for that pair, so that a single bad signature does not hide the
+  // result of the others. Returns an error if |messages| and |signatures|
+  // differ in size.
+  StatusOr<std::vector<Status>> VerifyBatch(
+      absl::Span<const ByteContainerView> messages,
+      absl::Span<const ByteContainerView> signatures) const;
+
+  // As above, for signatures given as Signature messages.
+  StatusOr<std::vector<Status>> VerifyBatch(
+      absl::Span<const ByteContainerView> messages,
+      absl::Span<const Signature> signatures) const;
+
  private:
   explicit EcdsaP256Sha256VerifyingKey(bssl::UniquePtr<EC_KEY> public_key);
 
+  // Shared implementation of the VerifyBatch() overloads.
+  template <typename SignatureT>
+  StatusOr<std::vector<Status>> VerifyEach(
+      absl::Span<const ByteContainerView> messages,
+      absl::Span<const SignatureT> signatures) const;
+
   // An ECDSA P256 public key.
   bssl::UniquePtr<EC_KEY> public_key_;
 };
@@ -427,6 +427,68 @@ TEST_P(EcdsaP256Sha256VerifyingKeyTest, VerifySignatureOverloadSuccess) {
                                         signature));
 }
 
+// Verify that VerifyBatch() reports a result for each signature, so that a bad
+// signature does not affect the others.
+TEST_P(EcdsaP256Sha256VerifyingKeyTest, VerifyBatchReportsEachSignature) {
+  std::unique_ptr<EcdsaP256Sha256VerifyingKey> verifying_key;
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      verifying_key,
+      EcdsaP256Sha256VerifyingKey::CreateFromPem(kTestVerifyingKeyPem));
+
+  std::string message(absl::HexStringToBytes(kTestMessageHex));
+  std::string valid_signature(absl::HexStringToBytes(kTestSignatureHex));
+  std::string invalid_signature(absl::HexStringToBytes(kInvalidSignatureHex));
+  std::vector<ByteContainerView> messages = {message, message, message};
+  std::vector<ByteContainerView> signatures = {
+      valid_signature, invalid_signature, valid_signature};
+
+  std::vector<Status> results;
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      results, verifying_key->VerifyBatch(messages, signatures));
+  ASSERT_EQ(results.size(), 3);
+  ASYLO_EXPECT_OK(results[0]);
+  EXPECT_THAT(results[1], Not(IsOk()));
+  ASYLO_EXPECT_OK(results[2]);
+}
+
+// Verify that the Signature overload of VerifyBatch() reports the same errors
+// as Verify().
+TEST_P(EcdsaP256Sha256VerifyingKeyTest, VerifyBatchSignatureOverload) {
+  std::unique_ptr<EcdsaP256Sha256VerifyingKey> verifying_key;
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      verifying_key,
+      EcdsaP256Sha256VerifyingKey::CreateFromPem(kTestVerifyingKeyPem));
+
+  std::string message(absl::HexStringToBytes(kTestMessageHex));
+  std::vector<Signature> signatures(2, CreateValidSignatureForTestMessage());
+  signatures[0].set_signature_scheme(UNKNOWN_SIGNATURE_SCHEME);
+  std::vector<ByteContainerView> messages = {message, message};
+
+  std::vector<Status> results;
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      results, verifying_key->VerifyBatch(messages, signatures));
+  ASSERT_EQ(results.size(), 2);
+  EXPECT_THAT(results[0], StatusIs(error::GoogleError::INVALID_ARGUMENT));
+  ASYLO_EXPECT_OK(results[1]);
+}
+
+// Verify that VerifyBatch() fails if the messages and signatures do not pair
+// up.
+TEST_P(EcdsaP256Sha256VerifyingKeyTest, VerifyBatchWithMismatchedSizesFails) {
+  std::unique_ptr<EcdsaP256Sha256VerifyingKey> verifying_key;
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      verifying_key,
+      EcdsaP256Sha256VerifyingKey::CreateFromPem(kTestVerifyingKeyPem));
+
+  std::string message(absl::HexStringToBytes(kTestMessageHex));
+  std::string signature(absl::HexStringToBytes(kTestSignatureHex));
+  std::vector<ByteContainerView> messages = {message, message};
+  std::vector<ByteContainerView> signatures = {signature};
+
+  EXPECT_THAT(verifying_key->VerifyBatch(messages, signatures),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+}
+
 // Verify that operator== fails with a different VerifyingKey implementation.
 TEST_P(EcdsaP256Sha256VerifyingKeyTest, EqualsFailsWithDifferentClassKeys) {
   FakeVerifyingKey other_verifying_key(ECDSA_P256_SHA256, kTestVerifyingKeyDer);
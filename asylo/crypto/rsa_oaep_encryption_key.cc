@@ -28,6 +28,7 @@
 
 #include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
 #include "asylo/crypto/algorithms.pb.h"
 #include "asylo/crypto/asymmetric_encryption_key.h"
 #include "asylo/crypto/util/bssl_util.h"
@@ -93,6 +94,37 @@ Status CheckEncryptionScheme(AsymmetricEncryptionScheme scheme) {
       absl::StrCat("Invalid encryption scheme: ", ProtoEnumValueName(scheme)));
 }
 
+StatusOr<const EVP_MD *> GetBoringSslHash(HashAlgorithm hash_alg) {
+  switch (hash_alg) {
+    case HashAlgorithm::SHA_1:
+      return EVP_sha1();
+    case HashAlgorithm::SHA224:
+      return EVP_sha224();
+    case HashAlgorithm::SHA256:
+      return EVP_sha256();
+    case HashAlgorithm::SHA384:
+      return EVP_sha384();
+    case HashAlgorithm::SHA512:
+      return EVP_sha512();
+    case HashAlgorithm::UNKNOWN_HASH_ALGORITHM:
+      break;
+  }
+
+  return Status(
+      error::GoogleError::INVALID_ARGUMENT,
+      absl::StrCat("Invalid hash algorithm in RSA key object: ", hash_alg));
+}
+
+// Wraps |rsa| in an EVP key, which shares |rsa| and the Montgomery contexts
+// BoringSSL caches in it.
+StatusOr<bssl::UniquePtr<EVP_PKEY>> CreateEvpKey(RSA *rsa) {
+  bssl::UniquePtr<EVP_PKEY> evp_key(EVP_PKEY_new());
+  if (!evp_key || EVP_PKEY_set1_RSA(evp_key.get(), rsa) != 1) {
+    return Status(error::GoogleError::INTERNAL, BsslLastErrorString());
+  }
+  return std::move(evp_key);
+}
+
 // Defines a functor which performs RSA crypto with OAEP.
 class RsaOaepOperation {
  public:
@@ -106,21 +138,42 @@ class RsaOaepOperation {
   using InitFunc = decltype(&EVP_PKEY_encrypt_init);
   using CryptoFunc = decltype(&EVP_PKEY_encrypt);
 
-  // Performs an BoringSSL EVP key crypto operation using an BoringSSL RSA
-  // object.
+  // Performs an BoringSSL EVP key crypto operation with |evp_key| on each of
+  // |inputs|, writing the results to the corresponding elements of |outputs|.
+  // The OAEP context is set up once for all the inputs.
+  template <typename AllocatorT>
+  Status operator()(EVP_PKEY *evp_key, const EVP_MD *md,
+                    absl::Span<const ByteContainerView> inputs,
+                    std::vector<std::vector<uint8_t, AllocatorT>> *outputs)
+      const {
+    bssl::UniquePtr<EVP_PKEY_CTX> ctx;
+    ASYLO_ASSIGN_OR_RETURN(ctx, CreateContext(evp_key, md));
+
+    outputs->resize(inputs.size());
+    for (size_t i = 0; i < inputs.size(); ++i) {
+      ASYLO_RETURN_IF_ERROR(Run(ctx.get(), inputs[i], &(*outputs)[i]));
+    }
+    return Status::OkStatus();
+  }
+
+  // Performs an BoringSSL EVP key crypto operation with |evp_key| on |input|.
   template <typename AllocatorT>
-  Status operator()(RSA *rsa, HashAlgorithm hash_alg, ByteContainerView input,
+  Status operator()(EVP_PKEY *evp_key, const EVP_MD *md,
+                    ByteContainerView input,
                     std::vector<uint8_t, AllocatorT> *output) const {
-    const EVP_MD *md;
-    ASYLO_ASSIGN_OR_RETURN(md, GetBoringSslHash(hash_alg));
+    bssl::UniquePtr<EVP_PKEY_CTX> ctx;
+    ASYLO_ASSIGN_OR_RETURN(ctx, CreateContext(evp_key, md));
+    return Run(ctx.get(), input, output);
+  }
 
-    bssl::UniquePtr<EVP_PKEY> evp_key(EVP_PKEY_new());
-    if (EVP_PKEY_set1_RSA(evp_key.get(), rsa) != 1) {
-      return Status(error::GoogleError::INTERNAL, BsslLastErrorString());
-    }
+ private:
+  InitFunc init_func_;
+  CryptoFunc crypto_func_;
 
+  StatusOr<bssl::UniquePtr<EVP_PKEY_CTX>> CreateContext(
+      EVP_PKEY *evp_key, const EVP_MD *md) const {
     bssl::UniquePtr<EVP_PKEY_CTX> ctx(
-        EVP_PKEY_CTX_new(evp_key.get(), /*ENGINE e=*/nullptr));
+        EVP_PKEY_CTX_new(evp_key, /*ENGINE e=*/nullptr));
     if (ctx == nullptr) {
       return Status(error::GoogleError::INTERNAL, BsslLastErrorString());
     }
@@ -134,15 +187,20 @@ class RsaOaepOperation {
     if (EVP_PKEY_CTX_set_rsa_oaep_md(ctx.get(), md) != 1) {
       return Status(error::GoogleError::INTERNAL, BsslLastErrorString());
     }
+    return std::move(ctx);
+  }
 
+  template <typename AllocatorT>
+  Status Run(EVP_PKEY_CTX *ctx, ByteContainerView input,
+             std::vector<uint8_t, AllocatorT> *output) const {
     size_t out_len = 0;
-    if (crypto_func_(ctx.get(), /*out=*/nullptr, &out_len, input.data(),
+    if (crypto_func_(ctx, /*out=*/nullptr, &out_len, input.data(),
                      input.size()) != 1) {
       return Status(error::GoogleError::INTERNAL, BsslLastErrorString());
     }
 
     output->resize(out_len);
-    if (crypto_func_(ctx.get(), output->data(), &out_len, input.data(),
+    if (crypto_func_(ctx, output->data(), &out_len, input.data(),
                      input.size()) != 1) {
       return Status(error::GoogleError::INTERNAL, BsslLastErrorString());
     }
@@ -150,31 +208,6 @@ class RsaOaepOperation {
     return Status::OkStatus();
   }
 
- private:
-  InitFunc init_func_;
-  CryptoFunc crypto_func_;
-
-  static StatusOr<const EVP_MD *> GetBoringSslHash(HashAlgorithm hash_alg) {
-    switch (hash_alg) {
-      case HashAlgorithm::SHA_1:
-        return EVP_sha1();
-      case HashAlgorithm::SHA224:
-        return EVP_sha224();
-      case HashAlgorithm::SHA256:
-        return EVP_sha256();
-      case HashAlgorithm::SHA384:
-        return EVP_sha384();
-      case HashAlgorithm::SHA512:
-        return EVP_sha512();
-      case HashAlgorithm::UNKNOWN_HASH_ALGORITHM:
-        break;
-    }
-
-    return Status(
-        error::GoogleError::INVALID_ARGUMENT,
-        absl::StrCat("Invalid hash algorithm in RSA key object: ", hash_alg));
-  }
-
   RsaOaepOperation(InitFunc init_func, CryptoFunc crypto_func)
       : init_func_(init_func), crypto_func_(crypto_func) {}
 };
@@ -270,8 +303,12 @@ StatusOr<std::unique_ptr<RsaOaepEncryptionKey>> RsaOaepEncryptionKey::Create(
                   "Public key is invalid");
   }
 
-  return absl::WrapUnique<RsaOaepEncryptionKey>(
-      new RsaOaepEncryptionKey(std::move(public_key), hash_alg));
+  bssl::UniquePtr<EVP_PKEY> evp_key;
+  ASYLO_ASSIGN_OR_RETURN(evp_key, CreateEvpKey(public_key.get()));
+  const EVP_MD *md;
+  ASYLO_ASSIGN_OR_RETURN(md, GetBoringSslHash(hash_alg));
+  return absl::WrapUnique<RsaOaepEncryptionKey>(new RsaOaepEncryptionKey(
+      std::move(public_key), std::move(evp_key), md, hash_alg));
 }
 
 const RSA *RsaOaepEncryptionKey::GetRsaPublicKey() const {
@@ -294,21 +331,32 @@ StatusOr<std::string> RsaOaepEncryptionKey::SerializeToDer() const {
 
 Status RsaOaepEncryptionKey::Encrypt(ByteContainerView plaintext,
                                      std::vector<uint8_t> *ciphertext) const {
-  return RsaOaepOperation::kEncrypt(public_key_.get(), hash_alg_, plaintext,
+  return RsaOaepOperation::kEncrypt(evp_key_.get(), md_, plaintext,
                                     ciphertext);
 }
 
+Status RsaOaepEncryptionKey::EncryptMany(
+    absl::Span<const ByteContainerView> plaintexts,
+    std::vector<std::vector<uint8_t>> *ciphertexts) const {
+  return RsaOaepOperation::kEncrypt(evp_key_.get(), md_, plaintexts,
+                                    ciphertexts);
+}
+
 RsaOaepEncryptionKey::RsaOaepEncryptionKey(bssl::UniquePtr<RSA> public_key,
+                                           bssl::UniquePtr<EVP_PKEY> evp_key,
+                                           const EVP_MD *md,
                                            HashAlgorithm hash_alg)
-    : public_key_(std::move(public_key)), hash_alg_(hash_alg) {}
+    : public_key_(std::move(public_key)),
+      evp_key_(std::move(evp_key)),
+      md_(md),
+      hash_alg_(hash_alg) {}
 
 StatusOr<std::unique_ptr<RsaOaepDecryptionKey>>
 RsaOaepDecryptionKey::CreateRsa3072OaepDecryptionKey(HashAlgorithm hash_alg) {
   ASYLO_RETURN_IF_ERROR(CheckHashAlgorithm(hash_alg));
-  bssl::UniquePtr<RSA> private_key(RSA_new());
+  bssl::UniquePtr<RSA> private_key;
   ASYLO_ASSIGN_OR_RETURN(private_key, CreateRsaKey(/*number_of_bits=*/3072));
-  return absl::WrapUnique<RsaOaepDecryptionKey>(
-      new RsaOaepDecryptionKey(std::move(private_key), hash_alg));
+  return Create(std::move(private_key), hash_alg);
 }
 
 StatusOr<std::unique_ptr<RsaOaepDecryptionKey>>
@@ -323,8 +371,7 @@ RsaOaepDecryptionKey::CreateFromDer(ByteContainerView serialized_key,
   }
   ASYLO_RETURN_IF_ERROR(CheckKeySize(RSA_bits(private_key.get())));
 
-  return absl::WrapUnique<RsaOaepDecryptionKey>(
-      new RsaOaepDecryptionKey(std::move(private_key), hash_alg));
+  return Create(std::move(private_key), hash_alg);
 }
 
 AsymmetricEncryptionScheme RsaOaepDecryptionKey::GetEncryptionScheme() const {
@@ -354,12 +401,34 @@ RsaOaepDecryptionKey::GetEncryptionKey() const {
 
 Status RsaOaepDecryptionKey::Decrypt(
     ByteContainerView ciphertext, CleansingVector<uint8_t> *plaintext) const {
-  return RsaOaepOperation::kDecrypt(private_key_.get(), hash_alg_, ciphertext,
+  return RsaOaepOperation::kDecrypt(evp_key_.get(), md_, ciphertext,
                                     plaintext);
 }
 
+Status RsaOaepDecryptionKey::DecryptMany(
+    absl::Span<const ByteContainerView> ciphertexts,
+    std::vector<CleansingVector<uint8_t>> *plaintexts) const {
+  return RsaOaepOperation::kDecrypt(evp_key_.get(), md_, ciphertexts,
+                                    plaintexts);
+}
+
+StatusOr<std::unique_ptr<RsaOaepDecryptionKey>> RsaOaepDecryptionKey::Create(
+    bssl::UniquePtr<RSA> private_key, HashAlgorithm hash_alg) {
+  bssl::UniquePtr<EVP_PKEY> evp_key;
+  ASYLO_ASSIGN_OR_RETURN(evp_key, CreateEvpKey(private_key.get()));
+  const EVP_MD *md;
+  ASYLO_ASSIGN_OR_RETURN(md, GetBoringSslHash(hash_alg));
+  return absl::WrapUnique<RsaOaepDecryptionKey>(new RsaOaepDecryptionKey(
+      std::move(private_key), std::move(evp_key), md, hash_alg));
+}
+
 RsaOaepDecryptionKey::RsaOaepDecryptionKey(bssl::UniquePtr<RSA> private_key,
+                                           bssl::UniquePtr<EVP_PKEY> evp_key,
+                                           const EVP_MD *md,
                                            HashAlgorithm hash_alg)
-    : private_key_(std::move(private_key)), hash_alg_(hash_alg) {}
+    : private_key_(std::move(private_key)),
+      evp_key_(std::move(evp_key)),
+      md_(md),
+      hash_alg_(hash_alg) {}
 
 }  // namespace asylo
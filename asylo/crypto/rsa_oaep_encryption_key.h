@@ -20,6 +20,7 @@
 #define ASYLO_CRYPTO_RSA_OAEP_ENCRYPTION_KEY_H_
 
 #include <openssl/base.h>
+#include <openssl/evp.h>
 #include <openssl/rsa.h>
 
 #include <cstdint>
@@ -27,6 +28,7 @@
 #include <string>
 #include <vector>
 
+#include "absl/types/span.h"
 #include "asylo/crypto/algorithms.pb.h"
 #include "asylo/crypto/asymmetric_encryption_key.h"
 #include "asylo/crypto/util/byte_container_view.h"
@@ -50,6 +52,11 @@ namespace asylo {
 // For example, consider OAEP with SHA-1 which produces a digest size of 20
 // bytes. An RsaOaepEncryptionKey with a 3072-bit key can encrypt a message that
 // has maximum size 384 - 2 * 20 - 2 = 342 bytes.
+//
+// The BoringSSL key and OAEP hash are set up once, when the key is created,
+// and BoringSSL caches the Montgomery context of the modulus in the key after
+// its first use. Callers encrypting repeatedly should therefore keep the key
+// object instead of recreating it. RsaOaepEncryptionKey is thread-safe.
 class RsaOaepEncryptionKey : public AsymmetricEncryptionKey {
  public:
   // Creates an RSA encryption key from the given DER-encoded
@@ -83,18 +90,33 @@ class RsaOaepEncryptionKey : public AsymmetricEncryptionKey {
   Status Encrypt(ByteContainerView plaintext,
                  std::vector<uint8_t> *ciphertext) const override;
 
+  // Encrypts each of |plaintexts| into the corresponding element of
+  // |ciphertexts|. Equivalent to calling Encrypt() on each plaintext, but sets
+  // up the OAEP context only once for the whole batch.
+  Status EncryptMany(absl::Span<const ByteContainerView> plaintexts,
+                     std::vector<std::vector<uint8_t>> *ciphertexts) const;
+
  private:
-  RsaOaepEncryptionKey(bssl::UniquePtr<RSA> public_key, HashAlgorithm hash_alg);
+  RsaOaepEncryptionKey(bssl::UniquePtr<RSA> public_key,
+                       bssl::UniquePtr<EVP_PKEY> evp_key, const EVP_MD *md,
+                       HashAlgorithm hash_alg);
 
   // An RSA public key.
   bssl::UniquePtr<RSA> public_key_;
 
+  // |public_key_| wrapped for the EVP interface.
+  bssl::UniquePtr<EVP_PKEY> evp_key_;
+
+  // The digest used by OAEP, which corresponds to |hash_alg_|.
+  const EVP_MD *md_;
+
   // The hash algorithm to use with the OAEP algorithm.
   HashAlgorithm hash_alg_;
 };
 
 // An implementation of the AsymmetricDecryptionKey interface that uses RSA-OAEP
-// for message decryption.
+// for message decryption. As with RsaOaepEncryptionKey, the BoringSSL key is
+// set up once per key object, and RsaOaepDecryptionKey is thread-safe.
 class RsaOaepDecryptionKey : public AsymmetricDecryptionKey {
  public:
   // Creates a random RSA-3072 decryption key. The public exponent is always set
@@ -120,13 +142,29 @@ class RsaOaepDecryptionKey : public AsymmetricDecryptionKey {
   Status Decrypt(ByteContainerView ciphertext,
                  CleansingVector<uint8_t> *plaintext) const override;
 
+  // Decrypts each of |ciphertexts| into the corresponding element of
+  // |plaintexts|. Equivalent to calling Decrypt() on each ciphertext, but sets
+  // up the OAEP context only once for the whole batch.
+  Status DecryptMany(absl::Span<const ByteContainerView> ciphertexts,
+                     std::vector<CleansingVector<uint8_t>> *plaintexts) const;
+
  private:
+  static StatusOr<std::unique_ptr<RsaOaepDecryptionKey>> Create(
+      bssl::UniquePtr<RSA> private_key, HashAlgorithm hash_alg);
+
   RsaOaepDecryptionKey(bssl::UniquePtr<RSA> private_key,
+                       bssl::UniquePtr<EVP_PKEY> evp_key, const EVP_MD *md,
                        HashAlgorithm hash_alg);
 
   // An RSA private key.
   bssl::UniquePtr<RSA> private_key_;
 
+  // |private_key_| wrapped for the EVP interface.
+  bssl::UniquePtr<EVP_PKEY> evp_key_;
+
+  // The digest used by OAEP, which corresponds to |hash_alg_|.
+  const EVP_MD *md_;
+
   // The hash algorithm to use with the OAEP algorithm.
   HashAlgorithm hash_alg_;
 };
@@ -25,6 +25,7 @@
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <thread>
 #include <type_traits>
 #include <vector>
 
@@ -36,6 +37,7 @@
 #include "asylo/crypto/keys.pb.h"
 #include "asylo/crypto/util/bssl_util.h"
 #include "asylo/crypto/util/byte_container_util.h"
+#include "asylo/crypto/util/byte_container_view.h"
 #include "asylo/test/util/status_matchers.h"
 #include "asylo/util/cleansing_types.h"
 #include "asylo/util/proto_parse_util.h"
@@ -49,6 +51,7 @@ using ::testing::ElementsAreArray;
 using ::testing::Eq;
 using ::testing::HasSubstr;
 using ::testing::IsTrue;
+using ::testing::Not;
 using ::testing::NotNull;
 using ::testing::Test;
 
@@ -366,6 +369,80 @@ TEST(RsaOaepEncryptionKeyTest, DecryptInvalidInputFails) {
               StatusIs(error::GoogleError::INTERNAL));
 }
 
+TEST(RsaOaepEncryptionKeyTest, EncryptManyDecryptManySuccess) {
+  std::unique_ptr<RsaOaepDecryptionKey> decryption_key;
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      decryption_key, CreateDecryptionKeyFromTestDer(HashAlgorithm::SHA256));
+  std::unique_ptr<RsaOaepEncryptionKey> encryption_key;
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      encryption_key, RsaOaepEncryptionKey::CreateFromPem(
+                          kRsa3072PublicKeyPem, HashAlgorithm::SHA256));
+
+  const std::vector<std::string> messages = {kPlaintext, "", "another"};
+  std::vector<ByteContainerView> plaintexts(messages.begin(), messages.end());
+  std::vector<std::vector<uint8_t>> ciphertexts;
+  ASYLO_ASSERT_OK(encryption_key->EncryptMany(plaintexts, &ciphertexts));
+  ASSERT_THAT(ciphertexts.size(), Eq(messages.size()));
+
+  // OAEP is randomized, so encrypting a message twice gives two ciphertexts.
+  std::vector<uint8_t> ciphertext;
+  ASYLO_ASSERT_OK(encryption_key->Encrypt(kPlaintext, &ciphertext));
+  EXPECT_THAT(ciphertext, Not(Eq(ciphertexts[0])));
+  ciphertexts.push_back(ciphertext);
+
+  std::vector<ByteContainerView> ciphertext_views(ciphertexts.begin(),
+                                                  ciphertexts.end());
+  std::vector<CleansingVector<uint8_t>> decrypted;
+  ASYLO_ASSERT_OK(decryption_key->DecryptMany(ciphertext_views, &decrypted));
+  ASSERT_THAT(decrypted.size(), Eq(ciphertexts.size()));
+  for (size_t i = 0; i < messages.size(); ++i) {
+    EXPECT_THAT(CopyToByteContainer<std::string>(
+                    {decrypted[i].data(), decrypted[i].size()}),
+                Eq(messages[i]));
+  }
+  EXPECT_THAT(CopyToByteContainer<std::string>(
+                  {decrypted.back().data(), decrypted.back().size()}),
+              Eq(kPlaintext));
+}
+
+TEST(RsaOaepEncryptionKeyTest, DecryptManyFailsOnAnyInvalidInput) {
+  std::unique_ptr<RsaOaepDecryptionKey> decryption_key;
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      decryption_key, CreateDecryptionKeyFromTestDer(HashAlgorithm::SHA256));
+  std::unique_ptr<AsymmetricEncryptionKey> encryption_key;
+  ASYLO_ASSERT_OK_AND_ASSIGN(encryption_key,
+                             decryption_key->GetEncryptionKey());
+
+  std::vector<uint8_t> valid;
+  ASYLO_ASSERT_OK(encryption_key->Encrypt(kPlaintext, &valid));
+  std::vector<uint8_t> invalid = valid;
+  invalid[0] ^= 1;
+
+  std::vector<CleansingVector<uint8_t>> plaintexts;
+  EXPECT_THAT(decryption_key->DecryptMany({valid, invalid}, &plaintexts),
+              StatusIs(error::GoogleError::INTERNAL));
+}
+
+TEST(RsaOaepEncryptionKeyTest, KeysAreUsableFromSeveralThreads) {
+  std::unique_ptr<RsaOaepDecryptionKey> decryption_key;
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      decryption_key, CreateDecryptionKeyFromTestDer(HashAlgorithm::SHA256));
+  std::unique_ptr<AsymmetricEncryptionKey> encryption_key;
+  ASYLO_ASSERT_OK_AND_ASSIGN(encryption_key,
+                             decryption_key->GetEncryptionKey());
+
+  constexpr int kNumThreads = 4;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back([&encryption_key, &decryption_key] {
+      VerifyEncryptionDecryptionSuccess(*encryption_key, *decryption_key);
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+}
+
 TEST(RsaOaepEncryptionKeyTest, CreateRsa3072OaepDecryptionKeySuccess) {
   std::unique_ptr<AsymmetricDecryptionKey> decryption_key;
   ASYLO_ASSERT_OK_AND_ASSIGN(
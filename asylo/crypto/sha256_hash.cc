@@ -20,13 +20,17 @@
 
 #include <openssl/base.h>
 #include <openssl/digest.h>
+#include <openssl/sha.h>
 
 #include <cstdint>
 #include <vector>
 
+#include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
 #include "asylo/crypto/sha256_hash.pb.h"
 #include "asylo/crypto/util/bssl_util.h"
 #include "asylo/crypto/util/byte_container_view.h"
+#include "asylo/crypto/util/bytes.h"
 #include "asylo/util/status_macros.h"
 #include "asylo/util/statusor.h"
 
@@ -81,4 +85,26 @@ StatusOr<Sha256HashProto> Sha256Hash::CumulativeHash() const {
   return hash_proto;
 }
 
+void Sha256Hash::Digest(ByteContainerView data,
+                        UnsafeBytes<kSha256DigestLength> *digest) {
+  // The one-shot SHA256() keeps its context on the stack and uses the fastest
+  // block function the CPU supports, such as the SHA extensions or AVX2. It is
+  // qualified to tell it apart from the HashAlgorithm enumerator.
+  ::SHA256(data.data(), data.size(), digest->data());
+}
+
+Status Sha256Hash::DigestMany(
+    absl::Span<const ByteContainerView> inputs,
+    absl::Span<UnsafeBytes<kSha256DigestLength>> digests) {
+  if (inputs.size() != digests.size()) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  absl::StrCat("Got ", inputs.size(), " inputs but ",
+                               digests.size(), " digests"));
+  }
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    Digest(inputs[i], &digests[i]);
+  }
+  return Status::OkStatus();
+}
+
 }  // namespace asylo
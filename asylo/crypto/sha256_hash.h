@@ -24,9 +24,11 @@
 #include <cstdint>
 #include <vector>
 
+#include "absl/types/span.h"
 #include "asylo/crypto/hash_interface.h"
 #include "asylo/crypto/sha256_hash.pb.h"
 #include "asylo/crypto/util/byte_container_view.h"
+#include "asylo/crypto/util/bytes.h"
 #include "asylo/util/status.h"
 #include "asylo/util/statusor.h"
 
@@ -53,6 +55,19 @@ class Sha256Hash final : public HashInterface {
 
   StatusOr<Sha256HashProto> CumulativeHash() const;
 
+  // Writes the SHA-256 digest of |data| to |digest|. This is faster than
+  // Init(), Update() and CumulativeHash() for a message which is available at
+  // once, since it neither allocates nor copies a hash context.
+  static void Digest(ByteContainerView data,
+                     UnsafeBytes<kSha256DigestLength> *digest);
+
+  // Writes the SHA-256 digest of each of |inputs| to the element of |digests|
+  // at the same index. Returns an error if |inputs| and |digests| differ in
+  // size.
+  static Status DigestMany(
+      absl::Span<const ByteContainerView> inputs,
+      absl::Span<UnsafeBytes<kSha256DigestLength>> digests);
+
  private:
   EVP_MD_CTX *context_;
 };
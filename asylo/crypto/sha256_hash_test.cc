@@ -25,10 +25,13 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include "absl/strings/escaping.h"
+#include "absl/types/span.h"
 #include "asylo/crypto/algorithms.pb.h"
 #include "asylo/crypto/sha256_hash.pb.h"
 #include "asylo/crypto/sha256_hash_util.h"
 #include "asylo/crypto/util/byte_container_util.h"
+#include "asylo/crypto/util/byte_container_view.h"
+#include "asylo/crypto/util/bytes.h"
 #include "asylo/test/util/status_matchers.h"
 
 namespace asylo {
@@ -124,5 +127,41 @@ TEST(Sha256HashTest, MultipleUpdates) {
             kResult2);
 }
 
+// Verify that the one-shot Digest() matches the standard test vectors.
+TEST(Sha256HashTest, DigestMatchesTestVectors) {
+  UnsafeBytes<kSha256DigestLength> digest;
+  Sha256Hash::Digest(kTestVector1, &digest);
+  EXPECT_EQ(absl::BytesToHexString(CopyToByteContainer<std::string>(digest)),
+            kResult1);
+
+  Sha256Hash::Digest(kTestVector2, &digest);
+  EXPECT_EQ(absl::BytesToHexString(CopyToByteContainer<std::string>(digest)),
+            kResult2);
+}
+
+TEST(Sha256HashTest, DigestManyHashesEachInput) {
+  std::vector<ByteContainerView> inputs = {kTestVector1, kTestVector2,
+                                           kTestVector1};
+  std::vector<UnsafeBytes<kSha256DigestLength>> digests(inputs.size());
+  ASYLO_ASSERT_OK(Sha256Hash::DigestMany(inputs, absl::MakeSpan(digests)));
+
+  EXPECT_EQ(
+      absl::BytesToHexString(CopyToByteContainer<std::string>(digests[0])),
+      kResult1);
+  EXPECT_EQ(
+      absl::BytesToHexString(CopyToByteContainer<std::string>(digests[1])),
+      kResult2);
+  EXPECT_EQ(
+      absl::BytesToHexString(CopyToByteContainer<std::string>(digests[2])),
+      kResult1);
+}
+
+TEST(Sha256HashTest, DigestManyWithMismatchedSizesFails) {
+  std::vector<ByteContainerView> inputs = {kTestVector1, kTestVector2};
+  std::vector<UnsafeBytes<kSha256DigestLength>> digests(1);
+  EXPECT_THAT(Sha256Hash::DigestMany(inputs, absl::MakeSpan(digests)),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+}
+
 }  // namespace
 }  // namespace asylo
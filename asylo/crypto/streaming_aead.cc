@@ -0,0 +1,227 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/crypto/streaming_aead.h"
+
+#include <openssl/digest.h>
+#include <openssl/hkdf.h>
+#include <openssl/rand.h>
+
+#include <algorithm>
+#include <memory>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "asylo/crypto/aead_cryptor.h"
+#include "asylo/crypto/algorithms.pb.h"
+#include "asylo/crypto/util/bssl_util.h"
+#include "asylo/util/cleansing_types.h"
+#include "asylo/util/status_macros.h"
+
+namespace asylo {
+namespace {
+
+// The stream header is a random salt for the key derivation followed by the
+// nonce prefix.
+constexpr size_t kSaltSize = kStreamingAeadHeaderSize -
+                             kStreamingAeadNoncePrefixSize;
+
+// Segment nonces are the nonce prefix, a 32-bit segment index and a byte
+// marking the last segment.
+constexpr size_t kSegmentNonceSize = kStreamingAeadNoncePrefixSize + 5;
+constexpr uint64_t kMaxSegments = UINT64_C(1) << 32;
+
+using SegmentNonce = std::array<uint8_t, kSegmentNonceSize>;
+
+// Derives the AES-GCM key of the stream with salt |salt| from |key| and
+// |associated_data|.
+StatusOr<std::unique_ptr<AeadKey>> DeriveStreamKey(
+    ByteContainerView key, ByteContainerView salt,
+    ByteContainerView associated_data) {
+  if (key.size() != 16 && key.size() != 32) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  absl::StrCat("Invalid AES-GCM key length: ", key.size(),
+                               " (must be 16 or 32 bytes)"));
+  }
+  CleansingVector<uint8_t> stream_key(key.size());
+  if (HKDF(stream_key.data(), stream_key.size(), EVP_sha256(), key.data(),
+           key.size(), salt.data(), salt.size(), associated_data.data(),
+           associated_data.size()) != 1) {
+    return Status(error::GoogleError::INTERNAL,
+                  absl::StrCat("HKDF failed: ", BsslLastErrorString()));
+  }
+  return AeadKey::CreateAesGcmKey(stream_key);
+}
+
+Status CheckSegmentSize(size_t segment_size) {
+  size_t max_segment_size;
+  ASYLO_ASSIGN_OR_RETURN(max_segment_size,
+                         AeadCryptor::MaxMessageSize(AES256_GCM));
+  if (segment_size == 0 || segment_size > max_segment_size) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  absl::StrCat("Segment size must be between 1 and ",
+                               max_segment_size, " bytes"));
+  }
+  return Status::OkStatus();
+}
+
+SegmentNonce MakeSegmentNonce(const uint8_t *nonce_prefix, uint64_t index,
+                              bool last_segment) {
+  SegmentNonce nonce;
+  std::copy(nonce_prefix, nonce_prefix + kStreamingAeadNoncePrefixSize,
+            nonce.begin());
+  for (int i = 0; i < 4; ++i) {
+    nonce[kStreamingAeadNoncePrefixSize + i] = index >> (24 - 8 * i);
+  }
+  nonce[kSegmentNonceSize - 1] = last_segment ? 1 : 0;
+  return nonce;
+}
+
+}  // namespace
+
+StatusOr<std::unique_ptr<StreamingAeadSealer>>
+StreamingAeadSealer::CreateAesGcmSealer(ByteContainerView key,
+                                        ByteContainerView associated_data,
+                                        size_t segment_size) {
+  ASYLO_RETURN_IF_ERROR(CheckSegmentSize(segment_size));
+  std::array<uint8_t, kStreamingAeadHeaderSize> header;
+  if (RAND_bytes(header.data(), header.size()) != 1) {
+    return Status(error::GoogleError::INTERNAL,
+                  absl::StrCat("RAND_bytes failed: ", BsslLastErrorString()));
+  }
+  std::unique_ptr<AeadKey> stream_key;
+  ASYLO_ASSIGN_OR_RETURN(
+      stream_key,
+      DeriveStreamKey(key, ByteContainerView(header.data(), kSaltSize),
+                      associated_data));
+  return absl::WrapUnique<StreamingAeadSealer>(
+      new StreamingAeadSealer(std::move(stream_key), header, segment_size));
+}
+
+size_t StreamingAeadSealer::MaxSegmentCiphertextSize() const {
+  return segment_size_ + key_->MaxSealOverhead();
+}
+
+Status StreamingAeadSealer::SealSegment(ByteContainerView plaintext,
+                                        bool last_segment,
+                                        absl::Span<uint8_t> ciphertext,
+                                        size_t *ciphertext_size) {
+  if (finished_) {
+    return Status(error::GoogleError::FAILED_PRECONDITION,
+                  "The last segment of the stream was already sealed");
+  }
+  if (next_segment_ >= kMaxSegments) {
+    return Status(error::GoogleError::FAILED_PRECONDITION,
+                  absl::StrCat("Reached maximum number of segments (",
+                               kMaxSegments, ")"));
+  }
+  if (last_segment ? plaintext.size() > segment_size_
+                   : plaintext.size() != segment_size_) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  absl::StrCat("Invalid segment size: ", plaintext.size(),
+                               " (segments hold ", segment_size_, " bytes)"));
+  }
+
+  SegmentNonce nonce =
+      MakeSegmentNonce(header_.data() + kSaltSize, next_segment_, last_segment);
+  ASYLO_RETURN_IF_ERROR(key_->Seal(plaintext, /*associated_data=*/"", nonce,
+                                   ciphertext, ciphertext_size));
+  next_segment_++;
+  finished_ = last_segment;
+  return Status::OkStatus();
+}
+
+StreamingAeadSealer::StreamingAeadSealer(
+    std::unique_ptr<AeadKey> key,
+    const std::array<uint8_t, kStreamingAeadHeaderSize> &header,
+    size_t segment_size)
+    : key_(std::move(key)),
+      header_(header),
+      segment_size_(segment_size),
+      next_segment_(0),
+      finished_(false) {}
+
+StatusOr<std::unique_ptr<StreamingAeadOpener>>
+StreamingAeadOpener::CreateAesGcmOpener(ByteContainerView key,
+                                        ByteContainerView associated_data,
+                                        ByteContainerView header,
+                                        size_t segment_size) {
+  ASYLO_RETURN_IF_ERROR(CheckSegmentSize(segment_size));
+  if (header.size() != kStreamingAeadHeaderSize) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  absl::StrCat("Invalid stream header length: ", header.size(),
+                               " (must be ", kStreamingAeadHeaderSize,
+                               " bytes)"));
+  }
+  std::unique_ptr<AeadKey> stream_key;
+  ASYLO_ASSIGN_OR_RETURN(
+      stream_key,
+      DeriveStreamKey(key, ByteContainerView(header.data(), kSaltSize),
+                      associated_data));
+  return absl::WrapUnique<StreamingAeadOpener>(new StreamingAeadOpener(
+      std::move(stream_key),
+      ByteContainerView(header.data() + kSaltSize,
+                        kStreamingAeadNoncePrefixSize),
+      segment_size));
+}
+
+size_t StreamingAeadOpener::MaxSegmentCiphertextSize() const {
+  return segment_size_ + key_->MaxSealOverhead();
+}
+
+Status StreamingAeadOpener::OpenSegment(ByteContainerView ciphertext,
+                                        bool last_segment,
+                                        absl::Span<uint8_t> plaintext,
+                                        size_t *plaintext_size) {
+  if (finished_) {
+    return Status(error::GoogleError::FAILED_PRECONDITION,
+                  "The last segment of the stream was already opened");
+  }
+  if (next_segment_ >= kMaxSegments) {
+    return Status(error::GoogleError::FAILED_PRECONDITION,
+                  absl::StrCat("Reached maximum number of segments (",
+                               kMaxSegments, ")"));
+  }
+  size_t max_ciphertext_size = MaxSegmentCiphertextSize();
+  if (last_segment ? ciphertext.size() > max_ciphertext_size
+                   : ciphertext.size() != max_ciphertext_size) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  absl::StrCat("Invalid sealed segment size: ",
+                               ciphertext.size()));
+  }
+
+  SegmentNonce nonce =
+      MakeSegmentNonce(nonce_prefix_.data(), next_segment_, last_segment);
+  ASYLO_RETURN_IF_ERROR(key_->Open(ciphertext, /*associated_data=*/"", nonce,
+                                   plaintext, plaintext_size));
+  next_segment_++;
+  finished_ = last_segment;
+  return Status::OkStatus();
+}
+
+StreamingAeadOpener::StreamingAeadOpener(std::unique_ptr<AeadKey> key,
+                                         ByteContainerView nonce_prefix,
+                                         size_t segment_size)
+    : key_(std::move(key)),
+      segment_size_(segment_size),
+      next_segment_(0),
+      finished_(false) {
+  std::copy(nonce_prefix.begin(), nonce_prefix.end(), nonce_prefix_.begin());
+}
+
+}  // namespace asylo
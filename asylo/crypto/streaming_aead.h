@@ -0,0 +1,177 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_CRYPTO_STREAMING_AEAD_H_
+#define ASYLO_CRYPTO_STREAMING_AEAD_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "absl/types/span.h"
+#include "asylo/crypto/aead_key.h"
+#include "asylo/crypto/util/byte_container_view.h"
+#include "asylo/util/status.h"
+#include "asylo/util/statusor.h"
+
+namespace asylo {
+
+/// Size in bytes of the header preceding the segments of a stream.
+constexpr size_t kStreamingAeadHeaderSize = 39;
+
+/// Size in bytes of the nonce prefix shared by the segments of a stream.
+constexpr size_t kStreamingAeadNoncePrefixSize = 7;
+
+/// Seals a stream of data in segments of a fixed size, so that only a single
+/// segment of plaintext and ciphertext needs to be held in memory at a time,
+/// regardless of the size of the stream.
+///
+/// This follows the STREAM construction used by Tink's streaming AEAD. Each
+/// stream is sealed with AES-GCM under a key derived with HKDF-SHA256 from the
+/// caller's key, a random salt and the associated data of the stream. The salt
+/// and a random nonce prefix make up the stream header. The nonce of each
+/// segment is the nonce prefix followed by the big-endian segment index and a
+/// byte marking the last segment, so segments cannot be reordered, dropped or
+/// truncated without StreamingAeadOpener detecting it.
+///
+/// A stream is laid out as header() followed by the sealed segments. Every
+/// segment but the last holds exactly segment_size() bytes of plaintext; the
+/// last one holds at most segment_size() bytes and may be empty.
+class StreamingAeadSealer {
+ public:
+  /// Creates a sealer for a new stream.
+  ///
+  /// \param key The AES-GCM key, 16 or 32 bytes long.
+  /// \param associated_data The data authenticated with the whole stream.
+  /// \param segment_size The size of the plaintext of each segment.
+  /// \return A pointer to the created sealer, or a non-OK Status if creation
+  ///         failed.
+  static StatusOr<std::unique_ptr<StreamingAeadSealer>> CreateAesGcmSealer(
+      ByteContainerView key, ByteContainerView associated_data,
+      size_t segment_size);
+
+  /// Gets the header of the stream, which must be passed to the opener.
+  ///
+  /// \return The kStreamingAeadHeaderSize bytes of the stream header.
+  ByteContainerView header() const {
+    return ByteContainerView(header_.data(), header_.size());
+  }
+
+  /// Gets the size of the plaintext of each segment but the last.
+  ///
+  /// \return The segment size.
+  size_t segment_size() const { return segment_size_; }
+
+  /// Gets the size of the ciphertext of a full segment.
+  ///
+  /// \return The largest ciphertext produced by SealSegment().
+  size_t MaxSegmentCiphertextSize() const;
+
+  /// Seals the next segment of the stream.
+  ///
+  /// `plaintext.size()` must equal segment_size() unless `last_segment` is
+  /// true, in which case it may be smaller. `ciphertext.size()` must be at
+  /// least `plaintext.size()` plus the overhead of AES-GCM. No segment may be
+  /// sealed after the last one, and a stream holds at most 2^32 segments.
+  ///
+  /// \param plaintext The plaintext of the segment.
+  /// \param last_segment Whether this is the last segment of the stream.
+  /// \param[out] ciphertext The sealed segment.
+  /// \param[out] ciphertext_size The size of the sealed segment.
+  /// \return The resulting status of the operation.
+  Status SealSegment(ByteContainerView plaintext, bool last_segment,
+                     absl::Span<uint8_t> ciphertext, size_t *ciphertext_size);
+
+ private:
+  StreamingAeadSealer(
+      std::unique_ptr<AeadKey> key,
+      const std::array<uint8_t, kStreamingAeadHeaderSize> &header,
+      size_t segment_size);
+
+  const std::unique_ptr<AeadKey> key_;
+  const std::array<uint8_t, kStreamingAeadHeaderSize> header_;
+  const size_t segment_size_;
+
+  // Index of the next segment to seal.
+  uint64_t next_segment_;
+
+  // True once the last segment was sealed.
+  bool finished_;
+};
+
+/// Opens a stream sealed by StreamingAeadSealer one segment at a time, in
+/// order.
+class StreamingAeadOpener {
+ public:
+  /// Creates an opener for a stream.
+  ///
+  /// \param key The AES-GCM key the stream was sealed with.
+  /// \param associated_data The data authenticated with the whole stream.
+  /// \param header The header of the stream.
+  /// \param segment_size The segment size the stream was sealed with.
+  /// \return A pointer to the created opener, or a non-OK Status if creation
+  ///         failed.
+  static StatusOr<std::unique_ptr<StreamingAeadOpener>> CreateAesGcmOpener(
+      ByteContainerView key, ByteContainerView associated_data,
+      ByteContainerView header, size_t segment_size);
+
+  /// Gets the size of the ciphertext of a full segment.
+  ///
+  /// \return The largest ciphertext accepted by OpenSegment().
+  size_t MaxSegmentCiphertextSize() const;
+
+  /// Opens the next segment of the stream. A failure to authenticate the
+  /// segment leaves the opener at the same segment.
+  ///
+  /// `plaintext.size()` must be at least the plaintext size of the segment,
+  /// which is at most segment_size().
+  ///
+  /// \param ciphertext The sealed segment.
+  /// \param last_segment Whether the caller reached the end of the stream.
+  /// \param[out] plaintext The plaintext of the segment.
+  /// \param[out] plaintext_size The size of the plaintext of the segment.
+  /// \return The resulting status of the operation.
+  Status OpenSegment(ByteContainerView ciphertext, bool last_segment,
+                     absl::Span<uint8_t> plaintext, size_t *plaintext_size);
+
+  /// Returns whether the last segment was opened. A stream whose last segment
+  /// was not opened was truncated, so its plaintext must not be trusted as a
+  /// whole until this returns true.
+  ///
+  /// \return True if the whole stream was opened.
+  bool finished() const { return finished_; }
+
+ private:
+  StreamingAeadOpener(std::unique_ptr<AeadKey> key,
+                      ByteContainerView nonce_prefix, size_t segment_size);
+
+  const std::unique_ptr<AeadKey> key_;
+  std::array<uint8_t, kStreamingAeadNoncePrefixSize> nonce_prefix_;
+  const size_t segment_size_;
+
+  // Index of the next segment to open.
+  uint64_t next_segment_;
+
+  // True once the last segment was opened.
+  bool finished_;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_CRYPTO_STREAMING_AEAD_H_
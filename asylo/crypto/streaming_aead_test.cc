@@ -0,0 +1,227 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/crypto/streaming_aead.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/types/span.h"
+#include "asylo/test/util/status_matchers.h"
+#include "asylo/util/cleansing_types.h"
+#include "asylo/util/status_macros.h"
+
+namespace asylo {
+namespace {
+
+using ::testing::Eq;
+using ::testing::Ne;
+using ::testing::Not;
+using ::testing::TestWithParam;
+
+constexpr char kKey128[] = "0123456789abcdef";
+constexpr char kKey256[] = "0123456789abcdef0123456789abcdef";
+constexpr char kAssociatedData[] = "stream associated data";
+constexpr size_t kSegmentSize = 64;
+
+// Seals |plaintext| as a stream of segments with |sealer|.
+std::vector<std::vector<uint8_t>> SealStream(StreamingAeadSealer *sealer,
+                                             const std::string &plaintext) {
+  std::vector<std::vector<uint8_t>> segments;
+  size_t offset = 0;
+  bool last_segment = false;
+  while (!last_segment) {
+    size_t size = std::min(sealer->segment_size(), plaintext.size() - offset);
+    last_segment = offset + sealer->segment_size() >= plaintext.size();
+    std::vector<uint8_t> segment(sealer->MaxSegmentCiphertextSize());
+    size_t segment_size;
+    Status status = sealer->SealSegment(
+        ByteContainerView(plaintext.data() + offset, size), last_segment,
+        absl::MakeSpan(segment), &segment_size);
+    EXPECT_THAT(status, IsOk());
+    segment.resize(segment_size);
+    segments.push_back(std::move(segment));
+    offset += size;
+  }
+  return segments;
+}
+
+// Opens |segments| with |opener|, the last of which is the end of the stream,
+// and returns the plaintext.
+StatusOr<std::string> OpenStream(
+    StreamingAeadOpener *opener,
+    const std::vector<std::vector<uint8_t>> &segments) {
+  std::string plaintext;
+  CleansingVector<uint8_t> buffer(opener->MaxSegmentCiphertextSize());
+  for (size_t i = 0; i < segments.size(); i++) {
+    size_t plaintext_size;
+    ASYLO_RETURN_IF_ERROR(opener->OpenSegment(
+        segments[i], i + 1 == segments.size(), absl::MakeSpan(buffer),
+        &plaintext_size));
+    plaintext.append(reinterpret_cast<const char *>(buffer.data()),
+                     plaintext_size);
+  }
+  return plaintext;
+}
+
+std::unique_ptr<StreamingAeadOpener> CreateOpener(
+    ByteContainerView key, ByteContainerView associated_data,
+    ByteContainerView header) {
+  auto opener_result = StreamingAeadOpener::CreateAesGcmOpener(
+      key, associated_data, header, kSegmentSize);
+  EXPECT_THAT(opener_result, IsOk());
+  return std::move(opener_result).ValueOrDie();
+}
+
+class StreamingAeadRoundTripTest
+    : public TestWithParam<std::pair<const char *, size_t>> {};
+
+TEST_P(StreamingAeadRoundTripTest, OpenReturnsSealedPlaintext) {
+  const char *key = GetParam().first;
+  std::string plaintext(GetParam().second, 'a');
+  for (size_t i = 0; i < plaintext.size(); i++) {
+    plaintext[i] += i % 26;
+  }
+
+  std::unique_ptr<StreamingAeadSealer> sealer;
+  ASYLO_ASSERT_OK_AND_ASSIGN(sealer, StreamingAeadSealer::CreateAesGcmSealer(
+                                         key, kAssociatedData, kSegmentSize));
+  EXPECT_THAT(sealer->header().size(), Eq(kStreamingAeadHeaderSize));
+  auto segments = SealStream(sealer.get(), plaintext);
+  EXPECT_THAT(segments.size(),
+              Eq(std::max<size_t>(
+                  1, (plaintext.size() + kSegmentSize - 1) / kSegmentSize)));
+
+  auto opener = CreateOpener(key, kAssociatedData, sealer->header());
+  EXPECT_THAT(OpenStream(opener.get(), segments), IsOkAndHolds(plaintext));
+  EXPECT_TRUE(opener->finished());
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    AllSizes, StreamingAeadRoundTripTest,
+    ::testing::Values(std::make_pair(kKey128, 0),
+                      std::make_pair(kKey128, 1),
+                      std::make_pair(kKey128, kSegmentSize - 1),
+                      std::make_pair(kKey256, kSegmentSize),
+                      std::make_pair(kKey256, kSegmentSize + 1),
+                      std::make_pair(kKey256, 10 * kSegmentSize + 3)));
+
+class StreamingAeadTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASYLO_ASSERT_OK_AND_ASSIGN(
+        sealer_, StreamingAeadSealer::CreateAesGcmSealer(
+                     kKey256, kAssociatedData, kSegmentSize));
+    segments_ = SealStream(sealer_.get(), std::string(4 * kSegmentSize, 'x'));
+  }
+
+  std::unique_ptr<StreamingAeadSealer> sealer_;
+  std::vector<std::vector<uint8_t>> segments_;
+};
+
+TEST_F(StreamingAeadTest, StreamsUseDistinctHeaders) {
+  std::unique_ptr<StreamingAeadSealer> other;
+  ASYLO_ASSERT_OK_AND_ASSIGN(other, StreamingAeadSealer::CreateAesGcmSealer(
+                                        kKey256, kAssociatedData,
+                                        kSegmentSize));
+  EXPECT_THAT(other->header(), Ne(sealer_->header()));
+}
+
+TEST_F(StreamingAeadTest, WrongKeyFails) {
+  auto opener = CreateOpener(kKey128, kAssociatedData, sealer_->header());
+  EXPECT_THAT(OpenStream(opener.get(), segments_), Not(IsOk()));
+}
+
+TEST_F(StreamingAeadTest, WrongAssociatedDataFails) {
+  auto opener = CreateOpener(kKey256, "other data", sealer_->header());
+  EXPECT_THAT(OpenStream(opener.get(), segments_), Not(IsOk()));
+}
+
+TEST_F(StreamingAeadTest, ModifiedSegmentFails) {
+  segments_[1][3] ^= 1;
+  auto opener = CreateOpener(kKey256, kAssociatedData, sealer_->header());
+  EXPECT_THAT(OpenStream(opener.get(), segments_), Not(IsOk()));
+}
+
+TEST_F(StreamingAeadTest, ReorderedSegmentsFail) {
+  std::swap(segments_[0], segments_[1]);
+  auto opener = CreateOpener(kKey256, kAssociatedData, sealer_->header());
+  EXPECT_THAT(OpenStream(opener.get(), segments_), Not(IsOk()));
+}
+
+TEST_F(StreamingAeadTest, TruncatedStreamFails) {
+  // The new last segment was sealed as a regular segment.
+  segments_.pop_back();
+  auto opener = CreateOpener(kKey256, kAssociatedData, sealer_->header());
+  EXPECT_THAT(OpenStream(opener.get(), segments_), Not(IsOk()));
+
+  // Without claiming to have reached the end, the truncation shows through
+  // finished().
+  opener = CreateOpener(kKey256, kAssociatedData, sealer_->header());
+  CleansingVector<uint8_t> buffer(opener->MaxSegmentCiphertextSize());
+  size_t plaintext_size;
+  for (const auto &segment : segments_) {
+    ASYLO_ASSERT_OK(opener->OpenSegment(segment, /*last_segment=*/false,
+                                        absl::MakeSpan(buffer),
+                                        &plaintext_size));
+  }
+  EXPECT_FALSE(opener->finished());
+}
+
+TEST_F(StreamingAeadTest, SegmentSizesAreEnforced) {
+  std::unique_ptr<StreamingAeadSealer> sealer;
+  ASYLO_ASSERT_OK_AND_ASSIGN(sealer, StreamingAeadSealer::CreateAesGcmSealer(
+                                         kKey256, kAssociatedData,
+                                         kSegmentSize));
+  std::vector<uint8_t> plaintext(kSegmentSize + 1);
+  std::vector<uint8_t> ciphertext(plaintext.size() +
+                                  sealer->MaxSegmentCiphertextSize());
+  size_t ciphertext_size;
+  EXPECT_THAT(sealer->SealSegment(
+                  ByteContainerView(plaintext.data(), kSegmentSize - 1),
+                  /*last_segment=*/false, absl::MakeSpan(ciphertext),
+                  &ciphertext_size),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+  EXPECT_THAT(sealer->SealSegment(plaintext, /*last_segment=*/true,
+                                  absl::MakeSpan(ciphertext), &ciphertext_size),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+  ASYLO_ASSERT_OK(sealer->SealSegment(
+      ByteContainerView(plaintext.data(), 1), /*last_segment=*/true,
+      absl::MakeSpan(ciphertext), &ciphertext_size));
+  EXPECT_THAT(sealer->SealSegment(
+                  ByteContainerView(plaintext.data(), 1),
+                  /*last_segment=*/true, absl::MakeSpan(ciphertext),
+                  &ciphertext_size),
+              StatusIs(error::GoogleError::FAILED_PRECONDITION));
+
+  EXPECT_THAT(StreamingAeadSealer::CreateAesGcmSealer(kKey256, kAssociatedData,
+                                                      /*segment_size=*/0),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+  EXPECT_THAT(StreamingAeadOpener::CreateAesGcmOpener(
+                  kKey256, kAssociatedData, "short header", kSegmentSize),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+}
+
+}  // namespace
+}  // namespace asylo
@@ -19,7 +19,6 @@
 #ifndef ASYLO_CRYPTO_UTIL_BYTE_CONTAINER_VIEW_H_
 #define ASYLO_CRYPTO_UTIL_BYTE_CONTAINER_VIEW_H_
 
-#include <openssl/mem.h>
 #include <string.h>
 #include <cstdint>
 #include <cstdlib>
@@ -28,6 +27,7 @@
 
 #include "absl/strings/string_view.h"
 #include "asylo/crypto/util/byte_container_view_internal.h"
+#include "asylo/crypto/util/constant_time.h"
 #include "asylo/util/logging.h"
 
 namespace asylo {
@@ -151,8 +151,7 @@ class ByteContainerView {
   // ByteContainerView with the contents of |other|. Returns true if the
   // contents are equal.
   bool SafeEquals(ByteContainerView other) const {
-    return (size_ == other.size_) &&
-           (CRYPTO_memcmp(data_, other.data_, size_) == 0);
+    return (size_ == other.size_) && SafeCompare(data_, other.data_, size_);
   }
 
  private:
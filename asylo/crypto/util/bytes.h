@@ -27,6 +27,7 @@
 
 #include "absl/base/attributes.h"
 #include "asylo/crypto/util/byte_container_view.h"
+#include "asylo/crypto/util/constant_time.h"
 #include "asylo/crypto/util/trivial_object_util.h"
 #include "asylo/util/logging.h"
 #include "asylo/util/cleansing_allocator.h"
@@ -238,7 +239,7 @@ class Bytes {
     if (Policy::policy == DataSafety::SAFE) {
       // Since Policy parameter is set to SAFE, perform constant-time comparison
       // to defend against side-channel leakage.
-      return (CRYPTO_memcmp(data_, data, Size) == 0);
+      return SafeCompare(data_, data, Size);
     } else {
       // Since Policy parameter is set to UNSAFE, use memcmp for fast
       // comparison.
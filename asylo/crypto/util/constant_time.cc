@@ -0,0 +1,126 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/crypto/util/constant_time.h"
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace asylo {
+namespace {
+
+uint64_t LoadWord(const uint8_t *data) {
+  uint64_t word;
+  memcpy(&word, data, sizeof(word));
+  return word;
+}
+
+void StoreWord(uint8_t *data, uint64_t word) {
+  memcpy(data, &word, sizeof(word));
+}
+
+}  // namespace
+
+bool SafeCompare(const void *lhs, const void *rhs, size_t size) {
+  const uint8_t *lhs_bytes = static_cast<const uint8_t *>(lhs);
+  const uint8_t *rhs_bytes = static_cast<const uint8_t *>(rhs);
+  size_t offset = 0;
+
+  // Accumulate the differences without branching on them, and only test the
+  // accumulated value once all bytes are consumed.
+  uint64_t difference = 0;
+#if defined(__AVX2__)
+  __m256i vector_difference = _mm256_setzero_si256();
+  for (; offset + sizeof(__m256i) <= size; offset += sizeof(__m256i)) {
+    __m256i lhs_vector = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(lhs_bytes + offset));
+    __m256i rhs_vector = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(rhs_bytes + offset));
+    vector_difference = _mm256_or_si256(
+        vector_difference, _mm256_xor_si256(lhs_vector, rhs_vector));
+  }
+  uint64_t lanes[sizeof(__m256i) / sizeof(uint64_t)];
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), vector_difference);
+  for (uint64_t lane : lanes) {
+    difference |= lane;
+  }
+#elif defined(__SSE2__)
+  __m128i vector_difference = _mm_setzero_si128();
+  for (; offset + sizeof(__m128i) <= size; offset += sizeof(__m128i)) {
+    __m128i lhs_vector = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(lhs_bytes + offset));
+    __m128i rhs_vector = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(rhs_bytes + offset));
+    vector_difference =
+        _mm_or_si128(vector_difference, _mm_xor_si128(lhs_vector, rhs_vector));
+  }
+  uint64_t lanes[sizeof(__m128i) / sizeof(uint64_t)];
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), vector_difference);
+  for (uint64_t lane : lanes) {
+    difference |= lane;
+  }
+#endif
+  for (; offset + sizeof(uint64_t) <= size; offset += sizeof(uint64_t)) {
+    difference |= LoadWord(lhs_bytes + offset) ^ LoadWord(rhs_bytes + offset);
+  }
+  for (; offset < size; ++offset) {
+    difference |= lhs_bytes[offset] ^ rhs_bytes[offset];
+  }
+  return difference == 0;
+}
+
+void XorBytes(const void *lhs, const void *rhs, void *output, size_t size) {
+  const uint8_t *lhs_bytes = static_cast<const uint8_t *>(lhs);
+  const uint8_t *rhs_bytes = static_cast<const uint8_t *>(rhs);
+  uint8_t *output_bytes = static_cast<uint8_t *>(output);
+  size_t offset = 0;
+
+#if defined(__AVX2__)
+  for (; offset + sizeof(__m256i) <= size; offset += sizeof(__m256i)) {
+    __m256i lhs_vector = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(lhs_bytes + offset));
+    __m256i rhs_vector = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(rhs_bytes + offset));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(output_bytes + offset),
+                        _mm256_xor_si256(lhs_vector, rhs_vector));
+  }
+#elif defined(__SSE2__)
+  for (; offset + sizeof(__m128i) <= size; offset += sizeof(__m128i)) {
+    __m128i lhs_vector = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(lhs_bytes + offset));
+    __m128i rhs_vector = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(rhs_bytes + offset));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(output_bytes + offset),
+                     _mm_xor_si128(lhs_vector, rhs_vector));
+  }
+#endif
+  for (; offset + sizeof(uint64_t) <= size; offset += sizeof(uint64_t)) {
+    StoreWord(output_bytes + offset,
+              LoadWord(lhs_bytes + offset) ^ LoadWord(rhs_bytes + offset));
+  }
+  for (; offset < size; ++offset) {
+    output_bytes[offset] = lhs_bytes[offset] ^ rhs_bytes[offset];
+  }
+}
+
+}  // namespace asylo
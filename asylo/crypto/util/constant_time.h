@@ -0,0 +1,41 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_CRYPTO_UTIL_CONSTANT_TIME_H_
+#define ASYLO_CRYPTO_UTIL_CONSTANT_TIME_H_
+
+#include <cstddef>
+
+namespace asylo {
+
+// Performs a side-channel-resistant comparison of the |size| bytes at |lhs| and
+// |rhs|. Returns true if they are equal. The running time depends only on
+// |size|, never on the contents of the buffers.
+//
+// The comparison uses AVX2 or SSE2 when available at compile time and falls
+// back to 64-bit words otherwise.
+bool SafeCompare(const void *lhs, const void *rhs, size_t size);
+
+// Writes the bitwise XOR of the |size| bytes at |lhs| and |rhs| to |output|.
+// |output| may be equal to |lhs| or |rhs|, but must not otherwise overlap them.
+// The running time depends only on |size|.
+void XorBytes(const void *lhs, const void *rhs, void *output, size_t size);
+
+}  // namespace asylo
+
+#endif  // ASYLO_CRYPTO_UTIL_CONSTANT_TIME_H_
@@ -0,0 +1,100 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/crypto/util/constant_time.h"
+
+#include <cstdint>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace {
+
+using ::testing::ElementsAreArray;
+
+// Larger than two AVX2 vectors, so that every size exercises a different mix of
+// the vector, word and byte loops.
+constexpr size_t kMaxSize = 100;
+
+// Returns |size| bytes starting at |first| and increasing.
+std::vector<uint8_t> Pattern(size_t size, uint8_t first) {
+  std::vector<uint8_t> bytes(size);
+  for (size_t i = 0; i < size; ++i) {
+    bytes[i] = first + 7 * i;
+  }
+  return bytes;
+}
+
+TEST(ConstantTimeTest, SafeCompareAcceptsEqualBuffers) {
+  for (size_t size = 0; size <= kMaxSize; ++size) {
+    std::vector<uint8_t> lhs = Pattern(size, 1);
+    std::vector<uint8_t> rhs = lhs;
+    EXPECT_TRUE(SafeCompare(lhs.data(), rhs.data(), size)) << size;
+  }
+}
+
+TEST(ConstantTimeTest, SafeCompareRejectsAnyDifferingByte) {
+  for (size_t size = 1; size <= kMaxSize; ++size) {
+    std::vector<uint8_t> lhs = Pattern(size, 1);
+    for (size_t position = 0; position < size; ++position) {
+      for (uint8_t bit = 1; bit != 0; bit <<= 1) {
+        std::vector<uint8_t> rhs = lhs;
+        rhs[position] ^= bit;
+        EXPECT_FALSE(SafeCompare(lhs.data(), rhs.data(), size))
+            << size << " " << position;
+      }
+    }
+  }
+}
+
+TEST(ConstantTimeTest, SafeCompareHandlesUnalignedBuffers) {
+  std::vector<uint8_t> lhs = Pattern(kMaxSize + 1, 3);
+  std::vector<uint8_t> rhs(kMaxSize + 3);
+  std::copy(lhs.begin() + 1, lhs.end(), rhs.begin() + 3);
+  EXPECT_TRUE(SafeCompare(lhs.data() + 1, rhs.data() + 3, kMaxSize));
+  rhs.back() ^= 1;
+  EXPECT_FALSE(SafeCompare(lhs.data() + 1, rhs.data() + 3, kMaxSize));
+}
+
+TEST(ConstantTimeTest, XorBytesMatchesBytewiseXor) {
+  for (size_t size = 0; size <= kMaxSize; ++size) {
+    std::vector<uint8_t> lhs = Pattern(size, 5);
+    std::vector<uint8_t> rhs = Pattern(size, 200);
+    std::vector<uint8_t> expected(size);
+    for (size_t i = 0; i < size; ++i) {
+      expected[i] = lhs[i] ^ rhs[i];
+    }
+    std::vector<uint8_t> output(size);
+    XorBytes(lhs.data(), rhs.data(), output.data(), size);
+    EXPECT_THAT(output, ElementsAreArray(expected)) << size;
+  }
+}
+
+TEST(ConstantTimeTest, XorBytesWorksInPlace) {
+  std::vector<uint8_t> lhs = Pattern(kMaxSize, 5);
+  std::vector<uint8_t> rhs = Pattern(kMaxSize, 200);
+  std::vector<uint8_t> original = lhs;
+  XorBytes(lhs.data(), rhs.data(), lhs.data(), lhs.size());
+  XorBytes(rhs.data(), lhs.data(), lhs.data(), lhs.size());
+  EXPECT_THAT(lhs, ElementsAreArray(original));
+}
+
+}  // namespace
+}  // namespace asylo
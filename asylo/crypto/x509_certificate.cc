@@ -251,31 +251,6 @@ std::vector<char> ToCharVector(absl::string_view str) {
   return vec;
 }
 
-// Converts |asn1_time| to an absl::Time.
-StatusOr<absl::Time> AbslTimeFromAsn1Time(const ASN1_TIME &asn1_time) {
-  constexpr absl::Duration kOneDay = absl::Hours(24);
-
-  static absl::once_flag once_init;
-  static ASN1_TIME *unix_epoch;
-  absl::call_once(once_init, [] {
-    unix_epoch = ASN1_TIME_new();
-    CHECK_NE(ASN1_TIME_set(unix_epoch, 0), nullptr) << BsslLastErrorString();
-  });
-
-  int num_days;
-  int num_seconds;
-  if (ASN1_TIME_diff(&num_days, &num_seconds, unix_epoch, &asn1_time) != 1) {
-    return Status(error::GoogleError::INTERNAL, BsslLastErrorString());
-  }
-  absl::Time time =
-      absl::UnixEpoch() + num_days * kOneDay + absl::Seconds(num_seconds);
-  if (time == absl::InfinitePast() || time == absl::InfiniteFuture()) {
-    return Status(error::GoogleError::OUT_OF_RANGE,
-                  "Time is too large or too small");
-  }
-  return time;
-}
-
 // Converts |time| to an ASN1_TIME.
 StatusOr<bssl::UniquePtr<ASN1_TIME>> Asn1TimeFromAbslTime(absl::Time time) {
   intmax_t unix_seconds = absl::ToUnixSeconds(time);
@@ -880,6 +855,17 @@ Status X509Certificate::Verify(const CertificateInterface &issuer_certificate,
 }
 
 StatusOr<std::string> X509Certificate::SubjectKeyDer() const {
+  return GetLazily(&subject_key_der_, [this] { return DecodeSubjectKeyDer(); });
+}
+
+absl::optional<std::string> X509Certificate::SubjectName() const {
+  return GetLazily(&subject_name_, [this] {
+           return StatusOr<absl::optional<std::string>>(DecodeSubjectName());
+         })
+      .ValueOrDie();
+}
+
+StatusOr<std::string> X509Certificate::DecodeSubjectKeyDer() const {
   bssl::UniquePtr<EVP_PKEY> evp_key(X509_get_pubkey(x509_.get()));
   if (evp_key == nullptr) {
     return Status(error::GoogleError::INTERNAL, BsslLastErrorString());
@@ -888,7 +874,7 @@ StatusOr<std::string> X509Certificate::SubjectKeyDer() const {
   return EvpPkeyToDer(*evp_key);
 }
 
-absl::optional<std::string> X509Certificate::SubjectName() const {
+absl::optional<std::string> X509Certificate::DecodeSubjectName() const {
   bssl::UniquePtr<BIO> subject_name_bio(BIO_new(BIO_s_mem()));
   if (!X509_NAME_print_ex(subject_name_bio.get(),
                           X509_get_subject_name(x509_.get()), 0,
@@ -968,6 +954,10 @@ StatusOr<X509Name> X509Certificate::GetIssuerName() const {
 }
 
 StatusOr<X509Validity> X509Certificate::GetValidity() const {
+  return GetLazily(&validity_, [this] { return DecodeValidity(); });
+}
+
+StatusOr<X509Validity> X509Certificate::DecodeValidity() const {
   X509Validity validity;
   ASYLO_ASSIGN_OR_RETURN(
       validity.not_before,
@@ -1014,6 +1004,12 @@ X509Certificate::GetSubjectKeyIdentifier() const {
 
 StatusOr<absl::optional<BasicConstraints>>
 X509Certificate::GetBasicConstraints() const {
+  return GetLazily(&basic_constraints_,
+                   [this] { return DecodeBasicConstraints(); });
+}
+
+StatusOr<absl::optional<BasicConstraints>>
+X509Certificate::DecodeBasicConstraints() const {
   bssl::UniquePtr<BASIC_CONSTRAINTS> bssl_constraints;
   ASYLO_ASSIGN_OR_RETURN(
       bssl_constraints,
@@ -1108,6 +1104,12 @@ X509Certificate::GetCrlDistributionPoints() const {
 
 StatusOr<std::vector<X509Extension>> X509Certificate::GetOtherExtensions()
     const {
+  return GetLazily(&other_extensions_,
+                   [this] { return DecodeOtherExtensions(); });
+}
+
+StatusOr<std::vector<X509Extension>>
+X509Certificate::DecodeOtherExtensions() const {
   int extension_count = X509_get_ext_count(x509_.get());
   std::vector<X509Extension> extensions;
   for (int i = 0; i < extension_count; ++i) {
@@ -1153,4 +1155,28 @@ StatusOr<X509_EXTENSION *> X509Certificate::GetExtensionByNid(int nid) const {
   return extension;
 }
 
+StatusOr<absl::Time> AbslTimeFromAsn1Time(const ASN1_TIME &asn1_time) {
+  constexpr absl::Duration kOneDay = absl::Hours(24);
+
+  static absl::once_flag once_init;
+  static ASN1_TIME *unix_epoch;
+  absl::call_once(once_init, [] {
+    unix_epoch = ASN1_TIME_new();
+    CHECK_NE(ASN1_TIME_set(unix_epoch, 0), nullptr) << BsslLastErrorString();
+  });
+
+  int num_days;
+  int num_seconds;
+  if (ASN1_TIME_diff(&num_days, &num_seconds, unix_epoch, &asn1_time) != 1) {
+    return Status(error::GoogleError::INTERNAL, BsslLastErrorString());
+  }
+  absl::Time time =
+      absl::UnixEpoch() + num_days * kOneDay + absl::Seconds(num_seconds);
+  if (time == absl::InfinitePast() || time == absl::InfiniteFuture()) {
+    return Status(error::GoogleError::OUT_OF_RANGE,
+                  "Time is too large or too small");
+  }
+  return time;
+}
+
 }  // namespace asylo
@@ -30,6 +30,7 @@
 #include <utility>
 #include <vector>
 
+#include "absl/base/call_once.h"
 #include "absl/strings/string_view.h"
 #include "absl/time/time.h"
 #include "absl/types/optional.h"
@@ -185,6 +186,11 @@ struct X509CertificateBuilder {
 
 // An implementation of CertificateInterface that can parse and verify
 // X.509 certificates from PEM or DER encodings.
+//
+// An X509Certificate is immutable. The subject key, subject name, validity
+// period, basic constraints and other extensions are decoded on first access
+// and kept for the lifetime of the object, so repeated calls to their getters
+// are cheap. The getters are safe to call concurrently.
 class X509Certificate : public CertificateInterface {
  public:
   // Creates and returns an X509Certificate with the given |certificate| as
@@ -274,8 +280,29 @@ class X509Certificate : public CertificateInterface {
  private:
   friend struct X509CertificateBuilder;
 
+  // A field that is decoded from |x509_| on first access and then kept.
+  template <typename T>
+  struct LazyField {
+    absl::once_flag once;
+    StatusOr<T> value;
+  };
+
+  // Returns the value of |field|, calling |decode| to set it on first access.
+  template <typename T, typename DecodeT>
+  static const StatusOr<T> &GetLazily(LazyField<T> *field, DecodeT decode) {
+    absl::call_once(field->once, [field, &decode] { field->value = decode(); });
+    return field->value;
+  }
+
   explicit X509Certificate(bssl::UniquePtr<X509> x509);
 
+  // Each decoder reads the corresponding field directly from |x509_|.
+  StatusOr<std::string> DecodeSubjectKeyDer() const;
+  absl::optional<std::string> DecodeSubjectName() const;
+  StatusOr<X509Validity> DecodeValidity() const;
+  StatusOr<absl::optional<BasicConstraints>> DecodeBasicConstraints() const;
+  StatusOr<std::vector<X509Extension>> DecodeOtherExtensions() const;
+
   // Returns the extension with NID |nid|, interpreted as the given type, or
   // nullptr if no such extension exists.
   template <typename X509v3ObjectT>
@@ -300,6 +327,12 @@ class X509Certificate : public CertificateInterface {
   StatusOr<X509_EXTENSION *> GetExtensionByNid(int nid) const;
 
   bssl::UniquePtr<X509> x509_;
+
+  mutable LazyField<std::string> subject_key_der_;
+  mutable LazyField<absl::optional<std::string>> subject_name_;
+  mutable LazyField<X509Validity> validity_;
+  mutable LazyField<absl::optional<BasicConstraints>> basic_constraints_;
+  mutable LazyField<std::vector<X509Extension>> other_extensions_;
 };
 
 // Creates and returns an X509_REQ object equivalent to the data in |csr|.
@@ -319,6 +352,10 @@ StatusOr<CertificateSigningRequest> X509ReqToDerCertificateSigningRequest(
 StatusOr<std::string> ExtractPkcs10SubjectKeyDer(
     const CertificateSigningRequest &csr);
 
+// Converts |asn1_time| to an absl::Time. Returns a non-OK Status if the time
+// cannot be represented.
+StatusOr<absl::Time> AbslTimeFromAsn1Time(const ASN1_TIME &asn1_time);
+
 }  // namespace asylo
 
 #endif  // ASYLO_CRYPTO_X509_CERTIFICATE_H_
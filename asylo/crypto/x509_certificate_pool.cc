@@ -0,0 +1,114 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/crypto/x509_certificate_pool.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "asylo/crypto/sha256_hash.h"
+#include "asylo/crypto/util/byte_container_view.h"
+#include "asylo/util/status.h"
+#include "asylo/util/status_macros.h"
+
+namespace asylo {
+namespace {
+
+// Returns the pool key of |certificate|.
+StatusOr<std::string> PoolKey(const Certificate &certificate) {
+  Sha256Hash hash;
+  uint8_t format[sizeof(uint32_t)];
+  for (size_t i = 0; i < sizeof(format); ++i) {
+    format[i] = static_cast<uint8_t>(
+        static_cast<uint32_t>(certificate.format()) >> (8 * i));
+  }
+  hash.Update(ByteContainerView(format, sizeof(format)));
+  hash.Update(certificate.data());
+
+  std::vector<uint8_t> digest;
+  ASYLO_RETURN_IF_ERROR(hash.CumulativeHash(&digest));
+  return std::string(digest.begin(), digest.end());
+}
+
+}  // namespace
+
+X509CertificatePool::X509CertificatePool(size_t capacity)
+    : capacity_(capacity) {}
+
+StatusOr<std::shared_ptr<const X509Certificate>> X509CertificatePool::Intern(
+    const Certificate &certificate) {
+  std::string key;
+  ASYLO_ASSIGN_OR_RETURN(key, PoolKey(certificate));
+
+  std::shared_ptr<const X509Certificate> pooled = Lookup(key);
+  if (pooled) {
+    return pooled;
+  }
+
+  std::unique_ptr<X509Certificate> parsed;
+  ASYLO_ASSIGN_OR_RETURN(parsed, X509Certificate::Create(certificate));
+  return Insert(key, std::move(parsed));
+}
+
+void X509CertificatePool::Clear() {
+  auto members_view = members_.Lock();
+  members_view->entries.clear();
+  members_view->index.clear();
+}
+
+size_t X509CertificatePool::size() const {
+  return members_.ReaderLock()->entries.size();
+}
+
+std::shared_ptr<const X509Certificate> X509CertificatePool::Lookup(
+    const std::string &key) {
+  auto members_view = members_.Lock();
+  auto it = members_view->index.find(key);
+  if (it == members_view->index.end()) {
+    return nullptr;
+  }
+  members_view->entries.splice(members_view->entries.begin(),
+                               members_view->entries, it->second);
+  return it->second->certificate;
+}
+
+std::shared_ptr<const X509Certificate> X509CertificatePool::Insert(
+    const std::string &key,
+    std::shared_ptr<const X509Certificate> certificate) {
+  if (capacity_ == 0) {
+    return certificate;
+  }
+  auto members_view = members_.Lock();
+  auto it = members_view->index.find(key);
+  if (it != members_view->index.end()) {
+    // Another thread parsed the same certificate concurrently.
+    members_view->entries.splice(members_view->entries.begin(),
+                                 members_view->entries, it->second);
+    return it->second->certificate;
+  }
+  if (members_view->entries.size() >= capacity_) {
+    members_view->index.erase(members_view->entries.back().key);
+    members_view->entries.pop_back();
+  }
+  members_view->entries.push_front({key, std::move(certificate)});
+  members_view->index.emplace(key, members_view->entries.begin());
+  return members_view->entries.front().certificate;
+}
+
+}  // namespace asylo
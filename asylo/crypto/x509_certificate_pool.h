@@ -0,0 +1,96 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_CRYPTO_X509_CERTIFICATE_POOL_H_
+#define ASYLO_CRYPTO_X509_CERTIFICATE_POOL_H_
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+#include "asylo/crypto/certificate.pb.h"
+#include "asylo/crypto/x509_certificate.h"
+#include "asylo/util/mutex_guarded.h"
+#include "asylo/util/statusor.h"
+
+namespace asylo {
+
+// A bounded pool of parsed X.509 certificates. Identical encoded certificates
+// passed to Intern() share a single X509Certificate, so the fields it decodes
+// lazily are decoded once for all of its users. Verifiers which see the same
+// certificates on every handshake can share one pool to avoid parsing them
+// again.
+//
+// Entries are keyed by a digest of the certificate's format and data. Failed
+// parses are not pooled. When the pool is full, the least-recently-used entry
+// is evicted; certificates which were handed out stay valid for as long as
+// their users hold them.
+//
+// This class is thread-safe.
+class X509CertificatePool {
+ public:
+  // Creates a pool holding up to |capacity| certificates.
+  explicit X509CertificatePool(size_t capacity);
+
+  X509CertificatePool(const X509CertificatePool &) = delete;
+  X509CertificatePool &operator=(const X509CertificatePool &) = delete;
+
+  // Returns the pooled X509Certificate for |certificate|, parsing it with
+  // X509Certificate::Create() if the pool does not hold it yet.
+  StatusOr<std::shared_ptr<const X509Certificate>> Intern(
+      const Certificate &certificate);
+
+  // Removes all entries.
+  void Clear();
+
+  // Returns the number of pooled certificates.
+  size_t size() const;
+
+ private:
+  struct Entry {
+    std::string key;
+    std::shared_ptr<const X509Certificate> certificate;
+  };
+
+  // Type that holds members for mutex-synchronized access.
+  struct Members {
+    // Entries from most to least recently used.
+    std::list<Entry> entries;
+    absl::flat_hash_map<std::string, std::list<Entry>::iterator> index;
+  };
+
+  // Returns the pooled certificate for |key|, or nullptr if there is none, and
+  // marks the entry as most recently used.
+  std::shared_ptr<const X509Certificate> Lookup(const std::string &key);
+
+  // Adds |certificate| under |key|, evicting the least-recently-used entry if
+  // the pool is full, and returns the pooled certificate. If another thread
+  // pooled the same certificate first, returns that one instead.
+  std::shared_ptr<const X509Certificate> Insert(
+      const std::string &key,
+      std::shared_ptr<const X509Certificate> certificate);
+
+  const size_t capacity_;
+  MutexGuarded<Members> members_;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_CRYPTO_X509_CERTIFICATE_POOL_H_
@@ -0,0 +1,152 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/crypto/x509_certificate_pool.h"
+
+#include <memory>
+#include <string>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/strings/escaping.h"
+#include "asylo/crypto/certificate.pb.h"
+#include "asylo/crypto/x509_certificate.h"
+#include "asylo/test/util/status_matchers.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+namespace {
+
+using ::testing::Eq;
+using ::testing::Ne;
+using ::testing::Not;
+using ::testing::NotNull;
+
+// A self-signed root certificate.
+constexpr char kRootCertPem[] =
+    R"(-----BEGIN CERTIFICATE-----
+MIICIDCCAcWgAwIBAgIULkih5ZufUjhWlLQoUWwpExC3zwcwCgYIKoZIzj0EAwIw
+ZDELMAkGA1UEBhMCVVMxEzARBgNVBAgMCldhc2hpbmd0b24xEDAOBgNVBAcMB1Nl
+YXR0bGUxDzANBgNVBAoMBkdvb2dsZTENMAsGA1UECwwEVGVzdDEOMAwGA1UEAwwF
+QXN5bG8wIBcNMjAwOTIxMjI1MjEyWhgPMjE1NzA4MTQyMjUyMTJaMGQxCzAJBgNV
+BAYTAlVTMRMwEQYDVQQIDApXYXNoaW5ndG9uMRAwDgYDVQQHDAdTZWF0dGxlMQ8w
+DQYDVQQKDAZHb29nbGUxDTALBgNVBAsMBFRlc3QxDjAMBgNVBAMMBUFzeWxvMFkw
+EwYHKoZIzj0CAQYIKoZIzj0DAQcDQgAE6u2lED6JGU9Dv+DYRPPnnwAJV/w8kjfH
+6o3c1n4ix1zXURnqmqAvds7Ky78bL+Ycafye6tof4ppWfWzrRo4WvaNTMFEwHQYD
+VR0OBBYEFHDdyENjESv3h+ykhA96vvYrdf2tMB8GA1UdIwQYMBaAFHDdyENjESv3
+h+ykhA96vvYrdf2tMA8GA1UdEwEB/wQFMAMBAf8wCgYIKoZIzj0EAwIDSQAwRgIh
+ALrU8G1GlTpoZMkywq37nEkltBwJY5OQhyCKv+Ca0/fLAiEA/vgihzv9O4uVMJeC
+7xrH1OhW49CIbzE+CY89+eGjdwY=
+-----END CERTIFICATE-----)";
+
+// An intermediate certificate signed by the root key.
+constexpr char kIntermediateCertDerHex[] =
+    "308201c53082016b021426b475554e271a15e4eabc11e5a3251eebbd965b300a06082a8648"
+    "ce3d0403023064310b30090603550406130255533113301106035504080c0a57617368696e"
+    "67746f6e3110300e06035504070c0753656174746c65310f300d060355040a0c06476f6f67"
+    "6c65310d300b060355040b0c0454657374310e300c06035504030c054173796c6f3020170d"
+    "3230303932323030313832385a180f32313537303831353030313832385a3064310b300906"
+    "03550406130255533113301106035504080c0a57617368696e67746f6e3110300e06035504"
+    "070c0753656174746c65310f300d060355040a0c06476f6f676c65310d300b060355040b0c"
+    "0454657374310e300c06035504030c054173796c6f3059301306072a8648ce3d020106082a"
+    "8648ce3d030107034200040079945224636910452c088d3d791ece3fda7546603e14fe76fc"
+    "afcdd75fcb7e7d63bfb32a894790bf6f128fe69f7da2f85394d2fac4208305100212c10f22"
+    "d9300a06082a8648ce3d0403020348003045022100c6b838458a48b89838fcac657e870c9d"
+    "dff5e5a8fec37bd74955a730d2549ace02204480fab3dccb57175b28985968fcb702cbde18"
+    "4a383c60e4094d3641977ee79a";
+
+Certificate RootCertificate() {
+  Certificate certificate;
+  certificate.set_format(Certificate::X509_PEM);
+  certificate.set_data(kRootCertPem);
+  return certificate;
+}
+
+Certificate IntermediateCertificate() {
+  Certificate certificate;
+  certificate.set_format(Certificate::X509_DER);
+  certificate.set_data(absl::HexStringToBytes(kIntermediateCertDerHex));
+  return certificate;
+}
+
+TEST(X509CertificatePoolTest, IdenticalCertificatesShareAnInstance) {
+  X509CertificatePool pool(/*capacity=*/4);
+  std::shared_ptr<const X509Certificate> first;
+  ASYLO_ASSERT_OK_AND_ASSIGN(first, pool.Intern(RootCertificate()));
+  std::shared_ptr<const X509Certificate> second;
+  ASYLO_ASSERT_OK_AND_ASSIGN(second, pool.Intern(RootCertificate()));
+  ASSERT_THAT(first, NotNull());
+  EXPECT_THAT(first.get(), Eq(second.get()));
+  EXPECT_THAT(pool.size(), Eq(1));
+}
+
+TEST(X509CertificatePoolTest, DistinctCertificatesGetDistinctInstances) {
+  X509CertificatePool pool(/*capacity=*/4);
+  std::shared_ptr<const X509Certificate> root;
+  ASYLO_ASSERT_OK_AND_ASSIGN(root, pool.Intern(RootCertificate()));
+  std::shared_ptr<const X509Certificate> intermediate;
+  ASYLO_ASSERT_OK_AND_ASSIGN(intermediate,
+                             pool.Intern(IntermediateCertificate()));
+  EXPECT_THAT(root.get(), Ne(intermediate.get()));
+  EXPECT_TRUE(intermediate->Verify(*root, VerificationConfig()).ok());
+  EXPECT_THAT(pool.size(), Eq(2));
+}
+
+TEST(X509CertificatePoolTest, FormatIsPartOfTheKey) {
+  X509CertificatePool pool(/*capacity=*/4);
+  Certificate mislabeled = IntermediateCertificate();
+  mislabeled.set_format(Certificate::X509_PEM);
+  ASSERT_THAT(pool.Intern(IntermediateCertificate()), IsOk());
+  EXPECT_THAT(pool.Intern(mislabeled), Not(IsOk()));
+  EXPECT_THAT(pool.size(), Eq(1));
+}
+
+TEST(X509CertificatePoolTest, FailedParsesAreNotPooled) {
+  X509CertificatePool pool(/*capacity=*/4);
+  Certificate malformed;
+  malformed.set_format(Certificate::X509_DER);
+  malformed.set_data("not a certificate");
+  EXPECT_THAT(pool.Intern(malformed), Not(IsOk()));
+  EXPECT_THAT(pool.size(), Eq(0));
+}
+
+TEST(X509CertificatePoolTest, EvictsLeastRecentlyUsedCertificate) {
+  X509CertificatePool pool(/*capacity=*/1);
+  std::shared_ptr<const X509Certificate> root;
+  ASYLO_ASSERT_OK_AND_ASSIGN(root, pool.Intern(RootCertificate()));
+  ASSERT_THAT(pool.Intern(IntermediateCertificate()), IsOk());
+  EXPECT_THAT(pool.size(), Eq(1));
+
+  // The evicted certificate stays usable, but is parsed again on the next
+  // lookup.
+  EXPECT_THAT(root->SubjectKeyDer(), IsOk());
+  std::shared_ptr<const X509Certificate> reparsed;
+  ASYLO_ASSERT_OK_AND_ASSIGN(reparsed, pool.Intern(RootCertificate()));
+  EXPECT_THAT(reparsed.get(), Ne(root.get()));
+}
+
+TEST(X509CertificatePoolTest, ClearRemovesAllCertificates) {
+  X509CertificatePool pool(/*capacity=*/4);
+  ASSERT_THAT(pool.Intern(RootCertificate()), IsOk());
+  ASSERT_THAT(pool.Intern(IntermediateCertificate()), IsOk());
+  pool.Clear();
+  EXPECT_THAT(pool.size(), Eq(0));
+}
+
+}  // namespace
+}  // namespace asylo
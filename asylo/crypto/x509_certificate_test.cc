@@ -736,6 +736,27 @@ TEST_F(X509CertificateTest, SubjectNameMatches) {
                      "CA,OU=Asylo,O=Google,L=Kirkland,ST=Washington,C=US")));
 }
 
+// Verifies that repeated calls to the lazily-decoded getters return the same
+// values.
+TEST_F(X509CertificateTest, RepeatedGettersReturnSameValues) {
+  std::unique_ptr<X509Certificate> x509;
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      x509, X509Certificate::CreateFromPem(kTestRealCaCertPem));
+
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_THAT(
+        x509->SubjectName(),
+        Optional(StrEq("CN=Test Real Root "
+                       "CA,OU=Asylo,O=Google,L=Kirkland,ST=Washington,C=US")));
+    EXPECT_THAT(x509->SubjectKeyDer(), IsOk());
+    EXPECT_THAT(x509->IsCa(), Optional(true));
+    EXPECT_THAT(x509->WithinValidityPeriod(absl::Now()), IsOk());
+    EXPECT_THAT(x509->GetOtherExtensions(), IsOk());
+  }
+  EXPECT_THAT(x509->SubjectKeyDer().ValueOrDie(),
+              Eq(x509->SubjectKeyDer().ValueOrDie()));
+}
+
 // Verifies that IsCa() returns an expected true value.
 TEST_F(X509CertificateTest, IsCaExtensionTrue) {
   std::unique_ptr<CertificateInterface> x509;
@@ -0,0 +1,247 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/crypto/x509_crl.h"
+
+#include <openssl/bio.h>
+#include <openssl/bn.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "asylo/crypto/asn1.h"
+#include "asylo/crypto/bignum_util.h"
+#include "asylo/crypto/certificate_util.h"
+#include "asylo/crypto/util/bssl_util.h"
+#include "asylo/crypto/x509_certificate.h"
+#include "asylo/util/proto_enum_util.h"
+#include "asylo/util/status_macros.h"
+
+namespace asylo {
+namespace {
+
+// Returns the key under which the serial number |serial_number| is indexed:
+// its sign followed by its big-endian magnitude without leading zeros, so that
+// equal numbers have equal keys however they were encoded.
+StatusOr<std::string> SerialNumberKey(const BIGNUM &serial_number) {
+  std::pair<Sign, std::vector<uint8_t>> sign_and_magnitude;
+  ASYLO_ASSIGN_OR_RETURN(sign_and_magnitude,
+                         BigEndianBytesFromBignum(serial_number));
+  std::string key(1, sign_and_magnitude.first == Sign::kNegative ? '-' : '+');
+  key.append(sign_and_magnitude.second.begin(),
+             sign_and_magnitude.second.end());
+  return key;
+}
+
+// Parses |crl| into an X509_CRL.
+StatusOr<bssl::UniquePtr<X509_CRL>> ParseCrl(
+    const CertificateRevocationList &crl) {
+  ASYLO_RETURN_IF_ERROR(ValidateCertificateRevocationList(crl));
+
+  bssl::UniquePtr<X509_CRL> x509_crl;
+  switch (crl.format()) {
+    case CertificateRevocationList::X509_DER: {
+      const uint8_t *data =
+          reinterpret_cast<const uint8_t *>(crl.data().data());
+      x509_crl.reset(d2i_X509_CRL(/*a=*/nullptr, &data, crl.data().size()));
+      break;
+    }
+    case CertificateRevocationList::X509_PEM: {
+      bssl::UniquePtr<BIO> crl_bio(
+          BIO_new_mem_buf(crl.data().data(), crl.data().size()));
+      x509_crl.reset(PEM_read_bio_X509_CRL(crl_bio.get(), /*x=*/nullptr,
+                                           /*cb=*/nullptr, /*u=*/nullptr));
+      break;
+    }
+    default:
+      return Status(error::GoogleError::INVALID_ARGUMENT,
+                    absl::StrCat("Unsupported certificate revocation list "
+                                 "format: ",
+                                 ProtoEnumValueName(crl.format())));
+  }
+  if (x509_crl == nullptr) {
+    return Status(error::GoogleError::INVALID_ARGUMENT, BsslLastErrorString());
+  }
+
+  // GCC 4.9 requires this std::move() invocation.
+  return std::move(x509_crl);
+}
+
+}  // namespace
+
+StatusOr<std::unique_ptr<X509Crl>> X509Crl::Create(
+    const CertificateRevocationList &crl, const CertificateInterface &issuer) {
+  bssl::UniquePtr<X509_CRL> x509_crl;
+  ASYLO_ASSIGN_OR_RETURN(x509_crl, ParseCrl(crl));
+
+  std::string issuer_key_der;
+  ASYLO_ASSIGN_OR_RETURN(issuer_key_der, issuer.SubjectKeyDer());
+  const uint8_t *key_data =
+      reinterpret_cast<const uint8_t *>(issuer_key_der.data());
+  bssl::UniquePtr<EVP_PKEY> issuer_key(
+      d2i_PUBKEY(/*out=*/nullptr, &key_data, issuer_key_der.size()));
+  if (issuer_key == nullptr) {
+    return Status(error::GoogleError::INTERNAL, BsslLastErrorString());
+  }
+  if (X509_CRL_verify(x509_crl.get(), issuer_key.get()) != 1) {
+    return Status(
+        error::GoogleError::UNAUTHENTICATED,
+        absl::StrCat("Invalid certificate revocation list signature: ",
+                     BsslLastErrorString()));
+  }
+
+  absl::Time this_update;
+  ASYLO_ASSIGN_OR_RETURN(
+      this_update,
+      AbslTimeFromAsn1Time(*X509_CRL_get0_lastUpdate(x509_crl.get())));
+  absl::optional<absl::Time> next_update;
+  const ASN1_TIME *next_update_asn1 = X509_CRL_get0_nextUpdate(x509_crl.get());
+  if (next_update_asn1 != nullptr) {
+    ASYLO_ASSIGN_OR_RETURN(next_update,
+                           AbslTimeFromAsn1Time(*next_update_asn1));
+  }
+
+  absl::flat_hash_set<std::string> revoked_serial_numbers;
+  STACK_OF(X509_REVOKED) *revoked = X509_CRL_get_REVOKED(x509_crl.get());
+  size_t revoked_count = revoked == nullptr ? 0 : sk_X509_REVOKED_num(revoked);
+  revoked_serial_numbers.reserve(revoked_count);
+  for (size_t i = 0; i < revoked_count; ++i) {
+    const X509_REVOKED *entry = sk_X509_REVOKED_value(revoked, i);
+    Asn1Value serial_asn1_value;
+    ASYLO_RETURN_IF_ERROR(serial_asn1_value.SetBsslInteger(
+        *X509_REVOKED_get0_serialNumber(entry)));
+    bssl::UniquePtr<BIGNUM> serial_number;
+    ASYLO_ASSIGN_OR_RETURN(serial_number, serial_asn1_value.GetInteger());
+    std::string key;
+    ASYLO_ASSIGN_OR_RETURN(key, SerialNumberKey(*serial_number));
+    revoked_serial_numbers.insert(std::move(key));
+  }
+
+  return absl::WrapUnique(new X509Crl(std::move(issuer_key_der), this_update,
+                                      next_update,
+                                      std::move(revoked_serial_numbers)));
+}
+
+Status X509Crl::CheckNotRevoked(const CertificateInterface &subject,
+                                const CertificateInterface &issuer,
+                                absl::Time time) const {
+  if (!IsIssuedBy(issuer)) {
+    return Status::OkStatus();
+  }
+  if (!IsCurrentAt(time)) {
+    return Status(error::GoogleError::FAILED_PRECONDITION,
+                  absl::StrCat("Certificate revocation list expired at ",
+                               absl::FormatTime(next_update_.value())));
+  }
+
+  const auto *x509_subject = dynamic_cast<const X509Certificate *>(&subject);
+  if (x509_subject == nullptr) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Certificate revocation list cannot check a certificate "
+                  "that is not an X.509 certificate");
+  }
+  bssl::UniquePtr<BIGNUM> serial_number;
+  ASYLO_ASSIGN_OR_RETURN(serial_number, x509_subject->GetSerialNumber());
+  bool revoked;
+  ASYLO_ASSIGN_OR_RETURN(revoked, IsRevoked(*serial_number));
+  if (revoked) {
+    return Status(error::GoogleError::UNAUTHENTICATED,
+                  "Certificate has been revoked");
+  }
+  return Status::OkStatus();
+}
+
+StatusOr<bool> X509Crl::IsRevoked(const BIGNUM &serial_number) const {
+  std::string key;
+  ASYLO_ASSIGN_OR_RETURN(key, SerialNumberKey(serial_number));
+  return revoked_serial_numbers_.contains(key);
+}
+
+bool X509Crl::IsCurrentAt(absl::Time time) const {
+  return !next_update_.has_value() || time < next_update_.value();
+}
+
+bool X509Crl::IsIssuedBy(const CertificateInterface &issuer) const {
+  StatusOr<std::string> issuer_key_der = issuer.SubjectKeyDer();
+  return issuer_key_der.ok() && issuer_key_der.ValueOrDie() == issuer_key_der_;
+}
+
+X509Crl::X509Crl(std::string issuer_key_der, absl::Time this_update,
+                 absl::optional<absl::Time> next_update,
+                 absl::flat_hash_set<std::string> revoked_serial_numbers)
+    : issuer_key_der_(std::move(issuer_key_der)),
+      this_update_(this_update),
+      next_update_(next_update),
+      revoked_serial_numbers_(std::move(revoked_serial_numbers)) {}
+
+StatusOr<std::unique_ptr<X509CrlRevocationChecker>>
+X509CrlRevocationChecker::Create(std::unique_ptr<CertificateInterface> issuer,
+                                 CrlFetcher fetcher) {
+  auto checker = absl::WrapUnique(
+      new X509CrlRevocationChecker(std::move(issuer), std::move(fetcher)));
+  ASYLO_ASSIGN_OR_RETURN(*checker->crl_.Lock(), checker->FetchCrl());
+
+  // GCC 4.9 requires this std::move() invocation.
+  return std::move(checker);
+}
+
+Status X509CrlRevocationChecker::CheckNotRevoked(
+    const CertificateInterface &subject, const CertificateInterface &issuer,
+    absl::Time time) const {
+  std::shared_ptr<const X509Crl> crl = this->crl();
+  // Certificates from other issuers do not warrant a refresh.
+  if (!crl->IsCurrentAt(time) && crl->IsIssuedBy(issuer)) {
+    ASYLO_ASSIGN_OR_RETURN(crl, CurrentCrl(time));
+  }
+  return crl->CheckNotRevoked(subject, issuer, time);
+}
+
+std::shared_ptr<const X509Crl> X509CrlRevocationChecker::crl() const {
+  return *crl_.ReaderLock();
+}
+
+X509CrlRevocationChecker::X509CrlRevocationChecker(
+    std::unique_ptr<CertificateInterface> issuer, CrlFetcher fetcher)
+    : issuer_(std::move(issuer)), fetcher_(std::move(fetcher)) {}
+
+StatusOr<std::shared_ptr<const X509Crl>> X509CrlRevocationChecker::CurrentCrl(
+    absl::Time time) const {
+  auto crl_view = crl_.Lock();
+  // Another thread may have refreshed the CRL while this one waited.
+  if (!(*crl_view)->IsCurrentAt(time)) {
+    ASYLO_ASSIGN_OR_RETURN(*crl_view, FetchCrl());
+  }
+  return *crl_view;
+}
+
+StatusOr<std::shared_ptr<const X509Crl>> X509CrlRevocationChecker::FetchCrl()
+    const {
+  CertificateRevocationList crl;
+  ASYLO_ASSIGN_OR_RETURN(crl, fetcher_());
+  std::unique_ptr<X509Crl> x509_crl;
+  ASYLO_ASSIGN_OR_RETURN(x509_crl, X509Crl::Create(crl, *issuer_));
+  return std::shared_ptr<const X509Crl>(std::move(x509_crl));
+}
+
+}  // namespace asylo
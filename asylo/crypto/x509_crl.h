@@ -0,0 +1,149 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_CRYPTO_X509_CRL_H_
+#define ASYLO_CRYPTO_X509_CRL_H_
+
+#include <openssl/base.h>
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/time/time.h"
+#include "absl/types/optional.h"
+#include "asylo/crypto/certificate.pb.h"
+#include "asylo/crypto/certificate_interface.h"
+#include "asylo/util/mutex_guarded.h"
+#include "asylo/util/status.h"
+#include "asylo/util/statusor.h"
+
+namespace asylo {
+
+// An X.509 certificate revocation list (CRL), as defined in RFC 5280. The list
+// is decoded once, when the X509Crl is created, into a hash set of the serial
+// numbers it revokes, so each revocation check is a single lookup regardless of
+// the size of the list.
+//
+// As a RevocationChecker, an X509Crl only has information about certificates
+// issued by the key that signed the list. It fails every check made after its
+// nextUpdate time, since the issuer may have revoked more certificates since.
+//
+// An X509Crl is immutable and safe to use concurrently.
+class X509Crl : public RevocationChecker {
+ public:
+  // Parses |crl| and verifies its signature with the subject key of |issuer|.
+  // Returns a non-OK Status if the list cannot be parsed or if its signature is
+  // invalid.
+  static StatusOr<std::unique_ptr<X509Crl>> Create(
+      const CertificateRevocationList &crl, const CertificateInterface &issuer);
+
+  // From RevocationChecker.
+
+  // Returns an UNAUTHENTICATED error if |subject| is an X.509 certificate that
+  // the list revokes, and a FAILED_PRECONDITION error if |time| is not before
+  // the nextUpdate time of the list.
+  Status CheckNotRevoked(const CertificateInterface &subject,
+                         const CertificateInterface &issuer,
+                         absl::Time time) const override;
+
+  // Returns whether the list revokes the certificate with serial number
+  // |serial_number|.
+  StatusOr<bool> IsRevoked(const BIGNUM &serial_number) const;
+
+  // Returns whether the list may be relied upon at |time|, which is the case
+  // until its nextUpdate time.
+  bool IsCurrentAt(absl::Time time) const;
+
+  // Returns whether |issuer| has the key that signed the list.
+  bool IsIssuedBy(const CertificateInterface &issuer) const;
+
+  // Returns the time at which the list was issued.
+  absl::Time this_update() const { return this_update_; }
+
+  // Returns the time by which the next list will be issued, or absl::nullopt
+  // if the list does not say.
+  absl::optional<absl::Time> next_update() const { return next_update_; }
+
+  // Returns the number of serial numbers revoked by the list.
+  size_t revoked_count() const { return revoked_serial_numbers_.size(); }
+
+ private:
+  X509Crl(std::string issuer_key_der, absl::Time this_update,
+          absl::optional<absl::Time> next_update,
+          absl::flat_hash_set<std::string> revoked_serial_numbers);
+
+  const std::string issuer_key_der_;
+  const absl::Time this_update_;
+  const absl::optional<absl::Time> next_update_;
+  const absl::flat_hash_set<std::string> revoked_serial_numbers_;
+};
+
+// A RevocationChecker backed by the CRL of a single issuer, such as the PCK CRL
+// of the Intel SGX Provisioning Certification Service. The CRL is fetched when
+// the checker is created, and fetched again by the first check made after its
+// nextUpdate time. Checks of certificates from other issuers always succeed
+// without consulting the CRL.
+//
+// This class is thread-safe. Concurrent checks share a single refresh.
+class X509CrlRevocationChecker : public RevocationChecker {
+ public:
+  // Returns the current CRL of the issuer.
+  using CrlFetcher = std::function<StatusOr<CertificateRevocationList>()>;
+
+  // Creates a checker for the certificates issued by |issuer|, and fetches
+  // the first CRL with |fetcher|. Returns a non-OK Status if the CRL cannot be
+  // fetched or is invalid.
+  static StatusOr<std::unique_ptr<X509CrlRevocationChecker>> Create(
+      std::unique_ptr<CertificateInterface> issuer, CrlFetcher fetcher);
+
+  X509CrlRevocationChecker(const X509CrlRevocationChecker &) = delete;
+  X509CrlRevocationChecker &operator=(const X509CrlRevocationChecker &) =
+      delete;
+
+  // From RevocationChecker.
+
+  // Refreshes the CRL first if it is not current at |time|. Returns a non-OK
+  // Status if the refresh fails or if even the new CRL is not current.
+  Status CheckNotRevoked(const CertificateInterface &subject,
+                         const CertificateInterface &issuer,
+                         absl::Time time) const override;
+
+  // Returns the CRL currently in use.
+  std::shared_ptr<const X509Crl> crl() const;
+
+ private:
+  X509CrlRevocationChecker(std::unique_ptr<CertificateInterface> issuer,
+                           CrlFetcher fetcher);
+
+  // Returns a CRL that is current at |time|, fetching a new one if needed.
+  StatusOr<std::shared_ptr<const X509Crl>> CurrentCrl(absl::Time time) const;
+
+  // Fetches the CRL of |issuer_| and verifies it.
+  StatusOr<std::shared_ptr<const X509Crl>> FetchCrl() const;
+
+  const std::unique_ptr<CertificateInterface> issuer_;
+  const CrlFetcher fetcher_;
+  mutable MutexGuarded<std::shared_ptr<const X509Crl>> crl_;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_CRYPTO_X509_CRL_H_
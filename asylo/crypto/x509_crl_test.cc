@@ -0,0 +1,276 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/crypto/x509_crl.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/strings/escaping.h"
+#include "absl/time/time.h"
+#include "asylo/crypto/certificate.pb.h"
+#include "asylo/crypto/certificate_interface.h"
+#include "asylo/crypto/certificate_util.h"
+#include "asylo/crypto/x509_certificate.h"
+#include "asylo/test/util/status_matchers.h"
+#include "asylo/util/status.h"
+#include "asylo/util/statusor.h"
+
+namespace asylo {
+namespace {
+
+using ::testing::Eq;
+using ::testing::Optional;
+
+// A self-signed CA certificate, which signs the leaf certificates and the
+// CRLs below.
+constexpr char kCaCertPem[] =
+    R"(-----BEGIN CERTIFICATE-----
+MIIBkjCCATmgAwIBAgIUeY7ahYOaS1uLg9y+EhxD1PPoKeMwCgYIKoZIzj0EAwIw
+FjEUMBIGA1UEAwwLVGVzdCBDUkwgQ0EwIBcNMjYxMDE1MDUyMjE2WhgPMjEyNjA5
+MjEwNTIyMTZaMBYxFDASBgNVBAMMC1Rlc3QgQ1JMIENBMFkwEwYHKoZIzj0CAQYI
+KoZIzj0DAQcDQgAEDpHa49tLz5tAj6YoSocTV79zhUJxaRgnxhCRW75MbkrsJ+lL
+OUTMexD9QdK05Qe+XjmQMO8oaSyD6DW7Z1xY6KNjMGEwHQYDVR0OBBYEFHXDknEN
+vH5dvRcNwGF8P5SEFUMmMB8GA1UdIwQYMBaAFHXDknENvH5dvRcNwGF8P5SEFUMm
+MA8GA1UdEwEB/wQFMAMBAf8wDgYDVR0PAQH/BAQDAgEGMAoGCCqGSM49BAMCA0cA
+MEQCIDHkz3ni/Nm2G7K4Bq0CYCtAf7fWUyxj3V3mLWO/aDG0AiAFLWtC1XqhMMFa
+RqTCHmBlPLMG6R4d4iCLTpt6G/vgOA==
+-----END CERTIFICATE-----)";
+
+// A certificate with serial number 0x1234 issued by the CA.
+constexpr char kRevokedLeafCertPem[] =
+    R"(-----BEGIN CERTIFICATE-----
+MIIBFTCBuwICEjQwCgYIKoZIzj0EAwIwFjEUMBIGA1UEAwwLVGVzdCBDUkwgQ0Ew
+IBcNMjYxMDE1MDUyMjE2WhgPMjEyNjA5MjEwNTIyMTZaMBQxEjAQBgNVBAMMCUxl
+YWYgMTIzNDBZMBMGByqGSM49AgEGCCqGSM49AwEHA0IABK6LAE84voDfWf2mp/hw
+FdW6Ar4lunn40d+PwfAfStDgR0khItbHJ1dvdLlv6dXmTQqtfvNCUsFugIQVOhVB
+Dx8wCgYIKoZIzj0EAwIDSQAwRgIhAItS/V+tPla7fouxy2lm2cu7s0o/puwNRhdt
+lEFhnnSHAiEAorhsFeCD+jF+/fYHdBt7DSE0xLp0hd/T5W8u7121JJY=
+-----END CERTIFICATE-----)";
+
+// A certificate with serial number 0x5678 issued by the CA.
+constexpr char kLaterRevokedLeafCertPem[] =
+    R"(-----BEGIN CERTIFICATE-----
+MIIBFDCBuwICVngwCgYIKoZIzj0EAwIwFjEUMBIGA1UEAwwLVGVzdCBDUkwgQ0Ew
+IBcNMjYxMDE1MDUyMjE2WhgPMjEyNjA5MjEwNTIyMTZaMBQxEjAQBgNVBAMMCUxl
+YWYgNTY3ODBZMBMGByqGSM49AgEGCCqGSM49AwEHA0IABK6LAE84voDfWf2mp/hw
+FdW6Ar4lunn40d+PwfAfStDgR0khItbHJ1dvdLlv6dXmTQqtfvNCUsFugIQVOhVB
+Dx8wCgYIKoZIzj0EAwIDSAAwRQIgDFpK7+l/VVqlzFZ41+xBFUPBBIsBGbQUVB5f
+4ooSXFACIQC8XUHY+HgTeAZQauBXO56WNnv4DghS9qi29xqoG3NxEA==
+-----END CERTIFICATE-----)";
+
+// A CRL from the CA revoking serial number 0x1234, with a nextUpdate time of
+// kCrlNextUpdate.
+constexpr char kCrlPem[] =
+    R"(-----BEGIN X509 CRL-----
+MIHFMGwCAQEwCgYIKoZIzj0EAwIwFjEUMBIGA1UEAwwLVGVzdCBDUkwgQ0EXDTI2
+MTAxNTA1MjIxNloXDTI2MTExNDA1MjIxNlowFTATAgISNBcNMjYxMDE1MDUyMjE2
+WqAOMAwwCgYDVR0UBAMCAQEwCgYIKoZIzj0EAwIDSQAwRgIhAJN+wPV/y6js2/f0
+zeJVjsYccXwdXTNNTGElo5vPU8d+AiEAwOlE+EFqJfvvMQJNamyFPPaOIxs93huY
+TWwpRKXszpY=
+-----END X509 CRL-----)";
+
+// The DER encoding of kCrlPem.
+constexpr char kCrlDerHex[] =
+    "3081c5306c020101300a06082a8648ce3d04030230163114301206035504030c0b546573"
+    "742043524c204341170d3236313031353035323231365a170d3236313131343035323231"
+    "365a3015301302021234170d3236313031353035323231365aa00e300c300a0603551d14"
+    "0403020101300a06082a8648ce3d0403020349003046022100937ec0f57fcba8ecdbf7f4"
+    "cde2558ec61c717c1d5d334d4c6125a39bcf53c77e022100c0e944f8416a25fbef31024d"
+    "6a6c853cf68e231b3dde1b984d6c2944a5ecce96";
+
+// A newer CRL from the CA revoking serial numbers 0x1234 and 0x5678, with a
+// nextUpdate time of kNewerCrlNextUpdate.
+constexpr char kNewerCrlPem[] =
+    R"(-----BEGIN X509 CRL-----
+MIHaMIGBAgEBMAoGCCqGSM49BAMCMBYxFDASBgNVBAMMC1Rlc3QgQ1JMIENBFw0y
+NjEwMTUwNTIyMjBaFw0yNjEyMTQwNTIyMjBaMCowEwICEjQXDTI2MTAxNTA1MjIx
+NlowEwICVngXDTI2MTAxNTA1MjIyMFqgDjAMMAoGA1UdFAQDAgECMAoGCCqGSM49
+BAMCA0gAMEUCIDMtbc2t+C9fHrUmTAyeLFsgkKg4s1aqig728zWjZST/AiEAt0Z0
+Fuyc9Pfh2I+JDARmHISu2sY2M4TZ1cI+LpvLN40=
+-----END X509 CRL-----)";
+
+// A CRL with the same issuer name as the CA, but signed with another key.
+constexpr char kCrlFromOtherKeyPem[] =
+    R"(-----BEGIN X509 CRL-----
+MIHaMIGBAgEBMAoGCCqGSM49BAMCMBYxFDASBgNVBAMMC1Rlc3QgQ1JMIENBFw0y
+NjEwMTUwNTIyMjBaFw0yNjExMTQwNTIyMjBaMCowEwICEjQXDTI2MTAxNTA1MjIx
+NlowEwICVngXDTI2MTAxNTA1MjIyMFqgDjAMMAoGA1UdFAQDAgEDMAoGCCqGSM49
+BAMCA0gAMEUCIDz6db5grK7YzLmi4fzrrCPrXMs8OeyBPz15sdXb0FnTAiEA2GmA
+I2PpONB6yGec0PCPlDdB4GlFTPJgmgzouZDeM/Y=
+-----END X509 CRL-----)";
+
+const absl::Time kCrlThisUpdate = absl::FromUnixSeconds(1792041736);
+const absl::Time kCrlNextUpdate = absl::FromUnixSeconds(1794633736);
+const absl::Time kNewerCrlNextUpdate = absl::FromUnixSeconds(1797225740);
+
+std::unique_ptr<X509Certificate> ParseCertificate(const char *pem) {
+  return X509Certificate::CreateFromPem(pem).ValueOrDie();
+}
+
+CertificateRevocationList ParseCrl(const char *pem) {
+  return GetCrlFromPem(pem).ValueOrDie();
+}
+
+class X509CrlTest : public ::testing::Test {
+ protected:
+  X509CrlTest()
+      : ca_(ParseCertificate(kCaCertPem)),
+        revoked_leaf_(ParseCertificate(kRevokedLeafCertPem)),
+        later_revoked_leaf_(ParseCertificate(kLaterRevokedLeafCertPem)) {}
+
+  std::unique_ptr<X509Certificate> ca_;
+  std::unique_ptr<X509Certificate> revoked_leaf_;
+  std::unique_ptr<X509Certificate> later_revoked_leaf_;
+};
+
+TEST_F(X509CrlTest, IndexesRevokedSerialNumbers) {
+  std::unique_ptr<X509Crl> crl;
+  ASYLO_ASSERT_OK_AND_ASSIGN(crl, X509Crl::Create(ParseCrl(kCrlPem), *ca_));
+
+  EXPECT_THAT(crl->revoked_count(), Eq(1));
+  EXPECT_THAT(crl->this_update(), Eq(kCrlThisUpdate));
+  EXPECT_THAT(crl->next_update(), Optional(kCrlNextUpdate));
+  EXPECT_THAT(crl->IsRevoked(*revoked_leaf_->GetSerialNumber().ValueOrDie()),
+              IsOkAndHolds(true));
+  EXPECT_THAT(
+      crl->IsRevoked(*later_revoked_leaf_->GetSerialNumber().ValueOrDie()),
+      IsOkAndHolds(false));
+}
+
+TEST_F(X509CrlTest, ParsesDerCrls) {
+  CertificateRevocationList der_crl;
+  der_crl.set_format(CertificateRevocationList::X509_DER);
+  der_crl.set_data(absl::HexStringToBytes(kCrlDerHex));
+  std::unique_ptr<X509Crl> crl;
+  ASYLO_ASSERT_OK_AND_ASSIGN(crl, X509Crl::Create(der_crl, *ca_));
+  EXPECT_THAT(crl->revoked_count(), Eq(1));
+}
+
+TEST_F(X509CrlTest, RejectsMalformedCrls) {
+  CertificateRevocationList der_crl;
+  der_crl.set_format(CertificateRevocationList::X509_DER);
+  der_crl.set_data("not a CRL");
+  EXPECT_THAT(X509Crl::Create(der_crl, *ca_).status(),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+  EXPECT_THAT(X509Crl::Create(ParseCrl("not a CRL"), *ca_).status(),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+}
+
+TEST_F(X509CrlTest, RejectsCrlSignedWithAnotherKey) {
+  EXPECT_THAT(X509Crl::Create(ParseCrl(kCrlFromOtherKeyPem), *ca_).status(),
+              StatusIs(error::GoogleError::UNAUTHENTICATED));
+}
+
+TEST_F(X509CrlTest, ChecksCertificatesFromItsIssuer) {
+  std::unique_ptr<X509Crl> crl;
+  ASYLO_ASSERT_OK_AND_ASSIGN(crl, X509Crl::Create(ParseCrl(kCrlPem), *ca_));
+
+  EXPECT_THAT(crl->CheckNotRevoked(*revoked_leaf_, *ca_, kCrlThisUpdate),
+              StatusIs(error::GoogleError::UNAUTHENTICATED));
+  EXPECT_THAT(crl->CheckNotRevoked(*later_revoked_leaf_, *ca_, kCrlThisUpdate),
+              IsOk());
+
+  // The CRL has no information about certificates from other issuers.
+  EXPECT_THAT(crl->CheckNotRevoked(*revoked_leaf_, *later_revoked_leaf_,
+                                   kCrlThisUpdate),
+              IsOk());
+}
+
+TEST_F(X509CrlTest, FailsChecksAfterNextUpdate) {
+  std::unique_ptr<X509Crl> crl;
+  ASYLO_ASSERT_OK_AND_ASSIGN(crl, X509Crl::Create(ParseCrl(kCrlPem), *ca_));
+
+  EXPECT_THAT(crl->CheckNotRevoked(*later_revoked_leaf_, *ca_, kCrlNextUpdate),
+              StatusIs(error::GoogleError::FAILED_PRECONDITION));
+}
+
+TEST_F(X509CrlTest, VerifyCertificateChainChecksRevocation) {
+  std::unique_ptr<X509Crl> crl;
+  ASYLO_ASSERT_OK_AND_ASSIGN(crl, X509Crl::Create(ParseCrl(kCrlPem), *ca_));
+  VerificationConfig config(/*all_fields=*/true, kCrlThisUpdate);
+  config.revocation_checker = crl.get();
+
+  CertificateInterfaceVector revoked_chain;
+  revoked_chain.push_back(ParseCertificate(kRevokedLeafCertPem));
+  revoked_chain.push_back(ParseCertificate(kCaCertPem));
+  EXPECT_THAT(VerifyCertificateChain(revoked_chain, config),
+              StatusIs(error::GoogleError::UNAUTHENTICATED));
+
+  CertificateInterfaceVector valid_chain;
+  valid_chain.push_back(ParseCertificate(kLaterRevokedLeafCertPem));
+  valid_chain.push_back(ParseCertificate(kCaCertPem));
+  EXPECT_THAT(VerifyCertificateChain(valid_chain, config), IsOk());
+}
+
+TEST_F(X509CrlTest, CheckerRefreshesCrlAfterNextUpdate) {
+  std::vector<const char *> crls = {kCrlPem, kNewerCrlPem};
+  int fetches = 0;
+  std::unique_ptr<X509CrlRevocationChecker> checker;
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      checker, X509CrlRevocationChecker::Create(
+                   ParseCertificate(kCaCertPem),
+                   [&crls, &fetches]() -> StatusOr<CertificateRevocationList> {
+                     return ParseCrl(crls[fetches++]);
+                   }));
+  EXPECT_THAT(fetches, Eq(1));
+
+  EXPECT_THAT(
+      checker->CheckNotRevoked(*later_revoked_leaf_, *ca_, kCrlThisUpdate),
+      IsOk());
+  EXPECT_THAT(fetches, Eq(1));
+
+  EXPECT_THAT(
+      checker->CheckNotRevoked(*later_revoked_leaf_, *ca_, kCrlNextUpdate),
+      StatusIs(error::GoogleError::UNAUTHENTICATED));
+  EXPECT_THAT(fetches, Eq(2));
+  EXPECT_THAT(checker->crl()->next_update(), Optional(kNewerCrlNextUpdate));
+
+  EXPECT_THAT(checker->CheckNotRevoked(*revoked_leaf_, *ca_, kCrlNextUpdate),
+              StatusIs(error::GoogleError::UNAUTHENTICATED));
+  EXPECT_THAT(fetches, Eq(2));
+}
+
+TEST_F(X509CrlTest, CheckerFailsWhenRefreshFails) {
+  int fetches = 0;
+  std::unique_ptr<X509CrlRevocationChecker> checker;
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      checker, X509CrlRevocationChecker::Create(
+                   ParseCertificate(kCaCertPem),
+                   [&fetches]() -> StatusOr<CertificateRevocationList> {
+                     if (fetches++ > 0) {
+                       return Status(error::GoogleError::UNAVAILABLE,
+                                     "CRL unavailable");
+                     }
+                     return ParseCrl(kCrlPem);
+                   }));
+
+  EXPECT_THAT(
+      checker->CheckNotRevoked(*later_revoked_leaf_, *ca_, kCrlNextUpdate),
+      StatusIs(error::GoogleError::UNAVAILABLE));
+  // The stale CRL is kept, and checks before its nextUpdate still use it.
+  EXPECT_THAT(checker->CheckNotRevoked(*revoked_leaf_, *ca_, kCrlThisUpdate),
+              StatusIs(error::GoogleError::UNAUTHENTICATED));
+}
+
+}  // namespace
+}  // namespace asylo
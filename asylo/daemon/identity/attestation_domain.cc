@@ -33,6 +33,7 @@
 #include "absl/strings/str_format.h"
 #include "asylo/crypto/sha256_hash.h"
 #include "asylo/crypto/util/bssl_util.h"
+#include "asylo/util/mutex_guarded.h"
 #include "asylo/util/posix_error_space.h"
 #include "asylo/util/status.h"
 #include "asylo/util/status_macros.h"
@@ -80,9 +81,8 @@ StatusOr<std::string> GetPerBootUuid() {
   return std::string(uuid.data(), uuid.size());
 }
 
-}  // namespace
-
-StatusOr<std::string> GetAttestationDomain() {
+// Derives the attestation domain from the per-boot machine UUID.
+StatusOr<std::string> DeriveAttestationDomain() {
   std::string boot_uuid;
   ASYLO_ASSIGN_OR_RETURN(boot_uuid, GetPerBootUuid());
 
@@ -105,4 +105,17 @@ StatusOr<std::string> GetAttestationDomain() {
                      kAttestationDomainSize);
 }
 
+}  // namespace
+
+StatusOr<std::string> GetAttestationDomain() {
+  // The per-boot machine UUID cannot change while the process runs, so the
+  // attestation domain is derived once and shared. Failures are not cached.
+  static auto *const cached_domain = new MutexGuarded<std::string>("");
+  auto domain = cached_domain->Lock();
+  if (domain->empty()) {
+    ASYLO_ASSIGN_OR_RETURN(*domain, DeriveAttestationDomain());
+  }
+  return *domain;
+}
+
 }  // namespace asylo
@@ -0,0 +1,419 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Measures the throughput of Redis running in an enclave against Redis running
+// directly on the host, with redis-benchmark, and reports the host calls the
+// enclave made per request. See README.md for how to run it.
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "absl/strings/strip.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "tools/cpp/runfiles/runfiles.h"
+#include "asylo/test/util/exec_tester.h"
+#include "asylo/test/util/test_flags.h"
+#include "asylo/util/logging.h"
+#include "asylo/util/status.h"
+#include "asylo/util/status_macros.h"
+#include "asylo/util/statusor.h"
+
+ABSL_FLAG(
+    std::string, enclave_server_path, "",
+    "The path to the binary that loads the Redis server inside an enclave");
+ABSL_FLAG(std::string, host_server_path, "",
+          "The path to the Redis server binary built for the host");
+ABSL_FLAG(std::string, client_path, "",
+          "The path to the binary that launches the Redis client");
+ABSL_FLAG(std::string, benchmark_path, "",
+          "The path to the redis-benchmark binary");
+ABSL_FLAG(int32_t, requests, 100000,
+          "The number of requests of each command in each workload");
+ABSL_FLAG(int32_t, clients, 50, "The number of parallel connections");
+ABSL_FLAG(int32_t, pipeline, 16,
+          "The number of requests per pipeline in the pipelined workload");
+ABSL_FLAG(int32_t, data_size, 3, "The size of SET values in bytes");
+ABSL_FLAG(int32_t, top_host_calls, 15,
+          "The number of most frequent host calls to report");
+ABSL_FLAG(std::string, output_path, "",
+          "If set, the report is also written to this file");
+
+namespace asylo {
+namespace {
+
+using bazel::tools::cpp::runfiles::Runfiles;
+
+constexpr char kServerInitializedMessage[] = "Server initialized";
+constexpr absl::Duration kServerStartTimeout = absl::Seconds(30);
+constexpr absl::Duration kWaitStep = absl::Milliseconds(100);
+
+// The commands each workload runs.
+constexpr char kCommands[] = "set,get";
+constexpr int kCommandCount = 2;
+
+// The environment variable through which the whole-application wrapper
+// profiles the exit calls of the enclave.
+constexpr char kExitProfilePathVariable[] = "ASYLO_EXIT_PROFILE_PATH";
+
+// A redis-benchmark run.
+struct Workload {
+  std::string name;
+  int pipeline;
+};
+
+// Requests per second of each command of each workload, by workload name and
+// command.
+using Throughput = std::map<std::string, std::map<std::string, double>>;
+
+// An ExecTester that records when the Redis server is ready to accept
+// requests.
+class RedisServerExecTester : public experimental::ExecTester {
+ public:
+  RedisServerExecTester(const std::vector<std::string> &args,
+                        std::atomic<bool> *server_initialized)
+      : ExecTester(args), server_initialized_(server_initialized) {}
+
+ protected:
+  bool CheckLine(const std::string &line) override {
+    if (absl::StrContains(line, kServerInitializedMessage)) {
+      *server_initialized_ = true;
+    }
+    return true;
+  }
+
+ private:
+  std::atomic<bool> *server_initialized_;
+};
+
+// An ExecTester that collects the requests per second redis-benchmark reports
+// in CSV format, which are lines like "SET","85470.09".
+class RedisBenchmarkExecTester : public experimental::ExecTester {
+ public:
+  RedisBenchmarkExecTester(const std::vector<std::string> &args,
+                           std::map<std::string, double> *throughput)
+      : ExecTester(args), throughput_(throughput) {}
+
+ protected:
+  bool CheckLine(const std::string &line) override {
+    std::vector<absl::string_view> fields = absl::StrSplit(line, ',');
+    if (fields.size() != 2) {
+      return true;
+    }
+    for (absl::string_view &field : fields) {
+      absl::ConsumePrefix(&field, "\"");
+      absl::ConsumeSuffix(&field, "\"");
+    }
+    double requests_per_second;
+    if (!absl::SimpleAtod(fields[1], &requests_per_second)) {
+      return false;
+    }
+    (*throughput_)[std::string(fields[0])] = requests_per_second;
+    return true;
+  }
+
+ private:
+  std::map<std::string, double> *throughput_;
+};
+
+// Returns an error unless |exit_status| is that of a process which exited with
+// status 0.
+Status CheckExitStatus(absl::string_view process, int exit_status) {
+  if (!WIFEXITED(exit_status)) {
+    return Status(error::GoogleError::INTERNAL,
+                  absl::StrCat(process, " ended abnormally"));
+  }
+  if (WEXITSTATUS(exit_status) != 0) {
+    return Status(error::GoogleError::INTERNAL,
+                  absl::StrCat(process, " exited with status ",
+                               WEXITSTATUS(exit_status)));
+  }
+  return Status::OkStatus();
+}
+
+// A Redis server process run by a thread of its own.
+struct ServerProcess {
+  std::vector<std::string> argv;
+  std::atomic<bool> initialized{false};
+  int exit_status = 0;
+};
+
+// Runs |workloads| against the |server_name| Redis server started with
+// |server_argv|, which listens on |socket_path|, and returns their throughput.
+StatusOr<Throughput> BenchmarkServer(absl::string_view server_name,
+                                     std::vector<std::string> server_argv,
+                                     const std::string &socket_path,
+                                     const std::string &client_path,
+                                     const std::string &benchmark_path,
+                                     const std::vector<Workload> &workloads) {
+  // The server is shared with its thread, which is detached if the server
+  // cannot be stopped.
+  auto server = std::make_shared<ServerProcess>();
+  server->argv = std::move(server_argv);
+  std::thread server_thread([server] {
+    RedisServerExecTester server_runner(server->argv, &server->initialized);
+    server_runner.Run(/*input=*/"", &server->exit_status);
+  });
+
+  absl::Time deadline = absl::Now() + kServerStartTimeout;
+  while (!server->initialized && absl::Now() < deadline) {
+    absl::SleepFor(kWaitStep);
+  }
+  if (!server->initialized) {
+    server_thread.detach();
+    return Status(error::GoogleError::DEADLINE_EXCEEDED,
+                  absl::StrCat("The ", server_name, " server did not start"));
+  }
+
+  Throughput throughput;
+  Status status;
+  for (const Workload &workload : workloads) {
+    RedisBenchmarkExecTester benchmark_runner(
+        {benchmark_path, "-s", socket_path, "-t", kCommands, "-n",
+         absl::StrCat(absl::GetFlag(FLAGS_requests)), "-c",
+         absl::StrCat(absl::GetFlag(FLAGS_clients)), "-d",
+         absl::StrCat(absl::GetFlag(FLAGS_data_size)), "-P",
+         absl::StrCat(workload.pipeline), "--csv"},
+        &throughput[workload.name]);
+    int benchmark_exit_status;
+    if (!benchmark_runner.Run(/*input=*/"", &benchmark_exit_status)) {
+      status = Status(error::GoogleError::INTERNAL,
+                      "Malformed output from redis-benchmark");
+      break;
+    }
+    status = CheckExitStatus("redis-benchmark", benchmark_exit_status);
+    if (!status.ok()) {
+      break;
+    }
+  }
+
+  // Shut the server down without saving a snapshot, which would otherwise be
+  // taken when the server exits.
+  experimental::ExecTester shutdown_runner(
+      {client_path, "-s", socket_path, "shutdown", "nosave"});
+  int shutdown_exit_status;
+  shutdown_runner.Run(/*input=*/"", &shutdown_exit_status);
+  Status shutdown_status = CheckExitStatus("redis-cli", shutdown_exit_status);
+  if (!shutdown_status.ok()) {
+    server_thread.detach();
+    return shutdown_status;
+  }
+  server_thread.join();
+  if (!status.ok()) {
+    return status;
+  }
+  ASYLO_RETURN_IF_ERROR(CheckExitStatus(
+      absl::StrCat("The ", server_name, " server"), server->exit_status));
+  return throughput;
+}
+
+// Returns the number of calls of each selector and sub key in the exit profile
+// at |path|, which holds the text written by the SGX loader.
+StatusOr<std::map<std::pair<uint64_t, int64_t>, uint64_t>> ReadExitProfile(
+    const std::string &path) {
+  std::ifstream file(path);
+  if (!file) {
+    return Status(error::GoogleError::NOT_FOUND,
+                  absl::StrCat("No exit profile at ", path));
+  }
+  std::map<std::pair<uint64_t, int64_t>, uint64_t> counts;
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    std::vector<absl::string_view> fields =
+        absl::StrSplit(line, ' ', absl::SkipEmpty());
+    uint64_t selector;
+    int64_t sub_key;
+    uint64_t count;
+    if (fields.size() < 3 || !absl::SimpleAtoi(fields[0], &selector) ||
+        !absl::SimpleAtoi(fields[1], &sub_key) ||
+        !absl::SimpleAtoi(fields[2], &count)) {
+      return Status(error::GoogleError::INTERNAL,
+                    absl::StrCat("Malformed exit profile line: ", line));
+    }
+    counts[{selector, sub_key}] += count;
+  }
+  return counts;
+}
+
+// Returns the report of the throughput of the host and enclave servers, and of
+// the host calls the enclave made.
+std::string FormatReport(
+    const std::vector<Workload> &workloads, const Throughput &host,
+    const Throughput &enclave,
+    const std::map<std::pair<uint64_t, int64_t>, uint64_t> &exit_counts) {
+  std::string report = absl::StrFormat("%-24s %14s %14s %8s\n", "Workload",
+                                       "Host ops/s", "Enclave ops/s", "Ratio");
+  for (const Workload &workload : workloads) {
+    const auto &host_workload = host.at(workload.name);
+    const auto &enclave_workload = enclave.at(workload.name);
+    for (const auto &command : host_workload) {
+      auto enclave_command = enclave_workload.find(command.first);
+      double enclave_ops = enclave_command == enclave_workload.end()
+                               ? 0
+                               : enclave_command->second;
+      absl::StrAppendFormat(&report, "%-24s %14.2f %14.2f %8.3f\n",
+                            absl::StrCat(workload.name, " ", command.first),
+                            command.second, enclave_ops,
+                            enclave_ops / command.second);
+    }
+  }
+
+  // Each workload runs every command |requests| times.
+  double total_requests = static_cast<double>(absl::GetFlag(FLAGS_requests)) *
+                          kCommandCount * workloads.size();
+  std::vector<std::pair<uint64_t, std::pair<uint64_t, int64_t>>> by_count;
+  uint64_t total_exits = 0;
+  for (const auto &entry : exit_counts) {
+    by_count.emplace_back(entry.second, entry.first);
+    total_exits += entry.second;
+  }
+  std::sort(by_count.rbegin(), by_count.rend());
+  size_t top_host_calls = std::max(absl::GetFlag(FLAGS_top_host_calls), 0);
+  if (by_count.size() > top_host_calls) {
+    by_count.resize(top_host_calls);
+  }
+
+  absl::StrAppendFormat(&report,
+                        "\nHost calls: %d in total, %.3f per request\n",
+                        total_exits, total_exits / total_requests);
+  absl::StrAppendFormat(&report, "%-10s %-8s %14s %12s\n", "Selector",
+                        "Sub key", "Count", "Per request");
+  for (const auto &entry : by_count) {
+    absl::StrAppendFormat(&report, "%-10d %-8d %14d %12.3f\n",
+                          entry.second.first, entry.second.second, entry.first,
+                          entry.first / total_requests);
+  }
+  return report;
+}
+
+Status Run(const char *argv0) {
+  std::string error;
+  std::unique_ptr<Runfiles> runfiles(Runfiles::Create(argv0, &error));
+  if (!runfiles) {
+    return Status(error::GoogleError::INTERNAL,
+                  absl::StrCat("Failed to find runfiles: ", error));
+  }
+  auto get_path = [&runfiles](const std::string &path) {
+    return runfiles->Rlocation(absl::StrCat("com_google_asylo/", path));
+  };
+  const std::string enclave_server_path =
+      get_path(absl::GetFlag(FLAGS_enclave_server_path));
+  const std::string host_server_path =
+      get_path(absl::GetFlag(FLAGS_host_server_path));
+  const std::string client_path = get_path(absl::GetFlag(FLAGS_client_path));
+  const std::string benchmark_path =
+      get_path(absl::GetFlag(FLAGS_benchmark_path));
+
+  // Redis may write files to its working directory.
+  const std::string tmpdir = absl::GetFlag(FLAGS_test_tmpdir);
+  if (chdir(tmpdir.c_str()) != 0) {
+    return Status(error::GoogleError::INTERNAL,
+                  absl::StrCat("Failed to change directory to ", tmpdir));
+  }
+
+  const std::vector<Workload> workloads = {
+      {"unpipelined", 1},
+      {absl::StrCat("pipeline=", absl::GetFlag(FLAGS_pipeline)),
+       absl::GetFlag(FLAGS_pipeline)},
+  };
+
+  // Unix domain sockets keep the network stack out of the measurement. Their
+  // paths must be short, so they are not placed in |tmpdir|.
+  const std::string host_socket_path =
+      absl::StrCat("/tmp/redis_benchmark_host_", getpid(), ".sock");
+  const std::string enclave_socket_path =
+      absl::StrCat("/tmp/redis_benchmark_enclave_", getpid(), ".sock");
+  const std::string exit_profile_path =
+      absl::StrCat(tmpdir, "/redis_exit_profile.txt");
+
+  // Snapshots are disabled so that they do not run during the measurement.
+  Throughput host_throughput;
+  ASYLO_ASSIGN_OR_RETURN(
+      host_throughput,
+      BenchmarkServer("host",
+                      {host_server_path, "--port", "0", "--unixsocket",
+                       host_socket_path, "--save", ""},
+                      host_socket_path, client_path, benchmark_path,
+                      workloads));
+
+  // ExecTester runs processes with an empty environment, so the exit profile
+  // path is passed to the enclave loader through env.
+  Throughput enclave_throughput;
+  ASYLO_ASSIGN_OR_RETURN(
+      enclave_throughput,
+      BenchmarkServer(
+          "enclave",
+          {"/usr/bin/env",
+           absl::StrCat(kExitProfilePathVariable, "=", exit_profile_path),
+           enclave_server_path, "--port", "0", "--unixsocket",
+           enclave_socket_path, "--save", ""},
+          enclave_socket_path, client_path, benchmark_path, workloads));
+
+  std::map<std::pair<uint64_t, int64_t>, uint64_t> exit_counts;
+  ASYLO_ASSIGN_OR_RETURN(exit_counts, ReadExitProfile(exit_profile_path));
+
+  std::string report = FormatReport(workloads, host_throughput,
+                                    enclave_throughput, exit_counts);
+  std::cout << report;
+  const std::string output_path = absl::GetFlag(FLAGS_output_path);
+  if (!output_path.empty()) {
+    std::ofstream output(output_path);
+    output << report;
+    if (!output) {
+      return Status(error::GoogleError::INTERNAL,
+                    absl::StrCat("Failed to write ", output_path));
+    }
+  }
+  return Status::OkStatus();
+}
+
+}  // namespace
+}  // namespace asylo
+
+int main(int argc, char *argv[]) {
+  absl::ParseCommandLine(argc, argv);
+  asylo::Status status = asylo::Run(argv[0]);
+  if (!status.ok()) {
+    LOG(ERROR) << "Redis benchmark failed: " << status;
+    return 1;
+  }
+  return 0;
+}
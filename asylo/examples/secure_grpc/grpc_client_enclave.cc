@@ -22,18 +22,18 @@
 #include <memory>
 #include <string>
 
+#include "absl/time/clock.h"
 #include "absl/time/time.h"
 #include "asylo/enclave.pb.h"
 #include "asylo/examples/grpc_server/translator_server.grpc.pb.h"
 #include "asylo/examples/secure_grpc/grpc_client_enclave.pb.h"
-#include "asylo/grpc/auth/enclave_channel_credentials.h"
+#include "asylo/grpc/auth/enclave_channel_pool.h"
+#include "asylo/grpc/auth/enclave_credentials_options.h"
 #include "asylo/grpc/auth/sgx_local_credentials_options.h"
 #include "asylo/trusted_application.h"
 #include "asylo/util/status.h"
 #include "asylo/util/status_macros.h"
 #include "asylo/util/statusor.h"
-#include "include/grpc/impl/codegen/gpr_types.h"
-#include "include/grpc/support/time.h"
 #include "include/grpcpp/grpcpp.h"
 
 namespace examples {
@@ -76,26 +76,19 @@ asylo::Status GrpcClientEnclave::Run(const asylo::EnclaveInput &input,
                          "Input must provide a non-empty RPC input");
   }
 
-  // The ::grpc::ChannelCredentials object configures the channel authentication
-  // mechanisms used by the client and server. This particular configuration
-  // enforces that both the client and server authenticate using SGX local
-  // attestation.
-  std::shared_ptr<::grpc::ChannelCredentials> channel_credentials =
-      EnclaveChannelCredentials(
-          asylo::BidirectionalSgxLocalCredentialsOptions());
-
-  // Connect a gRPC channel to the server specified in the EnclaveInput.
+  // The credentials options configure the channel authentication mechanisms
+  // used by the client and server. This particular configuration enforces that
+  // both the client and server authenticate using SGX local attestation.
+  //
+  // The channel pool connects a gRPC channel to the server specified in the
+  // EnclaveInput on first use, and hands the same authenticated channel to
+  // later calls.
+  asylo::EnclaveCredentialsOptions options =
+      asylo::BidirectionalSgxLocalCredentialsOptions();
+  ASYLO_RETURN_IF_ERROR(channel_pool_.Warm(
+      address, options, absl::Now() + kChannelDeadline));
   std::shared_ptr<::grpc::Channel> channel =
-      ::grpc::CreateChannel(address, channel_credentials);
-
-  gpr_timespec absolute_deadline = gpr_time_add(
-      gpr_now(GPR_CLOCK_REALTIME),
-      gpr_time_from_micros(absl::ToInt64Microseconds(kChannelDeadline),
-                           GPR_TIMESPAN));
-  if (!channel->WaitForConnected(absolute_deadline)) {
-    return asylo::Status(asylo::error::GoogleError::INTERNAL,
-                         "Failed to connect to server");
-  }
+      channel_pool_.GetChannel(address, options);
 
   GrpcClientEnclaveOutput *client_output =
       output->MutableExtension(client_enclave_output);
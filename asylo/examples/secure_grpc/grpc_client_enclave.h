@@ -23,6 +23,7 @@
 #include <string>
 
 #include "asylo/enclave.pb.h"
+#include "asylo/grpc/auth/enclave_channel_pool.h"
 #include "asylo/trusted_application.h"
 #include "asylo/util/status.h"
 
@@ -40,6 +41,11 @@ class GrpcClientEnclave : public asylo::TrustedApplication {
   // |output|.
   asylo::Status Run(const asylo::EnclaveInput &input,
                     asylo::EnclaveOutput *output) override;
+
+ private:
+  // Channels shared by all calls to Run(), so that only the first call to a
+  // server performs a handshake with it.
+  asylo::EnclaveChannelPool channel_pool_;
 };
 
 }  // namespace secure_grpc
@@ -22,8 +22,10 @@
 #include "absl/flags/flag.h"
 #include "absl/flags/parse.h"
 #include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
 #include "asylo/enclave_manager.h"
 #include "asylo/examples/secure_grpc/grpc_client_util.h"
+#include "asylo/examples/secure_grpc/load_test.h"
 #include "asylo/util/logging.h"
 #include "asylo/util/status.h"
 
@@ -34,6 +36,16 @@ ABSL_FLAG(int32_t, port, 0, "Port that the server listens to");
 ABSL_FLAG(std::string, word_to_translate, "", "Word to be translated");
 ABSL_FLAG(bool, debug, true, "Whether to use a debug enclave");
 
+ABSL_FLAG(bool, load_test, false,
+          "Whether to issue requests for --load_test_duration and report "
+          "throughput and latency instead of a single translation");
+ABSL_FLAG(int32_t, load_test_concurrency, 4,
+          "Number of requests in flight at once during the load test");
+ABSL_FLAG(absl::Duration, load_test_duration, absl::Seconds(10),
+          "How long the load test issues requests for");
+ABSL_FLAG(int32_t, load_test_request_padding, 0,
+          "Bytes of padding added to each request of the load test");
+
 int main(int argc, char *argv[]) {
   // Parse command-line arguments.
   absl::ParseCommandLine(argc, argv);
@@ -58,15 +70,36 @@ int main(int argc, char *argv[]) {
   LOG_IF(QFATAL, !status.ok())
       << "Loading " << enclave_path << " failed: " << status;
 
-  asylo::StatusOr<std::string> run_result =
-      examples::secure_grpc::GrpcClientEnclaveGetTranslation(
-          absl::StrCat(kServerAddress, ":", port), word_to_translate);
-  LOG_IF(QFATAL, !run_result.ok())
-      << "Getting translation for " << word_to_translate
-      << " failed: " << run_result.status();
+  if (absl::GetFlag(FLAGS_load_test)) {
+    int32_t request_padding = absl::GetFlag(FLAGS_load_test_request_padding);
+    LOG_IF(QFATAL, request_padding < 0)
+        << "--load_test_request_padding cannot be negative";
+
+    examples::secure_grpc::LoadTestOptions options;
+    options.address = absl::StrCat(kServerAddress, ":", port);
+    options.word_to_translate = word_to_translate;
+    options.concurrency = absl::GetFlag(FLAGS_load_test_concurrency);
+    options.duration = absl::GetFlag(FLAGS_load_test_duration);
+    options.request_padding = request_padding;
+    asylo::StatusOr<examples::secure_grpc::LoadTestReport> report_result =
+        examples::secure_grpc::RunLoadTest(options);
+    LOG_IF(QFATAL, !report_result.ok())
+        << "Load test failed: " << report_result.status();
+
+    std::cout << examples::secure_grpc::FormatLoadTestReport(
+                     report_result.ValueOrDie())
+              << std::endl;
+  } else {
+    asylo::StatusOr<std::string> run_result =
+        examples::secure_grpc::GrpcClientEnclaveGetTranslation(
+            absl::StrCat(kServerAddress, ":", port), word_to_translate);
+    LOG_IF(QFATAL, !run_result.ok())
+        << "Getting translation for " << word_to_translate
+        << " failed: " << run_result.status();
 
-  std::cout << "Translation for \"" << word_to_translate << "\" is \""
-            << run_result.ValueOrDie() << "\"" << std::endl;
+    std::cout << "Translation for \"" << word_to_translate << "\" is \""
+              << run_result.ValueOrDie() << "\"" << std::endl;
+  }
 
   status = examples::secure_grpc::DestroyGrpcClientEnclave();
   LOG_IF(QFATAL, !status.ok())
@@ -67,7 +67,8 @@ asylo::Status LoadGrpcClientEnclave(const std::string &enclave_path,
 }
 
 asylo::StatusOr<std::string> GrpcClientEnclaveGetTranslation(
-    const std::string &address, const std::string &word_to_translate) {
+    const std::string &address, const std::string &word_to_translate,
+    size_t request_padding) {
   asylo::EnclaveManager *manager = nullptr;
   ASYLO_ASSIGN_OR_RETURN(manager, asylo::EnclaveManager::Instance());
 
@@ -83,6 +84,10 @@ asylo::StatusOr<std::string> GrpcClientEnclaveGetTranslation(
       enclave_input.MutableExtension(client_enclave_input);
   input->set_server_address(address);
   input->mutable_translation_request()->set_input_word(word_to_translate);
+  if (request_padding > 0) {
+    input->mutable_translation_request()->set_padding(
+        std::string(request_padding, '\0'));
+  }
 
   asylo::EnclaveOutput enclave_output;
   ASYLO_RETURN_IF_ERROR(client->EnterAndRun(enclave_input, &enclave_output));
@@ -19,6 +19,7 @@
 #ifndef ASYLO_EXAMPLES_SECURE_GRPC_GRPC_CLIENT_UTIL_H_
 #define ASYLO_EXAMPLES_SECURE_GRPC_GRPC_CLIENT_UTIL_H_
 
+#include <cstddef>
 #include <string>
 
 #include "asylo/util/status.h"
@@ -37,10 +38,12 @@ asylo::Status LoadGrpcClientEnclave(const std::string &enclave_path,
 
 // Makes the GrpcClientEnclave issue a GetTranslation RPC for
 // |word_to_translate| to the server running at |address|, and returns the
-// translated word on success. |channel_deadline| is the channel-establishment
-// deadline. Returns a non-OK Status if the GrpcClientEnclave is not running.
+// translated word on success. The request carries |request_padding| bytes of
+// padding, which the server ignores. Returns a non-OK Status if the
+// GrpcClientEnclave is not running.
 asylo::StatusOr<std::string> GrpcClientEnclaveGetTranslation(
-    const std::string &address, const std::string &word_to_translate);
+    const std::string &address, const std::string &word_to_translate,
+    size_t request_padding = 0);
 
 // Destroys the GrpcClientEnclave and returns its finalization Status. Returns a
 // non-OK Status if the GrpcClientEnclave is not running.
@@ -0,0 +1,140 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/examples/secure_grpc/load_test.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <utility>
+
+#include "absl/strings/str_format.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "asylo/examples/secure_grpc/grpc_client_util.h"
+#include "asylo/util/status.h"
+
+namespace examples {
+namespace secure_grpc {
+namespace {
+
+// Returns the |percentile| of |sorted_latencies| by the nearest-rank method,
+// or zero if there are none.
+absl::Duration Percentile(const std::vector<absl::Duration> &sorted_latencies,
+                          double percentile) {
+  if (sorted_latencies.empty()) {
+    return absl::ZeroDuration();
+  }
+  size_t rank = static_cast<size_t>(
+      std::ceil(percentile / 100 * sorted_latencies.size()));
+  return sorted_latencies[std::max<size_t>(rank, 1) - 1];
+}
+
+}  // namespace
+
+LoadTestReport SummarizeLoadTest(std::vector<absl::Duration> latencies,
+                                 int64_t failures, absl::Duration elapsed) {
+  std::sort(latencies.begin(), latencies.end());
+  LoadTestReport report;
+  report.requests = latencies.size();
+  report.failures = failures;
+  report.elapsed = elapsed;
+  if (elapsed > absl::ZeroDuration()) {
+    report.qps = report.requests / absl::ToDoubleSeconds(elapsed);
+  }
+  report.latency_p50 = Percentile(latencies, 50);
+  report.latency_p90 = Percentile(latencies, 90);
+  report.latency_p99 = Percentile(latencies, 99);
+  report.latency_max = Percentile(latencies, 100);
+  return report;
+}
+
+std::string FormatLoadTestReport(const LoadTestReport &report) {
+  return absl::StrFormat(
+      "Requests: %d succeeded, %d failed in %s\n"
+      "Throughput: %.1f QPS\n"
+      "Latency: p50 %s, p90 %s, p99 %s, max %s",
+      report.requests, report.failures, absl::FormatDuration(report.elapsed),
+      report.qps, absl::FormatDuration(report.latency_p50),
+      absl::FormatDuration(report.latency_p90),
+      absl::FormatDuration(report.latency_p99),
+      absl::FormatDuration(report.latency_max));
+}
+
+asylo::StatusOr<LoadTestReport> RunLoadTest(const LoadTestOptions &options) {
+  if (options.concurrency < 1) {
+    return asylo::Status(asylo::error::GoogleError::INVALID_ARGUMENT,
+                         "Load test concurrency must be positive");
+  }
+
+  // Warm the channel of the enclave to the server, so that the handshake is
+  // not counted as the latency of a request.
+  asylo::StatusOr<std::string> warm_up = GrpcClientEnclaveGetTranslation(
+      options.address, options.word_to_translate, options.request_padding);
+  if (!warm_up.ok()) {
+    return warm_up.status();
+  }
+
+  absl::Mutex mu;
+  std::vector<absl::Duration> latencies;
+  int64_t failures = 0;
+  asylo::Status first_failure;
+
+  absl::Time start = absl::Now();
+  absl::Time deadline = start + options.duration;
+  std::vector<std::thread> threads;
+  threads.reserve(options.concurrency);
+  for (int i = 0; i < options.concurrency; ++i) {
+    threads.emplace_back([&] {
+      std::vector<absl::Duration> thread_latencies;
+      int64_t thread_failures = 0;
+      asylo::Status thread_failure;
+      for (absl::Time request_start = absl::Now(); request_start < deadline;) {
+        asylo::StatusOr<std::string> result = GrpcClientEnclaveGetTranslation(
+            options.address, options.word_to_translate,
+            options.request_padding);
+        absl::Time request_end = absl::Now();
+        if (result.ok()) {
+          thread_latencies.push_back(request_end - request_start);
+        } else if (thread_failures++ == 0) {
+          thread_failure = result.status();
+        }
+        request_start = request_end;
+      }
+      absl::MutexLock lock(&mu);
+      latencies.insert(latencies.end(), thread_latencies.begin(),
+                       thread_latencies.end());
+      failures += thread_failures;
+      if (first_failure.ok()) {
+        first_failure = thread_failure;
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  absl::Duration elapsed = absl::Now() - start;
+
+  if (latencies.empty() && !first_failure.ok()) {
+    return first_failure;
+  }
+  return SummarizeLoadTest(std::move(latencies), failures, elapsed);
+}
+
+}  // namespace secure_grpc
+}  // namespace examples
@@ -0,0 +1,88 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_EXAMPLES_SECURE_GRPC_LOAD_TEST_H_
+#define ASYLO_EXAMPLES_SECURE_GRPC_LOAD_TEST_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/time/time.h"
+#include "asylo/util/statusor.h"
+
+namespace examples {
+namespace secure_grpc {
+
+// Parameters of a load test of the translator server.
+struct LoadTestOptions {
+  // Address of the server.
+  std::string address;
+
+  // Word whose translation is requested.
+  std::string word_to_translate;
+
+  // Number of requests in flight at once, each issued by its own host thread
+  // entering the GrpcClientEnclave.
+  int concurrency = 1;
+
+  // How long requests are issued for.
+  absl::Duration duration = absl::Seconds(10);
+
+  // Bytes of padding added to each request, which the server ignores.
+  size_t request_padding = 0;
+};
+
+// Results of a load test.
+struct LoadTestReport {
+  // Numbers of requests that succeeded and failed.
+  int64_t requests = 0;
+  int64_t failures = 0;
+
+  // Time during which requests were issued.
+  absl::Duration elapsed;
+
+  // Successful requests per second.
+  double qps = 0;
+
+  // Latency percentiles of the successful requests, measured from the
+  // enclave entry to the enclave exit.
+  absl::Duration latency_p50;
+  absl::Duration latency_p90;
+  absl::Duration latency_p99;
+  absl::Duration latency_max;
+};
+
+// Summarizes a load test that ran for |elapsed|, with |failures| failed
+// requests and successful requests taking |latencies|.
+LoadTestReport SummarizeLoadTest(std::vector<absl::Duration> latencies,
+                                 int64_t failures, absl::Duration elapsed);
+
+// Returns a human-readable rendering of |report|.
+std::string FormatLoadTestReport(const LoadTestReport &report);
+
+// Issues GetTranslation RPCs through the GrpcClientEnclave as described by
+// |options| and reports on them. The GrpcClientEnclave must be loaded. Returns
+// the error of the first failed request if no request succeeded.
+asylo::StatusOr<LoadTestReport> RunLoadTest(const LoadTestOptions &options);
+
+}  // namespace secure_grpc
+}  // namespace examples
+
+#endif  // ASYLO_EXAMPLES_SECURE_GRPC_LOAD_TEST_H_
@@ -0,0 +1,78 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/examples/secure_grpc/load_test.h"
+
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/time/time.h"
+
+namespace examples {
+namespace secure_grpc {
+namespace {
+
+using ::testing::HasSubstr;
+
+TEST(LoadTestTest, SummarizesLatencyPercentiles) {
+  std::vector<absl::Duration> latencies;
+  for (int i = 100; i >= 1; --i) {
+    latencies.push_back(absl::Milliseconds(i));
+  }
+  LoadTestReport report =
+      SummarizeLoadTest(latencies, /*failures=*/3, absl::Seconds(2));
+  EXPECT_EQ(report.requests, 100);
+  EXPECT_EQ(report.failures, 3);
+  EXPECT_DOUBLE_EQ(report.qps, 50);
+  EXPECT_EQ(report.latency_p50, absl::Milliseconds(50));
+  EXPECT_EQ(report.latency_p90, absl::Milliseconds(90));
+  EXPECT_EQ(report.latency_p99, absl::Milliseconds(99));
+  EXPECT_EQ(report.latency_max, absl::Milliseconds(100));
+}
+
+TEST(LoadTestTest, SummarizesSingleRequest) {
+  LoadTestReport report =
+      SummarizeLoadTest({absl::Microseconds(700)}, /*failures=*/0,
+                        absl::Seconds(1));
+  EXPECT_EQ(report.latency_p50, absl::Microseconds(700));
+  EXPECT_EQ(report.latency_p99, absl::Microseconds(700));
+  EXPECT_EQ(report.latency_max, absl::Microseconds(700));
+}
+
+TEST(LoadTestTest, SummarizesNoRequests) {
+  LoadTestReport report =
+      SummarizeLoadTest({}, /*failures=*/5, absl::ZeroDuration());
+  EXPECT_EQ(report.requests, 0);
+  EXPECT_EQ(report.qps, 0);
+  EXPECT_EQ(report.latency_max, absl::ZeroDuration());
+}
+
+TEST(LoadTestTest, FormatsReport) {
+  LoadTestReport report =
+      SummarizeLoadTest({absl::Milliseconds(2)}, /*failures=*/1,
+                        absl::Seconds(1));
+  std::string text = FormatLoadTestReport(report);
+  EXPECT_THAT(text, HasSubstr("1 succeeded, 1 failed"));
+  EXPECT_THAT(text, HasSubstr("1.0 QPS"));
+  EXPECT_THAT(text, HasSubstr("p50 2ms"));
+}
+
+}  // namespace
+}  // namespace secure_grpc
+}  // namespace examples
@@ -0,0 +1,551 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/examples/sqlite/secure_vfs.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "asylo/secure_storage.h"
+#include "asylo/util/logging.h"
+#include "sqlite3.h"
+
+namespace asylo {
+namespace sqlite {
+namespace {
+
+// Key length expected by ENCLAVE_STORAGE_SET_KEY.
+constexpr size_t kKeyLength = 32;
+
+// State shared by all handles of the same file.
+struct SharedFile {
+  // The number of open handles of the file.
+  int open_count = 0;
+
+  // The number of handles holding at least a SHARED lock, and whether any
+  // handle holds the RESERVED, PENDING or EXCLUSIVE lock.
+  int shared_locks = 0;
+  bool reserved = false;
+  bool pending = false;
+  bool exclusive = false;
+
+  // The size the file was last truncated to, or -1 if it was not truncated
+  // since it was opened.
+  int64_t logical_size = -1;
+};
+
+// A file opened by the secure VFS.
+struct OpenFile {
+  int fd = -1;
+  std::string path;
+  bool delete_on_close = false;
+  uint32_t block_length = 0;
+
+  // The lock held by this handle, one of the SQLITE_LOCK_* levels, and whether
+  // this handle owns the RESERVED lock of the file.
+  int lock = SQLITE_LOCK_NONE;
+  bool owns_reserved = false;
+
+  SharedFile *shared = nullptr;
+};
+
+// The sqlite3_file subclass of the secure VFS. SQLite allocates and frees it,
+// so it only points at the state of the file.
+struct SecureFile {
+  sqlite3_file base;
+  OpenFile *file;
+};
+
+// State of the registered VFS.
+struct VfsState {
+  sqlite3_vfs vfs;
+  sqlite3_vfs *default_vfs;
+  SecureVfsOptions options;
+  std::atomic<uint64_t> next_temp_file{0};
+
+  absl::Mutex mu;
+  absl::flat_hash_map<std::string, std::unique_ptr<SharedFile>> files
+      ABSL_GUARDED_BY(mu);
+};
+
+VfsState *vfs_state = nullptr;
+
+bool IsValidBlockLength(uint32_t length) {
+  return length >= 128 && length <= 64 * 1024 && (length & (length - 1)) == 0;
+}
+
+OpenFile *GetFile(sqlite3_file *file) {
+  return reinterpret_cast<SecureFile *>(file)->file;
+}
+
+// Issues the ioctls which configure the secure file |fd| before its key is
+// set. Returns false on failure.
+bool ConfigureSecureFile(int fd, bool is_database) {
+  const SecureVfsOptions &options = vfs_state->options;
+  uint32_t block_length = is_database ? options.database_block_length
+                                      : options.journal_block_length;
+  if (ioctl(fd, ENCLAVE_STORAGE_SET_BLOCK_LENGTH, &block_length) != 0) {
+    return false;
+  }
+  // Journals are written once and read back at most once, so rebuilding their
+  // Merkle tree from the file on recovery is cheaper than keeping it on disk.
+  if (!is_database) {
+    uint32_t storage = ENCLAVE_STORAGE_MERKLE_TREE_IN_MEMORY;
+    if (ioctl(fd, ENCLAVE_STORAGE_SET_MERKLE_TREE_STORAGE, &storage) != 0) {
+      return false;
+    }
+  }
+
+  struct key_info key;
+  key.length = options.key.size();
+  key.data = const_cast<uint8_t *>(options.key.data());
+  if (ioctl(fd, ENCLAVE_STORAGE_SET_KEY, &key) != 0) {
+    return false;
+  }
+
+  if (is_database) {
+    uint64_t write_back = options.database_digest_write_back;
+    return write_back == 0 ||
+           ioctl(fd, ENCLAVE_STORAGE_SET_DIGEST_WRITE_BACK, &write_back) == 0;
+  }
+  uint64_t write_buffer = options.journal_write_buffer_length;
+  return write_buffer == 0 ||
+         ioctl(fd, ENCLAVE_STORAGE_SET_WRITE_BUFFER, &write_buffer) == 0;
+}
+
+int64_t PhysicalSize(const OpenFile *file) {
+  struct stat st;
+  if (fstat(file->fd, &st) != 0) {
+    return -1;
+  }
+  return st.st_size;
+}
+
+int SecureUnlock(sqlite3_file *sqlite_file, int level);
+
+int SecureClose(sqlite3_file *sqlite_file) {
+  SecureUnlock(sqlite_file, SQLITE_LOCK_NONE);
+  std::unique_ptr<OpenFile> file(GetFile(sqlite_file));
+  int result = close(file->fd);
+  {
+    absl::MutexLock lock(&vfs_state->mu);
+    if (--file->shared->open_count == 0) {
+      vfs_state->files.erase(file->path);
+    }
+  }
+  if (file->delete_on_close) {
+    unlink(file->path.c_str());
+  }
+  return result == 0 ? SQLITE_OK : SQLITE_IOERR_CLOSE;
+}
+
+int SecureRead(sqlite3_file *sqlite_file, void *buffer, int amount,
+               sqlite3_int64 offset) {
+  OpenFile *file = GetFile(sqlite_file);
+  int64_t readable = amount;
+  {
+    absl::MutexLock lock(&vfs_state->mu);
+    int64_t logical_size = file->shared->logical_size;
+    if (logical_size >= 0) {
+      readable = std::max<int64_t>(
+          0, std::min<int64_t>(readable, logical_size - offset));
+    }
+  }
+
+  uint8_t *destination = static_cast<uint8_t *>(buffer);
+  int64_t total = 0;
+  while (total < readable) {
+    ssize_t result =
+        pread(file->fd, destination + total, readable - total, offset + total);
+    if (result < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return SQLITE_IOERR_READ;
+    }
+    if (result == 0) {
+      break;
+    }
+    total += result;
+  }
+  if (total < amount) {
+    memset(destination + total, 0, amount - total);
+    return SQLITE_IOERR_SHORT_READ;
+  }
+  return SQLITE_OK;
+}
+
+int SecureWrite(sqlite3_file *sqlite_file, const void *buffer, int amount,
+                sqlite3_int64 offset) {
+  OpenFile *file = GetFile(sqlite_file);
+  if (lseek(file->fd, offset, SEEK_SET) != offset) {
+    return SQLITE_IOERR_SEEK;
+  }
+  const uint8_t *source = static_cast<const uint8_t *>(buffer);
+  int total = 0;
+  while (total < amount) {
+    ssize_t result = write(file->fd, source + total, amount - total);
+    if (result < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return errno == ENOSPC ? SQLITE_FULL : SQLITE_IOERR_WRITE;
+    }
+    total += result;
+  }
+
+  absl::MutexLock lock(&vfs_state->mu);
+  int64_t &logical_size = file->shared->logical_size;
+  if (logical_size >= 0) {
+    logical_size = std::max<int64_t>(logical_size, offset + amount);
+  }
+  return SQLITE_OK;
+}
+
+// Secure files cannot shrink, so truncation only hides the end of the file
+// from the handles of the enclave.
+int SecureTruncate(sqlite3_file *sqlite_file, sqlite3_int64 size) {
+  OpenFile *file = GetFile(sqlite_file);
+  int64_t physical_size = PhysicalSize(file);
+  if (physical_size < 0) {
+    return SQLITE_IOERR_TRUNCATE;
+  }
+  absl::MutexLock lock(&vfs_state->mu);
+  int64_t &logical_size = file->shared->logical_size;
+  int64_t current_size = logical_size >= 0 ? logical_size : physical_size;
+  if (size < current_size) {
+    logical_size = size;
+  }
+  return SQLITE_OK;
+}
+
+int SecureSync(sqlite3_file *sqlite_file, int flags) {
+  return fsync(GetFile(sqlite_file)->fd) == 0 ? SQLITE_OK : SQLITE_IOERR_FSYNC;
+}
+
+int SecureFileSize(sqlite3_file *sqlite_file, sqlite3_int64 *size) {
+  OpenFile *file = GetFile(sqlite_file);
+  int64_t physical_size = PhysicalSize(file);
+  if (physical_size < 0) {
+    return SQLITE_IOERR_FSTAT;
+  }
+  absl::MutexLock lock(&vfs_state->mu);
+  int64_t logical_size = file->shared->logical_size;
+  *size = logical_size >= 0 ? std::min(logical_size, physical_size)
+                            : physical_size;
+  return SQLITE_OK;
+}
+
+// Follows the locking protocol of the unix VFS, with the lock state kept in
+// trusted memory instead of in host file locks.
+int SecureLock(sqlite3_file *sqlite_file, int level) {
+  OpenFile *file = GetFile(sqlite_file);
+  if (file->lock >= level) {
+    return SQLITE_OK;
+  }
+  absl::MutexLock lock(&vfs_state->mu);
+  SharedFile *shared = file->shared;
+  switch (level) {
+    case SQLITE_LOCK_SHARED:
+      if (shared->pending || shared->exclusive) {
+        return SQLITE_BUSY;
+      }
+      ++shared->shared_locks;
+      file->lock = SQLITE_LOCK_SHARED;
+      return SQLITE_OK;
+    case SQLITE_LOCK_RESERVED:
+      if (shared->reserved) {
+        return SQLITE_BUSY;
+      }
+      shared->reserved = true;
+      file->owns_reserved = true;
+      file->lock = SQLITE_LOCK_RESERVED;
+      return SQLITE_OK;
+    case SQLITE_LOCK_EXCLUSIVE:
+      if (file->lock < SQLITE_LOCK_PENDING) {
+        if (shared->pending) {
+          return SQLITE_BUSY;
+        }
+        shared->pending = true;
+        file->lock = SQLITE_LOCK_PENDING;
+      }
+      if (shared->shared_locks > 1) {
+        return SQLITE_BUSY;
+      }
+      shared->exclusive = true;
+      file->lock = SQLITE_LOCK_EXCLUSIVE;
+      return SQLITE_OK;
+    default:
+      return SQLITE_MISUSE;
+  }
+}
+
+int SecureUnlock(sqlite3_file *sqlite_file, int level) {
+  OpenFile *file = GetFile(sqlite_file);
+  if (file->lock <= level) {
+    return SQLITE_OK;
+  }
+  absl::MutexLock lock(&vfs_state->mu);
+  SharedFile *shared = file->shared;
+  if (file->lock >= SQLITE_LOCK_PENDING) {
+    shared->pending = false;
+    shared->exclusive = false;
+  }
+  if (file->owns_reserved) {
+    shared->reserved = false;
+    file->owns_reserved = false;
+  }
+  if (level == SQLITE_LOCK_NONE) {
+    --shared->shared_locks;
+  }
+  file->lock = level;
+  return SQLITE_OK;
+}
+
+int SecureCheckReservedLock(sqlite3_file *sqlite_file, int *result) {
+  absl::MutexLock lock(&vfs_state->mu);
+  *result = GetFile(sqlite_file)->shared->reserved;
+  return SQLITE_OK;
+}
+
+int SecureFileControl(sqlite3_file *sqlite_file, int op, void *argument) {
+  return SQLITE_NOTFOUND;
+}
+
+// A write re-encrypts the whole blocks it covers, so a block is the smallest
+// unit a torn write can damage.
+int SecureSectorSize(sqlite3_file *sqlite_file) {
+  return GetFile(sqlite_file)->block_length;
+}
+
+int SecureDeviceCharacteristics(sqlite3_file *sqlite_file) { return 0; }
+
+const sqlite3_io_methods kSecureIoMethods = {
+    /*iVersion=*/1,
+    SecureClose,
+    SecureRead,
+    SecureWrite,
+    SecureTruncate,
+    SecureSync,
+    SecureFileSize,
+    SecureLock,
+    SecureUnlock,
+    SecureCheckReservedLock,
+    SecureFileControl,
+    SecureSectorSize,
+    SecureDeviceCharacteristics,
+};
+
+int SecureOpen(sqlite3_vfs *vfs, const char *name, sqlite3_file *sqlite_file,
+               int flags, int *out_flags) {
+  sqlite_file->pMethods = nullptr;
+  auto file = absl::make_unique<OpenFile>();
+  if (name) {
+    file->path = name;
+  } else {
+    uint64_t random;
+    vfs_state->default_vfs->xRandomness(vfs_state->default_vfs, sizeof(random),
+                                        reinterpret_cast<char *>(&random));
+    file->path = absl::StrCat(vfs_state->options.temp_directory,
+                              "/asylo_sqlite_", vfs_state->next_temp_file++,
+                              "_", absl::Hex(random));
+  }
+  file->delete_on_close = !name || (flags & SQLITE_OPEN_DELETEONCLOSE);
+
+  bool is_database = flags & SQLITE_OPEN_MAIN_DB;
+  file->block_length = is_database ? vfs_state->options.database_block_length
+                                   : vfs_state->options.journal_block_length;
+
+  int open_flags = O_SECURE;
+  open_flags |= (flags & SQLITE_OPEN_READWRITE) ? O_RDWR : O_RDONLY;
+  if (flags & SQLITE_OPEN_CREATE) {
+    open_flags |= O_CREAT;
+  }
+  if (flags & SQLITE_OPEN_EXCLUSIVE) {
+    open_flags |= O_EXCL;
+  }
+  file->fd = open(file->path.c_str(), open_flags, 0600);
+  if (file->fd < 0) {
+    return SQLITE_CANTOPEN;
+  }
+  if (!ConfigureSecureFile(file->fd, is_database)) {
+    LOG(ERROR) << "Failed to configure secure file " << file->path << ": "
+               << strerror(errno);
+    close(file->fd);
+    return SQLITE_CANTOPEN;
+  }
+
+  {
+    absl::MutexLock lock(&vfs_state->mu);
+    std::unique_ptr<SharedFile> &shared = vfs_state->files[file->path];
+    if (!shared) {
+      shared = absl::make_unique<SharedFile>();
+    }
+    ++shared->open_count;
+    file->shared = shared.get();
+  }
+
+  if (out_flags) {
+    *out_flags = flags;
+  }
+  reinterpret_cast<SecureFile *>(sqlite_file)->file = file.release();
+  sqlite_file->pMethods = &kSecureIoMethods;
+  return SQLITE_OK;
+}
+
+int SecureDelete(sqlite3_vfs *vfs, const char *name, int sync_directory) {
+  if (unlink(name) != 0) {
+    return errno == ENOENT ? SQLITE_IOERR_DELETE_NOENT : SQLITE_IOERR_DELETE;
+  }
+  return SQLITE_OK;
+}
+
+// The remaining methods do not touch file contents, so they are served by the
+// default VFS.
+
+int SecureAccess(sqlite3_vfs *vfs, const char *name, int flags, int *result) {
+  sqlite3_vfs *base = vfs_state->default_vfs;
+  return base->xAccess(base, name, flags, result);
+}
+
+int SecureFullPathname(sqlite3_vfs *vfs, const char *name, int length,
+                       char *result) {
+  sqlite3_vfs *base = vfs_state->default_vfs;
+  return base->xFullPathname(base, name, length, result);
+}
+
+void *SecureDlOpen(sqlite3_vfs *vfs, const char *path) {
+  sqlite3_vfs *base = vfs_state->default_vfs;
+  return base->xDlOpen(base, path);
+}
+
+void SecureDlError(sqlite3_vfs *vfs, int length, char *message) {
+  sqlite3_vfs *base = vfs_state->default_vfs;
+  base->xDlError(base, length, message);
+}
+
+void (*SecureDlSym(sqlite3_vfs *vfs, void *handle, const char *symbol))(void) {
+  sqlite3_vfs *base = vfs_state->default_vfs;
+  return base->xDlSym(base, handle, symbol);
+}
+
+void SecureDlClose(sqlite3_vfs *vfs, void *handle) {
+  sqlite3_vfs *base = vfs_state->default_vfs;
+  base->xDlClose(base, handle);
+}
+
+int SecureRandomness(sqlite3_vfs *vfs, int length, char *result) {
+  sqlite3_vfs *base = vfs_state->default_vfs;
+  return base->xRandomness(base, length, result);
+}
+
+int SecureSleep(sqlite3_vfs *vfs, int microseconds) {
+  sqlite3_vfs *base = vfs_state->default_vfs;
+  return base->xSleep(base, microseconds);
+}
+
+int SecureCurrentTime(sqlite3_vfs *vfs, double *time) {
+  sqlite3_vfs *base = vfs_state->default_vfs;
+  return base->xCurrentTime(base, time);
+}
+
+int SecureGetLastError(sqlite3_vfs *vfs, int length, char *message) {
+  sqlite3_vfs *base = vfs_state->default_vfs;
+  return base->xGetLastError(base, length, message);
+}
+
+int SecureCurrentTimeInt64(sqlite3_vfs *vfs, sqlite3_int64 *time) {
+  sqlite3_vfs *base = vfs_state->default_vfs;
+  return base->xCurrentTimeInt64(base, time);
+}
+
+}  // namespace
+
+Status RegisterSecureVfs(const SecureVfsOptions &options, bool make_default) {
+  if (options.key.size() != kKeyLength) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  absl::StrCat("Key must be ", kKeyLength, " bytes long"));
+  }
+  if (!IsValidBlockLength(options.database_block_length) ||
+      !IsValidBlockLength(options.journal_block_length)) {
+    return Status(
+        error::GoogleError::INVALID_ARGUMENT,
+        "Block lengths must be powers of two between 128 bytes and 64KiB");
+  }
+  if (vfs_state) {
+    return Status(error::GoogleError::FAILED_PRECONDITION,
+                  "The secure VFS is already registered");
+  }
+  if (sqlite3_initialize() != SQLITE_OK) {
+    return Status(error::GoogleError::INTERNAL, "Failed to initialize SQLite");
+  }
+  sqlite3_vfs *default_vfs = sqlite3_vfs_find(nullptr);
+  if (!default_vfs || default_vfs->iVersion < 2) {
+    return Status(error::GoogleError::FAILED_PRECONDITION,
+                  "SQLite has no suitable default VFS");
+  }
+
+  auto state = absl::make_unique<VfsState>();
+  state->default_vfs = default_vfs;
+  state->options = options;
+
+  sqlite3_vfs &vfs = state->vfs;
+  memset(&vfs, 0, sizeof(vfs));
+  vfs.iVersion = 2;
+  vfs.szOsFile = sizeof(SecureFile);
+  vfs.mxPathname = default_vfs->mxPathname;
+  vfs.zName = kSecureVfsName;
+  vfs.xOpen = SecureOpen;
+  vfs.xDelete = SecureDelete;
+  vfs.xAccess = SecureAccess;
+  vfs.xFullPathname = SecureFullPathname;
+  vfs.xDlOpen = SecureDlOpen;
+  vfs.xDlError = SecureDlError;
+  vfs.xDlSym = SecureDlSym;
+  vfs.xDlClose = SecureDlClose;
+  vfs.xRandomness = SecureRandomness;
+  vfs.xSleep = SecureSleep;
+  vfs.xCurrentTime = SecureCurrentTime;
+  vfs.xGetLastError = SecureGetLastError;
+  vfs.xCurrentTimeInt64 = SecureCurrentTimeInt64;
+
+  // The VFS must outlive every connection, so it is never unregistered.
+  vfs_state = state.release();
+  if (sqlite3_vfs_register(&vfs_state->vfs, make_default) != SQLITE_OK) {
+    return Status(error::GoogleError::INTERNAL,
+                  "Failed to register the secure VFS");
+  }
+  return Status::OkStatus();
+}
+
+}  // namespace sqlite
+}  // namespace asylo
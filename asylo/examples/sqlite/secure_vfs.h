@@ -0,0 +1,81 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_EXAMPLES_SQLITE_SECURE_VFS_H_
+#define ASYLO_EXAMPLES_SQLITE_SECURE_VFS_H_
+
+#include <cstdint>
+#include <string>
+
+#include "asylo/util/cleansing_types.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+namespace sqlite {
+
+// The name under which RegisterSecureVfs registers the secure VFS.
+constexpr char kSecureVfsName[] = "asylo-secure";
+
+// Options of the secure VFS.
+struct SecureVfsOptions {
+  // The 32-byte key which encrypts and authenticates every file of the VFS.
+  CleansingVector<uint8_t> key;
+
+  // The block length of newly created database files. Matching the page size
+  // of the database makes each page write encrypt exactly one block, instead
+  // of read-modify-writing the 128-byte blocks of a default secure file.
+  uint32_t database_block_length = 4096;
+
+  // The block length of newly created journals and temporary files.
+  uint32_t journal_block_length = 16384;
+
+  // The number of bytes of consecutive journal writes buffered in trusted
+  // memory and encrypted at once. SQLite syncs the journal before it touches
+  // the database, so buffered journal writes are never relied on before they
+  // are persisted.
+  uint64_t journal_write_buffer_length = 256 * 1024;
+
+  // If non-zero, the number of bytes which may be written to a database file
+  // before its digest is persisted, see ENCLAVE_STORAGE_SET_DIGEST_WRITE_BACK.
+  // The digest is always persisted by xSync, but a crash between two syncs
+  // leaves a database which fails verification, so this is off by default.
+  uint64_t database_digest_write_back = 0;
+
+  // The directory of the temporary files SQLite opens without a name.
+  std::string temp_directory = "/tmp";
+};
+
+// Registers the secure VFS as |kSecureVfsName|, and as the default VFS if
+// |make_default| is true. The secure VFS keeps every file SQLite opens in
+// secure storage, and shares locks between the connections of the enclave
+// only. It supports rollback journals, but not write-ahead logging, which
+// needs shared memory.
+//
+// Secure files cannot shrink, so the VFS emulates truncation by recording a
+// smaller logical size which it forgets when the last connection closes the
+// file. SQLite ignores the stale pages past the database size recorded in the
+// database header, but they keep using space on the host until the file is
+// rewritten by VACUUM INTO a new file.
+//
+// Must be called once, before any connection opens a database with the VFS.
+Status RegisterSecureVfs(const SecureVfsOptions &options, bool make_default);
+
+}  // namespace sqlite
+}  // namespace asylo
+
+#endif  // ASYLO_EXAMPLES_SQLITE_SECURE_VFS_H_
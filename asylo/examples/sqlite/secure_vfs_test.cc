@@ -0,0 +1,185 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/examples/sqlite/secure_vfs.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <string>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/flags/flag.h"
+#include "absl/strings/str_cat.h"
+#include "asylo/test/util/status_matchers.h"
+#include "asylo/test/util/test_flags.h"
+#include "asylo/util/cleansing_types.h"
+#include "sqlite3.h"
+
+namespace asylo {
+namespace sqlite {
+namespace {
+
+using ::testing::HasSubstr;
+using ::testing::Not;
+
+constexpr char kSecret[] = "The quick brown fox jumps over the lazy dog";
+
+class SecureVfsTest : public ::testing::Test {
+ protected:
+  static void SetUpTestSuite() {
+    SecureVfsOptions options;
+    options.key.assign(32, 0x5a);
+    options.temp_directory = absl::GetFlag(FLAGS_test_tmpdir);
+    ASSERT_THAT(RegisterSecureVfs(options, /*make_default=*/false), IsOk());
+  }
+
+  void SetUp() override {
+    path_ = absl::StrCat(absl::GetFlag(FLAGS_test_tmpdir), "/",
+                         ::testing::UnitTest::GetInstance()
+                             ->current_test_info()
+                             ->name(),
+                         ".db");
+  }
+
+  void TearDown() override { unlink(path_.c_str()); }
+
+  sqlite3 *Open() {
+    sqlite3 *db = nullptr;
+    EXPECT_EQ(sqlite3_open_v2(path_.c_str(), &db,
+                              SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE,
+                              kSecureVfsName),
+              SQLITE_OK);
+    return db;
+  }
+
+  static int Execute(sqlite3 *db, const std::string &sql) {
+    return sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr);
+  }
+
+  static int64_t QueryInt(sqlite3 *db, const std::string &sql) {
+    sqlite3_stmt *statement = nullptr;
+    EXPECT_EQ(sqlite3_prepare_v2(db, sql.c_str(), -1, &statement, nullptr),
+              SQLITE_OK);
+    EXPECT_EQ(sqlite3_step(statement), SQLITE_ROW);
+    int64_t value = sqlite3_column_int64(statement, 0);
+    sqlite3_finalize(statement);
+    return value;
+  }
+
+  std::string path_;
+};
+
+TEST_F(SecureVfsTest, RejectsInvalidOptions) {
+  SecureVfsOptions options;
+  options.key.assign(16, 0);
+  EXPECT_THAT(RegisterSecureVfs(options, /*make_default=*/false),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+
+  options.key.assign(32, 0);
+  options.database_block_length = 3000;
+  EXPECT_THAT(RegisterSecureVfs(options, /*make_default=*/false),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+
+  options.database_block_length = 4096;
+  EXPECT_THAT(RegisterSecureVfs(options, /*make_default=*/false),
+              StatusIs(error::GoogleError::FAILED_PRECONDITION));
+}
+
+TEST_F(SecureVfsTest, PersistsCommittedTransactions) {
+  sqlite3 *db = Open();
+  ASSERT_EQ(Execute(db, "CREATE TABLE t (id INTEGER PRIMARY KEY, value TEXT)"),
+            SQLITE_OK);
+  ASSERT_EQ(Execute(db, "INSERT INTO t VALUES (1, 'one'), (2, 'two')"),
+            SQLITE_OK);
+  ASSERT_EQ(sqlite3_close(db), SQLITE_OK);
+
+  db = Open();
+  EXPECT_EQ(QueryInt(db, "SELECT count(*) FROM t"), 2);
+  EXPECT_EQ(sqlite3_close(db), SQLITE_OK);
+}
+
+TEST_F(SecureVfsTest, RollbackOfGrowingTransaction) {
+  sqlite3 *db = Open();
+  ASSERT_EQ(Execute(db, "CREATE TABLE t (id INTEGER PRIMARY KEY, value BLOB);"
+                        "INSERT INTO t VALUES (1, zeroblob(100))"),
+            SQLITE_OK);
+
+  // The transaction grows the database, so rolling it back truncates it.
+  ASSERT_EQ(Execute(db, "BEGIN;"
+                        "WITH RECURSIVE n(i) AS (SELECT 2 UNION ALL "
+                        "SELECT i + 1 FROM n WHERE i < 1000) "
+                        "INSERT INTO t SELECT i, zeroblob(1000) FROM n;"
+                        "ROLLBACK"),
+            SQLITE_OK);
+  EXPECT_EQ(QueryInt(db, "SELECT count(*) FROM t"), 1);
+
+  ASSERT_EQ(Execute(db, "INSERT INTO t VALUES (2, zeroblob(100))"), SQLITE_OK);
+  ASSERT_EQ(sqlite3_close(db), SQLITE_OK);
+
+  db = Open();
+  EXPECT_EQ(QueryInt(db, "SELECT count(*) FROM t"), 2);
+  EXPECT_EQ(QueryInt(db, "SELECT integrity_check = 'ok' "
+                         "FROM pragma_integrity_check"),
+            1);
+  EXPECT_EQ(sqlite3_close(db), SQLITE_OK);
+}
+
+TEST_F(SecureVfsTest, LocksBetweenConnections) {
+  sqlite3 *first = Open();
+  sqlite3 *second = Open();
+  ASSERT_EQ(Execute(first, "CREATE TABLE t (id INTEGER PRIMARY KEY)"),
+            SQLITE_OK);
+
+  ASSERT_EQ(Execute(first, "BEGIN IMMEDIATE"), SQLITE_OK);
+  EXPECT_EQ(Execute(second, "BEGIN IMMEDIATE"), SQLITE_BUSY);
+  ASSERT_EQ(Execute(first, "INSERT INTO t VALUES (1); COMMIT"), SQLITE_OK);
+
+  ASSERT_EQ(Execute(second, "BEGIN IMMEDIATE; INSERT INTO t VALUES (2); COMMIT"),
+            SQLITE_OK);
+  EXPECT_EQ(QueryInt(first, "SELECT count(*) FROM t"), 2);
+  EXPECT_EQ(sqlite3_close(second), SQLITE_OK);
+  EXPECT_EQ(sqlite3_close(first), SQLITE_OK);
+}
+
+TEST_F(SecureVfsTest, StoresNoPlaintext) {
+  sqlite3 *db = Open();
+  ASSERT_EQ(Execute(db, absl::StrCat("CREATE TABLE t (value TEXT);"
+                                     "INSERT INTO t VALUES ('",
+                                     kSecret, "')")),
+            SQLITE_OK);
+  ASSERT_EQ(sqlite3_close(db), SQLITE_OK);
+
+  int fd = open(path_.c_str(), O_RDONLY);
+  ASSERT_GE(fd, 0);
+  std::string contents;
+  char buffer[4096];
+  ssize_t result;
+  while ((result = read(fd, buffer, sizeof(buffer))) > 0) {
+    contents.append(buffer, result);
+  }
+  close(fd);
+  EXPECT_FALSE(contents.empty());
+  EXPECT_THAT(contents, Not(HasSubstr(kSecret)));
+}
+
+}  // namespace
+}  // namespace sqlite
+}  // namespace asylo
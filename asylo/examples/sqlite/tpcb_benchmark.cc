@@ -0,0 +1,359 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Runs a TPC-B-like workload against SQLite and reports its throughput. Built
+// for the host, it measures SQLite on plain files. Built as an enclave, it
+// measures SQLite on plain host files, on secure files through the generic
+// POSIX layer, or on secure files through the secure VFS. See README.md for
+// how to run it.
+
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/strings/escaping.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "asylo/util/cleansing_types.h"
+#include "asylo/util/logging.h"
+#include "asylo/util/status.h"
+#include "asylo/util/status_macros.h"
+#include "asylo/util/statusor.h"
+#include "sqlite3.h"
+
+#ifdef __ASYLO__
+#include "asylo/examples/sqlite/secure_vfs.h"
+#include "asylo/secure_storage.h"
+#endif  // __ASYLO__
+
+ABSL_FLAG(std::string, mode, "native",
+          "Where SQLite keeps the database: \"native\" for plain files, "
+          "\"posix_secure\" for secure files opened through the POSIX layer, "
+          "or \"secure_vfs\" for secure files opened through the secure VFS. "
+          "The secure modes are only available in an enclave");
+ABSL_FLAG(std::string, database_path, "/tmp/tpcb.db",
+          "The path of the database, which is recreated by every run");
+ABSL_FLAG(int32_t, scale, 1, "The number of branches");
+ABSL_FLAG(int32_t, accounts_per_branch, 100000,
+          "The number of accounts of each branch");
+ABSL_FLAG(int32_t, transactions, 10000, "The number of transactions to run");
+ABSL_FLAG(int32_t, page_size, 4096, "The page size of the database");
+ABSL_FLAG(std::string, key, std::string(64, '0'),
+          "The hex-encoded 32-byte key of secure files. The default is public "
+          "and only suitable for benchmarking");
+
+namespace asylo {
+namespace {
+
+constexpr int kTellersPerBranch = 10;
+
+// Suffixes of the files SQLite keeps next to a database. In the enclave,
+// unlink() also removes the Merkle tree file of a secure file.
+constexpr const char *kDatabaseFileSuffixes[] = {"", "-journal"};
+
+// A prepared statement, finalized when it goes out of scope.
+class Statement {
+ public:
+  Statement() = default;
+  Statement(const Statement &) = delete;
+  Statement &operator=(const Statement &) = delete;
+  ~Statement() { sqlite3_finalize(statement_); }
+
+  sqlite3_stmt **mutable_statement() { return &statement_; }
+  sqlite3_stmt *get() const { return statement_; }
+
+ private:
+  sqlite3_stmt *statement_ = nullptr;
+};
+
+Status SqliteError(sqlite3 *db, absl::string_view context) {
+  return Status(error::GoogleError::INTERNAL,
+                absl::StrCat(context, ": ", sqlite3_errmsg(db)));
+}
+
+Status Execute(sqlite3 *db, const std::string &sql) {
+  char *message = nullptr;
+  if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &message) != SQLITE_OK) {
+    Status status(error::GoogleError::INTERNAL,
+                  absl::StrCat(sql, ": ", message ? message : "unknown error"));
+    sqlite3_free(message);
+    return status;
+  }
+  return Status::OkStatus();
+}
+
+Status Prepare(sqlite3 *db, const char *sql, Statement *statement) {
+  if (sqlite3_prepare_v2(db, sql, -1, statement->mutable_statement(),
+                         nullptr) != SQLITE_OK) {
+    return SqliteError(db, sql);
+  }
+  return Status::OkStatus();
+}
+
+// Runs |statement| to completion with |values| bound to its parameters, and
+// resets it.
+template <typename... Values>
+Status Run(sqlite3 *db, const Statement &statement, Values... values) {
+  int64_t bound[] = {0, static_cast<int64_t>(values)...};
+  for (int i = 1; i <= static_cast<int>(sizeof...(values)); ++i) {
+    sqlite3_bind_int64(statement.get(), i, bound[i]);
+  }
+  int result;
+  while ((result = sqlite3_step(statement.get())) == SQLITE_ROW) {
+  }
+  sqlite3_reset(statement.get());
+  if (result != SQLITE_DONE) {
+    return SqliteError(db, sqlite3_sql(statement.get()));
+  }
+  return Status::OkStatus();
+}
+
+#ifdef __ASYLO__
+
+CleansingVector<uint8_t> *posix_secure_key = nullptr;
+
+// Replaces the open() of the unix VFS, so that it opens every file it writes
+// as a secure file with the default block length.
+int OpenPosixSecure(const char *path, int flags, int mode) {
+  if ((flags & O_ACCMODE) == O_RDONLY && !(flags & O_CREAT)) {
+    // Directories are opened read-only to be synced, and cannot be secure.
+    return open(path, flags, mode);
+  }
+  int fd = open(path, flags | O_SECURE, mode);
+  if (fd < 0) {
+    return fd;
+  }
+  struct key_info key;
+  key.length = posix_secure_key->size();
+  key.data = posix_secure_key->data();
+  if (ioctl(fd, ENCLAVE_STORAGE_SET_KEY, &key) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+#endif  // __ASYLO__
+
+// Prepares SQLite to keep the database as selected by --mode, and returns the
+// name of the VFS to open it with.
+StatusOr<std::string> SetUpMode(const CleansingVector<uint8_t> &key) {
+  if (sqlite3_initialize() != SQLITE_OK) {
+    return Status(error::GoogleError::INTERNAL, "Failed to initialize SQLite");
+  }
+  std::string mode = absl::GetFlag(FLAGS_mode);
+  if (mode == "native") {
+    return std::string("unix");
+  }
+#ifdef __ASYLO__
+  if (mode == "posix_secure") {
+    // The unix-none VFS takes no host file locks, which secure files do not
+    // support. The unix VFSes share their system calls, so the override applies
+    // to all of them.
+    sqlite3_vfs *vfs = sqlite3_vfs_find("unix-none");
+    if (!vfs) {
+      return Status(error::GoogleError::INTERNAL, "No unix-none VFS");
+    }
+    posix_secure_key = new CleansingVector<uint8_t>(key);
+    if (vfs->xSetSystemCall(
+            vfs, "open",
+            reinterpret_cast<sqlite3_syscall_ptr>(OpenPosixSecure)) !=
+        SQLITE_OK) {
+      return Status(error::GoogleError::INTERNAL,
+                    "Failed to override the open() of the unix VFS");
+    }
+    return std::string("unix-none");
+  }
+  if (mode == "secure_vfs") {
+    sqlite::SecureVfsOptions options;
+    options.key = key;
+    options.database_block_length = absl::GetFlag(FLAGS_page_size);
+    ASYLO_RETURN_IF_ERROR(
+        sqlite::RegisterSecureVfs(options, /*make_default=*/false));
+    return std::string(sqlite::kSecureVfsName);
+  }
+#endif  // __ASYLO__
+  return Status(error::GoogleError::INVALID_ARGUMENT,
+                absl::StrCat("Unsupported mode: ", mode));
+}
+
+Status Populate(sqlite3 *db, int branches, int accounts_per_branch) {
+  ASYLO_RETURN_IF_ERROR(Execute(
+      db,
+      "CREATE TABLE branches (bid INTEGER PRIMARY KEY, bbalance INTEGER, "
+      "filler TEXT);"
+      "CREATE TABLE tellers (tid INTEGER PRIMARY KEY, bid INTEGER, "
+      "tbalance INTEGER, filler TEXT);"
+      "CREATE TABLE accounts (aid INTEGER PRIMARY KEY, bid INTEGER, "
+      "abalance INTEGER, filler TEXT);"
+      "CREATE TABLE history (tid INTEGER, bid INTEGER, aid INTEGER, "
+      "delta INTEGER, mtime INTEGER, filler TEXT);"));
+
+  // Rows are padded to the sizes TPC-B requires.
+  ASYLO_RETURN_IF_ERROR(Execute(db, "BEGIN"));
+  Statement branch;
+  Statement teller;
+  Statement account;
+  ASYLO_RETURN_IF_ERROR(Prepare(
+      db, "INSERT INTO branches VALUES (?, 0, zeroblob(88))", &branch));
+  ASYLO_RETURN_IF_ERROR(Prepare(
+      db, "INSERT INTO tellers VALUES (?, ?, 0, zeroblob(84))", &teller));
+  ASYLO_RETURN_IF_ERROR(Prepare(
+      db, "INSERT INTO accounts VALUES (?, ?, 0, zeroblob(84))", &account));
+  for (int64_t bid = 0; bid < branches; ++bid) {
+    ASYLO_RETURN_IF_ERROR(Run(db, branch, bid));
+    for (int64_t i = 0; i < kTellersPerBranch; ++i) {
+      ASYLO_RETURN_IF_ERROR(
+          Run(db, teller, bid * kTellersPerBranch + i, bid));
+    }
+    for (int64_t i = 0; i < accounts_per_branch; ++i) {
+      ASYLO_RETURN_IF_ERROR(
+          Run(db, account, bid * accounts_per_branch + i, bid));
+    }
+  }
+  return Execute(db, "COMMIT");
+}
+
+Status RunTransactions(sqlite3 *db, int branches, int accounts_per_branch,
+                       int transactions) {
+  Statement begin;
+  Statement update_account;
+  Statement select_account;
+  Statement update_teller;
+  Statement update_branch;
+  Statement insert_history;
+  Statement commit;
+  ASYLO_RETURN_IF_ERROR(Prepare(db, "BEGIN", &begin));
+  ASYLO_RETURN_IF_ERROR(Prepare(
+      db, "UPDATE accounts SET abalance = abalance + ? WHERE aid = ?",
+      &update_account));
+  ASYLO_RETURN_IF_ERROR(Prepare(
+      db, "SELECT abalance FROM accounts WHERE aid = ?", &select_account));
+  ASYLO_RETURN_IF_ERROR(Prepare(
+      db, "UPDATE tellers SET tbalance = tbalance + ? WHERE tid = ?",
+      &update_teller));
+  ASYLO_RETURN_IF_ERROR(Prepare(
+      db, "UPDATE branches SET bbalance = bbalance + ? WHERE bid = ?",
+      &update_branch));
+  ASYLO_RETURN_IF_ERROR(
+      Prepare(db,
+              "INSERT INTO history VALUES (?, ?, ?, ?, ?, zeroblob(22))",
+              &insert_history));
+  ASYLO_RETURN_IF_ERROR(Prepare(db, "COMMIT", &commit));
+
+  std::mt19937_64 random;
+  std::uniform_int_distribution<int64_t> branch_distribution(0, branches - 1);
+  std::uniform_int_distribution<int64_t> teller_distribution(
+      0, kTellersPerBranch - 1);
+  std::uniform_int_distribution<int64_t> account_distribution(
+      0, accounts_per_branch - 1);
+  std::uniform_int_distribution<int64_t> delta_distribution(-99999, 99999);
+  for (int i = 0; i < transactions; ++i) {
+    int64_t bid = branch_distribution(random);
+    int64_t tid = bid * kTellersPerBranch + teller_distribution(random);
+    int64_t aid = bid * accounts_per_branch + account_distribution(random);
+    int64_t delta = delta_distribution(random);
+    ASYLO_RETURN_IF_ERROR(Run(db, begin));
+    ASYLO_RETURN_IF_ERROR(Run(db, update_account, delta, aid));
+    ASYLO_RETURN_IF_ERROR(Run(db, select_account, aid));
+    ASYLO_RETURN_IF_ERROR(Run(db, update_teller, delta, tid));
+    ASYLO_RETURN_IF_ERROR(Run(db, update_branch, delta, bid));
+    ASYLO_RETURN_IF_ERROR(Run(db, insert_history, tid, bid, aid, delta,
+                              absl::ToUnixMicros(absl::Now())));
+    ASYLO_RETURN_IF_ERROR(Run(db, commit));
+  }
+  return Status::OkStatus();
+}
+
+Status RunBenchmark() {
+  CleansingVector<uint8_t> key;
+  std::string key_bytes = absl::HexStringToBytes(absl::GetFlag(FLAGS_key));
+  key.assign(key_bytes.begin(), key_bytes.end());
+
+  std::string vfs;
+  ASYLO_ASSIGN_OR_RETURN(vfs, SetUpMode(key));
+
+  std::string path = absl::GetFlag(FLAGS_database_path);
+  for (const char *suffix : kDatabaseFileSuffixes) {
+    unlink(absl::StrCat(path, suffix).c_str());
+  }
+
+  sqlite3 *db = nullptr;
+  int result = sqlite3_open_v2(
+      path.c_str(), &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE,
+      vfs.c_str());
+  if (result != SQLITE_OK) {
+    Status status = SqliteError(db, absl::StrCat("Failed to open ", path));
+    sqlite3_close(db);
+    return status;
+  }
+
+  int branches = absl::GetFlag(FLAGS_scale);
+  int accounts_per_branch = absl::GetFlag(FLAGS_accounts_per_branch);
+  int transactions = absl::GetFlag(FLAGS_transactions);
+  Status status = Execute(
+      db, absl::StrCat("PRAGMA page_size = ", absl::GetFlag(FLAGS_page_size),
+                       "; PRAGMA journal_mode = DELETE;"
+                       " PRAGMA synchronous = FULL;"));
+
+  absl::Time start = absl::Now();
+  if (status.ok()) {
+    status = Populate(db, branches, accounts_per_branch);
+  }
+  absl::Duration populate_time = absl::Now() - start;
+
+  start = absl::Now();
+  if (status.ok()) {
+    status = RunTransactions(db, branches, accounts_per_branch, transactions);
+  }
+  absl::Duration run_time = absl::Now() - start;
+  sqlite3_close(db);
+  ASYLO_RETURN_IF_ERROR(status);
+
+  std::cout << absl::StreamFormat(
+      "mode=%s vfs=%s branches=%d accounts=%d populate=%s transactions=%d "
+      "time=%s tps=%.1f latency=%s\n",
+      absl::GetFlag(FLAGS_mode), vfs, branches,
+      branches * accounts_per_branch, absl::FormatDuration(populate_time),
+      transactions, absl::FormatDuration(run_time),
+      transactions / absl::ToDoubleSeconds(run_time),
+      absl::FormatDuration(run_time / transactions));
+  return Status::OkStatus();
+}
+
+}  // namespace
+}  // namespace asylo
+
+int main(int argc, char *argv[]) {
+  absl::ParseCommandLine(argc, argv);
+  asylo::Status status = asylo::RunBenchmark();
+  if (!status.ok()) {
+    LOG(ERROR) << status;
+    return 1;
+  }
+  return 0;
+}
@@ -18,10 +18,11 @@
 
 #include "asylo/grpc/auth/core/client_ekep_handshaker.h"
 
-#include <openssl/curve25519.h>
 #include <openssl/rand.h>
 
 #include <algorithm>
+#include <utility>
+#include <vector>
 
 #include <google/protobuf/io/zero_copy_stream_impl_lite.h>
 #include "absl/memory/memory.h"
@@ -31,6 +32,8 @@
 #include "asylo/grpc/auth/core/ekep_crypto.h"
 #include "asylo/grpc/auth/core/ekep_error_space.h"
 #include "asylo/grpc/auth/core/ekep_handshaker_util.h"
+#include "asylo/grpc/auth/core/ekep_key_pool.h"
+#include "asylo/grpc/auth/core/ekep_session_cache.h"
 #include "asylo/grpc/auth/core/handshake.pb.h"
 #include "asylo/identity/identity.pb.h"
 #include "asylo/util/cleansing_types.h"
@@ -54,9 +57,12 @@ ClientEkepHandshaker::ClientEkepHandshaker(const EkepHandshakerOptions &options)
       self_assertions_(options.self_assertions),
       accepted_peer_assertions_(options.accepted_peer_assertions),
       available_cipher_suites_({CURVE25519_SHA256}),
-      available_record_protocols_({ALTSRP_AES128_GCM}),
+      available_record_protocols_(
+          {ALTSRP_AES128_GCM_REKEY, ALTSRP_AES128_GCM}),
       available_ekep_versions_({"EKEP v1"}),
       additional_authenticated_data_(options.additional_authenticated_data),
+      session_cache_(options.session_cache),
+      session_cache_key_(options.session_cache_key),
       selected_cipher_suite_(UNKNOWN_HANDSHAKE_CIPHER),
       selected_record_protocol_(UNKNOWN_RECORD_PROTOCOL),
       expected_message_type_(SERVER_PRECOMMIT),
@@ -153,6 +159,8 @@ ClientEkepHandshaker::Result ClientEkepHandshaker::HandleHandshakeMessage(
              selected_cipher_suite_, selected_record_protocol_, master_secret_)
              .ok()) {
       handshaker_state_ = HandshakeState::ABORTED;
+    } else {
+      CacheSession();
     }
   }
 
@@ -226,6 +234,14 @@ Status ClientEkepHandshaker::HandleServerPrecommit(
                                server_precommit.challenge().size()));
   }
 
+  if (server_precommit.resumed()) {
+    return ResumeSession(server_precommit);
+  }
+
+  // The server declined to resume the offered session. Its ticket was
+  // single-use, so the session cannot be offered again.
+  offered_session_.reset();
+
   // Verify that the server requested a non-empty subset of the assertions that
   // were offered by the client.
   if (server_precommit.server_requests().empty()) {
@@ -270,6 +286,48 @@ Status ClientEkepHandshaker::HandleServerPrecommit(
                        server_precommit.server_requests().cend(), output);
 }
 
+Status ClientEkepHandshaker::ResumeSession(
+    const ServerPrecommit &server_precommit) {
+  if (!offered_session_.has_value()) {
+    return Status(Abort::PROTOCOL_ERROR,
+                  "Server resumed a session that was not offered");
+  }
+  const EkepSession &session = offered_session_.value();
+
+  if (selected_ekep_version_ != session.ekep_version ||
+      selected_cipher_suite_ != session.cipher_suite ||
+      selected_record_protocol_ != session.record_protocol) {
+    return Status(Abort::PROTOCOL_ERROR,
+                  "Server selected parameters that differ from the resumed "
+                  "session");
+  }
+
+  if (!server_precommit.server_offers().empty() ||
+      !server_precommit.server_requests().empty()) {
+    return Status(Abort::PROTOCOL_ERROR,
+                  "Server exchanged assertions in a resumed handshake");
+  }
+
+  // The server's identities were verified in the handshake that established
+  // the session, and only a participant in that handshake knows the
+  // resumption secret.
+  for (const EnclaveIdentity &identity :
+       session.peer_identities.identities()) {
+    AddPeerIdentity(identity);
+  }
+
+  // The server follows up with a ServerFinish in a resumed handshake.
+  expected_message_type_ = SERVER_FINISH;
+
+  // Derive EKEP Master and Authenticator secrets using the current transcript:
+  //   hash(ClientPrecommit || ServerPrecommit)
+  std::string transcript_hash;
+  ASYLO_RETURN_IF_ERROR(GetTranscriptHash(&transcript_hash));
+  return DeriveResumedSecrets(selected_cipher_suite_, transcript_hash,
+                              session.resumption_secret, &master_secret_,
+                              &authenticator_secret_);
+}
+
 Status ClientEkepHandshaker::HandleServerId(const google::protobuf::Message &message) {
   const auto *server_id_ptr = dynamic_cast<const ServerId *>(&message);
   if (!server_id_ptr) {
@@ -296,19 +354,6 @@ Status ClientEkepHandshaker::HandleServerId(const google::protobuf::Message &mes
                     "Server provided an assertion that was not previously "
                     "offered");
     }
-
-    EnclaveIdentity identity;
-    // Note that assertion verifiers were verified during creation of the
-    // handshaker so there is no need to check whether the call to
-    // GetEnclaveAssertionVerifier() returns nullptr.
-    Status status =
-        GetEnclaveAssertionVerifier(assertion.description())
-            ->Verify(/*user_data=*/ekep_context, assertion, &identity);
-    if (!status.ok()) {
-      LOG(ERROR) << "Assertion could not be verified: " << status;
-      return Status(Abort::BAD_ASSERTION, "Assertion could not be verified");
-    }
-    AddPeerIdentity(identity);
     expected_peer_assertions_.erase(desc_it);
   }
 
@@ -318,6 +363,20 @@ Status ClientEkepHandshaker::HandleServerId(const google::protobuf::Message &mes
                   "Server did not provide all expected assertions");
   }
 
+  // Verify all assertions concurrently. Note that assertion verifiers were
+  // verified during creation of the handshaker so there is no need to check
+  // whether the calls to GetEnclaveAssertionVerifier() return nullptr.
+  std::vector<EnclaveIdentity> identities;
+  Status status =
+      VerifyAssertions(ekep_context, server_id.assertions(), &identities);
+  if (!status.ok()) {
+    LOG(ERROR) << "Assertion could not be verified: " << status;
+    return Status(Abort::BAD_ASSERTION, "Assertion could not be verified");
+  }
+  for (const EnclaveIdentity &identity : identities) {
+    AddPeerIdentity(identity);
+  }
+
   std::vector<uint8_t> server_public_key;
   std::copy(server_id.dh_public_key().cbegin(),
             server_id.dh_public_key().cend(),
@@ -360,6 +419,10 @@ Status ClientEkepHandshaker::HandleServerFinish(const google::protobuf::Message
                   "Server handshake authenticator value is incorrect");
   }
 
+  if (session_cache_) {
+    session_ticket_ = server_finish.session_ticket();
+  }
+
   return WriteClientFinish(output);
 }
 
@@ -391,6 +454,15 @@ Status ClientEkepHandshaker::WriteClientPrecommit(std::string *output) {
   }
   client_precommit.set_challenge(challenge.data(), challenge.size());
 
+  // Offer to resume the last session with the server. The offer includes all
+  // the fields of a regular ClientPrecommit in case the server declines.
+  if (session_cache_) {
+    offered_session_ = session_cache_->Take(session_cache_key_);
+    if (offered_session_.has_value()) {
+      client_precommit.set_session_ticket(offered_session_->ticket);
+    }
+  }
+
   for (const AssertionDescription &description : self_assertions_) {
     // Note that assertion generators were verified during creation of the
     // handshaker so there is no need to check whether the call to
@@ -428,14 +500,16 @@ Status ClientEkepHandshaker::WriteClientId(
     google::protobuf::RepeatedPtrField<AssertionRequest>::const_iterator requests_first,
     google::protobuf::RepeatedPtrField<AssertionRequest>::const_iterator requests_last,
     std::string *output) {
-  // Generate an ephemeral Diffie-Hellman key-pair for the negotiated cipher
-  // suite.
+  // Take an ephemeral Diffie-Hellman key-pair for the negotiated cipher suite.
+  // The key-pair was generated ahead of the handshake and is not handed out to
+  // any other handshake.
   switch (selected_cipher_suite_) {
-    case CURVE25519_SHA256:
-      dh_public_key_.resize(X25519_PUBLIC_VALUE_LEN);
-      dh_private_key_.resize(X25519_PRIVATE_KEY_LEN);
-      X25519_keypair(dh_public_key_.data(), dh_private_key_.data());
+    case CURVE25519_SHA256: {
+      EkepEphemeralKey key = EkepKeyPool::GetInstance()->Take();
+      dh_public_key_ = std::move(key.public_key);
+      dh_private_key_ = std::move(key.private_key);
       break;
+    }
     default:
       LOG(ERROR) << "Client handshaker has bad cipher suite configuration";
       return Status(Abort::INTERNAL_ERROR,
@@ -462,19 +536,19 @@ Status ClientEkepHandshaker::WriteClientId(
     return Status(Abort::INTERNAL_ERROR, "Assertion generation failed");
   }
 
+  // Generate the requested assertions concurrently. Note that assertion
+  // generators were verified during creation of the handshaker so there is no
+  // need to check whether the calls to GetEnclaveAssertionGenerator() return
+  // nullptr.
+  std::vector<const AssertionRequest *> requests;
   for (auto it = requests_first; it != requests_last; ++it) {
-    const AssertionRequest &request = *it;
-
-    // Note that assertion generators were verified during creation of the
-    // handshaker so there is no need to check whether the call to
-    // GetEnclaveAssertionGenerator() returns nullptr.
-    Status status =
-        GetEnclaveAssertionGenerator(request.description())
-            ->Generate(ekep_context, request, client_id.add_assertions());
-    if (!status.ok()) {
-      LOG(ERROR) << "Assertion generation failed: " << status;
-      return Status(Abort::INTERNAL_ERROR, "Assertion generation failed");
-    }
+    requests.push_back(&*it);
+  }
+  Status status = GenerateAssertions(ekep_context, requests,
+                                     client_id.mutable_assertions());
+  if (!status.ok()) {
+    LOG(ERROR) << "Assertion generation failed: " << status;
+    return Status(Abort::INTERNAL_ERROR, "Assertion generation failed");
   }
 
   ASYLO_RETURN_IF_ERROR(
@@ -500,6 +574,37 @@ Status ClientEkepHandshaker::WriteClientFinish(std::string *output) {
   return WriteFrameAndUpdateTranscript(CLIENT_FINISH, client_finish, output);
 }
 
+void ClientEkepHandshaker::CacheSession() {
+  if (!session_cache_ || session_ticket_.empty()) {
+    return;
+  }
+
+  EkepSession session;
+  session.ticket = session_ticket_;
+  session.ekep_version = selected_ekep_version_;
+  session.cipher_suite = selected_cipher_suite_;
+  session.record_protocol = selected_record_protocol_;
+  session.peer_identities = peer_identities();
+
+  // A resumed session keeps the expiration of the session that was attested.
+  session.expiration = offered_session_.has_value()
+                           ? offered_session_->expiration
+                           : session_cache_->NewSessionExpiration();
+
+  std::string transcript_hash;
+  Status status = GetTranscriptHash(&transcript_hash);
+  if (status.ok()) {
+    status = DeriveResumptionSecret(selected_cipher_suite_, transcript_hash,
+                                    master_secret_,
+                                    &session.resumption_secret);
+  }
+  if (!status.ok()) {
+    LOG(WARNING) << "Session cannot be resumed: " << status;
+    return;
+  }
+  session_cache_->Insert(session_cache_key_, std::move(session));
+}
+
 bool ClientEkepHandshaker::SetSelectedEkepVersion(
     const std::string &ekep_version) {
   // Verify that the selected EKEP version was offered by the client.
@@ -26,8 +26,10 @@
 
 #include <google/protobuf/io/zero_copy_stream.h>
 #include <google/protobuf/message.h>
+#include "absl/types/optional.h"
 #include "asylo/grpc/auth/core/ekep_handshaker.h"
 #include "asylo/grpc/auth/core/ekep_handshaker_util.h"
+#include "asylo/grpc/auth/core/ekep_session_cache.h"
 #include "asylo/util/cleansing_types.h"
 
 namespace asylo {
@@ -36,6 +38,11 @@ namespace asylo {
 // handshake. It handles ServerPrecommit, ServerId, and ServerFinish messages
 // from the server and sends ClientPrecommit, ClientId, and ClientFinish
 // messages to the server.
+//
+// If configured with a session cache, the handshaker offers to resume the last
+// session established with the same server. If the server accepts, the
+// ServerPrecommit is directly followed by the ServerFinish and neither
+// participant sends any assertions.
 class ClientEkepHandshaker final : public EkepHandshaker {
  public:
   // Creates a ClientEkepHandshaker configured with the given |options|, if
@@ -77,10 +84,17 @@ class ClientEkepHandshaker final : public EkepHandshaker {
 
   // Validates the ServerPrecommit handshake message contained in |message|. If
   // validation succeeds, writes the ClientId message to |output| and updates
-  // the handshake transcript with the outgoing ClientId frame.
+  // the handshake transcript with the outgoing ClientId frame. If the server
+  // resumed the offered session, derives the EKEP secrets instead and writes
+  // nothing to |output|.
   Status HandleServerPrecommit(const google::protobuf::Message &message,
                                std::string *output);
 
+  // Validates the resumption of the offered session by |server_precommit|. If
+  // validation succeeds, restores the peer identities of the session and
+  // derives the EKEP secrets from its resumption secret.
+  Status ResumeSession(const ServerPrecommit &server_precommit);
+
   // Validates the ServerId handshake message contained in |message|.
   Status HandleServerId(const google::protobuf::Message &message);
 
@@ -106,6 +120,10 @@ class ClientEkepHandshaker final : public EkepHandshaker {
   // transcript.
   Status WriteClientFinish(std::string *output);
 
+  // Adds the session established by the completed handshake to the session
+  // cache, if the server issued a session ticket.
+  void CacheSession();
+
   // Sets the handshaker's selected EKEP version to |ekep_version|. Returns
   // false if |ekep_version| is not a valid EKEP version for this handshaker.
   bool SetSelectedEkepVersion(const std::string &ekep_version);
@@ -140,6 +158,19 @@ class ClientEkepHandshaker final : public EkepHandshaker {
   // Additional data that is authenticated during the handshake.
   const std::string additional_authenticated_data_;
 
+  // Cache of resumable sessions, or nullptr if session resumption is disabled.
+  const std::shared_ptr<EkepSessionCache> session_cache_;
+
+  // Key of the sessions with the server in |session_cache_|.
+  const std::string session_cache_key_;
+
+  // The session offered for resumption in the ClientPrecommit. This field is
+  // cleared if the server does not resume the session.
+  absl::optional<EkepSession> offered_session_;
+
+  // The session ticket issued by the server in the ServerFinish, if any.
+  std::string session_ticket_;
+
   // Assertions expected from the peer. This field is populated after validation
   // of the ServerPrecommit message.
   std::vector<AssertionDescription> expected_peer_assertions_;
@@ -36,6 +36,7 @@
 #include "asylo/grpc/auth/core/ekep_error_space.h"
 #include "asylo/util/proto_enum_util.h"
 #include "asylo/util/status.h"
+#include "asylo/util/status_macros.h"
 
 namespace asylo {
 namespace {
@@ -45,6 +46,8 @@ constexpr size_t kEkepSecretSize =
 
 constexpr char kEkepHkdfSalt[] = "EKEP Handshake v1";
 constexpr char kEkepHkdfSaltRecordProtocol[] = "EKEP Record Protocol v1";
+constexpr char kEkepHkdfSaltResumption[] = "EKEP Resumption v1";
+constexpr char kEkepHkdfSaltResumptionSecret[] = "EKEP Resumption Secret v1";
 constexpr char kServerAuthenticatedText[] = "EKEP Handshake v1: Server Finish";
 constexpr char kClientAuthenticatedText[] = "EKEP Handshake v1: Client Finish";
 
@@ -78,6 +81,50 @@ Status Hmac(const HandshakeCipher &ciphersuite, ByteContainerView key,
   return Status::OkStatus();
 }
 
+// Returns the hash function used for HKDF by |ciphersuite| in |digest|.
+//
+// If the ciphersuite is unsupported, returns BAD_HANDSHAKE_CIPHER.
+Status GetHkdfDigest(const HandshakeCipher &ciphersuite,
+                     const EVP_MD **digest) {
+  switch (ciphersuite) {
+    case CURVE25519_SHA256:
+      *digest = EVP_sha256();
+      return Status::OkStatus();
+    default:
+      return Status(
+          Abort::BAD_HANDSHAKE_CIPHER,
+          "Ciphersuite not supported: " + ProtoEnumValueName(ciphersuite));
+  }
+}
+
+// Derives the master and authenticator secrets from |input_key| using HKDF
+// initialized with |digest|, |salt|, and |transcript_hash|. On success, appends
+// the master secret to |master_secret| and the authenticator secret to
+// |authenticator_secret|.
+Status ExpandSecrets(const EVP_MD *digest, ByteContainerView input_key,
+                     const std::string &salt, ByteContainerView transcript_hash,
+                     CleansingVector<uint8_t> *master_secret,
+                     CleansingVector<uint8_t> *authenticator_secret) {
+  CleansingVector<uint8_t> output_key;
+  output_key.resize(kEkepSecretSize);
+  if (!HKDF(output_key.data(), kEkepSecretSize, digest, input_key.data(),
+            input_key.size(), reinterpret_cast<const uint8_t *>(salt.data()),
+            salt.size(), transcript_hash.data(), transcript_hash.size())) {
+    LOG(ERROR) << "HKDF failed: " << BsslLastErrorString();
+    return Status(Abort::INTERNAL_ERROR, "Internal error");
+  }
+
+  // Copy the master secret.
+  std::copy(output_key.cbegin(), output_key.cbegin() + kEkepMasterSecretSize,
+            std::back_inserter(*master_secret));
+
+  // Copy the authenticator secret.
+  std::copy(output_key.cbegin() + kEkepMasterSecretSize, output_key.cend(),
+            std::back_inserter(*authenticator_secret));
+
+  return Status::OkStatus();
+}
+
 }  // namespace
 
 Status DeriveSecrets(const HandshakeCipher &ciphersuite,
@@ -123,25 +170,44 @@ Status DeriveSecrets(const HandshakeCipher &ciphersuite,
   }
 
   // Derive the master and authenticator secrets using HKDF.
-  std::string salt(kEkepHkdfSalt);
-  CleansingVector<uint8_t> output_key;
-  output_key.resize(kEkepSecretSize);
-  if (!HKDF(output_key.data(), kEkepSecretSize, digest, shared_secret.data(),
-            shared_secret.size(),
+  return ExpandSecrets(digest, shared_secret, kEkepHkdfSalt, transcript_hash,
+                       master_secret, authenticator_secret);
+}
+
+Status DeriveResumedSecrets(const HandshakeCipher &ciphersuite,
+                            ByteContainerView transcript_hash,
+                            ByteContainerView resumption_secret,
+                            CleansingVector<uint8_t> *master_secret,
+                            CleansingVector<uint8_t> *authenticator_secret) {
+  const EVP_MD *digest = nullptr;
+  ASYLO_RETURN_IF_ERROR(GetHkdfDigest(ciphersuite, &digest));
+  if (resumption_secret.size() != kEkepResumptionSecretSize) {
+    return Status(Abort::INTERNAL_ERROR,
+                  absl::StrCat("Resumption secret has incorrect size: ",
+                               resumption_secret.size()));
+  }
+  return ExpandSecrets(digest, resumption_secret, kEkepHkdfSaltResumption,
+                       transcript_hash, master_secret, authenticator_secret);
+}
+
+Status DeriveResumptionSecret(const HandshakeCipher &ciphersuite,
+                              ByteContainerView transcript_hash,
+                              ByteContainerView master_secret,
+                              CleansingVector<uint8_t> *resumption_secret) {
+  resumption_secret->clear();
+  const EVP_MD *digest = nullptr;
+  ASYLO_RETURN_IF_ERROR(GetHkdfDigest(ciphersuite, &digest));
+
+  std::string salt(kEkepHkdfSaltResumptionSecret);
+  resumption_secret->resize(kEkepResumptionSecretSize);
+  if (!HKDF(resumption_secret->data(), resumption_secret->size(), digest,
+            master_secret.data(), master_secret.size(),
             reinterpret_cast<const uint8_t *>(salt.data()), salt.size(),
             transcript_hash.data(), transcript_hash.size())) {
     LOG(ERROR) << "HKDF failed: " << BsslLastErrorString();
+    resumption_secret->clear();
     return Status(Abort::INTERNAL_ERROR, "Internal error");
   }
-
-  // Copy the master secret.
-  std::copy(output_key.cbegin(), output_key.cbegin() + kEkepMasterSecretSize,
-            std::back_inserter(*master_secret));
-
-  // Copy the authenticator secret.
-  std::copy(output_key.cbegin() + kEkepMasterSecretSize, output_key.cend(),
-            std::back_inserter(*authenticator_secret));
-
   return Status::OkStatus();
 }
 
@@ -167,14 +233,9 @@ Status DeriveRecordProtocolKey(const HandshakeCipher &ciphersuite,
   switch (record_protocol) {
     case ALTSRP_AES128_GCM:
       record_protocol_key->resize(kAltsRecordProtocolAes128GcmKeySize);
-      // Randomize the key bytes just in case the key is mistakenly used even
-      // when the key derivation fails. The byte-sequence in uninitialized
-      // memory could be predictable and, as a result, an attacker may be able
-      // to recover data that is encrypted by a key whose underlying bytes are
-      // uninitialized. Initializing the key with a truly random value makes it
-      // impossible for an attacker to recover any data that is mistakenly
-      // encrypted with the key.
-      RAND_bytes(record_protocol_key->data(), record_protocol_key->size());
+      break;
+    case ALTSRP_AES128_GCM_REKEY:
+      record_protocol_key->resize(kAltsRecordProtocolAes128GcmRekeyKeySize);
       break;
     default:
       return Status(Abort::BAD_RECORD_PROTOCOL,
@@ -182,6 +243,14 @@ Status DeriveRecordProtocolKey(const HandshakeCipher &ciphersuite,
                         ProtoEnumValueName(record_protocol));
   }
 
+  // Randomize the key bytes just in case the key is mistakenly used even when
+  // the key derivation fails. The byte-sequence in uninitialized memory could
+  // be predictable and, as a result, an attacker may be able to recover data
+  // that is encrypted by a key whose underlying bytes are uninitialized.
+  // Initializing the key with a truly random value makes it impossible for an
+  // attacker to recover any data that is mistakenly encrypted with the key.
+  RAND_bytes(record_protocol_key->data(), record_protocol_key->size());
+
   std::string salt(kEkepHkdfSaltRecordProtocol);
   if (!HKDF(record_protocol_key->data(), record_protocol_key->size(), digest,
             master_secret.data(), master_secret.size(),
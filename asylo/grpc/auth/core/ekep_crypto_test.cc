@@ -67,6 +67,37 @@ constexpr char kTestAuthenticatorSecret[] =
 //     kTestRecordProtocolKey
 constexpr char kTestRecordProtocolKey[] = "c7e0f5436c0fe4efdb6327469651b9fe";
 
+// Test vector for rekeying record protocol key derivation.
+//   Inputs:
+//     kTestMasterSecret, kTestTranscriptHash
+//   Outputs:
+//     kTestRekeyRecordProtocolKey
+constexpr char kTestRekeyRecordProtocolKey[] =
+    "c7e0f5436c0fe4efdb6327469651b9fe0b50787e2c74e2211e57ae267fac1399cb1a07f5"
+    "74c35315fe4599c4";
+
+// Test vector for resumption secret derivation.
+//   Inputs:
+//     kTestMasterSecret, kTestTranscriptHash
+//   Outputs:
+//     kTestResumptionSecret
+constexpr char kTestResumptionSecret[] =
+    "f278e2c2aa9bd4915654f2b89c91a091020e93855a5da4afcc9d8cb1ade96193"
+    "75484cca0bf0d09c05e673eefd16267dfec5977b1b58befaeb3891263b5cd01c";
+
+// Test vector for EKEP secret derivation in a resumed handshake.
+//   Inputs:
+//     kTestResumptionSecret, kTestTranscriptHash
+//   Outputs:
+//     kTestResumedMasterSecret, kTestResumedAuthenticatorSecret
+constexpr char kTestResumedMasterSecret[] =
+    "3f633ebda642b4a74c4a9dee4317128b739e054fcafd856c6c82e78ef639eb5e"
+    "55676baadfafcebc2217ddc1c067feca9ca7a439ec8df67afc2b7069e945a4d6";
+
+constexpr char kTestResumedAuthenticatorSecret[] =
+    "64b75f926300e2cee9c39b61d0de0a2eba578cdb24cd95001655a02efe375ee2"
+    "d9e6892429d321293c91963097b5b0b4d3110ce04f4d9b03d32b2c19002ff9ce";
+
 // Test vector for server handshake-authenticator computation.
 //   Inputs:
 //     kTestAuthenticatorSecret
@@ -240,6 +271,152 @@ TEST(EkepCryptoTest, DeriveRecordProtocolKeySealAes128Gcm) {
   EXPECT_EQ(*actual_key, expected_key);
 }
 
+// Verify success of DeriveRecordProtocolKey when using the ciphersuite
+// consisting of Curve25519 and SHA256, and the rekeying ALTS record protocol.
+TEST(EkepCryptoTest, DeriveRecordProtocolKeyAltsAes128GcmRekey) {
+  UnsafeBytes<kSha256DigestLength> transcript_hash;
+  ASYLO_ASSERT_OK(
+      SetTrivialObjectFromHexString(kTestTranscriptHash, &transcript_hash));
+
+  SafeBytes<kEkepMasterSecretSize> master_secret;
+  ASYLO_ASSERT_OK(
+      SetTrivialObjectFromHexString(kTestMasterSecret, &master_secret));
+
+  SafeBytes<kAltsRecordProtocolAes128GcmRekeyKeySize> expected_key;
+  ASYLO_ASSERT_OK(SetTrivialObjectFromHexString(kTestRekeyRecordProtocolKey,
+                                                &expected_key));
+
+  CleansingVector<uint8_t> key;
+  ASYLO_ASSERT_OK(DeriveRecordProtocolKey(CURVE25519_SHA256,
+                                          ALTSRP_AES128_GCM_REKEY,
+                                          transcript_hash, master_secret,
+                                          &key));
+
+  // Verify that the record protocol key is as expected.
+  ASSERT_EQ(key.size(), kAltsRecordProtocolAes128GcmRekeyKeySize);
+  SafeBytes<kAltsRecordProtocolAes128GcmRekeyKeySize> *actual_key =
+      SafeBytes<kAltsRecordProtocolAes128GcmRekeyKeySize>::Place(
+          &key, /*offset=*/0);
+  EXPECT_EQ(*actual_key, expected_key);
+}
+
+// Verify that DeriveResumptionSecret fails and returns BAD_HANDSHAKE_CIPHER
+// when passed an unsupported ciphersuite.
+TEST(EkepCryptoTest, DeriveResumptionSecretBadCiphersuite) {
+  std::string transcript_hash;
+  std::vector<uint8_t> master_secret;
+  CleansingVector<uint8_t> resumption_secret;
+
+  Status status =
+      DeriveResumptionSecret(UNKNOWN_HANDSHAKE_CIPHER, transcript_hash,
+                             master_secret, &resumption_secret);
+  EXPECT_THAT(status, Not(IsOk()));
+  EXPECT_THAT(status, StatusIs(Abort::BAD_HANDSHAKE_CIPHER));
+}
+
+// Verify success of DeriveResumptionSecret when using the ciphersuite
+// consisting of Curve25519 and SHA256.
+TEST(EkepCryptoTest, DeriveResumptionSecretWithCurve25519Sha256) {
+  UnsafeBytes<kSha256DigestLength> transcript_hash;
+  ASYLO_ASSERT_OK(
+      SetTrivialObjectFromHexString(kTestTranscriptHash, &transcript_hash));
+
+  SafeBytes<kEkepMasterSecretSize> master_secret;
+  ASYLO_ASSERT_OK(
+      SetTrivialObjectFromHexString(kTestMasterSecret, &master_secret));
+
+  SafeBytes<kEkepResumptionSecretSize> expected_resumption_secret;
+  ASYLO_ASSERT_OK(SetTrivialObjectFromHexString(kTestResumptionSecret,
+                                                &expected_resumption_secret));
+
+  CleansingVector<uint8_t> resumption_secret;
+
+  ASSERT_TRUE(DeriveResumptionSecret(CURVE25519_SHA256, transcript_hash,
+                                     master_secret, &resumption_secret)
+                  .ok());
+
+  // Verify that the resumption secret is as expected.
+  SafeBytes<kEkepResumptionSecretSize> *actual_resumption_secret =
+      SafeBytes<kEkepResumptionSecretSize>::Place(&resumption_secret,
+                                                  /*offset=*/0);
+  EXPECT_EQ(*actual_resumption_secret, expected_resumption_secret);
+}
+
+// Verify that DeriveResumedSecrets fails and returns BAD_HANDSHAKE_CIPHER when
+// passed an unsupported ciphersuite.
+TEST(EkepCryptoTest, DeriveResumedSecretsBadCiphersuite) {
+  std::string transcript_hash;
+  SafeBytes<kEkepResumptionSecretSize> resumption_secret =
+      TrivialRandomObject<SafeBytes<kEkepResumptionSecretSize>>();
+  CleansingVector<uint8_t> authenticator_secret;
+  CleansingVector<uint8_t> master_secret;
+
+  Status status = DeriveResumedSecrets(UNKNOWN_HANDSHAKE_CIPHER,
+                                       transcript_hash, resumption_secret,
+                                       &master_secret, &authenticator_secret);
+  EXPECT_THAT(status, Not(IsOk()));
+  EXPECT_THAT(status, StatusIs(Abort::BAD_HANDSHAKE_CIPHER));
+}
+
+// Verify that DeriveResumedSecrets fails and returns INTERNAL_ERROR when passed
+// a resumption secret that has an invalid size.
+TEST(EkepCryptoTest, DeriveResumedSecretsBadResumptionSecretSize) {
+  std::string transcript_hash;
+
+  // Resumption secret is empty.
+  CleansingVector<uint8_t> resumption_secret;
+
+  CleansingVector<uint8_t> authenticator_secret;
+  CleansingVector<uint8_t> master_secret;
+
+  Status status =
+      DeriveResumedSecrets(CURVE25519_SHA256, transcript_hash,
+                           resumption_secret, &master_secret,
+                           &authenticator_secret);
+  EXPECT_THAT(status, Not(IsOk()));
+  EXPECT_THAT(status, StatusIs(Abort::INTERNAL_ERROR));
+}
+
+// Verify success of DeriveResumedSecrets using the ciphersuite consisting of
+// Curve25519 and SHA256.
+TEST(EkepCryptoTest, DeriveResumedSecretsWithCurve25519Sha256) {
+  UnsafeBytes<kSha256DigestLength> transcript_hash;
+  ASYLO_ASSERT_OK(
+      SetTrivialObjectFromHexString(kTestTranscriptHash, &transcript_hash));
+
+  SafeBytes<kEkepResumptionSecretSize> resumption_secret;
+  ASYLO_ASSERT_OK(
+      SetTrivialObjectFromHexString(kTestResumptionSecret, &resumption_secret));
+
+  SafeBytes<kEkepMasterSecretSize> expected_master_secret;
+  ASYLO_ASSERT_OK(SetTrivialObjectFromHexString(kTestResumedMasterSecret,
+                                                &expected_master_secret));
+
+  SafeBytes<kEkepAuthenticatorSecretSize> expected_authenticator_secret;
+  ASYLO_ASSERT_OK(SetTrivialObjectFromHexString(
+      kTestResumedAuthenticatorSecret, &expected_authenticator_secret));
+
+  CleansingVector<uint8_t> authenticator_secret;
+  CleansingVector<uint8_t> master_secret;
+
+  ASSERT_TRUE(DeriveResumedSecrets(CURVE25519_SHA256, transcript_hash,
+                                   resumption_secret, &master_secret,
+                                   &authenticator_secret)
+                  .ok());
+
+  // Verify that the master secret is as expected.
+  SafeBytes<kEkepMasterSecretSize> *actual_master_secret =
+      SafeBytes<kEkepMasterSecretSize>::Place(&master_secret,
+                                              /*offset=*/0);
+  EXPECT_EQ(*actual_master_secret, expected_master_secret);
+
+  // Verify that the authenticator secret is as expected.
+  SafeBytes<kEkepAuthenticatorSecretSize> *actual_authenticator_secret =
+      SafeBytes<kEkepAuthenticatorSecretSize>::Place(&authenticator_secret,
+                                                     /*offset=*/0);
+  EXPECT_EQ(*actual_authenticator_secret, expected_authenticator_secret);
+}
+
 // Verify that ComputeClientHandshakeAuthenticator fails and returns
 // BAD_HANDSHAKER_CIPHER when passed an unsupported ciphersuite.
 TEST(EkepCryptoTest, ComputeClientHandshakeAuthenticatorBadCipherSuite) {
@@ -126,9 +126,13 @@ EkepHandshaker::Result EkepHandshaker::NextHandshakeStep(
 Status EkepHandshaker::EncodeFrame(
     HandshakeMessageType message_type, const google::protobuf::Message &handshake_message,
     google::protobuf::io::ZeroCopyOutputStream *output) const {
-  google::protobuf::io::CodedOutputStream encoded_frame(output);
+  return EncodeFrame(message_type, handshake_message,
+                     handshake_message.ByteSizeLong(), output);
+}
 
-  size_t message_size = handshake_message.ByteSizeLong();
+Status EkepHandshaker::EncodeFrame(
+    HandshakeMessageType message_type, const google::protobuf::Message &handshake_message,
+    size_t message_size, google::protobuf::io::ZeroCopyOutputStream *output) const {
   if (message_size > max_frame_size_ ||
       sizeof(message_type) + message_size > max_frame_size_) {
     return Status(
@@ -144,6 +148,8 @@ Status EkepHandshaker::EncodeFrame(
         "Cannot create a frame with message type UNKNOWN_HANDSHAKE_MESSAGE");
   }
 
+  google::protobuf::io::CodedOutputStream encoded_frame(output);
+
   // Write the frame size.
   uint32_t frame_size = sizeof(message_type) + message_size;
   encoded_frame.WriteLittleEndian32(frame_size);
@@ -317,15 +323,25 @@ EkepHandshaker::Result EkepHandshaker::DecodeAndHandleFrame(
 Status EkepHandshaker::WriteFrameAndUpdateTranscript(
     HandshakeMessageType message_type, const google::protobuf::Message &handshake_message,
     std::string *output) {
-  int offset = output->size();
-  google::protobuf::io::StringOutputStream outgoing_frame(output);
-  ASYLO_RETURN_IF_ERROR(
-      EncodeFrame(message_type, handshake_message, &outgoing_frame));
+  // Size the frame up front so that it is encoded in place at the end of
+  // |output|, without growing |output| while encoding. The message sizes
+  // computed here are cached for the serialization.
+  size_t message_size = handshake_message.ByteSizeLong();
+  size_t offset = output->size();
+  size_t encoded_size = kEkepFrameHeaderSize + message_size;
+  output->resize(offset + encoded_size);
+  google::protobuf::io::ArrayOutputStream outgoing_frame(&(*output)[offset],
+                                               encoded_size);
+  Status status = EncodeFrame(message_type, handshake_message, message_size,
+                              &outgoing_frame);
+  if (!status.ok()) {
+    output->resize(offset);
+    return status;
+  }
 
   // There may be outgoing frames already written to |output|. Only add bytes
   // from the most recently-written frame to the transcript.
-  UpdateTranscriptWithOutgoingBytes(output->data() + offset,
-                                    output->size() - offset);
+  UpdateTranscriptWithOutgoingBytes(output->data() + offset, encoded_size);
   return Status::OkStatus();
 }
 
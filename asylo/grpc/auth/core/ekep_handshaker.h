@@ -173,6 +173,9 @@ class EkepHandshaker {
   // writes the encoded frame to |output|, and updates the transcript with all
   // bytes written to |output|.
   //
+  // The frame is encoded directly into |output| and the transcript is updated
+  // from the encoded bytes in |output|, without intermediate copies.
+  //
   // This method is provided for simultaneously writing outgoing frames and
   // updating the handshake transcript. Note that while the EkepHandshaker base
   // class adds all incoming frame bytes to the transcript, EkepHandshaker
@@ -198,6 +201,9 @@ class EkepHandshaker {
   // Adds an identity to the list of peer identities.
   void AddPeerIdentity(const EnclaveIdentity &identity);
 
+  // Returns the list of peer identities added so far.
+  const EnclaveIdentities &peer_identities() const { return *peer_identities_; }
+
   // Sets the record protocol to use after the handshake completes.
   void SetRecordProtocol(RecordProtocol record_protocol);
 
@@ -259,6 +265,15 @@ class EkepHandshaker {
   virtual void HandleAbortMessage(const Abort *abort_message) = 0;
 
  private:
+  // Encodes |handshake_message| of type |message_type| as an EKEP frame and
+  // writes the encoded frame to |output|. |message_size| must be the result of
+  // the most recent call to |handshake_message|.ByteSizeLong(), whose cached
+  // sizes are used to serialize the message.
+  Status EncodeFrame(HandshakeMessageType message_type,
+                     const google::protobuf::Message &handshake_message,
+                     size_t message_size,
+                     google::protobuf::io::ZeroCopyOutputStream *output) const;
+
   // Updates the transcript with |outgoing_bytes_size| bytes from
   // |outgoing_bytes|.
   void UpdateTranscriptWithOutgoingBytes(const char *outgoing_bytes,
@@ -18,6 +18,10 @@
 
 #include "asylo/grpc/auth/core/ekep_handshaker_util.h"
 
+#include <functional>
+#include <string>
+#include <vector>
+
 #include <google/protobuf/util/message_differencer.h>
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
@@ -26,6 +30,8 @@
 #include "asylo/identity/attestation/enclave_assertion_verifier.h"
 #include "asylo/identity/enclave_assertion_authority.h"
 #include "asylo/util/status.h"
+#include "asylo/util/status_macros.h"
+#include "asylo/util/thread.h"
 
 namespace asylo {
 
@@ -130,4 +136,74 @@ bool MakeEkepContextBlob(const std::string &public_key,
       .ok();
 }
 
+std::vector<Status> RunConcurrently(
+    const std::vector<std::function<Status()>> &tasks) {
+  std::vector<Status> results(tasks.size());
+  std::vector<Thread> threads;
+  threads.reserve(tasks.size());
+  for (size_t i = 1; i < tasks.size(); ++i) {
+    threads.emplace_back([&tasks, &results, i] { results[i] = tasks[i](); });
+  }
+  if (!tasks.empty()) {
+    results[0] = tasks[0]();
+  }
+  for (Thread &thread : threads) {
+    thread.Join();
+  }
+  return results;
+}
+
+Status GenerateAssertions(
+    const std::string &ekep_context,
+    const std::vector<const AssertionRequest *> &requests,
+    google::protobuf::RepeatedPtrField<Assertion> *assertions) {
+  // Add all assertions before starting any task, so that the tasks write to
+  // stable locations.
+  std::vector<Assertion *> outputs;
+  outputs.reserve(requests.size());
+  for (size_t i = 0; i < requests.size(); ++i) {
+    outputs.push_back(assertions->Add());
+  }
+
+  std::vector<std::function<Status()>> tasks;
+  tasks.reserve(requests.size());
+  for (size_t i = 0; i < requests.size(); ++i) {
+    const AssertionRequest *request = requests[i];
+    Assertion *assertion = outputs[i];
+    tasks.emplace_back([&ekep_context, request, assertion] {
+      return GetEnclaveAssertionGenerator(request->description())
+          ->Generate(ekep_context, *request, assertion);
+    });
+  }
+
+  for (const Status &status : RunConcurrently(tasks)) {
+    ASYLO_RETURN_IF_ERROR(status);
+  }
+  return Status::OkStatus();
+}
+
+Status VerifyAssertions(
+    const std::string &ekep_context,
+    const google::protobuf::RepeatedPtrField<Assertion> &assertions,
+    std::vector<EnclaveIdentity> *identities) {
+  identities->clear();
+  identities->resize(assertions.size());
+
+  std::vector<std::function<Status()>> tasks;
+  tasks.reserve(assertions.size());
+  for (int i = 0; i < assertions.size(); ++i) {
+    const Assertion *assertion = &assertions.Get(i);
+    EnclaveIdentity *identity = &(*identities)[i];
+    tasks.emplace_back([&ekep_context, assertion, identity] {
+      return GetEnclaveAssertionVerifier(assertion->description())
+          ->Verify(ekep_context, *assertion, identity);
+    });
+  }
+
+  for (const Status &status : RunConcurrently(tasks)) {
+    ASYLO_RETURN_IF_ERROR(status);
+  }
+  return Status::OkStatus();
+}
+
 }  // namespace asylo
@@ -19,9 +19,13 @@
 #ifndef ASYLO_GRPC_AUTH_CORE_EKEP_HANDSHAKER_UTIL_H_
 #define ASYLO_GRPC_AUTH_CORE_EKEP_HANDSHAKER_UTIL_H_
 
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include <google/protobuf/repeated_field.h>
+#include "asylo/grpc/auth/core/ekep_session_cache.h"
 #include "asylo/identity/attestation/enclave_assertion_generator.h"
 #include "asylo/identity/attestation/enclave_assertion_verifier.h"
 #include "asylo/identity/identity.pb.h"
@@ -45,6 +49,16 @@ struct EkepHandshakerOptions {
   // Additional data presented by the EKEP participant during the handshake.
   std::string additional_authenticated_data;
 
+  // Sessions that may be resumed without exchanging assertions. Session
+  // resumption is disabled if this field is nullptr. The cache may be shared by
+  // any number of handshakers with the same configuration.
+  std::shared_ptr<EkepSessionCache> session_cache;
+
+  // Identifies the server to a client handshaker, which only resumes sessions
+  // that were established with a server of the same identifier. Ignored by
+  // server handshakers.
+  std::string session_cache_key;
+
   // Validates the handshaker options. All of the following conditions must
   // hold, otherwise returns INVALID_ARGUMENT:
   //   * max_frame_size is non-zero and does not exceed
@@ -87,6 +101,35 @@ bool MakeEkepContextBlob(const std::string &public_key,
                          const std::string &transcript_hash,
                          std::string *ekep_context);
 
+// Runs each of |tasks| and returns their results in the same order. If there
+// is more than one task, all but the first are started on their own threads so
+// that their latencies overlap, and the first runs on the calling thread.
+// Returns once all tasks have completed.
+std::vector<Status> RunConcurrently(
+    const std::vector<std::function<Status()>> &tasks);
+
+// Generates an assertion bound to |ekep_context| for each of |requests| and
+// adds the assertions to |assertions| in the same order. The assertions are
+// generated concurrently by RunConcurrently(). Returns the first error
+// encountered, if any.
+//
+// The generator for each request must be available.
+Status GenerateAssertions(
+    const std::string &ekep_context,
+    const std::vector<const AssertionRequest *> &requests,
+    google::protobuf::RepeatedPtrField<Assertion> *assertions);
+
+// Verifies that each of |assertions| is bound to |ekep_context| and writes the
+// identities extracted from the assertions to |identities| in the same order.
+// The assertions are verified concurrently by RunConcurrently(). Returns the
+// first error encountered, if any.
+//
+// The verifier for each assertion must be available.
+Status VerifyAssertions(
+    const std::string &ekep_context,
+    const google::protobuf::RepeatedPtrField<Assertion> &assertions,
+    std::vector<EnclaveIdentity> *identities);
+
 }  // namespace asylo
 
 #endif  // ASYLO_GRPC_AUTH_CORE_EKEP_HANDSHAKER_UTIL_H_
@@ -18,18 +18,27 @@
 
 #include "asylo/grpc/auth/core/ekep_handshaker_util.h"
 
+#include <atomic>
+#include <functional>
+#include <vector>
+
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "asylo/grpc/auth/core/ekep_handshaker.h"
 #include "asylo/identity/attestation/null/null_identity_util.h"
 #include "asylo/identity/descriptions.h"
 #include "asylo/identity/identity.pb.h"
 #include "asylo/test/util/status_matchers.h"
+#include "asylo/util/status.h"
 
 namespace asylo {
 namespace {
 
+using ::testing::IsEmpty;
 using ::testing::Not;
+using ::testing::SizeIs;
 
 const char kBadAuthorityType[] = "unknown authority";
 
@@ -148,5 +157,45 @@ TEST_F(EkepHandshakerUtilTest, ValidateInvalidAcceptedPeerAssertions) {
   EXPECT_THAT(options.Validate(), Not(IsOk()));
 }
 
+// Verify that RunConcurrently returns the result of each task in order.
+TEST_F(EkepHandshakerUtilTest, RunConcurrentlyReturnsResultsInOrder) {
+  EXPECT_THAT(RunConcurrently({}), IsEmpty());
+
+  std::vector<std::function<Status()>> tasks = {
+      [] { return Status::OkStatus(); },
+      [] { return Status(error::GoogleError::INTERNAL, "second"); },
+      [] { return Status(error::GoogleError::NOT_FOUND, "third"); },
+  };
+  std::vector<Status> results = RunConcurrently(tasks);
+  ASSERT_THAT(results, SizeIs(3));
+  EXPECT_THAT(results[0], IsOk());
+  EXPECT_THAT(results[1], StatusIs(error::GoogleError::INTERNAL, "second"));
+  EXPECT_THAT(results[2], StatusIs(error::GoogleError::NOT_FOUND, "third"));
+}
+
+// Verify that RunConcurrently runs its tasks at the same time. Each task waits
+// for all other tasks to start, which only succeeds if they overlap.
+TEST_F(EkepHandshakerUtilTest, RunConcurrentlyOverlapsTasks) {
+  constexpr int kNumTasks = 3;
+  std::atomic<int> started(0);
+  std::function<Status()> task = [&started] {
+    started.fetch_add(1);
+    absl::Time deadline = absl::Now() + absl::Seconds(10);
+    while (started.load() < kNumTasks) {
+      if (absl::Now() > deadline) {
+        return Status(error::GoogleError::DEADLINE_EXCEEDED,
+                      "Tasks did not run concurrently");
+      }
+      absl::SleepFor(absl::Milliseconds(1));
+    }
+    return Status::OkStatus();
+  };
+
+  for (const Status &status :
+       RunConcurrently(std::vector<std::function<Status()>>(kNumTasks, task))) {
+    EXPECT_THAT(status, IsOk());
+  }
+}
+
 }  // namespace
 }  // namespace asylo
@@ -0,0 +1,106 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/grpc/auth/core/ekep_key_pool.h"
+
+#include <openssl/curve25519.h>
+
+#include <memory>
+#include <utility>
+
+#include "absl/memory/memory.h"
+
+namespace asylo {
+namespace {
+
+EkepEphemeralKey GenerateKey() {
+  EkepEphemeralKey key;
+  key.public_key.resize(X25519_PUBLIC_VALUE_LEN);
+  key.private_key.resize(X25519_PRIVATE_KEY_LEN);
+  X25519_keypair(key.public_key.data(), key.private_key.data());
+  return key;
+}
+
+}  // namespace
+
+constexpr size_t EkepKeyPool::kDefaultCapacity;
+
+EkepKeyPool::EkepKeyPool(size_t capacity) : capacity_(capacity) {
+  absl::MutexLock lock(&mu_);
+  keys_.reserve(capacity_);
+}
+
+EkepKeyPool::~EkepKeyPool() {
+  std::unique_ptr<Thread> refill_thread;
+  {
+    absl::MutexLock lock(&mu_);
+    refill_thread = std::move(refill_thread_);
+  }
+  if (refill_thread) {
+    refill_thread->Join();
+  }
+}
+
+EkepKeyPool *EkepKeyPool::GetInstance() {
+  static EkepKeyPool *const pool = new EkepKeyPool();
+  return pool;
+}
+
+EkepEphemeralKey EkepKeyPool::Take() {
+  {
+    absl::MutexLock lock(&mu_);
+    if (keys_.size() <= capacity_ / 2 && !refilling_ && capacity_ > 0) {
+      // The previous refill thread, if any, has finished filling the pool.
+      if (refill_thread_) {
+        refill_thread_->Join();
+      }
+      refilling_ = true;
+      refill_thread_ = absl::make_unique<Thread>(&EkepKeyPool::Refill, this);
+    }
+    if (!keys_.empty()) {
+      EkepEphemeralKey key = std::move(keys_.back());
+      keys_.pop_back();
+      return key;
+    }
+  }
+  return GenerateKey();
+}
+
+size_t EkepKeyPool::Size() const {
+  absl::MutexLock lock(&mu_);
+  return keys_.size();
+}
+
+void EkepKeyPool::Refill() {
+  while (true) {
+    {
+      absl::MutexLock lock(&mu_);
+      if (keys_.size() >= capacity_) {
+        refilling_ = false;
+        return;
+      }
+    }
+    // Generate the key pair without holding |mu_|, so that Take() is not
+    // blocked on key generation.
+    EkepEphemeralKey key = GenerateKey();
+    absl::MutexLock lock(&mu_);
+    keys_.push_back(std::move(key));
+  }
+}
+
+}  // namespace asylo
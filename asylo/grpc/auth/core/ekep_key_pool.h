@@ -0,0 +1,91 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_GRPC_AUTH_CORE_EKEP_KEY_POOL_H_
+#define ASYLO_GRPC_AUTH_CORE_EKEP_KEY_POOL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "asylo/util/cleansing_types.h"
+#include "asylo/util/thread.h"
+
+namespace asylo {
+
+// An ephemeral X25519 key pair for a single EKEP handshake.
+struct EkepEphemeralKey {
+  std::vector<uint8_t> public_key;
+  CleansingVector<uint8_t> private_key;
+};
+
+// EkepKeyPool holds ephemeral X25519 key pairs that are generated ahead of the
+// handshakes that use them, so that a burst of handshakes does not pay for key
+// generation on the handshake thread.
+//
+// Each key pair is handed out at most once. When a Take() finds the pool at
+// most half full, a background thread refills it and then exits, so that the
+// pool does not hold a thread while it is full. At most one such thread runs at
+// a time. If the pool is empty, Take() generates a key pair inline. EkepKeyPool
+// is thread-safe.
+class EkepKeyPool {
+ public:
+  // The default number of key pairs held by a pool.
+  static constexpr size_t kDefaultCapacity = 64;
+
+  // Creates an empty pool holding up to |capacity| key pairs. The pool is first
+  // filled by the first call to Take().
+  explicit EkepKeyPool(size_t capacity = kDefaultCapacity);
+
+  // Waits for a running refill to finish.
+  ~EkepKeyPool();
+
+  EkepKeyPool(const EkepKeyPool &other) = delete;
+  EkepKeyPool &operator=(const EkepKeyPool &other) = delete;
+
+  // Returns the pool used by the EKEP handshakers of this process.
+  static EkepKeyPool *GetInstance();
+
+  // Removes a key pair from the pool and returns it.
+  EkepEphemeralKey Take();
+
+  // Returns the number of key pairs held by the pool.
+  size_t Size() const;
+
+ private:
+  // Generates key pairs until the pool is full.
+  void Refill();
+
+  const size_t capacity_;
+
+  mutable absl::Mutex mu_;
+  std::vector<EkepEphemeralKey> keys_ ABSL_GUARDED_BY(mu_);
+
+  // Whether |refill_thread_| is filling the pool.
+  bool refilling_ ABSL_GUARDED_BY(mu_) = false;
+
+  // The thread which last refilled the pool, if any.
+  std::unique_ptr<Thread> refill_thread_ ABSL_GUARDED_BY(mu_);
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_GRPC_AUTH_CORE_EKEP_KEY_POOL_H_
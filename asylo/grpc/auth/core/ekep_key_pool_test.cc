@@ -0,0 +1,95 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/grpc/auth/core/ekep_key_pool.h"
+
+#include <openssl/curve25519.h>
+
+#include <cstdint>
+#include <set>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+
+namespace asylo {
+namespace {
+
+using ::testing::ElementsAreArray;
+using ::testing::Eq;
+using ::testing::SizeIs;
+
+constexpr size_t kCapacity = 8;
+
+// Waits until |pool| holds |size| key pairs or the test times out.
+void WaitForSize(const EkepKeyPool &pool, size_t size) {
+  while (pool.Size() != size) {
+    absl::SleepFor(absl::Milliseconds(1));
+  }
+}
+
+// Verify that the public key of a key pair from the pool belongs to its private
+// key.
+TEST(EkepKeyPoolTest, TakeReturnsMatchingKeyPair) {
+  EkepKeyPool pool(kCapacity);
+  EkepEphemeralKey key = pool.Take();
+  ASSERT_THAT(key.public_key, SizeIs(X25519_PUBLIC_VALUE_LEN));
+  ASSERT_THAT(key.private_key, SizeIs(X25519_PRIVATE_KEY_LEN));
+
+  std::vector<uint8_t> public_key(X25519_PUBLIC_VALUE_LEN);
+  X25519_public_from_private(public_key.data(), key.private_key.data());
+  EXPECT_THAT(key.public_key, ElementsAreArray(public_key));
+}
+
+// Verify that the pool is refilled in the background once it is at most half
+// full.
+TEST(EkepKeyPoolTest, RefillsInBackground) {
+  EkepKeyPool pool(kCapacity);
+  EXPECT_THAT(pool.Size(), Eq(0));
+  pool.Take();
+  WaitForSize(pool, kCapacity);
+
+  for (size_t i = 0; i < kCapacity / 2 - 1; ++i) {
+    pool.Take();
+  }
+  EXPECT_THAT(pool.Size(), Eq(kCapacity / 2 + 1));
+  pool.Take();
+  pool.Take();
+  WaitForSize(pool, kCapacity);
+}
+
+// Verify that a key pair is never handed out twice.
+TEST(EkepKeyPoolTest, KeysAreSingleUse) {
+  EkepKeyPool pool(kCapacity);
+  std::set<std::vector<uint8_t>> public_keys;
+  for (size_t i = 0; i < 4 * kCapacity; ++i) {
+    EXPECT_TRUE(public_keys.insert(pool.Take().public_key).second);
+  }
+}
+
+// Verify that a pool without capacity generates key pairs inline.
+TEST(EkepKeyPoolTest, EmptyPoolGeneratesKeys) {
+  EkepKeyPool pool(/*capacity=*/0);
+  EXPECT_THAT(pool.Take().public_key, SizeIs(X25519_PUBLIC_VALUE_LEN));
+  EXPECT_THAT(pool.Size(), Eq(0));
+}
+
+}  // namespace
+}  // namespace asylo
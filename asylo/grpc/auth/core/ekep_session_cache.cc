@@ -0,0 +1,76 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/grpc/auth/core/ekep_session_cache.h"
+
+#include <iterator>
+#include <utility>
+
+#include "absl/time/clock.h"
+
+namespace asylo {
+
+constexpr size_t EkepSessionCache::kDefaultCapacity;
+
+EkepSessionCache::EkepSessionCache(absl::Duration lifetime, size_t capacity)
+    : lifetime_(lifetime), capacity_(capacity) {}
+
+absl::Time EkepSessionCache::NewSessionExpiration() const {
+  return absl::Now() + lifetime_;
+}
+
+void EkepSessionCache::Insert(const std::string &key, EkepSession session) {
+  if (capacity_ == 0 || session.expiration <= absl::Now()) {
+    return;
+  }
+
+  absl::MutexLock lock(&mu_);
+  auto index_it = index_.find(key);
+  if (index_it != index_.end()) {
+    sessions_.erase(index_it->second);
+    index_.erase(index_it);
+  }
+  while (sessions_.size() >= capacity_) {
+    index_.erase(sessions_.front().first);
+    sessions_.pop_front();
+  }
+  sessions_.emplace_back(key, std::move(session));
+  index_.emplace(key, std::prev(sessions_.end()));
+}
+
+absl::optional<EkepSession> EkepSessionCache::Take(const std::string &key) {
+  absl::MutexLock lock(&mu_);
+  auto index_it = index_.find(key);
+  if (index_it == index_.end()) {
+    return absl::nullopt;
+  }
+  EkepSession session = std::move(index_it->second->second);
+  sessions_.erase(index_it->second);
+  index_.erase(index_it);
+  if (session.expiration <= absl::Now()) {
+    return absl::nullopt;
+  }
+  return session;
+}
+
+size_t EkepSessionCache::Size() const {
+  absl::MutexLock lock(&mu_);
+  return sessions_.size();
+}
+
+}  // namespace asylo
@@ -0,0 +1,119 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_GRPC_AUTH_CORE_EKEP_SESSION_CACHE_H_
+#define ASYLO_GRPC_AUTH_CORE_EKEP_SESSION_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <utility>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "absl/types/optional.h"
+#include "asylo/grpc/auth/core/handshake.pb.h"
+#include "asylo/identity/identity.pb.h"
+#include "asylo/util/cleansing_types.h"
+
+namespace asylo {
+
+// The size of an EKEP session ticket.
+constexpr size_t kEkepSessionTicketSize = 32;
+
+// The parameters of a completed EKEP handshake that are needed to resume the
+// session in a later handshake without exchanging assertions.
+struct EkepSession {
+  // The single-use ticket that identifies the session to the server.
+  std::string ticket;
+
+  // The EKEP version, cipher suite, and record protocol of the session.
+  std::string ekep_version;
+  HandshakeCipher cipher_suite = UNKNOWN_HANDSHAKE_CIPHER;
+  RecordProtocol record_protocol = UNKNOWN_RECORD_PROTOCOL;
+
+  // The secret from which the resumed handshake derives its EKEP secrets.
+  CleansingVector<uint8_t> resumption_secret;
+
+  // The peer identities that were verified when the session was established.
+  EnclaveIdentities peer_identities;
+
+  // The time after which the session may no longer be resumed. A resumed
+  // session keeps the expiration of the session it resumes, so that the peer
+  // identities are re-attested at least once per lifetime of the cache.
+  absl::Time expiration;
+};
+
+// EkepSessionCache holds EKEP sessions that may be resumed by later handshakes.
+// A server handshaker keys each session by its ticket. A client handshaker
+// keys each session by an identifier of the server with which it was
+// established.
+//
+// Each session may be taken out of the cache at most once, which makes tickets
+// single-use. The cache holds at most |capacity| sessions and evicts the least
+// recently inserted session when full. EkepSessionCache is thread-safe.
+class EkepSessionCache {
+ public:
+  // The default number of sessions held by a cache.
+  static constexpr size_t kDefaultCapacity = 1024;
+
+  // Creates a cache of sessions that may be resumed for up to |lifetime| after
+  // they were first established.
+  explicit EkepSessionCache(absl::Duration lifetime,
+                            size_t capacity = kDefaultCapacity);
+
+  EkepSessionCache(const EkepSessionCache &other) = delete;
+  EkepSessionCache &operator=(const EkepSessionCache &other) = delete;
+
+  // Returns the time at which a session that is established now expires.
+  absl::Time NewSessionExpiration() const;
+
+  // Inserts |session| under |key|, replacing any session previously held under
+  // |key|. Does nothing if |session| has already expired.
+  void Insert(const std::string &key, EkepSession session);
+
+  // Removes the session held under |key| from the cache and returns it.
+  // Returns absl::nullopt if there is no such session or if it has expired.
+  absl::optional<EkepSession> Take(const std::string &key);
+
+  // Returns the number of sessions held by the cache, including any expired
+  // sessions that have not yet been evicted.
+  size_t Size() const;
+
+ private:
+  using SessionList = std::list<std::pair<std::string, EkepSession>>;
+
+  const absl::Duration lifetime_;
+  const size_t capacity_;
+
+  mutable absl::Mutex mu_;
+
+  // Sessions in order of insertion, oldest first.
+  SessionList sessions_ ABSL_GUARDED_BY(mu_);
+
+  // Index of |sessions_| by key.
+  absl::flat_hash_map<std::string, SessionList::iterator> index_
+      ABSL_GUARDED_BY(mu_);
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_GRPC_AUTH_CORE_EKEP_SESSION_CACHE_H_
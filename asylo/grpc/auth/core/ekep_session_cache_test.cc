@@ -0,0 +1,121 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/grpc/auth/core/ekep_session_cache.h"
+
+#include <string>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+
+namespace asylo {
+namespace {
+
+using ::testing::Eq;
+
+constexpr char kKey1[] = "key 1";
+constexpr char kKey2[] = "key 2";
+constexpr char kKey3[] = "key 3";
+
+// Returns a session with the given |ticket| that expires at |expiration|.
+EkepSession MakeSession(const std::string &ticket, absl::Time expiration) {
+  EkepSession session;
+  session.ticket = ticket;
+  session.ekep_version = "EKEP v1";
+  session.cipher_suite = CURVE25519_SHA256;
+  session.record_protocol = ALTSRP_AES128_GCM;
+  session.resumption_secret.assign(32, 0xab);
+  session.expiration = expiration;
+  return session;
+}
+
+// Verify that a cached session is returned exactly once.
+TEST(EkepSessionCacheTest, TakeReturnsSessionOnce) {
+  EkepSessionCache cache(absl::Hours(1));
+  cache.Insert(kKey1, MakeSession("ticket", cache.NewSessionExpiration()));
+  EXPECT_THAT(cache.Size(), Eq(1));
+
+  absl::optional<EkepSession> session = cache.Take(kKey1);
+  ASSERT_TRUE(session.has_value());
+  EXPECT_THAT(session->ticket, Eq("ticket"));
+  EXPECT_THAT(session->cipher_suite, Eq(CURVE25519_SHA256));
+  EXPECT_THAT(session->resumption_secret.size(), Eq(32));
+
+  EXPECT_FALSE(cache.Take(kKey1).has_value());
+  EXPECT_THAT(cache.Size(), Eq(0));
+}
+
+// Verify that Take fails for a key that was never inserted.
+TEST(EkepSessionCacheTest, TakeUnknownKeyFails) {
+  EkepSessionCache cache(absl::Hours(1));
+  cache.Insert(kKey1, MakeSession("ticket", cache.NewSessionExpiration()));
+  EXPECT_FALSE(cache.Take(kKey2).has_value());
+  EXPECT_THAT(cache.Size(), Eq(1));
+}
+
+// Verify that inserting under an existing key replaces the cached session.
+TEST(EkepSessionCacheTest, InsertReplacesSession) {
+  EkepSessionCache cache(absl::Hours(1));
+  cache.Insert(kKey1, MakeSession("old", cache.NewSessionExpiration()));
+  cache.Insert(kKey1, MakeSession("new", cache.NewSessionExpiration()));
+  EXPECT_THAT(cache.Size(), Eq(1));
+
+  absl::optional<EkepSession> session = cache.Take(kKey1);
+  ASSERT_TRUE(session.has_value());
+  EXPECT_THAT(session->ticket, Eq("new"));
+}
+
+// Verify that expired sessions are neither inserted nor returned.
+TEST(EkepSessionCacheTest, ExpiredSessionsAreNotResumed) {
+  EkepSessionCache cache(absl::Hours(1));
+  cache.Insert(kKey1, MakeSession("expired", absl::Now() - absl::Seconds(1)));
+  EXPECT_THAT(cache.Size(), Eq(0));
+
+  EkepSessionCache short_lived_cache(absl::Milliseconds(1));
+  short_lived_cache.Insert(
+      kKey1, MakeSession("ticket", short_lived_cache.NewSessionExpiration()));
+  absl::SleepFor(absl::Milliseconds(10));
+  EXPECT_FALSE(short_lived_cache.Take(kKey1).has_value());
+  EXPECT_THAT(short_lived_cache.Size(), Eq(0));
+}
+
+// Verify that a full cache evicts the oldest session.
+TEST(EkepSessionCacheTest, EvictsOldestSession) {
+  EkepSessionCache cache(absl::Hours(1), /*capacity=*/2);
+  cache.Insert(kKey1, MakeSession("1", cache.NewSessionExpiration()));
+  cache.Insert(kKey2, MakeSession("2", cache.NewSessionExpiration()));
+  cache.Insert(kKey3, MakeSession("3", cache.NewSessionExpiration()));
+  EXPECT_THAT(cache.Size(), Eq(2));
+
+  EXPECT_FALSE(cache.Take(kKey1).has_value());
+  EXPECT_TRUE(cache.Take(kKey2).has_value());
+  EXPECT_TRUE(cache.Take(kKey3).has_value());
+}
+
+// Verify that a cache without capacity holds no sessions.
+TEST(EkepSessionCacheTest, ZeroCapacityCacheIsEmpty) {
+  EkepSessionCache cache(absl::Hours(1), /*capacity=*/0);
+  cache.Insert(kKey1, MakeSession("ticket", cache.NewSessionExpiration()));
+  EXPECT_THAT(cache.Size(), Eq(0));
+  EXPECT_FALSE(cache.Take(kKey1).has_value());
+}
+
+}  // namespace
+}  // namespace asylo
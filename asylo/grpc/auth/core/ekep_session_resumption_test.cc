@@ -0,0 +1,305 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/time/time.h"
+#include "asylo/grpc/auth/core/client_ekep_handshaker.h"
+#include "asylo/grpc/auth/core/ekep_handshaker.h"
+#include "asylo/grpc/auth/core/ekep_handshaker_util.h"
+#include "asylo/grpc/auth/core/ekep_session_cache.h"
+#include "asylo/grpc/auth/core/server_ekep_handshaker.h"
+#include "asylo/identity/descriptions.h"
+#include "asylo/identity/identity.pb.h"
+#include "asylo/identity/init.h"
+#include "asylo/test/util/enclave_assertion_authority_configs.h"
+#include "asylo/test/util/proto_matchers.h"
+#include "asylo/test/util/status_matchers.h"
+#include "asylo/util/cleansing_types.h"
+
+namespace asylo {
+namespace {
+
+using ::testing::Eq;
+using ::testing::Ne;
+
+constexpr char kServerKey[] = "server";
+
+// The outcome of a handshake between a client and a server handshaker.
+struct HandshakeOutcome {
+  EkepHandshaker::Result client_result;
+  EkepHandshaker::Result server_result;
+
+  // The number of frame batches sent by the client.
+  int client_flights;
+};
+
+class EkepSessionResumptionTest : public ::testing::Test {
+ protected:
+  static void SetUpTestCase() {
+    std::vector<EnclaveAssertionAuthorityConfig> authority_configs = {
+        GetNullAssertionAuthorityTestConfig()};
+    ASSERT_THAT(InitializeEnclaveAssertionAuthorities(
+                    authority_configs.cbegin(), authority_configs.cend()),
+                IsOk());
+  }
+
+  void SetUp() override {
+    AssertionDescription null_assertion_description;
+    SetNullAssertionDescription(&null_assertion_description);
+    client_cache_ = std::make_shared<EkepSessionCache>(absl::Hours(1));
+    server_cache_ = std::make_shared<EkepSessionCache>(absl::Hours(1));
+
+    options_.self_assertions = {null_assertion_description};
+    options_.accepted_peer_assertions = {null_assertion_description};
+  }
+
+  // Creates a client handshaker that uses |cache|.
+  std::unique_ptr<EkepHandshaker> CreateClient(
+      std::shared_ptr<EkepSessionCache> cache) {
+    EkepHandshakerOptions options = options_;
+    options.session_cache = std::move(cache);
+    options.session_cache_key = kServerKey;
+    return ClientEkepHandshaker::Create(options);
+  }
+
+  // Creates a server handshaker that uses |cache|.
+  std::unique_ptr<EkepHandshaker> CreateServer(
+      std::shared_ptr<EkepSessionCache> cache) {
+    EkepHandshakerOptions options = options_;
+    options.session_cache = std::move(cache);
+    return ServerEkepHandshaker::Create(options);
+  }
+
+  // Relays frames between |client| and |server| until neither makes progress.
+  HandshakeOutcome RunHandshake(EkepHandshaker *client,
+                                EkepHandshaker *server) {
+    HandshakeOutcome outcome;
+    std::string client_output;
+    std::string server_output;
+    outcome.client_result = client->NextHandshakeStep(nullptr, 0,
+                                                      &client_output);
+    outcome.server_result = EkepHandshaker::Result::IN_PROGRESS;
+    outcome.client_flights = 1;
+
+    for (int step = 0; step < 8; ++step) {
+      bool client_in_progress =
+          outcome.client_result == EkepHandshaker::Result::IN_PROGRESS;
+      bool server_in_progress =
+          outcome.server_result == EkepHandshaker::Result::IN_PROGRESS;
+      if (!client_in_progress && !server_in_progress) {
+        break;
+      }
+      if (server_in_progress) {
+        outcome.server_result = server->NextHandshakeStep(
+            client_output.data(), client_output.size(), &server_output);
+        client_output.clear();
+      }
+      if (client_in_progress && !server_output.empty()) {
+        outcome.client_result = client->NextHandshakeStep(
+            server_output.data(), server_output.size(), &client_output);
+        server_output.clear();
+        if (!client_output.empty()) {
+          ++outcome.client_flights;
+        }
+      }
+    }
+    return outcome;
+  }
+
+  // Expects that |outcome| is a successful handshake in which the client sent
+  // |client_flights| batches of frames, and that both participants agree on
+  // the record protocol key.
+  void ExpectCompleted(const HandshakeOutcome &outcome, int client_flights,
+                       EkepHandshaker *client, EkepHandshaker *server) {
+    EXPECT_THAT(outcome.client_result,
+                Eq(EkepHandshaker::Result::COMPLETED));
+    EXPECT_THAT(outcome.server_result,
+                Eq(EkepHandshaker::Result::COMPLETED));
+    EXPECT_THAT(outcome.client_flights, Eq(client_flights));
+
+    auto client_key_result = client->GetRecordProtocolKey();
+    auto server_key_result = server->GetRecordProtocolKey();
+    ASSERT_THAT(client_key_result, IsOk());
+    ASSERT_THAT(server_key_result, IsOk());
+    EXPECT_THAT(client_key_result.ValueOrDie(),
+                Eq(server_key_result.ValueOrDie()));
+  }
+
+  EkepHandshakerOptions options_;
+  std::shared_ptr<EkepSessionCache> client_cache_;
+  std::shared_ptr<EkepSessionCache> server_cache_;
+};
+
+// Verify that handshakers without a session cache neither issue nor accept
+// session tickets.
+TEST_F(EkepSessionResumptionTest, ResumptionDisabled) {
+  for (int i = 0; i < 2; ++i) {
+    auto client = CreateClient(nullptr);
+    auto server = CreateServer(nullptr);
+    HandshakeOutcome outcome = RunHandshake(client.get(), server.get());
+    ExpectCompleted(outcome, /*client_flights=*/3, client.get(), server.get());
+  }
+}
+
+// Verify that a full handshake caches the session on both sides.
+TEST_F(EkepSessionResumptionTest, FullHandshakeCachesSession) {
+  auto client = CreateClient(client_cache_);
+  auto server = CreateServer(server_cache_);
+  HandshakeOutcome outcome = RunHandshake(client.get(), server.get());
+  ExpectCompleted(outcome, /*client_flights=*/3, client.get(), server.get());
+
+  EXPECT_THAT(client_cache_->Size(), Eq(1));
+  EXPECT_THAT(server_cache_->Size(), Eq(1));
+}
+
+// Verify that a session is resumed in a single round trip with fresh keys and
+// the peer identities of the original handshake.
+TEST_F(EkepSessionResumptionTest, ResumesSession) {
+  auto client = CreateClient(client_cache_);
+  auto server = CreateServer(server_cache_);
+  ExpectCompleted(RunHandshake(client.get(), server.get()),
+                  /*client_flights=*/3, client.get(), server.get());
+  auto client_peer_identities = client->GetPeerIdentities();
+  auto server_peer_identities = server->GetPeerIdentities();
+  ASSERT_THAT(client_peer_identities, IsOk());
+  ASSERT_THAT(server_peer_identities, IsOk());
+  CleansingVector<uint8_t> original_key =
+      client->GetRecordProtocolKey().ValueOrDie();
+
+  auto resumed_client = CreateClient(client_cache_);
+  auto resumed_server = CreateServer(server_cache_);
+  ExpectCompleted(RunHandshake(resumed_client.get(), resumed_server.get()),
+                  /*client_flights=*/2, resumed_client.get(),
+                  resumed_server.get());
+
+  EXPECT_THAT(resumed_client->GetRecordProtocolKey().ValueOrDie(),
+              Ne(original_key));
+
+  auto resumed_client_peer_identities = resumed_client->GetPeerIdentities();
+  auto resumed_server_peer_identities = resumed_server->GetPeerIdentities();
+  ASSERT_THAT(resumed_client_peer_identities, IsOk());
+  ASSERT_THAT(resumed_server_peer_identities, IsOk());
+  EXPECT_THAT(*resumed_client_peer_identities.ValueOrDie(),
+              EqualsProto(*client_peer_identities.ValueOrDie()));
+  EXPECT_THAT(*resumed_server_peer_identities.ValueOrDie(),
+              EqualsProto(*server_peer_identities.ValueOrDie()));
+
+  // The resumed handshake issued a new ticket, which can be resumed again.
+  EXPECT_THAT(client_cache_->Size(), Eq(1));
+  EXPECT_THAT(server_cache_->Size(), Eq(1));
+  auto next_client = CreateClient(client_cache_);
+  auto next_server = CreateServer(server_cache_);
+  ExpectCompleted(RunHandshake(next_client.get(), next_server.get()),
+                  /*client_flights=*/2, next_client.get(), next_server.get());
+}
+
+// Verify that the handshake falls back to exchanging assertions if the server
+// does not know the client's ticket.
+TEST_F(EkepSessionResumptionTest, UnknownTicketFallsBack) {
+  auto client = CreateClient(client_cache_);
+  auto server = CreateServer(server_cache_);
+  ExpectCompleted(RunHandshake(client.get(), server.get()),
+                  /*client_flights=*/3, client.get(), server.get());
+
+  auto other_server_cache = std::make_shared<EkepSessionCache>(absl::Hours(1));
+  auto next_client = CreateClient(client_cache_);
+  auto other_server = CreateServer(other_server_cache);
+  ExpectCompleted(RunHandshake(next_client.get(), other_server.get()),
+                  /*client_flights=*/3, next_client.get(), other_server.get());
+  EXPECT_THAT(client_cache_->Size(), Eq(1));
+  EXPECT_THAT(other_server_cache->Size(), Eq(1));
+}
+
+// Verify that a ticket can only be used once.
+TEST_F(EkepSessionResumptionTest, TicketIsSingleUse) {
+  auto client = CreateClient(client_cache_);
+  auto server = CreateServer(server_cache_);
+  ExpectCompleted(RunHandshake(client.get(), server.get()),
+                  /*client_flights=*/3, client.get(), server.get());
+
+  // Copy the client's session into a second client cache.
+  absl::optional<EkepSession> session = client_cache_->Take(kServerKey);
+  ASSERT_TRUE(session.has_value());
+  auto replay_cache = std::make_shared<EkepSessionCache>(absl::Hours(1));
+  replay_cache->Insert(kServerKey, session.value());
+  client_cache_->Insert(kServerKey, std::move(session).value());
+
+  auto resumed_client = CreateClient(client_cache_);
+  auto resumed_server = CreateServer(server_cache_);
+  ExpectCompleted(RunHandshake(resumed_client.get(), resumed_server.get()),
+                  /*client_flights=*/2, resumed_client.get(),
+                  resumed_server.get());
+
+  auto replay_client = CreateClient(replay_cache);
+  auto replay_server = CreateServer(server_cache_);
+  ExpectCompleted(RunHandshake(replay_client.get(), replay_server.get()),
+                  /*client_flights=*/3, replay_client.get(),
+                  replay_server.get());
+}
+
+// Verify that resuming a session without knowledge of its resumption secret
+// fails.
+TEST_F(EkepSessionResumptionTest, WrongResumptionSecretAborts) {
+  auto client = CreateClient(client_cache_);
+  auto server = CreateServer(server_cache_);
+  ExpectCompleted(RunHandshake(client.get(), server.get()),
+                  /*client_flights=*/3, client.get(), server.get());
+
+  absl::optional<EkepSession> session = client_cache_->Take(kServerKey);
+  ASSERT_TRUE(session.has_value());
+  session->resumption_secret[0] ^= 1;
+  client_cache_->Insert(kServerKey, std::move(session).value());
+
+  auto resumed_client = CreateClient(client_cache_);
+  auto resumed_server = CreateServer(server_cache_);
+  HandshakeOutcome outcome =
+      RunHandshake(resumed_client.get(), resumed_server.get());
+  EXPECT_THAT(outcome.client_result, Eq(EkepHandshaker::Result::ABORTED));
+  EXPECT_THAT(outcome.server_result, Eq(EkepHandshaker::Result::ABORTED));
+  EXPECT_THAT(client_cache_->Size(), Eq(0));
+  EXPECT_THAT(server_cache_->Size(), Eq(0));
+}
+
+// Verify that expired sessions are not resumed.
+TEST_F(EkepSessionResumptionTest, ExpiredSessionIsNotResumed) {
+  auto client = CreateClient(client_cache_);
+  auto server = CreateServer(server_cache_);
+  ExpectCompleted(RunHandshake(client.get(), server.get()),
+                  /*client_flights=*/3, client.get(), server.get());
+
+  // Move the client's session to a cache whose sessions expire immediately.
+  absl::optional<EkepSession> session = client_cache_->Take(kServerKey);
+  ASSERT_TRUE(session.has_value());
+  session->expiration = absl::InfinitePast();
+  auto expired_cache = std::make_shared<EkepSessionCache>(absl::Hours(1));
+  expired_cache->Insert(kServerKey, std::move(session).value());
+  EXPECT_THAT(expired_cache->Size(), Eq(0));
+
+  auto next_client = CreateClient(expired_cache);
+  auto next_server = CreateServer(server_cache_);
+  ExpectCompleted(RunHandshake(next_client.get(), next_server.get()),
+                  /*client_flights=*/3, next_client.get(), next_server.get());
+}
+
+}  // namespace
+}  // namespace asylo
@@ -19,6 +19,7 @@
 #include "asylo/grpc/auth/core/enclave_credentials.h"
 
 #include <iterator>
+#include <memory>
 #include <utility>
 
 #include "asylo/grpc/auth/core/enclave_security_connector.h"
@@ -27,6 +28,21 @@
 #include "src/core/lib/gprpp/ref_counted_ptr.h"
 #include "src/core/lib/security/credentials/credentials.h"
 
+namespace {
+
+// Creates the session cache for credentials configured with |options|, or
+// returns nullptr if session resumption is disabled.
+std::shared_ptr<asylo::EkepSessionCache> CreateSessionCache(
+    const asylo::EnclaveCredentialsOptions &options) {
+  if (!options.session_resumption_lifetime.has_value()) {
+    return nullptr;
+  }
+  return std::make_shared<asylo::EkepSessionCache>(
+      options.session_resumption_lifetime.value());
+}
+
+}  // namespace
+
 // Creates a grpc_enclave_channel_security_connector object.
 grpc_core::RefCountedPtr<grpc_channel_security_connector>
 grpc_enclave_channel_credentials::create_security_connector(
@@ -53,7 +69,9 @@ grpc_enclave_channel_credentials::grpc_enclave_channel_credentials(
       accepted_peer_assertions(
           std::make_move_iterator(options.accepted_peer_assertions.begin()),
           std::make_move_iterator(options.accepted_peer_assertions.end())),
-      peer_acl(std::move(options.peer_acl)) {}
+      peer_acl(std::move(options.peer_acl)),
+      session_cache(CreateSessionCache(options)),
+      max_protected_frame_size(options.max_protected_frame_size) {}
 
 grpc_enclave_server_credentials::grpc_enclave_server_credentials(
     asylo::EnclaveCredentialsOptions options)
@@ -65,4 +83,6 @@ grpc_enclave_server_credentials::grpc_enclave_server_credentials(
       accepted_peer_assertions(
           std::make_move_iterator(options.accepted_peer_assertions.begin()),
           std::make_move_iterator(options.accepted_peer_assertions.end())),
-      peer_acl(std::move(options.peer_acl)) {}
+      peer_acl(std::move(options.peer_acl)),
+      session_cache(CreateSessionCache(options)),
+      max_protected_frame_size(options.max_protected_frame_size) {}
@@ -21,6 +21,7 @@
 #include <algorithm>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <google/protobuf/io/coded_stream.h>
@@ -31,6 +32,7 @@
 #include "asylo/grpc/auth/core/client_ekep_handshaker.h"
 #include "asylo/grpc/auth/core/ekep_handshaker.h"
 #include "asylo/grpc/auth/core/ekep_handshaker_util.h"
+#include "asylo/grpc/auth/core/ekep_session_cache.h"
 #include "asylo/grpc/auth/core/handshake.pb.h"
 #include "asylo/grpc/auth/core/server_ekep_handshaker.h"
 #include "asylo/identity/delegating_identity_expectation_matcher.h"
@@ -43,6 +45,7 @@
 #include "src/core/lib/gpr/string.h"
 #include "src/core/lib/surface/api_trace.h"
 #include "src/core/tsi/alts/frame_protector/alts_frame_protector.h"
+#include "src/core/tsi/alts/zero_copy_frame_protector/alts_zero_copy_grpc_protector.h"
 #include "src/core/tsi/transport_security.h"
 #include "src/core/tsi/transport_security_interface.h"
 
@@ -51,6 +54,12 @@ namespace {
 
 constexpr int kEnclavePeerPropertyCount = 4;
 
+// Returns true if |record_protocol| is a variant of the ALTS record protocol
+// that rekeys its AES-GCM key.
+bool IsRekeyingRecordProtocol(RecordProtocol record_protocol) {
+  return record_protocol == ALTSRP_AES128_GCM_REKEY;
+}
+
 }  // namespace
 
 // --- tsi_handshaker_result implementation. ---
@@ -62,12 +71,14 @@ class TsiEnclaveHandshakerResult {
       bool is_client, RecordProtocol record_protocol,
       const CleansingVector<uint8_t> &record_protocol_key,
       std::unique_ptr<EnclaveIdentities> peer_identities,
-      std::string unused_bytes)
+      std::string unused_bytes,
+      absl::optional<size_t> max_protected_frame_size)
       : is_client_(is_client),
         record_protocol_(record_protocol),
         record_protocol_key_(record_protocol_key),
         peer_identities_(std::move(peer_identities)),
-        unused_bytes_(std::move(unused_bytes)) {}
+        unused_bytes_(std::move(unused_bytes)),
+        max_protected_frame_size_(max_protected_frame_size) {}
 
   // Creates a frame protector that uses a max frame size of
   // |max_output_protected_frame_size|, if non-null, and places the result in
@@ -76,10 +87,31 @@ class TsiEnclaveHandshakerResult {
                                   tsi_frame_protector **protector) {
     switch (record_protocol_) {
       case ALTSRP_AES128_GCM:
+      case ALTSRP_AES128_GCM_REKEY:
         return alts_create_frame_protector(
             record_protocol_key_.data(), record_protocol_key_.size(),
-            is_client_, /*is_rekey=*/false, max_output_protected_frame_size,
-            protector);
+            is_client_, IsRekeyingRecordProtocol(record_protocol_),
+            SelectMaxFrameSize(max_output_protected_frame_size), protector);
+      default:
+        return TSI_INTERNAL_ERROR;
+    }
+  }
+
+  // Creates a zero-copy frame protector that operates directly on gRPC slice
+  // buffers, which avoids copying each frame into and out of an intermediate
+  // buffer. Uses a max frame size of |max_output_protected_frame_size|, if
+  // non-null, and places the result in |protector|.
+  tsi_result CreateZeroCopyGrpcProtector(
+      size_t *max_output_protected_frame_size,
+      tsi_zero_copy_grpc_protector **protector) {
+    switch (record_protocol_) {
+      case ALTSRP_AES128_GCM:
+      case ALTSRP_AES128_GCM_REKEY:
+        return alts_zero_copy_grpc_protector_create(
+            record_protocol_key_.data(), record_protocol_key_.size(),
+            IsRekeyingRecordProtocol(record_protocol_), is_client_,
+            /*is_integrity_only=*/false, /*enable_extra_copy=*/false,
+            SelectMaxFrameSize(max_output_protected_frame_size), protector);
       default:
         return TSI_INTERNAL_ERROR;
     }
@@ -153,6 +185,17 @@ class TsiEnclaveHandshakerResult {
   }
 
  private:
+  // Returns the max frame size to request from a frame protector. Prefers the
+  // size requested by gRPC through |max_output_protected_frame_size|, if
+  // non-null, over the size configured in the credentials. Returns nullptr to
+  // request the frame protector's default size.
+  size_t *SelectMaxFrameSize(size_t *max_output_protected_frame_size) {
+    if (max_output_protected_frame_size || !max_protected_frame_size_) {
+      return max_output_protected_frame_size;
+    }
+    return &max_protected_frame_size_.value();
+  }
+
   // True if this is a client handshaker result. Required for configuration of
   // the frame protector.
   bool is_client_;
@@ -168,6 +211,11 @@ class TsiEnclaveHandshakerResult {
 
   // Unused bytes leftover at the end of the EKEP handshake.
   std::string unused_bytes_;
+
+  // The max size of protected frames configured in the credentials, if any.
+  // Frame protectors clamp this value to the sizes that they support and
+  // write back the size that they use.
+  absl::optional<size_t> max_protected_frame_size_;
 };
 
 // Implementation of tsi_handshaker_result that delegates all calls to a
@@ -195,6 +243,16 @@ tsi_result enclave_handshaker_result_create_frame_protector(
                                             protector);
 }
 
+tsi_result enclave_handshaker_result_create_zero_copy_grpc_protector(
+    const tsi_handshaker_result *self, size_t *max_output_protected_frame_size,
+    tsi_zero_copy_grpc_protector **protector) {
+  const tsi_enclave_handshaker_result *result =
+      reinterpret_cast<const tsi_enclave_handshaker_result *>(self);
+
+  return result->impl->CreateZeroCopyGrpcProtector(
+      max_output_protected_frame_size, protector);
+}
+
 tsi_result enclave_handshaker_result_get_unused_bytes(
     const tsi_handshaker_result *self, const unsigned char **bytes,
     size_t *bytes_size) {
@@ -212,7 +270,7 @@ void enclave_handshaker_result_destroy(tsi_handshaker_result *self) {
 
 const tsi_handshaker_result_vtable handshaker_result_vtable = {
     enclave_handshaker_result_extract_peer,
-    nullptr /* create_zero_copy_grpc_protector */,
+    enclave_handshaker_result_create_zero_copy_grpc_protector,
     enclave_handshaker_result_create_frame_protector,
     enclave_handshaker_result_get_unused_bytes,
     enclave_handshaker_result_destroy,
@@ -243,10 +301,12 @@ struct tsi_enclave_handshaker {
   const absl::optional<IdentityAclPredicate> peer_acl;
   std::unique_ptr<EkepHandshaker> handshaker;
   std::string outgoing_bytes;
+  const absl::optional<size_t> max_protected_frame_size;
 
   tsi_enclave_handshaker(bool is_client,
                          const absl::optional<IdentityAclPredicate> &peer_acl,
-                         std::unique_ptr<EkepHandshaker> ekep_handshaker);
+                         std::unique_ptr<EkepHandshaker> ekep_handshaker,
+                         absl::optional<size_t> max_protected_frame_size);
 
   tsi_result evaluate_acl(const std::vector<EnclaveIdentity> &identities);
 };
@@ -345,7 +405,8 @@ tsi_result enclave_handshaker_next(
           absl::make_unique<TsiEnclaveHandshakerResult>(
               tsi_handshaker->is_client, record_protocol_result.ValueOrDie(),
               key_result.ValueOrDie(), std::move(identities),
-              unused_bytes_result.ValueOrDie()),
+              unused_bytes_result.ValueOrDie(),
+              tsi_handshaker->max_protected_frame_size),
           handshaker_result);
       if (result == TSI_OK) {
         self->handshaker_result_created = true;
@@ -370,10 +431,12 @@ const tsi_handshaker_vtable handshaker_vtable = {
 
 tsi_enclave_handshaker::tsi_enclave_handshaker(
     bool is_client, const absl::optional<IdentityAclPredicate> &peer_acl,
-    std::unique_ptr<EkepHandshaker> ekep_handshaker)
+    std::unique_ptr<EkepHandshaker> ekep_handshaker,
+    absl::optional<size_t> max_protected_frame_size)
     : is_client(is_client),
       peer_acl(peer_acl),
-      handshaker(std::move(ekep_handshaker)) {
+      handshaker(std::move(ekep_handshaker)),
+      max_protected_frame_size(max_protected_frame_size) {
   base.handshaker_result_created = false;
   base.handshake_shutdown = false;
   base.vtable = &handshaker_vtable;
@@ -407,14 +470,19 @@ tsi_result tsi_enclave_handshaker_create(
     absl::Span<asylo::AssertionDescription> accepted_peer_assertions,
     absl::string_view additional_authenticated_data,
     const absl::optional<asylo::IdentityAclPredicate> &peer_acl,
+    std::shared_ptr<asylo::EkepSessionCache> session_cache,
+    absl::string_view session_cache_key,
+    absl::optional<size_t> max_protected_frame_size,
     tsi_handshaker **handshaker) {
   GRPC_API_TRACE(
       "tsi_enclave_handshaker_create(is_client=%d, self_assertions=%p, "
       "accepted_peer_assertions=%p, additional_authenticated_data=%p, "
-      "peer_acl=%d, handshaker=%p)",
-      6,
+      "peer_acl=%d, session_cache=%p, max_protected_frame_size=%zu, "
+      "handshaker=%p)",
+      8,
       (is_client, self_assertions.data(), accepted_peer_assertions.data(),
-       additional_authenticated_data.data(), peer_acl.has_value(), handshaker));
+       additional_authenticated_data.data(), peer_acl.has_value(),
+       session_cache.get(), max_protected_frame_size.value_or(0), handshaker));
 
   // Convert arguments to handshaker options.
   asylo::EkepHandshakerOptions options;
@@ -423,6 +491,8 @@ tsi_result tsi_enclave_handshaker_create(
   options.self_assertions = {self_assertions.cbegin(), self_assertions.cend()};
   options.accepted_peer_assertions = {accepted_peer_assertions.cbegin(),
                                       accepted_peer_assertions.cend()};
+  options.session_cache = std::move(session_cache);
+  options.session_cache_key = std::string(session_cache_key);
 
   if (!options.additional_authenticated_data.empty()) {
     gpr_log(GPR_DEBUG, "additional authenticated data: %s",
@@ -452,7 +522,8 @@ tsi_result tsi_enclave_handshaker_create(
 
   asylo::tsi_enclave_handshaker *tsi_handshaker =
       new asylo::tsi_enclave_handshaker(is_client, peer_acl,
-                                        std::move(ekep_handshaker));
+                                        std::move(ekep_handshaker),
+                                        max_protected_frame_size);
 
   *handshaker = &tsi_handshaker->base;
   return TSI_OK;
@@ -19,9 +19,13 @@
 #ifndef ASYLO_GRPC_AUTH_CORE_ENCLAVE_TRANSPORT_SECURITY_H_
 #define ASYLO_GRPC_AUTH_CORE_ENCLAVE_TRANSPORT_SECURITY_H_
 
+#include <cstddef>
+#include <memory>
+
 #include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
 #include "absl/types/span.h"
+#include "asylo/grpc/auth/core/ekep_session_cache.h"
 #include "asylo/identity/identity.pb.h"
 #include "asylo/identity/identity_acl.pb.h"
 #include "src/core/tsi/transport_security_interface.h"
@@ -47,11 +51,20 @@
 //   the handshake
 //   * |peer_acl| is the ACL evaluated using the authenticated peer's
 //   identities.
+//   * |session_cache| holds sessions that may be resumed without exchanging
+//   assertions, or is nullptr if session resumption is disabled
+//   * |session_cache_key| identifies the server to a client handshaker
+//   * |max_protected_frame_size| is the max size of frames produced by the
+//   frame protectors of the handshake result, or absl::nullopt to use the
+//   default size
 tsi_result tsi_enclave_handshaker_create(
     bool is_client, absl::Span<asylo::AssertionDescription> self_assertions,
     absl::Span<asylo::AssertionDescription> accepted_peer_assertions,
     absl::string_view additional_authenticated_data,
     const absl::optional<asylo::IdentityAclPredicate> &peer_acl,
+    std::shared_ptr<asylo::EkepSessionCache> session_cache,
+    absl::string_view session_cache_key,
+    absl::optional<size_t> max_protected_frame_size,
     tsi_handshaker **handshaker);
 
 #endif  // ASYLO_GRPC_AUTH_CORE_ENCLAVE_TRANSPORT_SECURITY_H_
@@ -0,0 +1,294 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/grpc/auth/core/local_channel.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "asylo/grpc/auth/core/client_ekep_handshaker.h"
+#include "asylo/grpc/auth/core/ekep_handshaker.h"
+#include "asylo/grpc/auth/core/handshake.pb.h"
+#include "asylo/grpc/auth/core/server_ekep_handshaker.h"
+#include "asylo/util/cleansing_types.h"
+#include "asylo/util/cleanup.h"
+#include "asylo/util/status_macros.h"
+#include "include/grpc/support/alloc.h"
+#include "src/core/tsi/alts/crypt/gsec.h"
+#include "src/core/tsi/alts/frame_protector/alts_crypter.h"
+
+namespace asylo {
+namespace {
+
+// Sizes of the ALTS record counters, as used by the ALTS frame protector. A
+// counter which would overflow fails the record instead of reusing a nonce.
+constexpr size_t kCounterOverflowSize = 5;
+constexpr size_t kRekeyCounterOverflowSize = 8;
+
+// Each ring is padded to a multiple of this alignment, so that the second
+// ring of a region is aligned like the first.
+constexpr size_t kRingAlignment = 64;
+
+size_t RingStride(size_t ring_capacity) {
+  return (LocalRing::RegionSize(ring_capacity) + kRingAlignment - 1) &
+         ~(kRingAlignment - 1);
+}
+
+// Returns an error with |message| and the |error_details| of a gRPC crypter
+// call, which it releases.
+Status CrypterError(error::GoogleError code, absl::string_view message,
+                    char *error_details) {
+  Status status(code, error_details == nullptr
+                          ? std::string(message)
+                          : absl::StrCat(message, ": ", error_details));
+  gpr_free(error_details);
+  return status;
+}
+
+// Creates a crypter which seals (or unseals, if |seal| is false) records with
+// |record_protocol| under |key|, on the side of the connection given by
+// |is_client|.
+StatusOr<alts_crypter *> CreateCrypter(RecordProtocol record_protocol,
+                                       const CleansingVector<uint8_t> &key,
+                                       bool is_client, bool seal) {
+  bool rekey;
+  switch (record_protocol) {
+    case ALTSRP_AES128_GCM:
+      rekey = false;
+      break;
+    case ALTSRP_AES128_GCM_REKEY:
+      rekey = true;
+      break;
+    default:
+      return Status(error::GoogleError::UNIMPLEMENTED,
+                    absl::StrCat("Unsupported record protocol: ",
+                                 RecordProtocol_Name(record_protocol)));
+  }
+
+  gsec_aead_crypter *aead_crypter = nullptr;
+  char *error_details = nullptr;
+  if (gsec_aes_gcm_aead_crypter_create(key.data(), key.size(),
+                                       kAesGcmNonceLength, kAesGcmTagLength,
+                                       rekey, &aead_crypter,
+                                       &error_details) != GRPC_STATUS_OK) {
+    return CrypterError(error::GoogleError::INTERNAL,
+                        "Failed to create AES-GCM crypter", error_details);
+  }
+
+  // The crypter takes ownership of |aead_crypter| once it is created.
+  alts_crypter *crypter = nullptr;
+  size_t overflow_size = rekey ? kRekeyCounterOverflowSize
+                               : kCounterOverflowSize;
+  grpc_status_code result =
+      seal ? alts_seal_crypter_create(aead_crypter, is_client, overflow_size,
+                                      &crypter, &error_details)
+           : alts_unseal_crypter_create(aead_crypter, is_client, overflow_size,
+                                        &crypter, &error_details);
+  if (result != GRPC_STATUS_OK) {
+    gsec_aead_crypter_destroy(aead_crypter);
+    return CrypterError(error::GoogleError::INTERNAL,
+                        "Failed to create ALTS record crypter", error_details);
+  }
+  return crypter;
+}
+
+// Runs |handshaker| to completion, exchanging its frames through |outgoing|
+// and |incoming|. The client starts the handshake.
+Status RunHandshake(bool is_client, EkepHandshaker *handshaker,
+                    LocalRing *outgoing, LocalRing *incoming) {
+  std::string output;
+  EkepHandshaker::Result result =
+      is_client ? handshaker->NextHandshakeStep(nullptr, 0, &output)
+                : EkepHandshaker::Result::NOT_ENOUGH_DATA;
+  while (true) {
+    // An aborted handshake may still have an Abort frame for the peer.
+    if (!output.empty()) {
+      ASYLO_RETURN_IF_ERROR(outgoing->Write(output));
+      output.clear();
+    }
+    if (result == EkepHandshaker::Result::COMPLETED) {
+      break;
+    }
+    if (result == EkepHandshaker::Result::ABORTED) {
+      return Status(error::GoogleError::UNAUTHENTICATED,
+                    "EKEP handshake aborted");
+    }
+    std::string input;
+    ASYLO_ASSIGN_OR_RETURN(input, incoming->Read());
+    result = handshaker->NextHandshakeStep(input.data(), input.size(), &output);
+  }
+
+  // Records only start in the frame after the last handshake frame.
+  std::string unused_bytes;
+  ASYLO_ASSIGN_OR_RETURN(unused_bytes, handshaker->GetUnusedBytes());
+  if (!unused_bytes.empty()) {
+    return Status(error::GoogleError::INTERNAL,
+                  "Unexpected bytes after the last handshake frame");
+  }
+  return Status::OkStatus();
+}
+
+}  // namespace
+
+size_t LocalChannel::RegionSize(size_t ring_capacity) {
+  return 2 * RingStride(ring_capacity);
+}
+
+StatusOr<std::unique_ptr<LocalChannel>> LocalChannel::Connect(
+    const EkepHandshakerOptions &options, void *region, size_t region_size) {
+  return Establish(/*is_client=*/true, options, region, region_size);
+}
+
+StatusOr<std::unique_ptr<LocalChannel>> LocalChannel::Accept(
+    const EkepHandshakerOptions &options, void *region, size_t region_size) {
+  return Establish(/*is_client=*/false, options, region, region_size);
+}
+
+StatusOr<std::unique_ptr<LocalChannel>> LocalChannel::Establish(
+    bool is_client, const EkepHandshakerOptions &options, void *region,
+    size_t region_size) {
+  // The client writes to the first ring and reads from the second one.
+  const size_t stride = (region_size / 2) & ~(kRingAlignment - 1);
+  auto *base = static_cast<uint8_t *>(region);
+  StatusOr<LocalRing> first = LocalRing::Attach(base, stride);
+  ASYLO_RETURN_IF_ERROR(first.status());
+  StatusOr<LocalRing> second = LocalRing::Attach(base + stride, stride);
+  ASYLO_RETURN_IF_ERROR(second.status());
+  LocalRing outgoing = std::move(is_client ? first : second).ValueOrDie();
+  LocalRing incoming = std::move(is_client ? second : first).ValueOrDie();
+  if (outgoing.max_frame_size() <= kAesGcmTagLength) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Channel region is too small");
+  }
+
+  // Closing the rings on failure wakes up the peer, so that it fails too.
+  Cleanup close_rings([&outgoing, &incoming] {
+    outgoing.Close();
+    incoming.Close();
+  });
+
+  ASYLO_RETURN_IF_ERROR(options.Validate());
+  std::unique_ptr<EkepHandshaker> handshaker =
+      is_client ? ClientEkepHandshaker::Create(options)
+                : ServerEkepHandshaker::Create(options);
+  if (!handshaker) {
+    return Status(error::GoogleError::INTERNAL,
+                  "Failed to create EKEP handshaker");
+  }
+  ASYLO_RETURN_IF_ERROR(
+      RunHandshake(is_client, handshaker.get(), &outgoing, &incoming));
+
+  RecordProtocol record_protocol;
+  ASYLO_ASSIGN_OR_RETURN(record_protocol, handshaker->GetRecordProtocol());
+  CleansingVector<uint8_t> key;
+  ASYLO_ASSIGN_OR_RETURN(key, handshaker->GetRecordProtocolKey());
+  std::unique_ptr<EnclaveIdentities> peer_identities;
+  ASYLO_ASSIGN_OR_RETURN(peer_identities, handshaker->GetPeerIdentities());
+
+  alts_crypter *seal_crypter;
+  ASYLO_ASSIGN_OR_RETURN(
+      seal_crypter,
+      CreateCrypter(record_protocol, key, is_client, /*seal=*/true));
+  StatusOr<alts_crypter *> unseal_crypter =
+      CreateCrypter(record_protocol, key, is_client, /*seal=*/false);
+  if (!unseal_crypter.ok()) {
+    alts_crypter_destroy(seal_crypter);
+    return unseal_crypter.status();
+  }
+
+  close_rings.release();
+  return absl::WrapUnique(new LocalChannel(
+      std::move(outgoing), std::move(incoming), std::move(*peer_identities),
+      seal_crypter, unseal_crypter.ValueOrDie()));
+}
+
+LocalChannel::LocalChannel(LocalRing outgoing, LocalRing incoming,
+                           EnclaveIdentities peer_identities,
+                           alts_crypter *seal_crypter,
+                           alts_crypter *unseal_crypter)
+    : outgoing_(std::move(outgoing)),
+      incoming_(std::move(incoming)),
+      seal_crypter_(seal_crypter),
+      unseal_crypter_(unseal_crypter),
+      peer_identities_(std::move(peer_identities)),
+      max_message_size_(outgoing_.max_frame_size() -
+                        alts_crypter_num_overhead_bytes(seal_crypter)) {}
+
+LocalChannel::~LocalChannel() {
+  Close();
+  alts_crypter_destroy(seal_crypter_);
+  alts_crypter_destroy(unseal_crypter_);
+}
+
+size_t LocalChannel::max_message_size() const { return max_message_size_; }
+
+Status LocalChannel::Send(ByteContainerView message) {
+  if (message.size() > max_message_size_) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  absl::StrCat("Message of ", message.size(),
+                               " bytes exceeds the channel limit of ",
+                               max_message_size_, " bytes"));
+  }
+
+  absl::MutexLock lock(&send_mu_);
+  // The record is sealed in place, with room for its tag.
+  seal_buffer_.assign(reinterpret_cast<const char *>(message.data()),
+                      message.size());
+  seal_buffer_.resize(message.size() +
+                      alts_crypter_num_overhead_bytes(seal_crypter_));
+  size_t sealed_size = 0;
+  char *error_details = nullptr;
+  if (alts_crypter_process_in_place(
+          seal_crypter_, reinterpret_cast<unsigned char *>(&seal_buffer_[0]),
+          seal_buffer_.size(), message.size(), &sealed_size,
+          &error_details) != GRPC_STATUS_OK) {
+    return CrypterError(error::GoogleError::INTERNAL,
+                        "Failed to seal record", error_details);
+  }
+  return outgoing_.Write(ByteContainerView(seal_buffer_.data(), sealed_size));
+}
+
+StatusOr<std::string> LocalChannel::Receive() {
+  absl::MutexLock lock(&receive_mu_);
+  std::string record;
+  ASYLO_ASSIGN_OR_RETURN(record, incoming_.Read());
+  size_t message_size = 0;
+  char *error_details = nullptr;
+  if (alts_crypter_process_in_place(
+          unseal_crypter_, reinterpret_cast<unsigned char *>(&record[0]),
+          record.size(), record.size(), &message_size,
+          &error_details) != GRPC_STATUS_OK) {
+    return CrypterError(error::GoogleError::DATA_LOSS,
+                        "Failed to unseal record", error_details);
+  }
+  record.resize(message_size);
+  return record;
+}
+
+void LocalChannel::Close() {
+  outgoing_.Close();
+  incoming_.Close();
+}
+
+}  // namespace asylo
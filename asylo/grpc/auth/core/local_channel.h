@@ -0,0 +1,122 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_GRPC_AUTH_CORE_LOCAL_CHANNEL_H_
+#define ASYLO_GRPC_AUTH_CORE_LOCAL_CHANNEL_H_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "asylo/crypto/util/byte_container_view.h"
+#include "asylo/grpc/auth/core/ekep_handshaker_util.h"
+#include "asylo/identity/identity.pb.h"
+#include "asylo/platform/core/local_ring.h"
+#include "asylo/util/status.h"
+#include "asylo/util/statusor.h"
+
+struct alts_crypter;
+
+namespace asylo {
+
+// A secure channel between two enclaves on the same host, which exchange
+// messages through a pair of LocalRings in untrusted memory instead of going
+// through gRPC and the network stack.
+//
+// Both enclaves first run an EKEP handshake over the rings. When they offer
+// and accept SGX local assertions, the handshake proves that both run on the
+// same platform. Every message is then sealed with the ALTS record protocol
+// under the record protocol key negotiated by the handshake, so the host sees
+// neither the contents of the messages nor can it tamper with, replay, reorder
+// or drop them undetected. The rings only add the cost of two copies and,
+// when the receiver is asleep, a futex wakeup through the host.
+//
+// The host allocates a zero-filled region of RegionSize() bytes, aligned to 64
+// bytes, and hands it to both enclaves. One of them calls Connect() and the
+// other Accept(). Send() and Receive() may be called concurrently with each
+// other, but not with themselves.
+class LocalChannel {
+ public:
+  // Returns the size of a region holding two rings of |ring_capacity| bytes.
+  static size_t RegionSize(size_t ring_capacity);
+
+  // Runs the client side of the handshake with |options| over |region| of
+  // |region_size| bytes, and returns the established channel.
+  static StatusOr<std::unique_ptr<LocalChannel>> Connect(
+      const EkepHandshakerOptions &options, void *region, size_t region_size);
+
+  // Runs the server side of the handshake with |options| over |region| of
+  // |region_size| bytes, and returns the established channel.
+  static StatusOr<std::unique_ptr<LocalChannel>> Accept(
+      const EkepHandshakerOptions &options, void *region, size_t region_size);
+
+  LocalChannel(const LocalChannel &other) = delete;
+  LocalChannel &operator=(const LocalChannel &other) = delete;
+
+  // Closes the channel.
+  ~LocalChannel();
+
+  // Returns the identities the peer proved during the handshake.
+  const EnclaveIdentities &peer_identities() const { return peer_identities_; }
+
+  // Returns the size of the largest message Send() accepts.
+  size_t max_message_size() const;
+
+  // Seals |message| and sends it to the peer, waiting for room in the ring if
+  // it is full.
+  Status Send(ByteContainerView message) ABSL_LOCKS_EXCLUDED(send_mu_);
+
+  // Waits for the next message from the peer and returns it unsealed. Fails
+  // with UNAVAILABLE once the channel is closed, and with DATA_LOSS if the
+  // message was tampered with.
+  StatusOr<std::string> Receive() ABSL_LOCKS_EXCLUDED(receive_mu_);
+
+  // Closes the rings in both directions, which wakes up the peer.
+  void Close();
+
+ private:
+  LocalChannel(LocalRing outgoing, LocalRing incoming,
+               EnclaveIdentities peer_identities, alts_crypter *seal_crypter,
+               alts_crypter *unseal_crypter);
+
+  static StatusOr<std::unique_ptr<LocalChannel>> Establish(
+      bool is_client, const EkepHandshakerOptions &options, void *region,
+      size_t region_size);
+
+  // Writes to |outgoing_| and reads from |incoming_| are serialized by
+  // |send_mu_| and |receive_mu_| respectively. Close() only marks the rings
+  // closed, so it needs neither.
+  LocalRing outgoing_;
+  LocalRing incoming_;
+
+  absl::Mutex send_mu_;
+  alts_crypter *const seal_crypter_ ABSL_GUARDED_BY(send_mu_);
+  std::string seal_buffer_ ABSL_GUARDED_BY(send_mu_);
+
+  absl::Mutex receive_mu_;
+  alts_crypter *const unseal_crypter_ ABSL_GUARDED_BY(receive_mu_);
+
+  const EnclaveIdentities peer_identities_;
+  const size_t max_message_size_;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_GRPC_AUTH_CORE_LOCAL_CHANNEL_H_
@@ -0,0 +1,182 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/grpc/auth/core/local_channel.h"
+
+#include <stdlib.h>
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/strings/str_cat.h"
+#include "asylo/grpc/auth/core/ekep_handshaker_util.h"
+#include "asylo/identity/descriptions.h"
+#include "asylo/identity/identity.pb.h"
+#include "asylo/identity/init.h"
+#include "asylo/platform/core/local_ring.h"
+#include "asylo/test/util/enclave_assertion_authority_configs.h"
+#include "asylo/test/util/status_matchers.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+namespace {
+
+using ::testing::Eq;
+using ::testing::Ne;
+using ::testing::SizeIs;
+
+constexpr size_t kRingCapacity = 4096;
+
+class LocalChannelTest : public ::testing::Test {
+ protected:
+  static void SetUpTestCase() {
+    std::vector<EnclaveAssertionAuthorityConfig> authority_configs = {
+        GetNullAssertionAuthorityTestConfig()};
+    ASSERT_THAT(InitializeEnclaveAssertionAuthorities(
+                    authority_configs.cbegin(), authority_configs.cend()),
+                IsOk());
+  }
+
+  void SetUp() override {
+    AssertionDescription null_assertion_description;
+    SetNullAssertionDescription(&null_assertion_description);
+    options_.self_assertions = {null_assertion_description};
+    options_.accepted_peer_assertions = {null_assertion_description};
+
+    region_size_ = LocalChannel::RegionSize(kRingCapacity);
+    region_ = aligned_alloc(64, region_size_);
+    memset(region_, 0, region_size_);
+  }
+
+  void TearDown() override {
+    client_.reset();
+    server_.reset();
+    free(region_);
+  }
+
+  // Establishes |client_| and |server_| over |region_|.
+  void Establish() {
+    std::thread server_thread([this] {
+      auto server = LocalChannel::Accept(options_, region_, region_size_);
+      ASSERT_THAT(server, IsOk());
+      server_ = std::move(server).ValueOrDie();
+    });
+    auto client = LocalChannel::Connect(options_, region_, region_size_);
+    server_thread.join();
+    ASSERT_THAT(client, IsOk());
+    client_ = std::move(client).ValueOrDie();
+    ASSERT_THAT(server_, Ne(nullptr));
+  }
+
+  EkepHandshakerOptions options_;
+  void *region_;
+  size_t region_size_;
+  std::unique_ptr<LocalChannel> client_;
+  std::unique_ptr<LocalChannel> server_;
+};
+
+TEST_F(LocalChannelTest, ExchangesMessagesBothWays) {
+  ASSERT_NO_FATAL_FAILURE(Establish());
+  EXPECT_THAT(client_->peer_identities().identities(), SizeIs(1));
+  EXPECT_THAT(server_->peer_identities().identities(), SizeIs(1));
+
+  std::thread echo([this] {
+    for (int i = 0; i < 100; ++i) {
+      auto message = server_->Receive();
+      ASSERT_THAT(message, IsOk());
+      ASSERT_THAT(server_->Send(absl::StrCat(message.ValueOrDie(), " back")),
+                  IsOk());
+    }
+  });
+  for (int i = 0; i < 100; ++i) {
+    ASSERT_THAT(client_->Send(absl::StrCat("message ", i)), IsOk());
+    EXPECT_THAT(client_->Receive(),
+                IsOkAndHolds(absl::StrCat("message ", i, " back")));
+  }
+  echo.join();
+}
+
+TEST_F(LocalChannelTest, SealsMessages) {
+  ASSERT_NO_FATAL_FAILURE(Establish());
+  const std::string secret = "not for the host to see";
+  ASSERT_THAT(client_->Send(secret), IsOk());
+
+  // The record follows the handshake frames in the client's ring, so search
+  // the whole ring.
+  auto *ring = static_cast<const char *>(region_);
+  size_t ring_size = LocalRing::RegionSize(kRingCapacity);
+  EXPECT_THAT(std::string(ring, ring_size).find(secret),
+              Eq(std::string::npos));
+  EXPECT_THAT(server_->Receive(), IsOkAndHolds(secret));
+}
+
+TEST_F(LocalChannelTest, DetectsTamperedMessages) {
+  ASSERT_NO_FATAL_FAILURE(Establish());
+  const std::string message(64, 'm');
+  ASSERT_THAT(server_->Send(message), IsOk());
+
+  // The server's ring only holds its handshake frames and the record, which
+  // is last. Flip the last byte of its tag.
+  auto *ring = static_cast<uint8_t *>(region_) + region_size_ / 2;
+  uint64_t write_position;
+  memcpy(&write_position, ring, sizeof(write_position));
+  ring[LocalRing::RegionSize(0) + (write_position - 1) % kRingCapacity] ^= 1;
+
+  EXPECT_THAT(client_->Receive(), StatusIs(error::GoogleError::DATA_LOSS));
+}
+
+TEST_F(LocalChannelTest, RejectsOversizedMessages) {
+  ASSERT_NO_FATAL_FAILURE(Establish());
+  std::string largest(client_->max_message_size(), 'x');
+  EXPECT_THAT(client_->Send(largest + "x"),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+  ASSERT_THAT(client_->Send(largest), IsOk());
+  EXPECT_THAT(server_->Receive(), IsOkAndHolds(largest));
+}
+
+TEST_F(LocalChannelTest, CloseWakesUpPeer) {
+  ASSERT_NO_FATAL_FAILURE(Establish());
+  std::thread closer([this] { client_->Close(); });
+  EXPECT_THAT(server_->Receive(), StatusIs(error::GoogleError::UNAVAILABLE));
+  closer.join();
+  EXPECT_THAT(server_->Send("late"),
+              StatusIs(error::GoogleError::UNAVAILABLE));
+}
+
+TEST_F(LocalChannelTest, FailsWhenPeerFails) {
+  // A server which cannot run the handshake closes the rings, which stops the
+  // client waiting for its frames.
+  EkepHandshakerOptions server_options = options_;
+  server_options.accepted_peer_assertions.clear();
+  std::thread server_thread([this, &server_options] {
+    EXPECT_THAT(LocalChannel::Accept(server_options, region_, region_size_),
+                StatusIs(error::GoogleError::INVALID_ARGUMENT));
+  });
+  EXPECT_THAT(LocalChannel::Connect(options_, region_, region_size_),
+              StatusIs(error::GoogleError::UNAVAILABLE));
+  server_thread.join();
+}
+
+}  // namespace
+}  // namespace asylo
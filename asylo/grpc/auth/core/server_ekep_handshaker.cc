@@ -18,9 +18,11 @@
 
 #include "asylo/grpc/auth/core/server_ekep_handshaker.h"
 
-#include <openssl/curve25519.h>
 #include <openssl/rand.h>
 
+#include <utility>
+#include <vector>
+
 #include <google/protobuf/io/zero_copy_stream_impl_lite.h>
 #include "absl/memory/memory.h"
 #include "asylo/crypto/sha256_hash.h"
@@ -28,6 +30,8 @@
 #include "asylo/grpc/auth/core/ekep_crypto.h"
 #include "asylo/grpc/auth/core/ekep_error_space.h"
 #include "asylo/grpc/auth/core/ekep_handshaker_util.h"
+#include "asylo/grpc/auth/core/ekep_key_pool.h"
+#include "asylo/grpc/auth/core/ekep_session_cache.h"
 #include "asylo/grpc/auth/core/handshake.pb.h"
 #include "asylo/identity/identity.pb.h"
 #include "asylo/util/cleansing_types.h"
@@ -60,9 +64,11 @@ ServerEkepHandshaker::ServerEkepHandshaker(const EkepHandshakerOptions &options)
       self_assertions_(options.self_assertions),
       accepted_peer_assertions_(options.accepted_peer_assertions),
       available_cipher_suites_({CURVE25519_SHA256}),
-      available_record_protocols_({ALTSRP_AES128_GCM}),
+      available_record_protocols_(
+          {ALTSRP_AES128_GCM_REKEY, ALTSRP_AES128_GCM}),
       available_ekep_versions_({"EKEP v1"}),
       additional_authenticated_data_(options.additional_authenticated_data),
+      session_cache_(options.session_cache),
       selected_cipher_suite_(UNKNOWN_HANDSHAKE_CIPHER),
       selected_record_protocol_(UNKNOWN_RECORD_PROTOCOL),
       expected_message_type_(CLIENT_PRECOMMIT),
@@ -163,6 +169,8 @@ ServerEkepHandshaker::Result ServerEkepHandshaker::HandleHandshakeMessage(
              selected_cipher_suite_, selected_record_protocol_, master_secret_)
              .ok()) {
       handshaker_state_ = HandshakeState::ABORTED;
+    } else {
+      CacheSession();
     }
   }
 
@@ -230,6 +238,21 @@ Status ServerEkepHandshaker::HandleClientPrecommit(
                   "Received a challenge with incorrect size");
   }
 
+  // Resume the session identified by the client's ticket if it is still cached
+  // and compatible with the selected parameters. Otherwise, fall back to a
+  // regular handshake. The ticket is single-use either way.
+  if (session_cache_ && client_precommit.has_session_ticket()) {
+    resumed_session_ = session_cache_->Take(client_precommit.session_ticket());
+    if (resumed_session_.has_value() &&
+        resumed_session_->ekep_version == selected_ekep_version_ &&
+        resumed_session_->cipher_suite == selected_cipher_suite_ &&
+        resumed_session_->record_protocol == selected_record_protocol_) {
+      expected_message_type_ = CLIENT_FINISH;
+      return ResumeSession(output);
+    }
+    resumed_session_.reset();
+  }
+
   for (const AssertionOffer &offer : client_precommit.client_offers()) {
     const AssertionDescription &offer_desc = offer.description();
     // Request any assertion that the peer offered and that this handshaker is
@@ -270,6 +293,32 @@ Status ServerEkepHandshaker::HandleClientPrecommit(
   return WriteServerPrecommit(output);
 }
 
+Status ServerEkepHandshaker::ResumeSession(std::string *output) {
+  // The client's identities were verified in the handshake that established
+  // the session, and only a participant in that handshake knows the
+  // resumption secret.
+  for (const EnclaveIdentity &identity :
+       resumed_session_->peer_identities.identities()) {
+    AddPeerIdentity(identity);
+  }
+
+  ASYLO_RETURN_IF_ERROR(WriteServerPrecommit(output));
+
+  // At this stage in a resumed handshake, the transcript is:
+  //   hash(ClientPrecommit || ServerPrecommit)
+  //
+  // This transcript is used by both the client and server to derive the EKEP
+  // secrets.
+  std::string transcript_hash;
+  ASYLO_RETURN_IF_ERROR(GetTranscriptHash(&transcript_hash));
+  ASYLO_RETURN_IF_ERROR(DeriveResumedSecrets(
+      selected_cipher_suite_, transcript_hash,
+      resumed_session_->resumption_secret, &master_secret_,
+      &authenticator_secret_));
+
+  return WriteServerFinish(output);
+}
+
 Status ServerEkepHandshaker::HandleClientId(const google::protobuf::Message &message,
                                             std::string *output) {
   const auto *client_id_ptr = dynamic_cast<const ClientId *>(&message);
@@ -297,18 +346,6 @@ Status ServerEkepHandshaker::HandleClientId(const google::protobuf::Message &mes
                     "Client provided an assertion that was not previously "
                     "requested");
     }
-
-    EnclaveIdentity identity;
-    // Note that assertion verifiers were verified during creation of the
-    // handshaker so there is no need to check whether the call to
-    // GetEnclaveAssertionVerifier() returns nullptr.
-    Status status = GetEnclaveAssertionVerifier(assertion.description())
-                        ->Verify(ekep_context, assertion, &identity);
-    if (!status.ok()) {
-      LOG(ERROR) << "Assertion could not be verified: " << status;
-      return Status(Abort::BAD_ASSERTION, "Assertion could not be verified");
-    }
-    AddPeerIdentity(identity);
     expected_peer_assertions_.erase(desc_it);
   }
 
@@ -318,6 +355,20 @@ Status ServerEkepHandshaker::HandleClientId(const google::protobuf::Message &mes
                   "Client did not provide all expected assertions");
   }
 
+  // Verify all assertions concurrently. Note that assertion verifiers were
+  // verified during creation of the handshaker so there is no need to check
+  // whether the calls to GetEnclaveAssertionVerifier() return nullptr.
+  std::vector<EnclaveIdentity> identities;
+  Status status =
+      VerifyAssertions(ekep_context, client_id.assertions(), &identities);
+  if (!status.ok()) {
+    LOG(ERROR) << "Assertion could not be verified: " << status;
+    return Status(Abort::BAD_ASSERTION, "Assertion could not be verified");
+  }
+  for (const EnclaveIdentity &identity : identities) {
+    AddPeerIdentity(identity);
+  }
+
   std::copy(client_id.dh_public_key().cbegin(),
             client_id.dh_public_key().cend(),
             std::back_inserter(client_public_key_));
@@ -374,6 +425,10 @@ Status ServerEkepHandshaker::WriteServerPrecommit(std::string *output) {
   }
   server_precommit.set_challenge(challenge.data(), challenge.size());
 
+  if (resumed_session_.has_value()) {
+    server_precommit.set_resumed(true);
+  }
+
   for (const AssertionRequest &request : promised_assertions_) {
     const AssertionDescription &description = request.description();
     // Note that assertion generators were verified during creation of the
@@ -403,14 +458,16 @@ Status ServerEkepHandshaker::WriteServerPrecommit(std::string *output) {
 }
 
 Status ServerEkepHandshaker::WriteServerId(std::string *output) {
-  // Generate an ephemeral Diffie-Hellman key-pair for the negotiated cipher
-  // suite.
+  // Take an ephemeral Diffie-Hellman key-pair for the negotiated cipher suite.
+  // The key-pair was generated ahead of the handshake and is not handed out to
+  // any other handshake.
   switch (selected_cipher_suite_) {
-    case CURVE25519_SHA256:
-      dh_public_key_.resize(X25519_PUBLIC_VALUE_LEN);
-      dh_private_key_.resize(X25519_PRIVATE_KEY_LEN);
-      X25519_keypair(dh_public_key_.data(), dh_private_key_.data());
+    case CURVE25519_SHA256: {
+      EkepEphemeralKey key = EkepKeyPool::GetInstance()->Take();
+      dh_public_key_ = std::move(key.public_key);
+      dh_private_key_ = std::move(key.private_key);
       break;
+    }
     default:
       LOG(ERROR) << "Server handshaker has bad cipher suite configuration";
       return Status(Abort::INTERNAL_ERROR, "Error using selected cipher suite");
@@ -437,39 +494,39 @@ Status ServerEkepHandshaker::WriteServerId(std::string *output) {
   }
 
   // Generate all assertions that the client requested and that the server
-  // offered.
+  // offered, concurrently. Note that assertion generators were verified during
+  // creation of the handshaker so there is no need to check whether the calls
+  // to GetEnclaveAssertionGenerator() return nullptr.
+  std::vector<const AssertionRequest *> requests;
+  requests.reserve(promised_assertions_.size());
   for (const AssertionRequest &request : promised_assertions_) {
-    // Note that assertion generators were verified during creation of the
-    // handshaker so there is no need to check whether the call to
-    // GetEnclaveAssertionGenerator() returns nullptr.
-    Status status =
-        GetEnclaveAssertionGenerator(request.description())
-            ->Generate(ekep_context, request, server_id.add_assertions());
-    if (!status.ok()) {
-      LOG(ERROR) << "Assertion generation failed: " << status;
-      return Status(Abort::INTERNAL_ERROR, "Assertion generation failed");
-    }
+    requests.push_back(&request);
+  }
+  Status status = GenerateAssertions(ekep_context, requests,
+                                     server_id.mutable_assertions());
+  if (!status.ok()) {
+    LOG(ERROR) << "Assertion generation failed: " << status;
+    return Status(Abort::INTERNAL_ERROR, "Assertion generation failed");
   }
 
   ASYLO_RETURN_IF_ERROR(
       WriteFrameAndUpdateTranscript(SERVER_ID, server_id, output));
 
-  return WriteServerFinish(output);
-}
-
-Status ServerEkepHandshaker::WriteServerFinish(std::string *output) {
   // At this stage in the protocol, the transcript is:
   //   hash(ClientPrecommit || ServerPrecommit || ClientId || ServerId)
   //
   // This transcript is used by both the client and server to derive the EKEP
   // secrets.
-  std::string transcript_hash;
   ASYLO_RETURN_IF_ERROR(GetTranscriptHash(&transcript_hash));
 
   ASYLO_RETURN_IF_ERROR(DeriveSecrets(selected_cipher_suite_, transcript_hash,
                                       client_public_key_, dh_private_key_,
                                       &master_secret_, &authenticator_secret_));
 
+  return WriteServerFinish(output);
+}
+
+Status ServerEkepHandshaker::WriteServerFinish(std::string *output) {
   CleansingVector<uint8_t> authenticator;
   ASYLO_RETURN_IF_ERROR(ComputeServerHandshakeAuthenticator(
       selected_cipher_suite_, authenticator_secret_, &authenticator));
@@ -478,9 +535,51 @@ Status ServerEkepHandshaker::WriteServerFinish(std::string *output) {
   server_finish.set_handshake_authenticator(authenticator.data(),
                                             authenticator.size());
 
+  // Issue a ticket for resuming this session. The session is only added to the
+  // cache once the client has proven knowledge of the EKEP secrets.
+  if (session_cache_) {
+    session_ticket_.resize(kEkepSessionTicketSize);
+    if (RAND_bytes(reinterpret_cast<uint8_t *>(&session_ticket_[0]),
+                   session_ticket_.size()) != 1) {
+      return Status(Abort::INTERNAL_ERROR, "Internal error");
+    }
+    server_finish.set_session_ticket(session_ticket_);
+  }
+
   return WriteFrameAndUpdateTranscript(SERVER_FINISH, server_finish, output);
 }
 
+void ServerEkepHandshaker::CacheSession() {
+  if (!session_cache_ || session_ticket_.empty()) {
+    return;
+  }
+
+  EkepSession session;
+  session.ticket = session_ticket_;
+  session.ekep_version = selected_ekep_version_;
+  session.cipher_suite = selected_cipher_suite_;
+  session.record_protocol = selected_record_protocol_;
+  session.peer_identities = peer_identities();
+
+  // A resumed session keeps the expiration of the session that was attested.
+  session.expiration = resumed_session_.has_value()
+                           ? resumed_session_->expiration
+                           : session_cache_->NewSessionExpiration();
+
+  std::string transcript_hash;
+  Status status = GetTranscriptHash(&transcript_hash);
+  if (status.ok()) {
+    status = DeriveResumptionSecret(selected_cipher_suite_, transcript_hash,
+                                    master_secret_,
+                                    &session.resumption_secret);
+  }
+  if (!status.ok()) {
+    LOG(WARNING) << "Session cannot be resumed: " << status;
+    return;
+  }
+  session_cache_->Insert(session_ticket_, std::move(session));
+}
+
 bool ServerEkepHandshaker::SetSelectedEkepVersion(
     const google::protobuf::RepeatedPtrField<EkepVersion> &ekep_versions) {
   // Choose the first compatible EKEP version available.
@@ -26,8 +26,10 @@
 
 #include <google/protobuf/io/zero_copy_stream.h>
 #include <google/protobuf/message.h>
+#include "absl/types/optional.h"
 #include "asylo/grpc/auth/core/ekep_handshaker.h"
 #include "asylo/grpc/auth/core/ekep_handshaker_util.h"
+#include "asylo/grpc/auth/core/ekep_session_cache.h"
 #include "asylo/util/cleansing_types.h"
 
 namespace asylo {
@@ -36,6 +38,12 @@ namespace asylo {
 // handshake. It handles ClientPrecommit, ClientId, and ClientFinish messages
 // from the client and sends ServerPrecommit, ServerId, and ServerFinish
 // messages to the client.
+//
+// If configured with a session cache, the handshaker issues a session ticket in
+// each ServerFinish and resumes the corresponding session when a client
+// presents the ticket in a later ClientPrecommit. In a resumed handshake the
+// ServerPrecommit is directly followed by the ServerFinish and neither
+// participant sends any assertions.
 class ServerEkepHandshaker final : public EkepHandshaker {
  public:
   // Creates a ServerEkepHandshaker configured with the given |options|, if
@@ -81,6 +89,11 @@ class ServerEkepHandshaker final : public EkepHandshaker {
   Status HandleClientPrecommit(const google::protobuf::Message &message,
                                std::string *output);
 
+  // Resumes |resumed_session_| by writing the ServerPrecommit and ServerFinish
+  // messages to |output| and updating the handshake transcript with both
+  // outgoing frames.
+  Status ResumeSession(std::string *output);
+
   // Validates the ClientId handshake message contained in |message|. If
   // validation succeeds, writes the ServerId and ServerFinish messages to
   // |output| and updates the handshake transcript with both outgoing frames.
@@ -100,6 +113,10 @@ class ServerEkepHandshaker final : public EkepHandshaker {
   // transcript.
   Status WriteServerFinish(std::string *output);
 
+  // Adds the session established by the completed handshake to the session
+  // cache, under the ticket issued in the ServerFinish.
+  void CacheSession();
+
   // Sets the handshaker's selected EKEP version to first compatible EKEP
   // version in |ekep_versions|. Returns false if there is no compatible EKEP
   // version in |ekep_versions|.
@@ -136,6 +153,16 @@ class ServerEkepHandshaker final : public EkepHandshaker {
   // Additional data that is authenticated during the handshake.
   const std::string additional_authenticated_data_;
 
+  // Cache of resumable sessions, or nullptr if session resumption is disabled.
+  const std::shared_ptr<EkepSessionCache> session_cache_;
+
+  // The session resumed by this handshake, if any. This field is populated
+  // after validation of the ClientPrecommit message.
+  absl::optional<EkepSession> resumed_session_;
+
+  // The session ticket issued to the client in the ServerFinish, if any.
+  std::string session_ticket_;
+
   // Assertions requested by the client that the server is willing to offer.
   // This field is populated after validation of the ClientPrecommit message.
   std::vector<AssertionRequest> promised_assertions_;
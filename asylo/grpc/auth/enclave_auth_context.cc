@@ -18,8 +18,13 @@
 
 #include "asylo/grpc/auth/enclave_auth_context.h"
 
+#include <string>
+#include <utility>
+
 #include <google/protobuf/io/coded_stream.h>
 #include "absl/strings/str_cat.h"
+#include "asylo/crypto/sha256_hash.h"
+#include "asylo/crypto/util/bytes.h"
 #include "asylo/grpc/auth/core/enclave_grpc_security_constants.h"
 #include "asylo/identity/identity_acl_evaluator.h"
 #include "asylo/util/status.h"
@@ -41,6 +46,7 @@ StatusOr<EnclaveAuthContext> EnclaveAuthContext::CreateFromAuthContext(
   }
 
   EnclaveIdentities identities;
+  std::string identities_digest;
   uint32_t record_protocol = 0;
   for (auto it = auth_context.begin(); it != auth_context.end(); ++it) {
     ::grpc::AuthProperty auth_property = *it;
@@ -68,6 +74,11 @@ StatusOr<EnclaveAuthContext> EnclaveAuthContext::CreateFromAuthContext(
         return Status(error::GoogleError::INVALID_ARGUMENT,
                       "Ill-formed peer identity in auth context");
       }
+      UnsafeBytes<kSha256DigestLength> digest;
+      Sha256Hash::Digest(ByteContainerView(auth_property.second.data(),
+                                           auth_property.second.length()),
+                         &digest);
+      identities_digest.assign(digest.begin(), digest.end());
     } else if (auth_property.first ==
                GRPC_TRANSPORT_SECURITY_TYPE_PROPERTY_NAME) {
       if (auth_property.second != GRPC_ENCLAVE_TRANSPORT_SECURITY_TYPE) {
@@ -87,14 +98,16 @@ StatusOr<EnclaveAuthContext> EnclaveAuthContext::CreateFromAuthContext(
     }
   }
 
-  return EnclaveAuthContext(std::move(identities),
+  return EnclaveAuthContext(std::move(identities), std::move(identities_digest),
                             static_cast<RecordProtocol>(record_protocol));
 }
 
 EnclaveAuthContext::EnclaveAuthContext(EnclaveIdentities identities,
+                                       std::string identities_digest,
                                        RecordProtocol record_protocol)
     : identities_(
           {identities.identities().begin(), identities.identities().end()}),
+      identities_digest_(std::move(identities_digest)),
       record_protocol_(record_protocol) {}
 
 RecordProtocol EnclaveAuthContext::GetRecordProtocol() const {
@@ -146,4 +159,18 @@ StatusOr<bool> EnclaveAuthContext::EvaluateAcl(
   return EvaluateAcl(acl, explanation);
 }
 
+StatusOr<bool> EnclaveAuthContext::EvaluateAcl(
+    const CompiledIdentityAcl &acl) const {
+  return EvaluateAcl(acl, /*explanation=*/nullptr);
+}
+
+StatusOr<bool> EnclaveAuthContext::EvaluateAcl(const CompiledIdentityAcl &acl,
+                                               std::string *explanation) const {
+  if (identities_digest_.empty()) {
+    return acl.Evaluate(identities_, matcher_, explanation);
+  }
+  return acl.EvaluateWithDigest(identities_digest_, identities_, matcher_,
+                                explanation);
+}
+
 }  // namespace asylo
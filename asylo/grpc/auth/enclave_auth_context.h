@@ -26,6 +26,7 @@
 #include "asylo/identity/delegating_identity_expectation_matcher.h"
 #include "asylo/identity/identity.pb.h"
 #include "asylo/identity/identity_acl.pb.h"
+#include "asylo/identity/identity_acl_evaluator.h"
 #include "asylo/util/statusor.h"
 #include "include/grpcpp/server_context.h"
 
@@ -121,15 +122,42 @@ class EnclaveAuthContext {
       const EnclaveIdentityExpectation &expectation,
       std::string *explanation) const;
 
+  /// Evaluates the peer's identities against `acl`, using the verdict cached
+  /// in `acl` for the peer's identities if there is one.
+  ///
+  /// \param acl The compiled ACL against which to evaluate the peer's
+  ///            identities.
+  /// \return A bool indicating whether the peer's identities match `acl`, or a
+  ///         non-OK Status if an error occurred while evaluating the ACL.
+  virtual StatusOr<bool> EvaluateAcl(const CompiledIdentityAcl &acl) const;
+
+  /// Evaluates the peer's identities against `acl`, using the verdict cached
+  /// in `acl` for the peer's identities if there is one.
+  ///
+  /// \param acl The compiled ACL against which to evaluate the peer's
+  ///            identities.
+  /// \param[out] explanation An explanation of why the peer's identities did
+  ///             not match `acl`, if the result is false.
+  /// \return A bool indicating whether the peer's identities match `acl`, or a
+  ///         non-OK Status if an error occurred while evaluating the ACL.
+  virtual StatusOr<bool> EvaluateAcl(const CompiledIdentityAcl &acl,
+                                     std::string *explanation) const;
+
  private:
   // Creates an EnclaveAuthContext for the given peer's |identities| and the
-  // session |record_protocol|.
+  // session |record_protocol|. |identities_digest| is the SHA-256 digest of the
+  // serialized |identities|.
   EnclaveAuthContext(EnclaveIdentities identities,
+                     std::string identities_digest,
                      RecordProtocol record_protocol);
 
   // Enclave identities held by the authenticated peer.
   std::vector<EnclaveIdentity> identities_;
 
+  // Digest identifying |identities_| in the verdict caches of compiled ACLs,
+  // or empty if the context was not created from an auth context.
+  std::string identities_digest_;
+
   // Secure transport record protocol.
   RecordProtocol record_protocol_;
 
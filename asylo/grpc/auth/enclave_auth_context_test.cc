@@ -18,6 +18,7 @@
 
 #include "asylo/grpc/auth/enclave_auth_context.h"
 
+#include <memory>
 #include <string>
 
 #include <google/protobuf/io/coded_stream.h>
@@ -28,6 +29,8 @@
 #include "asylo/grpc/auth/core/enclave_grpc_security_constants.h"
 #include "asylo/grpc/auth/core/handshake.pb.h"
 #include "asylo/identity/identity.pb.h"
+#include "asylo/identity/identity_acl.pb.h"
+#include "asylo/identity/identity_acl_evaluator.h"
 #include "asylo/identity/named_identity_expectation_matcher.h"
 #include "asylo/platform/common/static_map.h"
 #include "asylo/test/util/proto_matchers.h"
@@ -48,6 +51,7 @@ constexpr char kIdentityMismatchError[] = "Identity != Match spec";
 constexpr char kAuthorityType1[] = "Good Authority";
 constexpr char kAuthorityType2[] = "Bad Authority";
 
+using ::testing::Eq;
 using ::testing::HasSubstr;
 using ::testing::IsEmpty;
 using ::testing::Not;
@@ -327,6 +331,16 @@ TEST_F(EnclaveAuthContextTest, EvaluateAclFailure) {
                 IsOkAndHolds(false));
     EXPECT_THAT(explanation, HasSubstr(kIdentityMismatchError));
   }
+
+  // Test the CompiledIdentityAcl overload.
+  {
+    std::unique_ptr<CompiledIdentityAcl> compiled_acl;
+    ASYLO_ASSERT_OK_AND_ASSIGN(compiled_acl, CompiledIdentityAcl::Create(acl));
+    std::string explanation;
+    ASSERT_THAT(auth_context.EvaluateAcl(*compiled_acl, &explanation),
+                IsOkAndHolds(false));
+    EXPECT_THAT(explanation, HasSubstr(kIdentityMismatchError));
+  }
 }
 
 // Verify that EvaluateAcl() returns true when the ACL passes.
@@ -358,6 +372,53 @@ TEST_F(EnclaveAuthContextTest, EvaluateAclSuccess) {
                 IsOkAndHolds(true));
     EXPECT_THAT(explanation, IsEmpty());
   }
+
+  // Test the CompiledIdentityAcl overload.
+  {
+    std::unique_ptr<CompiledIdentityAcl> compiled_acl;
+    ASYLO_ASSERT_OK_AND_ASSIGN(compiled_acl, CompiledIdentityAcl::Create(acl));
+    std::string explanation;
+    ASSERT_THAT(auth_context.EvaluateAcl(*compiled_acl, &explanation),
+                IsOkAndHolds(true));
+    EXPECT_THAT(explanation, IsEmpty());
+  }
+}
+
+// Verify that auth contexts created for the same peer share the verdicts
+// cached in a CompiledIdentityAcl, and that other peers do not.
+TEST_F(EnclaveAuthContextTest, EvaluateCompiledAclCachesVerdictPerPeer) {
+  IdentityAclPredicate acl;
+  EnclaveIdentityExpectation *expectation = acl.mutable_expectation();
+  *expectation->mutable_reference_identity()->mutable_description() =
+      good_identity_description_;
+  expectation->set_match_spec(kMatchSpec1);
+  std::unique_ptr<CompiledIdentityAcl> compiled_acl;
+  ASYLO_ASSERT_OK_AND_ASSIGN(compiled_acl, CompiledIdentityAcl::Create(acl));
+
+  for (int i = 0; i < 3; ++i) {
+    EnclaveAuthContext auth_context;
+    ASYLO_ASSERT_OK_AND_ASSIGN(
+        auth_context,
+        EnclaveAuthContext::CreateFromAuthContext(*secure_auth_context_));
+    EXPECT_THAT(auth_context.EvaluateAcl(*compiled_acl), IsOkAndHolds(true));
+  }
+  EXPECT_THAT(compiled_acl->cache_size(), Eq(1));
+
+  EnclaveIdentities other_identities;
+  EnclaveIdentity *identity = other_identities.add_identities();
+  identity->set_identity(kMatchSpec2);
+  *identity->mutable_description() = good_identity_description_;
+  ::grpc::SecureAuthContext other_auth_context(
+      grpc_core::MakeRefCounted<grpc_auth_context>(/*chained=*/nullptr).get());
+  AddEnclaveIdentitiesProperty(other_identities, &other_auth_context);
+  AddTransportSecurityTypeProperty(&other_auth_context);
+
+  EnclaveAuthContext auth_context;
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      auth_context,
+      EnclaveAuthContext::CreateFromAuthContext(other_auth_context));
+  EXPECT_THAT(auth_context.EvaluateAcl(*compiled_acl), IsOkAndHolds(false));
+  EXPECT_THAT(compiled_acl->cache_size(), Eq(2));
 }
 
 }  // namespace
@@ -0,0 +1,224 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/grpc/auth/enclave_channel_pool.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "asylo/crypto/sha256_hash.h"
+#include "asylo/crypto/util/bytes.h"
+#include "asylo/grpc/auth/enclave_channel_credentials.h"
+#include "asylo/identity/assertion_description_util.h"
+#include "asylo/identity/identity.pb.h"
+#include "asylo/util/status.h"
+#include "include/grpc/grpc.h"
+#include "include/grpcpp/create_channel.h"
+#include "include/grpcpp/support/channel_arguments.h"
+
+namespace asylo {
+namespace {
+
+// Appends |bytes| to |canonical|, prefixed with its length.
+void AppendField(absl::string_view bytes, std::string *canonical) {
+  absl::StrAppend(canonical, bytes.size(), ":", bytes);
+}
+
+// Appends an optional field to |canonical|, distinguishing an absent field
+// from an empty one.
+void AppendOptionalField(bool has_value, absl::string_view bytes,
+                         std::string *canonical) {
+  if (has_value) {
+    AppendField(absl::StrCat("+", bytes), canonical);
+  } else {
+    AppendField("", canonical);
+  }
+}
+
+// Appends |descriptions| to |canonical| independently of the iteration order
+// of the set.
+void AppendDescriptions(const AssertionDescriptionHashSet &descriptions,
+                        std::string *canonical) {
+  std::vector<std::string> serialized;
+  serialized.reserve(descriptions.size());
+  for (const AssertionDescription &description : descriptions) {
+    serialized.push_back(description.SerializeAsString());
+  }
+  std::sort(serialized.begin(), serialized.end());
+  AppendField(absl::StrCat(serialized.size()), canonical);
+  for (const std::string &description : serialized) {
+    AppendField(description, canonical);
+  }
+}
+
+// Returns a key which is equal for equal |target| and |options|. The key is the
+// SHA-256 digest of a canonical encoding of |options| followed by |target|.
+std::string PoolKey(const std::string &target,
+                    const EnclaveCredentialsOptions &options) {
+  std::string canonical;
+  AppendDescriptions(options.self_assertions, &canonical);
+  AppendDescriptions(options.accepted_peer_assertions, &canonical);
+  AppendField(options.additional_authenticated_data, &canonical);
+  AppendOptionalField(
+      options.peer_acl.has_value(),
+      options.peer_acl.has_value() ? options.peer_acl->SerializeAsString() : "",
+      &canonical);
+  AppendOptionalField(
+      options.session_resumption_lifetime.has_value(),
+      options.session_resumption_lifetime.has_value()
+          ? absl::StrCat(absl::ToInt64Nanoseconds(
+                options.session_resumption_lifetime.value()))
+          : "",
+      &canonical);
+  AppendOptionalField(
+      options.max_protected_frame_size.has_value(),
+      options.max_protected_frame_size.has_value()
+          ? absl::StrCat(options.max_protected_frame_size.value())
+          : "",
+      &canonical);
+
+  UnsafeBytes<kSha256DigestLength> digest;
+  Sha256Hash::Digest(canonical, &digest);
+  return absl::StrCat(
+      absl::string_view(reinterpret_cast<const char *>(digest.data()),
+                        digest.size()),
+      target);
+}
+
+}  // namespace
+
+EnclaveChannelPool::EnclaveChannelPool(EnclaveChannelPoolOptions options)
+    : options_(std::move(options)) {}
+
+std::shared_ptr<::grpc::Channel> EnclaveChannelPool::GetChannel(
+    const std::string &target, const EnclaveCredentialsOptions &options) {
+  absl::MutexLock lock(&mu_);
+  Entry *entry = GetEntry(target, options);
+  PooledChannel *pooled = &entry->channels[entry->next];
+  entry->next = (entry->next + 1) % entry->channels.size();
+  Refresh(target, *entry, options_.clock(), pooled);
+  return pooled->channel;
+}
+
+Status EnclaveChannelPool::Warm(const std::string &target,
+                                const EnclaveCredentialsOptions &options,
+                                absl::Time deadline) {
+  std::vector<std::shared_ptr<::grpc::Channel>> channels;
+  {
+    absl::MutexLock lock(&mu_);
+    Entry *entry = GetEntry(target, options);
+    absl::Time now = options_.clock();
+    for (PooledChannel &pooled : entry->channels) {
+      Refresh(target, *entry, now, &pooled);
+      channels.push_back(pooled.channel);
+      if (pooled.replacement) {
+        channels.push_back(pooled.replacement);
+      }
+    }
+  }
+
+  // Wait outside the lock, so that callers keep being handed channels while
+  // the handshakes are in progress.
+  for (const std::shared_ptr<::grpc::Channel> &channel : channels) {
+    if (!channel->WaitForConnected(absl::ToChronoTime(deadline))) {
+      return Status(error::GoogleError::DEADLINE_EXCEEDED,
+                    absl::StrCat("Channel to ", target,
+                                 " did not connect before the deadline"));
+    }
+  }
+  return Status::OkStatus();
+}
+
+size_t EnclaveChannelPool::Size() const {
+  absl::MutexLock lock(&mu_);
+  size_t size = 0;
+  for (const auto &key_and_entry : entries_) {
+    size += key_and_entry.second.channels.size();
+  }
+  return size;
+}
+
+EnclaveChannelPool::Entry *EnclaveChannelPool::GetEntry(
+    const std::string &target, const EnclaveCredentialsOptions &options) {
+  Entry &entry = entries_[PoolKey(target, options)];
+  if (entry.channels.empty()) {
+    entry.credentials = EnclaveChannelCredentials(options);
+    absl::Time now = options_.clock();
+    size_t channel_count = std::max<size_t>(options_.channels_per_target, 1);
+    entry.channels.reserve(channel_count);
+    for (size_t i = 0; i < channel_count; ++i) {
+      PooledChannel pooled;
+      pooled.channel = CreateChannel(target, entry.credentials);
+      pooled.created = now;
+      entry.channels.push_back(std::move(pooled));
+    }
+  }
+  return &entry;
+}
+
+std::shared_ptr<::grpc::Channel> EnclaveChannelPool::CreateChannel(
+    const std::string &target,
+    const std::shared_ptr<::grpc::ChannelCredentials> &credentials) const {
+  // Without a local subchannel pool, gRPC would share one connection among all
+  // channels to |target| with the same arguments.
+  ::grpc::ChannelArguments args;
+  args.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+  return ::grpc::CreateCustomChannel(target, credentials, args);
+}
+
+void EnclaveChannelPool::Refresh(const std::string &target, const Entry &entry,
+                                 absl::Time now, PooledChannel *pooled) const {
+  if (!options_.max_channel_age.has_value()) {
+    return;
+  }
+  absl::Time retirement = pooled->created + options_.max_channel_age.value();
+
+  // Switch to the replacement once it is connected, or when the channel is
+  // retired, whichever happens first.
+  if (pooled->replacement) {
+    bool replacement_ready =
+        pooled->replacement->GetState(/*try_to_connect=*/false) ==
+        GRPC_CHANNEL_READY;
+    if (replacement_ready || now >= retirement) {
+      pooled->channel = std::move(pooled->replacement);
+      pooled->created = pooled->replacement_created;
+      pooled->replacement = nullptr;
+      retirement = pooled->created + options_.max_channel_age.value();
+    }
+  }
+
+  if (now >= retirement) {
+    pooled->channel = CreateChannel(target, entry.credentials);
+    pooled->created = now;
+  } else if (!pooled->replacement &&
+             now >= retirement - options_.refresh_margin) {
+    pooled->replacement = CreateChannel(target, entry.credentials);
+    pooled->replacement_created = now;
+    pooled->replacement->GetState(/*try_to_connect=*/true);
+  }
+}
+
+}  // namespace asylo
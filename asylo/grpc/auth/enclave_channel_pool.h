@@ -0,0 +1,154 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_GRPC_AUTH_ENCLAVE_CHANNEL_POOL_H_
+#define ASYLO_GRPC_AUTH_ENCLAVE_CHANNEL_POOL_H_
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "absl/types/optional.h"
+#include "asylo/grpc/auth/enclave_credentials_options.h"
+#include "asylo/util/status.h"
+#include "include/grpcpp/channel.h"
+#include "include/grpcpp/security/credentials.h"
+
+namespace asylo {
+
+/// Options used to configure an `EnclaveChannelPool`.
+struct EnclaveChannelPoolOptions {
+  /// The number of channels kept for each target and set of credentials
+  /// options. Each channel has a connection of its own, and callers are handed
+  /// the channels in turn. Must be at least one.
+  size_t channels_per_target = 1;
+
+  /// If set, a channel is retired once it is this old, so that callers are not
+  /// handed channels whose peer was authenticated longer ago than this. Set it
+  /// below the validity period of the assertions used by the peers.
+  absl::optional<absl::Duration> max_channel_age;
+
+  /// How long before a channel is retired its replacement starts connecting.
+  /// The pool keeps handing out the old channel until the replacement is
+  /// connected, so that callers do not wait for the new handshake. Ignored if
+  /// `max_channel_age` is not set.
+  absl::Duration refresh_margin = absl::Seconds(30);
+
+  /// Source of the current time.
+  std::function<absl::Time()> clock = absl::Now;
+};
+
+/// A pool of enclave gRPC channels shared by the callers of an enclave.
+///
+/// Creating a channel with `EnclaveChannelCredentials()` for every client
+/// costs an EKEP handshake, and therefore fresh assertions, per client. An
+/// `EnclaveChannelPool` instead reuses authenticated channels across callers
+/// that connect to the same target with equal credentials options. Options are
+/// compared by value, so callers do not need to share an options object.
+///
+/// This class is thread-safe.
+class EnclaveChannelPool {
+ public:
+  /// Creates an empty pool.
+  ///
+  /// \param options Options for configuring the pool.
+  explicit EnclaveChannelPool(
+      EnclaveChannelPoolOptions options = EnclaveChannelPoolOptions());
+
+  EnclaveChannelPool(const EnclaveChannelPool &other) = delete;
+  EnclaveChannelPool &operator=(const EnclaveChannelPool &other) = delete;
+
+  /// Returns a channel to `target` secured with `options`, creating the
+  /// channels for `target` and `options` on first use. Channels are created
+  /// without waiting for them to connect.
+  ///
+  /// \param target The address of the server.
+  /// \param options Options for configuring the channel credentials.
+  /// \return A channel to `target`.
+  std::shared_ptr<::grpc::Channel> GetChannel(
+      const std::string &target, const EnclaveCredentialsOptions &options);
+
+  /// Creates the channels to `target` secured with `options`, if they do not
+  /// exist yet, and waits for all of them to connect. Warming the channels
+  /// ahead of time moves their handshakes off the path of the first RPCs.
+  ///
+  /// \param target The address of the server.
+  /// \param options Options for configuring the channel credentials.
+  /// \param deadline The time by which the channels must be connected.
+  /// \return A non-OK status if a channel did not connect by `deadline`.
+  Status Warm(const std::string &target,
+              const EnclaveCredentialsOptions &options, absl::Time deadline);
+
+  /// Returns the number of channels held by the pool, excluding replacements
+  /// that are still connecting.
+  size_t Size() const;
+
+ private:
+  // A channel held by the pool, and its replacement once the channel is due
+  // for retirement.
+  struct PooledChannel {
+    std::shared_ptr<::grpc::Channel> channel;
+    absl::Time created;
+    std::shared_ptr<::grpc::Channel> replacement;
+    absl::Time replacement_created;
+  };
+
+  // The channels to one target with one set of credentials options.
+  struct Entry {
+    std::shared_ptr<::grpc::ChannelCredentials> credentials;
+    std::vector<PooledChannel> channels;
+
+    // The index of the channel handed to the next caller.
+    size_t next = 0;
+  };
+
+  // Returns the entry for |target| and |options|, creating it if needed.
+  Entry *GetEntry(const std::string &target,
+                  const EnclaveCredentialsOptions &options)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Creates a channel to |target| with |credentials| that does not share its
+  // connection with other channels.
+  std::shared_ptr<::grpc::Channel> CreateChannel(
+      const std::string &target,
+      const std::shared_ptr<::grpc::ChannelCredentials> &credentials) const;
+
+  // Replaces |pooled| with its replacement, or with a new channel, if it is
+  // due for retirement at |now|. Starts connecting a replacement if |pooled| is
+  // about to be retired.
+  void Refresh(const std::string &target, const Entry &entry, absl::Time now,
+               PooledChannel *pooled) const;
+
+  const EnclaveChannelPoolOptions options_;
+
+  mutable absl::Mutex mu_;
+
+  // Entries keyed by target and digest of the credentials options.
+  absl::flat_hash_map<std::string, Entry> entries_ ABSL_GUARDED_BY(mu_);
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_GRPC_AUTH_ENCLAVE_CHANNEL_POOL_H_
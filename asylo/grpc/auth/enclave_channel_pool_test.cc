@@ -0,0 +1,214 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/grpc/auth/enclave_channel_pool.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "asylo/grpc/auth/enclave_credentials_options.h"
+#include "asylo/grpc/auth/enclave_server_credentials.h"
+#include "asylo/grpc/auth/null_credentials_options.h"
+#include "asylo/grpc/util/grpc_server_launcher.h"
+#include "asylo/identity/enclave_assertion_authority_config.pb.h"
+#include "asylo/identity/init.h"
+#include "asylo/test/grpc/messenger_server_impl.h"
+#include "asylo/test/util/enclave_assertion_authority_configs.h"
+#include "asylo/test/util/status_matchers.h"
+#include "include/grpcpp/grpcpp.h"
+
+namespace asylo {
+namespace {
+
+using ::testing::Eq;
+using ::testing::Ne;
+
+constexpr char kAddress[] = "[::1]";
+
+// A target on which no server listens.
+constexpr char kUnreachableTarget[] = "[::1]:1";
+
+constexpr absl::Duration kMaxChannelAge = absl::Minutes(10);
+constexpr absl::Duration kRefreshMargin = absl::Minutes(1);
+
+class EnclaveChannelPoolTest : public ::testing::Test {
+ protected:
+  static void SetUpTestSuite() {
+    std::vector<EnclaveAssertionAuthorityConfig> authority_configs = {
+        GetNullAssertionAuthorityTestConfig()};
+    ASSERT_THAT(InitializeEnclaveAssertionAuthorities(
+                    authority_configs.cbegin(), authority_configs.cend()),
+                IsOk());
+  }
+
+  // Returns pool options with channel refresh enabled and a clock that reads
+  // |now_|.
+  EnclaveChannelPoolOptions RefreshingOptions() {
+    EnclaveChannelPoolOptions options;
+    options.max_channel_age = kMaxChannelAge;
+    options.refresh_margin = kRefreshMargin;
+    options.clock = [this] { return now_; };
+    return options;
+  }
+
+  // Starts a server accepting null credentials and returns its address.
+  std::string StartServer() {
+    launcher_ = absl::make_unique<GrpcServerLauncher>("EnclaveChannelPoolTest");
+    int port = 0;
+    EXPECT_THAT(
+        launcher_->RegisterService(absl::make_unique<test::MessengerServer1>()),
+        IsOk());
+    EXPECT_THAT(launcher_->AddListeningPort(
+                    absl::StrCat(kAddress, ":0"),
+                    EnclaveServerCredentials(
+                        BidirectionalNullCredentialsOptions()),
+                    &port),
+                IsOk());
+    EXPECT_THAT(launcher_->Start(), IsOk());
+    return absl::StrCat(kAddress, ":", port);
+  }
+
+  void TearDown() override {
+    if (launcher_) {
+      EXPECT_THAT(launcher_->Shutdown(), IsOk());
+    }
+  }
+
+  absl::Time now_ = absl::UnixEpoch();
+  std::unique_ptr<GrpcServerLauncher> launcher_;
+};
+
+TEST_F(EnclaveChannelPoolTest, ReusesChannelForEqualOptions) {
+  EnclaveChannelPool pool;
+  std::shared_ptr<::grpc::Channel> channel = pool.GetChannel(
+      kUnreachableTarget, BidirectionalNullCredentialsOptions());
+
+  // Options built separately and in a different order compare equal.
+  EXPECT_THAT(pool.GetChannel(kUnreachableTarget,
+                              PeerNullCredentialsOptions().Add(
+                                  SelfNullCredentialsOptions())),
+              Eq(channel));
+  EXPECT_THAT(pool.Size(), Eq(1));
+}
+
+TEST_F(EnclaveChannelPoolTest, SeparatesTargetsAndOptions) {
+  EnclaveChannelPool pool;
+  EnclaveCredentialsOptions options = BidirectionalNullCredentialsOptions();
+  std::shared_ptr<::grpc::Channel> channel =
+      pool.GetChannel(kUnreachableTarget, options);
+
+  EXPECT_THAT(pool.GetChannel("[::1]:2", options), Ne(channel));
+
+  options.additional_authenticated_data = "aad";
+  EXPECT_THAT(pool.GetChannel(kUnreachableTarget, options), Ne(channel));
+
+  options.additional_authenticated_data.clear();
+  options.max_protected_frame_size = 0;
+  EXPECT_THAT(pool.GetChannel(kUnreachableTarget, options), Ne(channel));
+  EXPECT_THAT(pool.Size(), Eq(4));
+}
+
+TEST_F(EnclaveChannelPoolTest, HandsOutChannelsInTurn) {
+  EnclaveChannelPoolOptions pool_options;
+  pool_options.channels_per_target = 3;
+  EnclaveChannelPool pool(pool_options);
+  EnclaveCredentialsOptions options = BidirectionalNullCredentialsOptions();
+
+  std::vector<std::shared_ptr<::grpc::Channel>> channels;
+  for (int i = 0; i < 3; ++i) {
+    channels.push_back(pool.GetChannel(kUnreachableTarget, options));
+  }
+  EXPECT_THAT(channels[0], Ne(channels[1]));
+  EXPECT_THAT(channels[1], Ne(channels[2]));
+  EXPECT_THAT(channels[0], Ne(channels[2]));
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_THAT(pool.GetChannel(kUnreachableTarget, options), Eq(channels[i]));
+  }
+  EXPECT_THAT(pool.Size(), Eq(3));
+}
+
+TEST_F(EnclaveChannelPoolTest, RetiresAgedChannels) {
+  EnclaveChannelPool pool(RefreshingOptions());
+  EnclaveCredentialsOptions options = BidirectionalNullCredentialsOptions();
+  std::shared_ptr<::grpc::Channel> channel =
+      pool.GetChannel(kUnreachableTarget, options);
+
+  // The replacement cannot connect, so the old channel is handed out until it
+  // is retired.
+  now_ += kMaxChannelAge - kRefreshMargin / 2;
+  EXPECT_THAT(pool.GetChannel(kUnreachableTarget, options), Eq(channel));
+
+  now_ += kRefreshMargin;
+  std::shared_ptr<::grpc::Channel> replacement =
+      pool.GetChannel(kUnreachableTarget, options);
+  EXPECT_THAT(replacement, Ne(channel));
+  EXPECT_THAT(pool.GetChannel(kUnreachableTarget, options), Eq(replacement));
+  EXPECT_THAT(pool.Size(), Eq(1));
+}
+
+TEST_F(EnclaveChannelPoolTest, WarmConnectsChannels) {
+  std::string target = StartServer();
+  EnclaveChannelPoolOptions pool_options;
+  pool_options.channels_per_target = 2;
+  EnclaveChannelPool pool(pool_options);
+  EnclaveCredentialsOptions options = BidirectionalNullCredentialsOptions();
+
+  ASSERT_THAT(pool.Warm(target, options, absl::Now() + absl::Seconds(10)),
+              IsOk());
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_THAT(pool.GetChannel(target, options)->GetState(
+                    /*try_to_connect=*/false),
+                Eq(GRPC_CHANNEL_READY));
+  }
+}
+
+TEST_F(EnclaveChannelPoolTest, WarmFailsAfterDeadline) {
+  EnclaveChannelPool pool;
+  EXPECT_THAT(pool.Warm(kUnreachableTarget,
+                        BidirectionalNullCredentialsOptions(),
+                        absl::Now() + absl::Milliseconds(100)),
+              StatusIs(error::GoogleError::DEADLINE_EXCEEDED));
+}
+
+TEST_F(EnclaveChannelPoolTest, SwitchesToConnectedReplacementBeforeRetirement) {
+  std::string target = StartServer();
+  EnclaveChannelPool pool(RefreshingOptions());
+  EnclaveCredentialsOptions options = BidirectionalNullCredentialsOptions();
+  std::shared_ptr<::grpc::Channel> channel = pool.GetChannel(target, options);
+
+  // Warming the pool within the refresh margin connects the replacement too.
+  now_ += kMaxChannelAge - kRefreshMargin / 2;
+  ASSERT_THAT(pool.Warm(target, options, absl::Now() + absl::Seconds(10)),
+              IsOk());
+
+  std::shared_ptr<::grpc::Channel> replacement =
+      pool.GetChannel(target, options);
+  EXPECT_THAT(replacement, Ne(channel));
+  EXPECT_THAT(replacement->GetState(/*try_to_connect=*/false),
+              Eq(GRPC_CHANNEL_READY));
+}
+
+}  // namespace
+}  // namespace asylo
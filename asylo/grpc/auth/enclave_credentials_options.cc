@@ -17,6 +17,9 @@
  */
 #include "asylo/grpc/auth/enclave_credentials_options.h"
 
+#include <algorithm>
+
+#include "absl/time/time.h"
 #include "asylo/identity/identity_acl.pb.h"
 
 namespace asylo {
@@ -48,6 +51,24 @@ EnclaveCredentialsOptions &EnclaveCredentialsOptions::Add(
       peer_acl = additional.peer_acl;
     }
   }
+  if (additional.session_resumption_lifetime.has_value()) {
+    if (session_resumption_lifetime.has_value()) {
+      session_resumption_lifetime =
+          std::min(session_resumption_lifetime.value(),
+                   additional.session_resumption_lifetime.value());
+    } else {
+      session_resumption_lifetime = additional.session_resumption_lifetime;
+    }
+  }
+  if (additional.max_protected_frame_size.has_value()) {
+    if (max_protected_frame_size.has_value()) {
+      max_protected_frame_size =
+          std::min(max_protected_frame_size.value(),
+                   additional.max_protected_frame_size.value());
+    } else {
+      max_protected_frame_size = additional.max_protected_frame_size;
+    }
+  }
 
   return *this;
 }
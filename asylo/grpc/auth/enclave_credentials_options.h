@@ -19,8 +19,10 @@
 #ifndef ASYLO_GRPC_AUTH_ENCLAVE_CREDENTIALS_OPTIONS_H_
 #define ASYLO_GRPC_AUTH_ENCLAVE_CREDENTIALS_OPTIONS_H_
 
+#include <cstddef>
 #include <string>
 
+#include "absl/time/time.h"
 #include "absl/types/optional.h"
 #include "asylo/identity/assertion_description_util.h"
 #include "asylo/identity/identity.pb.h"
@@ -53,6 +55,21 @@ struct EnclaveCredentialsOptions {
   /// authenticated peer's identities will cause gRPC channel establishment to
   /// fail.
   absl::optional<IdentityAclPredicate> peer_acl;
+
+  /// If set, sessions established with these credentials may be resumed by
+  /// later connections to the same peer without exchanging new assertions, for
+  /// up to this duration after the peer's assertions were last verified. When
+  /// two sets of options are combined, the shorter duration is used.
+  absl::optional<absl::Duration> session_resumption_lifetime;
+
+  /// If set, the maximum size in bytes of the record protocol frames sent on
+  /// channels established with these credentials. Larger frames amortize the
+  /// per-frame overhead of bulk transfers. The value is clamped to the range
+  /// supported by the record protocol, which is at most 1 MiB. Peers accept
+  /// frames of any supported size, so this option does not need to match
+  /// between peers. When two sets of options are combined, the smaller size
+  /// is used.
+  absl::optional<size_t> max_protected_frame_size;
 };
 
 }  // namespace asylo
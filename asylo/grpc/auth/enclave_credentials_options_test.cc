@@ -20,6 +20,7 @@
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include "absl/time/time.h"
 #include "asylo/grpc/auth/null_credentials_options.h"
 #include "asylo/grpc/auth/sgx_local_credentials_options.h"
 #include "asylo/identity/descriptions.h"
@@ -30,6 +31,8 @@
 namespace asylo {
 namespace {
 
+using ::testing::Eq;
+using ::testing::Optional;
 using ::testing::Test;
 using ::testing::UnorderedElementsAre;
 
@@ -151,5 +154,38 @@ TEST_F(EnclaveCredentialsOptionsTest, CombineIdentityAclPredicates) {
   EXPECT_THAT(lhs.Add(rhs).peer_acl, Optional(EqualsProto(combined)));
 }
 
+TEST_F(EnclaveCredentialsOptionsTest, CombineSessionResumptionLifetimes) {
+  EnclaveCredentialsOptions lhs = BidirectionalNullCredentialsOptions();
+  EnclaveCredentialsOptions rhs = BidirectionalNullCredentialsOptions();
+  EXPECT_THAT(lhs.Add(rhs).session_resumption_lifetime, Eq(absl::nullopt));
+
+  rhs.session_resumption_lifetime = absl::Minutes(10);
+  EXPECT_THAT(lhs.Add(rhs).session_resumption_lifetime,
+              Optional(absl::Minutes(10)));
+
+  rhs.session_resumption_lifetime = absl::Minutes(5);
+  EXPECT_THAT(lhs.Add(rhs).session_resumption_lifetime,
+              Optional(absl::Minutes(5)));
+
+  rhs.session_resumption_lifetime = absl::Minutes(20);
+  EXPECT_THAT(lhs.Add(rhs).session_resumption_lifetime,
+              Optional(absl::Minutes(5)));
+}
+
+TEST_F(EnclaveCredentialsOptionsTest, CombineMaxProtectedFrameSizes) {
+  EnclaveCredentialsOptions lhs = BidirectionalNullCredentialsOptions();
+  EnclaveCredentialsOptions rhs = BidirectionalNullCredentialsOptions();
+  EXPECT_THAT(lhs.Add(rhs).max_protected_frame_size, Eq(absl::nullopt));
+
+  rhs.max_protected_frame_size = 1 << 20;
+  EXPECT_THAT(lhs.Add(rhs).max_protected_frame_size, Optional(1 << 20));
+
+  rhs.max_protected_frame_size = 1 << 16;
+  EXPECT_THAT(lhs.Add(rhs).max_protected_frame_size, Optional(1 << 16));
+
+  rhs.max_protected_frame_size = 1 << 18;
+  EXPECT_THAT(lhs.Add(rhs).max_protected_frame_size, Optional(1 << 16));
+}
+
 }  // namespace
 }  // namespace asylo
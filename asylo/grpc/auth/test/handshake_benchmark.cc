@@ -0,0 +1,385 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Benchmarks of enclave gRPC channel establishment, used to size Assertion
+// Generator Enclave (AGE) and server deployments. The suite measures:
+//   * the latency of each step of an EKEP handshake, run in memory
+//   * handshakes per second over concurrent gRPC channels
+//   * steady-state unary RPC throughput over the ALTS record protocol
+// for null, SGX local and SGX AGE remote credentials. The SGX AGE remote
+// benchmarks need a running AGE, given by --age_server_address, and are skipped
+// otherwise. The same suite runs natively and inside an enclave, where the
+// benchmarks only run when the test is passed --benchmarks=all, or
+// --benchmarks=<regex> to select some of them.
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "asylo/grpc/auth/core/client_ekep_handshaker.h"
+#include "asylo/grpc/auth/core/ekep_handshaker.h"
+#include "asylo/grpc/auth/core/ekep_handshaker_util.h"
+#include "asylo/grpc/auth/core/server_ekep_handshaker.h"
+#include "asylo/grpc/auth/enclave_channel_credentials.h"
+#include "asylo/grpc/auth/enclave_credentials_options.h"
+#include "asylo/grpc/auth/enclave_server_credentials.h"
+#include "asylo/grpc/auth/null_credentials_options.h"
+#include "asylo/grpc/auth/sgx_age_remote_credentials_options.h"
+#include "asylo/grpc/auth/sgx_local_credentials_options.h"
+#include "asylo/grpc/util/grpc_server_launcher.h"
+#include "asylo/identity/enclave_assertion_authority_config.pb.h"
+#include "asylo/identity/init.h"
+#include "asylo/test/grpc/messenger_server_impl.h"
+#include "asylo/test/grpc/service.grpc.pb.h"
+#include "asylo/test/util/enclave_assertion_authority_configs.h"
+#include "asylo/util/status.h"
+#include "asylo/util/status_macros.h"
+#include "asylo/util/statusor.h"
+#include "include/grpcpp/grpcpp.h"
+
+ABSL_FLAG(std::string, age_server_address, "",
+          "Address of the AGE used by the SGX AGE remote benchmarks");
+
+namespace asylo {
+namespace {
+
+constexpr char kAddress[] = "[::1]";
+
+// Time allowed for a channel to connect, including its handshake.
+constexpr absl::Duration kConnectTimeout = absl::Seconds(30);
+
+// Largest number of concurrent channels of the handshake benchmarks.
+constexpr int kMaxChannels = 64;
+
+// Largest request size of the RPC throughput benchmarks.
+constexpr int64_t kMaxRequestSize = 1 << 20;
+
+// Steps of a full EKEP handshake, named after the frames each step writes. The
+// steps alternate between the client and the server, starting with the client.
+// The last step is the server consuming the ClientFinish.
+constexpr int kNumEkepSteps = 6;
+const char *const kEkepSteps[kNumEkepSteps] = {
+    "client_precommit", "server_precommit", "client_id",
+    "server_id_finish", "client_finish",    "server_done",
+};
+
+enum class Authority { kNull, kSgxLocal, kSgxAgeRemote };
+
+EnclaveCredentialsOptions GetCredentialsOptions(Authority authority) {
+  if (authority == Authority::kSgxLocal) {
+    return BidirectionalSgxLocalCredentialsOptions();
+  }
+  if (authority == Authority::kSgxAgeRemote) {
+    return BidirectionalSgxAgeRemoteCredentialsOptions();
+  }
+  return BidirectionalNullCredentialsOptions();
+}
+
+// Initializes the assertion authorities of every benchmark on first use.
+Status InitializeAuthorities() {
+  static const Status *const status = [] {
+    std::vector<EnclaveAssertionAuthorityConfig> authority_configs = {
+        GetNullAssertionAuthorityTestConfig(),
+        GetSgxLocalAssertionAuthorityTestConfig(),
+    };
+    std::string age_server_address = absl::GetFlag(FLAGS_age_server_address);
+    if (!age_server_address.empty()) {
+      authority_configs.push_back(
+          GetSgxAgeRemoteAssertionAuthorityTestConfig(age_server_address));
+    }
+    return new Status(InitializeEnclaveAssertionAuthorities(
+        authority_configs.cbegin(), authority_configs.cend()));
+  }();
+  return *status;
+}
+
+// Returns true if |authority| can be benchmarked. Otherwise, marks |state| as
+// skipped and returns false.
+bool PrepareAuthority(Authority authority, benchmark::State *state) {
+  Status status = InitializeAuthorities();
+  if (!status.ok()) {
+    state->SkipWithError(status.ToString().c_str());
+    return false;
+  }
+  if (authority == Authority::kSgxAgeRemote &&
+      absl::GetFlag(FLAGS_age_server_address).empty()) {
+    state->SkipWithError("--age_server_address is not set");
+    return false;
+  }
+  return true;
+}
+
+// Returns the |quantile| of |samples| in microseconds. Reorders |samples|.
+double QuantileMicros(double quantile, std::vector<absl::Duration> *samples) {
+  if (samples->empty()) {
+    return 0;
+  }
+  auto nth = samples->begin() +
+             static_cast<size_t>(quantile * (samples->size() - 1));
+  std::nth_element(samples->begin(), nth, samples->end());
+  return absl::ToDoubleMicroseconds(*nth);
+}
+
+// Reports the median and 99th percentile of |samples| as counters prefixed with
+// |name|. Counters of concurrent threads are averaged.
+void ReportLatency(const std::string &name,
+                   std::vector<absl::Duration> *samples,
+                   benchmark::State *state) {
+  state->counters[absl::StrCat(name, "_p50_us")] = benchmark::Counter(
+      QuantileMicros(0.5, samples), benchmark::Counter::kAvgThreads);
+  state->counters[absl::StrCat(name, "_p99_us")] = benchmark::Counter(
+      QuantileMicros(0.99, samples), benchmark::Counter::kAvgThreads);
+}
+
+EkepHandshakerOptions GetHandshakerOptions(Authority authority) {
+  EnclaveCredentialsOptions credentials_options =
+      GetCredentialsOptions(authority);
+  EkepHandshakerOptions options;
+  options.self_assertions.assign(credentials_options.self_assertions.cbegin(),
+                                 credentials_options.self_assertions.cend());
+  options.accepted_peer_assertions.assign(
+      credentials_options.accepted_peer_assertions.cbegin(),
+      credentials_options.accepted_peer_assertions.cend());
+  return options;
+}
+
+// Runs a full EKEP handshake between a new client and a new server configured
+// with |options|, relaying frames between them in memory. Appends the duration
+// of each step to the corresponding element of |steps|. Returns false if the
+// handshake did not complete.
+bool RunTimedHandshake(const EkepHandshakerOptions &options,
+                       std::vector<absl::Duration> steps[kNumEkepSteps]) {
+  std::unique_ptr<EkepHandshaker> participants[] = {
+      ClientEkepHandshaker::Create(options),
+      ServerEkepHandshaker::Create(options),
+  };
+  if (!participants[0] || !participants[1]) {
+    return false;
+  }
+
+  EkepHandshaker::Result results[2];
+  std::string input;
+  std::string output;
+  for (int step = 0; step < kNumEkepSteps; ++step) {
+    absl::Time start = absl::Now();
+    results[step % 2] = participants[step % 2]->NextHandshakeStep(
+        input.data(), input.size(), &output);
+    steps[step].push_back(absl::Now() - start);
+    if (results[step % 2] == EkepHandshaker::Result::ABORTED ||
+        results[step % 2] == EkepHandshaker::Result::NOT_ENOUGH_DATA) {
+      return false;
+    }
+    input.swap(output);
+  }
+  return results[0] == EkepHandshaker::Result::COMPLETED &&
+         results[1] == EkepHandshaker::Result::COMPLETED;
+}
+
+// Measures a full EKEP handshake without a transport, reporting the latency of
+// each of its steps. Assertion generation and verification happen in the
+// client_id, server_id_finish and client_finish steps.
+void BM_EkepHandshake(benchmark::State &state, Authority authority) {
+  if (!PrepareAuthority(authority, &state)) {
+    return;
+  }
+  EkepHandshakerOptions options = GetHandshakerOptions(authority);
+  std::vector<absl::Duration> steps[kNumEkepSteps];
+  for (auto _ : state) {
+    if (!RunTimedHandshake(options, steps)) {
+      state.SkipWithError("EKEP handshake failed");
+      break;
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+  for (int step = 0; step < kNumEkepSteps; ++step) {
+    ReportLatency(kEkepSteps[step], &steps[step], &state);
+  }
+}
+BENCHMARK_CAPTURE(BM_EkepHandshake, null, Authority::kNull);
+BENCHMARK_CAPTURE(BM_EkepHandshake, sgx_local, Authority::kSgxLocal);
+BENCHMARK_CAPTURE(BM_EkepHandshake, sgx_age_remote, Authority::kSgxAgeRemote);
+
+// Starts a Messenger1 server accepting |authority| credentials on a local port
+// and returns its address.
+StatusOr<std::string> StartServer(Authority authority) {
+  auto launcher = absl::make_unique<GrpcServerLauncher>("HandshakeBenchmark");
+  ASYLO_RETURN_IF_ERROR(
+      launcher->RegisterService(absl::make_unique<test::MessengerServer1>()));
+  int port = 0;
+  ASYLO_RETURN_IF_ERROR(launcher->AddListeningPort(
+      absl::StrCat(kAddress, ":0"),
+      EnclaveServerCredentials(GetCredentialsOptions(authority)), &port));
+  ASYLO_RETURN_IF_ERROR(launcher->Start());
+
+  // The server is shared by all benchmarks and threads and is never shut
+  // down.
+  launcher.release();
+  return absl::StrCat(kAddress, ":", port);
+}
+
+// Returns the address of the server for |kAuthority|, starting it on first
+// use.
+template <Authority kAuthority>
+StatusOr<std::string> GetServerAddress() {
+  static const StatusOr<std::string> *const address =
+      new StatusOr<std::string>(StartServer(kAuthority));
+  return *address;
+}
+
+StatusOr<std::string> GetServerAddress(Authority authority) {
+  if (authority == Authority::kSgxLocal) {
+    return GetServerAddress<Authority::kSgxLocal>();
+  }
+  if (authority == Authority::kSgxAgeRemote) {
+    return GetServerAddress<Authority::kSgxAgeRemote>();
+  }
+  return GetServerAddress<Authority::kNull>();
+}
+
+// Opens a channel to |address| with |authority| credentials and waits for it to
+// connect. The channel does not share connections with other channels, so that
+// every channel performs its own handshake. Returns nullptr if the channel
+// failed to connect.
+std::shared_ptr<::grpc::Channel> Connect(const std::string &address,
+                                         Authority authority) {
+  ::grpc::ChannelArguments args;
+  args.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+  std::shared_ptr<::grpc::Channel> channel = ::grpc::CreateCustomChannel(
+      address, EnclaveChannelCredentials(GetCredentialsOptions(authority)),
+      args);
+  if (!channel->WaitForConnected(
+          absl::ToChronoTime(absl::Now() + kConnectTimeout))) {
+    return nullptr;
+  }
+  return channel;
+}
+
+// Returns the address of the server for |authority|. Marks |state| as skipped
+// and returns an empty string if |authority| cannot be benchmarked.
+std::string PrepareServer(Authority authority, benchmark::State *state) {
+  if (!PrepareAuthority(authority, state)) {
+    return "";
+  }
+  StatusOr<std::string> address_result = GetServerAddress(authority);
+  if (!address_result.ok()) {
+    state->SkipWithError(address_result.status().ToString().c_str());
+    return "";
+  }
+  return address_result.ValueOrDie();
+}
+
+// Measures the establishment of a new channel, from its creation until it is
+// connected, with one channel being established per thread at any time. The
+// items per second are the handshakes per second of all threads.
+void BM_ChannelHandshake(benchmark::State &state, Authority authority) {
+  std::string address = PrepareServer(authority, &state);
+  if (address.empty()) {
+    return;
+  }
+  std::vector<absl::Duration> latencies;
+  for (auto _ : state) {
+    absl::Time start = absl::Now();
+    std::shared_ptr<::grpc::Channel> channel = Connect(address, authority);
+    if (!channel) {
+      state.SkipWithError("Channel failed to connect");
+      break;
+    }
+    latencies.push_back(absl::Now() - start);
+  }
+  state.SetItemsProcessed(state.iterations());
+  ReportLatency("handshake", &latencies, &state);
+}
+BENCHMARK_CAPTURE(BM_ChannelHandshake, null, Authority::kNull)
+    ->ThreadRange(1, kMaxChannels)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(BM_ChannelHandshake, sgx_local, Authority::kSgxLocal)
+    ->ThreadRange(1, kMaxChannels)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(BM_ChannelHandshake, sgx_age_remote,
+                  Authority::kSgxAgeRemote)
+    ->ThreadRange(1, kMaxChannels)
+    ->UseRealTime();
+
+// Measures unary RPCs carrying a state.range(0)-byte request over an
+// established channel, one channel per thread. The response carries the
+// request back, so the bytes per second count both directions.
+void BM_Rpc(benchmark::State &state, Authority authority) {
+  std::string address = PrepareServer(authority, &state);
+  if (address.empty()) {
+    return;
+  }
+  std::shared_ptr<::grpc::Channel> channel = Connect(address, authority);
+  if (!channel) {
+    state.SkipWithError("Channel failed to connect");
+    return;
+  }
+  std::unique_ptr<test::Messenger1::Stub> stub =
+      test::Messenger1::NewStub(channel);
+  test::HelloRequest request;
+  request.set_name(std::string(state.range(0), 'a'));
+  int64_t bytes = 0;
+  for (auto _ : state) {
+    ::grpc::ClientContext context;
+    test::HelloResponse response;
+    ::grpc::Status status = stub->Hello(&context, request, &response);
+    if (!status.ok()) {
+      state.SkipWithError(status.error_message().c_str());
+      break;
+    }
+    bytes += request.ByteSizeLong() + response.ByteSizeLong();
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(bytes);
+}
+BENCHMARK_CAPTURE(BM_Rpc, null, Authority::kNull)
+    ->RangeMultiplier(16)
+    ->Range(1, kMaxRequestSize);
+BENCHMARK_CAPTURE(BM_Rpc, null, Authority::kNull)
+    ->Arg(1)
+    ->ThreadRange(1, kMaxChannels)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(BM_Rpc, sgx_local, Authority::kSgxLocal)
+    ->RangeMultiplier(16)
+    ->Range(1, kMaxRequestSize);
+BENCHMARK_CAPTURE(BM_Rpc, sgx_local, Authority::kSgxLocal)
+    ->Arg(1)
+    ->ThreadRange(1, kMaxChannels)
+    ->UseRealTime();
+
+}  // namespace
+}  // namespace asylo
+
+// Inside an enclave, the test shim runs the benchmarks.
+#ifndef __ASYLO__
+int main(int argc, char *argv[]) {
+  benchmark::Initialize(&argc, argv);
+  absl::ParseCommandLine(argc, argv);
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
+#endif  // __ASYLO__
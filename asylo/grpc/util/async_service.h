@@ -0,0 +1,162 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_GRPC_UTIL_ASYNC_SERVICE_H_
+#define ASYLO_GRPC_UTIL_ASYNC_SERVICE_H_
+
+#include <functional>
+#include <memory>
+#include <utility>
+
+#include "include/grpcpp/completion_queue.h"
+#include "include/grpcpp/impl/codegen/service_type.h"
+#include "include/grpcpp/server_context.h"
+#include "include/grpcpp/support/async_unary_call.h"
+#include "include/grpcpp/support/status.h"
+
+namespace asylo {
+
+// Tag of an asynchronous gRPC operation started on a completion queue owned by
+// a GrpcServerLauncher. Every tag passed to an operation on those completion
+// queues must point to an AsyncCallTag.
+class AsyncCallTag {
+ public:
+  virtual ~AsyncCallTag() = default;
+
+  // Advances the call after its pending operation completed. Called on one of
+  // the executor threads of the launcher, never concurrently for the same tag.
+  // |ok| is the result reported by the completion queue.
+  //
+  // Once the launcher is shutting down, |ok| is always false. Implementations
+  // must then release the tag without starting any new operation.
+  virtual void Proceed(bool ok) = 0;
+};
+
+// An asynchronous gRPC service hosted by a GrpcServerLauncher.
+class AsyncServiceHandler {
+ public:
+  virtual ~AsyncServiceHandler() = default;
+
+  // Returns the service to register with the server. All of its methods must
+  // be asynchronous.
+  virtual ::grpc::Service *service() = 0;
+
+  // Requests the first calls to the service on |cq|. Called once for each
+  // completion queue of the launcher after the server has started.
+  virtual void RequestCalls(::grpc::ServerCompletionQueue *cq) = 0;
+};
+
+// Handles calls to a unary method of an asynchronous service, one call at a
+// time per object. Use ServeAsyncUnaryCalls() rather than creating objects of
+// this class directly.
+template <class RequestT, class ResponseT>
+class AsyncUnaryCall final : public AsyncCallTag {
+ public:
+  // Requests a call to the method as |tag| on |cq|.
+  using RequestFunction = std::function<void(
+      ::grpc::ServerContext *context, RequestT *request,
+      ::grpc::ServerAsyncResponseWriter<ResponseT> *responder,
+      ::grpc::ServerCompletionQueue *cq, void *tag)>;
+
+  // Produces the response to a call. Has the signature of the method of the
+  // synchronous service.
+  using Handler = std::function<::grpc::Status(
+      ::grpc::ServerContext *context, const RequestT *request,
+      ResponseT *response)>;
+
+  // State shared by all calls to the method on one completion queue.
+  struct Method {
+    RequestFunction request;
+    Handler handler;
+    ::grpc::ServerCompletionQueue *cq;
+  };
+
+  // Requests the next call to |method|. The new object deletes itself once the
+  // call is finished.
+  static void Request(std::shared_ptr<const Method> method) {
+    auto *call = new AsyncUnaryCall(std::move(method));
+    call->method_->request(&call->context_, &call->request_,
+                           &call->responder_, call->method_->cq, call);
+  }
+
+  void Proceed(bool ok) override {
+    if (!ok || finished_) {
+      delete this;
+      return;
+    }
+
+    // Keep accepting calls to the method while this one is being handled.
+    Request(method_);
+
+    ResponseT response;
+    ::grpc::Status status = method_->handler(&context_, &request_, &response);
+    finished_ = true;
+    responder_.Finish(response, status, this);
+  }
+
+ private:
+  explicit AsyncUnaryCall(std::shared_ptr<const Method> method)
+      : method_(std::move(method)), responder_(&context_) {}
+
+  std::shared_ptr<const Method> method_;
+  ::grpc::ServerContext context_;
+  RequestT request_;
+  ::grpc::ServerAsyncResponseWriter<ResponseT> responder_;
+
+  // Whether the response has been sent.
+  bool finished_ = false;
+};
+
+// Serves calls to the unary method requested by |request_method| of |service|
+// on |cq| by running |handler|. Meant to be called from
+// AsyncServiceHandler::RequestCalls(), for example:
+//
+//   void RequestCalls(::grpc::ServerCompletionQueue *cq) override {
+//     ServeAsyncUnaryCalls(&service_, &Translator::AsyncService::RequestGet,
+//                          [this](::grpc::ServerContext *context,
+//                                 const GetRequest *request,
+//                                 GetResponse *response) {
+//                            return Get(context, request, response);
+//                          },
+//                          cq);
+//   }
+template <class ServiceT, class MethodOwnerT, class RequestT, class ResponseT,
+          class HandlerT>
+void ServeAsyncUnaryCalls(
+    ServiceT *service,
+    void (MethodOwnerT::*request_method)(
+        ::grpc::ServerContext *, RequestT *,
+        ::grpc::ServerAsyncResponseWriter<ResponseT> *,
+        ::grpc::CompletionQueue *, ::grpc::ServerCompletionQueue *, void *),
+    HandlerT handler, ::grpc::ServerCompletionQueue *cq) {
+  using Call = AsyncUnaryCall<RequestT, ResponseT>;
+  auto method = std::make_shared<typename Call::Method>();
+  method->request = [service, request_method](
+                        ::grpc::ServerContext *context, RequestT *request,
+                        ::grpc::ServerAsyncResponseWriter<ResponseT> *responder,
+                        ::grpc::ServerCompletionQueue *cq, void *tag) {
+    (service->*request_method)(context, request, responder, cq, cq, tag);
+  };
+  method->handler = std::move(handler);
+  method->cq = cq;
+  Call::Request(std::move(method));
+}
+
+}  // namespace asylo
+
+#endif  // ASYLO_GRPC_UTIL_ASYNC_SERVICE_H_
@@ -0,0 +1,237 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/grpc/util/enclave_grpc_relay.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/match.h"
+#include "absl/strings/string_view.h"
+#include "asylo/enclave.pb.h"
+#include "asylo/grpc/util/enclave_server.pb.h"
+#include "asylo/util/status.h"
+#include "include/grpcpp/server_builder.h"
+#include "include/grpcpp/support/channel_arguments.h"
+#include "include/grpcpp/support/slice.h"
+
+namespace asylo {
+namespace {
+
+// Returns whether |key| is metadata that gRPC sets on each call by itself, and
+// which therefore must not be forwarded to the enclave.
+bool IsReservedMetadata(absl::string_view key) {
+  return absl::StartsWith(key, ":") || absl::StartsWith(key, "grpc-") ||
+         key == "content-type" || key == "te" || key == "user-agent";
+}
+
+// Appends the contents of |buffer| to |bytes|.
+::grpc::Status AppendByteBuffer(const ::grpc::ByteBuffer &buffer,
+                                std::string *bytes) {
+  std::vector<::grpc::Slice> slices;
+  ::grpc::Status status = buffer.Dump(&slices);
+  if (!status.ok()) {
+    return status;
+  }
+  for (const ::grpc::Slice &slice : slices) {
+    bytes->append(reinterpret_cast<const char *>(slice.begin()), slice.size());
+  }
+  return ::grpc::Status::OK;
+}
+
+}  // namespace
+
+// A call to the relay, which deletes itself once the call is finished.
+class EnclaveGrpcRelay::Call {
+ public:
+  // Requests the next call to |relay|.
+  explicit Call(EnclaveGrpcRelay *relay) : relay_(relay), stream_(&context_) {
+    relay_->service_.RequestCall(&context_, &stream_, relay_->cq_.get(),
+                                 relay_->cq_.get(), this);
+  }
+
+  // Advances the call after its pending operation completed with |ok|.
+  void Proceed(bool ok) {
+    switch (state_) {
+      case State::kRequested:
+        if (!ok) {
+          // The server is shutting down.
+          delete this;
+          return;
+        }
+        // Keep accepting calls while this one is being relayed.
+        relay_->RequestCall();
+        state_ = State::kReading;
+        stream_.Read(&request_, this);
+        return;
+      case State::kReading: {
+        state_ = State::kFinished;
+        if (!ok) {
+          stream_.Finish(::grpc::Status(::grpc::StatusCode::INVALID_ARGUMENT,
+                                        "Call has no request message"),
+                         this);
+          return;
+        }
+        ::grpc::ByteBuffer response;
+        ::grpc::Status status = relay_->Relay(context_, request_, &response);
+        if (status.ok()) {
+          stream_.WriteAndFinish(response, ::grpc::WriteOptions(), status,
+                                 this);
+        } else {
+          stream_.Finish(status, this);
+        }
+        return;
+      }
+      case State::kFinished:
+        delete this;
+        return;
+    }
+  }
+
+ private:
+  enum class State { kRequested, kReading, kFinished };
+
+  EnclaveGrpcRelay *const relay_;
+  ::grpc::GenericServerContext context_;
+  ::grpc::GenericServerAsyncReaderWriter stream_;
+  ::grpc::ByteBuffer request_;
+  State state_ = State::kRequested;
+};
+
+StatusOr<std::unique_ptr<EnclaveGrpcRelay>> EnclaveGrpcRelay::Create(
+    EnclaveClient *client, size_t num_threads) {
+  if (num_threads == 0) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "A relay needs at least one thread");
+  }
+
+  std::unique_ptr<EnclaveGrpcRelay> relay(new EnclaveGrpcRelay(client));
+  ::grpc::ServerBuilder builder;
+  builder.RegisterAsyncGenericService(&relay->service_);
+  relay->cq_ = builder.AddCompletionQueue();
+  relay->server_ = builder.BuildAndStart();
+  if (!relay->server_) {
+    relay->cq_->Shutdown();
+    void *tag;
+    bool ok;
+    while (relay->cq_->Next(&tag, &ok)) {
+    }
+    return Status(error::GoogleError::INTERNAL,
+                  "Failed to start the gRPC relay server");
+  }
+  relay->channel_ =
+      relay->server_->InProcessChannel(::grpc::ChannelArguments());
+
+  for (size_t i = 0; i < num_threads; ++i) {
+    relay->RequestCall();
+    relay->threads_.emplace_back(&EnclaveGrpcRelay::Poll, relay.get());
+  }
+  return std::move(relay);
+}
+
+EnclaveGrpcRelay::EnclaveGrpcRelay(EnclaveClient *client) : client_(client) {}
+
+EnclaveGrpcRelay::~EnclaveGrpcRelay() {
+  if (!server_) {
+    return;
+  }
+
+  // Shutdown() waits for the calls in progress, which the pollers finish.
+  server_->Shutdown();
+  {
+    absl::MutexLock lock(&mu_);
+    shutting_down_ = true;
+  }
+  cq_->Shutdown();
+  for (Thread &thread : threads_) {
+    thread.Join();
+  }
+}
+
+void EnclaveGrpcRelay::RequestCall() {
+  absl::MutexLock lock(&mu_);
+  if (!shutting_down_) {
+    new Call(this);
+  }
+}
+
+void EnclaveGrpcRelay::Poll() {
+  void *tag;
+  bool ok;
+  while (cq_->Next(&tag, &ok)) {
+    static_cast<Call *>(tag)->Proceed(ok);
+  }
+}
+
+::grpc::Status EnclaveGrpcRelay::Relay(
+    const ::grpc::GenericServerContext &context,
+    const ::grpc::ByteBuffer &request, ::grpc::ByteBuffer *response) {
+  EnclaveInput input;
+  EnclaveGrpcRequest *grpc_request =
+      input.MutableExtension(enclave_grpc_request);
+  grpc_request->set_method(context.method());
+  ::grpc::Status status =
+      AppendByteBuffer(request, grpc_request->mutable_request());
+  if (!status.ok()) {
+    return status;
+  }
+  for (const auto &entry : context.client_metadata()) {
+    absl::string_view key(entry.first.data(), entry.first.size());
+    if (IsReservedMetadata(key)) {
+      continue;
+    }
+    GrpcMetadataEntry *metadata = grpc_request->add_metadata();
+    metadata->set_key(key.data(), key.size());
+    metadata->set_value(entry.second.data(), entry.second.size());
+  }
+  if (context.deadline() != std::chrono::system_clock::time_point::max()) {
+    int64_t timeout_micros =
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            context.deadline() - std::chrono::system_clock::now())
+            .count();
+    grpc_request->set_timeout_micros(std::max<int64_t>(timeout_micros, 0));
+  }
+
+  EnclaveOutput output;
+  Status enter_status = client_->EnterAndRun(input, &output);
+  if (!enter_status.ok()) {
+    return ::grpc::Status(::grpc::StatusCode::UNAVAILABLE,
+                          enter_status.ToString());
+  }
+  if (!output.HasExtension(enclave_grpc_response)) {
+    return ::grpc::Status(::grpc::StatusCode::INTERNAL,
+                          "Enclave returned no gRPC response");
+  }
+
+  const EnclaveGrpcResponse &grpc_response =
+      output.GetExtension(enclave_grpc_response);
+  if (grpc_response.status_code() != ::grpc::StatusCode::OK) {
+    return ::grpc::Status(
+        static_cast<::grpc::StatusCode>(grpc_response.status_code()),
+        grpc_response.status_message());
+  }
+  ::grpc::Slice slice(grpc_response.response());
+  *response = ::grpc::ByteBuffer(&slice, /*nslices=*/1);
+  return ::grpc::Status::OK;
+}
+
+}  // namespace asylo
@@ -0,0 +1,104 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_GRPC_UTIL_ENCLAVE_GRPC_RELAY_H_
+#define ASYLO_GRPC_UTIL_ENCLAVE_GRPC_RELAY_H_
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "asylo/client.h"
+#include "asylo/util/statusor.h"
+#include "asylo/util/thread.h"
+#include "include/grpcpp/channel.h"
+#include "include/grpcpp/generic/async_generic_service.h"
+#include "include/grpcpp/server.h"
+#include "include/grpcpp/support/byte_buffer.h"
+#include "include/grpcpp/support/status.h"
+
+namespace asylo {
+
+// Serves a gRPC channel in the host application that is connected to the
+// EnclaveServer of an enclave without any socket. Each call made on the channel
+// is handed to the enclave by EnterAndRun, and served by the EnclaveServer
+// through an in-process channel to its own gRPC server. This avoids both the
+// network stack and the host calls that a socket connection into the enclave
+// requires, and lets the EnclaveServer run without a listening port (see the
+// |listen| field of ServerConfig).
+//
+// Only unary calls are supported: each call is relayed with the first message
+// from its client, and answered with at most one message.
+//
+// The calls never leave the host application, so the channel has no channel
+// security. Calls to services that authorize their callers by their enclave
+// identity need a listening server with enclave credentials instead.
+class EnclaveGrpcRelay {
+ public:
+  // Starts a relay for calls to the EnclaveServer in the enclave of |client|,
+  // which must outlive the relay. The calls are relayed by |num_threads|
+  // threads, each making one call into the enclave at a time.
+  static StatusOr<std::unique_ptr<EnclaveGrpcRelay>> Create(
+      EnclaveClient *client, size_t num_threads = 4);
+
+  EnclaveGrpcRelay(const EnclaveGrpcRelay &other) = delete;
+  EnclaveGrpcRelay &operator=(const EnclaveGrpcRelay &other) = delete;
+
+  // Waits for the calls in progress to finish, and stops the relay.
+  ~EnclaveGrpcRelay();
+
+  // Returns a channel on which to make calls to the services of the enclave.
+  // The channel must not be used once the relay is destroyed.
+  std::shared_ptr<::grpc::Channel> channel() const { return channel_; }
+
+ private:
+  class Call;
+
+  explicit EnclaveGrpcRelay(EnclaveClient *client);
+
+  // Requests the next call to the relay, unless it is shutting down.
+  void RequestCall();
+
+  // Handles the events of the completion queue until it is shut down.
+  void Poll();
+
+  // Makes the call described by |context| with |request| in the enclave, and
+  // writes its response to |response|.
+  ::grpc::Status Relay(const ::grpc::GenericServerContext &context,
+                       const ::grpc::ByteBuffer &request,
+                       ::grpc::ByteBuffer *response);
+
+  EnclaveClient *const client_;
+
+  ::grpc::AsyncGenericService service_;
+  std::unique_ptr<::grpc::ServerCompletionQueue> cq_;
+  std::unique_ptr<::grpc::Server> server_;
+  std::shared_ptr<::grpc::Channel> channel_;
+  std::vector<Thread> threads_;
+
+  // Set once no more calls may be requested on |cq_|, which is about to be
+  // shut down.
+  absl::Mutex mu_;
+  bool shutting_down_ ABSL_GUARDED_BY(mu_) = false;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_GRPC_UTIL_ENCLAVE_GRPC_RELAY_H_
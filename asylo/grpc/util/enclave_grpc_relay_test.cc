@@ -0,0 +1,123 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/grpc/util/enclave_grpc_relay.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "asylo/enclave.pb.h"
+#include "asylo/grpc/util/enclave_server.h"
+#include "asylo/grpc/util/enclave_server.pb.h"
+#include "asylo/test/grpc/messenger_client_impl.h"
+#include "asylo/test/grpc/messenger_server_impl.h"
+#include "asylo/test/util/mock_enclave_client.h"
+#include "asylo/test/util/status_matchers.h"
+#include "asylo/util/status.h"
+#include "asylo/util/thread.h"
+#include "include/grpcpp/security/server_credentials.h"
+
+namespace asylo {
+namespace {
+
+using ::testing::_;
+using ::testing::Invoke;
+using ::testing::Return;
+
+class EnclaveGrpcRelayTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    server_ = absl::make_unique<EnclaveServer>(
+        absl::make_unique<test::MessengerServer1>(),
+        ::grpc::InsecureServerCredentials());
+    EnclaveConfig config;
+    config.MutableExtension(server_input_config)->set_listen(false);
+    ASSERT_THAT(server_->Initialize(config), IsOk());
+
+    ON_CALL(client_, EnterAndRun(_, _))
+        .WillByDefault(Invoke(server_.get(), &EnclaveServer::Run));
+  }
+
+  void TearDown() override {
+    ASSERT_THAT(server_->Finalize(EnclaveFinal()), IsOk());
+  }
+
+  std::unique_ptr<EnclaveServer> server_;
+  ::testing::NiceMock<MockEnclaveClient> client_;
+};
+
+TEST_F(EnclaveGrpcRelayTest, RelaysCallsIntoEnclave) {
+  std::unique_ptr<EnclaveGrpcRelay> relay;
+  ASYLO_ASSERT_OK_AND_ASSIGN(relay, EnclaveGrpcRelay::Create(&client_));
+
+  test::MessengerClient1 client(relay->channel());
+  EXPECT_THAT(client.Hello("Relay"),
+              IsOkAndHolds(test::MessengerServer1::ResponseString("Relay")));
+}
+
+TEST_F(EnclaveGrpcRelayTest, RelaysErrorsOfCalls) {
+  std::unique_ptr<EnclaveGrpcRelay> relay;
+  ASYLO_ASSERT_OK_AND_ASSIGN(relay, EnclaveGrpcRelay::Create(&client_));
+
+  test::MessengerClient1 client(relay->channel());
+  EXPECT_THAT(client.Hello(""),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+}
+
+TEST_F(EnclaveGrpcRelayTest, RelaysConcurrentCalls) {
+  constexpr int kNumCallers = 8;
+  std::unique_ptr<EnclaveGrpcRelay> relay;
+  ASYLO_ASSERT_OK_AND_ASSIGN(relay, EnclaveGrpcRelay::Create(&client_));
+
+  std::vector<Thread> callers;
+  for (int i = 0; i < kNumCallers; ++i) {
+    callers.emplace_back([&relay, i] {
+      test::MessengerClient1 client(relay->channel());
+      std::string name = absl::StrCat("Caller ", i);
+      EXPECT_THAT(client.Hello(name),
+                  IsOkAndHolds(test::MessengerServer1::ResponseString(name)));
+    });
+  }
+  for (Thread &caller : callers) {
+    caller.Join();
+  }
+}
+
+TEST_F(EnclaveGrpcRelayTest, FailsCallsWhenEnclaveEntryFails) {
+  EXPECT_CALL(client_, EnterAndRun(_, _))
+      .WillOnce(Return(Status(error::GoogleError::INTERNAL, "Enclave lost")));
+  std::unique_ptr<EnclaveGrpcRelay> relay;
+  ASYLO_ASSERT_OK_AND_ASSIGN(relay, EnclaveGrpcRelay::Create(&client_));
+
+  test::MessengerClient1 client(relay->channel());
+  EXPECT_THAT(client.Hello("Relay"),
+              StatusIs(error::GoogleError::UNAVAILABLE));
+}
+
+TEST_F(EnclaveGrpcRelayTest, CreateRejectsZeroThreads) {
+  EXPECT_THAT(EnclaveGrpcRelay::Create(&client_, /*num_threads=*/0),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+}
+
+}  // namespace
+}  // namespace asylo
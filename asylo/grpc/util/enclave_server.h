@@ -19,8 +19,11 @@
 #ifndef ASYLO_GRPC_UTIL_ENCLAVE_SERVER_H_
 #define ASYLO_GRPC_UTIL_ENCLAVE_SERVER_H_
 
+#include <chrono>
+#include <cstdint>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "absl/strings/str_cat.h"
 #include "asylo/util/logging.h"
@@ -30,10 +33,17 @@
 #include "asylo/util/status.h"
 #include "asylo/util/status_macros.h"
 #include "asylo/util/statusor.h"
+#include "include/grpcpp/channel.h"
+#include "include/grpcpp/client_context.h"
+#include "include/grpcpp/completion_queue.h"
+#include "include/grpcpp/generic/generic_stub.h"
 #include "include/grpcpp/impl/codegen/service_type.h"
 #include "include/grpcpp/security/server_credentials.h"
 #include "include/grpcpp/server.h"
 #include "include/grpcpp/server_builder.h"
+#include "include/grpcpp/support/byte_buffer.h"
+#include "include/grpcpp/support/channel_arguments.h"
+#include "include/grpcpp/support/slice.h"
 
 namespace asylo {
 
@@ -50,6 +60,11 @@ namespace asylo {
 // if the EnclaveConfig specified a port of 0 (indicates that the operating
 // system should select an available port).
 //
+// Run() also serves the unary gRPC calls relayed by an EnclaveGrpcRelay in the
+// enclave_grpc_request extension of its input, through an in-process channel
+// to the server. A server configured not to listen is only reachable this way,
+// and needs no host or port.
+//
 // The server is shut down during Finalize(). To ensure proper server shutdown,
 // users of this class are expected to trigger enclave finalization by calling
 // EnclaveManager::DestroyEnclave() at some point during lifetime of their
@@ -62,6 +77,7 @@ class EnclaveServer final : public TrustedApplication {
   EnclaveServer(std::unique_ptr<::grpc::Service> service,
                 std::shared_ptr<::grpc::ServerCredentials> credentials)
       : server_{nullptr},
+        in_process_channel_{nullptr},
         service_{std::move(service)},
         service_factory_{NoFactory},
         credentials_{credentials} {}
@@ -69,6 +85,7 @@ class EnclaveServer final : public TrustedApplication {
   EnclaveServer(GrpcServiceFactory service_factory,
                 std::shared_ptr<::grpc::ServerCredentials> credentials)
       : server_{nullptr},
+        in_process_channel_{nullptr},
         service_factory_{service_factory},
         credentials_{credentials} {}
 
@@ -79,6 +96,11 @@ class EnclaveServer final : public TrustedApplication {
   Status Initialize(const EnclaveConfig &config) override {
     const ServerConfig &config_server_proto =
         config.GetExtension(server_input_config);
+    listen_ = config_server_proto.listen();
+    if (!listen_) {
+      LOG(INFO) << "gRPC server configured without a listening port";
+      return InitializeServer();
+    }
     if (!config_server_proto.has_host()) {
       return Status(
           error::GoogleError::FAILED_PRECONDITION,
@@ -99,6 +121,11 @@ class EnclaveServer final : public TrustedApplication {
   }
 
   Status Run(const EnclaveInput &input, EnclaveOutput *output) override {
+    if (input.HasExtension(enclave_grpc_request)) {
+      return HandleGrpcRequest(
+          input.GetExtension(enclave_grpc_request),
+          output->MutableExtension(enclave_grpc_response));
+    }
     GetServerAddress(output);
     return Status::OkStatus();
   }
@@ -119,16 +146,20 @@ class EnclaveServer final : public TrustedApplication {
     }
 
     ASYLO_ASSIGN_OR_RETURN(*server_view, CreateServer());
+    *in_process_channel_.Lock() =
+        (*server_view)->InProcessChannel(::grpc::ChannelArguments());
     return Status::OkStatus();
   }
 
-  // Creates a gRPC server that hosts service_ on host_ and port_ with
-  // credentials_.
+  // Creates a gRPC server that hosts service_, listening on host_ and port_
+  // with credentials_ if listen_ is set.
   StatusOr<std::unique_ptr<::grpc::Server>> CreateServer() {
-    int port;
+    int port = 0;
     ::grpc::ServerBuilder builder;
-    builder.AddListeningPort(absl::StrCat(host_, ":", port_), credentials_,
-                             &port);
+    if (listen_) {
+      builder.AddListeningPort(absl::StrCat(host_, ":", port_), credentials_,
+                               &port);
+    }
     if (service_ == nullptr) {
       StatusOr<std::unique_ptr<::grpc::Service>> service_result =
           service_factory_();
@@ -147,8 +178,10 @@ class EnclaveServer final : public TrustedApplication {
                     "Failed to start gRPC server");
     }
 
-    port_ = port;
-    LOG(INFO) << "gRPC server is listening on " << host_ << ":" << port_;
+    if (listen_) {
+      port_ = port;
+      LOG(INFO) << "gRPC server is listening on " << host_ << ":" << port_;
+    }
 
     return std::move(server);
   }
@@ -161,9 +194,70 @@ class EnclaveServer final : public TrustedApplication {
     config->set_port(port_);
   }
 
+  // Makes the unary call described by |request| on the server through its
+  // in-process channel, and writes its result to |response|. The returned
+  // status only reflects failures to relay the call: the status of the call
+  // itself is part of |response|.
+  Status HandleGrpcRequest(const EnclaveGrpcRequest &request,
+                           EnclaveGrpcResponse *response) {
+    std::shared_ptr<::grpc::Channel> channel = *in_process_channel_.Lock();
+    if (!channel) {
+      return Status(error::GoogleError::FAILED_PRECONDITION,
+                    "gRPC server is not running");
+    }
+
+    ::grpc::ClientContext context;
+    for (const GrpcMetadataEntry &entry : request.metadata()) {
+      context.AddMetadata(entry.key(), entry.value());
+    }
+    if (request.has_timeout_micros()) {
+      context.set_deadline(std::chrono::system_clock::now() +
+                           std::chrono::microseconds(request.timeout_micros()));
+    }
+
+    ::grpc::Slice request_slice(request.request());
+    ::grpc::ByteBuffer request_buffer(&request_slice, /*nslices=*/1);
+    ::grpc::ByteBuffer response_buffer;
+    ::grpc::Status status;
+    ::grpc::CompletionQueue cq;
+    ::grpc::GenericStub stub(channel);
+    std::unique_ptr<::grpc::GenericClientAsyncResponseReader> call =
+        stub.PrepareUnaryCall(&context, request.method(), request_buffer, &cq);
+    call->StartCall();
+    call->Finish(&response_buffer, &status, /*tag=*/&status);
+
+    void *tag;
+    bool ok;
+    bool finished = cq.Next(&tag, &ok) && ok;
+    cq.Shutdown();
+    while (cq.Next(&tag, &ok)) {
+    }
+    if (!finished) {
+      return Status(error::GoogleError::INTERNAL,
+                    "Failed to complete relayed gRPC call");
+    }
+
+    response->set_status_code(status.error_code());
+    response->set_status_message(status.error_message());
+    if (status.ok()) {
+      std::vector<::grpc::Slice> slices;
+      if (!response_buffer.Dump(&slices).ok()) {
+        return Status(error::GoogleError::INTERNAL,
+                      "Failed to read response of relayed gRPC call");
+      }
+      std::string *bytes = response->mutable_response();
+      for (const ::grpc::Slice &slice : slices) {
+        bytes->append(reinterpret_cast<const char *>(slice.begin()),
+                      slice.size());
+      }
+    }
+    return Status::OkStatus();
+  }
+
   // Finalizes the gRPC server by calling ::gprc::Server::Shutdown().
   void FinalizeServer() {
     auto server_view(server_.Lock());
+    *in_process_channel_.Lock() = nullptr;
     if (*server_view) {
       LOG(INFO) << "Shutting down...";
       (*server_view)->Shutdown();
@@ -178,9 +272,16 @@ class EnclaveServer final : public TrustedApplication {
   // A gRPC server hosting |messenger_|.
   MutexGuarded<std::unique_ptr<::grpc::Server>> server_;
 
+  // An in-process channel to |server_|, through which relayed calls are made.
+  // Null whenever |server_| is not running.
+  MutexGuarded<std::shared_ptr<::grpc::Channel>> in_process_channel_;
+
+  // Whether the server listens on host_ and port_.
+  bool listen_ = true;
+
   // The host and port of the server's address.
   std::string host_;
-  int port_;
+  int port_ = 0;
 
   std::unique_ptr<::grpc::Service> service_;
   GrpcServiceFactory service_factory_;
@@ -17,10 +17,26 @@
  */
 
 #include "asylo/grpc/util/grpc_server_launcher.h"
+
+#include <utility>
+
 #include "absl/synchronization/mutex.h"
 #include "asylo/util/logging.h"
+#include "asylo/util/status_macros.h"
 
 namespace asylo {
+namespace {
+
+// Shuts down |cq| and discards the operations left on it.
+void ShutdownAndDrain(::grpc::ServerCompletionQueue *cq) {
+  cq->Shutdown();
+  void *tag;
+  bool ok;
+  while (cq->Next(&tag, &ok)) {
+  }
+}
+
+}  // namespace
 
 Status GrpcServerLauncher::RegisterService(
     std::unique_ptr<::grpc::Service> service) {
@@ -34,6 +50,18 @@ Status GrpcServerLauncher::RegisterService(
   return Status::OkStatus();
 }
 
+Status GrpcServerLauncher::RegisterAsyncService(
+    std::unique_ptr<AsyncServiceHandler> handler) {
+  absl::MutexLock lock(&mu_);
+  if (state_ != State::NOT_LAUNCHED) {
+    return MakeStatus(error::GoogleError::FAILED_PRECONDITION,
+                      "Cannot add services after the server has started");
+  }
+  builder_.RegisterService(handler->service());
+  async_services_.emplace_back(std::move(handler));
+  return Status::OkStatus();
+}
+
 Status GrpcServerLauncher::AddListeningPort(
     const std::string &address,
     std::shared_ptr<::grpc::ServerCredentials> creds, int *selected_port) {
@@ -54,12 +82,41 @@ Status GrpcServerLauncher::Start() {
     return MakeStatus(error::GoogleError::FAILED_PRECONDITION,
                       "Cannot start server more than once");
   }
+
+  if (!async_services_.empty()) {
+    if (async_options_.num_completion_queues == 0 ||
+        async_options_.num_executor_threads == 0 ||
+        async_options_.max_queued_operations == 0) {
+      return MakeStatus(error::GoogleError::INVALID_ARGUMENT,
+                        "Asynchronous services require at least one "
+                        "completion queue, executor thread, and queued "
+                        "operation");
+    }
+    ASYLO_ASSIGN_OR_RETURN(
+        executor_,
+        WorkStealingExecutor::Create(async_options_.num_executor_threads));
+    for (size_t i = 0; i < async_options_.num_completion_queues; ++i) {
+      completion_queues_.emplace_back(builder_.AddCompletionQueue());
+    }
+  }
+
   server_ = builder_.BuildAndStart();
   if (!server_) {
     state_ = State::TERMINATED;
+    for (auto &cq : completion_queues_) {
+      ShutdownAndDrain(cq.get());
+    }
     return MakeStatus(error::GoogleError::INTERNAL,
                       "Failed to start the server ");
   }
+
+  for (auto &cq : completion_queues_) {
+    for (auto &handler : async_services_) {
+      handler->RequestCalls(cq.get());
+    }
+    pollers_.emplace_back(&GrpcServerLauncher::PollCompletionQueue, this,
+                          cq.get());
+  }
   state_ = State::LAUNCHED;
   return Status::OkStatus();
 }
@@ -75,6 +132,7 @@ Status GrpcServerLauncher::Shutdown() {
   }
 
   server_->Shutdown();
+  ShutdownAsyncServices();
   state_ = State::TERMINATED;
 
   return Status::OkStatus();
@@ -105,4 +163,62 @@ GrpcServerLauncher::State GrpcServerLauncher::GetState() {
   return state_;
 }
 
+void GrpcServerLauncher::PollCompletionQueue(
+    ::grpc::ServerCompletionQueue *cq) {
+  void *tag;
+  bool ok;
+  while (cq->Next(&tag, &ok)) {
+    {
+      absl::MutexLock lock(&operations_mu_);
+      operations_mu_.Await(
+          absl::Condition(this, &GrpcServerLauncher::CanQueueOperation));
+      ++queued_operations_;
+    }
+    executor_->Submit([this, tag, ok] {
+      RunOperation(static_cast<AsyncCallTag *>(tag), ok);
+    });
+  }
+}
+
+bool GrpcServerLauncher::CanQueueOperation() const {
+  return queued_operations_ < async_options_.max_queued_operations;
+}
+
+void GrpcServerLauncher::RunOperation(AsyncCallTag *tag, bool ok) {
+  {
+    absl::MutexLock lock(&operations_mu_);
+    --queued_operations_;
+    ++running_operations_;
+    ok = ok && !draining_;
+  }
+  tag->Proceed(ok);
+  absl::MutexLock lock(&operations_mu_);
+  --running_operations_;
+}
+
+void GrpcServerLauncher::ShutdownAsyncServices() {
+  if (completion_queues_.empty()) {
+    return;
+  }
+
+  // Operations which are already running may still start new operations, so
+  // wait for them before shutting down the completion queues. Every operation
+  // run from now on only releases its tag.
+  {
+    absl::MutexLock lock(&operations_mu_);
+    draining_ = true;
+    operations_mu_.Await(absl::Condition(
+        +[](size_t *running) { return *running == 0; }, &running_operations_));
+  }
+
+  for (auto &cq : completion_queues_) {
+    cq->Shutdown();
+  }
+  for (auto &poller : pollers_) {
+    poller.Join();
+  }
+  pollers_.clear();
+  executor_->Shutdown();
+}
+
 }  // namespace asylo
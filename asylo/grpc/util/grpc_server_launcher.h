@@ -19,13 +19,19 @@
 #ifndef ASYLO_GRPC_UTIL_GRPC_SERVER_LAUNCHER_H_
 #define ASYLO_GRPC_UTIL_GRPC_SERVER_LAUNCHER_H_
 
+#include <cstddef>
 #include <memory>
 #include <string>
 #include <vector>
 
+#include "absl/base/thread_annotations.h"
 #include "absl/strings/str_cat.h"
 #include "absl/synchronization/mutex.h"
+#include "asylo/grpc/util/async_service.h"
+#include "asylo/platform/posix/threading/work_stealing_executor.h"
 #include "asylo/util/status.h"
+#include "asylo/util/thread.h"
+#include "include/grpcpp/completion_queue.h"
 #include "include/grpcpp/impl/codegen/service_type.h"
 #include "include/grpcpp/security/server_credentials.h"
 #include "include/grpcpp/server.h"
@@ -76,6 +82,14 @@ namespace asylo {
 //  destroyed. Keeping the server running while the launcher is being destroyed
 //  may lead to unexpected/undesired behavior.
 //
+//  Services registered with RegisterAsyncService() are served from completion
+//  queues owned by the launcher instead of gRPC's synchronous thread pool. Each
+//  completion queue is polled by a dedicated thread, which hands completed
+//  operations to a fixed set of executor threads. A synchronous server keeps a
+//  thread, and inside an enclave a TCS, waiting on every call in flight; an
+//  asynchronous one only occupies the polling and executor threads, however
+//  many calls are in flight. See AsyncOptions and async_service.h.
+//
 //  This class is thread-safe. The various methods of this class can be called
 //  from different threads without leaving the class in an internally
 //  inconsistent state. However, if callers do not follow the basic sanity
@@ -85,12 +99,39 @@ class GrpcServerLauncher {
  public:
   enum class State { NOT_LAUNCHED, LAUNCHED, TERMINATED };
 
+  // Configuration of the threads serving asynchronous services.
+  struct AsyncOptions {
+    // Number of completion queues. Each is polled by its own thread.
+    size_t num_completion_queues = 1;
+
+    // Number of threads running AsyncCallTag::Proceed(). This bounds the
+    // number of calls handled at the same time, but not the number of calls in
+    // flight.
+    size_t num_executor_threads = 4;
+
+    // Maximum number of completed operations waiting for an executor thread.
+    // The polling threads stop taking operations off their completion queues
+    // while the limit is reached.
+    size_t max_queued_operations = 256;
+  };
+
   GrpcServerLauncher(std::string name)
-      : name_{std::move(name)}, state_{State::NOT_LAUNCHED} {}
+      : GrpcServerLauncher(std::move(name), AsyncOptions()) {}
+
+  // Creates a launcher which serves asynchronous services as configured by
+  // |async_options|.
+  GrpcServerLauncher(std::string name, AsyncOptions async_options)
+      : name_{std::move(name)},
+        state_{State::NOT_LAUNCHED},
+        async_options_{async_options} {}
 
   // Registers a gRPC service with the server. Takes ownership of |service|.
   Status RegisterService(std::unique_ptr<::grpc::Service> service);
 
+  // Registers an asynchronous gRPC service with the server. Takes ownership of
+  // |handler|.
+  Status RegisterAsyncService(std::unique_ptr<AsyncServiceHandler> handler);
+
   // Adds a listening port and associated credentials to the server. If
   // |selected_port| is not nullptr, then populates this value with the port
   // used once the server is started (i.e. via a call to Start()). The value of
@@ -102,13 +143,16 @@ class GrpcServerLauncher {
                           std::shared_ptr<::grpc::ServerCredentials> creds,
                           int *selected_port = nullptr);
 
-  // Starts the gRPC server.
+  // Starts the gRPC server. Fails with INVALID_ARGUMENT if asynchronous
+  // services are registered and the AsyncOptions of the launcher ask for no
+  // completion queue, executor thread, or queued operation.
   Status Start();
 
   // Waits for server to shut down.
   Status Wait() const;
 
-  // Shuts down the server started by this object.
+  // Shuts down the server started by this object. Also stops the threads
+  // serving asynchronous services once their pending operations are released.
   Status Shutdown();
 
   // Returns the current state of this object. The method is thread-safe,
@@ -124,15 +168,54 @@ class GrpcServerLauncher {
     return Status(code, absl::StrCat("Server ", name_, ": ", message));
   }
 
+  // Takes completed operations off |cq| and hands them to |executor_| until
+  // |cq| is shut down and drained.
+  void PollCompletionQueue(::grpc::ServerCompletionQueue *cq)
+      ABSL_LOCKS_EXCLUDED(operations_mu_);
+
+  // Returns whether a polling thread may hand another operation to
+  // |executor_|.
+  bool CanQueueOperation() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(operations_mu_);
+
+  // Advances |tag| after its operation completed with |ok|.
+  void RunOperation(AsyncCallTag *tag, bool ok)
+      ABSL_LOCKS_EXCLUDED(operations_mu_);
+
+  // Stops the threads serving asynchronous services. Must be called after the
+  // server has been shut down.
+  void ShutdownAsyncServices() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_)
+      ABSL_LOCKS_EXCLUDED(operations_mu_);
+
   // Identifier for the server which is used for logging and debugging purposes.
   std::string name_;
 
-  // Mutex to protect server_, state_, services_, and builder_.
+  // Mutex to protect server_, state_, services_, and builder_, as well as the
+  // members used for asynchronous services.
   mutable absl::Mutex mu_;
   State state_;
   std::vector<std::unique_ptr<::grpc::Service>> services_;
   std::unique_ptr<::grpc::Server> server_;
   ::grpc::ServerBuilder builder_;
+
+  const AsyncOptions async_options_;
+  std::vector<std::unique_ptr<AsyncServiceHandler>> async_services_;
+  std::vector<std::unique_ptr<::grpc::ServerCompletionQueue>>
+      completion_queues_;
+  std::vector<Thread> pollers_;
+  std::unique_ptr<WorkStealingExecutor> executor_;
+
+  // Protects the accounting of operations handed to |executor_|.
+  absl::Mutex operations_mu_;
+
+  // Number of operations handed to |executor_| which have not started running.
+  size_t queued_operations_ ABSL_GUARDED_BY(operations_mu_) = 0;
+
+  // Number of operations being run by |executor_|.
+  size_t running_operations_ ABSL_GUARDED_BY(operations_mu_) = 0;
+
+  // Whether operations are run with |ok| set to false because the launcher is
+  // shutting down.
+  bool draining_ ABSL_GUARDED_BY(operations_mu_) = false;
 };
 
 }  // namespace asylo
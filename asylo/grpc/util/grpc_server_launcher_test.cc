@@ -19,12 +19,14 @@
 #include "asylo/grpc/util/grpc_server_launcher.h"
 
 #include <thread>
+#include <vector>
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
 #include "absl/time/time.h"
+#include "asylo/grpc/util/async_service.h"
 #include "asylo/test/grpc/messenger_client_impl.h"
 #include "asylo/test/grpc/messenger_server_impl.h"
 #include "asylo/test/util/status_matchers.h"
@@ -72,6 +74,43 @@ class AsyncDelayedShutdownInvoker {
   std::thread thread_;
 };
 
+// Number of executor threads of the launchers under test.
+constexpr size_t kNumExecutorThreads = 2;
+
+// Serves Messenger1 asynchronously, with the responses of
+// test::MessengerServer1.
+class AsyncMessengerServer1 : public AsyncServiceHandler {
+ public:
+  ::grpc::Service *service() override { return &service_; }
+
+  void RequestCalls(::grpc::ServerCompletionQueue *cq) override {
+    ServeAsyncUnaryCalls(
+        &service_, &test::Messenger1::AsyncService::RequestHello,
+        [](::grpc::ServerContext *context, const test::HelloRequest *request,
+           test::HelloResponse *response) {
+          if (request->name().empty()) {
+            return ::grpc::Status(::grpc::StatusCode::INVALID_ARGUMENT,
+                                  "Name cannot be empty");
+          }
+          response->set_message(
+              test::MessengerServer1::ResponseString(request->name()));
+          return ::grpc::Status::OK;
+        },
+        cq);
+  }
+
+ private:
+  test::Messenger1::AsyncService service_;
+};
+
+GrpcServerLauncher::AsyncOptions TestAsyncOptions() {
+  GrpcServerLauncher::AsyncOptions options;
+  options.num_completion_queues = 2;
+  options.num_executor_threads = kNumExecutorThreads;
+  options.max_queued_operations = 4;
+  return options;
+}
+
 // A test fixture is used to provide a common set of methods that communicate
 // through test-fixture member variables.
 class GrpcServerLauncherTest : public ::testing::Test {
@@ -79,7 +118,8 @@ class GrpcServerLauncherTest : public ::testing::Test {
   GrpcServerLauncherTest()
       : launcher_(::testing::UnitTest::GetInstance()
                       ->current_test_info()
-                      ->test_case_name()),
+                      ->test_case_name(),
+                  TestAsyncOptions()),
         server_address_(absl::StrCat(kLocalhostAddress, ":", 0)) {}
 
   ~GrpcServerLauncherTest() override {
@@ -89,10 +129,16 @@ class GrpcServerLauncherTest : public ::testing::Test {
 
   // Registers Messenger1 and Messenger2 services with launcher_, adds a free
   // localhost listening port to the launcher, and launches the server. Stores
-  // the final server address in server_address_.
-  Status LaunchServer() {
-    ASYLO_RETURN_IF_ERROR(
-        launcher_.RegisterService(absl::make_unique<test::MessengerServer1>()));
+  // the final server address in server_address_. If |async_messenger1| is
+  // true, then Messenger1 is served asynchronously.
+  Status LaunchServer(bool async_messenger1 = false) {
+    if (async_messenger1) {
+      ASYLO_RETURN_IF_ERROR(launcher_.RegisterAsyncService(
+          absl::make_unique<AsyncMessengerServer1>()));
+    } else {
+      ASYLO_RETURN_IF_ERROR(launcher_.RegisterService(
+          absl::make_unique<test::MessengerServer1>()));
+    }
     ASYLO_RETURN_IF_ERROR(
         launcher_.RegisterService(absl::make_unique<test::MessengerServer2>()));
 
@@ -233,5 +279,62 @@ TEST_F(GrpcServerLauncherTest, LaunchAfterShutdown) {
   EXPECT_THAT(launcher_.Start(), Not(IsOk()));
 }
 
+// Verifies that asynchronous and synchronous services can be hosted by the
+// same server.
+TEST_F(GrpcServerLauncherTest, AsyncServiceSanityTest) {
+  ASSERT_THAT(LaunchServer(/*async_messenger1=*/true), IsOk());
+  ASSERT_TRUE(ConnectChannel());
+
+  EXPECT_THAT(CallServices(), IsOk());
+  test::MessengerClient1 messenger_client1(channel_);
+  EXPECT_THAT(messenger_client1.Hello(""), Not(IsOk()));
+
+  AsyncDelayedShutdownInvoker shutdown_invoker(&launcher_);
+  EXPECT_THAT(launcher_.Wait(), IsOk());
+  ASSERT_EQ(launcher_.GetState(), GrpcServerLauncher::State::TERMINATED);
+}
+
+// Verifies that an asynchronous service handles more concurrent calls than
+// the launcher has executor threads.
+TEST_F(GrpcServerLauncherTest, AsyncServiceConcurrentCalls) {
+  ASSERT_THAT(LaunchServer(/*async_messenger1=*/true), IsOk());
+  ASSERT_TRUE(ConnectChannel());
+
+  constexpr int kNumClients = 8 * kNumExecutorThreads;
+  constexpr int kCallsPerClient = 10;
+  std::vector<std::thread> clients;
+  for (int i = 0; i < kNumClients; ++i) {
+    clients.emplace_back([this, i] {
+      test::MessengerClient1 messenger_client1(channel_);
+      std::string name = absl::StrCat(kMessengerClientName, i);
+      for (int j = 0; j < kCallsPerClient; ++j) {
+        auto response_result = messenger_client1.Hello(name);
+        ASSERT_THAT(response_result, IsOk());
+        EXPECT_EQ(response_result.ValueOrDie(),
+                  test::MessengerServer1::ResponseString(name));
+      }
+    });
+  }
+  for (auto &client : clients) {
+    client.join();
+  }
+
+  EXPECT_THAT(launcher_.Shutdown(), IsOk());
+}
+
+// Verifies that a server with asynchronous services does not start without a
+// completion queue.
+TEST_F(GrpcServerLauncherTest, AsyncServiceWithoutCompletionQueue) {
+  GrpcServerLauncher::AsyncOptions options = TestAsyncOptions();
+  options.num_completion_queues = 0;
+  GrpcServerLauncher launcher("AsyncServiceWithoutCompletionQueue", options);
+  ASSERT_THAT(launcher.RegisterAsyncService(
+                  absl::make_unique<AsyncMessengerServer1>()),
+              IsOk());
+  EXPECT_THAT(launcher.Start(),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+  EXPECT_EQ(launcher.GetState(), GrpcServerLauncher::State::NOT_LAUNCHED);
+}
+
 }  // namespace
 }  // namespace asylo
@@ -0,0 +1,72 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/identity/attestation/attestation_timing.h"
+
+#include <atomic>
+
+namespace asylo {
+namespace {
+
+std::atomic<AttestationTimingSink *> &InstalledSink() {
+  static std::atomic<AttestationTimingSink *> sink(nullptr);
+  return sink;
+}
+
+}  // namespace
+
+absl::string_view AttestationPhaseName(AttestationPhase phase) {
+  switch (phase) {
+    case AttestationPhase::kEreport:
+      return "ereport";
+    case AttestationPhase::kQeCall:
+      return "qe_call";
+    case AttestationPhase::kPcsFetch:
+      return "pcs_fetch";
+    case AttestationPhase::kChainVerify:
+      return "chain_verify";
+    case AttestationPhase::kAclEvaluation:
+      return "acl_evaluation";
+    case AttestationPhase::kAgeRpc:
+      return "age_rpc";
+  }
+  return "unknown";
+}
+
+AttestationTimingSink *SetAttestationTimingSink(AttestationTimingSink *sink) {
+  return InstalledSink().exchange(sink);
+}
+
+AttestationTimingSink *GetAttestationTimingSink() {
+  return InstalledSink().load();
+}
+
+ScopedAttestationTimer::ScopedAttestationTimer(
+    absl::string_view authority_type, AttestationPhase phase)
+    : sink_(GetAttestationTimingSink()),
+      authority_type_(authority_type),
+      phase_(phase),
+      start_(sink_ == nullptr ? absl::InfinitePast() : absl::Now()) {}
+
+ScopedAttestationTimer::~ScopedAttestationTimer() {
+  if (sink_ != nullptr) {
+    sink_->Record(authority_type_, phase_, absl::Now() - start_);
+  }
+}
+
+}  // namespace asylo
@@ -0,0 +1,107 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_IDENTITY_ATTESTATION_ATTESTATION_TIMING_H_
+#define ASYLO_IDENTITY_ATTESTATION_ATTESTATION_TIMING_H_
+
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+
+namespace asylo {
+
+/// The phases of assertion generation and verification whose latency is
+/// reported to the installed `AttestationTimingSink`.
+enum class AttestationPhase {
+  /// Generating a hardware REPORT with EREPORT.
+  kEreport,
+  /// Obtaining a quote from a quoting enclave.
+  kQeCall,
+  /// Fetching collateral from the Intel Provisioning Certification Service.
+  kPcsFetch,
+  /// Verifying a certificate chain.
+  kChainVerify,
+  /// Evaluating an access-control expectation against an identity.
+  kAclEvaluation,
+  /// Calling the Assertion Generator Enclave over RPC.
+  kAgeRpc,
+};
+
+/// Returns a short, stable name for `phase`, suitable for use as a metric
+/// label.
+///
+/// \param phase An attestation phase.
+/// \return The name of `phase`.
+absl::string_view AttestationPhaseName(AttestationPhase phase);
+
+/// Receives the latency of each attestation phase timed by a
+/// `ScopedAttestationTimer`.
+///
+/// Implementations must be thread-safe, since timings are recorded from every
+/// thread that generates or verifies assertions.
+class AttestationTimingSink {
+ public:
+  virtual ~AttestationTimingSink() = default;
+
+  /// Records that `phase` took `duration` on behalf of the assertion authority
+  /// with type `authority_type`.
+  ///
+  /// \param authority_type The type of the authority that ran the phase.
+  /// \param phase The phase that was timed.
+  /// \param duration The time the phase took, including failed attempts.
+  virtual void Record(absl::string_view authority_type, AttestationPhase phase,
+                      absl::Duration duration) = 0;
+};
+
+/// Installs `sink` as the process-wide destination of attestation timings.
+/// Passing nullptr disables timing, which is the initial state. The caller
+/// retains ownership of `sink`, which must outlive its installation.
+///
+/// \param sink The sink to install, or nullptr.
+/// \return The previously-installed sink, or nullptr if there was none.
+AttestationTimingSink *SetAttestationTimingSink(AttestationTimingSink *sink);
+
+/// Returns the currently-installed sink, or nullptr if there is none.
+AttestationTimingSink *GetAttestationTimingSink();
+
+/// Times the scope in which it lives and reports the elapsed time to the
+/// installed `AttestationTimingSink` on destruction. If no sink is installed
+/// when the timer is created, the timer does not read the clock.
+///
+/// `authority_type` must outlive the timer. It is typically a string constant
+/// such as `sgx::kSgxLocalAssertionAuthority`.
+class ScopedAttestationTimer {
+ public:
+  ScopedAttestationTimer(absl::string_view authority_type,
+                         AttestationPhase phase);
+
+  ScopedAttestationTimer(const ScopedAttestationTimer &other) = delete;
+  ScopedAttestationTimer &operator=(const ScopedAttestationTimer &other) =
+      delete;
+
+  ~ScopedAttestationTimer();
+
+ private:
+  AttestationTimingSink *const sink_;
+  const absl::string_view authority_type_;
+  const AttestationPhase phase_;
+  const absl::Time start_;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_IDENTITY_ATTESTATION_ATTESTATION_TIMING_H_
@@ -0,0 +1,105 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/identity/attestation/attestation_timing.h"
+
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+
+namespace asylo {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::IsEmpty;
+using ::testing::IsNull;
+
+// An AttestationTimingSink that records the authority type and phase name of
+// every timing it receives.
+class RecordingSink : public AttestationTimingSink {
+ public:
+  void Record(absl::string_view authority_type, AttestationPhase phase,
+              absl::Duration duration) override {
+    absl::MutexLock lock(&mu_);
+    records_.push_back(
+        absl::StrCat(authority_type, "/", AttestationPhaseName(phase)));
+    EXPECT_GE(duration, absl::ZeroDuration());
+  }
+
+  std::vector<std::string> records() {
+    absl::MutexLock lock(&mu_);
+    return records_;
+  }
+
+ private:
+  absl::Mutex mu_;
+  std::vector<std::string> records_ ABSL_GUARDED_BY(mu_);
+};
+
+class AttestationTimingTest : public ::testing::Test {
+ protected:
+  void TearDown() override { SetAttestationTimingSink(nullptr); }
+
+  RecordingSink sink_;
+};
+
+TEST_F(AttestationTimingTest, TimersReportToTheInstalledSink) {
+  EXPECT_THAT(SetAttestationTimingSink(&sink_), IsNull());
+  {
+    ScopedAttestationTimer timer("Authority", AttestationPhase::kQeCall);
+  }
+  {
+    ScopedAttestationTimer timer("Authority", AttestationPhase::kChainVerify);
+  }
+  EXPECT_THAT(sink_.records(),
+              ElementsAre("Authority/qe_call", "Authority/chain_verify"));
+}
+
+TEST_F(AttestationTimingTest, TimersCreatedWithoutASinkReportNothing) {
+  {
+    ScopedAttestationTimer timer("Authority", AttestationPhase::kEreport);
+    SetAttestationTimingSink(&sink_);
+  }
+  EXPECT_THAT(sink_.records(), IsEmpty());
+}
+
+TEST_F(AttestationTimingTest, SetReturnsThePreviousSink) {
+  RecordingSink other;
+  SetAttestationTimingSink(&sink_);
+  EXPECT_THAT(SetAttestationTimingSink(&other), Eq(&sink_));
+  EXPECT_THAT(GetAttestationTimingSink(), Eq(&other));
+}
+
+TEST_F(AttestationTimingTest, PhaseNamesAreDistinct) {
+  EXPECT_THAT(AttestationPhaseName(AttestationPhase::kEreport), Eq("ereport"));
+  EXPECT_THAT(AttestationPhaseName(AttestationPhase::kPcsFetch),
+              Eq("pcs_fetch"));
+  EXPECT_THAT(AttestationPhaseName(AttestationPhase::kAclEvaluation),
+              Eq("acl_evaluation"));
+  EXPECT_THAT(AttestationPhaseName(AttestationPhase::kAgeRpc), Eq("age_rpc"));
+}
+
+}  // namespace
+}  // namespace asylo
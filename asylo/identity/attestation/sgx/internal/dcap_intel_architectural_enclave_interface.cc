@@ -18,6 +18,8 @@
 
 #include "asylo/identity/attestation/sgx/internal/dcap_intel_architectural_enclave_interface.h"
 
+#include <cstdint>
+#include <limits>
 #include <memory>
 #include <type_traits>
 #include <vector>
@@ -333,5 +335,40 @@ DcapIntelArchitecturalEnclaveInterface::GetQeQuote(const Report &report) {
   return quote;
 }
 
+StatusOr<std::vector<std::vector<uint8_t>>>
+DcapIntelArchitecturalEnclaveInterface::GetQeQuotes(
+    absl::Span<const Report> reports) {
+  std::vector<std::vector<uint8_t>> quotes;
+  if (reports.empty()) {
+    return quotes;
+  }
+  if (reports.size() > std::numeric_limits<uint32_t>::max()) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  absl::StrCat("Cannot quote more than ",
+                               std::numeric_limits<uint32_t>::max(),
+                               " reports at once"));
+  }
+
+  uint32_t quote_size;
+  quote3_error_t result = dcap_library_->QeGetQuoteSize(&quote_size);
+  if (result != SGX_QL_SUCCESS) {
+    return Quote3ErrorToStatus(result);
+  }
+
+  std::vector<uint8_t> buffer(reports.size() * quote_size);
+  result = dcap_library_->QeGetQuotes(
+      CheckedPointerCast<const sgx_report_t *>(reports.data()),
+      static_cast<uint32_t>(reports.size()), quote_size, buffer.data());
+  if (result != SGX_QL_SUCCESS) {
+    return Quote3ErrorToStatus(result);
+  }
+
+  quotes.reserve(reports.size());
+  for (auto it = buffer.cbegin(); it != buffer.cend(); it += quote_size) {
+    quotes.emplace_back(it, it + quote_size);
+  }
+  return quotes;
+}
+
 }  // namespace sgx
 }  // namespace asylo
@@ -74,6 +74,9 @@ class DcapIntelArchitecturalEnclaveInterface
 
   StatusOr<std::vector<uint8_t>> GetQeQuote(const Report &report) override;
 
+  StatusOr<std::vector<std::vector<uint8_t>>> GetQeQuotes(
+      absl::Span<const Report> reports) override;
+
  private:
   std::unique_ptr<DcapLibraryInterface> dcap_library_;
 };
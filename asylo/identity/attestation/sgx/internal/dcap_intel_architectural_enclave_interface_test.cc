@@ -66,13 +66,16 @@ namespace {
 using ::testing::HasSubstr;
 using ::testing::_;
 using ::testing::DoAll;
+using ::testing::ElementsAreArray;
 using ::testing::Eq;
+using ::testing::IsEmpty;
 using ::testing::Not;
 using ::testing::NotNull;
 using ::testing::Pointee;
 using ::testing::PrintToString;
 using ::testing::Return;
 using ::testing::SetArgPointee;
+using ::testing::SizeIs;
 using ::testing::Test;
 
 class MockDcapLibraryInterface : public DcapLibraryInterface {
@@ -104,6 +107,10 @@ class MockDcapLibraryInterface : public DcapLibraryInterface {
               (const sgx_report_t *p_app_report, uint32_t quote_size,
                uint8_t *p_quote),
               (const, override));
+  MOCK_METHOD(quote3_error_t, QeGetQuotes,
+              (const sgx_report_t *p_app_reports, uint32_t report_count,
+               uint32_t quote_size, uint8_t *p_quotes),
+              (const, override));
 };
 
 // Copies |buffer| into buffer pointed to by arg number |k|.
@@ -467,6 +474,51 @@ TEST_F(DcapIntelArchitecturalEnclaveInterfaceTests, GetQeQuoteFailure) {
               StatusIs(error::GoogleError::PERMISSION_DENIED));
 }
 
+TEST_F(DcapIntelArchitecturalEnclaveInterfaceTests,
+       GetQeQuotesSplitsQuotesFromASingleLibraryCall) {
+  const std::vector<Report> kReports = {TrivialRandomObject<Report>(),
+                                        TrivialRandomObject<Report>(),
+                                        TrivialRandomObject<Report>()};
+  constexpr uint32_t kQuoteSize = 128;  // size is arbitrary
+  std::vector<uint8_t> quotes(kReports.size() * kQuoteSize);
+  std::iota(quotes.begin(), quotes.end(), 0);
+  EXPECT_CALL(*dcap_library_, QeGetQuoteSize(NotNull()))
+      .WillOnce(DoAll(SetArgPointee<0>(kQuoteSize), Return(SGX_QL_SUCCESS)));
+  EXPECT_CALL(*dcap_library_,
+              QeGetQuotes(Pointee(TrivialObjectEq(kReports[0])),
+                          kReports.size(), kQuoteSize, NotNull()))
+      .WillOnce(DoAll(SetArgContainer<3>(quotes), Return(SGX_QL_SUCCESS)));
+  EXPECT_CALL(*dcap_library_, QeGetQuote).Times(0);
+
+  std::vector<std::vector<uint8_t>> result;
+  ASYLO_ASSERT_OK_AND_ASSIGN(result, dcap_.GetQeQuotes(kReports));
+  ASSERT_THAT(result, SizeIs(kReports.size()));
+  for (size_t i = 0; i < kReports.size(); ++i) {
+    auto quote_begin = quotes.begin() + i * kQuoteSize;
+    EXPECT_THAT(result[i],
+                ElementsAreArray(quote_begin, quote_begin + kQuoteSize));
+  }
+}
+
+TEST_F(DcapIntelArchitecturalEnclaveInterfaceTests,
+       GetQeQuotesOfNoReportsDoesNotCallLibrary) {
+  EXPECT_CALL(*dcap_library_, QeGetQuoteSize).Times(0);
+  EXPECT_CALL(*dcap_library_, QeGetQuotes).Times(0);
+  EXPECT_THAT(dcap_.GetQeQuotes({}), IsOkAndHolds(IsEmpty()));
+}
+
+TEST_F(DcapIntelArchitecturalEnclaveInterfaceTests, GetQeQuotesFailure) {
+  constexpr uint32_t kFakeQuoteSize = 32;  // size is arbitrary
+  EXPECT_CALL(*dcap_library_, QeGetQuoteSize(NotNull()))
+      .WillOnce(
+          DoAll(SetArgPointee<0>(kFakeQuoteSize), Return(SGX_QL_SUCCESS)));
+  EXPECT_CALL(*dcap_library_, QeGetQuotes(NotNull(), 2, kFakeQuoteSize,
+                                          NotNull()))
+      .WillOnce(Return(SGX_QL_ERROR_INVALID_PRIVILEGE));
+  EXPECT_THAT(dcap_.GetQeQuotes(std::vector<Report>(2)),
+              StatusIs(error::GoogleError::PERMISSION_DENIED));
+}
+
 }  // namespace
 }  // namespace sgx
 }  // namespace asylo
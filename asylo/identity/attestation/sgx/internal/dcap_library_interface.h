@@ -81,6 +81,15 @@ class DcapLibraryInterface {
   virtual quote3_error_t QeGetQuote(const sgx_report_t *p_app_report,
                                     uint32_t quote_size,
                                     uint8_t *p_quote) const = 0;
+
+  // Calls sgx_qe_get_quote for each of the |report_count| reports in
+  // |p_app_reports|, writing the i-th quote to the |quote_size| bytes at
+  // |p_quotes| + i * |quote_size|. Inside an enclave, all the quotes are
+  // generated in a single exit from the enclave. Stops at the first failure.
+  // Returns a value from the `quote3_error_t` enumeration to indicate status.
+  virtual quote3_error_t QeGetQuotes(const sgx_report_t *p_app_reports,
+                                     uint32_t report_count, uint32_t quote_size,
+                                     uint8_t *p_quotes) const = 0;
 };
 
 }  // namespace sgx
@@ -83,5 +83,12 @@ quote3_error_t EnclaveDcapLibraryInterface::QeGetQuote(
       p_app_report, quote_size, p_quote));
 }
 
+quote3_error_t EnclaveDcapLibraryInterface::QeGetQuotes(
+    const sgx_report_t *p_app_reports, uint32_t report_count,
+    uint32_t quote_size, uint8_t *p_quotes) const {
+  return static_cast<quote3_error_t>(primitives::enc_untrusted_qe_get_quotes(
+      p_app_reports, report_count, quote_size, p_quotes));
+}
+
 }  // namespace sgx
 }  // namespace asylo
@@ -129,5 +129,10 @@ StatusOr<std::vector<uint8_t>> FakePce::GetQeQuote(const Report &report) {
   return Status(error::GoogleError::UNIMPLEMENTED, "Not implemented");
 }
 
+StatusOr<std::vector<std::vector<uint8_t>>> FakePce::GetQeQuotes(
+    absl::Span<const Report> reports) {
+  return Status(error::GoogleError::UNIMPLEMENTED, "Not implemented");
+}
+
 }  // namespace sgx
 }  // namespace asylo
@@ -74,6 +74,10 @@ class FakePce : public IntelArchitecturalEnclaveInterface {
   // Not implemented
   StatusOr<std::vector<uint8_t>> GetQeQuote(const Report &report) override;
 
+  // Not implemented
+  StatusOr<std::vector<std::vector<uint8_t>>> GetQeQuotes(
+      absl::Span<const Report> reports) override;
+
  private:
   std::unique_ptr<SigningKey> pck_;
   uint16_t pce_svn_;
@@ -81,5 +81,19 @@ quote3_error_t HostDcapLibraryInterface::QeGetQuote(
   return sgx_qe_get_quote(p_app_report, quote_size, p_quote);
 }
 
+quote3_error_t HostDcapLibraryInterface::QeGetQuotes(
+    const sgx_report_t *p_app_reports, uint32_t report_count,
+    uint32_t quote_size, uint8_t *p_quotes) const {
+  for (uint32_t i = 0; i < report_count; ++i) {
+    quote3_error_t result =
+        sgx_qe_get_quote(&p_app_reports[i], quote_size,
+                         p_quotes + static_cast<size_t>(i) * quote_size);
+    if (result != SGX_QL_SUCCESS) {
+      return result;
+    }
+  }
+  return SGX_QL_SUCCESS;
+}
+
 }  // namespace sgx
 }  // namespace asylo
@@ -70,6 +70,10 @@ class HostDcapLibraryInterface : public DcapLibraryInterface {
   quote3_error_t QeGetQuote(const sgx_report_t *p_app_report,
                             uint32_t quote_size,
                             uint8_t *p_quote) const override;
+
+  quote3_error_t QeGetQuotes(const sgx_report_t *p_app_reports,
+                             uint32_t report_count, uint32_t quote_size,
+                             uint8_t *p_quotes) const override;
 };
 
 }  // namespace sgx
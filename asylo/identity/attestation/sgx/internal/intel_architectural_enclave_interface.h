@@ -115,6 +115,14 @@ class IntelArchitecturalEnclaveInterface {
   // On success, an Intel QE quote is returned which contains an Intel QE-
   // signed report over the data contained within |report|.
   virtual StatusOr<std::vector<uint8_t>> GetQeQuote(const Report &report) = 0;
+
+  // Converts each of |reports| into a quote signed by the QE, as by
+  // GetQeQuote. The quotes are generated in a single call into the DCAP
+  // library, which avoids a separate enclave exit per report. On success,
+  // returns one quote per report, in the order of |reports|. Fails if any
+  // report cannot be converted.
+  virtual StatusOr<std::vector<std::vector<uint8_t>>> GetQeQuotes(
+      absl::Span<const Report> reports) = 0;
 };
 
 }  // namespace sgx
@@ -52,6 +52,8 @@ class MockIntelArchitecturalEnclaveInterface
   MOCK_METHOD(StatusOr<Targetinfo>, GetQeTargetinfo, (), (override));
   MOCK_METHOD(StatusOr<std::vector<uint8_t>>, GetQeQuote,
               (const Report &report), (override));
+  MOCK_METHOD(StatusOr<std::vector<std::vector<uint8_t>>>, GetQeQuotes,
+              (absl::Span<const Report> reports), (override));
 };
 
 }  // namespace sgx
@@ -39,6 +39,10 @@ class MockSgxInfrastructuralEnclaveManager
       AgeGeneratePceInfoSgxHardwareReport,
       StatusOr<sgx::ReportProto>(const sgx::TargetInfoProto &,
                                  const AsymmetricEncryptionKeyProto &));
+  MOCK_METHOD1(AgeGeneratePceInfoSgxHardwareReports,
+               StatusOr<std::vector<sgx::ReportProto>>(
+                   const std::vector<sgx::GeneratePceInfoSgxHardwareReportInput>
+                       &));
   MOCK_METHOD2(AgeUpdateCerts,
                StatusOr<SealedSecret>(const std::vector<CertificateChain> &,
                                       bool));
@@ -22,6 +22,7 @@
 #include <utility>
 
 #include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
 #include "asylo/crypto/ecdsa_p256_sha256_signing_key.h"
 #include "asylo/crypto/keys.pb.h"
 #include "asylo/crypto/signing_key.h"
@@ -40,6 +41,40 @@
 
 namespace asylo {
 namespace sgx {
+namespace {
+
+// The maximum number of REPORTs generated by a single
+// GeneratePceInfoSgxHardwareReportsInput.
+constexpr int kMaxPceInfoReportBatchSize = 256;
+
+// Generates an SGX hardware REPORT for the PCE's GetPceInfo protocol with
+// |hardware|, and writes it to |report_proto|.
+Status GeneratePceInfoReport(const GeneratePceInfoSgxHardwareReportInput &input,
+                             HardwareInterface *hardware,
+                             ReportProto *report_proto) {
+  if (!input.has_pce_target_info()) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Input is missing pce_target_info");
+  }
+  if (!input.has_ppid_encryption_key()) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Input is missing ppid_encryption_key");
+  }
+  AlignedReportdataPtr reportdata;
+  ASYLO_ASSIGN_OR_RETURN(
+      *reportdata, CreateReportdataForGetPceInfo(input.ppid_encryption_key()));
+  AlignedTargetinfoPtr targetinfo;
+  ASYLO_ASSIGN_OR_RETURN(
+      *targetinfo, ConvertTargetInfoProtoToTargetinfo(input.pce_target_info()));
+
+  Report report;
+  ASYLO_ASSIGN_OR_RETURN(report, hardware->GetReport(*targetinfo, *reportdata));
+  report_proto->set_value(ConvertTrivialObjectToBinaryString(report));
+
+  return Status::OkStatus();
+}
+
+}  // namespace
 
 RemoteAssertionGeneratorEnclave::RemoteAssertionGeneratorEnclave()
     : attestation_key_certs_pair_(AttestationKeyCertsPair()),
@@ -91,6 +126,12 @@ Status RemoteAssertionGeneratorEnclave::Run(const EnclaveInput &input,
     case RemoteAssertionGeneratorEnclaveInput::kUpdateCertsInput:
       return UpdateCerts(enclave_input.update_certs_input(),
                          enclave_output->mutable_update_certs_output());
+    case RemoteAssertionGeneratorEnclaveInput::
+        kGeneratePceInfoSgxHardwareReportsInput:
+      return GeneratePceInfoSgxHardwareReports(
+          enclave_input.generate_pce_info_sgx_hardware_reports_input(),
+          enclave_output
+              ->mutable_generate_pce_info_sgx_hardware_reports_output());
     case RemoteAssertionGeneratorEnclaveInput::kGetEnclaveIdentityInput:
       SetSelfSgxIdentity(enclave_output->mutable_get_enclave_identity_output()
                              ->mutable_sgx_identity());
@@ -151,27 +192,26 @@ Status RemoteAssertionGeneratorEnclave::StartRemoteAssertionGeneratorGrpcServer(
 Status RemoteAssertionGeneratorEnclave::GeneratePceInfoSgxHardwareReport(
     const GeneratePceInfoSgxHardwareReportInput &input,
     GeneratePceInfoSgxHardwareReportOutput *output) {
-  if (!input.has_pce_target_info()) {
+  return GeneratePceInfoReport(input, HardwareInterface::CreateDefault().get(),
+                               output->mutable_report());
+}
+
+Status RemoteAssertionGeneratorEnclave::GeneratePceInfoSgxHardwareReports(
+    const GeneratePceInfoSgxHardwareReportsInput &input,
+    GeneratePceInfoSgxHardwareReportsOutput *output) {
+  if (input.inputs_size() > kMaxPceInfoReportBatchSize) {
     return Status(error::GoogleError::INVALID_ARGUMENT,
-                  "Input is missing pce_target_info");
+                  absl::StrCat("Too many report requests: ",
+                               input.inputs_size(), " (at most ",
+                               kMaxPceInfoReportBatchSize, ")"));
   }
-  if (!input.has_ppid_encryption_key()) {
-    return Status(error::GoogleError::INVALID_ARGUMENT,
-                  "Input is missing ppid_encryption_key");
+  std::unique_ptr<HardwareInterface> hardware =
+      HardwareInterface::CreateDefault();
+  for (const GeneratePceInfoSgxHardwareReportInput &report_input :
+       input.inputs()) {
+    ASYLO_RETURN_IF_ERROR(GeneratePceInfoReport(report_input, hardware.get(),
+                                                output->add_reports()));
   }
-  AlignedReportdataPtr reportdata;
-  ASYLO_ASSIGN_OR_RETURN(
-      *reportdata, CreateReportdataForGetPceInfo(input.ppid_encryption_key()));
-  AlignedTargetinfoPtr targetinfo;
-  ASYLO_ASSIGN_OR_RETURN(
-      *targetinfo, ConvertTargetInfoProtoToTargetinfo(input.pce_target_info()));
-
-  Report report;
-  ASYLO_ASSIGN_OR_RETURN(report, HardwareInterface::CreateDefault()->GetReport(
-                                     *targetinfo, *reportdata));
-  output->mutable_report()->set_value(
-      ConvertTrivialObjectToBinaryString(report));
-
   return Status::OkStatus();
 }
 
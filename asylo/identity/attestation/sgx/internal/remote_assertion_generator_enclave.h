@@ -77,6 +77,12 @@ class RemoteAssertionGeneratorEnclave final : public TrustedApplication {
       const GeneratePceInfoSgxHardwareReportInput &input,
       GeneratePceInfoSgxHardwareReportOutput *output);
 
+  // Generates an SGX hardware REPORT for each of the inputs of |input|, as
+  // GeneratePceInfoSgxHardwareReport does.
+  Status GeneratePceInfoSgxHardwareReports(
+      const GeneratePceInfoSgxHardwareReportsInput &input,
+      GeneratePceInfoSgxHardwareReportsOutput *output);
+
   // Generates a new value for |attestation_key_|. If TARGETINFO is specified in
   // |input|, this method also generates an SGX hardware REPORT that is suitable
   // for use in the PCE's SignReport protocol. This function can also be used to
@@ -32,6 +32,9 @@ namespace asylo {
 namespace sgx {
 namespace {
 
+// The maximum number of requests in a GetReports input.
+constexpr int kMaxReportBatchSize = 256;
+
 // Test enclave that generates reports given an arbitrary input report data.
 class ReportOracleEnclave : public TrustedApplication {
  public:
@@ -47,9 +50,16 @@ class ReportOracleEnclave : public TrustedApplication {
         output->MutableExtension(report_oracle_enclave_output);
 
     switch (enclave_input.input_case()) {
-      case ReportOracleEnclaveInput::kGetReport:
-        return GetReport(enclave_input.get_report(),
-                         enclave_output->mutable_get_report());
+      case ReportOracleEnclaveInput::kGetReport: {
+        std::unique_ptr<HardwareInterface> hardware =
+            HardwareInterface::CreateDefault();
+        return GetReport(
+            enclave_input.get_report(), hardware.get(),
+            enclave_output->mutable_get_report()->mutable_report());
+      }
+      case ReportOracleEnclaveInput::kGetReports:
+        return GetReports(enclave_input.get_reports(),
+                          enclave_output->mutable_get_reports());
       case ReportOracleEnclaveInput::INPUT_NOT_SET:
         break;
     }
@@ -59,8 +69,28 @@ class ReportOracleEnclave : public TrustedApplication {
         absl::StrCat("Invalid input case: ", enclave_input.input_case()));
   }
 
+  // Generates the REPORTs of all requests of |input| with a single hardware
+  // interface.
+  Status GetReports(const ReportOracleEnclaveInput::GetReports &input,
+                    ReportOracleEnclaveOutput::GetReports *output) {
+    if (input.requests_size() > kMaxReportBatchSize) {
+      return Status(error::GoogleError::INVALID_ARGUMENT,
+                    absl::StrCat("Too many report requests: ",
+                                 input.requests_size(), " (at most ",
+                                 kMaxReportBatchSize, ")"));
+    }
+    std::unique_ptr<HardwareInterface> hardware =
+        HardwareInterface::CreateDefault();
+    for (const ReportOracleEnclaveInput::GetReport &request :
+         input.requests()) {
+      ASYLO_RETURN_IF_ERROR(
+          GetReport(request, hardware.get(), output->add_reports()));
+    }
+    return Status::OkStatus();
+  }
+
   Status GetReport(const ReportOracleEnclaveInput::GetReport &input,
-                   ReportOracleEnclaveOutput::GetReport *output) {
+                   HardwareInterface *hardware, ReportProto *output) {
     AlignedTargetinfoPtr target_info;
     ASYLO_ASSIGN_OR_RETURN(
         *target_info, ConvertTargetInfoProtoToTargetinfo(input.target_info()));
@@ -78,12 +108,10 @@ class ReportOracleEnclave : public TrustedApplication {
     }
 
     Report report;
-    ASYLO_ASSIGN_OR_RETURN(
-        report, HardwareInterface::CreateDefault()->GetReport(*target_info,
-                                                              *reportdata));
+    ASYLO_ASSIGN_OR_RETURN(report,
+                           hardware->GetReport(*target_info, *reportdata));
 
-    output->mutable_report()->set_value(
-        ConvertTrivialObjectToBinaryString(report));
+    output->set_value(ConvertTrivialObjectToBinaryString(report));
 
     return Status::OkStatus();
   }
@@ -20,6 +20,7 @@
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "absl/memory/memory.h"
 #include "absl/random/distributions.h"
@@ -126,5 +127,52 @@ StatusOr<Report> ReportOracleEnclaveWrapper::GetReport(
           .report());
 }
 
+StatusOr<std::vector<Report>> ReportOracleEnclaveWrapper::GetReports(
+    const std::vector<Targetinfo> &targetinfos,
+    const std::vector<Reportdata> &reportdata) {
+  if (targetinfos.size() != reportdata.size()) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  absl::StrCat("Got ", targetinfos.size(),
+                               " TARGETINFOs for ", reportdata.size(),
+                               " REPORTDATAs"));
+  }
+
+  EnclaveInput enclave_input;
+  ReportOracleEnclaveInput_GetReports *get_reports_input =
+      enclave_input.MutableExtension(report_oracle_enclave_input)
+          ->mutable_get_reports();
+  for (size_t i = 0; i < targetinfos.size(); ++i) {
+    ReportOracleEnclaveInput_GetReport *request =
+        get_reports_input->add_requests();
+    request->mutable_target_info()->set_value(
+        ConvertTrivialObjectToBinaryString(targetinfos[i]));
+    request->set_reportdata(ConvertTrivialObjectToBinaryString(reportdata[i]));
+  }
+
+  EnclaveOutput enclave_output;
+  ASYLO_RETURN_IF_ERROR(
+      enclave_client_->EnterAndRun(enclave_input, &enclave_output));
+
+  const ReportOracleEnclaveOutput_GetReports &get_reports_output =
+      enclave_output.GetExtension(report_oracle_enclave_output).get_reports();
+  if (get_reports_output.reports_size() !=
+      static_cast<int>(targetinfos.size())) {
+    return Status(error::GoogleError::INTERNAL,
+                  absl::StrCat("Report oracle returned ",
+                               get_reports_output.reports_size(),
+                               " reports for ", targetinfos.size(),
+                               " requests"));
+  }
+  std::vector<Report> reports;
+  reports.reserve(targetinfos.size());
+  for (const ReportProto &report_proto : get_reports_output.reports()) {
+    Report report;
+    ASYLO_ASSIGN_OR_RETURN(report,
+                           ConvertReportProtoToHardwareReport(report_proto));
+    reports.push_back(report);
+  }
+  return reports;
+}
+
 }  // namespace sgx
 }  // namespace asylo
@@ -20,6 +20,7 @@
 #define ASYLO_IDENTITY_ATTESTATION_SGX_INTERNAL_REPORT_ORACLE_ENCLAVE_WRAPPER_H_
 
 #include <memory>
+#include <vector>
 
 #include "absl/strings/string_view.h"
 #include "asylo/identity/platform/sgx/internal/identity_key_management_structs.h"
@@ -56,6 +57,14 @@ class ReportOracleEnclaveWrapper {
   StatusOr<Report> GetReport(const Targetinfo &targetinfo,
                              const Reportdata &reportdata);
 
+  // Fetches a report from the oracle enclave for each pair of |targetinfos|
+  // and |reportdata| at the same index, in a single entry into the enclave.
+  // |targetinfos| and |reportdata| must have the same size, which is at most
+  // 256.
+  StatusOr<std::vector<Report>> GetReports(
+      const std::vector<Targetinfo> &targetinfos,
+      const std::vector<Reportdata> &reportdata);
+
  private:
   ReportOracleEnclaveWrapper(EnclaveManager *enclave_manager,
                              EnclaveClient *enclave_client)
@@ -20,6 +20,7 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
@@ -79,6 +80,32 @@ TEST(ReportOracleEnclaveWrapperTest, GetReport) {
   EXPECT_THAT(report.body.reportdata, TrivialObjectEq(reportdata));
 }
 
+TEST(ReportOracleEnclaveWrapperTest, GetReports) {
+  std::unique_ptr<ReportOracleEnclaveWrapper> report_oracle;
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      report_oracle,
+      ReportOracleEnclaveWrapper::LoadFromSection(kReportOracleSectionName));
+
+  std::vector<Targetinfo> targetinfos;
+  std::vector<Reportdata> reportdata;
+  for (int i = 0; i < 3; ++i) {
+    targetinfos.push_back(TrivialRandomObject<Targetinfo>());
+    reportdata.push_back(TrivialRandomObject<Reportdata>());
+  }
+  std::vector<Report> reports;
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      reports, report_oracle->GetReports(targetinfos, reportdata));
+
+  ASSERT_EQ(reports.size(), reportdata.size());
+  for (size_t i = 0; i < reports.size(); ++i) {
+    EXPECT_THAT(reports[i].body.reportdata, TrivialObjectEq(reportdata[i]));
+  }
+
+  reportdata.pop_back();
+  EXPECT_THAT(report_oracle->GetReports(targetinfos, reportdata),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+}
+
 }  // namespace
 }  // namespace sgx
 }  // namespace asylo
@@ -197,6 +197,30 @@ SgxInfrastructuralEnclaveManager::AgeGeneratePceInfoSgxHardwareReport(
       .report();
 }
 
+StatusOr<std::vector<sgx::ReportProto>>
+SgxInfrastructuralEnclaveManager::AgeGeneratePceInfoSgxHardwareReports(
+    const std::vector<sgx::GeneratePceInfoSgxHardwareReportInput> &inputs) {
+  EnclaveInput input;
+  *input.MutableExtension(sgx::remote_assertion_generator_enclave_input)
+       ->mutable_generate_pce_info_sgx_hardware_reports_input()
+       ->mutable_inputs() = {inputs.begin(), inputs.end()};
+
+  EnclaveOutput output;
+  ASYLO_RETURN_IF_ERROR(
+      assertion_generator_enclave_->EnterAndRun(input, &output));
+  ASYLO_RETURN_IF_ERROR(CheckEnclaveOutputExtension(output));
+  const sgx::GeneratePceInfoSgxHardwareReportsOutput &reports_output =
+      output.GetExtension(sgx::remote_assertion_generator_enclave_output)
+          .generate_pce_info_sgx_hardware_reports_output();
+  if (reports_output.reports_size() != static_cast<int>(inputs.size())) {
+    return Status(error::GoogleError::INTERNAL,
+                  absl::StrCat("AGE returned ", reports_output.reports_size(),
+                               " REPORTs for ", inputs.size(), " inputs"));
+  }
+  return std::vector<sgx::ReportProto>(reports_output.reports().begin(),
+                                       reports_output.reports().end());
+}
+
 StatusOr<SealedSecret> SgxInfrastructuralEnclaveManager::AgeUpdateCerts(
     const std::vector<asylo::CertificateChain> &cert_chains,
     bool validate_cert_chains) {
@@ -111,6 +111,13 @@ class SgxInfrastructuralEnclaveManager {
       const sgx::TargetInfoProto &pce_target_info,
       const asylo::AsymmetricEncryptionKeyProto &ppid_encryption_key);
 
+  // Requests the AGE to generate a hardware REPORT for the PCE's GetPceInfo
+  // protocol for each of |inputs|, in a single entry into the AGE. Returns the
+  // REPORTs in the order of |inputs|, which holds at most 256 elements.
+  virtual StatusOr<std::vector<sgx::ReportProto>>
+  AgeGeneratePceInfoSgxHardwareReports(
+      const std::vector<sgx::GeneratePceInfoSgxHardwareReportInput> &inputs);
+
   // Updates the AGE's attestation key certificates to the provided
   // |cert_chains|. On success, returns a sealed secret containing the AGE's
   // attestation key and associated certificates.
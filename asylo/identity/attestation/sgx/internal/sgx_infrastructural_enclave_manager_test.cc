@@ -264,6 +264,49 @@ TEST_F(SgxInfrastructuralEnclaveManagerTest,
                kInputMissingPpidEncryptionKeyErrorMessage));
 }
 
+TEST_F(SgxInfrastructuralEnclaveManagerTest,
+       AgeGeneratePceInfoSgxHardwareReportsSuccess) {
+  EnclaveOutput expected_enclave_output;
+  sgx::GeneratePceInfoSgxHardwareReportsOutput *reports_output =
+      expected_enclave_output
+          .MutableExtension(sgx::remote_assertion_generator_enclave_output)
+          ->mutable_generate_pce_info_sgx_hardware_reports_output();
+  *reports_output->add_reports() = Report();
+  *reports_output->add_reports() = Report();
+  EXPECT_CALL(*mock_assertion_generator_enclave_, EnterAndRun)
+      .WillOnce(DoAll(SetArgPointee<1>(expected_enclave_output),
+                      Return(Status::OkStatus())));
+
+  std::vector<sgx::GeneratePceInfoSgxHardwareReportInput> inputs(2);
+  for (sgx::GeneratePceInfoSgxHardwareReportInput &input : inputs) {
+    *input.mutable_ppid_encryption_key() = Ppidek();
+  }
+  std::vector<sgx::ReportProto> reports;
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      reports, sgx_infrastructural_enclave_manager_
+                   ->AgeGeneratePceInfoSgxHardwareReports(inputs));
+  ASSERT_THAT(reports.size(), Eq(2));
+  EXPECT_THAT(reports[0], EqualsProto(reports_output->reports(0)));
+  EXPECT_THAT(reports[1], EqualsProto(reports_output->reports(1)));
+}
+
+TEST_F(SgxInfrastructuralEnclaveManagerTest,
+       AgeGeneratePceInfoSgxHardwareReportsFailsOnMissingReports) {
+  EnclaveOutput expected_enclave_output;
+  *expected_enclave_output
+       .MutableExtension(sgx::remote_assertion_generator_enclave_output)
+       ->mutable_generate_pce_info_sgx_hardware_reports_output()
+       ->add_reports() = Report();
+  EXPECT_CALL(*mock_assertion_generator_enclave_, EnterAndRun)
+      .WillOnce(DoAll(SetArgPointee<1>(expected_enclave_output),
+                      Return(Status::OkStatus())));
+
+  std::vector<sgx::GeneratePceInfoSgxHardwareReportInput> inputs(2);
+  EXPECT_THAT(sgx_infrastructural_enclave_manager_
+                  ->AgeGeneratePceInfoSgxHardwareReports(inputs),
+              StatusIs(error::GoogleError::INTERNAL));
+}
+
 TEST_F(SgxInfrastructuralEnclaveManagerTest, AgeUpdateCertsSuccess) {
   EnclaveOutput expected_enclave_output;
   SealedSecret expected_sealed_secret = GetSealedSecret();
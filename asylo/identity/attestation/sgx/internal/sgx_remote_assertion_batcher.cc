@@ -0,0 +1,118 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/identity/attestation/sgx/internal/sgx_remote_assertion_batcher.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "asylo/util/logging.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+
+SgxRemoteAssertionBatcher::SgxRemoteAssertionBatcher(
+    ClientFactory client_factory, int max_batch_size)
+    : client_factory_(std::move(client_factory)),
+      max_batch_size_(max_batch_size) {}
+
+StatusOr<sgx::RemoteAssertion>
+SgxRemoteAssertionBatcher::GenerateSgxRemoteAssertion(
+    ByteContainerView user_data) {
+  PendingRequest request;
+  request.user_data.assign(reinterpret_cast<const char *>(user_data.data()),
+                           user_data.size());
+  state_.Lock()->queue.push_back(&request);
+
+  while (true) {
+    std::vector<PendingRequest *> batch;
+    {
+      auto state = state_.Lock();
+      state.Await([&request](const State &state) {
+        return request.done || !state.batch_in_flight;
+      });
+      if (request.done) {
+        return std::move(request.result);
+      }
+
+      // No batch is in flight, so this thread sends the oldest requests, which
+      // may or may not include its own.
+      size_t batch_size = std::min(state->queue.size(), max_batch_size_);
+      batch.assign(state->queue.begin(), state->queue.begin() + batch_size);
+      state->queue.erase(state->queue.begin(),
+                         state->queue.begin() + batch_size);
+      state->batch_in_flight = true;
+    }
+
+    std::vector<StatusOr<sgx::RemoteAssertion>> results = SendBatch(batch);
+
+    auto state = state_.Lock();
+    for (size_t i = 0; i < batch.size(); ++i) {
+      batch[i]->result = std::move(results[i]);
+      batch[i]->done = true;
+    }
+    state->batch_in_flight = false;
+  }
+}
+
+std::vector<StatusOr<sgx::RemoteAssertion>>
+SgxRemoteAssertionBatcher::SendBatch(
+    const std::vector<PendingRequest *> &batch) {
+  if (client_ == nullptr) {
+    StatusOr<std::unique_ptr<SgxRemoteAssertionGeneratorClient>>
+        client_result = client_factory_();
+    if (!client_result.ok()) {
+      return std::vector<StatusOr<sgx::RemoteAssertion>>(
+          batch.size(), client_result.status());
+    }
+    client_ = std::move(client_result).ValueOrDie();
+  }
+
+  std::vector<StatusOr<sgx::RemoteAssertion>> results;
+  results.reserve(batch.size());
+  if (batch.size() > 1 && !batch_rpc_unimplemented_) {
+    std::vector<std::string> user_data;
+    user_data.reserve(batch.size());
+    for (const PendingRequest *request : batch) {
+      user_data.push_back(request->user_data);
+    }
+    StatusOr<std::vector<sgx::RemoteAssertion>> assertions_result =
+        client_->GenerateSgxRemoteAssertions(user_data);
+    if (assertions_result.ok()) {
+      for (sgx::RemoteAssertion &assertion : assertions_result.ValueOrDie()) {
+        results.emplace_back(std::move(assertion));
+      }
+      return results;
+    }
+    if (assertions_result.status().CanonicalCode() !=
+        error::GoogleError::UNIMPLEMENTED) {
+      return std::vector<StatusOr<sgx::RemoteAssertion>>(
+          batch.size(), assertions_result.status());
+    }
+    LOG(WARNING) << "Assertion Generator Enclave does not support batched "
+                    "requests, falling back to individual requests";
+    batch_rpc_unimplemented_ = true;
+  }
+
+  for (const PendingRequest *request : batch) {
+    results.push_back(client_->GenerateSgxRemoteAssertion(request->user_data));
+  }
+  return results;
+}
+
+}  // namespace asylo
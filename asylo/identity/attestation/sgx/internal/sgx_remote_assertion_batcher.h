@@ -0,0 +1,115 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_IDENTITY_ATTESTATION_SGX_INTERNAL_SGX_REMOTE_ASSERTION_BATCHER_H_
+#define ASYLO_IDENTITY_ATTESTATION_SGX_INTERNAL_SGX_REMOTE_ASSERTION_BATCHER_H_
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "asylo/crypto/util/byte_container_view.h"
+#include "asylo/identity/attestation/sgx/internal/remote_assertion.pb.h"
+#include "asylo/identity/attestation/sgx/internal/sgx_remote_assertion_generator_client.h"
+#include "asylo/util/mutex_guarded.h"
+#include "asylo/util/statusor.h"
+
+namespace asylo {
+
+// A thread-safe wrapper around an SgxRemoteAssertionGeneratorClient that
+// coalesces concurrent assertion requests into GenerateSgxRemoteAssertions
+// RPCs.
+//
+// A request made while no RPC is in flight is sent immediately. Requests made
+// while an RPC is in flight are queued, and the first of them to be woken when
+// the RPC completes sends up to |max_batch_size| queued requests in a single
+// RPC on behalf of all their callers. Under light load this costs no extra
+// latency, while under heavy load the number of RPCs to the Assertion
+// Generator Enclave grows with the number of batches rather than with the
+// number of requests.
+//
+// If the server does not implement GenerateSgxRemoteAssertions, the batcher
+// falls back to one GenerateSgxRemoteAssertion RPC per request.
+class SgxRemoteAssertionBatcher {
+ public:
+  // A factory for the client used to talk to the Assertion Generator Enclave.
+  using ClientFactory = std::function<
+      StatusOr<std::unique_ptr<SgxRemoteAssertionGeneratorClient>>()>;
+
+  // Creates a batcher that sends batches of at most |max_batch_size| requests
+  // through a client created by |client_factory|. The client is created when
+  // the first batch is sent, and again for the next batch if creating it
+  // fails. |max_batch_size| must be between 1 and
+  // kMaxSgxRemoteAssertionBatchSize.
+  SgxRemoteAssertionBatcher(ClientFactory client_factory, int max_batch_size);
+
+  SgxRemoteAssertionBatcher(const SgxRemoteAssertionBatcher &other) = delete;
+  SgxRemoteAssertionBatcher &operator=(const SgxRemoteAssertionBatcher &other) =
+      delete;
+
+  // Requests an SGX remote assertion that is bound to |user_data|, possibly
+  // together with the requests of other threads. Blocks until the assertion
+  // is available.
+  StatusOr<sgx::RemoteAssertion> GenerateSgxRemoteAssertion(
+      ByteContainerView user_data);
+
+ private:
+  // A request waiting for its assertion.
+  struct PendingRequest {
+    std::string user_data;
+
+    // Whether |result| holds the outcome of the request.
+    bool done = false;
+
+    StatusOr<sgx::RemoteAssertion> result;
+  };
+
+  // State shared between the threads making requests.
+  struct State {
+    // Requests that have not yet been sent, in arrival order.
+    std::deque<PendingRequest *> queue;
+
+    // Whether a thread is currently sending a batch.
+    bool batch_in_flight = false;
+  };
+
+  // Sends the requests in |batch| and returns their results in order. Only
+  // called by the thread which set |batch_in_flight|.
+  std::vector<StatusOr<sgx::RemoteAssertion>> SendBatch(
+      const std::vector<PendingRequest *> &batch);
+
+  const ClientFactory client_factory_;
+  const size_t max_batch_size_;
+
+  MutexGuarded<State> state_;
+
+  // The following members are only accessed by the thread sending a batch.
+
+  // The client used for all RPCs, or nullptr if it has not been created yet.
+  std::unique_ptr<SgxRemoteAssertionGeneratorClient> client_;
+
+  // Whether the server rejected a GenerateSgxRemoteAssertions RPC as
+  // unimplemented.
+  bool batch_rpc_unimplemented_ = false;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_IDENTITY_ATTESTATION_SGX_INTERNAL_SGX_REMOTE_ASSERTION_BATCHER_H_
@@ -0,0 +1,256 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/identity/attestation/sgx/internal/sgx_remote_assertion_batcher.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "asylo/identity/attestation/sgx/internal/remote_assertion.pb.h"
+#include "asylo/identity/attestation/sgx/internal/sgx_remote_assertion_generator_mock.grpc.pb.h"
+#include "asylo/test/util/status_matchers.h"
+#include "asylo/util/status.h"
+#include "asylo/util/statusor.h"
+#include "asylo/util/thread.h"
+#include "include/grpcpp/support/status.h"
+
+namespace asylo {
+namespace {
+
+using ::testing::_;
+using ::testing::AnyNumber;
+using ::testing::Eq;
+using ::testing::Gt;
+using ::testing::Invoke;
+using ::testing::Lt;
+using ::testing::Return;
+
+constexpr int kMaxBatchSize = 8;
+
+// Answers a GenerateSgxRemoteAssertion RPC with an assertion whose payload is
+// the requested user data.
+::grpc::Status EchoAssertion(::grpc::ClientContext *context,
+                             const GenerateSgxRemoteAssertionRequest &request,
+                             GenerateSgxRemoteAssertionResponse *response) {
+  response->mutable_assertion()->set_payload(request.user_data());
+  return ::grpc::Status::OK;
+}
+
+// Answers a GenerateSgxRemoteAssertions RPC with an assertion for each
+// user-data item whose payload is that user data.
+::grpc::Status EchoAssertions(
+    ::grpc::ClientContext *context,
+    const GenerateSgxRemoteAssertionsRequest &request,
+    GenerateSgxRemoteAssertionsResponse *response) {
+  for (const std::string &user_data : request.user_data()) {
+    response->add_assertions()->set_payload(user_data);
+  }
+  return ::grpc::Status::OK;
+}
+
+class SgxRemoteAssertionBatcherTest : public ::testing::Test {
+ protected:
+  SgxRemoteAssertionBatcherTest()
+      : mock_stub_owner_(
+            absl::make_unique<MockSgxRemoteAssertionGeneratorStub>()),
+        mock_stub_(mock_stub_owner_.get()) {}
+
+  // Returns a client factory that hands out a client backed by |mock_stub_|.
+  SgxRemoteAssertionBatcher::ClientFactory MockClientFactory() {
+    return [this]()
+               -> StatusOr<std::unique_ptr<SgxRemoteAssertionGeneratorClient>> {
+      ++clients_created_;
+      return absl::make_unique<SgxRemoteAssertionGeneratorClient>(
+          std::unique_ptr<SgxRemoteAssertionGenerator::StubInterface>(
+              std::move(mock_stub_owner_)));
+    };
+  }
+
+  std::unique_ptr<MockSgxRemoteAssertionGeneratorStub> mock_stub_owner_;
+  MockSgxRemoteAssertionGeneratorStub *mock_stub_;
+  int clients_created_ = 0;
+};
+
+TEST_F(SgxRemoteAssertionBatcherTest, SingleRequestUsesSingleRpc) {
+  EXPECT_CALL(*mock_stub_, GenerateSgxRemoteAssertion(_, _, _))
+      .WillOnce(Invoke(EchoAssertion));
+  EXPECT_CALL(*mock_stub_, GenerateSgxRemoteAssertions(_, _, _)).Times(0);
+
+  SgxRemoteAssertionBatcher batcher(MockClientFactory(), kMaxBatchSize);
+  sgx::RemoteAssertion assertion;
+  ASYLO_ASSERT_OK_AND_ASSIGN(assertion,
+                             batcher.GenerateSgxRemoteAssertion("user data"));
+  EXPECT_THAT(assertion.payload(), Eq("user data"));
+}
+
+TEST_F(SgxRemoteAssertionBatcherTest, ReusesClient) {
+  EXPECT_CALL(*mock_stub_, GenerateSgxRemoteAssertion(_, _, _))
+      .Times(3)
+      .WillRepeatedly(Invoke(EchoAssertion));
+
+  SgxRemoteAssertionBatcher batcher(MockClientFactory(), kMaxBatchSize);
+  for (int i = 0; i < 3; ++i) {
+    ASYLO_EXPECT_OK(batcher.GenerateSgxRemoteAssertion("user data"));
+  }
+  EXPECT_THAT(clients_created_, Eq(1));
+}
+
+TEST_F(SgxRemoteAssertionBatcherTest, PropagatesRpcErrors) {
+  EXPECT_CALL(*mock_stub_, GenerateSgxRemoteAssertion(_, _, _))
+      .WillOnce(Return(::grpc::Status(::grpc::StatusCode::PERMISSION_DENIED,
+                                      "Peer does not have SGX identity")));
+
+  SgxRemoteAssertionBatcher batcher(MockClientFactory(), kMaxBatchSize);
+  EXPECT_THAT(batcher.GenerateSgxRemoteAssertion("user data"),
+              StatusIs(error::GoogleError::PERMISSION_DENIED));
+}
+
+TEST_F(SgxRemoteAssertionBatcherTest, RetriesFailedClientCreation) {
+  EXPECT_CALL(*mock_stub_, GenerateSgxRemoteAssertion(_, _, _))
+      .WillOnce(Invoke(EchoAssertion));
+
+  bool fail = true;
+  SgxRemoteAssertionBatcher::ClientFactory mock_factory = MockClientFactory();
+  SgxRemoteAssertionBatcher batcher(
+      [&fail, &mock_factory]()
+          -> StatusOr<std::unique_ptr<SgxRemoteAssertionGeneratorClient>> {
+        if (fail) {
+          return Status(error::GoogleError::UNAVAILABLE,
+                        "Failed to connect to server");
+        }
+        return mock_factory();
+      },
+      kMaxBatchSize);
+
+  EXPECT_THAT(batcher.GenerateSgxRemoteAssertion("user data"),
+              StatusIs(error::GoogleError::UNAVAILABLE));
+  fail = false;
+  ASYLO_EXPECT_OK(batcher.GenerateSgxRemoteAssertion("user data"));
+}
+
+// Blocks the first RPC until the remaining requests have queued up behind it,
+// then checks that they are sent in fewer RPCs than there are requests and
+// that every caller receives the assertion for its own user data.
+TEST_F(SgxRemoteAssertionBatcherTest, CoalescesConcurrentRequests) {
+  constexpr int kNumRequests = 2 * kMaxBatchSize + 1;
+
+  absl::Notification release_first_rpc;
+  int total_rpcs = 0;
+  EXPECT_CALL(*mock_stub_, GenerateSgxRemoteAssertion(_, _, _))
+      .Times(AnyNumber())
+      .WillRepeatedly(Invoke(
+          [&](::grpc::ClientContext *context,
+              const GenerateSgxRemoteAssertionRequest &request,
+              GenerateSgxRemoteAssertionResponse *response) {
+            if (total_rpcs++ == 0) {
+              release_first_rpc.WaitForNotification();
+            }
+            return EchoAssertion(context, request, response);
+          }));
+  int batched_rpcs = 0;
+  EXPECT_CALL(*mock_stub_, GenerateSgxRemoteAssertions(_, _, _))
+      .Times(AnyNumber())
+      .WillRepeatedly(Invoke(
+          [&](::grpc::ClientContext *context,
+              const GenerateSgxRemoteAssertionsRequest &request,
+              GenerateSgxRemoteAssertionsResponse *response) {
+            ++total_rpcs;
+            ++batched_rpcs;
+            EXPECT_THAT(request.user_data_size(), Lt(kMaxBatchSize + 1));
+            return EchoAssertions(context, request, response);
+          }));
+
+  SgxRemoteAssertionBatcher batcher(MockClientFactory(), kMaxBatchSize);
+  std::vector<StatusOr<sgx::RemoteAssertion>> results(kNumRequests);
+  std::vector<Thread> threads;
+  threads.reserve(kNumRequests);
+  for (int i = 0; i < kNumRequests; ++i) {
+    threads.emplace_back([&batcher, &results, i] {
+      results[i] = batcher.GenerateSgxRemoteAssertion(absl::StrCat(i));
+    });
+    if (i == 0) {
+      // Let the first request become the one in flight.
+      absl::SleepFor(absl::Milliseconds(100));
+    }
+  }
+  absl::SleepFor(absl::Milliseconds(100));
+  release_first_rpc.Notify();
+  for (auto &thread : threads) {
+    thread.Join();
+  }
+
+  for (int i = 0; i < kNumRequests; ++i) {
+    ASSERT_THAT(results[i], IsOk());
+    EXPECT_THAT(results[i].ValueOrDie().payload(), Eq(absl::StrCat(i)));
+  }
+  EXPECT_THAT(batched_rpcs, Gt(0));
+  EXPECT_THAT(total_rpcs, Lt(kNumRequests));
+}
+
+TEST_F(SgxRemoteAssertionBatcherTest, FallsBackWhenBatchRpcIsUnimplemented) {
+  absl::Notification release_first_rpc;
+  int single_rpcs = 0;
+  EXPECT_CALL(*mock_stub_, GenerateSgxRemoteAssertion(_, _, _))
+      .Times(4)
+      .WillRepeatedly(Invoke(
+          [&](::grpc::ClientContext *context,
+              const GenerateSgxRemoteAssertionRequest &request,
+              GenerateSgxRemoteAssertionResponse *response) {
+            if (single_rpcs++ == 0) {
+              release_first_rpc.WaitForNotification();
+            }
+            return EchoAssertion(context, request, response);
+          }));
+  EXPECT_CALL(*mock_stub_, GenerateSgxRemoteAssertions(_, _, _))
+      .WillOnce(Return(
+          ::grpc::Status(::grpc::StatusCode::UNIMPLEMENTED, "Unimplemented")));
+
+  SgxRemoteAssertionBatcher batcher(MockClientFactory(), kMaxBatchSize);
+  std::vector<StatusOr<sgx::RemoteAssertion>> results(4);
+  std::vector<Thread> threads;
+  threads.reserve(4);
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&batcher, &results, i] {
+      results[i] = batcher.GenerateSgxRemoteAssertion(absl::StrCat(i));
+    });
+    if (i == 0) {
+      absl::SleepFor(absl::Milliseconds(100));
+    }
+  }
+  absl::SleepFor(absl::Milliseconds(100));
+  release_first_rpc.Notify();
+  for (auto &thread : threads) {
+    thread.Join();
+  }
+
+  for (int i = 0; i < 4; ++i) {
+    ASSERT_THAT(results[i], IsOk());
+    EXPECT_THAT(results[i].ValueOrDie().payload(), Eq(absl::StrCat(i)));
+  }
+}
+
+}  // namespace
+}  // namespace asylo
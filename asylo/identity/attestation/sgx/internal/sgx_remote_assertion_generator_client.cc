@@ -18,6 +18,10 @@
 
 #include "asylo/identity/attestation/sgx/internal/sgx_remote_assertion_generator_client.h"
 
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
 #include "asylo/util/status.h"
 #include "include/grpcpp/client_context.h"
 
@@ -49,4 +53,39 @@ SgxRemoteAssertionGeneratorClient::GenerateSgxRemoteAssertion(
   return response.assertion();
 }
 
+StatusOr<std::vector<sgx::RemoteAssertion>>
+SgxRemoteAssertionGeneratorClient::GenerateSgxRemoteAssertions(
+    const std::vector<std::string> &user_data) {
+  if (user_data.size() >
+      static_cast<size_t>(kMaxSgxRemoteAssertionBatchSize)) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  absl::StrCat("Cannot request more than ",
+                               kMaxSgxRemoteAssertionBatchSize,
+                               " assertions at once"));
+  }
+
+  ::grpc::ClientContext context;
+
+  GenerateSgxRemoteAssertionsRequest request;
+  for (const std::string &data : user_data) {
+    request.add_user_data(data);
+  }
+  GenerateSgxRemoteAssertionsResponse response;
+
+  ::grpc::Status status =
+      stub_->GenerateSgxRemoteAssertions(&context, request, &response);
+  if (!status.ok()) {
+    return Status(status);
+  }
+
+  if (response.assertions_size() != static_cast<int>(user_data.size())) {
+    return Status(error::GoogleError::INTERNAL,
+                  absl::StrCat("Expected ", user_data.size(),
+                               " assertions but received ",
+                               response.assertions_size()));
+  }
+  return std::vector<sgx::RemoteAssertion>(response.assertions().begin(),
+                                           response.assertions().end());
+}
+
 }  // namespace asylo
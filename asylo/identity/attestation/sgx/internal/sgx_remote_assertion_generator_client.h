@@ -20,6 +20,8 @@
 #define ASYLO_IDENTITY_ATTESTATION_SGX_INTERNAL_SGX_REMOTE_ASSERTION_GENERATOR_CLIENT_H_
 
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "asylo/crypto/util/byte_container_view.h"
 #include "asylo/identity/attestation/sgx/internal/remote_assertion.pb.h"
@@ -29,6 +31,10 @@
 
 namespace asylo {
 
+// The maximum number of user-data items in a GenerateSgxRemoteAssertions
+// request.
+constexpr int kMaxSgxRemoteAssertionBatchSize = 256;
+
 // A gRPC client for the SgxRemoteAssertionGenerator service.
 class SgxRemoteAssertionGeneratorClient {
  public:
@@ -48,6 +54,13 @@ class SgxRemoteAssertionGeneratorClient {
   StatusOr<sgx::RemoteAssertion> GenerateSgxRemoteAssertion(
       ByteContainerView user_data);
 
+  // Requests an SGX remote assertion for each of |user_data| from the remote
+  // server in a single RPC. On success, the assertion at each index is bound to
+  // the user data at the same index. |user_data| must contain at most
+  // kMaxSgxRemoteAssertionBatchSize items.
+  StatusOr<std::vector<sgx::RemoteAssertion>> GenerateSgxRemoteAssertions(
+      const std::vector<std::string> &user_data);
+
  private:
   std::unique_ptr<SgxRemoteAssertionGenerator::StubInterface> stub_;
 };
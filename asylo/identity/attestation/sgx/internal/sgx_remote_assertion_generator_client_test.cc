@@ -18,6 +18,9 @@
 
 #include "asylo/identity/attestation/sgx/internal/sgx_remote_assertion_generator_client.h"
 
+#include <string>
+#include <vector>
+
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include "absl/memory/memory.h"
@@ -36,6 +39,7 @@ namespace {
 
 using ::testing::_;
 using ::testing::DoAll;
+using ::testing::ElementsAre;
 using ::testing::Return;
 using ::testing::SetArgPointee;
 
@@ -98,5 +102,71 @@ TEST(SgxRemoteAssertionGeneratorClientTest, GenerateSgxRemoteAssertionFails) {
               StatusIs(error::GoogleError::PERMISSION_DENIED));
 }
 
+// Tests that the SgxRemoteAssertionGeneratorClient returns the assertions from
+// a successful GenerateSgxRemoteAssertions RPC in order.
+TEST(SgxRemoteAssertionGeneratorClientTest,
+     GenerateSgxRemoteAssertionsSucceeds) {
+  auto mock_stub =
+      absl::make_unique<MockSgxRemoteAssertionGeneratorStub>();
+
+  GenerateSgxRemoteAssertionsRequest request;
+  request.add_user_data("first");
+  request.add_user_data("second");
+  GenerateSgxRemoteAssertionsResponse response;
+  response.add_assertions()->set_payload("first payload");
+  response.add_assertions()->set_payload("second payload");
+
+  EXPECT_CALL(*mock_stub,
+              GenerateSgxRemoteAssertions(_, EqualsProto(request), _))
+      .WillOnce(DoAll(SetArgPointee<2>(response), Return(::grpc::Status::OK)));
+
+  SgxRemoteAssertionGeneratorClient client(
+      std::unique_ptr<SgxRemoteAssertionGenerator::StubInterface>(
+          std::move(mock_stub)));
+  auto result = client.GenerateSgxRemoteAssertions({"first", "second"});
+
+  ASSERT_THAT(result, IsOk());
+  EXPECT_THAT(result.ValueOrDie(),
+              ElementsAre(EqualsProto(response.assertions(0)),
+                          EqualsProto(response.assertions(1))));
+}
+
+// Tests that the SgxRemoteAssertionGeneratorClient rejects a response that
+// does not contain an assertion for each requested user-data item.
+TEST(SgxRemoteAssertionGeneratorClientTest,
+     GenerateSgxRemoteAssertionsRejectsMissingAssertions) {
+  auto mock_stub =
+      absl::make_unique<MockSgxRemoteAssertionGeneratorStub>();
+
+  GenerateSgxRemoteAssertionsResponse response;
+  response.add_assertions()->set_payload("payload");
+
+  EXPECT_CALL(*mock_stub, GenerateSgxRemoteAssertions(_, _, _))
+      .WillOnce(DoAll(SetArgPointee<2>(response), Return(::grpc::Status::OK)));
+
+  SgxRemoteAssertionGeneratorClient client(
+      std::unique_ptr<SgxRemoteAssertionGenerator::StubInterface>(
+          std::move(mock_stub)));
+  EXPECT_THAT(client.GenerateSgxRemoteAssertions({"first", "second"}),
+              StatusIs(error::GoogleError::INTERNAL));
+}
+
+// Tests that the SgxRemoteAssertionGeneratorClient does not send a batch that
+// is larger than the server accepts.
+TEST(SgxRemoteAssertionGeneratorClientTest,
+     GenerateSgxRemoteAssertionsRejectsOversizedBatch) {
+  auto mock_stub =
+      absl::make_unique<MockSgxRemoteAssertionGeneratorStub>();
+  EXPECT_CALL(*mock_stub, GenerateSgxRemoteAssertions(_, _, _)).Times(0);
+
+  SgxRemoteAssertionGeneratorClient client(
+      std::unique_ptr<SgxRemoteAssertionGenerator::StubInterface>(
+          std::move(mock_stub)));
+  std::vector<std::string> user_data(kMaxSgxRemoteAssertionBatchSize + 1,
+                                     kUserData);
+  EXPECT_THAT(client.GenerateSgxRemoteAssertions(user_data),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+}
+
 }  // namespace
 }  // namespace asylo
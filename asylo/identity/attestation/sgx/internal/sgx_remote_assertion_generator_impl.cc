@@ -19,10 +19,13 @@
 #include "asylo/identity/attestation/sgx/internal/sgx_remote_assertion_generator_impl.h"
 
 #include <memory>
+#include <string>
 #include <vector>
 
+#include "absl/strings/str_cat.h"
 #include "asylo/grpc/auth/enclave_auth_context.h"
 #include "asylo/identity/attestation/sgx/internal/remote_assertion_util.h"
+#include "asylo/identity/attestation/sgx/internal/sgx_remote_assertion_generator_client.h"
 #include "asylo/identity/descriptions.h"
 #include "asylo/identity/platform/sgx/sgx_identity_util.h"
 #include "asylo/util/mutex_guarded.h"
@@ -66,6 +69,40 @@ SgxRemoteAssertionGeneratorImpl::SgxRemoteAssertionGeneratorImpl(
     ::grpc::ServerContext *context,
     const GenerateSgxRemoteAssertionRequest *request,
     GenerateSgxRemoteAssertionResponse *response) {
+  return MakeRemoteAssertions(context, {&request->user_data()},
+                              {response->mutable_assertion()});
+}
+
+::grpc::Status SgxRemoteAssertionGeneratorImpl::GenerateSgxRemoteAssertions(
+    ::grpc::ServerContext *context,
+    const GenerateSgxRemoteAssertionsRequest *request,
+    GenerateSgxRemoteAssertionsResponse *response) {
+  if (request->user_data_size() > kMaxSgxRemoteAssertionBatchSize) {
+    return ::grpc::Status(
+        ::grpc::StatusCode::INVALID_ARGUMENT,
+        absl::StrCat("Cannot generate more than ",
+                     kMaxSgxRemoteAssertionBatchSize, " assertions at once"));
+  }
+
+  std::vector<const std::string *> user_data;
+  std::vector<sgx::RemoteAssertion *> assertions;
+  user_data.reserve(request->user_data_size());
+  assertions.reserve(request->user_data_size());
+  for (const std::string &data : request->user_data()) {
+    user_data.push_back(&data);
+    assertions.push_back(response->add_assertions());
+  }
+  ::grpc::Status status = MakeRemoteAssertions(context, user_data, assertions);
+  if (!status.ok()) {
+    response->clear_assertions();
+  }
+  return status;
+}
+
+::grpc::Status SgxRemoteAssertionGeneratorImpl::MakeRemoteAssertions(
+    ::grpc::ServerContext *context,
+    const std::vector<const std::string *> &user_data,
+    const std::vector<sgx::RemoteAssertion *> &assertions) {
   StatusOr<EnclaveAuthContext> auth_context_result =
       EnclaveAuthContext::CreateFromAuthContext(*context->auth_context());
   if (!auth_context_result.ok()) {
@@ -90,13 +127,15 @@ SgxRemoteAssertionGeneratorImpl::SgxRemoteAssertionGeneratorImpl(
   }
 
   auto certificate_chains_locked = certificate_chains_.ReaderLock();
-  status = MakeRemoteAssertion(request->user_data(), sgx_identity,
-                               **signing_key_locked, *certificate_chains_locked,
-                               response->mutable_assertion());
-  if (!status.ok()) {
-    LOG(ERROR) << "MakeRemoteAssertion failed: " << status;
-    return ::grpc::Status(::grpc::StatusCode::INTERNAL,
-                          "Failed to generate SGX remote assertion");
+  for (size_t i = 0; i < user_data.size(); ++i) {
+    status = MakeRemoteAssertion(*user_data[i], sgx_identity,
+                                 **signing_key_locked,
+                                 *certificate_chains_locked, assertions[i]);
+    if (!status.ok()) {
+      LOG(ERROR) << "MakeRemoteAssertion failed: " << status;
+      return ::grpc::Status(::grpc::StatusCode::INTERNAL,
+                            "Failed to generate SGX remote assertion");
+    }
   }
   return ::grpc::Status::OK;
 }
@@ -20,6 +20,7 @@
 #define ASYLO_IDENTITY_ATTESTATION_SGX_INTERNAL_SGX_REMOTE_ASSERTION_GENERATOR_IMPL_H_
 
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "asylo/crypto/certificate.pb.h"
@@ -58,6 +59,16 @@ class SgxRemoteAssertionGeneratorImpl
       const GenerateSgxRemoteAssertionRequest *request,
       GenerateSgxRemoteAssertionResponse *response) override;
 
+  // Generates an SGX remote assertion for each user-data item in |request| for
+  // the caller described in |context|, if that caller is an authenticated local
+  // SGX enclave entity. On success, writes the assertions to |response| in the
+  // order of the request. Returns an INVALID_ARGUMENT error if |request|
+  // contains more than kMaxSgxRemoteAssertionBatchSize items.
+  ::grpc::Status GenerateSgxRemoteAssertions(
+      ::grpc::ServerContext *context,
+      const GenerateSgxRemoteAssertionsRequest *request,
+      GenerateSgxRemoteAssertionsResponse *response) override;
+
   // Updates |signing_key_| and |certificate_chains_| with |signing_key| and
   // |certificate_chains| respectively.
   void UpdateSigningKeyAndCertificateChains(
@@ -65,6 +76,14 @@ class SgxRemoteAssertionGeneratorImpl
       const std::vector<CertificateChain> &certificate_chains);
 
  private:
+  // Writes an SGX remote assertion bound to each of |user_data| to the element
+  // of |assertions| with the same index, for the caller described in
+  // |context|. The signing key is held for all assertions.
+  ::grpc::Status MakeRemoteAssertions(
+      ::grpc::ServerContext *context,
+      const std::vector<const std::string *> &user_data,
+      const std::vector<sgx::RemoteAssertion *> &assertions);
+
   // The key used to sign attestations.
   MutexGuarded<std::unique_ptr<SigningKey>> signing_key_;
 
@@ -140,10 +140,9 @@ class SgxRemoteAssertionGeneratorImplTest : public testing::Test {
     server_address_ = absl::StrCat(kAddress, ":", port);
   }
 
-  // Starts a gRPC client that connects to the server using
-  // |channel_credentials|. Uses the client to make a GenerateSgxRemoteAssertion
-  // RPC and returns the result of the RPC.
-  StatusOr<RemoteAssertion> GenerateSgxRemoteAssertion(
+  // Creates a channel to the server using |channel_credentials| and waits for
+  // it to connect.
+  StatusOr<std::shared_ptr<::grpc::Channel>> ConnectToServer(
       const std::shared_ptr<::grpc::ChannelCredentials> &channel_credentials) {
     std::shared_ptr<::grpc::Channel> channel =
         ::grpc::CreateChannel(server_address_, channel_credentials);
@@ -155,11 +154,36 @@ class SgxRemoteAssertionGeneratorImplTest : public testing::Test {
       return Status(error::GoogleError::INTERNAL,
                     "Failed to connect to server");
     }
+    return channel;
+  }
+
+  // Starts a gRPC client that connects to the server using
+  // |channel_credentials|. Uses the client to make a GenerateSgxRemoteAssertion
+  // RPC and returns the result of the RPC.
+  StatusOr<RemoteAssertion> GenerateSgxRemoteAssertion(
+      const std::shared_ptr<::grpc::ChannelCredentials> &channel_credentials) {
+    std::shared_ptr<::grpc::Channel> channel;
+    ASYLO_ASSIGN_OR_RETURN(channel, ConnectToServer(channel_credentials));
 
     SgxRemoteAssertionGeneratorClient client(channel);
     return client.GenerateSgxRemoteAssertion(kUserData);
   }
 
+  // Starts a gRPC client that connects to the server using
+  // |channel_credentials|. Uses the client to make a
+  // GenerateSgxRemoteAssertions RPC for |count| copies of kUserData and returns
+  // the result of the RPC.
+  StatusOr<std::vector<RemoteAssertion>> GenerateSgxRemoteAssertions(
+      const std::shared_ptr<::grpc::ChannelCredentials> &channel_credentials,
+      int count) {
+    std::shared_ptr<::grpc::Channel> channel;
+    ASYLO_ASSIGN_OR_RETURN(channel, ConnectToServer(channel_credentials));
+
+    SgxRemoteAssertionGeneratorClient client(channel);
+    return client.GenerateSgxRemoteAssertions(
+        std::vector<std::string>(count, kUserData));
+  }
+
   bool CheckCertificateChainsEqual(
       const std::vector<CertificateChain> &certificate_chains1,
       const google::protobuf::RepeatedPtrField<CertificateChain> &certificate_chains2) {
@@ -270,6 +294,42 @@ TEST_F(SgxRemoteAssertionGeneratorImplTest,
       VerifyRemoteAssertion(assertion, certificate_chains_, *verifying_key_));
 }
 
+TEST_F(SgxRemoteAssertionGeneratorImplTest,
+       GenerateSgxRemoteAssertionsSucceeds) {
+  // Configure the server and the peer to use bidirectional authentication based
+  // on SGX local attestation. Every assertion in the batch should be a valid
+  // remote assertion.
+  std::shared_ptr<::grpc::ServerCredentials> server_credentials =
+      EnclaveServerCredentials(BidirectionalSgxLocalCredentialsOptions());
+  std::unique_ptr<SgxRemoteAssertionGeneratorImpl> service;
+  ASYLO_ASSERT_OK_AND_ASSIGN(service, CreateServiceWithKeyAndCertificate());
+  SetUpServer(service.get(), server_credentials);
+
+  std::shared_ptr<::grpc::ChannelCredentials> channel_credentials =
+      EnclaveChannelCredentials(BidirectionalSgxLocalCredentialsOptions());
+  std::vector<RemoteAssertion> assertions;
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      assertions, GenerateSgxRemoteAssertions(channel_credentials, 3));
+  ASSERT_EQ(assertions.size(), 3);
+  for (const RemoteAssertion &assertion : assertions) {
+    EXPECT_NO_FATAL_FAILURE(
+        VerifyRemoteAssertion(assertion, certificate_chains_, *verifying_key_));
+  }
+}
+
+TEST_F(SgxRemoteAssertionGeneratorImplTest,
+       ServerWithoutAttestationKeyGenerateSgxRemoteAssertionsFails) {
+  std::shared_ptr<::grpc::ServerCredentials> server_credentials =
+      EnclaveServerCredentials(BidirectionalSgxLocalCredentialsOptions());
+  auto service = absl::make_unique<SgxRemoteAssertionGeneratorImpl>();
+  SetUpServer(service.get(), server_credentials);
+
+  std::shared_ptr<::grpc::ChannelCredentials> channel_credentials =
+      EnclaveChannelCredentials(BidirectionalSgxLocalCredentialsOptions());
+  EXPECT_THAT(GenerateSgxRemoteAssertions(channel_credentials, 2),
+              StatusIs(error::GoogleError::FAILED_PRECONDITION));
+}
+
 TEST_F(SgxRemoteAssertionGeneratorImplTest,
        UpdateSigningKeyAndCertificateChainsOnNoKeyServerSucceeds) {
   // Configure the server and the peer to use bidirectional authentication based
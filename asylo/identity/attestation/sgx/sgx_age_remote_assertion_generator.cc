@@ -20,17 +20,20 @@
 
 #include <algorithm>
 #include <memory>
+#include <string>
 #include <utility>
 
 #include <google/protobuf/repeated_field.h>
 #include <google/protobuf/util/message_differencer.h>
 #include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
 #include "absl/time/time.h"
 #include "asylo/crypto/certificate_interface.h"
 #include "asylo/crypto/certificate_util.h"
 #include "asylo/grpc/auth/enclave_channel_credentials.h"
 #include "asylo/grpc/auth/enclave_credentials_options.h"
 #include "asylo/grpc/auth/sgx_local_credentials_options.h"
+#include "asylo/identity/attestation/attestation_timing.h"
 #include "asylo/identity/attestation/sgx/internal/certificate_util.h"
 #include "asylo/identity/attestation/sgx/internal/remote_assertion.pb.h"
 #include "asylo/identity/attestation/sgx/internal/sgx_remote_assertion_generator_client.h"
@@ -54,6 +57,26 @@ StatusOr<sgx::RemoteAssertionRequestAdditionalInfo> ParseAdditionalInfo(
   return additional_info;
 }
 
+// Connects to the Assertion Generator Enclave at |server_address| using SGX
+// local attestation.
+StatusOr<std::unique_ptr<SgxRemoteAssertionGeneratorClient>> ConnectToAge(
+    const std::string &server_address) {
+  auto channel_credentials =
+      EnclaveChannelCredentials(BidirectionalSgxLocalCredentialsOptions());
+  std::shared_ptr<::grpc::Channel> channel =
+      ::grpc::CreateChannel(server_address, channel_credentials);
+
+  gpr_timespec absolute_deadline =
+      gpr_time_add(gpr_now(GPR_CLOCK_REALTIME),
+                   gpr_time_from_micros(kDeadlineMicros, GPR_TIMESPAN));
+
+  if (!channel->WaitForConnected(absolute_deadline)) {
+    return Status(error::GoogleError::INTERNAL, "Failed to connect to server");
+  }
+
+  return absl::make_unique<SgxRemoteAssertionGeneratorClient>(channel);
+}
+
 }  // namespace
 
 const char *const SgxAgeRemoteAssertionGenerator::kAuthorityType =
@@ -93,6 +116,13 @@ Status SgxAgeRemoteAssertionGenerator::Initialize(const std::string &config) {
                   "Config is missing server address");
   }
 
+  if (authority_config.max_assertion_batch_size() >
+      static_cast<uint32_t>(kMaxSgxRemoteAssertionBatchSize)) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  absl::StrCat("Maximum assertion batch size cannot exceed ",
+                               kMaxSgxRemoteAssertionBatchSize));
+  }
+
   members_view->root_ca_certificates.reserve(
       authority_config.root_ca_certificates_size() + 1);
   members_view->root_ca_certificates.emplace_back(
@@ -101,6 +131,12 @@ Status SgxAgeRemoteAssertionGenerator::Initialize(const std::string &config) {
             authority_config.root_ca_certificates().end(),
             std::back_inserter(members_view->root_ca_certificates));
   members_view->server_address = authority_config.server_address();
+  if (authority_config.max_assertion_batch_size() > 1) {
+    std::string server_address = authority_config.server_address();
+    members_view->batcher = absl::make_unique<SgxRemoteAssertionBatcher>(
+        [server_address] { return ConnectToAge(server_address); },
+        authority_config.max_assertion_batch_size());
+  }
   members_view->initialized = true;
 
 
@@ -210,23 +246,22 @@ Status SgxAgeRemoteAssertionGenerator::Generate(const std::string &user_data,
   sgx::RemoteAssertionRequestAdditionalInfo additional_info;
   ASYLO_ASSIGN_OR_RETURN(additional_info, ParseAdditionalInfo(request));
 
-  auto channel_credentials =
-      EnclaveChannelCredentials(BidirectionalSgxLocalCredentialsOptions());
-  std::shared_ptr<::grpc::Channel> channel =
-      ::grpc::CreateChannel(members_view->server_address, channel_credentials);
-
-  gpr_timespec absolute_deadline =
-      gpr_time_add(gpr_now(GPR_CLOCK_REALTIME),
-                   gpr_time_from_micros(kDeadlineMicros, GPR_TIMESPAN));
-
-  if (!channel->WaitForConnected(absolute_deadline)) {
-    return Status(error::GoogleError::INTERNAL, "Failed to connect to server");
-  }
-
-  SgxRemoteAssertionGeneratorClient client(channel);
   sgx::RemoteAssertion remote_assertion;
-  ASYLO_ASSIGN_OR_RETURN(remote_assertion,
-                         client.GenerateSgxRemoteAssertion(user_data));
+  {
+    ScopedAttestationTimer timer(sgx::kSgxAgeRemoteAssertionAuthority,
+                                 AttestationPhase::kAgeRpc);
+    if (members_view->batcher != nullptr) {
+      ASYLO_ASSIGN_OR_RETURN(
+          remote_assertion,
+          members_view->batcher->GenerateSgxRemoteAssertion(user_data));
+    } else {
+      std::unique_ptr<SgxRemoteAssertionGeneratorClient> client;
+      ASYLO_ASSIGN_OR_RETURN(client,
+                             ConnectToAge(members_view->server_address));
+      ASYLO_ASSIGN_OR_RETURN(remote_assertion,
+                             client->GenerateSgxRemoteAssertion(user_data));
+    }
+  }
 
   if (!remote_assertion.SerializeToString(assertion->mutable_assertion())) {
     return Status(error::GoogleError::INTERNAL,
@@ -19,12 +19,14 @@
 #ifndef ASYLO_IDENTITY_ATTESTATION_SGX_SGX_AGE_REMOTE_ASSERTION_GENERATOR_H_
 #define ASYLO_IDENTITY_ATTESTATION_SGX_SGX_AGE_REMOTE_ASSERTION_GENERATOR_H_
 
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "asylo/crypto/certificate.pb.h"
 #include "asylo/crypto/certificate_util.h"
 #include "asylo/identity/attestation/enclave_assertion_generator.h"
+#include "asylo/identity/attestation/sgx/internal/sgx_remote_assertion_batcher.h"
 #include "asylo/identity/attestation/sgx/internal/sgx_remote_assertion_generator_client.h"
 #include "asylo/identity/identity.pb.h"
 #include "asylo/util/mutex_guarded.h"
@@ -86,6 +88,10 @@ class SgxAgeRemoteAssertionGenerator final : public EnclaveAssertionGenerator {
     // The server address of the Assertion Generator Enclave (AGE).
     std::string server_address;
 
+    // Coalesces concurrent requests to the AGE, or nullptr if batching is
+    // disabled.
+    std::unique_ptr<SgxRemoteAssertionBatcher> batcher;
+
     // Indicates whether this generator has been initialized.
     bool initialized;
 
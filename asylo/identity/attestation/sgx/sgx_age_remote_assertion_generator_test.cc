@@ -22,6 +22,7 @@
 #include <cstring>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <google/protobuf/text_format.h>
 #include <gmock/gmock.h>
@@ -299,6 +300,20 @@ TEST_F(SgxAgeRemoteAssertionGeneratorTest, InitializeFailsWithBadIntelCert) {
               StatusIs(error::GoogleError::INVALID_ARGUMENT));
 }
 
+TEST_F(SgxAgeRemoteAssertionGeneratorTest,
+       InitializeFailsWithTooLargeBatchSize) {
+  SgxAgeRemoteAssertionAuthorityConfig authority_config;
+  ASSERT_TRUE(authority_config.ParseFromString(config_));
+  authority_config.set_max_assertion_batch_size(
+      kMaxSgxRemoteAssertionBatchSize + 1);
+
+  std::string config;
+  ASSERT_TRUE(authority_config.SerializeToString(&config));
+
+  EXPECT_THAT(test_enclave_wrapper_->Initialize(config),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+}
+
 TEST_F(SgxAgeRemoteAssertionGeneratorTest, OneInitializationSingleThreaded) {
   ASYLO_EXPECT_OK(test_enclave_wrapper_->Initialize(config_));
   EXPECT_THAT(test_enclave_wrapper_->Initialize(config_),
@@ -471,5 +486,48 @@ TEST_F(SgxAgeRemoteAssertionGeneratorTest, GenerateSuccess) {
   }
 }
 
+TEST_F(SgxAgeRemoteAssertionGeneratorTest, GenerateWithBatchingSuccess) {
+  SgxAgeRemoteAssertionAuthorityConfig authority_config;
+  ASSERT_TRUE(authority_config.ParseFromString(config_));
+  authority_config.set_max_assertion_batch_size(16);
+  std::string config;
+  ASSERT_TRUE(authority_config.SerializeToString(&config));
+  ASYLO_EXPECT_OK(test_enclave_wrapper_->Initialize(config));
+
+  AssertionRequest assertion_request;
+  ASYLO_ASSERT_OK_AND_ASSIGN(assertion_request,
+                             MakeAssertionRequest({*intel_root_cert_}));
+
+  SgxIdentity enclave_identity;
+  ASYLO_ASSERT_OK_AND_ASSIGN(enclave_identity,
+                             test_enclave_wrapper_->GetSgxSelfIdentity());
+
+  constexpr int kNumThreads = 8;
+  std::vector<StatusOr<Assertion>> results(kNumThreads);
+  std::vector<Thread> threads;
+  threads.reserve(kNumThreads);
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back([this, &assertion_request, &results, i] {
+      results[i] =
+          test_enclave_wrapper_->Generate(kUserData, assertion_request);
+    });
+  }
+  for (auto &thread : threads) {
+    thread.Join();
+  }
+
+  for (const StatusOr<Assertion> &result : results) {
+    ASSERT_THAT(result, IsOk());
+    sgx::RemoteAssertion remote_assertion;
+    ASSERT_TRUE(
+        remote_assertion.ParseFromString(result.ValueOrDie().assertion()));
+
+    sgx::RemoteAssertionPayload payload;
+    ASSERT_TRUE(payload.ParseFromString(remote_assertion.payload()));
+    EXPECT_THAT(payload.identity(), EqualsProto(enclave_identity));
+    EXPECT_EQ(payload.user_data(), kUserData);
+  }
+}
+
 }  // namespace
 }  // namespace asylo
@@ -26,6 +26,7 @@
 #include "absl/memory/memory.h"
 #include "absl/strings/str_format.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
 #include "absl/types/variant.h"
 #include "asylo/crypto/certificate.pb.h"
 #include "asylo/crypto/certificate_interface.h"
@@ -33,6 +34,7 @@
 #include "asylo/crypto/sha256_hash.h"
 #include "asylo/crypto/x509_certificate.h"
 #include "asylo/identity/additional_authenticated_data_generator.h"
+#include "asylo/identity/attestation/attestation_timing.h"
 #include "asylo/identity/attestation/sgx/internal/dcap_intel_architectural_enclave_interface.h"
 #include "asylo/identity/attestation/sgx/internal/enclave_dcap_library_interface.h"
 #include "asylo/identity/attestation/sgx/internal/intel_architectural_enclave_interface.h"
@@ -174,6 +176,72 @@ StatusOr<bool> SgxIntelEcdsaQeRemoteAssertionGenerator::CanGenerate(
 Status SgxIntelEcdsaQeRemoteAssertionGenerator::Generate(
     const std::string &user_data, const AssertionRequest &request,
     Assertion *assertion) const {
+  ASYLO_RETURN_IF_ERROR(CheckCanGenerate(request));
+
+  sgx::Targetinfo qe_targetinfo;
+  ASYLO_ASSIGN_OR_RETURN(qe_targetinfo, GetQeTargetinfo());
+
+  sgx::Report report;
+  ASYLO_ASSIGN_OR_RETURN(report, GetReportForQe(user_data, qe_targetinfo));
+
+  StatusOr<std::vector<uint8_t>> quote_result = [&] {
+    ScopedAttestationTimer timer(sgx::kSgxIntelEcdsaQeRemoteAssertionAuthority,
+                                 AttestationPhase::kQeCall);
+    return intel_enclaves_->GetQeQuote(report);
+  }();
+  if (!quote_result.ok()) {
+    ResetQeTargetinfo();
+    return quote_result.status();
+  }
+
+  SetAssertion(quote_result.ValueOrDie(), assertion);
+  return Status::OkStatus();
+}
+
+Status SgxIntelEcdsaQeRemoteAssertionGenerator::GenerateBatch(
+    absl::Span<const std::string> user_data, const AssertionRequest &request,
+    std::vector<Assertion> *assertions) const {
+  ASYLO_RETURN_IF_ERROR(CheckCanGenerate(request));
+
+  sgx::Targetinfo qe_targetinfo;
+  ASYLO_ASSIGN_OR_RETURN(qe_targetinfo, GetQeTargetinfo());
+
+  std::vector<sgx::Report> reports;
+  reports.reserve(user_data.size());
+  for (const std::string &data : user_data) {
+    sgx::Report report;
+    ASYLO_ASSIGN_OR_RETURN(report, GetReportForQe(data, qe_targetinfo));
+    reports.push_back(report);
+  }
+
+  StatusOr<std::vector<std::vector<uint8_t>>> quotes_result = [&] {
+    ScopedAttestationTimer timer(sgx::kSgxIntelEcdsaQeRemoteAssertionAuthority,
+                                 AttestationPhase::kQeCall);
+    return intel_enclaves_->GetQeQuotes(reports);
+  }();
+  if (!quotes_result.ok()) {
+    ResetQeTargetinfo();
+    return quotes_result.status();
+  }
+
+  std::vector<std::vector<uint8_t>> quotes =
+      std::move(quotes_result).ValueOrDie();
+  if (quotes.size() != reports.size()) {
+    return Status(error::GoogleError::INTERNAL,
+                  absl::StrFormat("Expected %d quotes, but got %d",
+                                  reports.size(), quotes.size()));
+  }
+
+  std::vector<Assertion> generated(quotes.size());
+  for (size_t i = 0; i < quotes.size(); ++i) {
+    SetAssertion(quotes[i], &generated[i]);
+  }
+  *assertions = std::move(generated);
+  return Status::OkStatus();
+}
+
+Status SgxIntelEcdsaQeRemoteAssertionGenerator::CheckCanGenerate(
+    const AssertionRequest &request) const {
   bool can_generate;
   ASYLO_ASSIGN_OR_RETURN(can_generate, CanGenerate(request));
   if (!can_generate) {
@@ -181,25 +249,45 @@ Status SgxIntelEcdsaQeRemoteAssertionGenerator::Generate(
                   absl::StrFormat("Cannot generate assertions for '%s'",
                                   request.ShortDebugString()));
   }
+  return Status::OkStatus();
+}
+
+StatusOr<sgx::Targetinfo>
+SgxIntelEcdsaQeRemoteAssertionGenerator::GetQeTargetinfo() const {
+  {
+    auto members_view = members_.ReaderLock();
+    if (members_view->qe_targetinfo.has_value()) {
+      return *members_view->qe_targetinfo;
+    }
+  }
+
+  sgx::Targetinfo qe_targetinfo;
+  ASYLO_ASSIGN_OR_RETURN(qe_targetinfo, intel_enclaves_->GetQeTargetinfo());
+  members_.Lock()->qe_targetinfo = qe_targetinfo;
+  return qe_targetinfo;
+}
 
+void SgxIntelEcdsaQeRemoteAssertionGenerator::ResetQeTargetinfo() const {
+  members_.Lock()->qe_targetinfo.reset();
+}
+
+StatusOr<sgx::Report> SgxIntelEcdsaQeRemoteAssertionGenerator::GetReportForQe(
+    const std::string &user_data, const sgx::Targetinfo &qe_targetinfo) const {
   AlignedReportdataPtr reportdata;
   ASYLO_ASSIGN_OR_RETURN(reportdata->data, aad_generator_->Generate(user_data));
 
   AlignedTargetinfoPtr targetinfo;
-  ASYLO_ASSIGN_OR_RETURN(*targetinfo, intel_enclaves_->GetQeTargetinfo());
-
-  sgx::Report report;
-  ASYLO_ASSIGN_OR_RETURN(
-      report, hardware_interface_->GetReport(*targetinfo, *reportdata));
-
-  std::vector<uint8_t> quote;
-  ASYLO_ASSIGN_OR_RETURN(quote, intel_enclaves_->GetQeQuote(report));
+  *targetinfo = qe_targetinfo;
+  ScopedAttestationTimer timer(sgx::kSgxIntelEcdsaQeRemoteAssertionAuthority,
+                               AttestationPhase::kEreport);
+  return hardware_interface_->GetReport(*targetinfo, *reportdata);
+}
 
+void SgxIntelEcdsaQeRemoteAssertionGenerator::SetAssertion(
+    const std::vector<uint8_t> &quote, Assertion *assertion) const {
   assertion->mutable_assertion()->assign(quote.begin(), quote.end());
   assertion->mutable_description()->set_authority_type(AuthorityType());
   assertion->mutable_description()->set_identity_type(IdentityType());
-
-  return Status::OkStatus();
 }
 
 SET_STATIC_MAP_VALUE_OF_DERIVED_TYPE(AssertionGeneratorMap,
@@ -21,6 +21,10 @@
 
 #include <memory>
 #include <string>
+#include <vector>
+
+#include "absl/types/optional.h"
+#include "absl/types/span.h"
 
 #include "asylo/crypto/certificate_util.h"
 #include "asylo/identity/additional_authenticated_data_generator.h"
@@ -30,6 +34,7 @@
 #include "asylo/identity/attestation/sgx/sgx_intel_ecdsa_qe_remote_assertion_authority_config.pb.h"
 #include "asylo/identity/identity.pb.h"
 #include "asylo/identity/platform/sgx/internal/hardware_interface.h"
+#include "asylo/identity/platform/sgx/internal/identity_key_management_structs.h"
 #include "asylo/util/mutex_guarded.h"
 #include "asylo/util/status.h"
 #include "asylo/util/statusor.h"
@@ -81,15 +86,47 @@ class SgxIntelEcdsaQeRemoteAssertionGenerator
   Status Generate(const std::string &user_data, const AssertionRequest &request,
                   Assertion *assertion) const override;
 
+  // Generates one assertion per element of |user_data| for |request|, in the
+  // same order. All of the quotes are obtained from the quoting enclave in a
+  // single call, which is cheaper than calling Generate() once per element.
+  // On success, |assertions| is replaced with the generated assertions.
+  Status GenerateBatch(absl::Span<const std::string> user_data,
+                       const AssertionRequest &request,
+                       std::vector<Assertion> *assertions) const;
+
  private:
   struct Members {
     bool is_initialized = false;
+
+    // The TARGETINFO of the QE, once it has been fetched.
+    absl::optional<sgx::Targetinfo> qe_targetinfo;
   };
 
   Status ReadCertificationData(
       const SgxIntelEcdsaQeRemoteAssertionAuthorityConfig &config) const;
 
-  MutexGuarded<Members> members_;
+  // Returns an error if assertions for |request| cannot be generated.
+  Status CheckCanGenerate(const AssertionRequest &request) const;
+
+  // Returns the TARGETINFO of the QE. The TARGETINFO is only fetched from
+  // |intel_enclaves_| on the first call, and after a call to
+  // ResetQeTargetinfo().
+  StatusOr<sgx::Targetinfo> GetQeTargetinfo() const;
+
+  // Drops the cached TARGETINFO of the QE. Called when the QE fails to quote a
+  // report, since the QE may have been reloaded with a different identity.
+  void ResetQeTargetinfo() const;
+
+  // Returns a REPORT targeted at the QE whose REPORTDATA binds |user_data|.
+  StatusOr<sgx::Report> GetReportForQe(const std::string &user_data,
+                                       const sgx::Targetinfo &qe_targetinfo)
+      const;
+
+  // Fills in |assertion| with |quote|.
+  void SetAssertion(const std::vector<uint8_t> &quote,
+                    Assertion *assertion) const;
+
+  mutable MutexGuarded<Members> members_;
   std::unique_ptr<AdditionalAuthenticatedDataGenerator> aad_generator_;
   std::unique_ptr<asylo::sgx::IntelArchitecturalEnclaveInterface>
       intel_enclaves_;
@@ -69,6 +69,7 @@ using ::testing::ElementsAreArray;
 using ::testing::Eq;
 using ::testing::Return;
 using ::testing::SaveArg;
+using ::testing::SizeIs;
 using ::testing::Test;
 
 class SgxIntelEcdsaQeRemoteAssertionGeneratorTests : public testing::Test {
@@ -290,6 +291,81 @@ TEST_F(SgxIntelEcdsaQeRemoteAssertionGeneratorTests, GenerateSucceeds) {
   EXPECT_THAT(assertion.assertion(), ElementsAreArray(fake_quote));
 }
 
+TEST_F(SgxIntelEcdsaQeRemoteAssertionGeneratorTests,
+       GenerateReusesQeTargetinfoUntilQuotingFails) {
+  EXPECT_CALL(*mock_intel_enclaves_, SetPckCertificateChain(_))
+      .WillOnce(Return(Status::OkStatus()));
+  ASSERT_THAT(generator_.Initialize(valid_config_), IsOk());
+  AssertionRequest request;
+  *request.mutable_description() = CreateValidAssertionDescription();
+
+  EXPECT_CALL(*mock_intel_enclaves_, GetQeTargetinfo())
+      .Times(2)
+      .WillRepeatedly(Return(CreateFakeTargetInfo()));
+  EXPECT_CALL(*mock_hardware_interface_, GetReport(_, _))
+      .WillRepeatedly(Return(Report{}));
+  EXPECT_CALL(*mock_intel_enclaves_, GetQeQuote(_))
+      .WillOnce(Return(std::vector<uint8_t>(16)))
+      .WillOnce(Return(std::vector<uint8_t>(16)))
+      .WillOnce(Return(Status(error::GoogleError::INTERNAL, "QE reloaded")))
+      .WillOnce(Return(std::vector<uint8_t>(16)));
+
+  Assertion assertion;
+  EXPECT_THAT(generator_.Generate("first", request, &assertion), IsOk());
+  EXPECT_THAT(generator_.Generate("second", request, &assertion), IsOk());
+  EXPECT_THAT(generator_.Generate("third", request, &assertion),
+              StatusIs(error::GoogleError::INTERNAL));
+  EXPECT_THAT(generator_.Generate("fourth", request, &assertion), IsOk());
+}
+
+TEST_F(SgxIntelEcdsaQeRemoteAssertionGeneratorTests,
+       GenerateBatchQuotesAllReportsAtOnce) {
+  EXPECT_CALL(*mock_intel_enclaves_, SetPckCertificateChain(_))
+      .WillOnce(Return(Status::OkStatus()));
+  ASSERT_THAT(generator_.Initialize(valid_config_), IsOk());
+  AssertionRequest request;
+  *request.mutable_description() = CreateValidAssertionDescription();
+
+  const Targetinfo kTargetinfo = CreateFakeTargetInfo();
+  EXPECT_CALL(*mock_intel_enclaves_, GetQeTargetinfo())
+      .WillOnce(Return(kTargetinfo));
+
+  const std::vector<Report> kReports = {TrivialRandomObject<Report>(),
+                                        TrivialRandomObject<Report>(),
+                                        TrivialRandomObject<Report>()};
+  EXPECT_CALL(*mock_hardware_interface_,
+              GetReport(TrivialObjectEq(kTargetinfo), _))
+      .WillOnce(Return(kReports[0]))
+      .WillOnce(Return(kReports[1]))
+      .WillOnce(Return(kReports[2]));
+
+  std::vector<std::vector<uint8_t>> fake_quotes;
+  for (size_t i = 0; i < kReports.size(); ++i) {
+    fake_quotes.emplace_back(32, i);
+  }
+  EXPECT_CALL(*mock_intel_enclaves_, GetQeQuote(_)).Times(0);
+  EXPECT_CALL(*mock_intel_enclaves_, GetQeQuotes(SizeIs(kReports.size())))
+      .WillOnce(Return(fake_quotes));
+
+  const std::vector<std::string> kData = {"first", "second", "third"};
+  std::vector<Assertion> assertions;
+  ASSERT_THAT(generator_.GenerateBatch(kData, request, &assertions), IsOk());
+  ASSERT_THAT(assertions, SizeIs(kData.size()));
+  for (size_t i = 0; i < assertions.size(); ++i) {
+    EXPECT_THAT(assertions[i].description(),
+                EqualsProto(CreateValidAssertionDescription()));
+    EXPECT_THAT(assertions[i].assertion(), ElementsAreArray(fake_quotes[i]));
+  }
+}
+
+TEST_F(SgxIntelEcdsaQeRemoteAssertionGeneratorTests,
+       GenerateBatchFailsIfNotInitialized) {
+  std::vector<Assertion> assertions;
+  EXPECT_THAT(generator_.GenerateBatch({"data"}, AssertionRequest{},
+                                       &assertions),
+              StatusIs(error::GoogleError::FAILED_PRECONDITION));
+}
+
 TEST_F(SgxIntelEcdsaQeRemoteAssertionGeneratorTests,
        GenerateFailsIfNotInitialized) {
   ASSERT_FALSE(generator_.IsInitialized());
@@ -21,14 +21,22 @@
 #include <math.h>
 
 #include <algorithm>
+#include <cstdint>
 #include <iterator>
+#include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
+#include "absl/memory/memory.h"
 #include "absl/strings/escaping.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "asylo/crypto/algorithms.pb.h"
 #include "asylo/crypto/certificate.pb.h"
+#include "asylo/crypto/certificate_chain_cache.h"
 #include "asylo/crypto/certificate_interface.h"
 #include "asylo/crypto/certificate_util.h"
 #include "asylo/crypto/ecdsa_p256_sha256_signing_key.h"
@@ -40,6 +48,7 @@
 #include "asylo/crypto/util/trivial_object_util.h"
 #include "asylo/crypto/x509_certificate.h"
 #include "asylo/identity/additional_authenticated_data_generator.h"
+#include "asylo/identity/attestation/attestation_timing.h"
 #include "asylo/identity/attestation/sgx/internal/intel_ecdsa_quote.h"
 #include "asylo/identity/attestation/sgx/internal/pce_util.h"
 #include "asylo/identity/attestation/sgx/sgx_intel_ecdsa_qe_remote_assertion_authority_config.pb.h"
@@ -60,6 +69,7 @@
 #include "asylo/identity/provisioning/sgx/internal/pck_certificate_util.h"
 #include "asylo/platform/common/static_map.h"
 #include "asylo/util/error_codes.h"
+#include "asylo/util/logging.h"
 #include "asylo/util/status.h"
 #include "asylo/util/status_macros.h"
 #include "asylo/util/statusor.h"
@@ -69,6 +79,14 @@
 namespace asylo {
 namespace {
 
+// Number of verified PCK certificate chains kept by each verifier. A verifier
+// usually sees the chains of a handful of platforms.
+constexpr size_t kPckChainCacheCapacity = 32;
+
+// Number of verified platforms kept by each verifier. The verified platforms
+// are discarded once there are this many.
+constexpr size_t kVerifiedPlatformCapacity = 32;
+
 StatusOr<std::unique_ptr<EcdsaP256Sha256VerifyingKey>>
 ToEcdsaP256Sha256VerifyingKey(UnsafeBytes<64> big_endian_key_bytes) {
   EccP256CurvePoint public_key_point;
@@ -215,25 +233,24 @@ Status VerifyPckSignatureOverQuotingEnclave(const sgx::IntelQeQuote &quote) {
                       quote.cert_data.qe_cert_data_type));
 }
 
-Status VerifyPckCertificateChain(
+// Verifies the PCK certificate chain in |quote| and returns the parsed chain.
+StatusOr<std::shared_ptr<const CertificateInterfaceVector>>
+VerifyPckCertificateChain(
     const sgx::IntelQeQuote &quote,
     const std::vector<std::unique_ptr<CertificateInterface>>
-        &trusted_root_certificates) {
+        &trusted_root_certificates,
+    VerifiedCertificateChainCache *pck_chain_cache) {
   CertificateChain pck_cert_chain;
   ASYLO_ASSIGN_OR_RETURN(pck_cert_chain, GetPckCertificateChainFromCertData(
                                              quote.cert_data.qe_cert_data));
 
-  CertificateInterfaceVector certificate_chain;
-  ASYLO_ASSIGN_OR_RETURN(
-      certificate_chain,
-      CreateCertificateChain({{Certificate::X509_PEM, X509Certificate::Create}},
-                             pck_cert_chain));
-
   VerificationConfig verification_config(/*all_fields=*/true);
-  ASYLO_RETURN_IF_ERROR(
-      VerifyCertificateChain(certificate_chain, verification_config));
+  std::shared_ptr<const CertificateInterfaceVector> certificate_chain;
+  ASYLO_ASSIGN_OR_RETURN(certificate_chain,
+                         pck_chain_cache->ParseAndVerify(pck_cert_chain,
+                                                         verification_config));
 
-  const CertificateInterface &root_certificate = *certificate_chain.back();
+  const CertificateInterface &root_certificate = *certificate_chain->back();
 
   if (std::none_of(
           trusted_root_certificates.begin(), trusted_root_certificates.end(),
@@ -247,53 +264,27 @@ Status VerifyPckCertificateChain(
                      root_certificate.SubjectName().value_or("Unknown CA")));
   }
 
-  return Status::OkStatus();
+  return certificate_chain;
 }
 
-Status ParseAndAppendPeerMachineConfigurationFromPckCertChain(
-    const sgx::IntelCertData &cert_data, SgxIdentity *identity) {
-  CertificateChain pck_cert_chain;
-  ASYLO_ASSIGN_OR_RETURN(pck_cert_chain, GetPckCertificateChainFromCertData(
-                                             cert_data.qe_cert_data));
-
-  std::unique_ptr<X509Certificate> pck_cert;
-  ASYLO_ASSIGN_OR_RETURN(pck_cert, X509Certificate::Create(
-                                       *pck_cert_chain.certificates().begin()));
-
-  ASYLO_ASSIGN_OR_RETURN(
-      *identity->mutable_machine_configuration(),
-      sgx::ExtractMachineConfigurationFromPckCert(pck_cert.get()));
-
-  return Status::OkStatus();
-}
-
-Status ParseEnclaveIdentityFromQuote(const sgx::ReportBody &report_body,
-                                     const sgx::IntelCertData &cert_data,
-                                     EnclaveIdentity *enclave_identity) {
+// Returns the identity of the enclave that produced |report_body| on a machine
+// with |machine_configuration|.
+StatusOr<EnclaveIdentity> ParseEnclaveIdentityFromReport(
+    const sgx::ReportBody &report_body,
+    const sgx::MachineConfiguration &machine_configuration) {
   SgxIdentity identity = ParseSgxIdentityFromHardwareReport(report_body);
-
-  switch (cert_data.qe_cert_data_type) {
-    case PCK_CERT_CHAIN: {
-      ASYLO_RETURN_IF_ERROR(
-          ParseAndAppendPeerMachineConfigurationFromPckCertChain(cert_data,
-                                                                 &identity));
-      ASYLO_ASSIGN_OR_RETURN(*enclave_identity, SerializeSgxIdentity(identity));
-      return Status::OkStatus();
-    }
-  }
-
-  return Status(error::GoogleError::UNIMPLEMENTED,
-                absl::StrFormat("Extracting peer machine identity not "
-                                "supported for QE cert data type %d",
-                                cert_data.qe_cert_data_type));
+  *identity.mutable_machine_configuration() = machine_configuration;
+  return SerializeSgxIdentity(identity);
 }
 
 Status VerifyQeIdentityMatchesExpectation(
     const sgx::IntelQeQuote &quote,
+    const sgx::MachineConfiguration &machine_configuration,
     const IdentityAclPredicate &qe_expectation) {
   EnclaveIdentity qe_identity;
-  ASYLO_RETURN_IF_ERROR(ParseEnclaveIdentityFromQuote(
-      quote.signature.qe_report, quote.cert_data, &qe_identity));
+  ASYLO_ASSIGN_OR_RETURN(qe_identity,
+                         ParseEnclaveIdentityFromReport(
+                             quote.signature.qe_report, machine_configuration));
 
   std::string explanation;
   SgxIdentityExpectationMatcher matcher;
@@ -312,6 +303,34 @@ Status VerifyQeIdentityMatchesExpectation(
   return Status::OkStatus();
 }
 
+// Returns a digest of the parts of |quote| that identify the platform that
+// produced it: the QE report, the PCK signature over it, and the QE
+// certification data.
+std::string VerifiedPlatformKey(const sgx::IntelQeQuote &quote) {
+  Sha256Hash sha256;
+  sha256.Update(ConvertTrivialObjectToBinaryString(quote.signature.qe_report));
+  sha256.Update(
+      ConvertTrivialObjectToBinaryString(quote.signature.qe_report_signature));
+  sha256.Update(ConvertTrivialObjectToBinaryString(
+      quote.cert_data.qe_cert_data_type));
+  sha256.Update(quote.cert_data.qe_cert_data);
+
+  std::vector<uint8_t> digest;
+  CHECK(sha256.CumulativeHash(&digest).ok());
+  return std::string(digest.begin(), digest.end());
+}
+
+// Returns true if every certificate in |chain| is valid at |time|.
+bool WithinValidityPeriod(const CertificateInterfaceVector &chain,
+                          absl::Time time) {
+  return std::all_of(
+      chain.begin(), chain.end(),
+      [time](const std::unique_ptr<CertificateInterface> &certificate) {
+        StatusOr<bool> within_period = certificate->WithinValidityPeriod(time);
+        return within_period.ok() && within_period.ValueOrDie();
+      });
+}
+
 }  // namespace
 
 SgxIntelEcdsaQeRemoteAssertionVerifier::SgxIntelEcdsaQeRemoteAssertionVerifier()
@@ -320,7 +339,11 @@ SgxIntelEcdsaQeRemoteAssertionVerifier::SgxIntelEcdsaQeRemoteAssertionVerifier()
 
 SgxIntelEcdsaQeRemoteAssertionVerifier::SgxIntelEcdsaQeRemoteAssertionVerifier(
     std::unique_ptr<AdditionalAuthenticatedDataGenerator> aad_generator)
-    : members_(Members(std::move(aad_generator))) {}
+    : members_(Members(std::move(aad_generator))),
+      pck_chain_cache_(absl::make_unique<VerifiedCertificateChainCache>(
+          CertificateFactoryMap(
+              {{Certificate::X509_PEM, X509Certificate::Create}}),
+          kPckChainCacheCapacity)) {}
 
 Status SgxIntelEcdsaQeRemoteAssertionVerifier::Initialize(
     const std::string &serialized_config) {
@@ -403,18 +426,67 @@ Status SgxIntelEcdsaQeRemoteAssertionVerifier::Verify(
   ASYLO_RETURN_IF_ERROR(
       VerifyQuoteBodySignature(*members_view->aad_generator, user_data, quote));
   ASYLO_RETURN_IF_ERROR(VerifyQeReportDataMatchesQuoteSigningKey(quote));
-  ASYLO_RETURN_IF_ERROR(VerifyPckSignatureOverQuotingEnclave(quote));
-  ASYLO_RETURN_IF_ERROR(
-      VerifyPckCertificateChain(quote, members_view->root_certificates));
-  ASYLO_RETURN_IF_ERROR(VerifyQeIdentityMatchesExpectation(
-      quote, members_view->qe_identity_expectation));
 
-  ASYLO_RETURN_IF_ERROR(ParseEnclaveIdentityFromQuote(
-      quote.body, quote.cert_data, peer_identity));
+  std::shared_ptr<const VerifiedPlatform> platform;
+  ASYLO_ASSIGN_OR_RETURN(platform, GetVerifiedPlatform(quote, *members_view));
+
+  ASYLO_ASSIGN_OR_RETURN(*peer_identity,
+                         ParseEnclaveIdentityFromReport(
+                             quote.body, platform->machine_configuration));
 
   return Status::OkStatus();
 }
 
+StatusOr<std::shared_ptr<
+    const SgxIntelEcdsaQeRemoteAssertionVerifier::VerifiedPlatform>>
+SgxIntelEcdsaQeRemoteAssertionVerifier::GetVerifiedPlatform(
+    const sgx::IntelQeQuote &quote, const Members &members) const {
+  // Quotes from the same platform share their QE report and certification
+  // data, so the checks over them only run once per platform. They run again
+  // once a certificate in the PCK certificate chain expires.
+  std::string key = VerifiedPlatformKey(quote);
+  std::shared_ptr<const VerifiedPlatform> cached;
+  {
+    auto verified_platforms = verified_platforms_.ReaderLock();
+    auto it = verified_platforms->find(key);
+    if (it != verified_platforms->end()) {
+      cached = it->second;
+    }
+  }
+  if (cached && WithinValidityPeriod(*cached->pck_chain, absl::Now())) {
+    return cached;
+  }
+
+  ASYLO_RETURN_IF_ERROR(VerifyPckSignatureOverQuotingEnclave(quote));
+
+  auto platform = std::make_shared<VerifiedPlatform>();
+  {
+    ScopedAttestationTimer timer(sgx::kSgxIntelEcdsaQeRemoteAssertionAuthority,
+                                 AttestationPhase::kChainVerify);
+    ASYLO_ASSIGN_OR_RETURN(
+        platform->pck_chain,
+        VerifyPckCertificateChain(quote, members.root_certificates,
+                                  pck_chain_cache_.get()));
+  }
+  ASYLO_ASSIGN_OR_RETURN(platform->machine_configuration,
+                         sgx::ExtractMachineConfigurationFromPckCert(
+                             platform->pck_chain->front().get()));
+  {
+    ScopedAttestationTimer timer(sgx::kSgxIntelEcdsaQeRemoteAssertionAuthority,
+                                 AttestationPhase::kAclEvaluation);
+    ASYLO_RETURN_IF_ERROR(VerifyQeIdentityMatchesExpectation(
+        quote, platform->machine_configuration,
+        members.qe_identity_expectation));
+  }
+
+  auto verified_platforms = verified_platforms_.Lock();
+  if (verified_platforms->size() >= kVerifiedPlatformCapacity) {
+    verified_platforms->clear();
+  }
+  verified_platforms->insert_or_assign(key, platform);
+  return std::shared_ptr<const VerifiedPlatform>(std::move(platform));
+}
+
 Status SgxIntelEcdsaQeRemoteAssertionVerifier::CheckInitialization(
     absl::string_view caller) const {
   return IsInitialized()
@@ -25,6 +25,8 @@
 #include <utility>
 #include <vector>
 
+#include "absl/container/flat_hash_map.h"
+#include "asylo/crypto/certificate_chain_cache.h"
 #include "asylo/crypto/certificate_interface.h"
 #include "asylo/identity/additional_authenticated_data_generator.h"
 #include "asylo/identity/attestation/enclave_assertion_verifier.h"
@@ -33,6 +35,7 @@
 #include "asylo/identity/identity.pb.h"
 #include "asylo/identity/identity_acl.pb.h"
 #include "asylo/identity/platform/sgx/internal/code_identity_constants.h"
+#include "asylo/identity/platform/sgx/machine_configuration.pb.h"
 #include "asylo/identity/platform/sgx/sgx_identity.pb.h"
 #include "asylo/platform/common/static_map.h"
 #include "asylo/util/mutex_guarded.h"
@@ -40,6 +43,11 @@
 #include "asylo/util/statusor.h"
 
 namespace asylo {
+namespace sgx {
+
+struct IntelQeQuote;
+
+}  // namespace sgx
 
 /// Implementation of `EnclaveAssertionVerifier` that verifiers assertions
 /// generated by the Intel ECDSA quoting enclave. These assertions attest,
@@ -85,9 +93,35 @@ class SgxIntelEcdsaQeRemoteAssertionVerifier : public EnclaveAssertionVerifier {
     IdentityAclPredicate qe_identity_expectation;
   };
 
+  // The results of the checks that only depend on the platform that produced a
+  // quote: the PCK signature over the QE report, the PCK certificate chain, and
+  // the QE identity.
+  struct VerifiedPlatform {
+    // The verified PCK certificate chain.
+    std::shared_ptr<const CertificateInterfaceVector> pck_chain;
+
+    // The machine configuration from the PCK certificate.
+    sgx::MachineConfiguration machine_configuration;
+  };
+
+  using VerifiedPlatformMap =
+      absl::flat_hash_map<std::string, std::shared_ptr<const VerifiedPlatform>>;
+
   Status CheckInitialization(absl::string_view caller) const;
 
+  // Returns the platform checks for |quote|, running them with |members| if
+  // they did not pass before or the PCK certificate chain has since expired.
+  StatusOr<std::shared_ptr<const VerifiedPlatform>> GetVerifiedPlatform(
+      const sgx::IntelQeQuote &quote, const Members &members) const;
+
   MutexGuarded<Members> members_;
+
+  // Cache of verified PCK certificate chains. It is synchronized internally.
+  std::unique_ptr<VerifiedCertificateChainCache> pck_chain_cache_;
+
+  // Platforms that passed the platform checks, keyed by a digest of the QE
+  // report, its signature, and the QE certification data.
+  mutable MutexGuarded<VerifiedPlatformMap> verified_platforms_;
 };
 
 }  // namespace asylo
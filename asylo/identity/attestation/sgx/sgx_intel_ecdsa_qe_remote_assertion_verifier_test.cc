@@ -629,5 +629,40 @@ TEST_F(SgxIntelEcdsaQeRemoteAssertionVerifierTest, VerifySuccess) {
             quote.body.isvsvn);
 }
 
+TEST_F(SgxIntelEcdsaQeRemoteAssertionVerifierTest,
+       VerifyChecksEachQuoteFromAVerifiedPlatform) {
+  SgxIntelEcdsaQeRemoteAssertionVerifier verifier;
+  ASYLO_ASSERT_OK(verifier.Initialize(valid_config_));
+
+  EnclaveIdentity identity;
+  ASYLO_ASSERT_OK(verifier.Verify(
+      "first data", CreateAssertion(GenerateValidQuote("first data")),
+      &identity));
+
+  // Quotes from the same platform reuse the platform checks, but their own
+  // contents are still checked.
+  sgx::IntelQeQuote quote = GenerateValidQuote("second data");
+  ASYLO_ASSERT_OK(
+      verifier.Verify("second data", CreateAssertion(quote), &identity));
+
+  SgxIdentity peer_identity;
+  ASYLO_ASSERT_OK_AND_ASSIGN(peer_identity, ParseSgxIdentity(identity));
+  sgx::MachineConfiguration fake_pck_machine_config =
+      ParseTextProtoOrDie(sgx::kFakePckMachineConfigurationTextProto);
+  EXPECT_THAT(peer_identity.machine_configuration(),
+              EqualsProto(fake_pck_machine_config));
+  EXPECT_THAT(peer_identity.code_identity().mrenclave().hash().data(),
+              MemEq(quote.body.mrenclave.data(), quote.body.mrenclave.size()));
+
+  EXPECT_THAT(
+      verifier.Verify("other data", CreateAssertion(quote), &identity),
+      StatusIs(error::GoogleError::INVALID_ARGUMENT));
+
+  quote.signature.body_signature[0] ^= 0xff;
+  EXPECT_THAT(
+      verifier.Verify("second data", CreateAssertion(quote), &identity),
+      StatusIs(error::GoogleError::INTERNAL, HasSubstr("BAD_SIGNATURE")));
+}
+
 }  // namespace
 }  // namespace asylo
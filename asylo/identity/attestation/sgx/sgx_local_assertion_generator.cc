@@ -23,6 +23,7 @@
 #include "asylo/crypto/sha256_hash.h"
 #include "asylo/crypto/util/bytes.h"
 #include "asylo/crypto/util/trivial_object_util.h"
+#include "asylo/identity/attestation/attestation_timing.h"
 #include "asylo/identity/attestation/sgx/internal/local_assertion.pb.h"
 #include "asylo/identity/attestation/sgx/sgx_local_assertion_authority_config.pb.h"
 #include "asylo/identity/platform/sgx/internal/code_identity_constants.h"
@@ -166,9 +167,13 @@ Status SgxLocalAssertionGenerator::Generate(const std::string &user_data,
   // Generate a REPORT that is bound to the provided |user_data| and is targeted
   // at the enclave described in the request.
   sgx::Report report;
-  ASYLO_ASSIGN_OR_RETURN(
-      report,
-      sgx::HardwareInterface::CreateDefault()->GetReport(*tinfo, *reportdata));
+  {
+    ScopedAttestationTimer timer(sgx::kSgxLocalAssertionAuthority,
+                                 AttestationPhase::kEreport);
+    ASYLO_ASSIGN_OR_RETURN(report,
+                           sgx::HardwareInterface::CreateDefault()->GetReport(
+                               *tinfo, *reportdata));
+  }
 
   // As explained above, the REPORT structure can be copied byte-for-byte into
   // the report field of the assertion because the layout and endianness of the
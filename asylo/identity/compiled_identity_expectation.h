@@ -0,0 +1,122 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_IDENTITY_COMPILED_IDENTITY_EXPECTATION_H_
+#define ASYLO_IDENTITY_COMPILED_IDENTITY_EXPECTATION_H_
+
+#include <memory>
+#include <string>
+
+#include <google/protobuf/message.h>
+#include "absl/base/thread_annotations.h"
+#include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
+#include "asylo/identity/identity.pb.h"
+#include "asylo/util/status.h"
+#include "asylo/util/status_macros.h"
+#include "asylo/util/statusor.h"
+
+namespace asylo {
+
+/// An `EnclaveIdentity` that remembers its platform-specific parsed form.
+///
+/// Matching an identity against an expectation usually requires parsing the
+/// serialized identity into a platform-specific proto. A
+/// `ParsedEnclaveIdentity` parses the identity the first time a
+/// `CompiledIdentityExpectation` asks for it, and hands out the same parsed
+/// form to all later matches, so a peer identity can be matched against many
+/// expectations while being parsed only once.
+///
+/// This class is thread-safe.
+class ParsedEnclaveIdentity {
+ public:
+  /// Wraps `identity`.
+  ///
+  /// \param identity The identity to wrap.
+  explicit ParsedEnclaveIdentity(EnclaveIdentity identity)
+      : identity_(std::move(identity)) {}
+
+  ParsedEnclaveIdentity(const ParsedEnclaveIdentity &other) = delete;
+  ParsedEnclaveIdentity &operator=(const ParsedEnclaveIdentity &other) = delete;
+
+  /// Returns the wrapped identity.
+  const EnclaveIdentity &identity() const { return identity_; }
+
+  /// Returns the identity parsed as a `T` proto. On the first call, the
+  /// identity is parsed with `parse`, which must be callable as
+  /// `Status(const EnclaveIdentity &, T *)`. Later calls return the same
+  /// object without calling `parse`. Parse failures are not remembered.
+  ///
+  /// \param parse The function that parses the identity.
+  /// \return A pointer to the parsed identity, which is valid for the lifetime
+  ///         of this object, or a non-OK Status if parsing failed or if the
+  ///         identity was already parsed as a different type.
+  template <typename T, typename ParseFunction>
+  StatusOr<const T *> GetOrParse(ParseFunction parse) const {
+    absl::MutexLock lock(&mu_);
+    if (parsed_ == nullptr) {
+      auto parsed = absl::make_unique<T>();
+      ASYLO_RETURN_IF_ERROR(parse(identity_, parsed.get()));
+      parsed_ = std::move(parsed);
+    }
+    if (parsed_->GetDescriptor() != T::descriptor()) {
+      return Status(error::GoogleError::INTERNAL,
+                    "Identity was already parsed as a different type");
+    }
+    return static_cast<const T *>(parsed_.get());
+  }
+
+ private:
+  const EnclaveIdentity identity_;
+
+  mutable absl::Mutex mu_;
+
+  // The parsed identity. Never replaced once set.
+  mutable std::unique_ptr<google::protobuf::Message> parsed_
+      ABSL_GUARDED_BY(mu_);
+};
+
+/// An `EnclaveIdentityExpectation` that has been validated and converted into
+/// a form that can be matched against identities without parsing the
+/// expectation again. Instances are created by
+/// `IdentityExpectationMatcher::CompileExpectation()`.
+///
+/// All implementations of this interface are expected to be thread-safe.
+class CompiledIdentityExpectation {
+ public:
+  virtual ~CompiledIdentityExpectation() = default;
+
+  /// Evaluates whether `identity` matches the compiled expectation. Gives the
+  /// same result as `IdentityExpectationMatcher::MatchAndExplain()` with the
+  /// source expectation.
+  ///
+  /// \param identity An identity to match.
+  /// \param[out] explanation An explanation of why the match failed, if the
+  ///                         return value was false.
+  /// \return A bool indicating whether the match succeeded, or a non-OK Status
+  ///         in the case of invalid arguments.
+  virtual StatusOr<bool> MatchAndExplain(const ParsedEnclaveIdentity &identity,
+                                         std::string *explanation) const = 0;
+
+  /// Returns the expectation this object was compiled from.
+  virtual const EnclaveIdentityExpectation &expectation() const = 0;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_IDENTITY_COMPILED_IDENTITY_EXPECTATION_H_
@@ -18,13 +18,82 @@
 
 #include "asylo/identity/delegating_identity_expectation_matcher.h"
 
+#include <memory>
+#include <string>
+#include <utility>
+
 #include <google/protobuf/util/message_differencer.h>
+#include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "asylo/identity/named_identity_expectation_matcher.h"
 #include "asylo/platform/common/static_map.h"
+#include "asylo/util/status_macros.h"
 
 namespace asylo {
+namespace {
+
+// Returns true if a matcher for |description| is registered in the
+// IdentityExpectationMatcherMap.
+bool HasMatcher(const EnclaveIdentityDescription &description) {
+  return IdentityExpectationMatcherMap::GetValue(
+             NamedIdentityExpectationMatcher::GetMatcherName(description)
+                 .ValueOrDie()) != IdentityExpectationMatcherMap::value_end();
+}
+
+// Sets |explanation|, if non-null, to explain that the descriptions of
+// |identity| and |reference_identity| differ.
+void ExplainDescriptionMismatch(const EnclaveIdentity &identity,
+                                const EnclaveIdentity &reference_identity,
+                                std::string *explanation) {
+  if (explanation != nullptr) {
+    *explanation = absl::StrFormat(
+        "Matched identity, which has description %s, is incompatible with "
+        "reference identity, which has description %s",
+        identity.description().ShortDebugString(),
+        reference_identity.description().ShortDebugString());
+  }
+}
+
+// A compiled expectation that checks the description of the matched identity
+// before handing it to the expectation compiled by the matcher for the
+// reference identity.
+class DelegatingCompiledIdentityExpectation
+    : public CompiledIdentityExpectation {
+ public:
+  explicit DelegatingCompiledIdentityExpectation(
+      std::unique_ptr<CompiledIdentityExpectation> delegate)
+      : delegate_(std::move(delegate)) {}
+
+  StatusOr<bool> MatchAndExplain(const ParsedEnclaveIdentity &identity,
+                                 std::string *explanation) const override {
+    const EnclaveIdentity &reference_identity =
+        delegate_->expectation().reference_identity();
+    if (!::google::protobuf::util::MessageDifferencer::Equivalent(
+            identity.identity().description(),
+            reference_identity.description())) {
+      if (!HasMatcher(identity.identity().description())) {
+        return Status(
+            error::GoogleError::INTERNAL,
+            absl::StrCat("No matcher exists for identity with description ",
+                         identity.identity().description().ShortDebugString()));
+      }
+      ExplainDescriptionMismatch(identity.identity(), reference_identity,
+                                 explanation);
+      return false;
+    }
+    return delegate_->MatchAndExplain(identity, explanation);
+  }
+
+  const EnclaveIdentityExpectation &expectation() const override {
+    return delegate_->expectation();
+  }
+
+ private:
+  const std::unique_ptr<CompiledIdentityExpectation> delegate_;
+};
+
+}  // namespace
 
 StatusOr<bool> DelegatingIdentityExpectationMatcher::MatchAndExplain(
     const EnclaveIdentity &identity,
@@ -50,10 +119,7 @@ StatusOr<bool> DelegatingIdentityExpectationMatcher::MatchAndExplain(
     // IdentityExpectationMatcherMap. If a compatible matcher cannot be found,
     // then |expectation| is considered to have a description that is
     // unrecognized by this matcher.
-    if (IdentityExpectationMatcherMap::GetValue(
-            NamedIdentityExpectationMatcher::GetMatcherName(
-                expectation.reference_identity().description())
-                .ValueOrDie()) == IdentityExpectationMatcherMap::value_end()) {
+    if (!HasMatcher(expectation.reference_identity().description())) {
       return Status(error::GoogleError::INTERNAL,
                     absl::StrCat("No matcher exists for matching expectation "
                                  "with reference-identity description ",
@@ -69,17 +135,34 @@ StatusOr<bool> DelegatingIdentityExpectationMatcher::MatchAndExplain(
     // This matcher may be used to compare an identity against multiple
     // expectations with differing reference-identity descriptions. Returning a
     // non-ok status here would break that comparison logic.
-    if (explanation != nullptr) {
-      *explanation = absl::StrFormat(
-          "Matched identity, which has description %s, is incompatible with "
-          "reference identity, which has description %s",
-          identity.description().ShortDebugString(),
-          expectation.reference_identity().description().ShortDebugString());
-    }
+    ExplainDescriptionMismatch(identity, expectation.reference_identity(),
+                               explanation);
     return false;
   }
 
   return matcher_it->MatchAndExplain(identity, expectation, explanation);
 }
 
+StatusOr<std::unique_ptr<CompiledIdentityExpectation>>
+DelegatingIdentityExpectationMatcher::CompileExpectation(
+    const EnclaveIdentityExpectation &expectation) const {
+  const EnclaveIdentityDescription &description =
+      expectation.reference_identity().description();
+  auto matcher_it = IdentityExpectationMatcherMap::GetValue(
+      NamedIdentityExpectationMatcher::GetMatcherName(description)
+          .ValueOrDie());
+  if (matcher_it == IdentityExpectationMatcherMap::value_end()) {
+    return Status(error::GoogleError::INTERNAL,
+                  absl::StrCat("No matcher exists for matching expectation "
+                               "with reference-identity description ",
+                               description.ShortDebugString()));
+  }
+
+  std::unique_ptr<CompiledIdentityExpectation> delegate;
+  ASYLO_ASSIGN_OR_RETURN(delegate, matcher_it->CompileExpectation(expectation));
+  return std::unique_ptr<CompiledIdentityExpectation>(
+      absl::make_unique<DelegatingCompiledIdentityExpectation>(
+          std::move(delegate)));
+}
+
 }  // namespace asylo
@@ -19,6 +19,7 @@
 #ifndef ASYLO_IDENTITY_DELEGATING_IDENTITY_EXPECTATION_MATCHER_H_
 #define ASYLO_IDENTITY_DELEGATING_IDENTITY_EXPECTATION_MATCHER_H_
 
+#include <memory>
 #include <string>
 
 #include "asylo/identity/identity.pb.h"
@@ -37,6 +38,11 @@ namespace asylo {
 // non-ok status, indicating that |identity| and/or |expectation| is not
 // recognized by the matcher. These checks are performed to make sure that the
 // program has linked in all the necessary matcher libraries.
+//
+// CompileExpectation() looks up the matcher for |expectation| once and returns
+// that matcher's compiled form of |expectation|, so matching a compiled
+// expectation only consults the static map when the matched identity has a
+// different description than the reference identity.
 class DelegatingIdentityExpectationMatcher final
     : public IdentityExpectationMatcher {
  public:
@@ -44,6 +50,9 @@ class DelegatingIdentityExpectationMatcher final
   StatusOr<bool> MatchAndExplain(const EnclaveIdentity &identity,
                                  const EnclaveIdentityExpectation &expectation,
                                  std::string *explanation) const override;
+
+  StatusOr<std::unique_ptr<CompiledIdentityExpectation>> CompileExpectation(
+      const EnclaveIdentityExpectation &expectation) const override;
 };
 
 }  // namespace asylo
@@ -0,0 +1,93 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/identity/enclave_assertion_authority_warm_start.h"
+
+#include <cstdint>
+#include <string>
+
+#include "asylo/crypto/util/byte_container_view.h"
+#include "asylo/identity/enclave_assertion_authority_config.pb.h"
+#include "asylo/identity/init.h"
+#include "asylo/identity/sealing/sealed_secret.pb.h"
+#include "asylo/identity/sealing/secret_sealer.h"
+#include "asylo/util/cleansing_types.h"
+#include "asylo/util/status.h"
+#include "asylo/util/status_macros.h"
+#include "asylo/util/statusor.h"
+
+namespace asylo {
+
+const char kEnclaveAssertionAuthorityWarmStartSecretName[] =
+    "Asylo enclave assertion authority warm-start state";
+
+namespace {
+
+constexpr char kWarmStartSecretVersion[] = "1";
+
+// Binds the sealed state to its use, so that other secrets sealed by the same
+// sealer cannot be passed off as warm-start state.
+constexpr char kWarmStartAdditionalAuthenticatedData[] =
+    "EnclaveAssertionAuthorityWarmStartState";
+
+}  // namespace
+
+StatusOr<SealedSecret> SealEnclaveAssertionAuthorityWarmStartState(
+    const EnclaveAssertionAuthorityWarmStartState &state,
+    SecretSealer *sealer) {
+  SealedSecretHeader header;
+  ASYLO_RETURN_IF_ERROR(sealer->SetDefaultHeader(&header));
+  header.set_secret_name(kEnclaveAssertionAuthorityWarmStartSecretName);
+  header.set_secret_version(kWarmStartSecretVersion);
+
+  CleansingVector<uint8_t> serialized_state(state.ByteSizeLong());
+  if (!state.SerializeToArray(serialized_state.data(),
+                              serialized_state.size())) {
+    return Status(error::GoogleError::INTERNAL,
+                  "Failed to serialize warm-start state");
+  }
+
+  SealedSecret warm_start;
+  ASYLO_RETURN_IF_ERROR(sealer->Seal(header,
+                                     kWarmStartAdditionalAuthenticatedData,
+                                     serialized_state, &warm_start));
+  return warm_start;
+}
+
+Status InitializeEnclaveAssertionAuthoritiesFromWarmStart(
+    const SealedSecret &warm_start, SecretSealer *sealer) {
+  if (warm_start.additional_authenticated_data() !=
+      kWarmStartAdditionalAuthenticatedData) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Sealed secret does not hold warm-start state");
+  }
+
+  CleansingVector<uint8_t> serialized_state;
+  ASYLO_RETURN_IF_ERROR(sealer->Unseal(warm_start, &serialized_state));
+
+  EnclaveAssertionAuthorityWarmStartState state;
+  if (!state.ParseFromArray(serialized_state.data(),
+                            serialized_state.size())) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Failed to parse warm-start state");
+  }
+  return InitializeEnclaveAssertionAuthorities(state.configs().begin(),
+                                               state.configs().end());
+}
+
+}  // namespace asylo
@@ -0,0 +1,75 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_IDENTITY_ENCLAVE_ASSERTION_AUTHORITY_WARM_START_H_
+#define ASYLO_IDENTITY_ENCLAVE_ASSERTION_AUTHORITY_WARM_START_H_
+
+#include "asylo/identity/enclave_assertion_authority_config.pb.h"
+#include "asylo/identity/sealing/sealed_secret.pb.h"
+#include "asylo/identity/sealing/secret_sealer.h"
+#include "asylo/util/status.h"
+#include "asylo/util/statusor.h"
+
+namespace asylo {
+
+// The name of the secret in warm-start blobs created by
+// SealEnclaveAssertionAuthorityWarmStartState().
+extern const char kEnclaveAssertionAuthorityWarmStartSecretName[];
+
+// Seals |state| with |sealer| into a warm-start blob. The blob can later be
+// passed to InitializeEnclaveAssertionAuthoritiesFromWarmStart() by any enclave
+// that |sealer| allows to unseal it.
+//
+// The configs in |state| should be ones that were already used to initialize
+// authorities successfully, such as those passed to a successful call to
+// InitializeEnclaveAssertionAuthorities().
+StatusOr<SealedSecret> SealEnclaveAssertionAuthorityWarmStartState(
+    const EnclaveAssertionAuthorityWarmStartState &state,
+    SecretSealer *sealer);
+
+// Seals the configs in the range [|configs_begin|, |configs_end|) into a
+// warm-start blob as SealEnclaveAssertionAuthorityWarmStartState() does.
+// ConfigIteratorT must satisfy the constraints described for
+// InitializeEnclaveAssertionAuthorities().
+template <class ConfigIteratorT>
+StatusOr<SealedSecret> SealEnclaveAssertionAuthorityConfigs(
+    ConfigIteratorT configs_begin, ConfigIteratorT configs_end,
+    SecretSealer *sealer) {
+  EnclaveAssertionAuthorityWarmStartState state;
+  for (auto it = configs_begin; it != configs_end; ++it) {
+    *state.add_configs() = *it;
+  }
+  return SealEnclaveAssertionAuthorityWarmStartState(state, sealer);
+}
+
+// Unseals the warm-start blob |warm_start| with |sealer| and initializes the
+// assertion authorities with the configs in it, as
+// InitializeEnclaveAssertionAuthorities() does.
+//
+// This function will return a non-ok status if |warm_start| cannot be unsealed
+// by |sealer|, was not created by
+// SealEnclaveAssertionAuthorityWarmStartState(), or if
+// InitializeEnclaveAssertionAuthorities() fails with its configs. Callers can
+// then fall back to initializing the authorities from configs supplied by
+// the host.
+Status InitializeEnclaveAssertionAuthoritiesFromWarmStart(
+    const SealedSecret &warm_start, SecretSealer *sealer);
+
+}  // namespace asylo
+
+#endif  // ASYLO_IDENTITY_ENCLAVE_ASSERTION_AUTHORITY_WARM_START_H_
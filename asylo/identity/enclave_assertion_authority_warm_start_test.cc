@@ -0,0 +1,177 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/identity/enclave_assertion_authority_warm_start.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "asylo/crypto/util/byte_container_util.h"
+#include "asylo/crypto/util/byte_container_view.h"
+#include "asylo/identity/attestation/enclave_assertion_generator.h"
+#include "asylo/identity/attestation/enclave_assertion_verifier.h"
+#include "asylo/identity/enclave_assertion_authority.h"
+#include "asylo/identity/enclave_assertion_authority_config.pb.h"
+#include "asylo/identity/identity.pb.h"
+#include "asylo/identity/sealing/sealed_secret.pb.h"
+#include "asylo/identity/sealing/secret_sealer.h"
+#include "asylo/test/util/status_matchers.h"
+#include "asylo/util/cleansing_types.h"
+#include "asylo/util/proto_parse_util.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+namespace {
+
+using ::testing::Eq;
+using ::testing::Not;
+
+constexpr char kNullConfig[] = R"proto(
+  description: { identity_type: NULL_IDENTITY authority_type: "Any" }
+  config: "Warm regards"
+)proto";
+
+constexpr char kInvalidConfig[] = R"proto(
+  description: { identity_type: CODE_IDENTITY authority_type: "foobar" }
+  config: "Cold feet"
+)proto";
+
+// A SecretSealer that "seals" secrets by storing them in the clear. It only
+// exists to exercise the handling of warm-start blobs.
+class PlaintextSecretSealer : public SecretSealer {
+ public:
+  SealingRootType RootType() const override { return LOCAL; }
+
+  std::string RootName() const override { return "PLAINTEXT"; }
+
+  std::vector<EnclaveIdentityExpectation> RootAcl() const override {
+    return {};
+  }
+
+  Status SetDefaultHeader(SealedSecretHeader *header) const override {
+    header->mutable_root_info()->set_sealing_root_type(RootType());
+    header->mutable_root_info()->set_sealing_root_name(RootName());
+    return Status::OkStatus();
+  }
+
+  StatusOr<size_t> MaxMessageSize(
+      const SealedSecretHeader &header) const override {
+    return static_cast<size_t>(1 << 20);
+  }
+
+  StatusOr<uint64_t> MaxSealedMessages(
+      const SealedSecretHeader &header) const override {
+    return static_cast<uint64_t>(1) << 32;
+  }
+
+  Status Seal(const SealedSecretHeader &header,
+              ByteContainerView additional_authenticated_data,
+              ByteContainerView secret, SealedSecret *sealed_secret) override {
+    if (!header.SerializeToString(
+            sealed_secret->mutable_sealed_secret_header())) {
+      return Status(error::GoogleError::INTERNAL, "Bad header");
+    }
+    sealed_secret->set_additional_authenticated_data(
+        CopyToByteContainer<std::string>(additional_authenticated_data));
+    sealed_secret->set_secret_ciphertext(
+        CopyToByteContainer<std::string>(secret));
+    return Status::OkStatus();
+  }
+
+  Status Unseal(const SealedSecret &sealed_secret,
+                CleansingVector<uint8_t> *secret) override {
+    secret->assign(sealed_secret.secret_ciphertext().begin(),
+                   sealed_secret.secret_ciphertext().end());
+    return Status::OkStatus();
+  }
+};
+
+TEST(EnclaveAssertionAuthorityWarmStartTest, SealedHeaderNamesTheState) {
+  std::vector<EnclaveAssertionAuthorityConfig> configs = {
+      ParseTextProtoOrDie(kNullConfig)};
+  PlaintextSecretSealer sealer;
+
+  SealedSecret warm_start;
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      warm_start, SealEnclaveAssertionAuthorityConfigs(configs.begin(),
+                                                       configs.end(), &sealer));
+
+  SealedSecretHeader header;
+  ASSERT_TRUE(header.ParseFromString(warm_start.sealed_secret_header()));
+  EXPECT_THAT(header.secret_name(),
+              Eq(kEnclaveAssertionAuthorityWarmStartSecretName));
+  EXPECT_THAT(header.root_info().sealing_root_name(), Eq("PLAINTEXT"));
+}
+
+TEST(EnclaveAssertionAuthorityWarmStartTest, WarmStartInitializesAuthorities) {
+  std::vector<EnclaveAssertionAuthorityConfig> configs = {
+      ParseTextProtoOrDie(kNullConfig)};
+  PlaintextSecretSealer sealer;
+
+  SealedSecret warm_start;
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      warm_start, SealEnclaveAssertionAuthorityConfigs(configs.begin(),
+                                                       configs.end(), &sealer));
+  ASYLO_ASSERT_OK(
+      InitializeEnclaveAssertionAuthoritiesFromWarmStart(warm_start, &sealer));
+
+  std::string authority_id;
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      authority_id, EnclaveAssertionAuthority::GenerateAuthorityId(
+                        configs[0].description().identity_type(),
+                        configs[0].description().authority_type()));
+  auto generator_it = AssertionGeneratorMap::GetValue(authority_id);
+  ASSERT_NE(generator_it, AssertionGeneratorMap::value_end());
+  EXPECT_TRUE(generator_it->IsInitialized());
+  auto verifier_it = AssertionVerifierMap::GetValue(authority_id);
+  ASSERT_NE(verifier_it, AssertionVerifierMap::value_end());
+  EXPECT_TRUE(verifier_it->IsInitialized());
+}
+
+TEST(EnclaveAssertionAuthorityWarmStartTest, WarmStartFailsWithInvalidConfigs) {
+  std::vector<EnclaveAssertionAuthorityConfig> configs = {
+      ParseTextProtoOrDie(kInvalidConfig)};
+  PlaintextSecretSealer sealer;
+
+  SealedSecret warm_start;
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      warm_start, SealEnclaveAssertionAuthorityConfigs(configs.begin(),
+                                                       configs.end(), &sealer));
+  EXPECT_THAT(
+      InitializeEnclaveAssertionAuthoritiesFromWarmStart(warm_start, &sealer),
+      Not(IsOk()));
+}
+
+TEST(EnclaveAssertionAuthorityWarmStartTest, WarmStartRejectsOtherSecrets) {
+  PlaintextSecretSealer sealer;
+  SealedSecretHeader header;
+  ASYLO_ASSERT_OK(sealer.SetDefaultHeader(&header));
+
+  SealedSecret other_secret;
+  ASYLO_ASSERT_OK(sealer.Seal(header, "Some other purpose", "Not a state",
+                              &other_secret));
+  EXPECT_THAT(
+      InitializeEnclaveAssertionAuthoritiesFromWarmStart(other_secret, &sealer),
+      StatusIs(error::GoogleError::INVALID_ARGUMENT));
+}
+
+}  // namespace
+}  // namespace asylo
@@ -18,15 +18,20 @@
 
 #include "asylo/identity/identity_acl_evaluator.h"
 
+#include <cstdint>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include <google/protobuf/repeated_field.h>
+#include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_join.h"
+#include "asylo/crypto/sha256_hash.h"
+#include "asylo/crypto/util/byte_container_view.h"
 #include "asylo/util/status.h"
+#include "asylo/util/status_macros.h"
 
 namespace asylo {
 namespace {
@@ -228,6 +233,30 @@ StatusOr<bool> EvaluateIdentityAclImpl(
   }
 }
 
+// Returns the cache key of |identities| for CompiledIdentityAcl, which is the
+// SHA-256 digest of the length-prefixed serializations of |identities|.
+StatusOr<std::string> DigestIdentities(
+    const std::vector<EnclaveIdentity> &identities) {
+  Sha256Hash hash;
+  std::string serialized;
+  for (const EnclaveIdentity &identity : identities) {
+    if (!identity.SerializeToString(&serialized)) {
+      return Status(error::GoogleError::INTERNAL,
+                    "Failed to serialize EnclaveIdentity");
+    }
+    uint8_t length[sizeof(uint64_t)];
+    for (size_t i = 0; i < sizeof(length); ++i) {
+      length[i] = static_cast<uint8_t>(serialized.size() >> (8 * i));
+    }
+    hash.Update(ByteContainerView(length, sizeof(length)));
+    hash.Update(serialized);
+  }
+
+  std::vector<uint8_t> digest;
+  ASYLO_RETURN_IF_ERROR(hash.CumulativeHash(&digest));
+  return std::string(digest.begin(), digest.end());
+}
+
 }  // namespace
 
 StatusOr<bool> EvaluateIdentityAcl(
@@ -242,4 +271,205 @@ StatusOr<bool> EvaluateIdentityAcl(
   return result;
 }
 
+constexpr size_t CompiledIdentityAcl::kDefaultVerdictCacheCapacity;
+
+StatusOr<std::unique_ptr<CompiledIdentityAcl>> CompiledIdentityAcl::Create(
+    const IdentityAclPredicate &acl, size_t verdict_cache_capacity) {
+  auto compiled = absl::WrapUnique(
+      new CompiledIdentityAcl(acl, verdict_cache_capacity));
+  ASYLO_RETURN_IF_ERROR(compiled->Compile(compiled->acl_));
+  return std::move(compiled);
+}
+
+CompiledIdentityAcl::CompiledIdentityAcl(const IdentityAclPredicate &acl,
+                                         size_t verdict_cache_capacity)
+    : acl_(acl), verdict_cache_capacity_(verdict_cache_capacity) {}
+
+Status CompiledIdentityAcl::Compile(const IdentityAclPredicate &predicate) {
+  size_t index = program_.size();
+  switch (predicate.item_case()) {
+    case IdentityAclPredicate::kExpectation:
+      program_.push_back({Instruction::kExpectation, 1,
+                          &predicate.expectation()});
+      return Status::OkStatus();
+    case IdentityAclPredicate::kAclGroup:
+      break;
+    case IdentityAclPredicate::ITEM_NOT_SET:
+      return Status(
+          error::GoogleError::INVALID_ARGUMENT,
+          "Invalid ACL predicate: must be either a group or an expectation.");
+    default:
+      return Status(error::GoogleError::INVALID_ARGUMENT,
+                    absl::StrCat("Unknown acl item: ", predicate.item_case()));
+  }
+
+  const IdentityAclGroup &acl_group = predicate.acl_group();
+  if (acl_group.predicates().empty()) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "ACL predicate groups cannot be empty");
+  }
+
+  Instruction::Op op;
+  switch (acl_group.type()) {
+    case IdentityAclGroup::OR:
+      op = Instruction::kOr;
+      break;
+    case IdentityAclGroup::AND:
+      op = Instruction::kAnd;
+      break;
+    case IdentityAclGroup::NOT:
+      if (acl_group.predicates_size() != 1) {
+        return Status(error::GoogleError::INVALID_ARGUMENT,
+                      "NOT predicate groups must have exactly one element");
+      }
+      op = Instruction::kNot;
+      break;
+    default:
+      return Status(error::GoogleError::INVALID_ARGUMENT,
+                    absl::StrCat("Unknown acl_group type: ", acl_group.type()));
+  }
+
+  program_.push_back({op, 0, nullptr});
+  for (const IdentityAclPredicate &child : acl_group.predicates()) {
+    ASYLO_RETURN_IF_ERROR(Compile(child));
+  }
+  program_[index].size = program_.size() - index;
+  return Status::OkStatus();
+}
+
+StatusOr<bool> CompiledIdentityAcl::Run(
+    size_t index, const std::vector<EnclaveIdentity> &identities,
+    const IdentityExpectationMatcher &matcher) const {
+  const Instruction &instruction = program_[index];
+  if (instruction.op == Instruction::kExpectation) {
+    for (const EnclaveIdentity &identity : identities) {
+      bool match;
+      ASYLO_ASSIGN_OR_RETURN(
+          match, matcher.MatchAndExplain(identity, *instruction.expectation,
+                                         /*explanation=*/nullptr));
+      if (match) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Mirror EvaluateIdentityAcl, which stops at the first satisfied predicate
+  // of an OR group but evaluates all predicates of an AND group, so that both
+  // report the same matcher errors.
+  size_t end = index + instruction.size;
+  bool result = instruction.op != Instruction::kOr;
+  for (size_t child = index + 1; child < end; child += program_[child].size) {
+    bool child_result;
+    ASYLO_ASSIGN_OR_RETURN(child_result, Run(child, identities, matcher));
+    switch (instruction.op) {
+      case Instruction::kOr:
+        if (child_result) {
+          return true;
+        }
+        break;
+      case Instruction::kAnd:
+        result &= child_result;
+        break;
+      case Instruction::kNot:
+        return !child_result;
+      case Instruction::kExpectation:
+        break;
+    }
+  }
+  return result;
+}
+
+StatusOr<bool> CompiledIdentityAcl::EvaluateUncached(
+    const std::vector<EnclaveIdentity> &identities,
+    const IdentityExpectationMatcher &matcher,
+    std::string *explanation) const {
+  bool result;
+  ASYLO_ASSIGN_OR_RETURN(result, Run(/*index=*/0, identities, matcher));
+  if (!result && explanation != nullptr) {
+    // Explanations are only needed for denials, so build them with the
+    // recursive evaluator instead of tracking them in the program.
+    return EvaluateIdentityAcl(identities, acl_, matcher, explanation);
+  }
+  return result;
+}
+
+StatusOr<bool> CompiledIdentityAcl::Evaluate(
+    const std::vector<EnclaveIdentity> &identities,
+    const IdentityExpectationMatcher &matcher,
+    std::string *explanation) const {
+  if (verdict_cache_capacity_ == 0) {
+    return EvaluateUncached(identities, matcher, explanation);
+  }
+  std::string identities_digest;
+  ASYLO_ASSIGN_OR_RETURN(identities_digest, DigestIdentities(identities));
+  return EvaluateWithDigest(identities_digest, identities, matcher,
+                            explanation);
+}
+
+StatusOr<bool> CompiledIdentityAcl::EvaluateWithDigest(
+    const std::string &identities_digest,
+    const std::vector<EnclaveIdentity> &identities,
+    const IdentityExpectationMatcher &matcher,
+    std::string *explanation) const {
+  if (verdict_cache_capacity_ == 0) {
+    return EvaluateUncached(identities, matcher, explanation);
+  }
+
+  {
+    auto members_view = members_.Lock();
+    auto it = members_view->index.find(identities_digest);
+    if (it != members_view->index.end()) {
+      members_view->verdicts.splice(members_view->verdicts.begin(),
+                                    members_view->verdicts, it->second);
+      const Verdict &verdict = *it->second;
+      if (verdict.result || explanation == nullptr) {
+        return verdict.result;
+      }
+      if (verdict.has_explanation) {
+        *explanation = verdict.explanation;
+        return false;
+      }
+    }
+  }
+
+  bool result;
+  ASYLO_ASSIGN_OR_RETURN(result,
+                         EvaluateUncached(identities, matcher, explanation));
+  bool has_explanation = !result && explanation != nullptr;
+  Insert({identities_digest, result, has_explanation,
+          has_explanation ? *explanation : ""});
+  return result;
+}
+
+void CompiledIdentityAcl::ClearCache() {
+  auto members_view = members_.Lock();
+  members_view->verdicts.clear();
+  members_view->index.clear();
+}
+
+size_t CompiledIdentityAcl::cache_size() const {
+  return members_.ReaderLock()->verdicts.size();
+}
+
+void CompiledIdentityAcl::Insert(Verdict verdict) const {
+  auto members_view = members_.Lock();
+  auto it = members_view->index.find(verdict.key);
+  if (it != members_view->index.end()) {
+    // Another thread evaluated the same identities concurrently, or the
+    // verdict is being extended with an explanation.
+    *it->second = std::move(verdict);
+    members_view->verdicts.splice(members_view->verdicts.begin(),
+                                  members_view->verdicts, it->second);
+    return;
+  }
+  if (members_view->verdicts.size() >= verdict_cache_capacity_) {
+    members_view->index.erase(members_view->verdicts.back().key);
+    members_view->verdicts.pop_back();
+  }
+  members_view->verdicts.push_front(std::move(verdict));
+  members_view->index.emplace(members_view->verdicts.front().key,
+                              members_view->verdicts.begin());
+}
+
 }  // namespace asylo
@@ -19,9 +19,17 @@
 #ifndef ASYLO_IDENTITY_IDENTITY_ACL_EVALUATOR_H_
 #define ASYLO_IDENTITY_IDENTITY_ACL_EVALUATOR_H_
 
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
 #include "asylo/identity/identity.pb.h"
 #include "asylo/identity/identity_acl.pb.h"
 #include "asylo/identity/identity_expectation_matcher.h"
+#include "asylo/util/mutex_guarded.h"
 #include "asylo/util/statusor.h"
 
 namespace asylo {
@@ -54,6 +62,141 @@ StatusOr<bool> EvaluateIdentityAcl(
     const IdentityAclPredicate &acl, const IdentityExpectationMatcher &matcher,
     std::string *explanation = nullptr);
 
+/// An identity ACL which is validated and flattened once, so that it can be
+/// evaluated repeatedly, for instance on every RPC of a service, without
+/// walking the `IdentityAclPredicate` proto each time.
+///
+/// A `CompiledIdentityAcl` also caches its verdicts for the sets of peer
+/// identities it was evaluated against. A cached verdict is returned without
+/// consulting the matcher, so all evaluations of a `CompiledIdentityAcl` must
+/// use matchers that behave identically, such as
+/// `DelegatingIdentityExpectationMatcher`. Evaluations that fail with a non-OK
+/// status are not cached. When the cache is full, the least-recently-used
+/// verdict is evicted.
+///
+/// This class is thread-safe.
+class CompiledIdentityAcl {
+ public:
+  /// The default number of cached verdicts.
+  static constexpr size_t kDefaultVerdictCacheCapacity = 1024;
+
+  /// Validates and compiles `acl`.
+  ///
+  /// `acl` must conform to the constraints described for
+  /// `EvaluateIdentityAcl()` in all of its nodes, including nodes which
+  /// `EvaluateIdentityAcl()` might never reach.
+  ///
+  /// \param acl An ACL specifying expectations on an identity.
+  /// \param verdict_cache_capacity The maximum number of cached verdicts. A
+  ///        capacity of zero disables caching.
+  /// \return The compiled ACL, or a non-OK Status if `acl` is malformed.
+  static StatusOr<std::unique_ptr<CompiledIdentityAcl>> Create(
+      const IdentityAclPredicate &acl,
+      size_t verdict_cache_capacity = kDefaultVerdictCacheCapacity);
+
+  CompiledIdentityAcl(const CompiledIdentityAcl &other) = delete;
+  CompiledIdentityAcl &operator=(const CompiledIdentityAcl &other) = delete;
+
+  /// Uses `matcher` to evaluate whether `identities` satisfies the ACL. Gives
+  /// the same result as `EvaluateIdentityAcl()` with the source ACL.
+  ///
+  /// \param identities A list of identities to match against the ACL.
+  /// \param matcher The matcher to use to evaluate `identities`.
+  /// \param[out] explanation An explanation of why the match failed, if the
+  ///             result is false.
+  /// \return A bool indicating whether the ACL evaluated to true, or a non-OK
+  ///         Status if `matcher.MatchAndExplain()` returned a non-OK status.
+  StatusOr<bool> Evaluate(const std::vector<EnclaveIdentity> &identities,
+                          const IdentityExpectationMatcher &matcher,
+                          std::string *explanation = nullptr) const;
+
+  /// As `Evaluate()`, but takes the cache key of `identities` from the caller,
+  /// which lets a caller that evaluates several ACLs against the same peer
+  /// compute it once.
+  ///
+  /// \param identities_digest A collision-resistant digest which identifies
+  ///        `identities`, such as the SHA-256 digest of their serialization.
+  /// \param identities A list of identities to match against the ACL.
+  /// \param matcher The matcher to use to evaluate `identities`.
+  /// \param[out] explanation An explanation of why the match failed, if the
+  ///             result is false.
+  /// \return A bool indicating whether the ACL evaluated to true, or a non-OK
+  ///         Status if `matcher.MatchAndExplain()` returned a non-OK status.
+  StatusOr<bool> EvaluateWithDigest(
+      const std::string &identities_digest,
+      const std::vector<EnclaveIdentity> &identities,
+      const IdentityExpectationMatcher &matcher,
+      std::string *explanation = nullptr) const;
+
+  /// Returns the ACL this object was compiled from.
+  const IdentityAclPredicate &acl() const { return acl_; }
+
+  /// Removes all cached verdicts.
+  void ClearCache();
+
+  /// Returns the number of cached verdicts.
+  size_t cache_size() const;
+
+ private:
+  // A node of the flattened ACL. The nodes of a subtree are laid out in
+  // pre-order, so the children of the node at index i start at index i + 1,
+  // and each child is followed by its next sibling |size| nodes later.
+  struct Instruction {
+    enum Op { kExpectation, kAnd, kOr, kNot };
+
+    Op op;
+
+    // The number of nodes in the subtree rooted at this node.
+    size_t size;
+
+    // The expectation to match, for kExpectation nodes. Points into |acl_|.
+    const EnclaveIdentityExpectation *expectation;
+  };
+
+  // A cached verdict.
+  struct Verdict {
+    std::string key;
+    bool result;
+
+    // Whether |explanation| holds the explanation of a false |result|.
+    bool has_explanation;
+    std::string explanation;
+  };
+
+  // Type that holds members for mutex-synchronized access.
+  struct Members {
+    // Verdicts from most to least recently used.
+    std::list<Verdict> verdicts;
+    absl::flat_hash_map<std::string, std::list<Verdict>::iterator> index;
+  };
+
+  CompiledIdentityAcl(const IdentityAclPredicate &acl,
+                      size_t verdict_cache_capacity);
+
+  // Appends the nodes of |predicate| to |program_|.
+  Status Compile(const IdentityAclPredicate &predicate);
+
+  // Evaluates the subtree rooted at |program_[index]| against |identities|.
+  StatusOr<bool> Run(size_t index,
+                     const std::vector<EnclaveIdentity> &identities,
+                     const IdentityExpectationMatcher &matcher) const;
+
+  // Evaluates the ACL without consulting the cache.
+  StatusOr<bool> EvaluateUncached(
+      const std::vector<EnclaveIdentity> &identities,
+      const IdentityExpectationMatcher &matcher,
+      std::string *explanation) const;
+
+  // Adds |verdict| to the cache, evicting the least-recently-used verdict if
+  // the cache is full.
+  void Insert(Verdict verdict) const;
+
+  const IdentityAclPredicate acl_;
+  const size_t verdict_cache_capacity_;
+  std::vector<Instruction> program_;
+  mutable MutexGuarded<Members> members_;
+};
+
 }  // namespace asylo
 
 #endif  // ASYLO_IDENTITY_IDENTITY_ACL_EVALUATOR_H_
@@ -0,0 +1,259 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/identity/identity_acl_evaluator.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "asylo/identity/identity.pb.h"
+#include "asylo/identity/identity_acl.pb.h"
+#include "asylo/identity/identity_expectation_matcher.h"
+#include "asylo/test/util/status_matchers.h"
+#include "asylo/util/status.h"
+#include "asylo/util/statusor.h"
+
+namespace asylo {
+namespace {
+
+using ::testing::Eq;
+using ::testing::Gt;
+using ::testing::HasSubstr;
+
+constexpr char kIdentityMismatch[] = "identity does not match";
+constexpr char kErrorSpec[] = "error";
+
+// Matches an identity whose identity string equals the expectation's match
+// spec, and fails on the match spec kErrorSpec. Counts its invocations.
+class CountingMatcher : public IdentityExpectationMatcher {
+ public:
+  StatusOr<bool> MatchAndExplain(const EnclaveIdentity &identity,
+                                 const EnclaveIdentityExpectation &expectation,
+                                 std::string *explanation) const override {
+    ++calls_;
+    if (expectation.match_spec() == kErrorSpec) {
+      return Status(error::GoogleError::INVALID_ARGUMENT, "Bad expectation");
+    }
+    if (identity.identity() != expectation.match_spec()) {
+      if (explanation != nullptr) {
+        *explanation = kIdentityMismatch;
+      }
+      return false;
+    }
+    return true;
+  }
+
+  int calls() const { return calls_; }
+
+ private:
+  mutable int calls_ = 0;
+};
+
+IdentityAclPredicate Expect(const std::string &match_spec) {
+  IdentityAclPredicate predicate;
+  predicate.mutable_expectation()->set_match_spec(match_spec);
+  return predicate;
+}
+
+IdentityAclPredicate Group(IdentityAclGroup::GroupType type,
+                           const std::vector<IdentityAclPredicate> &children) {
+  IdentityAclPredicate predicate;
+  predicate.mutable_acl_group()->set_type(type);
+  for (const IdentityAclPredicate &child : children) {
+    *predicate.mutable_acl_group()->add_predicates() = child;
+  }
+  return predicate;
+}
+
+std::vector<EnclaveIdentity> Identities(
+    const std::vector<std::string> &values) {
+  std::vector<EnclaveIdentity> identities;
+  for (const std::string &value : values) {
+    EnclaveIdentity identity;
+    identity.set_identity(value);
+    identities.push_back(identity);
+  }
+  return identities;
+}
+
+// Checks that the compiled form of |acl| agrees with EvaluateIdentityAcl on
+// |identities|, including the explanation.
+void ExpectSameAsEvaluateIdentityAcl(
+    const IdentityAclPredicate &acl,
+    const std::vector<EnclaveIdentity> &identities) {
+  CountingMatcher matcher;
+  std::string expected_explanation;
+  StatusOr<bool> expected =
+      EvaluateIdentityAcl(identities, acl, matcher, &expected_explanation);
+
+  std::unique_ptr<CompiledIdentityAcl> compiled;
+  ASYLO_ASSERT_OK_AND_ASSIGN(compiled, CompiledIdentityAcl::Create(acl));
+  for (int i = 0; i < 2; ++i) {
+    std::string explanation;
+    StatusOr<bool> result = compiled->Evaluate(identities, matcher,
+                                               &explanation);
+    ASSERT_THAT(result.ok(), Eq(expected.ok()));
+    if (expected.ok()) {
+      EXPECT_THAT(result.ValueOrDie(), Eq(expected.ValueOrDie()));
+      EXPECT_THAT(explanation, Eq(expected_explanation));
+    } else {
+      EXPECT_THAT(result.status(), Eq(expected.status()));
+    }
+  }
+}
+
+TEST(CompiledIdentityAclTest, MatchesEvaluateIdentityAcl) {
+  std::vector<IdentityAclPredicate> acls = {
+      Expect("a"),
+      Group(IdentityAclGroup::OR, {Expect("x"), Expect("b")}),
+      Group(IdentityAclGroup::AND, {Expect("a"), Expect("b")}),
+      Group(IdentityAclGroup::AND, {Expect("a"), Expect("x")}),
+      Group(IdentityAclGroup::NOT, {Expect("a")}),
+      Group(IdentityAclGroup::NOT, {Expect("x")}),
+      Group(IdentityAclGroup::OR,
+            {Group(IdentityAclGroup::AND, {Expect("x"), Expect("a")}),
+             Group(IdentityAclGroup::NOT,
+                   {Group(IdentityAclGroup::OR, {Expect("y"), Expect("z")})})}),
+      Group(IdentityAclGroup::OR, {Expect("a"), Expect(kErrorSpec)}),
+      Group(IdentityAclGroup::AND, {Expect("x"), Expect(kErrorSpec)}),
+  };
+  for (const IdentityAclPredicate &acl : acls) {
+    SCOPED_TRACE(acl.DebugString());
+    ExpectSameAsEvaluateIdentityAcl(acl, Identities({"a", "b"}));
+    ExpectSameAsEvaluateIdentityAcl(acl, Identities({}));
+  }
+}
+
+TEST(CompiledIdentityAclTest, RejectsMalformedAcls) {
+  EXPECT_THAT(CompiledIdentityAcl::Create(IdentityAclPredicate()),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+  EXPECT_THAT(CompiledIdentityAcl::Create(Group(IdentityAclGroup::AND, {})),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+  EXPECT_THAT(CompiledIdentityAcl::Create(Group(IdentityAclGroup::NOT,
+                                                {Expect("a"), Expect("b")})),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+
+  // Unlike EvaluateIdentityAcl, compilation rejects malformed predicates that
+  // an evaluation would not reach.
+  EXPECT_THAT(
+      CompiledIdentityAcl::Create(Group(
+          IdentityAclGroup::OR,
+          {Expect("a"), Group(IdentityAclGroup::NOT, {})})),
+      StatusIs(error::GoogleError::INVALID_ARGUMENT));
+}
+
+TEST(CompiledIdentityAclTest, CachesVerdicts) {
+  std::unique_ptr<CompiledIdentityAcl> compiled;
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      compiled, CompiledIdentityAcl::Create(
+                    Group(IdentityAclGroup::AND, {Expect("a"), Expect("b")})));
+
+  CountingMatcher matcher;
+  std::vector<EnclaveIdentity> allowed = Identities({"a", "b"});
+  EXPECT_THAT(compiled->Evaluate(allowed, matcher), IsOkAndHolds(true));
+  int calls = matcher.calls();
+  EXPECT_THAT(compiled->Evaluate(allowed, matcher), IsOkAndHolds(true));
+  EXPECT_THAT(matcher.calls(), Eq(calls));
+
+  std::vector<EnclaveIdentity> denied = Identities({"a"});
+  std::string explanation;
+  EXPECT_THAT(compiled->Evaluate(denied, matcher, &explanation),
+              IsOkAndHolds(false));
+  EXPECT_THAT(explanation, HasSubstr(kIdentityMismatch));
+  calls = matcher.calls();
+  std::string cached_explanation;
+  EXPECT_THAT(compiled->Evaluate(denied, matcher, &cached_explanation),
+              IsOkAndHolds(false));
+  EXPECT_THAT(cached_explanation, Eq(explanation));
+  EXPECT_THAT(matcher.calls(), Eq(calls));
+  EXPECT_THAT(compiled->cache_size(), Eq(2));
+
+  compiled->ClearCache();
+  EXPECT_THAT(compiled->cache_size(), Eq(0));
+  EXPECT_THAT(compiled->Evaluate(allowed, matcher), IsOkAndHolds(true));
+  EXPECT_THAT(matcher.calls(), Gt(calls));
+}
+
+TEST(CompiledIdentityAclTest, AddsExplanationToCachedDenial) {
+  std::unique_ptr<CompiledIdentityAcl> compiled;
+  ASYLO_ASSERT_OK_AND_ASSIGN(compiled,
+                             CompiledIdentityAcl::Create(Expect("a")));
+
+  CountingMatcher matcher;
+  std::vector<EnclaveIdentity> denied = Identities({"b"});
+  EXPECT_THAT(compiled->Evaluate(denied, matcher), IsOkAndHolds(false));
+
+  std::string explanation;
+  EXPECT_THAT(compiled->Evaluate(denied, matcher, &explanation),
+              IsOkAndHolds(false));
+  EXPECT_THAT(explanation, HasSubstr(kIdentityMismatch));
+  EXPECT_THAT(compiled->cache_size(), Eq(1));
+}
+
+TEST(CompiledIdentityAclTest, DoesNotCacheErrors) {
+  std::unique_ptr<CompiledIdentityAcl> compiled;
+  ASYLO_ASSERT_OK_AND_ASSIGN(compiled,
+                             CompiledIdentityAcl::Create(Expect(kErrorSpec)));
+
+  CountingMatcher matcher;
+  EXPECT_THAT(compiled->Evaluate(Identities({"a"}), matcher),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+  EXPECT_THAT(compiled->cache_size(), Eq(0));
+}
+
+TEST(CompiledIdentityAclTest, EvictsLeastRecentlyUsedVerdict) {
+  std::unique_ptr<CompiledIdentityAcl> compiled;
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      compiled,
+      CompiledIdentityAcl::Create(Expect("a"), /*verdict_cache_capacity=*/2));
+
+  CountingMatcher matcher;
+  ASYLO_ASSERT_OK(compiled->Evaluate(Identities({"a"}), matcher).status());
+  ASYLO_ASSERT_OK(compiled->Evaluate(Identities({"b"}), matcher).status());
+  ASYLO_ASSERT_OK(compiled->Evaluate(Identities({"a"}), matcher).status());
+  ASYLO_ASSERT_OK(compiled->Evaluate(Identities({"c"}), matcher).status());
+  EXPECT_THAT(compiled->cache_size(), Eq(2));
+
+  // {"a"} was used more recently than {"b"}, so it is still cached.
+  int calls = matcher.calls();
+  ASYLO_ASSERT_OK(compiled->Evaluate(Identities({"a"}), matcher).status());
+  EXPECT_THAT(matcher.calls(), Eq(calls));
+  ASYLO_ASSERT_OK(compiled->Evaluate(Identities({"b"}), matcher).status());
+  EXPECT_THAT(matcher.calls(), Eq(calls + 1));
+}
+
+TEST(CompiledIdentityAclTest, ZeroCapacityDisablesCache) {
+  std::unique_ptr<CompiledIdentityAcl> compiled;
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      compiled,
+      CompiledIdentityAcl::Create(Expect("a"), /*verdict_cache_capacity=*/0));
+
+  CountingMatcher matcher;
+  EXPECT_THAT(compiled->Evaluate(Identities({"a"}), matcher),
+              IsOkAndHolds(true));
+  EXPECT_THAT(compiled->Evaluate(Identities({"a"}), matcher),
+              IsOkAndHolds(true));
+  EXPECT_THAT(matcher.calls(), Eq(2));
+  EXPECT_THAT(compiled->cache_size(), Eq(0));
+}
+
+}  // namespace
+}  // namespace asylo
@@ -0,0 +1,64 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/identity/identity_expectation_matcher.h"
+
+#include <memory>
+#include <string>
+
+#include "absl/memory/memory.h"
+
+namespace asylo {
+namespace {
+
+// A CompiledIdentityExpectation that forwards each match to the
+// MatchAndExplain() method of the matcher that created it.
+class ForwardingCompiledIdentityExpectation
+    : public CompiledIdentityExpectation {
+ public:
+  ForwardingCompiledIdentityExpectation(
+      const IdentityExpectationMatcher *matcher,
+      EnclaveIdentityExpectation expectation)
+      : matcher_(matcher), expectation_(std::move(expectation)) {}
+
+  StatusOr<bool> MatchAndExplain(const ParsedEnclaveIdentity &identity,
+                                 std::string *explanation) const override {
+    return matcher_->MatchAndExplain(identity.identity(), expectation_,
+                                     explanation);
+  }
+
+  const EnclaveIdentityExpectation &expectation() const override {
+    return expectation_;
+  }
+
+ private:
+  const IdentityExpectationMatcher *const matcher_;
+  const EnclaveIdentityExpectation expectation_;
+};
+
+}  // namespace
+
+StatusOr<std::unique_ptr<CompiledIdentityExpectation>>
+IdentityExpectationMatcher::CompileExpectation(
+    const EnclaveIdentityExpectation &expectation) const {
+  return std::unique_ptr<CompiledIdentityExpectation>(
+      absl::make_unique<ForwardingCompiledIdentityExpectation>(this,
+                                                               expectation));
+}
+
+}  // namespace asylo
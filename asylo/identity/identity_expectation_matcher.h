@@ -19,9 +19,11 @@
 #ifndef ASYLO_IDENTITY_IDENTITY_EXPECTATION_MATCHER_H_
 #define ASYLO_IDENTITY_IDENTITY_EXPECTATION_MATCHER_H_
 
+#include <memory>
 #include <string>
 
 #include "absl/base/macros.h"
+#include "asylo/identity/compiled_identity_expectation.h"
 #include "asylo/identity/identity.pb.h"
 #include "asylo/util/statusor.h"
 
@@ -81,6 +83,23 @@ class IdentityExpectationMatcher {
       const EnclaveIdentityExpectation &expectation) const {
     return MatchAndExplain(identity, expectation, /*explanation=*/nullptr);
   }
+
+  /// Compiles `expectation` into an object that matches identities against it
+  /// without re-validating `expectation` on every match.
+  ///
+  /// Implementations should parse and validate `expectation` here, and return
+  /// a non-OK Status if `expectation` is not understood by this matcher. The
+  /// default implementation only copies `expectation` and forwards each match
+  /// to MatchAndExplain().
+  ///
+  /// The returned object may refer to this matcher, so this matcher must
+  /// outlive it.
+  ///
+  /// \param expectation The identity expectation to compile.
+  /// \return The compiled expectation, or a non-OK Status if `expectation` is
+  ///         invalid for this matcher.
+  virtual StatusOr<std::unique_ptr<CompiledIdentityExpectation>>
+  CompileExpectation(const EnclaveIdentityExpectation &expectation) const;
 };
 
 }  // namespace asylo
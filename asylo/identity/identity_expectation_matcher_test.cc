@@ -18,12 +18,14 @@
 
 #include "asylo/identity/identity_expectation_matcher.h"
 
+#include <memory>
 #include <string>
 
 #include <google/protobuf/util/message_differencer.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include "absl/strings/str_format.h"
+#include "asylo/identity/compiled_identity_expectation.h"
 #include "asylo/identity/delegating_identity_expectation_matcher.h"
 #include "asylo/identity/identity.pb.h"
 #include "asylo/identity/named_identity_expectation_matcher.h"
@@ -186,5 +188,88 @@ TEST(IdentityExpectationMatcherTest,
   EXPECT_THAT(match_result, Not(IsOk()));
 }
 
+// Tests that a compiled expectation of type 'A' matches identities of type 'A'
+// the same way as the delegating matcher, and rejects identities of type 'B'
+// with an explanation.
+TEST(IdentityExpectationMatcherTest, CompiledExpectationMatches) {
+  DelegatingIdentityExpectationMatcher matcher;
+  std::unique_ptr<CompiledIdentityExpectation> compiled;
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      compiled, matcher.CompileExpectation(MakeExpectation<'A'>("foo")));
+
+  std::string explanation;
+  EXPECT_THAT(compiled->MatchAndExplain(
+                  ParsedEnclaveIdentity(MakeIdentity<'A'>("foo")),
+                  &explanation),
+              IsOkAndHolds(true));
+  EXPECT_THAT(explanation, Eq(""));
+
+  EXPECT_THAT(compiled->MatchAndExplain(
+                  ParsedEnclaveIdentity(MakeIdentity<'A'>("bar")),
+                  &explanation),
+              IsOkAndHolds(false));
+  EXPECT_THAT(explanation, HasSubstr("does not match expected identity"));
+
+  EXPECT_THAT(compiled->MatchAndExplain(
+                  ParsedEnclaveIdentity(MakeIdentity<'B'>("foo")),
+                  &explanation),
+              IsOkAndHolds(false));
+  EXPECT_THAT(explanation, HasSubstr("incompatible with reference identity"));
+}
+
+// Tests that a compiled expectation returns a non-ok status when matched
+// against an identity of type 'C', for which no matcher is registered.
+TEST(IdentityExpectationMatcherTest,
+     CompiledExpectationFailsIfIdentityDescriptionInvalid) {
+  DelegatingIdentityExpectationMatcher matcher;
+  std::unique_ptr<CompiledIdentityExpectation> compiled;
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      compiled, matcher.CompileExpectation(MakeExpectation<'A'>("foo")));
+
+  EXPECT_THAT(compiled->MatchAndExplain(
+                  ParsedEnclaveIdentity(MakeIdentity<'C'>("foo")),
+                  /*explanation=*/nullptr),
+              Not(IsOk()));
+}
+
+// Tests that the delegating matcher refuses to compile an expectation of type
+// 'C', for which no matcher is registered.
+TEST(IdentityExpectationMatcherTest,
+     CompileFailsIfExpectationDescriptionInvalid) {
+  DelegatingIdentityExpectationMatcher matcher;
+  EXPECT_THAT(matcher.CompileExpectation(MakeExpectation<'C'>("foo")),
+              Not(IsOk()));
+}
+
+// Tests that a ParsedEnclaveIdentity parses its identity only once.
+TEST(IdentityExpectationMatcherTest, ParsedEnclaveIdentityParsesOnce) {
+  ParsedEnclaveIdentity identity(MakeIdentity<'A'>("foo"));
+
+  int parse_calls = 0;
+  auto parse = [&parse_calls](const EnclaveIdentity &generic_identity,
+                              EnclaveIdentity *parsed) {
+    ++parse_calls;
+    *parsed = generic_identity;
+    return Status::OkStatus();
+  };
+
+  const EnclaveIdentity *first;
+  ASYLO_ASSERT_OK_AND_ASSIGN(first,
+                             identity.GetOrParse<EnclaveIdentity>(parse));
+  const EnclaveIdentity *second;
+  ASYLO_ASSERT_OK_AND_ASSIGN(second,
+                             identity.GetOrParse<EnclaveIdentity>(parse));
+  EXPECT_THAT(second, Eq(first));
+  EXPECT_THAT(parse_calls, Eq(1));
+  EXPECT_THAT(first->identity(), Eq("foo"));
+
+  EXPECT_THAT(identity.GetOrParse<EnclaveIdentityExpectation>(
+                  [](const EnclaveIdentity &generic_identity,
+                     EnclaveIdentityExpectation *parsed) {
+                    return Status::OkStatus();
+                  }),
+              Not(IsOk()));
+}
+
 }  // namespace
 }  // namespace asylo
@@ -0,0 +1,86 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/identity/platform/sgx/internal/caching_hardware_interface.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "asylo/crypto/util/trivial_object_util.h"
+#include "asylo/identity/platform/sgx/internal/hardware_interface.h"
+#include "asylo/identity/platform/sgx/internal/identity_key_management_structs.h"
+#include "asylo/util/status_macros.h"
+#include "asylo/util/statusor.h"
+
+namespace asylo {
+namespace sgx {
+
+constexpr size_t CachingHardwareInterface::kDefaultCapacity;
+
+CachingHardwareInterface *CachingHardwareInterface::GetInstance() {
+#ifdef __ASYLO__
+  constexpr size_t kCapacity = kDefaultCapacity;
+#else
+  constexpr size_t kCapacity = 0;
+#endif  // __ASYLO__
+  static CachingHardwareInterface *const instance =
+      new CachingHardwareInterface(HardwareInterface::CreateDefault(),
+                                   kCapacity);
+  return instance;
+}
+
+CachingHardwareInterface::CachingHardwareInterface(
+    std::unique_ptr<HardwareInterface> hardware, size_t capacity)
+    : hardware_(std::move(hardware)), capacity_(capacity), keys_(KeyMap()) {}
+
+StatusOr<HardwareKey> CachingHardwareInterface::GetKey(
+    const Keyrequest &request) const {
+  if (capacity_ == 0) {
+    return hardware_->GetKey(request);
+  }
+
+  std::string request_bytes = ConvertTrivialObjectToBinaryString(request);
+  {
+    auto keys_view = keys_.ReaderLock();
+    auto it = keys_view->find(request_bytes);
+    if (it != keys_view->end()) {
+      return it->second;
+    }
+  }
+
+  HardwareKey key;
+  ASYLO_ASSIGN_OR_RETURN(key, hardware_->GetKey(request));
+
+  auto keys_view = keys_.Lock();
+  if (keys_view->size() >= capacity_) {
+    keys_view->clear();
+  }
+  keys_view->emplace(std::move(request_bytes), key);
+  return key;
+}
+
+StatusOr<Report> CachingHardwareInterface::GetReport(
+    const Targetinfo &tinfo, const Reportdata &reportdata) const {
+  return hardware_->GetReport(tinfo, reportdata);
+}
+
+void CachingHardwareInterface::ClearKeys() { keys_.Lock()->clear(); }
+
+}  // namespace sgx
+}  // namespace asylo
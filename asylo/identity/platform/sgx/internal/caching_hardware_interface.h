@@ -0,0 +1,94 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_IDENTITY_PLATFORM_SGX_INTERNAL_CACHING_HARDWARE_INTERFACE_H_
+#define ASYLO_IDENTITY_PLATFORM_SGX_INTERNAL_CACHING_HARDWARE_INTERFACE_H_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+#include "asylo/identity/platform/sgx/internal/hardware_interface.h"
+#include "asylo/identity/platform/sgx/internal/identity_key_management_structs.h"
+#include "asylo/util/mutex_guarded.h"
+#include "asylo/util/statusor.h"
+
+namespace asylo {
+namespace sgx {
+
+// A HardwareInterface that remembers the keys returned by another
+// HardwareInterface, so that repeated requests for the same key do not execute
+// EGETKEY again. Keys are looked up by the entire KEYREQUEST.
+//
+// At most |capacity| keys are kept. All keys are dropped when the cache is full
+// and a new key is added. Cached keys are held in HardwareKey objects, so they
+// are cleansed when they are dropped and when the cache is destroyed.
+//
+// The cached keys are only valid while the identity of the calling enclave and
+// the platform it runs on stay the same. ClearKeys() must be called whenever
+// that may no longer hold, such as after an enclave is restored from a
+// snapshot.
+//
+// CachingHardwareInterface is thread-safe.
+class CachingHardwareInterface : public HardwareInterface {
+ public:
+  // The number of keys kept by GetInstance().
+  static constexpr size_t kDefaultCapacity = 64;
+
+  // Returns a process-wide instance that wraps HardwareInterface::
+  // CreateDefault(). Outside of an enclave, the default HardwareInterface
+  // derives keys for whichever fake enclave is current, so the instance does
+  // not cache keys there.
+  static CachingHardwareInterface *GetInstance();
+
+  // Creates an instance that caches up to |capacity| keys from |hardware|. If
+  // |capacity| is zero, no keys are cached.
+  explicit CachingHardwareInterface(std::unique_ptr<HardwareInterface> hardware,
+                                    size_t capacity = kDefaultCapacity);
+
+  CachingHardwareInterface(const CachingHardwareInterface &other) = delete;
+  CachingHardwareInterface &operator=(const CachingHardwareInterface &other) =
+      delete;
+
+  ~CachingHardwareInterface() override = default;
+
+  // From HardwareInterface.
+
+  StatusOr<HardwareKey> GetKey(const Keyrequest &request) const override;
+
+  StatusOr<Report> GetReport(const Targetinfo &tinfo,
+                             const Reportdata &reportdata) const override;
+
+  // Drops and cleanses all cached keys.
+  void ClearKeys();
+
+ private:
+  using KeyMap = absl::flat_hash_map<std::string, HardwareKey>;
+
+  const std::unique_ptr<HardwareInterface> hardware_;
+  const size_t capacity_;
+
+  // Cached keys, keyed by the bytes of their KEYREQUEST.
+  mutable MutexGuarded<KeyMap> keys_;
+};
+
+}  // namespace sgx
+}  // namespace asylo
+
+#endif  // ASYLO_IDENTITY_PLATFORM_SGX_INTERNAL_CACHING_HARDWARE_INTERFACE_H_
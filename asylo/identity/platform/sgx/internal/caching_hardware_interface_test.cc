@@ -0,0 +1,148 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/identity/platform/sgx/internal/caching_hardware_interface.h"
+
+#include <atomic>
+#include <memory>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/memory/memory.h"
+#include "asylo/crypto/util/trivial_object_util.h"
+#include "asylo/identity/platform/sgx/internal/hardware_interface.h"
+#include "asylo/identity/platform/sgx/internal/identity_key_management_structs.h"
+#include "asylo/test/util/status_matchers.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+namespace sgx {
+namespace {
+
+using ::testing::Eq;
+using ::testing::Ne;
+
+// A HardwareInterface that counts calls to GetKey() and returns a different key
+// on every call.
+class CountingHardwareInterface : public HardwareInterface {
+ public:
+  explicit CountingHardwareInterface(std::atomic<int> *get_key_calls)
+      : get_key_calls_(get_key_calls) {}
+
+  StatusOr<HardwareKey> GetKey(const Keyrequest &request) const override {
+    if (request.keyname == KeyrequestKeyname::PROVISION_KEY) {
+      return Status(error::GoogleError::PERMISSION_DENIED, "No provision key");
+    }
+    HardwareKey key;
+    key.fill(0);
+    key[0] = static_cast<uint8_t>(++*get_key_calls_);
+    return key;
+  }
+
+  StatusOr<Report> GetReport(const Targetinfo &tinfo,
+                             const Reportdata &reportdata) const override {
+    return Status(error::GoogleError::UNIMPLEMENTED, "Not implemented");
+  }
+
+ private:
+  std::atomic<int> *get_key_calls_;
+};
+
+class CachingHardwareInterfaceTest : public ::testing::Test {
+ protected:
+  std::unique_ptr<CachingHardwareInterface> CreateHardware(size_t capacity) {
+    return absl::make_unique<CachingHardwareInterface>(
+        absl::make_unique<CountingHardwareInterface>(&get_key_calls_),
+        capacity);
+  }
+
+  static Keyrequest CreateKeyrequest(uint8_t keyid) {
+    Keyrequest request = TrivialZeroObject<Keyrequest>();
+    request.keyname = KeyrequestKeyname::SEAL_KEY;
+    request.keyid[0] = keyid;
+    return request;
+  }
+
+  std::atomic<int> get_key_calls_{0};
+};
+
+TEST_F(CachingHardwareInterfaceTest, RepeatedRequestsReturnTheCachedKey) {
+  std::unique_ptr<CachingHardwareInterface> hardware = CreateHardware(4);
+
+  HardwareKey first;
+  ASYLO_ASSERT_OK_AND_ASSIGN(first, hardware->GetKey(CreateKeyrequest(1)));
+  HardwareKey second;
+  ASYLO_ASSERT_OK_AND_ASSIGN(second, hardware->GetKey(CreateKeyrequest(1)));
+  EXPECT_THAT(second, Eq(first));
+  EXPECT_THAT(get_key_calls_.load(), Eq(1));
+
+  HardwareKey other;
+  ASYLO_ASSERT_OK_AND_ASSIGN(other, hardware->GetKey(CreateKeyrequest(2)));
+  EXPECT_THAT(other, Ne(first));
+  EXPECT_THAT(get_key_calls_.load(), Eq(2));
+}
+
+TEST_F(CachingHardwareInterfaceTest, ErrorsAreNotCached) {
+  std::unique_ptr<CachingHardwareInterface> hardware = CreateHardware(4);
+  Keyrequest request = CreateKeyrequest(1);
+  request.keyname = KeyrequestKeyname::PROVISION_KEY;
+
+  EXPECT_THAT(hardware->GetKey(request),
+              StatusIs(error::GoogleError::PERMISSION_DENIED));
+  EXPECT_THAT(hardware->GetKey(request),
+              StatusIs(error::GoogleError::PERMISSION_DENIED));
+}
+
+TEST_F(CachingHardwareInterfaceTest, CacheIsBounded) {
+  std::unique_ptr<CachingHardwareInterface> hardware = CreateHardware(2);
+
+  ASYLO_ASSERT_OK(hardware->GetKey(CreateKeyrequest(1)).status());
+  ASYLO_ASSERT_OK(hardware->GetKey(CreateKeyrequest(2)).status());
+  ASYLO_ASSERT_OK(hardware->GetKey(CreateKeyrequest(3)).status());
+  EXPECT_THAT(get_key_calls_.load(), Eq(3));
+
+  // Adding the third key dropped the first two.
+  ASYLO_ASSERT_OK(hardware->GetKey(CreateKeyrequest(3)).status());
+  EXPECT_THAT(get_key_calls_.load(), Eq(3));
+  ASYLO_ASSERT_OK(hardware->GetKey(CreateKeyrequest(1)).status());
+  EXPECT_THAT(get_key_calls_.load(), Eq(4));
+}
+
+TEST_F(CachingHardwareInterfaceTest, ClearKeysDropsCachedKeys) {
+  std::unique_ptr<CachingHardwareInterface> hardware = CreateHardware(4);
+
+  HardwareKey first;
+  ASYLO_ASSERT_OK_AND_ASSIGN(first, hardware->GetKey(CreateKeyrequest(1)));
+  hardware->ClearKeys();
+  HardwareKey second;
+  ASYLO_ASSERT_OK_AND_ASSIGN(second, hardware->GetKey(CreateKeyrequest(1)));
+  EXPECT_THAT(second, Ne(first));
+  EXPECT_THAT(get_key_calls_.load(), Eq(2));
+}
+
+TEST_F(CachingHardwareInterfaceTest, ZeroCapacityDisablesCaching) {
+  std::unique_ptr<CachingHardwareInterface> hardware = CreateHardware(0);
+
+  ASYLO_ASSERT_OK(hardware->GetKey(CreateKeyrequest(1)).status());
+  ASYLO_ASSERT_OK(hardware->GetKey(CreateKeyrequest(1)).status());
+  EXPECT_THAT(get_key_calls_.load(), Eq(2));
+}
+
+}  // namespace
+}  // namespace sgx
+}  // namespace asylo
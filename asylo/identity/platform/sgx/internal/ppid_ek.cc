@@ -17,7 +17,9 @@
  */
 
 #include "asylo/identity/platform/sgx/internal/ppid_ek.h"
+#include "asylo/crypto/algorithms.pb.h"
 #include "asylo/crypto/keys.pb.h"
+#include "asylo/crypto/rsa_oaep_encryption_key.h"
 #include "asylo/util/proto_parse_util.h"
 
 namespace asylo {
@@ -47,5 +49,14 @@ AsymmetricEncryptionKeyProto GetPpidEkProto() {
       .ValueOrDie();
 }
 
+const RsaOaepEncryptionKey &GetPpidEk() {
+  static const RsaOaepEncryptionKey *const kPpidEk =
+      RsaOaepEncryptionKey::CreateFromProto(GetPpidEkProto(),
+                                            HashAlgorithm::SHA256)
+          .ValueOrDie()
+          .release();
+  return *kPpidEk;
+}
+
 }  // namespace sgx
 }  // namespace asylo
@@ -21,6 +21,7 @@
 
 #include "absl/strings/string_view.h"
 #include "asylo/crypto/keys.pb.h"
+#include "asylo/crypto/rsa_oaep_encryption_key.h"
 
 namespace asylo {
 namespace sgx {
@@ -33,6 +34,11 @@ extern const absl::string_view kPpidEkTextProto;
 // Returns the PPID EK as a protobuf message.
 AsymmetricEncryptionKeyProto GetPpidEkProto();
 
+// Returns the PPID EK as an encryption key using SHA-256 for OAEP, as expected
+// by the PCS. The key is parsed once and shared by all callers, which may use
+// it concurrently.
+const RsaOaepEncryptionKey &GetPpidEk();
+
 }  // namespace sgx
 }  // namespace asylo
 
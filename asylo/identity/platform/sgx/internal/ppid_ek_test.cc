@@ -18,10 +18,17 @@
 
 #include "asylo/identity/platform/sgx/internal/ppid_ek.h"
 
+#include <cstdint>
+#include <string>
+#include <vector>
+
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include "asylo/crypto/algorithms.pb.h"
 #include "asylo/crypto/keys.pb.h"
+#include "asylo/crypto/rsa_oaep_encryption_key.h"
+#include "asylo/identity/platform/sgx/internal/identity_key_management_structs.h"
+#include "asylo/test/util/status_matchers.h"
 
 namespace asylo {
 namespace sgx {
@@ -45,6 +52,16 @@ TEST(PpidEkTest, GetPpidEkProtoTest) {
   EXPECT_THAT(ek.encryption_scheme(), Eq(RSA3072_OAEP));
 }
 
+TEST(PpidEkTest, GetPpidEkTest) {
+  const RsaOaepEncryptionKey &ek = GetPpidEk();
+  EXPECT_THAT(&GetPpidEk(), Eq(&ek));
+  EXPECT_THAT(ek.GetEncryptionScheme(), Eq(RSA3072_OAEP));
+
+  std::vector<uint8_t> ciphertext;
+  ASYLO_ASSERT_OK(ek.Encrypt(std::string(kPpidSize, 'a'), &ciphertext));
+  EXPECT_THAT(ciphertext.size(), Eq(3072 / 8));
+}
+
 }  // namespace
 }  // namespace sgx
 }  // namespace asylo
@@ -40,8 +40,8 @@
 #include "asylo/identity/platform/sgx/attributes.pb.h"
 #include "asylo/identity/platform/sgx/attributes_util.h"
 #include "asylo/identity/platform/sgx/code_identity.pb.h"
+#include "asylo/identity/platform/sgx/internal/caching_hardware_interface.h"
 #include "asylo/identity/platform/sgx/internal/code_identity_constants.h"
-#include "asylo/identity/platform/sgx/internal/hardware_interface.h"
 #include "asylo/identity/platform/sgx/internal/identity_key_management_structs.h"
 #include "asylo/identity/platform/sgx/internal/proto_format.h"
 #include "asylo/identity/platform/sgx/internal/secs_attributes.h"
@@ -94,7 +94,7 @@ StatusOr<HardwareKey> GetReportKey(
   request->attributemask.Clear();
   request->miscmask = 0;
 
-  return HardwareInterface::CreateDefault()->GetKey(*request);
+  return CachingHardwareInterface::GetInstance()->GetKey(*request);
 }
 
 StatusOr<bool> MatchIdentityToExpectation(const CodeIdentity &identity,
@@ -18,12 +18,50 @@
 
 #include "asylo/identity/platform/sgx/sgx_identity_expectation_matcher.h"
 
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/memory/memory.h"
 #include "asylo/identity/descriptions.h"
 #include "asylo/identity/platform/sgx/internal/sgx_identity_util_internal.h"
 #include "asylo/identity/platform/sgx/sgx_identity.pb.h"
 #include "asylo/util/status_macros.h"
 
 namespace asylo {
+namespace {
+
+// A compiled SGX identity expectation, which holds the parsed form of its
+// source expectation.
+class SgxCompiledIdentityExpectation : public CompiledIdentityExpectation {
+ public:
+  SgxCompiledIdentityExpectation(
+      EnclaveIdentityExpectation expectation,
+      SgxIdentityExpectation sgx_identity_expectation)
+      : expectation_(std::move(expectation)),
+        sgx_identity_expectation_(std::move(sgx_identity_expectation)) {}
+
+  StatusOr<bool> MatchAndExplain(const ParsedEnclaveIdentity &identity,
+                                 std::string *explanation) const override {
+    // If this call fails, then |identity| either does not have the correct
+    // description, or is malformed.
+    const SgxIdentity *sgx_identity;
+    ASYLO_ASSIGN_OR_RETURN(sgx_identity, identity.GetOrParse<SgxIdentity>(
+                                             sgx::ParseSgxIdentity));
+    return sgx::MatchIdentityToExpectation(
+        *sgx_identity, sgx_identity_expectation_, explanation);
+  }
+
+  const EnclaveIdentityExpectation &expectation() const override {
+    return expectation_;
+  }
+
+ private:
+  const EnclaveIdentityExpectation expectation_;
+  const SgxIdentityExpectation sgx_identity_expectation_;
+};
+
+}  // namespace
 
 StatusOr<bool> SgxIdentityExpectationMatcher::MatchAndExplain(
     const EnclaveIdentity &identity,
@@ -44,6 +82,20 @@ StatusOr<bool> SgxIdentityExpectationMatcher::MatchAndExplain(
                                          explanation);
 }
 
+StatusOr<std::unique_ptr<CompiledIdentityExpectation>>
+SgxIdentityExpectationMatcher::CompileExpectation(
+    const EnclaveIdentityExpectation &expectation) const {
+  // If this call fails, then |expectation|.reference_identity() either does not
+  // have the correct description, or is malformed.
+  SgxIdentityExpectation sgx_identity_expectation;
+  ASYLO_RETURN_IF_ERROR(
+      sgx::ParseSgxExpectation(expectation, &sgx_identity_expectation));
+
+  return std::unique_ptr<CompiledIdentityExpectation>(
+      absl::make_unique<SgxCompiledIdentityExpectation>(
+          expectation, std::move(sgx_identity_expectation)));
+}
+
 EnclaveIdentityDescription SgxIdentityExpectationMatcher::Description() const {
   EnclaveIdentityDescription description;
   SetSgxIdentityDescription(&description);
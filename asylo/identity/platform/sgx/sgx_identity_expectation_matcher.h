@@ -19,6 +19,7 @@
 #ifndef ASYLO_IDENTITY_PLATFORM_SGX_SGX_IDENTITY_EXPECTATION_MATCHER_H_
 #define ASYLO_IDENTITY_PLATFORM_SGX_SGX_IDENTITY_EXPECTATION_MATCHER_H_
 
+#include <memory>
 #include <string>
 
 #include "asylo/identity/identity.pb.h"
@@ -47,6 +48,17 @@ class SgxIdentityExpectationMatcher final
                                  const EnclaveIdentityExpectation &expectation,
                                  std::string *explanation) const override;
 
+  /// From the `IdentityExpectationMatcher` interface.
+  ///
+  /// Parses `expectation` into an `SgxIdentityExpectation` once. Each match
+  /// parses the matched identity only if no earlier match has parsed it.
+  ///
+  /// \param expectation The identity expectation to compile.
+  /// \return The compiled expectation, or a non-OK Status if `expectation`
+  ///         is not a valid SGX identity expectation.
+  StatusOr<std::unique_ptr<CompiledIdentityExpectation>> CompileExpectation(
+      const EnclaveIdentityExpectation &expectation) const override;
+
   /// From the `NamedIdentityExpectationMatcher` interface.
   ///
   /// \return A description of the enclave identities/enclave identity
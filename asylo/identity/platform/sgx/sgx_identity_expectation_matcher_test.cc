@@ -18,8 +18,12 @@
 
 #include "asylo/identity/platform/sgx/sgx_identity_expectation_matcher.h"
 
+#include <memory>
+#include <string>
+
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include "asylo/identity/compiled_identity_expectation.h"
 #include "asylo/identity/descriptions.h"
 #include "asylo/identity/identity.pb.h"
 #include "asylo/identity/named_identity_expectation_matcher.h"
@@ -159,5 +163,77 @@ TEST(SgxIdentityExpectationMatcherTest, MatchInvalidIdentityExpectation) {
       << sgx::FormatProto(identity) << sgx::FormatProto(expectation);
 }
 
+// Tests that a compiled SGX identity expectation gives the same results as
+// SgxIdentityExpectationMatcher::MatchAndExplain() for identities it is matched
+// against repeatedly.
+TEST(SgxIdentityExpectationMatcherTest, CompiledExpectationMatchesLikeMatcher) {
+  EnclaveIdentityExpectation expectation;
+  SgxIdentityExpectation sgx_identity_expectation;
+  ASYLO_ASSERT_OK(sgx::SetRandomValidGenericExpectation(
+      &expectation, &sgx_identity_expectation));
+
+  SgxIdentityExpectationMatcher matcher;
+  std::unique_ptr<CompiledIdentityExpectation> compiled;
+  ASYLO_ASSERT_OK_AND_ASSIGN(compiled, matcher.CompileExpectation(expectation));
+
+  ParsedEnclaveIdentity reference_identity(expectation.reference_identity());
+  for (int i = 0; i < 2; ++i) {
+    std::string explanation;
+    EXPECT_THAT(compiled->MatchAndExplain(reference_identity, &explanation),
+                IsOkAndHolds(true))
+        << sgx::FormatProto(sgx_identity_expectation);
+    EXPECT_THAT(explanation, IsEmpty());
+  }
+
+  SgxIdentity sgx_identity = sgx::GetRandomValidSgxIdentityWithConstraints(
+      /*mrenclave_constraint=*/{true}, /*mrsigner_constraint=*/{true},
+      /*cpu_svn_constraint=*/{true}, /*sgx_type_constraint=*/{true});
+  EnclaveIdentity identity;
+  ASYLO_ASSERT_OK(sgx::SerializeSgxIdentity(sgx_identity, &identity));
+  ParsedEnclaveIdentity parsed_identity(identity);
+
+  std::string explanation;
+  bool expected_result;
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      expected_result,
+      matcher.MatchAndExplain(identity, expectation, &explanation));
+  std::string compiled_explanation;
+  EXPECT_THAT(compiled->MatchAndExplain(parsed_identity, &compiled_explanation),
+              IsOkAndHolds(expected_result));
+  EXPECT_THAT(compiled_explanation, Eq(explanation));
+}
+
+// Tests that SgxIdentityExpectationMatcher fails to compile an invalid SGX
+// identity expectation.
+TEST(SgxIdentityExpectationMatcherTest, CompileInvalidExpectation) {
+  EnclaveIdentityExpectation expectation;
+  ASYLO_ASSERT_OK(sgx::SetRandomInvalidGenericExpectation(&expectation));
+
+  SgxIdentityExpectationMatcher matcher;
+  EXPECT_THAT(matcher.CompileExpectation(expectation), Not(IsOk()))
+      << sgx::FormatProto(expectation);
+}
+
+// Tests that a compiled SGX identity expectation returns a non-OK status when
+// matched against an invalid SGX identity.
+TEST(SgxIdentityExpectationMatcherTest, CompiledExpectationInvalidIdentity) {
+  EnclaveIdentityExpectation expectation;
+  SgxIdentityExpectation sgx_identity_expectation;
+  ASYLO_ASSERT_OK(sgx::SetRandomValidGenericExpectation(
+      &expectation, &sgx_identity_expectation));
+
+  SgxIdentityExpectationMatcher matcher;
+  std::unique_ptr<CompiledIdentityExpectation> compiled;
+  ASYLO_ASSERT_OK_AND_ASSIGN(compiled, matcher.CompileExpectation(expectation));
+
+  EnclaveIdentity identity;
+  sgx::SetRandomInvalidGenericIdentity(&identity);
+  ParsedEnclaveIdentity parsed_identity(identity);
+  EXPECT_THAT(
+      compiled->MatchAndExplain(parsed_identity, /*explanation=*/nullptr),
+      Not(IsOk()))
+      << sgx::FormatProto(identity);
+}
+
 }  // namespace
 }  // namespace asylo
@@ -0,0 +1,418 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/identity/provisioning/sgx/internal/caching_sgx_pcs_client.h"
+
+#include <openssl/asn1.h>
+#include <openssl/base.h>
+#include <openssl/bio.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/strings/escaping.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "absl/types/optional.h"
+#include "asylo/crypto/certificate.pb.h"
+#include "asylo/crypto/sha256_hash.h"
+#include "asylo/crypto/util/bytes.h"
+#include "asylo/identity/attestation/attestation_timing.h"
+#include "asylo/identity/platform/sgx/internal/code_identity_constants.h"
+#include "asylo/identity/provisioning/sgx/internal/tcb.pb.h"
+#include "asylo/identity/provisioning/sgx/internal/tcb_info_from_json.h"
+#include "asylo/util/logging.h"
+#include "asylo/util/status.h"
+#include "asylo/util/status_macros.h"
+#include "asylo/util/std_thread.h"
+#include "asylo/util/time_conversions.h"
+#include <google/protobuf/timestamp.pb.h>
+
+namespace asylo {
+namespace sgx {
+namespace {
+
+// Returns the "nextUpdate" time of |crl|, or absl::nullopt if |crl| cannot be
+// parsed or has no "nextUpdate" time.
+absl::optional<absl::Time> CrlNextUpdate(const CertificateRevocationList &crl) {
+  bssl::UniquePtr<X509_CRL> x509_crl;
+  switch (crl.format()) {
+    case CertificateRevocationList::X509_PEM: {
+      bssl::UniquePtr<BIO> bio(
+          BIO_new_mem_buf(crl.data().data(), crl.data().size()));
+      x509_crl.reset(PEM_read_bio_X509_CRL(bio.get(), /*x=*/nullptr,
+                                           /*cb=*/nullptr, /*u=*/nullptr));
+      break;
+    }
+    case CertificateRevocationList::X509_DER: {
+      const uint8_t *data =
+          reinterpret_cast<const uint8_t *>(crl.data().data());
+      x509_crl.reset(d2i_X509_CRL(/*a=*/nullptr, &data, crl.data().size()));
+      break;
+    }
+    default:
+      return absl::nullopt;
+  }
+  if (x509_crl == nullptr) {
+    return absl::nullopt;
+  }
+
+  const ASN1_TIME *next_update = X509_CRL_get0_nextUpdate(x509_crl.get());
+  bssl::UniquePtr<ASN1_TIME> unix_epoch(ASN1_TIME_set(/*s=*/nullptr, 0));
+  int num_days;
+  int num_seconds;
+  if (next_update == nullptr || unix_epoch == nullptr ||
+      ASN1_TIME_diff(&num_days, &num_seconds, unix_epoch.get(), next_update) !=
+          1) {
+    return absl::nullopt;
+  }
+  return absl::UnixEpoch() + num_days * absl::Hours(24) +
+         absl::Seconds(num_seconds);
+}
+
+// Returns the hex encoding of |bytes|, for use in cache keys.
+std::string Hex(absl::string_view bytes) {
+  return absl::BytesToHexString(bytes);
+}
+
+}  // namespace
+
+CachingSgxPcsClient::CachingSgxPcsClient(std::unique_ptr<SgxPcsClient> client,
+                                         CachingSgxPcsClientOptions options)
+    : client_(std::move(client)), options_(std::move(options)) {
+  CHECK(client_ != nullptr);
+}
+
+CachingSgxPcsClient::~CachingSgxPcsClient() {
+  absl::MutexLock lock(&mu_);
+  mu_.Await(absl::Condition(
+      +[](int *background_refreshes) { return *background_refreshes == 0; },
+      &background_refreshes_));
+}
+
+StatusOr<GetPckCertificateResult> CachingSgxPcsClient::GetPckCertificate(
+    const Ppid &ppid, const CpuSvn &cpu_svn, const PceSvn &pce_svn,
+    const PceId &pce_id) {
+  std::string key =
+      absl::StrCat("pck_certificate/", Hex(ppid.value()), "/",
+                   Hex(cpu_svn.value()), "/", pce_svn.value(), "/",
+                   pce_id.value());
+  CachedPcsResponse response;
+  ASYLO_ASSIGN_OR_RETURN(
+      response,
+      Get(key, [this, ppid, cpu_svn, pce_svn,
+                pce_id]() -> StatusOr<CachedPcsResponse> {
+        GetPckCertificateResult result;
+        ASYLO_ASSIGN_OR_RETURN(
+            result, client_->GetPckCertificate(ppid, cpu_svn, pce_svn, pce_id));
+        CachedPcsResponse fetched;
+        *fetched.mutable_issuer_cert_chain() =
+            std::move(result.issuer_cert_chain);
+        *fetched.mutable_pck_certificate()->mutable_pck_cert() =
+            std::move(result.pck_cert);
+        *fetched.mutable_pck_certificate()->mutable_tcbm() =
+            std::move(result.tcbm);
+        return fetched;
+      }));
+  if (!response.has_pck_certificate()) {
+    return Status(error::GoogleError::INTERNAL,
+                  "Cached response is not a PCK certificate");
+  }
+
+  GetPckCertificateResult result;
+  CachedPcsResponse::PckCertificateResult *pck_certificate =
+      response.mutable_pck_certificate();
+  result.pck_cert = std::move(*pck_certificate->mutable_pck_cert());
+  result.issuer_cert_chain = std::move(*response.mutable_issuer_cert_chain());
+  result.tcbm = std::move(*pck_certificate->mutable_tcbm());
+  return result;
+}
+
+StatusOr<GetPckCertificatesResult> CachingSgxPcsClient::GetPckCertificates(
+    const Ppid &ppid, const PceId &pce_id) {
+  std::string key = absl::StrCat("pck_certificates/", Hex(ppid.value()), "/",
+                                 pce_id.value());
+  CachedPcsResponse response;
+  ASYLO_ASSIGN_OR_RETURN(
+      response,
+      Get(key, [this, ppid, pce_id]() -> StatusOr<CachedPcsResponse> {
+        GetPckCertificatesResult result;
+        ASYLO_ASSIGN_OR_RETURN(result,
+                               client_->GetPckCertificates(ppid, pce_id));
+        CachedPcsResponse fetched;
+        *fetched.mutable_issuer_cert_chain() =
+            std::move(result.issuer_cert_chain);
+        *fetched.mutable_pck_certificates() = std::move(result.pck_certs);
+        return fetched;
+      }));
+  if (!response.has_pck_certificates()) {
+    return Status(error::GoogleError::INTERNAL,
+                  "Cached response is not a set of PCK certificates");
+  }
+
+  GetPckCertificatesResult result;
+  result.pck_certs = std::move(*response.mutable_pck_certificates());
+  result.issuer_cert_chain = std::move(*response.mutable_issuer_cert_chain());
+  return result;
+}
+
+StatusOr<GetCrlResult> CachingSgxPcsClient::GetCrl(SgxCaType sgx_ca_type) {
+  std::string key = absl::StrCat("crl/", static_cast<int>(sgx_ca_type));
+  CachedPcsResponse response;
+  ASYLO_ASSIGN_OR_RETURN(
+      response, Get(key, [this, sgx_ca_type]() -> StatusOr<CachedPcsResponse> {
+        GetCrlResult result;
+        ASYLO_ASSIGN_OR_RETURN(result, client_->GetCrl(sgx_ca_type));
+        CachedPcsResponse fetched;
+        *fetched.mutable_issuer_cert_chain() =
+            std::move(result.issuer_cert_chain);
+        *fetched.mutable_pck_crl() = std::move(result.pck_crl);
+        return fetched;
+      }));
+  if (!response.has_pck_crl()) {
+    return Status(error::GoogleError::INTERNAL, "Cached response is not a CRL");
+  }
+
+  GetCrlResult result;
+  result.pck_crl = std::move(*response.mutable_pck_crl());
+  result.issuer_cert_chain = std::move(*response.mutable_issuer_cert_chain());
+  return result;
+}
+
+StatusOr<GetTcbInfoResult> CachingSgxPcsClient::GetTcbInfo(const Fmspc &fmspc) {
+  std::string key = absl::StrCat("tcb_info/", Hex(fmspc.value()));
+  CachedPcsResponse response;
+  ASYLO_ASSIGN_OR_RETURN(
+      response, Get(key, [this, fmspc]() -> StatusOr<CachedPcsResponse> {
+        GetTcbInfoResult result;
+        ASYLO_ASSIGN_OR_RETURN(result, client_->GetTcbInfo(fmspc));
+        CachedPcsResponse fetched;
+        *fetched.mutable_issuer_cert_chain() =
+            std::move(result.issuer_cert_chain);
+        *fetched.mutable_tcb_info() = std::move(result.tcb_info);
+        return fetched;
+      }));
+  if (!response.has_tcb_info()) {
+    return Status(error::GoogleError::INTERNAL,
+                  "Cached response is not a TCB info");
+  }
+
+  GetTcbInfoResult result;
+  result.tcb_info = std::move(*response.mutable_tcb_info());
+  result.issuer_cert_chain = std::move(*response.mutable_issuer_cert_chain());
+  return result;
+}
+
+StatusOr<CachedPcsResponse> CachingSgxPcsClient::Get(
+    const std::string &key, const FetchFunction &fetch) {
+  absl::Time now = options_.clock();
+  {
+    absl::MutexLock lock(&mu_);
+    auto it = cache_.find(key);
+    if (it != cache_.end()) {
+      if (now < it->second.expiration) {
+        if (now >= it->second.expiration - options_.refresh_margin &&
+            !pending_.contains(key)) {
+          RefreshInBackground(key, fetch);
+        }
+        return it->second.response;
+      }
+      cache_.erase(it);
+    }
+  }
+
+  if (!options_.cache_directory.empty()) {
+    absl::optional<Entry> stored = ReadFromDisk(key);
+    if (stored.has_value() && now < stored->expiration) {
+      absl::MutexLock lock(&mu_);
+      cache_.insert_or_assign(key, *stored);
+      return stored->response;
+    }
+  }
+
+  return Fetch(key, fetch);
+}
+
+StatusOr<CachedPcsResponse> CachingSgxPcsClient::Fetch(
+    const std::string &key, const FetchFunction &fetch) {
+  std::shared_ptr<PendingFetch> pending;
+  bool is_first_caller = false;
+  {
+    absl::MutexLock lock(&mu_);
+    std::shared_ptr<PendingFetch> &slot = pending_[key];
+    if (slot == nullptr) {
+      slot = std::make_shared<PendingFetch>();
+      is_first_caller = true;
+    }
+    pending = slot;
+  }
+
+  if (is_first_caller) {
+    StatusOr<CachedPcsResponse> result = [&fetch] {
+      ScopedAttestationTimer timer(kSgxIntelEcdsaQeRemoteAssertionAuthority,
+                                   AttestationPhase::kPcsFetch);
+      return fetch();
+    }();
+    Complete(key, std::move(result), pending.get());
+  } else {
+    pending->done.WaitForNotification();
+  }
+  return pending->result;
+}
+
+void CachingSgxPcsClient::RefreshInBackground(const std::string &key,
+                                              FetchFunction fetch) {
+  auto pending = std::make_shared<PendingFetch>();
+  pending_[key] = pending;
+  ++background_refreshes_;
+  Thread::StartDetached([this, key, fetch, pending] {
+    StatusOr<CachedPcsResponse> result = fetch();
+    if (!result.ok()) {
+      // The cached response stays in use until it expires.
+      LOG(WARNING) << "Failed to refresh " << key << ": " << result.status();
+    }
+    Complete(key, std::move(result), pending.get());
+
+    absl::MutexLock lock(&mu_);
+    --background_refreshes_;
+  });
+}
+
+void CachingSgxPcsClient::Complete(const std::string &key,
+                                   StatusOr<CachedPcsResponse> result,
+                                   PendingFetch *pending) {
+  absl::optional<Entry> entry;
+  if (result.ok()) {
+    StatusOr<Entry> entry_result = CreateEntry(std::move(result).ValueOrDie());
+    if (entry_result.ok()) {
+      entry = std::move(entry_result).ValueOrDie();
+      result = entry->response;
+    } else {
+      result = entry_result.status();
+    }
+  }
+
+  if (entry.has_value() && !options_.cache_directory.empty()) {
+    WriteToDisk(key, entry->response);
+  }
+
+  {
+    absl::MutexLock lock(&mu_);
+    if (entry.has_value()) {
+      cache_.insert_or_assign(key, *std::move(entry));
+    }
+    pending_.erase(key);
+  }
+  pending->result = std::move(result);
+  pending->done.Notify();
+}
+
+StatusOr<CachingSgxPcsClient::Entry> CachingSgxPcsClient::CreateEntry(
+    CachedPcsResponse response) const {
+  Entry entry;
+  ASYLO_ASSIGN_OR_RETURN(entry.expiration,
+                         GetExpiration(response, options_.clock()));
+  ASYLO_ASSIGN_OR_RETURN(
+      *response.mutable_expiration(),
+      ConvertTime<google::protobuf::Timestamp>(entry.expiration));
+  entry.response = std::move(response);
+  return entry;
+}
+
+StatusOr<absl::Time> CachingSgxPcsClient::GetExpiration(
+    const CachedPcsResponse &response, absl::Time now) const {
+  if (response.has_tcb_info()) {
+    TcbInfo tcb_info;
+    ASYLO_ASSIGN_OR_RETURN(
+        tcb_info, TcbInfoFromJson(response.tcb_info().tcb_info_json()));
+    return ConvertTime<absl::Time>(tcb_info.impl().next_update());
+  }
+  if (response.has_pck_crl()) {
+    absl::optional<absl::Time> next_update = CrlNextUpdate(response.pck_crl());
+    if (next_update.has_value()) {
+      return next_update.value();
+    }
+  }
+  return now + options_.default_ttl;
+}
+
+std::string CachingSgxPcsClient::DiskPath(const std::string &key) const {
+  // Keys are hashed so that PPIDs do not appear in file names.
+  UnsafeBytes<kSha256DigestLength> digest;
+  Sha256Hash::Digest(key, &digest);
+  return absl::StrCat(
+      options_.cache_directory, "/",
+      Hex(absl::string_view(reinterpret_cast<const char *>(digest.data()),
+                            digest.size())),
+      ".pb");
+}
+
+absl::optional<CachingSgxPcsClient::Entry> CachingSgxPcsClient::ReadFromDisk(
+    const std::string &key) const {
+  std::ifstream input(DiskPath(key), std::ios::binary);
+  if (!input) {
+    return absl::nullopt;
+  }
+
+  CachedPcsResponse response;
+  if (!response.ParseFromIstream(&input)) {
+    LOG(WARNING) << "Ignoring unreadable cached response for " << key;
+    return absl::nullopt;
+  }
+  StatusOr<absl::Time> expiration_result =
+      ConvertTime<absl::Time>(response.expiration());
+  if (!expiration_result.ok()) {
+    LOG(WARNING) << "Ignoring cached response for " << key << ": "
+                 << expiration_result.status();
+    return absl::nullopt;
+  }
+  return Entry{std::move(response), expiration_result.ValueOrDie()};
+}
+
+void CachingSgxPcsClient::WriteToDisk(const std::string &key,
+                                      const CachedPcsResponse &response) const {
+  // Responses are written to a temporary file first so that other processes
+  // sharing the directory never read a partial response.
+  std::string path = DiskPath(key);
+  std::string temporary_path = absl::StrCat(path, ".", getpid(), ".tmp");
+  {
+    std::ofstream output(temporary_path, std::ios::binary | std::ios::trunc);
+    if (!response.SerializeToOstream(&output)) {
+      LOG(WARNING) << "Failed to write cached response to " << temporary_path;
+      return;
+    }
+  }
+  if (rename(temporary_path.c_str(), path.c_str()) != 0) {
+    LOG(WARNING) << "Failed to rename " << temporary_path << " to " << path
+                 << ": " << strerror(errno);
+  }
+}
+
+}  // namespace sgx
+}  // namespace asylo
@@ -0,0 +1,167 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_IDENTITY_PROVISIONING_SGX_INTERNAL_CACHING_SGX_PCS_CLIENT_H_
+#define ASYLO_IDENTITY_PROVISIONING_SGX_INTERNAL_CACHING_SGX_PCS_CLIENT_H_
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "absl/types/optional.h"
+#include "asylo/identity/platform/sgx/machine_configuration.pb.h"
+#include "asylo/identity/provisioning/sgx/internal/caching_sgx_pcs_client.pb.h"
+#include "asylo/identity/provisioning/sgx/internal/platform_provisioning.pb.h"
+#include "asylo/identity/provisioning/sgx/internal/sgx_pcs_client.h"
+#include "asylo/identity/provisioning/sgx/internal/sgx_pcs_client.pb.h"
+#include "asylo/util/statusor.h"
+
+namespace asylo {
+namespace sgx {
+
+// Options used to configure a CachingSgxPcsClient.
+struct CachingSgxPcsClientOptions {
+  // How long responses that carry no "nextUpdate" time are kept. This applies
+  // to PCK certificates, and to CRLs whose "nextUpdate" cannot be read.
+  absl::Duration default_ttl = absl::Hours(24);
+
+  // How long before a response expires it is refreshed. Callers keep being
+  // served the cached response while the refresh runs in the background.
+  absl::Duration refresh_margin = absl::Hours(1);
+
+  // If non-empty, responses are also stored in this directory, which must
+  // exist, so that they outlive the process.
+  std::string cache_directory;
+
+  // Source of the current time.
+  std::function<absl::Time()> clock = absl::Now;
+};
+
+// An SgxPcsClient that caches the responses of another SgxPcsClient.
+//
+// TCB infos and CRLs are kept until their "nextUpdate" time, and all other
+// responses for CachingSgxPcsClientOptions::default_ttl. Errors are never
+// cached. Concurrent calls that miss the cache for the same arguments share a
+// single call to the underlying client.
+//
+// CachingSgxPcsClient is thread-safe.
+class CachingSgxPcsClient : public SgxPcsClient {
+ public:
+  // Creates a client that caches the responses of |client|, which must not be
+  // nullptr.
+  explicit CachingSgxPcsClient(
+      std::unique_ptr<SgxPcsClient> client,
+      CachingSgxPcsClientOptions options = CachingSgxPcsClientOptions());
+
+  CachingSgxPcsClient(const CachingSgxPcsClient &other) = delete;
+  CachingSgxPcsClient &operator=(const CachingSgxPcsClient &other) = delete;
+
+  // Waits for any background refreshes to finish.
+  ~CachingSgxPcsClient() override;
+
+  // From SgxPcsClient.
+
+  StatusOr<GetPckCertificateResult> GetPckCertificate(
+      const Ppid &ppid, const CpuSvn &cpu_svn, const PceSvn &pce_svn,
+      const PceId &pce_id) override;
+
+  StatusOr<GetPckCertificatesResult> GetPckCertificates(
+      const Ppid &ppid, const PceId &pce_id) override;
+
+  StatusOr<GetCrlResult> GetCrl(SgxCaType sgx_ca_type) override;
+
+  StatusOr<GetTcbInfoResult> GetTcbInfo(const Fmspc &fmspc) override;
+
+ private:
+  // Fetches a response from the underlying client.
+  using FetchFunction = std::function<StatusOr<CachedPcsResponse>()>;
+
+  // A cached response and the time at which it expires.
+  struct Entry {
+    CachedPcsResponse response;
+    absl::Time expiration;
+  };
+
+  // A call to the underlying client that other callers may wait on.
+  struct PendingFetch {
+    absl::Notification done;
+    StatusOr<CachedPcsResponse> result;
+  };
+
+  // Returns the cached response for |key|, or the response of |fetch| if there
+  // is no unexpired response for |key|.
+  StatusOr<CachedPcsResponse> Get(const std::string &key,
+                                  const FetchFunction &fetch);
+
+  // Calls |fetch|, or waits for a call that is already pending for |key|.
+  StatusOr<CachedPcsResponse> Fetch(const std::string &key,
+                                    const FetchFunction &fetch);
+
+  // Calls |fetch| on a background thread to replace the response for |key|.
+  void RefreshInBackground(const std::string &key, FetchFunction fetch)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Stores |result| for |key| if it is OK, and wakes the callers waiting on
+  // |pending|.
+  void Complete(const std::string &key, StatusOr<CachedPcsResponse> result,
+                PendingFetch *pending);
+
+  // Returns an entry for |response| with its expiration set.
+  StatusOr<Entry> CreateEntry(CachedPcsResponse response) const;
+
+  // Returns the time at which |response| expires, which is its "nextUpdate"
+  // time, or |now| plus the default TTL if it has none.
+  StatusOr<absl::Time> GetExpiration(const CachedPcsResponse &response,
+                                     absl::Time now) const;
+
+  // Returns the path of the file that stores the response for |key|.
+  std::string DiskPath(const std::string &key) const;
+
+  // Reads the response for |key| from the on-disk store, if there is one.
+  absl::optional<Entry> ReadFromDisk(const std::string &key) const;
+
+  // Writes |response| for |key| to the on-disk store.
+  void WriteToDisk(const std::string &key,
+                   const CachedPcsResponse &response) const;
+
+  const std::unique_ptr<SgxPcsClient> client_;
+  const CachingSgxPcsClientOptions options_;
+
+  absl::Mutex mu_;
+
+  // Unexpired responses keyed by the method and arguments of the call.
+  absl::flat_hash_map<std::string, Entry> cache_ ABSL_GUARDED_BY(mu_);
+
+  // Calls to the underlying client that have not returned yet.
+  absl::flat_hash_map<std::string, std::shared_ptr<PendingFetch>> pending_
+      ABSL_GUARDED_BY(mu_);
+
+  // The number of background refreshes that have not finished yet.
+  int background_refreshes_ ABSL_GUARDED_BY(mu_) = 0;
+};
+
+}  // namespace sgx
+}  // namespace asylo
+
+#endif  // ASYLO_IDENTITY_PROVISIONING_SGX_INTERNAL_CACHING_SGX_PCS_CLIENT_H_
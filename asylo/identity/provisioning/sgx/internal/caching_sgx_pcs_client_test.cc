@@ -0,0 +1,240 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/identity/provisioning/sgx/internal/caching_sgx_pcs_client.h"
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/flags/flag.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/time.h"
+#include "asylo/crypto/certificate.pb.h"
+#include "asylo/identity/provisioning/sgx/internal/mock_sgx_pcs_client.h"
+#include "asylo/identity/provisioning/sgx/internal/platform_provisioning.pb.h"
+#include "asylo/identity/provisioning/sgx/internal/sgx_pcs_client.h"
+#include "asylo/test/util/proto_matchers.h"
+#include "asylo/test/util/status_matchers.h"
+#include "asylo/test/util/test_flags.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+namespace sgx {
+namespace {
+
+using ::testing::Return;
+
+// A TCB info whose "nextUpdate" is 2020-03-20T20:20:20Z.
+constexpr char kTcbInfoJson[] = R"json({
+      "version": 1,
+      "issueDate": "2020-02-20T20:20:20Z",
+      "nextUpdate": "2020-03-20T20:20:20Z",
+      "fmspc": "0123456789ab",
+      "pceId": "0000",
+      "tcbLevels": [{
+        "tcb": {
+          "sgxtcbcomp01svn": 0,
+          "sgxtcbcomp02svn": 1,
+          "sgxtcbcomp03svn": 2,
+          "sgxtcbcomp04svn": 3,
+          "sgxtcbcomp05svn": 4,
+          "sgxtcbcomp06svn": 5,
+          "sgxtcbcomp07svn": 6,
+          "sgxtcbcomp08svn": 7,
+          "sgxtcbcomp09svn": 8,
+          "sgxtcbcomp10svn": 9,
+          "sgxtcbcomp11svn": 10,
+          "sgxtcbcomp12svn": 11,
+          "sgxtcbcomp13svn": 12,
+          "sgxtcbcomp14svn": 13,
+          "sgxtcbcomp15svn": 14,
+          "sgxtcbcomp16svn": 15,
+          "pcesvn": 2
+        },
+        "status": "UpToDate"
+      }]
+    })json";
+
+const absl::Time kNextUpdate =
+    absl::FromDateTime(2020, 3, 20, 20, 20, 20, absl::UTCTimeZone());
+
+GetTcbInfoResult CreateTcbInfoResult() {
+  GetTcbInfoResult result;
+  result.tcb_info.set_tcb_info_json(kTcbInfoJson);
+  result.tcb_info.set_signature("signature");
+  Certificate *cert = result.issuer_cert_chain.add_certificates();
+  cert->set_format(Certificate::X509_PEM);
+  cert->set_data("issuer");
+  return result;
+}
+
+GetPckCertificatesResult CreatePckCertificatesResult() {
+  GetPckCertificatesResult result;
+  result.pck_certs.add_certs()->mutable_cert()->set_data("pck");
+  return result;
+}
+
+Fmspc CreateFmspc() {
+  Fmspc fmspc;
+  fmspc.set_value("\x01\x23\x45\x67\x89\xab");
+  return fmspc;
+}
+
+class CachingSgxPcsClientTest : public ::testing::Test {
+ protected:
+  CachingSgxPcsClientTest()
+      : now_(kNextUpdate - absl::Hours(24 * 7)),
+        mock_client_(new MockSgxPcsClient) {
+    options_.refresh_margin = absl::ZeroDuration();
+    options_.clock = [this] {
+      absl::MutexLock lock(&now_mu_);
+      return now_;
+    };
+  }
+
+  void SetNow(absl::Time now) {
+    absl::MutexLock lock(&now_mu_);
+    now_ = now;
+  }
+
+  void AdvanceTime(absl::Duration duration) {
+    absl::MutexLock lock(&now_mu_);
+    now_ += duration;
+  }
+
+  // Creates the client under test, which takes ownership of |mock_client_|.
+  std::unique_ptr<CachingSgxPcsClient> CreateClient() {
+    return absl::make_unique<CachingSgxPcsClient>(
+        absl::WrapUnique(mock_client_), options_);
+  }
+
+  absl::Mutex now_mu_;
+  absl::Time now_ ABSL_GUARDED_BY(now_mu_);
+  MockSgxPcsClient *mock_client_;
+  CachingSgxPcsClientOptions options_;
+};
+
+TEST_F(CachingSgxPcsClientTest, TcbInfoIsCachedUntilNextUpdate) {
+  EXPECT_CALL(*mock_client_, GetTcbInfo)
+      .Times(2)
+      .WillRepeatedly(Return(CreateTcbInfoResult()));
+  std::unique_ptr<CachingSgxPcsClient> client = CreateClient();
+
+  GetTcbInfoResult expected = CreateTcbInfoResult();
+  for (int i = 0; i < 3; ++i) {
+    GetTcbInfoResult result;
+    ASYLO_ASSERT_OK_AND_ASSIGN(result, client->GetTcbInfo(CreateFmspc()));
+    EXPECT_THAT(result.tcb_info, EqualsProto(expected.tcb_info));
+    EXPECT_THAT(result.issuer_cert_chain,
+                EqualsProto(expected.issuer_cert_chain));
+  }
+
+  SetNow(kNextUpdate);
+  ASYLO_EXPECT_OK(client->GetTcbInfo(CreateFmspc()));
+}
+
+TEST_F(CachingSgxPcsClientTest, ResponsesWithoutNextUpdateUseDefaultTtl) {
+  options_.default_ttl = absl::Hours(1);
+  EXPECT_CALL(*mock_client_, GetPckCertificates)
+      .Times(2)
+      .WillRepeatedly(Return(CreatePckCertificatesResult()));
+  std::unique_ptr<CachingSgxPcsClient> client = CreateClient();
+
+  ASYLO_EXPECT_OK(client->GetPckCertificates(Ppid(), PceId()));
+  AdvanceTime(absl::Minutes(30));
+  ASYLO_EXPECT_OK(client->GetPckCertificates(Ppid(), PceId()));
+  AdvanceTime(absl::Minutes(30));
+  ASYLO_EXPECT_OK(client->GetPckCertificates(Ppid(), PceId()));
+}
+
+TEST_F(CachingSgxPcsClientTest, ErrorsAreNotCached) {
+  EXPECT_CALL(*mock_client_, GetTcbInfo)
+      .WillOnce(Return(Status(error::GoogleError::UNAVAILABLE, "PCS is down")))
+      .WillOnce(Return(CreateTcbInfoResult()));
+  std::unique_ptr<CachingSgxPcsClient> client = CreateClient();
+
+  EXPECT_THAT(client->GetTcbInfo(CreateFmspc()),
+              StatusIs(error::GoogleError::UNAVAILABLE));
+  ASYLO_EXPECT_OK(client->GetTcbInfo(CreateFmspc()));
+}
+
+TEST_F(CachingSgxPcsClientTest, ConcurrentMissesShareOneFetch) {
+  constexpr int kNumThreads = 8;
+
+  absl::Notification release_fetch;
+  EXPECT_CALL(*mock_client_, GetTcbInfo)
+      .WillOnce([&release_fetch](const Fmspc &fmspc) {
+        release_fetch.WaitForNotification();
+        return CreateTcbInfoResult();
+      });
+  std::unique_ptr<CachingSgxPcsClient> client = CreateClient();
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back(
+        [&client] { ASYLO_EXPECT_OK(client->GetTcbInfo(CreateFmspc())); });
+  }
+  release_fetch.Notify();
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+
+TEST_F(CachingSgxPcsClientTest, ResponsesAreRefreshedInBackground) {
+  options_.refresh_margin = absl::Hours(1);
+  SetNow(kNextUpdate - absl::Minutes(30));
+
+  absl::Notification refreshed;
+  EXPECT_CALL(*mock_client_, GetTcbInfo)
+      .WillOnce(Return(CreateTcbInfoResult()))
+      .WillOnce([&refreshed](const Fmspc &fmspc) {
+        refreshed.Notify();
+        return CreateTcbInfoResult();
+      });
+  std::unique_ptr<CachingSgxPcsClient> client = CreateClient();
+
+  ASYLO_EXPECT_OK(client->GetTcbInfo(CreateFmspc()));
+
+  // The response is about to expire, so it is served while being refreshed.
+  ASYLO_EXPECT_OK(client->GetTcbInfo(CreateFmspc()));
+  refreshed.WaitForNotification();
+}
+
+TEST_F(CachingSgxPcsClientTest, OnDiskStoreIsSharedAcrossClients) {
+  options_.cache_directory = absl::GetFlag(FLAGS_test_tmpdir);
+  EXPECT_CALL(*mock_client_, GetTcbInfo)
+      .WillOnce(Return(CreateTcbInfoResult()));
+  ASYLO_EXPECT_OK(CreateClient()->GetTcbInfo(CreateFmspc()));
+
+  mock_client_ = new MockSgxPcsClient;
+  EXPECT_CALL(*mock_client_, GetTcbInfo).Times(0);
+  GetTcbInfoResult result;
+  ASYLO_ASSERT_OK_AND_ASSIGN(result, CreateClient()->GetTcbInfo(CreateFmspc()));
+  EXPECT_THAT(result.tcb_info, EqualsProto(CreateTcbInfoResult().tcb_info));
+}
+
+}  // namespace
+}  // namespace sgx
+}  // namespace asylo
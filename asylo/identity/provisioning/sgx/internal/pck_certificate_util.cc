@@ -23,6 +23,7 @@
 #include <array>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <functional>
 #include <memory>
 #include <string>
@@ -74,12 +75,17 @@ enum class Optionality { REQUIRED, OPTIONAL };
 // Information needed to read a particular extension.
 struct ReadInfo {
   // The function used to read the ASN.1 value.
-  std::function<Status(const Asn1Value &)> read_function;
+  std::function<Status(const Asn1View &)> read_function;
 
   // Whether the extension is required or optional.
   Optionality optionality;
 };
 
+// A list of OIDs and the information needed to read their values. Each OID
+// appears at most once. A small list is scanned faster than a hash map can be
+// built, and scanning it does not need to allocate an ObjectId per element.
+using ReadInfoList = std::vector<std::pair<ObjectId, ReadInfo>>;
+
 // Returns an OBJECT IDENTIFIER for |oid_string|. Crashes the program on
 // failure.
 ObjectId CreateOidOrDie(const std::string &oid_string);
@@ -147,23 +153,42 @@ const SgxOidsStruct &GetSgxOids() {
   return *oids;
 }
 
-// If |asn1| is an OCTET STRING with size |expected_size|, returns its octets.
-// Otherwise, returns an error.
-StatusOr<std::vector<uint8_t>> ReadOctetStringWithSize(const Asn1Value &asn1,
-                                                       size_t expected_size) {
-  std::vector<uint8_t> bytes;
-  ASYLO_ASSIGN_OR_RETURN(bytes, asn1.GetOctetString());
-  if (bytes.size() != expected_size) {
+// If |asn1| is an OCTET STRING with size |expected_size|, copies its octets to
+// |bytes|. Otherwise, returns an error.
+Status ReadOctetStringWithSize(const Asn1View &asn1, size_t expected_size,
+                               std::string *bytes) {
+  StatusOr<ByteContainerView> octets_result = asn1.GetOctetString();
+  if (!octets_result.ok()) {
+    return octets_result.status();
+  }
+  ByteContainerView octets = octets_result.ValueOrDie();
+  if (octets.size() != expected_size) {
     return Status(
         error::GoogleError::INVALID_ARGUMENT,
         absl::StrFormat("Expected a container of size %d, found size %d",
-                        expected_size, bytes.size()));
+                        expected_size, octets.size()));
   }
-  return bytes;
+  bytes->assign(reinterpret_cast<const char *>(octets.data()), octets.size());
+  return Status::OkStatus();
+}
+
+// Returns the OID string of |oid| for use in error messages.
+std::string OidStringForError(const ObjectId &oid) {
+  auto oid_string_result = oid.GetOidString();
+  return oid_string_result.ok() ? oid_string_result.ValueOrDie()
+                                : "<could not print OID>";
+}
+
+// Returns the OID string of the OBJECT IDENTIFIER |oid_asn1| for use in error
+// messages.
+std::string OidStringForError(const Asn1View &oid_asn1) {
+  auto oid_result = oid_asn1.GetObjectId();
+  return oid_result.ok() ? OidStringForError(oid_result.ValueOrDie())
+                         : "<could not print OID>";
 }
 
 // Returns a schema for a sequence of (OID, ANY) pairs with a minimum length of
-// one.
+// one. Only used for writing; reading goes through ReadOidAnySequence().
 const Asn1Schema<std::vector<std::tuple<ObjectId, Asn1Value>>>
     &OidAnySequenceSchema() {
   static const auto *kSchema =
@@ -173,42 +198,64 @@ const Asn1Schema<std::vector<std::tuple<ObjectId, Asn1Value>>>
   return *kSchema;
 }
 
-// For each (OID, ASN.1 value) pair in |sequence|, ReadOidAnySequence() calls
-// the function in |read_infos| corresponding to the OID on the ASN.1 value.
-// ReadOidAnySequence() fails if:
+// |asn1| must be a non-empty sequence of (OID, ANY) pairs. For each pair,
+// ReadOidAnySequence() calls the function in |read_infos| corresponding to the
+// OID on a view of the ASN.1 value. ReadOidAnySequence() fails if:
 //
-//   * Any OID appears more than once in |sequence|.
-//   * Any OID in |sequence| is not a key in |read_infos|.
+//   * |asn1| is not a non-empty sequence of (OID, ANY) pairs.
+//   * Any OID appears more than once in |asn1|.
+//   * Any OID in |asn1| is not in |read_infos|.
 //   * Any of the calls to the functions in |read_infos| returns a non-OK
 //     status.
-//   * An OID in |read_infos| is marked as REQUIRED but is not found in
-//     |sequence|.
-Status ReadOidAnySequence(
-    absl::flat_hash_map<ObjectId, ReadInfo> read_infos,
-    const std::vector<std::tuple<ObjectId, Asn1Value>> &sequence) {
-  absl::flat_hash_set<ObjectId> found_oids;
+//   * An OID in |read_infos| is marked as REQUIRED but is not found in |asn1|.
+Status ReadOidAnySequence(const ReadInfoList &read_infos,
+                          const Asn1View &asn1) {
+  std::vector<Asn1View> sequence;
+  ASYLO_ASSIGN_OR_RETURN(sequence, asn1.GetSequence());
+  if (sequence.empty()) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Sequence has size 0, but size at least 1 was expected");
+  }
+
+  std::vector<bool> found(read_infos.size(), false);
   std::vector<std::string> errors;
-  for (auto pair : sequence) {
-    ObjectId oid;
-    Asn1Value asn1;
-    std::tie(oid, asn1) = std::move(pair);
-    auto oid_string_result = oid.GetOidString();
-    std::string oid_string = oid_string_result.ok()
-                                 ? oid_string_result.ValueOrDie()
-                                 : "<could not print OID>";
-    if (!found_oids.insert(oid).second) {
-      errors.push_back(absl::StrCat("Found repeated OID: ", oid_string));
+  std::vector<Asn1View> pair;
+  for (const Asn1View &element : sequence) {
+    ASYLO_ASSIGN_OR_RETURN(pair, element.GetSequence());
+    if (pair.size() != 2) {
+      return Status(
+          error::GoogleError::INVALID_ARGUMENT,
+          absl::StrFormat("Sequence has size %d, but size 2 was expected",
+                          pair.size()));
+    }
+    const Asn1View &oid_asn1 = pair[0];
+    if (oid_asn1.Type() != Asn1Type::kObjectId) {
+      return Status(error::GoogleError::INVALID_ARGUMENT,
+                    "Expected an OBJECT IDENTIFIER");
+    }
+
+    size_t index = 0;
+    while (index < read_infos.size() &&
+           !oid_asn1.IsObjectId(read_infos[index].first)) {
+      ++index;
+    }
+    if (index == read_infos.size()) {
+      errors.push_back(
+          absl::StrCat("Unexpected OID: ", OidStringForError(oid_asn1)));
       continue;
     }
-    const auto it = read_infos.find(oid);
-    if (it == read_infos.end()) {
-      auto oid_string_result = oid.GetOidString();
-      errors.push_back(absl::StrCat("Unexpected OID: ", oid_string));
+    if (found[index]) {
+      errors.push_back(
+          absl::StrCat("Found repeated OID: ", OidStringForError(oid_asn1)));
       continue;
     }
-    Status read_status = it->second.read_function(asn1).WithPrependedContext(
-        absl::StrFormat("Error reading value for OID %s: ", oid_string));
+    found[index] = true;
+
+    Status read_status = read_infos[index].second.read_function(pair[1]);
     if (!read_status.ok()) {
+      read_status = read_status.WithPrependedContext(
+          absl::StrFormat("Error reading value for OID %s: ",
+                          OidStringForError(read_infos[index].first)));
       if (read_status.CanonicalCode() == error::GoogleError::INVALID_ARGUMENT) {
         errors.push_back(std::string(read_status.error_message()));
       } else {
@@ -216,13 +263,10 @@ Status ReadOidAnySequence(
       }
     }
   }
-  for (auto pair : read_infos) {
-    ObjectId oid;
-    ReadInfo read_info;
-    std::tie(oid, read_info) = std::move(pair);
-    if (read_info.optionality == Optionality::REQUIRED &&
-        !found_oids.contains(oid)) {
-      auto oid_string_result = oid.GetOidString();
+  for (size_t i = 0; i < read_infos.size(); ++i) {
+    if (read_infos[i].second.optionality == Optionality::REQUIRED &&
+        !found[i]) {
+      auto oid_string_result = read_infos[i].first.GetOidString();
       errors.push_back(oid_string_result.ok()
                            ? absl::StrCat("Missing extension with OID ",
                                           oid_string_result.ValueOrDie())
@@ -252,10 +296,10 @@ Status ValidateSgxExtensions(const SgxExtensions &extensions) {
 }
 
 // Reads |asn1| as a TCB ASN.1 value into |tcb| and |cpu_svn|.
-Status ReadTcb(const Asn1Value &asn1, Tcb *tcb, CpuSvn *cpu_svn) {
-  absl::flat_hash_map<ObjectId, ReadInfo> read_functions(
+Status ReadTcb(const Asn1View &asn1, Tcb *tcb, CpuSvn *cpu_svn) {
+  ReadInfoList read_functions(
       {{GetSgxOids().pce_svn,
-        {[tcb](const Asn1Value &asn1) {
+        {[tcb](const Asn1View &asn1) {
            uint16_t pce_svn;
            ASYLO_ASSIGN_OR_RETURN(pce_svn, asn1.GetIntegerAsInt<uint16_t>());
            tcb->mutable_pce_svn()->set_value(pce_svn);
@@ -263,35 +307,31 @@ Status ReadTcb(const Asn1Value &asn1, Tcb *tcb, CpuSvn *cpu_svn) {
          },
          Optionality::REQUIRED}},
        {GetSgxOids().cpu_svn,
-        {[cpu_svn](const Asn1Value &asn1) {
-           std::vector<uint8_t> cpu_svn_bytes;
-           ASYLO_ASSIGN_OR_RETURN(cpu_svn_bytes,
-                                  ReadOctetStringWithSize(asn1, kCpusvnSize));
-           cpu_svn->set_value(cpu_svn_bytes.data(), cpu_svn_bytes.size());
-           return Status::OkStatus();
+        {[cpu_svn](const Asn1View &asn1) {
+           return ReadOctetStringWithSize(asn1, kCpusvnSize,
+                                          cpu_svn->mutable_value());
          },
          Optionality::REQUIRED}}});
-  ObjectId oid;
+  read_functions.reserve(read_functions.size() + kTcbComponentsSize);
   for (int i = 0; i < kTcbComponentsSize; ++i) {
-    read_functions.insert({GetSgxOids().sgx_tcb_comp_svns[i],
-                           {[tcb, i](const Asn1Value &asn1) {
-                              // Read as a uint8_t and cast to disallow negative
-                              // values.
-                              uint8_t component;
-                              ASYLO_ASSIGN_OR_RETURN(
-                                  component, asn1.GetIntegerAsInt<uint8_t>());
-                              (*tcb->mutable_components())[i] =
-                                  *reinterpret_cast<char *>(&component);
-                              return Status::OkStatus();
-                            },
-                            Optionality::REQUIRED}});
+    read_functions.push_back({GetSgxOids().sgx_tcb_comp_svns[i],
+                              {[tcb, i](const Asn1View &asn1) {
+                                 // Read as a uint8_t and cast to disallow
+                                 // negative values.
+                                 uint8_t component;
+                                 ASYLO_ASSIGN_OR_RETURN(
+                                     component,
+                                     asn1.GetIntegerAsInt<uint8_t>());
+                                 (*tcb->mutable_components())[i] =
+                                     *reinterpret_cast<char *>(&component);
+                                 return Status::OkStatus();
+                               },
+                               Optionality::REQUIRED}});
   }
 
-  std::vector<std::tuple<ObjectId, Asn1Value>> sequence;
-  ASYLO_ASSIGN_OR_RETURN(sequence, OidAnySequenceSchema().Read(asn1));
   // Ensure that tcb.components has a slot for each TCB component.
   tcb->mutable_components()->resize(kTcbComponentsSize);
-  return ReadOidAnySequence(read_functions, sequence);
+  return ReadOidAnySequence(read_functions, asn1);
 }
 
 // Writes |tcb| and |cpu_svn| to a TCB ASN.1 value.
@@ -347,47 +387,47 @@ Status ValidatePckCertificateInfo(
 const ObjectId &GetSgxExtensionsOid() { return GetSgxOids().sgx_extensions; }
 
 StatusOr<SgxExtensions> ReadSgxExtensions(const Asn1Value &extensions_asn1) {
-  std::vector<std::tuple<ObjectId, Asn1Value>> sequence;
-  ASYLO_ASSIGN_OR_RETURN(sequence,
-                         OidAnySequenceSchema().Read(extensions_asn1));
+  std::vector<uint8_t> der;
+  ASYLO_ASSIGN_OR_RETURN(der, extensions_asn1.SerializeToDer());
+  Asn1View extensions_view;
+  ASYLO_ASSIGN_OR_RETURN(extensions_view, Asn1View::Create(der));
+  return ReadSgxExtensions(extensions_view);
+}
+
+StatusOr<SgxExtensions> ReadSgxExtensions(const Asn1View &extensions_asn1) {
   SgxExtensions extensions;
-  absl::flat_hash_set<ObjectId> sequence_oids;
   ASYLO_RETURN_IF_ERROR(ReadOidAnySequence(
       {{GetSgxOids().ppid,
-        {[&extensions](const Asn1Value &asn1) {
-           std::vector<uint8_t> ppid_bytes;
-           ASYLO_ASSIGN_OR_RETURN(ppid_bytes,
-                                  ReadOctetStringWithSize(asn1, kPpidSize));
-           extensions.ppid.set_value(ppid_bytes.data(), ppid_bytes.size());
-           return Status::OkStatus();
+        {[&extensions](const Asn1View &asn1) {
+           return ReadOctetStringWithSize(asn1, kPpidSize,
+                                          extensions.ppid.mutable_value());
          },
          Optionality::REQUIRED}},
        {GetSgxOids().tcb,
-        {[&extensions](const Asn1Value &asn1) {
+        {[&extensions](const Asn1View &asn1) {
            return ReadTcb(asn1, &extensions.tcb, &extensions.cpu_svn);
          },
          Optionality::REQUIRED}},
        {GetSgxOids().pce_id,
-        {[&extensions](const Asn1Value &asn1) {
-           std::vector<uint8_t> pce_id_bytes;
-           ASYLO_ASSIGN_OR_RETURN(
-               pce_id_bytes, ReadOctetStringWithSize(asn1, sizeof(uint16_t)));
-           extensions.pce_id.set_value(
-               le16toh(*reinterpret_cast<uint16_t *>(pce_id_bytes.data())));
+        {[&extensions](const Asn1View &asn1) {
+           std::string pce_id_bytes;
+           ASYLO_RETURN_IF_ERROR(ReadOctetStringWithSize(
+               asn1, sizeof(uint16_t), &pce_id_bytes));
+           uint16_t pce_id_little_endian;
+           memcpy(&pce_id_little_endian, pce_id_bytes.data(),
+                  sizeof(pce_id_little_endian));
+           extensions.pce_id.set_value(le16toh(pce_id_little_endian));
            return Status::OkStatus();
          },
          Optionality::REQUIRED}},
        {GetSgxOids().fmspc,
-        {[&extensions](const Asn1Value &asn1) {
-           std::vector<uint8_t> fmspc_bytes;
-           ASYLO_ASSIGN_OR_RETURN(fmspc_bytes,
-                                  ReadOctetStringWithSize(asn1, kFmspcSize));
-           extensions.fmspc.set_value(fmspc_bytes.data(), fmspc_bytes.size());
-           return Status::OkStatus();
+        {[&extensions](const Asn1View &asn1) {
+           return ReadOctetStringWithSize(asn1, kFmspcSize,
+                                          extensions.fmspc.mutable_value());
          },
          Optionality::REQUIRED}},
        {GetSgxOids().sgx_type,
-        {[&extensions](const Asn1Value &asn1) {
+        {[&extensions](const Asn1View &asn1) {
            using UnderlyingType = std::underlying_type<SgxTypeRaw>::type;
            UnderlyingType raw;
            ASYLO_ASSIGN_OR_RETURN(raw,
@@ -395,8 +435,8 @@ StatusOr<SgxExtensions> ReadSgxExtensions(const Asn1Value &extensions_asn1) {
            ASYLO_ASSIGN_OR_RETURN(extensions.sgx_type, FromRawSgxType(raw));
            return Status::OkStatus();
          },
-      Optionality::REQUIRED}}},
-      sequence));
+         Optionality::REQUIRED}}},
+      extensions_asn1));
   return extensions;
 }
 
@@ -60,6 +60,10 @@ const ObjectId &GetSgxExtensionsOid();
 // Reads the SGX-specific extension data in |extensions_asn1|.
 StatusOr<SgxExtensions> ReadSgxExtensions(const Asn1Value &extensions_asn1);
 
+// Reads the SGX-specific extension data in |extensions_asn1| directly from its
+// DER encoding, without building a tree of Asn1Values.
+StatusOr<SgxExtensions> ReadSgxExtensions(const Asn1View &extensions_asn1);
+
 // Writes the SGX-specific extension data in |extensions| to an Asn1Value. This
 // is only intended to be used for testing.
 StatusOr<Asn1Value> WriteSgxExtensions(const SgxExtensions &extensions);
@@ -625,6 +625,19 @@ TEST(PckCertificateUtilTest, SgxExtensionsRoundtrip) {
               IsOkAndHolds(SgxExtensionsEquals(extensions)));
 }
 
+TEST(PckCertificateUtilTest, SgxExtensionsCanBeReadFromDerView) {
+  SgxExtensions extensions = CreateValidSgxExtensions();
+  Asn1Value extensions_asn1;
+  ASYLO_ASSERT_OK_AND_ASSIGN(extensions_asn1, WriteSgxExtensions(extensions));
+  std::vector<uint8_t> extensions_der;
+  ASYLO_ASSERT_OK_AND_ASSIGN(extensions_der, extensions_asn1.SerializeToDer());
+  Asn1View extensions_view;
+  ASYLO_ASSERT_OK_AND_ASSIGN(extensions_view,
+                             Asn1View::Create(extensions_der));
+  EXPECT_THAT(ReadSgxExtensions(extensions_view),
+              IsOkAndHolds(SgxExtensionsEquals(extensions)));
+}
+
 TEST(PckCertificateUtilTest, SgxExtensionsElementsCanBeInAnyOrder) {
   SgxExtensions extensions = CreateValidSgxExtensions();
   Asn1Value extensions_asn1;
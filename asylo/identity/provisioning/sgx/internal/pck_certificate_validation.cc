@@ -0,0 +1,336 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/identity/provisioning/sgx/internal/pck_certificate_validation.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <google/protobuf/text_format.h>
+#include <google/protobuf/util/message_differencer.h>
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include "asylo/crypto/certificate_util.h"
+#include "asylo/crypto/x509_certificate.h"
+#include "asylo/identity/provisioning/sgx/internal/pck_certificate_util.h"
+#include "asylo/util/path.h"
+#include "asylo/util/posix_error_space.h"
+#include "asylo/util/proto_parse_util.h"
+#include "asylo/util/status.h"
+#include "asylo/util/status.pb.h"
+#include "asylo/util/status_macros.h"
+
+namespace asylo {
+namespace sgx {
+
+const char kPckCertificateValidationOutputExtension[] = ".validation";
+
+namespace {
+
+using ::google::protobuf::util::MessageDifferencer;
+
+// Returns the factories for the certificate formats used in PCK certificate
+// chains.
+const CertificateFactoryMap &GetPckCertificateFactories() {
+  static const CertificateFactoryMap *const kFactories =
+      new CertificateFactoryMap(
+          {{Certificate::X509_DER, X509Certificate::Create},
+           {Certificate::X509_PEM, X509Certificate::Create}});
+  return *kFactories;
+}
+
+StatusProto ToStatusProto(const Status &status) {
+  StatusProto status_proto;
+  status.SaveTo(&status_proto);
+  return status_proto;
+}
+
+// Returns a Status describing the current value of errno.
+Status ErrnoStatus(absl::string_view context) {
+  int error_number = errno;
+  char buf[128] = {};
+  return Status(static_cast<error::PosixError>(error_number),
+                absl::StrCat(context, ": ",
+                             strerror_r(error_number, buf, sizeof(buf))));
+}
+
+// Reads the PckCertificates message in text format in |path| and checks that
+// it is well-formed.
+StatusOr<PckCertificates> ReadPckCertificatesFile(const std::string &path) {
+  std::ifstream input(path);
+  if (!input) {
+    return ErrnoStatus(absl::StrCat("Unable to open ", path));
+  }
+  std::stringstream contents;
+  contents << input.rdbuf();
+
+  PckCertificates pck_certificates;
+  ASYLO_ASSIGN_OR_RETURN(pck_certificates,
+                         ParseTextProto<PckCertificates>(contents.str()));
+  ASYLO_RETURN_IF_ERROR(ValidatePckCertificates(pck_certificates));
+  return pck_certificates;
+}
+
+// Writes |results| to |path| in text format. The results are first written to
+// a temporary file, which is then renamed to |path|, so that |path| only ever
+// holds complete results.
+Status WriteResultsFile(const PckCertificateValidationResults &results,
+                        const std::string &path) {
+  std::string text;
+  if (!google::protobuf::TextFormat::PrintToString(results, &text)) {
+    return Status(error::GoogleError::INTERNAL,
+                  absl::StrCat("Unable to format results for ", path));
+  }
+
+  std::string temp_path = absl::StrCat(path, ".tmp");
+  {
+    std::ofstream output(temp_path, std::ios::trunc);
+    output << text;
+    output.close();
+    if (!output) {
+      return ErrnoStatus(absl::StrCat("Unable to write ", temp_path));
+    }
+  }
+  if (rename(temp_path.c_str(), path.c_str()) != 0) {
+    return ErrnoStatus(absl::StrCat("Unable to rename ", temp_path));
+  }
+  return Status::OkStatus();
+}
+
+// Parses the chain formed by |pck_cert| followed by |issuer_cert_chain|.
+StatusOr<CertificateInterfaceVector> CreatePckCertificateChain(
+    const Certificate &pck_cert, const CertificateChain &issuer_cert_chain) {
+  CertificateChain chain;
+  *chain.add_certificates() = pck_cert;
+  chain.mutable_certificates()->MergeFrom(issuer_cert_chain.certificates());
+  return CreateCertificateChain(GetPckCertificateFactories(), chain);
+}
+
+// Checks that the SGX extensions of a PCK certificate agree with the TCB level
+// and TCBM that the certificate is listed under in |info|.
+Status CheckSgxExtensions(const SgxExtensions &extensions,
+                          const PckCertificates::PckCertificateInfo &info) {
+  if (!MessageDifferencer::Equals(extensions.tcb, info.tcb_level())) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "TCB in SGX extensions does not match TCB level");
+  }
+  if (!MessageDifferencer::Equals(extensions.cpu_svn, info.tcbm().cpu_svn())) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "CPU SVN in SGX extensions does not match TCBM");
+  }
+  return Status::OkStatus();
+}
+
+// Validates the file at |input_file| and returns its results.
+PckCertificateValidationResults ValidateInputFile(
+    const std::string &input_file,
+    const PckCertificateValidationOptions &options) {
+  PckCertificateValidationResults results;
+  results.set_input_file(input_file);
+
+  StatusOr<PckCertificates> pck_certificates_result =
+      ReadPckCertificatesFile(input_file);
+  *results.mutable_status() = ToStatusProto(pck_certificates_result.status());
+  if (!pck_certificates_result.ok()) {
+    return results;
+  }
+
+  for (PckCertificateValidationResult &result : ValidatePckCertificateSet(
+           pck_certificates_result.ValueOrDie(), options.issuer_cert_chain,
+           options.verification_config)) {
+    *results.add_results() = std::move(result);
+  }
+  return results;
+}
+
+bool IsOk(const StatusProto &status) {
+  return status.code() == error::GoogleError::OK;
+}
+
+// Returns true if |results| shows that every PCK certificate was valid.
+bool AllValid(const PckCertificateValidationResults &results) {
+  return IsOk(results.status()) &&
+         std::all_of(results.results().begin(), results.results().end(),
+                     [](const PckCertificateValidationResult &result) {
+                       return IsOk(result.status());
+                     });
+}
+
+}  // namespace
+
+std::string GetPckCertificateValidationOutputPath(
+    absl::string_view output_directory, absl::string_view input_file) {
+  absl::string_view base_name = input_file.substr(input_file.rfind('/') + 1);
+  return JoinPath(output_directory,
+                  absl::StrCat(base_name,
+                               kPckCertificateValidationOutputExtension));
+}
+
+std::vector<PckCertificateValidationResult> ValidatePckCertificateSet(
+    const PckCertificates &pck_certificates,
+    const CertificateChain &issuer_cert_chain,
+    const VerificationConfig &verification_config) {
+  const int num_certs = pck_certificates.certs_size();
+  std::vector<PckCertificateValidationResult> results(num_certs);
+  std::vector<Status> statuses(num_certs);
+  std::vector<CertificateInterfaceVector> chains(num_certs);
+
+  // Parse all chains first, so that the links to the issuer CAs, which all
+  // chains share, are only verified once.
+  std::vector<CertificateInterfaceSpan> parsed_chains;
+  std::vector<int> parsed_chain_indices;
+  for (int i = 0; i < num_certs; ++i) {
+    const PckCertificates::PckCertificateInfo &info =
+        pck_certificates.certs(i);
+    *results[i].mutable_tcbm() = info.tcbm();
+
+    StatusOr<CertificateInterfaceVector> chain_result =
+        CreatePckCertificateChain(info.cert(), issuer_cert_chain);
+    if (!chain_result.ok()) {
+      statuses[i] = chain_result.status();
+      continue;
+    }
+    chains[i] = std::move(chain_result).ValueOrDie();
+    parsed_chains.push_back(chains[i]);
+    parsed_chain_indices.push_back(i);
+  }
+
+  std::vector<Status> verify_statuses =
+      VerifyCertificateChains(parsed_chains, verification_config);
+  for (size_t j = 0; j < verify_statuses.size(); ++j) {
+    statuses[parsed_chain_indices[j]] = std::move(verify_statuses[j]);
+  }
+
+  for (int i = 0; i < num_certs; ++i) {
+    if (statuses[i].ok()) {
+      StatusOr<SgxExtensions> extensions_result =
+          ExtractSgxExtensionsFromPckCert(*chains[i].front());
+      if (extensions_result.ok()) {
+        const SgxExtensions &extensions = extensions_result.ValueOrDie();
+        *results[i].mutable_fmspc() = extensions.fmspc;
+        statuses[i] =
+            CheckSgxExtensions(extensions, pck_certificates.certs(i));
+      } else {
+        statuses[i] = extensions_result.status();
+      }
+    }
+    *results[i].mutable_status() = ToStatusProto(statuses[i]);
+  }
+  return results;
+}
+
+StatusOr<PckCertificateValidationSummary> ValidatePckCertificateFiles(
+    absl::Span<const std::string> input_files,
+    const PckCertificateValidationOptions &options) {
+  if (options.num_threads <= 0) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Number of threads must be positive");
+  }
+  if (options.output_directory.empty()) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Output directory must be specified");
+  }
+
+  CertificateInterfaceVector issuer_chain;
+  ASYLO_ASSIGN_OR_RETURN(issuer_chain,
+                         CreateCertificateChain(GetPckCertificateFactories(),
+                                                options.issuer_cert_chain));
+  Status issuer_status =
+      VerifyCertificateChain(issuer_chain, options.verification_config);
+  if (!issuer_status.ok()) {
+    return issuer_status.WithPrependedContext(
+        "Invalid issuer certificate chain");
+  }
+
+  std::vector<std::string> output_paths;
+  output_paths.reserve(input_files.size());
+  absl::flat_hash_set<std::string> unique_output_paths;
+  for (const std::string &input_file : input_files) {
+    output_paths.push_back(GetPckCertificateValidationOutputPath(
+        options.output_directory, input_file));
+    if (!unique_output_paths.insert(output_paths.back()).second) {
+      return Status(
+          error::GoogleError::INVALID_ARGUMENT,
+          absl::StrCat("More than one input file would write results to ",
+                       output_paths.back()));
+    }
+  }
+
+  // Each thread claims the next input file until all files are claimed or a
+  // results file cannot be written.
+  std::atomic<size_t> next_input(0);
+  absl::Mutex mu;
+  PckCertificateValidationSummary summary;
+  Status write_status;
+  auto validate_files = [&] {
+    for (size_t i = next_input++; i < input_files.size(); i = next_input++) {
+      if (access(output_paths[i].c_str(), F_OK) == 0) {
+        absl::MutexLock lock(&mu);
+        ++summary.skipped_files;
+        continue;
+      }
+
+      PckCertificateValidationResults results =
+          ValidateInputFile(input_files[i], options);
+      Status status = WriteResultsFile(results, output_paths[i]);
+
+      absl::MutexLock lock(&mu);
+      if (!status.ok()) {
+        write_status = std::move(status);
+        next_input = input_files.size();
+        return;
+      }
+      if (AllValid(results)) {
+        ++summary.valid_files;
+      } else {
+        ++summary.invalid_files;
+      }
+    }
+  };
+
+  size_t num_threads = std::min<size_t>(options.num_threads,
+                                        input_files.size());
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads);
+  for (size_t i = 0; i < num_threads; ++i) {
+    threads.emplace_back(validate_files);
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  ASYLO_RETURN_IF_ERROR(write_status);
+  return summary;
+}
+
+}  // namespace sgx
+}  // namespace asylo
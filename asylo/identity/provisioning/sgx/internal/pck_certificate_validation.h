@@ -0,0 +1,105 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_IDENTITY_PROVISIONING_SGX_INTERNAL_PCK_CERTIFICATE_VALIDATION_H_
+#define ASYLO_IDENTITY_PROVISIONING_SGX_INTERNAL_PCK_CERTIFICATE_VALIDATION_H_
+
+#include <string>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "asylo/crypto/certificate.pb.h"
+#include "asylo/crypto/certificate_interface.h"
+#include "asylo/identity/provisioning/sgx/internal/pck_certificate_validation.pb.h"
+#include "asylo/identity/provisioning/sgx/internal/pck_certificates.pb.h"
+#include "asylo/util/statusor.h"
+
+namespace asylo {
+namespace sgx {
+
+// The extension added to the name of an input file to form the name of the
+// file that its results are written to.
+extern const char kPckCertificateValidationOutputExtension[];
+
+// Options for ValidatePckCertificateFiles().
+struct PckCertificateValidationOptions {
+  // The certificates that issued the PCK certificates, starting with the PCK
+  // issuer CA and ending with the self-signed root CA.
+  CertificateChain issuer_cert_chain;
+
+  // The checks applied when verifying the chain of each PCK certificate.
+  VerificationConfig verification_config{/*all_fields=*/true};
+
+  // The number of threads that validate input files. Must be positive.
+  int num_threads = 1;
+
+  // The existing directory that results are written to.
+  std::string output_directory;
+};
+
+// The number of input files handled in each way by
+// ValidatePckCertificateFiles().
+struct PckCertificateValidationSummary {
+  // Files in which every PCK certificate was valid.
+  int valid_files = 0;
+
+  // Files that could not be read, were malformed, or held an invalid PCK
+  // certificate.
+  int invalid_files = 0;
+
+  // Files whose results were already in the output directory.
+  int skipped_files = 0;
+};
+
+// Returns the path of the file in |output_directory| that holds the results
+// for |input_file|.
+std::string GetPckCertificateValidationOutputPath(
+    absl::string_view output_directory, absl::string_view input_file);
+
+// Validates each certificate in |pck_certificates|, which must already have
+// passed ValidatePckCertificates(). A certificate is valid if the chain formed
+// by the certificate and |issuer_cert_chain| verifies under
+// |verification_config|, and if the SGX extensions in the certificate agree
+// with its TCB level and TCBM.
+std::vector<PckCertificateValidationResult> ValidatePckCertificateSet(
+    const PckCertificates &pck_certificates,
+    const CertificateChain &issuer_cert_chain,
+    const VerificationConfig &verification_config);
+
+// Validates the PckCertificates messages in |input_files|, which are in text
+// format, using |options|.num_threads threads. The results for each input file
+// are written to the output directory as a PckCertificateValidationResults
+// message in text format as soon as that file has been validated.
+//
+// Results files are written atomically, so an interrupted run can be resumed
+// by calling this function again with the same arguments. Input files whose
+// results are already in the output directory are skipped.
+//
+// Returns a non-OK Status if |options| are invalid, if |issuer_cert_chain| does
+// not verify, if two input files would share a results file, or if a results
+// file could not be written. Problems with individual input files are recorded
+// in their results files instead.
+StatusOr<PckCertificateValidationSummary> ValidatePckCertificateFiles(
+    absl::Span<const std::string> input_files,
+    const PckCertificateValidationOptions &options);
+
+}  // namespace sgx
+}  // namespace asylo
+
+#endif  // ASYLO_IDENTITY_PROVISIONING_SGX_INTERNAL_PCK_CERTIFICATE_VALIDATION_H_
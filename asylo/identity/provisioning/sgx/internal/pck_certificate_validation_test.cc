@@ -0,0 +1,230 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/identity/provisioning/sgx/internal/pck_certificate_validation.h"
+
+#include <stdlib.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <google/protobuf/text_format.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/flags/flag.h"
+#include "absl/strings/str_cat.h"
+#include "absl/types/optional.h"
+#include "asylo/crypto/certificate.pb.h"
+#include "asylo/crypto/certificate_interface.h"
+#include "asylo/identity/provisioning/sgx/internal/fake_sgx_pki.h"
+#include "asylo/identity/provisioning/sgx/internal/pck_certificate_util.h"
+#include "asylo/identity/provisioning/sgx/internal/pck_certificate_validation.pb.h"
+#include "asylo/identity/provisioning/sgx/internal/pck_certificates.pb.h"
+#include "asylo/test/util/proto_matchers.h"
+#include "asylo/test/util/status_matchers.h"
+#include "asylo/test/util/test_flags.h"
+#include "asylo/util/proto_parse_util.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+namespace sgx {
+namespace {
+
+using ::testing::Eq;
+using ::testing::Ne;
+using ::testing::Not;
+using ::testing::SizeIs;
+
+// Returns a PckCertificates message holding the fake PCK certificate, listed
+// under the TCB level in its SGX extensions.
+PckCertificates CreateValidPckCertificates() {
+  SgxExtensions extensions = GetFakePckCertificateExtensions();
+  PckCertificates pck_certificates;
+  PckCertificates::PckCertificateInfo *info = pck_certificates.add_certs();
+  *info->mutable_tcb_level() = extensions.tcb;
+  *info->mutable_tcbm()->mutable_cpu_svn() = extensions.cpu_svn;
+  *info->mutable_tcbm()->mutable_pce_svn() = extensions.tcb.pce_svn();
+  *info->mutable_cert() = GetFakePckCertificateChain().certificates(0);
+  return pck_certificates;
+}
+
+// Returns a PckCertificates message holding the fake PCK certificate, listed
+// under a TCB level other than the one in its SGX extensions.
+PckCertificates CreateMislabeledPckCertificates() {
+  PckCertificates pck_certificates = CreateValidPckCertificates();
+  PckCertificates::PckCertificateInfo *info =
+      pck_certificates.mutable_certs(0);
+  info->mutable_tcb_level()->set_components("Another TCB lvl!");
+  info->mutable_tcbm()->mutable_cpu_svn()->set_value("Another TCB lvl!");
+  return pck_certificates;
+}
+
+// Returns the certificates that issued the fake PCK certificate.
+CertificateChain CreateIssuerCertChain() {
+  CertificateChain chain = GetFakePckCertificateChain();
+  chain.mutable_certificates()->erase(chain.certificates().begin());
+  return chain;
+}
+
+// The fake certificates are not checked against the current time, since they
+// may expire before the test code does.
+VerificationConfig CreateVerificationConfig() {
+  VerificationConfig config(/*all_fields=*/true);
+  config.subject_validity_period = absl::nullopt;
+  return config;
+}
+
+void WriteFile(const std::string &path, const std::string &contents) {
+  std::ofstream output(path, std::ios::trunc);
+  output << contents;
+}
+
+void WriteTextProtoFile(const std::string &path,
+                        const google::protobuf::Message &message) {
+  std::string text;
+  ASSERT_TRUE(google::protobuf::TextFormat::PrintToString(message, &text));
+  WriteFile(path, text);
+}
+
+StatusOr<PckCertificateValidationResults> ReadResultsFile(
+    const std::string &path) {
+  std::ifstream input(path);
+  std::stringstream contents;
+  contents << input.rdbuf();
+  return ParseTextProto<PckCertificateValidationResults>(contents.str());
+}
+
+class PckCertificateValidationTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    std::string dir_template =
+        absl::StrCat(absl::GetFlag(FLAGS_test_tmpdir), "/pck_XXXXXX");
+    ASSERT_THAT(mkdtemp(&dir_template[0]), Ne(nullptr));
+    directory_ = dir_template;
+
+    options_.issuer_cert_chain = CreateIssuerCertChain();
+    options_.verification_config = CreateVerificationConfig();
+    options_.num_threads = 2;
+    options_.output_directory = directory_;
+  }
+
+  std::string InputPath(const std::string &name) {
+    return absl::StrCat(directory_, "/", name);
+  }
+
+  std::string directory_;
+  PckCertificateValidationOptions options_;
+};
+
+TEST_F(PckCertificateValidationTest, ValidCertificateSetSucceeds) {
+  std::vector<PckCertificateValidationResult> results =
+      ValidatePckCertificateSet(CreateValidPckCertificates(),
+                                CreateIssuerCertChain(),
+                                CreateVerificationConfig());
+  ASSERT_THAT(results, SizeIs(1));
+  EXPECT_THAT(results[0].status().code(), Eq(0));
+  EXPECT_THAT(results[0].fmspc(),
+              EqualsProto(GetFakePckCertificateExtensions().fmspc));
+  EXPECT_THAT(results[0].tcbm(),
+              EqualsProto(CreateValidPckCertificates().certs(0).tcbm()));
+}
+
+TEST_F(PckCertificateValidationTest, MislabeledCertificateFails) {
+  std::vector<PckCertificateValidationResult> results =
+      ValidatePckCertificateSet(CreateMislabeledPckCertificates(),
+                                CreateIssuerCertChain(),
+                                CreateVerificationConfig());
+  ASSERT_THAT(results, SizeIs(1));
+  EXPECT_THAT(results[0].status().code(), Ne(0));
+}
+
+TEST_F(PckCertificateValidationTest, CertificateFromOtherIssuerFails) {
+  CertificateChain root_only;
+  *root_only.add_certificates() = GetFakeSgxRootCertificate();
+
+  std::vector<PckCertificateValidationResult> results =
+      ValidatePckCertificateSet(CreateValidPckCertificates(), root_only,
+                                CreateVerificationConfig());
+  ASSERT_THAT(results, SizeIs(1));
+  EXPECT_THAT(results[0].status().code(), Ne(0));
+}
+
+TEST_F(PckCertificateValidationTest, FilesAreValidatedAndRunsCanBeResumed) {
+  std::vector<std::string> input_files = {
+      InputPath("valid.textproto"), InputPath("mislabeled.textproto"),
+      InputPath("garbage.textproto"), InputPath("missing.textproto")};
+  WriteTextProtoFile(input_files[0], CreateValidPckCertificates());
+  WriteTextProtoFile(input_files[1], CreateMislabeledPckCertificates());
+  WriteFile(input_files[2], "not a textproto");
+
+  PckCertificateValidationSummary summary;
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      summary, ValidatePckCertificateFiles(input_files, options_));
+  EXPECT_THAT(summary.valid_files, Eq(1));
+  EXPECT_THAT(summary.invalid_files, Eq(3));
+  EXPECT_THAT(summary.skipped_files, Eq(0));
+
+  PckCertificateValidationResults results;
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      results, ReadResultsFile(GetPckCertificateValidationOutputPath(
+                   directory_, input_files[0])));
+  EXPECT_THAT(results.input_file(), Eq(input_files[0]));
+  EXPECT_THAT(results.status().code(), Eq(0));
+  ASSERT_THAT(results.results(), SizeIs(1));
+  EXPECT_THAT(results.results(0).status().code(), Eq(0));
+
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      results, ReadResultsFile(GetPckCertificateValidationOutputPath(
+                   directory_, input_files[2])));
+  EXPECT_THAT(results.status().code(), Ne(0));
+  EXPECT_THAT(results.results(), SizeIs(0));
+
+  // A second run finds all of the results from the first run.
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      summary, ValidatePckCertificateFiles(input_files, options_));
+  EXPECT_THAT(summary.valid_files, Eq(0));
+  EXPECT_THAT(summary.invalid_files, Eq(0));
+  EXPECT_THAT(summary.skipped_files, Eq(4));
+}
+
+TEST_F(PckCertificateValidationTest, InputsWithTheSameNameFail) {
+  std::vector<std::string> input_files = {"a/certs.textproto",
+                                          "b/certs.textproto"};
+  EXPECT_THAT(ValidatePckCertificateFiles(input_files, options_),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+}
+
+TEST_F(PckCertificateValidationTest, InvalidOptionsFail) {
+  std::vector<std::string> input_files = {InputPath("certs.textproto")};
+
+  PckCertificateValidationOptions options = options_;
+  options.num_threads = 0;
+  EXPECT_THAT(ValidatePckCertificateFiles(input_files, options),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+
+  options = options_;
+  options.issuer_cert_chain.mutable_certificates()->RemoveLast();
+  EXPECT_THAT(ValidatePckCertificateFiles(input_files, options),
+              Not(IsOk()));
+}
+
+}  // namespace
+}  // namespace sgx
+}  // namespace asylo
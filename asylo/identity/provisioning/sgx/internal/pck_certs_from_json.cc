@@ -23,12 +23,15 @@
 #include <cstdint>
 #include <cstring>
 #include <functional>
+#include <string>
+#include <utility>
+#include <vector>
 
-#include "google/protobuf/struct.pb.h"
-#include <google/protobuf/util/json_util.h>
 #include "absl/memory/memory.h"
 #include "absl/strings/escaping.h"
 #include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/string_view.h"
 #include "asylo/crypto/certificate.pb.h"
 #include "asylo/crypto/certificate_util.h"
 #include "asylo/identity/platform/sgx/internal/identity_key_management_structs.h"
@@ -39,7 +42,8 @@
 #include "asylo/util/error_codes.h"
 #include "asylo/util/function_deleter.h"
 #include "asylo/util/hex_util.h"
-#include "asylo/util/proto_struct_util.h"
+#include "asylo/util/json_reader.h"
+#include "asylo/util/logging.h"
 #include "asylo/util/status.h"
 #include "asylo/util/status_macros.h"
 #include "asylo/util/url_util.h"
@@ -55,26 +59,36 @@ constexpr uint32_t kPcesvnSize = 2;
 // Size of the RawTcb in bytes.
 constexpr uint32_t kRawTcbSize = kCpusvnSize + kPcesvnSize;
 
-// Parses a Certificate proto from JSON string |cert_json|.
-StatusOr<Certificate> CertificateFromJsonValue(
-    const google::protobuf::Value &cert_json) {
-  const std::string *cert_str;
-  ASYLO_ASSIGN_OR_RETURN(cert_str, JsonGetString(cert_json));
+// Marks the field |name| of a JSON object as read in |*read|. Returns an error
+// if it was read before.
+Status MarkFieldRead(absl::string_view name, bool *read) {
+  if (*read) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  absl::StrCat("JSON object has more than one ", name,
+                               " field"));
+  }
+  *read = true;
+  return Status::OkStatus();
+}
+
+// Reads a Certificate proto from |reader|.
+StatusOr<Certificate> CertificateFromJson(JsonReader *reader) {
+  std::string cert_str;
+  ASYLO_ASSIGN_OR_RETURN(cert_str, reader->ReadString());
   std::string cert_str_unescaped;
-  ASYLO_ASSIGN_OR_RETURN(cert_str_unescaped, UrlDecode(*cert_str));
+  ASYLO_ASSIGN_OR_RETURN(cert_str_unescaped, UrlDecode(cert_str));
   return GetCertificateFromPem(cert_str_unescaped);
 }
 
-// Parses a RawTcb proto from JSON string |raw_tcb_json|.
-StatusOr<RawTcb> RawTcbFromJsonValue(
-    const google::protobuf::Value &raw_tcb_json) {
-  const std::string *raw_tcb_hex;
-  ASYLO_ASSIGN_OR_RETURN(raw_tcb_hex, JsonGetString(raw_tcb_json));
-  if (!IsHexEncoded(*raw_tcb_hex)) {
+// Reads a RawTcb proto from |reader|.
+StatusOr<RawTcb> RawTcbFromJson(JsonReader *reader) {
+  std::string raw_tcb_hex;
+  ASYLO_ASSIGN_OR_RETURN(raw_tcb_hex, reader->ReadString());
+  if (!IsHexEncoded(raw_tcb_hex)) {
     return Status(error::GoogleError::INVALID_ARGUMENT,
                   "Raw TCB JSON is not a hex-encoded string.");
   }
-  std::string raw_tcb = absl::HexStringToBytes(*raw_tcb_hex);
+  std::string raw_tcb = absl::HexStringToBytes(raw_tcb_hex);
   if (raw_tcb.size() != kRawTcbSize) {
     return Status(error::GoogleError::INVALID_ARGUMENT,
                   absl::StrCat("Raw TCB JSON does not represents a ",
@@ -87,66 +101,78 @@ StatusOr<RawTcb> RawTcbFromJsonValue(
   return raw_tcb_proto;
 }
 
-// Parses PckCertificateInfo proto from |pck_cert_json|.
-StatusOr<PckCertificates::PckCertificateInfo> PckCertificateInfoFromJsonValue(
-    const google::protobuf::Value &pck_cert_json) {
-  const google::protobuf::Struct *pck_cert_object;
-  ASYLO_ASSIGN_OR_RETURN(pck_cert_object, JsonGetObject(pck_cert_json));
+// Reads a PckCertificateInfo proto from |reader|.
+StatusOr<PckCertificates::PckCertificateInfo> PckCertificateInfoFromJson(
+    JsonReader *reader) {
+  ASYLO_RETURN_IF_ERROR(reader->BeginObject());
   PckCertificates::PckCertificateInfo pck_cert_proto;
+  bool has_tcb = false;
+  bool has_tcbm = false;
+  bool has_cert = false;
+  std::vector<std::string> unrecognized_fields;
+
+  std::string name;
+  bool has_field;
+  while (true) {
+    ASYLO_ASSIGN_OR_RETURN(has_field, reader->NextField(&name));
+    if (!has_field) {
+      break;
+    }
+    if (name == "tcb") {
+      ASYLO_RETURN_IF_ERROR(MarkFieldRead(name, &has_tcb));
+      ASYLO_ASSIGN_OR_RETURN(*pck_cert_proto.mutable_tcb_level(),
+                             TcbFromJsonReader(reader));
+    } else if (name == "tcbm") {
+      ASYLO_RETURN_IF_ERROR(MarkFieldRead(name, &has_tcbm));
+      ASYLO_ASSIGN_OR_RETURN(*pck_cert_proto.mutable_tcbm(),
+                             RawTcbFromJson(reader));
+    } else if (name == "cert") {
+      ASYLO_RETURN_IF_ERROR(MarkFieldRead(name, &has_cert));
+      ASYLO_ASSIGN_OR_RETURN(*pck_cert_proto.mutable_cert(),
+                             CertificateFromJson(reader));
+    } else {
+      unrecognized_fields.push_back(name);
+      ASYLO_RETURN_IF_ERROR(reader->SkipValue());
+    }
+  }
 
-  const google::protobuf::Value *tcb_json;
-  ASYLO_ASSIGN_OR_RETURN(tcb_json, JsonObjectGetField(*pck_cert_object, "tcb"));
-  std::string tcb_json_str;
-  ASYLO_RETURN_IF_ERROR(
-      Status(google::protobuf::util::MessageToJsonString(*tcb_json, &tcb_json_str)));
-  ASYLO_ASSIGN_OR_RETURN(*pck_cert_proto.mutable_tcb_level(),
-                         TcbFromJson(tcb_json_str));
-
-  const google::protobuf::Value *tcbm_json;
-  ASYLO_ASSIGN_OR_RETURN(tcbm_json,
-                         JsonObjectGetField(*pck_cert_object, "tcbm"));
-  ASYLO_ASSIGN_OR_RETURN(*pck_cert_proto.mutable_tcbm(),
-                         RawTcbFromJsonValue(*tcbm_json));
-
-  const google::protobuf::Value *cert_json;
-  ASYLO_ASSIGN_OR_RETURN(cert_json,
-                         JsonObjectGetField(*pck_cert_object, "cert"));
-  ASYLO_ASSIGN_OR_RETURN(*pck_cert_proto.mutable_cert(),
-                         CertificateFromJsonValue(*cert_json));
-
-  // We only expect three fields in |pck_cert_json|: "tcb", "tcbm", and "cert".
-  // Log warning if there exist additional fields.
-  if (pck_cert_object->fields().size() > 3) {
-    std::string json_string;
-    if (!google::protobuf::util::MessageToJsonString(pck_cert_json, &json_string).ok()) {
-      json_string = "PCK Certificate JSON";
+  for (const auto &field : {std::make_pair("tcb", has_tcb),
+                            std::make_pair("tcbm", has_tcbm),
+                            std::make_pair("cert", has_cert)}) {
+    if (!field.second) {
+      return Status(error::GoogleError::INVALID_ARGUMENT,
+                    absl::StrCat("JSON object does not have a ", field.first,
+                                 " field"));
     }
-    LOG(WARNING) << absl::StrCat("Encountered unrecognized fields in ",
-                                 json_string);
   }
-  return pck_cert_proto;
-}
 
-// Parses PckCertificates proto from |pck_certs_json|.
-StatusOr<PckCertificates> PckCertificatesFromJsonValue(
-    const google::protobuf::Value &pck_certs_json) {
-  const google::protobuf::ListValue *pck_certs_array;
-  ASYLO_ASSIGN_OR_RETURN(pck_certs_array, JsonGetArray(pck_certs_json));
-  PckCertificates pck_certs;
-  for (const auto &pck_cert_json : pck_certs_array->values()) {
-    ASYLO_ASSIGN_OR_RETURN(*pck_certs.add_certs(),
-                           PckCertificateInfoFromJsonValue(pck_cert_json));
+  // We only expect three fields in a PCK certificate JSON object: "tcb",
+  // "tcbm", and "cert". Log warning if there exist additional fields.
+  if (!unrecognized_fields.empty()) {
+    LOG(WARNING) << absl::StrCat(
+        "Encountered unrecognized fields in PCK Certificate JSON: ",
+        absl::StrJoin(unrecognized_fields, ", "));
   }
-  return pck_certs;
+  return pck_cert_proto;
 }
 
 }  // namespace
 
 StatusOr<PckCertificates> PckCertificatesFromJson(const std::string &json_str) {
-  google::protobuf::Value pck_certs_json;
-  ASYLO_RETURN_IF_ERROR(
-      Status(google::protobuf::util::JsonStringToMessage(json_str, &pck_certs_json)));
-  return PckCertificatesFromJsonValue(pck_certs_json);
+  JsonReader reader(json_str);
+  ASYLO_RETURN_IF_ERROR(reader.BeginArray());
+  PckCertificates pck_certs;
+  bool has_element;
+  while (true) {
+    ASYLO_ASSIGN_OR_RETURN(has_element, reader.NextElement());
+    if (!has_element) {
+      break;
+    }
+    ASYLO_ASSIGN_OR_RETURN(*pck_certs.add_certs(),
+                           PckCertificateInfoFromJson(&reader));
+  }
+  ASYLO_RETURN_IF_ERROR(reader.Finish());
+  return pck_certs;
 }
 
 }  // namespace sgx
@@ -41,6 +41,18 @@ ABSL_FLAG(std::string, dcap_enclave_dir, ".",
 int main(int argc, char *argv[]) {
   absl::ParseCommandLine(argc, argv);
 
+  if (!absl::GetFlag(FLAGS_pck_cert_files).empty()) {
+    ASYLO_CHECK_OK(asylo::sgx::ValidatePckCertificatesAccordingToFlags())
+        << "Error validating PCK certificates.";
+    return 0;
+  }
+
+  if (!absl::GetFlag(FLAGS_ppids_file).empty()) {
+    ASYLO_CHECK_OK(asylo::sgx::EncryptPpidsAccordingToFlags())
+        << "Error encrypting PPIDs.";
+    return 0;
+  }
+
   auto client_result = asylo::sgx::CreateSgxPcsClientFromFlags();
 
   asylo::sgx::PlatformInfo platform_info;
@@ -25,6 +25,8 @@
 #include <cstdint>
 #include <cstdlib>
 #include <fstream>
+#include <iostream>
+#include <sstream>
 #include <string>
 #include <vector>
 
@@ -32,11 +34,14 @@
 #include "absl/base/call_once.h"
 #include "absl/flags/flag.h"
 #include "absl/memory/memory.h"
+#include "absl/strings/ascii.h"
 #include "absl/strings/escaping.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "asylo/crypto/algorithms.pb.h"
 #include "asylo/crypto/asymmetric_encryption_key.h"
+#include "asylo/crypto/certificate_util.h"
+#include "asylo/crypto/util/byte_container_view.h"
 #include "asylo/crypto/rsa_oaep_encryption_key.h"
 #include "asylo/crypto/x509_certificate.h"
 #include "asylo/util/logging.h"
@@ -47,6 +52,7 @@
 #include "asylo/identity/platform/sgx/internal/identity_key_management_structs.h"
 #include "asylo/identity/platform/sgx/internal/ppid_ek.h"
 #include "asylo/identity/platform/sgx/machine_configuration.pb.h"
+#include "asylo/identity/provisioning/sgx/internal/pck_certificate_validation.h"
 #include "asylo/identity/provisioning/sgx/internal/platform_provisioning.h"
 #include "asylo/identity/provisioning/sgx/internal/platform_provisioning.pb.h"
 #include "asylo/identity/provisioning/sgx/internal/sgx_pcs_client.h"
@@ -77,6 +83,24 @@ ABSL_FLAG(std::string, outfile, "certs.out",
 ABSL_FLAG(std::string, outfmt, "textproto",
           "The output format to use. Valid options are 'textproto' or 'pem'. "
           "Defaults to textproto.");
+ABSL_FLAG(std::vector<std::string>, pck_cert_files, {},
+          "Comma-separated list of files that each hold a PckCertificates "
+          "message in text format. If set, the tool validates the PCK "
+          "certificates in these files instead of fetching a PCK "
+          "certificate.");
+ABSL_FLAG(std::string, pck_issuer_chain, "",
+          "File holding the PEM-encoded certificate chain that issued the PCK "
+          "certificates in --pck_cert_files, ending with the root CA.");
+ABSL_FLAG(int, num_threads, 8,
+          "The number of threads used to validate --pck_cert_files.");
+ABSL_FLAG(std::string, validation_outdir, ".",
+          "The directory where the results of validating each of "
+          "--pck_cert_files are written.");
+ABSL_FLAG(std::string, ppids_file, "",
+          "File holding one PPID per line, expressed as ASCII hexadecimal. If "
+          "set, the tool encrypts each PPID with the PPID encryption key of "
+          "the Intel PCS and writes the encrypted PPIDs to --outfile, one per "
+          "line in the same order, instead of fetching a PCK certificate.");
 
 namespace asylo {
 namespace sgx {
@@ -208,6 +232,17 @@ Status WriteTextProtoOutput(asylo::sgx::GetPckCertificateResult cert_result,
   return Status::OkStatus();
 }
 
+StatusOr<CertificateChain> ReadPemCertificateChain(const std::string &path) {
+  std::ifstream input(path);
+  if (!input) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  absl::StrCat("Unable to open ", path, ": ", ErrnoToString()));
+  }
+  std::stringstream contents;
+  contents << input.rdbuf();
+  return GetCertificateChainFromPem(contents.str());
+}
+
 }  // namespace
 
 void PlatformInfo::FillEmptyFields(const PlatformInfo &info) {
@@ -353,5 +388,85 @@ Status WriteOutputAccordingToFlags(GetPckCertificateResult cert_result) {
       absl::StrCat("Invalid ", FLAGS_outfmt.Name(), " value: ", outfmt));
 }
 
+Status ValidatePckCertificatesAccordingToFlags() {
+  std::string issuer_chain_file = absl::GetFlag(FLAGS_pck_issuer_chain);
+  if (issuer_chain_file.empty()) {
+    return Status(
+        error::GoogleError::INVALID_ARGUMENT,
+        absl::StrCat(FLAGS_pck_issuer_chain.Name(), " must be specified"));
+  }
+
+  PckCertificateValidationOptions options;
+  ASYLO_ASSIGN_OR_RETURN(options.issuer_cert_chain,
+                         ReadPemCertificateChain(issuer_chain_file));
+  options.num_threads = absl::GetFlag(FLAGS_num_threads);
+  options.output_directory = absl::GetFlag(FLAGS_validation_outdir);
+
+  std::vector<std::string> input_files = absl::GetFlag(FLAGS_pck_cert_files);
+  std::cout << "Validating " << input_files.size() << " PCK certificate files "
+            << "into " << options.output_directory << "." << std::endl;
+
+  PckCertificateValidationSummary summary;
+  ASYLO_ASSIGN_OR_RETURN(summary,
+                         ValidatePckCertificateFiles(input_files, options));
+  std::cout << summary.valid_files << " valid, " << summary.invalid_files
+            << " invalid, " << summary.skipped_files
+            << " skipped (already validated)." << std::endl;
+  return Status::OkStatus();
+}
+
+Status EncryptPpidsAccordingToFlags() {
+  std::string ppids_file = absl::GetFlag(FLAGS_ppids_file);
+  std::ifstream input(ppids_file);
+  if (!input) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  absl::StrCat("Unable to open ", ppids_file, ": ",
+                               ErrnoToString()));
+  }
+
+  std::vector<std::string> ppids;
+  std::string line;
+  while (std::getline(input, line)) {
+    absl::string_view ppid_hex = absl::StripAsciiWhitespace(line);
+    if (ppid_hex.empty()) {
+      continue;
+    }
+    Ppid ppid;
+    ppid.set_value(absl::HexStringToBytes(ppid_hex));
+    ASYLO_RETURN_IF_ERROR(ValidatePpid(ppid));
+    ppids.push_back(ppid.value());
+  }
+
+  // The PPIDs are encrypted as one batch with the shared PPID EK, so that the
+  // key is parsed and its OAEP context set up only once.
+  std::vector<ByteContainerView> plaintexts(ppids.begin(), ppids.end());
+  std::vector<std::vector<uint8_t>> ciphertexts;
+  ASYLO_RETURN_IF_ERROR(GetPpidEk().EncryptMany(plaintexts, &ciphertexts));
+
+  std::string outfile = absl::GetFlag(FLAGS_outfile);
+  std::ofstream output(outfile);
+  if (!output) {
+    return Status(
+        error::GoogleError::INVALID_ARGUMENT,
+        absl::StrCat("Unable to open ", outfile, ": ", ErrnoToString()));
+  }
+  for (const std::vector<uint8_t> &ciphertext : ciphertexts) {
+    output << absl::BytesToHexString(absl::string_view(
+                  reinterpret_cast<const char *>(ciphertext.data()),
+                  ciphertext.size()))
+           << "\n";
+  }
+  output.close();
+  if (!output) {
+    return Status(
+        error::GoogleError::INTERNAL,
+        absl::StrCat("Error writing to ", outfile, ": ", ErrnoToString()));
+  }
+
+  std::cout << "Wrote " << ciphertexts.size() << " encrypted PPIDs to "
+            << outfile << "." << std::endl;
+  return Status::OkStatus();
+}
+
 }  // namespace sgx
 }  // namespace asylo
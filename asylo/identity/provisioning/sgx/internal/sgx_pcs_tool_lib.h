@@ -23,6 +23,7 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "absl/flags/declare.h"
 #include "absl/strings/string_view.h"
@@ -46,6 +47,15 @@ ABSL_DECLARE_FLAG(std::string, outfile);
 // How the output is written.
 ABSL_DECLARE_FLAG(std::string, outfmt);
 
+// Flags for validating sets of PCK certificates instead of fetching one.
+ABSL_DECLARE_FLAG(std::vector<std::string>, pck_cert_files);
+ABSL_DECLARE_FLAG(std::string, pck_issuer_chain);
+ABSL_DECLARE_FLAG(int, num_threads);
+ABSL_DECLARE_FLAG(std::string, validation_outdir);
+
+// Flag for encrypting a batch of PPIDs instead of fetching a PCK certificate.
+ABSL_DECLARE_FLAG(std::string, ppids_file);
+
 namespace asylo {
 namespace sgx {
 
@@ -88,6 +98,17 @@ StatusOr<std::unique_ptr<SgxPcsClient>> CreateSgxPcsClientFromFlags();
 // command-line flags.
 Status WriteOutputAccordingToFlags(GetPckCertificateResult cert_result);
 
+// Validate the PCK certificate files named by command-line flags, writing the
+// results to the directory named by command-line flags. Files that already
+// have results there are skipped, so an interrupted run can be resumed by
+// running the tool again with the same flags.
+Status ValidatePckCertificatesAccordingToFlags();
+
+// Encrypt the PPIDs in the file named by command-line flags with the PPID
+// encryption key of the Intel PCS, writing the hex-encoded results to the file
+// named by command-line flags.
+Status EncryptPpidsAccordingToFlags();
+
 }  // namespace sgx
 }  // namespace asylo
 
@@ -21,8 +21,11 @@
 #include <fcntl.h>
 
 #include <cstdlib>
+#include <fstream>
 #include <iterator>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include <google/protobuf/io/zero_copy_stream_impl.h>
 #include <google/protobuf/text_format.h>
@@ -400,6 +403,43 @@ TEST_F(SgxPcsToolLibTest, WriteCertResultAsProto) {
   }
 }
 
+TEST_F(SgxPcsToolLibTest, EncryptPpidsWithMissingFile) {
+  absl::SetFlag(&FLAGS_ppids_file, "/totally/bogus/path/that/does/not/exist");
+  EXPECT_THAT(EncryptPpidsAccordingToFlags(),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+}
+
+TEST_F(SgxPcsToolLibTest, EncryptPpidsWithInvalidPpid) {
+  OpenTempFile();
+  std::ofstream(temp_filename_) << kValidPpidHex << "\nnot a ppid\n";
+  absl::SetFlag(&FLAGS_ppids_file, temp_filename_);
+  EXPECT_THAT(EncryptPpidsAccordingToFlags(),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+}
+
+TEST_F(SgxPcsToolLibTest, EncryptPpids) {
+  // The PPIDs are all read before the output is written, so the same file can
+  // serve as both.
+  OpenTempFile();
+  std::ofstream(temp_filename_)
+      << kValidPpidHex << "\n\n  " << kValidPpidHex << "  \n";
+  absl::SetFlag(&FLAGS_ppids_file, temp_filename_);
+  absl::SetFlag(&FLAGS_outfile, temp_filename_);
+  ASSERT_THAT(EncryptPpidsAccordingToFlags(), IsOk());
+
+  std::ifstream output(temp_filename_);
+  std::vector<std::string> encrypted_ppids{
+      std::istream_iterator<std::string>(output),
+      std::istream_iterator<std::string>()};
+  ASSERT_THAT(encrypted_ppids.size(), Eq(2));
+  for (const std::string &encrypted_ppid : encrypted_ppids) {
+    // The ciphertexts are hex-encoded RSA-3072 values.
+    EXPECT_THAT(encrypted_ppid.size(), Eq(2 * 3072 / 8));
+  }
+  // OAEP is randomized, so the same PPID gives different ciphertexts.
+  EXPECT_THAT(encrypted_ppids[0], Ne(encrypted_ppids[1]));
+}
+
 }  // namespace
 }  // namespace sgx
 }  // namespace asylo
@@ -21,33 +21,22 @@
 #include <string>
 #include <utility>
 
-#include "google/protobuf/struct.pb.h"
-#include <google/protobuf/util/json_util.h>
+#include "absl/strings/ascii.h"
 #include "absl/strings/escaping.h"
-#include "absl/strings/str_replace.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
 #include "asylo/identity/provisioning/sgx/internal/sgx_pcs_client.pb.h"
 #include "asylo/util/error_codes.h"
 #include "asylo/util/hex_util.h"
-#include "asylo/util/proto_struct_util.h"
+#include "asylo/util/json_reader.h"
 #include "asylo/util/status.h"
 #include "asylo/util/status_macros.h"
 #include "asylo/util/statusor.h"
-#include "re2/re2.h"
 
 namespace asylo {
 namespace sgx {
 namespace {
 
-// Regexpr to match the signed TCB info JSON where the "signature" field comes
-// after the "tcbInfo" field.
-static const LazyRE2 kSignedTcbInfoJsonSigLastPattern = {
-    R"regexp((?s:\s*\{\s*\"tcbInfo\"\s*:\s*(\{.*\})\s*,\s*\"signature\"\s*:\s*\"[\d|a-f|A-F]*\"\s*\}\s*))regexp"};
-
-// Regexpr to match the signed TCB info JSON where the "signature" field is
-// ahead of the "tcbInfo" field.
-static const LazyRE2 kSignedTcbInfoJsonSigFirstPattern = {
-    R"regexp((?s:\s*\{\s*\"signature\"\s*:\s*\"[\d|a-f|A-F]*\"\s*,\s*\"tcbInfo\"\s*:\s*(\{.*\})\s*\}\s*))regexp"};
-
 // Parses JSON string |signed_tcb_info_json| and populates |tcb_info_json| and
 // |signature| with the values of "tcbInfo" and "signature" respectively.
 // Returns an error status if the |signed_tcb_info_json| does not match
@@ -56,38 +45,57 @@ static const LazyRE2 kSignedTcbInfoJsonSigFirstPattern = {
 Status ParseSignedTcbInfoFromJson(const std::string &signed_tcb_info_json,
                                   std::string *tcb_info_json,
                                   std::string *signature) {
-  google::protobuf::Value signed_tcb_info_value;
-  ASYLO_RETURN_IF_ERROR(Status(google::protobuf::util::JsonStringToMessage(
-      signed_tcb_info_json, &signed_tcb_info_value)));
-  const google::protobuf::Struct *signed_tcb_info_obj;
-  ASYLO_ASSIGN_OR_RETURN(signed_tcb_info_obj,
-                         JsonGetObject(signed_tcb_info_value));
-  const google::protobuf::Value *sig_value;
-  ASYLO_ASSIGN_OR_RETURN(sig_value,
-                         JsonObjectGetField(*signed_tcb_info_obj, "signature"));
-  const std::string *signature_str;
-  ASYLO_ASSIGN_OR_RETURN(signature_str, JsonGetString(*sig_value));
-
-  // Check that the signature is hex-encoded.
-  if (!IsHexEncoded(*signature)) {
-    return Status(error::GoogleError::INVALID_ARGUMENT,
-                  "Signature is not hex-encoded");
+  JsonReader reader(signed_tcb_info_json);
+  ASYLO_RETURN_IF_ERROR(reader.BeginObject());
+  bool has_tcb_info = false;
+  bool has_signature = false;
+  std::string name;
+  bool has_field;
+  while (true) {
+    ASYLO_ASSIGN_OR_RETURN(has_field, reader.NextField(&name));
+    if (!has_field) {
+      break;
+    }
+    if (name == "tcbInfo" && !has_tcb_info) {
+      JsonType type;
+      ASYLO_ASSIGN_OR_RETURN(type, reader.PeekType());
+      if (type != JsonType::kObject) {
+        return Status(error::GoogleError::INVALID_ARGUMENT,
+                      "\"tcbInfo\" is not a JSON object");
+      }
+      // The text of the "tcbInfo" field is kept as is, to be verified against
+      // the signature. According to Intel's Get TCB Info API documentation,
+      // the signature is over the "tcbInfo" field without whitespaces.
+      absl::string_view tcb_info;
+      ASYLO_ASSIGN_OR_RETURN(tcb_info, reader.ReadRawValue());
+      tcb_info_json->clear();
+      tcb_info_json->reserve(tcb_info.size());
+      for (char c : tcb_info) {
+        if (!absl::ascii_isspace(c)) {
+          tcb_info_json->push_back(c);
+        }
+      }
+      has_tcb_info = true;
+    } else if (name == "signature" && !has_signature) {
+      ASYLO_ASSIGN_OR_RETURN(*signature, reader.ReadString());
+      if (!IsHexEncoded(*signature)) {
+        return Status(error::GoogleError::INVALID_ARGUMENT,
+                      "Signature is not hex-encoded");
+      }
+      has_signature = true;
+    } else {
+      return Status(error::GoogleError::INVALID_ARGUMENT,
+                    absl::StrCat("Unexpected field in signed TCB info JSON: ",
+                                 name));
+    }
   }
+  ASYLO_RETURN_IF_ERROR(reader.Finish());
 
-  // The entire JSON was validated above, so it is safe to use regex to extract
-  // the contents of the tcbInfo JSON field as a JSON string.
-  if (!RE2::FullMatch(signed_tcb_info_json, *kSignedTcbInfoJsonSigLastPattern,
-                      tcb_info_json) &&
-      !RE2::FullMatch(signed_tcb_info_json, *kSignedTcbInfoJsonSigFirstPattern,
-                      tcb_info_json)) {
+  if (!has_tcb_info || !has_signature) {
     return Status(error::GoogleError::INVALID_ARGUMENT,
-                  "Cannot parse the JSON of signed TCB info");
+                  "Signed TCB info JSON must have \"tcbInfo\" and "
+                  "\"signature\" fields");
   }
-
-  // According to Intel's Get TCB Info API documentation, the signature is
-  // over the "tcbInfo" field without whitespaces.
-  RE2::GlobalReplace(tcb_info_json, R"regexp(\s)regexp", "");
-  *signature = *signature_str;
   return Status::OkStatus();
 }
 
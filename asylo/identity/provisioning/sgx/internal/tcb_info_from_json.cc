@@ -20,17 +20,17 @@
 
 #include <endian.h>
 
+#include <array>
 #include <cmath>
 #include <cstdint>
 #include <limits>
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
-#include "google/protobuf/struct.pb.h"
 #include "google/protobuf/timestamp.pb.h"
 #include <google/protobuf/repeated_field.h>
-#include <google/protobuf/util/json_util.h>
 #include <google/protobuf/util/message_differencer.h>
 #include <google/protobuf/util/time_util.h>
 #include "absl/base/call_once.h"
@@ -38,8 +38,10 @@
 #include "absl/hash/hash.h"
 #include "absl/strings/ascii.h"
 #include "absl/strings/escaping.h"
+#include "absl/strings/match.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
+#include "absl/strings/str_join.h"
 #include "absl/strings/string_view.h"
 #include "absl/time/civil_time.h"
 #include "absl/time/time.h"
@@ -50,7 +52,7 @@
 #include "asylo/identity/provisioning/sgx/internal/tcb.h"
 #include "asylo/identity/provisioning/sgx/internal/tcb.pb.h"
 #include "asylo/util/hex_util.h"
-#include "asylo/util/proto_struct_util.h"
+#include "asylo/util/json_reader.h"
 #include "asylo/util/status.h"
 #include "asylo/util/status_macros.h"
 
@@ -99,14 +101,51 @@ const absl::flat_hash_map<std::string, TcbStatus::StatusType>
   return *map;
 }
 
-// Returns the value of |int32_json| if |int32_json| is a number value within
-// the range of a 32-bit integer. Otherwise, returns an error, using
-// |value_name| to name the value.
-StatusOr<int32_t> Int32FromJson(const google::protobuf::Value &int32_json,
-                                absl::string_view value_name) {
-  ASYLO_RETURN_IF_ERROR(JsonGetNumber(int32_json));
+// Marks the field |name| of a JSON object as read in |*read|. Returns an error
+// if it was read before.
+Status MarkFieldRead(absl::string_view name, bool *read) {
+  if (*read) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  absl::StrCat("JSON object has more than one ", name,
+                               " field"));
+  }
+  *read = true;
+  return Status::OkStatus();
+}
+
+// Returns the error for a JSON object without a |name| field.
+Status MissingFieldError(absl::string_view name) {
+  return Status(
+      error::GoogleError::INVALID_ARGUMENT,
+      absl::StrCat("JSON object does not have a ", name, " field"));
+}
+
+// Skips the value of the unrecognized field |name| of a JSON object, and adds
+// |name| to |unrecognized_fields|.
+Status SkipUnrecognizedField(const std::string &name, JsonReader *reader,
+                             std::vector<std::string> *unrecognized_fields) {
+  unrecognized_fields->push_back(name);
+  return reader->SkipValue();
+}
 
-  double value = int32_json.number_value();
+// Logs a warning if |unrecognized_fields| of the JSON object named
+// |object_name| is not empty.
+void WarnUnrecognizedFields(
+    absl::string_view object_name,
+    const std::vector<std::string> &unrecognized_fields) {
+  if (!unrecognized_fields.empty()) {
+    LOG(WARNING) << absl::StrCat("Encountered unrecognized fields in ",
+                                 object_name, ": ",
+                                 absl::StrJoin(unrecognized_fields, ", "));
+  }
+}
+
+// Reads a number from |reader| if it is within the range of a 32-bit integer.
+// Otherwise, returns an error, using |value_name| to name the value.
+StatusOr<int32_t> Int32FromJson(JsonReader *reader,
+                                absl::string_view value_name) {
+  double value;
+  ASYLO_ASSIGN_OR_RETURN(value, reader->ReadNumber());
   if (value < static_cast<double>(std::numeric_limits<int32_t>::min()) ||
       value > static_cast<double>(std::numeric_limits<int32_t>::max()) ||
       round(value) != value) {
@@ -118,21 +157,20 @@ StatusOr<int32_t> Int32FromJson(const google::protobuf::Value &int32_json,
   return value;
 }
 
-// Parses a valid google.protobuf.Timestamp from |timestamp_json|. The
-// |timestamp_json| must be in ISO 8601 format.
-StatusOr<google::protobuf::Timestamp> TimestampFromJson(
-    const google::protobuf::Value &timestamp_json) {
-  const std::string *timestamp_string;
-  ASYLO_ASSIGN_OR_RETURN(timestamp_string, JsonGetString(timestamp_json));
+// Reads a valid google.protobuf.Timestamp from |reader|. The timestamp must be
+// in ISO 8601 format.
+StatusOr<google::protobuf::Timestamp> TimestampFromJson(JsonReader *reader) {
+  std::string timestamp_string;
+  ASYLO_ASSIGN_OR_RETURN(timestamp_string, reader->ReadString());
 
   absl::Time time;
-  ASYLO_ASSIGN_OR_RETURN(time, ParseIso8601TimeString(*timestamp_string));
+  ASYLO_ASSIGN_OR_RETURN(time, ParseIso8601TimeString(timestamp_string));
   if (!CanBeTimestampProto(time)) {
     return Status(
         error::GoogleError::OUT_OF_RANGE,
         absl::StrFormat(
             "Timestamp %s cannot be represented as a google.protobuf.Timestamp",
-            *timestamp_string));
+            timestamp_string));
   }
 
   google::protobuf::Timestamp timestamp;
@@ -144,11 +182,30 @@ StatusOr<google::protobuf::Timestamp> TimestampFromJson(
   return timestamp;
 }
 
-// Parses a valid SGX TCB component SVN from |component_json|.
-StatusOr<int> SgxTcbComponentSvnFromJson(
-    const google::protobuf::Value &component_json) {
+// Returns the index of the SGX TCB component whose SVN is the value of the
+// field |name| of a TCB JSON object, or -1 if |name| is not such a field. The
+// fields are named "sgxtcbcomp##svn", with ## between 01 and
+// kTcbComponentsSize.
+int SgxTcbComponentIndex(absl::string_view name) {
+  constexpr absl::string_view kPrefix = "sgxtcbcomp";
+  constexpr absl::string_view kSuffix = "svn";
+  if (name.size() != kPrefix.size() + 2 + kSuffix.size() ||
+      !absl::StartsWith(name, kPrefix) || !absl::EndsWith(name, kSuffix)) {
+    return -1;
+  }
+  char tens = name[kPrefix.size()];
+  char ones = name[kPrefix.size() + 1];
+  if (!absl::ascii_isdigit(tens) || !absl::ascii_isdigit(ones)) {
+    return -1;
+  }
+  int number = (tens - '0') * 10 + (ones - '0');
+  return number >= 1 && number <= kTcbComponentsSize ? number - 1 : -1;
+}
+
+// Reads a valid SGX TCB component SVN from |reader|.
+StatusOr<int> SgxTcbComponentSvnFromJson(JsonReader *reader) {
   double component;
-  ASYLO_ASSIGN_OR_RETURN(component, JsonGetNumber(component_json));
+  ASYLO_ASSIGN_OR_RETURN(component, reader->ReadNumber());
   if (component < 0. || component > 255.) {
     return Status(error::GoogleError::INVALID_ARGUMENT,
                   "An SGX TCB component SVN is out of bounds");
@@ -156,10 +213,10 @@ StatusOr<int> SgxTcbComponentSvnFromJson(
   return component;
 }
 
-// Parses a valid PceSvn from |pce_svn_json|.
-StatusOr<PceSvn> PceSvnFromJson(const google::protobuf::Value &pce_svn_json) {
+// Reads a valid PceSvn from |reader|.
+StatusOr<PceSvn> PceSvnFromJson(JsonReader *reader) {
   double pce_svn_raw;
-  ASYLO_ASSIGN_OR_RETURN(pce_svn_raw, JsonGetNumber(pce_svn_json));
+  ASYLO_ASSIGN_OR_RETURN(pce_svn_raw, reader->ReadNumber());
   if (pce_svn_raw < 0. || pce_svn_raw > kPceSvnMaxValue) {
     return Status(error::GoogleError::INVALID_ARGUMENT,
                   "pcesvn is out of bounds");
@@ -170,154 +227,111 @@ StatusOr<PceSvn> PceSvnFromJson(const google::protobuf::Value &pce_svn_json) {
   return pce_svn;
 }
 
-StatusOr<Tcb> TcbFromJsonValue(const google::protobuf::Value &json_value) {
-  const google::protobuf::Struct *tcb_object;
-  ASYLO_ASSIGN_OR_RETURN(tcb_object, JsonGetObject(json_value));
-
-  Tcb tcb;
-
-  tcb.set_components(std::string(kTcbComponentsSize, 0));
-  for (int i = 0; i < kTcbComponentsSize; ++i) {
-    const std::string field_name = absl::StrFormat("sgxtcbcomp%02dsvn", i + 1);
-    const google::protobuf::Value *component_json;
-    ASYLO_ASSIGN_OR_RETURN(component_json,
-                           JsonObjectGetField(*tcb_object, field_name));
-    ASYLO_ASSIGN_OR_RETURN((*tcb.mutable_components())[i],
-                           SgxTcbComponentSvnFromJson(*component_json));
-  }
-
-  const google::protobuf::Value *pce_svn_json;
-  ASYLO_ASSIGN_OR_RETURN(pce_svn_json,
-                         JsonObjectGetField(*tcb_object, "pcesvn"));
-  ASYLO_ASSIGN_OR_RETURN(*tcb.mutable_pce_svn(), PceSvnFromJson(*pce_svn_json));
-
-  // Each TCB JSON object should have kTcbComponentsSize + 1 fields: one
-  // "sgxtcbcomp##svn" for each number between 1 and kTcbComponentsSize, as well
-  // as a "pcesvn" field.
-  if (tcb_object->fields().size() > kTcbComponentsSize + 1) {
-    std::string json_string;
-    if (!google::protobuf::util::MessageToJsonString(json_value, &json_string).ok()) {
-      json_string = "TCB JSON";
-    }
-    LOG(WARNING) << absl::StrCat("Encountered unrecognized fields in ",
-                                 json_string);
-  }
-
-  return tcb;
-}
-
-// Parses a valid TcbStatus from |tcb_status_json|.
-StatusOr<TcbStatus> TcbStatusFromJson(
-    const google::protobuf::Value &tcb_status_json) {
-  const std::string *status_string;
-  ASYLO_ASSIGN_OR_RETURN(status_string, JsonGetString(tcb_status_json));
+// Reads a valid TcbStatus from |reader|.
+StatusOr<TcbStatus> TcbStatusFromJson(JsonReader *reader) {
+  std::string status_string;
+  ASYLO_ASSIGN_OR_RETURN(status_string, reader->ReadString());
   TcbStatus status;
-  if (KnownStatusesMap().contains(*status_string)) {
-    status.set_known_status(KnownStatusesMap().at(*status_string));
+  auto known_status = KnownStatusesMap().find(status_string);
+  if (known_status != KnownStatusesMap().end()) {
+    status.set_known_status(known_status->second);
   } else {
-    status.set_unknown_status(*status_string);
+    status.set_unknown_status(std::move(status_string));
   }
   return status;
 }
 
-// Parses a list of advisory IDs from |advisory_ids_json|.
+// Reads a list of advisory IDs from |reader|.
 StatusOr<google::protobuf::RepeatedPtrField<std::string>> AdvisoryIdsFromJson(
-    const google::protobuf::Value &advisory_ids_json) {
-  const google::protobuf::ListValue *advisory_ids_array;
-  ASYLO_ASSIGN_OR_RETURN(advisory_ids_array, JsonGetArray(advisory_ids_json));
-  if (advisory_ids_array->values().empty()) {
+    JsonReader *reader) {
+  ASYLO_RETURN_IF_ERROR(reader->BeginArray());
+  google::protobuf::RepeatedPtrField<std::string> advisory_ids;
+  bool has_element;
+  while (true) {
+    ASYLO_ASSIGN_OR_RETURN(has_element, reader->NextElement());
+    if (!has_element) {
+      break;
+    }
+    ASYLO_ASSIGN_OR_RETURN(*advisory_ids.Add(), reader->ReadString());
+  }
+  if (advisory_ids.empty()) {
     return Status(error::GoogleError::INVALID_ARGUMENT,
                   "\"advisoryIDs\" array may not be empty");
   }
-  google::protobuf::RepeatedPtrField<std::string> advisory_ids;
-  advisory_ids.Reserve(advisory_ids_array->values_size());
-  for (const google::protobuf::Value &advisory_id_json :
-       advisory_ids_array->values()) {
-    const std::string *advisory_id;
-    ASYLO_ASSIGN_OR_RETURN(advisory_id, JsonGetString(advisory_id_json));
-    advisory_ids.Add(std::string(*advisory_id));
-  }
   return advisory_ids;
 }
 
-// Parses a valid TcbLevel from |tcb_level_json|. Assumes that the TCB level
-// comes from a TCB info structure with version |tcb_info_version|, which must
-// be either 1 or 2.
-StatusOr<TcbLevel> TcbLevelFromJson(
-    int32_t tcb_info_version, const google::protobuf::Value &tcb_level_json) {
-  const google::protobuf::Struct *tcb_level_object;
-  ASYLO_ASSIGN_OR_RETURN(tcb_level_object, JsonGetObject(tcb_level_json));
+// Reads a valid TcbLevel from |reader|. Assumes that the TCB level comes from a
+// TCB info structure with version |tcb_info_version|, which must be either 1 or
+// 2.
+StatusOr<TcbLevel> TcbLevelFromJson(int32_t tcb_info_version,
+                                    JsonReader *reader) {
+  // A TCB level from a version 1 TCB info JSON object has two fields: "tcb"
+  // and "status". A TCB level from a version 2 TCB info JSON object has three
+  // or four fields: "tcb", "tcbDate", "tcbStatus", and optionally
+  // "advisoryIDs".
+  const absl::string_view status_field =
+      tcb_info_version == 2 ? "tcbStatus" : "status";
+  ASYLO_RETURN_IF_ERROR(reader->BeginObject());
   TcbLevel tcb_level;
+  bool has_tcb = false;
+  bool has_status = false;
+  bool has_tcb_date = false;
   bool has_advisory_ids = false;
+  std::vector<std::string> unrecognized_fields;
 
-  const google::protobuf::Value *tcb_json;
-  ASYLO_ASSIGN_OR_RETURN(tcb_json,
-                         JsonObjectGetField(*tcb_level_object, "tcb"));
-  ASYLO_ASSIGN_OR_RETURN(*tcb_level.mutable_tcb(), TcbFromJsonValue(*tcb_json));
-
-  const google::protobuf::Value *status_json;
-  ASYLO_ASSIGN_OR_RETURN(
-      status_json,
-      JsonObjectGetField(*tcb_level_object,
-                         tcb_info_version == 2 ? "tcbStatus" : "status"));
-  ASYLO_ASSIGN_OR_RETURN(*tcb_level.mutable_status(),
-                         TcbStatusFromJson(*status_json));
-
-  if (tcb_info_version == 2) {
-    const google::protobuf::Value *tcb_date_json;
-    ASYLO_ASSIGN_OR_RETURN(tcb_date_json,
-                           JsonObjectGetField(*tcb_level_object, "tcbDate"));
-    ASYLO_ASSIGN_OR_RETURN(*tcb_level.mutable_tcb_date(),
-                           TimestampFromJson(*tcb_date_json));
-
-    // The "advisoryIDs" field is optional.
-    auto get_advisory_ids_result =
-        JsonObjectGetField(*tcb_level_object, "advisoryIDs");
-    if (get_advisory_ids_result.ok()) {
-      has_advisory_ids = true;
-      ASYLO_ASSIGN_OR_RETURN(
-          *tcb_level.mutable_advisory_ids(),
-          AdvisoryIdsFromJson(*get_advisory_ids_result.ValueOrDie()));
+  std::string name;
+  bool has_field;
+  while (true) {
+    ASYLO_ASSIGN_OR_RETURN(has_field, reader->NextField(&name));
+    if (!has_field) {
+      break;
+    }
+    if (name == "tcb") {
+      ASYLO_RETURN_IF_ERROR(MarkFieldRead(name, &has_tcb));
+      ASYLO_ASSIGN_OR_RETURN(*tcb_level.mutable_tcb(),
+                             TcbFromJsonReader(reader));
+    } else if (name == status_field) {
+      ASYLO_RETURN_IF_ERROR(MarkFieldRead(name, &has_status));
+      ASYLO_ASSIGN_OR_RETURN(*tcb_level.mutable_status(),
+                             TcbStatusFromJson(reader));
+    } else if (tcb_info_version == 2 && name == "tcbDate") {
+      ASYLO_RETURN_IF_ERROR(MarkFieldRead(name, &has_tcb_date));
+      ASYLO_ASSIGN_OR_RETURN(*tcb_level.mutable_tcb_date(),
+                             TimestampFromJson(reader));
+    } else if (tcb_info_version == 2 && name == "advisoryIDs") {
+      ASYLO_RETURN_IF_ERROR(MarkFieldRead(name, &has_advisory_ids));
+      ASYLO_ASSIGN_OR_RETURN(*tcb_level.mutable_advisory_ids(),
+                             AdvisoryIdsFromJson(reader));
+    } else {
+      ASYLO_RETURN_IF_ERROR(
+          SkipUnrecognizedField(name, reader, &unrecognized_fields));
     }
   }
 
-  // Each TCB level JSON object should have two fields: "tcb" and "status".
-  int expected_num_fields = -1;
-  switch (tcb_info_version) {
-    case 1:
-      // A TCB level from a version 1 TCB info JSON object should have two top-
-      // level fields: "tcb" and "status".
-      expected_num_fields = 2;
-      break;
-    case 2:
-      // A TCB level from a version 1 TCB info JSON object should have three or
-      // four top-level fields: "tcb", "tcbDate", "tcbStatus", and optionally
-      // "advisoryIDs".
-      expected_num_fields = 3 + (has_advisory_ids ? 1 : 0);
-      break;
+  if (!has_tcb) {
+    return MissingFieldError("tcb");
   }
-  if (tcb_level_json.struct_value().fields().size() > expected_num_fields) {
-    std::string json_string;
-    if (!google::protobuf::util::MessageToJsonString(tcb_level_json, &json_string).ok()) {
-      json_string = "TCB level JSON";
-    }
-    LOG(WARNING) << absl::StrCat("Encountered unrecognized fields in ",
-                                 json_string);
+  if (!has_status) {
+    return MissingFieldError(status_field);
   }
-
+  if (tcb_info_version == 2 && !has_tcb_date) {
+    return MissingFieldError("tcbDate");
+  }
+  WarnUnrecognizedFields("TCB level JSON", unrecognized_fields);
   return tcb_level;
 }
 
-// Parses a valid Fmspc from |fmspc_json|.
-StatusOr<Fmspc> FmspcFromJson(const google::protobuf::Value &fmspc_json) {
-  const std::string *fmspc_hex_string;
-  ASYLO_ASSIGN_OR_RETURN(fmspc_hex_string, JsonGetString(fmspc_json));
-  if (!IsHexEncoded(*fmspc_hex_string)) {
+// Reads a valid Fmspc from |reader|.
+StatusOr<Fmspc> FmspcFromJson(JsonReader *reader) {
+  std::string fmspc_hex_string;
+  ASYLO_ASSIGN_OR_RETURN(fmspc_hex_string, reader->ReadString());
+  if (!IsHexEncoded(fmspc_hex_string)) {
     return Status(error::GoogleError::INVALID_ARGUMENT,
                   "FMSPC JSON is not a hex encoding string");
   }
 
-  std::string fmspc_bytes = absl::HexStringToBytes(*fmspc_hex_string);
+  std::string fmspc_bytes = absl::HexStringToBytes(fmspc_hex_string);
   if (fmspc_bytes.size() != kFmspcSize) {
     return Status(error::GoogleError::INVALID_ARGUMENT,
                   absl::StrCat("FMSPC JSON does not represent a ", kFmspcSize,
@@ -329,18 +343,18 @@ StatusOr<Fmspc> FmspcFromJson(const google::protobuf::Value &fmspc_json) {
   return fmspc;
 }
 
-// Parses a valid PceId from |pce_id_json|.
-StatusOr<PceId> PceIdFromJson(const google::protobuf::Value &pce_id_json) {
+// Reads a valid PceId from |reader|.
+StatusOr<PceId> PceIdFromJson(JsonReader *reader) {
   constexpr int kPceIdNumBytes = 2;
 
-  const std::string *pce_id_hex_string;
-  ASYLO_ASSIGN_OR_RETURN(pce_id_hex_string, JsonGetString(pce_id_json));
-  if (!IsHexEncoded(*pce_id_hex_string)) {
+  std::string pce_id_hex_string;
+  ASYLO_ASSIGN_OR_RETURN(pce_id_hex_string, reader->ReadString());
+  if (!IsHexEncoded(pce_id_hex_string)) {
     return Status(error::GoogleError::INVALID_ARGUMENT,
                   "PCE ID JSON is not a hex encoding string");
   }
 
-  std::string pce_id_bytes = absl::HexStringToBytes(*pce_id_hex_string);
+  std::string pce_id_bytes = absl::HexStringToBytes(pce_id_hex_string);
   if (pce_id_bytes.size() != kPceIdNumBytes) {
     return Status(error::GoogleError::INVALID_ARGUMENT,
                   absl::StrCat("PCE ID JSON does not represent a ",
@@ -353,21 +367,25 @@ StatusOr<PceId> PceIdFromJson(const google::protobuf::Value &pce_id_json) {
   return pce_id;
 }
 
-// Parses a valid list of TcbLevels from |tcb_levels_json|. Assumes that the TCB
-// levels come from a TCB info structure with version |tcb_info_version|, which
-// must be either 1 or 2.
+// Reads a valid list of TcbLevels from |reader|. Assumes that the TCB levels
+// come from a TCB info structure with version |tcb_info_version|, which must be
+// either 1 or 2.
 StatusOr<google::protobuf::RepeatedPtrField<TcbLevel>> TcbLevelsFromJson(
-    int32_t tcb_info_version, const google::protobuf::Value &tcb_levels_json) {
-  const google::protobuf::ListValue *tcb_levels_array;
-  ASYLO_ASSIGN_OR_RETURN(tcb_levels_array, JsonGetArray(tcb_levels_json));
+    int32_t tcb_info_version, JsonReader *reader) {
+  ASYLO_RETURN_IF_ERROR(reader->BeginArray());
 
   absl::flat_hash_map<Tcb, TcbStatus, absl::Hash<Tcb>, MessageEqual>
       tcb_to_status_map;
   google::protobuf::RepeatedPtrField<TcbLevel> tcb_levels;
-  for (const auto &tcb_level_json : tcb_levels_array->values()) {
+  bool has_element;
+  while (true) {
+    ASYLO_ASSIGN_OR_RETURN(has_element, reader->NextElement());
+    if (!has_element) {
+      break;
+    }
     TcbLevel tcb_level;
     ASYLO_ASSIGN_OR_RETURN(tcb_level,
-                           TcbLevelFromJson(tcb_info_version, tcb_level_json));
+                           TcbLevelFromJson(tcb_info_version, reader));
     auto insert_pair =
         tcb_to_status_map.insert({tcb_level.tcb(), tcb_level.status()});
     if (!insert_pair.second) {
@@ -378,13 +396,9 @@ StatusOr<google::protobuf::RepeatedPtrField<TcbLevel>> TcbLevelsFromJson(
             "TCB info JSON contains the same TCB level multiple times with "
             "different statuses");
       } else {
-        std::string json_string;
-        if (!google::protobuf::util::MessageToJsonString(tcb_levels_json, &json_string)
-                 .ok()) {
-          json_string = "TCB levels JSON";
-        }
-        LOG(WARNING) << absl::StrCat("Encountered duplicate TCB entries in ",
-                                     json_string);
+        LOG(WARNING) << absl::StrCat(
+            "Encountered duplicate TCB entries in TCB levels JSON: ",
+            tcb_level.ShortDebugString());
         continue;
       }
     }
@@ -393,50 +407,25 @@ StatusOr<google::protobuf::RepeatedPtrField<TcbLevel>> TcbLevelsFromJson(
   return tcb_levels;
 }
 
-// Parses a valid TcbInfo from |tcb_info_object| with a "version" of |version|.
-// The |version| must be equal to 1 or 2.
-StatusOr<TcbInfo> TcbInfoFromJsonV1and2(
-    int32_t version, const google::protobuf::Struct &tcb_info_object) {
-  TcbInfo tcb_info;
-  TcbInfoImpl *tcb_info_impl = tcb_info.mutable_impl();
-
-  tcb_info_impl->set_version(version);
-
-  const google::protobuf::Value *issue_date_json;
-  ASYLO_ASSIGN_OR_RETURN(issue_date_json,
-                         JsonObjectGetField(tcb_info_object, "issueDate"));
-  ASYLO_ASSIGN_OR_RETURN(*tcb_info_impl->mutable_issue_date(),
-                         TimestampFromJson(*issue_date_json));
-
-  const google::protobuf::Value *next_update_json;
-  ASYLO_ASSIGN_OR_RETURN(next_update_json,
-                         JsonObjectGetField(tcb_info_object, "nextUpdate"));
-  ASYLO_ASSIGN_OR_RETURN(*tcb_info_impl->mutable_next_update(),
-                         TimestampFromJson(*next_update_json));
-
-  if (tcb_info_impl->issue_date() >= tcb_info_impl->next_update()) {
-    return Status(error::GoogleError::INVALID_ARGUMENT,
-                  "Issue date does not come before next update");
+// Reads the value of the field |name| of a TCB info JSON object whose
+// interpretation depends on the |version| of the TCB info, which must be 1 or
+// 2, into |tcb_info_impl|. Returns false without reading the value if |name| is
+// not a field of TCB info JSON objects with that |version|.
+StatusOr<bool> VersionedTcbInfoFieldFromJson(int32_t version,
+                                             absl::string_view name,
+                                             JsonReader *reader,
+                                             TcbInfoImpl *tcb_info_impl) {
+  if (name == "tcbLevels") {
+    ASYLO_ASSIGN_OR_RETURN(*tcb_info_impl->mutable_tcb_levels(),
+                           TcbLevelsFromJson(version, reader));
+    return true;
   }
-
-  const google::protobuf::Value *fmspc_json;
-  ASYLO_ASSIGN_OR_RETURN(fmspc_json,
-                         JsonObjectGetField(tcb_info_object, "fmspc"));
-  ASYLO_ASSIGN_OR_RETURN(*tcb_info_impl->mutable_fmspc(),
-                         FmspcFromJson(*fmspc_json));
-
-  const google::protobuf::Value *pce_id_json;
-  ASYLO_ASSIGN_OR_RETURN(pce_id_json,
-                         JsonObjectGetField(tcb_info_object, "pceId"));
-  ASYLO_ASSIGN_OR_RETURN(*tcb_info_impl->mutable_pce_id(),
-                         PceIdFromJson(*pce_id_json));
-
-  if (version == 2) {
-    const google::protobuf::Value *tcb_type_json;
-    ASYLO_ASSIGN_OR_RETURN(tcb_type_json,
-                           JsonObjectGetField(tcb_info_object, "tcbType"));
+  if (version != 2) {
+    return false;
+  }
+  if (name == "tcbType") {
     int32_t tcb_type;
-    ASYLO_ASSIGN_OR_RETURN(tcb_type, Int32FromJson(*tcb_type_json, "TCB type"));
+    ASYLO_ASSIGN_OR_RETURN(tcb_type, Int32FromJson(reader, "TCB type"));
     switch (tcb_type) {
       case 0:
         tcb_info_impl->set_tcb_type(TcbType::TCB_TYPE_0);
@@ -445,84 +434,216 @@ StatusOr<TcbInfo> TcbInfoFromJsonV1and2(
         return Status(error::GoogleError::INVALID_ARGUMENT,
                       absl::StrCat("Unknown TCB type value: ", tcb_type));
     }
-
-    const google::protobuf::Value *tcb_evaluation_data_number_json;
-    ASYLO_ASSIGN_OR_RETURN(
-        tcb_evaluation_data_number_json,
-        JsonObjectGetField(tcb_info_object, "tcbEvaluationDataNumber"));
+    return true;
+  }
+  if (name == "tcbEvaluationDataNumber") {
     int32_t tcb_evaluation_data_number;
-    ASYLO_ASSIGN_OR_RETURN(tcb_evaluation_data_number,
-                           Int32FromJson(*tcb_evaluation_data_number_json,
-                                         "TCB evaluation data number"));
+    ASYLO_ASSIGN_OR_RETURN(
+        tcb_evaluation_data_number,
+        Int32FromJson(reader, "TCB evaluation data number"));
     tcb_info_impl->set_tcb_evaluation_data_number(tcb_evaluation_data_number);
+    return true;
   }
+  return false;
+}
 
-  const google::protobuf::Value *tcb_levels_json;
-  ASYLO_ASSIGN_OR_RETURN(tcb_levels_json,
-                         JsonObjectGetField(tcb_info_object, "tcbLevels"));
-  ASYLO_ASSIGN_OR_RETURN(*tcb_info_impl->mutable_tcb_levels(),
-                         TcbLevelsFromJson(version, *tcb_levels_json));
+// Reads a valid TcbInfo from |reader|. Currently, only versions 1 and 2 of TCB
+// info JSON objects are supported.
+StatusOr<TcbInfo> TcbInfoFromJsonReader(JsonReader *reader) {
+  // A version 1 TCB info JSON object has six fields: "version", "issueDate",
+  // "nextUpdate", "fmspc", "pceId", and "tcbLevels". A version 2 TCB info JSON
+  // object also has "tcbType" and "tcbEvaluationDataNumber".
+  ASYLO_RETURN_IF_ERROR(reader->BeginObject());
+  TcbInfo tcb_info;
+  TcbInfoImpl *tcb_info_impl = tcb_info.mutable_impl();
+  bool has_version = false;
+  bool has_issue_date = false;
+  bool has_next_update = false;
+  bool has_fmspc = false;
+  bool has_pce_id = false;
+  bool has_tcb_type = false;
+  bool has_tcb_evaluation_data_number = false;
+  bool has_tcb_levels = false;
+  std::vector<std::string> unrecognized_fields;
+
+  // The fields which depend on the version are only decoded once it is known.
+  // Intel's services list the version first, so the values of these fields are
+  // only set aside when it comes later.
+  std::vector<std::pair<std::string, absl::string_view>> deferred_fields;
+
+  std::string name;
+  auto read_versioned_field = [&](bool *read) -> Status {
+    ASYLO_RETURN_IF_ERROR(MarkFieldRead(name, read));
+    if (!has_version) {
+      absl::string_view value;
+      ASYLO_ASSIGN_OR_RETURN(value, reader->ReadRawValue());
+      deferred_fields.emplace_back(name, value);
+      return Status::OkStatus();
+    }
+    bool recognized;
+    ASYLO_ASSIGN_OR_RETURN(
+        recognized, VersionedTcbInfoFieldFromJson(tcb_info_impl->version(),
+                                                  name, reader, tcb_info_impl));
+    if (!recognized) {
+      return SkipUnrecognizedField(name, reader, &unrecognized_fields);
+    }
+    return Status::OkStatus();
+  };
 
-  int expected_num_fields = -1;
-  switch (version) {
-    case 1:
-      // A version 1 TCB info JSON object should have six top-level fields:
-      // "version", "issueDate", "nextUpdate", "fmspc", "pceId", and
-      // "tcbLevels".
-      expected_num_fields = 6;
-      break;
-    case 2:
-      // A version 2 TCB info JSON object should have six top-level fields:
-      // "version", "issueDate", "nextUpdate", "fmspc", "pceId", "tcbType",
-      // "tcbEvaluationDataNumber", and "tcbLevels".
-      expected_num_fields = 8;
+  bool has_field;
+  while (true) {
+    ASYLO_ASSIGN_OR_RETURN(has_field, reader->NextField(&name));
+    if (!has_field) {
       break;
+    }
+    if (name == "version") {
+      ASYLO_RETURN_IF_ERROR(MarkFieldRead(name, &has_version));
+      int32_t version;
+      ASYLO_ASSIGN_OR_RETURN(version,
+                             Int32FromJson(reader, "TCB info version"));
+      if (version != 1 && version != 2) {
+        return Status(
+            error::GoogleError::INVALID_ARGUMENT,
+            absl::StrCat("Unrecognized version of TCB info JSON: ", version));
+      }
+      tcb_info_impl->set_version(version);
+    } else if (name == "issueDate") {
+      ASYLO_RETURN_IF_ERROR(MarkFieldRead(name, &has_issue_date));
+      ASYLO_ASSIGN_OR_RETURN(*tcb_info_impl->mutable_issue_date(),
+                             TimestampFromJson(reader));
+    } else if (name == "nextUpdate") {
+      ASYLO_RETURN_IF_ERROR(MarkFieldRead(name, &has_next_update));
+      ASYLO_ASSIGN_OR_RETURN(*tcb_info_impl->mutable_next_update(),
+                             TimestampFromJson(reader));
+    } else if (name == "fmspc") {
+      ASYLO_RETURN_IF_ERROR(MarkFieldRead(name, &has_fmspc));
+      ASYLO_ASSIGN_OR_RETURN(*tcb_info_impl->mutable_fmspc(),
+                             FmspcFromJson(reader));
+    } else if (name == "pceId") {
+      ASYLO_RETURN_IF_ERROR(MarkFieldRead(name, &has_pce_id));
+      ASYLO_ASSIGN_OR_RETURN(*tcb_info_impl->mutable_pce_id(),
+                             PceIdFromJson(reader));
+    } else if (name == "tcbType") {
+      ASYLO_RETURN_IF_ERROR(read_versioned_field(&has_tcb_type));
+    } else if (name == "tcbEvaluationDataNumber") {
+      ASYLO_RETURN_IF_ERROR(
+          read_versioned_field(&has_tcb_evaluation_data_number));
+    } else if (name == "tcbLevels") {
+      ASYLO_RETURN_IF_ERROR(read_versioned_field(&has_tcb_levels));
+    } else {
+      ASYLO_RETURN_IF_ERROR(
+          SkipUnrecognizedField(name, reader, &unrecognized_fields));
+    }
+  }
+
+  if (!has_version) {
+    return MissingFieldError("version");
   }
-  if (tcb_info_object.fields().size() > expected_num_fields) {
-    std::string json_string;
-    if (!google::protobuf::util::MessageToJsonString(tcb_info_object, &json_string)
-             .ok()) {
-      json_string = "TCB info JSON";
+  for (const auto &field : deferred_fields) {
+    JsonReader field_reader(field.second);
+    bool recognized;
+    ASYLO_ASSIGN_OR_RETURN(
+        recognized,
+        VersionedTcbInfoFieldFromJson(tcb_info_impl->version(), field.first,
+                                      &field_reader, tcb_info_impl));
+    if (recognized) {
+      ASYLO_RETURN_IF_ERROR(field_reader.Finish());
+    } else {
+      unrecognized_fields.push_back(field.first);
     }
-    LOG(WARNING) << absl::StrCat("Encountered unrecognized fields in ",
-                                 json_string);
   }
 
+  if (!has_issue_date) {
+    return MissingFieldError("issueDate");
+  }
+  if (!has_next_update) {
+    return MissingFieldError("nextUpdate");
+  }
+  if (tcb_info_impl->issue_date() >= tcb_info_impl->next_update()) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Issue date does not come before next update");
+  }
+  if (!has_fmspc) {
+    return MissingFieldError("fmspc");
+  }
+  if (!has_pce_id) {
+    return MissingFieldError("pceId");
+  }
+  if (tcb_info_impl->version() == 2) {
+    if (!has_tcb_type) {
+      return MissingFieldError("tcbType");
+    }
+    if (!has_tcb_evaluation_data_number) {
+      return MissingFieldError("tcbEvaluationDataNumber");
+    }
+  }
+  if (!has_tcb_levels) {
+    return MissingFieldError("tcbLevels");
+  }
+  WarnUnrecognizedFields("TCB info JSON", unrecognized_fields);
   return tcb_info;
 }
 
 }  // namespace
 
+StatusOr<Tcb> TcbFromJsonReader(JsonReader *reader) {
+  ASYLO_RETURN_IF_ERROR(reader->BeginObject());
+  Tcb tcb;
+  tcb.set_components(std::string(kTcbComponentsSize, 0));
+  std::array<bool, kTcbComponentsSize> has_components = {};
+  bool has_pce_svn = false;
+  std::vector<std::string> unrecognized_fields;
+
+  std::string name;
+  bool has_field;
+  while (true) {
+    ASYLO_ASSIGN_OR_RETURN(has_field, reader->NextField(&name));
+    if (!has_field) {
+      break;
+    }
+    int component = SgxTcbComponentIndex(name);
+    if (component >= 0) {
+      ASYLO_RETURN_IF_ERROR(MarkFieldRead(name, &has_components[component]));
+      ASYLO_ASSIGN_OR_RETURN((*tcb.mutable_components())[component],
+                             SgxTcbComponentSvnFromJson(reader));
+    } else if (name == "pcesvn") {
+      ASYLO_RETURN_IF_ERROR(MarkFieldRead(name, &has_pce_svn));
+      ASYLO_ASSIGN_OR_RETURN(*tcb.mutable_pce_svn(), PceSvnFromJson(reader));
+    } else {
+      ASYLO_RETURN_IF_ERROR(
+          SkipUnrecognizedField(name, reader, &unrecognized_fields));
+    }
+  }
+
+  // Each TCB JSON object should have kTcbComponentsSize + 1 fields: one
+  // "sgxtcbcomp##svn" for each number between 1 and kTcbComponentsSize, as well
+  // as a "pcesvn" field.
+  for (int i = 0; i < kTcbComponentsSize; ++i) {
+    if (!has_components[i]) {
+      return MissingFieldError(absl::StrFormat("sgxtcbcomp%02dsvn", i + 1));
+    }
+  }
+  if (!has_pce_svn) {
+    return MissingFieldError("pcesvn");
+  }
+  WarnUnrecognizedFields("TCB JSON", unrecognized_fields);
+  return tcb;
+}
+
 StatusOr<Tcb> TcbFromJson(const std::string &json_string) {
-  google::protobuf::Value tcb_json;
-  ASYLO_RETURN_IF_ERROR(
-      Status(google::protobuf::util::JsonStringToMessage(json_string, &tcb_json)));
-  return TcbFromJsonValue(tcb_json);
+  JsonReader reader(json_string);
+  Tcb tcb;
+  ASYLO_ASSIGN_OR_RETURN(tcb, TcbFromJsonReader(&reader));
+  ASYLO_RETURN_IF_ERROR(reader.Finish());
+  return tcb;
 }
 
 StatusOr<TcbInfo> TcbInfoFromJson(const std::string &json_string) {
-  google::protobuf::Value tcb_info_json;
-  ASYLO_RETURN_IF_ERROR(
-      Status(google::protobuf::util::JsonStringToMessage(json_string, &tcb_info_json)));
-
-  const google::protobuf::Struct *tcb_info_object;
-  ASYLO_ASSIGN_OR_RETURN(tcb_info_object, JsonGetObject(tcb_info_json));
-
-  const google::protobuf::Value *version_json;
-  ASYLO_ASSIGN_OR_RETURN(version_json,
-                         JsonObjectGetField(*tcb_info_object, "version"));
-  int32_t version;
-  ASYLO_ASSIGN_OR_RETURN(version,
-                         Int32FromJson(*version_json, "TCB info version"));
-  switch (version) {
-    case 1:
-    case 2:
-      return TcbInfoFromJsonV1and2(version, *tcb_info_object);
-    default:
-      return Status(
-          error::GoogleError::INVALID_ARGUMENT,
-          absl::StrCat("Unrecognized version of TCB info JSON: ", version));
-  }
+  JsonReader reader(json_string);
+  TcbInfo tcb_info;
+  ASYLO_ASSIGN_OR_RETURN(tcb_info, TcbInfoFromJsonReader(&reader));
+  ASYLO_RETURN_IF_ERROR(reader.Finish());
+  return tcb_info;
 }
 
 }  // namespace sgx
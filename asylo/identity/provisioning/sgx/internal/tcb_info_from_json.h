@@ -22,6 +22,7 @@
 #include <string>
 
 #include "asylo/identity/provisioning/sgx/internal/tcb.pb.h"
+#include "asylo/util/json_reader.h"
 #include "asylo/util/statusor.h"
 
 namespace asylo {
@@ -37,6 +38,11 @@ namespace sgx {
 // but does not return an error.
 StatusOr<Tcb> TcbFromJson(const std::string &json_string);
 
+// Reads the next value of |reader| into a Tcb proto, with the same
+// requirements as TcbFromJson(). This allows decoders of JSON documents which
+// contain TCBs to decode them without parsing them a second time.
+StatusOr<Tcb> TcbFromJsonReader(JsonReader *reader);
+
 // Parses |json_string| into a TcbInfo proto. If the |json_string| does not
 // match the specification of the "tcbInfo" field of the JSON returned by
 // Intel's Get TCB Info API (as documented at
@@ -18,12 +18,19 @@
 
 #include "asylo/identity/provisioning/sgx/internal/tcb_info_reader.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
+#include <string>
 #include <utility>
+#include <vector>
 
 #include "absl/container/flat_hash_set.h"
 #include "absl/hash/hash.h"
 #include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
 #include "asylo/identity/platform/sgx/machine_configuration.pb.h"
 #include "asylo/identity/provisioning/sgx/internal/container_util.h"
 #include "asylo/identity/provisioning/sgx/internal/pck_certificate_util.h"
@@ -42,15 +49,52 @@ namespace {
 // The index of the Configuration ID byte in a CPU SVN for TCB type 0.
 constexpr int kConfigIdByteIndexForTcbType0 = 6;
 
+// The number of GetTcbLevel() results kept by a TcbInfoReader. The results are
+// discarded once there are this many, which bounds the memory used for readers
+// that see many distinct platforms.
+constexpr size_t kMaxCachedTcbLevelLookups = 4096;
+
+// Returns a key whose lexicographic order extends the partial order of TCBs of
+// type 0 with |components| and |pce_svn|. That is, if one TCB is less than or
+// equal to another, then so is its key.
+std::string TcbSortKey(absl::string_view components, uint32_t pce_svn) {
+  std::string key(components);
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    key.push_back(static_cast<char>((pce_svn >> shift) & 0xff));
+  }
+  return key;
+}
+
+// Returns true if every component of the TCB with key |lhs| is less than or
+// equal to the corresponding component of the TCB with key |rhs|.
+bool IsAtOrBelow(absl::string_view lhs, absl::string_view rhs) {
+  for (int i = 0; i < kTcbComponentsSize; ++i) {
+    if (static_cast<uint8_t>(lhs[i]) > static_cast<uint8_t>(rhs[i])) {
+      return false;
+    }
+  }
+  return lhs.substr(kTcbComponentsSize) <= rhs.substr(kTcbComponentsSize);
+}
+
 }  // namespace
 
 StatusOr<TcbInfoReader> TcbInfoReader::Create(TcbInfo tcb_info) {
   ASYLO_RETURN_IF_ERROR(ValidateTcbInfo(tcb_info));
   absl::flat_hash_set<Tcb, absl::Hash<Tcb>, MessageEqual> tcb_levels;
-  for (const TcbLevel &tcb_level : tcb_info.impl().tcb_levels()) {
-    tcb_levels.insert(tcb_level.tcb());
+  std::vector<IndexedTcbLevel> tcb_level_index;
+  tcb_level_index.reserve(tcb_info.impl().tcb_levels_size());
+  for (int i = 0; i < tcb_info.impl().tcb_levels_size(); ++i) {
+    const Tcb &tcb = tcb_info.impl().tcb_levels(i).tcb();
+    tcb_levels.insert(tcb);
+    tcb_level_index.push_back(
+        {TcbSortKey(tcb.components(), tcb.pce_svn().value()), i});
   }
-  return TcbInfoReader(std::move(tcb_info), std::move(tcb_levels));
+  std::stable_sort(tcb_level_index.begin(), tcb_level_index.end(),
+                   [](const IndexedTcbLevel &lhs, const IndexedTcbLevel &rhs) {
+                     return lhs.key > rhs.key;
+                   });
+  return TcbInfoReader(std::move(tcb_info), std::move(tcb_levels),
+                       std::move(tcb_level_index));
 }
 
 const TcbInfo &TcbInfoReader::GetTcbInfo() const { return tcb_info_; }
@@ -109,10 +153,67 @@ StatusOr<ProvisioningConsistency> TcbInfoReader::GetConsistencyWith(
   }
 }
 
+StatusOr<TcbLevel> TcbInfoReader::GetTcbLevel(const RawTcb &raw_tcb) const {
+  ASYLO_RETURN_IF_ERROR(ValidateRawTcb(raw_tcb));
+  TcbType tcb_type = tcb_info_.impl().has_tcb_type()
+                         ? tcb_info_.impl().tcb_type()
+                         : TcbType::TCB_TYPE_0;
+  if (tcb_type != TcbType::TCB_TYPE_0) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  absl::StrCat("Unknown TCB type: ",
+                               ProtoEnumValueName(tcb_type)));
+  }
+
+  absl::optional<int> index;
+  {
+    auto lookup_cache = lookup_cache_->ReaderLock();
+    auto it = lookup_cache->find(raw_tcb);
+    if (it != lookup_cache->end()) {
+      index = it->second;
+    }
+  }
+  if (!index.has_value()) {
+    index = FindTcbLevel(raw_tcb);
+    auto lookup_cache = lookup_cache_->Lock();
+    if (lookup_cache->size() >= kMaxCachedTcbLevelLookups) {
+      lookup_cache->clear();
+    }
+    lookup_cache->emplace(raw_tcb, index.value());
+  }
+
+  if (index.value() < 0) {
+    return Status(error::GoogleError::NOT_FOUND,
+                  "TCB is below every TCB level in the TCB info");
+  }
+  return tcb_info_.impl().tcb_levels(index.value());
+}
+
 TcbInfoReader::TcbInfoReader(
     TcbInfo tcb_info,
-    absl::flat_hash_set<Tcb, absl::Hash<Tcb>, MessageEqual> tcb_levels)
-    : tcb_info_(std::move(tcb_info)), tcb_levels_(std::move(tcb_levels)) {}
+    absl::flat_hash_set<Tcb, absl::Hash<Tcb>, MessageEqual> tcb_levels,
+    std::vector<IndexedTcbLevel> tcb_level_index)
+    : tcb_info_(std::move(tcb_info)),
+      tcb_levels_(std::move(tcb_levels)),
+      tcb_level_index_(std::move(tcb_level_index)) {}
+
+int TcbInfoReader::FindTcbLevel(const RawTcb &raw_tcb) const {
+  std::string key =
+      TcbSortKey(raw_tcb.cpu_svn().value(), raw_tcb.pce_svn().value());
+
+  // TCB levels with a greater key than |raw_tcb| cannot be at or below it, so
+  // the search starts at the first TCB level whose key is not greater.
+  auto it = std::lower_bound(
+      tcb_level_index_.begin(), tcb_level_index_.end(), key,
+      [](const IndexedTcbLevel &level, const std::string &target) {
+        return level.key > target;
+      });
+  for (; it != tcb_level_index_.end(); ++it) {
+    if (IsAtOrBelow(it->key, key)) {
+      return it->index;
+    }
+  }
+  return -1;
+}
 
 }  // namespace sgx
 }  // namespace asylo
@@ -19,8 +19,11 @@
 #ifndef ASYLO_IDENTITY_PROVISIONING_SGX_INTERNAL_TCB_INFO_READER_H_
 #define ASYLO_IDENTITY_PROVISIONING_SGX_INTERNAL_TCB_INFO_READER_H_
 
+#include <memory>
 #include <string>
+#include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/hash/hash.h"
 #include "asylo/identity/platform/sgx/machine_configuration.pb.h"
@@ -28,6 +31,7 @@
 #include "asylo/identity/provisioning/sgx/internal/pck_certificates.pb.h"
 #include "asylo/identity/provisioning/sgx/internal/platform_provisioning.pb.h"
 #include "asylo/identity/provisioning/sgx/internal/tcb.pb.h"
+#include "asylo/util/mutex_guarded.h"
 #include "asylo/util/statusor.h"
 
 namespace asylo {
@@ -56,6 +60,9 @@ enum class ProvisioningConsistency {
 };
 
 // A class that provides provisioning information based on TCB info.
+//
+// TcbInfoReader is thread-safe. Copies of a TcbInfoReader share the memoized
+// results of GetTcbLevel().
 class TcbInfoReader {
  public:
   TcbInfoReader() = default;
@@ -80,16 +87,51 @@ class TcbInfoReader {
   StatusOr<ProvisioningConsistency> GetConsistencyWith(
       const PckCertificates &pck_certificates) const;
 
+  // Returns the TCB level of the contained TCB info that applies to a platform
+  // at |raw_tcb|. This is the greatest TCB level, in the lexicographic order of
+  // its components and PCE SVN, that every component of |raw_tcb| is at or
+  // above. For TCB infos from Intel, whose TCB levels are sorted from highest
+  // to lowest, this is the first such TCB level.
+  //
+  // Returns a NOT_FOUND error if |raw_tcb| is below every TCB level, and an
+  // INVALID_ARGUMENT error if |raw_tcb| is not valid according to
+  // ValidateRawTcb().
+  StatusOr<TcbLevel> GetTcbLevel(const RawTcb &raw_tcb) const;
+
  private:
+  // A TCB level of the TCB info and its sort key.
+  struct IndexedTcbLevel {
+    // The TCB components followed by the big-endian PCE SVN.
+    std::string key;
+
+    // The index of the TCB level in the TCB info.
+    int index;
+  };
+
+  using LookupCache =
+      absl::flat_hash_map<RawTcb, int, absl::Hash<RawTcb>, MessageEqual>;
+
   TcbInfoReader(
       TcbInfo tcb_info,
-      absl::flat_hash_set<Tcb, absl::Hash<Tcb>, MessageEqual> tcb_levels);
+      absl::flat_hash_set<Tcb, absl::Hash<Tcb>, MessageEqual> tcb_levels,
+      std::vector<IndexedTcbLevel> tcb_level_index);
+
+  // Returns the index of the TCB level that applies to |raw_tcb|, or -1 if
+  // there is none. |raw_tcb| must be valid.
+  int FindTcbLevel(const RawTcb &raw_tcb) const;
 
   // The TCB info that this TcbInfoReader was created with.
   TcbInfo tcb_info_;
 
   // The TCB levels from the TCB info.
   absl::flat_hash_set<Tcb, absl::Hash<Tcb>, MessageEqual> tcb_levels_;
+
+  // The TCB levels from the TCB info, sorted by descending key.
+  std::vector<IndexedTcbLevel> tcb_level_index_;
+
+  // Results of FindTcbLevel() for the TCBs looked up so far.
+  std::shared_ptr<MutexGuarded<LookupCache>> lookup_cache_ =
+      std::make_shared<MutexGuarded<LookupCache>>();
 };
 
 }  // namespace sgx
@@ -30,6 +30,7 @@
 #include "asylo/identity/platform/sgx/internal/identity_key_management_structs.h"
 #include "asylo/identity/platform/sgx/machine_configuration.pb.h"
 #include "asylo/identity/provisioning/sgx/internal/platform_provisioning.pb.h"
+#include "asylo/identity/provisioning/sgx/internal/tcb.pb.h"
 #include "asylo/test/util/proto_matchers.h"
 #include "asylo/test/util/status_matchers.h"
 #include "asylo/util/status.h"
@@ -187,6 +188,67 @@ TEST(TcbInfoReaderTest, GetConsistencyWithFailsOnInvalidPckCertificates) {
               StatusIs(error::GoogleError::INVALID_ARGUMENT));
 }
 
+// Returns a RawTcb with CPU SVN |cpu_svn| and PCE SVN |pce_svn|.
+RawTcb CreateRawTcb(absl::string_view cpu_svn, int pce_svn) {
+  RawTcb raw_tcb;
+  raw_tcb.mutable_cpu_svn()->set_value(cpu_svn.data(), cpu_svn.size());
+  raw_tcb.mutable_pce_svn()->set_value(pce_svn);
+  return raw_tcb;
+}
+
+constexpr char kTcbInfoCpuSvn[] =
+    "\x00\x01\x02\x03\x04\x05\x06\x07\x08\x09\x0a\x0b\x0c\x0d\x0e\x0f";
+
+TEST(TcbInfoReaderTest, GetTcbLevelFailsOnInvalidRawTcb) {
+  TcbInfo tcb_info;
+  ASSERT_TRUE(google::protobuf::TextFormat::ParseFromString(kExtendedTcbInfo, &tcb_info));
+  TcbInfoReader reader;
+  ASYLO_ASSERT_OK_AND_ASSIGN(reader, TcbInfoReader::Create(tcb_info));
+
+  EXPECT_THAT(reader.GetTcbLevel(RawTcb()),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+}
+
+TEST(TcbInfoReaderTest, GetTcbLevelReturnsHighestApplicableTcbLevel) {
+  TcbInfo tcb_info;
+  ASSERT_TRUE(google::protobuf::TextFormat::ParseFromString(kExtendedTcbInfo, &tcb_info));
+  TcbInfoReader reader;
+  ASYLO_ASSERT_OK_AND_ASSIGN(reader, TcbInfoReader::Create(tcb_info));
+
+  std::string cpu_svn(kTcbInfoCpuSvn, kCpusvnSize);
+  RawTcb raw_tcb = CreateRawTcb(cpu_svn, 3);
+  EXPECT_THAT(reader.GetTcbLevel(raw_tcb),
+              IsOkAndHolds(EqualsProto(tcb_info.impl().tcb_levels(0))));
+
+  // Repeated lookups return the same TCB level.
+  EXPECT_THAT(reader.GetTcbLevel(raw_tcb),
+              IsOkAndHolds(EqualsProto(tcb_info.impl().tcb_levels(0))));
+
+  EXPECT_THAT(reader.GetTcbLevel(CreateRawTcb(cpu_svn, 2)),
+              IsOkAndHolds(EqualsProto(tcb_info.impl().tcb_levels(1))));
+
+  // A higher CPU SVN component does not make up for a lower PCE SVN.
+  cpu_svn[kCpusvnSize - 1] = 0x10;
+  EXPECT_THAT(reader.GetTcbLevel(CreateRawTcb(cpu_svn, 2)),
+              IsOkAndHolds(EqualsProto(tcb_info.impl().tcb_levels(1))));
+}
+
+TEST(TcbInfoReaderTest, GetTcbLevelFailsOnTcbBelowEveryTcbLevel) {
+  TcbInfo tcb_info;
+  ASSERT_TRUE(google::protobuf::TextFormat::ParseFromString(kExtendedTcbInfo, &tcb_info));
+  TcbInfoReader reader;
+  ASYLO_ASSERT_OK_AND_ASSIGN(reader, TcbInfoReader::Create(tcb_info));
+
+  std::string cpu_svn(kTcbInfoCpuSvn, kCpusvnSize);
+  EXPECT_THAT(reader.GetTcbLevel(CreateRawTcb(cpu_svn, 1)),
+              StatusIs(error::GoogleError::NOT_FOUND));
+
+  // A higher PCE SVN does not make up for a lower CPU SVN component.
+  cpu_svn[kCpusvnSize - 1] = 0x0e;
+  EXPECT_THAT(reader.GetTcbLevel(CreateRawTcb(cpu_svn, 5)),
+              StatusIs(error::GoogleError::NOT_FOUND));
+}
+
 class TcbInfoReaderGetConsistencyWithTest
     : public TestWithParam<
           std::tuple<const char *, const char *, ProvisioningConsistency>> {};
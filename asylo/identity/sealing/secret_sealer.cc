@@ -20,8 +20,11 @@
 
 #include <cstdint>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
 #include "asylo/crypto/util/byte_container_util.h"
 #include "asylo/util/status_macros.h"
 
@@ -36,6 +39,86 @@ Status SecretSealer::Reseal(const SealedSecret &old_sealed_secret,
               unsealed_secret, new_sealed_secret);
 }
 
+Status SecretSealer::SealBatch(const SealedSecretHeader &header,
+                               ByteContainerView additional_authenticated_data,
+                               absl::Span<const ByteContainerView> secrets,
+                               SealedSecretBatch *sealed_batch) {
+  SealedSecretBatch batch;
+  if (secrets.empty()) {
+    if (!header.SerializeToString(batch.mutable_sealed_secret_header())) {
+      return Status(error::GoogleError::INTERNAL,
+                    "Header serialization to string failed");
+    }
+    batch.set_additional_authenticated_data(
+        reinterpret_cast<const char *>(additional_authenticated_data.data()),
+        additional_authenticated_data.size());
+  }
+  for (ByteContainerView secret : secrets) {
+    SealedSecret sealed_secret;
+    ASYLO_RETURN_IF_ERROR(
+        Seal(header, additional_authenticated_data, secret, &sealed_secret));
+    if (batch.records().empty()) {
+      *batch.mutable_sealed_secret_header() =
+          std::move(*sealed_secret.mutable_sealed_secret_header());
+      *batch.mutable_additional_authenticated_data() =
+          std::move(*sealed_secret.mutable_additional_authenticated_data());
+      *batch.mutable_sealing_root_bookkeeping_info() =
+          std::move(*sealed_secret.mutable_sealing_root_bookkeeping_info());
+    } else if (sealed_secret.sealed_secret_header() !=
+                   batch.sealed_secret_header() ||
+               sealed_secret.sealing_root_bookkeeping_info() !=
+                   batch.sealing_root_bookkeeping_info()) {
+      return Status(error::GoogleError::INTERNAL,
+                    "Secrets sealed to the same header have different headers");
+    }
+    SealedSecretRecord *record = batch.add_records();
+    *record->mutable_iv() = std::move(*sealed_secret.mutable_iv());
+    *record->mutable_secret_ciphertext() =
+        std::move(*sealed_secret.mutable_secret_ciphertext());
+  }
+  *sealed_batch = std::move(batch);
+  return Status::OkStatus();
+}
+
+Status SecretSealer::UnsealBatch(
+    const SealedSecretBatch &sealed_batch,
+    std::vector<CleansingVector<uint8_t>> *secrets) {
+  std::vector<CleansingVector<uint8_t>> unsealed(sealed_batch.records_size());
+  for (size_t i = 0; i < unsealed.size(); ++i) {
+    ASYLO_RETURN_IF_ERROR(UnsealBatchRecord(sealed_batch, i, &unsealed[i]));
+  }
+  *secrets = std::move(unsealed);
+  return Status::OkStatus();
+}
+
+Status SecretSealer::UnsealBatchRecord(const SealedSecretBatch &sealed_batch,
+                                       size_t index,
+                                       CleansingVector<uint8_t> *secret) {
+  SealedSecret sealed_secret;
+  ASYLO_ASSIGN_OR_RETURN(sealed_secret, GetBatchRecord(sealed_batch, index));
+  return Unseal(sealed_secret, secret);
+}
+
+StatusOr<SealedSecret> SecretSealer::GetBatchRecord(
+    const SealedSecretBatch &sealed_batch, size_t index) {
+  if (index >= static_cast<size_t>(sealed_batch.records_size())) {
+    return Status(error::GoogleError::OUT_OF_RANGE,
+                  absl::StrCat("Record index ", index,
+                               " is out of range for a batch of ",
+                               sealed_batch.records_size(), " records"));
+  }
+  const SealedSecretRecord &record = sealed_batch.records(index);
+  SealedSecret sealed_secret;
+  sealed_secret.set_iv(record.iv());
+  sealed_secret.set_sealed_secret_header(sealed_batch.sealed_secret_header());
+  sealed_secret.set_additional_authenticated_data(
+      sealed_batch.additional_authenticated_data());
+  sealed_secret.set_secret_ciphertext(record.secret_ciphertext());
+  sealed_secret.set_sealing_root_bookkeeping_info(
+      sealed_batch.sealing_root_bookkeeping_info());
+  return sealed_secret;
+}
+
 StatusOr<std::string> SecretSealer::GenerateSealerId(SealingRootType type,
                                                      const std::string &name) {
   std::string serialized;
@@ -23,6 +23,7 @@
 #include <string>
 #include <vector>
 
+#include "absl/types/span.h"
 #include "asylo/crypto/util/byte_container_view.h"
 #include "asylo/identity/identity.pb.h"
 #include "asylo/identity/sealing/sealed_secret.pb.h"
@@ -133,6 +134,49 @@ class SecretSealer {
                         const SealedSecretHeader &new_header,
                         SealedSecret *new_sealed_secret);
 
+  /// Seals each of `secrets` per the header specification, all with the same
+  /// `additional_authenticated_data`.
+  ///
+  /// The `header` and `additional_authenticated_data` are stored once in
+  /// `sealed_batch`, which holds one record per secret, in the order of
+  /// `secrets`. The base class implements this method by calling Seal() for
+  /// each secret. A derived class of SecretSealer may choose to further
+  /// optimize this method, for instance by deriving the sealing key only once.
+  ///
+  /// \param header The metadata to guide the sealing.
+  /// \param additional_authenticated_data Unencrypted data that is bundled with
+  ///        the sealed secrets.
+  /// \param secrets The data to encrypt and seal.
+  /// \param[out] sealed_batch The output sealed secrets.
+  /// \return A non-OK status if sealing any of the secrets fails.
+  virtual Status SealBatch(const SealedSecretHeader &header,
+                           ByteContainerView additional_authenticated_data,
+                           absl::Span<const ByteContainerView> secrets,
+                           SealedSecretBatch *sealed_batch);
+
+  /// Unseals all the records of `sealed_batch` and writes them to `secrets`,
+  /// in the order of the records.
+  ///
+  /// The base class implements this method by calling Unseal() for each
+  /// record. A derived class of SecretSealer may choose to further optimize
+  /// this method.
+  ///
+  /// \param sealed_batch The input secrets to unseal.
+  /// \param[out] secrets The destination for the unsealed secrets.
+  /// \return A non-OK Status if unsealing any of the records fails.
+  virtual Status UnsealBatch(const SealedSecretBatch &sealed_batch,
+                             std::vector<CleansingVector<uint8_t>> *secrets);
+
+  /// Unseals only the record at `index` of `sealed_batch` and writes it to
+  /// `secret`.
+  ///
+  /// \param sealed_batch The input secrets.
+  /// \param index The index of the record to unseal.
+  /// \param[out] secret The destination for the unsealed secret.
+  /// \return A non-OK Status if `index` is out of range or if unsealing fails.
+  Status UnsealBatchRecord(const SealedSecretBatch &sealed_batch, size_t index,
+                           CleansingVector<uint8_t> *secret);
+
   /// Combines the specified sealing root type and sealing root name
   /// to form a string. The combined string uniquely identifies the SecretSealer
   /// responsible for handling secrets associated with the particular
@@ -143,6 +187,16 @@ class SecretSealer {
   /// \return An object that represents a result string, or a failure status.
   static StatusOr<std::string> GenerateSealerId(SealingRootType type,
                                                 const std::string &name);
+
+ protected:
+  /// Returns the record at `index` of `sealed_batch` as a standalone
+  /// SealedSecret.
+  ///
+  /// \param sealed_batch The batch that holds the record.
+  /// \param index The index of the record.
+  /// \return The sealed secret, or a non-OK status if `index` is out of range.
+  static StatusOr<SealedSecret> GetBatchRecord(
+      const SealedSecretBatch &sealed_batch, size_t index);
 };
 
 /// \cond Internal
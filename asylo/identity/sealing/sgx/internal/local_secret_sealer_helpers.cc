@@ -31,7 +31,7 @@
 #include "asylo/crypto/util/trivial_object_util.h"
 #include "asylo/identity/identity.pb.h"
 #include "asylo/identity/identity_acl.pb.h"
-#include "asylo/identity/platform/sgx/internal/hardware_interface.h"
+#include "asylo/identity/platform/sgx/internal/caching_hardware_interface.h"
 #include "asylo/identity/platform/sgx/internal/secs_attributes.h"
 #include "asylo/identity/platform/sgx/internal/self_identity.h"
 #include "asylo/identity/platform/sgx/internal/sgx_identity_util_internal.h"
@@ -158,8 +158,8 @@ Status GenerateCryptorKey(AeadScheme aead_scheme, const std::string &key_id,
     req->keyid.assign(digest);
 
     HardwareKey hardware_key;
-    ASYLO_ASSIGN_OR_RETURN(hardware_key,
-                           HardwareInterface::CreateDefault()->GetKey(*req));
+    ASYLO_ASSIGN_OR_RETURN(
+        hardware_key, CachingHardwareInterface::GetInstance()->GetKey(*req));
     size_t copy_size = std::min(hardware_key.size(), remaining_key_bytes);
     remaining_key_bytes -= copy_size;
     std::copy(hardware_key.cbegin(), hardware_key.cbegin() + copy_size,
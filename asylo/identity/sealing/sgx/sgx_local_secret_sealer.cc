@@ -19,9 +19,12 @@
 #include "asylo/identity/sealing/sgx/sgx_local_secret_sealer.h"
 
 #include <memory>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include "absl/memory/memory.h"
+#include "absl/types/span.h"
 #include "asylo/crypto/aead_cryptor.h"
 #include "asylo/crypto/algorithms.pb.h"
 #include "asylo/crypto/util/byte_container_util.h"
@@ -33,12 +36,32 @@
 #include "asylo/identity/platform/sgx/sgx_identity.pb.h"
 #include "asylo/identity/platform/sgx/sgx_identity_util.h"
 #include "asylo/identity/sealing/sgx/internal/local_secret_sealer_helpers.h"
+#include "asylo/util/cleansing_types.h"
 #include "asylo/util/status_macros.h"
 
 namespace asylo {
+namespace {
 
 constexpr size_t kAes256GcmSivKeySize = 32;
 
+// Returns a cryptor that uses the key for secrets sealed to |header|.
+StatusOr<std::unique_ptr<AeadCryptor>> MakeCryptorForHeader(
+    const SealedSecretHeader &header) {
+  AeadScheme aead_scheme;
+  SgxIdentityExpectation sgx_expectation;
+  ASYLO_RETURN_IF_ERROR(
+      sgx::internal::ParseKeyGenerationParamsFromSealedSecretHeader(
+          header, &aead_scheme, &sgx_expectation));
+
+  CleansingVector<uint8_t> key;
+  ASYLO_RETURN_IF_ERROR(sgx::internal::GenerateCryptorKey(
+      aead_scheme, "default_key_id", sgx_expectation, kAes256GcmSivKeySize,
+      &key));
+  return sgx::internal::MakeCryptor(aead_scheme, key);
+}
+
+}  // namespace
+
 std::unique_ptr<SgxLocalSecretSealer>
 SgxLocalSecretSealer::CreateMrenclaveSecretSealer() {
   // This always returns OK because the DEFAULT match spec options are valid.
@@ -124,11 +147,8 @@ Status SgxLocalSecretSealer::Seal(
     const SealedSecretHeader &header,
     ByteContainerView additional_authenticated_data, ByteContainerView secret,
     SealedSecret *sealed_secret) {
-  AeadScheme aead_scheme;
-  SgxIdentityExpectation sgx_expectation;
-  ASYLO_RETURN_IF_ERROR(
-      sgx::internal::ParseKeyGenerationParamsFromSealedSecretHeader(
-          header, &aead_scheme, &sgx_expectation));
+  std::unique_ptr<AeadCryptor> cryptor;
+  ASYLO_ASSIGN_OR_RETURN(cryptor, MakeCryptorForHeader(header));
 
   if (!header.SerializeToString(
           sealed_secret->mutable_sealed_secret_header())) {
@@ -144,13 +164,6 @@ Status SgxLocalSecretSealer::Seal(
                           sealed_secret->sealed_secret_header(),
                           additional_authenticated_data);
 
-  CleansingVector<uint8_t> key;
-  ASYLO_RETURN_IF_ERROR(sgx::internal::GenerateCryptorKey(
-      aead_scheme, "default_key_id", sgx_expectation, kAes256GcmSivKeySize,
-      &key));
-
-  std::unique_ptr<AeadCryptor> cryptor;
-  ASYLO_ASSIGN_OR_RETURN(cryptor, sgx::internal::MakeCryptor(aead_scheme, key));
   return sgx::internal::Seal(cryptor.get(), secret, final_additional_data,
                              sealed_secret);
 }
@@ -163,26 +176,86 @@ Status SgxLocalSecretSealer::Unseal(const SealedSecret &sealed_secret,
                   "Could not parse the sealed secret header");
   }
 
-  AeadScheme aead_scheme;
-  SgxIdentityExpectation sgx_expectation;
-  ASYLO_RETURN_IF_ERROR(
-      sgx::internal::ParseKeyGenerationParamsFromSealedSecretHeader(
-          header, &aead_scheme, &sgx_expectation));
+  std::unique_ptr<AeadCryptor> cryptor;
+  ASYLO_ASSIGN_OR_RETURN(cryptor, MakeCryptorForHeader(header));
 
   std::string final_additional_data;
   SerializeByteContainers(&final_additional_data,
                           sealed_secret.sealed_secret_header(),
                           sealed_secret.additional_authenticated_data());
 
-  CleansingVector<uint8_t> key;
-  ASYLO_RETURN_IF_ERROR(sgx::internal::GenerateCryptorKey(
-      aead_scheme, "default_key_id", sgx_expectation, kAes256GcmSivKeySize,
-      &key));
-
-  std::unique_ptr<AeadCryptor> cryptor;
-  ASYLO_ASSIGN_OR_RETURN(cryptor, sgx::internal::MakeCryptor(aead_scheme, key));
   return sgx::internal::Open(cryptor.get(), sealed_secret,
                              final_additional_data, secret);
 }
 
+Status SgxLocalSecretSealer::SealBatch(
+    const SealedSecretHeader &header,
+    ByteContainerView additional_authenticated_data,
+    absl::Span<const ByteContainerView> secrets,
+    SealedSecretBatch *sealed_batch) {
+  std::unique_ptr<AeadCryptor> cryptor;
+  ASYLO_ASSIGN_OR_RETURN(cryptor, MakeCryptorForHeader(header));
+
+  SealedSecretBatch batch;
+  if (!header.SerializeToString(batch.mutable_sealed_secret_header())) {
+    return Status(error::GoogleError::INTERNAL,
+                  "Header serialization to string failed");
+  }
+  batch.set_additional_authenticated_data(
+      reinterpret_cast<const char *>(additional_authenticated_data.data()),
+      additional_authenticated_data.size());
+
+  // Each record is sealed exactly as Seal() would seal it, so that every record
+  // can also be unsealed as a standalone SealedSecret.
+  std::string final_additional_data;
+  SerializeByteContainers(&final_additional_data, batch.sealed_secret_header(),
+                          additional_authenticated_data);
+
+  batch.mutable_records()->Reserve(secrets.size());
+  for (ByteContainerView secret : secrets) {
+    SealedSecret sealed_secret;
+    ASYLO_RETURN_IF_ERROR(sgx::internal::Seal(
+        cryptor.get(), secret, final_additional_data, &sealed_secret));
+    SealedSecretRecord *record = batch.add_records();
+    *record->mutable_iv() = std::move(*sealed_secret.mutable_iv());
+    *record->mutable_secret_ciphertext() =
+        std::move(*sealed_secret.mutable_secret_ciphertext());
+  }
+
+  *sealed_batch = std::move(batch);
+  return Status::OkStatus();
+}
+
+Status SgxLocalSecretSealer::UnsealBatch(
+    const SealedSecretBatch &sealed_batch,
+    std::vector<CleansingVector<uint8_t>> *secrets) {
+  SealedSecretHeader header;
+  if (!header.ParseFromString(sealed_batch.sealed_secret_header())) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Could not parse the sealed secret header");
+  }
+
+  std::unique_ptr<AeadCryptor> cryptor;
+  ASYLO_ASSIGN_OR_RETURN(cryptor, MakeCryptorForHeader(header));
+
+  std::string final_additional_data;
+  SerializeByteContainers(&final_additional_data,
+                          sealed_batch.sealed_secret_header(),
+                          sealed_batch.additional_authenticated_data());
+
+  std::vector<CleansingVector<uint8_t>> unsealed(sealed_batch.records_size());
+  for (int i = 0; i < sealed_batch.records_size(); ++i) {
+    // sgx::internal::Open() only reads the IV and the ciphertext.
+    SealedSecret sealed_secret;
+    sealed_secret.set_iv(sealed_batch.records(i).iv());
+    sealed_secret.set_secret_ciphertext(
+        sealed_batch.records(i).secret_ciphertext());
+    ASYLO_RETURN_IF_ERROR(sgx::internal::Open(
+        cryptor.get(), sealed_secret, final_additional_data, &unsealed[i]));
+  }
+
+  *secrets = std::move(unsealed);
+  return Status::OkStatus();
+}
+
 }  // namespace asylo
@@ -20,7 +20,9 @@
 #define ASYLO_IDENTITY_SEALING_SGX_SGX_LOCAL_SECRET_SEALER_H_
 
 #include <memory>
+#include <vector>
 
+#include "absl/types/span.h"
 #include "asylo/crypto/util/byte_container_view.h"
 #include "asylo/identity/identity.pb.h"
 #include "asylo/identity/platform/sgx/code_identity.pb.h"
@@ -139,6 +141,16 @@ class SgxLocalSecretSealer : public SecretSealer {
   Status Unseal(const SealedSecret &sealed_secret,
                 CleansingVector<uint8_t> *secret) override;
 
+  // Derives the sealing key once for the whole batch.
+  Status SealBatch(const SealedSecretHeader &header,
+                   ByteContainerView additional_authenticated_data,
+                   absl::Span<const ByteContainerView> secrets,
+                   SealedSecretBatch *sealed_batch) override;
+
+  // Derives the sealing key once for the whole batch.
+  Status UnsealBatch(const SealedSecretBatch &sealed_batch,
+                     std::vector<CleansingVector<uint8_t>> *secrets) override;
+
  private:
   // Instantiates LocalSecretSealer that sets client_acl in the default sealed
   // secret header per |default_client_acl|.
@@ -23,6 +23,8 @@
 #include <sys/types.h>
 
 #include <memory>
+#include <string>
+#include <vector>
 
 #include <google/protobuf/io/zero_copy_stream_impl.h>
 #include <google/protobuf/text_format.h>
@@ -61,7 +63,10 @@ ABSL_FLAG(std::string, test_data_path, "", "Path to secret sealer test data");
 namespace asylo {
 namespace {
 
+using ::testing::ElementsAreArray;
+using ::testing::Eq;
 using ::testing::Not;
+using ::testing::SizeIs;
 
 constexpr char kBadRootName[] = "BAD";
 constexpr char kBadExpectation[] = "BAD";
@@ -411,6 +416,65 @@ TEST_F(SgxLocalSecretSealerTest, SealUnsealMrenclaveSuccessSameEnclave) {
   EXPECT_EQ(input_secret, output_secret);
 }
 
+// Verify that a batch of secrets can be unsealed as a whole, one record at a
+// time, and as standalone sealed secrets.
+TEST_F(SgxLocalSecretSealerTest, SealBatchUnsealBatchSuccess) {
+  const std::vector<std::string> kSecrets = {kTestSecret, kTestString, ""};
+  std::vector<ByteContainerView> input_secrets(kSecrets.begin(),
+                                               kSecrets.end());
+  std::string input_aad(kTestAad);
+
+  std::unique_ptr<SgxLocalSecretSealer> sealer =
+      SgxLocalSecretSealer::CreateMrenclaveSecretSealer();
+  SealedSecretHeader header;
+  PrepareSealedSecretHeader(*sealer, &header);
+
+  SealedSecretBatch sealed_batch;
+  ASSERT_THAT(
+      sealer->SealBatch(header, input_aad, input_secrets, &sealed_batch),
+      IsOk());
+  ASSERT_THAT(sealed_batch.records(), SizeIs(kSecrets.size()));
+  EXPECT_THAT(sealed_batch.additional_authenticated_data(), Eq(input_aad));
+
+  std::unique_ptr<SgxLocalSecretSealer> sealer2 =
+      SgxLocalSecretSealer::CreateMrenclaveSecretSealer();
+  std::vector<CleansingVector<uint8_t>> output_secrets;
+  ASSERT_THAT(sealer2->UnsealBatch(sealed_batch, &output_secrets), IsOk());
+  ASSERT_THAT(output_secrets, SizeIs(kSecrets.size()));
+  for (size_t i = 0; i < kSecrets.size(); ++i) {
+    EXPECT_THAT(output_secrets[i], ElementsAreArray(kSecrets[i]));
+
+    CleansingVector<uint8_t> output_secret;
+    ASSERT_THAT(sealer2->UnsealBatchRecord(sealed_batch, i, &output_secret),
+                IsOk());
+    EXPECT_THAT(output_secret, ElementsAreArray(kSecrets[i]));
+  }
+
+  CleansingVector<uint8_t> output_secret;
+  EXPECT_THAT(sealer2->UnsealBatchRecord(sealed_batch, kSecrets.size(),
+                                         &output_secret),
+              StatusIs(error::GoogleError::OUT_OF_RANGE));
+}
+
+// Verify that tampering with the shared additional authenticated data of a
+// batch is detected.
+TEST_F(SgxLocalSecretSealerTest, UnsealBatchFailureModifiedAad) {
+  std::vector<ByteContainerView> input_secrets = {kTestSecret, kTestString};
+
+  std::unique_ptr<SgxLocalSecretSealer> sealer =
+      SgxLocalSecretSealer::CreateMrenclaveSecretSealer();
+  SealedSecretHeader header;
+  PrepareSealedSecretHeader(*sealer, &header);
+
+  SealedSecretBatch sealed_batch;
+  ASSERT_THAT(sealer->SealBatch(header, kTestAad, input_secrets, &sealed_batch),
+              IsOk());
+  sealed_batch.mutable_additional_authenticated_data()->append(kTestString);
+
+  std::vector<CleansingVector<uint8_t>> output_secrets;
+  EXPECT_THAT(sealer->UnsealBatch(sealed_batch, &output_secrets), Not(IsOk()));
+}
+
 // Verify that a secret sealed to MRENCLAVE cannot be unsealed from an enclave
 // with a different MRENCLAVE value.
 TEST_F(SgxLocalSecretSealerTest, SealUnsealMrenclaveFailureDifferentMrenclave) {
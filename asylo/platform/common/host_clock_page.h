@@ -0,0 +1,104 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_COMMON_HOST_CLOCK_PAGE_H_
+#define ASYLO_PLATFORM_COMMON_HOST_CLOCK_PAGE_H_
+
+#include <atomic>
+#include <cstdint>
+
+#include "asylo/platform/core/atomic.h"
+
+namespace asylo {
+
+// This file defines the layout of the host clock page, through which a host
+// thread periodically publishes the host clocks to the enclave, like the vDSO
+// data page of Linux. The page lives in untrusted memory, so the trusted side
+// must treat every field as attacker controlled.
+
+// Value stored in |HostClockPage::magic| by the host.
+constexpr uint64_t kHostClockPageMagic = 0x41534c4f434c4b31;  // "ASLOCLK1"
+
+// A reading of the host clocks.
+struct HostClockSample {
+  // CLOCK_REALTIME and CLOCK_MONOTONIC, in nanoseconds.
+  int64_t realtime_ns;
+  int64_t monotonic_ns;
+
+  // The time stamp counter at the time of the reading, and the nanoseconds per
+  // tick measured by the host as a 32.32 fixed-point number. Both are zero if
+  // the host does not publish the time stamp counter.
+  uint64_t tsc;
+  uint64_t nanoseconds_per_tick_q32;
+};
+
+struct alignas(kCacheLineSize) HostClockPage {
+  // Always kHostClockPageMagic for an initialized page.
+  uint64_t magic;
+
+  // Nanoseconds between two updates of |sample|.
+  uint64_t update_interval_ns;
+
+  // Incremented before and after each update of |sample|, so it is odd while
+  // an update is in progress.
+  volatile uint64_t sequence;
+
+  // The latest reading of the host clocks.
+  volatile HostClockSample sample;
+};
+
+// Publishes |sample| to |page|. Only one thread may publish to a page.
+inline void PublishHostClockSample(HostClockPage *page,
+                                   const HostClockSample &sample) {
+  uint64_t sequence = page->sequence;
+  AtomicStore(&page->sequence, sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  page->sample.realtime_ns = sample.realtime_ns;
+  page->sample.monotonic_ns = sample.monotonic_ns;
+  page->sample.tsc = sample.tsc;
+  page->sample.nanoseconds_per_tick_q32 = sample.nanoseconds_per_tick_q32;
+  AtomicStore(&page->sequence, sequence + 2, std::memory_order_release);
+}
+
+// Reads a consistent sample from |page| into |sample|, trying at most
+// |max_attempts| times while the page is being updated. Returns false if no
+// attempt succeeded.
+inline bool ReadHostClockSample(const HostClockPage *page,
+                                HostClockSample *sample,
+                                int max_attempts = 64) {
+  for (int attempt = 0; attempt < max_attempts; ++attempt) {
+    uint64_t sequence = page->sequence;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (sequence & 1) {
+      continue;
+    }
+    sample->realtime_ns = page->sample.realtime_ns;
+    sample->monotonic_ns = page->sample.monotonic_ns;
+    sample->tsc = page->sample.tsc;
+    sample->nanoseconds_per_tick_q32 = page->sample.nanoseconds_per_tick_q32;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (page->sequence == sequence) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_COMMON_HOST_CLOCK_PAGE_H_
@@ -0,0 +1,119 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_COMMON_IO_URING_LAYOUT_H_
+#define ASYLO_PLATFORM_COMMON_IO_URING_LAYOUT_H_
+
+#include <cstdint>
+
+namespace asylo {
+
+// This file defines how an io_uring instance set up by the host is described
+// to the enclave, together with the parts of the kernel io_uring ABI the
+// enclave uses. Enclave toolchains do not ship the Linux headers, so the ABI is
+// mirrored here and checked against the kernel headers on the host. Everything
+// reachable from an IoUringLayout lives in untrusted memory, so the trusted
+// side must treat every field as attacker controlled.
+
+// Value stored in |IoUringLayout::magic| by the host.
+constexpr uint64_t kIoUringLayoutMagic = 0x41534c4f55524731;  // "ASLOURG1"
+
+// Operations submitted by the enclave (IORING_OP_*).
+constexpr uint8_t kIoUringOpAccept = 13;
+constexpr uint8_t kIoUringOpRead = 22;
+constexpr uint8_t kIoUringOpWrite = 23;
+constexpr uint8_t kIoUringOpSend = 26;
+constexpr uint8_t kIoUringOpRecv = 27;
+
+// Flags of io_uring_enter() (IORING_ENTER_*).
+constexpr uint32_t kIoUringEnterGetEvents = 1U << 0;
+constexpr uint32_t kIoUringEnterSqWakeup = 1U << 1;
+
+// Flag set in the submission queue flags while the kernel polling thread
+// sleeps (IORING_SQ_NEED_WAKEUP).
+constexpr uint32_t kIoUringSqNeedWakeup = 1U << 0;
+
+// A submission queue entry (struct io_uring_sqe).
+struct IoUringSqe {
+  uint8_t opcode;
+  uint8_t flags;
+  uint16_t ioprio;
+  int32_t fd;
+  // File offset, or the address of the address length for accept.
+  uint64_t off;
+  uint64_t addr;
+  uint32_t len;
+  // Per-operation flags, such as the message flags of send and recv.
+  uint32_t op_flags;
+  uint64_t user_data;
+  uint16_t buf_index;
+  uint16_t personality;
+  int32_t splice_fd_in;
+  uint64_t pad[2];
+};
+
+static_assert(sizeof(IoUringSqe) == 64, "IoUringSqe does not match the kernel");
+
+// A completion queue entry (struct io_uring_cqe).
+struct IoUringCqe {
+  uint64_t user_data;
+  int32_t res;
+  uint32_t flags;
+};
+
+static_assert(sizeof(IoUringCqe) == 16, "IoUringCqe does not match the kernel");
+
+// An io_uring instance and the bounce buffers through which the enclave
+// exchanges data with it. Ring sizes are powers of two and the rings are
+// indexed with free-running counters masked by size - 1.
+struct IoUringLayout {
+  // Always kIoUringLayoutMagic for an initialized layout.
+  uint64_t magic;
+
+  // Host file descriptor of the instance, passed to io_uring_enter().
+  int32_t ring_fd;
+
+  // Nonzero if a kernel thread polls the submission queue, in which case
+  // submissions only need io_uring_enter() to wake the thread up.
+  uint32_t sq_polled;
+
+  // Submission queue ring.
+  uint32_t *sq_head;
+  uint32_t *sq_tail;
+  uint32_t *sq_flags;
+  uint32_t *sq_array;
+  uint32_t sq_entries;
+
+  // Completion queue ring.
+  uint32_t cq_entries;
+  uint32_t *cq_head;
+  uint32_t *cq_tail;
+  IoUringCqe *cqes;
+
+  // The |sq_entries| submission queue entries indexed by |sq_array|.
+  IoUringSqe *sqes;
+
+  // |buffer_count| bounce buffers of |buffer_size| bytes each, contiguous.
+  uint8_t *buffers;
+  uint32_t buffer_count;
+  uint32_t buffer_size;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_COMMON_IO_URING_LAYOUT_H_
@@ -0,0 +1,177 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/core/balanced_enclave_pool.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "asylo/util/logging.h"
+#include "asylo/util/status_macros.h"
+
+namespace asylo {
+
+StatusOr<std::unique_ptr<BalancedEnclavePool>> BalancedEnclavePool::Create(
+    EnclaveManager *manager, EnclaveLoadConfig load_config, size_t size) {
+  if (manager == nullptr) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "BalancedEnclavePool requires an EnclaveManager");
+  }
+  if (load_config.name().empty()) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "BalancedEnclavePool requires a named EnclaveLoadConfig");
+  }
+  if (size == 0) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "BalancedEnclavePool size must be positive");
+  }
+
+  auto pool = absl::WrapUnique(
+      new BalancedEnclavePool(manager, std::move(load_config)));
+  for (size_t i = 0; i < size; ++i) {
+    ASYLO_RETURN_IF_ERROR(pool->AddInstance());
+  }
+  return std::move(pool);
+}
+
+BalancedEnclavePool::BalancedEnclavePool(EnclaveManager *manager,
+                                         EnclaveLoadConfig load_config)
+    : manager_(manager), load_config_(std::move(load_config)) {}
+
+BalancedEnclavePool::~BalancedEnclavePool() {
+  std::vector<std::unique_ptr<Instance>> instances;
+  {
+    absl::MutexLock lock(&mu_);
+    instances.swap(instances_);
+  }
+  for (auto &instance : instances) {
+    Status status = Destroy(std::move(instance));
+    if (!status.ok()) {
+      LOG(ERROR) << "Failed to destroy pooled enclave: " << status;
+    }
+  }
+}
+
+Status BalancedEnclavePool::EnterAndRun(const EnclaveInput &input,
+                                        EnclaveOutput *output) {
+  Instance *instance;
+  {
+    absl::MutexLock lock(&mu_);
+    instance = LeastLoaded();
+    if (instance == nullptr) {
+      return Status(error::GoogleError::FAILED_PRECONDITION,
+                    absl::StrCat("BalancedEnclavePool for ",
+                                 load_config_.name(), " has no instances"));
+    }
+    ++instance->in_flight;
+  }
+
+  // The instance outlives the call even if it is drained meanwhile, since
+  // Destroy() waits for its calls in flight.
+  Status status = instance->client->EnterAndRun(input, output);
+
+  absl::MutexLock lock(&mu_);
+  --instance->in_flight;
+  return status;
+}
+
+Status BalancedEnclavePool::AddInstance() {
+  EnclaveLoadConfig load_config = load_config_;
+  {
+    absl::MutexLock lock(&mu_);
+    load_config.set_name(absl::StrCat(load_config_.name(), "#", next_id_++));
+  }
+
+  // Load without holding |mu_| so that calls keep flowing to the other
+  // instances meanwhile.
+  ASYLO_RETURN_IF_ERROR(manager_->LoadEnclave(load_config));
+  EnclaveClient *client = manager_->GetClient(load_config.name());
+  if (client == nullptr) {
+    return Status(error::GoogleError::INTERNAL,
+                  absl::StrCat("Loaded enclave ", load_config.name(),
+                               " is not registered"));
+  }
+
+  absl::MutexLock lock(&mu_);
+  instances_.push_back(absl::WrapUnique(new Instance{client, 0}));
+  return Status::OkStatus();
+}
+
+Status BalancedEnclavePool::DrainInstance() {
+  std::unique_ptr<Instance> instance;
+  {
+    absl::MutexLock lock(&mu_);
+    Instance *least_loaded = LeastLoaded();
+    if (least_loaded == nullptr) {
+      return Status(error::GoogleError::FAILED_PRECONDITION,
+                    absl::StrCat("BalancedEnclavePool for ",
+                                 load_config_.name(), " has no instances"));
+    }
+    auto it = std::find_if(instances_.begin(), instances_.end(),
+                           [least_loaded](const std::unique_ptr<Instance> &i) {
+                             return i.get() == least_loaded;
+                           });
+    instance = std::move(*it);
+    instances_.erase(it);
+  }
+  return Destroy(std::move(instance));
+}
+
+size_t BalancedEnclavePool::size() const {
+  absl::MutexLock lock(&mu_);
+  return instances_.size();
+}
+
+std::vector<int> BalancedEnclavePool::InFlightCounts() const {
+  absl::MutexLock lock(&mu_);
+  std::vector<int> counts;
+  counts.reserve(instances_.size());
+  for (const auto &instance : instances_) {
+    counts.push_back(instance->in_flight);
+  }
+  return counts;
+}
+
+BalancedEnclavePool::Instance *BalancedEnclavePool::LeastLoaded() {
+  if (instances_.empty()) {
+    return nullptr;
+  }
+  size_t start = next_start_++ % instances_.size();
+  Instance *least_loaded = instances_[start].get();
+  for (size_t i = 1; i < instances_.size(); ++i) {
+    Instance *instance = instances_[(start + i) % instances_.size()].get();
+    if (instance->in_flight < least_loaded->in_flight) {
+      least_loaded = instance;
+    }
+  }
+  return least_loaded;
+}
+
+Status BalancedEnclavePool::Destroy(std::unique_ptr<Instance> instance) {
+  {
+    absl::MutexLock lock(&mu_);
+    mu_.Await(absl::Condition(
+        +[](Instance *instance) { return instance->in_flight == 0; },
+        instance.get()));
+  }
+  return manager_->DestroyEnclave(instance->client, EnclaveFinal());
+}
+
+}  // namespace asylo
@@ -0,0 +1,124 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_CORE_BALANCED_ENCLAVE_POOL_H_
+#define ASYLO_PLATFORM_CORE_BALANCED_ENCLAVE_POOL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "asylo/enclave.pb.h"
+#include "asylo/platform/core/enclave_client.h"
+#include "asylo/platform/core/enclave_manager.h"
+#include "asylo/util/status.h"
+#include "asylo/util/statusor.h"
+
+namespace asylo {
+
+/// A set of identical enclaves loaded from a single `EnclaveLoadConfig`, which
+/// spreads `EnterAndRun()` calls across its instances.
+///
+/// Each call is routed to the instance with the fewest calls in flight, so
+/// that a slow call on one instance does not hold up the calls behind it. The
+/// number of instances can change while calls are in flight: `AddInstance()`
+/// loads one more, and `DrainInstance()` stops routing calls to one, waits for
+/// the calls it is running to return, and destroys it.
+///
+/// Every instance is registered with the `EnclaveManager` under the configured
+/// name followed by `#` and a unique number, and belongs to the pool.
+/// `BalancedEnclavePool` is thread-safe.
+class BalancedEnclavePool {
+ public:
+  /// Creates a pool of `size` enclaves loaded from `load_config` through
+  /// `manager`.
+  ///
+  /// \param manager The manager to load enclaves with. It must outlive the
+  ///                pool.
+  /// \param load_config The configuration of every enclave in the pool. Its
+  ///                    name must not be empty.
+  /// \param size The initial number of enclaves. Must be positive.
+  /// \return The new pool, or an error if the arguments are invalid or an
+  ///         enclave fails to load.
+  static StatusOr<std::unique_ptr<BalancedEnclavePool>> Create(
+      EnclaveManager *manager, EnclaveLoadConfig load_config, size_t size);
+
+  BalancedEnclavePool(const BalancedEnclavePool &other) = delete;
+  BalancedEnclavePool &operator=(const BalancedEnclavePool &other) = delete;
+
+  /// Waits for calls in flight to return and destroys every instance.
+  ~BalancedEnclavePool();
+
+  /// Enters the least-loaded instance with `input`.
+  ///
+  /// \return The status returned by the enclave, or FAILED_PRECONDITION if the
+  ///         pool has no instance left.
+  Status EnterAndRun(const EnclaveInput &input, EnclaveOutput *output)
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  /// Loads one more instance and starts routing calls to it.
+  Status AddInstance() ABSL_LOCKS_EXCLUDED(mu_);
+
+  /// Stops routing calls to the least-loaded instance, waits for the calls it
+  /// is running to return, and destroys it.
+  ///
+  /// \return The status of destroying the instance, or FAILED_PRECONDITION if
+  ///         the pool has no instance left.
+  Status DrainInstance() ABSL_LOCKS_EXCLUDED(mu_);
+
+  /// Returns the number of instances that calls are routed to.
+  size_t size() const ABSL_LOCKS_EXCLUDED(mu_);
+
+  /// Returns the number of calls in flight on each instance that calls are
+  /// routed to, in the order the instances were added.
+  std::vector<int> InFlightCounts() const ABSL_LOCKS_EXCLUDED(mu_);
+
+ private:
+  // An enclave of the pool.
+  struct Instance {
+    EnclaveClient *client;
+    int in_flight;
+  };
+
+  BalancedEnclavePool(EnclaveManager *manager, EnclaveLoadConfig load_config);
+
+  // Returns the instance with the fewest calls in flight, or nullptr if there
+  // are no instances.
+  Instance *LeastLoaded() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Waits for the calls in flight on |instance| to return, then destroys it.
+  Status Destroy(std::unique_ptr<Instance> instance) ABSL_LOCKS_EXCLUDED(mu_);
+
+  EnclaveManager *const manager_;
+  const EnclaveLoadConfig load_config_;
+
+  mutable absl::Mutex mu_;
+  std::vector<std::unique_ptr<Instance>> instances_ ABSL_GUARDED_BY(mu_);
+  uint64_t next_id_ ABSL_GUARDED_BY(mu_) = 0;
+
+  // Index in |instances_| to start the next search for the least-loaded
+  // instance at, so that ties are spread across instances.
+  size_t next_start_ ABSL_GUARDED_BY(mu_) = 0;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_CORE_BALANCED_ENCLAVE_POOL_H_
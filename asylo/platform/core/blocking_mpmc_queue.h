@@ -0,0 +1,165 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_CORE_BLOCKING_MPMC_QUEUE_H_
+#define ASYLO_PLATFORM_CORE_BLOCKING_MPMC_QUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "asylo/platform/core/atomic.h"
+#include "asylo/platform/core/trusted_spin_lock.h"
+#include "asylo/platform/host_call/trusted/host_calls.h"
+#include "asylo/platform/primitives/trusted_runtime.h"
+#include "asylo/util/mpmc_queue.h"
+
+namespace asylo {
+
+// A bounded multi-producer, multi-consumer queue for trusted code whose Push
+// and Pop sleep on the host while the queue is full or empty.
+//
+// Elements are exchanged through an MpmcQueue, so threads which find space or
+// elements never take a lock or exit the enclave. A thread which has to wait
+// polls briefly, then sleeps on an untrusted wait queue with
+// enc_untrusted_thread_wait_value. Threads on the other end exit the enclave to
+// wake a sleeper only when one is registered.
+template <typename T>
+class BlockingMpmcQueue {
+ public:
+  // Creates an empty queue holding at least |capacity| elements.
+  explicit BlockingMpmcQueue(size_t capacity) : queue_(capacity) {}
+
+  BlockingMpmcQueue(const BlockingMpmcQueue &other) = delete;
+  BlockingMpmcQueue &operator=(const BlockingMpmcQueue &other) = delete;
+
+  // Appends |value| to the queue. Returns false without modifying |value| if
+  // the queue is full.
+  bool TryPush(T &&value) {
+    if (!queue_.TryPush(std::move(value))) {
+      return false;
+    }
+    not_empty_.Signal();
+    return true;
+  }
+
+  // Moves the element at the front of the queue into |value|. Returns false
+  // without modifying |value| if the queue is empty.
+  bool TryPop(T *value) {
+    if (!queue_.TryPop(value)) {
+      return false;
+    }
+    not_full_.Signal();
+    return true;
+  }
+
+  // Appends |value| to the queue, waiting for space if the queue is full.
+  void Push(T value) {
+    // A failed TryPush leaves |value| intact, so it may be retried.
+    not_full_.Wait([this, &value] { return queue_.TryPush(std::move(value)); });
+    not_empty_.Signal();
+  }
+
+  // Moves the element at the front of the queue into |value|, waiting for an
+  // element if the queue is empty.
+  void Pop(T *value) {
+    not_empty_.Wait([this, value] { return queue_.TryPop(value); });
+    not_full_.Signal();
+  }
+
+  // Returns the number of elements the queue can hold.
+  size_t capacity() const { return queue_.capacity(); }
+
+ private:
+  // An event count: a thread waiting for a condition samples |generation_|,
+  // registers itself in |waiters_|, checks the condition once more and sleeps
+  // on an untrusted copy of the generation. A thread which makes the condition
+  // true advances the generation only if somebody is registered, so that a
+  // sleeper either sees the condition or is woken up.
+  class Event {
+   public:
+    Event()
+        : lock_(/*is_recursive=*/false),
+          wait_queue_(enc_untrusted_create_wait_queue()) {
+      enc_untrusted_wait_queue_set_value(wait_queue_, generation_);
+    }
+
+    ~Event() { enc_untrusted_destroy_wait_queue(wait_queue_); }
+
+    // Returns once |try_operation| returns true.
+    template <typename TryOperation>
+    void Wait(TryOperation try_operation) {
+      for (int attempt = 0; attempt < kNumPollAttempts; ++attempt) {
+        if (try_operation()) {
+          return;
+        }
+        enc_pause();
+      }
+      while (true) {
+        int32_t generation = __atomic_load_n(&generation_, __ATOMIC_ACQUIRE);
+        AtomicIncrement(&waiters_);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool done = try_operation();
+        if (!done) {
+          // Returns immediately if the generation moved on since it was
+          // sampled.
+          enc_untrusted_thread_wait_value(wait_queue_, generation);
+          done = try_operation();
+        }
+        AtomicDecrement(&waiters_);
+        if (done) {
+          return;
+        }
+      }
+    }
+
+    // Wakes a sleeping waiter, if any.
+    void Signal() {
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (__atomic_load_n(&waiters_, __ATOMIC_RELAXED) == 0) {
+        return;
+      }
+      // Advance the trusted and untrusted generations together, so that the
+      // untrusted copy never moves backwards.
+      lock_.Lock();
+      int32_t generation = generation_ + 1;
+      AtomicStore(&generation_, generation);
+      enc_untrusted_wait_queue_set_value(wait_queue_, generation);
+      lock_.Unlock();
+      enc_untrusted_notify(wait_queue_);
+    }
+
+   private:
+    // Number of polls of the queue before sleeping on the host.
+    static constexpr int kNumPollAttempts = 1000;
+
+    TrustedSpinLock lock_;
+    int32_t *const wait_queue_;
+    int32_t generation_ = 0;
+    int32_t waiters_ = 0;
+  };
+
+  MpmcQueue<T> queue_;
+  Event not_empty_;
+  Event not_full_;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_CORE_BLOCKING_MPMC_QUEUE_H_
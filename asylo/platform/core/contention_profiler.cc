@@ -0,0 +1,325 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/core/contention_profiler.h"
+
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <cstdarg>
+#include <cstdio>
+
+#include "asylo/platform/core/atomic.h"
+
+namespace asylo {
+namespace internal {
+
+bool contention_profiling_enabled = false;
+
+}  // namespace internal
+
+namespace {
+
+// Number of table slots probed for a site before it is counted as untracked.
+constexpr size_t kMaxSiteProbes = 16;
+
+struct SiteSlot {
+  // Hash of |lock| and |caller|, or zero if the slot is free.
+  uint64_t key;
+  const void *lock;
+  const void *caller;
+  uint64_t contentions;
+  uint64_t total_wait_nanos;
+  uint64_t max_wait_nanos;
+  uint64_t total_spins;
+};
+
+struct {
+  SiteSlot sites[kMaxContentionSites];
+  uint64_t untracked_contentions;
+  uint64_t untracked_wait_nanos;
+  uint64_t untracked_spins;
+  uint64_t futex_waits;
+  uint64_t futex_wakes;
+  uint64_t thread_enqueues;
+  uint64_t total_thread_queue_depth;
+  uint64_t max_thread_queue_depth;
+  ContentionEvent events[kMaxContentionEvents];
+  // Number of events recorded so far. The event with index i is stored at
+  // events[i % kMaxContentionEvents].
+  uint64_t next_event;
+  uint64_t next_thread;
+} profile_state;
+
+// Set while the calling thread records, so that locks taken by the clock do
+// not record themselves.
+thread_local bool recording = false;
+
+// Identifier of the calling thread in events, or zero if not assigned yet.
+thread_local uint64_t profile_thread = 0;
+
+uint64_t MonotonicNanos() {
+  struct timespec ts;
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) {
+    return 0;
+  }
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+uint64_t SiteKey(const void *lock, const void *caller) {
+  uint64_t key = reinterpret_cast<uintptr_t>(lock) * 0x9e3779b97f4a7c15ull ^
+                 reinterpret_cast<uintptr_t>(caller);
+  key ^= key >> 29;
+  // Zero marks free slots.
+  return key ? key : 1;
+}
+
+// Returns the slot of the given site, claiming a free one if needed, or
+// nullptr if the table has no room for it.
+SiteSlot *FindSite(const void *lock, const void *caller) {
+  const uint64_t key = SiteKey(lock, caller);
+  for (size_t i = 0; i < kMaxSiteProbes; ++i) {
+    SiteSlot *slot = &profile_state.sites[(key + i) % kMaxContentionSites];
+    uint64_t slot_key = __atomic_load_n(&slot->key, __ATOMIC_ACQUIRE);
+    if (slot_key == 0) {
+      if (AtomicCompareExchange(&slot->key, &slot_key, key, /*weak=*/false,
+                                std::memory_order_acq_rel,
+                                std::memory_order_acquire)) {
+        AtomicStore(&slot->lock, lock, std::memory_order_relaxed);
+        AtomicStore(&slot->caller, caller, std::memory_order_relaxed);
+        return slot;
+      }
+    }
+    if (slot_key == key) {
+      return slot;
+    }
+  }
+  return nullptr;
+}
+
+void AtomicMax(uint64_t *location, uint64_t value) {
+  uint64_t current = __atomic_load_n(location, __ATOMIC_RELAXED);
+  while (current < value &&
+         !AtomicCompareExchange(location, &current, value, /*weak=*/true,
+                                std::memory_order_relaxed,
+                                std::memory_order_relaxed)) {
+  }
+}
+
+void RecordLockWait(const void *lock, const void *caller, uint64_t start_nanos,
+                    uint64_t wait_nanos) {
+  SiteSlot *slot = FindSite(lock, caller);
+  if (slot) {
+    AtomicIncrement(&slot->contentions, std::memory_order_relaxed);
+    __atomic_fetch_add(&slot->total_wait_nanos, wait_nanos, __ATOMIC_RELAXED);
+    AtomicMax(&slot->max_wait_nanos, wait_nanos);
+  } else {
+    AtomicIncrement(&profile_state.untracked_contentions,
+                    std::memory_order_relaxed);
+    __atomic_fetch_add(&profile_state.untracked_wait_nanos, wait_nanos,
+                       __ATOMIC_RELAXED);
+  }
+
+  if (profile_thread == 0) {
+    profile_thread = AtomicIncrement(&profile_state.next_thread,
+                                     std::memory_order_relaxed) +
+                     1;
+  }
+  uint64_t index =
+      AtomicIncrement(&profile_state.next_event, std::memory_order_relaxed);
+  ContentionEvent *event =
+      &profile_state.events[index % kMaxContentionEvents];
+  event->lock = lock;
+  event->caller = caller;
+  event->thread = profile_thread;
+  event->start_nanos = start_nanos;
+  event->wait_nanos = wait_nanos;
+}
+
+void AppendFormat(std::string *out, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+void AppendFormat(std::string *out, const char *format, ...) {
+  char buffer[256];
+  va_list args;
+  va_start(args, format);
+  int size = vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+  if (size > 0) {
+    out->append(buffer, std::min<size_t>(size, sizeof(buffer) - 1));
+  }
+}
+
+}  // namespace
+
+void EnableContentionProfiling(bool enabled) {
+  AtomicStore(&internal::contention_profiling_enabled, enabled,
+              std::memory_order_relaxed);
+}
+
+ScopedLockWait::ScopedLockWait(const void *lock, const void *caller)
+    : lock_(lock), caller_(caller), start_nanos_(0) {
+  if (!ContentionProfilingEnabled() || recording) {
+    return;
+  }
+  recording = true;
+  start_nanos_ = MonotonicNanos();
+  recording = false;
+}
+
+ScopedLockWait::~ScopedLockWait() {
+  if (start_nanos_ == 0 || recording) {
+    return;
+  }
+  recording = true;
+  uint64_t end_nanos = MonotonicNanos();
+  uint64_t wait_nanos = end_nanos > start_nanos_ ? end_nanos - start_nanos_ : 0;
+  RecordLockWait(lock_, caller_, start_nanos_, wait_nanos);
+  recording = false;
+}
+
+void RecordSpinWait(const void *lock, const void *caller, uint64_t spins) {
+  if (!ContentionProfilingEnabled()) {
+    return;
+  }
+  SiteSlot *slot = FindSite(lock, caller);
+  if (slot) {
+    AtomicIncrement(&slot->contentions, std::memory_order_relaxed);
+    __atomic_fetch_add(&slot->total_spins, spins, __ATOMIC_RELAXED);
+  } else {
+    AtomicIncrement(&profile_state.untracked_contentions,
+                    std::memory_order_relaxed);
+    __atomic_fetch_add(&profile_state.untracked_spins, spins,
+                       __ATOMIC_RELAXED);
+  }
+}
+
+void RecordFutexWait() {
+  if (ContentionProfilingEnabled()) {
+    AtomicIncrement(&profile_state.futex_waits, std::memory_order_relaxed);
+  }
+}
+
+void RecordFutexWake() {
+  if (ContentionProfilingEnabled()) {
+    AtomicIncrement(&profile_state.futex_wakes, std::memory_order_relaxed);
+  }
+}
+
+void RecordThreadQueueDepth(size_t depth) {
+  if (!ContentionProfilingEnabled()) {
+    return;
+  }
+  AtomicIncrement(&profile_state.thread_enqueues, std::memory_order_relaxed);
+  __atomic_fetch_add(&profile_state.total_thread_queue_depth, depth,
+                     __ATOMIC_RELAXED);
+  AtomicMax(&profile_state.max_thread_queue_depth, depth);
+}
+
+ContentionProfile GetContentionProfile() {
+  ContentionProfile profile;
+  for (const SiteSlot &slot : profile_state.sites) {
+    if (__atomic_load_n(&slot.key, __ATOMIC_ACQUIRE) == 0) {
+      continue;
+    }
+    profile.sites.push_back(
+        {__atomic_load_n(&slot.lock, __ATOMIC_RELAXED),
+         __atomic_load_n(&slot.caller, __ATOMIC_RELAXED),
+         __atomic_load_n(&slot.contentions, __ATOMIC_RELAXED),
+         __atomic_load_n(&slot.total_wait_nanos, __ATOMIC_RELAXED),
+         __atomic_load_n(&slot.max_wait_nanos, __ATOMIC_RELAXED),
+         __atomic_load_n(&slot.total_spins, __ATOMIC_RELAXED)});
+  }
+  std::sort(profile.sites.begin(), profile.sites.end(),
+            [](const LockContentionStats &a, const LockContentionStats &b) {
+              return a.total_wait_nanos != b.total_wait_nanos
+                         ? a.total_wait_nanos > b.total_wait_nanos
+                         : a.total_spins > b.total_spins;
+            });
+  profile.untracked_contentions =
+      __atomic_load_n(&profile_state.untracked_contentions, __ATOMIC_RELAXED);
+  profile.untracked_wait_nanos =
+      __atomic_load_n(&profile_state.untracked_wait_nanos, __ATOMIC_RELAXED);
+  profile.untracked_spins =
+      __atomic_load_n(&profile_state.untracked_spins, __ATOMIC_RELAXED);
+  profile.futex_waits =
+      __atomic_load_n(&profile_state.futex_waits, __ATOMIC_RELAXED);
+  profile.futex_wakes =
+      __atomic_load_n(&profile_state.futex_wakes, __ATOMIC_RELAXED);
+  profile.thread_enqueues =
+      __atomic_load_n(&profile_state.thread_enqueues, __ATOMIC_RELAXED);
+  profile.total_thread_queue_depth = __atomic_load_n(
+      &profile_state.total_thread_queue_depth, __ATOMIC_RELAXED);
+  profile.max_thread_queue_depth =
+      __atomic_load_n(&profile_state.max_thread_queue_depth, __ATOMIC_RELAXED);
+
+  uint64_t end = __atomic_load_n(&profile_state.next_event, __ATOMIC_RELAXED);
+  uint64_t begin = end > kMaxContentionEvents ? end - kMaxContentionEvents : 0;
+  for (uint64_t i = begin; i < end; ++i) {
+    profile.events.push_back(profile_state.events[i % kMaxContentionEvents]);
+  }
+  return profile;
+}
+
+void ResetContentionProfile() { profile_state = {}; }
+
+std::string ContentionProfileToChromeTrace(const ContentionProfile &profile) {
+  std::string trace = "{\"traceEvents\":[";
+  bool first = true;
+  for (const ContentionEvent &event : profile.events) {
+    AppendFormat(&trace,
+                 "%s{\"name\":\"lock %p\",\"cat\":\"contention\",\"ph\":\"X\","
+                 "\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":%" PRIu64
+                 ",\"args\":{\"caller\":\"%p\"}}",
+                 first ? "" : ",", event.lock, event.start_nanos / 1000.0,
+                 event.wait_nanos / 1000.0, event.thread, event.caller);
+    first = false;
+  }
+  trace += "],\"metadata\":{\"sites\":[";
+  first = true;
+  for (const LockContentionStats &site : profile.sites) {
+    AppendFormat(&trace,
+                 "%s{\"lock\":\"%p\",\"caller\":\"%p\",\"contentions\":%" PRIu64
+                 ",\"total_wait_ns\":%" PRIu64 ",\"max_wait_ns\":%" PRIu64
+                 ",\"total_spins\":%" PRIu64 "}",
+                 first ? "" : ",", site.lock, site.caller, site.contentions,
+                 site.total_wait_nanos, site.max_wait_nanos, site.total_spins);
+    first = false;
+  }
+  AppendFormat(&trace,
+               "],\"untracked_contentions\":%" PRIu64
+               ",\"untracked_wait_ns\":%" PRIu64
+               ",\"untracked_spins\":%" PRIu64,
+               profile.untracked_contentions, profile.untracked_wait_nanos,
+               profile.untracked_spins);
+  AppendFormat(&trace,
+               ",\"futex_waits\":%" PRIu64 ",\"futex_wakes\":%" PRIu64
+               ",\"thread_enqueues\":%" PRIu64,
+               profile.futex_waits, profile.futex_wakes,
+               profile.thread_enqueues);
+  AppendFormat(&trace,
+               ",\"total_thread_queue_depth\":%" PRIu64
+               ",\"max_thread_queue_depth\":%" PRIu64 "}}",
+               profile.total_thread_queue_depth,
+               profile.max_thread_queue_depth);
+  return trace;
+}
+
+}  // namespace asylo
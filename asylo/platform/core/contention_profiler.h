@@ -0,0 +1,162 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_CORE_CONTENTION_PROFILER_H_
+#define ASYLO_PLATFORM_CORE_CONTENTION_PROFILER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace asylo {
+
+// Opt-in instrumentation of enclave synchronization. When enabled, contended
+// acquisitions of pthread mutexes record how long they waited, and contended
+// acquisitions of TrustedSpinLock and TrustedTicketLock record how many times
+// they polled, keyed by the lock and the code which locked it. The
+// ThreadManager records the depth of its queue of threads waiting for a thread
+// donated by the host, and the untrusted wait queue host calls count futex
+// waits and wakes.
+//
+// Reading the clock exits the enclave, and host calls take the trusted locks
+// which guard untrusted memory allocation. The trusted spin locks therefore
+// count polls rather than measuring time.
+//
+// Recording takes no locks and does not allocate, so it may be called from the
+// implementation of any lock. Counters live in fixed-size static tables; sites
+// which do not fit are only counted in aggregate. Recorded values are updated
+// with relaxed atomics, so a profile taken while other threads record is
+// approximate.
+
+// Number of distinct (lock, caller) sites tracked individually.
+constexpr size_t kMaxContentionSites = 256;
+
+// Number of most recent contended acquisitions kept for trace dumps.
+constexpr size_t kMaxContentionEvents = 512;
+
+// Aggregated waits for one lock acquired from one call site.
+struct LockContentionStats {
+  const void *lock;
+  const void *caller;
+  uint64_t contentions;
+  // Time spent waiting by timed acquisitions.
+  uint64_t total_wait_nanos;
+  uint64_t max_wait_nanos;
+  // Polls made by spinning acquisitions.
+  uint64_t total_spins;
+};
+
+// A single timed contended acquisition.
+struct ContentionEvent {
+  const void *lock;
+  const void *caller;
+  // Small integer identifying the waiting thread within the profile.
+  uint64_t thread;
+  // CLOCK_MONOTONIC time at which the thread started waiting.
+  uint64_t start_nanos;
+  uint64_t wait_nanos;
+};
+
+struct ContentionProfile {
+  std::vector<LockContentionStats> sites;
+  // Contended acquisitions at sites which did not fit the site table.
+  uint64_t untracked_contentions;
+  uint64_t untracked_wait_nanos;
+  uint64_t untracked_spins;
+
+  uint64_t futex_waits;
+  uint64_t futex_wakes;
+
+  // Threads queued by ThreadManager::EnqueueThread, with the sum and maximum
+  // of the queue depths they observed.
+  uint64_t thread_enqueues;
+  uint64_t total_thread_queue_depth;
+  uint64_t max_thread_queue_depth;
+
+  // Most recent timed contended acquisitions, oldest first.
+  std::vector<ContentionEvent> events;
+};
+
+namespace internal {
+
+extern bool contention_profiling_enabled;
+
+}  // namespace internal
+
+// Starts or stops recording. Recorded data is kept until
+// ResetContentionProfile() is called.
+void EnableContentionProfiling(bool enabled);
+
+// Returns true if contention profiling is enabled.
+inline bool ContentionProfilingEnabled() {
+  return __atomic_load_n(&internal::contention_profiling_enabled,
+                         __ATOMIC_RELAXED);
+}
+
+// Measures a contended lock acquisition. Construct it once the uncontended
+// attempt to take |lock| failed and destroy it once the lock is held. By
+// default the call site is the return address of the enclosing function, which
+// is the caller of the lock function that creates the object. Reads the clock,
+// so it must not be used by locks which host calls may take.
+class ScopedLockWait {
+ public:
+  explicit ScopedLockWait(const void *lock,
+                          const void *caller = __builtin_return_address(0));
+  ~ScopedLockWait();
+
+  ScopedLockWait(const ScopedLockWait &other) = delete;
+  ScopedLockWait &operator=(const ScopedLockWait &other) = delete;
+
+ private:
+  const void *const lock_;
+  const void *const caller_;
+  // Start of the wait, or zero if the wait is not recorded.
+  uint64_t start_nanos_;
+};
+
+// Records a contended acquisition of |lock| from |caller| which polled |spins|
+// times before taking the lock. Never exits the enclave.
+void RecordSpinWait(const void *lock, const void *caller, uint64_t spins);
+
+// Counts a thread going to sleep on an untrusted wait queue.
+void RecordFutexWait();
+
+// Counts a wake up request on an untrusted wait queue.
+void RecordFutexWake();
+
+// Records that a thread was queued behind |depth| - 1 other threads waiting
+// for a thread donated by the host.
+void RecordThreadQueueDepth(size_t depth);
+
+// Returns the data recorded since the last reset. Allocates, so it must not be
+// called by a lock implementation.
+ContentionProfile GetContentionProfile();
+
+// Discards all recorded data. Must not run concurrently with recording.
+void ResetContentionProfile();
+
+// Formats the sites and events of |profile| in the Chrome trace event format
+// read by chrome://tracing and Perfetto. Each event becomes a complete event
+// on the track of its thread, and the per-site totals are attached as trace
+// metadata.
+std::string ContentionProfileToChromeTrace(const ContentionProfile &profile);
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_CORE_CONTENTION_PROFILER_H_
@@ -0,0 +1,317 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/core/cpu_profiler.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <sys/ucontext.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_split.h"
+#include "asylo/platform/core/atomic.h"
+#include "asylo/util/posix_error_space.h"
+
+// Function whose runtime address is recorded in profiles. It must not be
+// inlined or merged so that it keeps its own symbol.
+extern "C" __attribute__((noinline, used)) void AsyloCpuProfileAnchor() {
+  asm volatile("");
+}
+
+namespace asylo {
+namespace {
+
+// Number of table slots probed for a stack before it is counted as untracked.
+constexpr size_t kMaxStackProbes = 16;
+
+// Indices of the frame pointer and of the program counter in the general
+// registers of an x86-64 Linux signal context.
+constexpr int kFramePointerRegister = 10;
+constexpr int kProgramCounterRegister = 16;
+
+struct StackSlot {
+  // Hash of the frames, or zero if the slot is free.
+  uint64_t key;
+  uint64_t depth;
+  uint64_t frames[kMaxCpuProfileFrames];
+  uint64_t samples;
+};
+
+struct {
+  StackSlot stacks[kMaxCpuProfileStacks];
+  uint64_t untracked_samples;
+  uint64_t outside_samples;
+  uint64_t unattributed_samples;
+  uint64_t period_micros;
+} profile_state;
+
+bool (*is_trusted_memory)(const void *, size_t) = nullptr;
+
+uint64_t StackKey(const uint64_t *frames, size_t depth) {
+  uint64_t key = depth;
+  for (size_t i = 0; i < depth; ++i) {
+    key = (key ^ frames[i]) * 0x9e3779b97f4a7c15ull;
+    key ^= key >> 29;
+  }
+  // Zero marks free slots.
+  return key ? key : 1;
+}
+
+// Returns the slot of the given stack, claiming a free one if needed, or
+// nullptr if the table has no room for it.
+StackSlot *FindStack(const uint64_t *frames, size_t depth) {
+  const uint64_t key = StackKey(frames, depth);
+  for (size_t i = 0; i < kMaxStackProbes; ++i) {
+    StackSlot *slot = &profile_state.stacks[(key + i) % kMaxCpuProfileStacks];
+    uint64_t slot_key = __atomic_load_n(&slot->key, __ATOMIC_ACQUIRE);
+    if (slot_key == 0) {
+      if (AtomicCompareExchange(&slot->key, &slot_key, key, /*weak=*/false,
+                                std::memory_order_acq_rel,
+                                std::memory_order_acquire)) {
+        std::copy(frames, frames + depth, slot->frames);
+        AtomicStore(&slot->depth, static_cast<uint64_t>(depth),
+                    std::memory_order_release);
+        return slot;
+      }
+    }
+    if (slot_key == key) {
+      return slot;
+    }
+  }
+  return nullptr;
+}
+
+void HandleProfilingSignal(int signum, siginfo_t *info, void *ucontext) {
+  RecordCpuSample(ucontext);
+}
+
+Status SetProfilingTimer(int frequency_hz) {
+  struct itimerval timer = {};
+  if (frequency_hz > 0) {
+    const int period_micros = 1000000 / frequency_hz;
+    timer.it_interval.tv_sec = period_micros / 1000000;
+    timer.it_interval.tv_usec = period_micros % 1000000;
+    timer.it_value = timer.it_interval;
+  }
+  if (setitimer(ITIMER_PROF, &timer, nullptr) != 0) {
+    return Status(static_cast<error::PosixError>(errno),
+                  "Failed to set the profiling timer");
+  }
+  return Status::OkStatus();
+}
+
+// Returns the next whitespace-separated token of |text|, and removes it.
+absl::string_view NextToken(absl::string_view *text) {
+  size_t start = text->find_first_not_of(" \n");
+  if (start == absl::string_view::npos) {
+    *text = absl::string_view();
+    return absl::string_view();
+  }
+  text->remove_prefix(start);
+  size_t end = std::min(text->find_first_of(" \n"), text->size());
+  absl::string_view token = text->substr(0, end);
+  text->remove_prefix(end);
+  return token;
+}
+
+}  // namespace
+
+Status StartCpuProfiling(int frequency_hz,
+                         bool (*is_trusted)(const void *addr, size_t size)) {
+  if (frequency_hz <= 0 || frequency_hz > 1000000) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Profiling frequency must be between 1 and 1000000 Hz");
+  }
+  is_trusted_memory = is_trusted;
+  AtomicStore(&profile_state.period_micros,
+              static_cast<uint64_t>(1000000 / frequency_hz),
+              std::memory_order_relaxed);
+
+  struct sigaction action = {};
+  action.sa_sigaction = HandleProfilingSignal;
+  action.sa_flags = SA_SIGINFO | SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  if (sigaction(SIGPROF, &action, nullptr) != 0) {
+    return Status(static_cast<error::PosixError>(errno),
+                  "Failed to register the profiling signal handler");
+  }
+  return SetProfilingTimer(frequency_hz);
+}
+
+Status StopCpuProfiling() { return SetProfilingTimer(0); }
+
+void RecordCpuSample(const void *ucontext) {
+  if (!ucontext || !is_trusted_memory) {
+    AtomicIncrement(&profile_state.unattributed_samples,
+                    std::memory_order_relaxed);
+    return;
+  }
+  const greg_t *registers =
+      static_cast<const ucontext_t *>(ucontext)->uc_mcontext.gregs;
+  uint64_t pc = registers[kProgramCounterRegister];
+  if (!is_trusted_memory(reinterpret_cast<const void *>(pc), 1)) {
+    AtomicIncrement(&profile_state.outside_samples,
+                    std::memory_order_relaxed);
+    return;
+  }
+
+  // Each frame record holds the caller's frame pointer followed by the return
+  // address. Frames grow towards lower addresses, so a valid chain strictly
+  // increases, which bounds the walk even over a corrupted stack.
+  uint64_t frames[kMaxCpuProfileFrames];
+  size_t depth = 0;
+  frames[depth++] = pc;
+  uint64_t fp = registers[kFramePointerRegister];
+  while (depth < kMaxCpuProfileFrames && fp % sizeof(uint64_t) == 0 &&
+         is_trusted_memory(reinterpret_cast<const void *>(fp),
+                           2 * sizeof(uint64_t))) {
+    const uint64_t *record = reinterpret_cast<const uint64_t *>(fp);
+    uint64_t return_address = record[1];
+    if (!is_trusted_memory(reinterpret_cast<const void *>(return_address),
+                           1)) {
+      break;
+    }
+    frames[depth++] = return_address;
+    if (record[0] <= fp) {
+      break;
+    }
+    fp = record[0];
+  }
+
+  StackSlot *slot = FindStack(frames, depth);
+  if (slot) {
+    AtomicIncrement(&slot->samples, std::memory_order_relaxed);
+  } else {
+    AtomicIncrement(&profile_state.untracked_samples,
+                    std::memory_order_relaxed);
+  }
+}
+
+CpuProfile GetCpuProfile() {
+  CpuProfile profile;
+  profile.period_micros =
+      __atomic_load_n(&profile_state.period_micros, __ATOMIC_RELAXED);
+  profile.anchor_address = reinterpret_cast<uintptr_t>(&AsyloCpuProfileAnchor);
+  for (const StackSlot &slot : profile_state.stacks) {
+    // A claimed slot publishes its frames with its depth.
+    uint64_t depth = __atomic_load_n(&slot.depth, __ATOMIC_ACQUIRE);
+    uint64_t samples = __atomic_load_n(&slot.samples, __ATOMIC_RELAXED);
+    if (depth == 0 || samples == 0) {
+      continue;
+    }
+    profile.stacks.push_back(
+        {std::vector<uint64_t>(slot.frames, slot.frames + depth), samples});
+  }
+  std::sort(profile.stacks.begin(), profile.stacks.end(),
+            [](const CpuProfileStack &a, const CpuProfileStack &b) {
+              return a.samples > b.samples;
+            });
+  profile.untracked_samples =
+      __atomic_load_n(&profile_state.untracked_samples, __ATOMIC_RELAXED);
+  profile.outside_samples =
+      __atomic_load_n(&profile_state.outside_samples, __ATOMIC_RELAXED);
+  profile.unattributed_samples =
+      __atomic_load_n(&profile_state.unattributed_samples, __ATOMIC_RELAXED);
+  return profile;
+}
+
+void ResetCpuProfile() {
+  uint64_t period_micros = profile_state.period_micros;
+  profile_state = {};
+  profile_state.period_micros = period_micros;
+}
+
+std::string EncodeCpuProfile(const CpuProfile &profile) {
+  std::string encoded;
+  char buffer[32];
+  auto append_number = [&encoded, &buffer](uint64_t value) {
+    snprintf(buffer, sizeof(buffer), " %" PRIu64, value);
+    encoded += buffer;
+  };
+  encoded += "asylo_cpu_profile";
+  for (uint64_t value :
+       {profile.period_micros, profile.anchor_address,
+        profile.untracked_samples, profile.outside_samples,
+        profile.unattributed_samples}) {
+    append_number(value);
+  }
+  encoded += "\n";
+  for (const CpuProfileStack &stack : profile.stacks) {
+    encoded += "stack";
+    append_number(stack.samples);
+    for (uint64_t frame : stack.frames) {
+      append_number(frame);
+    }
+    encoded += "\n";
+  }
+  return encoded;
+}
+
+StatusOr<CpuProfile> DecodeCpuProfile(absl::string_view encoded) {
+  const Status malformed(error::GoogleError::INVALID_ARGUMENT,
+                         "Malformed CPU profile");
+  std::vector<absl::string_view> lines =
+      absl::StrSplit(encoded, '\n', absl::SkipEmpty());
+  if (lines.empty()) {
+    return malformed;
+  }
+
+  CpuProfile profile;
+  absl::string_view header = lines[0];
+  if (NextToken(&header) != "asylo_cpu_profile") {
+    return malformed;
+  }
+  for (uint64_t *value :
+       {&profile.period_micros, &profile.anchor_address,
+        &profile.untracked_samples, &profile.outside_samples,
+        &profile.unattributed_samples}) {
+    if (!absl::SimpleAtoi(NextToken(&header), value)) {
+      return malformed;
+    }
+  }
+
+  for (size_t i = 1; i < lines.size(); ++i) {
+    absl::string_view line = lines[i];
+    CpuProfileStack stack;
+    if (NextToken(&line) != "stack" ||
+        !absl::SimpleAtoi(NextToken(&line), &stack.samples)) {
+      return malformed;
+    }
+    for (absl::string_view token = NextToken(&line); !token.empty();
+         token = NextToken(&line)) {
+      uint64_t frame;
+      if (!absl::SimpleAtoi(token, &frame)) {
+        return malformed;
+      }
+      stack.frames.push_back(frame);
+    }
+    if (stack.frames.empty()) {
+      return malformed;
+    }
+    profile.stacks.push_back(std::move(stack));
+  }
+  return profile;
+}
+
+}  // namespace asylo
@@ -0,0 +1,115 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_CORE_CPU_PROFILER_H_
+#define ASYLO_PLATFORM_CORE_CPU_PROFILER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "asylo/util/status.h"
+#include "asylo/util/statusor.h"
+
+namespace asylo {
+
+// Opt-in sampling CPU profiler for enclave code. While it runs, an
+// ITIMER_PROF timer raises SIGPROF, whose handler is registered with the
+// enclave's SignalManager. The handler records the program counter of the
+// interrupted code and the return addresses found by following its frame
+// pointers, so enclaves are best built with -fno-omit-frame-pointer.
+//
+// The handler only sees the interrupted context when the signal is delivered
+// on the interrupted thread, as in simulation mode. Signals entering the
+// enclave through EnterAndHandleSignal() carry no context, since the state of
+// the interrupted thread stays in its SSA, and are counted as unattributed.
+//
+// Recording takes no locks and does not allocate. Samples are aggregated by
+// call stack in a fixed-size static table; stacks which do not fit are only
+// counted in aggregate. Program counters are runtime addresses; the profile
+// carries the runtime address of the anchor function below, from which a
+// host-side symbolizer derives the load address of the enclave image.
+
+// Number of distinct call stacks tracked individually.
+constexpr size_t kMaxCpuProfileStacks = 1024;
+
+// Number of frames kept for each sample, starting from the interrupted one.
+constexpr size_t kMaxCpuProfileFrames = 32;
+
+// Name of the function whose runtime address anchors the program counters of
+// a profile.
+constexpr char kCpuProfileAnchorSymbol[] = "AsyloCpuProfileAnchor";
+
+// Samples which share a call stack.
+struct CpuProfileStack {
+  // Program counter of the interrupted code followed by the return addresses
+  // of its callers.
+  std::vector<uint64_t> frames;
+  uint64_t samples;
+};
+
+struct CpuProfile {
+  // Time between two samples of a busy thread.
+  uint64_t period_micros;
+  // Runtime address of kCpuProfileAnchorSymbol.
+  uint64_t anchor_address;
+  std::vector<CpuProfileStack> stacks;
+  // Samples whose stacks did not fit the stack table.
+  uint64_t untracked_samples;
+  // Samples of threads interrupted outside the enclave.
+  uint64_t outside_samples;
+  // Samples delivered without the interrupted context.
+  uint64_t unattributed_samples;
+};
+
+// Starts sampling the CPU time of the process |frequency_hz| times per
+// second. |is_trusted| decides whether a range of memory belongs to the
+// enclave: samples of code outside of it are only counted, and frame pointers
+// are only followed into it. Recorded data is kept until ResetCpuProfile() is
+// called.
+Status StartCpuProfiling(int frequency_hz,
+                         bool (*is_trusted)(const void *addr, size_t size));
+
+// Stops the timer started by StartCpuProfiling(). Signals already raised may
+// still be recorded.
+Status StopCpuProfiling();
+
+// Records a sample of the code interrupted with the register context
+// |ucontext|, which may be null. Called by the SIGPROF handler, and exposed
+// for tests.
+void RecordCpuSample(const void *ucontext);
+
+// Returns the data recorded since the last reset, busiest stacks first.
+// Allocates, so it must not be called from a signal handler.
+CpuProfile GetCpuProfile();
+
+// Discards all recorded data. Must not run concurrently with recording.
+void ResetCpuProfile();
+
+// Encodes |profile| as text, to be written out of the enclave and decoded by
+// DecodeCpuProfile() on the host.
+std::string EncodeCpuProfile(const CpuProfile &profile);
+
+// Decodes a profile encoded by EncodeCpuProfile().
+StatusOr<CpuProfile> DecodeCpuProfile(absl::string_view encoded);
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_CORE_CPU_PROFILER_H_
@@ -22,7 +22,9 @@
 #include <sys/ucontext.h>
 #include <time.h>
 
+#include <memory>
 #include <thread>
+#include <utility>
 
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
@@ -30,13 +32,16 @@
 #include "asylo/util/logging.h"
 #include "asylo/platform/common/time_util.h"
 #include "asylo/platform/core/generic_enclave_client.h"
+#include "asylo/platform/core/load_phase_timer.h"
 #include "asylo/platform/primitives/enclave_loader.h"
 #include "asylo/platform/primitives/extent.h"
 #include "asylo/platform/primitives/sgx/loader.pb.h"
 #include "asylo/platform/primitives/sgx/untrusted_sgx.h"
+#include "asylo/util/cleanup.h"
 #include "asylo/util/status.h"
 #include "asylo/util/status_macros.h"
 #include "asylo/util/statusor.h"
+#include "asylo/util/thread.h"
 
 namespace asylo {
 namespace {
@@ -113,17 +118,33 @@ Status EnclaveManager::DestroyEnclave(EnclaveClient *client,
   client_by_name_.erase(name);
   name_by_client_.erase(client);
   load_config_by_client_.erase(client);
+  PublishClientSnapshot();
 
   return finalize_status;
 }
 
 EnclaveClient *EnclaveManager::GetClient(absl::string_view name) const {
-  absl::ReaderMutexLock lock(&client_table_lock_);
-  auto it = client_by_name_.find(name);
-  if (it == client_by_name_.end()) {
+  // Each thread keeps the last snapshot it read, and only goes through the
+  // table lock again once an enclave has been loaded or destroyed since.
+  thread_local const EnclaveManager *cached_manager = nullptr;
+  thread_local uint64_t cached_generation = 0;
+  thread_local std::shared_ptr<const ClientSnapshot> cached_snapshot;
+
+  uint64_t generation =
+      client_snapshot_generation_.load(std::memory_order_acquire);
+  if (cached_manager != this || cached_generation != generation) {
+    absl::ReaderMutexLock lock(&client_table_lock_);
+    cached_snapshot = client_snapshot_;
+    cached_generation =
+        client_snapshot_generation_.load(std::memory_order_relaxed);
+    cached_manager = this;
+  }
+
+  auto it = cached_snapshot->find(name);
+  if (it == cached_snapshot->end()) {
     return nullptr;
   } else {
-    return it->second.get();
+    return it->second;
   }
 }
 
@@ -225,16 +246,13 @@ Status EnclaveManager::LoadFakeEnclave(absl::string_view name,
                                        const EnclaveConfig &config,
                                        void *base_address,
                                        const size_t enclave_size) {
-  // Check whether a client with this name already exists.
-  {
-    absl::ReaderMutexLock lock(&client_table_lock_);
-    if (client_by_name_.find(name) != client_by_name_.end()) {
-      Status status(error::GoogleError::ALREADY_EXISTS,
-                    absl::StrCat("Name already exists: ", name));
-      LOG(ERROR) << "LoadEnclave failed: " << status;
-      return status;
-    }
+  // Claim the name, so that a concurrent load of the same name fails.
+  Status reserve_status = ReserveName(name);
+  if (!reserve_status.ok()) {
+    LOG(ERROR) << "LoadEnclave failed: " << reserve_status;
+    return reserve_status;
   }
+  Cleanup release_name([this, &name] { ReleaseName(name); });
 
   // Attempt to load the enclave.
   StatusOr<std::unique_ptr<EnclaveClient>> result =
@@ -248,8 +266,11 @@ Status EnclaveManager::LoadFakeEnclave(absl::string_view name,
   EnclaveClient *client = result.ValueOrDie().get();
   {
     absl::WriterMutexLock lock(&client_table_lock_);
+    loading_names_.erase(name);
+    release_name.release();
     client_by_name_.emplace(name, std::move(result).ValueOrDie());
     name_by_client_.emplace(client, name);
+    PublishClientSnapshot();
   }
 
   Status status = client->EnterAndInitialize(config);
@@ -265,12 +286,21 @@ Status EnclaveManager::LoadFakeEnclave(absl::string_view name,
       absl::WriterMutexLock lock(&client_table_lock_);
       client_by_name_.erase(name);
       name_by_client_.erase(client);
+      PublishClientSnapshot();
     }
   }
   return status;
 }
 
 Status EnclaveManager::LoadEnclave(const EnclaveLoadConfig &load_config) {
+  return LoadEnclave(load_config, /*report=*/nullptr);
+}
+
+Status EnclaveManager::LoadEnclave(const EnclaveLoadConfig &load_config,
+                                   EnclaveLoadReport *report) {
+  EnclaveLoadReport load_report;
+  LoadPhaseTimer timer(&load_report);
+
   EnclaveConfig config;
   if (load_config.has_config()) {
     config = load_config.config();
@@ -297,33 +327,35 @@ Status EnclaveManager::LoadEnclave(const EnclaveLoadConfig &load_config) {
     // that points to the enclave in the parent process.
     RemoveEnclaveReference(name);
   }
-  // Check whether a client with this name already exists.
-  {
-    absl::ReaderMutexLock lock(&client_table_lock_);
-    if (client_by_name_.find(name) != client_by_name_.end()) {
-      Status status(error::GoogleError::ALREADY_EXISTS,
-                    absl::StrCat("Name already exists: ", name));
-      LOG(ERROR) << "LoadEnclave failed: " << status;
-      return status;
-    }
+  // Claim the name, so that a concurrent load of the same name fails.
+  Status reserve_status = ReserveName(name);
+  if (!reserve_status.ok()) {
+    LOG(ERROR) << "LoadEnclave failed: " << reserve_status;
+    return reserve_status;
   }
+  Cleanup release_name([this, &name] { ReleaseName(name); });
   std::shared_ptr<primitives::Client> primitive_client;
   ASYLO_ASSIGN_OR_RETURN(primitive_client,
                          asylo::primitives::LoadEnclave(load_config));
 
-  StatusOr<std::unique_ptr<EnclaveClient>> result =
+  StatusOr<std::unique_ptr<GenericEnclaveClient>> result =
       GenericEnclaveClient::Create(name, primitive_client);
   if (!result.ok()) {
     LOG(ERROR) << "LoadEnclave failed: " << result.status();
     return result.status();
   }
+  timer.EndPhase("backend_load");
 
   // Add the client to the lookup tables.
-  EnclaveClient *client = result.ValueOrDie().get();
+  GenericEnclaveClient *generic_client = result.ValueOrDie().get();
+  EnclaveClient *client = generic_client;
   {
     absl::WriterMutexLock lock(&client_table_lock_);
+    loading_names_.erase(name);
+    release_name.release();
     client_by_name_.emplace(name, std::move(result).ValueOrDie());
     name_by_client_.emplace(client, name);
+    PublishClientSnapshot();
 
     if (config.enable_fork()) {
       load_config_by_client_.emplace(client, load_config);
@@ -344,16 +376,78 @@ Status EnclaveManager::LoadEnclave(const EnclaveLoadConfig &load_config) {
       client_by_name_.erase(name);
       name_by_client_.erase(client);
       load_config_by_client_.erase(client);
+      PublishClientSnapshot();
     }
+    return status;
+  }
+
+  timer.AppendPhases(generic_client->trusted_load_report());
+  timer.Finish();
+  VLOG(1) << "Loaded enclave " << name << ": "
+          << load_report.ShortDebugString();
+  if (report) {
+    *report = std::move(load_report);
   }
   return status;
 }
 
+std::vector<Status> EnclaveManager::LoadEnclaves(
+    const std::vector<EnclaveLoadConfig> &load_configs) {
+  std::vector<Status> statuses(load_configs.size());
+
+  // A name given twice in the batch only loads its first enclave, regardless
+  // of which load would win the race for the name.
+  absl::flat_hash_set<std::string> batch_names;
+  std::vector<Thread> threads;
+  threads.reserve(load_configs.size());
+  for (size_t i = 0; i < load_configs.size(); ++i) {
+    if (!batch_names.insert(load_configs[i].name()).second) {
+      statuses[i] = Status(error::GoogleError::ALREADY_EXISTS,
+                           absl::StrCat("Name given twice in one batch: ",
+                                        load_configs[i].name()));
+      continue;
+    }
+    threads.emplace_back([this, &load_configs, &statuses, i] {
+      statuses[i] = LoadEnclave(load_configs[i]);
+    });
+  }
+  for (Thread &thread : threads) {
+    thread.Join();
+  }
+  return statuses;
+}
+
+Status EnclaveManager::ReserveName(absl::string_view name) {
+  absl::WriterMutexLock lock(&client_table_lock_);
+  if (client_by_name_.contains(name) || loading_names_.contains(name)) {
+    return Status(error::GoogleError::ALREADY_EXISTS,
+                  absl::StrCat("Name already exists: ", name));
+  }
+  loading_names_.emplace(name);
+  return Status::OkStatus();
+}
+
+void EnclaveManager::ReleaseName(absl::string_view name) {
+  absl::WriterMutexLock lock(&client_table_lock_);
+  loading_names_.erase(name);
+}
+
 void EnclaveManager::RemoveEnclaveReference(absl::string_view name) {
   absl::WriterMutexLock lock(&client_table_lock_);
   EnclaveClient *client = client_by_name_[name].get();
   client_by_name_.erase(name);
   name_by_client_.erase(client);
+  PublishClientSnapshot();
+}
+
+void EnclaveManager::PublishClientSnapshot() {
+  auto snapshot = std::make_shared<ClientSnapshot>();
+  snapshot->reserve(client_by_name_.size());
+  for (const auto &entry : client_by_name_) {
+    snapshot->emplace(entry.first, entry.second.get());
+  }
+  client_snapshot_ = std::move(snapshot);
+  client_snapshot_generation_.fetch_add(1, std::memory_order_release);
 }
 
 primitives::Client *LoadEnclaveInChildProcess(absl::string_view enclave_name,
@@ -22,10 +22,15 @@
 // Declares the enclave client API, providing types and methods for loading,
 // accessing, and finalizing enclaves.
 
+#include <atomic>
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/memory/memory.h"
 #include "absl/strings/string_view.h"
 #include "absl/synchronization/mutex.h"
@@ -112,6 +117,36 @@ class EnclaveManager {
   /// \param load_config Backend configuration options to load an enclave
   Status LoadEnclave(const EnclaveLoadConfig &load_config);
 
+  /// Loads an enclave, and reports how long each phase of loading and
+  /// initializing it took.
+  ///
+  /// Behaves as LoadEnclave(const EnclaveLoadConfig &load_config). The same
+  /// report is also logged at verbosity level 1.
+  ///
+  /// \param load_config Backend configuration options to load an enclave
+  /// \param report Set to the timing of the load if the enclave was loaded.
+  ///               May be nullptr.
+  Status LoadEnclave(const EnclaveLoadConfig &load_config,
+                     EnclaveLoadReport *report);
+
+  /// Loads several enclaves concurrently.
+  ///
+  /// Each enclave is loaded and initialized as by
+  /// LoadEnclave(const EnclaveLoadConfig &), on its own thread, so that the
+  /// slow backend loads and initializations overlap. The call returns once
+  /// every load has finished. A failure to load one enclave does not affect
+  /// the others.
+  ///
+  /// It is an error to specify a name which is already bound to an enclave, or
+  /// to specify the same name twice in |load_configs|; in the latter case only
+  /// the first enclave with that name is loaded.
+  ///
+  /// \param load_configs Backend configuration options of the enclaves to
+  ///                     load.
+  /// \return The status of each load, in the order of |load_configs|.
+  std::vector<Status> LoadEnclaves(
+      const std::vector<EnclaveLoadConfig> &load_configs);
+
   /// Loads an enclave.
   ///
   /// Loads a new enclave with default enclave config settings and binds it to a
@@ -235,6 +270,19 @@ class EnclaveManager {
                          const size_t enclave_size = 0)
       ABSL_LOCKS_EXCLUDED(client_table_lock_);
 
+  // Claims |name| for an enclave about to be loaded. Fails if an enclave is
+  // already bound to |name|, or is being loaded under it.
+  Status ReserveName(absl::string_view name)
+      ABSL_LOCKS_EXCLUDED(client_table_lock_);
+
+  // Gives up a name claimed by ReserveName() for a load that failed.
+  void ReleaseName(absl::string_view name)
+      ABSL_LOCKS_EXCLUDED(client_table_lock_);
+
+  // Publishes the current |client_by_name_| table to GetClient().
+  void PublishClientSnapshot()
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(client_table_lock_);
+
   // Deletes an enclave client reference that points to an enclave that no
   // longer exists. This should only happen during fork.
   void RemoveEnclaveReference(absl::string_view name)
@@ -249,8 +297,8 @@ class EnclaveManager {
   // Value synchronized to CLOCK_REALTIME by the worker loop.
   std::atomic<int64_t> clock_realtime_;
 
-  // A mutex guarding |client_by_name_|, |name_by_client_|, and
-  // |loader_by_client_| tables.
+  // A mutex guarding |client_by_name_|, |name_by_client_|,
+  // |load_config_by_client_|, and |loading_names_| tables.
   mutable absl::Mutex client_table_lock_;
 
   absl::flat_hash_map<std::string, std::unique_ptr<EnclaveClient>>
@@ -261,6 +309,22 @@ class EnclaveManager {
   absl::flat_hash_map<const EnclaveClient *, EnclaveLoadConfig>
       load_config_by_client_ ABSL_GUARDED_BY(client_table_lock_);
 
+  // Names of the enclaves being loaded, which are not yet in
+  // |client_by_name_|. The table lock is only held while a name is claimed or
+  // registered, so that loads of different enclaves run concurrently.
+  absl::flat_hash_set<std::string> loading_names_
+      ABSL_GUARDED_BY(client_table_lock_);
+
+  // An immutable copy of |client_by_name_| read by GetClient(), so that
+  // lookups by name need not take |client_table_lock_|. It is replaced, and
+  // |client_snapshot_generation_| incremented, every time |client_by_name_|
+  // changes.
+  using ClientSnapshot = absl::flat_hash_map<std::string, EnclaveClient *>;
+  std::shared_ptr<const ClientSnapshot> client_snapshot_
+      ABSL_GUARDED_BY(client_table_lock_) =
+          std::make_shared<const ClientSnapshot>();
+  std::atomic<uint64_t> client_snapshot_generation_{0};
+
   // Mutex guarding the static state of this class.
   static absl::Mutex mu_;
 
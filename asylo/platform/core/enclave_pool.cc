@@ -0,0 +1,153 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/core/enclave_pool.h"
+
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "asylo/util/logging.h"
+#include "asylo/util/status_macros.h"
+
+namespace asylo {
+
+StatusOr<std::unique_ptr<EnclavePool>> EnclavePool::Create(
+    EnclaveManager *manager, EnclaveLoadConfig load_config, size_t size) {
+  if (manager == nullptr) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "EnclavePool requires an EnclaveManager");
+  }
+  if (load_config.name().empty()) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "EnclavePool requires a named EnclaveLoadConfig");
+  }
+  if (size == 0) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "EnclavePool size must be positive");
+  }
+
+  auto pool = absl::WrapUnique(
+      new EnclavePool(manager, std::move(load_config), size));
+  pool->refill_thread_ =
+      absl::make_unique<Thread>([pool = pool.get()] { pool->Refill(); });
+  return std::move(pool);
+}
+
+EnclavePool::EnclavePool(EnclaveManager *manager,
+                         EnclaveLoadConfig load_config, size_t size)
+    : manager_(manager), load_config_(std::move(load_config)), size_(size) {}
+
+EnclavePool::~EnclavePool() {
+  {
+    absl::MutexLock lock(&mu_);
+    stopping_ = true;
+  }
+  refill_thread_->Join();
+
+  // The background thread has exited, so |idle_| can no longer change.
+  std::deque<EnclaveClient *> idle;
+  {
+    absl::MutexLock lock(&mu_);
+    idle.swap(idle_);
+  }
+  for (EnclaveClient *client : idle) {
+    Status status = manager_->DestroyEnclave(client, EnclaveFinal());
+    if (!status.ok()) {
+      LOG(ERROR) << "Failed to destroy idle pooled enclave: " << status;
+    }
+  }
+}
+
+StatusOr<EnclaveClient *> EnclavePool::Acquire() {
+  {
+    absl::MutexLock lock(&mu_);
+
+    // Taking an enclave from the pool, or finding it empty, is a reason to
+    // retry a background load that failed earlier.
+    refill_status_ = Status::OkStatus();
+    if (!idle_.empty()) {
+      EnclaveClient *client = idle_.front();
+      idle_.pop_front();
+      return client;
+    }
+  }
+  return LoadOne();
+}
+
+size_t EnclavePool::IdleCount() const {
+  absl::MutexLock lock(&mu_);
+  return idle_.size();
+}
+
+Status EnclavePool::WaitUntilFull() {
+  absl::MutexLock lock(&mu_);
+  mu_.Await(absl::Condition(this, &EnclavePool::FullOrStalled));
+  return refill_status_;
+}
+
+StatusOr<EnclaveClient *> EnclavePool::LoadOne() {
+  EnclaveLoadConfig load_config = load_config_;
+  {
+    absl::MutexLock lock(&mu_);
+    load_config.set_name(absl::StrCat(load_config_.name(), "#", next_id_++));
+  }
+  ASYLO_RETURN_IF_ERROR(manager_->LoadEnclave(load_config));
+  EnclaveClient *client = manager_->GetClient(load_config.name());
+  if (client == nullptr) {
+    return Status(error::GoogleError::INTERNAL,
+                  absl::StrCat("Loaded enclave ", load_config.name(),
+                               " is not registered"));
+  }
+  return client;
+}
+
+void EnclavePool::Refill() {
+  while (true) {
+    {
+      absl::MutexLock lock(&mu_);
+      mu_.Await(absl::Condition(this, &EnclavePool::RefillNeeded));
+      if (stopping_) {
+        return;
+      }
+    }
+
+    // Load without holding |mu_| so that Acquire() is never blocked behind an
+    // enclave initialization.
+    StatusOr<EnclaveClient *> client_result = LoadOne();
+
+    absl::MutexLock lock(&mu_);
+    if (!client_result.ok()) {
+      LOG(WARNING) << "Failed to refill enclave pool for "
+                   << load_config_.name() << ": " << client_result.status();
+      refill_status_ = client_result.status();
+      continue;
+    }
+    idle_.push_back(client_result.ValueOrDie());
+  }
+}
+
+bool EnclavePool::RefillNeeded() const {
+  return stopping_ || (refill_status_.ok() && idle_.size() < size_);
+}
+
+bool EnclavePool::FullOrStalled() const {
+  return stopping_ || !refill_status_.ok() || idle_.size() >= size_;
+}
+
+}  // namespace asylo
@@ -0,0 +1,128 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_CORE_ENCLAVE_POOL_H_
+#define ASYLO_PLATFORM_CORE_ENCLAVE_POOL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+
+#include "absl/synchronization/mutex.h"
+#include "asylo/enclave.pb.h"
+#include "asylo/platform/core/enclave_client.h"
+#include "asylo/platform/core/enclave_manager.h"
+#include "asylo/util/status.h"
+#include "asylo/util/statusor.h"
+#include "asylo/util/thread.h"
+
+namespace asylo {
+
+/// A pool of initialized enclaves that are loaded ahead of time from a single
+/// `EnclaveLoadConfig`.
+///
+/// Loading and initializing an enclave can take a long time, which is paid by
+/// whoever asks for a new enclave instance. An `EnclavePool` moves that cost
+/// off the request path: it keeps up to a fixed number of idle enclaves and
+/// refills itself on a background thread every time one is handed out.
+///
+/// Every enclave in the pool is loaded with the same configuration, and is
+/// registered with the `EnclaveManager` under the configured name followed by
+/// `#` and a unique number. Enclaves handed out by `Acquire()` belong to the
+/// caller, who destroys them with `EnclaveManager::DestroyEnclave()` as usual.
+/// Idle enclaves are destroyed with the pool.
+///
+/// If the background thread fails to load an enclave, it stops refilling the
+/// pool until the next call to `Acquire()`, so that a persistent failure does
+/// not spin. `EnclavePool` is thread-safe.
+class EnclavePool {
+ public:
+  /// Creates a pool that keeps up to `size` idle enclaves loaded from
+  /// `load_config` through `manager`. The pool starts filling in the
+  /// background immediately.
+  ///
+  /// \param manager The manager to load enclaves with. It must outlive the
+  ///                pool.
+  /// \param load_config The configuration of every enclave in the pool. Its
+  ///                    name must not be empty.
+  /// \param size The number of idle enclaves to keep. Must be positive.
+  /// \return The new pool, or an error if the arguments are invalid.
+  static StatusOr<std::unique_ptr<EnclavePool>> Create(
+      EnclaveManager *manager, EnclaveLoadConfig load_config, size_t size);
+
+  EnclavePool(const EnclavePool &other) = delete;
+  EnclavePool &operator=(const EnclavePool &other) = delete;
+
+  /// Stops refilling the pool and destroys every idle enclave.
+  ~EnclavePool();
+
+  /// Hands out an enclave. If the pool has an idle enclave, it is returned
+  /// immediately. Otherwise, a new enclave is loaded on the calling thread.
+  /// In either case, the pool is then refilled in the background.
+  ///
+  /// \return A client for an initialized enclave that now belongs to the
+  ///         caller, or the error from loading a new enclave.
+  StatusOr<EnclaveClient *> Acquire() ABSL_LOCKS_EXCLUDED(mu_);
+
+  /// Returns the number of idle enclaves currently in the pool.
+  size_t IdleCount() const ABSL_LOCKS_EXCLUDED(mu_);
+
+  /// Blocks until the pool is full or the background thread fails to load an
+  /// enclave.
+  ///
+  /// \return An OK status if the pool is full, or the error that stopped the
+  ///         pool from being refilled.
+  Status WaitUntilFull() ABSL_LOCKS_EXCLUDED(mu_);
+
+ private:
+  EnclavePool(EnclaveManager *manager, EnclaveLoadConfig load_config,
+              size_t size);
+
+  // Loads one enclave under a fresh name and returns its client.
+  StatusOr<EnclaveClient *> LoadOne() ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Body of the background thread that keeps the pool full.
+  void Refill() ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns true if the background thread has work to do or must exit.
+  bool RefillNeeded() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Returns true if WaitUntilFull() can return.
+  bool FullOrStalled() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  EnclaveManager *const manager_;
+  const EnclaveLoadConfig load_config_;
+  const size_t size_;
+
+  mutable absl::Mutex mu_;
+  std::deque<EnclaveClient *> idle_ ABSL_GUARDED_BY(mu_);
+  uint64_t next_id_ ABSL_GUARDED_BY(mu_) = 0;
+
+  // The error from the last background load, if it failed. Refilling is paused
+  // while this is not OK.
+  Status refill_status_ ABSL_GUARDED_BY(mu_);
+  bool stopping_ ABSL_GUARDED_BY(mu_) = false;
+
+  std::unique_ptr<Thread> refill_thread_;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_CORE_ENCLAVE_POOL_H_
@@ -0,0 +1,118 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/core/entry_arena.h"
+
+#include <memory>
+#include <utility>
+
+#include "absl/base/attributes.h"
+#include "absl/memory/memory.h"
+#include "asylo/platform/core/memory_monitor.h"
+
+namespace asylo {
+namespace {
+
+// Size of the block each pooled arena keeps across entries.
+constexpr size_t kEntryArenaBlockSize = 16 * 1024;
+
+// Number of arenas kept between entries, which bounds the memory held by idle
+// arenas to kEntryArenaBlockSize * kMaxIdleEntryArenas.
+constexpr size_t kMaxIdleEntryArenas = 16;
+
+ABSL_CONST_INIT thread_local google::protobuf::Arena *current_entry_arena =
+    nullptr;
+
+google::protobuf::ArenaOptions BlockArenaOptions(char *block,
+                                                 size_t block_size) {
+  google::protobuf::ArenaOptions options;
+  options.initial_block = block;
+  options.initial_block_size = block_size;
+  return options;
+}
+
+}  // namespace
+
+EntryArenaPool *EntryArenaPool::GetInstance() {
+  static EntryArenaPool *const pool = [] {
+    auto pool = new EntryArenaPool(kEntryArenaBlockSize, kMaxIdleEntryArenas);
+    MemoryMonitor::GetInstance()->Register(
+        "entry_arenas", [pool] { return pool->IdleBytes(); },
+        [pool](MemoryPressure pressure) { return pool->ReleaseIdle(); });
+    return pool;
+  }();
+  return pool;
+}
+
+EntryArenaPool::EntryArenaPool(size_t block_size, size_t max_idle_arenas)
+    : block_size_(block_size), max_idle_arenas_(max_idle_arenas) {}
+
+EntryArenaPool::PooledArena::PooledArena(std::unique_ptr<char[]> block,
+                                         size_t block_size)
+    : block(std::move(block)),
+      arena(BlockArenaOptions(this->block.get(), block_size)) {}
+
+size_t EntryArenaPool::IdleBytes() {
+  absl::MutexLock lock(&mu_);
+  return idle_arenas_.size() * block_size_;
+}
+
+size_t EntryArenaPool::ReleaseIdle() {
+  std::vector<std::unique_ptr<PooledArena>> released;
+  {
+    absl::MutexLock lock(&mu_);
+    released.swap(idle_arenas_);
+  }
+  return released.size() * block_size_;
+}
+
+std::unique_ptr<EntryArenaPool::PooledArena> EntryArenaPool::Acquire() {
+  {
+    absl::MutexLock lock(&mu_);
+    if (!idle_arenas_.empty()) {
+      std::unique_ptr<PooledArena> arena = std::move(idle_arenas_.back());
+      idle_arenas_.pop_back();
+      return arena;
+    }
+  }
+  return absl::make_unique<PooledArena>(
+      std::unique_ptr<char[]>(new char[block_size_]), block_size_);
+}
+
+void EntryArenaPool::Release(std::unique_ptr<PooledArena> arena) {
+  // Frees every block but the initial one.
+  arena->arena.Reset();
+  absl::MutexLock lock(&mu_);
+  if (idle_arenas_.size() < max_idle_arenas_) {
+    idle_arenas_.push_back(std::move(arena));
+  }
+}
+
+ScopedEntryArena::ScopedEntryArena(EntryArenaPool *pool)
+    : pool_(pool), arena_(pool->Acquire()), previous_(current_entry_arena) {
+  current_entry_arena = &arena_->arena;
+}
+
+ScopedEntryArena::~ScopedEntryArena() {
+  current_entry_arena = previous_;
+  pool_->Release(std::move(arena_));
+}
+
+google::protobuf::Arena *GetEntryArena() { return current_entry_arena; }
+
+}  // namespace asylo
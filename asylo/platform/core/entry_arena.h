@@ -0,0 +1,111 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_CORE_ENTRY_ARENA_H_
+#define ASYLO_PLATFORM_CORE_ENTRY_ARENA_H_
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include <google/protobuf/arena.h>
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+
+namespace asylo {
+
+// A pool of protobuf arenas for the messages parsed and built while handling an
+// enclave entry. Each arena starts with a block of its own that survives
+// resets, so a pooled arena serves the small messages of a typical entry
+// without touching the trusted heap. This avoids fragmenting the heap with
+// short-lived allocations and contending on its lock.
+//
+// This class is thread-safe.
+class EntryArenaPool {
+ public:
+  // Returns the pool used by the enclave entry points. Its idle arenas are
+  // released when the trusted heap is under pressure.
+  static EntryArenaPool *GetInstance();
+
+  // Creates a pool of arenas with initial blocks of |block_size| bytes that
+  // keeps at most |max_idle_arenas| arenas between entries.
+  EntryArenaPool(size_t block_size, size_t max_idle_arenas);
+
+  EntryArenaPool(const EntryArenaPool &other) = delete;
+  EntryArenaPool &operator=(const EntryArenaPool &other) = delete;
+
+  // Returns the number of bytes held by idle arenas.
+  size_t IdleBytes() ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Frees all idle arenas and returns the number of bytes released.
+  size_t ReleaseIdle() ABSL_LOCKS_EXCLUDED(mu_);
+
+ private:
+  friend class ScopedEntryArena;
+
+  struct PooledArena {
+    PooledArena(std::unique_ptr<char[]> block, size_t block_size);
+
+    std::unique_ptr<char[]> block;
+    google::protobuf::Arena arena;
+  };
+
+  // Takes an idle arena, or creates one if none is idle.
+  std::unique_ptr<PooledArena> Acquire() ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Resets |arena| and returns it to the idle arenas.
+  void Release(std::unique_ptr<PooledArena> arena) ABSL_LOCKS_EXCLUDED(mu_);
+
+  const size_t block_size_;
+  const size_t max_idle_arenas_;
+
+  absl::Mutex mu_;
+  std::vector<std::unique_ptr<PooledArena>> idle_arenas_ ABSL_GUARDED_BY(mu_);
+};
+
+// Provides an arena from an EntryArenaPool for the lifetime of the object, and
+// makes it the arena returned by GetEntryArena() on the calling thread. All
+// messages created on the arena are freed when the object is destroyed. Scopes
+// may nest, for instance when an enclave entry is made while the enclave is
+// waiting for a host call; each then has its own arena.
+class ScopedEntryArena {
+ public:
+  ScopedEntryArena() : ScopedEntryArena(EntryArenaPool::GetInstance()) {}
+  explicit ScopedEntryArena(EntryArenaPool *pool);
+  ~ScopedEntryArena();
+
+  ScopedEntryArena(const ScopedEntryArena &other) = delete;
+  ScopedEntryArena &operator=(const ScopedEntryArena &other) = delete;
+
+  google::protobuf::Arena *get() const { return &arena_->arena; }
+
+ private:
+  EntryArenaPool *const pool_;
+  std::unique_ptr<EntryArenaPool::PooledArena> arena_;
+  google::protobuf::Arena *const previous_;
+};
+
+// Returns the arena of the innermost ScopedEntryArena on the calling thread, or
+// nullptr if there is none. Code running on behalf of an enclave entry may
+// create the messages it only needs until the entry returns on this arena,
+// with google::protobuf::Arena::CreateMessage().
+google::protobuf::Arena *GetEntryArena();
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_CORE_ENTRY_ARENA_H_
@@ -20,14 +20,18 @@
 
 #include <cstddef>
 #include <memory>
+#include <string>
 
 #include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
 #include "asylo/enclave.pb.h"  // IWYU pragma: export
 #include "asylo/platform/core/entry_selectors.h"
 #include "asylo/platform/host_call/untrusted/host_call_handlers_initializer.h"
 #include "asylo/platform/primitives/extent.h"
 #include "asylo/platform/primitives/primitives.h"
 #include "asylo/platform/primitives/util/message.h"
+#include "asylo/platform/primitives/util/trace_context.h"
+#include "asylo/util/logging.h"
 #include "asylo/util/posix_error_space.h"
 #include "asylo/util/status.h"
 #include "asylo/util/status_macros.h"
@@ -57,27 +61,23 @@ Status GenericEnclaveClient::Initialize(const char *name, size_t name_len,
 
   ASYLO_RETURN_IF_ERROR(
       primitive_client_->EnclaveCall(kSelectorAsyloInit, &in, &out));
-  ASYLO_RETURN_IF_INCORRECT_READER_ARGUMENTS(out, 1);
+  ASYLO_RETURN_IF_TOO_FEW_READER_ARGUMENTS(out, 1);
   auto output_extent = out.next();
   *output_len = output_extent.size();
   output->reset(new char[*output_len]);
   memcpy(output->get(), output_extent.As<char>(), *output_len);
-  return Status::OkStatus();
-}
 
-Status GenericEnclaveClient::Run(const char *input, size_t input_len,
-                                 std::unique_ptr<char[]> *output,
-                                 size_t *output_len) {
-  primitives::MessageWriter in;
-  in.PushByReference(primitives::Extent{input, input_len});
-  primitives::MessageReader out;
-  ASYLO_RETURN_IF_ERROR(
-      primitive_client_->EnclaveCall(kSelectorAsyloRun, &in, &out));
-  ASYLO_RETURN_IF_INCORRECT_READER_ARGUMENTS(out, 1);
-  auto output_extent = out.next();
-  *output_len = output_extent.size();
-  output->reset(new char[*output_len]);
-  memcpy(output->get(), output_extent.As<char>(), *output_len);
+  // The timing of the trusted initialization phases follows, if the enclave
+  // runtime reports it.
+  trusted_load_report_.Clear();
+  if (out.hasNext()) {
+    auto report_extent = out.next();
+    if (!trusted_load_report_.ParseFromArray(report_extent.data(),
+                                             report_extent.size())) {
+      LOG(WARNING) << "Failed to deserialize EnclaveLoadReport";
+      trusted_load_report_.Clear();
+    }
+  }
   return Status::OkStatus();
 }
 
@@ -125,28 +125,46 @@ Status GenericEnclaveClient::EnterAndInitialize(const EnclaveConfig &config) {
 
 Status GenericEnclaveClient::EnterAndRun(const EnclaveInput &input,
                                          EnclaveOutput *output) {
+  absl::optional<primitives::ScopedTraceContext> scoped_trace_context;
+  if (input.has_trace_context()) {
+    const TraceContext &proto = input.trace_context();
+    primitives::TraceContext context;
+    context.trace_id_high = proto.trace_id_high();
+    context.trace_id_low = proto.trace_id_low();
+    context.span_id = proto.span_id();
+    context.sampled = proto.sampled();
+    scoped_trace_context.emplace(context);
+  }
   std::string buf;
   if (!input.SerializeToString(&buf)) {
     return Status(error::GoogleError::INVALID_ARGUMENT,
                   "Failed to serialize EnclaveInput");
   }
+  return EnterAndRunSerialized(primitives::Extent{buf.data(), buf.size()},
+                               output);
+}
 
-  std::unique_ptr<char[]> output_buf;
-  size_t output_len = 0;
-  ASYLO_RETURN_IF_ERROR(Run(buf.data(), buf.size(), &output_buf, &output_len));
+Status GenericEnclaveClient::EnterAndRunSerialized(
+    primitives::Extent serialized_input, EnclaveOutput *output) {
+  primitives::MessageWriter in;
+  in.PushByReference(serialized_input);
+  primitives::MessageReader out;
+  ASYLO_RETURN_IF_ERROR(
+      primitive_client_->EnclaveCall(kSelectorAsyloRun, &in, &out));
+  ASYLO_RETURN_IF_INCORRECT_READER_ARGUMENTS(out, 1);
 
-  // Enclave entry-point was successfully invoked. |output_buf| is guaranteed to
-  // have a value.
+  // Parse the output straight from the message returned by the enclave.
   EnclaveOutput local_output;
-  local_output.ParseFromArray(output_buf.get(), output_len);
-  Status status;
-  status.RestoreFrom(local_output.status());
-
-  // Set the output parameter if necessary.
-  if (output) {
-    *output = local_output;
+  if (!output) {
+    output = &local_output;
   }
-
+  auto output_extent = out.next();
+  if (!output->ParseFromArray(output_extent.data(), output_extent.size())) {
+    return Status(error::GoogleError::INTERNAL,
+                  "Failed to parse EnclaveOutput");
+  }
+  Status status;
+  status.RestoreFrom(output->status());
   return status;
 }
 
@@ -21,6 +21,7 @@
 
 #include "asylo/enclave.pb.h"  // IWYU pragma: export
 #include "asylo/platform/core/enclave_client.h"
+#include "asylo/platform/primitives/extent.h"
 #include "asylo/platform/primitives/untrusted_primitives.h"
 #include "asylo/util/status.h"  // IWYU pragma: export
 
@@ -35,10 +36,24 @@ class GenericEnclaveClient : public EnclaveClient {
 
   Status EnterAndRun(const EnclaveInput &input, EnclaveOutput *output) override;
 
+  // Like EnterAndRun(), but takes an EnclaveInput already serialized by the
+  // caller into |serialized_input|, which is passed to the enclave without
+  // being copied on the host. This avoids a serialization round trip for
+  // callers that hold serialized input, such as ones forwarding requests.
+  // |output| may be nullptr.
+  Status EnterAndRunSerialized(primitives::Extent serialized_input,
+                               EnclaveOutput *output);
+
   std::shared_ptr<primitives::Client> GetPrimitiveClient() const {
     return primitive_client_;
   }
 
+  // Returns the time taken by each initialization phase inside the enclave, as
+  // reported by its last successful initialization.
+  const EnclaveLoadReport &trusted_load_report() const {
+    return trusted_load_report_;
+  }
+
  protected:
   explicit GenericEnclaveClient(absl::string_view name)
       : EnclaveClient(name) {}
@@ -60,14 +75,6 @@ class GenericEnclaveClient : public EnclaveClient {
                     size_t input_len, std::unique_ptr<char[]> *output,
                     size_t *output_len);
 
-  // Enters the enclave and invokes the execution entry-point. If the ecall
-  // fails, or the enclave does not return any output, returns a non-OK status.
-  // In this case, the caller cannot make any assumptions about the contents of
-  // |output|. Otherwise, |output| points to a buffer of length *|output_len|
-  // that contains output from the enclave.
-  Status Run(const char *input, size_t input_len,
-             std::unique_ptr<char[]> *output, size_t *output_len);
-
   // Enters the enclave and invokes the finalization entry-point. If the ecall
   // fails, or the enclave does not return any output, returns a non-OK status.
   // In this case, the caller cannot make any assumptions about the contents of
@@ -77,6 +84,8 @@ class GenericEnclaveClient : public EnclaveClient {
                   std::unique_ptr<char[]> *output, size_t *output_len);
 
   void ReleaseMemory() override { primitive_client_->ReleaseMemory(); }
+
+  EnclaveLoadReport trusted_load_report_;
 };
 
 }  // namespace asylo
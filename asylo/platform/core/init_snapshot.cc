@@ -0,0 +1,141 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/core/init_snapshot.h"
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <utility>
+
+#include "absl/strings/str_cat.h"
+#include "asylo/crypto/sha256_hash.h"
+#include "asylo/crypto/util/bytes.h"
+#include "asylo/identity/sealing/sealed_secret.pb.h"
+#include "asylo/util/logging.h"
+#include "asylo/util/status_macros.h"
+
+namespace asylo {
+namespace {
+
+constexpr char kSecretName[] = "asylo init snapshot";
+constexpr char kSecretPurpose[] = "Enclave state after initialization";
+
+// Returns a digest identifying |config|.
+std::string ConfigDigest(const EnclaveConfig &config) {
+  UnsafeBytes<kSha256DigestLength> digest;
+  Sha256Hash::Digest(config.SerializeAsString(), &digest);
+  return std::string(digest.begin(), digest.end());
+}
+
+}  // namespace
+
+InitSnapshot::InitSnapshot(std::string path,
+                           std::unique_ptr<SecretSealer> sealer)
+    : path_(std::move(path)), sealer_(std::move(sealer)) {}
+
+StatusOr<bool> InitSnapshot::InitializeOrRestore(const EnclaveConfig &config,
+                                                 const Callbacks &callbacks) {
+  std::string config_digest = ConfigDigest(config);
+
+  absl::optional<CleansingVector<uint8_t>> state = Read(config_digest);
+  if (state.has_value()) {
+    Status status = callbacks.restore(*state);
+    if (status.ok()) {
+      return true;
+    }
+    LOG(WARNING) << "Failed to restore init snapshot " << path_ << ": "
+                 << status;
+  }
+
+  ASYLO_RETURN_IF_ERROR(callbacks.initialize());
+
+  StatusOr<std::string> saved_state = callbacks.save();
+  if (!saved_state.ok()) {
+    LOG(WARNING) << "Failed to save init snapshot: " << saved_state.status();
+    return false;
+  }
+  Status status = Write(config_digest, saved_state.ValueOrDie());
+  if (!status.ok()) {
+    LOG(WARNING) << "Failed to write init snapshot " << path_ << ": "
+                 << status;
+  }
+  return false;
+}
+
+absl::optional<CleansingVector<uint8_t>> InitSnapshot::Read(
+    const std::string &config_digest) {
+  std::ifstream input(path_, std::ios::binary);
+  if (!input) {
+    return absl::nullopt;
+  }
+
+  SealedSecret sealed_secret;
+  if (!sealed_secret.ParseFromIstream(&input)) {
+    LOG(WARNING) << "Ignoring malformed init snapshot " << path_;
+    return absl::nullopt;
+  }
+  if (sealed_secret.additional_authenticated_data() != config_digest) {
+    VLOG(1) << "Ignoring init snapshot " << path_
+            << " taken with a different configuration";
+    return absl::nullopt;
+  }
+
+  CleansingVector<uint8_t> state;
+  Status status = sealer_->Unseal(sealed_secret, &state);
+  if (!status.ok()) {
+    LOG(WARNING) << "Ignoring init snapshot " << path_
+                 << " that cannot be unsealed: " << status;
+    return absl::nullopt;
+  }
+  return state;
+}
+
+Status InitSnapshot::Write(const std::string &config_digest,
+                           ByteContainerView state) {
+  SealedSecretHeader header;
+  ASYLO_RETURN_IF_ERROR(sealer_->SetDefaultHeader(&header));
+  header.set_secret_name(kSecretName);
+  header.set_secret_purpose(kSecretPurpose);
+
+  SealedSecret sealed_secret;
+  ASYLO_RETURN_IF_ERROR(
+      sealer_->Seal(header, config_digest, state, &sealed_secret));
+
+  // The snapshot is written to a temporary file first so that an enclave
+  // starting concurrently never reads a partial snapshot.
+  std::string temporary_path = absl::StrCat(path_, ".", getpid(), ".tmp");
+  {
+    std::ofstream output(temporary_path, std::ios::binary | std::ios::trunc);
+    if (!sealed_secret.SerializeToOstream(&output)) {
+      return Status(error::GoogleError::INTERNAL,
+                    absl::StrCat("Failed to write ", temporary_path));
+    }
+  }
+  if (rename(temporary_path.c_str(), path_.c_str()) != 0) {
+    return Status(error::GoogleError::INTERNAL,
+                  absl::StrCat("Failed to rename ", temporary_path, " to ",
+                               path_, ": ", strerror(errno)));
+  }
+  return Status::OkStatus();
+}
+
+}  // namespace asylo
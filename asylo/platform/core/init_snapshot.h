@@ -0,0 +1,101 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_CORE_INIT_SNAPSHOT_H_
+#define ASYLO_PLATFORM_CORE_INIT_SNAPSHOT_H_
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "absl/types/optional.h"
+#include "asylo/crypto/util/byte_container_view.h"
+#include "asylo/enclave.pb.h"
+#include "asylo/identity/sealing/secret_sealer.h"
+#include "asylo/util/cleansing_types.h"
+#include "asylo/util/status.h"
+#include "asylo/util/statusor.h"
+
+namespace asylo {
+
+// A sealed file holding the state an enclave built during initialization, so
+// that later instances of the same enclave, started with the same
+// configuration, can restore that state instead of building it again.
+//
+// The snapshot holds whatever the application chooses to serialize, such as
+// parsed configuration, lookup tables, or unsealed secrets. It is sealed with
+// the given SecretSealer, typically one sealing to MRENCLAVE, so that only the
+// same enclave can read it. A digest of the EnclaveConfig is bound to the
+// snapshot as additional authenticated data, and a snapshot taken with a
+// different configuration is ignored.
+//
+// Example use in TrustedApplication::Initialize():
+//
+//   InitSnapshot snapshot(path,
+//                         sgx::SgxLocalSecretSealer::CreateMrenclaveSecretSealer());
+//   InitSnapshot::Callbacks callbacks;
+//   callbacks.initialize = [&] { return BuildTables(config); };
+//   callbacks.save = [&] { return SerializeTables(); };
+//   callbacks.restore = [&](ByteContainerView state) {
+//     return ParseTables(state);
+//   };
+//   ASYLO_RETURN_IF_ERROR(snapshot.InitializeOrRestore(config, callbacks)
+//                             .status());
+class InitSnapshot {
+ public:
+  // Application hooks for building, saving, and restoring the state.
+  struct Callbacks {
+    // Builds the state from scratch.
+    std::function<Status()> initialize;
+
+    // Serializes the state built by |initialize|.
+    std::function<StatusOr<std::string>()> save;
+
+    // Rebuilds the state from the output of |save|.
+    std::function<Status(ByteContainerView state)> restore;
+  };
+
+  // Creates a snapshot stored at |path| and sealed with |sealer|.
+  InitSnapshot(std::string path, std::unique_ptr<SecretSealer> sealer);
+
+  // Restores the state from the snapshot if one exists for |config|.
+  // Otherwise, or if restoring fails, builds the state from scratch and writes
+  // a new snapshot. Failing to write the snapshot is logged, but does not fail
+  // the initialization.
+  //
+  // Returns true if the state was restored, false if it was built from scratch,
+  // or the error from |callbacks.initialize|.
+  StatusOr<bool> InitializeOrRestore(const EnclaveConfig &config,
+                                     const Callbacks &callbacks);
+
+ private:
+  // Returns the state saved in the snapshot if it can be unsealed and was
+  // taken with the configuration digest |config_digest|.
+  absl::optional<CleansingVector<uint8_t>> Read(
+      const std::string &config_digest);
+
+  // Seals |state| with |config_digest| and writes it to the snapshot file.
+  Status Write(const std::string &config_digest, ByteContainerView state);
+
+  const std::string path_;
+  const std::unique_ptr<SecretSealer> sealer_;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_CORE_INIT_SNAPSHOT_H_
@@ -0,0 +1,69 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_CORE_LOAD_PHASE_TIMER_H_
+#define ASYLO_PLATFORM_CORE_LOAD_PHASE_TIMER_H_
+
+#include <string>
+
+#include "absl/strings/string_view.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "asylo/enclave.pb.h"
+
+namespace asylo {
+
+// Records consecutive phases of enclave loading into an EnclaveLoadReport.
+// Each phase lasts from the end of the previous one, or from the construction
+// of the timer for the first one.
+class LoadPhaseTimer {
+ public:
+  // Appends phases to |report|, which must outlive the timer.
+  explicit LoadPhaseTimer(EnclaveLoadReport *report)
+      : report_(report), start_(absl::Now()), phase_start_(start_) {}
+
+  // Records the time since the previous phase ended as phase |name|.
+  void EndPhase(absl::string_view name) {
+    const absl::Time now = absl::Now();
+    EnclaveLoadReport::Phase *phase = report_->add_phases();
+    phase->set_name(std::string(name));
+    phase->set_duration_ns(absl::ToInt64Nanoseconds(now - phase_start_));
+    phase_start_ = now;
+  }
+
+  // Appends the phases of |other| as they are.
+  void AppendPhases(const EnclaveLoadReport &other) {
+    report_->mutable_phases()->MergeFrom(other.phases());
+    phase_start_ = absl::Now();
+  }
+
+  // Records the time since the timer was constructed as the total duration.
+  void Finish() {
+    report_->set_total_duration_ns(
+        absl::ToInt64Nanoseconds(absl::Now() - start_));
+  }
+
+ private:
+  EnclaveLoadReport *const report_;
+  const absl::Time start_;
+  absl::Time phase_start_;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_CORE_LOAD_PHASE_TIMER_H_
@@ -0,0 +1,277 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/core/local_ring.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+
+#include "absl/strings/str_cat.h"
+#include "asylo/platform/core/local_ring_wait.h"
+#include "asylo/util/status_macros.h"
+
+namespace asylo {
+
+// |write_position| and |read_position| count the bytes ever written to and
+// read from the ring; their difference is the number of bytes in the ring.
+// Each frame is a 32-bit length followed by that many bytes, and may wrap
+// around the end of the data. Each side bumps the futex word of its peer to
+// wake it up, which it only does if the peer announced that it is going to
+// sleep.
+struct LocalRingHeader {
+  // Written by the producer.
+  alignas(64) std::atomic<uint64_t> write_position;
+  std::atomic<int32_t> readable_word;
+  std::atomic<int32_t> consumer_sleeping;
+
+  // Written by the consumer.
+  alignas(64) std::atomic<uint64_t> read_position;
+  std::atomic<int32_t> writable_word;
+  std::atomic<int32_t> producer_sleeping;
+
+  // Written by either side.
+  alignas(64) std::atomic<int32_t> closed;
+};
+
+namespace {
+
+constexpr size_t kFrameHeaderSize = sizeof(uint32_t);
+constexpr size_t kRegionAlignment = 64;
+
+// Number of times a side polls the ring before it sleeps.
+constexpr int kSpinIterations = 4096;
+
+static_assert(sizeof(std::atomic<int32_t>) == sizeof(int32_t),
+              "Futex words must be plain 32-bit integers");
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "Ring positions must be lock-free to be shared across enclaves");
+static_assert(sizeof(LocalRingHeader) % kRegionAlignment == 0,
+              "The data of a ring must be cache-line aligned");
+
+void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
+
+int32_t *FutexWord(std::atomic<int32_t> *word) {
+  return reinterpret_cast<int32_t *>(word);
+}
+
+// Wakes up the side which announced in |sleeping| that it sleeps on |word|.
+void WakeIfSleeping(std::atomic<int32_t> *sleeping,
+                    std::atomic<int32_t> *word) {
+  if (sleeping->load(std::memory_order_relaxed) != 0) {
+    word->fetch_add(1, std::memory_order_release);
+    internal::LocalRingWake(FutexWord(word));
+  }
+}
+
+// Sleeps on |word| until the peer wakes this side up, unless |ready| returns
+// true after this side announced in |sleeping| that it goes to sleep.
+template <typename Ready>
+void Sleep(std::atomic<int32_t> *sleeping, std::atomic<int32_t> *word,
+           Ready ready) {
+  int32_t value = word->load(std::memory_order_acquire);
+  sleeping->store(1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (!ready()) {
+    internal::LocalRingWait(FutexWord(word), value);
+  }
+  sleeping->store(0, std::memory_order_relaxed);
+}
+
+}  // namespace
+
+size_t LocalRing::RegionSize(size_t capacity) {
+  return sizeof(LocalRingHeader) + capacity;
+}
+
+StatusOr<LocalRing> LocalRing::Attach(void *region, size_t region_size) {
+  if (region == nullptr ||
+      reinterpret_cast<uintptr_t>(region) % kRegionAlignment != 0) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  absl::StrCat("Ring region must be aligned to ",
+                               kRegionAlignment, " bytes"));
+  }
+  if (region_size <= RegionSize(kFrameHeaderSize)) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Ring region is too small");
+  }
+  if (!internal::IsUntrustedRegion(region, region_size)) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Ring region must be in untrusted memory");
+  }
+  auto *header = static_cast<LocalRingHeader *>(region);
+  return LocalRing(header, reinterpret_cast<uint8_t *>(header + 1),
+                   region_size - sizeof(LocalRingHeader));
+}
+
+size_t LocalRing::max_frame_size() const {
+  return std::min<size_t>(capacity_ - kFrameHeaderSize,
+                          std::numeric_limits<uint32_t>::max());
+}
+
+Status LocalRing::Write(ByteContainerView frame) {
+  if (frame.size() > max_frame_size()) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  absl::StrCat("Frame of ", frame.size(),
+                               " bytes exceeds the ring limit of ",
+                               max_frame_size(), " bytes"));
+  }
+  const size_t needed = kFrameHeaderSize + frame.size();
+
+  int spins = 0;
+  Status status;
+  while (true) {
+    if (closed()) {
+      return Status(error::GoogleError::UNAVAILABLE, "Ring is closed");
+    }
+    size_t writable;
+    ASYLO_ASSIGN_OR_RETURN(writable, WritableBytes());
+    if (writable >= needed) {
+      break;
+    }
+    if (spins < kSpinIterations) {
+      ++spins;
+      CpuRelax();
+      continue;
+    }
+    Sleep(&header_->producer_sleeping, &header_->writable_word, [&] {
+      auto result = WritableBytes();
+      if (!result.ok()) {
+        status = result.status();
+        return true;
+      }
+      return result.ValueOrDie() >= needed || closed();
+    });
+    ASYLO_RETURN_IF_ERROR(status);
+  }
+
+  uint32_t length = frame.size();
+  CopyIn(position_, reinterpret_cast<const uint8_t *>(&length),
+         kFrameHeaderSize);
+  CopyIn(position_ + kFrameHeaderSize, frame.data(), frame.size());
+  position_ += needed;
+  header_->write_position.store(position_, std::memory_order_release);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  WakeIfSleeping(&header_->consumer_sleeping, &header_->readable_word);
+  return Status::OkStatus();
+}
+
+StatusOr<std::string> LocalRing::Read() {
+  int spins = 0;
+  size_t readable = 0;
+  Status status;
+  while (true) {
+    ASYLO_ASSIGN_OR_RETURN(readable, ReadableBytes());
+    if (readable > 0) {
+      break;
+    }
+    if (closed()) {
+      return Status(error::GoogleError::UNAVAILABLE, "Ring is closed");
+    }
+    if (spins < kSpinIterations) {
+      ++spins;
+      CpuRelax();
+      continue;
+    }
+    Sleep(&header_->consumer_sleeping, &header_->readable_word, [&] {
+      auto result = ReadableBytes();
+      if (!result.ok()) {
+        status = result.status();
+        return true;
+      }
+      return result.ValueOrDie() > 0 || closed();
+    });
+    ASYLO_RETURN_IF_ERROR(status);
+  }
+
+  // The producer only publishes whole frames, so anything else is corrupt.
+  uint32_t length = 0;
+  if (readable >= kFrameHeaderSize) {
+    CopyOut(position_, reinterpret_cast<uint8_t *>(&length), kFrameHeaderSize);
+  }
+  if (readable < kFrameHeaderSize || length > readable - kFrameHeaderSize) {
+    return Status(error::GoogleError::DATA_LOSS,
+                  "Ring holds a truncated frame");
+  }
+  std::string frame(length, '\0');
+  CopyOut(position_ + kFrameHeaderSize, reinterpret_cast<uint8_t *>(&frame[0]),
+          length);
+  position_ += kFrameHeaderSize + length;
+  header_->read_position.store(position_, std::memory_order_release);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  WakeIfSleeping(&header_->producer_sleeping, &header_->writable_word);
+  return frame;
+}
+
+void LocalRing::Close() {
+  header_->closed.store(1, std::memory_order_seq_cst);
+  for (std::atomic<int32_t> *word :
+       {&header_->readable_word, &header_->writable_word}) {
+    word->fetch_add(1, std::memory_order_release);
+    internal::LocalRingWake(FutexWord(word));
+  }
+}
+
+void LocalRing::CopyIn(uint64_t position, const uint8_t *buffer,
+                       size_t size) {
+  const size_t offset = position % capacity_;
+  const size_t first = std::min(size, capacity_ - offset);
+  memcpy(data_ + offset, buffer, first);
+  memcpy(data_, buffer + first, size - first);
+}
+
+void LocalRing::CopyOut(uint64_t position, uint8_t *buffer,
+                        size_t size) const {
+  const size_t offset = position % capacity_;
+  const size_t first = std::min(size, capacity_ - offset);
+  memcpy(buffer, data_ + offset, first);
+  memcpy(buffer + first, data_, size - first);
+}
+
+StatusOr<size_t> LocalRing::ReadableBytes() const {
+  uint64_t write_position =
+      header_->write_position.load(std::memory_order_acquire);
+  if (write_position < position_ || write_position - position_ > capacity_) {
+    return Status(error::GoogleError::DATA_LOSS,
+                  "Ring producer published an invalid position");
+  }
+  return write_position - position_;
+}
+
+StatusOr<size_t> LocalRing::WritableBytes() const {
+  uint64_t read_position =
+      header_->read_position.load(std::memory_order_acquire);
+  if (read_position > position_ || position_ - read_position > capacity_) {
+    return Status(error::GoogleError::DATA_LOSS,
+                  "Ring consumer published an invalid position");
+  }
+  return capacity_ - (position_ - read_position);
+}
+
+bool LocalRing::closed() const {
+  return header_->closed.load(std::memory_order_acquire) != 0;
+}
+
+}  // namespace asylo
@@ -0,0 +1,108 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_CORE_LOCAL_RING_H_
+#define ASYLO_PLATFORM_CORE_LOCAL_RING_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "asylo/crypto/util/byte_container_view.h"
+#include "asylo/util/status.h"
+#include "asylo/util/statusor.h"
+
+namespace asylo {
+
+// Header of a LocalRing in untrusted memory.
+struct LocalRingHeader;
+
+// A single-producer, single-consumer ring of frames in untrusted memory, shared
+// by two enclaves on the same host. The host allocates a zero-filled region of
+// RegionSize() bytes and hands it to both enclaves, which attach to it with
+// Attach(): one only writes to the ring and the other only reads from it.
+//
+// Frames are copied in and out of the region, and each side keeps its own
+// position in trusted memory, checking the position published by its peer
+// before using it. The ring thus survives a host which tampers with the
+// region, but it provides neither confidentiality nor integrity: callers must
+// protect the frames themselves.
+//
+// A side which finds the ring empty (or full) spins briefly, then sleeps on a
+// futex word in the region until its peer wakes it up. A side only exits the
+// enclave to wake its peer if the peer is asleep.
+class LocalRing {
+ public:
+  // Returns the size of a region holding a ring of |capacity| bytes.
+  static size_t RegionSize(size_t capacity);
+
+  // Attaches to the ring in |region|, which must be |region_size| bytes of
+  // untrusted memory aligned to 64 bytes, and zero-filled before either side
+  // attaches to it.
+  static StatusOr<LocalRing> Attach(void *region, size_t region_size);
+
+  LocalRing(LocalRing &&other) = default;
+  LocalRing &operator=(LocalRing &&other) = default;
+
+  // Returns the size of the largest frame that fits in the ring.
+  size_t max_frame_size() const;
+
+  // Appends |frame| to the ring, waiting for room if the ring is full. Fails
+  // if the frame can never fit in the ring, or if the ring was closed.
+  Status Write(ByteContainerView frame);
+
+  // Removes the next frame from the ring, waiting for one if the ring is
+  // empty. Fails once the ring is empty and closed, or if the peer published
+  // an invalid position or frame.
+  StatusOr<std::string> Read();
+
+  // Marks the ring closed and wakes up both sides.
+  void Close();
+
+ private:
+  LocalRing(LocalRingHeader *header, uint8_t *data, size_t capacity)
+      : header_(header), data_(data), capacity_(capacity) {}
+
+  // Copies |size| bytes between |buffer| and the ring at |position|, wrapping
+  // around the end of the ring.
+  void CopyIn(uint64_t position, const uint8_t *buffer, size_t size);
+  void CopyOut(uint64_t position, uint8_t *buffer, size_t size) const;
+
+  // Returns the number of bytes in the ring, as published by the producer, or
+  // an error if the producer published an invalid position.
+  StatusOr<size_t> ReadableBytes() const;
+
+  // Returns the number of free bytes in the ring, as published by the
+  // consumer, or an error if the consumer published an invalid position.
+  StatusOr<size_t> WritableBytes() const;
+
+  bool closed() const;
+
+  LocalRingHeader *header_;
+  uint8_t *data_;
+  size_t capacity_;
+
+  // The position of this side in the ring, in bytes since the ring was
+  // created: the end of the written frames for the producer, and the start of
+  // the unread frames for the consumer.
+  uint64_t position_ = 0;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_CORE_LOCAL_RING_H_
@@ -0,0 +1,144 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/core/local_ring.h"
+
+#include <stdlib.h>
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/strings/str_cat.h"
+#include "asylo/test/util/status_matchers.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+namespace {
+
+using ::testing::Eq;
+
+constexpr size_t kCapacity = 256;
+constexpr int kNumFrames = 2000;
+
+class LocalRingTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    region_size_ = LocalRing::RegionSize(kCapacity);
+    region_ = aligned_alloc(64, region_size_);
+    memset(region_, 0, region_size_);
+  }
+
+  void TearDown() override { free(region_); }
+
+  LocalRing Attach() {
+    auto ring = LocalRing::Attach(region_, region_size_);
+    EXPECT_THAT(ring, IsOk());
+    return std::move(ring).ValueOrDie();
+  }
+
+  void *region_;
+  size_t region_size_;
+};
+
+TEST_F(LocalRingTest, DeliversFramesInOrder) {
+  LocalRing producer = Attach();
+  LocalRing consumer = Attach();
+
+  // The frames wrap around the end of the ring many times, and the producer
+  // regularly finds the ring full.
+  std::thread writer([&producer] {
+    for (int i = 0; i < kNumFrames; ++i) {
+      ASSERT_THAT(producer.Write(absl::StrCat("frame ", i)), IsOk());
+    }
+  });
+  for (int i = 0; i < kNumFrames; ++i) {
+    EXPECT_THAT(consumer.Read(), IsOkAndHolds(absl::StrCat("frame ", i)));
+  }
+  writer.join();
+}
+
+TEST_F(LocalRingTest, DeliversEmptyAndLargestFrames) {
+  LocalRing producer = Attach();
+  LocalRing consumer = Attach();
+  std::string largest(producer.max_frame_size(), 'x');
+
+  ASSERT_THAT(producer.Write(""), IsOk());
+  EXPECT_THAT(consumer.Read(), IsOkAndHolds(""));
+  ASSERT_THAT(producer.Write(largest), IsOk());
+  EXPECT_THAT(consumer.Read(), IsOkAndHolds(largest));
+  EXPECT_THAT(producer.Write(largest + "x"),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+}
+
+TEST_F(LocalRingTest, CloseWakesUpReader) {
+  LocalRing producer = Attach();
+  LocalRing consumer = Attach();
+  ASSERT_THAT(producer.Write("last"), IsOk());
+
+  std::thread closer([&producer] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    producer.Close();
+  });
+  // Frames written before the ring was closed are still delivered.
+  EXPECT_THAT(consumer.Read(), IsOkAndHolds("last"));
+  EXPECT_THAT(consumer.Read(), StatusIs(error::GoogleError::UNAVAILABLE));
+  closer.join();
+  EXPECT_THAT(producer.Write("more"),
+              StatusIs(error::GoogleError::UNAVAILABLE));
+}
+
+TEST_F(LocalRingTest, RejectsInvalidPositions) {
+  LocalRing producer = Attach();
+  LocalRing consumer = Attach();
+  ASSERT_THAT(producer.Write("frame"), IsOk());
+
+  // The region is untrusted, so a position published by the peer may be
+  // anything.
+  uint64_t bogus = kCapacity * 2;
+  auto *header = static_cast<uint8_t *>(region_);
+  uint64_t saved;
+  memcpy(&saved, header, sizeof(saved));
+  memcpy(header, &bogus, sizeof(bogus));
+  EXPECT_THAT(consumer.Read(), StatusIs(error::GoogleError::DATA_LOSS));
+  memcpy(header, &saved, sizeof(saved));
+
+  // A frame longer than the bytes published is rejected too.
+  auto *data = header + LocalRing::RegionSize(0);
+  uint32_t length = kCapacity;
+  memcpy(data, &length, sizeof(length));
+  EXPECT_THAT(consumer.Read(), StatusIs(error::GoogleError::DATA_LOSS));
+}
+
+TEST(LocalRingAttachTest, RejectsInvalidRegions) {
+  alignas(64) static uint8_t region[1024];
+  EXPECT_THAT(LocalRing::Attach(nullptr, sizeof(region)),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+  EXPECT_THAT(LocalRing::Attach(region + 1, sizeof(region) - 1),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+  EXPECT_THAT(LocalRing::Attach(region, LocalRing::RegionSize(0)),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+  EXPECT_THAT(LocalRing::Attach(region, sizeof(region)), IsOk());
+}
+
+}  // namespace
+}  // namespace asylo
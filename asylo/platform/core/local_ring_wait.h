@@ -0,0 +1,44 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_CORE_LOCAL_RING_WAIT_H_
+#define ASYLO_PLATFORM_CORE_LOCAL_RING_WAIT_H_
+
+#include <cstddef>
+#include <cstdint>
+
+// Host services used by LocalRing, implemented with host calls inside an
+// enclave and with system calls outside of one.
+
+namespace asylo {
+namespace internal {
+
+// Returns true if [|addr|, |addr| + |size|) lies outside of the enclave.
+bool IsUntrustedRegion(const void *addr, size_t size);
+
+// Sleeps until the futex word |word| is woken up, unless it no longer holds
+// |value|.
+void LocalRingWait(int32_t *word, int32_t value);
+
+// Wakes up the thread sleeping on the futex word |word|, if any.
+void LocalRingWake(int32_t *word);
+
+}  // namespace internal
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_CORE_LOCAL_RING_WAIT_H_
@@ -0,0 +1,40 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+#include "asylo/platform/core/local_ring_wait.h"
+#include "asylo/platform/host_call/trusted/host_calls.h"
+#include "asylo/platform/primitives/trusted_primitives.h"
+
+namespace asylo {
+namespace internal {
+
+bool IsUntrustedRegion(const void *addr, size_t size) {
+  return primitives::TrustedPrimitives::IsOutsideEnclave(addr, size);
+}
+
+void LocalRingWait(int32_t *word, int32_t value) {
+  enc_untrusted_thread_wait_value(word, value);
+}
+
+void LocalRingWake(int32_t *word) { enc_untrusted_notify(word); }
+
+}  // namespace internal
+}  // namespace asylo
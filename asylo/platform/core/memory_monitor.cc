@@ -0,0 +1,129 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/core/memory_monitor.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "asylo/platform/primitives/trusted_runtime.h"
+
+namespace asylo {
+namespace {
+
+HeapUsage GetEnclaveHeapUsage() {
+  struct EnclaveMemoryLayout layout;
+  enc_get_memory_layout(&layout);
+  return {layout.heap_in_use, layout.heap_used, layout.heap_size,
+          layout.heap_exhaustions};
+}
+
+}  // namespace
+
+MemoryMonitor *MemoryMonitor::GetInstance() {
+  static MemoryMonitor *instance = new MemoryMonitor(&GetEnclaveHeapUsage);
+  return instance;
+}
+
+MemoryMonitor::MemoryMonitor(std::function<HeapUsage()> heap_usage)
+    : heap_usage_(std::move(heap_usage)) {}
+
+void MemoryMonitor::SetThresholds(size_t moderate_bytes,
+                                  size_t critical_bytes) {
+  absl::MutexLock lock(&mu_);
+  moderate_bytes_ = moderate_bytes;
+  critical_bytes_ = critical_bytes;
+  last_reclaim_in_use_ = 0;
+}
+
+int MemoryMonitor::Register(std::string name, UsageReporter reporter,
+                            Reclaimer reclaimer) {
+  absl::MutexLock lock(&mu_);
+  int id = next_id_++;
+  subsystems_.push_back(
+      {id, std::move(name), std::move(reporter), std::move(reclaimer)});
+  return id;
+}
+
+void MemoryMonitor::Unregister(int id) {
+  absl::MutexLock lock(&mu_);
+  subsystems_.erase(
+      std::remove_if(subsystems_.begin(), subsystems_.end(),
+                     [id](const Subsystem &subsystem) {
+                       return subsystem.id == id;
+                     }),
+      subsystems_.end());
+}
+
+MemoryUsageReport MemoryMonitor::GetUsage() {
+  std::vector<Subsystem> subsystems;
+  MemoryUsageReport report;
+  report.heap = heap_usage_();
+  {
+    absl::MutexLock lock(&mu_);
+    subsystems = subsystems_;
+    report.pressure = PressureOf(report.heap.in_use);
+  }
+  for (const Subsystem &subsystem : subsystems) {
+    report.subsystems.push_back({subsystem.name, subsystem.reporter()});
+  }
+  return report;
+}
+
+MemoryPressure MemoryMonitor::CheckPressure() {
+  size_t in_use = heap_usage_().in_use;
+  MemoryPressure pressure;
+  std::vector<Subsystem> subsystems;
+  {
+    absl::MutexLock lock(&mu_);
+    pressure = PressureOf(in_use);
+    if (pressure == MemoryPressure::kNone) {
+      last_reclaim_in_use_ = 0;
+      return pressure;
+    }
+    if (reclaiming_ || in_use <= last_reclaim_in_use_) {
+      return pressure;
+    }
+    reclaiming_ = true;
+    subsystems = subsystems_;
+  }
+
+  for (const Subsystem &subsystem : subsystems) {
+    if (subsystem.reclaimer) {
+      subsystem.reclaimer(pressure);
+    }
+  }
+
+  in_use = heap_usage_().in_use;
+  absl::MutexLock lock(&mu_);
+  reclaiming_ = false;
+  last_reclaim_in_use_ = in_use;
+  return PressureOf(in_use);
+}
+
+MemoryPressure MemoryMonitor::PressureOf(size_t in_use) const {
+  if (critical_bytes_ > 0 && in_use > critical_bytes_) {
+    return MemoryPressure::kCritical;
+  }
+  if (moderate_bytes_ > 0 && in_use > moderate_bytes_) {
+    return MemoryPressure::kModerate;
+  }
+  return MemoryPressure::kNone;
+}
+
+}  // namespace asylo
@@ -0,0 +1,148 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_CORE_MEMORY_MONITOR_H_
+#define ASYLO_PLATFORM_CORE_MEMORY_MONITOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+
+namespace asylo {
+
+// How close the trusted heap is to the thresholds configured for it.
+enum class MemoryPressure {
+  kNone,
+  // The heap is above the moderate threshold. Caches should give back memory
+  // they can cheaply rebuild.
+  kModerate,
+  // The heap is above the critical threshold. Caches should give back as much
+  // memory as they can.
+  kCritical,
+};
+
+// Sizes of the trusted heap, in bytes.
+struct HeapUsage {
+  // Bytes currently handed out by enclave_sbrk.
+  size_t in_use;
+  // Most bytes ever handed out by enclave_sbrk. Every page below this mark has
+  // been touched, and counts against the EPC until the enclave is destroyed.
+  size_t peak;
+  // Size of the heap reserved for the enclave.
+  size_t limit;
+  // Number of times enclave_sbrk refused to grow the heap.
+  uint64_t exhaustions;
+};
+
+// Memory used by one registered subsystem.
+struct SubsystemMemoryUsage {
+  std::string name;
+  size_t bytes;
+};
+
+struct MemoryUsageReport {
+  HeapUsage heap;
+  std::vector<SubsystemMemoryUsage> subsystems;
+  MemoryPressure pressure;
+};
+
+// Tracks the memory used by the trusted heap and by the subsystems that hold
+// large amounts of it, and asks those subsystems to give memory back when the
+// heap crosses configured thresholds. Without thresholds, the monitor only
+// reports usage.
+//
+// Enclave memory beyond the EPC is paged by the host at a large cost, and the
+// enclave cannot observe the paging itself. The heap thresholds should
+// therefore be set below the share of the EPC that the enclave can expect.
+//
+// This class is thread-safe. Reporters and reclaimers are called without the
+// monitor's lock held, and may allocate and free memory.
+class MemoryMonitor {
+ public:
+  // Returns the size of a subsystem's memory, in bytes.
+  using UsageReporter = std::function<size_t()>;
+
+  // Asks a subsystem to give back memory at the given pressure. Returns the
+  // number of bytes released.
+  using Reclaimer = std::function<size_t(MemoryPressure)>;
+
+  // Returns the monitor of the trusted heap of this enclave.
+  static MemoryMonitor *GetInstance();
+
+  // Creates a monitor of the heap described by |heap_usage|. Used by tests.
+  explicit MemoryMonitor(std::function<HeapUsage()> heap_usage);
+
+  MemoryMonitor(const MemoryMonitor &other) = delete;
+  MemoryMonitor &operator=(const MemoryMonitor &other) = delete;
+
+  // Sets the number of bytes of heap in use above which the heap is under
+  // moderate and critical pressure. A zero threshold is never crossed.
+  void SetThresholds(size_t moderate_bytes, size_t critical_bytes)
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Registers a subsystem under |name|. |reporter| must be set. |reclaimer|
+  // may be null for subsystems that cannot give memory back. Returns an
+  // identifier for Unregister().
+  int Register(std::string name, UsageReporter reporter, Reclaimer reclaimer)
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Unregisters the subsystem registered as |id|. Its callbacks may still be
+  // running when this returns.
+  void Unregister(int id) ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns the current usage of the heap and of every registered subsystem.
+  MemoryUsageReport GetUsage() ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns the current pressure. If the heap is under pressure and has grown
+  // since reclaimers last ran, runs every reclaimer first. This is cheap when
+  // the heap is below its thresholds, and is called after every enclave entry.
+  MemoryPressure CheckPressure() ABSL_LOCKS_EXCLUDED(mu_);
+
+ private:
+  struct Subsystem {
+    int id;
+    std::string name;
+    UsageReporter reporter;
+    Reclaimer reclaimer;
+  };
+
+  MemoryPressure PressureOf(size_t in_use) const
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  const std::function<HeapUsage()> heap_usage_;
+
+  absl::Mutex mu_;
+  size_t moderate_bytes_ ABSL_GUARDED_BY(mu_) = 0;
+  size_t critical_bytes_ ABSL_GUARDED_BY(mu_) = 0;
+  std::vector<Subsystem> subsystems_ ABSL_GUARDED_BY(mu_);
+  int next_id_ ABSL_GUARDED_BY(mu_) = 0;
+
+  // Heap in use when reclaimers last ran. Reclaimers run again only once the
+  // heap grows past it, since the heap rarely shrinks after memory is freed.
+  size_t last_reclaim_in_use_ ABSL_GUARDED_BY(mu_) = 0;
+  bool reclaiming_ ABSL_GUARDED_BY(mu_) = false;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_CORE_MEMORY_MONITOR_H_
@@ -0,0 +1,68 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/core/profile_counters.h"
+
+#include <errno.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "asylo/platform/host_call/trusted/host_calls.h"
+#include "asylo/util/posix_error_space.h"
+
+// Entry points of the profile runtimes, which are only linked into instrumented
+// enclaves.
+extern "C" {
+
+uint64_t __llvm_profile_get_size_for_buffer(void) __attribute__((weak));
+int __llvm_profile_write_buffer(char *buffer) __attribute__((weak));
+void __gcov_dump(void) __attribute__((weak));
+
+}  // extern "C"
+
+namespace asylo {
+
+bool HasProfileCounters() {
+  return __llvm_profile_write_buffer != nullptr || __gcov_dump != nullptr;
+}
+
+Status FlushProfileCounters(const std::string &path) {
+  if (__gcov_dump) {
+    __gcov_dump();
+  }
+  if (!__llvm_profile_get_size_for_buffer || !__llvm_profile_write_buffer) {
+    return Status::OkStatus();
+  }
+
+  std::vector<char> buffer(__llvm_profile_get_size_for_buffer());
+  if (__llvm_profile_write_buffer(buffer.data()) != 0) {
+    return Status(error::GoogleError::INTERNAL,
+                  "Failed to serialize the LLVM profile counters");
+  }
+  if (enc_untrusted_write_profile(path.c_str(), buffer.data(),
+                                  buffer.size()) != 0) {
+    return Status(static_cast<error::PosixError>(errno),
+                  "Failed to write the LLVM profile counters to " +
+                      (path.empty() ? std::string("the host") : path));
+  }
+  return Status::OkStatus();
+}
+
+}  // namespace asylo
@@ -0,0 +1,47 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_CORE_PROFILE_COUNTERS_H_
+#define ASYLO_PLATFORM_CORE_PROFILE_COUNTERS_H_
+
+#include <string>
+
+#include "asylo/util/status.h"
+
+namespace asylo {
+
+// Support for the profile counters of enclaves built for profile-guided
+// optimization with -fprofile-generate. The profile runtimes of GCC and LLVM
+// write their counters from an atexit handler, which never runs in an enclave,
+// so the runtime flushes them explicitly when the enclave is finalized.
+
+// Returns true if the enclave is instrumented with GCC or LLVM profile
+// counters.
+bool HasProfileCounters();
+
+// Writes the profile counters of the enclave out to the host. LLVM counters
+// are serialized in the enclave and written to the host file |path| in a
+// single host call. An empty |path| lets the host pick the file, as described
+// in enc_untrusted_write_profile. GCC counters are written by libgcov to the
+// .gcda files named when the enclave was built, through the file I/O of the
+// enclave, and ignore |path|. Does nothing if the enclave is not instrumented.
+Status FlushProfileCounters(const std::string &path);
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_CORE_PROFILE_COUNTERS_H_
@@ -18,6 +18,8 @@
 
 #include "asylo/platform/core/shared_resource_manager.h"
 
+#include <atomic>
+
 #include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
 #include "absl/synchronization/mutex.h"
@@ -47,11 +49,28 @@ bool SharedResourceManager::ReleaseResource(const SharedName &name) {
   if (it == shared_resources_.end()) {
     return false;
   }
-  it->second->reference_count--;
-  if (it->second->reference_count == 0) {
+  if (--it->second->reference_count == 0) {
     shared_resources_.erase(it);
   }
   return true;
 }
 
+void SharedResourceManager::Release(ResourceHandle *handle) {
+  // Dropping a reference which is not the last one needs no lock, since the
+  // resource stays in the table either way.
+  int count = handle->reference_count.load(std::memory_order_relaxed);
+  while (count > 1) {
+    if (handle->reference_count.compare_exchange_weak(
+            count, count - 1, std::memory_order_acq_rel,
+            std::memory_order_relaxed)) {
+      return;
+    }
+  }
+
+  absl::MutexLock lock(&mu_);
+  if (--handle->reference_count == 0) {
+    shared_resources_.erase(handle->resource_name);
+  }
+}
+
 }  // namespace asylo
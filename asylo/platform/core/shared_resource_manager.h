@@ -19,7 +19,9 @@
 #ifndef ASYLO_PLATFORM_CORE_SHARED_RESOURCE_MANAGER_H_
 #define ASYLO_PLATFORM_CORE_SHARED_RESOURCE_MANAGER_H_
 
+#include <atomic>
 #include <memory>
+#include <utility>
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/synchronization/mutex.h"
@@ -33,7 +35,76 @@ namespace asylo {
 /// A manager object responsible for reference-counted untrusted resources which
 /// are shared between trusted and untrusted code.
 class SharedResourceManager {
+ private:
+  struct ResourceHandle;
+
  public:
+  /// A counted reference to a shared resource.
+  ///
+  /// A reference resolves the name of the resource once, when it is acquired
+  /// with AcquireReference(), and then accesses the resource without taking
+  /// the lock of the SharedResourceManager or looking up its name. Copying a
+  /// reference adds a reference to the resource, and destroying one removes
+  /// it, both with atomic operations only, unless it drops the last reference
+  /// to the resource. The resource stays alive while any reference to it
+  /// exists.
+  template <typename T>
+  class Reference {
+   public:
+    /// Constructs an empty reference.
+    Reference() = default;
+
+    Reference(const Reference &other)
+        : manager_(other.manager_), handle_(other.handle_) {
+      if (handle_) {
+        handle_->reference_count.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+
+    Reference(Reference &&other)
+        : manager_(other.manager_), handle_(other.handle_) {
+      other.manager_ = nullptr;
+      other.handle_ = nullptr;
+    }
+
+    Reference &operator=(Reference other) {
+      std::swap(manager_, other.manager_);
+      std::swap(handle_, other.handle_);
+      return *this;
+    }
+
+    ~Reference() { reset(); }
+
+    /// Returns the referenced resource, or nullptr if the reference is empty.
+    T *get() const {
+      return handle_ ? static_cast<T *>(handle_->get()) : nullptr;
+    }
+
+    T *operator->() const { return get(); }
+    T &operator*() const { return *get(); }
+
+    /// Returns true if the reference is not empty.
+    explicit operator bool() const { return handle_ != nullptr; }
+
+    /// Drops the reference, leaving it empty.
+    void reset() {
+      if (handle_) {
+        manager_->Release(handle_);
+        manager_ = nullptr;
+        handle_ = nullptr;
+      }
+    }
+
+   private:
+    friend class SharedResourceManager;
+
+    Reference(SharedResourceManager *manager, ResourceHandle *handle)
+        : manager_(manager), handle_(handle) {}
+
+    SharedResourceManager *manager_ = nullptr;
+    ResourceHandle *handle_ = nullptr;
+  };
+
   /// Registers a shared resource and passes ownership to the
   /// SharedResourceManager.
   ///
@@ -90,6 +161,22 @@ class SharedResourceManager {
     return static_cast<T *>(it->second->get());
   }
 
+  /// Acquires a counted reference to a named resource.
+  ///
+  /// Looks up the named resource once and returns a Reference to it, which
+  /// holds one reference count on the resource until it is destroyed. Returns
+  /// an empty Reference if the named resource does not exist.
+  template <typename T>
+  Reference<T> AcquireReference(const SharedName &name) {
+    absl::MutexLock lock(&mu_);
+    auto it = shared_resources_.find(name);
+    if (it == shared_resources_.end()) {
+      return Reference<T>();
+    }
+    it->second->reference_count++;
+    return Reference<T>(this, it->second.get());
+  }
+
   /// Releases a named resource.
   ///
   /// Releases a named resource by decrementing its reference count. Removes it
@@ -115,7 +202,10 @@ class SharedResourceManager {
     virtual void release() = 0;
 
     SharedName resource_name;
-    int reference_count;
+
+    // Only drops to zero under |mu_|, so that a resource is never found in
+    // |shared_resources_| after its last reference was released.
+    std::atomic<int> reference_count;
   };
 
   // A resource owned by the EnclaveManager.
@@ -143,6 +233,10 @@ class SharedResourceManager {
   Status InstallResource(ResourceHandle *handle)
       ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
 
+  // Releases one reference to |handle|, removing and finalizing the resource
+  // if that was the last one. Takes |mu_| only in that case.
+  void Release(ResourceHandle *handle) ABSL_LOCKS_EXCLUDED(mu_);
+
   absl::Mutex mu_;
   absl::flat_hash_map<SharedName, std::unique_ptr<ResourceHandle>,
                       SharedName::Hash, SharedName::Eq>
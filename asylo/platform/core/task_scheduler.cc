@@ -0,0 +1,230 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/core/task_scheduler.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <utility>
+
+#include "asylo/platform/host_call/trusted/host_calls.h"
+#include "asylo/platform/primitives/trusted_primitives.h"
+#include "asylo/platform/primitives/trusted_runtime.h"
+
+extern "C" {
+
+// Pushes the callee-saved registers and the floating point control state onto
+// the current stack, stores the stack pointer in |*save| and continues on the
+// stack |load|, which was saved the same way.
+void asylo_task_swap_context(void **save, void *load)
+    __attribute__((visibility("hidden")));
+
+// First code run on the stack of a new task. Calls the function in %r13 with
+// the argument in %r12. The function must not return.
+void asylo_task_trampoline() __attribute__((visibility("hidden")));
+
+}  // extern "C"
+
+asm(R"(
+    .text
+    .globl asylo_task_swap_context
+    .hidden asylo_task_swap_context
+    .type asylo_task_swap_context, @function
+asylo_task_swap_context:
+    pushq %rbp
+    pushq %rbx
+    pushq %r12
+    pushq %r13
+    pushq %r14
+    pushq %r15
+    subq $8, %rsp
+    stmxcsr (%rsp)
+    fnstcw 4(%rsp)
+    movq %rsp, (%rdi)
+    movq %rsi, %rsp
+    ldmxcsr (%rsp)
+    fldcw 4(%rsp)
+    addq $8, %rsp
+    popq %r15
+    popq %r14
+    popq %r13
+    popq %r12
+    popq %rbx
+    popq %rbp
+    ret
+    .size asylo_task_swap_context, .-asylo_task_swap_context
+
+    .globl asylo_task_trampoline
+    .hidden asylo_task_trampoline
+    .type asylo_task_trampoline, @function
+asylo_task_trampoline:
+    movq %r12, %rdi
+    andq $-16, %rsp
+    callq *%r13
+    ud2
+    .size asylo_task_trampoline, .-asylo_task_trampoline
+)");
+
+namespace asylo {
+namespace {
+
+// Initial floating point control state of a task: the MXCSR in the low half
+// and the x87 control word in the high half, both at their power-on defaults.
+constexpr uint64_t kInitialFloatingPointControl = 0x0000037f00001f80;
+
+// Number of consecutive passes over the tasks in which all of them were
+// waiting, after which the scheduler yields its CPU on the host.
+constexpr int kIdlePassesBeforeYield = 64;
+
+// Scheduler running a task on the calling thread, or nullptr outside a task.
+thread_local TaskScheduler *current_scheduler = nullptr;
+
+}  // namespace
+
+struct TaskScheduler::Task {
+  std::function<void()> function;
+
+  // If set, the task waits until |*ready| returns true.
+  const std::function<bool()> *ready = nullptr;
+
+  // Saved stack pointer of the task while it is not running.
+  void *stack_pointer = nullptr;
+
+  bool done = false;
+
+  std::unique_ptr<char[]> stack;
+};
+
+TaskScheduler::TaskScheduler(size_t stack_size) : stack_size_(stack_size) {}
+
+TaskScheduler::~TaskScheduler() {
+  if (!tasks_.empty() || running_task_) {
+    primitives::TrustedPrimitives::BestEffortAbort(
+        "TaskScheduler destroyed with tasks remaining.");
+  }
+}
+
+void TaskScheduler::Spawn(std::function<void()> function) {
+  std::unique_ptr<Task> task(new Task);
+  task->function = std::move(function);
+  task->stack.reset(new char[stack_size_]);
+
+  // Lay out the stack as if the task had called asylo_task_swap_context from
+  // the start of asylo_task_trampoline, which then calls RunTask(task).
+  uintptr_t top =
+      (reinterpret_cast<uintptr_t>(task->stack.get()) + stack_size_) &
+      ~uintptr_t{15};
+  uint64_t *stack_pointer = reinterpret_cast<uint64_t *>(top);
+  *--stack_pointer = 0;
+  *--stack_pointer = reinterpret_cast<uint64_t>(&asylo_task_trampoline);
+  *--stack_pointer = 0;  // %rbp
+  *--stack_pointer = 0;  // %rbx
+  *--stack_pointer = reinterpret_cast<uint64_t>(task.get());  // %r12
+  *--stack_pointer = reinterpret_cast<uint64_t>(&TaskScheduler::RunTask);
+  *--stack_pointer = 0;  // %r14
+  *--stack_pointer = 0;  // %r15
+  *--stack_pointer = kInitialFloatingPointControl;
+  task->stack_pointer = stack_pointer;
+
+  tasks_.push_back(std::move(task));
+}
+
+void TaskScheduler::Run() {
+  if (InTask()) {
+    primitives::TrustedPrimitives::BestEffortAbort(
+        "TaskScheduler::Run called from a task.");
+  }
+  int idle_passes = 0;
+  while (!tasks_.empty()) {
+    // Tasks spawned during the pass get their first turn in the next pass.
+    size_t pass_length = tasks_.size();
+    bool progressed = false;
+    for (size_t i = 0; i < pass_length; ++i) {
+      running_task_ = std::move(tasks_.front());
+      tasks_.pop_front();
+      if (!running_task_->ready || (*running_task_->ready)()) {
+        running_task_->ready = nullptr;
+        progressed = true;
+        Resume(running_task_.get());
+      }
+      if (running_task_->done) {
+        running_task_.reset();
+      } else {
+        tasks_.push_back(std::move(running_task_));
+      }
+    }
+
+    if (progressed) {
+      idle_passes = 0;
+    } else if (++idle_passes < kIdlePassesBeforeYield) {
+      enc_pause();
+    } else {
+      idle_passes = 0;
+      enc_untrusted_sched_yield();
+    }
+  }
+}
+
+size_t TaskScheduler::num_tasks() const {
+  return tasks_.size() + (running_task_ ? 1 : 0);
+}
+
+bool TaskScheduler::InTask() { return current_scheduler != nullptr; }
+
+void TaskScheduler::Yield() {
+  if (InTask()) {
+    Suspend();
+  }
+}
+
+void TaskScheduler::WaitUntil(const std::function<bool()> &ready) {
+  if (!InTask()) {
+    while (!ready()) {
+      enc_pause();
+    }
+    return;
+  }
+  if (ready()) {
+    return;
+  }
+  current_scheduler->running_task_->ready = &ready;
+  Suspend();
+}
+
+void TaskScheduler::RunTask(Task *task) {
+  task->function();
+  task->function = nullptr;
+  task->done = true;
+  Suspend();
+  primitives::TrustedPrimitives::BestEffortAbort(
+      "TaskScheduler resumed a task which has returned.");
+}
+
+void TaskScheduler::Resume(Task *task) {
+  current_scheduler = this;
+  asylo_task_swap_context(&scheduler_stack_pointer_, task->stack_pointer);
+  current_scheduler = nullptr;
+}
+
+void TaskScheduler::Suspend() {
+  TaskScheduler *scheduler = current_scheduler;
+  asylo_task_swap_context(&scheduler->running_task_->stack_pointer,
+                          scheduler->scheduler_stack_pointer_);
+}
+
+}  // namespace asylo
@@ -0,0 +1,113 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_CORE_TASK_SCHEDULER_H_
+#define ASYLO_PLATFORM_CORE_TASK_SCHEDULER_H_
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+
+namespace asylo {
+
+// A cooperative scheduler which multiplexes many tasks onto the enclave thread
+// that calls Run().
+//
+// Each task runs on its own stack carved out of the enclave heap. A task gives
+// up the thread only when it calls Yield() or WaitUntil(), and the scheduler
+// switches between tasks with a user-space context switch, without exiting the
+// enclave. A task which waits for an asynchronous host call (for instance with
+// UntrustedCallFuture::Await) lets the other tasks run until the call
+// completes, so a few TCS can serve many concurrent requests.
+//
+// A scheduler is driven by a single thread. Tasks must not throw exceptions
+// out of their function, and must fit in their fixed-size stack; there is no
+// guard page to catch a task overflowing its stack.
+//
+// Example:
+//
+//   TaskScheduler scheduler;
+//   for (int fd : client_fds) {
+//     scheduler.Spawn([fd] { ServeClient(fd); });
+//   }
+//   scheduler.Run();
+class TaskScheduler {
+ public:
+  // Default size in bytes of the stack of each task.
+  static constexpr size_t kDefaultStackSize = 64 * 1024;
+
+  // Creates a scheduler whose tasks each get a stack of |stack_size| bytes.
+  explicit TaskScheduler(size_t stack_size = kDefaultStackSize);
+
+  // Destroys the scheduler. Must not be called while tasks remain.
+  ~TaskScheduler();
+
+  TaskScheduler(const TaskScheduler &other) = delete;
+  TaskScheduler &operator=(const TaskScheduler &other) = delete;
+
+  // Adds a task which runs |function|. May be called from a running task.
+  void Spawn(std::function<void()> function);
+
+  // Runs tasks on the calling thread until all of them have returned. Must not
+  // be called from a task.
+  void Run();
+
+  // Returns the number of tasks which have not returned yet.
+  size_t num_tasks() const;
+
+  // Returns true if the caller is running in a task.
+  static bool InTask();
+
+  // Lets the other runnable tasks run before the calling task continues. Does
+  // nothing when called outside a task.
+  static void Yield();
+
+  // Suspends the calling task until |ready| returns true. |ready| is polled by
+  // the scheduler between tasks, so it must be cheap and must not block. When
+  // called outside a task, polls |ready| on the calling thread instead.
+  static void WaitUntil(const std::function<bool()> &ready);
+
+ private:
+  struct Task;
+
+  // Entry point of every task, called on the task's stack.
+  static void RunTask(Task *task);
+
+  // Switches from the scheduler to |task| until the task suspends or returns.
+  void Resume(Task *task);
+
+  // Switches from the calling task back to its scheduler.
+  static void Suspend();
+
+  const size_t stack_size_;
+
+  // Tasks which have not returned and are not running, in the order they get
+  // to run.
+  std::deque<std::unique_ptr<Task>> tasks_;
+
+  // Task taking its turn while Run() is active.
+  std::unique_ptr<Task> running_task_;
+
+  // Stack pointer of the thread running Run() while a task runs.
+  void *scheduler_stack_pointer_ = nullptr;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_CORE_TASK_SCHEDULER_H_
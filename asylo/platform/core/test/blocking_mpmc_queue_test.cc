@@ -0,0 +1,137 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/core/blocking_mpmc_queue.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace {
+
+using ::testing::Eq;
+using ::testing::Pointee;
+
+constexpr int kNumProducers = 4;
+constexpr int kNumConsumers = 4;
+constexpr int kItemsPerProducer = 5000;
+
+TEST(BlockingMpmcQueueTest, TryOperationsDoNotBlock) {
+  BlockingMpmcQueue<int> queue(2);
+  int value = 0;
+  EXPECT_FALSE(queue.TryPop(&value));
+  EXPECT_TRUE(queue.TryPush(1));
+  EXPECT_TRUE(queue.TryPush(2));
+  EXPECT_FALSE(queue.TryPush(3));
+  ASSERT_TRUE(queue.TryPop(&value));
+  EXPECT_THAT(value, Eq(1));
+}
+
+TEST(BlockingMpmcQueueTest, PushAndPopMoveOnlyValues) {
+  BlockingMpmcQueue<std::unique_ptr<int>> queue(2);
+  queue.Push(std::unique_ptr<int>(new int(5)));
+  std::unique_ptr<int> value;
+  queue.Pop(&value);
+  EXPECT_THAT(value, Pointee(5));
+}
+
+// A consumer blocked on an empty queue is woken by a later push.
+TEST(BlockingMpmcQueueTest, PopWaitsForPush) {
+  BlockingMpmcQueue<int> queue(2);
+  std::atomic<bool> popped{false};
+  std::thread consumer([&queue, &popped] {
+    int value;
+    queue.Pop(&value);
+    EXPECT_THAT(value, Eq(42));
+    popped = true;
+  });
+  // Give the consumer time to go to sleep on the host.
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(popped);
+  queue.Push(42);
+  consumer.join();
+  EXPECT_TRUE(popped);
+}
+
+// A producer blocked on a full queue is woken by a later pop.
+TEST(BlockingMpmcQueueTest, PushWaitsForPop) {
+  BlockingMpmcQueue<int> queue(2);
+  queue.Push(1);
+  queue.Push(2);
+  std::atomic<bool> pushed{false};
+  std::thread producer([&queue, &pushed] {
+    queue.Push(3);
+    pushed = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(pushed);
+  int value;
+  queue.Pop(&value);
+  EXPECT_THAT(value, Eq(1));
+  producer.join();
+  EXPECT_TRUE(pushed);
+  queue.Pop(&value);
+  EXPECT_THAT(value, Eq(2));
+  queue.Pop(&value);
+  EXPECT_THAT(value, Eq(3));
+}
+
+// Every element pushed by blocking producers through a small queue is popped
+// exactly once by blocking consumers.
+TEST(BlockingMpmcQueueTest, ConcurrentProducersAndConsumers) {
+  BlockingMpmcQueue<int> queue(4);
+  std::vector<std::atomic<int>> seen(kNumProducers * kItemsPerProducer);
+  for (auto &count : seen) {
+    count = 0;
+  }
+
+  std::vector<std::thread> threads;
+  for (int producer = 0; producer < kNumProducers; ++producer) {
+    threads.emplace_back([&queue, producer] {
+      for (int i = 0; i < kItemsPerProducer; ++i) {
+        queue.Push(producer * kItemsPerProducer + i);
+      }
+    });
+  }
+  for (int consumer = 0; consumer < kNumConsumers; ++consumer) {
+    threads.emplace_back([&queue, &seen] {
+      for (int i = 0; i < kItemsPerProducer * kNumProducers / kNumConsumers;
+           ++i) {
+        int value;
+        queue.Pop(&value);
+        seen[value]++;
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  for (const auto &count : seen) {
+    EXPECT_THAT(count.load(), Eq(1));
+  }
+}
+
+}  // namespace
+}  // namespace asylo
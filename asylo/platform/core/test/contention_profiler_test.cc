@@ -0,0 +1,174 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/core/contention_profiler.h"
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace {
+
+using ::testing::Eq;
+using ::testing::Ge;
+using ::testing::HasSubstr;
+using ::testing::IsEmpty;
+using ::testing::SizeIs;
+
+class ContentionProfilerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ResetContentionProfile();
+    EnableContentionProfiling(true);
+  }
+
+  void TearDown() override {
+    EnableContentionProfiling(false);
+    ResetContentionProfile();
+  }
+};
+
+void WaitOn(const void *lock, const void *caller) {
+  ScopedLockWait wait(lock, caller);
+  std::this_thread::sleep_for(std::chrono::microseconds(50));
+}
+
+TEST_F(ContentionProfilerTest, DisabledProfilerRecordsNothing) {
+  EnableContentionProfiling(false);
+  int lock;
+  WaitOn(&lock, nullptr);
+  RecordFutexWait();
+  RecordFutexWake();
+  RecordThreadQueueDepth(3);
+
+  ContentionProfile profile = GetContentionProfile();
+  EXPECT_THAT(profile.sites, IsEmpty());
+  EXPECT_THAT(profile.events, IsEmpty());
+  EXPECT_THAT(profile.futex_waits, Eq(0));
+  EXPECT_THAT(profile.futex_wakes, Eq(0));
+  EXPECT_THAT(profile.thread_enqueues, Eq(0));
+}
+
+TEST_F(ContentionProfilerTest, AggregatesWaitsPerSite) {
+  int lock;
+  int first_caller;
+  int second_caller;
+  WaitOn(&lock, &first_caller);
+  WaitOn(&lock, &first_caller);
+  WaitOn(&lock, &second_caller);
+
+  ContentionProfile profile = GetContentionProfile();
+  ASSERT_THAT(profile.sites, SizeIs(2));
+  uint64_t total_contentions = 0;
+  for (const LockContentionStats &site : profile.sites) {
+    EXPECT_THAT(site.lock, Eq(&lock));
+    EXPECT_THAT(site.total_wait_nanos, Ge(site.max_wait_nanos));
+    EXPECT_THAT(site.max_wait_nanos, Ge(50000));
+    if (site.caller == &first_caller) {
+      EXPECT_THAT(site.contentions, Eq(2));
+    } else {
+      EXPECT_THAT(site.caller, Eq(&second_caller));
+      EXPECT_THAT(site.contentions, Eq(1));
+    }
+    total_contentions += site.contentions;
+  }
+  EXPECT_THAT(total_contentions, Eq(3));
+  ASSERT_THAT(profile.events, SizeIs(3));
+  EXPECT_THAT(profile.events[2].caller, Eq(&second_caller));
+  EXPECT_THAT(profile.events[1].start_nanos,
+              Ge(profile.events[0].start_nanos + profile.events[0].wait_nanos));
+}
+
+TEST_F(ContentionProfilerTest, CountsSpinsWithoutEvents) {
+  int lock;
+  int caller;
+  RecordSpinWait(&lock, &caller, 10);
+  RecordSpinWait(&lock, &caller, 5);
+
+  ContentionProfile profile = GetContentionProfile();
+  ASSERT_THAT(profile.sites, SizeIs(1));
+  EXPECT_THAT(profile.sites[0].lock, Eq(&lock));
+  EXPECT_THAT(profile.sites[0].caller, Eq(&caller));
+  EXPECT_THAT(profile.sites[0].contentions, Eq(2));
+  EXPECT_THAT(profile.sites[0].total_spins, Eq(15));
+  EXPECT_THAT(profile.sites[0].total_wait_nanos, Eq(0));
+  EXPECT_THAT(profile.events, IsEmpty());
+}
+
+TEST_F(ContentionProfilerTest, KeepsMostRecentEvents) {
+  int lock;
+  for (size_t i = 0; i < kMaxContentionEvents + 10; ++i) {
+    ScopedLockWait wait(&lock, reinterpret_cast<const void *>(i + 1));
+  }
+  ContentionProfile profile = GetContentionProfile();
+  ASSERT_THAT(profile.events, SizeIs(kMaxContentionEvents));
+  EXPECT_THAT(profile.events.front().caller,
+              Eq(reinterpret_cast<const void *>(11)));
+  EXPECT_THAT(profile.events.back().caller,
+              Eq(reinterpret_cast<const void *>(kMaxContentionEvents + 10)));
+
+  // Sites beyond the table capacity are still counted.
+  uint64_t total_contentions = profile.untracked_contentions;
+  for (const LockContentionStats &site : profile.sites) {
+    total_contentions += site.contentions;
+  }
+  EXPECT_THAT(total_contentions, Eq(kMaxContentionEvents + 10));
+}
+
+TEST_F(ContentionProfilerTest, CountsFutexAndQueueDepth) {
+  constexpr int kNumThreads = 8;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back([i] {
+      RecordFutexWait();
+      RecordFutexWake();
+      RecordFutexWake();
+      RecordThreadQueueDepth(i + 1);
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  ContentionProfile profile = GetContentionProfile();
+  EXPECT_THAT(profile.futex_waits, Eq(kNumThreads));
+  EXPECT_THAT(profile.futex_wakes, Eq(2 * kNumThreads));
+  EXPECT_THAT(profile.thread_enqueues, Eq(kNumThreads));
+  EXPECT_THAT(profile.total_thread_queue_depth,
+              Eq(kNumThreads * (kNumThreads + 1) / 2));
+  EXPECT_THAT(profile.max_thread_queue_depth, Eq(kNumThreads));
+}
+
+TEST_F(ContentionProfilerTest, FormatsChromeTrace) {
+  int lock;
+  WaitOn(&lock, nullptr);
+  RecordFutexWait();
+  std::string trace = ContentionProfileToChromeTrace(GetContentionProfile());
+  EXPECT_THAT(trace, HasSubstr("{\"traceEvents\":[{\"name\":\"lock "));
+  EXPECT_THAT(trace, HasSubstr("\"ph\":\"X\""));
+  EXPECT_THAT(trace, HasSubstr("\"contentions\":1,"));
+  EXPECT_THAT(trace, HasSubstr("\"futex_waits\":1,"));
+}
+
+}  // namespace
+}  // namespace asylo
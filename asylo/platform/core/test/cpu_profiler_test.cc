@@ -0,0 +1,177 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/core/cpu_profiler.h"
+
+#include <sys/ucontext.h>
+#include <time.h>
+
+#include <cstdint>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "asylo/test/util/status_matchers.h"
+
+namespace asylo {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::Gt;
+using ::testing::IsEmpty;
+using ::testing::SizeIs;
+using ::testing::UnorderedElementsAre;
+
+// Memory standing in for the enclave, holding both fake code and fake stack
+// frames.
+uint64_t trusted_memory[64];
+
+bool IsTrustedMemory(const void *addr, size_t size) {
+  auto begin = reinterpret_cast<uintptr_t>(trusted_memory);
+  auto end = begin + sizeof(trusted_memory);
+  auto address = reinterpret_cast<uintptr_t>(addr);
+  return address >= begin && address <= end && size <= end - address;
+}
+
+bool IsNeverTrusted(const void *addr, size_t size) { return false; }
+
+uint64_t Address(size_t index) {
+  return reinterpret_cast<uintptr_t>(&trusted_memory[index]);
+}
+
+ucontext_t MakeContext(uint64_t pc, uint64_t fp) {
+  ucontext_t context = {};
+  context.uc_mcontext.gregs[16] = pc;
+  context.uc_mcontext.gregs[10] = fp;
+  return context;
+}
+
+class CpuProfilerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    // The timer of the lowest frequency does not fire before it is stopped.
+    ASSERT_THAT(StartCpuProfiling(1, IsTrustedMemory), IsOk());
+    ASSERT_THAT(StopCpuProfiling(), IsOk());
+    ResetCpuProfile();
+
+    // Three frame records, each pointing to the next one.
+    trusted_memory[10] = Address(20);
+    trusted_memory[11] = Address(1);
+    trusted_memory[20] = Address(30);
+    trusted_memory[21] = Address(2);
+    trusted_memory[30] = 0;
+    trusted_memory[31] = Address(3);
+  }
+
+  void TearDown() override { ResetCpuProfile(); }
+};
+
+TEST_F(CpuProfilerTest, FollowsFramePointers) {
+  ucontext_t context = MakeContext(Address(0), Address(10));
+  RecordCpuSample(&context);
+  RecordCpuSample(&context);
+
+  CpuProfile profile = GetCpuProfile();
+  ASSERT_THAT(profile.stacks, SizeIs(1));
+  EXPECT_THAT(profile.stacks[0].frames,
+              ElementsAre(Address(0), Address(1), Address(2), Address(3)));
+  EXPECT_THAT(profile.stacks[0].samples, Eq(2));
+  EXPECT_THAT(profile.period_micros, Eq(1000000));
+}
+
+TEST_F(CpuProfilerTest, StopsAtFramesOutsideTheEnclave) {
+  // A frame pointer outside the enclave ends the stack at the interrupted
+  // code.
+  ucontext_t context = MakeContext(Address(0), 0x1000);
+  RecordCpuSample(&context);
+
+  // A frame record pointing back down ends the stack too.
+  trusted_memory[20] = Address(10);
+  ucontext_t looping_context = MakeContext(Address(5), Address(10));
+  RecordCpuSample(&looping_context);
+
+  CpuProfile profile = GetCpuProfile();
+  ASSERT_THAT(profile.stacks, SizeIs(2));
+  std::vector<std::vector<uint64_t>> stacks = {profile.stacks[0].frames,
+                                               profile.stacks[1].frames};
+  EXPECT_THAT(stacks, UnorderedElementsAre(
+                          ElementsAre(Address(0)),
+                          ElementsAre(Address(5), Address(1), Address(2))));
+}
+
+TEST_F(CpuProfilerTest, CountsSamplesWithoutTrustedContext) {
+  ucontext_t context = MakeContext(0x1000, Address(10));
+  RecordCpuSample(&context);
+  RecordCpuSample(nullptr);
+  RecordCpuSample(nullptr);
+
+  CpuProfile profile = GetCpuProfile();
+  EXPECT_THAT(profile.stacks, IsEmpty());
+  EXPECT_THAT(profile.outside_samples, Eq(1));
+  EXPECT_THAT(profile.unattributed_samples, Eq(2));
+}
+
+TEST_F(CpuProfilerTest, EncodesAndDecodesProfiles) {
+  ucontext_t context = MakeContext(Address(0), Address(10));
+  RecordCpuSample(&context);
+  RecordCpuSample(nullptr);
+  CpuProfile profile = GetCpuProfile();
+
+  CpuProfile decoded;
+  ASYLO_ASSERT_OK_AND_ASSIGN(decoded,
+                             DecodeCpuProfile(EncodeCpuProfile(profile)));
+  EXPECT_THAT(decoded.period_micros, Eq(profile.period_micros));
+  EXPECT_THAT(decoded.anchor_address, Eq(profile.anchor_address));
+  EXPECT_THAT(decoded.unattributed_samples, Eq(1));
+  ASSERT_THAT(decoded.stacks, SizeIs(1));
+  EXPECT_THAT(decoded.stacks[0].frames, Eq(profile.stacks[0].frames));
+  EXPECT_THAT(decoded.stacks[0].samples, Eq(1));
+}
+
+TEST_F(CpuProfilerTest, RejectsMalformedProfiles) {
+  for (const char *encoded :
+       {"", "asylo_cpu_profile 1 2 3", "other 1 2 3 4 5",
+        "asylo_cpu_profile 1 2 3 4 5\nstack 1",
+        "asylo_cpu_profile 1 2 3 4 5\nstack 1 x"}) {
+    EXPECT_THAT(DecodeCpuProfile(encoded),
+                StatusIs(error::GoogleError::INVALID_ARGUMENT))
+        << encoded;
+  }
+}
+
+TEST_F(CpuProfilerTest, RejectsInvalidFrequencies) {
+  EXPECT_THAT(StartCpuProfiling(0, IsTrustedMemory),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+}
+
+TEST_F(CpuProfilerTest, SamplesBusyThreads) {
+  ASSERT_THAT(StartCpuProfiling(1000, IsNeverTrusted), IsOk());
+  timespec start;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
+  timespec now = start;
+  while (now.tv_sec - start.tv_sec < 1 &&
+         GetCpuProfile().outside_samples < 10) {
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+  }
+  ASSERT_THAT(StopCpuProfiling(), IsOk());
+  EXPECT_THAT(GetCpuProfile().outside_samples, Gt(0));
+}
+
+}  // namespace
+}  // namespace asylo
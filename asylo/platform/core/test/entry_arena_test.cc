@@ -0,0 +1,86 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/core/entry_arena.h"
+
+#include <google/protobuf/arena.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "asylo/enclave.pb.h"
+
+namespace asylo {
+namespace {
+
+using ::testing::Eq;
+using ::testing::IsNull;
+using ::testing::Ne;
+
+constexpr size_t kBlockSize = 4096;
+
+TEST(EntryArenaTest, ScopeSetsCurrentArena) {
+  EntryArenaPool pool(kBlockSize, /*max_idle_arenas=*/4);
+  EXPECT_THAT(GetEntryArena(), IsNull());
+  {
+    ScopedEntryArena arena(&pool);
+    EXPECT_THAT(GetEntryArena(), Eq(arena.get()));
+    {
+      ScopedEntryArena nested_arena(&pool);
+      EXPECT_THAT(nested_arena.get(), Ne(arena.get()));
+      EXPECT_THAT(GetEntryArena(), Eq(nested_arena.get()));
+    }
+    EXPECT_THAT(GetEntryArena(), Eq(arena.get()));
+  }
+  EXPECT_THAT(GetEntryArena(), IsNull());
+}
+
+TEST(EntryArenaTest, ArenasAreReusedAndReset) {
+  EntryArenaPool pool(kBlockSize, /*max_idle_arenas=*/4);
+  google::protobuf::Arena *first = nullptr;
+  {
+    ScopedEntryArena arena(&pool);
+    first = arena.get();
+    auto *output =
+        google::protobuf::Arena::CreateMessage<EnclaveOutput>(first);
+    output->mutable_status()->set_code(1);
+    // Grow the arena past its initial block.
+    for (int i = 0; i < 64; ++i) {
+      google::protobuf::Arena::CreateArray<char>(first, kBlockSize / 8);
+    }
+    EXPECT_THAT(first->SpaceAllocated(), Ne(kBlockSize));
+  }
+  EXPECT_THAT(pool.IdleBytes(), Eq(kBlockSize));
+
+  ScopedEntryArena arena(&pool);
+  EXPECT_THAT(arena.get(), Eq(first));
+  EXPECT_THAT(arena.get()->SpaceUsed(), Eq(0));
+  EXPECT_THAT(pool.IdleBytes(), Eq(0));
+}
+
+TEST(EntryArenaTest, IdleArenasAreBounded) {
+  EntryArenaPool pool(kBlockSize, /*max_idle_arenas=*/1);
+  {
+    ScopedEntryArena first(&pool);
+    ScopedEntryArena second(&pool);
+  }
+  EXPECT_THAT(pool.IdleBytes(), Eq(kBlockSize));
+  EXPECT_THAT(pool.ReleaseIdle(), Eq(kBlockSize));
+  EXPECT_THAT(pool.IdleBytes(), Eq(0));
+}
+
+}  // namespace
+}  // namespace asylo
@@ -0,0 +1,198 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/core/init_snapshot.h"
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/flags/flag.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "asylo/crypto/util/byte_container_util.h"
+#include "asylo/identity/sealing/sealed_secret.pb.h"
+#include "asylo/test/util/status_matchers.h"
+#include "asylo/test/util/test_flags.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+namespace {
+
+using ::testing::Eq;
+using ::testing::IsFalse;
+using ::testing::IsTrue;
+
+// A SecretSealer that "seals" secrets by storing them in the clear, and can be
+// made to fail unsealing as if the enclave identity had changed.
+class PlaintextSecretSealer : public SecretSealer {
+ public:
+  explicit PlaintextSecretSealer(bool fail_unseal = false)
+      : fail_unseal_(fail_unseal) {}
+
+  SealingRootType RootType() const override { return LOCAL; }
+
+  std::string RootName() const override { return "PLAINTEXT"; }
+
+  std::vector<EnclaveIdentityExpectation> RootAcl() const override {
+    return {};
+  }
+
+  Status SetDefaultHeader(SealedSecretHeader *header) const override {
+    header->mutable_root_info()->set_sealing_root_type(RootType());
+    header->mutable_root_info()->set_sealing_root_name(RootName());
+    return Status::OkStatus();
+  }
+
+  StatusOr<size_t> MaxMessageSize(
+      const SealedSecretHeader &header) const override {
+    return static_cast<size_t>(1 << 20);
+  }
+
+  StatusOr<uint64_t> MaxSealedMessages(
+      const SealedSecretHeader &header) const override {
+    return static_cast<uint64_t>(1) << 32;
+  }
+
+  Status Seal(const SealedSecretHeader &header,
+              ByteContainerView additional_authenticated_data,
+              ByteContainerView secret, SealedSecret *sealed_secret) override {
+    if (!header.SerializeToString(
+            sealed_secret->mutable_sealed_secret_header())) {
+      return Status(error::GoogleError::INTERNAL, "Bad header");
+    }
+    sealed_secret->set_additional_authenticated_data(
+        CopyToByteContainer<std::string>(additional_authenticated_data));
+    sealed_secret->set_secret_ciphertext(
+        CopyToByteContainer<std::string>(secret));
+    return Status::OkStatus();
+  }
+
+  Status Unseal(const SealedSecret &sealed_secret,
+                CleansingVector<uint8_t> *secret) override {
+    if (fail_unseal_) {
+      return Status(error::GoogleError::PERMISSION_DENIED, "Wrong identity");
+    }
+    secret->assign(sealed_secret.secret_ciphertext().begin(),
+                   sealed_secret.secret_ciphertext().end());
+    return Status::OkStatus();
+  }
+
+ private:
+  const bool fail_unseal_;
+};
+
+class InitSnapshotTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    path_ = absl::StrCat(absl::GetFlag(FLAGS_test_tmpdir), "/init_snapshot");
+    remove(path_.c_str());
+    config_.set_enable_fork(true);
+
+    callbacks_.initialize = [this] {
+      ++initialize_count_;
+      state_ = "initialized state";
+      return Status::OkStatus();
+    };
+    callbacks_.save = [this]() -> StatusOr<std::string> { return state_; };
+    callbacks_.restore = [this](ByteContainerView state) {
+      state_ = CopyToByteContainer<std::string>(state);
+      return Status::OkStatus();
+    };
+  }
+
+  StatusOr<bool> Run(bool fail_unseal = false) {
+    state_.clear();
+    InitSnapshot snapshot(
+        path_, absl::make_unique<PlaintextSecretSealer>(fail_unseal));
+    return snapshot.InitializeOrRestore(config_, callbacks_);
+  }
+
+  std::string path_;
+  EnclaveConfig config_;
+  InitSnapshot::Callbacks callbacks_;
+  int initialize_count_ = 0;
+  std::string state_;
+};
+
+TEST_F(InitSnapshotTest, FirstRunInitializes) {
+  bool restored;
+  ASYLO_ASSERT_OK_AND_ASSIGN(restored, Run());
+  EXPECT_THAT(restored, IsFalse());
+  EXPECT_THAT(initialize_count_, Eq(1));
+  EXPECT_THAT(state_, Eq("initialized state"));
+}
+
+TEST_F(InitSnapshotTest, SecondRunRestores) {
+  ASYLO_ASSERT_OK(Run().status());
+
+  bool restored;
+  ASYLO_ASSERT_OK_AND_ASSIGN(restored, Run());
+  EXPECT_THAT(restored, IsTrue());
+  EXPECT_THAT(initialize_count_, Eq(1));
+  EXPECT_THAT(state_, Eq("initialized state"));
+}
+
+TEST_F(InitSnapshotTest, ChangedConfigInitializes) {
+  ASYLO_ASSERT_OK(Run().status());
+
+  config_.set_enable_fork(false);
+  bool restored;
+  ASYLO_ASSERT_OK_AND_ASSIGN(restored, Run());
+  EXPECT_THAT(restored, IsFalse());
+  EXPECT_THAT(initialize_count_, Eq(2));
+
+  // The snapshot now matches the new configuration.
+  ASYLO_ASSERT_OK_AND_ASSIGN(restored, Run());
+  EXPECT_THAT(restored, IsTrue());
+}
+
+TEST_F(InitSnapshotTest, UnsealFailureInitializes) {
+  ASYLO_ASSERT_OK(Run().status());
+
+  bool restored;
+  ASYLO_ASSERT_OK_AND_ASSIGN(restored, Run(/*fail_unseal=*/true));
+  EXPECT_THAT(restored, IsFalse());
+  EXPECT_THAT(initialize_count_, Eq(2));
+}
+
+TEST_F(InitSnapshotTest, RestoreFailureInitializes) {
+  ASYLO_ASSERT_OK(Run().status());
+
+  callbacks_.restore = [](ByteContainerView state) {
+    return Status(error::GoogleError::DATA_LOSS, "Bad state");
+  };
+  bool restored;
+  ASYLO_ASSERT_OK_AND_ASSIGN(restored, Run());
+  EXPECT_THAT(restored, IsFalse());
+  EXPECT_THAT(initialize_count_, Eq(2));
+  EXPECT_THAT(state_, Eq("initialized state"));
+}
+
+TEST_F(InitSnapshotTest, InitializeFailureIsReturned) {
+  callbacks_.initialize = [] {
+    return Status(error::GoogleError::INTERNAL, "Failed");
+  };
+  EXPECT_THAT(Run(), StatusIs(error::GoogleError::INTERNAL));
+}
+
+}  // namespace
+}  // namespace asylo
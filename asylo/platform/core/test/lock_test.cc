@@ -22,6 +22,7 @@
 #include <gtest/gtest.h>
 #include "asylo/platform/core/trusted_mutex.h"
 #include "asylo/platform/core/trusted_spin_lock.h"
+#include "asylo/platform/core/trusted_ticket_lock.h"
 
 namespace asylo {
 namespace {
@@ -37,7 +38,8 @@ class LockTest : public ::testing::Test {
   LockType non_recursive_;
 };
 
-typedef ::testing::Types<TrustedSpinLock, TrustedMutex> Implementations;
+typedef ::testing::Types<TrustedSpinLock, TrustedMutex,
+                         TrustedTicketLock> Implementations;
 
 TYPED_TEST_SUITE(LockTest, Implementations);
 
@@ -0,0 +1,127 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/core/memory_monitor.h"
+
+#include <cstddef>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::Ge;
+using ::testing::IsEmpty;
+
+class MemoryMonitorTest : public ::testing::Test {
+ protected:
+  MemoryMonitorTest()
+      : monitor_([this] { return HeapUsage{in_use_, in_use_, 1 << 30, 0}; }) {
+  }
+
+  // Registers a subsystem that records the pressure of every reclaim and
+  // releases |release| bytes of heap each time.
+  void RegisterReclaimer(size_t release) {
+    monitor_.Register(
+        "cache", [] { return size_t{0}; },
+        [this, release](MemoryPressure pressure) {
+          reclaims_.push_back(pressure);
+          in_use_ -= release;
+          return release;
+        });
+  }
+
+  size_t in_use_ = 0;
+  std::vector<MemoryPressure> reclaims_;
+  MemoryMonitor monitor_;
+};
+
+TEST_F(MemoryMonitorTest, ReportsHeapAndSubsystemUsage) {
+  in_use_ = 300;
+  monitor_.Register(
+      "first", [] { return size_t{10}; }, nullptr);
+  int second = monitor_.Register(
+      "second", [] { return size_t{20}; }, nullptr);
+
+  MemoryUsageReport report = monitor_.GetUsage();
+  EXPECT_THAT(report.heap.in_use, Eq(300));
+  EXPECT_THAT(report.pressure, Eq(MemoryPressure::kNone));
+  ASSERT_THAT(report.subsystems.size(), Eq(2));
+  EXPECT_THAT(report.subsystems[0].name, Eq("first"));
+  EXPECT_THAT(report.subsystems[1].bytes, Eq(20));
+
+  monitor_.Unregister(second);
+  EXPECT_THAT(monitor_.GetUsage().subsystems.size(), Eq(1));
+}
+
+TEST_F(MemoryMonitorTest, NoThresholdsMeansNoPressure) {
+  RegisterReclaimer(0);
+  in_use_ = 1 << 29;
+  EXPECT_THAT(monitor_.CheckPressure(), Eq(MemoryPressure::kNone));
+  EXPECT_THAT(reclaims_, IsEmpty());
+}
+
+TEST_F(MemoryMonitorTest, ReclaimsWhenThresholdsAreCrossed) {
+  RegisterReclaimer(0);
+  monitor_.SetThresholds(/*moderate_bytes=*/100, /*critical_bytes=*/200);
+
+  in_use_ = 100;
+  EXPECT_THAT(monitor_.CheckPressure(), Eq(MemoryPressure::kNone));
+  in_use_ = 150;
+  EXPECT_THAT(monitor_.CheckPressure(), Eq(MemoryPressure::kModerate));
+  in_use_ = 250;
+  EXPECT_THAT(monitor_.CheckPressure(), Eq(MemoryPressure::kCritical));
+  EXPECT_THAT(reclaims_,
+              ElementsAre(MemoryPressure::kModerate, MemoryPressure::kCritical));
+}
+
+TEST_F(MemoryMonitorTest, ReclaimsAgainOnlyAfterTheHeapGrows) {
+  RegisterReclaimer(0);
+  monitor_.SetThresholds(/*moderate_bytes=*/100, /*critical_bytes=*/0);
+
+  in_use_ = 150;
+  monitor_.CheckPressure();
+  monitor_.CheckPressure();
+  EXPECT_THAT(reclaims_.size(), Eq(1));
+
+  in_use_ = 160;
+  monitor_.CheckPressure();
+  EXPECT_THAT(reclaims_.size(), Eq(2));
+}
+
+TEST_F(MemoryMonitorTest, ReturnsPressureAfterReclaiming) {
+  RegisterReclaimer(100);
+  monitor_.SetThresholds(/*moderate_bytes=*/100, /*critical_bytes=*/0);
+
+  in_use_ = 150;
+  EXPECT_THAT(monitor_.CheckPressure(), Eq(MemoryPressure::kNone));
+  EXPECT_THAT(reclaims_.size(), Eq(1));
+}
+
+TEST(EnclaveMemoryMonitorTest, ReportsTheEnclaveHeap) {
+  HeapUsage heap = MemoryMonitor::GetInstance()->GetUsage().heap;
+  EXPECT_THAT(heap.peak, Ge(heap.in_use));
+  EXPECT_THAT(heap.limit, Ge(heap.peak));
+}
+
+}  // namespace
+}  // namespace asylo
@@ -16,9 +16,13 @@
  *
  */
 
+#include <thread>
+#include <vector>
+
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include "asylo/platform/core/enclave_manager.h"
+#include "asylo/platform/core/shared_resource_manager.h"
 
 namespace asylo {
 namespace {
@@ -119,5 +123,70 @@ TEST(EnclaveResourcesTest, CustomDeleter) {
   EXPECT_EQ(a_string_resource, "custom cleanup strategy was invoked");
 }
 
+TEST(EnclaveResourcesTest, ReferenceKeepsResourceAlive) {
+  SharedResourceManager resources;
+  const SharedName name(kUnspecifiedName, "referenced resource");
+  bool is_alive;
+  auto *resource = new TestResource(&is_alive);
+  resource->value = "referenced resource";
+  ASSERT_TRUE(resources.RegisterManagedResource(name, resource).ok());
+
+  SharedResourceManager::Reference<TestResource> reference =
+      resources.AcquireReference<TestResource>(name);
+  ASSERT_TRUE(reference);
+  EXPECT_EQ(reference->value, "referenced resource");
+
+  // Drop the reference held since registration.
+  EXPECT_TRUE(resources.ReleaseResource(name));
+  EXPECT_TRUE(is_alive);
+
+  SharedResourceManager::Reference<TestResource> copy = reference;
+  reference.reset();
+  EXPECT_FALSE(reference);
+  EXPECT_TRUE(is_alive);
+  EXPECT_EQ(copy.get(), resource);
+
+  copy.reset();
+  EXPECT_FALSE(is_alive);
+  EXPECT_FALSE(resources.AcquireReference<TestResource>(name));
+}
+
+TEST(EnclaveResourcesTest, ReferenceToMissingResourceIsEmpty) {
+  SharedResourceManager resources;
+  const SharedName name(kUnspecifiedName, "missing resource");
+  SharedResourceManager::Reference<TestResource> reference =
+      resources.AcquireReference<TestResource>(name);
+  EXPECT_FALSE(reference);
+  EXPECT_EQ(reference.get(), nullptr);
+}
+
+TEST(EnclaveResourcesTest, ConcurrentReferences) {
+  SharedResourceManager resources;
+  const SharedName name(kUnspecifiedName, "concurrent resource");
+  bool is_alive;
+  ASSERT_TRUE(
+      resources.RegisterManagedResource(name, new TestResource(&is_alive))
+          .ok());
+  auto reference = resources.AcquireReference<TestResource>(name);
+  EXPECT_TRUE(resources.ReleaseResource(name));
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 8; i++) {
+    threads.emplace_back([&reference] {
+      for (int j = 0; j < 10000; j++) {
+        SharedResourceManager::Reference<TestResource> copy = reference;
+        EXPECT_TRUE(*copy->alive);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_TRUE(is_alive);
+
+  reference.reset();
+  EXPECT_FALSE(is_alive);
+}
+
 }  // namespace
 }  // namespace asylo
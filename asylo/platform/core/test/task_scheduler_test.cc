@@ -0,0 +1,133 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/core/task_scheduler.h"
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+
+TEST(TaskSchedulerTest, RunWithoutTasksReturns) {
+  TaskScheduler scheduler;
+  scheduler.Run();
+  EXPECT_THAT(scheduler.num_tasks(), Eq(0));
+}
+
+TEST(TaskSchedulerTest, RunsTasksToCompletion) {
+  TaskScheduler scheduler;
+  std::vector<int> order;
+  for (int i = 0; i < 3; ++i) {
+    scheduler.Spawn([&order, i] { order.push_back(i); });
+  }
+  EXPECT_THAT(scheduler.num_tasks(), Eq(3));
+  scheduler.Run();
+  EXPECT_THAT(order, ElementsAre(0, 1, 2));
+  EXPECT_THAT(scheduler.num_tasks(), Eq(0));
+}
+
+TEST(TaskSchedulerTest, YieldInterleavesTasks) {
+  TaskScheduler scheduler;
+  std::string trace;
+  for (char name : {'a', 'b'}) {
+    scheduler.Spawn([&trace, name] {
+      for (int i = 0; i < 3; ++i) {
+        EXPECT_TRUE(TaskScheduler::InTask());
+        trace.push_back(name);
+        TaskScheduler::Yield();
+      }
+    });
+  }
+  EXPECT_FALSE(TaskScheduler::InTask());
+  scheduler.Run();
+  EXPECT_THAT(trace, Eq("ababab"));
+}
+
+TEST(TaskSchedulerTest, WaitUntilResumesOnceReady) {
+  TaskScheduler scheduler;
+  bool ready = false;
+  std::vector<std::string> events;
+  scheduler.Spawn([&] {
+    TaskScheduler::WaitUntil([&ready] { return ready; });
+    events.push_back("waiter resumed");
+  });
+  scheduler.Spawn([&] {
+    for (int i = 0; i < 5; ++i) {
+      TaskScheduler::Yield();
+    }
+    events.push_back("signaller ready");
+    ready = true;
+  });
+  scheduler.Run();
+  EXPECT_THAT(events, ElementsAre("signaller ready", "waiter resumed"));
+}
+
+TEST(TaskSchedulerTest, TasksMaySpawnTasks) {
+  TaskScheduler scheduler;
+  int count = 0;
+  scheduler.Spawn([&] {
+    for (int i = 0; i < 10; ++i) {
+      scheduler.Spawn([&count] { ++count; });
+    }
+  });
+  scheduler.Run();
+  EXPECT_THAT(count, Eq(10));
+}
+
+// Each task keeps its own locals, including floating point state, across
+// switches.
+TEST(TaskSchedulerTest, PreservesTaskState) {
+  constexpr int kNumTasks = 200;
+  TaskScheduler scheduler(/*stack_size=*/16 * 1024);
+  std::vector<double> results(kNumTasks);
+  for (int task = 0; task < kNumTasks; ++task) {
+    scheduler.Spawn([&results, task] {
+      double sum = 0;
+      for (int i = 1; i <= 10; ++i) {
+        sum += std::sqrt(static_cast<double>(task * i));
+        TaskScheduler::Yield();
+      }
+      results[task] = sum;
+    });
+  }
+  scheduler.Run();
+  for (int task = 0; task < kNumTasks; ++task) {
+    double expected = 0;
+    for (int i = 1; i <= 10; ++i) {
+      expected += std::sqrt(static_cast<double>(task * i));
+    }
+    EXPECT_THAT(results[task], Eq(expected));
+  }
+}
+
+TEST(TaskSchedulerTest, WaitUntilOutsideTaskPolls) {
+  int polls = 0;
+  TaskScheduler::WaitUntil([&polls] { return ++polls == 3; });
+  EXPECT_THAT(polls, Eq(3));
+}
+
+}  // namespace
+}  // namespace asylo
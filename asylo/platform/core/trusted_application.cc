@@ -18,6 +18,7 @@
 
 #include "asylo/platform/core/trusted_application.h"
 
+#include <fcntl.h>
 #include <sys/ucontext.h>
 #include <unistd.h>
 
@@ -25,19 +26,30 @@
 #include <cstdio>
 #include <cstdlib>
 #include <functional>
+#include <memory>
 #include <string>
 #include <utility>
 
+#include <google/protobuf/arena.h>
 #include "absl/memory/memory.h"
 #include "asylo/util/logging.h"
 #include "asylo/identity/init.h"
 #include "asylo/platform/common/enclave_state.h"
+#include "asylo/platform/core/contention_profiler.h"
+#include "asylo/platform/core/cpu_profiler.h"
+#include "asylo/platform/core/entry_arena.h"
 #include "asylo/platform/core/entry_selectors.h"
+#include "asylo/platform/core/load_phase_timer.h"
+#include "asylo/platform/core/memory_monitor.h"
+#include "asylo/platform/core/profile_counters.h"
 #include "asylo/platform/core/shared_name_kind.h"
 #include "asylo/platform/core/trusted_global_state.h"
 #include "asylo/platform/posix/io/io_manager.h"
 #include "asylo/platform/posix/io/native_paths.h"
+#include "asylo/platform/posix/io/output_buffer.h"
+#include "asylo/platform/posix/io/page_cache.h"
 #include "asylo/platform/posix/io/random_devices.h"
+#include "asylo/platform/posix/sockets/socket_stats.h"
 #include "asylo/platform/posix/threading/thread_manager.h"
 #include "asylo/platform/primitives/extent.h"
 #include "asylo/platform/primitives/primitive_status.h"
@@ -46,6 +58,7 @@
 #include "asylo/platform/primitives/util/message.h"
 #include "asylo/platform/primitives/util/status_conversions.h"
 #include "asylo/platform/primitives/util/status_serializer.h"
+#include "asylo/util/binary_log.h"
 #include "asylo/util/posix_error_space.h"
 #include "asylo/util/status.h"
 #include "asylo/util/status_macros.h"
@@ -83,6 +96,12 @@ PrimitiveStatus VerifyTrustedAddressRange(void *address, size_t size) {
   return PrimitiveStatus::OkStatus();
 }
 
+// Returns the timing of the phases of the last enclave initialization.
+EnclaveLoadReport *GetInitReport() {
+  static EnclaveLoadReport *const report = new EnclaveLoadReport();
+  return report;
+}
+
 // Handler installed by the runtime to initialize the enclave.
 PrimitiveStatus Initialize(void *context, MessageReader *in,
                            MessageWriter *out) {
@@ -109,29 +128,53 @@ PrimitiveStatus Initialize(void *context, MessageReader *in,
   }
   if (!result) {
     out->PushByCopy(Extent{output, output_len});
+    // The host reports how long each initialization phase took.
+    std::string report = GetInitReport()->SerializeAsString();
+    out->PushByCopy(Extent{report.data(), report.size()});
   }
   free(output);
   return PrimitiveStatus(result);
 }
 
-// Handler installed by the runtime to invoke the enclave run entry point.
+// Handler installed by the runtime to invoke the enclave run entry point. The
+// input and output messages live on the entry arena, which the application
+// may use for its own messages, and the output is serialized directly into
+// |out| rather than into an intermediate buffer that is then copied.
 PrimitiveStatus Run(void *context, MessageReader *in, MessageWriter *out) {
   ASYLO_RETURN_IF_INCORRECT_READER_ARGUMENTS(*in, 1);
   auto input_extent = in->next();
-  char *output = nullptr;
-  size_t output_len = 0;
-  int result = 0;
+
+  ScopedEntryArena arena;
+  auto *enclave_input =
+      google::protobuf::Arena::CreateMessage<EnclaveInput>(arena.get());
+  auto *enclave_output =
+      google::protobuf::Arena::CreateMessage<EnclaveOutput>(arena.get());
+  Status status;
   try {
-    result = asylo::__asylo_user_run(input_extent.As<char>(),
-                                     input_extent.size(), &output, &output_len);
+    if (!enclave_input->ParseFromArray(input_extent.data(),
+                                       input_extent.size())) {
+      status = Status(error::GoogleError::INVALID_ARGUMENT,
+                      "Failed to parse EnclaveInput");
+    } else if (GetState() != EnclaveState::kRunning) {
+      status = Status(error::GoogleError::FAILED_PRECONDITION,
+                      "Enclave not in state RUNNING");
+    } else {
+      // Invoke the enclave entry-point.
+      status = GetApplicationInstance()->Run(*enclave_input, enclave_output);
+      MemoryMonitor::GetInstance()->CheckPressure();
+    }
   } catch (...) {
     TrustedPrimitives::BestEffortAbort("Uncaught exception in enclave");
   }
-  if (!result) {
-    out->PushByCopy(Extent{output, output_len});
+  status.SaveTo(enclave_output->mutable_status());
+
+  size_t output_len = enclave_output->ByteSizeLong();
+  if (!enclave_output->SerializeToArray(out->Allocate(output_len),
+                                        output_len)) {
+    TrustedPrimitives::DebugPuts(status.ToString().c_str());
+    return PrimitiveStatus(1);
   }
-  free(output);
-  return PrimitiveStatus(result);
+  return PrimitiveStatus::OkStatus();
 }
 
 // Handler installed by the runtime to invoke the enclave finalization entry
@@ -201,7 +244,20 @@ Status InitializeEnvironmentVariables(
 }
 
 Status TrustedApplication::InitializeInternal(const EnclaveConfig &config) {
+  GetInitReport()->Clear();
+  LoadPhaseTimer timer(GetInitReport());
+
   InitializeIO(config);
+  timer.EndPhase("io");
+
+  ThreadManager::GetInstance()->SetThreadPoolOptions(
+      config.max_idle_threads(), config.idle_thread_timeout_ms());
+  EnableContentionProfiling(config.enable_contention_profiling());
+  EnableSocketStats(config.enable_socket_stats());
+  MemoryMonitor::GetInstance()->SetThresholds(
+      config.memory_pressure_moderate_bytes(),
+      config.memory_pressure_critical_bytes());
+  timer.EndPhase("runtime");
   Status status =
       InitializeEnvironmentVariables(config.environment_variables());
   const char *log_directory = config.logging_config().log_directory().c_str();
@@ -209,11 +265,21 @@ Status TrustedApplication::InitializeInternal(const EnclaveConfig &config) {
   if(!InitLogging(log_directory, GetEnclaveName().c_str(), vlog_level)) {
     fprintf(stderr, "Initialization of enclave logging failed\n");
   }
+  SetBinaryLoggingEnabled(config.logging_config().binary_logging());
   if (!status.ok()) {
     LOG(WARNING) << "Initialization of enclave environment variables failed: "
                  << status;
   }
   SetEnclaveConfig(config);
+  if (config.cpu_profile_frequency_hz() > 0) {
+    status = StartCpuProfiling(config.cpu_profile_frequency_hz(),
+                               TrustedPrimitives::IsInsideEnclave);
+    if (!status.ok()) {
+      LOG(WARNING) << "Starting the CPU profiler failed: " << status;
+    }
+  }
+  timer.EndPhase("environment_and_logging");
+
   // This call can fail, but it should not stop the enclave from running.
   status = InitializeEnclaveAssertionAuthorities(
       config.enclave_assertion_authority_configs().begin(),
@@ -222,10 +288,75 @@ Status TrustedApplication::InitializeInternal(const EnclaveConfig &config) {
     LOG(WARNING) << "Initialization of enclave assertion authorities failed: "
                  << status;
   }
+  timer.EndPhase("assertion_authorities");
 
   ASYLO_RETURN_IF_ERROR(VerifyAndSetState(EnclaveState::kInternalInitializing,
                                           EnclaveState::kUserInitializing));
-  return Initialize(config);
+  status = Initialize(config);
+  timer.EndPhase("user_initialize");
+  return status;
+}
+
+// Number of sockets whose statistics are logged at finalization.
+constexpr size_t kLoggedSockets = 16;
+
+// Writes a recorded |profile| to |path|.
+static Status WriteProfile(const std::string &path,
+                           const std::string &profile) {
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return Status(static_cast<error::PosixError>(errno),
+                  "Failed to open profile " + path);
+  }
+  size_t written = 0;
+  while (written < profile.size()) {
+    ssize_t result =
+        write(fd, profile.data() + written, profile.size() - written);
+    if (result < 0) {
+      Status status(static_cast<error::PosixError>(errno),
+                    "Failed to write profile " + path);
+      close(fd);
+      return status;
+    }
+    written += result;
+  }
+  close(fd);
+  return Status::OkStatus();
+}
+
+static io::OutputBufferOptions ToOutputBufferOptions(
+    const OutputBufferingConfig &config) {
+  io::OutputBufferOptions options;
+  switch (config.flush_policy()) {
+    case OutputBufferingConfig::LINE:
+      options.policy = io::FlushPolicy::kLine;
+      break;
+    case OutputBufferingConfig::SIZE:
+      options.policy = io::FlushPolicy::kSize;
+      break;
+    case OutputBufferingConfig::TIME_BOUNDED:
+      options.policy = io::FlushPolicy::kTimeBounded;
+      break;
+    default:
+      options.policy = io::FlushPolicy::kUnbuffered;
+      break;
+  }
+  options.capacity = config.buffer_size();
+  options.max_delay_nanoseconds = config.max_delay_ms() * 1000 * 1000;
+  return options;
+}
+
+// Registers |host_fd| as the next enclave file descriptor, buffering writes to
+// it as configured by |buffering|.
+static void RegisterOutputStream(int host_fd,
+                                 const OutputBufferingConfig &buffering) {
+  auto &io_manager = io::IOManager::GetInstance();
+  io::OutputBufferOptions options = ToOutputBufferOptions(buffering);
+  if (options.policy == io::FlushPolicy::kUnbuffered) {
+    io_manager.RegisterHostFileDescriptor(host_fd);
+  } else {
+    io_manager.RegisterBufferedHostFileDescriptor(host_fd, options);
+  }
 }
 
 void InitializeIO(const EnclaveConfig &config) {
@@ -238,17 +369,33 @@ void InitializeIO(const EnclaveConfig &config) {
     io_manager.RegisterHostFileDescriptor(config.stdin_fd());
   }
   if (config.stdout_fd() >= 0) {
-    io_manager.RegisterHostFileDescriptor(config.stdout_fd());
+    RegisterOutputStream(config.stdout_fd(), config.stdout_buffering());
   }
   if (config.stderr_fd() >= 0) {
-    io_manager.RegisterHostFileDescriptor(config.stderr_fd());
+    RegisterOutputStream(config.stderr_fd(), config.stderr_buffering());
   }
+  io_manager.SetSyslogBuffering(
+      ToOutputBufferOptions(config.logging_config().syslog_buffering()));
 
   // Register handler for / so paths without other handlers are forwarded on to
   // the host system. Paths are registered without the trailing slash, so an
   // empty string is used.
+  std::shared_ptr<io::PageCache> page_cache;
+  if (config.file_page_cache_size() > 0) {
+    page_cache =
+        std::make_shared<io::PageCache>(config.file_page_cache_size());
+    // Under moderate pressure the cache drops half its contents, and under
+    // critical pressure all of them.
+    MemoryMonitor::GetInstance()->Register(
+        "file_page_cache", [page_cache] { return page_cache->size(); },
+        [page_cache](MemoryPressure pressure) {
+          return page_cache->Shrink(pressure == MemoryPressure::kCritical
+                                        ? 0
+                                        : page_cache->size() / 2);
+        });
+  }
   io_manager.RegisterVirtualPathHandler(
-      "", ::absl::make_unique<io::NativePathHandler>());
+      "", ::absl::make_unique<io::NativePathHandler>(std::move(page_cache)));
 
   // Register handlers for /dev/random and /dev/urandom so they can be opened
   // and read like regular files without exiting the enclave.
@@ -277,8 +424,10 @@ int __asylo_user_init(const char *name, const char *config, size_t config_len,
 
   StatusSerializer<StatusProto> status_serializer(output, output_len);
 
-  EnclaveConfig enclave_config;
-  if (!enclave_config.ParseFromArray(config, config_len)) {
+  ScopedEntryArena arena;
+  auto *enclave_config =
+      google::protobuf::Arena::CreateMessage<EnclaveConfig>(arena.get());
+  if (!enclave_config->ParseFromArray(config, config_len)) {
     status = Status(error::GoogleError::INVALID_ARGUMENT,
                     "Failed to parse EnclaveConfig");
     return status_serializer.Serialize(status);
@@ -292,7 +441,7 @@ int __asylo_user_init(const char *name, const char *config, size_t config_len,
 
   SetEnclaveName(name);
   // Invoke the enclave entry-point.
-  status = GetApplicationInstance()->InitializeInternal(enclave_config);
+  status = GetApplicationInstance()->InitializeInternal(*enclave_config);
   if (!status.ok()) {
     SetState(EnclaveState::kUninitialized);
     return status_serializer.Serialize(status);
@@ -328,6 +477,7 @@ int __asylo_user_run(const char *input, size_t input_len, char **output,
 
   // Invoke the enclave entry-point.
   status = GetApplicationInstance()->Run(enclave_input, &enclave_output);
+  MemoryMonitor::GetInstance()->CheckPressure();
   return status_serializer.Serialize(status);
 }
 
@@ -340,8 +490,10 @@ int __asylo_user_fini(const char *input, size_t input_len, char **output,
 
   StatusSerializer<StatusProto> status_serializer(output, output_len);
 
-  asylo::EnclaveFinal enclave_final;
-  if (!enclave_final.ParseFromArray(input, input_len)) {
+  ScopedEntryArena arena;
+  auto *enclave_final =
+      google::protobuf::Arena::CreateMessage<EnclaveFinal>(arena.get());
+  if (!enclave_final->ParseFromArray(input, input_len)) {
     status = Status(error::GoogleError::INVALID_ARGUMENT,
                     "Failed to parse EnclaveFinal");
     return status_serializer.Serialize(status);
@@ -353,11 +505,50 @@ int __asylo_user_fini(const char *input, size_t input_len, char **output,
   }
 
   // Invoke the enclave entry-point.
-  status = GetApplicationInstance()->Finalize(enclave_final);
+  status = GetApplicationInstance()->Finalize(*enclave_final);
+  io::OutputBuffer::FlushAll();
 
   ThreadManager *thread_manager = ThreadManager::GetInstance();
   thread_manager->Finalize();
 
+  StatusOr<const EnclaveConfig *> config_result = GetEnclaveConfig();
+  if (config_result.ok() &&
+      config_result.ValueOrDie()->has_contention_trace_path()) {
+    EnableContentionProfiling(false);
+    Status trace_status = WriteProfile(
+        config_result.ValueOrDie()->contention_trace_path(),
+        ContentionProfileToChromeTrace(GetContentionProfile()));
+    if (!trace_status.ok()) {
+      LOG(WARNING) << trace_status;
+    }
+  }
+  if (config_result.ok() &&
+      config_result.ValueOrDie()->cpu_profile_frequency_hz() > 0) {
+    Status profile_status = StopCpuProfiling();
+    if (profile_status.ok() &&
+        config_result.ValueOrDie()->has_cpu_profile_path()) {
+      profile_status =
+          WriteProfile(config_result.ValueOrDie()->cpu_profile_path(),
+                       EncodeCpuProfile(GetCpuProfile()));
+    }
+    if (!profile_status.ok()) {
+      LOG(WARNING) << profile_status;
+    }
+  }
+  if (HasProfileCounters()) {
+    Status counters_status = FlushProfileCounters(
+        config_result.ok() ? config_result.ValueOrDie()->pgo_profile_path()
+                           : "");
+    if (!counters_status.ok()) {
+      LOG(WARNING) << counters_status;
+    }
+  }
+  if (config_result.ok() &&
+      config_result.ValueOrDie()->enable_socket_stats()) {
+    EnableSocketStats(false);
+    LOG(INFO) << "Socket statistics:\n" << FormatSocketStats(kLoggedSockets);
+  }
+
   SetState(EnclaveState::kFinalized);
   return status_serializer.Serialize(status);
 }
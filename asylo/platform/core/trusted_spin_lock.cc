@@ -22,14 +22,21 @@
 #include <cstdio>
 #include <cstdlib>
 
+#include "asylo/platform/core/contention_profiler.h"
 #include "asylo/platform/primitives/trusted_primitives.h"
 
 namespace asylo {
 
 void TrustedSpinLock::Lock() {
-  while (!TryLock()) {
-    enc_pause();
+  if (TryLock()) {
+    return;
   }
+  uint64_t spins = 0;
+  do {
+    enc_pause();
+    ++spins;
+  } while (!TryLock());
+  RecordSpinWait(this, __builtin_return_address(0), spins);
 }
 
 bool TrustedSpinLock::Owned() const { return owner_ == enc_thread_self(); }
@@ -0,0 +1,96 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/core/trusted_ticket_lock.h"
+
+#include <algorithm>
+#include <atomic>
+
+#include "asylo/platform/core/contention_profiler.h"
+#include "asylo/platform/primitives/trusted_primitives.h"
+
+namespace asylo {
+
+void TrustedTicketLock::Lock() {
+  if (is_recursive_ && owner_ == enc_thread_self()) {
+    recursive_lock_count_++;
+    return;
+  }
+
+  uint32_t ticket = AtomicIncrement(&next_ticket_, std::memory_order_relaxed);
+  uint32_t serving = __atomic_load_n(&now_serving_, __ATOMIC_ACQUIRE);
+  if (serving != ticket) {
+    uint64_t spins = 0;
+    do {
+      ++spins;
+      // Unsigned arithmetic keeps the distance correct across wrap-around.
+      uint32_t pauses = std::min(kMaxPausesPerPoll,
+                                 (ticket - serving) * kPausesPerWaiter);
+      for (uint32_t i = 0; i < pauses; ++i) {
+        enc_pause();
+      }
+      serving = __atomic_load_n(&now_serving_, __ATOMIC_ACQUIRE);
+    } while (serving != ticket);
+    RecordSpinWait(this, __builtin_return_address(0), spins);
+  }
+  owner_ = enc_thread_self();
+  recursive_lock_count_ = 1;
+}
+
+bool TrustedTicketLock::Owned() const { return owner_ == enc_thread_self(); }
+
+bool TrustedTicketLock::TryLock() {
+  if (is_recursive_ && owner_ == enc_thread_self()) {
+    recursive_lock_count_++;
+    return true;
+  }
+
+  // The lock is free exactly when no ticket beyond the one being served was
+  // handed out, so take the next ticket only if it would be served right away.
+  uint32_t serving = __atomic_load_n(&now_serving_, __ATOMIC_ACQUIRE);
+  uint32_t expected = serving;
+  if (!AtomicCompareExchange(&next_ticket_, &expected, serving + 1,
+                             /*weak=*/false, std::memory_order_acquire,
+                             std::memory_order_relaxed)) {
+    return false;
+  }
+  owner_ = enc_thread_self();
+  recursive_lock_count_ = 1;
+  return true;
+}
+
+void TrustedTicketLock::Unlock() {
+  // It is a fatal error to attempt to unlock a lock the calling thread does
+  // not own.
+  if (owner_ != enc_thread_self()) {
+    primitives::TrustedPrimitives::DebugPuts(
+        "TrustedTicketLock::Unlock called by thread that does not own it.");
+    return;
+  }
+
+  recursive_lock_count_--;
+  if (recursive_lock_count_ == 0) {
+    owner_ = kInvalidThread;
+    // Only the owner writes |now_serving_|, so it may be read non-atomically.
+    AtomicStore(&now_serving_, now_serving_ + 1, std::memory_order_release);
+  }
+}
+
+bool TrustedTicketLock::LockDepthIsOne() { return recursive_lock_count_ == 1; }
+
+}  // namespace asylo
@@ -0,0 +1,108 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_CORE_TRUSTED_TICKET_LOCK_H_
+#define ASYLO_PLATFORM_CORE_TRUSTED_TICKET_LOCK_H_
+
+#include <cstdint>
+
+#include "asylo/platform/core/atomic.h"
+#include "asylo/platform/primitives/trusted_runtime.h"
+
+namespace asylo {
+
+// A fair spin lock implementation depending on only trusted resources.
+//
+// A TrustedTicketLock is a drop-in replacement for TrustedSpinLock which grants
+// the lock to waiting threads in the order they asked for it. Each thread
+// takes a ticket and waits for it to be served, so contended acquisitions make
+// a single atomic update rather than repeatedly competing for the lock word,
+// and no thread is starved. Waiting threads back off in proportion to their
+// distance from the head of the queue, which keeps the threads far from being
+// served from polling the shared cache line.
+//
+// The 'alignas' aligns the object to the cache line size and pads the object to
+// the same cache line size.
+class alignas(kCacheLineSize) TrustedTicketLock {
+ public:
+  // Number of pause instructions a waiting thread executes between polls for
+  // each thread queued ahead of it.
+  constexpr static uint32_t kPausesPerWaiter = 32;
+
+  // Upper bound on the number of pause instructions between polls.
+  constexpr static uint32_t kMaxPausesPerPoll = 1024;
+
+  // Initializes an unlocked ticket lock. If |is_recursive| is true, then the
+  // lock may 1) be locked more than once by the caller and 2) does not become
+  // free until it is unlocked a corresponding number of times.
+  constexpr explicit TrustedTicketLock(bool is_recursive)
+      : next_ticket_(0),
+        now_serving_(0),
+        owner_(kInvalidThread),
+        is_recursive_(is_recursive),
+        recursive_lock_count_(0) {}
+
+  ~TrustedTicketLock() = default;
+
+  // If this lock is not already held by the calling thread, blocks until all
+  // threads which called Lock() earlier have released it and then acquires it.
+  // If configured as a recursive lock, a TrustedTicketLock may be acquired
+  // multiple times, in which case it must be unlocked a corresponding number of
+  // times before becoming free.
+  void Lock();
+
+  // Returns true if the calling thread is the owner of the lock.
+  bool Owned() const;
+
+  // Tries to acquire the lock without blocking. Returns true if the lock was
+  // acquired, otherwise false. Fails if any thread holds or waits for the lock.
+  bool TryLock();
+
+  // Releases the lock, which must be held by the calling thread, and hands it
+  // to the longest waiting thread.
+  void Unlock();
+
+  // As TrustedSpinLock::LockDepthIsOne. Only safe to call from a thread which
+  // currently holds the lock.
+  bool LockDepthIsOne();
+
+ private:
+  // The ticket handed to the next thread calling Lock().
+  volatile uint32_t next_ticket_;
+
+  // The ticket of the thread which holds or is next to hold the lock. The lock
+  // is free when it equals |next_ticket_|.
+  volatile uint32_t now_serving_;
+
+  // The enc_thread_self() value of the thread that owns the lock, or zero if
+  // the lock is unlocked.
+  volatile uint64_t owner_;
+
+  // True if this lock has been configured as a recursive lock.
+  const bool is_recursive_;
+
+  // The number of times this lock has been locked recursively.
+  uint64_t recursive_lock_count_;
+};
+
+static_assert(sizeof(TrustedTicketLock) == kCacheLineSize,
+              "TrustedTicketLock must be sizeof a cache line.");
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_CORE_TRUSTED_TICKET_LOCK_H_
@@ -92,7 +92,9 @@ GcmCryptor::GcmCryptor(size_t block_length, const GcmCryptorKey &gcm_key,
     : kBlockLength(block_length),
       kGcmKey(gcm_key),
       kCmacKey(cmac_key),
-      key_id_counter_(0) {}
+      key_id_counter_(0),
+      decryption_contexts_(kDecryptionContextCacheSize),
+      next_decryption_context_(0) {}
 
 std::unique_ptr<GcmCryptor> GcmCryptor::Create(
     size_t block_length, const GcmCryptorKey &master_key) {
@@ -151,7 +153,81 @@ bool GcmCryptor::EncryptBlock(const uint8_t *plaintext_data, uint8_t *token,
   }
 
   absl::MutexLock lock(&mu_);
+  return EncryptBlockLocked(plaintext_data, token, ciphertext_data);
+}
+
+bool GcmCryptor::DecryptBlock(const uint8_t *ciphertext_data,
+                              const uint8_t *token, uint8_t *plaintext_data) {
+  if (ciphertext_data == nullptr || token == nullptr ||
+      plaintext_data == nullptr) {
+    LOG(ERROR) << "Invalid input to GcmCryptor::DecryptBlock.";
+    return false;
+  }
+
+  const Token *tok = reinterpret_cast<const Token *>(token);
+
+  std::shared_ptr<const DerivedContext> context =
+      GetDecryptionContext(tok->key_id);
+  if (!context) {
+    LOG(ERROR) << "Failed to derive key for GcmCryptor::DecryptBlock: "
+               << BsslLastErrorString();
+    return false;
+  }
+
+  return DecryptBlockWithContext(*context, ciphertext_data, *tok,
+                                 plaintext_data);
+}
+
+bool GcmCryptor::EncryptBlocks(uint8_t *sealed_blocks, size_t count) {
+  if (sealed_blocks == nullptr && count > 0) {
+    LOG(ERROR) << "Invalid input to GcmCryptor::EncryptBlocks.";
+    return false;
+  }
 
+  const size_t sealed_block_length = SealedBlockLength();
+  absl::MutexLock lock(&mu_);
+  for (size_t i = 0; i < count; ++i) {
+    uint8_t *sealed_block = sealed_blocks + i * sealed_block_length;
+    if (!EncryptBlockLocked(sealed_block,
+                            sealed_block + kBlockLength + kTagLength,
+                            sealed_block)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool GcmCryptor::DecryptBlocks(uint8_t *sealed_blocks, size_t count) {
+  if (sealed_blocks == nullptr && count > 0) {
+    LOG(ERROR) << "Invalid input to GcmCryptor::DecryptBlocks.";
+    return false;
+  }
+
+  const size_t sealed_block_length = SealedBlockLength();
+  std::shared_ptr<const DerivedContext> context;
+  for (size_t i = 0; i < count; ++i) {
+    uint8_t *sealed_block = sealed_blocks + i * sealed_block_length;
+    const Token *token = reinterpret_cast<const Token *>(
+        sealed_block + kBlockLength + kTagLength);
+    if (!context ||
+        memcmp(context->key_id, token->key_id, kKeyIdLength) != 0) {
+      context = GetDecryptionContext(token->key_id);
+      if (!context) {
+        LOG(ERROR) << "Failed to derive key for GcmCryptor::DecryptBlocks: "
+                   << BsslLastErrorString();
+        return false;
+      }
+    }
+    if (!DecryptBlockWithContext(*context, sealed_block, *token,
+                                 sealed_block)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool GcmCryptor::EncryptBlockLocked(const uint8_t *plaintext_data,
+                                    uint8_t *token, uint8_t *ciphertext_data) {
   if (1 != RAND_bytes(next_token_.nonce, kNonceLength)) {
     LOG(ERROR)
         << "Failed to generate random nonce for GcmCryptor::EncryptBlock: "
@@ -169,7 +245,8 @@ bool GcmCryptor::EncryptBlock(const uint8_t *plaintext_data, uint8_t *token,
       return false;
     }
 
-    if (!GenerateDerivedGcmKey(next_token_.key_id, &next_derived_key_)) {
+    encryption_context_ = CreateDerivedContext(next_token_.key_id);
+    if (!encryption_context_) {
       LOG(ERROR) << "Failed to derive key for GcmCryptor::EncryptBlock: "
                  << BsslLastErrorString();
       return false;
@@ -179,23 +256,13 @@ bool GcmCryptor::EncryptBlock(const uint8_t *plaintext_data, uint8_t *token,
   // Increment the key reuse counter only if the key was successfully generated.
   key_id_counter_++;
 
-  EVP_AEAD_CTX context;
-  if (!EVP_AEAD_CTX_init(
-          &context, EVP_aead_aes_256_gcm(),
-          reinterpret_cast<const uint8_t *>(next_derived_key_.data()),
-          kKeyLength, kTagLength, nullptr)) {
-    LOG(ERROR) << "EVP_AEAD_CTX_init failed: " << BsslLastErrorString();
-    EVP_AEAD_CTX_cleanup(&context);
-    return false;
-  }
-
   size_t ciphertext_length;
   size_t max_ciphertext_length = kBlockLength + kTagLength;
-  if (!EVP_AEAD_CTX_seal(&context, ciphertext_data, &ciphertext_length,
-                         max_ciphertext_length, next_token_.nonce, kNonceLength,
-                         plaintext_data, kBlockLength, nullptr, 0)) {
+  if (!EVP_AEAD_CTX_seal(&encryption_context_->context, ciphertext_data,
+                         &ciphertext_length, max_ciphertext_length,
+                         next_token_.nonce, kNonceLength, plaintext_data,
+                         kBlockLength, nullptr, 0)) {
     LOG(ERROR) << "EVP_AEAD_CTX_seal failed: " << BsslLastErrorString();
-    EVP_AEAD_CTX_cleanup(&context);
     return false;
   }
 
@@ -203,49 +270,23 @@ bool GcmCryptor::EncryptBlock(const uint8_t *plaintext_data, uint8_t *token,
     LOG(ERROR) << "EVP_AEAD_CTX_seal failed to encrypt complete plaintext, "
                << "expected ciphertext_length = " << max_ciphertext_length
                << ", encountered ciphertext_length = " << ciphertext_length;
-    EVP_AEAD_CTX_cleanup(&context);
     return false;
   }
 
   memcpy(token, next_token_.data(), kTokenLength);
-
-  EVP_AEAD_CTX_cleanup(&context);
   return true;
 }
 
-bool GcmCryptor::DecryptBlock(const uint8_t *ciphertext_data,
-                              const uint8_t *token, uint8_t *plaintext_data) {
-  if (ciphertext_data == nullptr || token == nullptr ||
-      plaintext_data == nullptr) {
-    LOG(ERROR) << "Invalid input to GcmCryptor::DecryptBlock.";
-    return false;
-  }
-
-  const Token *tok = reinterpret_cast<const Token *>(token);
-
-  GcmCryptorKey derived_key;
-  if (!GenerateDerivedGcmKey(tok->key_id, &derived_key)) {
-    LOG(ERROR) << "Failed to derive key for GcmCryptor::DecryptBlock: "
-               << BsslLastErrorString();
-    return false;
-  }
-
-  EVP_AEAD_CTX context;
-  if (!EVP_AEAD_CTX_init(&context, EVP_aead_aes_256_gcm(),
-                         reinterpret_cast<const uint8_t *>(derived_key.data()),
-                         kKeyLength, kTagLength, nullptr)) {
-    LOG(ERROR) << "EVP_AEAD_CTX_init failed: " << BsslLastErrorString();
-    EVP_AEAD_CTX_cleanup(&context);
-    return false;
-  }
-
+bool GcmCryptor::DecryptBlockWithContext(const DerivedContext &context,
+                                         const uint8_t *ciphertext_data,
+                                         const Token &token,
+                                         uint8_t *plaintext_data) const {
   size_t plaintext_length;
-  if (!EVP_AEAD_CTX_open(&context, plaintext_data, &plaintext_length,
-                         kBlockLength, tok->nonce, kNonceLength,
+  if (!EVP_AEAD_CTX_open(&context.context, plaintext_data, &plaintext_length,
+                         kBlockLength, token.nonce, kNonceLength,
                          ciphertext_data, kBlockLength + kTagLength, nullptr,
                          0)) {
     LOG(ERROR) << "EVP_AEAD_CTX_open failed: " << BsslLastErrorString();
-    EVP_AEAD_CTX_cleanup(&context);
     return false;
   }
 
@@ -253,11 +294,9 @@ bool GcmCryptor::DecryptBlock(const uint8_t *ciphertext_data,
     LOG(ERROR) << "EVP_AEAD_CTX_open failed to decrypt complete ciphertext, "
                << "expected plaintext_length = " << kBlockLength
                << ", encountered plaintext_length = " << plaintext_length;
-    EVP_AEAD_CTX_cleanup(&context);
     return false;
   }
 
-  EVP_AEAD_CTX_cleanup(&context);
   return true;
 }
 
@@ -266,6 +305,49 @@ bool GcmCryptor::GenerateDerivedGcmKey(const uint8_t *key_id,
   return GenerateDerivedKey(kGcmKey, key_id, dk);
 }
 
+std::unique_ptr<GcmCryptor::DerivedContext> GcmCryptor::CreateDerivedContext(
+    const uint8_t *key_id) {
+  GcmCryptorKey derived_key;
+  if (!GenerateDerivedGcmKey(key_id, &derived_key)) {
+    return nullptr;
+  }
+
+  auto context = absl::make_unique<DerivedContext>();
+  memcpy(context->key_id, key_id, kKeyIdLength);
+  if (!EVP_AEAD_CTX_init(&context->context, EVP_aead_aes_256_gcm(),
+                         reinterpret_cast<const uint8_t *>(derived_key.data()),
+                         kKeyLength, kTagLength, nullptr)) {
+    LOG(ERROR) << "EVP_AEAD_CTX_init failed: " << BsslLastErrorString();
+    return nullptr;
+  }
+  return context;
+}
+
+std::shared_ptr<const GcmCryptor::DerivedContext>
+GcmCryptor::GetDecryptionContext(const uint8_t *key_id) {
+  {
+    absl::MutexLock lock(&decryption_mu_);
+    for (const auto &context : decryption_contexts_) {
+      if (context && memcmp(context->key_id, key_id, kKeyIdLength) == 0) {
+        return context;
+      }
+    }
+  }
+
+  // Derive the key outside of the lock, so that a miss does not stall threads
+  // decrypting with cached contexts.
+  std::shared_ptr<const DerivedContext> context = CreateDerivedContext(key_id);
+  if (!context) {
+    return nullptr;
+  }
+
+  absl::MutexLock lock(&decryption_mu_);
+  decryption_contexts_[next_decryption_context_] = context;
+  next_decryption_context_ =
+      (next_decryption_context_ + 1) % kDecryptionContextCacheSize;
+  return context;
+}
+
 bool GcmCryptor::GetAuthTag(uint8_t out[16], const uint8_t *in,
                             size_t in_len) const {
   if (1 != AES_CMAC(out, reinterpret_cast<const uint8_t *>(kCmacKey.data()),
@@ -287,13 +369,13 @@ GcmCryptor *GcmCryptorRegistry::GetGcmCryptor(size_t block_length,
                                               const GcmCryptorKey &key) {
   absl::MutexLock lock(&mu_);
 
-  auto it = cryptor_registry_.find(key);
-  if (it != cryptor_registry_.end()) {
+  auto &cryptors = cryptor_registry_[block_length];
+  auto it = cryptors.find(key);
+  if (it != cryptors.end()) {
     return it->second.get();
   }
 
-  auto result =
-      cryptor_registry_.emplace(key, GcmCryptor::Create(block_length, key));
+  auto result = cryptors.emplace(key, GcmCryptor::Create(block_length, key));
   return result.first->second.get();
 }
 
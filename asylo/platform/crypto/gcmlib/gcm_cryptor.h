@@ -19,6 +19,7 @@
 #ifndef ASYLO_PLATFORM_CRYPTO_GCMLIB_GCM_CRYPTOR_H_
 #define ASYLO_PLATFORM_CRYPTO_GCMLIB_GCM_CRYPTOR_H_
 
+#include <openssl/aead.h>
 #include <openssl/evp.h>
 
 #include <memory>
@@ -68,6 +69,27 @@ class GcmCryptor {
   bool DecryptBlock(const uint8_t *ciphertext_data, const uint8_t *token,
                     uint8_t *plaintext_data);
 
+  // Returns the length of a sealed block, which holds the ciphertext, the tag
+  // and the token of one block, in this order.
+  size_t SealedBlockLength() const {
+    return kBlockLength + kTagLength + kTokenLength;
+  }
+
+  // Encrypts |count| blocks in place in |sealed_blocks|, an array of |count|
+  // sealed blocks. On input, each sealed block starts with its plaintext. On
+  // output, each holds the ciphertext, tag and token of its block. The blocks
+  // are encrypted under a single acquisition of the encryption lock. Returns
+  // true on success. Returns false otherwise, in which case the content of
+  // |sealed_blocks| is unspecified.
+  bool EncryptBlocks(uint8_t *sealed_blocks, size_t count);
+
+  // Decrypts |count| sealed blocks in place in |sealed_blocks|, leaving the
+  // plaintext of each block at its start. Consecutive blocks encrypted under
+  // the same key ID share a single lookup of the decryption key. Returns true
+  // on success. Returns false otherwise, in which case the content of
+  // |sealed_blocks| is unspecified.
+  bool DecryptBlocks(uint8_t *sealed_blocks, size_t count);
+
   // Generates auth tag, in particular CMAC, for the specified data. Returns
   // true on success, false on failure.
   bool GetAuthTag(uint8_t out[16], const uint8_t *in, size_t in_len) const;
@@ -76,6 +98,10 @@ class GcmCryptor {
   static constexpr size_t kNonceLength = 12;
   static constexpr size_t kKeyIdCycle = 256;
 
+  // Number of AES-GCM contexts kept for decryption. Blocks encrypted together
+  // share a key ID, so decrypting a range of blocks mostly hits the cache.
+  static constexpr size_t kDecryptionContextCacheSize = 8;
+
   struct Token {
     uint8_t nonce[kNonceLength];
     uint8_t key_id[kKeyIdLength];
@@ -84,18 +110,56 @@ class GcmCryptor {
     uint8_t *data() { return nonce; }
   };
 
+  // AES-GCM context initialized with the key derived from |key_id|. Once
+  // initialized, the context may be used by concurrent seal and open calls.
+  struct DerivedContext {
+    DerivedContext() { EVP_AEAD_CTX_zero(&context); }
+    ~DerivedContext() { EVP_AEAD_CTX_cleanup(&context); }
+
+    uint8_t key_id[kKeyIdLength];
+    EVP_AEAD_CTX context;
+  };
+
   GcmCryptor(size_t block_length, const GcmCryptorKey &gcm_key,
              const GcmCryptorKey &cmac_key);
+
+  // Encrypts one block as EncryptBlock() does, with |mu_| already held.
+  bool EncryptBlockLocked(const uint8_t *plaintext_data, uint8_t *token,
+                          uint8_t *ciphertext_data)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Decrypts one block with |context|, which must have been derived from the
+  // key ID in |token|.
+  bool DecryptBlockWithContext(const DerivedContext &context,
+                               const uint8_t *ciphertext_data,
+                               const Token &token,
+                               uint8_t *plaintext_data) const;
+
   bool GenerateDerivedGcmKey(const uint8_t *key_id, GcmCryptorKey *dk);
 
+  // Derives the key for |key_id| and initializes a context with it. Returns
+  // nullptr on failure.
+  std::unique_ptr<DerivedContext> CreateDerivedContext(const uint8_t *key_id);
+
+  // Returns the context for |key_id| from the decryption cache, creating it if
+  // necessary. Returns nullptr on failure.
+  std::shared_ptr<const DerivedContext> GetDecryptionContext(
+      const uint8_t *key_id) ABSL_LOCKS_EXCLUDED(decryption_mu_);
+
   const size_t kBlockLength;
   const GcmCryptorKey kGcmKey;
   const GcmCryptorKey kCmacKey;
   Token next_token_ ABSL_GUARDED_BY(mu_);
   uint64_t key_id_counter_;
-  GcmCryptorKey next_derived_key_ ABSL_GUARDED_BY(mu_);
+  std::unique_ptr<DerivedContext> encryption_context_ ABSL_GUARDED_BY(mu_);
   absl::Mutex mu_;
 
+  // Recently used decryption contexts, replaced in round-robin order.
+  std::vector<std::shared_ptr<const DerivedContext>> decryption_contexts_
+      ABSL_GUARDED_BY(decryption_mu_);
+  size_t next_decryption_context_ ABSL_GUARDED_BY(decryption_mu_);
+  absl::Mutex decryption_mu_;
+
   GcmCryptor(const GcmCryptor &) = delete;
   GcmCryptor &operator=(const GcmCryptor &) = delete;
 };
@@ -109,7 +173,8 @@ class GcmCryptorRegistry {
     return *instance;
   }
 
-  // Accessor to the instance of GCM cryptor associated with a given key.
+  // Accessor to the instance of GCM cryptor associated with a given block
+  // length and key.
   GcmCryptor *GetGcmCryptor(size_t block_length, const GcmCryptorKey &key)
       ABSL_LOCKS_EXCLUDED(mu_);
 
@@ -140,8 +205,10 @@ class GcmCryptorRegistry {
   // primitives interface where system calls might not be available, so we use
   // std::unordered_map instead of absl::flat_hash_map to prevent unsafe system
   // calls made by absl based containers.
-  std::unordered_map<GcmCryptorKey, std::unique_ptr<GcmCryptor>,
-                     SafeBytesHasher>
+  // Cryptors are keyed on the block length first, then on the key.
+  std::unordered_map<
+      size_t, std::unordered_map<GcmCryptorKey, std::unique_ptr<GcmCryptor>,
+                                 SafeBytesHasher>>
       cryptor_registry_ ABSL_GUARDED_BY(mu_);
   absl::Mutex mu_;
 };
@@ -20,6 +20,8 @@
 
 #include <openssl/rand.h>
 
+#include <vector>
+
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include "asylo/crypto/util/bytes.h"
@@ -126,6 +128,99 @@ TEST(GcmCryptorTest, DecryptAfterEncryptInPlaceReturnsOriginalTexts) {
   }
 }
 
+// Tests decryption of blocks encrypted under more key IDs than the cryptor
+// caches, in an order which keeps evicting cached keys.
+TEST(GcmCryptorTest, DecryptAcrossKeyIdsReturnsOriginalTexts) {
+  GcmCryptorKey key;
+  ASSERT_EQ(RAND_bytes(key.data(), key.size()), 1);
+  auto encryptor = GcmCryptor::Create(kBlockLength, key);
+  auto decryptor = GcmCryptor::Create(kBlockLength, key);
+  const int kNumKeyIds = 12;
+  const int kNumMessages = kNumKeyIds * kKeyIdCycle;
+  std::vector<uint8_t> plaintexts(kNumMessages * kBlockLength);
+  std::vector<uint8_t> ciphertexts(kNumMessages * (kBlockLength + kTagLength));
+  std::vector<uint8_t> tokens(kNumMessages * kTokenLength);
+  ASSERT_EQ(RAND_bytes(plaintexts.data(), plaintexts.size()), 1);
+  for (int i = 0; i < kNumMessages; ++i) {
+    ASSERT_TRUE(encryptor->EncryptBlock(
+        &plaintexts[i * kBlockLength], &tokens[i * kTokenLength],
+        &ciphertexts[i * (kBlockLength + kTagLength)]));
+  }
+
+  // Visit one block per key ID in turn, starting from the last key ID.
+  uint8_t decryptor_buffer[kBlockLength];
+  for (int offset = 0; offset < kKeyIdCycle; offset += 37) {
+    for (int key_id = kNumKeyIds - 1; key_id >= 0; --key_id) {
+      int i = key_id * kKeyIdCycle + offset;
+      ASSERT_TRUE(decryptor->DecryptBlock(
+          &ciphertexts[i * (kBlockLength + kTagLength)],
+          &tokens[i * kTokenLength], decryptor_buffer));
+      EXPECT_EQ(
+          memcmp(&plaintexts[i * kBlockLength], decryptor_buffer, kBlockLength),
+          0);
+    }
+  }
+}
+
+// Tests that blocks encrypted together in place decrypt together in place, and
+// that each sealed block can also be decrypted on its own.
+TEST(GcmCryptorTest, DecryptBlocksAfterEncryptBlocksReturnsOriginalTexts) {
+  GcmCryptorKey key;
+  ASSERT_EQ(RAND_bytes(key.data(), key.size()), 1);
+  auto encryptor = GcmCryptor::Create(kBlockLength, key);
+  auto decryptor = GcmCryptor::Create(kBlockLength, key);
+  const size_t sealed_block_length = encryptor->SealedBlockLength();
+  ASSERT_EQ(sealed_block_length, kBlockLength + kTagLength + kTokenLength);
+
+  // Span more than one key ID.
+  const int kNumBlocks = kKeyIdCycle + 10;
+  std::vector<uint8_t> plaintexts(kNumBlocks * kBlockLength);
+  ASSERT_EQ(RAND_bytes(plaintexts.data(), plaintexts.size()), 1);
+  std::vector<uint8_t> sealed_blocks(kNumBlocks * sealed_block_length);
+  for (int i = 0; i < kNumBlocks; ++i) {
+    memcpy(&sealed_blocks[i * sealed_block_length],
+           &plaintexts[i * kBlockLength], kBlockLength);
+  }
+
+  ASSERT_TRUE(encryptor->EncryptBlocks(sealed_blocks.data(), kNumBlocks));
+  std::vector<uint8_t> sealed_copy = sealed_blocks;
+  for (int i = 0; i < kNumBlocks; ++i) {
+    EXPECT_NE(memcmp(&sealed_blocks[i * sealed_block_length],
+                     &plaintexts[i * kBlockLength], kBlockLength),
+              0);
+  }
+
+  ASSERT_TRUE(decryptor->DecryptBlocks(sealed_blocks.data(), kNumBlocks));
+  for (int i = 0; i < kNumBlocks; ++i) {
+    EXPECT_EQ(memcmp(&sealed_blocks[i * sealed_block_length],
+                     &plaintexts[i * kBlockLength], kBlockLength),
+              0);
+  }
+
+  uint8_t decryptor_buffer[kBlockLength];
+  const uint8_t *last_block =
+      &sealed_copy[(kNumBlocks - 1) * sealed_block_length];
+  ASSERT_TRUE(decryptor->DecryptBlock(
+      last_block, last_block + kBlockLength + kTagLength, decryptor_buffer));
+  EXPECT_EQ(memcmp(&plaintexts[(kNumBlocks - 1) * kBlockLength],
+                   decryptor_buffer, kBlockLength),
+            0);
+}
+
+// Tests that DecryptBlocks() fails if any of the blocks was altered.
+TEST(GcmCryptorTest, DecryptBlocksWithAlteredBlockFails) {
+  GcmCryptorKey key;
+  ASSERT_EQ(RAND_bytes(key.data(), key.size()), 1);
+  auto cryptor = GcmCryptor::Create(kBlockLength, key);
+  const size_t sealed_block_length = cryptor->SealedBlockLength();
+  const int kNumBlocks = 4;
+  std::vector<uint8_t> sealed_blocks(kNumBlocks * sealed_block_length);
+  ASSERT_TRUE(cryptor->EncryptBlocks(sealed_blocks.data(), kNumBlocks));
+
+  sealed_blocks[2 * sealed_block_length + 1] ^= 1;
+  EXPECT_FALSE(cryptor->DecryptBlocks(sealed_blocks.data(), kNumBlocks));
+}
+
 // Tests decryption with an altered key.
 TEST(GcmCryptorTest, DecryptWithAlteredKeyFails) {
   uint8_t plaintext[kBlockLength];
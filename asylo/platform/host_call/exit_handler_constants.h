@@ -139,9 +139,41 @@ static constexpr uint64_t kSysFutexWakeHandler =
 static constexpr uint64_t kLocalLifetimeAllocHandler =
     primitives::kSelectorHostCall + 30;
 
+// Exit handler constant for |BatchedSystemCallHandler|.
+static constexpr uint64_t kBatchedSystemCallHandler =
+    primitives::kSelectorHostCall + 31;
+
+// Exit handler constant for |SendMmsgHandler|.
+static constexpr uint64_t kSendMmsgHandler = primitives::kSelectorHostCall + 32;
+
+// Exit handler constant for |RecvMmsgHandler|.
+static constexpr uint64_t kRecvMmsgHandler = primitives::kSelectorHostCall + 33;
+
+// Exit handler constant for |WritevHandler|.
+static constexpr uint64_t kWritevHandler = primitives::kSelectorHostCall + 34;
+
+// Exit handler constant for |ReadvHandler|.
+static constexpr uint64_t kReadvHandler = primitives::kSelectorHostCall + 35;
+
+// Exit handler constant for |AcceptBatchHandler|.
+static constexpr uint64_t kAcceptBatchHandler =
+    primitives::kSelectorHostCall + 36;
+
+// Exit handler constant for |SysFutexWakeBatchHandler|.
+static constexpr uint64_t kSysFutexWakeBatchHandler =
+    primitives::kSelectorHostCall + 37;
+
+// Exit handler constant for |IoUringEnterHandler|.
+static constexpr uint64_t kIoUringEnterHandler =
+    primitives::kSelectorHostCall + 38;
+
+// Exit handler constant for |WriteProfileHandler|.
+static constexpr uint64_t kWriteProfileHandler =
+    primitives::kSelectorHostCall + 39;
+
 // Assert that the largest host call handler lies in
-// [kSelectorHostCall, kSelectorRemote).
-static_assert(kLocalLifetimeAllocHandler < primitives::kSelectorRemote,
+// [kSelectorHostCall, kSelectorRemote). It must name the last handler above.
+static_assert(kWriteProfileHandler < primitives::kSelectorRemote,
               "Cannot have host call handler constant spill over into "
               "|kSelectorRemote|.");
 
@@ -429,12 +429,10 @@ bool SerializenotifyEvents(const char *buf, size_t buf_len, char **out,
   return true;
 }
 
-bool DeserializeInotifyEvents(const char *buf, size_t buf_len,
-                              std::queue<struct inotify_event *> *events) {
-  if (!events) {
-    return false;
-  }
-
+bool DeserializeInotifyEvents(
+    const char *buf, size_t buf_len,
+    const std::function<void(int wd, uint32_t mask, uint32_t cookie,
+                             absl::string_view name)> &handle_event) {
   primitives::MessageReader reader;
   reader.Deserialize(buf, buf_len);
 
@@ -448,18 +446,8 @@ bool DeserializeInotifyEvents(const char *buf, size_t buf_len,
     uint32_t mask = FromkLinuxInotifyEventMask(reader.next<uint32_t>());
     uint32_t cookie = reader.next<uint32_t>();
     Extent name_buf = reader.next();
-
-    auto *new_event_struct = static_cast<struct inotify_event *>(
-        malloc(sizeof(struct inotify_event) + name_buf.size()));
-    new_event_struct->wd = wd;
-    new_event_struct->mask = mask;
-    new_event_struct->cookie = cookie;
-    new_event_struct->len = name_buf.size();
-    if (!name_buf.empty()) {
-      memcpy(new_event_struct->name, name_buf.As<char>(), name_buf.size());
-    }
-
-    events->push(new_event_struct);
+    handle_event(wd, mask, cookie,
+                 absl::string_view(name_buf.As<char>(), name_buf.size()));
   }
   return true;
 }
@@ -25,8 +25,10 @@
 #include <sys/inotify.h>
 #include <sys/socket.h>
 
-#include <queue>
+#include <cstdint>
+#include <functional>
 
+#include "absl/strings/string_view.h"
 #include "asylo/platform/primitives/primitive_status.h"
 #include "asylo/platform/primitives/util/message.h"
 
@@ -79,10 +81,13 @@ void FreeDeserializedIfAddrs(struct ifaddrs *ifa);
 bool SerializenotifyEvents(const char *buf, size_t buf_len, char **out,
                            size_t *len);
 
-// Deserializes a buffer containing list of inotify event structs into a
-// queue of events owned by the caller.
-bool DeserializeInotifyEvents(const char *buf, size_t buf_len,
-                              std::queue<struct inotify_event *> *events);
+// Deserializes a buffer containing list of inotify event structs, passing the
+// fields of each event to |handle_event| in order. The name passed includes the
+// null padding of the event name, if any.
+bool DeserializeInotifyEvents(
+    const char *buf, size_t buf_len,
+    const std::function<void(int wd, uint32_t mask, uint32_t cookie,
+                             absl::string_view name)> &handle_event);
 
 }  // namespace host_call
 }  // namespace asylo
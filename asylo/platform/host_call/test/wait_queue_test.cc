@@ -61,6 +61,50 @@ TEST_F(WaitQueueTest, NotifyOneTest) {
   enc_untrusted_destroy_wait_queue(queue);
 }
 
+TEST_F(WaitQueueTest, NotifyBatchTest) {
+  auto wait = [](int32_t *queue) { enc_untrusted_thread_wait(queue); };
+
+  int32_t *queues[] = {enc_untrusted_create_wait_queue(),
+                       enc_untrusted_create_wait_queue()};
+  std::vector<std::thread> threads;
+  for (int32_t *queue : queues) {
+    enc_untrusted_enable_waiting(queue);
+    threads.emplace_back(wait, queue);
+  }
+  for (int32_t *queue : queues) {
+    enc_untrusted_disable_waiting(queue);
+  }
+  const int32_t num_threads[] = {INT32_MAX, INT32_MAX};
+  enc_untrusted_notify_batch(queues, num_threads, 2);
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+
+TEST_F(WaitQueueTest, DeferredNotifyTest) {
+  constexpr int kNumQueues = 4;
+
+  auto wait = [](int32_t *queue) { enc_untrusted_thread_wait(queue); };
+
+  std::vector<int32_t *> queues;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumQueues; i++) {
+    queues.push_back(enc_untrusted_create_wait_queue());
+    enc_untrusted_enable_waiting(queues.back());
+    threads.emplace_back(wait, queues.back());
+  }
+  {
+    ScopedDeferredNotify deferred_notify;
+    for (int32_t *queue : queues) {
+      enc_untrusted_disable_waiting(queue);
+      enc_untrusted_notify(queue, INT32_MAX);
+    }
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+
 TEST_F(WaitQueueTest, DisabledTest) {
   int32_t *queue = enc_untrusted_create_wait_queue();
   constexpr int kNumIters = 1000;
@@ -17,14 +17,21 @@
  */
 
 #include <errno.h>
+#include <stdint.h>
 
+#include <climits>
+#include <vector>
+
+#include "asylo/platform/core/contention_profiler.h"
 #include "asylo/platform/host_call/exit_handler_constants.h"
 #include "asylo/platform/host_call/trusted/host_call_dispatcher.h"
 #include "asylo/platform/host_call/trusted/host_calls.h"
 #include "asylo/platform/primitives/trusted_primitives.h"
+#include "asylo/platform/system_call/type_conversions/kernel_types.h"
 #include "asylo/platform/system_call/type_conversions/types_functions.h"
 
 using ::asylo::host_call::NonSystemCallDispatcher;
+using ::asylo::primitives::Extent;
 using ::asylo::primitives::MessageReader;
 using ::asylo::primitives::MessageWriter;
 using ::asylo::primitives::TrustedPrimitives;
@@ -32,6 +39,64 @@ using ::asylo::primitives::TrustedPrimitives;
 static constexpr int32_t kWaitQueueEnabled = 0;
 static constexpr int32_t kWaitQueueDisabled = 1;
 
+namespace {
+
+// Maximum number of distinct queues whose wakes a thread defers before issuing
+// them early.
+constexpr size_t kMaxDeferredWakes = 32;
+
+// Wait queue wakes deferred by ScopedDeferredNotify on a thread.
+struct DeferredWakes {
+  // Number of live ScopedDeferredNotify objects.
+  int depth;
+
+  size_t count;
+  int32_t *queues[kMaxDeferredWakes];
+  int32_t num_threads[kMaxDeferredWakes];
+};
+
+thread_local DeferredWakes deferred_wakes;
+
+// Issues the wakes deferred by the calling thread, if any.
+void FlushDeferredWakes() {
+  size_t count = deferred_wakes.count;
+  if (count == 0) {
+    return;
+  }
+  deferred_wakes.count = 0;
+  enc_untrusted_notify_batch(deferred_wakes.queues, deferred_wakes.num_threads,
+                             count);
+}
+
+// Records a wake of |num_threads| threads waiting on |queue|, merging it with a
+// wake of the same queue deferred earlier.
+void DeferWake(int32_t *queue, int32_t num_threads) {
+  for (size_t i = 0; i < deferred_wakes.count; ++i) {
+    if (deferred_wakes.queues[i] == queue) {
+      int32_t &deferred = deferred_wakes.num_threads[i];
+      deferred = num_threads > INT32_MAX - deferred ? INT32_MAX
+                                                    : deferred + num_threads;
+      return;
+    }
+  }
+  if (deferred_wakes.count == kMaxDeferredWakes) {
+    FlushDeferredWakes();
+  }
+  deferred_wakes.queues[deferred_wakes.count] = queue;
+  deferred_wakes.num_threads[deferred_wakes.count] = num_threads;
+  ++deferred_wakes.count;
+}
+
+}  // namespace
+
+ScopedDeferredNotify::ScopedDeferredNotify() { ++deferred_wakes.depth; }
+
+ScopedDeferredNotify::~ScopedDeferredNotify() {
+  if (--deferred_wakes.depth == 0) {
+    FlushDeferredWakes();
+  }
+}
+
 extern "C" {
 
 int enc_untrusted_sys_futex_wait(int32_t *futex, int32_t expected,
@@ -84,6 +149,24 @@ int enc_untrusted_sys_futex_wake(int32_t *futex, int32_t num) {
   return result;
 }
 
+int enc_untrusted_sys_futex_cmp_requeue(int32_t *futex, int32_t num_wake,
+                                        int32_t *target, int32_t num_requeue,
+                                        int32_t expected) {
+  if (!TrustedPrimitives::IsOutsideEnclave(futex, sizeof(int32_t)) ||
+      !TrustedPrimitives::IsOutsideEnclave(target, sizeof(int32_t))) {
+    TrustedPrimitives::BestEffortAbort(
+        "enc_untrusted_sys_futex_cmp_requeue: futex words should be in "
+        "untrusted local memory.");
+  }
+
+  // FUTEX_CMP_REQUEUE takes the number of threads to requeue in place of the
+  // timeout.
+  return EnsureInitializedAndDispatchSyscall(
+      asylo::system_call::kSYS_futex, reinterpret_cast<uint64_t>(futex),
+      kLinux_FUTEX_CMP_REQUEUE, num_wake, static_cast<uint64_t>(num_requeue),
+      reinterpret_cast<uint64_t>(target), expected);
+}
+
 int32_t *enc_untrusted_create_wait_queue() {
   MessageWriter input;
   MessageReader output;
@@ -116,9 +199,60 @@ void enc_untrusted_thread_wait(int32_t *const queue,
 }
 
 void enc_untrusted_notify(int32_t *const queue, int32_t num_threads) {
+  asylo::RecordFutexWake();
+  if (deferred_wakes.depth > 0) {
+    DeferWake(queue, num_threads);
+    return;
+  }
   enc_untrusted_sys_futex_wake(queue, num_threads);
 }
 
+void enc_untrusted_notify_batch(int32_t *const *queues,
+                                const int32_t *num_threads, size_t count) {
+  if (count == 0) {
+    return;
+  }
+  if (count == 1) {
+    enc_untrusted_sys_futex_wake(queues[0], num_threads[0]);
+    return;
+  }
+
+  std::vector<uint64_t> addresses(count);
+  for (size_t i = 0; i < count; ++i) {
+    if (!TrustedPrimitives::IsOutsideEnclave(queues[i], sizeof(int32_t))) {
+      TrustedPrimitives::BestEffortAbort(
+          "enc_untrusted_notify_batch: queues should be in untrusted local "
+          "memory.");
+    }
+    addresses[i] = reinterpret_cast<uint64_t>(queues[i]);
+  }
+
+  // Posted to the switchless ring like any other host call when it is
+  // enabled, so a batch of wakes costs at most one enclave exit.
+  MessageWriter input;
+  MessageReader output;
+  input.PushByReference(Extent{addresses.data(), count});
+  input.PushByReference(Extent{num_threads, count});
+  const auto status = NonSystemCallDispatcher(
+      ::asylo::host_call::kSysFutexWakeBatchHandler, &input, &output);
+  CheckStatusAndParamCount(status, output, "enc_untrusted_notify_batch", 2);
+  int result = output.next<int>();
+  int klinux_errno = output.next<int>();
+  if (result == -1) {
+    errno = FromkLinuxErrorNumber(klinux_errno);
+  }
+}
+
+int enc_untrusted_notify_and_requeue(int32_t *const queue, int32_t value,
+                                     int32_t *const target_queue) {
+  asylo::RecordFutexWake();
+  if (enc_untrusted_sys_futex_cmp_requeue(queue, /*num_wake=*/1, target_queue,
+                                          INT32_MAX, value) == -1) {
+    return -1;
+  }
+  return 0;
+}
+
 void enc_untrusted_disable_waiting(int32_t *const queue) {
   enc_untrusted_wait_queue_set_value(queue, kWaitQueueDisabled);
 }
@@ -133,6 +267,9 @@ void enc_untrusted_wait_queue_set_value(int32_t *const queue, int32_t value) {
 
 void enc_untrusted_thread_wait_value(int32_t *const queue, int32_t value,
                                      uint64_t timeout_microsec) {
+  // The thread to be woken may be the one that would wake this one.
+  FlushDeferredWakes();
+  asylo::RecordFutexWait();
   enc_untrusted_sys_futex_wait(queue, value, timeout_microsec);
 }
 
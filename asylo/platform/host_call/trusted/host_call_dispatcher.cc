@@ -22,15 +22,19 @@
 #include "asylo/platform/primitives/extent.h"
 #include "asylo/platform/primitives/trusted_primitives.h"
 #include "asylo/platform/primitives/util/message.h"
+#include "asylo/platform/system_call/system_call.h"
 #include "asylo/util/status_macros.h"
 
 namespace asylo {
 namespace host_call {
 
-primitives::PrimitiveStatus SystemCallDispatcher(const uint8_t* request_buffer,
-                                                 size_t request_size,
-                                                 uint8_t** response_buffer,
-                                                 size_t* response_size) {
+namespace {
+
+// Sends the serialized system call request in |request_buffer| to the host,
+// and receives the serialized response as the only item of |output|.
+primitives::PrimitiveStatus DispatchSystemCall(
+    const uint8_t* request_buffer, size_t request_size,
+    primitives::MessageReader* output) {
   if (request_size == 0 || request_buffer == nullptr) {
     return primitives::PrimitiveStatus{
         error::GoogleError::FAILED_PRECONDITION,
@@ -43,12 +47,23 @@ primitives::PrimitiveStatus SystemCallDispatcher(const uint8_t* request_buffer,
   // untrusted code.
   primitives::MessageWriter input;
   input.PushByReference(primitives::Extent{request_buffer, request_size});
-  primitives::MessageReader output;
   ASYLO_RETURN_IF_ERROR(primitives::TrustedPrimitives::UntrustedCall(
-      kSystemCallHandler, &input, &output));
+      kSystemCallHandler, &input, output));
 
   // The output should only contain the serialized response.
-  ASYLO_RETURN_IF_INCORRECT_READER_ARGUMENTS(output, 1);
+  ASYLO_RETURN_IF_INCORRECT_READER_ARGUMENTS(*output, 1);
+  return primitives::PrimitiveStatus::OkStatus();
+}
+
+}  // namespace
+
+primitives::PrimitiveStatus SystemCallDispatcher(const uint8_t* request_buffer,
+                                                 size_t request_size,
+                                                 uint8_t** response_buffer,
+                                                 size_t* response_size) {
+  primitives::MessageReader output;
+  ASYLO_RETURN_IF_ERROR(
+      DispatchSystemCall(request_buffer, request_size, &output));
 
   auto response = output.next();
   *response_size = response.size();
@@ -57,7 +72,7 @@ primitives::PrimitiveStatus SystemCallDispatcher(const uint8_t* request_buffer,
   // *response_buffer is expected to be owned by the caller, so we wouldn't
   // worry about freeing the memory we allocate here.
   *response_buffer = reinterpret_cast<uint8_t*>(malloc(*response_size));
-  if (!response_buffer) {
+  if (!*response_buffer) {
     return primitives::PrimitiveStatus{error::GoogleError::RESOURCE_EXHAUSTED,
                                        "Failed to malloc response buffer"};
   }
@@ -66,6 +81,66 @@ primitives::PrimitiveStatus SystemCallDispatcher(const uint8_t* request_buffer,
   return primitives::PrimitiveStatus::OkStatus();
 }
 
+primitives::PrimitiveStatus SystemCallInPlaceDispatcher(
+    const uint8_t* request_buffer, size_t request_size,
+    syscall_response_callback response_callback, void* context) {
+  primitives::MessageReader output;
+  ASYLO_RETURN_IF_ERROR(
+      DispatchSystemCall(request_buffer, request_size, &output));
+
+  // The response is read where the trusted runtime received it, and must not
+  // outlive |output|.
+  auto response = output.next();
+  return response_callback(context, response.As<uint8_t>(), response.size());
+}
+
+primitives::PrimitiveStatus BatchedSystemCallDispatcher(
+    size_t count, const primitives::Extent* requests,
+    primitives::Extent* responses) {
+  if (count == 0 || requests == nullptr || responses == nullptr) {
+    return primitives::PrimitiveStatus{
+        error::GoogleError::FAILED_PRECONDITION,
+        "Empty batch or null requests provided. Need at least one valid "
+        "request to dispatch the host calls."};
+  }
+
+  primitives::MessageWriter input;
+  for (size_t i = 0; i < count; i++) {
+    if (requests[i].empty()) {
+      return primitives::PrimitiveStatus{
+          error::GoogleError::FAILED_PRECONDITION,
+          "Zero-sized request provided in batch."};
+    }
+    input.PushByReference(requests[i]);
+  }
+  primitives::MessageReader output;
+  ASYLO_RETURN_IF_ERROR(primitives::TrustedPrimitives::UntrustedCall(
+      kBatchedSystemCallHandler, &input, &output));
+
+  // The output should contain one serialized response per request.
+  ASYLO_RETURN_IF_INCORRECT_READER_ARGUMENTS(output, count);
+
+  for (size_t i = 0; i < count; i++) {
+    auto response = output.next();
+    responses[i] = primitives::Extent{nullptr, 0};
+    if (response.empty()) {
+      continue;
+    }
+    void* response_buffer = malloc(response.size());
+    if (!response_buffer) {
+      for (size_t j = 0; j < i; j++) {
+        free(responses[j].data());
+      }
+      return primitives::PrimitiveStatus{error::GoogleError::RESOURCE_EXHAUSTED,
+                                         "Failed to malloc response buffer"};
+    }
+    memcpy(response_buffer, response.data(), response.size());
+    responses[i] = primitives::Extent{response_buffer, response.size()};
+  }
+
+  return primitives::PrimitiveStatus::OkStatus();
+}
+
 primitives::PrimitiveStatus NonSystemCallDispatcher(
     uint64_t exit_selector, primitives::MessageWriter* input,
     primitives::MessageReader* output) {
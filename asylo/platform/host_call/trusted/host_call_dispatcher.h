@@ -23,9 +23,11 @@
 
 #include <cstdint>
 
+#include "asylo/platform/primitives/extent.h"
 #include "asylo/platform/primitives/primitive_status.h"
 #include "asylo/platform/primitives/trusted_primitives.h"
 #include "asylo/platform/primitives/util/message.h"
+#include "asylo/platform/system_call/system_call.h"
 
 namespace asylo {
 namespace host_call {
@@ -43,6 +45,29 @@ primitives::PrimitiveStatus SystemCallDispatcher(const uint8_t* request_buffer,
                                                  uint8_t** response_buffer,
                                                  size_t* response_size);
 
+// Provides the dispatcher used for making host calls that are system calls,
+// without copying their responses. This dispatcher is installed as a callback
+// by the |system_call| library, which then prefers it over
+// SystemCallDispatcher. Takes in a serialized |request_buffer|, and passes the
+// serialized response to |response_callback| along with |context|, without
+// allocating a buffer for it. Returns the status of |response_callback| when
+// the host call is dispatched, otherwise a status containing the error code
+// and error message of the dispatch.
+primitives::PrimitiveStatus SystemCallInPlaceDispatcher(
+    const uint8_t* request_buffer, size_t request_size,
+    syscall_response_callback response_callback, void* context);
+
+// Provides the dispatcher used for making batches of independent host calls
+// that are system calls. This dispatcher is installed as a callback by the
+// |system_call| library and sends all |count| serialized |requests| to the host
+// in a single untrusted call. On success, each of |responses| is populated with
+// the serialized response to the corresponding request, allocated by malloc()
+// and owned by the caller, or with an empty extent if the host failed to invoke
+// that request.
+primitives::PrimitiveStatus BatchedSystemCallDispatcher(
+    size_t count, const primitives::Extent* requests,
+    primitives::Extent* responses);
+
 // Provides a dispatcher to wrap the UntrustedCall function and perform basic
 // validations. Used for host calls which are not implemented using syscalls.
 primitives::PrimitiveStatus NonSystemCallDispatcher(
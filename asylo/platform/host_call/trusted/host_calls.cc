@@ -19,6 +19,7 @@
 #include "asylo/platform/host_call/trusted/host_calls.h"
 
 #include <errno.h>
+#include <fcntl.h>
 #include <ifaddrs.h>
 #include <net/if.h>
 #include <netdb.h>
@@ -26,10 +27,13 @@
 #include <sys/statfs.h>
 
 #include <algorithm>
+#include <cstring>
 
 #include "asylo/platform/host_call/exit_handler_constants.h"
 #include "asylo/platform/host_call/serializer_functions.h"
 #include "asylo/platform/primitives/trusted_primitives.h"
+#include "asylo/platform/primitives/util/untrusted_message_writer.h"
+#include "asylo/platform/system_call/type_conversions/kernel_types.h"
 #include "asylo/platform/system_call/type_conversions/types_functions.h"
 
 using ::asylo::host_call::NonSystemCallDispatcher;
@@ -37,6 +41,7 @@ using ::asylo::primitives::Extent;
 using ::asylo::primitives::MessageReader;
 using ::asylo::primitives::MessageWriter;
 using ::asylo::primitives::TrustedPrimitives;
+using ::asylo::primitives::UntrustedArenaMessageWriter;
 
 void CheckStatusAndParamCount(const asylo::primitives::PrimitiveStatus &status,
                               const MessageReader &output, const char *name,
@@ -69,6 +74,34 @@ namespace {
 // getpwuid.
 struct passwd global_passwd;
 
+// Largest number of messages accepted by sendmmsg/recvmmsg; larger requests are
+// truncated, as the Linux kernel does.
+constexpr unsigned int kMaxMmsgMessages = 1024;
+
+// Largest number of connections taken by a single enc_untrusted_accept_batch
+// call.
+constexpr size_t kMaxAcceptBatch = 64;
+
+// Converts splice(2) |flags| to their Linux values. Returns false if |flags|
+// holds a bit with no Linux equivalent.
+bool TokLinuxSpliceFlags(unsigned int flags, unsigned int *klinux_flags) {
+  constexpr struct {
+    unsigned int flag;
+    unsigned int klinux_flag;
+  } kSpliceFlags[] = {{SPLICE_F_MOVE, kLinux_SPLICE_F_MOVE},
+                      {SPLICE_F_NONBLOCK, kLinux_SPLICE_F_NONBLOCK},
+                      {SPLICE_F_MORE, kLinux_SPLICE_F_MORE},
+                      {SPLICE_F_GIFT, kLinux_SPLICE_F_GIFT}};
+  *klinux_flags = 0;
+  for (const auto &splice_flag : kSpliceFlags) {
+    if (flags & splice_flag.flag) {
+      *klinux_flags |= splice_flag.klinux_flag;
+      flags &= ~splice_flag.flag;
+    }
+  }
+  return flags == 0;
+}
+
 size_t CalculateTotalMessageSize(const struct msghdr *msg) {
   size_t total_message_size = 0;
   for (int i = 0; i < msg->msg_iovlen; ++i) {
@@ -77,6 +110,156 @@ size_t CalculateTotalMessageSize(const struct msghdr *msg) {
   return total_message_size;
 }
 
+// Returns the capacity an UntrustedArenaMessageWriter needs to hold
+// |scalars_size| bytes of |scalars| pushed values followed by the msghdr pushed
+// by PushSendMsghdr for |msg|.
+size_t SendMsghdrCapacity(size_t scalars, size_t scalars_size,
+                          const struct msghdr *msg) {
+  return UntrustedArenaMessageWriter::CapacityFor(
+      scalars + 4 + msg->msg_iovlen,
+      scalars_size + msg->msg_namelen + msg->msg_controllen + sizeof(int) +
+          sizeof(uint64_t) + CalculateTotalMessageSize(msg));
+}
+
+// Pushes [msg_name, msg_control, int msg_flags, uint64_t iovlen, iov_0, ...,
+// iov_{iovlen - 1}] for |msg|. Every iovec is pushed by reference as its own
+// extent, so the payload is copied straight out of the caller's buffers when
+// |input| is serialized instead of being staged in a trusted buffer first.
+void PushSendMsghdr(const struct msghdr *msg, MessageWriter *input) {
+  input->PushByReference(Extent{msg->msg_name, msg->msg_namelen});
+  input->PushByReference(Extent{msg->msg_control, msg->msg_controllen});
+  input->Push(msg->msg_flags);
+  input->Push<uint64_t>(msg->msg_iovlen);
+  for (int i = 0; i < msg->msg_iovlen; ++i) {
+    input->PushByReference(
+        Extent{msg->msg_iov[i].iov_base, msg->msg_iov[i].iov_len});
+  }
+}
+
+// Pushes [uint64_t msg_namelen, uint64_t msg_controllen, int msg_flags,
+// uint64_t iovlen, uint64_t iov_len_0, ..., uint64_t iov_len_{iovlen - 1}],
+// describing the buffers of |msg| the host should receive into.
+void PushRecvMsghdr(const struct msghdr *msg, MessageWriter *input) {
+  input->Push<uint64_t>(msg->msg_namelen);
+  input->Push<uint64_t>(msg->msg_controllen);
+  input->Push(msg->msg_flags);
+  input->Push<uint64_t>(msg->msg_iovlen);
+  for (int i = 0; i < msg->msg_iovlen; ++i) {
+    input->Push<uint64_t>(msg->msg_iov[i].iov_len);
+  }
+}
+
+// Reads [msg_name, msg_control, iov_0, ..., iov_{iovlen - 1}] from |output|
+// into the buffers of |msg|, copying each received iovec directly into the
+// matching scattered buffer inside the enclave.
+void ReadRecvMsghdr(MessageReader *output, struct msghdr *msg) {
+  auto msg_name_extent = output->next();
+  // The returned |msg_namelen| should not exceed the buffer size.
+  if (msg_name_extent.size() <= msg->msg_namelen) {
+    msg->msg_namelen = msg_name_extent.size();
+  }
+  memcpy(msg->msg_name, msg_name_extent.As<char>(), msg->msg_namelen);
+
+  auto msg_control_extent = output->next();
+  // The returned |msg_controllen| should not exceed the buffer size.
+  if (msg_control_extent.size() <= msg->msg_controllen) {
+    msg->msg_controllen = msg_control_extent.size();
+  }
+  memcpy(msg->msg_control, msg_control_extent.As<char>(),
+         msg->msg_controllen);
+
+  for (int i = 0; i < msg->msg_iovlen; ++i) {
+    auto msg_iov_extent = output->next();
+    memcpy(msg->msg_iov[i].iov_base, msg_iov_extent.As<char>(),
+           std::min(msg->msg_iov[i].iov_len, msg_iov_extent.size()));
+  }
+}
+
+// Largest number of iovecs accepted by the vectored I/O calls, matching the
+// Linux kernel's UIO_MAXIOV.
+constexpr int kMaxIovecs = 1024;
+
+// Writes the buffers of |iov| to |fd| with a single host call, at |offset| if
+// |positional| is true and at the file offset otherwise. Every iovec is pushed
+// by reference as its own extent, as for sendmsg.
+ssize_t VectoredWrite(int fd, const struct iovec *iov, int iovcnt,
+                      bool positional, off_t offset) {
+  if (iovcnt <= 0 || iovcnt > kMaxIovecs) {
+    errno = EINVAL;
+    return -1;
+  }
+  size_t total_size = 0;
+  for (int i = 0; i < iovcnt; ++i) {
+    total_size += iov[i].iov_len;
+  }
+  // The payload is serialized straight into the untrusted message.
+  UntrustedArenaMessageWriter input(UntrustedArenaMessageWriter::CapacityFor(
+      4 + iovcnt, 2 * sizeof(int) + sizeof(int64_t) + sizeof(uint64_t) +
+                      total_size));
+  input.Push(fd);
+  input.Push<int>(positional);
+  input.Push<int64_t>(offset);
+  input.Push<uint64_t>(iovcnt);
+  for (int i = 0; i < iovcnt; ++i) {
+    input.PushByReference(Extent{iov[i].iov_base, iov[i].iov_len});
+  }
+  MessageReader output;
+
+  const auto status = NonSystemCallDispatcher(
+      ::asylo::host_call::kWritevHandler, &input, &output);
+  CheckStatusAndParamCount(status, output, "enc_untrusted_writev", 2);
+
+  ssize_t result = output.next<ssize_t>();
+  int klinux_errno = output.next<int>();
+  if (result == -1) {
+    errno = FromkLinuxErrorNumber(klinux_errno);
+  }
+  return result;
+}
+
+// Reads from |fd| into the buffers of |iov| with a single host call, at
+// |offset| if |positional| is true and at the file offset otherwise. The host
+// returns one extent per iovec, each copied straight into its buffer.
+ssize_t VectoredRead(int fd, const struct iovec *iov, int iovcnt,
+                     bool positional, off_t offset) {
+  if (iovcnt <= 0 || iovcnt > kMaxIovecs) {
+    errno = EINVAL;
+    return -1;
+  }
+  size_t total_size = 0;
+  MessageWriter input;
+  input.Push(fd);
+  input.Push<int>(positional);
+  input.Push<int64_t>(offset);
+  input.Push<uint64_t>(iovcnt);
+  for (int i = 0; i < iovcnt; ++i) {
+    input.Push<uint64_t>(iov[i].iov_len);
+    total_size += iov[i].iov_len;
+  }
+  MessageReader output;
+
+  const auto status = NonSystemCallDispatcher(
+      ::asylo::host_call::kReadvHandler, &input, &output);
+  CheckStatusAndParamCount(status, output, "enc_untrusted_readv", 2 + iovcnt);
+
+  ssize_t result = output.next<ssize_t>();
+  int klinux_errno = output.next<int>();
+  if (result == -1) {
+    errno = FromkLinuxErrorNumber(klinux_errno);
+    return result;
+  }
+  if (result > total_size) {
+    TrustedPrimitives::BestEffortAbort(
+        "enc_untrusted_readv: result exceeds requested");
+  }
+  for (int i = 0; i < iovcnt; ++i) {
+    auto extent = output.next();
+    memcpy(iov[i].iov_base, extent.As<char>(),
+           std::min(iov[i].iov_len, extent.size()));
+  }
+  return result;
+}
+
 #define PASSWD_HOLDER_FIELD_LENGTH 1024
 
 // Struct for storing the buffers needed by struct passwd members.
@@ -138,8 +321,172 @@ bool PasswdHolderToPasswd(struct passwd_holder *passwd_in,
   return true;
 }
 
+// Parses the |size| bytes of getdents64 records in |buffer| into |entries|.
+// The records come from the host, so every length is checked against the
+// buffer. Returns false if the records are malformed.
+bool ParseDirectoryRecords(const char *buffer, size_t size,
+                           std::vector<HostDirectoryEntry> *entries) {
+  size_t position = 0;
+  while (position < size) {
+    struct klinux_dirent64 header;
+    if (size - position <= sizeof(header)) {
+      return false;
+    }
+    memcpy(&header, buffer + position, sizeof(header));
+    if (header.klinux_d_reclen <= sizeof(header) ||
+        header.klinux_d_reclen > size - position) {
+      return false;
+    }
+    const char *name = buffer + position + sizeof(header);
+    size_t name_capacity = header.klinux_d_reclen - sizeof(header);
+    size_t name_length = strnlen(name, name_capacity);
+    if (name_length == 0 || name_length == name_capacity) {
+      return false;
+    }
+    HostDirectoryEntry entry;
+    entry.inode = header.klinux_d_ino;
+    entry.next_offset = header.klinux_d_off;
+    entry.name.assign(name, name_length);
+    entry.stat_errno = EIO;
+    entries->push_back(std::move(entry));
+    position += header.klinux_d_reclen;
+  }
+  return true;
+}
+
 }  // namespace
 
+int enc_untrusted_getdents_stat(int fd, size_t buffer_size,
+                                std::vector<HostDirectoryEntry> *entries) {
+  entries->clear();
+  std::vector<char> buffer(buffer_size);
+  int64_t size = EnsureInitializedAndDispatchSyscall(
+      asylo::system_call::kSYS_getdents64, fd, buffer.data(), buffer.size());
+  if (size <= 0) {
+    return size;
+  }
+  if (static_cast<size_t>(size) > buffer.size() ||
+      !ParseDirectoryRecords(buffer.data(), size, entries)) {
+    entries->clear();
+    errno = EIO;
+    return -1;
+  }
+
+  // Entries whose attributes cannot be fetched keep a non-zero |stat_errno|,
+  // which callers treat as a cache miss rather than as an error.
+  std::vector<struct klinux_stat> klinux_stats(entries->size());
+  asylo::system_call::SystemCallBatch batch;
+  for (size_t i = 0; i < entries->size(); ++i) {
+    const char *name = (*entries)[i].name.c_str();
+    if (!batch.Add(asylo::system_call::kSYS_newfstatat, fd, name,
+                   &klinux_stats[i], kLinux_AT_SYMLINK_NOFOLLOW)
+             .ok()) {
+      return entries->size();
+    }
+  }
+  if (!EnsureInitializedAndDispatchSyscallBatch(&batch).ok()) {
+    return entries->size();
+  }
+  for (size_t i = 0; i < entries->size(); ++i) {
+    HostDirectoryEntry *entry = &(*entries)[i];
+    if (!batch.status(i).ok()) {
+      continue;
+    }
+    if (batch.result(i) == -1) {
+      entry->stat_errno = batch.error_number(i);
+      continue;
+    }
+    if (FromkLinuxStat(&klinux_stats[i], &entry->attributes)) {
+      entry->attributes.st_mode =
+          FromkLinuxFileModeFlag(klinux_stats[i].klinux_st_mode);
+      entry->stat_errno = 0;
+    }
+  }
+  return entries->size();
+}
+
+void enc_untrusted_syslog_batch(
+    const std::vector<HostSyslogMessage> &messages) {
+  asylo::system_call::SystemCallBatch batch;
+  for (const HostSyslogMessage &message : messages) {
+    batch.Add(asylo::system_call::kSYS_syslog,
+              TokLinuxSyslogPriority(message.priority), message.message,
+              message.length);
+  }
+  EnsureInitializedAndDispatchSyscallBatch(&batch);
+}
+
+int enc_untrusted_accept_batch(
+    int sockfd, int flags, const std::vector<HostSocketOption> &options,
+    size_t max_connections, std::vector<HostAcceptedConnection> *connections) {
+  if (max_connections == 0 || (flags & ~(SOCK_NONBLOCK | SOCK_CLOEXEC))) {
+    errno = EINVAL;
+    return -1;
+  }
+  max_connections = std::min(max_connections, kMaxAcceptBatch);
+
+  std::vector<int32_t> klinux_options;
+  klinux_options.reserve(3 * options.size());
+  for (const HostSocketOption &option : options) {
+    int klinux_option_name =
+        TokLinuxOptionName(option.level, option.option_name);
+    if (klinux_option_name == -1) {
+      errno = ENOPROTOOPT;
+      return -1;
+    }
+    klinux_options.push_back(option.level);
+    klinux_options.push_back(klinux_option_name);
+    klinux_options.push_back(option.value);
+  }
+
+  MessageWriter input;
+  input.Push(sockfd);
+  input.Push(TokLinuxSocketType(flags));
+  input.Push<uint64_t>(max_connections);
+  input.PushByReference(Extent{klinux_options.data(), klinux_options.size()});
+  MessageReader output;
+  const auto status = NonSystemCallDispatcher(
+      ::asylo::host_call::kAcceptBatchHandler, &input, &output);
+  CheckStatusAndParamCount(status, output, "enc_untrusted_accept_batch", 2,
+                           /*match_exact_params=*/false);
+
+  int result = output.next<int>();
+  int klinux_errno = output.next<int>();
+  if (result == -1) {
+    errno = FromkLinuxErrorNumber(klinux_errno);
+    return result;
+  }
+  if (result <= 0 || static_cast<size_t>(result) > max_connections) {
+    TrustedPrimitives::BestEffortAbort(
+        "enc_untrusted_accept_batch: result exceeds requested");
+  }
+  CheckStatusAndParamCount(status, output, "enc_untrusted_accept_batch",
+                           2 + 3 * result);
+
+  for (int i = 0; i < result; ++i) {
+    HostAcceptedConnection connection;
+    connection.fd = output.next<int>();
+    if (connection.fd < 0) {
+      TrustedPrimitives::BestEffortAbort(
+          "enc_untrusted_accept_batch: invalid file descriptor");
+    }
+    int klinux_setup_errno = output.next<int>();
+    connection.setup_errno =
+        klinux_setup_errno ? FromkLinuxErrorNumber(klinux_setup_errno) : 0;
+    auto klinux_sockaddr_buf = output.next();
+    connection.addrlen = sizeof(connection.addr);
+    if (!FromkLinuxSockAddr(
+            klinux_sockaddr_buf.As<struct klinux_sockaddr>(),
+            klinux_sockaddr_buf.size(),
+            reinterpret_cast<struct sockaddr *>(&connection.addr),
+            &connection.addrlen, TrustedPrimitives::BestEffortAbort)) {
+      connection.addrlen = 0;
+    }
+    connections->push_back(connection);
+  }
+  return result;
+}
+
 extern "C" {
 
 int enc_untrusted_access(const char *path_name, int mode) {
@@ -236,8 +583,10 @@ ssize_t enc_untrusted_read(int fd, void *buf, size_t count) {
 }
 
 ssize_t enc_untrusted_write(int fd, const void *buf, size_t count) {
-  return static_cast<ssize_t>(EnsureInitializedAndDispatchSyscall(
-      asylo::system_call::kSYS_write, fd, buf, count));
+  // Written as a single iovec, which is copied out of the enclave only once.
+  struct iovec iov = {const_cast<void *>(buf), count};
+  return VectoredWrite(fd, &iov, /*iovcnt=*/1, /*positional=*/false,
+                       /*offset=*/0);
 }
 
 int enc_untrusted_symlink(const char *target, const char *linkpath) {
@@ -292,10 +641,12 @@ int enc_untrusted_shutdown(int sockfd, int how) {
 }
 
 ssize_t enc_untrusted_send(int sockfd, const void *buf, size_t len, int flags) {
-  return EnsureInitializedAndDispatchSyscall(asylo::system_call::kSYS_sendto,
-                                             sockfd, buf, len, flags,
-                                             /*dest_addr=*/nullptr,
-                                             /*addrlen=*/0);
+  // Sent as a single iovec, which is copied out of the enclave only once.
+  struct iovec iov = {const_cast<void *>(buf), len};
+  struct msghdr msg = {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  return enc_untrusted_sendmsg(sockfd, &msg, flags);
 }
 
 int enc_untrusted_fcntl(int fd, int cmd, ... /* arg */) {
@@ -773,22 +1124,11 @@ int enc_untrusted_connect(int sockfd, const struct sockaddr *addr,
 }
 
 ssize_t enc_untrusted_sendmsg(int sockfd, const struct msghdr *msg, int flags) {
-  size_t total_message_size = CalculateTotalMessageSize(msg);
-  std::unique_ptr<char[]> msg_iov_buffer(new char[total_message_size]);
-  size_t copied_bytes = 0;
-  for (int i = 0; i < msg->msg_iovlen; ++i) {
-    memcpy(msg_iov_buffer.get() + copied_bytes, msg->msg_iov[i].iov_base,
-           msg->msg_iov[i].iov_len);
-    copied_bytes += msg->msg_iov[i].iov_len;
-  }
-
-  MessageWriter input;
+  UntrustedArenaMessageWriter input(
+      SendMsghdrCapacity(/*scalars=*/2, 2 * sizeof(int), msg));
   input.Push(sockfd);
-  input.PushByReference(Extent{msg->msg_name, msg->msg_namelen});
-  input.PushByReference(Extent{msg_iov_buffer.get(), total_message_size});
-  input.PushByReference(Extent{msg->msg_control, msg->msg_controllen});
-  input.Push(msg->msg_flags);
   input.Push(flags);
+  PushSendMsghdr(msg, &input);
   MessageReader output;
 
   const auto status = NonSystemCallDispatcher(
@@ -810,18 +1150,15 @@ ssize_t enc_untrusted_recvmsg(int sockfd, struct msghdr *msg, int flags) {
 
   MessageWriter input;
   input.Push(sockfd);
-  input.Push<uint64_t>(msg->msg_namelen);
-  input.Push<uint64_t>(total_buffer_size);
-  input.Push<uint64_t>(msg->msg_controllen);
-  input.Push(msg->msg_flags);
   input.Push(flags);
+  PushRecvMsghdr(msg, &input);
 
   MessageReader output;
 
   const auto status = NonSystemCallDispatcher(
       ::asylo::host_call::kRecvMsgHandler, &input, &output);
-  CheckStatusAndParamCount(status, output, "enc_untrusted_recvmsg", 2,
-                           /*match_exact_params=*/false);
+  CheckStatusAndParamCount(status, output, "enc_untrusted_recvmsg",
+                           4 + msg->msg_iovlen);
 
   ssize_t result = output.next<ssize_t>();
   int klinux_errno = output.next<int>();
@@ -838,36 +1175,190 @@ ssize_t enc_untrusted_recvmsg(int sockfd, struct msghdr *msg, int flags) {
         "enc_untrusted_recvmsg: result exceeds requested");
   }
 
-  auto msg_name_extent = output.next();
-  // The returned |msg_namelen| should not exceed the buffer size.
-  if (msg_name_extent.size() <= msg->msg_namelen) {
-    msg->msg_namelen = msg_name_extent.size();
+  ReadRecvMsghdr(&output, msg);
+  return result;
+}
+
+int enc_untrusted_sendmmsg(int sockfd, struct mmsghdr *msgvec,
+                           unsigned int vlen, int flags) {
+  vlen = std::min(vlen, kMaxMmsgMessages);
+
+  size_t capacity = UntrustedArenaMessageWriter::CapacityFor(
+      3, 2 * sizeof(int) + sizeof(uint64_t));
+  for (unsigned int i = 0; i < vlen; ++i) {
+    capacity += SendMsghdrCapacity(/*scalars=*/0, 0, &msgvec[i].msg_hdr);
   }
-  memcpy(msg->msg_name, msg_name_extent.As<char>(), msg->msg_namelen);
+  UntrustedArenaMessageWriter input(capacity);
+  input.Push(sockfd);
+  input.Push(flags);
+  input.Push<uint64_t>(vlen);
+  for (unsigned int i = 0; i < vlen; ++i) {
+    PushSendMsghdr(&msgvec[i].msg_hdr, &input);
+  }
+  MessageReader output;
 
-  // A single buffer is passed from the untrusted side, copy it into the
-  // scattered buffers inside the enclave.
-  auto msg_iov_extent = output.next();
-  size_t total_bytes = msg_iov_extent.size();
-  size_t bytes_copied = 0;
-  for (int i = 0; i < msg->msg_iovlen && bytes_copied < total_bytes; ++i) {
-    size_t bytes_to_copy =
-        std::min(msg->msg_iov[i].iov_len, total_bytes - bytes_copied);
-    memcpy(msg->msg_iov[i].iov_base, msg_iov_extent.As<char>() + bytes_copied,
-           bytes_to_copy);
-    bytes_copied += bytes_to_copy;
+  const auto status = NonSystemCallDispatcher(
+      ::asylo::host_call::kSendMmsgHandler, &input, &output);
+  CheckStatusAndParamCount(status, output, "enc_untrusted_sendmmsg", 2,
+                           /*match_exact_params=*/false);
+
+  int result = output.next<int>();
+  int klinux_errno = output.next<int>();
+  // sendmmsg() returns the number of messages sent. On error, -1 is returned,
+  // with errno set to indicate the cause of the error.
+  if (result == -1) {
+    errno = FromkLinuxErrorNumber(klinux_errno);
+    return result;
   }
 
-  auto msg_control_extent = output.next();
-  // The returned |msg_controllen| should not exceed the buffer size.
-  if (msg_control_extent.size() <= msg->msg_controllen) {
-    msg->msg_controllen = msg_control_extent.size();
+  if (static_cast<unsigned int>(result) > vlen ||
+      output.size() != 2 + result) {
+    ::asylo::primitives::TrustedPrimitives::BestEffortAbort(
+        "enc_untrusted_sendmmsg: result exceeds requested");
+  }
+  for (int i = 0; i < result; ++i) {
+    msgvec[i].msg_len = output.next<uint32_t>();
   }
-  memcpy(msg->msg_control, msg_control_extent.As<char>(), msg->msg_controllen);
+  return result;
+}
+
+int enc_untrusted_recvmmsg(int sockfd, struct mmsghdr *msgvec,
+                           unsigned int vlen, int flags,
+                           struct timespec *timeout) {
+  vlen = std::min(vlen, kMaxMmsgMessages);
+
+  MessageWriter input;
+  input.Push(sockfd);
+  input.Push(flags);
+  input.Push<uint64_t>(vlen);
+  int64_t timeout_fields[2];
+  if (timeout) {
+    timeout_fields[0] = timeout->tv_sec;
+    timeout_fields[1] = timeout->tv_nsec;
+    input.PushByCopy(Extent{timeout_fields, sizeof(timeout_fields)});
+  } else {
+    input.PushByCopy(Extent{nullptr, 0});
+  }
+  for (unsigned int i = 0; i < vlen; ++i) {
+    PushRecvMsghdr(&msgvec[i].msg_hdr, &input);
+  }
+  MessageReader output;
+
+  const auto status = NonSystemCallDispatcher(
+      ::asylo::host_call::kRecvMmsgHandler, &input, &output);
+  CheckStatusAndParamCount(status, output, "enc_untrusted_recvmmsg", 2,
+                           /*match_exact_params=*/false);
+
+  int result = output.next<int>();
+  int klinux_errno = output.next<int>();
+  // recvmmsg() returns the number of messages received. On error, -1 is
+  // returned, with errno set to indicate the cause of the error.
+  if (result == -1) {
+    errno = FromkLinuxErrorNumber(klinux_errno);
+    return result;
+  }
+
+  if (static_cast<unsigned int>(result) > vlen) {
+    ::asylo::primitives::TrustedPrimitives::BestEffortAbort(
+        "enc_untrusted_recvmmsg: result exceeds requested");
+  }
+  size_t expected_params = 2;
+  for (int i = 0; i < result; ++i) {
+    expected_params += 3 + msgvec[i].msg_hdr.msg_iovlen;
+  }
+  CheckStatusAndParamCount(status, output, "enc_untrusted_recvmmsg",
+                           expected_params);
+
+  for (int i = 0; i < result; ++i) {
+    uint32_t msg_len = output.next<uint32_t>();
+    if (msg_len > CalculateTotalMessageSize(&msgvec[i].msg_hdr)) {
+      ::asylo::primitives::TrustedPrimitives::BestEffortAbort(
+          "enc_untrusted_recvmmsg: message length exceeds requested");
+    }
+    msgvec[i].msg_len = msg_len;
+    ReadRecvMsghdr(&output, &msgvec[i].msg_hdr);
+  }
+  return result;
+}
+
+ssize_t enc_untrusted_writev(int fd, const struct iovec *iov, int iovcnt) {
+  return VectoredWrite(fd, iov, iovcnt, /*positional=*/false, /*offset=*/0);
+}
+
+ssize_t enc_untrusted_readv(int fd, const struct iovec *iov, int iovcnt) {
+  return VectoredRead(fd, iov, iovcnt, /*positional=*/false, /*offset=*/0);
+}
+
+ssize_t enc_untrusted_pwritev(int fd, const struct iovec *iov, int iovcnt,
+                              off_t offset) {
+  return VectoredWrite(fd, iov, iovcnt, /*positional=*/true, offset);
+}
+
+ssize_t enc_untrusted_preadv(int fd, const struct iovec *iov, int iovcnt,
+                             off_t offset) {
+  return VectoredRead(fd, iov, iovcnt, /*positional=*/true, offset);
+}
 
+int enc_untrusted_fstatat(int dirfd, const char *pathname,
+                          struct stat *statbuf, int flags) {
+  if (flags & ~AT_SYMLINK_NOFOLLOW) {
+    errno = EINVAL;
+    return -1;
+  }
+  int klinux_dirfd = dirfd == AT_FDCWD ? kLinux_AT_FDCWD : dirfd;
+  int klinux_flags = (flags & AT_SYMLINK_NOFOLLOW) ? kLinux_AT_SYMLINK_NOFOLLOW
+                                                   : 0;
+  struct klinux_stat stat_kernel;
+  int result = EnsureInitializedAndDispatchSyscall(
+      asylo::system_call::kSYS_newfstatat, klinux_dirfd, pathname,
+      &stat_kernel, klinux_flags);
+  if (result == 0 && FromkLinuxStat(&stat_kernel, statbuf)) {
+    statbuf->st_mode = FromkLinuxFileModeFlag(stat_kernel.klinux_st_mode);
+  }
   return result;
 }
 
+void *enc_untrusted_mmap_read_only(int fd, size_t length, off_t offset) {
+  int64_t result = EnsureInitializedAndDispatchSyscall(
+      asylo::system_call::kSYS_mmap, /*addr=*/0, length, kLinux_PROT_READ,
+      kLinux_MAP_PRIVATE, fd, offset);
+  if (result == -1) {
+    return nullptr;
+  }
+  return reinterpret_cast<void *>(result);
+}
+
+int enc_untrusted_munmap(void *addr, size_t length) {
+  return EnsureInitializedAndDispatchSyscall(asylo::system_call::kSYS_munmap,
+                                             addr, length);
+}
+
+ssize_t enc_untrusted_sendfile(int out_fd, int in_fd, off_t *offset,
+                               size_t count) {
+  return EnsureInitializedAndDispatchSyscall(asylo::system_call::kSYS_sendfile,
+                                             out_fd, in_fd, offset, count);
+}
+
+ssize_t enc_untrusted_splice(int fd_in, off_t *off_in, int fd_out,
+                             off_t *off_out, size_t len, unsigned int flags) {
+  unsigned int klinux_flags;
+  if (!TokLinuxSpliceFlags(flags, &klinux_flags)) {
+    errno = EINVAL;
+    return -1;
+  }
+  return EnsureInitializedAndDispatchSyscall(asylo::system_call::kSYS_splice,
+                                             fd_in, off_in, fd_out, off_out,
+                                             len, klinux_flags);
+}
+
+ssize_t enc_untrusted_copy_file_range(int fd_in, off_t *off_in, int fd_out,
+                                      off_t *off_out, size_t len,
+                                      unsigned int flags) {
+  return EnsureInitializedAndDispatchSyscall(
+      asylo::system_call::kSYS_copy_file_range, fd_in, off_in, fd_out, off_out,
+      len, flags);
+}
+
 int enc_untrusted_getsockname(int sockfd, struct sockaddr *addr,
                               socklen_t *addrlen) {
   if (!addr || !addrlen) {
@@ -1213,11 +1704,9 @@ void enc_freeaddrinfo(struct addrinfo *res) {
 
 int enc_untrusted_poll(struct pollfd *fds, nfds_t nfds, int timeout) {
   auto klinux_fds = absl::make_unique<struct klinux_pollfd[]>(nfds);
-  for (int i = 0; i < nfds; ++i) {
-    if (!TokLinuxPollfd(&fds[i], &klinux_fds[i])) {
-      errno = EFAULT;
-      return -1;
-    }
+  if (!TokLinuxPollfdArray(fds, nfds, klinux_fds.get())) {
+    errno = EFAULT;
+    return -1;
   }
 
   int result = EnsureInitializedAndDispatchSyscall(
@@ -1228,11 +1717,9 @@ int enc_untrusted_poll(struct pollfd *fds, nfds_t nfds, int timeout) {
     return result;
   }
 
-  for (int i = 0; i < nfds; ++i) {
-    if (!FromkLinuxPollfd(&klinux_fds[i], &fds[i])) {
-      errno = EFAULT;
-      return -1;
-    }
+  if (!FromkLinuxPollfdArray(klinux_fds.get(), nfds, fds)) {
+    errno = EFAULT;
+    return -1;
   }
   return result;
 }
@@ -1450,11 +1937,14 @@ int enc_untrusted_epoll_wait(int epfd, struct epoll_event *events,
     errno = EINVAL;
     return -1;
   }
-  auto klinux_events =
-      absl::make_unique<struct klinux_epoll_event[]>(maxevents);
+  // Kernel events are packed and no larger than enclave events, so the host
+  // writes them straight into |events| and they are converted in place.
+  static_assert(sizeof(struct klinux_epoll_event) <= sizeof(struct epoll_event),
+                "Kernel epoll events must fit in enclave epoll events");
+  auto klinux_events = reinterpret_cast<struct klinux_epoll_event *>(events);
 
   int result = EnsureInitializedAndDispatchSyscall(
-      asylo::system_call::kSYS_epoll_wait, epfd, klinux_events.get(), maxevents,
+      asylo::system_call::kSYS_epoll_wait, epfd, klinux_events, maxevents,
       timeout);
 
   // Only process epoll events if syscall was successful.
@@ -1469,11 +1959,9 @@ int enc_untrusted_epoll_wait(int epfd, struct epoll_event *events,
         "supplied.");
   }
 
-  for (int i = 0; i < result; i++) {
-    if (!FromkLinuxEpollEvent(&klinux_events.get()[i], &events[i])) {
-      errno = EBADE;
-      return -1;
-    }
+  if (!FromkLinuxEpollEventArray(klinux_events, result, events)) {
+    errno = EBADE;
+    return -1;
   }
   return result;
 }
@@ -1653,6 +2141,42 @@ int enc_untrusted_inotify_read(int fd, size_t count, char **serialized_events,
   return result;
 }
 
+int enc_untrusted_io_uring_enter(int ring_fd, uint32_t to_submit,
+                                 uint32_t min_complete, uint32_t flags) {
+  MessageWriter input;
+  input.Push<int>(ring_fd);
+  input.Push<uint32_t>(to_submit);
+  input.Push<uint32_t>(min_complete);
+  input.Push<uint32_t>(flags);
+  MessageReader output;
+  const auto status = NonSystemCallDispatcher(
+      ::asylo::host_call::kIoUringEnterHandler, &input, &output);
+  CheckStatusAndParamCount(status, output, "enc_untrusted_io_uring_enter", 2);
+  int result = output.next<int>();
+  int klinux_errno = output.next<int>();
+  if (result == -1) {
+    errno = FromkLinuxErrorNumber(klinux_errno);
+  }
+  return result;
+}
+
+int enc_untrusted_write_profile(const char *path, const void *data,
+                                size_t size) {
+  MessageWriter input;
+  input.PushString(path);
+  input.PushByReference(Extent{reinterpret_cast<const char *>(data), size});
+  MessageReader output;
+  const auto status = NonSystemCallDispatcher(
+      ::asylo::host_call::kWriteProfileHandler, &input, &output);
+  CheckStatusAndParamCount(status, output, "enc_untrusted_write_profile", 2);
+  int result = output.next<int>();
+  int klinux_errno = output.next<int>();
+  if (result == -1) {
+    errno = FromkLinuxErrorNumber(klinux_errno);
+  }
+  return result;
+}
+
 int enc_untrusted_ioctl1(int fd, uint64_t request) {
   return EnsureInitializedAndDispatchSyscall(asylo::system_call::kSYS_ioctl, fd,
                                              request);
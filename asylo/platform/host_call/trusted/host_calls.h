@@ -31,30 +31,58 @@
 #include <sched.h>
 #include <sys/epoll.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 
 #include <cstdarg>
 #include <cstddef>
 #include <cstdint>
+#include <string>
+#include <vector>
 
 #include "asylo/platform/host_call/trusted/host_call_dispatcher.h"
 #include "asylo/platform/primitives/util/message.h"
 #include "asylo/platform/system_call/sysno.h"
 #include "asylo/platform/system_call/system_call.h"
+#include "asylo/platform/system_call/system_call_batch.h"
 
-// Ensures that the host call library is initialized, then dispatches the
-// syscall to enc_untrusted_syscall.
-template <class... Ts>
-int64_t EnsureInitializedAndDispatchSyscall(int sysno, Ts... args) {
+// Installs the host call library dispatchers and error handler for the
+// |system_call| library, unless already installed.
+inline void EnsureSyscallDispatchersInitialized() {
   if (!enc_is_syscall_dispatcher_set()) {
     enc_set_dispatch_syscall(asylo::host_call::SystemCallDispatcher);
   }
+  if (!enc_is_syscall_in_place_dispatcher_set()) {
+    enc_set_dispatch_syscall_in_place(
+        asylo::host_call::SystemCallInPlaceDispatcher);
+  }
+  if (!enc_is_syscall_batch_dispatcher_set()) {
+    enc_set_dispatch_syscall_batch(
+        asylo::host_call::BatchedSystemCallDispatcher);
+  }
   if (!enc_is_error_handler_set()) {
     enc_set_error_handler(
         asylo::primitives::TrustedPrimitives::BestEffortAbort);
   }
+}
+
+// Ensures that the host call library is initialized, then dispatches the
+// syscall to enc_untrusted_syscall.
+template <class... Ts>
+int64_t EnsureInitializedAndDispatchSyscall(int sysno, Ts... args) {
+  EnsureSyscallDispatchersInitialized();
   return enc_untrusted_syscall(sysno, args...);
 }
 
+// Ensures that the host call library is initialized, then dispatches all
+// system calls queued on |batch| to the host in a single host call.
+inline asylo::primitives::PrimitiveStatus
+EnsureInitializedAndDispatchSyscallBatch(
+    asylo::system_call::SystemCallBatch *batch) {
+  EnsureSyscallDispatchersInitialized();
+  return batch->Dispatch();
+}
+
 // Verifies the return status of the host call and checks if the expected number
 // of parameters are received on the MessageReader.
 void CheckStatusAndParamCount(const asylo::primitives::PrimitiveStatus &status,
@@ -62,6 +90,90 @@ void CheckStatusAndParamCount(const asylo::primitives::PrimitiveStatus &status,
                               const char *name, int expected_params,
                               bool match_exact_params = true);
 
+// A host directory entry read by enc_untrusted_getdents_stat, together with
+// its attributes.
+struct HostDirectoryEntry {
+  ino_t inode;
+
+  // Host position of the entry following this one in the directory.
+  off_t next_offset;
+
+  std::string name;
+
+  // 0 if |attributes| holds the attributes of the entry, otherwise the errno
+  // value with which fetching them failed.
+  int stat_errno;
+
+  struct stat attributes;
+};
+
+// Reads the next entries of the host directory |fd| into |entries| with a
+// single getdents64 call returning at most |buffer_size| bytes of records, then
+// fetches the attributes of every entry read, without following symbolic
+// links, with a single batch of newfstatat calls. Directory scans thus cost two
+// host calls per batch rather than two per entry. Returns the number of
+// entries read, 0 at the end of the directory, or -1 and sets errno.
+int enc_untrusted_getdents_stat(int fd, size_t buffer_size,
+                                std::vector<HostDirectoryEntry> *entries);
+
+// A message passed to enc_untrusted_syslog_batch. |message| need not be
+// NUL-terminated.
+struct HostSyslogMessage {
+  int priority;
+  const char *message;
+  int length;
+};
+
+// Logs each of |messages| on the host, in order, with a single batch of syslog
+// calls.
+void enc_untrusted_syslog_batch(const std::vector<HostSyslogMessage> &messages);
+
+// An integer socket option set by enc_untrusted_accept_batch on each connection
+// it accepts.
+struct HostSocketOption {
+  int level;
+  int option_name;
+  int value;
+};
+
+// A connection accepted by enc_untrusted_accept_batch.
+struct HostAcceptedConnection {
+  // Host file descriptor of the connection.
+  int fd;
+
+  // 0 if every option was set, otherwise the errno value with which setting
+  // the first failing option failed.
+  int setup_errno;
+
+  struct sockaddr_storage addr;
+  socklen_t addrlen;
+};
+
+// Accepts up to |max_connections| pending connections on the host socket
+// |sockfd| as accept4(2) with |flags| would, and sets |options| on each, all in
+// a single host call. Connections beyond the first are only taken from a
+// non-blocking socket. Appends the accepted connections to |connections| and
+// returns their number, or returns -1 and sets errno if none was accepted.
+int enc_untrusted_accept_batch(
+    int sockfd, int flags, const std::vector<HostSocketOption> &options,
+    size_t max_connections, std::vector<HostAcceptedConnection> *connections);
+
+// Defers the wait queue wakes issued by the calling thread through
+// enc_untrusted_notify() for the lifetime of the object, then issues them all
+// with a single host call. Useful when releasing several locks or signalling
+// several condition variables in a row. Scopes nest; the outermost one issues
+// the wakes. A thread issues its deferred wakes before waiting on a queue
+// itself, but wakes are otherwise delayed until the end of the scope, so the
+// scope should not span blocking host calls.
+class ScopedDeferredNotify {
+ public:
+  ScopedDeferredNotify();
+  ~ScopedDeferredNotify();
+
+  ScopedDeferredNotify(const ScopedDeferredNotify &other) = delete;
+  ScopedDeferredNotify &operator=(const ScopedDeferredNotify &other) = delete;
+};
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -169,6 +281,41 @@ void *enc_untrusted_realloc(void *ptr, size_t size);
 uint32_t enc_untrusted_sleep(uint32_t seconds);
 ssize_t enc_untrusted_sendmsg(int sockfd, const struct msghdr *msg, int flags);
 ssize_t enc_untrusted_recvmsg(int sockfd, struct msghdr *msg, int flags);
+int enc_untrusted_sendmmsg(int sockfd, struct mmsghdr *msgvec,
+                           unsigned int vlen, int flags);
+int enc_untrusted_recvmmsg(int sockfd, struct mmsghdr *msgvec,
+                           unsigned int vlen, int flags,
+                           struct timespec *timeout);
+ssize_t enc_untrusted_writev(int fd, const struct iovec *iov, int iovcnt);
+ssize_t enc_untrusted_readv(int fd, const struct iovec *iov, int iovcnt);
+ssize_t enc_untrusted_pwritev(int fd, const struct iovec *iov, int iovcnt,
+                              off_t offset);
+ssize_t enc_untrusted_preadv(int fd, const struct iovec *iov, int iovcnt,
+                             off_t offset);
+
+// AT_SYMLINK_NOFOLLOW is the only flag supported in |flags|.
+int enc_untrusted_fstatat(int dirfd, const char *pathname,
+                          struct stat *statbuf, int flags);
+
+// Maps |length| bytes of the host file |fd| starting at |offset| into untrusted
+// memory as a private, read-only mapping. Returns the address of the mapping,
+// or nullptr and sets errno on failure. The mapping is controlled by the host,
+// so callers must validate its address and copy data out of it before use.
+void *enc_untrusted_mmap_read_only(int fd, size_t length, off_t offset);
+
+// Unmaps a mapping returned by enc_untrusted_mmap_read_only.
+int enc_untrusted_munmap(void *addr, size_t length);
+
+// The following calls move data between two host file descriptors entirely on
+// the host; the data never enters the enclave.
+ssize_t enc_untrusted_sendfile(int out_fd, int in_fd, off_t *offset,
+                               size_t count);
+ssize_t enc_untrusted_splice(int fd_in, off_t *off_in, int fd_out,
+                             off_t *off_out, size_t len, unsigned int flags);
+ssize_t enc_untrusted_copy_file_range(int fd_in, off_t *off_in, int fd_out,
+                                      off_t *off_out, size_t len,
+                                      unsigned int flags);
+
 int enc_untrusted_getsockname(int sockfd, struct sockaddr *addr,
                               socklen_t *addrlen);
 int enc_untrusted_accept(int sockfd, struct sockaddr *addr, socklen_t *addrlen);
@@ -206,6 +353,28 @@ int enc_untrusted_sys_futex_wait(int32_t *futex, int32_t expected,
                                  int64_t timeout_microsec);
 int enc_untrusted_sys_futex_wake(int32_t *futex, int32_t num);
 
+// Wakes at most |num_wake| of the threads waiting on |futex| and moves at most
+// |num_requeue| of the remaining waiters to wait on |target| instead, provided
+// |*futex| still holds |expected|. Returns the number of threads woken or
+// moved, or -1 with errno set to EAGAIN if |*futex| held a different value.
+int enc_untrusted_sys_futex_cmp_requeue(int32_t *futex, int32_t num_wake,
+                                        int32_t *target, int32_t num_requeue,
+                                        int32_t expected);
+
+// Calls io_uring_enter() on the host io_uring instance |ring_fd|, submitting
+// up to |to_submit| entries and, with kIoUringEnterGetEvents in |flags|,
+// waiting for at least |min_complete| completions. |flags| holds kernel
+// io_uring_enter() flags. Returns the number of entries submitted, or -1 and
+// sets errno.
+int enc_untrusted_io_uring_enter(int ring_fd, uint32_t to_submit,
+                                 uint32_t min_complete, uint32_t flags);
+
+// Writes the |size| bytes of a profile at |data| to the host file |path| in a
+// single host call, replacing the file. An empty |path| lets the host pick the
+// file, as described by WriteProfileHandler. Returns 0, or -1 and sets errno.
+int enc_untrusted_write_profile(const char *path, const void *data,
+                                size_t size);
+
 // Calls that are not delegated to the host or depend on other host calls are
 // defined below.
 void enc_freeaddrinfo(struct addrinfo *res);
@@ -225,9 +394,22 @@ void enc_untrusted_destroy_wait_queue(int32_t *const queue);
 void enc_untrusted_thread_wait(int32_t *const queue,
                                uint64_t timeout_microsec = 0);
 
-// Wake |num_threads| threads currently waiting on the |queue|.
+// Wake |num_threads| threads currently waiting on the |queue|. Deferred while
+// a ScopedDeferredNotify is live on the calling thread.
 void enc_untrusted_notify(int32_t *const queue, int32_t num_threads = 1);
 
+// Wakes |num_threads[i]| threads currently waiting on |queues[i]| for each of
+// the |count| queues, with a single host call.
+void enc_untrusted_notify_batch(int32_t *const *queues,
+                                const int32_t *num_threads, size_t count);
+
+// Wakes one thread waiting on |queue| and moves all other threads waiting on
+// |queue| to |target_queue|, where they remain asleep until notified through
+// |target_queue|. Returns 0 on success. Returns -1 without waking or moving any
+// thread if the |queue| state is no longer |value|.
+int enc_untrusted_notify_and_requeue(int32_t *const queue, int32_t value,
+                                     int32_t *const target_queue);
+
 // Disable waiting on the given |queue|.
 void enc_untrusted_disable_waiting(int32_t *const queue);
 
@@ -20,17 +20,29 @@
 
 #include <arpa/inet.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <ifaddrs.h>
 #include <net/if.h>
 #include <netdb.h>
 #include <pwd.h>
 #include <signal.h>
 #include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
 #include <syslog.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <climits>
+#include <cstring>
 #include <cstdint>
 #include <ctime>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_replace.h"
 
 #include "asylo/platform/common/memory.h"
 #include "asylo/platform/host_call/serializer_functions.h"
@@ -52,6 +64,133 @@ void untrusted_abort_handler(const char *message) {
   abort();
 }
 
+// An upper bound of buffer size for name/control to avoid allocating memory
+// for a non-initialized random size.
+constexpr size_t kMaxMsghdrBufferSize = 1024;
+
+// A msghdr rebuilt on the host from its components on a MessageReader,
+// together with the storage it points into.
+struct HostMsghdr {
+  struct msghdr msg {};
+  std::vector<struct iovec> iov;
+  std::unique_ptr<char[]> name;
+  std::unique_ptr<char[]> control;
+  std::unique_ptr<char[]> data;
+};
+
+// Reads a msghdr pushed as [msg_name, msg_control, int msg_flags,
+// uint64_t iovlen, iov_0, ..., iov_{iovlen - 1}] from |input| into |hdr|. The
+// rebuilt msghdr points directly into the extents owned by |input|. |remaining|
+// holds the number of unread items on |input| and is updated accordingly.
+Status ReadSendMsghdr(primitives::MessageReader *input, size_t *remaining,
+                      HostMsghdr *hdr) {
+  if (*remaining < 4) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Truncated msghdr on the reader.");
+  }
+  auto msg_name_extent = input->next();
+  hdr->msg.msg_name = msg_name_extent.As<char>();
+  hdr->msg.msg_namelen = msg_name_extent.size();
+
+  auto msg_control_extent = input->next();
+  hdr->msg.msg_control = msg_control_extent.As<char>();
+  hdr->msg.msg_controllen = msg_control_extent.size();
+
+  hdr->msg.msg_flags = input->next<int>();
+  auto iovlen = input->next<uint64_t>();
+  *remaining -= 4;
+  if (iovlen > *remaining) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Truncated msghdr iovec array on the reader.");
+  }
+
+  // Each iovec arrives as its own extent, so scatter/gather is preserved all
+  // the way down to the host kernel.
+  hdr->iov.resize(iovlen);
+  for (uint64_t i = 0; i < iovlen; ++i) {
+    auto iov_extent = input->next();
+    hdr->iov[i].iov_base = iov_extent.As<char>();
+    hdr->iov[i].iov_len = iov_extent.size();
+  }
+  *remaining -= iovlen;
+  hdr->msg.msg_iov = hdr->iov.data();
+  hdr->msg.msg_iovlen = iovlen;
+  return Status::OkStatus();
+}
+
+// Reads a msghdr pushed as [uint64_t msg_namelen, uint64_t msg_controllen,
+// int msg_flags, uint64_t iovlen, uint64_t iov_len_0, ...,
+// uint64_t iov_len_{iovlen - 1}] from |input| into |hdr|, allocating host
+// buffers for the data to be received. |remaining| holds the number of unread
+// items on |input| and is updated accordingly.
+Status ReadRecvMsghdr(primitives::MessageReader *input, size_t *remaining,
+                      HostMsghdr *hdr) {
+  if (*remaining < 4) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Truncated msghdr on the reader.");
+  }
+  hdr->msg.msg_namelen = input->next<uint64_t>();
+  if (hdr->msg.msg_namelen > 0 &&
+      hdr->msg.msg_namelen < kMaxMsghdrBufferSize) {
+    hdr->name.reset(new char[hdr->msg.msg_namelen]);
+  } else {
+    hdr->msg.msg_namelen = 0;
+  }
+  hdr->msg.msg_name = hdr->name.get();
+
+  hdr->msg.msg_controllen = input->next<uint64_t>();
+  if (hdr->msg.msg_controllen > 0 &&
+      hdr->msg.msg_controllen < kMaxMsghdrBufferSize) {
+    hdr->control.reset(new char[hdr->msg.msg_controllen]);
+  } else {
+    hdr->msg.msg_controllen = 0;
+  }
+  hdr->msg.msg_control = hdr->control.get();
+
+  hdr->msg.msg_flags = input->next<int>();
+  auto iovlen = input->next<uint64_t>();
+  *remaining -= 4;
+  if (iovlen > *remaining) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Truncated msghdr iovec array on the reader.");
+  }
+
+  // All iovecs share a single host allocation, mirroring the layout of the
+  // scattered buffers inside the enclave.
+  hdr->iov.resize(iovlen);
+  size_t total_size = 0;
+  for (uint64_t i = 0; i < iovlen; ++i) {
+    hdr->iov[i].iov_len = input->next<uint64_t>();
+    total_size += hdr->iov[i].iov_len;
+  }
+  *remaining -= iovlen;
+  if (total_size > 0) {
+    hdr->data.reset(new char[total_size]);
+  }
+  size_t offset = 0;
+  for (auto &iov : hdr->iov) {
+    iov.iov_base = hdr->data.get() + offset;
+    offset += iov.iov_len;
+  }
+  hdr->msg.msg_iov = hdr->iov.data();
+  hdr->msg.msg_iovlen = iovlen;
+  return Status::OkStatus();
+}
+
+// Pushes [msg_name, msg_control, iov_0, ..., iov_{iovlen - 1}] of |hdr| after
+// |received| bytes were received into it. Each iovec is trimmed to the part
+// holding received data.
+void PushRecvMsghdr(const HostMsghdr &hdr, size_t received,
+                    primitives::MessageWriter *output) {
+  output->PushByCopy(Extent{hdr.msg.msg_name, hdr.msg.msg_namelen});
+  output->PushByCopy(Extent{hdr.msg.msg_control, hdr.msg.msg_controllen});
+  for (const auto &iov : hdr.iov) {
+    size_t iov_received = std::min(iov.iov_len, received);
+    output->PushByCopy(Extent{iov.iov_base, iov_received});
+    received -= iov_received;
+  }
+}
+
 }  // namespace
 
 Status SystemCallHandler(const std::shared_ptr<primitives::Client> &client,
@@ -72,6 +211,23 @@ Status SystemCallHandler(const std::shared_ptr<primitives::Client> &client,
   return Status::OkStatus();
 }
 
+Status BatchedSystemCallHandler(
+    const std::shared_ptr<primitives::Client> &client, void *context,
+    primitives::MessageReader *input, primitives::MessageWriter *output) {
+  ASYLO_RETURN_IF_TOO_FEW_READER_ARGUMENTS(*input, 1);
+  while (input->hasNext()) {
+    auto request = input->next();
+    Extent response;  // To be owned by untrusted call parameters.
+    if (system_call::UntrustedInvoke(request, &response).ok()) {
+      output->PushByCopy(response);
+      free(response.data());
+    } else {
+      output->PushByCopy(Extent{nullptr, 0});
+    }
+  }
+  return Status::OkStatus();
+}
+
 Status IsAttyHandler(const std::shared_ptr<primitives::Client> &client,
                      void *context, primitives::MessageReader *input,
                      primitives::MessageWriter *output) {
@@ -131,88 +287,201 @@ Status SleepHandler(const std::shared_ptr<primitives::Client> &client,
 Status SendMsgHandler(const std::shared_ptr<primitives::Client> &client,
                       void *context, primitives::MessageReader *input,
                       primitives::MessageWriter *output) {
-  ASYLO_RETURN_IF_INCORRECT_READER_ARGUMENTS(*input, 6);
-  struct msghdr msg;
+  ASYLO_RETURN_IF_TOO_FEW_READER_ARGUMENTS(*input, 2);
   int sockfd = input->next<int>();
-
-  auto msg_name_extent = input->next();
-  msg.msg_name = msg_name_extent.As<char>();
-  msg.msg_namelen = msg_name_extent.size();
-
-  auto msg_iov_extent = input->next();
-  // The message is serialized into a single buffer on the trusted side.
-  struct iovec msg_iov[1];
-  memset(msg_iov, 0, sizeof(*msg_iov));
-  msg_iov[0].iov_base = msg_iov_extent.As<char>();
-  msg_iov[0].iov_len = msg_iov_extent.size();
-  msg.msg_iov = msg_iov;
-  msg.msg_iovlen = 1;
-
-  auto msg_control_extent = input->next();
-  msg.msg_control = msg_control_extent.As<char>();
-  msg.msg_controllen = msg_control_extent.size();
-
-  msg.msg_flags = input->next<int>();
-
   int flags = input->next<int>();
-  output->Push<int64_t>(sendmsg(sockfd, &msg, flags));  // Push return value.
-  output->Push<int>(errno);                             // Push errno.
+  size_t remaining = input->size() - 2;
+  HostMsghdr hdr;
+  ASYLO_RETURN_IF_ERROR(ReadSendMsghdr(input, &remaining, &hdr));
+  if (remaining != 0) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "More items than expected on the reader.");
+  }
+
+  output->Push<int64_t>(sendmsg(sockfd, &hdr.msg, flags));  // Push result.
+  output->Push<int>(errno);                                 // Push errno.
   return Status::OkStatus();
 }
 
 Status RecvMsgHandler(const std::shared_ptr<primitives::Client> &client,
                       void *context, primitives::MessageReader *input,
                       primitives::MessageWriter *output) {
-  ASYLO_RETURN_IF_INCORRECT_READER_ARGUMENTS(*input, 6);
+  ASYLO_RETURN_IF_TOO_FEW_READER_ARGUMENTS(*input, 2);
   int sockfd = input->next<int>();
+  int flags = input->next<int>();
+  size_t remaining = input->size() - 2;
+  HostMsghdr hdr;
+  ASYLO_RETURN_IF_ERROR(ReadRecvMsghdr(input, &remaining, &hdr));
+  if (remaining != 0) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "More items than expected on the reader.");
+  }
 
-  // An upper bound of buffer size for name/control to avoid allocating memory
-  // for a non-initialized random size.
-  constexpr size_t kMaxBufferSize = 1024;
+  ssize_t result = recvmsg(sockfd, &hdr.msg, flags);
+  output->Push<int64_t>(result);  // Push return value.
+  output->Push<int>(errno);       // Push errno.
+  PushRecvMsghdr(hdr, result > 0 ? result : 0, output);
+  return Status::OkStatus();
+}
 
-  struct msghdr msg;
-  msg.msg_namelen = input->next<uint64_t>();
-  std::unique_ptr<char[]> msg_name_buffer(nullptr);
-  if (msg.msg_namelen > 0 && msg.msg_namelen < kMaxBufferSize) {
-    msg_name_buffer.reset(new char[msg.msg_namelen]);
-  } else {
-    msg.msg_namelen = 0;
-  }
-  msg.msg_name = msg_name_buffer.get();
-
-  // Receive message in a single buffer, which will be copied into the scattered
-  // buffers once back inside the enclave.
-  msg.msg_iovlen = 1;
-  struct iovec msg_iov[1];
-  memset(msg_iov, 0, sizeof(*msg_iov));
-  msg_iov[0].iov_len = input->next<uint64_t>();
-  std::unique_ptr<char[]> msg_iov_buffer(nullptr);
-  if (msg_iov[0].iov_len > 0) {
-    msg_iov_buffer.reset(new char[msg_iov[0].iov_len]);
-  }
-  msg_iov[0].iov_base = msg_iov_buffer.get();
-  msg.msg_iov = msg_iov;
-
-  msg.msg_controllen = input->next<uint64_t>();
-  std::unique_ptr<char[]> msg_control_buffer(nullptr);
-  if (msg.msg_controllen > 0 && msg.msg_controllen < kMaxBufferSize) {
-    msg_control_buffer.reset(new char[msg.msg_controllen]);
-  } else {
-    msg.msg_controllen = 0;
+Status SendMmsgHandler(const std::shared_ptr<primitives::Client> &client,
+                       void *context, primitives::MessageReader *input,
+                       primitives::MessageWriter *output) {
+  ASYLO_RETURN_IF_TOO_FEW_READER_ARGUMENTS(*input, 3);
+  int sockfd = input->next<int>();
+  int flags = input->next<int>();
+  auto vlen = input->next<uint64_t>();
+  size_t remaining = input->size() - 3;
+  if (vlen > UIO_MAXIOV) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Too many messages in sendmmsg request.");
+  }
+
+  std::vector<HostMsghdr> hdrs(vlen);
+  std::vector<struct mmsghdr> msgvec(vlen);
+  for (size_t i = 0; i < vlen; ++i) {
+    ASYLO_RETURN_IF_ERROR(ReadSendMsghdr(input, &remaining, &hdrs[i]));
+    msgvec[i].msg_hdr = hdrs[i].msg;
+    msgvec[i].msg_len = 0;
+  }
+  if (remaining != 0) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "More items than expected on the reader.");
+  }
+
+  int result = sendmmsg(sockfd, msgvec.data(), vlen, flags);
+  output->Push<int>(result);  // Push return value.
+  output->Push<int>(errno);   // Push errno.
+  for (int i = 0; i < result; ++i) {
+    output->Push<uint32_t>(msgvec[i].msg_len);
   }
-  msg.msg_control = msg_control_buffer.get();
+  return Status::OkStatus();
+}
 
-  msg.msg_flags = input->next<int>();
+Status RecvMmsgHandler(const std::shared_ptr<primitives::Client> &client,
+                       void *context, primitives::MessageReader *input,
+                       primitives::MessageWriter *output) {
+  ASYLO_RETURN_IF_TOO_FEW_READER_ARGUMENTS(*input, 4);
+  int sockfd = input->next<int>();
   int flags = input->next<int>();
+  auto vlen = input->next<uint64_t>();
+  auto timeout_extent = input->next();
+  size_t remaining = input->size() - 4;
+  if (vlen > UIO_MAXIOV) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Too many messages in recvmmsg request.");
+  }
 
-  output->Push<int64_t>(recvmsg(sockfd, &msg, flags));  // Push return value.
-  output->Push<int>(errno);                             // Push errno.
-  output->PushByCopy(Extent{msg.msg_name, msg.msg_namelen});  // Push msg name.
-  output->PushByCopy(Extent{msg.msg_iov[0].iov_base,
-                            msg.msg_iov[0].iov_len});  // Push received msg.
-  output->PushByCopy(
-      Extent{msg.msg_control, msg.msg_controllen});  // Push control msg.
+  // An empty extent stands for a null timeout, which blocks until |vlen|
+  // messages are received.
+  struct timespec timeout;
+  struct timespec *timeout_ptr = nullptr;
+  if (!timeout_extent.empty()) {
+    if (timeout_extent.size() != 2 * sizeof(int64_t)) {
+      return Status(error::GoogleError::INVALID_ARGUMENT,
+                    "Malformed recvmmsg timeout.");
+    }
+    const int64_t *timeout_fields = timeout_extent.As<int64_t>();
+    timeout.tv_sec = timeout_fields[0];
+    timeout.tv_nsec = timeout_fields[1];
+    timeout_ptr = &timeout;
+  }
 
+  std::vector<HostMsghdr> hdrs(vlen);
+  std::vector<struct mmsghdr> msgvec(vlen);
+  for (size_t i = 0; i < vlen; ++i) {
+    ASYLO_RETURN_IF_ERROR(ReadRecvMsghdr(input, &remaining, &hdrs[i]));
+    msgvec[i].msg_hdr = hdrs[i].msg;
+    msgvec[i].msg_len = 0;
+  }
+  if (remaining != 0) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "More items than expected on the reader.");
+  }
+
+  int result = recvmmsg(sockfd, msgvec.data(), vlen, flags, timeout_ptr);
+  output->Push<int>(result);  // Push return value.
+  output->Push<int>(errno);   // Push errno.
+  for (int i = 0; i < result; ++i) {
+    // The kernel updates the lengths in |msgvec|, not in |hdrs|.
+    hdrs[i].msg.msg_namelen = msgvec[i].msg_hdr.msg_namelen;
+    hdrs[i].msg.msg_controllen = msgvec[i].msg_hdr.msg_controllen;
+    output->Push<uint32_t>(msgvec[i].msg_len);
+    PushRecvMsghdr(hdrs[i], msgvec[i].msg_len, output);
+  }
+  return Status::OkStatus();
+}
+
+Status WritevHandler(const std::shared_ptr<primitives::Client> &client,
+                     void *context, primitives::MessageReader *input,
+                     primitives::MessageWriter *output) {
+  ASYLO_RETURN_IF_TOO_FEW_READER_ARGUMENTS(*input, 4);
+  int fd = input->next<int>();
+  int positional = input->next<int>();
+  auto offset = input->next<int64_t>();
+  auto iovcnt = input->next<uint64_t>();
+  if (iovcnt > UIO_MAXIOV || iovcnt != input->size() - 4) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Malformed iovec array on the reader.");
+  }
+
+  // Each iovec arrives as its own extent and is handed to the kernel in place.
+  std::vector<struct iovec> iov(iovcnt);
+  for (auto &entry : iov) {
+    auto extent = input->next();
+    entry.iov_base = extent.As<char>();
+    entry.iov_len = extent.size();
+  }
+
+  ssize_t result = positional ? pwritev(fd, iov.data(), iovcnt, offset)
+                              : writev(fd, iov.data(), iovcnt);
+  output->Push<int64_t>(result);  // Push return value.
+  output->Push<int>(errno);       // Push errno.
+  return Status::OkStatus();
+}
+
+Status ReadvHandler(const std::shared_ptr<primitives::Client> &client,
+                    void *context, primitives::MessageReader *input,
+                    primitives::MessageWriter *output) {
+  ASYLO_RETURN_IF_TOO_FEW_READER_ARGUMENTS(*input, 4);
+  int fd = input->next<int>();
+  int positional = input->next<int>();
+  auto offset = input->next<int64_t>();
+  auto iovcnt = input->next<uint64_t>();
+  if (iovcnt > UIO_MAXIOV || iovcnt != input->size() - 4) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Malformed iovec array on the reader.");
+  }
+
+  // All iovecs share a single host allocation, mirroring the layout of the
+  // scattered buffers inside the enclave.
+  std::vector<struct iovec> iov(iovcnt);
+  size_t total_size = 0;
+  for (auto &entry : iov) {
+    entry.iov_len = input->next<uint64_t>();
+    if (entry.iov_len > SSIZE_MAX - total_size) {
+      return Status(error::GoogleError::INVALID_ARGUMENT,
+                    "Total iovec length overflows.");
+    }
+    total_size += entry.iov_len;
+  }
+  std::unique_ptr<char[]> data(new char[total_size]);
+  size_t data_offset = 0;
+  for (auto &entry : iov) {
+    entry.iov_base = data.get() + data_offset;
+    data_offset += entry.iov_len;
+  }
+
+  ssize_t result = positional ? preadv(fd, iov.data(), iovcnt, offset)
+                              : readv(fd, iov.data(), iovcnt);
+  output->Push<int64_t>(result);  // Push return value.
+  output->Push<int>(errno);       // Push errno.
+  size_t received = result > 0 ? result : 0;
+  for (const auto &entry : iov) {
+    size_t iov_received = std::min(entry.iov_len, received);
+    output->PushByCopy(Extent{entry.iov_base, iov_received});
+    received -= iov_received;
+  }
   return Status::OkStatus();
 }
 
@@ -259,6 +528,75 @@ Status AcceptHandler(const std::shared_ptr<primitives::Client> &client,
   return Status::OkStatus();
 }
 
+Status AcceptBatchHandler(const std::shared_ptr<primitives::Client> &client,
+                          void *context, primitives::MessageReader *input,
+                          primitives::MessageWriter *output) {
+  ASYLO_RETURN_IF_INCORRECT_READER_ARGUMENTS(*input, 4);
+  int sockfd = input->next<int>();
+  int flags = input->next<int>();
+  auto max_connections = input->next<uint64_t>();
+  auto options_extent = input->next();
+  constexpr size_t kOptionSize = 3 * sizeof(int32_t);
+  if (max_connections == 0 || max_connections > UIO_MAXIOV ||
+      options_extent.size() % kOptionSize != 0) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Malformed accept batch request.");
+  }
+  std::vector<int32_t> options(options_extent.size() / sizeof(int32_t));
+  memcpy(options.data(), options_extent.data(), options_extent.size());
+
+  // Further connections can only be taken without blocking from a
+  // non-blocking listening socket.
+  int listener_flags = fcntl(sockfd, F_GETFL);
+  if (listener_flags == -1 || !(listener_flags & O_NONBLOCK)) {
+    max_connections = 1;
+  }
+
+  struct AcceptedConnection {
+    int fd;
+    int setup_errno;
+    struct sockaddr_storage addr;
+  };
+  std::vector<AcceptedConnection> accepted;
+  accepted.reserve(max_connections);
+  int accept_errno = 0;
+  while (accepted.size() < max_connections) {
+    AcceptedConnection connection = {};
+    socklen_t addr_len = sizeof(connection.addr);
+    connection.fd =
+        accept4(sockfd, reinterpret_cast<struct sockaddr *>(&connection.addr),
+                &addr_len, flags);
+    if (connection.fd == -1) {
+      accept_errno = errno;
+      break;
+    }
+    LOG_IF(FATAL, addr_len > sizeof(connection.addr))
+        << "Insufficient sockaddr buf space encountered for accept batch host "
+           "call.";
+
+    // Options are best effort, as after accept(2); the first failure is
+    // reported with the connection.
+    for (size_t i = 0; i < options.size(); i += 3) {
+      int value = options[i + 2];
+      if (setsockopt(connection.fd, options[i], options[i + 1], &value,
+                     sizeof(value)) == -1 &&
+          connection.setup_errno == 0) {
+        connection.setup_errno = errno;
+      }
+    }
+    accepted.push_back(connection);
+  }
+
+  output->Push<int>(accepted.empty() ? -1 : accepted.size());
+  output->Push<int>(accepted.empty() ? accept_errno : 0);
+  for (const AcceptedConnection &connection : accepted) {
+    output->Push<int>(connection.fd);
+    output->Push<int>(connection.setup_errno);
+    output->Push<struct sockaddr_storage>(connection.addr);
+  }
+  return Status::OkStatus();
+}
+
 Status GetPeernameHandler(const std::shared_ptr<primitives::Client> &client,
                           void *context, primitives::MessageReader *input,
                           primitives::MessageWriter *output) {
@@ -578,6 +916,26 @@ Status SysFutexWakeHandler(const std::shared_ptr<primitives::Client> &client,
   return SysFutexWakeHelper(input, output);
 }
 
+Status SysFutexWakeBatchHandler(
+    const std::shared_ptr<primitives::Client> &client, void *context,
+    primitives::MessageReader *input, primitives::MessageWriter *output) {
+  return SysFutexWakeBatchHelper(input, output);
+}
+
+Status IoUringEnterHandler(const std::shared_ptr<primitives::Client> &client,
+                           void *context, primitives::MessageReader *input,
+                           primitives::MessageWriter *output) {
+  ASYLO_RETURN_IF_INCORRECT_READER_ARGUMENTS(*input, 4);
+  int fd = input->next<int>();
+  auto to_submit = input->next<uint32_t>();
+  auto min_complete = input->next<uint32_t>();
+  auto flags = input->next<uint32_t>();
+  output->Push<int>(syscall(SYS_io_uring_enter, fd, to_submit, min_complete,
+                            flags, /*sig=*/nullptr, /*sigsz=*/0));
+  output->Push<int>(errno);
+  return Status::OkStatus();
+}
+
 Status LocalLifetimeAllocHandler(
     const std::shared_ptr<primitives::Client> &client, void *context,
     primitives::MessageReader *input, primitives::MessageWriter *output) {
@@ -594,5 +952,47 @@ Status LocalLifetimeAllocHandler(
   return Status::OkStatus();
 }
 
+Status WriteProfileHandler(const std::shared_ptr<primitives::Client> &client,
+                           void *context, primitives::MessageReader *input,
+                           primitives::MessageWriter *output) {
+  ASYLO_RETURN_IF_INCORRECT_READER_ARGUMENTS(*input, 2);
+  auto path_buf = input->next();
+  auto data = input->next();
+
+  std::string path = path_buf.empty() ? "" : path_buf.As<char>();
+  if (path.empty()) {
+    const char *env_path = getenv("LLVM_PROFILE_FILE");
+    path = env_path && *env_path ? env_path : "default.profraw";
+  }
+  path = absl::StrReplaceAll(path, {{"%p", absl::StrCat(getpid())}});
+
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    output->Push<int>(-1);
+    output->Push<int>(errno);
+    return Status::OkStatus();
+  }
+  const char *buffer = data.As<char>();
+  size_t remaining = data.size();
+  int result = 0;
+  while (remaining > 0) {
+    ssize_t written = write(fd, buffer, remaining);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      result = -1;
+      break;
+    }
+    buffer += written;
+    remaining -= written;
+  }
+  int write_errno = errno;
+  close(fd);
+  output->Push<int>(result);
+  output->Push<int>(write_errno);
+  return Status::OkStatus();
+}
+
 }  // namespace host_call
 }  // namespace asylo
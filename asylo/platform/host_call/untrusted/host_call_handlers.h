@@ -37,6 +37,15 @@ Status SystemCallHandler(const std::shared_ptr<primitives::Client> &client,
                          void *context, primitives::MessageReader *input,
                          primitives::MessageWriter *output);
 
+// Handler for a batch of independent system call requests. It receives a
+// MessageReader containing one or more serialized requests, invokes them on
+// the host in order, and writes back one serialized response per request, in
+// the same order. A request which fails to be invoked yields an empty response
+// and does not prevent the remaining requests from being invoked.
+Status BatchedSystemCallHandler(
+    const std::shared_ptr<primitives::Client> &client, void *context,
+    primitives::MessageReader *input, primitives::MessageWriter *output);
+
 // isatty library call handler on the host; expects [int fd] and returns [int].
 Status IsAttyHandler(const std::shared_ptr<primitives::Client> &client,
                      void *context, primitives::MessageReader *input,
@@ -66,18 +75,59 @@ Status SleepHandler(const std::shared_ptr<primitives::Client> &client,
                     void *context, primitives::MessageReader *input,
                     primitives::MessageWriter *output);
 
-// sendmsg syscall handler on the host; expects [int sockfd, const struct msghdr
-// *msg, int flags] and returns [ssize_t].
+// sendmsg syscall handler on the host; expects [int sockfd, int flags,
+// msg_name, msg_control, int msg_flags, uint64_t iovlen, iov_0, ...,
+// iov_{iovlen - 1}] and returns [ssize_t /*result*/, int /*errno*/].
 Status SendMsgHandler(const std::shared_ptr<primitives::Client> &client,
                       void *context, primitives::MessageReader *input,
                       primitives::MessageWriter *output);
 
-// recvmsg syscall handler on the host; expects [int sockfd, struct msghdr *msg,
-// int flags] and returns [ssize_t].
+// recvmsg syscall handler on the host; expects [int sockfd, int flags,
+// uint64_t msg_namelen, uint64_t msg_controllen, int msg_flags,
+// uint64_t iovlen, uint64_t iov_len_0, ..., uint64_t iov_len_{iovlen - 1}] and
+// returns [ssize_t /*result*/, int /*errno*/, msg_name, msg_control, iov_0,
+// ..., iov_{iovlen - 1}], where each iovec holds only the bytes received into
+// it.
 Status RecvMsgHandler(const std::shared_ptr<primitives::Client> &client,
                       void *context, primitives::MessageReader *input,
                       primitives::MessageWriter *output);
 
+// sendmmsg syscall handler on the host; expects [int sockfd, int flags,
+// uint64_t vlen] followed by |vlen| messages laid out as for |SendMsgHandler|,
+// and returns [int /*result*/, int /*errno*/, uint32_t msg_len_0, ...,
+// uint32_t msg_len_{result - 1}].
+Status SendMmsgHandler(const std::shared_ptr<primitives::Client> &client,
+                       void *context, primitives::MessageReader *input,
+                       primitives::MessageWriter *output);
+
+// recvmmsg syscall handler on the host; expects [int sockfd, int flags,
+// uint64_t vlen, timeout] followed by |vlen| messages laid out as for
+// |RecvMsgHandler|, where |timeout| is either empty or [int64_t tv_sec,
+// int64_t tv_nsec]. Returns [int /*result*/, int /*errno*/] followed by
+// [uint32_t msg_len, msg_name, msg_control, iov_0, ..., iov_{iovlen - 1}] for
+// each of the |result| messages received.
+Status RecvMmsgHandler(const std::shared_ptr<primitives::Client> &client,
+                       void *context, primitives::MessageReader *input,
+                       primitives::MessageWriter *output);
+
+// writev and pwritev syscall handler on the host; expects [int fd,
+// int positional, int64_t offset, uint64_t iovcnt, iov_0, ...,
+// iov_{iovcnt - 1}] and returns [ssize_t /*result*/, int /*errno*/]. Calls
+// pwritev at |offset| if |positional| is non-zero, and writev otherwise.
+Status WritevHandler(const std::shared_ptr<primitives::Client> &client,
+                     void *context, primitives::MessageReader *input,
+                     primitives::MessageWriter *output);
+
+// readv and preadv syscall handler on the host; expects [int fd,
+// int positional, int64_t offset, uint64_t iovcnt, uint64_t iov_len_0, ...,
+// uint64_t iov_len_{iovcnt - 1}] and returns [ssize_t /*result*/,
+// int /*errno*/, iov_0, ..., iov_{iovcnt - 1}], where each iovec holds only the
+// bytes read into it. Calls preadv at |offset| if |positional| is non-zero, and
+// readv otherwise.
+Status ReadvHandler(const std::shared_ptr<primitives::Client> &client,
+                    void *context, primitives::MessageReader *input,
+                    primitives::MessageWriter *output);
+
 // getsockname syscall handler on the host; expects [int sockfd] and returns
 // [int /*result*/, int /*errno*/, sockaddr] on the MessageWriter.
 Status GetSocknameHandler(const std::shared_ptr<primitives::Client> &client,
@@ -90,6 +140,17 @@ Status AcceptHandler(const std::shared_ptr<primitives::Client> &client,
                      void *context, primitives::MessageReader *input,
                      primitives::MessageWriter *output);
 
+// accept4 handler on the host which accepts up to |max_connections| pending
+// connections and sets the given socket options on each, all in a single
+// exit. Expects [int sockfd, int flags, uint64_t max_connections, options],
+// where |options| holds [int32_t level, int32_t optname, int32_t value] for
+// each option, and returns [int /*result*/, int /*errno*/] followed by
+// [int fd, int setup_errno, sockaddr] for each of the |result| connections.
+// More than one connection is only accepted from a non-blocking socket.
+Status AcceptBatchHandler(const std::shared_ptr<primitives::Client> &client,
+                          void *context, primitives::MessageReader *input,
+                          primitives::MessageWriter *output);
+
 // getpeername syscall handler on the host; expects [int sockfd] and returns
 // [int /*result*/, int /*errno*/, sockaddr] on the MessageWriter.
 Status GetPeernameHandler(const std::shared_ptr<primitives::Client> &client,
@@ -229,6 +290,22 @@ Status SysFutexWakeHandler(const std::shared_ptr<primitives::Client> &client,
                            void *context, primitives::MessageReader *input,
                            primitives::MessageWriter *output);
 
+// Handler for host call enc_untrusted_notify_batch(). Expects [futexes, nums],
+// where |futexes| holds a uint64_t futex address and |nums| the int32_t number
+// of threads to wake for each futex, and returns [int result, int errno] on the
+// MessageWriter. |result| is the total number of threads woken, or -1 if any
+// wake failed.
+Status SysFutexWakeBatchHandler(
+    const std::shared_ptr<primitives::Client> &client, void *context,
+    primitives::MessageReader *input, primitives::MessageWriter *output);
+
+// io_uring_enter syscall handler on the host; expects [int fd, uint32_t
+// to_submit, uint32_t min_complete, uint32_t flags] and returns [int /*result*/,
+// int /*errno*/] on the MessageWriter.
+Status IoUringEnterHandler(const std::shared_ptr<primitives::Client> &client,
+                           void *context, primitives::MessageReader *input,
+                           primitives::MessageWriter *output);
+
 // Handler for host call helper LocalLifetimeAlloc. Expects [size_t
 // bytes] and returns [uintptr_t result, int errno] on the
 // MessageWriter.
@@ -236,6 +313,16 @@ Status LocalLifetimeAllocHandler(
     const std::shared_ptr<primitives::Client> &client, void *context,
     primitives::MessageReader *input, primitives::MessageWriter *output);
 
+// Handler for host call enc_untrusted_write_profile(). Expects [char *path,
+// Extent data], writes |data| to |path| and returns [int result, int errno] on
+// the MessageWriter. An empty |path| is replaced by the LLVM_PROFILE_FILE
+// environment variable of the host, or by "default.profraw" if it is unset, and
+// each "%p" in the path is replaced by the process ID of the host, as the LLVM
+// profile runtime does for host binaries.
+Status WriteProfileHandler(const std::shared_ptr<primitives::Client> &client,
+                           void *context, primitives::MessageReader *input,
+                           primitives::MessageWriter *output);
+
 }  // namespace host_call
 }  // namespace asylo
 
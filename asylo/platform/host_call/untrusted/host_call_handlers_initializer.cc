@@ -20,6 +20,9 @@
 
 #include "asylo/platform/host_call/exit_handler_constants.h"
 #include "asylo/platform/host_call/untrusted/host_call_handlers.h"
+#include "asylo/platform/primitives/util/exit_profile.h"
+#include "asylo/platform/system_call/compact_message.h"
+#include "asylo/platform/system_call/message.h"
 #include "asylo/util/status_macros.h"
 #include "asylo/util/statusor.h"
 
@@ -52,12 +55,27 @@ Status AddHostCallHandlersToExitCallProvider(
   ASYLO_RETURN_IF_ERROR(exit_call_provider->RegisterExitHandler(
       kRecvMsgHandler, primitives::ExitHandler{RecvMsgHandler}));
 
+  ASYLO_RETURN_IF_ERROR(exit_call_provider->RegisterExitHandler(
+      kSendMmsgHandler, primitives::ExitHandler{SendMmsgHandler}));
+
+  ASYLO_RETURN_IF_ERROR(exit_call_provider->RegisterExitHandler(
+      kRecvMmsgHandler, primitives::ExitHandler{RecvMmsgHandler}));
+
+  ASYLO_RETURN_IF_ERROR(exit_call_provider->RegisterExitHandler(
+      kWritevHandler, primitives::ExitHandler{WritevHandler}));
+
+  ASYLO_RETURN_IF_ERROR(exit_call_provider->RegisterExitHandler(
+      kReadvHandler, primitives::ExitHandler{ReadvHandler}));
+
   ASYLO_RETURN_IF_ERROR(exit_call_provider->RegisterExitHandler(
       kGetSocknameHandler, primitives::ExitHandler{GetSocknameHandler}));
 
   ASYLO_RETURN_IF_ERROR(exit_call_provider->RegisterExitHandler(
       kAcceptHandler, primitives::ExitHandler{AcceptHandler}));
 
+  ASYLO_RETURN_IF_ERROR(exit_call_provider->RegisterExitHandler(
+      kAcceptBatchHandler, primitives::ExitHandler{AcceptBatchHandler}));
+
   ASYLO_RETURN_IF_ERROR(exit_call_provider->RegisterExitHandler(
       kGetPeernameHandler, primitives::ExitHandler{GetPeernameHandler}));
 
@@ -115,12 +133,45 @@ Status AddHostCallHandlersToExitCallProvider(
   ASYLO_RETURN_IF_ERROR(exit_call_provider->RegisterExitHandler(
       kSysFutexWakeHandler, primitives::ExitHandler{SysFutexWakeHandler}));
 
+  ASYLO_RETURN_IF_ERROR(exit_call_provider->RegisterExitHandler(
+      kSysFutexWakeBatchHandler,
+      primitives::ExitHandler{SysFutexWakeBatchHandler}));
+
+  ASYLO_RETURN_IF_ERROR(exit_call_provider->RegisterExitHandler(
+      kIoUringEnterHandler, primitives::ExitHandler{IoUringEnterHandler}));
+
+  ASYLO_RETURN_IF_ERROR(exit_call_provider->RegisterExitHandler(
+      kWriteProfileHandler, primitives::ExitHandler{WriteProfileHandler}));
+
   ASYLO_RETURN_IF_ERROR(exit_call_provider->RegisterExitHandler(
       kLocalLifetimeAllocHandler,
       primitives::ExitHandler{LocalLifetimeAllocHandler}));
 
+  ASYLO_RETURN_IF_ERROR(exit_call_provider->RegisterExitHandler(
+      kBatchedSystemCallHandler,
+      primitives::ExitHandler{BatchedSystemCallHandler}));
+
   return Status::OkStatus();
 }
 
+int64_t ClassifyHostCallExit(uint64_t untrusted_selector,
+                             const primitives::MessageReader &input) {
+  if (untrusted_selector != kSystemCallHandler || input.size() != 1 ||
+      !input.hasNext()) {
+    return primitives::kUnclassifiedExit;
+  }
+  primitives::Extent request = input.peek();
+  if (system_call::IsCompactMessage(request)) {
+    return system_call::IsCompactRequest(request)
+               ? system_call::CompactMessageSysno(request)
+               : primitives::kUnclassifiedExit;
+  }
+  system_call::MessageReader reader(request);
+  if (!reader.Validate().ok() || !reader.is_request()) {
+    return primitives::kUnclassifiedExit;
+  }
+  return reader.sysno();
+}
+
 }  // namespace host_call
 }  // namespace asylo
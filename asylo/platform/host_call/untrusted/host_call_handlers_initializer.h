@@ -19,7 +19,10 @@
 #ifndef ASYLO_PLATFORM_HOST_CALL_UNTRUSTED_HOST_CALL_HANDLERS_INITIALIZER_H_
 #define ASYLO_PLATFORM_HOST_CALL_UNTRUSTED_HOST_CALL_HANDLERS_INITIALIZER_H_
 
+#include <cstdint>
+
 #include "asylo/platform/primitives/util/dispatch_table.h"
+#include "asylo/platform/primitives/util/message.h"
 
 namespace asylo {
 namespace host_call {
@@ -29,6 +32,12 @@ namespace host_call {
 Status AddHostCallHandlersToExitCallProvider(
     primitives::Client::ExitCallProvider* exit_call_provider);
 
+// Classifies host call exits for a primitives::ExitProfiler. Returns the system
+// call number of |kSystemCallHandler| exits carrying a well-formed request, and
+// primitives::kUnclassifiedExit for every other exit.
+int64_t ClassifyHostCallExit(uint64_t untrusted_selector,
+                             const primitives::MessageReader& input);
+
 }  // namespace host_call
 }  // namespace asylo
 
@@ -18,11 +18,20 @@
 
 #include "asylo/platform/host_call/untrusted/host_call_handlers_initializer.h"
 
+#include <sys/syscall.h>
+
+#include <array>
+#include <cstdlib>
+
 #include <gtest/gtest.h>
+#include "absl/memory/memory.h"
 #include "asylo/util/logging.h"
 #include "asylo/platform/host_call/exit_handler_constants.h"
 #include "asylo/platform/primitives/untrusted_primitives.h"
+#include "asylo/platform/primitives/util/exit_profile.h"
 #include "asylo/platform/primitives/util/message.h"
+#include "asylo/platform/primitives/util/status_conversions.h"
+#include "asylo/platform/system_call/serialize.h"
 #include "asylo/test/util/status_matchers.h"
 
 namespace asylo {
@@ -117,6 +126,12 @@ TEST(HostCallHandlersInitializerTest, RegisterHostCallHandlersTest) {
   EXPECT_THAT(client->exit_call_provider()->InvokeExitHandler(
                   kAcceptHandler, &input, &output, client.get()),
               StatusIs(error::GoogleError::INVALID_ARGUMENT));
+  EXPECT_THAT(client->exit_call_provider()->RegisterExitHandler(
+                  kAcceptBatchHandler, primitives::ExitHandler{nullptr}),
+              StatusIs(error::GoogleError::ALREADY_EXISTS));
+  EXPECT_THAT(client->exit_call_provider()->InvokeExitHandler(
+                  kAcceptBatchHandler, &input, &output, client.get()),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
   EXPECT_THAT(client->exit_call_provider()->RegisterExitHandler(
                   kGetPeernameHandler, primitives::ExitHandler{nullptr}),
               StatusIs(error::GoogleError::ALREADY_EXISTS));
@@ -131,5 +146,47 @@ TEST(HostCallHandlersInitializerTest, RegisterHostCallHandlersTest) {
               StatusIs(error::GoogleError::INVALID_ARGUMENT));
 }
 
+// Verify that system call host calls are classified by system call number.
+TEST(HostCallHandlersInitializerTest, ClassifyHostCallExitTest) {
+  std::array<uint64_t, system_call::kParameterMax> request_params;
+  primitives::Extent request;
+  ASYLO_ASSERT_OK(primitives::MakeStatus(
+      system_call::SerializeRequest(SYS_getpid, request_params, &request)));
+  primitives::MessageWriter writer;
+  writer.PushByCopy(request);
+  free(request.data());
+  auto buffer = absl::make_unique<char[]>(writer.MessageSize());
+  writer.Serialize(buffer.get());
+  primitives::MessageReader input;
+  input.Deserialize(buffer.get(), writer.MessageSize());
+
+  EXPECT_EQ(ClassifyHostCallExit(kSystemCallHandler, input), SYS_getpid);
+  EXPECT_EQ(input.size(), 1);
+  EXPECT_TRUE(input.hasNext());
+  EXPECT_EQ(ClassifyHostCallExit(kIsAttyHandler, input),
+            primitives::kUnclassifiedExit);
+
+  primitives::MessageReader empty_input;
+  EXPECT_EQ(ClassifyHostCallExit(kSystemCallHandler, empty_input),
+            primitives::kUnclassifiedExit);
+}
+
+// Verify that compactly encoded system call host calls are classified too.
+TEST(HostCallHandlersInitializerTest, ClassifyCompactHostCallExitTest) {
+  std::array<uint64_t, system_call::kParameterMax> request_params = {3};
+  primitives::Extent request;
+  ASYLO_ASSERT_OK(primitives::MakeStatus(
+      system_call::SerializeRequest(SYS_close, request_params, &request)));
+  primitives::MessageWriter writer;
+  writer.PushByCopy(request);
+  free(request.data());
+  auto buffer = absl::make_unique<char[]>(writer.MessageSize());
+  writer.Serialize(buffer.get());
+  primitives::MessageReader input;
+  input.Deserialize(buffer.get(), writer.MessageSize());
+
+  EXPECT_EQ(ClassifyHostCallExit(kSystemCallHandler, input), SYS_close);
+}
+
 }  // namespace host_call
 }  // namespace asylo
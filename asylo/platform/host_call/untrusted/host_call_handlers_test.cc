@@ -18,19 +18,36 @@
 
 #include "asylo/platform/host_call/untrusted/host_call_handlers.h"
 
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
 #include <sys/syscall.h>
+#include <sys/types.h>
+#include <unistd.h>
 
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
 #include <functional>
+#include <sstream>
+#include <string>
+#include <thread>
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "asylo/platform/common/futex.h"
 #include "asylo/platform/primitives/util/message.h"
 #include "asylo/platform/primitives/util/status_conversions.h"
 #include "asylo/platform/system_call/message.h"
 #include "asylo/platform/system_call/serialize.h"
 #include "asylo/test/util/status_matchers.h"
 
+using ::asylo::primitives::Extent;
 using ::asylo::primitives::MessageReader;
 using ::asylo::primitives::MessageWriter;
 using ::testing::IsEmpty;
@@ -134,6 +151,63 @@ TEST(HostCallHandlersTest, SyscallHandlerInvalidRequestTest) {
   EXPECT_THAT(output, IsEmpty());
 }
 
+TEST(HostCallHandlersTest, BatchedSyscallHandlerEmptyMessageTest) {
+  MessageReader empty_input;
+  MessageWriter empty_output;
+  EXPECT_THAT(BatchedSystemCallHandler(nullptr, nullptr, &empty_input,
+                                       &empty_output),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+}
+
+// Invokes a batch of requests containing an illegal request in the middle.
+// Verifies one response is produced per request, in order, and that the
+// illegal request does not prevent the following request from being invoked.
+TEST(HostCallHandlersTest, BatchedSyscallHandlerTest) {
+  std::array<uint64_t, system_call::kParameterMax> request_params;
+  MessageReader input;
+  FillInput(
+      [&request_params](MessageWriter *params) {
+        primitives::Extent request;
+        ASYLO_ASSERT_OK(primitives::MakeStatus(system_call::SerializeRequest(
+            SYS_getpid, request_params, &request)));
+        params->PushByCopy(request);
+        free(request.data());
+
+        auto writer =
+            system_call::MessageWriter::RequestWriter(-1, request_params);
+        size_t size = writer.MessageSize();
+        request = {reinterpret_cast<uint8_t *>(malloc(size)), size};
+        writer.Write(&request);
+        params->PushByCopy(request);
+        free(request.data());
+
+        ASYLO_ASSERT_OK(primitives::MakeStatus(system_call::SerializeRequest(
+            SYS_getppid, request_params, &request)));
+        params->PushByCopy(request);
+        free(request.data());
+      },
+      &input);
+  MessageWriter output;
+  ASSERT_THAT(BatchedSystemCallHandler(nullptr, nullptr, &input, &output),
+              IsOk());
+  VerifyOutput(
+      [](MessageReader *result) {
+        ASSERT_THAT(*result, SizeIs(3));
+        system_call::MessageReader getpid_response(result->next());
+        ASSERT_TRUE(getpid_response.Validate().ok());
+        EXPECT_EQ(getpid_response.sysno(), SYS_getpid);
+        EXPECT_EQ(getpid_response.result(), getpid());
+
+        EXPECT_EQ(result->next().size(), 0);
+
+        system_call::MessageReader getppid_response(result->next());
+        ASSERT_TRUE(getppid_response.Validate().ok());
+        EXPECT_EQ(getppid_response.sysno(), SYS_getppid);
+        EXPECT_EQ(getppid_response.result(), getppid());
+      },
+      &output);
+}
+
 // Invokes an IsAtty hostcall for an invalid request. It tests that the correct
 // error is returned for an empty input or for an input with more than one item.
 TEST(HostCallHandlersTest, IsAttyIncorrectSizeTest) {
@@ -206,6 +280,532 @@ TEST(HostCallHandlersTest, USleepValidRequestTest) {
       &output);
 }
 
+// Sends a message with several iovecs through SendMsgHandler and receives it
+// through RecvMsgHandler into differently sized iovecs, and verifies that the
+// data is scattered across the returned iovecs.
+TEST(HostCallHandlersTest, SendMsgRecvMsgScatterGatherTest) {
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_DGRAM, 0, fds), 0);
+
+  MessageReader send_input;
+  FillInput(
+      [&fds](MessageWriter *params) {
+        params->Push(fds[0]);
+        params->Push(0);                         // flags
+        params->PushByCopy(Extent{nullptr, 0});  // msg_name
+        params->PushByCopy(Extent{nullptr, 0});  // msg_control
+        params->Push(0);                         // msg_flags
+        params->Push<uint64_t>(2);               // iovlen
+        params->PushByCopy(Extent{"hello, ", 7});
+        params->PushByCopy(Extent{"world", 5});
+      },
+      &send_input);
+  MessageWriter send_output;
+  ASSERT_THAT(SendMsgHandler(nullptr, nullptr, &send_input, &send_output),
+              IsOk());
+  VerifyOutput(
+      [](MessageReader *results) {
+        ASSERT_THAT(*results, SizeIs(2));
+        EXPECT_EQ(results->next<int64_t>(), 12);
+      },
+      &send_output);
+
+  MessageReader recv_input;
+  FillInput(
+      [&fds](MessageWriter *params) {
+        params->Push(fds[1]);
+        params->Push(0);             // flags
+        params->Push<uint64_t>(0);   // msg_namelen
+        params->Push<uint64_t>(0);   // msg_controllen
+        params->Push(0);             // msg_flags
+        params->Push<uint64_t>(3);   // iovlen
+        params->Push<uint64_t>(4);   // iov_len_0
+        params->Push<uint64_t>(4);   // iov_len_1
+        params->Push<uint64_t>(64);  // iov_len_2
+      },
+      &recv_input);
+  MessageWriter recv_output;
+  ASSERT_THAT(RecvMsgHandler(nullptr, nullptr, &recv_input, &recv_output),
+              IsOk());
+  VerifyOutput(
+      [](MessageReader *results) {
+        ASSERT_THAT(*results, SizeIs(7));
+        EXPECT_EQ(results->next<int64_t>(), 12);
+        results->next<int>();
+        EXPECT_TRUE(results->next().empty());  // msg_name
+        EXPECT_TRUE(results->next().empty());  // msg_control
+        EXPECT_EQ(std::string(results->next().As<char>(), 4), "hell");
+        EXPECT_EQ(std::string(results->next().As<char>(), 4), "o, w");
+        auto tail = results->next();
+        EXPECT_EQ(std::string(tail.As<char>(), tail.size()), "orld");
+      },
+      &recv_output);
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+// Verifies that SendMsgHandler rejects a request with fewer iovecs than
+// announced.
+TEST(HostCallHandlersTest, SendMsgTruncatedIovecsTest) {
+  MessageReader input;
+  FillInput(
+      [](MessageWriter *params) {
+        params->Push(-1);
+        params->Push(0);
+        params->PushByCopy(Extent{nullptr, 0});
+        params->PushByCopy(Extent{nullptr, 0});
+        params->Push(0);
+        params->Push<uint64_t>(2);
+        params->PushString("only one");
+      },
+      &input);
+  MessageWriter output;
+  EXPECT_THAT(SendMsgHandler(nullptr, nullptr, &input, &output),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+}
+
+// Sends two messages with a single SendMmsgHandler call and receives both with
+// a single RecvMmsgHandler call.
+TEST(HostCallHandlersTest, SendMmsgRecvMmsgTest) {
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_DGRAM, 0, fds), 0);
+
+  MessageReader send_input;
+  FillInput(
+      [&fds](MessageWriter *params) {
+        params->Push(fds[0]);
+        params->Push(0);            // flags
+        params->Push<uint64_t>(2);  // vlen
+        for (const char *payload : {"first", "second"}) {
+          params->PushByCopy(Extent{nullptr, 0});
+          params->PushByCopy(Extent{nullptr, 0});
+          params->Push(0);
+          params->Push<uint64_t>(1);
+          params->PushByCopy(Extent{payload, strlen(payload)});
+        }
+      },
+      &send_input);
+  MessageWriter send_output;
+  ASSERT_THAT(SendMmsgHandler(nullptr, nullptr, &send_input, &send_output),
+              IsOk());
+  VerifyOutput(
+      [](MessageReader *results) {
+        ASSERT_THAT(*results, SizeIs(4));
+        EXPECT_EQ(results->next<int>(), 2);
+        results->next<int>();
+        EXPECT_EQ(results->next<uint32_t>(), 5);
+        EXPECT_EQ(results->next<uint32_t>(), 6);
+      },
+      &send_output);
+
+  MessageReader recv_input;
+  FillInput(
+      [&fds](MessageWriter *params) {
+        params->Push(fds[1]);
+        params->Push(0);                         // flags
+        params->Push<uint64_t>(2);               // vlen
+        params->PushByCopy(Extent{nullptr, 0});  // timeout
+        for (int i = 0; i < 2; ++i) {
+          params->Push<uint64_t>(0);
+          params->Push<uint64_t>(0);
+          params->Push(0);
+          params->Push<uint64_t>(1);
+          params->Push<uint64_t>(16);
+        }
+      },
+      &recv_input);
+  MessageWriter recv_output;
+  ASSERT_THAT(RecvMmsgHandler(nullptr, nullptr, &recv_input, &recv_output),
+              IsOk());
+  VerifyOutput(
+      [](MessageReader *results) {
+        ASSERT_THAT(*results, SizeIs(10));
+        EXPECT_EQ(results->next<int>(), 2);
+        results->next<int>();
+        for (const std::string payload : {"first", "second"}) {
+          EXPECT_EQ(results->next<uint32_t>(), payload.size());
+          results->next();  // msg_name
+          results->next();  // msg_control
+          auto iov = results->next();
+          EXPECT_EQ(std::string(iov.As<char>(), iov.size()), payload);
+        }
+      },
+      &recv_output);
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+// Gathers two extents with a single WritevHandler call and scatters them back
+// into two buffers of a different shape with a single ReadvHandler call.
+TEST(HostCallHandlersTest, WritevReadvTest) {
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+
+  MessageReader write_input;
+  FillInput(
+      [&fds](MessageWriter *params) {
+        params->Push(fds[1]);
+        params->Push(0);           // positional
+        params->Push<int64_t>(0);  // offset
+        params->Push<uint64_t>(2);
+        params->PushString("hello ");
+        params->PushByCopy(Extent{"world", 5});
+      },
+      &write_input);
+  MessageWriter write_output;
+  ASSERT_THAT(WritevHandler(nullptr, nullptr, &write_input, &write_output),
+              IsOk());
+  VerifyOutput(
+      [](MessageReader *results) {
+        ASSERT_THAT(*results, SizeIs(2));
+        // PushString includes the terminating null character.
+        EXPECT_EQ(results->next<int64_t>(), 12);
+      },
+      &write_output);
+
+  MessageReader read_input;
+  FillInput(
+      [&fds](MessageWriter *params) {
+        params->Push(fds[0]);
+        params->Push(0);           // positional
+        params->Push<int64_t>(0);  // offset
+        params->Push<uint64_t>(3);
+        params->Push<uint64_t>(4);
+        params->Push<uint64_t>(7);
+        params->Push<uint64_t>(16);
+      },
+      &read_input);
+  MessageWriter read_output;
+  ASSERT_THAT(ReadvHandler(nullptr, nullptr, &read_input, &read_output),
+              IsOk());
+  VerifyOutput(
+      [](MessageReader *results) {
+        ASSERT_THAT(*results, SizeIs(5));
+        EXPECT_EQ(results->next<int64_t>(), 12);
+        results->next<int>();
+        auto first = results->next();
+        EXPECT_EQ(std::string(first.As<char>(), first.size()), "hell");
+        auto second = results->next();
+        EXPECT_EQ(std::string(second.As<char>(), second.size()),
+                  std::string("o \0worl", 7));
+        auto third = results->next();
+        EXPECT_EQ(std::string(third.As<char>(), third.size()), "d");
+      },
+      &read_output);
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+TEST(HostCallHandlersTest, PositionalWritevReadvTest) {
+  char path[] = "/tmp/host_call_handlers_test_XXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_GE(fd, 0);
+  unlink(path);
+
+  MessageReader write_input;
+  FillInput(
+      [fd](MessageWriter *params) {
+        params->Push(fd);
+        params->Push(1);           // positional
+        params->Push<int64_t>(4);  // offset
+        params->Push<uint64_t>(1);
+        params->PushByCopy(Extent{"data", 4});
+      },
+      &write_input);
+  MessageWriter write_output;
+  ASSERT_THAT(WritevHandler(nullptr, nullptr, &write_input, &write_output),
+              IsOk());
+
+  MessageReader read_input;
+  FillInput(
+      [fd](MessageWriter *params) {
+        params->Push(fd);
+        params->Push(1);           // positional
+        params->Push<int64_t>(5);  // offset
+        params->Push<uint64_t>(1);
+        params->Push<uint64_t>(8);
+      },
+      &read_input);
+  MessageWriter read_output;
+  ASSERT_THAT(ReadvHandler(nullptr, nullptr, &read_input, &read_output),
+              IsOk());
+  VerifyOutput(
+      [](MessageReader *results) {
+        ASSERT_THAT(*results, SizeIs(3));
+        EXPECT_EQ(results->next<int64_t>(), 3);
+        results->next<int>();
+        auto data = results->next();
+        EXPECT_EQ(std::string(data.As<char>(), data.size()), "ata");
+      },
+      &read_output);
+
+  // Positional calls leave the file offset untouched.
+  EXPECT_EQ(lseek(fd, 0, SEEK_CUR), 0);
+  close(fd);
+}
+
+TEST(HostCallHandlersTest, WritevHandlerRejectsTruncatedIovecs) {
+  MessageReader input;
+  FillInput(
+      [](MessageWriter *params) {
+        params->Push(-1);
+        params->Push(0);
+        params->Push<int64_t>(0);
+        params->Push<uint64_t>(2);
+        params->PushString("only one");
+      },
+      &input);
+  MessageWriter output;
+  EXPECT_THAT(WritevHandler(nullptr, nullptr, &input, &output),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+}
+
+// Returns a socket listening on an ephemeral loopback port, and stores its
+// address in |addr|.
+int ListenOnLoopback(int type, struct sockaddr_in *addr) {
+  int listener = socket(AF_INET, type, 0);
+  EXPECT_GE(listener, 0);
+  *addr = {};
+  addr->sin_family = AF_INET;
+  addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t addr_len = sizeof(*addr);
+  EXPECT_EQ(bind(listener, reinterpret_cast<struct sockaddr *>(addr),
+                 sizeof(*addr)),
+            0);
+  EXPECT_EQ(listen(listener, 8), 0);
+  EXPECT_EQ(getsockname(listener, reinterpret_cast<struct sockaddr *>(addr),
+                        &addr_len),
+            0);
+  return listener;
+}
+
+void FillAcceptBatchInput(int listener, uint64_t max_connections,
+                          MessageReader *input) {
+  FillInput(
+      [listener, max_connections](MessageWriter *params) {
+        const int32_t options[] = {IPPROTO_TCP, TCP_NODELAY, 1};
+        params->Push(listener);
+        params->Push<int>(SOCK_NONBLOCK);
+        params->Push<uint64_t>(max_connections);
+        params->PushByCopy(Extent{options, 3});
+      },
+      input);
+}
+
+TEST(HostCallHandlersTest, AcceptBatchTest) {
+  struct sockaddr_in addr;
+  int listener = ListenOnLoopback(SOCK_STREAM | SOCK_NONBLOCK, &addr);
+  int clients[3];
+  for (int &client : clients) {
+    client = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_EQ(connect(client, reinterpret_cast<struct sockaddr *>(&addr),
+                      sizeof(addr)),
+              0);
+  }
+
+  MessageReader input;
+  FillAcceptBatchInput(listener, 8, &input);
+  MessageWriter output;
+  ASSERT_THAT(AcceptBatchHandler(nullptr, nullptr, &input, &output), IsOk());
+  VerifyOutput(
+      [](MessageReader *results) {
+        ASSERT_THAT(*results, SizeIs(2 + 3 * 3));
+        EXPECT_EQ(results->next<int>(), 3);
+        EXPECT_EQ(results->next<int>(), 0);
+        for (int i = 0; i < 3; ++i) {
+          int fd = results->next<int>();
+          EXPECT_EQ(results->next<int>(), 0);
+          auto peer = results->next<struct sockaddr_storage>();
+          EXPECT_EQ(peer.ss_family, AF_INET);
+          EXPECT_TRUE(fcntl(fd, F_GETFL) & O_NONBLOCK);
+          int nodelay = 0;
+          socklen_t nodelay_len = sizeof(nodelay);
+          EXPECT_EQ(getsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay,
+                               &nodelay_len),
+                    0);
+          EXPECT_EQ(nodelay, 1);
+          close(fd);
+        }
+      },
+      &output);
+
+  // No connection is left pending.
+  MessageReader empty_input;
+  FillAcceptBatchInput(listener, 8, &empty_input);
+  MessageWriter empty_output;
+  ASSERT_THAT(AcceptBatchHandler(nullptr, nullptr, &empty_input, &empty_output),
+              IsOk());
+  VerifyOutput(
+      [](MessageReader *results) {
+        ASSERT_THAT(*results, SizeIs(2));
+        EXPECT_EQ(results->next<int>(), -1);
+        EXPECT_EQ(results->next<int>(), EAGAIN);
+      },
+      &empty_output);
+
+  for (int client : clients) {
+    close(client);
+  }
+  close(listener);
+}
+
+TEST(HostCallHandlersTest, AcceptBatchTakesOneFromBlockingSocket) {
+  struct sockaddr_in addr;
+  int listener = ListenOnLoopback(SOCK_STREAM, &addr);
+  int clients[2];
+  for (int &client : clients) {
+    client = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_EQ(connect(client, reinterpret_cast<struct sockaddr *>(&addr),
+                      sizeof(addr)),
+              0);
+  }
+
+  MessageReader input;
+  FillAcceptBatchInput(listener, 8, &input);
+  MessageWriter output;
+  ASSERT_THAT(AcceptBatchHandler(nullptr, nullptr, &input, &output), IsOk());
+  VerifyOutput(
+      [](MessageReader *results) {
+        ASSERT_THAT(*results, SizeIs(2 + 3));
+        EXPECT_EQ(results->next<int>(), 1);
+        results->next<int>();
+        close(results->next<int>());
+      },
+      &output);
+
+  for (int client : clients) {
+    close(client);
+  }
+  close(listener);
+}
+
+TEST(HostCallHandlersTest, AcceptBatchRejectsMalformedOptions) {
+  MessageReader input;
+  FillInput(
+      [](MessageWriter *params) {
+        const int32_t options[] = {IPPROTO_TCP, TCP_NODELAY};
+        params->Push(0);
+        params->Push(0);
+        params->Push<uint64_t>(1);
+        params->PushByCopy(Extent{options, 2});
+      },
+      &input);
+  MessageWriter output;
+  EXPECT_THAT(AcceptBatchHandler(nullptr, nullptr, &input, &output),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+}
+
+TEST(HostCallHandlersTest, SysFutexWakeBatchWakesEveryFutex) {
+  int32_t futexes[2] = {0, 0};
+  std::thread waiter(
+      [&futexes] { sys_futex_wait(&futexes[0], 0, /*timeout_microsec=*/0); });
+
+  // The waiter may not be asleep yet, so retry until it has been woken.
+  int woken = 0;
+  while (woken == 0) {
+    MessageReader input;
+    FillInput(
+        [&futexes](MessageWriter *params) {
+          const uint64_t addresses[] = {reinterpret_cast<uint64_t>(&futexes[0]),
+                                        reinterpret_cast<uint64_t>(&futexes[1])};
+          const int32_t nums[] = {1, INT32_MAX};
+          params->PushByCopy(Extent{addresses, 2});
+          params->PushByCopy(Extent{nums, 2});
+        },
+        &input);
+    MessageWriter output;
+    ASSERT_THAT(SysFutexWakeBatchHandler(nullptr, nullptr, &input, &output),
+                IsOk());
+    VerifyOutput(
+        [&woken](MessageReader *results) {
+          ASSERT_THAT(*results, SizeIs(2));
+          woken = results->next<int>();
+          EXPECT_EQ(results->next<int>(), 0);
+        },
+        &output);
+  }
+  EXPECT_EQ(woken, 1);
+  waiter.join();
+}
+
+TEST(HostCallHandlersTest, SysFutexWakeBatchRejectsMismatchedCounts) {
+  MessageReader input;
+  FillInput(
+      [](MessageWriter *params) {
+        int32_t futex = 0;
+        const uint64_t addresses[] = {reinterpret_cast<uint64_t>(&futex)};
+        const int32_t nums[] = {1, 1};
+        params->PushByCopy(Extent{addresses, 1});
+        params->PushByCopy(Extent{nums, 2});
+      },
+      &input);
+  MessageWriter output;
+  EXPECT_THAT(SysFutexWakeBatchHandler(nullptr, nullptr, &input, &output),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+}
+
+std::string ReadFile(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  std::stringstream contents;
+  contents << file.rdbuf();
+  return contents.str();
+}
+
+// Writes |data| through WriteProfileHandler and returns its result.
+int WriteProfile(const std::string &path, const std::string &data) {
+  MessageReader input;
+  FillInput(
+      [&path, &data](MessageWriter *params) {
+        params->PushString(path);
+        params->PushByCopy(Extent{data.data(), data.size()});
+      },
+      &input);
+  MessageWriter output;
+  EXPECT_THAT(WriteProfileHandler(nullptr, nullptr, &input, &output), IsOk());
+  int result = -1;
+  VerifyOutput(
+      [&result](MessageReader *results) {
+        ASSERT_THAT(*results, SizeIs(2));
+        result = results->next<int>();
+      },
+      &output);
+  return result;
+}
+
+TEST(HostCallHandlersTest, WriteProfileReplacesFileAndExpandsPid) {
+  char directory[] = "/tmp/host_call_handlers_test_XXXXXX";
+  ASSERT_NE(mkdtemp(directory), nullptr);
+  const std::string path = absl::StrCat(directory, "/profile.%p");
+  const std::string expanded = absl::StrCat(directory, "/profile.", getpid());
+
+  EXPECT_EQ(WriteProfile(path, std::string(1000, 'a')), 0);
+  EXPECT_EQ(WriteProfile(path, std::string("counters\0", 9)), 0);
+  EXPECT_EQ(ReadFile(expanded), std::string("counters\0", 9));
+
+  unlink(expanded.c_str());
+  rmdir(directory);
+}
+
+TEST(HostCallHandlersTest, WriteProfileDefaultsToLlvmProfileFile) {
+  char directory[] = "/tmp/host_call_handlers_test_XXXXXX";
+  ASSERT_NE(mkdtemp(directory), nullptr);
+  const std::string path = absl::StrCat(directory, "/default.profraw");
+  ASSERT_EQ(setenv("LLVM_PROFILE_FILE", path.c_str(), 1), 0);
+
+  EXPECT_EQ(WriteProfile("", "counters"), 0);
+  EXPECT_EQ(ReadFile(path), "counters");
+  unsetenv("LLVM_PROFILE_FILE");
+
+  EXPECT_EQ(WriteProfile(absl::StrCat(directory, "/missing/profraw"), "x"),
+            -1);
+
+  unlink(path.c_str());
+  rmdir(directory);
+}
+
 }  // namespace
 
 }  // namespace host_call
@@ -18,6 +18,11 @@
 
 #include "asylo/platform/host_call/untrusted/host_call_handlers_util.h"
 
+#include <errno.h>
+
+#include <cstdint>
+#include <cstring>
+
 #include "asylo/platform/common/futex.h"
 
 namespace asylo {
@@ -45,5 +50,38 @@ Status SysFutexWakeHelper(primitives::MessageReader *input,
   return Status::OkStatus();
 }
 
+Status SysFutexWakeBatchHelper(primitives::MessageReader *input,
+                               primitives::MessageWriter *output) {
+  ASYLO_RETURN_IF_INCORRECT_READER_ARGUMENTS(*input, 2);
+  auto futexes = input->next();
+  auto nums = input->next();
+  size_t count = futexes.size() / sizeof(uint64_t);
+  if (count == 0 || futexes.size() % sizeof(uint64_t) != 0 ||
+      nums.size() != count * sizeof(int32_t)) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Malformed futex wake batch request.");
+  }
+
+  // Every futex is woken even if an earlier wake fails; the last failure is
+  // reported.
+  int woken = 0;
+  int wake_errno = 0;
+  for (size_t i = 0; i < count; ++i) {
+    uint64_t futex;
+    int32_t num;
+    memcpy(&futex, futexes.As<uint8_t>() + i * sizeof(futex), sizeof(futex));
+    memcpy(&num, nums.As<uint8_t>() + i * sizeof(num), sizeof(num));
+    int result = sys_futex_wake(reinterpret_cast<int32_t *>(futex), num);
+    if (result == -1) {
+      wake_errno = errno;
+    } else {
+      woken += result;
+    }
+  }
+  output->Push<int>(wake_errno ? -1 : woken);
+  output->Push<int>(wake_errno);
+  return Status::OkStatus();
+}
+
 }  // namespace host_call
 }  // namespace asylo
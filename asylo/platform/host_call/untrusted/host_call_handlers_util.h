@@ -29,6 +29,8 @@ Status SysFutexWaitHelper(primitives::MessageReader *input,
                           primitives::MessageWriter *output);
 Status SysFutexWakeHelper(primitives::MessageReader *input,
                           primitives::MessageWriter *output);
+Status SysFutexWakeBatchHelper(primitives::MessageReader *input,
+                               primitives::MessageWriter *output);
 
 }  // namespace host_call
 }  // namespace asylo
@@ -17,22 +17,133 @@
  */
 
 #include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 
-#include <cstdint>
+#include <cerrno>
+#include <cstddef>
 #include <cstdlib>
+#include <cstring>
 
-int closedir(DIR *) { abort(); }
+#include "asylo/platform/posix/io/io_manager.h"
 
-DIR *opendir(const char *) { abort(); }
+using asylo::io::IOManager;
 
-struct dirent *readdir(DIR *) {
-  abort();
+namespace {
+
+// Longest entry name a directory stream returns, as on Linux.
+constexpr size_t kMaxNameLength = 255;
+
+// Size of a struct dirent holding a name of kMaxNameLength characters.
+constexpr size_t kDirentSize =
+    offsetof(struct dirent, d_name) + kMaxNameLength + 1;
+
+// Reads the next entry of |dirp| into |entry|, which must have room for
+// kDirentSize bytes. Returns 1 if an entry was read, 0 at the end of the
+// directory, or -1 and sets errno.
+int ReadEntry(DIR *dirp, struct dirent *entry) {
+  IOManager::DirectoryEntry directory_entry;
+  int result =
+      IOManager::GetInstance().ReadDirectory(dirp->dd_fd, &directory_entry);
+  if (result <= 0) {
+    return result;
+  }
+  if (directory_entry.name.size() > kMaxNameLength) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  entry->d_ino = directory_entry.inode;
+  entry->d_off = directory_entry.next_offset;
+  entry->d_reclen =
+      offsetof(struct dirent, d_name) + directory_entry.name.size() + 1;
+  memcpy(entry->d_name, directory_entry.name.c_str(),
+         directory_entry.name.size() + 1);
+  dirp->dd_seek = directory_entry.next_offset;
+  return 1;
+}
+
+}  // namespace
+
+extern "C" {
+
+// Directory streams keep the enclave file descriptor of the directory in
+// |dd_fd|, the position of the next entry in |dd_seek| and the entry returned
+// by readdir in |dd_buf|. Entries are fetched from the host in batches, see
+// IOManager::ReadDirectory.
+DIR *opendir(const char *name) {
+  IOManager &io_manager = IOManager::GetInstance();
+  int fd = io_manager.Open(name, O_RDONLY, 0);
+  if (fd == -1) {
+    return nullptr;
+  }
+  struct stat stat_buffer;
+  if (io_manager.FStat(fd, &stat_buffer) == -1) {
+    int fstat_errno = errno;
+    io_manager.Close(fd);
+    errno = fstat_errno;
+    return nullptr;
+  }
+  if (!S_ISDIR(stat_buffer.st_mode)) {
+    io_manager.Close(fd);
+    errno = ENOTDIR;
+    return nullptr;
+  }
+
+  DIR *dirp = static_cast<DIR *>(calloc(1, sizeof(DIR)));
+  char *buffer = static_cast<char *>(malloc(kDirentSize));
+  if (!dirp || !buffer) {
+    free(dirp);
+    free(buffer);
+    io_manager.Close(fd);
+    errno = ENOMEM;
+    return nullptr;
+  }
+  dirp->dd_fd = fd;
+  dirp->dd_buf = buffer;
+  dirp->dd_len = kDirentSize;
+  return dirp;
 }
 
-int readdir_r(DIR *, struct dirent *, struct dirent **) { abort(); }
+int closedir(DIR *dirp) {
+  if (!dirp) {
+    errno = EBADF;
+    return -1;
+  }
+  int result = IOManager::GetInstance().Close(dirp->dd_fd);
+  free(dirp->dd_buf);
+  free(dirp);
+  return result;
+}
+
+struct dirent *readdir(DIR *dirp) {
+  auto entry = reinterpret_cast<struct dirent *>(dirp->dd_buf);
+  return ReadEntry(dirp, entry) == 1 ? entry : nullptr;
+}
+
+// |entry| must have room for a name of NAME_MAX characters, as POSIX requires.
+int readdir_r(DIR *dirp, struct dirent *entry, struct dirent **result) {
+  int saved_errno = errno;
+  int read_result = ReadEntry(dirp, entry);
+  if (read_result == -1) {
+    int read_errno = errno;
+    errno = saved_errno;
+    *result = nullptr;
+    return read_errno;
+  }
+  *result = read_result == 1 ? entry : nullptr;
+  return 0;
+}
+
+void rewinddir(DIR *dirp) { seekdir(dirp, 0); }
+
+void seekdir(DIR *dirp, long loc) {
+  if (IOManager::GetInstance().SeekDirectory(dirp->dd_fd, loc) == 0) {
+    dirp->dd_seek = loc;
+  }
+}
 
-void rewinddir(DIR *) { abort(); }
+long telldir(DIR *dirp) { return dirp->dd_seek; }
 
-void seekdir(DIR *, int64_t) { abort(); }
+int dirfd(DIR *dirp) { return dirp->dd_fd; }
 
-int64_t telldir(DIR *) { abort(); }
+}  // extern "C"
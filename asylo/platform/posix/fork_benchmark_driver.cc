@@ -0,0 +1,161 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <sys/resource.h>
+
+#include <cstdint>
+#include <string>
+
+#include <benchmark/benchmark.h>
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "asylo/client.h"
+#include "asylo/enclave.pb.h"
+#include "asylo/platform/posix/fork_benchmark.pb.h"
+#include "asylo/platform/primitives/sgx/loader.pb.h"
+#include "asylo/test/util/enclave_assertion_authority_configs.h"
+#include "asylo/util/status.h"
+#include "asylo/util/statusor.h"
+
+ABSL_FLAG(std::string, enclave_path, "", "Path to the fork benchmark enclave");
+
+namespace asylo {
+namespace {
+
+constexpr char kEnclaveName[] = "/fork_benchmark";
+constexpr int64_t kMiB = 1 << 20;
+
+// Loads the benchmark enclave on first use and returns its client.
+StatusOr<EnclaveClient *> GetClient() {
+  static StatusOr<EnclaveClient *> *client = [] {
+    EnclaveManager::Configure(EnclaveManagerOptions());
+    StatusOr<EnclaveManager *> manager_result = EnclaveManager::Instance();
+    if (!manager_result.ok()) {
+      return new StatusOr<EnclaveClient *>(manager_result.status());
+    }
+    EnclaveManager *manager = manager_result.ValueOrDie();
+
+    EnclaveLoadConfig load_config;
+    load_config.set_name(kEnclaveName);
+    EnclaveConfig *config = load_config.mutable_config();
+    *config->add_enclave_assertion_authority_configs() =
+        GetSgxLocalAssertionAuthorityTestConfig();
+    config->set_enable_fork(true);
+    SgxLoadConfig sgx_config;
+    sgx_config.mutable_file_enclave_config()->set_enclave_path(
+        absl::GetFlag(FLAGS_enclave_path));
+    sgx_config.set_debug(true);
+    *load_config.MutableExtension(sgx_load_config) = sgx_config;
+
+    Status status = manager->LoadEnclave(load_config);
+    if (!status.ok()) {
+      return new StatusOr<EnclaveClient *>(status);
+    }
+    return new StatusOr<EnclaveClient *>(manager->GetClient(kEnclaveName));
+  }();
+  return *client;
+}
+
+// Returns the peak resident set size of the calling process, or of its
+// terminated children if |who| is RUSAGE_CHILDREN, in MiB.
+double PeakRssMiB(int who) {
+  struct rusage usage;
+  if (getrusage(who, &usage) == -1) {
+    return 0;
+  }
+  // ru_maxrss is in KiB on Linux.
+  return static_cast<double>(usage.ru_maxrss) / 1024;
+}
+
+// Forks the enclave with state.range(0) MiB of used heap and state.range(1)
+// threads inside it. Reports the mean time until fork() returned in the parent
+// (snapshot, host fork and key handoff) and in the child (additionally
+// enclave load and restore), and the peak untrusted memory of the benchmark
+// process and of its forked children.
+void BM_Fork(benchmark::State &state) {
+  StatusOr<EnclaveClient *> client_result = GetClient();
+  if (!client_result.ok()) {
+    state.SkipWithError(client_result.status().error_message().c_str());
+    return;
+  }
+  EnclaveClient *client = client_result.ValueOrDie();
+
+  EnclaveInput input;
+  ForkBenchmarkInput *benchmark_input =
+      input.MutableExtension(fork_benchmark_input);
+  benchmark_input->set_heap_bytes(state.range(0) * kMiB);
+  benchmark_input->set_num_threads(state.range(1));
+
+  absl::Duration parent_fork = absl::ZeroDuration();
+  absl::Duration child_fork = absl::ZeroDuration();
+  for (auto _ : state) {
+    absl::Time start = absl::Now();
+    EnclaveOutput output;
+    Status status = client->EnterAndRun(input, &output);
+    if (!status.ok()) {
+      state.SkipWithError(status.error_message().c_str());
+      return;
+    }
+    state.SetIterationTime(absl::ToDoubleSeconds(absl::Now() - start));
+
+    const ForkBenchmarkOutput &benchmark_output =
+        output.GetExtension(fork_benchmark_output);
+    parent_fork += absl::Nanoseconds(benchmark_output.parent_fork_ns());
+    child_fork += absl::Nanoseconds(benchmark_output.child_fork_ns());
+  }
+
+  state.counters["parent_fork_ms"] =
+      benchmark::Counter(absl::ToDoubleMilliseconds(parent_fork),
+                         benchmark::Counter::kAvgIterations);
+  state.counters["child_fork_ms"] =
+      benchmark::Counter(absl::ToDoubleMilliseconds(child_fork),
+                         benchmark::Counter::kAvgIterations);
+  state.counters["peak_rss_mib"] = PeakRssMiB(RUSAGE_SELF);
+  state.counters["peak_child_rss_mib"] = PeakRssMiB(RUSAGE_CHILDREN);
+  state.SetBytesProcessed(state.iterations() * state.range(0) * kMiB);
+}
+
+// Sweeps the used heap from 64 MiB to 4 GiB and the number of threads. The
+// enclave snapshots its heap up to the high-water mark, so heap sizes must be
+// swept in increasing order for each run to measure the intended size.
+void ForkArguments(benchmark::internal::Benchmark *benchmark) {
+  for (int64_t heap_mib = 64; heap_mib <= 4096; heap_mib *= 4) {
+    for (int64_t threads : {1, 2, 8}) {
+      benchmark->Args({heap_mib, threads});
+    }
+  }
+}
+
+BENCHMARK(BM_Fork)
+    ->ArgNames({"heap_mib", "threads"})
+    ->Apply(ForkArguments)
+    ->Iterations(3)
+    ->UseManualTime()
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
+}  // namespace asylo
+
+int main(int argc, char *argv[]) {
+  benchmark::Initialize(&argc, argv);
+  absl::ParseCommandLine(argc, argv);
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
@@ -0,0 +1,156 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "asylo/platform/posix/fork_benchmark.pb.h"
+#include "asylo/test/util/enclave_test_application.h"
+#include "asylo/util/posix_error_space.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+namespace {
+
+constexpr int64_t kNanoSecondsPerSecond = 1000000000;
+
+int64_t MonotonicNanos() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * kNanoSecondsPerSecond + ts.tv_nsec;
+}
+
+Status PosixErrorStatus(absl::string_view what) {
+  return Status(static_cast<error::PosixError>(errno),
+                absl::StrCat(what, ": ", strerror(errno)));
+}
+
+// Keeps a thread inside the enclave, exiting briefly every millisecond, until
+// |done| is set.
+void Idle(std::atomic<int> *entered, std::atomic<bool> *done) {
+  ++*entered;
+  struct timespec ts;
+  ts.tv_sec = 0;
+  ts.tv_nsec = 1000000;
+  while (!*done) {
+    nanosleep(&ts, /*rem=*/nullptr);
+  }
+}
+
+}  // namespace
+
+// Forks once with a given amount of used heap and number of threads, and
+// reports how long fork() took to return in the parent and in the child.
+//
+// The snapshot covers the enclave heap up to its high-water mark, so a run
+// includes the heap used by every earlier run. Runs should go from small to
+// large heaps.
+class ForkBenchmark : public EnclaveTestCase {
+ public:
+  Status Run(const EnclaveInput &input, EnclaveOutput *output) override {
+    if (!input.HasExtension(fork_benchmark_input)) {
+      return Status(error::GoogleError::INVALID_ARGUMENT,
+                    "Missing fork_benchmark_input");
+    }
+    const ForkBenchmarkInput &benchmark_input =
+        input.GetExtension(fork_benchmark_input);
+
+    // Touch every page so that the heap is actually used.
+    size_t heap_bytes = benchmark_input.heap_bytes();
+    void *heap = malloc(heap_bytes);
+    if (heap_bytes > 0 && !heap) {
+      return Status(error::GoogleError::RESOURCE_EXHAUSTED,
+                    absl::StrCat("Cannot allocate ", heap_bytes,
+                                 " bytes of enclave heap"));
+    }
+    memset(heap, 1, heap_bytes);
+
+    std::atomic<int> entered(0);
+    std::atomic<bool> done(false);
+    std::vector<std::thread> threads;
+    for (int i = 1; i < benchmark_input.num_threads(); ++i) {
+      threads.emplace_back(Idle, &entered, &done);
+    }
+    while (entered < static_cast<int>(threads.size())) {
+      sched_yield();
+    }
+
+    int fds[2];
+    if (pipe(fds) == -1) {
+      return PosixErrorStatus("pipe failed");
+    }
+
+    int64_t start = MonotonicNanos();
+    pid_t pid = fork();
+    if (pid == 0) {
+      // Child enclave. Reports its timing to the parent and exits.
+      int64_t child_fork_ns = MonotonicNanos() - start;
+      bool written = write(fds[1], &child_fork_ns, sizeof(child_fork_ns)) ==
+                     sizeof(child_fork_ns);
+      _exit(written ? 0 : 1);
+    }
+    int64_t parent_fork_ns = MonotonicNanos() - start;
+
+    done = true;
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    free(heap);
+    close(fds[1]);
+
+    if (pid < 0) {
+      close(fds[0]);
+      return PosixErrorStatus("fork failed");
+    }
+
+    int64_t child_fork_ns = -1;
+    ssize_t read_size = read(fds[0], &child_fork_ns, sizeof(child_fork_ns));
+    close(fds[0]);
+
+    int wait_status;
+    if (waitpid(pid, &wait_status, 0) == -1) {
+      return PosixErrorStatus("Error waiting for child");
+    }
+    if (!WIFEXITED(wait_status) || WEXITSTATUS(wait_status) != 0 ||
+        read_size != sizeof(child_fork_ns)) {
+      return Status(error::GoogleError::INTERNAL,
+                    "Child enclave failed to report its timing");
+    }
+
+    ForkBenchmarkOutput *benchmark_output =
+        output->MutableExtension(fork_benchmark_output);
+    benchmark_output->set_parent_fork_ns(parent_fork_ns);
+    benchmark_output->set_child_fork_ns(child_fork_ns);
+    return Status::OkStatus();
+  }
+};
+
+TrustedApplication *BuildTrustedApplication() { return new ForkBenchmark; }
+
+}  // namespace asylo
@@ -0,0 +1,203 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/host_clock.h"
+
+#include <x86intrin.h>
+
+#include <atomic>
+#include <cstdint>
+
+#include "absl/base/attributes.h"
+#include "absl/numeric/int128.h"
+#include "asylo/platform/common/host_clock_page.h"
+#include "asylo/platform/common/time_util.h"
+#include "asylo/platform/core/atomic.h"
+#include "asylo/platform/primitives/trusted_primitives.h"
+
+namespace asylo {
+namespace {
+
+// One in this many reads is left to the host, so that the page is regularly
+// checked against the host clocks even when nothing else reads them.
+constexpr uint32_t kValidationPeriod = 256;
+
+// Trusted copy of the page configuration. Only |page| and |use_tsc| are read
+// concurrently; |max_staleness_ns| is written before |page| is published.
+struct {
+  HostClockPage *volatile page = nullptr;
+  int64_t max_staleness_ns = 0;
+  std::atomic<bool> use_tsc{false};
+} host_clock_state;
+
+// Latest CLOCK_MONOTONIC reading returned to the enclave.
+std::atomic<int64_t> last_monotonic_ns{0};
+
+// Latest time stamp counter reading returned by EmulateTimeStampCounter.
+std::atomic<uint64_t> last_emulated_tsc{0};
+
+// Number of page reads made by the calling thread.
+ABSL_CONST_INIT thread_local uint32_t host_clock_reads = 0;
+
+bool IsPageClock(clockid_t clock_id) {
+  return clock_id == CLOCK_REALTIME || clock_id == CLOCK_MONOTONIC;
+}
+
+int64_t SampleNanoseconds(clockid_t clock_id, const HostClockSample &sample) {
+  return clock_id == CLOCK_MONOTONIC ? sample.monotonic_ns
+                                     : sample.realtime_ns;
+}
+
+// Returns the nanoseconds elapsed since |sample| was taken according to the
+// time stamp counter, or 0 if the counter is unavailable.
+int64_t ExtrapolateNanoseconds(const HostClockSample &sample) {
+  if (!host_clock_state.use_tsc.load(std::memory_order_relaxed) ||
+      sample.nanoseconds_per_tick_q32 == 0) {
+    return 0;
+  }
+  uint64_t tsc = __rdtsc();
+  if (tsc < sample.tsc) {
+    // The counter read in the enclave is not the one read by the host, as on
+    // SGX1 where RDTSC is emulated by the runtime. Stop extrapolating.
+    host_clock_state.use_tsc.store(false, std::memory_order_relaxed);
+    return 0;
+  }
+  absl::uint128 elapsed_q32 =
+      absl::uint128(tsc - sample.tsc) * sample.nanoseconds_per_tick_q32;
+  uint64_t elapsed_ns = absl::Uint128Low64(elapsed_q32 >> 32);
+  if (absl::Uint128High64(elapsed_q32 >> 32) != 0 ||
+      elapsed_ns > static_cast<uint64_t>(host_clock_state.max_staleness_ns)) {
+    return host_clock_state.max_staleness_ns;
+  }
+  return static_cast<int64_t>(elapsed_ns);
+}
+
+// Returns |nanoseconds| or the latest CLOCK_MONOTONIC reading returned to the
+// enclave, whichever is later, and records the result.
+int64_t ClampMonotonic(int64_t nanoseconds) {
+  int64_t last = last_monotonic_ns.load(std::memory_order_relaxed);
+  while (nanoseconds > last) {
+    if (last_monotonic_ns.compare_exchange_weak(last, nanoseconds,
+                                                std::memory_order_relaxed)) {
+      return nanoseconds;
+    }
+  }
+  return last;
+}
+
+}  // namespace
+
+primitives::PrimitiveStatus EnableHostClock(void *untrusted_page,
+                                            uint64_t max_staleness_ns,
+                                            bool use_tsc) {
+  if (!untrusted_page || max_staleness_ns == 0 ||
+      max_staleness_ns > static_cast<uint64_t>(INT64_MAX) ||
+      !primitives::TrustedPrimitives::IsOutsideEnclave(untrusted_page,
+                                                       sizeof(HostClockPage))) {
+    return {error::GoogleError::INVALID_ARGUMENT,
+            "Host clock page must lie in untrusted memory."};
+  }
+  auto page = reinterpret_cast<HostClockPage *>(untrusted_page);
+  if (page->magic != kHostClockPageMagic) {
+    return {error::GoogleError::INVALID_ARGUMENT,
+            "Host clock page is not initialized."};
+  }
+  if (host_clock_state.page) {
+    return {error::GoogleError::ALREADY_EXISTS,
+            "A host clock page is already in use."};
+  }
+  host_clock_state.max_staleness_ns = static_cast<int64_t>(max_staleness_ns);
+  host_clock_state.use_tsc.store(use_tsc, std::memory_order_relaxed);
+  AtomicStore(&host_clock_state.page, page, std::memory_order_release);
+  return primitives::PrimitiveStatus::OkStatus();
+}
+
+void DisableHostClock() {
+  AtomicStore(&host_clock_state.page, static_cast<HostClockPage *>(nullptr),
+              std::memory_order_release);
+}
+
+bool ReadHostClock(clockid_t clock_id, struct timespec *time) {
+  HostClockPage *page =
+      __atomic_load_n(&host_clock_state.page, __ATOMIC_ACQUIRE);
+  if (!page || !IsPageClock(clock_id) ||
+      ++host_clock_reads % kValidationPeriod == 0) {
+    return false;
+  }
+  HostClockSample sample;
+  if (!ReadHostClockSample(page, &sample)) {
+    return false;
+  }
+  int64_t nanoseconds =
+      SampleNanoseconds(clock_id, sample) + ExtrapolateNanoseconds(sample);
+  if (clock_id == CLOCK_MONOTONIC) {
+    nanoseconds = ClampMonotonic(nanoseconds);
+  }
+  NanosecondsToTimeSpec(time, nanoseconds);
+  return true;
+}
+
+void ObserveHostClock(clockid_t clock_id, struct timespec *time) {
+  if (!IsPageClock(clock_id)) {
+    return;
+  }
+  int64_t host_nanoseconds = TimeSpecToNanoseconds(time);
+  HostClockPage *page =
+      __atomic_load_n(&host_clock_state.page, __ATOMIC_ACQUIRE);
+  HostClockSample sample;
+  if (page && ReadHostClockSample(page, &sample)) {
+    int64_t page_nanoseconds = SampleNanoseconds(clock_id, sample);
+    int64_t max_staleness_ns = host_clock_state.max_staleness_ns;
+    // The page must neither lag behind nor run ahead of the host clocks.
+    if (host_nanoseconds - page_nanoseconds > max_staleness_ns ||
+        page_nanoseconds - host_nanoseconds > max_staleness_ns) {
+      DisableHostClock();
+    }
+  }
+  if (clock_id == CLOCK_MONOTONIC) {
+    NanosecondsToTimeSpec(time, ClampMonotonic(host_nanoseconds));
+  }
+}
+
+bool EmulateTimeStampCounter(uint64_t *tsc) {
+  HostClockPage *page =
+      __atomic_load_n(&host_clock_state.page, __ATOMIC_ACQUIRE);
+  HostClockSample sample;
+  if (!page || !ReadHostClockSample(page, &sample)) {
+    return false;
+  }
+  // The counter is emulated because RDTSC faults, so extrapolating readings
+  // with it would cost an exception each.
+  host_clock_state.use_tsc.store(false, std::memory_order_relaxed);
+
+  uint64_t ticks = sample.nanoseconds_per_tick_q32 != 0
+                       ? sample.tsc
+                       : static_cast<uint64_t>(sample.monotonic_ns);
+  uint64_t last = last_emulated_tsc.load(std::memory_order_relaxed);
+  uint64_t next;
+  do {
+    // Callers commonly subtract two readings, so never return the same one
+    // twice, even between two updates of the page.
+    next = ticks > last ? ticks : last + 1;
+  } while (!last_emulated_tsc.compare_exchange_weak(last, next,
+                                                    std::memory_order_relaxed));
+  *tsc = next;
+  return true;
+}
+
+}  // namespace asylo
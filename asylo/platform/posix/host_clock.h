@@ -0,0 +1,66 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_POSIX_HOST_CLOCK_H_
+#define ASYLO_PLATFORM_POSIX_HOST_CLOCK_H_
+
+#include <time.h>
+
+#include <cstdint>
+
+#include "asylo/platform/primitives/primitive_status.h"
+
+namespace asylo {
+
+// Starts serving CLOCK_REALTIME and CLOCK_MONOTONIC reads from the host clock
+// page located at |untrusted_page|, which is validated to lie entirely outside
+// the enclave. Readings are trusted no further than a host call would be: the
+// page is dropped for good once it lags behind the host clocks by more than
+// |max_staleness_ns|. If |use_tsc| is true, readings are extrapolated from the
+// time stamp counter, by at most |max_staleness_ns|, when the host publishes
+// it and the enclave can read it. Returns an error if the page is malformed
+// or if a page is already in use.
+primitives::PrimitiveStatus EnableHostClock(void *untrusted_page,
+                                            uint64_t max_staleness_ns,
+                                            bool use_tsc);
+
+// Stops reading the host clock page.
+void DisableHostClock();
+
+// Reads |clock_id| from the host clock page into |time|. Returns false if the
+// page is not in use, cannot serve |clock_id|, or the caller should read the
+// clock from the host instead and report the reading to ObserveHostClock.
+bool ReadHostClock(clockid_t clock_id, struct timespec *time);
+
+// Checks the host clock page against |time|, a reading of |clock_id| obtained
+// from the host, and adjusts |time| so that CLOCK_MONOTONIC readings from the
+// page and from the host never go backwards relative to each other.
+void ObserveHostClock(clockid_t clock_id, struct timespec *time);
+
+// Stores in |tsc| a time stamp counter reading emulated from the host clock
+// page, for enclaves in which the RDTSC instruction faults. The reading is the
+// counter last published by the host, or the CLOCK_MONOTONIC nanoseconds if
+// the host does not publish the counter, and is always greater than the
+// previous reading. Reads no clock in the enclave and makes no host call, so
+// it is safe to call from an exception handler. Returns false if the page is
+// not in use.
+bool EmulateTimeStampCounter(uint64_t *tsc);
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_POSIX_HOST_CLOCK_H_
@@ -28,4 +28,28 @@
 #define O_DIRECT 0x20000
 #define O_SECURE 0x40000000
 
+// Flag of pipe2() creating a pipe implemented inside the enclave, for pipes
+// whose ends are only used by enclave threads. Reading, writing and polling it
+// takes no enclave exits, but the pipe is not shared with forked enclaves.
+#define O_ENCLAVE_LOCAL 0x20000000
+
+#define SPLICE_F_MOVE 0x01
+#define SPLICE_F_NONBLOCK 0x02
+#define SPLICE_F_MORE 0x04
+#define SPLICE_F_GIFT 0x08
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Moves up to |len| bytes from |fd_in| to |fd_out|, one of which must be a
+// pipe. Both file descriptors must be backed by host file descriptors, and the
+// data is moved on the host without entering the enclave.
+ssize_t splice(int fd_in, off_t *off_in, int fd_out, off_t *off_out,
+               size_t len, unsigned int flags);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
 #endif  // ASYLO_PLATFORM_POSIX_INCLUDE_FCNTL_H_
@@ -63,7 +63,13 @@ struct msghdr {
   int msg_flags;
 };
 
+struct mmsghdr {
+  struct msghdr msg_hdr;
+  unsigned int msg_len;
+};
+
 int accept(int sockfd, struct sockaddr *addr, socklen_t *addrlen);
+int accept4(int sockfd, struct sockaddr *addr, socklen_t *addrlen, int flags);
 int bind(int sockfd, const struct sockaddr *addr, socklen_t addrlen);
 int connect(int sockfd, const struct sockaddr *addr, socklen_t addrlen);
 
@@ -297,6 +303,11 @@ enum {
 #define SOCK_CLOEXEC 02000000
 // Atomically mark descriptor(s) as non-blocking.
 #define SOCK_NONBLOCK 00004000
+// Connect a TCP socket to listening sockets created with the same flag over
+// loopback inside the enclave. Such connections take no enclave exits, but
+// ignore socket options such as SO_RCVTIMEO, SO_SNDBUF and TCP_NODELAY, and are
+// not shared with forked enclaves.
+#define SOCK_ENCLAVE_LOCAL 0x20000000
 
 #define SOL_SOCKET 1
 #define SO_REUSEADDR 2
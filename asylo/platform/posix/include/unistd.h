@@ -0,0 +1,38 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include_next <unistd.h>
+
+#ifndef ASYLO_PLATFORM_POSIX_INCLUDE_UNISTD_H_
+#define ASYLO_PLATFORM_POSIX_INCLUDE_UNISTD_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Copies up to |len| bytes between two files. Both file descriptors must be
+// backed by host file descriptors, and the data is copied on the host without
+// entering the enclave.
+ssize_t copy_file_range(int fd_in, off_t *off_in, int fd_out, off_t *off_out,
+                        size_t len, unsigned int flags);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // ASYLO_PLATFORM_POSIX_INCLUDE_UNISTD_H_
@@ -16,6 +16,8 @@
  *
  */
 
+#include <poll.h>
+#include <sys/epoll.h>
 #include <sys/eventfd.h>
 #include <unistd.h>
 
@@ -196,5 +198,41 @@ TEST_F(EventFdTest, MaxCounterNonBlock) {
   EXPECT_EQ(errno, EAGAIN);
 }
 
+TEST_F(EventFdTest, PollWaitsForWriter) {
+  InitializeEventFd(false, 0, true);
+  struct pollfd pfd = {event_fd_, POLLIN, 0};
+  EXPECT_EQ(poll(&pfd, 1, 0), 0);
+
+  std::thread worker([this] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(kSleepDur));
+    Write(1);
+  });
+  ASSERT_EQ(poll(&pfd, 1, -1), 1);
+  EXPECT_EQ(pfd.revents, POLLIN);
+  EXPECT_EQ(Read(), 1);
+  worker.join();
+}
+
+TEST_F(EventFdTest, EpollWaitsForWriter) {
+  InitializeEventFd(false, 0, true);
+  int epfd = epoll_create(1);
+  ASSERT_NE(epfd, -1);
+  struct epoll_event event = {};
+  event.events = EPOLLIN;
+  event.data.u64 = 42;
+  ASSERT_EQ(epoll_ctl(epfd, EPOLL_CTL_ADD, event_fd_, &event), 0);
+  EXPECT_EQ(epoll_wait(epfd, &event, 1, 0), 0);
+
+  std::thread worker([this] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(kSleepDur));
+    Write(1);
+  });
+  ASSERT_EQ(epoll_wait(epfd, &event, 1, -1), 1);
+  EXPECT_EQ(event.events, EPOLLIN);
+  EXPECT_EQ(event.data.u64, 42);
+  worker.join();
+  close(epfd);
+}
+
 }  // namespace
 }  // namespace asylo
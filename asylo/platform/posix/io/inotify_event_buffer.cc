@@ -0,0 +1,108 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/io/inotify_event_buffer.h"
+
+#include <cstring>
+
+namespace asylo {
+namespace io {
+namespace {
+
+const struct inotify_event *EventAt(const std::vector<char> &events,
+                                    size_t offset) {
+  return reinterpret_cast<const struct inotify_event *>(events.data() +
+                                                        offset);
+}
+
+size_t EventLength(const struct inotify_event *event) {
+  return sizeof(struct inotify_event) + event->len;
+}
+
+}  // namespace
+
+bool InotifyEventBuffer::Append(int wd, uint32_t mask, uint32_t cookie,
+                                absl::string_view name) {
+  auto latest = latest_events_.find(wd);
+  if (cookie == 0 && latest != latest_events_.end() &&
+      latest->second >= begin_) {
+    const struct inotify_event *event = EventAt(events_, latest->second);
+    if (event->mask == mask && event->cookie == 0 &&
+        event->len == name.size() &&
+        memcmp(event->name, name.data(), name.size()) == 0) {
+      return false;
+    }
+  }
+
+  // Reclaim the space of read events before growing the buffer.
+  if (begin_ > 0 && begin_ >= events_.size() / 2) {
+    Compact();
+  }
+
+  struct inotify_event event;
+  event.wd = wd;
+  event.mask = mask;
+  event.cookie = cookie;
+  event.len = name.size();
+  size_t offset = events_.size();
+  events_.resize(offset + sizeof(event) + name.size());
+  memcpy(events_.data() + offset, &event, sizeof(event));
+  if (!name.empty()) {
+    memcpy(events_.data() + offset + sizeof(event), name.data(), name.size());
+  }
+  latest_events_[wd] = offset;
+  return true;
+}
+
+size_t InotifyEventBuffer::Read(char *buf, size_t count) {
+  size_t end = begin_;
+  while (end < events_.size()) {
+    size_t length = EventLength(EventAt(events_, end));
+    if (end - begin_ + length > count) {
+      break;
+    }
+    end += length;
+  }
+  size_t num_bytes = end - begin_;
+  if (num_bytes > 0) {
+    memcpy(buf, events_.data() + begin_, num_bytes);
+  }
+  begin_ = end;
+  if (empty()) {
+    events_.clear();
+    latest_events_.clear();
+    begin_ = 0;
+  }
+  return num_bytes;
+}
+
+void InotifyEventBuffer::Compact() {
+  events_.erase(events_.begin(), events_.begin() + begin_);
+  for (auto it = latest_events_.begin(); it != latest_events_.end();) {
+    if (it->second < begin_) {
+      latest_events_.erase(it++);
+    } else {
+      it->second -= begin_;
+      ++it;
+    }
+  }
+  begin_ = 0;
+}
+
+}  // namespace io
+}  // namespace asylo
@@ -0,0 +1,75 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_POSIX_IO_INOTIFY_EVENT_BUFFER_H_
+#define ASYLO_PLATFORM_POSIX_IO_INOTIFY_EVENT_BUFFER_H_
+
+#include <sys/inotify.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+
+namespace asylo {
+namespace io {
+
+// Unread inotify events, stored back to back in the layout read(2) returns
+// them in, so that reads are served with a single copy.
+//
+// Like the kernel, the buffer drops an event identical to the latest unread
+// event of the same watch. Unlike the kernel, which only compares with the
+// very last queued event, it does so per watch descriptor, so that bursts of
+// events on several watches still coalesce when they interleave. Events
+// carrying a cookie are never dropped, since they pair renames.
+//
+// This class is not thread safe.
+class InotifyEventBuffer {
+ public:
+  // Appends an event, unless it duplicates the latest unread event of |wd|.
+  // |name| includes the null padding of the event name, if any. Returns
+  // whether the event was appended.
+  bool Append(int wd, uint32_t mask, uint32_t cookie, absl::string_view name);
+
+  // Moves as many whole events as fit in |count| bytes to |buf|, in the order
+  // they were appended. Returns the number of bytes copied.
+  size_t Read(char *buf, size_t count);
+
+  // Returns whether there are no unread events.
+  bool empty() const { return begin_ == events_.size(); }
+
+ private:
+  // Drops the events read so far from the front of |events_|.
+  void Compact();
+
+  std::vector<char> events_;
+
+  // Offset in |events_| of the first unread event.
+  size_t begin_ = 0;
+
+  // Offset in |events_| of the latest event appended for each watch
+  // descriptor. Entries before |begin_| are stale.
+  absl::flat_hash_map<int, size_t> latest_events_;
+};
+
+}  // namespace io
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_POSIX_IO_INOTIFY_EVENT_BUFFER_H_
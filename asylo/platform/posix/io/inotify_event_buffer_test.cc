@@ -0,0 +1,144 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/io/inotify_event_buffer.h"
+
+#include <sys/inotify.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace io {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::IsFalse;
+using ::testing::IsTrue;
+
+// The name "file" padded to the alignment of inotify events.
+const char kName[] = "file\0\0\0\0";
+constexpr size_t kNameLength = sizeof(kName) - 1;
+constexpr size_t kEventLength = sizeof(struct inotify_event) + kNameLength;
+
+// Returns "wd:mask" for each event in |buf|.
+std::vector<std::string> Events(const char *buf, size_t len) {
+  std::vector<std::string> events;
+  for (size_t offset = 0; offset < len;) {
+    const auto *event =
+        reinterpret_cast<const struct inotify_event *>(buf + offset);
+    events.push_back(std::to_string(event->wd) + ":" +
+                     std::to_string(event->mask));
+    offset += sizeof(struct inotify_event) + event->len;
+  }
+  return events;
+}
+
+TEST(InotifyEventBufferTest, ReadsEventsInOrder) {
+  InotifyEventBuffer buffer;
+  EXPECT_THAT(buffer.empty(), IsTrue());
+  buffer.Append(1, IN_CREATE, 0, absl::string_view(kName, kNameLength));
+  buffer.Append(2, IN_MODIFY, 0, "");
+
+  char buf[2 * kEventLength];
+  size_t len = buffer.Read(buf, sizeof(buf));
+  EXPECT_THAT(len, Eq(kEventLength + sizeof(struct inotify_event)));
+  EXPECT_THAT(Events(buf, len), ElementsAre("1:256", "2:2"));
+  const auto *event = reinterpret_cast<const struct inotify_event *>(buf);
+  EXPECT_THAT(event->len, Eq(kNameLength));
+  EXPECT_THAT(std::string(event->name), Eq("file"));
+  EXPECT_THAT(buffer.empty(), IsTrue());
+}
+
+TEST(InotifyEventBufferTest, ReadsOnlyWholeEvents) {
+  InotifyEventBuffer buffer;
+  buffer.Append(1, IN_CREATE, 0, absl::string_view(kName, kNameLength));
+  buffer.Append(1, IN_DELETE, 0, absl::string_view(kName, kNameLength));
+
+  char buf[2 * kEventLength];
+  EXPECT_THAT(buffer.Read(buf, kEventLength - 1), Eq(0));
+  EXPECT_THAT(buffer.Read(buf, kEventLength + 1), Eq(kEventLength));
+  EXPECT_THAT(Events(buf, kEventLength), ElementsAre("1:256"));
+  EXPECT_THAT(buffer.empty(), IsFalse());
+  EXPECT_THAT(buffer.Read(buf, sizeof(buf)), Eq(kEventLength));
+  EXPECT_THAT(Events(buf, kEventLength), ElementsAre("1:512"));
+}
+
+TEST(InotifyEventBufferTest, CoalescesDuplicatesPerWatch) {
+  InotifyEventBuffer buffer;
+  EXPECT_THAT(buffer.Append(1, IN_MODIFY, 0, ""), IsTrue());
+  EXPECT_THAT(buffer.Append(2, IN_MODIFY, 0, ""), IsTrue());
+  EXPECT_THAT(buffer.Append(1, IN_MODIFY, 0, ""), IsFalse());
+  EXPECT_THAT(buffer.Append(2, IN_MODIFY, 0, ""), IsFalse());
+  EXPECT_THAT(buffer.Append(1, IN_ATTRIB, 0, ""), IsTrue());
+  EXPECT_THAT(buffer.Append(1, IN_MODIFY, 0, ""), IsTrue());
+
+  // Events with a different name or a cookie are kept.
+  EXPECT_THAT(buffer.Append(1, IN_MODIFY, 0,
+                            absl::string_view(kName, kNameLength)),
+              IsTrue());
+  EXPECT_THAT(buffer.Append(1, IN_MOVED_FROM, 7, ""), IsTrue());
+  EXPECT_THAT(buffer.Append(1, IN_MOVED_FROM, 7, ""), IsTrue());
+
+  char buf[8 * kEventLength];
+  size_t len = buffer.Read(buf, sizeof(buf));
+  EXPECT_THAT(Events(buf, len), ElementsAre("1:2", "2:2", "1:4", "1:2", "1:2",
+                                            "1:64", "1:64"));
+}
+
+TEST(InotifyEventBufferTest, DoesNotCoalesceWithReadEvents) {
+  InotifyEventBuffer buffer;
+  buffer.Append(1, IN_MODIFY, 0, "");
+  buffer.Append(2, IN_MODIFY, 0, "");
+
+  char buf[4 * kEventLength];
+  EXPECT_THAT(buffer.Read(buf, sizeof(struct inotify_event)),
+              Eq(sizeof(struct inotify_event)));
+  EXPECT_THAT(buffer.Append(1, IN_MODIFY, 0, ""), IsTrue());
+  EXPECT_THAT(buffer.Append(2, IN_MODIFY, 0, ""), IsFalse());
+  size_t len = buffer.Read(buf, sizeof(buf));
+  EXPECT_THAT(Events(buf, len), ElementsAre("2:2", "1:2"));
+}
+
+TEST(InotifyEventBufferTest, ReusesSpaceOfReadEvents) {
+  InotifyEventBuffer buffer;
+  buffer.Append(-1, IN_DELETE, 0, absl::string_view(kName, kNameLength));
+
+  // Each round leaves one event unread, so that the buffer is never drained.
+  char buf[2 * kEventLength];
+  for (int i = 0; i < 1000; ++i) {
+    buffer.Append(i, IN_CREATE, 0, absl::string_view(kName, kNameLength));
+    buffer.Append(i, IN_DELETE, 0, absl::string_view(kName, kNameLength));
+    ASSERT_THAT(buffer.Read(buf, sizeof(buf)), Eq(sizeof(buf)));
+    EXPECT_THAT(Events(buf, sizeof(buf)),
+                ElementsAre(std::to_string(i - 1) + ":512",
+                            std::to_string(i) + ":256"));
+  }
+  ASSERT_THAT(buffer.Read(buf, sizeof(buf)), Eq(kEventLength));
+  EXPECT_THAT(Events(buf, kEventLength), ElementsAre("999:512"));
+  EXPECT_THAT(buffer.empty(), IsTrue());
+}
+
+}  // namespace
+}  // namespace io
+}  // namespace asylo
@@ -19,19 +19,66 @@
 
 #include <errno.h>
 #include <openssl/rand.h>
+#include <poll.h>
 #include <stdint.h>
 
+#include <vector>
+
 #include "absl/memory/memory.h"
+#include "absl/time/time.h"
 #include "asylo/platform/host_call/trusted/host_calls.h"
 
 namespace asylo {
 namespace io {
+namespace {
+
+// The key of the wakeup file descriptor of the wait queue in the host epoll
+// instance, which is never assigned to a registration.
+constexpr uint64_t kWakeupKey = 0;
+
+short ToPollEvents(uint32_t epoll_events) {
+  return ((epoll_events & EPOLLIN) ? POLLIN : 0) |
+         ((epoll_events & EPOLLOUT) ? POLLOUT : 0) |
+         ((epoll_events & EPOLLRDHUP) ? POLLRDHUP : 0);
+}
 
-int IOContextEpoll::EpollCtl(int op, int hostfd, struct epoll_event *event) {
+uint32_t ToEpollEvents(short poll_events) {
+  return ((poll_events & POLLIN) ? EPOLLIN : 0) |
+         ((poll_events & POLLOUT) ? EPOLLOUT : 0) |
+         ((poll_events & POLLRDHUP) ? EPOLLRDHUP : 0) |
+         ((poll_events & POLLERR) ? EPOLLERR : 0) |
+         ((poll_events & POLLHUP) ? EPOLLHUP : 0);
+}
+
+}  // namespace
+
+int IOContextEpoll::EpollCtl(int op, int hostfd, struct epoll_event *event,
+                             const std::shared_ptr<IOContext> &target) {
+  if (hostfd == -1) {
+    return LocalEpollCtl(op, event, target);
+  }
   struct epoll_event event_copy;
   if (event) {
     event_copy.events = event->events;
   }
+  absl::MutexLock lock(&lock_);
+  if (HostEpollCtl(op, hostfd, event, target, &event_copy) != 0) {
+    return -1;
+  }
+  // A listening socket also takes connections from inside the enclave, which
+  // are reported as for a local stream.
+  if (target && target->LocalPoll(0) >= 0) {
+    if (LocalEpollCtlLocked(op, event, target) != 0 &&
+        !(op == EPOLL_CTL_DEL && errno == ENOENT)) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+int IOContextEpoll::HostEpollCtl(int op, int hostfd, struct epoll_event *event,
+                                 const std::shared_ptr<IOContext> &target,
+                                 struct epoll_event *event_copy) {
   if (op == EPOLL_CTL_ADD) {
     uint64_t key = 0;
     do {
@@ -40,51 +87,226 @@ int IOContextEpoll::EpollCtl(int op, int hostfd, struct epoll_event *event) {
         errno = EBADE;
         return -1;
       }
-    } while (key_to_data.find(key) != key_to_data.end());
-    key_to_data[key] = event->data.u64;
+    } while (key == kWakeupKey || key_to_data.find(key) != key_to_data.end());
+    key_to_data[key] = Registration{event->data.u64, target};
     fd_to_key[hostfd] = key;
-    event_copy.data.u64 = key;
+    event_copy->data.u64 = key;
   } else if (op == EPOLL_CTL_MOD) {
-    if (fd_to_key.find(hostfd) == fd_to_key.end()) {
+    auto it = fd_to_key.find(hostfd);
+    if (it == fd_to_key.end()) {
       errno = ENOENT;
       return -1;
     }
-    uint64_t key = fd_to_key[hostfd];
-    key_to_data[key] = event->data.u64;
-    event_copy.data.u64 = key;
+    uint64_t key = it->second;
+    key_to_data[key] = Registration{event->data.u64, target};
+    event_copy->data.u64 = key;
   } else if (op == EPOLL_CTL_DEL) {
-    if (fd_to_key.find(hostfd) == fd_to_key.end()) {
+    auto it = fd_to_key.find(hostfd);
+    if (it == fd_to_key.end()) {
       errno = ENOENT;
       return -1;
     }
-    uint64_t key = fd_to_key[hostfd];
-    event_copy.data.u64 = key;
-    fd_to_key.erase(hostfd);
+    uint64_t key = it->second;
+    event_copy->data.u64 = key;
+    fd_to_key.erase(it);
     key_to_data.erase(key);
   } else {
     return -1;
   }
-  return enc_untrusted_epoll_ctl(host_fd_, op, hostfd, &event_copy);
+  return enc_untrusted_epoll_ctl(host_fd_, op, hostfd, event_copy);
+}
+
+int IOContextEpoll::LocalEpollCtl(int op, struct epoll_event *event,
+                                  const std::shared_ptr<IOContext> &target) {
+  absl::MutexLock lock(&lock_);
+  return LocalEpollCtlLocked(op, event, target);
+}
+
+int IOContextEpoll::LocalEpollCtlLocked(
+    int op, struct epoll_event *event,
+    const std::shared_ptr<IOContext> &target) {
+  auto it = local_registrations_.find(target.get());
+  if (op == EPOLL_CTL_ADD || op == EPOLL_CTL_MOD) {
+    if (!event) {
+      errno = EFAULT;
+      return -1;
+    }
+    if ((op == EPOLL_CTL_ADD) != (it == local_registrations_.end())) {
+      errno = op == EPOLL_CTL_ADD ? EEXIST : ENOENT;
+      return -1;
+    }
+    local_registrations_[target.get()] = LocalRegistration{
+        event->events, event->data.u64, target,
+        /*reported_generation=*/~uint64_t{0}, /*disabled=*/false};
+    return 0;
+  } else if (op == EPOLL_CTL_DEL) {
+    if (it == local_registrations_.end()) {
+      errno = ENOENT;
+      return -1;
+    }
+    local_registrations_.erase(it);
+    return 0;
+  }
+  errno = EINVAL;
+  return -1;
+}
+
+int IOContextEpoll::CollectLocalEvents(struct epoll_event *events,
+                                       int maxevents, uint64_t generation) {
+  int count = 0;
+  for (auto it = local_registrations_.begin();
+       it != local_registrations_.end() && count < maxevents;) {
+    LocalRegistration &registration = it->second;
+    std::shared_ptr<IOContext> target = registration.target.lock();
+    if (!target) {
+      // The stream was closed, which removes it from the interest list.
+      local_registrations_.erase(it++);
+      continue;
+    }
+    ++it;
+    if (registration.disabled ||
+        ((registration.events & EPOLLET) &&
+         registration.reported_generation == generation)) {
+      continue;
+    }
+    int ready = target->LocalPoll(ToPollEvents(registration.events));
+    if (ready <= 0) {
+      continue;
+    }
+    registration.reported_generation = generation;
+    registration.disabled = registration.events & EPOLLONESHOT;
+    events[count].events = ToEpollEvents(ready);
+    events[count].data.u64 = registration.data;
+    ++count;
+  }
+  return count;
+}
+
+int IOContextEpoll::TranslateHostEvents(struct epoll_event *events, int count,
+                                        uint64_t snapshot) {
+  // Convert the random bits in the data field back to the original data using
+  // the key_to_data map. Events for keys which are no longer registered were
+  // reported for descriptors deleted while the host call was in flight, and
+  // are dropped, as are the events of the wakeup file descriptor.
+  int translated = 0;
+  for (int i = 0; i < count; ++i) {
+    auto it = key_to_data.find(events[i].data.u64);
+    if (it == key_to_data.end()) {
+      continue;
+    }
+    // A descriptor missing from the results may still be ready, so only the
+    // reported events are recorded.
+    std::shared_ptr<IOContext> target = it->second.target.lock();
+    if (target) {
+      short ready = ((events[i].events & EPOLLIN) ? POLLIN : 0) |
+                    ((events[i].events & EPOLLOUT) ? POLLOUT : 0);
+      short conditions = ((events[i].events & EPOLLERR) ? POLLERR : 0) |
+                         ((events[i].events & EPOLLHUP) ? POLLHUP : 0);
+      target->readiness_cache()->Update(snapshot, ready, ready | conditions);
+    }
+    events[translated].events = events[i].events;
+    events[translated].data.u64 = it->second.data;
+    ++translated;
+  }
+  return translated;
 }
 
 int IOContextEpoll::EpollWait(struct epoll_event *events, int maxevents,
                               int timeout) {
+  bool has_local_streams;
+  {
+    absl::MutexLock lock(&lock_);
+    has_local_streams = !local_registrations_.empty();
+  }
+  if (has_local_streams) {
+    return EpollWaitWithLocalStreams(events, maxevents, timeout);
+  }
+  uint64_t snapshot = ReadinessCache::Snapshot();
   int ret = enc_untrusted_epoll_wait(host_fd_, events, maxevents, timeout);
   if (ret == -1) {
     // errno is set in enc_untrusted_epoll_wait.
     return -1;
   }
-  // Convert the random bits in the data field back to the original data using
-  // the key_to_data map.
-  for (int i = 0; i < ret; ++i) {
-    uint64_t key = events[i].data.u64;
-    if (key_to_data.find(key) == key_to_data.end()) {
-      errno = EBADE;
+  absl::MutexLock lock(&lock_);
+  return TranslateHostEvents(events, ret, snapshot);
+}
+
+int IOContextEpoll::EpollWaitWithLocalStreams(struct epoll_event *events,
+                                              int maxevents, int timeout) {
+  if (maxevents <= 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  const absl::Time deadline = LocalWaitQueue::Deadline(timeout);
+  std::vector<struct epoll_event> host_events;
+  while (true) {
+    // Register before checking the local streams, so that no change after the
+    // check goes unnoticed.
+    uint64_t generation;
+    bool wait_on_host;
+    int count;
+    {
+      absl::MutexLock lock(&lock_);
+      wait_on_host = !fd_to_key.empty();
+      if (wait_on_host) {
+        int wakeup_fd = wait_queue_->BeginHostWait(&generation);
+        if (wakeup_fd < 0) {
+          return -1;
+        }
+        if (!host_wakeup_added_) {
+          struct epoll_event wakeup_event;
+          wakeup_event.events = EPOLLIN;
+          wakeup_event.data.u64 = kWakeupKey;
+          if (enc_untrusted_epoll_ctl(host_fd_, EPOLL_CTL_ADD, wakeup_fd,
+                                      &wakeup_event) != 0) {
+            wait_queue_->EndHostWait(generation);
+            return -1;
+          }
+          host_wakeup_added_ = true;
+        }
+      } else {
+        generation = wait_queue_->Generation();
+      }
+      count = CollectLocalEvents(events, maxevents, generation);
+    }
+
+    if (!wait_on_host) {
+      if (count > 0 || timeout == 0) {
+        return count;
+      }
+      if (!wait_queue_->Wait(generation, deadline)) {
+        return 0;
+      }
+      continue;
+    }
+
+    // Wait for the host file descriptors, including the wakeup file descriptor
+    // to learn about changes of the local streams.
+    int host_timeout =
+        count > 0 ? 0 : LocalWaitQueue::RemainingTimeout(deadline);
+    int ret = 0;
+    uint64_t snapshot = ReadinessCache::Snapshot();
+    if (count < maxevents) {
+      host_events.resize(maxevents - count);
+      ret = enc_untrusted_epoll_wait(host_fd_, host_events.data(),
+                                     host_events.size(), host_timeout);
+    }
+    wait_queue_->EndHostWait(generation);
+    if (ret == -1) {
+      // errno is set in enc_untrusted_epoll_wait.
       return -1;
     }
-    events[i].data.u64 = key_to_data[key];
+    {
+      absl::MutexLock lock(&lock_);
+      ret = TranslateHostEvents(host_events.data(), ret, snapshot);
+    }
+    for (int i = 0; i < ret; ++i) {
+      events[count++] = host_events[i];
+    }
+    if (count > 0 || host_timeout == 0) {
+      return count;
+    }
   }
-  return ret;
 }
 
 int IOContextEpoll::GetHostFileDescriptor() { return host_fd_; }
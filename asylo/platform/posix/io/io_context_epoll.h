@@ -19,19 +19,33 @@
 #ifndef ASYLO_PLATFORM_POSIX_IO_IO_CONTEXT_EPOLL_H_
 #define ASYLO_PLATFORM_POSIX_IO_IO_CONTEXT_EPOLL_H_
 
-#include <unordered_map>
+#include <cstdint>
+#include <memory>
 
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
 #include "asylo/platform/posix/io/io_manager.h"
+#include "asylo/platform/posix/io/local_wait_queue.h"
 
 namespace asylo {
 namespace io {
-// IOContext implementation wrapping an epoll file descriptor
+// IOContext implementation wrapping an epoll file descriptor. Local streams,
+// which have no host file descriptor, are registered with the context itself
+// and polled inside the enclave.
 class IOContextEpoll : public IOManager::IOContext {
  public:
-  explicit IOContextEpoll(int host_fd) : host_fd_(host_fd) {}
+  // Waits for local streams through |wait_queue|, which must outlive the
+  // context.
+  IOContextEpoll(int host_fd, LocalWaitQueue *wait_queue)
+      : host_fd_(host_fd), wait_queue_(wait_queue) {}
   // It's important to note that adding dup'd file descriptors here won't work
-  // the same as it would in POSIX.
-  int EpollCtl(int op, int hostfd, struct epoll_event *event) override;
+  // the same as it would in POSIX. Local streams are registered when |hostfd|
+  // is -1. A target with both a host file descriptor and local state, such as
+  // a listening socket, is registered both ways, and may be reported twice by
+  // a single EpollWait.
+  int EpollCtl(int op, int hostfd, struct epoll_event *event,
+               const std::shared_ptr<IOContext> &target) override;
   int EpollWait(struct epoll_event *events, int maxevents,
                 int timeout) override;
   int GetHostFileDescriptor() override;
@@ -40,12 +54,80 @@ class IOContextEpoll : public IOManager::IOContext {
   int Close();
 
  private:
+  // Registers |hostfd|, the host file descriptor of |target|, with the host
+  // epoll instance, using |event_copy| for the host call.
+  int HostEpollCtl(int op, int hostfd, struct epoll_event *event,
+                   const std::shared_ptr<IOContext> &target,
+                   struct epoll_event *event_copy)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Registers the local stream |target|.
+  int LocalEpollCtl(int op, struct epoll_event *event,
+                    const std::shared_ptr<IOContext> &target);
+  int LocalEpollCtlLocked(int op, struct epoll_event *event,
+                          const std::shared_ptr<IOContext> &target)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Stores up to |maxevents| events of the ready local streams in |events|,
+  // as of |generation| of the wait queue. Returns the number of events stored.
+  int CollectLocalEvents(struct epoll_event *events, int maxevents,
+                         uint64_t generation);
+
+  // Replaces the keys in the |count| |events| returned by the host with the
+  // data of their registrations, dropping stale events. Returns the number of
+  // events left.
+  int TranslateHostEvents(struct epoll_event *events, int count,
+                          uint64_t snapshot);
+
+  // Implements EpollWait when local streams are registered.
+  int EpollWaitWithLocalStreams(struct epoll_event *events, int maxevents,
+                                int timeout);
+
   // Host file descriptor implementing this stream.
   int host_fd_;
-  std::unordered_map<uint64_t, uint64_t> key_to_data;
+
+  LocalWaitQueue *const wait_queue_;
+
+  // Guards the key maps, which are consulted after every host epoll_wait and
+  // may be updated concurrently by EpollCtl.
+  absl::Mutex lock_;
+
+  // The data supplied by the enclave for a registered file descriptor, and the
+  // context whose readiness cache records the events reported for it.
+  struct Registration {
+    uint64_t data;
+    std::weak_ptr<IOContext> target;
+  };
+
+  // Maps the random key registered with the host for each file descriptor to
+  // its registration.
+  absl::flat_hash_map<uint64_t, Registration> key_to_data
+      ABSL_GUARDED_BY(lock_);
   // Manages a mapping from the host file descriptor to a random key to enable
   // updates to the above map durring deletions/modifications.
-  std::unordered_map<int, uint64_t> fd_to_key;
+  absl::flat_hash_map<int, uint64_t> fd_to_key ABSL_GUARDED_BY(lock_);
+
+  // A registered local stream.
+  struct LocalRegistration {
+    uint32_t events;
+    uint64_t data;
+    std::weak_ptr<IOContext> target;
+
+    // The generation of the wait queue when the stream was last reported, to
+    // report edge-triggered streams only after a change.
+    uint64_t reported_generation;
+
+    // Whether a one-shot registration has been reported.
+    bool disabled;
+  };
+
+  // The local streams registered, by context.
+  absl::flat_hash_map<IOContext *, LocalRegistration> local_registrations_
+      ABSL_GUARDED_BY(lock_);
+
+  // Whether the wakeup file descriptor of |wait_queue_| was added to the host
+  // epoll instance.
+  bool host_wakeup_added_ ABSL_GUARDED_BY(lock_) = false;
 };
 
 }  // namespace io
@@ -17,6 +17,8 @@
  */
 #include "asylo/platform/posix/io/io_context_eventfd.h"
 
+#include <poll.h>
+
 constexpr uint64_t kMaxCounter = 0xfffffffffffffffe;
 constexpr ssize_t kCounterBufSize = sizeof(uint64_t);
 
@@ -28,21 +30,24 @@ ssize_t IOContextEventFd::Read(void *buf, size_t count) {
     errno = EINVAL;
     return -1;
   }
-  absl::MutexLock counter_mutex_lock(&counter_mutex_);
-  if (nonblock_ && (counter_ == 0)) {
-    errno = EAGAIN;
-    return -1;
-  } else {
-    auto ready = [this]() { return counter_ > 0; };
-    counter_mutex_.Await(absl::Condition(&ready));
-  }
-  if (semaphore_) {
-    *reinterpret_cast<uint64_t *>(buf) = 1;
-    --counter_;
-  } else {
-    *reinterpret_cast<uint64_t *>(buf) = counter_;
-    counter_ = 0;
+  {
+    absl::MutexLock counter_mutex_lock(&counter_mutex_);
+    if (nonblock_ && (counter_ == 0)) {
+      errno = EAGAIN;
+      return -1;
+    } else {
+      auto ready = [this]() { return counter_ > 0; };
+      counter_mutex_.Await(absl::Condition(&ready));
+    }
+    if (semaphore_) {
+      *reinterpret_cast<uint64_t *>(buf) = 1;
+      --counter_;
+    } else {
+      *reinterpret_cast<uint64_t *>(buf) = counter_;
+      counter_ = 0;
+    }
   }
+  wait_queue_->Notify();
   return kCounterBufSize;
 }
 
@@ -56,15 +61,18 @@ ssize_t IOContextEventFd::Write(const void *buf, size_t count) {
     errno = EINVAL;
     return -1;
   }
-  absl::MutexLock counter_mutex_lock(&counter_mutex_);
-  if (nonblock_ && (counter_ + add > kMaxCounter)) {
-    errno = EAGAIN;
-    return -1;
-  } else {
-    auto ready = [this, add]() { return (counter_ + add) <= kMaxCounter; };
-    counter_mutex_.Await(absl::Condition(&ready));
+  {
+    absl::MutexLock counter_mutex_lock(&counter_mutex_);
+    if (nonblock_ && (counter_ + add > kMaxCounter)) {
+      errno = EAGAIN;
+      return -1;
+    } else {
+      auto ready = [this, add]() { return (counter_ + add) <= kMaxCounter; };
+      counter_mutex_.Await(absl::Condition(&ready));
+    }
+    counter_ += add;
   }
-  counter_ += add;
+  wait_queue_->Notify();
   return kCounterBufSize;
 }
 
@@ -72,5 +80,17 @@ int IOContextEventFd::Close() {
   return 0;
 }
 
+int IOContextEventFd::LocalPoll(short events) {
+  absl::MutexLock counter_mutex_lock(&counter_mutex_);
+  short ready = 0;
+  if (counter_ > 0) {
+    ready |= POLLIN;
+  }
+  if (counter_ < kMaxCounter) {
+    ready |= POLLOUT;
+  }
+  return ready & events;
+}
+
 }  // namespace io
 }  // namespace asylo
@@ -25,14 +25,17 @@
 
 #include "absl/synchronization/mutex.h"
 #include "asylo/platform/posix/io/io_manager.h"
+#include "asylo/platform/posix/io/local_wait_queue.h"
 
 namespace asylo {
 namespace io {
 // IOContext implementation wrapping an epoll file descriptor
 class IOContextEventFd : public IOManager::IOContext {
  public:
-  explicit IOContextEventFd(unsigned int initval, int flags)
-      : counter_(initval) {
+  // Changes in the readiness of the eventfd are reported to |wait_queue|,
+  // which must outlive it.
+  IOContextEventFd(unsigned int initval, int flags, LocalWaitQueue *wait_queue)
+      : counter_(initval), wait_queue_(wait_queue) {
     if (flags & EFD_SEMAPHORE) {
       semaphore_ = true;
     } else {
@@ -48,12 +51,14 @@ class IOContextEventFd : public IOManager::IOContext {
   ssize_t Read(void *buf, size_t count) override;
   ssize_t Write(const void *buf, size_t count) override;
   int Close() override;
+  int LocalPoll(short events) override;
 
  private:
   // Host file descriptor implementing this stream.
   uint64_t counter_;
   bool semaphore_;
   bool nonblock_;
+  LocalWaitQueue *const wait_queue_;
   absl::Mutex counter_mutex_;
 };
 
@@ -19,12 +19,22 @@
 
 #include <sys/inotify.h>
 
+#include <algorithm>
+#include <cstdint>
+
+#include "absl/strings/string_view.h"
 #include "asylo/platform/common/memory.h"
 #include "asylo/platform/host_call/serializer_functions.h"
 #include "asylo/platform/host_call/trusted/host_calls.h"
 
 namespace asylo {
 namespace io {
+namespace {
+
+// Minimum number of bytes of events read from the host at once.
+constexpr size_t kHostReadLength = 64 * 1024;
+
+}  // namespace
 
 int IOContextInotify::GetHostFileDescriptor() { return host_fd_; }
 
@@ -36,57 +46,41 @@ int IOContextInotify::InotifyRmWatch(int wd) {
   return enc_untrusted_inotify_rm_watch(host_fd_, wd);
 }
 
-size_t IOContextInotify::TransferFromQueueToBuffer(char *buf_ptr,
-                                                   size_t count) {
-  size_t num_bytes_written = 0;
-  while (!event_queue_.empty()) {
-    struct inotify_event *front_event = event_queue_.front();
-    size_t front_event_len = sizeof(struct inotify_event) + front_event->len;
-    if (count < front_event_len) {
-      return num_bytes_written;
-    }
-    memcpy(buf_ptr, front_event, front_event_len);
-    buf_ptr += front_event_len;
-    num_bytes_written += front_event_len;
-    count -= front_event_len;
-    asylo::MallocUniquePtr<struct inotify_event> ev_ptr(front_event);
-    event_queue_.pop();
-  }
-  return num_bytes_written;
-}
-
-ssize_t IOContextInotify::Read(void *buf, size_t count) {
-  // Remove events from queue, if there are any.
-  char *buf_ptr = static_cast<char *>(buf);
-  size_t num_bytes_written = TransferFromQueueToBuffer(buf_ptr, count);
-  buf_ptr += num_bytes_written;
-  count -= num_bytes_written;
-  // Check if the buffer was too small.
-  if (!event_queue_.empty() && (num_bytes_written == 0)) {
-    errno = EINVAL;
-    return -1;
-  } else if (!event_queue_.empty() || count == 0) {
-    // No need to read events from the host if the queue is not empty.
-    return num_bytes_written;
-  }
-  // Read serialized events from the host, adjusting for space left in buffer.
+int IOContextInotify::ReadFromHost(size_t count) {
+  // Read well beyond |count|, so that a burst of events takes few host calls.
+  // The events which do not fit in the caller's buffer serve later reads.
   char *serialized_events = nullptr;
   size_t serialized_events_len = 0;
-  if (enc_untrusted_inotify_read(host_fd_, count, &serialized_events,
+  if (enc_untrusted_inotify_read(host_fd_, std::max(count, kHostReadLength),
+                                 &serialized_events,
                                  &serialized_events_len) < 0) {
     // errno is set by enc_untrusted_inotify_read.
     return -1;
   }
   asylo::MallocUniquePtr<char> serialized_events_ptr(serialized_events);
-  // Extract events back into the queue.
   if (!asylo::host_call::DeserializeInotifyEvents(
-          serialized_events, serialized_events_len, &event_queue_)) {
+          serialized_events, serialized_events_len,
+          [this](int wd, uint32_t mask, uint32_t cookie,
+                 absl::string_view name) {
+            events_.Append(wd, mask, cookie, name);
+          })) {
     errno = EBADE;
     return -1;
   }
-  // Transfer events from the queue into the buffer again (as much as possible).
-  num_bytes_written += TransferFromQueueToBuffer(buf_ptr, count);
-  if (!event_queue_.empty() && (num_bytes_written == 0)) {
+  return 0;
+}
+
+ssize_t IOContextInotify::Read(void *buf, size_t count) {
+  if (count == 0) {
+    return 0;
+  }
+  // Only go to the host once the events read before are all consumed.
+  if (events_.empty() && ReadFromHost(count) < 0) {
+    return -1;
+  }
+  size_t num_bytes_written = events_.Read(static_cast<char *>(buf), count);
+  // Check if the buffer was too small.
+  if (num_bytes_written == 0 && !events_.empty()) {
     errno = EINVAL;
     return -1;
   }
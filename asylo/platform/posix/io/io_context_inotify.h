@@ -21,7 +21,7 @@
 
 #include <sys/inotify.h>
 
-#include <queue>
+#include "asylo/platform/posix/io/inotify_event_buffer.h"
 #include "asylo/platform/posix/io/io_manager.h"
 
 namespace asylo {
@@ -40,10 +40,14 @@ class IOContextInotify : public IOManager::IOContext {
   int Close() override;
 
  private:
-  size_t TransferFromQueueToBuffer(char *buf_ptr, size_t count);
+  // Reads a batch of events from the host into |events_|.
+  int ReadFromHost(size_t count);
+
   // Host file descriptor implementing this stream.
   int host_fd_;
-  std::queue<struct inotify_event *> event_queue_;
+
+  // Events read from the host but not yet by the enclave.
+  InotifyEventBuffer events_;
 };
 
 }  // namespace io
@@ -0,0 +1,367 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/io/io_context_local_pipe.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+
+namespace asylo {
+namespace io {
+namespace {
+
+constexpr size_t kPageSize = 4096;
+
+// Returns the total length of the |iovcnt| buffers of |iov|, or -1 and sets
+// errno if they are invalid.
+ssize_t TotalLength(const struct iovec *iov, int iovcnt) {
+  if (iovcnt < 0 || (iovcnt > 0 && !iov)) {
+    errno = EINVAL;
+    return -1;
+  }
+  size_t total = 0;
+  for (int i = 0; i < iovcnt; ++i) {
+    total += iov[i].iov_len;
+  }
+  if (total > SSIZE_MAX) {
+    errno = EINVAL;
+    return -1;
+  }
+  return total;
+}
+
+}  // namespace
+
+struct IOContextLocalPipe::Pipe {
+  explicit Pipe(size_t capacity) : ring(capacity) {}
+
+  // Returns the number of bytes which can be written without blocking.
+  size_t space() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu) {
+    return ring.size() - size;
+  }
+
+  // Appends |count| bytes of |buf| to the pipe. There must be enough space.
+  void Push(const char *buf, size_t count) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu) {
+    size_t tail = (head + size) % ring.size();
+    size_t first = std::min(count, ring.size() - tail);
+    memcpy(ring.data() + tail, buf, first);
+    memcpy(ring.data(), buf + first, count - first);
+    size += count;
+  }
+
+  // Copies |count| bytes of the pipe starting |offset| bytes after its first
+  // byte to |buf|, leaving them in the pipe. There must be enough data.
+  void Peek(char *buf, size_t offset, size_t count) const
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu) {
+    size_t start = (head + offset) % ring.size();
+    size_t first = std::min(count, ring.size() - start);
+    memcpy(buf, ring.data() + start, first);
+    memcpy(buf + first, ring.data(), count - first);
+  }
+
+  // Moves the first |count| bytes of the pipe to |buf|. There must be enough
+  // data.
+  void Pop(char *buf, size_t count) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu) {
+    Peek(buf, 0, count);
+    Consume(count);
+  }
+
+  // Removes the first |count| bytes of the pipe. There must be enough data.
+  void Consume(size_t count) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu) {
+    head = (head + count) % ring.size();
+    size -= count;
+    if (size == 0) {
+      head = 0;
+    }
+  }
+
+  // Changes the capacity of the pipe to |capacity|, which must hold the data
+  // in the pipe.
+  void Resize(size_t capacity) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu) {
+    std::vector<char> resized(capacity);
+    size_t count = size;
+    Pop(resized.data(), count);
+    ring = std::move(resized);
+    head = 0;
+    size = count;
+  }
+
+  mutable absl::Mutex mu;
+
+  // The data in the pipe are the |size| bytes starting at |head|, wrapping
+  // around the end of |ring|.
+  std::vector<char> ring ABSL_GUARDED_BY(mu);
+  size_t head ABSL_GUARDED_BY(mu) = 0;
+  size_t size ABSL_GUARDED_BY(mu) = 0;
+
+  bool reader_open ABSL_GUARDED_BY(mu) = true;
+  bool writer_open ABSL_GUARDED_BY(mu) = true;
+};
+
+constexpr size_t IOContextLocalPipe::kDefaultCapacity;
+constexpr size_t IOContextLocalPipe::kMaxCapacity;
+
+void IOContextLocalPipe::CreatePipe(
+    int flags, LocalWaitQueue *wait_queue,
+    std::unique_ptr<IOContextLocalPipe> *read_end,
+    std::unique_ptr<IOContextLocalPipe> *write_end) {
+  auto pipe = std::make_shared<Pipe>(kDefaultCapacity);
+  read_end->reset(
+      new IOContextLocalPipe(pipe, /*write_end=*/false, flags, wait_queue));
+  write_end->reset(
+      new IOContextLocalPipe(pipe, /*write_end=*/true, flags, wait_queue));
+}
+
+IOContextLocalPipe::IOContextLocalPipe(std::shared_ptr<Pipe> pipe,
+                                       bool write_end, int flags,
+                                       LocalWaitQueue *wait_queue)
+    : pipe_(std::move(pipe)),
+      write_end_(write_end),
+      wait_queue_(wait_queue),
+      status_flags_(flags & O_NONBLOCK),
+      fd_flags_((flags & O_CLOEXEC) ? FD_CLOEXEC : 0) {}
+
+IOContextLocalPipe::~IOContextLocalPipe() {
+  if (!closed_) {
+    Close();
+  }
+}
+
+ssize_t IOContextLocalPipe::Read(void *buf, size_t count) {
+  struct iovec iov = {buf, count};
+  return Readv(&iov, 1);
+}
+
+ssize_t IOContextLocalPipe::Write(const void *buf, size_t count) {
+  struct iovec iov = {const_cast<void *>(buf), count};
+  return Writev(&iov, 1);
+}
+
+ssize_t IOContextLocalPipe::Readv(const struct iovec *iov, int iovcnt) {
+  return ReadvWithFlags(iov, iovcnt, /*flags=*/0);
+}
+
+ssize_t IOContextLocalPipe::Writev(const struct iovec *iov, int iovcnt) {
+  return WritevWithFlags(iov, iovcnt, /*flags=*/0);
+}
+
+ssize_t IOContextLocalPipe::ReadvWithFlags(const struct iovec *iov, int iovcnt,
+                                           int flags) {
+  if (write_end_) {
+    errno = EBADF;
+    return -1;
+  }
+  ssize_t total = TotalLength(iov, iovcnt);
+  if (total <= 0) {
+    return total;
+  }
+
+  size_t count;
+  {
+    absl::MutexLock lock(&pipe_->mu);
+    if (pipe_->size == 0 && pipe_->writer_open) {
+      if ((status_flags_ & O_NONBLOCK) || (flags & MSG_DONTWAIT)) {
+        errno = EAGAIN;
+        return -1;
+      }
+      auto readable = [this]() {
+        return pipe_->size > 0 || !pipe_->writer_open;
+      };
+      pipe_->mu.Await(absl::Condition(&readable));
+    }
+    count = std::min<size_t>(total, pipe_->size);
+    size_t copied = 0;
+    for (int i = 0; copied < count; ++i) {
+      size_t length = std::min(iov[i].iov_len, count - copied);
+      pipe_->Peek(static_cast<char *>(iov[i].iov_base), copied, length);
+      copied += length;
+    }
+    if (flags & MSG_PEEK) {
+      return count;
+    }
+    pipe_->Consume(count);
+  }
+  if (count > 0) {
+    wait_queue_->Notify();
+  }
+  return count;
+}
+
+ssize_t IOContextLocalPipe::WritevWithFlags(const struct iovec *iov,
+                                            int iovcnt, int flags) {
+  if (!write_end_) {
+    errno = EBADF;
+    return -1;
+  }
+  ssize_t total = TotalLength(iov, iovcnt);
+  if (total <= 0) {
+    return total;
+  }
+
+  // Writes of up to PIPE_BUF bytes are atomic, so they wait for enough space
+  // to write all of their data at once.
+  const size_t needed = total <= PIPE_BUF ? total : 1;
+  size_t written = 0;
+  bool notify = false;
+  {
+    absl::MutexLock lock(&pipe_->mu);
+    int i = 0;
+    size_t offset = 0;
+    while (written < static_cast<size_t>(total)) {
+      if (!pipe_->reader_open) {
+        break;
+      }
+      if (pipe_->space() < needed) {
+        if ((status_flags_ & O_NONBLOCK) || (flags & MSG_DONTWAIT)) {
+          break;
+        }
+        // Let waiters for the read end see the data written so far.
+        if (notify) {
+          wait_queue_->Notify();
+          notify = false;
+        }
+        auto writable = [this, needed]() {
+          return pipe_->space() >= needed || !pipe_->reader_open;
+        };
+        pipe_->mu.Await(absl::Condition(&writable));
+        continue;
+      }
+      size_t count = std::min(total - written, pipe_->space());
+      written += count;
+      while (count > 0) {
+        size_t length = std::min(iov[i].iov_len - offset, count);
+        pipe_->Push(static_cast<const char *>(iov[i].iov_base) + offset,
+                    length);
+        offset += length;
+        count -= length;
+        if (offset == iov[i].iov_len) {
+          ++i;
+          offset = 0;
+        }
+      }
+      notify = true;
+    }
+    if (written == 0) {
+      errno = pipe_->reader_open ? EAGAIN : EPIPE;
+      return -1;
+    }
+  }
+  if (notify) {
+    wait_queue_->Notify();
+  }
+  return written;
+}
+
+int IOContextLocalPipe::Close() {
+  {
+    absl::MutexLock lock(&pipe_->mu);
+    if (write_end_) {
+      pipe_->writer_open = false;
+    } else {
+      pipe_->reader_open = false;
+    }
+  }
+  closed_ = true;
+  wait_queue_->Notify();
+  return 0;
+}
+
+int IOContextLocalPipe::FCntl(int cmd, int64_t arg) {
+  switch (cmd) {
+    case F_GETFL:
+      return (write_end_ ? O_WRONLY : O_RDONLY) | status_flags_;
+    case F_SETFL:
+      status_flags_ = arg & O_NONBLOCK;
+      return 0;
+    case F_GETFD:
+      return fd_flags_;
+    case F_SETFD:
+      fd_flags_ = arg & FD_CLOEXEC;
+      return 0;
+    case F_GETPIPE_SZ: {
+      absl::MutexLock lock(&pipe_->mu);
+      return pipe_->ring.size();
+    }
+    case F_SETPIPE_SZ: {
+      if (arg < 0 || static_cast<uint64_t>(arg) > kMaxCapacity) {
+        errno = arg < 0 ? EINVAL : EPERM;
+        return -1;
+      }
+      // As on Linux, the capacity is rounded up to a power of two pages.
+      size_t capacity = kPageSize;
+      while (capacity < static_cast<uint64_t>(arg)) {
+        capacity *= 2;
+      }
+      {
+        absl::MutexLock lock(&pipe_->mu);
+        if (capacity < pipe_->size) {
+          errno = EBUSY;
+          return -1;
+        }
+        pipe_->Resize(capacity);
+      }
+      wait_queue_->Notify();
+      return capacity;
+    }
+    default:
+      errno = EINVAL;
+      return -1;
+  }
+}
+
+int IOContextLocalPipe::FStat(struct stat *st) {
+  memset(st, 0, sizeof(*st));
+  st->st_mode = S_IFIFO | S_IRUSR | S_IWUSR;
+  st->st_blksize = kPageSize;
+  return 0;
+}
+
+int IOContextLocalPipe::LocalPoll(short events) {
+  short ready = 0;
+  absl::MutexLock lock(&pipe_->mu);
+  if (write_end_) {
+    if (pipe_->space() >= PIPE_BUF) {
+      ready |= POLLOUT;
+    }
+    if (!pipe_->reader_open) {
+      ready |= POLLERR;
+    }
+  } else {
+    if (pipe_->size > 0) {
+      ready |= POLLIN;
+    }
+    if (!pipe_->writer_open) {
+      ready |= POLLHUP;
+    }
+  }
+  return ready & (events | POLLERR | POLLHUP);
+}
+
+}  // namespace io
+}  // namespace asylo
@@ -0,0 +1,94 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_POSIX_IO_IO_CONTEXT_LOCAL_PIPE_H_
+#define ASYLO_PLATFORM_POSIX_IO_IO_CONTEXT_LOCAL_PIPE_H_
+
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+#include "asylo/platform/posix/io/io_manager.h"
+#include "asylo/platform/posix/io/local_wait_queue.h"
+
+namespace asylo {
+namespace io {
+
+// IOContext implementation of one end of a pipe whose ends both stay inside
+// the enclave. The data is kept in a trusted ring buffer and never reaches the
+// host, and neither reads, writes nor blocking on the pipe exit the enclave.
+//
+// The pipe follows pipe(7), with two exceptions: it cannot be shared with a
+// forked enclave, and writing after the read end is closed fails with EPIPE
+// without raising SIGPIPE.
+class IOContextLocalPipe : public IOManager::IOContext {
+ public:
+  // The capacity of a new pipe, and the largest capacity F_SETPIPE_SZ may set,
+  // as by default on Linux.
+  static constexpr size_t kDefaultCapacity = 64 * 1024;
+  static constexpr size_t kMaxCapacity = 1024 * 1024;
+
+  // Creates the read end |*read_end| and write end |*write_end| of a new pipe
+  // with the O_NONBLOCK and O_CLOEXEC bits of |flags|. Changes in the
+  // readiness of the pipe are reported to |wait_queue|, which must outlive
+  // both ends.
+  static void CreatePipe(int flags, LocalWaitQueue *wait_queue,
+                         std::unique_ptr<IOContextLocalPipe> *read_end,
+                         std::unique_ptr<IOContextLocalPipe> *write_end);
+
+  ~IOContextLocalPipe() override;
+
+  ssize_t Read(void *buf, size_t count) override;
+  ssize_t Write(const void *buf, size_t count) override;
+  ssize_t Readv(const struct iovec *iov, int iovcnt) override;
+  ssize_t Writev(const struct iovec *iov, int iovcnt) override;
+  int Close() override;
+  int FCntl(int cmd, int64_t arg) override;
+  int FStat(struct stat *st) override;
+  int LocalPoll(short events) override;
+
+  // Readv and Writev with the send(2) and recv(2) |flags| MSG_DONTWAIT, which
+  // makes a single call non-blocking, and, for reads, MSG_PEEK. Other flags
+  // are ignored.
+  ssize_t ReadvWithFlags(const struct iovec *iov, int iovcnt, int flags);
+  ssize_t WritevWithFlags(const struct iovec *iov, int iovcnt, int flags);
+
+ private:
+  // The state shared by both ends of a pipe.
+  struct Pipe;
+
+  IOContextLocalPipe(std::shared_ptr<Pipe> pipe, bool write_end, int flags,
+                     LocalWaitQueue *wait_queue);
+
+  const std::shared_ptr<Pipe> pipe_;
+  const bool write_end_;
+  LocalWaitQueue *const wait_queue_;
+  bool closed_ = false;
+
+  // The O_NONBLOCK file status flag and the FD_CLOEXEC file descriptor flag.
+  std::atomic<int> status_flags_;
+  std::atomic<int> fd_flags_;
+};
+
+}  // namespace io
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_POSIX_IO_IO_CONTEXT_LOCAL_PIPE_H_
@@ -0,0 +1,234 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/io/io_context_local_pipe.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+
+#include <algorithm>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/memory/memory.h"
+#include "absl/time/time.h"
+#include "asylo/platform/posix/io/local_wait_queue.h"
+
+namespace asylo {
+namespace io {
+namespace {
+
+using ::testing::Eq;
+using ::testing::Gt;
+using ::testing::IsFalse;
+using ::testing::IsTrue;
+
+// Counts the wakeups of threads waiting on the host.
+class FakeHostWakeup : public LocalWaitQueue::HostWakeup {
+ public:
+  explicit FakeHostWakeup(int *wakes) : wakes_(wakes) {}
+
+  int fd() override { return 100; }
+  void Wake() override { ++*wakes_; }
+  void Drain() override {}
+
+ private:
+  int *const wakes_;
+};
+
+class LocalPipeTest : public ::testing::Test {
+ protected:
+  void SetUp() override { CreatePipe(0); }
+
+  void CreatePipe(int flags) {
+    IOContextLocalPipe::CreatePipe(flags, &wait_queue_, &read_end_,
+                                   &write_end_);
+  }
+
+  int host_wakes_ = 0;
+  LocalWaitQueue wait_queue_{absl::make_unique<FakeHostWakeup>(&host_wakes_)};
+  std::unique_ptr<IOContextLocalPipe> read_end_;
+  std::unique_ptr<IOContextLocalPipe> write_end_;
+};
+
+TEST_F(LocalPipeTest, ReadsDataInOrderAcrossTheRingBoundary) {
+  std::vector<char> data(3 * IOContextLocalPipe::kDefaultCapacity);
+  std::iota(data.begin(), data.end(), 0);
+  std::vector<char> received(data.size());
+
+  // Chunks not dividing the capacity make the ring wrap around mid-chunk.
+  constexpr size_t kChunk = 5000;
+  for (size_t offset = 0; offset < data.size(); offset += kChunk) {
+    size_t length = std::min(kChunk, data.size() - offset);
+    ASSERT_THAT(write_end_->Write(data.data() + offset, length), Eq(length));
+    ASSERT_THAT(read_end_->Read(received.data() + offset, length), Eq(length));
+  }
+  EXPECT_THAT(received, Eq(data));
+}
+
+TEST_F(LocalPipeTest, ScattersAndGathersVectors) {
+  char first[] = "abc";
+  char second[] = "defgh";
+  struct iovec out[] = {{first, 3}, {second, 5}};
+  ASSERT_THAT(write_end_->Writev(out, 2), Eq(8));
+
+  char a[2], b[6];
+  struct iovec in[] = {{a, sizeof(a)}, {b, sizeof(b)}};
+  ASSERT_THAT(read_end_->Readv(in, 2), Eq(8));
+  EXPECT_THAT(std::string(a, 2) + std::string(b, 6), Eq("abcdefgh"));
+}
+
+TEST_F(LocalPipeTest, ReportsEndOfFileAndBrokenPipe) {
+  char byte = 'x';
+  ASSERT_THAT(write_end_->Write(&byte, 1), Eq(1));
+  ASSERT_THAT(write_end_->Close(), Eq(0));
+  EXPECT_THAT(read_end_->LocalPoll(POLLIN), Eq(POLLIN | POLLHUP));
+  EXPECT_THAT(read_end_->Read(&byte, 1), Eq(1));
+  EXPECT_THAT(read_end_->Read(&byte, 1), Eq(0));
+
+  CreatePipe(0);
+  ASSERT_THAT(read_end_->Close(), Eq(0));
+  EXPECT_THAT(write_end_->LocalPoll(POLLOUT), Eq(POLLOUT | POLLERR));
+  EXPECT_THAT(write_end_->Write(&byte, 1), Eq(-1));
+  EXPECT_THAT(errno, Eq(EPIPE));
+}
+
+TEST_F(LocalPipeTest, NonBlockingEndsFailWithEagain) {
+  CreatePipe(O_NONBLOCK);
+  char byte;
+  EXPECT_THAT(read_end_->Read(&byte, 1), Eq(-1));
+  EXPECT_THAT(errno, Eq(EAGAIN));
+
+  // A large write is partial, after which even an atomic write fails.
+  std::vector<char> data(IOContextLocalPipe::kDefaultCapacity + 100);
+  EXPECT_THAT(write_end_->Write(data.data(), data.size()),
+              Eq(IOContextLocalPipe::kDefaultCapacity));
+  EXPECT_THAT(write_end_->LocalPoll(POLLOUT), Eq(0));
+  EXPECT_THAT(write_end_->Write(data.data(), 1), Eq(-1));
+  EXPECT_THAT(errno, Eq(EAGAIN));
+
+  // Writes of up to PIPE_BUF bytes are not split.
+  ASSERT_THAT(read_end_->Read(data.data(), 10), Eq(10));
+  EXPECT_THAT(write_end_->Write(data.data(), 20), Eq(-1));
+  EXPECT_THAT(errno, Eq(EAGAIN));
+}
+
+TEST_F(LocalPipeTest, BlockingReadWaitsForWriter) {
+  char received = 0;
+  std::thread reader([this, &received] {
+    EXPECT_THAT(read_end_->Read(&received, 1), Eq(1));
+  });
+  absl::SleepFor(absl::Milliseconds(10));
+  char byte = 'y';
+  ASSERT_THAT(write_end_->Write(&byte, 1), Eq(1));
+  reader.join();
+  EXPECT_THAT(received, Eq('y'));
+}
+
+TEST_F(LocalPipeTest, BlockingWriteWaitsForReader) {
+  std::vector<char> data(2 * IOContextLocalPipe::kDefaultCapacity, 'z');
+  std::thread writer([this, &data] {
+    EXPECT_THAT(write_end_->Write(data.data(), data.size()), Eq(data.size()));
+  });
+  std::vector<char> received(data.size());
+  size_t total = 0;
+  while (total < data.size()) {
+    ssize_t result = read_end_->Read(received.data() + total,
+                                     received.size() - total);
+    ASSERT_THAT(result, Gt(0));
+    total += result;
+  }
+  writer.join();
+  EXPECT_THAT(received, Eq(data));
+}
+
+TEST_F(LocalPipeTest, NotifiesWaitQueue) {
+  uint64_t generation = wait_queue_.Generation();
+  std::thread waiter([this, generation] {
+    EXPECT_THAT(wait_queue_.Wait(generation, absl::InfiniteFuture()),
+                IsTrue());
+  });
+  char byte = 0;
+  ASSERT_THAT(write_end_->Write(&byte, 1), Eq(1));
+  waiter.join();
+  EXPECT_THAT(read_end_->LocalPoll(POLLIN | POLLOUT), Eq(POLLIN));
+  EXPECT_THAT(wait_queue_.Wait(wait_queue_.Generation(),
+                               absl::Now() + absl::Milliseconds(1)),
+              IsFalse());
+}
+
+TEST_F(LocalPipeTest, ResizesPipe) {
+  EXPECT_THAT(write_end_->FCntl(F_GETPIPE_SZ, 0),
+              Eq(IOContextLocalPipe::kDefaultCapacity));
+  std::vector<char> data(5000, 'q');
+  ASSERT_THAT(write_end_->Write(data.data(), data.size()), Eq(data.size()));
+  EXPECT_THAT(write_end_->FCntl(F_SETPIPE_SZ, 4096), Eq(-1));
+  EXPECT_THAT(errno, Eq(EBUSY));
+  EXPECT_THAT(write_end_->FCntl(F_SETPIPE_SZ, 5000), Eq(8192));
+
+  std::vector<char> received(data.size());
+  ASSERT_THAT(read_end_->Read(received.data(), received.size()),
+              Eq(received.size()));
+  EXPECT_THAT(received, Eq(data));
+  EXPECT_THAT(write_end_->FCntl(F_SETPIPE_SZ,
+                                IOContextLocalPipe::kMaxCapacity + 1),
+              Eq(-1));
+  EXPECT_THAT(errno, Eq(EPERM));
+}
+
+TEST_F(LocalPipeTest, TracksFlags) {
+  EXPECT_THAT(read_end_->FCntl(F_GETFL, 0), Eq(O_RDONLY));
+  EXPECT_THAT(write_end_->FCntl(F_SETFL, O_NONBLOCK), Eq(0));
+  EXPECT_THAT(write_end_->FCntl(F_GETFL, 0), Eq(O_WRONLY | O_NONBLOCK));
+  EXPECT_THAT(read_end_->FCntl(F_GETFD, 0), Eq(0));
+
+  CreatePipe(O_CLOEXEC);
+  EXPECT_THAT(read_end_->FCntl(F_GETFD, 0), Eq(FD_CLOEXEC));
+}
+
+TEST_F(LocalPipeTest, WakesHostWaitersOnlyOncePerChange) {
+  char byte = 0;
+  ASSERT_THAT(write_end_->Write(&byte, 1), Eq(1));
+  EXPECT_THAT(host_wakes_, Eq(0));
+
+  uint64_t first, second;
+  ASSERT_THAT(wait_queue_.BeginHostWait(&first), Eq(100));
+  ASSERT_THAT(wait_queue_.BeginHostWait(&second), Eq(100));
+  ASSERT_THAT(write_end_->Write(&byte, 1), Eq(1));
+  ASSERT_THAT(write_end_->Write(&byte, 1), Eq(1));
+  EXPECT_THAT(host_wakes_, Eq(1));
+
+  // The second waiter still has to learn about the change.
+  wait_queue_.EndHostWait(first);
+  EXPECT_THAT(host_wakes_, Eq(2));
+  ASSERT_THAT(wait_queue_.BeginHostWait(&first), Eq(100));
+  wait_queue_.EndHostWait(second);
+  EXPECT_THAT(host_wakes_, Eq(2));
+  wait_queue_.EndHostWait(first);
+  EXPECT_THAT(host_wakes_, Eq(2));
+}
+
+}  // namespace
+}  // namespace io
+}  // namespace asylo
@@ -0,0 +1,290 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/io/io_context_local_socket.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace asylo {
+namespace io {
+namespace {
+
+// Copies |address| to the |addr| buffer of |*addrlen| bytes, as for
+// getsockname(2).
+int CopyAddress(const SocketAddress &address, struct sockaddr *addr,
+                socklen_t *addrlen) {
+  if (!addr || !addrlen) {
+    errno = EFAULT;
+    return -1;
+  }
+  memcpy(addr, &address.addr, std::min(*addrlen, address.addrlen));
+  *addrlen = address.addrlen;
+  return 0;
+}
+
+// Sets the O_NONBLOCK and O_CLOEXEC bits of |flags| on |pipe_end|.
+void SetFlags(IOContextLocalPipe *pipe_end, int flags) {
+  pipe_end->FCntl(F_SETFL, flags & O_NONBLOCK);
+  pipe_end->FCntl(F_SETFD, (flags & O_CLOEXEC) ? FD_CLOEXEC : 0);
+}
+
+}  // namespace
+
+void IOContextLocalSocket::CreatePair(
+    int first_flags, const SocketAddress &first_address, int second_flags,
+    const SocketAddress &second_address, LocalWaitQueue *wait_queue,
+    std::unique_ptr<IOContextLocalSocket> *first,
+    std::unique_ptr<IOContextLocalSocket> *second) {
+  std::unique_ptr<IOContextLocalPipe> to_second_read, to_second_write;
+  IOContextLocalPipe::CreatePipe(/*flags=*/0, wait_queue, &to_second_read,
+                                 &to_second_write);
+  std::unique_ptr<IOContextLocalPipe> to_first_read, to_first_write;
+  IOContextLocalPipe::CreatePipe(/*flags=*/0, wait_queue, &to_first_read,
+                                 &to_first_write);
+  SetFlags(to_first_read.get(), first_flags);
+  SetFlags(to_second_write.get(), first_flags);
+  SetFlags(to_second_read.get(), second_flags);
+  SetFlags(to_first_write.get(), second_flags);
+  first->reset(new IOContextLocalSocket(std::move(to_first_read),
+                                        std::move(to_second_write),
+                                        first_address, second_address));
+  second->reset(new IOContextLocalSocket(std::move(to_second_read),
+                                         std::move(to_first_write),
+                                         second_address, first_address));
+}
+
+IOContextLocalSocket::IOContextLocalSocket(
+    std::unique_ptr<IOContextLocalPipe> in,
+    std::unique_ptr<IOContextLocalPipe> out, const SocketAddress &address,
+    const SocketAddress &peer_address)
+    : in_(std::move(in)),
+      out_(std::move(out)),
+      address_(address),
+      peer_address_(peer_address) {}
+
+ssize_t IOContextLocalSocket::Read(void *buf, size_t count) {
+  return in_->Read(buf, count);
+}
+
+ssize_t IOContextLocalSocket::Write(const void *buf, size_t count) {
+  return out_->Write(buf, count);
+}
+
+ssize_t IOContextLocalSocket::Readv(const struct iovec *iov, int iovcnt) {
+  return in_->Readv(iov, iovcnt);
+}
+
+ssize_t IOContextLocalSocket::Writev(const struct iovec *iov, int iovcnt) {
+  return out_->Writev(iov, iovcnt);
+}
+
+int IOContextLocalSocket::Close() {
+  in_->Close();
+  out_->Close();
+  return 0;
+}
+
+int IOContextLocalSocket::FCntl(int cmd, int64_t arg) {
+  switch (cmd) {
+    case F_GETFL:
+      return O_RDWR | (in_->FCntl(F_GETFL, 0) & O_NONBLOCK);
+    case F_SETFL:
+    case F_SETFD:
+      in_->FCntl(cmd, arg);
+      out_->FCntl(cmd, arg);
+      return 0;
+    case F_GETFD:
+      return in_->FCntl(cmd, arg);
+    default:
+      errno = EINVAL;
+      return -1;
+  }
+}
+
+int IOContextLocalSocket::FStat(struct stat *st) {
+  memset(st, 0, sizeof(*st));
+  st->st_mode = S_IFSOCK | S_IRWXU | S_IRWXG | S_IRWXO;
+  st->st_blksize = 4096;
+  return 0;
+}
+
+int IOContextLocalSocket::SetSockOpt(int level, int option_name,
+                                     const void *option_value,
+                                     socklen_t option_len) {
+  if (!option_value) {
+    errno = EFAULT;
+    return -1;
+  }
+  // Options which are not integers, such as timeouts, are accepted and
+  // ignored.
+  if (option_len == sizeof(int)) {
+    int value;
+    memcpy(&value, option_value, sizeof(value));
+    absl::MutexLock lock(&options_lock_);
+    options_[{level, option_name}] = value;
+  }
+  return 0;
+}
+
+int IOContextLocalSocket::GetSockOpt(int level, int optname, void *optval,
+                                     socklen_t *optlen) {
+  if (!optval || !optlen) {
+    errno = EFAULT;
+    return -1;
+  }
+  int value = 0;
+  if (level == SOL_SOCKET && optname == SO_TYPE) {
+    value = SOCK_STREAM;
+  } else if (level == SOL_SOCKET &&
+             (optname == SO_SNDBUF || optname == SO_RCVBUF)) {
+    value = (optname == SO_SNDBUF ? out_ : in_)->FCntl(F_GETPIPE_SZ, 0);
+  } else if (!(level == SOL_SOCKET && optname == SO_ERROR)) {
+    absl::MutexLock lock(&options_lock_);
+    auto it = options_.find({level, optname});
+    if (it != options_.end()) {
+      value = it->second;
+    }
+  }
+  memcpy(optval, &value, std::min<socklen_t>(*optlen, sizeof(value)));
+  *optlen = sizeof(value);
+  return 0;
+}
+
+int IOContextLocalSocket::Connect(const struct sockaddr *addr,
+                                  socklen_t addrlen) {
+  errno = EISCONN;
+  return -1;
+}
+
+int IOContextLocalSocket::Shutdown(int how) {
+  switch (how) {
+    case SHUT_RD:
+      return in_->Close();
+    case SHUT_WR:
+      return out_->Close();
+    case SHUT_RDWR:
+      return Close();
+    default:
+      errno = EINVAL;
+      return -1;
+  }
+}
+
+ssize_t IOContextLocalSocket::Send(const void *buf, size_t len, int flags) {
+  struct iovec iov = {const_cast<void *>(buf), len};
+  return out_->WritevWithFlags(&iov, 1, flags);
+}
+
+ssize_t IOContextLocalSocket::SendMsg(const struct msghdr *msg, int flags) {
+  // As for TCP, the destination address is ignored. Ancillary data is not
+  // supported.
+  return out_->WritevWithFlags(msg->msg_iov, msg->msg_iovlen, flags);
+}
+
+ssize_t IOContextLocalSocket::RecvMsg(struct msghdr *msg, int flags) {
+  ssize_t result = Receive(msg->msg_iov, msg->msg_iovlen, flags);
+  if (result >= 0) {
+    msg->msg_namelen = 0;
+    msg->msg_controllen = 0;
+    msg->msg_flags = 0;
+  }
+  return result;
+}
+
+ssize_t IOContextLocalSocket::RecvFrom(void *buf, size_t len, int flags,
+                                       struct sockaddr *src_addr,
+                                       socklen_t *addrlen) {
+  struct iovec iov = {buf, len};
+  ssize_t result = Receive(&iov, 1, flags);
+  if (result >= 0 && src_addr && addrlen) {
+    *addrlen = 0;
+  }
+  return result;
+}
+
+ssize_t IOContextLocalSocket::Receive(const struct iovec *iov, int iovcnt,
+                                      int flags) {
+  if (!(flags & MSG_WAITALL) || (flags & (MSG_PEEK | MSG_DONTWAIT))) {
+    return in_->ReadvWithFlags(iov, iovcnt, flags);
+  }
+  // Keep reading into the part of the buffers not filled yet until they are
+  // full, the peer stops sending or an error occurs.
+  std::vector<struct iovec> remaining(iov, iov + iovcnt);
+  size_t first = 0;
+  ssize_t received = 0;
+  while (true) {
+    ssize_t result = in_->ReadvWithFlags(remaining.data() + first,
+                                         remaining.size() - first, flags);
+    if (result <= 0) {
+      return received > 0 ? received : result;
+    }
+    received += result;
+    size_t consumed = result;
+    while (first < remaining.size() &&
+           consumed >= remaining[first].iov_len) {
+      consumed -= remaining[first].iov_len;
+      ++first;
+    }
+    if (first == remaining.size()) {
+      return received;
+    }
+    remaining[first].iov_base =
+        static_cast<char *>(remaining[first].iov_base) + consumed;
+    remaining[first].iov_len -= consumed;
+  }
+}
+
+int IOContextLocalSocket::GetSockName(struct sockaddr *addr,
+                                      socklen_t *addrlen) {
+  return CopyAddress(address_, addr, addrlen);
+}
+
+int IOContextLocalSocket::GetPeerName(struct sockaddr *addr,
+                                      socklen_t *addrlen) {
+  return CopyAddress(peer_address_, addr, addrlen);
+}
+
+int IOContextLocalSocket::LocalPoll(short events) {
+  int in = in_->LocalPoll(POLLIN);
+  int out = out_->LocalPoll(POLLOUT);
+  int ready = 0;
+  // The end of the stream is readable once the peer stops sending, and
+  // sending fails without blocking once the peer stops receiving.
+  if (in & (POLLIN | POLLHUP)) {
+    ready |= POLLIN;
+  }
+  if (in & POLLHUP) {
+    ready |= POLLRDHUP;
+  }
+  if (out & (POLLOUT | POLLERR)) {
+    ready |= POLLOUT;
+  }
+  if ((in & POLLHUP) && (out & POLLERR)) {
+    ready |= POLLHUP;
+  }
+  return ready & (events | POLLHUP);
+}
+
+}  // namespace io
+}  // namespace asylo
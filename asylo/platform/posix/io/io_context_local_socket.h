@@ -0,0 +1,111 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_POSIX_IO_IO_CONTEXT_LOCAL_SOCKET_H_
+#define ASYLO_PLATFORM_POSIX_IO_IO_CONTEXT_LOCAL_SOCKET_H_
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include <memory>
+#include <utility>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "asylo/platform/posix/io/io_context_local_pipe.h"
+#include "asylo/platform/posix/io/io_manager.h"
+#include "asylo/platform/posix/io/local_wait_queue.h"
+#include "asylo/platform/posix/io/loopback_listener.h"
+
+namespace asylo {
+namespace io {
+
+// IOContext implementation of one end of a connected stream socket whose ends
+// both stay inside the enclave. Each direction of the connection is a local
+// pipe, so sending and receiving never exit the enclave.
+//
+// The socket behaves like a connected TCP socket, except that it cannot be
+// shared with a forked enclave, sending after the peer is closed fails with
+// EPIPE without raising SIGPIPE, and socket options are recorded but have no
+// effect.
+class IOContextLocalSocket : public IOManager::IOContext {
+ public:
+  // Creates the two ends |*first| and |*second| of a new connection with the
+  // O_NONBLOCK and O_CLOEXEC bits of |first_flags| and |second_flags|
+  // respectively. |first_address| is the local address of |*first| and the
+  // peer address of |*second|, and conversely for |second_address|. Changes
+  // in the readiness of the connection are reported to |wait_queue|, which
+  // must outlive both ends.
+  static void CreatePair(int first_flags, const SocketAddress &first_address,
+                         int second_flags, const SocketAddress &second_address,
+                         LocalWaitQueue *wait_queue,
+                         std::unique_ptr<IOContextLocalSocket> *first,
+                         std::unique_ptr<IOContextLocalSocket> *second);
+
+  ssize_t Read(void *buf, size_t count) override;
+  ssize_t Write(const void *buf, size_t count) override;
+  ssize_t Readv(const struct iovec *iov, int iovcnt) override;
+  ssize_t Writev(const struct iovec *iov, int iovcnt) override;
+  int Close() override;
+  int FCntl(int cmd, int64_t arg) override;
+  int FStat(struct stat *st) override;
+  int SetSockOpt(int level, int option_name, const void *option_value,
+                 socklen_t option_len) override;
+  int GetSockOpt(int level, int optname, void *optval,
+                 socklen_t *optlen) override;
+  int Connect(const struct sockaddr *addr, socklen_t addrlen) override;
+  int Shutdown(int how) override;
+  ssize_t Send(const void *buf, size_t len, int flags) override;
+  ssize_t SendMsg(const struct msghdr *msg, int flags) override;
+  ssize_t RecvMsg(struct msghdr *msg, int flags) override;
+  ssize_t RecvFrom(void *buf, size_t len, int flags, struct sockaddr *src_addr,
+                   socklen_t *addrlen) override;
+  int GetSockName(struct sockaddr *addr, socklen_t *addrlen) override;
+  int GetPeerName(struct sockaddr *addr, socklen_t *addrlen) override;
+  int LocalPoll(short events) override;
+
+ private:
+  IOContextLocalSocket(std::unique_ptr<IOContextLocalPipe> in,
+                       std::unique_ptr<IOContextLocalPipe> out,
+                       const SocketAddress &address,
+                       const SocketAddress &peer_address);
+
+  // Receives into the |iovcnt| buffers of |iov| as for recvmsg(2) with
+  // |flags|.
+  ssize_t Receive(const struct iovec *iov, int iovcnt, int flags);
+
+  // The pipes carrying the data received and sent by this end.
+  const std::unique_ptr<IOContextLocalPipe> in_;
+  const std::unique_ptr<IOContextLocalPipe> out_;
+
+  const SocketAddress address_;
+  const SocketAddress peer_address_;
+
+  absl::Mutex options_lock_;
+
+  // Integer socket options set on this end, by level and name.
+  absl::flat_hash_map<std::pair<int, int>, int> options_
+      ABSL_GUARDED_BY(options_lock_);
+};
+
+}  // namespace io
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_POSIX_IO_IO_CONTEXT_LOCAL_SOCKET_H_
@@ -0,0 +1,355 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/io/io_context_local_socket.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/memory/memory.h"
+#include "asylo/platform/posix/io/local_wait_queue.h"
+#include "asylo/platform/posix/io/loopback_listener.h"
+
+namespace asylo {
+namespace io {
+namespace {
+
+using ::testing::Eq;
+using ::testing::IsFalse;
+using ::testing::IsNull;
+using ::testing::IsTrue;
+using ::testing::NotNull;
+
+class NoHostWakeup : public LocalWaitQueue::HostWakeup {
+ public:
+  int fd() override { return -1; }
+  void Wake() override {}
+  void Drain() override {}
+};
+
+SocketAddress Ipv4Address(const char *ip, uint16_t port) {
+  SocketAddress address = {};
+  auto *in = reinterpret_cast<struct sockaddr_in *>(&address.addr);
+  in->sin_family = AF_INET;
+  in->sin_port = htons(port);
+  inet_pton(AF_INET, ip, &in->sin_addr);
+  address.addrlen = sizeof(*in);
+  return address;
+}
+
+SocketAddress Ipv6Address(const char *ip, uint16_t port) {
+  SocketAddress address = {};
+  auto *in6 = reinterpret_cast<struct sockaddr_in6 *>(&address.addr);
+  in6->sin6_family = AF_INET6;
+  in6->sin6_port = htons(port);
+  inet_pton(AF_INET6, ip, &in6->sin6_addr);
+  address.addrlen = sizeof(*in6);
+  return address;
+}
+
+const struct sockaddr *AsSockaddr(const SocketAddress &address) {
+  return reinterpret_cast<const struct sockaddr *>(&address.addr);
+}
+
+class LocalSocketTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    IOContextLocalSocket::CreatePair(0, client_address_, 0, server_address_,
+                                     &wait_queue_, &client_, &server_);
+  }
+
+  LocalWaitQueue wait_queue_{absl::make_unique<NoHostWakeup>()};
+  const SocketAddress client_address_ = Ipv4Address("127.0.0.1", 40000);
+  const SocketAddress server_address_ = Ipv4Address("127.0.0.1", 8080);
+  std::unique_ptr<IOContextLocalSocket> client_;
+  std::unique_ptr<IOContextLocalSocket> server_;
+};
+
+TEST_F(LocalSocketTest, ExchangesDataInBothDirections) {
+  EXPECT_THAT(client_->Send("request", 7, 0), Eq(7));
+  char buffer[16];
+  EXPECT_THAT(server_->RecvFrom(buffer, sizeof(buffer), 0, nullptr, nullptr),
+              Eq(7));
+  EXPECT_THAT(std::string(buffer, 7), Eq("request"));
+
+  EXPECT_THAT(server_->Write("response", 8), Eq(8));
+  EXPECT_THAT(client_->Read(buffer, sizeof(buffer)), Eq(8));
+  EXPECT_THAT(std::string(buffer, 8), Eq("response"));
+}
+
+TEST_F(LocalSocketTest, ReportsAddresses) {
+  struct sockaddr_storage addr;
+  socklen_t addrlen = sizeof(addr);
+  ASSERT_THAT(client_->GetSockName(reinterpret_cast<struct sockaddr *>(&addr),
+                                   &addrlen),
+              Eq(0));
+  EXPECT_THAT(addrlen, Eq(client_address_.addrlen));
+  EXPECT_THAT(memcmp(&addr, &client_address_.addr, addrlen), Eq(0));
+
+  addrlen = sizeof(addr);
+  ASSERT_THAT(server_->GetPeerName(reinterpret_cast<struct sockaddr *>(&addr),
+                                   &addrlen),
+              Eq(0));
+  EXPECT_THAT(memcmp(&addr, &client_address_.addr, addrlen), Eq(0));
+
+  addrlen = sizeof(addr);
+  ASSERT_THAT(client_->GetPeerName(reinterpret_cast<struct sockaddr *>(&addr),
+                                   &addrlen),
+              Eq(0));
+  EXPECT_THAT(memcmp(&addr, &server_address_.addr, addrlen), Eq(0));
+}
+
+TEST_F(LocalSocketTest, PeeksAndDoesNotWait) {
+  char buffer[16];
+  EXPECT_THAT(client_->RecvFrom(buffer, sizeof(buffer), MSG_DONTWAIT, nullptr,
+                                nullptr),
+              Eq(-1));
+  EXPECT_THAT(errno, Eq(EAGAIN));
+
+  ASSERT_THAT(server_->Send("abc", 3, 0), Eq(3));
+  EXPECT_THAT(client_->RecvFrom(buffer, sizeof(buffer), MSG_PEEK, nullptr,
+                                nullptr),
+              Eq(3));
+  EXPECT_THAT(client_->RecvFrom(buffer, 2, 0, nullptr, nullptr), Eq(2));
+  EXPECT_THAT(std::string(buffer, 2), Eq("ab"));
+  EXPECT_THAT(client_->RecvFrom(buffer, sizeof(buffer), 0, nullptr, nullptr),
+              Eq(1));
+  EXPECT_THAT(buffer[0], Eq('c'));
+}
+
+TEST_F(LocalSocketTest, WaitsForAllData) {
+  std::thread sender([this] {
+    for (char c : std::string("0123456789")) {
+      server_->Send(&c, 1, 0);
+    }
+  });
+  char buffer[10];
+  EXPECT_THAT(
+      client_->RecvFrom(buffer, sizeof(buffer), MSG_WAITALL, nullptr, nullptr),
+      Eq(10));
+  EXPECT_THAT(std::string(buffer, 10), Eq("0123456789"));
+  sender.join();
+}
+
+TEST_F(LocalSocketTest, ShutdownEndsTheStream) {
+  EXPECT_THAT(client_->LocalPoll(POLLIN | POLLRDHUP), Eq(0));
+  EXPECT_THAT(client_->LocalPoll(POLLOUT), Eq(POLLOUT));
+
+  ASSERT_THAT(server_->Send("x", 1, 0), Eq(1));
+  ASSERT_THAT(server_->Shutdown(SHUT_WR), Eq(0));
+  EXPECT_THAT(client_->LocalPoll(POLLIN | POLLRDHUP), Eq(POLLIN | POLLRDHUP));
+  char buffer[4];
+  EXPECT_THAT(client_->Read(buffer, sizeof(buffer)), Eq(1));
+  EXPECT_THAT(client_->Read(buffer, sizeof(buffer)), Eq(0));
+
+  // The other direction stays open.
+  EXPECT_THAT(client_->Send("y", 1, 0), Eq(1));
+  EXPECT_THAT(server_->Read(buffer, sizeof(buffer)), Eq(1));
+
+  ASSERT_THAT(server_->Close(), Eq(0));
+  EXPECT_THAT(client_->LocalPoll(POLLIN | POLLOUT) & POLLHUP, Eq(POLLHUP));
+  EXPECT_THAT(client_->Send("z", 1, MSG_NOSIGNAL), Eq(-1));
+  EXPECT_THAT(errno, Eq(EPIPE));
+}
+
+TEST_F(LocalSocketTest, TracksFlagsAndOptions) {
+  EXPECT_THAT(client_->FCntl(F_GETFL, 0), Eq(O_RDWR));
+  ASSERT_THAT(client_->FCntl(F_SETFL, O_NONBLOCK), Eq(0));
+  EXPECT_THAT(client_->FCntl(F_GETFL, 0), Eq(O_RDWR | O_NONBLOCK));
+  char buffer[4];
+  EXPECT_THAT(client_->Read(buffer, sizeof(buffer)), Eq(-1));
+  EXPECT_THAT(errno, Eq(EAGAIN));
+
+  int value = 1;
+  ASSERT_THAT(client_->SetSockOpt(IPPROTO_TCP, 1, &value, sizeof(value)),
+              Eq(0));
+  value = 0;
+  socklen_t length = sizeof(value);
+  ASSERT_THAT(client_->GetSockOpt(IPPROTO_TCP, 1, &value, &length), Eq(0));
+  EXPECT_THAT(value, Eq(1));
+  ASSERT_THAT(client_->GetSockOpt(SOL_SOCKET, SO_TYPE, &value, &length),
+              Eq(0));
+  EXPECT_THAT(value, Eq(SOCK_STREAM));
+  EXPECT_THAT(client_->Connect(AsSockaddr(server_address_),
+                               server_address_.addrlen),
+              Eq(-1));
+  EXPECT_THAT(errno, Eq(EISCONN));
+}
+
+class LoopbackListenerTest : public ::testing::Test {
+ protected:
+  std::shared_ptr<LoopbackListener> Listen(const SocketAddress &address,
+                                           bool v6_only = false,
+                                           int backlog = 8) {
+    auto listener = std::make_shared<LoopbackListener>(address, v6_only,
+                                                       backlog, &wait_queue_);
+    registry_.Register(listener);
+    return listener;
+  }
+
+  std::shared_ptr<LoopbackListener> Find(const SocketAddress &address) {
+    return registry_.Find(AsSockaddr(address), address.addrlen);
+  }
+
+  // Returns a new connection to be queued on a listener.
+  std::unique_ptr<IOContextLocalSocket> NewConnection() {
+    std::unique_ptr<IOContextLocalSocket> client, server;
+    IOContextLocalSocket::CreatePair(0, Ipv4Address("127.0.0.1", 40000), 0,
+                                     Ipv4Address("127.0.0.1", 8080),
+                                     &wait_queue_, &client, &server);
+    clients_.push_back(std::move(client));
+    return server;
+  }
+
+  LocalWaitQueue wait_queue_{absl::make_unique<NoHostWakeup>()};
+  LoopbackRegistry registry_;
+  std::vector<std::unique_ptr<IOContextLocalSocket>> clients_;
+};
+
+TEST_F(LoopbackListenerTest, DetectsLoopbackAddresses) {
+  SocketAddress addresses[] = {Ipv4Address("127.0.0.1", 1),
+                               Ipv4Address("127.1.2.3", 1),
+                               Ipv6Address("::1", 1),
+                               Ipv6Address("::ffff:127.0.0.1", 1)};
+  for (const SocketAddress &address : addresses) {
+    EXPECT_THAT(IsLoopbackAddress(AsSockaddr(address), address.addrlen),
+                IsTrue());
+  }
+  SocketAddress external[] = {Ipv4Address("10.0.0.1", 1),
+                              Ipv4Address("0.0.0.0", 1), Ipv6Address("::", 1),
+                              Ipv6Address("::ffff:10.0.0.1", 1)};
+  for (const SocketAddress &address : external) {
+    EXPECT_THAT(IsLoopbackAddress(AsSockaddr(address), address.addrlen),
+                IsFalse());
+  }
+}
+
+TEST_F(LoopbackListenerTest, FindsListenersByAddress) {
+  auto wildcard = Listen(Ipv4Address("0.0.0.0", 8080));
+  auto specific = Listen(Ipv4Address("127.0.0.2", 9090));
+  auto external = std::make_shared<LoopbackListener>(
+      Ipv4Address("10.0.0.1", 7070), false, 8, &wait_queue_);
+  EXPECT_THAT(external->ReachableFromLoopback(), IsFalse());
+
+  EXPECT_THAT(Find(Ipv4Address("127.0.0.1", 8080)), Eq(wildcard));
+  EXPECT_THAT(Find(Ipv6Address("::ffff:127.0.0.1", 8080)), Eq(wildcard));
+  EXPECT_THAT(Find(Ipv6Address("::1", 8080)), IsNull());
+  EXPECT_THAT(Find(Ipv4Address("10.0.0.1", 8080)), IsNull());
+  EXPECT_THAT(Find(Ipv4Address("127.0.0.1", 8081)), IsNull());
+  EXPECT_THAT(Find(Ipv4Address("127.0.0.2", 9090)), Eq(specific));
+  EXPECT_THAT(Find(Ipv4Address("127.0.0.1", 9090)), IsNull());
+
+  wildcard->Close();
+  EXPECT_THAT(Find(Ipv4Address("127.0.0.1", 8080)), IsNull());
+  specific.reset();
+  EXPECT_THAT(Find(Ipv4Address("127.0.0.2", 9090)), IsNull());
+}
+
+TEST_F(LoopbackListenerTest, DualStackListenerAcceptsIpv4) {
+  auto dual_stack = Listen(Ipv6Address("::", 8080));
+  auto v6_only = Listen(Ipv6Address("::", 9090), /*v6_only=*/true);
+
+  EXPECT_THAT(Find(Ipv6Address("::1", 8080)), Eq(dual_stack));
+  EXPECT_THAT(Find(Ipv4Address("127.0.0.1", 8080)), Eq(dual_stack));
+  EXPECT_THAT(Find(Ipv6Address("::1", 9090)), Eq(v6_only));
+  EXPECT_THAT(Find(Ipv4Address("127.0.0.1", 9090)), IsNull());
+}
+
+TEST_F(LoopbackListenerTest, QueuesConnectionsUpToTheBacklog) {
+  auto listener = Listen(Ipv4Address("127.0.0.1", 8080), false,
+                         /*backlog=*/1);
+  EXPECT_THAT(listener->HasPending(), IsFalse());
+  EXPECT_THAT(listener->Dequeue(), IsNull());
+
+  uint64_t generation = wait_queue_.Generation();
+  std::unique_ptr<IOContextLocalSocket> first = NewConnection();
+  IOContextLocalSocket *first_pointer = first.get();
+  EXPECT_THAT(listener->Enqueue(std::move(first)), IsTrue());
+  EXPECT_THAT(wait_queue_.Generation(), Eq(generation + 1));
+  EXPECT_THAT(listener->Enqueue(NewConnection()), IsTrue());
+  EXPECT_THAT(listener->Enqueue(NewConnection()), IsFalse());
+  EXPECT_THAT(listener->HasPending(), IsTrue());
+
+  std::unique_ptr<IOContextLocalSocket> accepted = listener->Dequeue();
+  ASSERT_THAT(accepted, NotNull());
+  EXPECT_THAT(accepted.get(), Eq(first_pointer));
+
+  // Closing the listener ends the streams of the connections still queued.
+  listener->Close();
+  EXPECT_THAT(listener->HasPending(), IsFalse());
+  EXPECT_THAT(listener->Enqueue(NewConnection()), IsFalse());
+  char buffer[1];
+  EXPECT_THAT(clients_[1]->Read(buffer, sizeof(buffer)), Eq(0));
+}
+
+TEST_F(LoopbackListenerTest, PassesConnectionsBetweenConcurrentThreads) {
+  constexpr int kThreads = 4;
+  constexpr int kConnectionsPerThread = 16;
+  auto listener = Listen(Ipv4Address("127.0.0.1", 8080), false,
+                         /*backlog=*/kThreads * kConnectionsPerThread);
+  std::vector<std::unique_ptr<IOContextLocalSocket>> connections;
+  for (int i = 0; i < kThreads * kConnectionsPerThread; ++i) {
+    connections.push_back(NewConnection());
+  }
+
+  std::vector<std::thread> connecting;
+  for (int i = 0; i < kThreads; ++i) {
+    connecting.emplace_back([&, i] {
+      for (int j = 0; j < kConnectionsPerThread; ++j) {
+        EXPECT_THAT(listener->Enqueue(std::move(
+                        connections[i * kConnectionsPerThread + j])),
+                    IsTrue());
+      }
+    });
+  }
+  std::atomic<int> accepted{0};
+  std::vector<std::thread> accepting;
+  for (int i = 0; i < kThreads; ++i) {
+    accepting.emplace_back([&] {
+      while (accepted < kThreads * kConnectionsPerThread) {
+        if (listener->Dequeue()) {
+          ++accepted;
+        }
+      }
+    });
+  }
+  for (auto &thread : connecting) {
+    thread.join();
+  }
+  for (auto &thread : accepting) {
+    thread.join();
+  }
+  EXPECT_THAT(accepted.load(), Eq(kThreads * kConnectionsPerThread));
+  EXPECT_THAT(listener->HasPending(), IsFalse());
+}
+
+}  // namespace
+}  // namespace io
+}  // namespace asylo
@@ -0,0 +1,351 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/io/io_context_stream_socket.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace asylo {
+namespace io {
+namespace {
+
+// Sets the port of the IPv4 or IPv6 socket address |address| to 0.
+void ClearPort(SocketAddress *address) {
+  if (address->addr.ss_family == AF_INET) {
+    reinterpret_cast<struct sockaddr_in *>(&address->addr)->sin_port = 0;
+  } else {
+    reinterpret_cast<struct sockaddr_in6 *>(&address->addr)->sin6_port = 0;
+  }
+}
+
+// Returns whether the IPv4 or IPv6 socket address |address| has a port.
+bool HasPort(const SocketAddress &address) {
+  if (address.addr.ss_family == AF_INET) {
+    return reinterpret_cast<const struct sockaddr_in *>(&address.addr)
+               ->sin_port != 0;
+  }
+  return reinterpret_cast<const struct sockaddr_in6 *>(&address.addr)
+             ->sin6_port != 0;
+}
+
+}  // namespace
+
+IOContextStreamSocket::IOContextStreamSocket(int host_fd,
+                                             LoopbackRegistry *registry,
+                                             LocalWaitQueue *wait_queue)
+    : IOContextNative(host_fd), registry_(registry), wait_queue_(wait_queue) {}
+
+ssize_t IOContextStreamSocket::Read(void *buf, size_t count) {
+  if (IOContextLocalSocket *local = connection()) {
+    return local->Read(buf, count);
+  }
+  return IOContextNative::Read(buf, count);
+}
+
+ssize_t IOContextStreamSocket::Write(const void *buf, size_t count) {
+  if (IOContextLocalSocket *local = connection()) {
+    return local->Write(buf, count);
+  }
+  return IOContextNative::Write(buf, count);
+}
+
+ssize_t IOContextStreamSocket::Readv(const struct iovec *iov, int iovcnt) {
+  if (IOContextLocalSocket *local = connection()) {
+    return local->Readv(iov, iovcnt);
+  }
+  return IOContextNative::Readv(iov, iovcnt);
+}
+
+ssize_t IOContextStreamSocket::Writev(const struct iovec *iov, int iovcnt) {
+  if (IOContextLocalSocket *local = connection()) {
+    return local->Writev(iov, iovcnt);
+  }
+  return IOContextNative::Writev(iov, iovcnt);
+}
+
+int IOContextStreamSocket::Close() {
+  std::shared_ptr<LoopbackListener> listener;
+  {
+    absl::MutexLock lock(&mu_);
+    listener = listener_;
+  }
+  if (listener) {
+    listener->Close();
+  }
+  if (IOContextLocalSocket *local = connection()) {
+    local->Close();
+  }
+  return IOContextNative::Close();
+}
+
+int IOContextStreamSocket::FCntl(int cmd, int64_t arg) {
+  if (IOContextLocalSocket *local = connection()) {
+    return local->FCntl(cmd, arg);
+  }
+  return IOContextNative::FCntl(cmd, arg);
+}
+
+int IOContextStreamSocket::FStat(struct stat *stat_buffer) {
+  if (IOContextLocalSocket *local = connection()) {
+    return local->FStat(stat_buffer);
+  }
+  return IOContextNative::FStat(stat_buffer);
+}
+
+int IOContextStreamSocket::SetSockOpt(int level, int option_name,
+                                      const void *option_value,
+                                      socklen_t option_len) {
+  if (IOContextLocalSocket *local = connection()) {
+    return local->SetSockOpt(level, option_name, option_value, option_len);
+  }
+  return IOContextNative::SetSockOpt(level, option_name, option_value,
+                                     option_len);
+}
+
+int IOContextStreamSocket::GetSockOpt(int level, int optname, void *optval,
+                                      socklen_t *optlen) {
+  if (IOContextLocalSocket *local = connection()) {
+    return local->GetSockOpt(level, optname, optval, optlen);
+  }
+  return IOContextNative::GetSockOpt(level, optname, optval, optlen);
+}
+
+int IOContextStreamSocket::Connect(const struct sockaddr *addr,
+                                   socklen_t addrlen) {
+  if (connection()) {
+    errno = EISCONN;
+    return -1;
+  }
+  std::shared_ptr<LoopbackListener> listener = registry_->Find(addr, addrlen);
+  if (listener) {
+    absl::MutexLock lock(&mu_);
+    if (connection()) {
+      errno = EISCONN;
+      return -1;
+    }
+    // A listening socket cannot connect, which the host reports.
+    if (!listener_ && ConnectLocally(addr, addrlen, listener.get())) {
+      return 0;
+    }
+  }
+  return IOContextNative::Connect(addr, addrlen);
+}
+
+bool IOContextStreamSocket::ConnectLocally(const struct sockaddr *addr,
+                                           socklen_t addrlen,
+                                           LoopbackListener *listener) {
+  if (addrlen > sizeof(struct sockaddr_storage)) {
+    return false;
+  }
+  // Bind the host socket to a loopback port unless it is bound already, so
+  // that the local address of the connection is not used by another socket.
+  SocketAddress address;
+  address.addrlen = sizeof(address.addr);
+  if (IOContextNative::GetSockName(
+          reinterpret_cast<struct sockaddr *>(&address.addr),
+          &address.addrlen) != 0 ||
+      address.addr.ss_family != addr->sa_family) {
+    return false;
+  }
+  SocketAddress peer_address;
+  memcpy(&peer_address.addr, addr, addrlen);
+  peer_address.addrlen = addrlen;
+  if (!HasPort(address)) {
+    SocketAddress bind_address = peer_address;
+    ClearPort(&bind_address);
+    address.addrlen = sizeof(address.addr);
+    if (IOContextNative::Bind(
+            reinterpret_cast<struct sockaddr *>(&bind_address.addr),
+            bind_address.addrlen) != 0 ||
+        IOContextNative::GetSockName(
+            reinterpret_cast<struct sockaddr *>(&address.addr),
+            &address.addrlen) != 0) {
+      return false;
+    }
+  }
+
+  int status_flags = IOContextNative::FCntl(F_GETFL, 0);
+  int fd_flags = IOContextNative::FCntl(F_GETFD, 0);
+  if (status_flags < 0 || fd_flags < 0) {
+    return false;
+  }
+  int flags = (status_flags & O_NONBLOCK) |
+              ((fd_flags & FD_CLOEXEC) ? O_CLOEXEC : 0);
+  std::unique_ptr<IOContextLocalSocket> local, accepting;
+  IOContextLocalSocket::CreatePair(flags, address, /*second_flags=*/0,
+                                   peer_address, wait_queue_, &local,
+                                   &accepting);
+  if (!listener->Enqueue(std::move(accepting))) {
+    return false;
+  }
+  owned_connection_ = std::move(local);
+  connection_.store(owned_connection_.get(), std::memory_order_release);
+  return true;
+}
+
+int IOContextStreamSocket::Shutdown(int how) {
+  if (IOContextLocalSocket *local = connection()) {
+    return local->Shutdown(how);
+  }
+  return IOContextNative::Shutdown(how);
+}
+
+ssize_t IOContextStreamSocket::Send(const void *buf, size_t len, int flags) {
+  if (IOContextLocalSocket *local = connection()) {
+    return local->Send(buf, len, flags);
+  }
+  return IOContextNative::Send(buf, len, flags);
+}
+
+int IOContextStreamSocket::Listen(int backlog) {
+  if (connection()) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (IOContextNative::Listen(backlog) != 0) {
+    return -1;
+  }
+  absl::MutexLock lock(&mu_);
+  if (listener_) {
+    listener_->SetBacklog(backlog);
+    return 0;
+  }
+  // The socket keeps listening on the host for connections from outside the
+  // enclave even if it cannot be registered.
+  SocketAddress address;
+  address.addrlen = sizeof(address.addr);
+  if (IOContextNative::GetSockName(
+          reinterpret_cast<struct sockaddr *>(&address.addr),
+          &address.addrlen) != 0) {
+    return 0;
+  }
+  int v6_only = 0;
+  if (address.addr.ss_family == AF_INET6) {
+    socklen_t length = sizeof(v6_only);
+    if (IOContextNative::GetSockOpt(IPPROTO_IPV6, IPV6_V6ONLY, &v6_only,
+                                    &length) != 0) {
+      return 0;
+    }
+  }
+  auto listener = std::make_shared<LoopbackListener>(address, v6_only != 0,
+                                                     backlog, wait_queue_);
+  if (listener->ReachableFromLoopback()) {
+    registry_->Register(listener);
+    listener_ = std::move(listener);
+  }
+  return 0;
+}
+
+ssize_t IOContextStreamSocket::SendMsg(const struct msghdr *msg, int flags) {
+  if (IOContextLocalSocket *local = connection()) {
+    return local->SendMsg(msg, flags);
+  }
+  return IOContextNative::SendMsg(msg, flags);
+}
+
+ssize_t IOContextStreamSocket::RecvMsg(struct msghdr *msg, int flags) {
+  if (IOContextLocalSocket *local = connection()) {
+    return local->RecvMsg(msg, flags);
+  }
+  return IOContextNative::RecvMsg(msg, flags);
+}
+
+int IOContextStreamSocket::GetSockName(struct sockaddr *addr,
+                                       socklen_t *addrlen) {
+  if (IOContextLocalSocket *local = connection()) {
+    return local->GetSockName(addr, addrlen);
+  }
+  return IOContextNative::GetSockName(addr, addrlen);
+}
+
+int IOContextStreamSocket::GetPeerName(struct sockaddr *addr,
+                                       socklen_t *addrlen) {
+  if (IOContextLocalSocket *local = connection()) {
+    return local->GetPeerName(addr, addrlen);
+  }
+  return IOContextNative::GetPeerName(addr, addrlen);
+}
+
+ssize_t IOContextStreamSocket::RecvFrom(void *buf, size_t len, int flags,
+                                        struct sockaddr *src_addr,
+                                        socklen_t *addrlen) {
+  if (IOContextLocalSocket *local = connection()) {
+    return local->RecvFrom(buf, len, flags, src_addr, addrlen);
+  }
+  return IOContextNative::RecvFrom(buf, len, flags, src_addr, addrlen);
+}
+
+int IOContextStreamSocket::GetHostFileDescriptor() {
+  // A socket connected inside the enclave is waited on as a local stream.
+  if (connection()) {
+    return -1;
+  }
+  return IOContextNative::GetHostFileDescriptor();
+}
+
+int IOContextStreamSocket::GetHostTransferFileDescriptor() {
+  if (connection()) {
+    return -1;
+  }
+  return IOContextNative::GetHostTransferFileDescriptor();
+}
+
+int IOContextStreamSocket::LocalPoll(short events) {
+  if (IOContextLocalSocket *local = connection()) {
+    return local->LocalPoll(events);
+  }
+  absl::MutexLock lock(&mu_);
+  if (!listener_) {
+    return -1;
+  }
+  return listener_->HasPending() ? (events & POLLIN) : 0;
+}
+
+std::unique_ptr<IOManager::IOContext> IOContextStreamSocket::AcceptLocal(
+    int flags, IOManager::AcceptedConnection *connection) {
+  std::shared_ptr<LoopbackListener> listener;
+  {
+    absl::MutexLock lock(&mu_);
+    listener = listener_;
+  }
+  if (!listener) {
+    return nullptr;
+  }
+  std::unique_ptr<IOContextLocalSocket> accepted = listener->Dequeue();
+  if (!accepted) {
+    return nullptr;
+  }
+  accepted->FCntl(F_SETFL, (flags & SOCK_NONBLOCK) ? O_NONBLOCK : 0);
+  accepted->FCntl(F_SETFD, (flags & SOCK_CLOEXEC) ? FD_CLOEXEC : 0);
+  connection->fd = -1;
+  connection->setup_errno = 0;
+  connection->addrlen = sizeof(connection->addr);
+  accepted->GetPeerName(reinterpret_cast<struct sockaddr *>(&connection->addr),
+                        &connection->addrlen);
+  return std::move(accepted);
+}
+
+}  // namespace io
+}  // namespace asylo
@@ -0,0 +1,113 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_POSIX_IO_IO_CONTEXT_STREAM_SOCKET_H_
+#define ASYLO_PLATFORM_POSIX_IO_IO_CONTEXT_STREAM_SOCKET_H_
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include <atomic>
+#include <memory>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "asylo/platform/posix/io/io_context_local_socket.h"
+#include "asylo/platform/posix/io/io_manager.h"
+#include "asylo/platform/posix/io/local_wait_queue.h"
+#include "asylo/platform/posix/io/loopback_listener.h"
+#include "asylo/platform/posix/io/native_paths.h"
+
+namespace asylo {
+namespace io {
+
+// IOContext implementation of a TCP socket created inside the enclave with
+// SOCK_ENCLAVE_LOCAL, backed by a host socket. Connections between two such sockets over a loopback
+// address do not go through the host: a listening socket bound to a loopback
+// or wildcard address is registered with |registry|, and a socket connecting
+// to it becomes one end of an IOContextLocalSocket whose other end is queued
+// for AcceptLocal. Every other connection uses the host socket.
+//
+// The host socket of a socket connected inside the enclave stays bound to a
+// loopback port, which reserves the local address of the connection.
+class IOContextStreamSocket : public IOContextNative {
+ public:
+  // Creates a socket backed by |host_fd|. |registry| and |wait_queue| must
+  // outlive the socket.
+  IOContextStreamSocket(int host_fd, LoopbackRegistry *registry,
+                        LocalWaitQueue *wait_queue);
+
+  ssize_t Read(void *buf, size_t count) override;
+  ssize_t Write(const void *buf, size_t count) override;
+  ssize_t Readv(const struct iovec *iov, int iovcnt) override;
+  ssize_t Writev(const struct iovec *iov, int iovcnt) override;
+  int Close() override;
+  int FCntl(int cmd, int64_t arg) override;
+  int FStat(struct stat *stat_buffer) override;
+  int SetSockOpt(int level, int option_name, const void *option_value,
+                 socklen_t option_len) override;
+  int GetSockOpt(int level, int optname, void *optval,
+                 socklen_t *optlen) override;
+  int Connect(const struct sockaddr *addr, socklen_t addrlen) override;
+  int Shutdown(int how) override;
+  ssize_t Send(const void *buf, size_t len, int flags) override;
+  int Listen(int backlog) override;
+  ssize_t SendMsg(const struct msghdr *msg, int flags) override;
+  ssize_t RecvMsg(struct msghdr *msg, int flags) override;
+  int GetSockName(struct sockaddr *addr, socklen_t *addrlen) override;
+  int GetPeerName(struct sockaddr *addr, socklen_t *addrlen) override;
+  ssize_t RecvFrom(void *buf, size_t len, int flags, struct sockaddr *src_addr,
+                   socklen_t *addrlen) override;
+  int GetHostFileDescriptor() override;
+  int GetHostTransferFileDescriptor() override;
+  int LocalPoll(short events) override;
+  std::unique_ptr<IOManager::IOContext> AcceptLocal(
+      int flags, IOManager::AcceptedConnection *connection) override;
+
+ private:
+  // Returns the connection made inside the enclave, or nullptr if the socket
+  // is not connected that way.
+  IOContextLocalSocket *connection() const {
+    return connection_.load(std::memory_order_acquire);
+  }
+
+  // Connects to |listener| inside the enclave. Returns false if the listener
+  // does not take the connection.
+  bool ConnectLocally(const struct sockaddr *addr, socklen_t addrlen,
+                      LoopbackListener *listener)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  LoopbackRegistry *const registry_;
+  LocalWaitQueue *const wait_queue_;
+
+  absl::Mutex mu_;
+
+  // Set once the socket is connected inside the enclave. |connection_| is an
+  // unowned copy of |owned_connection_| which may be read without |mu_|.
+  std::unique_ptr<IOContextLocalSocket> owned_connection_ ABSL_GUARDED_BY(mu_);
+  std::atomic<IOContextLocalSocket *> connection_{nullptr};
+
+  // Set once the socket listens on an address reachable over loopback.
+  std::shared_ptr<LoopbackListener> listener_ ABSL_GUARDED_BY(mu_);
+};
+
+}  // namespace io
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_POSIX_IO_IO_CONTEXT_STREAM_SOCKET_H_
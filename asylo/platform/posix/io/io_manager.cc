@@ -19,57 +19,128 @@
 #include "asylo/platform/posix/io/io_manager.h"
 
 #include <fcntl.h>
+#include <netinet/in.h>
 #include <poll.h>
+#include <sys/uio.h>
 
+#include <algorithm>
 #include <cerrno>
+#include <climits>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <memory>
 #include <unordered_set>
+#include <vector>
 
-#include "absl/algorithm/container.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "asylo/platform/host_call/trusted/host_calls.h"
 #include "asylo/platform/posix/io/io_context_epoll.h"
 #include "asylo/platform/posix/io/io_context_eventfd.h"
 #include "asylo/platform/posix/io/io_context_inotify.h"
+#include "asylo/platform/posix/io/io_context_local_pipe.h"
+#include "asylo/platform/posix/io/io_context_stream_socket.h"
+#include "asylo/platform/posix/io/local_wait_queue.h"
 #include "asylo/platform/posix/io/native_paths.h"
 #include "asylo/platform/posix/io/util.h"
+#include "asylo/platform/posix/sockets/socket_stats.h"
 #include "asylo/util/posix_error_space.h"
 #include "asylo/util/statusor.h"
 
 namespace asylo {
 namespace io {
+namespace {
+
+// Wakes threads waiting on the host for local streams through a non-blocking
+// host pipe, created when a thread first waits on the host and local streams
+// at once.
+class HostPipeWakeup : public LocalWaitQueue::HostWakeup {
+ public:
+  int fd() override {
+    absl::MutexLock lock(&mu_);
+    if (fds_[0] < 0 && enc_untrusted_pipe2(fds_, O_NONBLOCK | O_CLOEXEC) != 0) {
+      fds_[0] = fds_[1] = -1;
+      return -1;
+    }
+    return fds_[0];
+  }
+
+  void Wake() override {
+    char byte = 0;
+    enc_untrusted_write(fds_[1], &byte, 1);
+  }
+
+  void Drain() override {
+    char buffer[64];
+    while (enc_untrusted_read(fds_[0], buffer, sizeof(buffer)) ==
+           sizeof(buffer)) {
+    }
+  }
+
+ private:
+  absl::Mutex mu_;
+  int fds_[2] = {-1, -1};
+};
+
+}  // namespace
+
+IOManager::IOManager()
+    : local_wait_queue_(absl::make_unique<HostPipeWakeup>()) {}
 
 IOManager::FileDescriptorTable::FileDescriptorTable()
     : maximum_fd_soft_limit(kMaxOpenFiles),
-      maximum_fd_hard_limit(kMaxOpenFiles) {}
+      maximum_fd_hard_limit(kMaxOpenFiles) {
+  for (auto &entry : published_) {
+    entry.store(nullptr, std::memory_order_relaxed);
+  }
+}
 
 std::shared_ptr<IOManager::IOContext> IOManager::FileDescriptorTable::Get(
     int fd) {
-  if (!IsFileDescriptorValid(fd) || !fd_table_[fd]) return nullptr;
-  return fd_table_[fd]->Get();
+  if (!IsFileDescriptorValid(fd)) return nullptr;
+  EpochDomain::ReadSection read_section(&epoch_domain_);
+  AutoCloseIOContext *file = published_[fd].load(std::memory_order_acquire);
+  if (!file) return nullptr;
+  return file->Get();
 }
 
 int IOManager::FileDescriptorTable::Delete(int fd) {
   if (!IsFileDescriptorValid(fd)) return 0;
   int close_result = 0;
   fd_table_[fd]->WriteCloseResultTo(&close_result);
+  published_[fd].store(nullptr, std::memory_order_release);
+  epoch_domain_.Synchronize();
   fd_table_[fd] = nullptr;
   return close_result;
 }
 
+void IOManager::FileDescriptorTable::Publish(int fd) {
+  published_[fd].store(fd_table_[fd].get(), std::memory_order_release);
+}
+
 bool IOManager::FileDescriptorTable::IsFileDescriptorUnused(int fd) {
   if (!IsFileDescriptorValid(fd)) return false;
   return !fd_table_[fd];
 }
 
+size_t IOManager::FileDescriptorTable::CountFreeFileDescriptors(size_t max) {
+  size_t count = 0;
+  for (int i = 0; i < maximum_fd_soft_limit && count < max; ++i) {
+    if (!fd_table_[i]) {
+      ++count;
+    }
+  }
+  return count;
+}
+
 int IOManager::FileDescriptorTable::Insert(IOContext *context) {
   int fd = GetNextFreeFileDescriptor(0);
   if (fd < 0) {
     return -1;
   }
   fd_table_[fd] = std::make_shared<AutoCloseIOContext>(context);
+  Publish(fd);
   return fd;
 }
 
@@ -79,6 +150,7 @@ int IOManager::FileDescriptorTable::CopyFileDescriptor(int oldfd, int startfd) {
     return -1;
   }
   fd_table_[newfd] = fd_table_[oldfd];
+  Publish(newfd);
   return newfd;
 }
 
@@ -89,6 +161,7 @@ int IOManager::FileDescriptorTable::CopyFileDescriptorToSpecifiedTarget(
     return -1;
   }
   fd_table_[newfd] = fd_table_[oldfd];
+  Publish(newfd);
   return newfd;
 }
 
@@ -163,57 +236,61 @@ int IOManager::CloseFileDescriptor(int fd) {
 
 int IOManager::Close(int fd) {
   absl::WriterMutexLock lock(&fd_table_lock_);
-  return CloseFileDescriptor(fd);
+  int result = CloseFileDescriptor(fd);
+  if (result == 0) {
+    ForgetSocketStats(fd);
+  }
+  return result;
 }
 
+constexpr size_t IOManager::kMaxResolutionCacheSize;
+constexpr size_t IOManager::kMaxAcceptBatch;
+
 IOManager::VirtualPathHandler *IOManager::HandlerForPath(
     absl::string_view path) const {
-  // Start by looking for a full match.
-  std::string current_prefix(path);
-
-  // Keep looking until we find a match or run out of handlers to check.
-  while (true) {
-    // Find the first handler with a prefix greater or equal to this path.
-    // If there is an exact match, this will be it.  Otherwise, any match must
-    // be before this.
-    auto iter = prefix_to_handler_.lower_bound(current_prefix);
-
-    // iter->first is the registered prefix.
-    // iter->second.get() is a pointer to the registered handler.
-
-    // lower_bound can land directory on a match.
-    if (iter != prefix_to_handler_.end() && current_prefix == iter->first) {
-      return iter->second.get();
-    }
-
-    // Since we started with the lower_bound, any prefixes will be found
-    // before that iterator.  If there are none, we're done.
-    if (iter == prefix_to_handler_.begin()) break;
-    --iter;
-
-    // Determine how much this handler's prefix and the current prefix have in
-    // common.
-    std::string::const_iterator end_prefix, end_path;
-    std::tie(end_prefix, end_path) =
-        absl::c_mismatch(iter->first, current_prefix);
+  const std::unique_ptr<VirtualPathHandler> *handler =
+      prefix_to_handler_.FindLongestPrefix(path);
+  return handler ? handler->get() : nullptr;
+}
 
-    // If the entire prefix is in the current prefix up to a /, it's a match.
-    if (end_prefix == iter->first.end() && *end_path == '/') {
-      return iter->second.get();
+StatusOr<std::shared_ptr<const IOManager::ResolvedPath>>
+IOManager::ResolvePath(absl::string_view path) {
+  uint64_t generation;
+  {
+    absl::ReaderMutexLock lock(&resolution_cache_lock_);
+    auto it = resolution_cache_.find(path);
+    if (it != resolution_cache_.end()) {
+      return it->second;
     }
+    generation = resolution_generation_;
+  }
 
-    // Back up the prefix to nearest directory.  We know there can't be a
-    // matching handler with a longer prefix match or we would have found it by
-    // now.
-    while (*end_prefix != '/') --end_prefix;
-
-    // The next iteration of the loop will look for a matching handler using
-    // that directory prefix.
-    current_prefix = std::string(iter->first.begin(), end_prefix);
+  StatusOr<std::string> canonical_path = CanonicalizePath(path);
+  if (!canonical_path.ok()) {
+    return canonical_path.status();
+  }
+  VirtualPathHandler *handler = HandlerForPath(canonical_path.ValueOrDie());
+  auto resolved = std::make_shared<const ResolvedPath>(
+      ResolvedPath{std::move(canonical_path).ValueOrDie(), handler});
+
+  absl::MutexLock lock(&resolution_cache_lock_);
+  // The resolution may predate a change of the working directory or of the
+  // handlers made while it was computed, so it is only cached if there was
+  // none.
+  if (generation != resolution_generation_) {
+    return resolved;
+  }
+  if (resolution_cache_.size() >= kMaxResolutionCacheSize) {
+    resolution_cache_.clear();
   }
+  resolution_cache_.emplace(path, resolved);
+  return resolved;
+}
 
-  // Didn't find a handler.
-  return nullptr;
+void IOManager::InvalidateResolutionCache() {
+  absl::MutexLock lock(&resolution_cache_lock_);
+  resolution_cache_.clear();
+  ++resolution_generation_;
 }
 
 int IOManager::Open(const char *path, int flags, mode_t mode) {
@@ -269,10 +346,37 @@ int IOManager::Dup2(int oldfd, int newfd) {
 }
 
 int IOManager::Pipe(int pipefd[2], int flags) {
+  if (flags & O_ENCLAVE_LOCAL) {
+    if (flags & ~(O_ENCLAVE_LOCAL | O_CLOEXEC | O_NONBLOCK)) {
+      errno = EINVAL;
+      return -1;
+    }
+    std::unique_ptr<IOContextLocalPipe> read_end, write_end;
+    IOContextLocalPipe::CreatePipe(flags, &local_wait_queue_, &read_end,
+                                   &write_end);
+    absl::WriterMutexLock lock(&fd_table_lock_);
+    int read_fd = fd_table_.Insert(read_end.get());
+    if (read_fd < 0) {
+      errno = EMFILE;
+      return -1;
+    }
+    read_end.release();
+    int write_fd = fd_table_.Insert(write_end.get());
+    if (write_fd < 0) {
+      CloseFileDescriptor(read_fd);
+      errno = EMFILE;
+      return -1;
+    }
+    write_end.release();
+    pipefd[0] = read_fd;
+    pipefd[1] = write_fd;
+    return 0;
+  }
+
   int res = enc_untrusted_pipe2(pipefd, flags);
   if (res != -1) {
-    pipefd[0] = RegisterHostFileDescriptor(pipefd[0]);
-    pipefd[1] = RegisterHostFileDescriptor(pipefd[1]);
+    pipefd[0] = RegisterExclusiveHostFileDescriptor(pipefd[0]);
+    pipefd[1] = RegisterExclusiveHostFileDescriptor(pipefd[1]);
     if (pipefd[0] < 0 || pipefd[1] < 0) {
       errno = EMFILE;
       return -1;
@@ -287,6 +391,33 @@ int IOManager::Select(int nfds, fd_set *readfds, fd_set *writefds,
     errno = EINVAL;
     return -1;
   }
+  int cached_result;
+  if (SelectFromReadinessCache(nfds, readfds, writefds, exceptfds,
+                               &cached_result)) {
+    return cached_result;
+  }
+  for (int fd = 0; fd < nfds; ++fd) {
+    if ((readfds && FD_ISSET(fd, readfds)) ||
+        (writefds && FD_ISSET(fd, writefds)) ||
+        (exceptfds && FD_ISSET(fd, exceptfds))) {
+      std::shared_ptr<IOContext> context = fd_table_.Get(fd);
+      if (context && context->LocalPoll(0) >= 0) {
+        return SelectByPoll(nfds, readfds, writefds, exceptfds, timeout);
+      }
+    }
+  }
+
+  // Remember the requested descriptors to record the results in their
+  // readiness caches.
+  fd_set requested_readfds, requested_writefds;
+  FD_ZERO(&requested_readfds);
+  FD_ZERO(&requested_writefds);
+  if (readfds) {
+    requested_readfds = *readfds;
+  }
+  if (writefds) {
+    requested_writefds = *writefds;
+  }
 
   // Translate the fd_sets into host file descriptors.
   fd_set host_readfds, host_writefds, host_exceptfds;
@@ -321,6 +452,7 @@ int IOManager::Select(int nfds, fd_set *readfds, fd_set *writefds,
       }
     }
   }
+  uint64_t snapshot = ReadinessCache::Snapshot();
   int ret = enc_untrusted_select(host_nfds, &host_readfds, &host_writefds,
                                  &host_exceptfds, timeout);
 
@@ -378,32 +510,260 @@ int IOManager::Select(int nfds, fd_set *readfds, fd_set *writefds,
           host_exceptfds_set.find(host_fd) != host_exceptfds_set.end()) {
         FD_SET(fd, exceptfds);
       }
+
+      short requested = 0;
+      short returned = 0;
+      if (FD_ISSET(fd, &requested_readfds)) {
+        requested |= POLLIN;
+        returned |= FD_ISSET(fd, readfds) ? POLLIN : 0;
+      }
+      if (FD_ISSET(fd, &requested_writefds)) {
+        requested |= POLLOUT;
+        returned |= FD_ISSET(fd, writefds) ? POLLOUT : 0;
+      }
+      if (requested) {
+        context->readiness_cache()->Update(snapshot, requested, returned);
+      }
     }
   }
   return ret;
 }
 
+bool IOManager::SelectFromReadinessCache(int nfds, const fd_set *readfds,
+                                         const fd_set *writefds,
+                                         const fd_set *exceptfds,
+                                         int *result) {
+  int ready = 0;
+  for (int fd = 0; fd < nfds; ++fd) {
+    if (exceptfds && FD_ISSET(fd, exceptfds)) {
+      return false;
+    }
+    short requested = 0;
+    if (readfds && FD_ISSET(fd, readfds)) {
+      requested |= POLLIN;
+      ++ready;
+    }
+    if (writefds && FD_ISSET(fd, writefds)) {
+      requested |= POLLOUT;
+      ++ready;
+    }
+    if (!requested) {
+      continue;
+    }
+    std::shared_ptr<IOContext> context = fd_table_.Get(fd);
+    if (!context || (context->readiness_cache()->Lookup(requested) &
+                     requested) != requested) {
+      return false;
+    }
+  }
+  if (ready == 0) {
+    return false;
+  }
+  *result = ready;
+  return true;
+}
+
+int IOManager::SelectByPoll(int nfds, fd_set *readfds, fd_set *writefds,
+                            fd_set *exceptfds, struct timeval *timeout) {
+  std::vector<struct pollfd> fds;
+  for (int fd = 0; fd < nfds; ++fd) {
+    short events = 0;
+    if (readfds && FD_ISSET(fd, readfds)) {
+      events |= POLLIN;
+    }
+    if (writefds && FD_ISSET(fd, writefds)) {
+      events |= POLLOUT;
+    }
+    if (exceptfds && FD_ISSET(fd, exceptfds)) {
+      events |= POLLPRI;
+    }
+    if (events) {
+      fds.push_back({fd, events, 0});
+    }
+  }
+  int poll_timeout = -1;
+  if (timeout) {
+    if (timeout->tv_sec < 0 || timeout->tv_usec < 0) {
+      errno = EINVAL;
+      return -1;
+    }
+    poll_timeout = std::min<int64_t>(
+        timeout->tv_sec * 1000 + (timeout->tv_usec + 999) / 1000, INT_MAX);
+  }
+  int ret = Poll(fds.data(), fds.size(), poll_timeout);
+  if (ret < 0) {
+    return ret;
+  }
+
+  if (readfds) {
+    FD_ZERO(readfds);
+  }
+  if (writefds) {
+    FD_ZERO(writefds);
+  }
+  if (exceptfds) {
+    FD_ZERO(exceptfds);
+  }
+  int ready = 0;
+  for (const struct pollfd &pfd : fds) {
+    if ((pfd.events & POLLIN) && (pfd.revents & (POLLIN | POLLHUP | POLLERR))) {
+      FD_SET(pfd.fd, readfds);
+      ++ready;
+    }
+    if ((pfd.events & POLLOUT) && (pfd.revents & (POLLOUT | POLLERR))) {
+      FD_SET(pfd.fd, writefds);
+      ++ready;
+    }
+    if ((pfd.events & POLLPRI) && (pfd.revents & POLLPRI)) {
+      FD_SET(pfd.fd, exceptfds);
+      ++ready;
+    }
+  }
+  return ready;
+}
+
 int IOManager::Poll(struct pollfd *fds, nfds_t nfds, int timeout) {
+  int cached_result;
+  if (PollFromReadinessCache(fds, nfds, &cached_result)) {
+    return cached_result;
+  }
+
   std::vector<int> enclave_fd(nfds);
+  std::vector<std::shared_ptr<IOContext>> contexts(nfds);
   {
     absl::ReaderMutexLock lock(&fd_table_lock_);
-    for (int i = 0; i < nfds; ++i) {
-      enclave_fd[i] = fds[i].fd;
-      std::shared_ptr<IOContext> context = fd_table_.Get(enclave_fd[i]);
-      if (context) {
-        fds[i].fd = context->GetHostFileDescriptor();
-      } else {
-        fds[i].fd = -1;
-      }
+    for (nfds_t i = 0; i < nfds; ++i) {
+      contexts[i] = fd_table_.Get(fds[i].fd);
     }
   }
+  for (nfds_t i = 0; i < nfds; ++i) {
+    if (contexts[i] && contexts[i]->LocalPoll(0) >= 0) {
+      return PollWithLocalStreams(fds, nfds, timeout, contexts);
+    }
+  }
+  for (nfds_t i = 0; i < nfds; ++i) {
+    enclave_fd[i] = fds[i].fd;
+    fds[i].fd = contexts[i] ? contexts[i]->GetHostFileDescriptor() : -1;
+  }
+  uint64_t snapshot = ReadinessCache::Snapshot();
   int ret = enc_untrusted_poll(fds, nfds, timeout);
   for (int i = 0; i < nfds; ++i) {
     fds[i].fd = enclave_fd[i];
+    if (ret >= 0 && contexts[i]) {
+      contexts[i]->readiness_cache()->Update(snapshot, fds[i].events,
+                                             fds[i].revents);
+    }
   }
   return ret;
 }
 
+int IOManager::PollWithLocalStreams(
+    struct pollfd *fds, nfds_t nfds, int timeout,
+    const std::vector<std::shared_ptr<IOContext>> &contexts) {
+  const absl::Time deadline = LocalWaitQueue::Deadline(timeout);
+  std::vector<bool> local(nfds);
+  std::vector<struct pollfd> host_fds;
+  std::vector<nfds_t> host_index;
+  for (nfds_t i = 0; i < nfds; ++i) {
+    if (!contexts[i]) {
+      continue;
+    }
+    // A stream may be both local and backed by a host file descriptor, in
+    // which case it is waited on both ways.
+    local[i] = contexts[i]->LocalPoll(0) >= 0;
+    int host_fd = contexts[i]->GetHostFileDescriptor();
+    if (!local[i] || host_fd >= 0) {
+      host_fds.push_back({host_fd, fds[i].events, 0});
+      host_index.push_back(i);
+    }
+  }
+
+  while (true) {
+    // Register before checking the local streams, so that no change after the
+    // check goes unnoticed.
+    uint64_t generation;
+    int wakeup_fd = -1;
+    if (host_fds.empty()) {
+      generation = local_wait_queue_.Generation();
+    } else {
+      wakeup_fd = local_wait_queue_.BeginHostWait(&generation);
+      if (wakeup_fd < 0) {
+        return -1;
+      }
+    }
+
+    int ready = 0;
+    for (nfds_t i = 0; i < nfds; ++i) {
+      fds[i].revents = local[i] ? contexts[i]->LocalPoll(fds[i].events) : 0;
+      if (fds[i].revents) {
+        ++ready;
+      }
+    }
+
+    if (host_fds.empty()) {
+      if (ready > 0 || timeout == 0) {
+        return ready;
+      }
+      if (!local_wait_queue_.Wait(generation, deadline)) {
+        return 0;
+      }
+      continue;
+    }
+
+    // Wait for the host file descriptors, and for the wakeup file descriptor
+    // to learn about changes of the local streams.
+    host_fds.push_back({wakeup_fd, POLLIN, 0});
+    int host_timeout =
+        ready > 0 ? 0 : LocalWaitQueue::RemainingTimeout(deadline);
+    uint64_t snapshot = ReadinessCache::Snapshot();
+    int ret = enc_untrusted_poll(host_fds.data(), host_fds.size(), host_timeout);
+    local_wait_queue_.EndHostWait(generation);
+    host_fds.pop_back();
+    if (ret < 0) {
+      return -1;
+    }
+    for (size_t j = 0; j < host_fds.size(); ++j) {
+      nfds_t i = host_index[j];
+      contexts[i]->readiness_cache()->Update(snapshot, fds[i].events,
+                                             host_fds[j].revents);
+      if (!fds[i].revents && host_fds[j].revents) {
+        ++ready;
+      }
+      fds[i].revents |= host_fds[j].revents;
+    }
+    if (ready > 0 || host_timeout == 0) {
+      return ready;
+    }
+  }
+}
+
+bool IOManager::PollFromReadinessCache(struct pollfd *fds, nfds_t nfds,
+                                       int *result) {
+  if (nfds == 0) {
+    return false;
+  }
+  for (nfds_t i = 0; i < nfds; ++i) {
+    if (fds[i].events == 0 ||
+        (fds[i].events & ~ReadinessCache::kTrackedEvents) != 0) {
+      return false;
+    }
+    std::shared_ptr<IOContext> context = fd_table_.Get(fds[i].fd);
+    if (!context || (context->readiness_cache()->Lookup(fds[i].events) &
+                     fds[i].events) != fds[i].events) {
+      return false;
+    }
+  }
+  // Report the conditions last reported by the host along with the events.
+  for (nfds_t i = 0; i < nfds; ++i) {
+    std::shared_ptr<IOContext> context = fd_table_.Get(fds[i].fd);
+    fds[i].revents =
+        fds[i].events |
+        (context ? context->readiness_cache()->Lookup(fds[i].events) : 0);
+  }
+  *result = nfds;
+  return true;
+}
+
 int IOManager::EpollCreate(int size) {
   if (size < 1) {
     errno = EINVAL;
@@ -413,7 +773,8 @@ int IOManager::EpollCreate(int size) {
   if (hostfd == -1) {
     return -1;
   }
-  auto context = ::absl::make_unique<IOContextEpoll>(hostfd);
+  auto context =
+      ::absl::make_unique<IOContextEpoll>(hostfd, &local_wait_queue_);
   absl::WriterMutexLock lock(&fd_table_lock_);
   int fd = fd_table_.Insert(context.get());
   if (fd >= 0) {
@@ -425,20 +786,17 @@ int IOManager::EpollCreate(int size) {
 }
 
 int IOManager::EpollCtl(int epfd, int op, int fd, struct epoll_event *event) {
-  std::shared_ptr<IOContext> context;
-  {
-    absl::ReaderMutexLock lock(&fd_table_lock_);
-    context = fd_table_.Get(fd);
-  }
+  std::shared_ptr<IOContext> context = fd_table_.Get(fd);
   int hostfd = context ? context->GetHostFileDescriptor() : -1;
-  if (hostfd == -1) {
+  // Local streams are registered with the epoll context itself.
+  if (hostfd == -1 && !(context && context->LocalPoll(0) >= 0)) {
     errno = EBADF;
     return -1;
   }
-  return CallWithContext(
-      epfd, [op, hostfd, event](std::shared_ptr<IOContext> epoll_context) {
-        return epoll_context->EpollCtl(op, hostfd, event);
-      });
+  return CallWithContext(epfd, [op, hostfd, event, &context](
+                                   std::shared_ptr<IOContext> epoll_context) {
+    return epoll_context->EpollCtl(op, hostfd, event, context);
+  });
 }
 
 int IOManager::EpollWait(int epfd, struct epoll_event *events, int maxevents,
@@ -450,7 +808,8 @@ int IOManager::EpollWait(int epfd, struct epoll_event *events, int maxevents,
 }
 
 int IOManager::EventFd(unsigned int initval, int flags) {
-  auto context = ::absl::make_unique<IOContextEventFd>(initval, flags);
+  auto context =
+      ::absl::make_unique<IOContextEventFd>(initval, flags, &local_wait_queue_);
   absl::WriterMutexLock lock(&fd_table_lock_);
   int fd = fd_table_.Insert(context.get());
   if (fd >= 0) {
@@ -516,15 +875,40 @@ struct ErrorValue<Type,
   static constexpr Type value = nullptr;
 };
 
+// Header of a message in the syslog buffer. The header is followed by
+// |length| bytes of message and a newline, so that every message is a line.
+struct SyslogRecordHeader {
+  int priority;
+  int length;
+};
+
+// Sink of the syslog buffer, which logs all whole records in |data| with a
+// single host call.
+ssize_t WriteSyslogRecords(const void *data, size_t size) {
+  const char *position = reinterpret_cast<const char *>(data);
+  const char *end = position + size;
+  std::vector<HostSyslogMessage> messages;
+  while (end - position >= static_cast<ptrdiff_t>(sizeof(SyslogRecordHeader))) {
+    SyslogRecordHeader header;
+    memcpy(&header, position, sizeof(header));
+    const char *message = position + sizeof(header);
+    if (header.length < 0 || end - message < header.length + 1) {
+      break;
+    }
+    messages.push_back({header.priority, message, header.length});
+    position = message + header.length + 1;
+  }
+  enc_untrusted_syslog_batch(messages);
+  return size;
+}
+
 }  // namespace
 
 template <typename IOAction, typename ReturnType>
 ReturnType IOManager::CallWithContext(int fd, IOAction action) {
-  std::shared_ptr<IOContext> context;
-  {
-    absl::ReaderMutexLock lock(&fd_table_lock_);
-    context = fd_table_.Get(fd);
-  }
+  // The context is copied out of the table rather than used inside the read
+  // section, since actions may block on the host for arbitrarily long.
+  std::shared_ptr<IOContext> context = fd_table_.Get(fd);
   if (context) {
     return action(context);
   }
@@ -532,19 +916,56 @@ ReturnType IOManager::CallWithContext(int fd, IOAction action) {
   return ErrorValue<ReturnType>::value;
 }
 
+template <typename IOAction, typename ReturnType>
+ReturnType IOManager::CallWithContextConsuming(int fd, short events,
+                                               IOAction action) {
+  std::shared_ptr<IOContext> context = fd_table_.Get(fd);
+  if (context) {
+    ReturnType result = action(context);
+    // Invalidate only after the action completed, so that a concurrent poll
+    // which observed readiness before it was consumed cannot record it later.
+    context->readiness_cache()->Invalidate(events);
+    return result;
+  }
+  errno = EBADF;
+  return ErrorValue<ReturnType>::value;
+}
+
+template <typename IOAction>
+ssize_t IOManager::CallWithHostTransfer(int in_fd, int out_fd,
+                                        IOAction action) {
+  // Hold both contexts for the duration of the transfer so that their host
+  // file descriptors are not closed and reused underneath it.
+  std::shared_ptr<IOContext> in_context = fd_table_.Get(in_fd);
+  std::shared_ptr<IOContext> out_context = fd_table_.Get(out_fd);
+  if (!in_context || !out_context) {
+    errno = EBADF;
+    return -1;
+  }
+  int host_in_fd = in_context->GetHostTransferFileDescriptor();
+  int host_out_fd = out_context->GetHostTransferFileDescriptor();
+  if (host_in_fd < 0 || host_out_fd < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  ssize_t result = action(host_in_fd, host_out_fd);
+  in_context->readiness_cache()->Invalidate(POLLIN);
+  out_context->readiness_cache()->Invalidate(POLLOUT);
+  return result;
+}
+
 template <typename IOAction, typename ReturnType>
 ReturnType IOManager::CallWithHandler(const char *path, IOAction action) {
-  StatusOr<std::string> status = CanonicalizePath(path);
+  StatusOr<std::shared_ptr<const ResolvedPath>> status = ResolvePath(path);
   if (!status.ok()) {
     errno = status.status().error_code();
     return ErrorValue<ReturnType>::value;
   }
 
-  absl::string_view canonical_path = status.ValueOrDie();
-  VirtualPathHandler *handler = HandlerForPath(canonical_path);
-  if (handler) {
+  const ResolvedPath &resolved = *status.ValueOrDie();
+  if (resolved.handler) {
     // Invoke the path handler if one is installed.
-    return action(handler, canonical_path.data());
+    return action(resolved.handler, resolved.canonical_path.c_str());
   }
 
   errno = ENOENT;
@@ -554,29 +975,28 @@ ReturnType IOManager::CallWithHandler(const char *path, IOAction action) {
 template <typename IOAction, typename ReturnType>
 ReturnType IOManager::CallWithHandler(const char *path1, const char *path2,
                                       IOAction action) {
-  StatusOr<std::string> status1 = CanonicalizePath(path1);
+  StatusOr<std::shared_ptr<const ResolvedPath>> status1 = ResolvePath(path1);
   if (!status1.ok()) {
     errno = status1.status().error_code();
     return ErrorValue<ReturnType>::value;
   }
-  StatusOr<std::string> status2 = CanonicalizePath(path2);
+  StatusOr<std::shared_ptr<const ResolvedPath>> status2 = ResolvePath(path2);
   if (!status2.ok()) {
     errno = status2.status().error_code();
     return ErrorValue<ReturnType>::value;
   }
 
-  absl::string_view canonical_path1 = status1.ValueOrDie();
-  absl::string_view canonical_path2 = status2.ValueOrDie();
-  VirtualPathHandler *handler1 = HandlerForPath(canonical_path1);
-  VirtualPathHandler *handler2 = HandlerForPath(canonical_path2);
-  if (handler1 != handler2) {
+  const ResolvedPath &resolved1 = *status1.ValueOrDie();
+  const ResolvedPath &resolved2 = *status2.ValueOrDie();
+  if (resolved1.handler != resolved2.handler) {
     errno = EXDEV;
     return ErrorValue<ReturnType>::value;
   }
 
-  if (handler1) {
+  if (resolved1.handler) {
     // Invoke the path handler if one is installed.
-    return action(handler1, canonical_path1.data(), canonical_path2.data());
+    return action(resolved1.handler, resolved1.canonical_path.c_str(),
+                  resolved2.canonical_path.c_str());
   }
 
   errno = ENOENT;
@@ -584,9 +1004,10 @@ ReturnType IOManager::CallWithHandler(const char *path1, const char *path2,
 }
 
 int IOManager::Read(int fd, char *buf, size_t count) {
-  return CallWithContext(fd, [buf, count](std::shared_ptr<IOContext> context) {
-    return context->Read(buf, count);
-  });
+  return CallWithContextConsuming(
+      fd, POLLIN, [buf, count](std::shared_ptr<IOContext> context) {
+        return context->Read(buf, count);
+      });
 }
 
 bool IOManager::RegisterVirtualPathHandler(
@@ -597,12 +1018,14 @@ bool IOManager::RegisterVirtualPathHandler(
     return false;
   }
 
-  prefix_to_handler_.emplace(path_prefix, std::move(handler));
+  prefix_to_handler_.Insert(path_prefix, std::move(handler));
+  InvalidateResolutionCache();
   return true;
 }
 
 void IOManager::DeregisterVirtualPathHandler(const std::string &path_prefix) {
-  prefix_to_handler_.erase(path_prefix);
+  prefix_to_handler_.Erase(path_prefix);
+  InvalidateResolutionCache();
 }
 
 Status IOManager::SetCurrentWorkingDirectory(absl::string_view path) {
@@ -610,6 +1033,7 @@ Status IOManager::SetCurrentWorkingDirectory(absl::string_view path) {
   Status status = working_directory.status();
   if (status.ok()) {
     current_working_directory_ = working_directory.ValueOrDie();
+    InvalidateResolutionCache();
   }
 
   return status;
@@ -667,9 +1091,10 @@ StatusOr<std::string> IOManager::CanonicalizePath(
 }
 
 int IOManager::Write(int fd, const char *buf, size_t count) {
-  return CallWithContext(fd, [buf, count](std::shared_ptr<IOContext> context) {
-    return context->Write(buf, count);
-  });
+  return CallWithContextConsuming(
+      fd, POLLOUT, [buf, count](std::shared_ptr<IOContext> context) {
+        return context->Write(buf, count);
+      });
 }
 
 int IOManager::Chown(const char *path, uid_t owner, gid_t group) {
@@ -753,6 +1178,49 @@ int IOManager::LStat(const char *pathname, struct stat *stat_buffer) {
   });
 }
 
+int IOManager::FStatAt(int dirfd, const char *pathname,
+                       struct stat *stat_buffer, int flags) {
+  if (!pathname) {
+    errno = EFAULT;
+    return -1;
+  }
+  if (pathname[0] == '/' || dirfd == AT_FDCWD) {
+    if (flags & ~AT_SYMLINK_NOFOLLOW) {
+      errno = EINVAL;
+      return -1;
+    }
+    return (flags & AT_SYMLINK_NOFOLLOW) ? LStat(pathname, stat_buffer)
+                                         : Stat(pathname, stat_buffer);
+  }
+  return CallWithContext(dirfd, [pathname, stat_buffer,
+                                 flags](std::shared_ptr<IOContext> context) {
+    return context->FStatAt(pathname, stat_buffer, flags);
+  });
+}
+
+int IOManager::ReadDirectory(int fd, DirectoryEntry *entry) {
+  size_t batch_size = directory_batch_size_.load(std::memory_order_relaxed);
+  return CallWithContext(
+      fd, [batch_size, entry](std::shared_ptr<IOContext> context) {
+        return context->ReadDirectory(batch_size, entry);
+      });
+}
+
+int IOManager::SeekDirectory(int fd, off_t offset) {
+  return CallWithContext(fd, [offset](std::shared_ptr<IOContext> context) {
+    return context->SeekDirectory(offset);
+  });
+}
+
+bool IOManager::SetDirectoryBatchSize(size_t batch_size) {
+  if (batch_size < kMinDirectoryBatchSize ||
+      batch_size > kMaxDirectoryBatchSize) {
+    return false;
+  }
+  directory_batch_size_.store(batch_size, std::memory_order_relaxed);
+  return true;
+}
+
 int IOManager::StatFs(const char *pathname, struct statfs *statfs_buffer) {
   return CallWithHandler(pathname, [statfs_buffer](VirtualPathHandler *handler,
                                                    const char *canonical_path) {
@@ -955,24 +1423,78 @@ int IOManager::Utimes(const char *filename, const struct timeval times[2]) {
 }
 
 ssize_t IOManager::Writev(int fd, const struct iovec *iov, int iovcnt) {
-  return CallWithContext(fd, [iov, iovcnt](std::shared_ptr<IOContext> context) {
-    return context->Writev(iov, iovcnt);
-  });
+  return CallWithContextConsuming(
+      fd, POLLOUT, [iov, iovcnt](std::shared_ptr<IOContext> context) {
+        return context->Writev(iov, iovcnt);
+      });
 }
 
 ssize_t IOManager::Readv(int fd, const struct iovec *iov, int iovcnt) {
-  return CallWithContext(fd, [iov, iovcnt](std::shared_ptr<IOContext> context) {
-    return context->Readv(iov, iovcnt);
-  });
+  return CallWithContextConsuming(
+      fd, POLLIN, [iov, iovcnt](std::shared_ptr<IOContext> context) {
+        return context->Readv(iov, iovcnt);
+      });
 }
 
 ssize_t IOManager::PRead(int fd, void *buf, size_t count, off_t offset) {
-  return CallWithContext(
-      fd, [buf, count, offset](std::shared_ptr<IOContext> context) {
+  return CallWithContextConsuming(
+      fd, POLLIN, [buf, count, offset](std::shared_ptr<IOContext> context) {
         return context->PRead(buf, count, offset);
       });
 }
 
+ssize_t IOManager::PWritev(int fd, const struct iovec *iov, int iovcnt,
+                           off_t offset) {
+  return CallWithContextConsuming(
+      fd, POLLOUT, [iov, iovcnt, offset](std::shared_ptr<IOContext> context) {
+        return context->PWritev(iov, iovcnt, offset);
+      });
+}
+
+ssize_t IOManager::PReadv(int fd, const struct iovec *iov, int iovcnt,
+                          off_t offset) {
+  return CallWithContextConsuming(
+      fd, POLLIN, [iov, iovcnt, offset](std::shared_ptr<IOContext> context) {
+        return context->PReadv(iov, iovcnt, offset);
+      });
+}
+
+void *IOManager::MapReadOnly(int fd, size_t length, off_t offset) {
+  return CallWithContext(
+      fd, [length, offset](std::shared_ptr<IOContext> context) {
+        return context->MapReadOnly(length, offset);
+      });
+}
+
+ssize_t IOManager::SendFile(int out_fd, int in_fd, off_t *offset,
+                            size_t count) {
+  return CallWithHostTransfer(
+      in_fd, out_fd, [offset, count](int host_in_fd, int host_out_fd) {
+        return enc_untrusted_sendfile(host_out_fd, host_in_fd, offset, count);
+      });
+}
+
+ssize_t IOManager::Splice(int fd_in, off_t *off_in, int fd_out,
+                          off_t *off_out, size_t len, unsigned int flags) {
+  return CallWithHostTransfer(
+      fd_in, fd_out,
+      [off_in, off_out, len, flags](int host_in_fd, int host_out_fd) {
+        return enc_untrusted_splice(host_in_fd, off_in, host_out_fd, off_out,
+                                    len, flags);
+      });
+}
+
+ssize_t IOManager::CopyFileRange(int fd_in, off_t *off_in, int fd_out,
+                                 off_t *off_out, size_t len,
+                                 unsigned int flags) {
+  return CallWithHostTransfer(
+      fd_in, fd_out,
+      [off_in, off_out, len, flags](int host_in_fd, int host_out_fd) {
+        return enc_untrusted_copy_file_range(host_in_fd, off_in, host_out_fd,
+                                             off_out, len, flags);
+      });
+}
+
 mode_t IOManager::Umask(mode_t mask) { return enc_untrusted_umask(mask); }
 
 int IOManager::GetRLimit(int resource, struct rlimit *rlim) {
@@ -1026,32 +1548,61 @@ int IOManager::SetSockOpt(int sockfd, int level, int option_name,
 
 int IOManager::Connect(int sockfd, const struct sockaddr *addr,
                        socklen_t addrlen) {
-  return CallWithContext(sockfd,
-                         [addr, addrlen](std::shared_ptr<IOContext> context) {
-                           return context->Connect(addr, addrlen);
-                         });
+  return CallWithContextConsuming(
+      sockfd, ReadinessCache::kTrackedEvents,
+      [addr, addrlen](std::shared_ptr<IOContext> context) {
+        return context->Connect(addr, addrlen);
+      });
 }
 
 int IOManager::Shutdown(int sockfd, int how) {
-  return CallWithContext(sockfd, [how](std::shared_ptr<IOContext> context) {
-    return context->Shutdown(how);
-  });
+  return CallWithContextConsuming(
+      sockfd, ReadinessCache::kTrackedEvents,
+      [how](std::shared_ptr<IOContext> context) {
+        return context->Shutdown(how);
+      });
 }
 
 ssize_t IOManager::Send(int sockfd, const void *buf, size_t len, int flags) {
-  return CallWithContext(sockfd,
-                         [buf, len, flags](std::shared_ptr<IOContext> context) {
-                           return context->Send(buf, len, flags);
-                         });
+  return CallWithContextConsuming(
+      sockfd, POLLOUT, [buf, len, flags](std::shared_ptr<IOContext> context) {
+        return context->Send(buf, len, flags);
+      });
 }
 
 int IOManager::Socket(int domain, int type, int protocol) {
+  bool enclave_local = type & SOCK_ENCLAVE_LOCAL;
+  type &= ~SOCK_ENCLAVE_LOCAL;
+  if (enclave_local &&
+      ((domain != AF_INET && domain != AF_INET6) ||
+       (type & ~(SOCK_NONBLOCK | SOCK_CLOEXEC)) != SOCK_STREAM ||
+       (protocol != 0 && protocol != IPPROTO_TCP))) {
+    errno = EINVAL;
+    return -1;
+  }
+
   int socket = enc_untrusted_socket(domain, type, protocol);
   if (socket == -1) {
     return -1;
   }
 
-  int ret = this->RegisterHostFileDescriptor(socket);
+  // TCP sockets which opt in connect to listening sockets of the enclave over
+  // loopback without going through the host.
+  if (enclave_local) {
+    auto context = ::absl::make_unique<IOContextStreamSocket>(
+        socket, &loopback_registry_, &local_wait_queue_);
+    context->readiness_cache()->set_exclusive(true);
+    absl::WriterMutexLock lock(&fd_table_lock_);
+    int fd = fd_table_.Insert(context.get());
+    if (fd >= 0) {
+      context.release();
+      return fd;
+    }
+    errno = EMFILE;
+    return -1;
+  }
+
+  int ret = RegisterExclusiveHostFileDescriptor(socket);
   if (ret < 0) {
     errno = EMFILE;
   }
@@ -1067,20 +1618,160 @@ int IOManager::GetSockOpt(int sockfd, int level, int optname, void *optval,
 }
 
 int IOManager::Accept(int sockfd, struct sockaddr *addr, socklen_t *addrlen) {
-  int ret = CallWithContext(
-      sockfd, [addr, addrlen](std::shared_ptr<IOContext> context) {
+  std::shared_ptr<IOContext> context = fd_table_.Get(sockfd);
+  if (context && context->LocalPoll(0) >= 0) {
+    // The socket also takes connections from inside the enclave.
+    return Accept4(sockfd, addr, addrlen, /*flags=*/0);
+  }
+  int ret = CallWithContextConsuming(
+      sockfd, POLLIN, [addr, addrlen](std::shared_ptr<IOContext> context) {
         return context->Accept(addr, addrlen);
       });
   if (ret < 0) {
     return -1;
   }
-  ret = this->RegisterHostFileDescriptor(ret);
+  ret = RegisterExclusiveHostFileDescriptor(ret);
   if (ret < 0) {
     errno = EMFILE;
   }
   return ret;
 }
 
+int IOManager::AcceptBatch(int sockfd, int flags,
+                           const std::vector<SocketOption> &options,
+                           size_t max_connections,
+                           std::vector<AcceptedConnection> *connections) {
+  max_connections = std::min(max_connections, kMaxAcceptBatch);
+  {
+    // Accepting a connection which cannot be given a file descriptor would
+    // drop it, so leave it queued on the socket instead.
+    absl::WriterMutexLock lock(&fd_table_lock_);
+    max_connections = fd_table_.CountFreeFileDescriptors(max_connections);
+  }
+  if (max_connections == 0) {
+    errno = EMFILE;
+    return -1;
+  }
+  size_t first = connections->size();
+  std::shared_ptr<IOContext> context = fd_table_.Get(sockfd);
+  if (context && context->LocalPoll(0) >= 0) {
+    int ret = AcceptLocalConnections(sockfd, context, flags, options,
+                                     max_connections, connections);
+    if (ret != 0) {
+      return ret;
+    }
+  }
+  SocketCallRecorder recorder(sockfd, SocketCallKind::kOther);
+  int ret = recorder.Finish(CallWithContextConsuming(
+      sockfd, POLLIN,
+      [flags, &options, max_connections,
+       connections](std::shared_ptr<IOContext> context) {
+        return context->AcceptBatch(flags, options, max_connections,
+                                    connections);
+      }));
+  if (ret < 0) {
+    return -1;
+  }
+
+  size_t registered = first;
+  for (size_t i = first; i < connections->size(); ++i) {
+    AcceptedConnection connection = (*connections)[i];
+    int fd = RegisterExclusiveHostFileDescriptor(connection.fd);
+    if (fd < 0) {
+      // Another thread took the file descriptors counted above. The
+      // connection is already accepted on the host, so it is dropped.
+      enc_untrusted_close(connection.fd);
+      continue;
+    }
+    connection.fd = fd;
+    RecordSocketPeer(fd, reinterpret_cast<struct sockaddr *>(&connection.addr),
+                     connection.addrlen);
+    (*connections)[registered++] = connection;
+  }
+  connections->resize(registered);
+  if (registered == first) {
+    errno = EMFILE;
+    return -1;
+  }
+  return registered - first;
+}
+
+int IOManager::AcceptLocalConnections(
+    int sockfd, const std::shared_ptr<IOContext> &context, int flags,
+    const std::vector<SocketOption> &options, size_t max_connections,
+    std::vector<AcceptedConnection> *connections) {
+  while (true) {
+    int accepted = 0;
+    bool dropped = false;
+    while (static_cast<size_t>(accepted) < max_connections) {
+      AcceptedConnection connection;
+      std::unique_ptr<IOContext> socket =
+          context->AcceptLocal(flags, &connection);
+      if (!socket) {
+        break;
+      }
+      for (const SocketOption &option : options) {
+        if (socket->SetSockOpt(option.level, option.option_name,
+                               &option.value, sizeof(option.value)) != 0) {
+          connection.setup_errno = errno;
+          break;
+        }
+      }
+      {
+        absl::WriterMutexLock lock(&fd_table_lock_);
+        connection.fd = fd_table_.Insert(socket.get());
+      }
+      if (connection.fd < 0) {
+        // Out of enclave file descriptors; the connection is dropped.
+        dropped = true;
+        continue;
+      }
+      socket.release();
+      RecordSocketPeer(connection.fd,
+                       reinterpret_cast<struct sockaddr *>(&connection.addr),
+                       connection.addrlen);
+      connections->push_back(connection);
+      ++accepted;
+    }
+    if (accepted > 0) {
+      return accepted;
+    }
+    if (dropped) {
+      errno = EMFILE;
+      return -1;
+    }
+
+    // Wait for a connection from either inside or outside the enclave, unless
+    // the socket is non-blocking and the host reports that none is pending.
+    int status_flags = context->FCntl(F_GETFL, 0);
+    if (status_flags < 0 || (status_flags & O_NONBLOCK)) {
+      return 0;
+    }
+    struct pollfd pfd = {sockfd, POLLIN, 0};
+    if (Poll(&pfd, 1, /*timeout=*/-1) < 0) {
+      return -1;
+    }
+    if (context->LocalPoll(POLLIN) <= 0) {
+      return 0;
+    }
+  }
+}
+
+int IOManager::Accept4(int sockfd, struct sockaddr *addr, socklen_t *addrlen,
+                       int flags) {
+  std::vector<AcceptedConnection> connections;
+  if (AcceptBatch(sockfd, flags, /*options=*/{}, /*max_connections=*/1,
+                  &connections) < 0) {
+    return -1;
+  }
+  const AcceptedConnection &connection = connections.front();
+  if (addr && addrlen) {
+    memcpy(addr, &connection.addr, std::min(*addrlen, connection.addrlen));
+    *addrlen = connection.addrlen;
+  }
+  return connection.fd;
+}
+
 int IOManager::Bind(int sockfd, const struct sockaddr *addr,
                     socklen_t addrlen) {
   return CallWithContext(sockfd,
@@ -1096,17 +1787,17 @@ int IOManager::Listen(int sockfd, int backlog) {
 }
 
 ssize_t IOManager::SendMsg(int sockfd, const struct msghdr *msg, int flags) {
-  return CallWithContext(sockfd,
-                         [msg, flags](std::shared_ptr<IOContext> context) {
-                           return context->SendMsg(msg, flags);
-                         });
+  return CallWithContextConsuming(
+      sockfd, POLLOUT, [msg, flags](std::shared_ptr<IOContext> context) {
+        return context->SendMsg(msg, flags);
+      });
 }
 
 ssize_t IOManager::RecvMsg(int sockfd, struct msghdr *msg, int flags) {
-  return CallWithContext(sockfd,
-                         [msg, flags](std::shared_ptr<IOContext> context) {
-                           return context->RecvMsg(msg, flags);
-                         });
+  return CallWithContextConsuming(
+      sockfd, POLLIN, [msg, flags](std::shared_ptr<IOContext> context) {
+        return context->RecvMsg(msg, flags);
+      });
 }
 
 int IOManager::GetSockName(int sockfd, struct sockaddr *addr,
@@ -1127,10 +1818,11 @@ int IOManager::GetPeerName(int sockfd, struct sockaddr *addr,
 
 ssize_t IOManager::RecvFrom(int sockfd, void *buf, size_t len, int flags,
                             struct sockaddr *src_addr, socklen_t *addrlen) {
-  return CallWithContext(sockfd, [buf, len, flags, src_addr,
-                                  addrlen](std::shared_ptr<IOContext> context) {
-    return context->RecvFrom(buf, len, flags, src_addr, addrlen);
-  });
+  return CallWithContextConsuming(
+      sockfd, POLLIN,
+      [buf, len, flags, src_addr, addrlen](std::shared_ptr<IOContext> context) {
+        return context->RecvFrom(buf, len, flags, src_addr, addrlen);
+      });
 }
 
 int IOManager::RegisterHostFileDescriptor(int host_fd) {
@@ -1144,5 +1836,67 @@ int IOManager::RegisterHostFileDescriptor(int host_fd) {
   return -1;
 }
 
+int IOManager::RegisterExclusiveHostFileDescriptor(int host_fd) {
+  absl::WriterMutexLock lock(&fd_table_lock_);
+  auto context = ::absl::make_unique<IOContextNative>(host_fd);
+  context->readiness_cache()->set_exclusive(true);
+  int fd = fd_table_.Insert(context.get());
+  if (fd >= 0) {
+    context.release();
+    return fd;
+  }
+  return -1;
+}
+
+void IOManager::MarkFileDescriptorsShared() {
+  absl::ReaderMutexLock lock(&fd_table_lock_);
+  for (int fd = 0; fd < kMaxOpenFiles; ++fd) {
+    std::shared_ptr<IOContext> context = fd_table_.Get(fd);
+    if (context) {
+      context->readiness_cache()->set_exclusive(false);
+    }
+  }
+}
+
+int IOManager::RegisterBufferedHostFileDescriptor(
+    int host_fd, const OutputBufferOptions &options) {
+  absl::WriterMutexLock lock(&fd_table_lock_);
+  auto context = ::absl::make_unique<IOContextBufferedNative>(host_fd, options);
+  int fd = fd_table_.Insert(context.get());
+  if (fd >= 0) {
+    context.release();
+    return fd;
+  }
+  return -1;
+}
+
+void IOManager::Syslog(int priority, const char *message, size_t length) {
+  if (length > INT_MAX - sizeof(SyslogRecordHeader) - 1) {
+    length = INT_MAX - sizeof(SyslogRecordHeader) - 1;
+  }
+  absl::ReaderMutexLock lock(&syslog_lock_);
+  if (!syslog_buffer_) {
+    enc_untrusted_syslog(priority, message, length);
+    return;
+  }
+  SyslogRecordHeader header = {priority, static_cast<int>(length)};
+  char newline = '\n';
+  struct iovec record[] = {
+      {&header, sizeof(header)},
+      {const_cast<char *>(message), length},
+      {&newline, 1},
+  };
+  syslog_buffer_->Writev(record, 3);
+}
+
+void IOManager::SetSyslogBuffering(const OutputBufferOptions &options) {
+  absl::MutexLock lock(&syslog_lock_);
+  syslog_buffer_.reset();
+  if (options.policy != FlushPolicy::kUnbuffered) {
+    syslog_buffer_ =
+        absl::make_unique<OutputBuffer>(options, WriteSyslogRecords);
+  }
+}
+
 }  // namespace io
 }  // namespace asylo
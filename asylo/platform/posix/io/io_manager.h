@@ -34,15 +34,23 @@
 #include <cstdint>
 #include <cstdlib>
 #include <functional>
-#include <map>
 #include <memory>
 #include <queue>
+#include <string>
 #include <type_traits>
+#include <vector>
 
 #include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/memory/memory.h"
 #include "absl/strings/string_view.h"
 #include "absl/synchronization/mutex.h"
+#include "asylo/util/epoch_domain.h"
+#include "asylo/platform/posix/io/local_wait_queue.h"
+#include "asylo/platform/posix/io/loopback_listener.h"
+#include "asylo/platform/posix/io/output_buffer.h"
+#include "asylo/platform/posix/io/path_trie.h"
+#include "asylo/platform/posix/io/readiness_cache.h"
 #include "asylo/platform/storage/secure/enclave_storage_secure.h"
 #include "asylo/util/statusor.h"
 
@@ -57,6 +65,45 @@ class IOManager {
   // time.
   static const constexpr int kMaxOpenFiles = 1024;
 
+  // The default, smallest and largest number of bytes of directory entries
+  // fetched from the host at a time by ReadDirectory.
+  static constexpr size_t kDefaultDirectoryBatchSize = 32 * 1024;
+  static constexpr size_t kMinDirectoryBatchSize = 1024;
+  static constexpr size_t kMaxDirectoryBatchSize = 1024 * 1024;
+
+  // An entry of a directory read by ReadDirectory.
+  struct DirectoryEntry {
+    ino_t inode;
+
+    // Position of the entry following this one, which may be passed to
+    // SeekDirectory.
+    off_t next_offset;
+
+    std::string name;
+  };
+
+  // The largest number of connections taken by a single AcceptBatch call.
+  static constexpr size_t kMaxAcceptBatch = 64;
+
+  // An integer socket option set by AcceptBatch on each accepted connection.
+  struct SocketOption {
+    int level;
+    int option_name;
+    int value;
+  };
+
+  // A connection accepted by AcceptBatch.
+  struct AcceptedConnection {
+    int fd;
+
+    // 0 if every option was set, otherwise the errno value with which setting
+    // the first failing option failed.
+    int setup_errno;
+
+    struct sockaddr_storage addr;
+    socklen_t addrlen;
+  };
+
   // An IOContext object represents an abstract I/O stream. Different concrete
   // implementations might wrap a native file descriptor on the host, a virtual
   // device like "/dev/urandom" backed by software, or a secure stream with
@@ -65,6 +112,30 @@ class IOManager {
    public:
     virtual ~IOContext() = default;
 
+    // Readiness of this stream for reading and writing, as last learned from
+    // the host. Only consulted once the stream is marked exclusive, that is
+    // while no other process can use its host file descriptor.
+    ReadinessCache *readiness_cache() { return &readiness_cache_; }
+
+    // For streams implemented entirely inside the enclave, returns which of
+    // the poll(2) |events| the stream is ready for, along with POLLERR and
+    // POLLHUP if they apply. Such streams report changes in their readiness
+    // to the LocalWaitQueue of the IOManager. Returns -1 for streams backed by
+    // a host file descriptor. A stream which also has a host file descriptor,
+    // such as a listening socket which accepts connections from both inside
+    // and outside the enclave, is ready if either is.
+    virtual int LocalPoll(short events) { return -1; }
+
+    // For a listening socket, takes the next connection made to it from
+    // inside the enclave and returns the context of the accepted socket,
+    // created with the SOCK_NONBLOCK and SOCK_CLOEXEC bits of |flags|. Stores
+    // the peer address in |connection|. Returns nullptr if there is no such
+    // connection.
+    virtual std::unique_ptr<IOContext> AcceptLocal(
+        int flags, AcceptedConnection *connection) {
+      return nullptr;
+    }
+
    protected:
     virtual ssize_t Read(void *buf, size_t count) = 0;
 
@@ -144,6 +215,48 @@ class IOManager {
       return -1;
     }
 
+    virtual ssize_t PWritev(const struct iovec *iov, int iovcnt,
+                            off_t offset) {
+      errno = ENOSYS;
+      return -1;
+    }
+
+    virtual ssize_t PReadv(const struct iovec *iov, int iovcnt, off_t offset) {
+      errno = ENOSYS;
+      return -1;
+    }
+
+    // Maps |length| bytes of the file starting at |offset| into untrusted
+    // memory as a read-only mapping. Returns nullptr and sets errno if the
+    // file cannot be mapped.
+    virtual void *MapReadOnly(size_t length, off_t offset) {
+      errno = ENODEV;
+      return nullptr;
+    }
+
+    // Reads the next entry of the directory this context refers to into
+    // |entry|, fetching entries from the host |batch_size| bytes at a time.
+    // Returns 1 if an entry was read, 0 at the end of the directory, or -1 and
+    // sets errno.
+    virtual int ReadDirectory(size_t batch_size, DirectoryEntry *entry) {
+      errno = ENOTDIR;
+      return -1;
+    }
+
+    // Moves the directory stream to |offset|, which is either 0 or the
+    // |next_offset| of an entry returned by ReadDirectory.
+    virtual int SeekDirectory(off_t offset) {
+      errno = ENOTDIR;
+      return -1;
+    }
+
+    // Implements fstatat(2) for a |pathname| relative to this directory.
+    virtual int FStatAt(const char *pathname, struct stat *stat_buffer,
+                        int flags) {
+      errno = ENOTDIR;
+      return -1;
+    }
+
     virtual ssize_t FGetXattr(const char *name, void *value, size_t size) {
       errno = ENOSYS;
       return -1;
@@ -192,6 +305,16 @@ class IOManager {
       return -1;
     }
 
+    // Accepts up to |max_connections| connections as described for
+    // IOManager::AcceptBatch, except that the file descriptors appended to
+    // |connections| are host file descriptors.
+    virtual int AcceptBatch(int flags, const std::vector<SocketOption> &options,
+                            size_t max_connections,
+                            std::vector<AcceptedConnection> *connections) {
+      errno = ENOSYS;
+      return -1;
+    }
+
     virtual int Bind(const struct sockaddr *addr, socklen_t addrlen) {
       errno = ENOSYS;
       return -1;
@@ -222,7 +345,11 @@ class IOManager {
       return -1;
     }
 
-    virtual int EpollCtl(int op, int hostfd, struct epoll_event *event) {
+    // Registers |hostfd|, the host file descriptor of |target|, with this
+    // epoll instance. Readiness reported for |hostfd| is recorded in the
+    // readiness cache of |target| while it is alive.
+    virtual int EpollCtl(int op, int hostfd, struct epoll_event *event,
+                         const std::shared_ptr<IOContext> &target) {
       // EINVAL since file descriptors do not by default support epoll behavior.
       errno = EINVAL;
       return -1;
@@ -253,9 +380,18 @@ class IOManager {
 
     virtual int GetHostFileDescriptor() { return -1; }
 
+
+    // Returns the host file descriptor which sendfile, splice and
+    // copy_file_range may read from and write to on the host, or -1 if the
+    // host does not see the contents of this context in the clear or its file
+    // offset is kept inside the enclave.
+    virtual int GetHostTransferFileDescriptor() { return -1; }
+
    private:
     friend class IOManager;
     friend class NativePathHandler;
+
+    ReadinessCache readiness_cache_;
   };
 
   // A VirtualPathHandler maps file paths to appropriate behavior
@@ -393,25 +529,32 @@ class IOManager {
   };
 
   // A table of virtual file descriptors managed by the IOManager.
-  // This class is not thread safe. IOManager is responsible for locking the
-  // access to objects of this class.
+  //
+  // Get() may be called concurrently with any other method and does not take a
+  // lock. Every other method mutates or scans the table and is not thread
+  // safe; IOManager is responsible for serializing those calls.
   class FileDescriptorTable {
    public:
     FileDescriptorTable();
 
     // Returns the IOContext associated with a file descriptor, or nullptr if
-    // no such context exists.
+    // no such context exists. Lock free.
     std::shared_ptr<IOContext> Get(int fd);
 
     // Removes an entry from the table, destroying the associated IOContext if
     // this is the last reference to the IOContext, and returns the file
-    // descriptor to the free list. If close() is called on the host and that
-    // call fails, returns -1; otherwise, returns 0.
+    // descriptor to the free list. Waits for concurrent Get() calls which may
+    // still observe the entry. If close() is called on the host and that call
+    // fails, returns -1; otherwise, returns 0.
     int Delete(int fd);
 
     // Returns true if a specified file descriptor is available.
     bool IsFileDescriptorUnused(int fd);
 
+    // Returns the number of available file descriptors, counting no further
+    // than |max|.
+    size_t CountFreeFileDescriptors(size_t max);
+
     // Inserts an I/O context into the table, assigning it the next available
     // file descriptor value and taking ownership of the pointer. Returns the
     // newly assigned fd.
@@ -491,8 +634,21 @@ class IOManager {
     // |startfd|. Returns -1 if there is no file descriptor available.
     int GetNextFreeFileDescriptor(int startfd);
 
+    // Makes the entry of |fd| in |fd_table_| visible to Get().
+    void Publish(int fd);
+
+    // Owning references to the file descriptors in the table. Only accessed by
+    // the serialized methods.
     std::array<std::shared_ptr<AutoCloseIOContext>, kMaxOpenFiles> fd_table_;
 
+    // Unowned copies of the pointers in |fd_table_| read by Get(). An entry is
+    // cleared and |epoch_domain_| synchronized before the corresponding
+    // |fd_table_| reference is dropped.
+    std::array<std::atomic<AutoCloseIOContext *>, kMaxOpenFiles> published_;
+
+    // Protects readers of |published_| against concurrent deletion.
+    EpochDomain epoch_domain_;
+
     // The maximum file descriptor number allowed.
     int maximum_fd_soft_limit;
 
@@ -536,6 +692,26 @@ class IOManager {
   // it points to.
   virtual int LStat(const char *pathname, struct stat *stat_buffer);
 
+  // Implements fstatat(2). Attributes of the entries most recently fetched by
+  // ReadDirectory on |dirfd| are served from the enclave, as of when they were
+  // fetched, without exiting the enclave.
+  virtual int FStatAt(int dirfd, const char *pathname, struct stat *stat_buffer,
+                      int flags);
+
+  // Reads the next entry of the directory |fd| into |entry|. Returns 1 if an
+  // entry was read, 0 at the end of the directory, or -1 and sets errno.
+  virtual int ReadDirectory(int fd, DirectoryEntry *entry);
+
+  // Moves the directory stream of |fd| to |offset|, which is either 0 or the
+  // |next_offset| of an entry returned by ReadDirectory.
+  virtual int SeekDirectory(int fd, off_t offset);
+
+  // Sets the number of bytes of directory entries fetched from the host at a
+  // time by ReadDirectory. Larger batches take fewer host calls to scan a large
+  // directory but hold more entries in enclave memory. Returns false if
+  // |batch_size| is outside [kMinDirectoryBatchSize, kMaxDirectoryBatchSize].
+  bool SetDirectoryBatchSize(size_t batch_size);
+
   // Provides a canonicalized absolute pathname that resolves symbolic links.
   // Returns |resolved_path| on success, nullptr on failure.
   char *RealPath(const char *path, char *resolved_path);
@@ -553,10 +729,12 @@ class IOManager {
   virtual int Dup2(int oldfd, int newfd) ABSL_LOCKS_EXCLUDED(fd_table_lock_);
 
   // Creates a pipe with the given |flags|, which must be a bitwise-or of any
-  // combination of O_CLOEXEC, O_DIRECT, and O_NONBLOCK. The array |pipefd| is
-  // used to return two file descriptors referring to the ends of the pipe.
-  // |pipefd[0]| refers to the read end while |pipefd[1]| refers to the write
-  // end.
+  // combination of O_CLOEXEC, O_DIRECT, O_NONBLOCK and O_ENCLAVE_LOCAL. The
+  // array |pipefd| is used to return two file descriptors referring to the
+  // ends of the pipe. |pipefd[0]| refers to the read end while |pipefd[1]|
+  // refers to the write end. With O_ENCLAVE_LOCAL, the pipe is implemented
+  // inside the enclave, for pipes whose ends are only used by enclave threads;
+  // O_DIRECT is not supported then.
   virtual int Pipe(int pipefd[2], int flags);
 
   // Reads up to |count| bytes from the stream into |buf|, returning the number
@@ -651,6 +829,32 @@ class IOManager {
   // Implements pread(2).
   virtual ssize_t PRead(int fd, void *buf, size_t count, off_t offset);
 
+  // Implements pwritev(2).
+  virtual ssize_t PWritev(int fd, const struct iovec *iov, int iovcnt,
+                          off_t offset);
+
+  // Implements preadv(2).
+  virtual ssize_t PReadv(int fd, const struct iovec *iov, int iovcnt,
+                         off_t offset);
+
+  // Maps |length| bytes of |fd| starting at |offset| into untrusted memory as a
+  // private, read-only mapping, which must be released with
+  // enc_untrusted_munmap. Returns nullptr and sets errno if |fd| is not backed
+  // by a host file which the enclave may read in the clear.
+  virtual void *MapReadOnly(int fd, size_t length, off_t offset);
+
+  // Implements sendfile(2). The transfer takes place on the host, so both file
+  // descriptors must refer to contexts with a host transfer file descriptor.
+  virtual ssize_t SendFile(int out_fd, int in_fd, off_t *offset, size_t count);
+
+  // Implements splice(2), with the same restrictions as SendFile.
+  virtual ssize_t Splice(int fd_in, off_t *off_in, int fd_out, off_t *off_out,
+                         size_t len, unsigned int flags);
+
+  // Implements copy_file_range(2), with the same restrictions as SendFile.
+  virtual ssize_t CopyFileRange(int fd_in, off_t *off_in, int fd_out,
+                                off_t *off_out, size_t len, unsigned int flags);
+
   // Implements umask(2).
   virtual mode_t Umask(mode_t mask);
 
@@ -724,6 +928,25 @@ class IOManager {
   // Implements accept(2).
   virtual int Accept(int sockfd, struct sockaddr *addr, socklen_t *addrlen);
 
+  // Accepts up to |max_connections| pending connections on |sockfd| as
+  // accept4(2) with |flags| would, and sets |options| on each, with a single
+  // exit from the enclave rather than one per accept, fcntl, setsockopt and
+  // getpeername call. Connections beyond the first are only taken from a
+  // non-blocking socket, and at most kMaxAcceptBatch are taken. No more
+  // connections are taken than there are free file descriptors, so pending
+  // connections stay queued on the socket rather than being dropped when the
+  // file descriptor table is full, in which case EMFILE is returned. Appends
+  // the accepted connections to |connections| and returns their number, or
+  // returns -1 and sets errno if none was accepted.
+  virtual int AcceptBatch(int sockfd, int flags,
+                          const std::vector<SocketOption> &options,
+                          size_t max_connections,
+                          std::vector<AcceptedConnection> *connections);
+
+  // Implements accept4(2).
+  virtual int Accept4(int sockfd, struct sockaddr *addr, socklen_t *addrlen,
+                      int flags);
+
   // Implements bind(2).
   virtual int Bind(int sockfd, const struct sockaddr *addr, socklen_t addrlen);
 
@@ -744,7 +967,9 @@ class IOManager {
   virtual int GetPeerName(int sockfd, struct sockaddr *addr,
                           socklen_t *addrlen);
 
-  // Implements socket(2).
+  // Implements socket(2). A TCP socket created with SOCK_ENCLAVE_LOCAL in
+  // |type| connects to listening sockets also created with it inside the
+  // enclave.
   virtual int Socket(int domain, int type, int protocol);
 
   // Implements eventfd(2).
@@ -769,6 +994,30 @@ class IOManager {
   int RegisterHostFileDescriptor(int host_fd)
       ABSL_LOCKS_EXCLUDED(fd_table_lock_);
 
+  // Stops answering poll(2) and select(2) for the open file descriptors from
+  // what the enclave last learned about their readiness. Must be called once
+  // another process may use their host file descriptors, as after fork(2).
+  void MarkFileDescriptorsShared() ABSL_LOCKS_EXCLUDED(fd_table_lock_);
+
+  // As RegisterHostFileDescriptor, but writes to the returned file descriptor
+  // are buffered inside the enclave as specified by |options|. Buffered data is
+  // flushed by fsync(2) and close(2) as well as by OutputBuffer::FlushAll().
+  int RegisterBufferedHostFileDescriptor(int host_fd,
+                                         const OutputBufferOptions &options)
+      ABSL_LOCKS_EXCLUDED(fd_table_lock_);
+
+  // Logs |length| bytes of |message| with |priority| on the host. Messages are
+  // buffered as set by SetSyslogBuffering, and are logged one by one by
+  // default.
+  void Syslog(int priority, const char *message, size_t length)
+      ABSL_LOCKS_EXCLUDED(syslog_lock_);
+
+  // Sets the buffering of messages passed to Syslog. Every message counts as a
+  // line for FlushPolicy::kLine. Messages buffered under the previous options
+  // are flushed first.
+  void SetSyslogBuffering(const OutputBufferOptions &options)
+      ABSL_LOCKS_EXCLUDED(syslog_lock_);
+
   // Registers the handler responsible for a given path prefix.
   // When processing a path, the handler with the longest prefix shared with the
   // path will be chosen.  Prefixes are considered shared only on whole
@@ -786,7 +1035,7 @@ class IOManager {
   std::string GetCurrentWorkingDirectory() const;
 
  protected:
-  IOManager() = default;
+  IOManager();
 
  private:
   IOManager(IOManager const &) = delete;
@@ -797,6 +1046,12 @@ class IOManager {
   // relative paths and path normalization.
   StatusOr<std::string> CanonicalizePath(absl::string_view path) const;
 
+  // As RegisterHostFileDescriptor, for a host file descriptor the enclave just
+  // created, which no other process uses until the enclave forks. Poll and
+  // select may then be answered from its readiness cache.
+  int RegisterExclusiveHostFileDescriptor(int host_fd)
+      ABSL_LOCKS_EXCLUDED(fd_table_lock_);
+
   // Closes a file descriptor by removing it from |fd_table_|, and closing the
   // corresponding host file descriptor if this is the last reference to it.
   // This method does not obtain a locker. Caller of this method is responsible
@@ -807,12 +1062,79 @@ class IOManager {
   // nullptr if no entry is found.
   VirtualPathHandler *HandlerForPath(absl::string_view path) const;
 
-  // Locks the mutex corresponding to |fd| and performs thread safe action.
+  // A path resolved to its canonical form and the handler responsible for it,
+  // which is nullptr if no handler is registered for the canonical path.
+  struct ResolvedPath {
+    std::string canonical_path;
+    VirtualPathHandler *handler;
+  };
+
+  // Resolves |path| through |resolution_cache_|, canonicalizing it on a miss.
+  // Returns an error if |path| cannot be canonicalized.
+  StatusOr<std::shared_ptr<const ResolvedPath>> ResolvePath(
+      absl::string_view path) ABSL_LOCKS_EXCLUDED(resolution_cache_lock_);
+
+  // Drops every cached path resolution. Must be called whenever the working
+  // directory or the set of registered handlers changes.
+  void InvalidateResolutionCache() ABSL_LOCKS_EXCLUDED(resolution_cache_lock_);
+
+  // Looks up the context of |fd| without taking |fd_table_lock_| and performs
+  // thread safe action.
   template <typename IOAction, typename ReturnType = typename std::result_of<
                                    IOAction(std::shared_ptr<IOContext>)>::type>
   ReturnType CallWithContext(int fd, IOAction action)
       ABSL_LOCKS_EXCLUDED(fd_table_lock_);
 
+  // Like CallWithContext, but forgets the |events| readiness of the context
+  // once |action| returns, for actions which may consume it.
+  template <typename IOAction, typename ReturnType = typename std::result_of<
+                                   IOAction(std::shared_ptr<IOContext>)>::type>
+  ReturnType CallWithContextConsuming(int fd, short events, IOAction action)
+      ABSL_LOCKS_EXCLUDED(fd_table_lock_);
+
+  // Answers a poll of |fds| from the readiness caches of their contexts if
+  // every requested event is known to be ready. Returns false if the host must
+  // be asked instead.
+  bool PollFromReadinessCache(struct pollfd *fds, nfds_t nfds, int *result);
+
+  // Answers a select of |readfds| and |writefds| from the readiness caches of
+  // their contexts if every requested descriptor is known to be ready and no
+  // exceptional conditions are requested. Returns false if the host must be
+  // asked instead.
+  bool SelectFromReadinessCache(int nfds, const fd_set *readfds,
+                                const fd_set *writefds,
+                                const fd_set *exceptfds, int *result);
+
+  // Accepts up to |max_connections| connections made to the listening socket
+  // |sockfd| with context |context| from inside the enclave, as AcceptBatch
+  // does. If there is none and the socket is blocking, first waits for a
+  // connection from inside or outside the enclave. Returns 0 if connections
+  // are to be accepted on the host instead.
+  int AcceptLocalConnections(int sockfd,
+                             const std::shared_ptr<IOContext> &context,
+                             int flags,
+                             const std::vector<SocketOption> &options,
+                             size_t max_connections,
+                             std::vector<AcceptedConnection> *connections)
+      ABSL_LOCKS_EXCLUDED(fd_table_lock_);
+
+  // Implements Poll when some of |contexts|, the contexts of |fds|, are local
+  // streams. Waits without exiting the enclave if all of them are.
+  int PollWithLocalStreams(
+      struct pollfd *fds, nfds_t nfds, int timeout,
+      const std::vector<std::shared_ptr<IOContext>> &contexts);
+
+  // Implements Select through Poll, for sets including local streams.
+  int SelectByPoll(int nfds, fd_set *readfds, fd_set *writefds,
+                   fd_set *exceptfds, struct timeval *timeout);
+
+  // Looks up the contexts of |in_fd| and |out_fd| and calls |action| with their
+  // host transfer file descriptors. Fails with EINVAL if either context does
+  // not have one.
+  template <typename IOAction>
+  ssize_t CallWithHostTransfer(int in_fd, int out_fd, IOAction action)
+      ABSL_LOCKS_EXCLUDED(fd_table_lock_);
+
   // Looks up the appropriate VirtualPathHandler and calls the given function on
   // it.  Errors related to path resolution and handler lookups are handled.
   // This is the single path variant.
@@ -831,8 +1153,24 @@ class IOManager {
   ReturnType CallWithHandler(const char *path1, const char *path2,
                              IOAction action);
 
-  // A map from path prefix to VirtualPathHandler.
-  std::map<std::string, std::unique_ptr<VirtualPathHandler>> prefix_to_handler_;
+  // The largest number of path resolutions cached at a time.
+  static constexpr size_t kMaxResolutionCacheSize = 4096;
+
+  // A trie from path prefix to VirtualPathHandler.
+  util::PathTrie<std::unique_ptr<VirtualPathHandler>> prefix_to_handler_;
+
+  absl::Mutex resolution_cache_lock_;
+
+  // Path resolutions keyed by the path passed in by the caller. Resolution is
+  // purely lexical, so an entry stays valid until the working directory or the
+  // registered handlers change. Entries are shared so that they outlive their
+  // eviction for callers still using them.
+  absl::flat_hash_map<std::string, std::shared_ptr<const ResolvedPath>>
+      resolution_cache_ ABSL_GUARDED_BY(resolution_cache_lock_);
+
+  // Incremented by every InvalidateResolutionCache(), so that resolutions
+  // computed across an invalidation are not cached.
+  uint64_t resolution_generation_ ABSL_GUARDED_BY(resolution_cache_lock_) = 0;
 
   FileDescriptorTable fd_table_;
 
@@ -840,6 +1178,21 @@ class IOManager {
   absl::Mutex fd_table_lock_;
 
   std::string current_working_directory_;
+
+  std::atomic<size_t> directory_batch_size_{kDefaultDirectoryBatchSize};
+
+  absl::Mutex syslog_lock_;
+
+  // Buffer of messages passed to Syslog, or nullptr if they are not buffered.
+  std::unique_ptr<OutputBuffer> syslog_buffer_ ABSL_GUARDED_BY(syslog_lock_);
+
+  // Wakes the threads waiting for local streams, such as eventfds and
+  // enclave-local pipes.
+  LocalWaitQueue local_wait_queue_;
+
+  // The listening TCP sockets which sockets of the enclave connecting to a
+  // loopback address reach without going through the host.
+  LoopbackRegistry loopback_registry_;
 };
 
 }  // namespace io
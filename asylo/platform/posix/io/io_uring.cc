@@ -0,0 +1,456 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/io/io_uring.h"
+
+#include <errno.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "asylo/platform/common/io_uring_layout.h"
+#include "asylo/platform/host_call/trusted/host_calls.h"
+#include "asylo/platform/primitives/trusted_primitives.h"
+#include "asylo/platform/system_call/type_conversions/kernel_types.h"
+#include "asylo/platform/system_call/type_conversions/types_functions.h"
+
+namespace asylo {
+namespace io {
+namespace {
+
+using primitives::TrustedPrimitives;
+
+// Largest ring and buffer sizes accepted from the host. The ring limits are
+// those of the kernel.
+constexpr uint32_t kMaxSqEntries = 32768;
+constexpr uint32_t kMaxCqEntries = 2 * kMaxSqEntries;
+constexpr uint32_t kMaxBufferSize = 1 << 24;
+
+// Number of times a waiting thread checks the completion queue before it
+// sleeps in the kernel.
+constexpr int kChecksBeforeSleep = 64;
+
+// Size of the socket address area at the start of the buffer of an accept,
+// which is followed by the address length.
+constexpr size_t kAcceptAddressSize = 128;
+
+// States of a slot.
+constexpr uint32_t kSlotFree = 0;
+constexpr uint32_t kSlotInFlight = 1;
+constexpr uint32_t kSlotDone = 2;
+
+// An operation in flight. Slot i submits through submission queue entry i and
+// transfers data through bounce buffer i. Completions carry the index of the
+// slot in their low 32 bits and its generation in their high 32 bits, so that
+// a completion the kernel did not post for the current operation of the slot
+// is caught.
+struct Slot {
+  std::atomic<uint32_t> state{kSlotFree};
+  std::atomic<uint32_t> generation{0};
+
+  // Largest result the operation may complete with, written before the slot
+  // goes in flight.
+  uint32_t max_result = 0;
+
+  // Result of the operation, written before the slot is done.
+  int32_t result = 0;
+};
+
+class IoUring {
+ public:
+  explicit IoUring(const IoUringLayout &layout)
+      : layout_(layout),
+        slots_(new Slot[layout.buffer_count]),
+        sq_tail_(__atomic_load_n(layout.sq_tail, __ATOMIC_ACQUIRE)),
+        cq_head_(__atomic_load_n(layout.cq_head, __ATOMIC_ACQUIRE)) {
+    free_slots_.reserve(layout_.buffer_count);
+    for (uint32_t slot = layout_.buffer_count; slot > 0; --slot) {
+      free_slots_.push_back(slot - 1);
+    }
+  }
+
+  uint32_t buffer_size() const { return layout_.buffer_size; }
+
+  uint8_t *Buffer(uint32_t slot) const {
+    return layout_.buffers + static_cast<size_t>(slot) * layout_.buffer_size;
+  }
+
+  // Claims a free slot into |*slot|. Returns false if all slots are taken.
+  bool Claim(uint32_t *slot) {
+    absl::MutexLock lock(&sq_mutex_);
+    if (free_slots_.empty()) {
+      return false;
+    }
+    *slot = free_slots_.back();
+    free_slots_.pop_back();
+    return true;
+  }
+
+  // Returns |slot| to the free slots.
+  void Release(uint32_t slot) {
+    slots_[slot].state.store(kSlotFree, std::memory_order_relaxed);
+    absl::MutexLock lock(&sq_mutex_);
+    free_slots_.push_back(slot);
+  }
+
+  // Submits |sqe| through the claimed |slot| and waits for its completion.
+  // Returns the result of the operation, which the kernel is not trusted to
+  // have kept below |max_result|.
+  int32_t Run(uint32_t slot, IoUringSqe sqe, uint32_t max_result) {
+    Slot &state = slots_[slot];
+    uint32_t generation =
+        state.generation.load(std::memory_order_relaxed) + 1;
+    state.max_result = max_result;
+    state.generation.store(generation, std::memory_order_relaxed);
+    state.state.store(kSlotInFlight, std::memory_order_release);
+    sqe.user_data = (static_cast<uint64_t>(generation) << 32) | slot;
+    Submit(slot, sqe);
+    return Wait(slot);
+  }
+
+ private:
+  void Submit(uint32_t slot, const IoUringSqe &sqe) {
+    {
+      absl::MutexLock lock(&sq_mutex_);
+      // At most |buffer_count| operations are in flight, so the kernel has
+      // consumed the entries last published at both indices.
+      memcpy(&layout_.sqes[slot], &sqe, sizeof(sqe));
+      __atomic_store_n(&layout_.sq_array[sq_tail_ & (layout_.sq_entries - 1)],
+                       slot, __ATOMIC_RELAXED);
+      ++sq_tail_;
+      __atomic_store_n(layout_.sq_tail, sq_tail_, __ATOMIC_RELEASE);
+    }
+    if (!layout_.sq_polled) {
+      // The kernel submits no more entries than are pending.
+      Enter(layout_.sq_entries, 0, 0);
+      return;
+    }
+    // The polling thread sets the flag before it checks the queue a last time
+    // and sleeps, so reading the flag after publishing the entry cannot miss a
+    // sleeping thread.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (__atomic_load_n(layout_.sq_flags, __ATOMIC_RELAXED) &
+        kIoUringSqNeedWakeup) {
+      Enter(0, 0, kIoUringEnterSqWakeup);
+    }
+  }
+
+  static bool IsDone(const Slot &slot) {
+    return slot.state.load(std::memory_order_acquire) == kSlotDone;
+  }
+
+  // A waiter that finds another thread sleeping in the kernel.
+  struct Sleeper {
+    const IoUring *ring;
+    const Slot *slot;
+  };
+
+  static bool SlotDoneOrAwake(Sleeper *sleeper)
+      ABSL_NO_THREAD_SAFETY_ANALYSIS {
+    return IsDone(*sleeper->slot) || !sleeper->ring->sleeping_;
+  }
+
+  int32_t Wait(uint32_t slot) {
+    const Slot &state = slots_[slot];
+    absl::MutexLock lock(&cq_mutex_);
+    for (int checks = 0; !IsDone(state); ++checks) {
+      if (sleeping_) {
+        // The sleeping thread wakes up on the next completion. Reaping now
+        // could take that completion from under it, so let it reap instead.
+        Sleeper sleeper = {this, &state};
+        cq_mutex_.Await(absl::Condition(&SlotDoneOrAwake, &sleeper));
+        continue;
+      }
+      ReapLocked();
+      if (IsDone(state)) {
+        break;
+      }
+      if (checks < kChecksBeforeSleep) {
+        cq_mutex_.Unlock();
+        cq_mutex_.Lock();
+        continue;
+      }
+      sleeping_ = true;
+      cq_mutex_.Unlock();
+      // Callers only submit operations which cannot block indefinitely, so a
+      // sleep interrupted by a signal is simply resumed.
+      Enter(0, 1, kIoUringEnterGetEvents);
+      cq_mutex_.Lock();
+      sleeping_ = false;
+    }
+    return state.result;
+  }
+
+  void ReapLocked() ABSL_EXCLUSIVE_LOCKS_REQUIRED(cq_mutex_) {
+    uint32_t tail = __atomic_load_n(layout_.cq_tail, __ATOMIC_ACQUIRE);
+    if (tail - cq_head_ > layout_.cq_entries) {
+      TrustedPrimitives::BestEffortAbort(
+          "io_uring completion queue tail is out of range");
+    }
+    if (tail == cq_head_) {
+      return;
+    }
+    while (cq_head_ != tail) {
+      IoUringCqe cqe;
+      memcpy(&cqe, &layout_.cqes[cq_head_ & (layout_.cq_entries - 1)],
+             sizeof(cqe));
+      ++cq_head_;
+      Complete(cqe);
+    }
+    __atomic_store_n(layout_.cq_head, cq_head_, __ATOMIC_RELEASE);
+  }
+
+  void Complete(const IoUringCqe &cqe) {
+    uint32_t slot = static_cast<uint32_t>(cqe.user_data);
+    uint32_t generation = static_cast<uint32_t>(cqe.user_data >> 32);
+    if (slot >= layout_.buffer_count) {
+      TrustedPrimitives::BestEffortAbort(
+          "io_uring completion for an unknown operation");
+    }
+    Slot &state = slots_[slot];
+    if (state.state.load(std::memory_order_acquire) != kSlotInFlight ||
+        state.generation.load(std::memory_order_relaxed) != generation) {
+      TrustedPrimitives::BestEffortAbort(
+          "io_uring completion for an operation not in flight");
+    }
+    if (cqe.res > 0 && static_cast<uint32_t>(cqe.res) > state.max_result) {
+      TrustedPrimitives::BestEffortAbort(
+          "io_uring result exceeds the requested length");
+    }
+    state.result = cqe.res;
+    state.state.store(kSlotDone, std::memory_order_release);
+  }
+
+  void Enter(uint32_t to_submit, uint32_t min_complete, uint32_t flags) {
+    if (enc_untrusted_io_uring_enter(layout_.ring_fd, to_submit, min_complete,
+                                     flags) == -1 &&
+        errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+      // Submitted operations may never complete, and their slots cannot be
+      // reused while the kernel may still write to their buffers.
+      TrustedPrimitives::BestEffortAbort("io_uring_enter failed");
+    }
+  }
+
+  // Trusted copy of the layout, so the ring addresses validated once cannot
+  // change afterwards.
+  const IoUringLayout layout_;
+  const std::unique_ptr<Slot[]> slots_;
+
+  absl::Mutex sq_mutex_;
+  uint32_t sq_tail_ ABSL_GUARDED_BY(sq_mutex_);
+  std::vector<uint32_t> free_slots_ ABSL_GUARDED_BY(sq_mutex_);
+
+  absl::Mutex cq_mutex_;
+  uint32_t cq_head_ ABSL_GUARDED_BY(cq_mutex_);
+
+  // Whether a thread sleeps in the kernel until the next completion. No other
+  // thread reaps completions meanwhile.
+  bool sleeping_ ABSL_GUARDED_BY(cq_mutex_) = false;
+};
+
+IoUring *volatile io_uring = nullptr;
+
+IoUring *GetIoUring() { return __atomic_load_n(&io_uring, __ATOMIC_ACQUIRE); }
+
+bool IsPowerOfTwo(uint32_t value) {
+  return value != 0 && (value & (value - 1)) == 0;
+}
+
+// Returns true if |count| objects of type T at |address| lie entirely outside
+// the enclave and are properly aligned.
+template <typename T>
+bool IsUntrustedArray(const T *address, uint64_t count) {
+  return address &&
+         reinterpret_cast<uintptr_t>(address) % alignof(T) == 0 &&
+         TrustedPrimitives::IsOutsideEnclave(address, count * sizeof(T));
+}
+
+bool IsValidLayout(const IoUringLayout &layout) {
+  return IsPowerOfTwo(layout.sq_entries) &&
+         layout.sq_entries <= kMaxSqEntries &&
+         IsPowerOfTwo(layout.cq_entries) &&
+         layout.cq_entries <= kMaxCqEntries && layout.buffer_count != 0 &&
+         layout.buffer_count <= layout.sq_entries &&
+         layout.buffer_count <= layout.cq_entries && layout.buffer_size != 0 &&
+         layout.buffer_size <= kMaxBufferSize &&
+         IsUntrustedArray(layout.sq_head, 1) &&
+         IsUntrustedArray(layout.sq_tail, 1) &&
+         IsUntrustedArray(layout.sq_flags, 1) &&
+         IsUntrustedArray(layout.sq_array, layout.sq_entries) &&
+         IsUntrustedArray(layout.cq_head, 1) &&
+         IsUntrustedArray(layout.cq_tail, 1) &&
+         IsUntrustedArray(layout.cqes, layout.cq_entries) &&
+         IsUntrustedArray(layout.sqes, layout.sq_entries) &&
+         IsUntrustedArray(layout.buffers, static_cast<uint64_t>(
+                                              layout.buffer_count) *
+                                              layout.buffer_size);
+}
+
+// Converts the result of an operation to the return value of the system call,
+// setting errno on failure.
+int32_t ToSystemCallResult(int32_t res) {
+  if (res < 0) {
+    errno = FromkLinuxErrorNumber(-res);
+    return -1;
+  }
+  return res;
+}
+
+// Runs the transfer of |sqe| of up to |count| bytes to or from the buffer of
+// a slot, copying |in| into the buffer before and the result bytes from the
+// buffer into |out| after. Returns false if the transfer cannot be served.
+bool Transfer(IoUringSqe sqe, const void *in, void *out, size_t count,
+              ssize_t *result) {
+  IoUring *ring = GetIoUring();
+  uint32_t slot;
+  if (!ring || count > ring->buffer_size() || !ring->Claim(&slot)) {
+    return false;
+  }
+  uint8_t *buffer = ring->Buffer(slot);
+  if (in) {
+    TrustedPrimitives::UntrustedLocalMemcpy(buffer, in, count);
+  }
+  sqe.addr = reinterpret_cast<uint64_t>(buffer);
+  sqe.len = static_cast<uint32_t>(count);
+  int32_t res = ring->Run(slot, sqe, sqe.len);
+  if (out && res > 0) {
+    TrustedPrimitives::UntrustedLocalMemcpy(out, buffer, res);
+  }
+  ring->Release(slot);
+  *result = ToSystemCallResult(res);
+  return true;
+}
+
+}  // namespace
+
+primitives::PrimitiveStatus EnableIoUring(void *untrusted_layout) {
+  if (!untrusted_layout ||
+      !TrustedPrimitives::IsOutsideEnclave(untrusted_layout,
+                                           sizeof(IoUringLayout))) {
+    return {error::GoogleError::INVALID_ARGUMENT,
+            "io_uring layout must lie in untrusted memory."};
+  }
+  IoUringLayout layout;
+  memcpy(&layout, untrusted_layout, sizeof(layout));
+  if (layout.magic != kIoUringLayoutMagic) {
+    return {error::GoogleError::INVALID_ARGUMENT,
+            "io_uring layout is not initialized."};
+  }
+  if (!IsValidLayout(layout)) {
+    return {error::GoogleError::INVALID_ARGUMENT,
+            "io_uring layout is malformed."};
+  }
+  if (GetIoUring()) {
+    return {error::GoogleError::ALREADY_EXISTS,
+            "An io_uring instance is already in use."};
+  }
+  __atomic_store_n(&io_uring, new IoUring(layout), __ATOMIC_RELEASE);
+  return primitives::PrimitiveStatus::OkStatus();
+}
+
+bool IoUringInUse() { return GetIoUring() != nullptr; }
+
+bool IoUringRead(int fd, void *buf, size_t count, ssize_t *result) {
+  IoUringSqe sqe = {};
+  sqe.opcode = kIoUringOpRead;
+  sqe.fd = fd;
+  // Read at the current file position.
+  sqe.off = static_cast<uint64_t>(-1);
+  return Transfer(sqe, nullptr, buf, count, result);
+}
+
+bool IoUringWrite(int fd, const void *buf, size_t count, ssize_t *result) {
+  IoUringSqe sqe = {};
+  sqe.opcode = kIoUringOpWrite;
+  sqe.fd = fd;
+  sqe.off = static_cast<uint64_t>(-1);
+  return Transfer(sqe, buf, nullptr, count, result);
+}
+
+bool IoUringSend(int fd, const void *buf, size_t len, int flags,
+                 ssize_t *result) {
+  int klinux_flags = TokLinuxRecvSendFlag(flags);
+  if (klinux_flags == 0 && flags != 0) {
+    return false;
+  }
+  IoUringSqe sqe = {};
+  sqe.opcode = kIoUringOpSend;
+  sqe.fd = fd;
+  sqe.op_flags = static_cast<uint32_t>(klinux_flags);
+  return Transfer(sqe, buf, nullptr, len, result);
+}
+
+bool IoUringRecv(int fd, void *buf, size_t len, int flags, ssize_t *result) {
+  int klinux_flags = TokLinuxRecvSendFlag(flags);
+  if (klinux_flags == 0 && flags != 0) {
+    return false;
+  }
+  IoUringSqe sqe = {};
+  sqe.opcode = kIoUringOpRecv;
+  sqe.fd = fd;
+  sqe.op_flags = static_cast<uint32_t>(klinux_flags);
+  return Transfer(sqe, nullptr, buf, len, result);
+}
+
+bool IoUringAccept(int fd, struct sockaddr *addr, socklen_t *addrlen,
+                   int *result) {
+  IoUring *ring = GetIoUring();
+  uint32_t slot;
+  if (!ring ||
+      ring->buffer_size() < kAcceptAddressSize + sizeof(uint32_t) ||
+      !ring->Claim(&slot)) {
+    return false;
+  }
+  uint8_t *buffer = ring->Buffer(slot);
+  bool want_address = addr != nullptr && addrlen != nullptr;
+  IoUringSqe sqe = {};
+  sqe.opcode = kIoUringOpAccept;
+  sqe.fd = fd;
+  if (want_address) {
+    uint32_t klinux_addrlen = kAcceptAddressSize;
+    memcpy(buffer + kAcceptAddressSize, &klinux_addrlen,
+           sizeof(klinux_addrlen));
+    sqe.addr = reinterpret_cast<uint64_t>(buffer);
+    sqe.off = reinterpret_cast<uint64_t>(buffer + kAcceptAddressSize);
+  }
+  int32_t res = ring->Run(slot, sqe, INT32_MAX);
+  if (res >= 0 && want_address) {
+    alignas(8) uint8_t klinux_addr[kAcceptAddressSize];
+    uint32_t klinux_addrlen;
+    memcpy(klinux_addr, buffer, sizeof(klinux_addr));
+    memcpy(&klinux_addrlen, buffer + kAcceptAddressSize,
+           sizeof(klinux_addrlen));
+    if (klinux_addrlen > kAcceptAddressSize) {
+      klinux_addrlen = kAcceptAddressSize;
+    }
+    FromkLinuxSockAddr(reinterpret_cast<struct klinux_sockaddr *>(klinux_addr),
+                       klinux_addrlen, addr, addrlen,
+                       TrustedPrimitives::BestEffortAbort);
+  }
+  ring->Release(slot);
+  *result = ToSystemCallResult(res);
+  return true;
+}
+
+}  // namespace io
+}  // namespace asylo
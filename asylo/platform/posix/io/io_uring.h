@@ -0,0 +1,64 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_POSIX_IO_IO_URING_H_
+#define ASYLO_PLATFORM_POSIX_IO_IO_URING_H_
+
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#include <cstddef>
+
+#include "asylo/platform/primitives/primitive_status.h"
+
+namespace asylo {
+namespace io {
+
+// Starts serving reads, writes and socket I/O on host file descriptors through
+// the host io_uring instance described by the IoUringLayout at
+// |untrusted_layout|. The layout is copied into the enclave and every ring and
+// buffer it names is validated to lie entirely outside the enclave. Returns an
+// error if the layout is malformed or if an instance is already in use.
+primitives::PrimitiveStatus EnableIoUring(void *untrusted_layout);
+
+// Returns true if an io_uring instance is in use.
+bool IoUringInUse();
+
+// Each of the following performs the named operation on the host file
+// descriptor |fd| through the io_uring instance and stores in |*result| what
+// the corresponding system call would return, setting errno on failure.
+// Returns false without doing anything if the operation cannot be served
+// through the instance, because none is in use, all its buffers are taken or
+// the transfer does not fit in a buffer, in which case the caller must fall
+// back to a host call.
+//
+// Waiting for the completion of an operation is not interrupted by signals, so
+// callers must only pass operations which cannot block indefinitely, e.g.
+// those on regular files or non-blocking descriptors.
+bool IoUringRead(int fd, void *buf, size_t count, ssize_t *result);
+bool IoUringWrite(int fd, const void *buf, size_t count, ssize_t *result);
+bool IoUringSend(int fd, const void *buf, size_t len, int flags,
+                 ssize_t *result);
+bool IoUringRecv(int fd, void *buf, size_t len, int flags, ssize_t *result);
+bool IoUringAccept(int fd, struct sockaddr *addr, socklen_t *addrlen,
+                   int *result);
+
+}  // namespace io
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_POSIX_IO_IO_URING_H_
@@ -0,0 +1,101 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/io/local_wait_queue.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+namespace asylo {
+namespace io {
+
+LocalWaitQueue::LocalWaitQueue(std::unique_ptr<HostWakeup> host_wakeup)
+    : host_wakeup_(std::move(host_wakeup)) {}
+
+absl::Time LocalWaitQueue::Deadline(int timeout) {
+  return timeout < 0 ? absl::InfiniteFuture()
+                     : absl::Now() + absl::Milliseconds(timeout);
+}
+
+int LocalWaitQueue::RemainingTimeout(absl::Time deadline) {
+  if (deadline == absl::InfiniteFuture()) {
+    return -1;
+  }
+  absl::Duration remaining = deadline - absl::Now();
+  if (remaining <= absl::ZeroDuration()) {
+    return 0;
+  }
+  return std::min<int64_t>(
+      absl::ToInt64Milliseconds(absl::Ceil(remaining, absl::Milliseconds(1))),
+      std::numeric_limits<int>::max());
+}
+
+uint64_t LocalWaitQueue::Generation() {
+  absl::MutexLock lock(&mu_);
+  return generation_;
+}
+
+void LocalWaitQueue::Notify() {
+  absl::MutexLock lock(&mu_);
+  ++generation_;
+  if (!host_waiters_.empty() && !host_woken_) {
+    host_wakeup_->Wake();
+    host_woken_ = true;
+  }
+}
+
+bool LocalWaitQueue::Wait(uint64_t generation, absl::Time deadline) {
+  absl::MutexLock lock(&mu_);
+  auto changed = [this, generation]() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    return generation_ != generation;
+  };
+  return mu_.AwaitWithDeadline(absl::Condition(&changed), deadline);
+}
+
+int LocalWaitQueue::BeginHostWait(uint64_t *generation) {
+  int fd = host_wakeup_->fd();
+  if (fd < 0) {
+    return -1;
+  }
+  absl::MutexLock lock(&mu_);
+  host_waiters_.insert(generation_);
+  *generation = generation_;
+  return fd;
+}
+
+void LocalWaitQueue::EndHostWait(uint64_t generation) {
+  absl::MutexLock lock(&mu_);
+  host_waiters_.erase(host_waiters_.find(generation));
+  if (!host_woken_) {
+    return;
+  }
+  // Keep the host file descriptor readable only for the remaining threads
+  // which have not seen the latest change yet, so that threads which already
+  // did do not spin on it.
+  host_wakeup_->Drain();
+  host_woken_ = false;
+  if (!host_waiters_.empty() && *host_waiters_.begin() != generation_) {
+    host_wakeup_->Wake();
+    host_woken_ = true;
+  }
+}
+
+}  // namespace io
+}  // namespace asylo
@@ -0,0 +1,117 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_POSIX_IO_LOCAL_WAIT_QUEUE_H_
+#define ASYLO_PLATFORM_POSIX_IO_LOCAL_WAIT_QUEUE_H_
+
+#include <cstdint>
+#include <memory>
+#include <set>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+
+namespace asylo {
+namespace io {
+
+// Wakes the threads waiting for the state of enclave-local streams to change,
+// such as pipes whose ends both stay inside the enclave. Local streams call
+// Notify() whenever they may have become readable or writable, and waiting
+// threads recheck the streams they are interested in.
+//
+// A thread which also waits for host file descriptors cannot block here.
+// Instead it brackets its host call with BeginHostWait() and EndHostWait(),
+// and includes the host file descriptor returned by BeginHostWait() in the
+// host call. That file descriptor is readable while any such thread has
+// missed a change, so that its host call returns. No host call is made while
+// no thread waits on the host, so signalling between enclave threads costs no
+// enclave exits.
+//
+// This class is thread safe.
+class LocalWaitQueue {
+ public:
+  // The host file descriptor through which threads waiting on the host are
+  // woken.
+  class HostWakeup {
+   public:
+    virtual ~HostWakeup() = default;
+
+    // Returns the host file descriptor, creating it on first use, or returns
+    // -1 and sets errno if it cannot be created.
+    virtual int fd() = 0;
+
+    // Makes the host file descriptor readable.
+    virtual void Wake() = 0;
+
+    // Makes the host file descriptor no longer readable.
+    virtual void Drain() = 0;
+  };
+
+  // Creates a queue which wakes the threads waiting on the host through
+  // |host_wakeup|.
+  explicit LocalWaitQueue(std::unique_ptr<HostWakeup> host_wakeup);
+
+  LocalWaitQueue(const LocalWaitQueue &other) = delete;
+  LocalWaitQueue &operator=(const LocalWaitQueue &other) = delete;
+
+  // Returns the deadline of a wait with a poll(2) |timeout| in milliseconds,
+  // which is infinite if negative.
+  static absl::Time Deadline(int timeout);
+
+  // Returns the poll(2) timeout in milliseconds left until |deadline|.
+  static int RemainingTimeout(absl::Time deadline);
+
+  // Returns a token identifying the current state of the local streams, to be
+  // taken before checking them.
+  uint64_t Generation() ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Wakes the threads waiting for a change.
+  void Notify() ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Waits until a change after |generation| or until |deadline|. Returns false
+  // if the deadline passed first.
+  bool Wait(uint64_t generation, absl::Time deadline) ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Registers the calling thread as waiting on the host from the current
+  // generation on, which is stored in |*generation|. Returns the host file
+  // descriptor to wait for, or -1 and sets errno if it cannot be created, in
+  // which case the thread is not registered.
+  int BeginHostWait(uint64_t *generation) ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Unregisters a thread registered by BeginHostWait() at |generation|.
+  void EndHostWait(uint64_t generation) ABSL_LOCKS_EXCLUDED(mu_);
+
+ private:
+  const std::unique_ptr<HostWakeup> host_wakeup_;
+
+  absl::Mutex mu_;
+  uint64_t generation_ ABSL_GUARDED_BY(mu_) = 0;
+
+  // The generations at which the threads waiting on the host registered.
+  std::multiset<uint64_t> host_waiters_ ABSL_GUARDED_BY(mu_);
+
+  // Whether the host file descriptor is readable. It is whenever a thread in
+  // |host_waiters_| registered before the current generation.
+  bool host_woken_ ABSL_GUARDED_BY(mu_) = false;
+};
+
+}  // namespace io
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_POSIX_IO_LOCAL_WAIT_QUEUE_H_
@@ -0,0 +1,253 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/io/loopback_listener.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <utility>
+
+#include "asylo/platform/posix/io/io_context_local_socket.h"
+
+namespace asylo {
+namespace io {
+namespace {
+
+// An IPv4 or IPv6 socket address, with IPv4 addresses mapped to IPv6 treated
+// as IPv4 addresses.
+struct Endpoint {
+  sa_family_t family;
+  struct in_addr ipv4;
+  struct in6_addr ipv6;
+  uint16_t port;
+};
+
+// Parses |addr| into |endpoint|. Returns false if it is not a valid IPv4 or
+// IPv6 socket address.
+bool ParseEndpoint(const struct sockaddr *addr, socklen_t addrlen,
+                   Endpoint *endpoint) {
+  if (!addr || addrlen < sizeof(sa_family_t)) {
+    return false;
+  }
+  if (addr->sa_family == AF_INET) {
+    if (addrlen < sizeof(struct sockaddr_in)) {
+      return false;
+    }
+    struct sockaddr_in in;
+    memcpy(&in, addr, sizeof(in));
+    endpoint->family = AF_INET;
+    endpoint->ipv4 = in.sin_addr;
+    endpoint->port = ntohs(in.sin_port);
+    return true;
+  }
+  if (addr->sa_family == AF_INET6) {
+    if (addrlen < sizeof(struct sockaddr_in6)) {
+      return false;
+    }
+    struct sockaddr_in6 in6;
+    memcpy(&in6, addr, sizeof(in6));
+    endpoint->port = ntohs(in6.sin6_port);
+    if (IN6_IS_ADDR_V4MAPPED(&in6.sin6_addr)) {
+      endpoint->family = AF_INET;
+      memcpy(&endpoint->ipv4, &in6.sin6_addr.s6_addr[12],
+             sizeof(endpoint->ipv4));
+    } else {
+      endpoint->family = AF_INET6;
+      endpoint->ipv6 = in6.sin6_addr;
+    }
+    return true;
+  }
+  return false;
+}
+
+bool IsLoopback(const Endpoint &endpoint) {
+  if (endpoint.family == AF_INET) {
+    return (ntohl(endpoint.ipv4.s_addr) >> 24) == 127;
+  }
+  return IN6_IS_ADDR_LOOPBACK(&endpoint.ipv6);
+}
+
+bool IsWildcard(const Endpoint &endpoint) {
+  if (endpoint.family == AF_INET) {
+    return endpoint.ipv4.s_addr == htonl(INADDR_ANY);
+  }
+  return IN6_IS_ADDR_UNSPECIFIED(&endpoint.ipv6);
+}
+
+// Returns the length of the accept queue of a socket listening with
+// |backlog|, as on Linux.
+size_t QueueLength(int backlog) {
+  return std::min(std::max(backlog, 0), SOMAXCONN) + 1;
+}
+
+}  // namespace
+
+bool IsLoopbackAddress(const struct sockaddr *addr, socklen_t addrlen) {
+  Endpoint endpoint;
+  return ParseEndpoint(addr, addrlen, &endpoint) && IsLoopback(endpoint);
+}
+
+LoopbackListener::LoopbackListener(const SocketAddress &address, bool v6_only,
+                                   int backlog, LocalWaitQueue *wait_queue)
+    : address_(address),
+      v6_only_(v6_only),
+      wait_queue_(wait_queue),
+      backlog_(QueueLength(backlog)),
+      pending_(QueueLength(SOMAXCONN)) {}
+
+LoopbackListener::~LoopbackListener() = default;
+
+bool LoopbackListener::ReachableFromLoopback() const {
+  Endpoint endpoint;
+  return ParseEndpoint(reinterpret_cast<const struct sockaddr *>(
+                           &address_.addr),
+                       address_.addrlen, &endpoint) &&
+         (IsLoopback(endpoint) || IsWildcard(endpoint));
+}
+
+bool LoopbackListener::Accepts(const struct sockaddr *addr,
+                               socklen_t addrlen) const {
+  Endpoint target;
+  Endpoint own;
+  if (!ParseEndpoint(addr, addrlen, &target) || !IsLoopback(target) ||
+      !ParseEndpoint(
+          reinterpret_cast<const struct sockaddr *>(&address_.addr),
+          address_.addrlen, &own) ||
+      target.port != own.port) {
+    return false;
+  }
+  // An IPv6 socket bound to the wildcard address also accepts IPv4
+  // connections, unless it is restricted to IPv6.
+  if (own.family == AF_INET6 && IsWildcard(own)) {
+    if (target.family == AF_INET && v6_only_) {
+      return false;
+    }
+  } else if (own.family != target.family) {
+    return false;
+  }
+  if (!IsWildcard(own) &&
+      (own.family == AF_INET
+           ? own.ipv4.s_addr != target.ipv4.s_addr
+           : memcmp(&own.ipv6, &target.ipv6, sizeof(own.ipv6)) != 0)) {
+    return false;
+  }
+  return !closed_.load();
+}
+
+uint16_t LoopbackListener::port() const {
+  Endpoint endpoint;
+  if (!ParseEndpoint(reinterpret_cast<const struct sockaddr *>(&address_.addr),
+                     address_.addrlen, &endpoint)) {
+    return 0;
+  }
+  return endpoint.port;
+}
+
+void LoopbackListener::SetBacklog(int backlog) {
+  backlog_.store(QueueLength(backlog));
+}
+
+bool LoopbackListener::Enqueue(
+    std::unique_ptr<IOContextLocalSocket> connection) {
+  if (closed_.load()) {
+    return false;
+  }
+  if (pending_count_.fetch_add(1) >= backlog_.load()) {
+    pending_count_.fetch_sub(1);
+    return false;
+  }
+  // Cannot fail, since the backlog never exceeds the capacity of the queue.
+  pending_.TryPush(std::move(connection));
+
+  // A concurrent Close() may have drained the queue before the push; if so,
+  // close the connection it missed.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (closed_.load()) {
+    CloseQueued();
+  }
+  wait_queue_->Notify();
+  return true;
+}
+
+std::unique_ptr<IOContextLocalSocket> LoopbackListener::Dequeue() {
+  std::unique_ptr<IOContextLocalSocket> connection;
+  if (!pending_.TryPop(&connection)) {
+    return nullptr;
+  }
+  pending_count_.fetch_sub(1);
+  return connection;
+}
+
+bool LoopbackListener::HasPending() { return !pending_.IsEmptyApproximate(); }
+
+void LoopbackListener::Close() {
+  closed_.store(true);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  CloseQueued();
+}
+
+void LoopbackListener::CloseQueued() {
+  // Closing the queued connections lets their peers see the end of the
+  // stream, as a reset would.
+  std::unique_ptr<IOContextLocalSocket> connection;
+  while (pending_.TryPop(&connection)) {
+    pending_count_.fetch_sub(1);
+    connection->Close();
+    connection.reset();
+  }
+}
+
+void LoopbackRegistry::Register(
+    const std::shared_ptr<LoopbackListener> &listener) {
+  absl::MutexLock lock(&mu_);
+  std::vector<std::weak_ptr<LoopbackListener>> &listeners =
+      listeners_[listener->port()];
+  listeners.erase(std::remove_if(listeners.begin(), listeners.end(),
+                                 [](const std::weak_ptr<LoopbackListener> &l) {
+                                   return l.expired();
+                                 }),
+                  listeners.end());
+  listeners.push_back(listener);
+}
+
+std::shared_ptr<LoopbackListener> LoopbackRegistry::Find(
+    const struct sockaddr *addr, socklen_t addrlen) {
+  Endpoint target;
+  if (!ParseEndpoint(addr, addrlen, &target) || !IsLoopback(target)) {
+    return nullptr;
+  }
+  absl::MutexLock lock(&mu_);
+  auto it = listeners_.find(target.port);
+  if (it == listeners_.end()) {
+    return nullptr;
+  }
+  for (const std::weak_ptr<LoopbackListener> &weak_listener : it->second) {
+    std::shared_ptr<LoopbackListener> listener = weak_listener.lock();
+    if (listener && listener->Accepts(addr, addrlen)) {
+      return listener;
+    }
+  }
+  return nullptr;
+}
+
+}  // namespace io
+}  // namespace asylo
@@ -0,0 +1,145 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_POSIX_IO_LOOPBACK_LISTENER_H_
+#define ASYLO_PLATFORM_POSIX_IO_LOOPBACK_LISTENER_H_
+
+#include <sys/socket.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "asylo/platform/posix/io/local_wait_queue.h"
+#include "asylo/util/mpmc_queue.h"
+
+namespace asylo {
+namespace io {
+
+class IOContextLocalSocket;
+
+// The address of a socket.
+struct SocketAddress {
+  struct sockaddr_storage addr;
+  socklen_t addrlen;
+};
+
+// Returns whether |addr| is a loopback address: 127.0.0.0/8, ::1, or
+// 127.0.0.0/8 mapped to IPv6.
+bool IsLoopbackAddress(const struct sockaddr *addr, socklen_t addrlen);
+
+// The queue of connections made from inside the enclave to a listening TCP
+// socket of the enclave, which are accepted without involving the host.
+//
+// Connections are passed through an MpmcQueue sized for the largest backlog,
+// so connecting and accepting threads never take a lock.
+//
+// This class is thread safe.
+class LoopbackListener {
+ public:
+  // Creates a listener for the socket bound to |address|, which only accepts
+  // IPv6 connections if |v6_only| is set and queues at most |backlog|
+  // connections, as for listen(2). Changes in the readiness of the listener
+  // are reported to |wait_queue|, which must outlive it.
+  LoopbackListener(const SocketAddress &address, bool v6_only, int backlog,
+                   LocalWaitQueue *wait_queue);
+  ~LoopbackListener();
+
+  LoopbackListener(const LoopbackListener &other) = delete;
+  LoopbackListener &operator=(const LoopbackListener &other) = delete;
+
+  // Returns whether connections to loopback addresses may reach the listener,
+  // that is whether it is bound to a loopback or wildcard address.
+  bool ReachableFromLoopback() const;
+
+  // Returns whether a connection to the loopback address |addr| reaches the
+  // listener while it is open.
+  bool Accepts(const struct sockaddr *addr, socklen_t addrlen) const;
+
+  // Returns the port of the listener, in host byte order.
+  uint16_t port() const;
+
+  // Changes the backlog of the listener, as a repeated listen(2) does.
+  void SetBacklog(int backlog);
+
+  // Queues the accepting end of a new connection. Returns false if the backlog
+  // is full or the listener is closed, in which case |connection| is
+  // destroyed.
+  bool Enqueue(std::unique_ptr<IOContextLocalSocket> connection);
+
+  // Returns the oldest queued connection, or nullptr if there is none.
+  std::unique_ptr<IOContextLocalSocket> Dequeue();
+
+  // Returns whether a connection is queued.
+  bool HasPending();
+
+  // Stops accepting connections and closes the queued ones.
+  void Close();
+
+ private:
+  const SocketAddress address_;
+  const bool v6_only_;
+  LocalWaitQueue *const wait_queue_;
+
+  // Closes the connections in |pending_|.
+  void CloseQueued();
+
+  std::atomic<size_t> backlog_;
+  std::atomic<bool> closed_{false};
+
+  // Number of connections queued or being queued, kept within |backlog_|.
+  std::atomic<size_t> pending_count_{0};
+  MpmcQueue<std::unique_ptr<IOContextLocalSocket>> pending_;
+};
+
+// The listening TCP sockets of the enclave which connections to loopback
+// addresses may reach.
+//
+// This class is thread safe.
+class LoopbackRegistry {
+ public:
+  LoopbackRegistry() = default;
+
+  LoopbackRegistry(const LoopbackRegistry &other) = delete;
+  LoopbackRegistry &operator=(const LoopbackRegistry &other) = delete;
+
+  // Adds |listener|, which stays registered until it is destroyed.
+  void Register(const std::shared_ptr<LoopbackListener> &listener);
+
+  // Returns a listener which a connection to |addr| reaches, or nullptr if
+  // |addr| is not a loopback address or no such listener exists.
+  std::shared_ptr<LoopbackListener> Find(const struct sockaddr *addr,
+                                         socklen_t addrlen);
+
+ private:
+  absl::Mutex mu_;
+
+  // The registered listeners by port.
+  absl::flat_hash_map<uint16_t, std::vector<std::weak_ptr<LoopbackListener>>>
+      listeners_ ABSL_GUARDED_BY(mu_);
+};
+
+}  // namespace io
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_POSIX_IO_LOOPBACK_LISTENER_H_
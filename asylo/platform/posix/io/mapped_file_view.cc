@@ -0,0 +1,201 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/io/mapped_file_view.h"
+
+#include <openssl/sha.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#include "asylo/platform/host_call/trusted/host_calls.h"
+#include "asylo/platform/posix/io/io_manager.h"
+#include "asylo/platform/primitives/trusted_primitives.h"
+
+namespace asylo {
+namespace io {
+namespace {
+
+// Host mappings must start on a page boundary.
+constexpr off_t kPageSize = 4096;
+
+constexpr uint8_t kLeafPrefix = 0x00;
+constexpr uint8_t kNodePrefix = 0x01;
+
+MappedFileView::Digest NodeDigest(const MappedFileView::Digest &left,
+                                  const MappedFileView::Digest &right) {
+  MappedFileView::Digest digest;
+  SHA256_CTX context;
+  SHA256_Init(&context);
+  SHA256_Update(&context, &kNodePrefix, sizeof(kNodePrefix));
+  SHA256_Update(&context, left.data(), left.size());
+  SHA256_Update(&context, right.data(), right.size());
+  SHA256_Final(digest.data(), &context);
+  return digest;
+}
+
+}  // namespace
+
+constexpr size_t MappedFileView::kDigestSize;
+
+std::unique_ptr<MappedFileView> MappedFileView::Create(int fd, off_t offset,
+                                                       size_t length) {
+  return CreateVerified(fd, offset, length, /*chunk_size=*/0, /*root=*/{},
+                        /*chunk_digests=*/{});
+}
+
+std::unique_ptr<MappedFileView> MappedFileView::CreateVerified(
+    int fd, off_t offset, size_t length, size_t chunk_size,
+    const Digest &root, std::vector<Digest> chunk_digests) {
+  if (offset < 0 || length == 0) {
+    errno = EINVAL;
+    return nullptr;
+  }
+  if (chunk_size > 0) {
+    size_t chunks = length / chunk_size + (length % chunk_size != 0);
+    if (chunk_digests.size() != chunks) {
+      errno = EINVAL;
+      return nullptr;
+    }
+    if (MerkleRoot(chunk_digests) != root) {
+      errno = EBADMSG;
+      return nullptr;
+    }
+  }
+
+  // Accessing a mapping past the end of its file faults, so the range must lie
+  // within the file as it is now.
+  struct stat stat_buffer;
+  if (fstat(fd, &stat_buffer) != 0) {
+    return nullptr;
+  }
+  if (!S_ISREG(stat_buffer.st_mode)) {
+    errno = ENODEV;
+    return nullptr;
+  }
+  if (offset > stat_buffer.st_size ||
+      length > static_cast<uint64_t>(stat_buffer.st_size - offset)) {
+    errno = EINVAL;
+    return nullptr;
+  }
+
+  off_t page_offset = offset % kPageSize;
+  size_t mapping_size = length + page_offset;
+  void *mapping = IOManager::GetInstance().MapReadOnly(fd, mapping_size,
+                                                       offset - page_offset);
+  if (!mapping) {
+    return nullptr;
+  }
+  if (!primitives::TrustedPrimitives::IsOutsideEnclave(mapping,
+                                                       mapping_size)) {
+    enc_untrusted_munmap(mapping, mapping_size);
+    errno = EFAULT;
+    return nullptr;
+  }
+  const uint8_t *data = static_cast<const uint8_t *>(mapping) + page_offset;
+  return std::unique_ptr<MappedFileView>(
+      new MappedFileView(mapping, mapping_size, data, length, chunk_size,
+                         std::move(chunk_digests)));
+}
+
+MappedFileView::Digest MappedFileView::ChunkDigest(const void *data,
+                                                   size_t size) {
+  Digest digest;
+  SHA256_CTX context;
+  SHA256_Init(&context);
+  SHA256_Update(&context, &kLeafPrefix, sizeof(kLeafPrefix));
+  SHA256_Update(&context, data, size);
+  SHA256_Final(digest.data(), &context);
+  return digest;
+}
+
+MappedFileView::Digest MappedFileView::MerkleRoot(
+    const std::vector<Digest> &chunk_digests) {
+  if (chunk_digests.empty()) {
+    Digest digest;
+    SHA256(nullptr, 0, digest.data());
+    return digest;
+  }
+  std::vector<Digest> level = chunk_digests;
+  while (level.size() > 1) {
+    std::vector<Digest> next;
+    next.reserve((level.size() + 1) / 2);
+    for (size_t i = 0; i + 1 < level.size(); i += 2) {
+      next.push_back(NodeDigest(level[i], level[i + 1]));
+    }
+    if (level.size() % 2 != 0) {
+      next.push_back(level.back());
+    }
+    level.swap(next);
+  }
+  return level.front();
+}
+
+MappedFileView::~MappedFileView() {
+  enc_untrusted_munmap(mapping_, mapping_size_);
+}
+
+ssize_t MappedFileView::Read(off_t offset, void *buf, size_t count) const {
+  if (offset < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (static_cast<uint64_t>(offset) >= size_) {
+    return 0;
+  }
+  count = std::min(count, size_ - offset);
+  if (!buf && count > 0) {
+    errno = EFAULT;
+    return -1;
+  }
+  if (chunk_size_ > 0) {
+    return VerifiedRead(offset, static_cast<uint8_t *>(buf), count);
+  }
+  memcpy(buf, data_ + offset, count);
+  return count;
+}
+
+ssize_t MappedFileView::VerifiedRead(size_t offset, uint8_t *buf,
+                                     size_t count) const {
+  // The host may change the mapping at any time, so each chunk is verified and
+  // served from a trusted copy rather than from the mapping itself.
+  std::unique_ptr<uint8_t[]> chunk(new uint8_t[chunk_size_]);
+  size_t total = 0;
+  while (total < count) {
+    size_t position = offset + total;
+    size_t index = position / chunk_size_;
+    size_t chunk_start = index * chunk_size_;
+    size_t chunk_length = std::min(chunk_size_, size_ - chunk_start);
+    memcpy(chunk.get(), data_ + chunk_start, chunk_length);
+    if (ChunkDigest(chunk.get(), chunk_length) != chunk_digests_[index]) {
+      errno = EBADMSG;
+      return -1;
+    }
+    size_t offset_in_chunk = position - chunk_start;
+    size_t copied = std::min(count - total, chunk_length - offset_in_chunk);
+    memcpy(buf + total, chunk.get() + offset_in_chunk, copied);
+    total += copied;
+  }
+  return total;
+}
+
+}  // namespace io
+}  // namespace asylo
@@ -0,0 +1,124 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_POSIX_IO_MAPPED_FILE_VIEW_H_
+#define ASYLO_PLATFORM_POSIX_IO_MAPPED_FILE_VIEW_H_
+
+#include <sys/types.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace asylo {
+namespace io {
+
+// A read-only view of a range of a host file opened through a native path. The
+// range is mapped into untrusted memory once, after which reads are served by
+// copying out of the mapping without leaving the enclave. The mapping itself
+// is never handed out: every read is bounds checked against the view and
+// copies into a caller-supplied trusted buffer.
+//
+// The contents of the mapping are controlled by the host. A view created with
+// CreateVerified() checks each chunk it reads against a Merkle tree over the
+// chunks of the range whose root is supplied by the enclave, so modified data
+// is detected instead of returned. The backing file must not be truncated
+// while a view of it exists.
+//
+// This class is thread safe.
+class MappedFileView {
+ public:
+  static constexpr size_t kDigestSize = 32;
+
+  // A SHA-256 digest.
+  using Digest = std::array<uint8_t, kDigestSize>;
+
+  // Maps |length| bytes of the host file open as |fd| starting at |offset|.
+  // Returns nullptr and sets errno on failure.
+  static std::unique_ptr<MappedFileView> Create(int fd, off_t offset,
+                                                size_t length);
+
+  // As Create(), but splits the range into chunks of |chunk_size| bytes, the
+  // last of which may be shorter, and verifies every chunk a read touches.
+  // |chunk_digests| holds the ChunkDigest() of each chunk in order and may come
+  // from an untrusted source; it is checked against |root| here. Sets errno to
+  // EINVAL if the digests do not match the range and to EBADMSG if they do not
+  // produce |root|.
+  static std::unique_ptr<MappedFileView> CreateVerified(
+      int fd, off_t offset, size_t length, size_t chunk_size,
+      const Digest &root, std::vector<Digest> chunk_digests);
+
+  // Returns the leaf digest of a chunk of |size| bytes at |data|, which is
+  // SHA-256(0x00 || data).
+  static Digest ChunkDigest(const void *data, size_t size);
+
+  // Returns the root of the Merkle tree over |chunk_digests|. Each interior
+  // node is SHA-256(0x01 || left || right), and a node without a sibling is
+  // promoted to the next level as is, so the root matches RFC 6962 for the
+  // same leaves.
+  static Digest MerkleRoot(const std::vector<Digest> &chunk_digests);
+
+  // Unmaps the range.
+  ~MappedFileView();
+
+  MappedFileView(const MappedFileView &other) = delete;
+  MappedFileView &operator=(const MappedFileView &other) = delete;
+
+  // Copies up to |count| bytes starting |offset| bytes into the view to |buf|.
+  // Returns the number of bytes copied, which is smaller than |count| only at
+  // the end of the view, or -1 and sets errno. Verified views set errno to
+  // EBADMSG if a chunk does not match its digest.
+  ssize_t Read(off_t offset, void *buf, size_t count) const;
+
+  // Returns the length of the view in bytes.
+  size_t size() const { return size_; }
+
+ private:
+  MappedFileView(void *mapping, size_t mapping_size, const uint8_t *data,
+                 size_t size, size_t chunk_size,
+                 std::vector<Digest> chunk_digests)
+      : mapping_(mapping),
+        mapping_size_(mapping_size),
+        data_(data),
+        size_(size),
+        chunk_size_(chunk_size),
+        chunk_digests_(std::move(chunk_digests)) {}
+
+  // Copies |count| bytes at |offset| through the chunks covering them,
+  // verifying each chunk in trusted memory first.
+  ssize_t VerifiedRead(size_t offset, uint8_t *buf, size_t count) const;
+
+  // The host mapping, which starts at the page containing the range.
+  void *const mapping_;
+  const size_t mapping_size_;
+
+  // The first byte of the range inside |mapping_|.
+  const uint8_t *const data_;
+  const size_t size_;
+
+  // Zero for views which are not verified.
+  const size_t chunk_size_;
+  const std::vector<Digest> chunk_digests_;
+};
+
+}  // namespace io
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_POSIX_IO_MAPPED_FILE_VIEW_H_
@@ -0,0 +1,201 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/io/mapped_file_view.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/flags/flag.h"
+#include "asylo/platform/common/memory.h"
+#include "asylo/test/util/test_flags.h"
+
+namespace asylo {
+namespace io {
+namespace {
+
+using ::testing::Eq;
+using ::testing::IsNull;
+using ::testing::NotNull;
+
+constexpr size_t kChunkSize = 1000;
+
+class MappedFileViewTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    test_file_.reset(tempnam(absl::GetFlag(FLAGS_test_tmpdir).c_str(), "MFV"));
+    for (size_t i = 0; i < 10000; ++i) {
+      contents_.push_back(static_cast<char>('a' + i % 23));
+    }
+    int fd = open(test_file_.get(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+    ASSERT_GE(fd, 0);
+    ASSERT_THAT(write(fd, contents_.data(), contents_.size()),
+                Eq(static_cast<ssize_t>(contents_.size())));
+    ASSERT_THAT(close(fd), Eq(0));
+    fd_ = open(test_file_.get(), O_RDONLY);
+    ASSERT_GE(fd_, 0);
+  }
+
+  void TearDown() override {
+    close(fd_);
+    remove(test_file_.get());
+  }
+
+  // Returns the chunk digests of |size| bytes of the file at |offset|.
+  std::vector<MappedFileView::Digest> ChunkDigests(size_t offset,
+                                                   size_t size) {
+    std::vector<MappedFileView::Digest> digests;
+    for (size_t start = 0; start < size; start += kChunkSize) {
+      digests.push_back(MappedFileView::ChunkDigest(
+          contents_.data() + offset + start,
+          std::min(kChunkSize, size - start)));
+    }
+    return digests;
+  }
+
+  MallocUniquePtr<char> test_file_;
+  std::string contents_;
+  int fd_ = -1;
+};
+
+TEST_F(MappedFileViewTest, ReadsWithinBounds) {
+  auto view = MappedFileView::Create(fd_, /*offset=*/0, contents_.size());
+  ASSERT_THAT(view, NotNull());
+  EXPECT_THAT(view->size(), Eq(contents_.size()));
+
+  std::string buffer(100, '\0');
+  ASSERT_THAT(view->Read(5000, &buffer[0], buffer.size()), Eq(100));
+  EXPECT_THAT(buffer, Eq(contents_.substr(5000, 100)));
+
+  // Reads are truncated at the end of the view.
+  ASSERT_THAT(view->Read(contents_.size() - 10, &buffer[0], buffer.size()),
+              Eq(10));
+  EXPECT_THAT(buffer.substr(0, 10),
+              Eq(contents_.substr(contents_.size() - 10)));
+  EXPECT_THAT(view->Read(contents_.size(), &buffer[0], buffer.size()), Eq(0));
+  EXPECT_THAT(view->Read(-1, &buffer[0], buffer.size()), Eq(-1));
+  EXPECT_THAT(errno, Eq(EINVAL));
+}
+
+TEST_F(MappedFileViewTest, MapsUnalignedRanges) {
+  auto view = MappedFileView::Create(fd_, /*offset=*/4097, /*length=*/3000);
+  ASSERT_THAT(view, NotNull());
+
+  std::string buffer(view->size(), '\0');
+  ASSERT_THAT(view->Read(0, &buffer[0], buffer.size()), Eq(3000));
+  EXPECT_THAT(buffer, Eq(contents_.substr(4097, 3000)));
+}
+
+TEST_F(MappedFileViewTest, RejectsRangesBeyondTheFile) {
+  EXPECT_THAT(MappedFileView::Create(fd_, 0, contents_.size() + 1), IsNull());
+  EXPECT_THAT(errno, Eq(EINVAL));
+  EXPECT_THAT(MappedFileView::Create(fd_, 0, 0), IsNull());
+  EXPECT_THAT(errno, Eq(EINVAL));
+  EXPECT_THAT(MappedFileView::Create(-1, 0, 1), IsNull());
+}
+
+TEST_F(MappedFileViewTest, VerifiedReadsMatchTheFile) {
+  auto digests = ChunkDigests(0, contents_.size());
+  auto root = MappedFileView::MerkleRoot(digests);
+  auto view = MappedFileView::CreateVerified(fd_, 0, contents_.size(),
+                                             kChunkSize, root, digests);
+  ASSERT_THAT(view, NotNull());
+
+  // Read across several chunk boundaries.
+  std::string buffer(2500, '\0');
+  ASSERT_THAT(view->Read(1500, &buffer[0], buffer.size()), Eq(2500));
+  EXPECT_THAT(buffer, Eq(contents_.substr(1500, 2500)));
+}
+
+TEST_F(MappedFileViewTest, VerifiesTheLastShortChunk) {
+  constexpr size_t kLength = 2 * kChunkSize + 10;
+  auto digests = ChunkDigests(100, kLength);
+  ASSERT_THAT(digests.size(), Eq(3));
+  auto view = MappedFileView::CreateVerified(
+      fd_, 100, kLength, kChunkSize, MappedFileView::MerkleRoot(digests),
+      digests);
+  ASSERT_THAT(view, NotNull());
+
+  std::string buffer(20, '\0');
+  ASSERT_THAT(view->Read(kLength - 15, &buffer[0], buffer.size()), Eq(15));
+  EXPECT_THAT(buffer.substr(0, 15),
+              Eq(contents_.substr(100 + kLength - 15, 15)));
+}
+
+TEST_F(MappedFileViewTest, RejectsDigestsNotMatchingTheRoot) {
+  auto digests = ChunkDigests(0, contents_.size());
+  auto root = MappedFileView::MerkleRoot(digests);
+  digests[3][0] ^= 1;
+  EXPECT_THAT(MappedFileView::CreateVerified(fd_, 0, contents_.size(),
+                                             kChunkSize, root, digests),
+              IsNull());
+  EXPECT_THAT(errno, Eq(EBADMSG));
+
+  digests.pop_back();
+  EXPECT_THAT(MappedFileView::CreateVerified(fd_, 0, contents_.size(),
+                                             kChunkSize, root, digests),
+              IsNull());
+  EXPECT_THAT(errno, Eq(EINVAL));
+}
+
+TEST_F(MappedFileViewTest, DetectsChunksNotMatchingTheirDigest) {
+  // Describe contents which differ from the file in the third chunk only.
+  std::string expected = contents_;
+  expected[2 * kChunkSize + 1] ^= 1;
+  std::vector<MappedFileView::Digest> digests;
+  for (size_t start = 0; start < expected.size(); start += kChunkSize) {
+    digests.push_back(
+        MappedFileView::ChunkDigest(expected.data() + start, kChunkSize));
+  }
+  auto view = MappedFileView::CreateVerified(
+      fd_, 0, contents_.size(), kChunkSize,
+      MappedFileView::MerkleRoot(digests), digests);
+  ASSERT_THAT(view, NotNull());
+
+  std::string buffer(kChunkSize, '\0');
+  EXPECT_THAT(view->Read(0, &buffer[0], buffer.size()),
+              Eq(static_cast<ssize_t>(kChunkSize)));
+  EXPECT_THAT(view->Read(2 * kChunkSize - 1, &buffer[0], 2), Eq(-1));
+  EXPECT_THAT(errno, Eq(EBADMSG));
+}
+
+TEST(MerkleRootTest, PromotesNodesWithoutSibling) {
+  std::vector<MappedFileView::Digest> leaves;
+  for (char c = 'a'; c < 'd'; ++c) {
+    leaves.push_back(MappedFileView::ChunkDigest(&c, 1));
+  }
+  auto root = MappedFileView::MerkleRoot(leaves);
+
+  // The root of three leaves is the root of the first two combined with the
+  // third.
+  auto left = MappedFileView::MerkleRoot({leaves[0], leaves[1]});
+  EXPECT_THAT(MappedFileView::MerkleRoot({left, leaves[2]}), Eq(root));
+  EXPECT_THAT(MappedFileView::MerkleRoot({leaves[0]}), Eq(leaves[0]));
+}
+
+}  // namespace
+}  // namespace io
+}  // namespace asylo
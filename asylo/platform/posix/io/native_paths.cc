@@ -19,24 +19,59 @@
 #include "asylo/platform/posix/io/native_paths.h"
 
 #include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
 
+#include <algorithm>
 #include <cerrno>
 #include <cstring>
+#include <vector>
 
 #include "asylo/platform/host_call/trusted/host_calls.h"
-#include "asylo/platform/posix/io/secure_paths.h"
 #include "asylo/platform/posix/io/io_context_inotify.h"
+#include "asylo/platform/posix/io/io_uring.h"
+#include "asylo/platform/posix/io/secure_paths.h"
+#include "asylo/platform/storage/secure/enclave_storage_secure.h"
 
 namespace asylo {
 namespace io {
 
 int IOContextNative::Close() { return enc_untrusted_close(host_fd_); }
 
+bool IOContextNative::UseIoUring(int flags) {
+  if (!IoUringInUse()) {
+    return false;
+  }
+  if (flags & MSG_DONTWAIT) {
+    return true;
+  }
+  int never_blocks = never_blocks_.load(std::memory_order_relaxed);
+  if (never_blocks < 0) {
+    struct stat stat_buffer;
+    int status_flags;
+    never_blocks =
+        (enc_untrusted_fstat(host_fd_, &stat_buffer) == 0 &&
+         S_ISREG(stat_buffer.st_mode)) ||
+        ((status_flags = enc_untrusted_fcntl(host_fd_, F_GETFL)) != -1 &&
+         (status_flags & O_NONBLOCK));
+    never_blocks_.store(never_blocks, std::memory_order_relaxed);
+  }
+  return never_blocks;
+}
+
 ssize_t IOContextNative::Read(void *buf, size_t count) {
+  ssize_t result;
+  if (UseIoUring() && IoUringRead(host_fd_, buf, count, &result)) {
+    return result;
+  }
   return enc_untrusted_read(host_fd_, buf, count);
 }
 
 ssize_t IOContextNative::Write(const void *buf, size_t count) {
+  ssize_t result;
+  if (UseIoUring() && IoUringWrite(host_fd_, buf, count, &result)) {
+    return result;
+  }
   return enc_untrusted_write(host_fd_, buf, count);
 }
 
@@ -49,7 +84,11 @@ int IOContextNative::LSeek(off_t offset, int whence) {
 }
 
 int IOContextNative::FCntl(int cmd, int64_t arg) {
-  return enc_untrusted_fcntl(host_fd_, cmd, arg);
+  int result = enc_untrusted_fcntl(host_fd_, cmd, arg);
+  if (cmd == F_SETFL && result != -1) {
+    never_blocks_.store(-1, std::memory_order_relaxed);
+  }
+  return result;
 }
 
 int IOContextNative::FSync() { return enc_untrusted_fsync(host_fd_); }
@@ -89,56 +128,26 @@ int IOContextNative::FLock(int operation) {
   return enc_untrusted_flock(host_fd_, operation);
 }
 
-void IOContextNative::FillIov(const char *buf, int size,
-                              const struct iovec *iov, int iovcnt) {
-  size_t bytes_left = size;
-  for (int i = 0; i < iovcnt; ++i) {
-    if (bytes_left == 0) {
-      break;
-    }
-    int bytes_to_copy = std::min(bytes_left, iov[i].iov_len);
-    memcpy(iov[i].iov_base, buf, bytes_to_copy);
-    buf += bytes_to_copy;
-    bytes_left -= bytes_to_copy;
-  }
-}
-
 ssize_t IOContextNative::Writev(const struct iovec *iov, int iovcnt) {
-  if (iovcnt <= 0) {
-    errno = EINVAL;
-    return -1;
-  }
-
-  size_t total_size = 0;
-  for (int i = 0; i < iovcnt; ++i) {
-    total_size += iov[i].iov_len;
-  }
-  std::unique_ptr<char[]> trusted_buf(new char[total_size]);
-  size_t copied_bytes = 0;
-  for (int i = 0; i < iovcnt; ++i) {
-    memcpy(trusted_buf.get() + copied_bytes, iov[i].iov_base, iov[i].iov_len);
-    copied_bytes += iov[i].iov_len;
-  }
-
-  return enc_untrusted_write(host_fd_, trusted_buf.get(), total_size);
+  return enc_untrusted_writev(host_fd_, iov, iovcnt);
 }
 
 ssize_t IOContextNative::Readv(const struct iovec *iov, int iovcnt) {
-  if (iovcnt <= 0) {
-    errno = EINVAL;
-    return -1;
-  }
+  return enc_untrusted_readv(host_fd_, iov, iovcnt);
+}
 
-  size_t total_size = 0;
-  for (int i = 0; i < iovcnt; ++i) {
-    total_size += iov[i].iov_len;
-  }
-  std::unique_ptr<char[]> trusted_buf(new char[total_size]);
+ssize_t IOContextNative::PWritev(const struct iovec *iov, int iovcnt,
+                                 off_t offset) {
+  return enc_untrusted_pwritev(host_fd_, iov, iovcnt, offset);
+}
 
-  ssize_t ret = enc_untrusted_read(host_fd_, trusted_buf.get(), total_size);
-  FillIov(trusted_buf.get(), ret, iov, iovcnt);
+ssize_t IOContextNative::PReadv(const struct iovec *iov, int iovcnt,
+                                off_t offset) {
+  return enc_untrusted_preadv(host_fd_, iov, iovcnt, offset);
+}
 
-  return ret;
+void *IOContextNative::MapReadOnly(size_t length, off_t offset) {
+  return enc_untrusted_mmap_read_only(host_fd_, length, offset);
 }
 
 ssize_t IOContextNative::PRead(void *buf, size_t count, off_t offset) {
@@ -161,6 +170,10 @@ int IOContextNative::Shutdown(int how) {
 }
 
 ssize_t IOContextNative::Send(const void *buf, size_t len, int flags) {
+  ssize_t result;
+  if (UseIoUring(flags) && IoUringSend(host_fd_, buf, len, flags, &result)) {
+    return result;
+  }
   return enc_untrusted_send(host_fd_, buf, len, flags);
 }
 
@@ -170,9 +183,32 @@ int IOContextNative::GetSockOpt(int level, int optname, void *optval,
 }
 
 int IOContextNative::Accept(struct sockaddr *addr, socklen_t *addrlen) {
+  int result;
+  if (UseIoUring() && IoUringAccept(host_fd_, addr, addrlen, &result)) {
+    return result;
+  }
   return enc_untrusted_accept(host_fd_, addr, addrlen);
 }
 
+int IOContextNative::AcceptBatch(
+    int flags, const std::vector<IOManager::SocketOption> &options,
+    size_t max_connections,
+    std::vector<IOManager::AcceptedConnection> *connections) {
+  std::vector<HostSocketOption> host_options;
+  host_options.reserve(options.size());
+  for (const IOManager::SocketOption &option : options) {
+    host_options.push_back({option.level, option.option_name, option.value});
+  }
+  std::vector<HostAcceptedConnection> host_connections;
+  int result = enc_untrusted_accept_batch(host_fd_, flags, host_options,
+                                          max_connections, &host_connections);
+  for (const HostAcceptedConnection &host_connection : host_connections) {
+    connections->push_back({host_connection.fd, host_connection.setup_errno,
+                            host_connection.addr, host_connection.addrlen});
+  }
+  return result;
+}
+
 int IOContextNative::Bind(const struct sockaddr *addr, socklen_t addrlen) {
   return enc_untrusted_bind(host_fd_, addr, addrlen);
 }
@@ -200,11 +236,312 @@ int IOContextNative::GetPeerName(struct sockaddr *addr, socklen_t *addrlen) {
 ssize_t IOContextNative::RecvFrom(void *buf, size_t len, int flags,
                                   struct sockaddr *src_addr,
                                   socklen_t *addrlen) {
+  ssize_t result;
+  if (!src_addr && UseIoUring(flags) &&
+      IoUringRecv(host_fd_, buf, len, flags, &result)) {
+    return result;
+  }
   return enc_untrusted_recvfrom(host_fd_, buf, len, flags, src_addr, addrlen);
 }
 
+int IOContextNative::ReadDirectory(size_t batch_size,
+                                   IOManager::DirectoryEntry *entry) {
+  absl::MutexLock lock(&directory_lock_);
+  if (!directory_batch_) {
+    directory_batch_ = absl::make_unique<DirectoryBatch>();
+  }
+  DirectoryBatch *batch = directory_batch_.get();
+  if (batch->next == batch->entries.size()) {
+    batch->index.clear();
+    batch->next = 0;
+    int result =
+        enc_untrusted_getdents_stat(host_fd_, batch_size, &batch->entries);
+    if (result <= 0) {
+      return result;
+    }
+    for (size_t i = 0; i < batch->entries.size(); ++i) {
+      batch->index.emplace(batch->entries[i].name, i);
+    }
+  }
+  const HostDirectoryEntry &host_entry = batch->entries[batch->next++];
+  entry->inode = host_entry.inode;
+  entry->next_offset = host_entry.next_offset;
+  entry->name = host_entry.name;
+  return 1;
+}
+
+int IOContextNative::SeekDirectory(off_t offset) {
+  absl::MutexLock lock(&directory_lock_);
+  directory_batch_.reset();
+  return enc_untrusted_lseek(host_fd_, offset, SEEK_SET) == -1 ? -1 : 0;
+}
+
+int IOContextNative::FStatAt(const char *pathname, struct stat *stat_buffer,
+                             int flags) {
+  if (flags & ~AT_SYMLINK_NOFOLLOW) {
+    errno = EINVAL;
+    return -1;
+  }
+  {
+    absl::MutexLock lock(&directory_lock_);
+    if (directory_batch_) {
+      auto it = directory_batch_->index.find(pathname);
+      if (it != directory_batch_->index.end()) {
+        const HostDirectoryEntry &host_entry =
+            directory_batch_->entries[it->second];
+        // Batched attributes are fetched without following symbolic links, so
+        // they also answer requests which follow links for entries which are
+        // not links themselves.
+        if (host_entry.stat_errno == 0 &&
+            ((flags & AT_SYMLINK_NOFOLLOW) ||
+             !S_ISLNK(host_entry.attributes.st_mode))) {
+          *stat_buffer = host_entry.attributes;
+          return 0;
+        }
+      }
+    }
+  }
+  return enc_untrusted_fstatat(host_fd_, pathname, stat_buffer, flags);
+}
+
 int IOContextNative::GetHostFileDescriptor() { return host_fd_; }
 
+int IOContextNative::GetHostTransferFileDescriptor() { return host_fd_; }
+
+constexpr size_t IOContextCachedFile::kReadAheadBlocks;
+constexpr size_t IOContextCachedFile::kMaxCachedReadSize;
+
+ssize_t IOContextCachedFile::CachedPRead(char *buf, size_t count,
+                                         off_t offset) {
+  if (offset < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (count > kMaxCachedReadSize) {
+    return enc_untrusted_pread64(GetHostFileDescriptor(), buf, count, offset);
+  }
+
+  constexpr size_t kBlockSize = PageCache::kBlockSize;
+  size_t total = 0;
+  while (total < count) {
+    off_t position = offset + total;
+    uint64_t block = position / kBlockSize;
+    size_t offset_in_block = position % kBlockSize;
+    size_t wanted = std::min(count - total, kBlockSize - offset_in_block);
+    ssize_t cached =
+        cache_->Read(file_, block, offset_in_block, buf + total, wanted);
+    if (cached >= 0) {
+      next_block_ = block + 1;
+      total += cached;
+      if (static_cast<size_t>(cached) < wanted) {
+        break;
+      }
+      continue;
+    }
+
+    // Fetch every remaining block of the request in one host call, reading
+    // ahead if the request continues a sequential scan.
+    uint64_t last_block = (offset + count - 1) / kBlockSize;
+    size_t blocks = last_block - block + 1;
+    if (block == next_block_) {
+      blocks += kReadAheadBlocks;
+    }
+    std::vector<char> fetched(blocks * kBlockSize);
+    ssize_t result =
+        enc_untrusted_pread64(GetHostFileDescriptor(), fetched.data(),
+                              fetched.size(), block * kBlockSize);
+    if (result < 0) {
+      return total > 0 ? total : -1;
+    }
+    size_t fetched_size = result;
+    for (size_t i = 0; i * kBlockSize < fetched_size; ++i) {
+      cache_->Insert(file_, block + i, fetched.data() + i * kBlockSize,
+                     std::min(kBlockSize, fetched_size - i * kBlockSize));
+    }
+    size_t available =
+        fetched_size > offset_in_block ? fetched_size - offset_in_block : 0;
+    size_t copied = std::min(count - total, available);
+    memcpy(buf + total, fetched.data() + offset_in_block, copied);
+    total += copied;
+    next_block_ = (offset + total + kBlockSize - 1) / kBlockSize;
+    break;
+  }
+  return total;
+}
+
+ssize_t IOContextCachedFile::Read(void *buf, size_t count) {
+  absl::MutexLock lock(&lock_);
+  ssize_t result = CachedPRead(static_cast<char *>(buf), count, position_);
+  if (result > 0) {
+    position_ += result;
+  }
+  return result;
+}
+
+ssize_t IOContextCachedFile::PRead(void *buf, size_t count, off_t offset) {
+  absl::MutexLock lock(&lock_);
+  return CachedPRead(static_cast<char *>(buf), count, offset);
+}
+
+ssize_t IOContextCachedFile::Write(const void *buf, size_t count) {
+  absl::MutexLock lock(&lock_);
+  ssize_t result =
+      enc_untrusted_pwrite64(GetHostFileDescriptor(), buf, count, position_);
+  if (result > 0) {
+    cache_->Write(file_, position_, buf, result);
+    position_ += result;
+  }
+  return result;
+}
+
+int IOContextCachedFile::LSeek(off_t offset, int whence) {
+  absl::MutexLock lock(&lock_);
+  off_t position;
+  switch (whence) {
+    case SEEK_SET:
+      position = offset;
+      break;
+    case SEEK_CUR:
+      position = position_ + offset;
+      break;
+    default:
+      // The host offset is never used otherwise, so let the host resolve
+      // offsets relative to the end of the file, holes and data.
+      position = enc_untrusted_lseek(GetHostFileDescriptor(), offset, whence);
+      if (position < 0) {
+        return -1;
+      }
+  }
+  if (position < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  position_ = position;
+  return position_;
+}
+
+int IOContextCachedFile::FTruncate(off_t length) {
+  int result = IOContextNative::FTruncate(length);
+  if (result == 0) {
+    cache_->Invalidate(file_);
+  }
+  return result;
+}
+
+ssize_t IOContextCachedFile::CachedPReadv(const struct iovec *iov, int iovcnt,
+                                          off_t offset) {
+  if (iovcnt <= 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  ssize_t total = 0;
+  for (int i = 0; i < iovcnt; ++i) {
+    ssize_t result = CachedPRead(static_cast<char *>(iov[i].iov_base),
+                                 iov[i].iov_len, offset + total);
+    if (result < 0) {
+      return total > 0 ? total : -1;
+    }
+    total += result;
+    if (static_cast<size_t>(result) < iov[i].iov_len) {
+      break;
+    }
+  }
+  return total;
+}
+
+ssize_t IOContextCachedFile::ThroughPWritev(const struct iovec *iov,
+                                            int iovcnt, off_t offset) {
+  ssize_t result =
+      enc_untrusted_pwritev(GetHostFileDescriptor(), iov, iovcnt, offset);
+  size_t remaining = result > 0 ? result : 0;
+  for (int i = 0; i < iovcnt && remaining > 0; ++i) {
+    size_t written = std::min(remaining, iov[i].iov_len);
+    cache_->Write(file_, offset, iov[i].iov_base, written);
+    offset += written;
+    remaining -= written;
+  }
+  return result;
+}
+
+ssize_t IOContextCachedFile::Writev(const struct iovec *iov, int iovcnt) {
+  absl::MutexLock lock(&lock_);
+  ssize_t result = ThroughPWritev(iov, iovcnt, position_);
+  if (result > 0) {
+    position_ += result;
+  }
+  return result;
+}
+
+ssize_t IOContextCachedFile::Readv(const struct iovec *iov, int iovcnt) {
+  absl::MutexLock lock(&lock_);
+  ssize_t result = CachedPReadv(iov, iovcnt, position_);
+  if (result > 0) {
+    position_ += result;
+  }
+  return result;
+}
+
+ssize_t IOContextCachedFile::PWritev(const struct iovec *iov, int iovcnt,
+                                     off_t offset) {
+  absl::MutexLock lock(&lock_);
+  return ThroughPWritev(iov, iovcnt, offset);
+}
+
+ssize_t IOContextCachedFile::PReadv(const struct iovec *iov, int iovcnt,
+                                    off_t offset) {
+  absl::MutexLock lock(&lock_);
+  return CachedPReadv(iov, iovcnt, offset);
+}
+
+ssize_t IOContextBufferedNative::Write(const void *buf, size_t count) {
+  return buffer_.Write(buf, count);
+}
+
+ssize_t IOContextBufferedNative::Writev(const struct iovec *iov, int iovcnt) {
+  return buffer_.Writev(iov, iovcnt);
+}
+
+int IOContextBufferedNative::LSeek(off_t offset, int whence) {
+  if (buffer_.Flush() != 0) {
+    return -1;
+  }
+  return IOContextNative::LSeek(offset, whence);
+}
+
+int IOContextBufferedNative::FSync() {
+  if (buffer_.Flush() != 0) {
+    return -1;
+  }
+  return IOContextNative::FSync();
+}
+
+int IOContextBufferedNative::Close() {
+  // As with fclose(3), the stream is closed even if the flush fails.
+  int flush_result = buffer_.Flush();
+  int flush_errno = errno;
+  int result = IOContextNative::Close();
+  if (flush_result != 0) {
+    errno = flush_errno;
+    return -1;
+  }
+  return result;
+}
+
+int IOContextBufferedNative::FTruncate(off_t length) {
+  if (buffer_.Flush() != 0) {
+    return -1;
+  }
+  return IOContextNative::FTruncate(length);
+}
+
+ssize_t IOContextBufferedNative::PWritev(const struct iovec *iov, int iovcnt,
+                                         off_t offset) {
+  if (buffer_.Flush() != 0) {
+    return -1;
+  }
+  return IOContextNative::PWritev(iov, iovcnt, offset);
+}
+
 std::unique_ptr<IOManager::IOContext> NativePathHandler::Open(const char *path,
                                                               int flags,
                                                               mode_t mode) {
@@ -217,6 +554,17 @@ std::unique_ptr<IOManager::IOContext> NativePathHandler::Open(const char *path,
     return nullptr;
   }
 
+  // Appending writes use the host file offset, so only cache descriptors
+  // whose offset can be tracked in the enclave.
+  if (page_cache_ && !(flags & O_APPEND)) {
+    struct stat stat_buffer;
+    if (enc_untrusted_fstat(host_fd, &stat_buffer) == 0 &&
+        S_ISREG(stat_buffer.st_mode)) {
+      return ::absl::make_unique<IOContextCachedFile>(
+          host_fd, page_cache_, PageCache::FileKey::FromStat(stat_buffer));
+    }
+  }
+
   return ::absl::make_unique<IOContextNative>(host_fd);
 }
 
@@ -228,8 +576,11 @@ int NativePathHandler::Link(const char *existing, const char *new_link) {
   return enc_untrusted_link(existing, new_link);
 }
 
+// A file is only known to be secure while it is open, so removing or renaming
+// any path also removes or renames the Merkle tree file a secure file kept
+// there.
 int NativePathHandler::Unlink(const char *pathname) {
-  return enc_untrusted_unlink(pathname);
+  return platform::storage::secure_unlink(pathname);
 }
 
 ssize_t NativePathHandler::ReadLink(const char *path_name, char *buf,
@@ -297,7 +648,7 @@ int NativePathHandler::RmDir(const char *pathname) {
 }
 
 int NativePathHandler::Rename(const char *oldpath, const char *newpath) {
-  return enc_untrusted_rename(oldpath, newpath);
+  return platform::storage::secure_rename(oldpath, newpath);
 }
 
 int NativePathHandler::Access(const char *path, int mode) {
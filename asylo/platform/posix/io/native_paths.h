@@ -21,7 +21,18 @@
 
 #include <utime.h>
 
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "asylo/platform/host_call/trusted/host_calls.h"
 #include "asylo/platform/posix/io/io_manager.h"
+#include "asylo/platform/posix/io/output_buffer.h"
+#include "asylo/platform/posix/io/page_cache.h"
 
 namespace asylo {
 namespace io {
@@ -52,6 +63,14 @@ class IOContextNative : public IOManager::IOContext {
   ssize_t Writev(const struct iovec *iov, int iovcnt) override;
   ssize_t Readv(const struct iovec *iov, int iovcnt) override;
   ssize_t PRead(void *buf, size_t count, off_t offset) override;
+  ssize_t PWritev(const struct iovec *iov, int iovcnt, off_t offset) override;
+  ssize_t PReadv(const struct iovec *iov, int iovcnt, off_t offset) override;
+  void *MapReadOnly(size_t length, off_t offset) override;
+  int ReadDirectory(size_t batch_size,
+                    IOManager::DirectoryEntry *entry) override;
+  int SeekDirectory(off_t offset) override;
+  int FStatAt(const char *pathname, struct stat *stat_buffer,
+              int flags) override;
   int SetSockOpt(int level, int option_name, const void *option_value,
                  socklen_t option_len) override;
   int Connect(const struct sockaddr *addr, socklen_t addrlen) override;
@@ -60,6 +79,10 @@ class IOContextNative : public IOManager::IOContext {
   int GetSockOpt(int level, int optname, void *optval,
                  socklen_t *optlen) override;
   int Accept(struct sockaddr *addr, socklen_t *addrlen) override;
+  int AcceptBatch(int flags, const std::vector<IOManager::SocketOption> &options,
+                  size_t max_connections,
+                  std::vector<IOManager::AcceptedConnection> *connections)
+      override;
   int Bind(const struct sockaddr *addr, socklen_t addrlen) override;
   int Listen(int backlog) override;
   ssize_t SendMsg(const struct msghdr *msg, int flags) override;
@@ -69,16 +92,134 @@ class IOContextNative : public IOManager::IOContext {
   ssize_t RecvFrom(void *buf, size_t len, int flags, struct sockaddr *src_addr,
                    socklen_t *addrlen) override;
   int GetHostFileDescriptor() override;
+  int GetHostTransferFileDescriptor() override;
 
  private:
+  // A batch of directory entries fetched from the host together with their
+  // attributes, which FStatAt serves until the next batch is fetched.
+  struct DirectoryBatch {
+    std::vector<HostDirectoryEntry> entries;
+
+    // Index into |entries| by entry name. Keys refer to the names held by
+    // |entries|.
+    absl::flat_hash_map<absl::string_view, size_t> index;
+
+    // Index of the next entry returned by ReadDirectory.
+    size_t next = 0;
+  };
+
+  // Returns true if the io_uring instance may serve an operation passed
+  // |flags| on the host file descriptor. Waits in the ring are not interrupted
+  // by signals, so only operations which cannot block indefinitely are served
+  // through it: those on regular files, on non-blocking descriptors, or passed
+  // MSG_DONTWAIT. Other operations stay on host calls, which return EINTR.
+  bool UseIoUring(int flags = 0);
+
   // Host file descriptor implementing this stream.
   int host_fd_;
-  void FillIov(const char *buf, int size, const struct iovec *iov, int iovcnt);
+
+  // Whether operations on |host_fd_| never block, or -1 if not determined
+  // since the descriptor was opened or its status flags last changed.
+  std::atomic<int> never_blocks_{-1};
+
+  absl::Mutex directory_lock_;
+
+  // The current batch of a directory stream, created on the first call to
+  // ReadDirectory.
+  std::unique_ptr<DirectoryBatch> directory_batch_
+      ABSL_GUARDED_BY(directory_lock_);
+};
+
+// IOContextNative variant for regular host files which serves reads from a
+// trusted PageCache. The file offset is tracked inside the enclave and all host
+// accesses are positional, so reads which hit the cache do not leave the
+// enclave. Writes go through to the host and update the cache.
+class IOContextCachedFile : public IOContextNative {
+ public:
+  // Number of blocks read ahead when a read continues where the previous one
+  // ended.
+  static constexpr size_t kReadAheadBlocks = 8;
+
+  // Reads larger than this bypass the cache.
+  static constexpr size_t kMaxCachedReadSize = 64 * PageCache::kBlockSize;
+
+  IOContextCachedFile(int host_fd, std::shared_ptr<PageCache> cache,
+                      const PageCache::FileKey &file)
+      : IOContextNative(host_fd), cache_(std::move(cache)), file_(file) {}
+
+  ssize_t Read(void *buf, size_t count) override;
+  ssize_t Write(const void *buf, size_t count) override;
+  int LSeek(off_t offset, int whence) override;
+  int FTruncate(off_t length) override;
+  ssize_t Writev(const struct iovec *iov, int iovcnt) override;
+  ssize_t Readv(const struct iovec *iov, int iovcnt) override;
+  ssize_t PRead(void *buf, size_t count, off_t offset) override;
+  ssize_t PWritev(const struct iovec *iov, int iovcnt, off_t offset) override;
+  ssize_t PReadv(const struct iovec *iov, int iovcnt, off_t offset) override;
+
+  // Host transfers would bypass both the cache and the file offset kept here.
+  int GetHostTransferFileDescriptor() override { return -1; }
+
+ private:
+  // Reads into the buffers of |iov| at |offset| through the cache.
+  ssize_t CachedPReadv(const struct iovec *iov, int iovcnt, off_t offset)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Writes the buffers of |iov| at |offset| to the host and the cache.
+  ssize_t ThroughPWritev(const struct iovec *iov, int iovcnt, off_t offset)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Reads |count| bytes at |offset| through the cache.
+  ssize_t CachedPRead(char *buf, size_t count, off_t offset)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  const std::shared_ptr<PageCache> cache_;
+  const PageCache::FileKey file_;
+
+  absl::Mutex lock_;
+
+  // The file offset used by Read() and Write().
+  off_t position_ ABSL_GUARDED_BY(lock_) = 0;
+
+  // The block following the last block read, used to detect sequential reads.
+  uint64_t next_block_ ABSL_GUARDED_BY(lock_) = 0;
+};
+
+// IOContextNative variant for host output streams such as standard out and
+// standard error, which buffers writes inside the enclave to save host calls.
+// Operations which depend on the stream position flush the buffer first.
+class IOContextBufferedNative : public IOContextNative {
+ public:
+  IOContextBufferedNative(int host_fd, const OutputBufferOptions &options)
+      : IOContextNative(host_fd),
+        buffer_(options, [this](const void *data, size_t size) {
+          return IOContextNative::Write(data, size);
+        }) {}
+
+  ssize_t Write(const void *buf, size_t count) override;
+  ssize_t Writev(const struct iovec *iov, int iovcnt) override;
+  int LSeek(off_t offset, int whence) override;
+  int FSync() override;
+  int Close() override;
+  int FTruncate(off_t length) override;
+  ssize_t PWritev(const struct iovec *iov, int iovcnt, off_t offset) override;
+
+  // Host transfers would overtake buffered data.
+  int GetHostTransferFileDescriptor() override { return -1; }
+
+ private:
+  OutputBuffer buffer_;
 };
 
 // VirtualPathHandler implementation handling paths to be forwarded to the host.
 class NativePathHandler : public io::IOManager::VirtualPathHandler {
  public:
+  NativePathHandler() = default;
+
+  // Creates a handler which serves reads of regular files from |page_cache|.
+  explicit NativePathHandler(std::shared_ptr<PageCache> page_cache)
+      : page_cache_(std::move(page_cache)) {}
+
   std::unique_ptr<io::IOManager::IOContext> Open(const char *path, int flags,
                                                  mode_t mode) override;
 
@@ -110,6 +251,10 @@ class NativePathHandler : public io::IOManager::VirtualPathHandler {
   int Utimes(const char *filename, const struct timeval times[2]) override;
   int InotifyAddWatch(std::shared_ptr<IOManager::IOContext> context,
                       const char *pathname, uint32_t mask) override;
+
+ private:
+  // Cache for file reads, or nullptr if reads are not cached.
+  std::shared_ptr<PageCache> page_cache_;
 };
 
 }  // namespace io
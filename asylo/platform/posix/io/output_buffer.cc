@@ -0,0 +1,210 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/io/output_buffer.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+
+#include <cstring>
+#include <utility>
+
+#include "absl/container/flat_hash_set.h"
+#include "asylo/platform/common/time_util.h"
+
+namespace asylo {
+namespace io {
+namespace {
+
+// The set of live buffers flushed by OutputBuffer::FlushAll().
+struct BufferRegistry {
+  absl::Mutex lock;
+  absl::flat_hash_set<OutputBuffer *> buffers ABSL_GUARDED_BY(lock);
+};
+
+BufferRegistry *GetBufferRegistry() {
+  static BufferRegistry *registry = new BufferRegistry();
+  return registry;
+}
+
+int64_t MonotonicNanoseconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return TimeSpecToNanoseconds(&ts);
+}
+
+}  // namespace
+
+OutputBuffer::OutputBuffer(const OutputBufferOptions &options, Sink sink,
+                           Clock clock)
+    : options_(options),
+      sink_(std::move(sink)),
+      clock_(clock ? std::move(clock) : MonotonicNanoseconds) {
+  BufferRegistry *registry = GetBufferRegistry();
+  absl::MutexLock lock(&registry->lock);
+  registry->buffers.insert(this);
+}
+
+OutputBuffer::~OutputBuffer() {
+  {
+    BufferRegistry *registry = GetBufferRegistry();
+    absl::MutexLock lock(&registry->lock);
+    registry->buffers.erase(this);
+  }
+  Flush();
+}
+
+ssize_t OutputBuffer::Write(const void *buf, size_t count) {
+  struct iovec iov;
+  iov.iov_base = const_cast<void *>(buf);
+  iov.iov_len = count;
+  absl::MutexLock lock(&lock_);
+  return AppendLocked(&iov, 1, count);
+}
+
+ssize_t OutputBuffer::Writev(const struct iovec *iov, int iovcnt) {
+  if (iovcnt < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  size_t count = 0;
+  for (int i = 0; i < iovcnt; ++i) {
+    if (iov[i].iov_len > SSIZE_MAX - count) {
+      errno = EINVAL;
+      return -1;
+    }
+    count += iov[i].iov_len;
+  }
+  absl::MutexLock lock(&lock_);
+  return AppendLocked(iov, iovcnt, count);
+}
+
+int OutputBuffer::Flush() {
+  absl::MutexLock lock(&lock_);
+  return FlushLocked();
+}
+
+size_t OutputBuffer::BufferedSize() {
+  absl::MutexLock lock(&lock_);
+  return buffer_.size();
+}
+
+void OutputBuffer::FlushAll() {
+  BufferRegistry *registry = GetBufferRegistry();
+  absl::MutexLock lock(&registry->lock);
+  for (OutputBuffer *buffer : registry->buffers) {
+    buffer->Flush();
+  }
+}
+
+void OutputBuffer::FlushAllBestEffort() {
+  BufferRegistry *registry = GetBufferRegistry();
+  if (!registry->lock.TryLock()) {
+    return;
+  }
+  for (OutputBuffer *buffer : registry->buffers) {
+    if (buffer->lock_.TryLock()) {
+      buffer->FlushLocked();
+      buffer->lock_.Unlock();
+    }
+  }
+  registry->lock.Unlock();
+}
+
+ssize_t OutputBuffer::AppendLocked(const struct iovec *iov, int iovcnt,
+                                   size_t count) {
+  if (count == 0) {
+    return 0;
+  }
+
+  // Data which would not fit an empty buffer is written through, after the
+  // buffered data to preserve ordering.
+  if (options_.policy == FlushPolicy::kUnbuffered ||
+      count >= options_.capacity) {
+    if (FlushLocked() != 0) {
+      return -1;
+    }
+    for (int i = 0; i < iovcnt; ++i) {
+      if (!WriteFully(reinterpret_cast<const char *>(iov[i].iov_base),
+                      iov[i].iov_len)) {
+        return -1;
+      }
+    }
+    return count;
+  }
+
+  if (buffer_.size() + count > options_.capacity && FlushLocked() != 0) {
+    return -1;
+  }
+
+  const bool time_bounded = options_.policy == FlushPolicy::kTimeBounded;
+  const int64_t now = time_bounded ? clock_() : 0;
+  if (buffer_.empty()) {
+    oldest_write_time_ = now;
+  }
+  bool wrote_newline = false;
+  for (int i = 0; i < iovcnt; ++i) {
+    const char *data = reinterpret_cast<const char *>(iov[i].iov_base);
+    buffer_.append(data, iov[i].iov_len);
+    if (options_.policy == FlushPolicy::kLine && !wrote_newline &&
+        memchr(data, '\n', iov[i].iov_len)) {
+      wrote_newline = true;
+    }
+  }
+
+  if (wrote_newline || buffer_.size() >= options_.capacity ||
+      (time_bounded &&
+       now - oldest_write_time_ >= options_.max_delay_nanoseconds)) {
+    if (FlushLocked() != 0) {
+      return -1;
+    }
+  }
+  return count;
+}
+
+int OutputBuffer::FlushLocked() {
+  if (buffer_.empty()) {
+    return 0;
+  }
+  bool success = WriteFully(buffer_.data(), buffer_.size());
+  buffer_.clear();
+  return success ? 0 : -1;
+}
+
+bool OutputBuffer::WriteFully(const char *data, size_t size) {
+  while (size > 0) {
+    ssize_t result = sink_(data, size);
+    if (result < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    if (result == 0) {
+      errno = EIO;
+      return false;
+    }
+    data += result;
+    size -= result;
+  }
+  return true;
+}
+
+}  // namespace io
+}  // namespace asylo
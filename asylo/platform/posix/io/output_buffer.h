@@ -0,0 +1,146 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_POSIX_IO_OUTPUT_BUFFER_H_
+#define ASYLO_PLATFORM_POSIX_IO_OUTPUT_BUFFER_H_
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+
+namespace asylo {
+namespace io {
+
+// Determines when an OutputBuffer passes buffered data on to its sink.
+enum class FlushPolicy {
+  // Every write goes straight to the sink.
+  kUnbuffered,
+
+  // Data is flushed after every write containing a newline, and whenever the
+  // buffer is full.
+  kLine,
+
+  // Data is flushed only when the buffer is full.
+  kSize,
+
+  // As kSize, and additionally data is flushed by the first write which
+  // happens |max_delay_nanoseconds| or more after the oldest buffered byte was
+  // written.
+  kTimeBounded,
+};
+
+struct OutputBufferOptions {
+  FlushPolicy policy = FlushPolicy::kUnbuffered;
+
+  // Number of bytes buffered before a flush is forced.
+  size_t capacity = 4096;
+
+  // Bound on the age of buffered data for FlushPolicy::kTimeBounded.
+  int64_t max_delay_nanoseconds = 100 * 1000 * 1000;
+};
+
+// A write buffer in trusted memory which coalesces small writes to a stream
+// outside the enclave, such as the host's standard output or log, into fewer,
+// larger writes.
+//
+// There is no timer inside the enclave, so data is only flushed by writes,
+// explicit calls to Flush(), and FlushAll() and FlushAllBestEffort() on exit
+// and abort. In particular, FlushPolicy::kTimeBounded bounds the age of
+// buffered data only while the stream keeps being written to. Messages which
+// must reach the host even if the enclave dies immediately afterwards should
+// bypass the buffer, e.g. through TrustedPrimitives::DebugPuts.
+//
+// This class is thread safe.
+class OutputBuffer {
+ public:
+  // Writes |size| bytes of |data| to the underlying stream. Returns the number
+  // of bytes written, which may be fewer than |size|, or -1 and sets errno.
+  using Sink = std::function<ssize_t(const void *data, size_t size)>;
+
+  // Returns a monotonic time in nanoseconds.
+  using Clock = std::function<int64_t()>;
+
+  // Creates a buffer writing to |sink| according to |options|. |clock| is only
+  // consulted for FlushPolicy::kTimeBounded, and defaults to CLOCK_MONOTONIC.
+  OutputBuffer(const OutputBufferOptions &options, Sink sink,
+               Clock clock = nullptr);
+
+  // Flushes any buffered data.
+  ~OutputBuffer();
+
+  OutputBuffer(const OutputBuffer &other) = delete;
+  OutputBuffer &operator=(const OutputBuffer &other) = delete;
+
+  // Appends |count| bytes of |buf| to the buffer, flushing as required by the
+  // flush policy. Writes which do not fit the buffer go directly to the sink
+  // after the buffered data. Returns |count|, or -1 and sets errno if a flush
+  // failed, in which case the data buffered at the time is dropped.
+  ssize_t Write(const void *buf, size_t count) ABSL_LOCKS_EXCLUDED(lock_);
+
+  // As Write() for the concatenation of the buffers of |iov|.
+  ssize_t Writev(const struct iovec *iov, int iovcnt)
+      ABSL_LOCKS_EXCLUDED(lock_);
+
+  // Passes all buffered data to the sink. Returns 0 on success, or -1 and sets
+  // errno, in which case the buffered data is dropped.
+  int Flush() ABSL_LOCKS_EXCLUDED(lock_);
+
+  // Returns the number of bytes currently buffered.
+  size_t BufferedSize() ABSL_LOCKS_EXCLUDED(lock_);
+
+  // Flushes every live OutputBuffer.
+  static void FlushAll();
+
+  // Flushes every live OutputBuffer which is not in use by another thread,
+  // without blocking. Intended for abort paths, which may be reached while the
+  // aborting thread itself holds a buffer.
+  static void FlushAllBestEffort();
+
+ private:
+  // Appends the |iovcnt| buffers of |iov|, holding |count| bytes in total.
+  ssize_t AppendLocked(const struct iovec *iov, int iovcnt, size_t count)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  int FlushLocked() ABSL_EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Writes all |size| bytes of |data| to the sink.
+  bool WriteFully(const char *data, size_t size)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  const OutputBufferOptions options_;
+  const Sink sink_;
+  const Clock clock_;
+
+  absl::Mutex lock_;
+  std::string buffer_ ABSL_GUARDED_BY(lock_);
+
+  // Time at which the oldest byte in |buffer_| was written.
+  int64_t oldest_write_time_ ABSL_GUARDED_BY(lock_) = 0;
+};
+
+}  // namespace io
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_POSIX_IO_OUTPUT_BUFFER_H_
@@ -0,0 +1,171 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/io/output_buffer.h"
+
+#include <errno.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/memory/memory.h"
+
+namespace asylo {
+namespace io {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::IsEmpty;
+using ::testing::UnorderedElementsAre;
+
+// Records the writes an OutputBuffer makes to its sink.
+class OutputBufferTest : public ::testing::Test {
+ protected:
+  std::unique_ptr<OutputBuffer> MakeBuffer(FlushPolicy policy,
+                                           size_t capacity = 16) {
+    OutputBufferOptions options;
+    options.policy = policy;
+    options.capacity = capacity;
+    options.max_delay_nanoseconds = 100;
+    return absl::make_unique<OutputBuffer>(
+        options,
+        [this](const void *data, size_t size) -> ssize_t {
+          if (fail_writes_) {
+            errno = EPIPE;
+            return -1;
+          }
+          size = std::min(size, max_write_size_);
+          writes_.emplace_back(reinterpret_cast<const char *>(data), size);
+          return size;
+        },
+        [this] { return now_; });
+  }
+
+  std::vector<std::string> writes_;
+  size_t max_write_size_ = SIZE_MAX;
+  bool fail_writes_ = false;
+  int64_t now_ = 0;
+};
+
+TEST_F(OutputBufferTest, UnbufferedWritesThrough) {
+  auto buffer = MakeBuffer(FlushPolicy::kUnbuffered);
+  EXPECT_THAT(buffer->Write("ab", 2), Eq(2));
+  EXPECT_THAT(buffer->Write("cd", 2), Eq(2));
+  EXPECT_THAT(writes_, ElementsAre("ab", "cd"));
+}
+
+TEST_F(OutputBufferTest, LineModeFlushesOnNewline) {
+  auto buffer = MakeBuffer(FlushPolicy::kLine);
+  EXPECT_THAT(buffer->Write("ab", 2), Eq(2));
+  EXPECT_THAT(buffer->Write("c\nd", 3), Eq(3));
+  EXPECT_THAT(writes_, ElementsAre("abc\nd"));
+  EXPECT_THAT(buffer->BufferedSize(), Eq(0));
+}
+
+TEST_F(OutputBufferTest, SizeModeFlushesWhenFull) {
+  auto buffer = MakeBuffer(FlushPolicy::kSize, /*capacity=*/4);
+  EXPECT_THAT(buffer->Write("a\n", 2), Eq(2));
+  EXPECT_THAT(writes_, IsEmpty());
+  EXPECT_THAT(buffer->Write("bcd", 3), Eq(3));
+  EXPECT_THAT(writes_, ElementsAre("a\n"));
+  EXPECT_THAT(buffer->Write("e", 1), Eq(1));
+  EXPECT_THAT(writes_, ElementsAre("a\n", "bcde"));
+}
+
+TEST_F(OutputBufferTest, LargeWritesGoThroughInOrder) {
+  auto buffer = MakeBuffer(FlushPolicy::kSize, /*capacity=*/4);
+  EXPECT_THAT(buffer->Write("a", 1), Eq(1));
+  EXPECT_THAT(buffer->Write("bcdefg", 6), Eq(6));
+  EXPECT_THAT(writes_, ElementsAre("a", "bcdefg"));
+}
+
+TEST_F(OutputBufferTest, TimeBoundedModeFlushesOldData) {
+  auto buffer = MakeBuffer(FlushPolicy::kTimeBounded);
+  EXPECT_THAT(buffer->Write("a", 1), Eq(1));
+  now_ = 99;
+  EXPECT_THAT(buffer->Write("b", 1), Eq(1));
+  EXPECT_THAT(writes_, IsEmpty());
+  now_ = 100;
+  EXPECT_THAT(buffer->Write("c", 1), Eq(1));
+  EXPECT_THAT(writes_, ElementsAre("abc"));
+
+  // The age of the buffer is measured from the first write after a flush.
+  now_ = 150;
+  EXPECT_THAT(buffer->Write("d", 1), Eq(1));
+  now_ = 200;
+  EXPECT_THAT(buffer->Write("e", 1), Eq(1));
+  EXPECT_THAT(writes_, ElementsAre("abc"));
+}
+
+TEST_F(OutputBufferTest, WritevAppendsAllBuffers) {
+  auto buffer = MakeBuffer(FlushPolicy::kLine);
+  char first[] = "ab";
+  char second[] = "c\n";
+  struct iovec iov[] = {{first, 2}, {second, 2}};
+  EXPECT_THAT(buffer->Writev(iov, 2), Eq(4));
+  EXPECT_THAT(writes_, ElementsAre("abc\n"));
+}
+
+TEST_F(OutputBufferTest, FlushRetriesPartialWrites) {
+  auto buffer = MakeBuffer(FlushPolicy::kSize);
+  max_write_size_ = 2;
+  EXPECT_THAT(buffer->Write("abcde", 5), Eq(5));
+  EXPECT_THAT(buffer->Flush(), Eq(0));
+  EXPECT_THAT(writes_, ElementsAre("ab", "cd", "e"));
+}
+
+TEST_F(OutputBufferTest, FailedFlushDropsData) {
+  auto buffer = MakeBuffer(FlushPolicy::kSize);
+  EXPECT_THAT(buffer->Write("abc", 3), Eq(3));
+  fail_writes_ = true;
+  errno = 0;
+  EXPECT_THAT(buffer->Flush(), Eq(-1));
+  EXPECT_THAT(errno, Eq(EPIPE));
+  EXPECT_THAT(buffer->BufferedSize(), Eq(0));
+}
+
+TEST_F(OutputBufferTest, FlushAllFlushesLiveBuffers) {
+  auto first = MakeBuffer(FlushPolicy::kSize);
+  auto second = MakeBuffer(FlushPolicy::kSize);
+  EXPECT_THAT(first->Write("a", 1), Eq(1));
+  EXPECT_THAT(second->Write("b", 1), Eq(1));
+  OutputBuffer::FlushAllBestEffort();
+  EXPECT_THAT(writes_, UnorderedElementsAre("a", "b"));
+
+  EXPECT_THAT(first->Write("c", 1), Eq(1));
+  OutputBuffer::FlushAll();
+  EXPECT_THAT(writes_, UnorderedElementsAre("a", "b", "c"));
+}
+
+TEST_F(OutputBufferTest, DestructorFlushes) {
+  auto buffer = MakeBuffer(FlushPolicy::kSize);
+  EXPECT_THAT(buffer->Write("abc", 3), Eq(3));
+  buffer.reset();
+  EXPECT_THAT(writes_, ElementsAre("abc"));
+}
+
+}  // namespace
+}  // namespace io
+}  // namespace asylo
@@ -0,0 +1,154 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/io/page_cache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+namespace asylo {
+namespace io {
+
+constexpr size_t PageCache::kBlockSize;
+
+PageCache::FileKey PageCache::FileKey::FromStat(
+    const struct stat &stat_buffer) {
+  FileKey key;
+  key.device = stat_buffer.st_dev;
+  key.inode = stat_buffer.st_ino;
+  key.mtime_sec = stat_buffer.st_mtim.tv_sec;
+  key.mtime_nsec = stat_buffer.st_mtim.tv_nsec;
+  return key;
+}
+
+PageCache::PageCache(size_t capacity) : capacity_(capacity) {}
+
+ssize_t PageCache::Read(const FileKey &file, uint64_t block, size_t offset,
+                        void *buffer, size_t count) {
+  absl::MutexLock lock(&lock_);
+  auto it = blocks_.find({file, block});
+  if (it == blocks_.end()) {
+    return -1;
+  }
+  Touch(it->second);
+  const Block &cached = *it->second;
+  if (offset >= cached.size) {
+    return 0;
+  }
+  size_t copied = std::min(count, cached.size - offset);
+  memcpy(buffer, cached.data.get() + offset, copied);
+  return copied;
+}
+
+void PageCache::Insert(const FileKey &file, uint64_t block, const void *data,
+                       size_t size) {
+  size = std::min(size, kBlockSize);
+  if (size == 0 || capacity_ < kBlockSize) {
+    return;
+  }
+  absl::MutexLock lock(&lock_);
+  BlockKey key(file, block);
+  auto it = blocks_.find(key);
+  if (it != blocks_.end()) {
+    Erase(it);
+  }
+  while (size_ + kBlockSize > capacity_ && !lru_.empty()) {
+    Erase(blocks_.find(lru_.back().key));
+  }
+  Block cached{key, size, std::unique_ptr<char[]>(new char[kBlockSize])};
+  memcpy(cached.data.get(), data, size);
+  lru_.push_front(std::move(cached));
+  blocks_.emplace(key, lru_.begin());
+  size_ += kBlockSize;
+}
+
+void PageCache::Write(const FileKey &file, off_t offset, const void *data,
+                      size_t size) {
+  if (offset < 0 || size == 0) {
+    return;
+  }
+  auto source = static_cast<const char *>(data);
+  absl::MutexLock lock(&lock_);
+  uint64_t first = offset / kBlockSize;
+  uint64_t last = (offset + size - 1) / kBlockSize;
+  auto it = blocks_.lower_bound({file, first});
+  if (it != blocks_.begin()) {
+    // A short block before the write ends at the old end of the file, which
+    // the write may have moved.
+    auto previous = std::prev(it);
+    if (!(previous->first.first < file) &&
+        previous->second->size < kBlockSize) {
+      Erase(previous);
+    }
+  }
+  while (it != blocks_.end() && !(file < it->first.first) &&
+         !(it->first.first < file) && it->first.second <= last) {
+    Block &cached = *it->second;
+    off_t block_start = it->first.second * kBlockSize;
+    off_t begin = std::max(offset, block_start);
+    off_t end = std::min<off_t>(offset + size, block_start + kBlockSize);
+    size_t begin_in_block = begin - block_start;
+    if (begin_in_block > cached.size) {
+      // The write leaves a hole after the cached end of the file.
+      Erase(it++);
+      continue;
+    }
+    memcpy(cached.data.get() + begin_in_block, source + (begin - offset),
+           end - begin);
+    cached.size = std::max<size_t>(cached.size, end - block_start);
+    ++it;
+  }
+}
+
+void PageCache::Invalidate(const FileKey &file) {
+  absl::MutexLock lock(&lock_);
+  auto it = blocks_.lower_bound({file, 0});
+  while (it != blocks_.end() && !(file < it->first.first)) {
+    Erase(it++);
+  }
+}
+
+size_t PageCache::Shrink(size_t target) {
+  absl::MutexLock lock(&lock_);
+  size_t evicted = 0;
+  while (size_ > target && !lru_.empty()) {
+    Erase(blocks_.find(lru_.back().key));
+    evicted += kBlockSize;
+  }
+  return evicted;
+}
+
+size_t PageCache::size() const {
+  absl::MutexLock lock(&lock_);
+  return size_;
+}
+
+void PageCache::Touch(std::list<Block>::iterator it) {
+  lru_.splice(lru_.begin(), lru_, it);
+}
+
+void PageCache::Erase(
+    std::map<BlockKey, std::list<Block>::iterator>::iterator it) {
+  lru_.erase(it->second);
+  blocks_.erase(it);
+  size_ -= kBlockSize;
+}
+
+}  // namespace io
+}  // namespace asylo
@@ -0,0 +1,137 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_POSIX_IO_PAGE_CACHE_H_
+#define ASYLO_PLATFORM_POSIX_IO_PAGE_CACHE_H_
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <tuple>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+
+namespace asylo {
+namespace io {
+
+// A block cache in trusted memory for the contents of host files. Blocks are
+// keyed by the identity of the file they belong to, which includes the file's
+// modification time, so a file changed on the host is cached afresh the next
+// time it is opened. The least recently used blocks are evicted once the cache
+// exceeds its size budget.
+//
+// A cached block shorter than kBlockSize ends at the end of the file as it was
+// when the block was cached.
+//
+// This class is thread safe.
+class PageCache {
+ public:
+  static constexpr size_t kBlockSize = 4096;
+
+  // Identifies a version of a host file.
+  struct FileKey {
+    uint64_t device;
+    uint64_t inode;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+
+    // Returns the key of the file described by |stat_buffer|.
+    static FileKey FromStat(const struct stat &stat_buffer);
+
+    bool operator<(const FileKey &other) const {
+      return std::tie(device, inode, mtime_sec, mtime_nsec) <
+             std::tie(other.device, other.inode, other.mtime_sec,
+                      other.mtime_nsec);
+    }
+  };
+
+  // Creates a cache holding at most |capacity| bytes of file contents.
+  explicit PageCache(size_t capacity);
+
+  PageCache(const PageCache &other) = delete;
+  PageCache &operator=(const PageCache &other) = delete;
+
+  // Copies up to |count| bytes starting |offset| bytes into block |block| of
+  // |file| to |buffer|. Returns the number of bytes copied, which is only
+  // smaller than min(|count|, kBlockSize - |offset|) at the end of the file, or
+  // -1 if the block is not cached.
+  ssize_t Read(const FileKey &file, uint64_t block, size_t offset,
+               void *buffer, size_t count);
+
+  // Caches the first |size| bytes of block |block| of |file| from |data|.
+  // Empty blocks are not cached.
+  void Insert(const FileKey &file, uint64_t block, const void *data,
+              size_t size);
+
+  // Applies a write of |size| bytes from |data| at |offset| in |file| to the
+  // cached blocks of |file|, which must already have been written to the host.
+  // Cached blocks which the write does not extend contiguously are dropped.
+  void Write(const FileKey &file, off_t offset, const void *data,
+             size_t size);
+
+  // Drops every cached block of |file|.
+  void Invalidate(const FileKey &file);
+
+  // Evicts the least recently used blocks until at most |target| bytes are
+  // cached. Returns the number of bytes evicted.
+  size_t Shrink(size_t target);
+
+  // Returns the number of bytes of file contents currently cached.
+  size_t size() const;
+
+ private:
+  using BlockKey = std::pair<FileKey, uint64_t>;
+
+  struct Block {
+    BlockKey key;
+    size_t size;
+    std::unique_ptr<char[]> data;
+  };
+
+  // Marks the block at |it| as the most recently used block.
+  void Touch(std::list<Block>::iterator it)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Removes the block at |it| from the cache.
+  void Erase(std::map<BlockKey, std::list<Block>::iterator>::iterator it)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  const size_t capacity_;
+
+  mutable absl::Mutex lock_;
+
+  // Cached blocks, most recently used first.
+  std::list<Block> lru_ ABSL_GUARDED_BY(lock_);
+
+  // The cached blocks ordered by file and block number.
+  std::map<BlockKey, std::list<Block>::iterator> blocks_
+      ABSL_GUARDED_BY(lock_);
+
+  size_t size_ ABSL_GUARDED_BY(lock_) = 0;
+};
+
+}  // namespace io
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_POSIX_IO_PAGE_CACHE_H_
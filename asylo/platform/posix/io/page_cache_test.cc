@@ -0,0 +1,144 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/io/page_cache.h"
+
+#include <string>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace io {
+namespace {
+
+using ::testing::Eq;
+
+constexpr size_t kBlockSize = PageCache::kBlockSize;
+
+PageCache::FileKey MakeKey(uint64_t inode, int64_t mtime) {
+  return PageCache::FileKey{/*device=*/1, inode, mtime, /*mtime_nsec=*/0};
+}
+
+// Reads |count| bytes at |offset| of |block| as a string, or returns "<miss>".
+std::string ReadBlock(PageCache *cache, const PageCache::FileKey &file,
+                      uint64_t block, size_t offset = 0,
+                      size_t count = kBlockSize) {
+  std::string buffer(count, '\0');
+  ssize_t result = cache->Read(file, block, offset, &buffer[0], count);
+  if (result < 0) {
+    return "<miss>";
+  }
+  buffer.resize(result);
+  return buffer;
+}
+
+TEST(PageCacheTest, ReadsInsertedBlocks) {
+  PageCache cache(4 * kBlockSize);
+  PageCache::FileKey file = MakeKey(1, 1);
+  std::string block(kBlockSize, 'a');
+  cache.Insert(file, 0, block.data(), block.size());
+  cache.Insert(file, 1, "tail", 4);
+
+  EXPECT_THAT(ReadBlock(&cache, file, 0), Eq(block));
+  EXPECT_THAT(ReadBlock(&cache, file, 0, kBlockSize - 2), Eq("aa"));
+  EXPECT_THAT(ReadBlock(&cache, file, 1), Eq("tail"));
+  EXPECT_THAT(ReadBlock(&cache, file, 1, 8), Eq(""));
+  EXPECT_THAT(ReadBlock(&cache, file, 2), Eq("<miss>"));
+}
+
+TEST(PageCacheTest, KeysIncludeModificationTime) {
+  PageCache cache(4 * kBlockSize);
+  cache.Insert(MakeKey(1, 1), 0, "old", 3);
+  EXPECT_THAT(ReadBlock(&cache, MakeKey(1, 2), 0), Eq("<miss>"));
+  EXPECT_THAT(ReadBlock(&cache, MakeKey(2, 1), 0), Eq("<miss>"));
+  EXPECT_THAT(ReadBlock(&cache, MakeKey(1, 1), 0), Eq("old"));
+}
+
+TEST(PageCacheTest, EvictsLeastRecentlyUsedBlock) {
+  PageCache cache(2 * kBlockSize);
+  PageCache::FileKey file = MakeKey(1, 1);
+  cache.Insert(file, 0, "zero", 4);
+  cache.Insert(file, 1, "one", 3);
+  EXPECT_THAT(ReadBlock(&cache, file, 0), Eq("zero"));
+  cache.Insert(file, 2, "two", 3);
+
+  EXPECT_THAT(ReadBlock(&cache, file, 1), Eq("<miss>"));
+  EXPECT_THAT(ReadBlock(&cache, file, 0), Eq("zero"));
+  EXPECT_THAT(ReadBlock(&cache, file, 2), Eq("two"));
+  EXPECT_THAT(cache.size(), Eq(2 * kBlockSize));
+}
+
+TEST(PageCacheTest, ShrinkEvictsLeastRecentlyUsedBlocks) {
+  PageCache cache(4 * kBlockSize);
+  PageCache::FileKey file = MakeKey(1, 1);
+  cache.Insert(file, 0, "zero", 4);
+  cache.Insert(file, 1, "one", 3);
+  cache.Insert(file, 2, "two", 3);
+  EXPECT_THAT(ReadBlock(&cache, file, 0), Eq("zero"));
+
+  EXPECT_THAT(cache.Shrink(kBlockSize), Eq(2 * kBlockSize));
+  EXPECT_THAT(cache.size(), Eq(kBlockSize));
+  EXPECT_THAT(ReadBlock(&cache, file, 0), Eq("zero"));
+  EXPECT_THAT(ReadBlock(&cache, file, 1), Eq("<miss>"));
+  EXPECT_THAT(cache.Shrink(kBlockSize), Eq(0));
+}
+
+TEST(PageCacheTest, WritesUpdateCachedBlocks) {
+  PageCache cache(4 * kBlockSize);
+  PageCache::FileKey file = MakeKey(1, 1);
+  std::string block(kBlockSize, 'a');
+  cache.Insert(file, 0, block.data(), block.size());
+  cache.Insert(file, 1, "bbbb", 4);
+
+  // Overwrite across the block boundary and extend the short last block.
+  cache.Write(file, kBlockSize - 2, "xxxxxx", 6);
+  EXPECT_THAT(ReadBlock(&cache, file, 0, kBlockSize - 3), Eq("axx"));
+  EXPECT_THAT(ReadBlock(&cache, file, 1), Eq("xxxx"));
+  cache.Write(file, kBlockSize + 4, "yy", 2);
+  EXPECT_THAT(ReadBlock(&cache, file, 1), Eq("xxxxyy"));
+}
+
+TEST(PageCacheTest, WritesPastTheEndDropShortBlocks) {
+  PageCache cache(4 * kBlockSize);
+  PageCache::FileKey file = MakeKey(1, 1);
+  cache.Insert(file, 0, "short", 5);
+  cache.Write(file, 3 * kBlockSize, "far", 3);
+  EXPECT_THAT(ReadBlock(&cache, file, 0), Eq("<miss>"));
+
+  cache.Insert(file, 0, "short", 5);
+  cache.Write(file, 16, "gap", 3);
+  EXPECT_THAT(ReadBlock(&cache, file, 0), Eq("<miss>"));
+}
+
+TEST(PageCacheTest, InvalidateDropsOnlyThatFile) {
+  PageCache cache(4 * kBlockSize);
+  cache.Insert(MakeKey(1, 1), 0, "one", 3);
+  cache.Insert(MakeKey(1, 1), 5, "five", 4);
+  cache.Insert(MakeKey(2, 1), 0, "other", 5);
+  cache.Invalidate(MakeKey(1, 1));
+
+  EXPECT_THAT(ReadBlock(&cache, MakeKey(1, 1), 0), Eq("<miss>"));
+  EXPECT_THAT(ReadBlock(&cache, MakeKey(1, 1), 5), Eq("<miss>"));
+  EXPECT_THAT(ReadBlock(&cache, MakeKey(2, 1), 0), Eq("other"));
+  EXPECT_THAT(cache.size(), Eq(kBlockSize));
+}
+
+}  // namespace
+}  // namespace io
+}  // namespace asylo
@@ -0,0 +1,132 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_POSIX_IO_PATH_TRIE_H_
+#define ASYLO_PLATFORM_POSIX_IO_PATH_TRIE_H_
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+
+namespace asylo {
+namespace io {
+namespace util {
+
+// A trie mapping path prefixes to values, keyed by path component. A prefix
+// matches a path if every component of the prefix equals the corresponding
+// component of the path, so "/dev/random" matches "/dev/random" and
+// "/dev/random/x" but not "/dev/randomx". Empty path components are ignored,
+// so the empty prefix and "/" are the same prefix, which matches every path.
+//
+// Lookups do not allocate memory. This class is not thread safe.
+template <typename T>
+class PathTrie {
+ public:
+  // Associates |value| with |prefix|. Does nothing and returns false if
+  // |prefix| already has a value.
+  bool Insert(absl::string_view prefix, T value) {
+    Node *node = &root_;
+    ForEachComponent(prefix, [&node](absl::string_view component) {
+      auto it = node->children.find(component);
+      if (it == node->children.end()) {
+        it = node->children
+                 .emplace(std::string(component), absl::make_unique<Node>())
+                 .first;
+      }
+      node = it->second.get();
+      return true;
+    });
+    if (node->value) {
+      return false;
+    }
+    node->value = std::move(value);
+    return true;
+  }
+
+  // Removes the value associated with |prefix|, if any.
+  void Erase(absl::string_view prefix) {
+    Node *node = &root_;
+    bool found = ForEachComponent(prefix, [&node](absl::string_view component) {
+      auto it = node->children.find(component);
+      if (it == node->children.end()) {
+        return false;
+      }
+      node = it->second.get();
+      return true;
+    });
+    if (found) {
+      node->value.reset();
+    }
+  }
+
+  // Returns the value associated with the longest prefix matching |path|, or
+  // nullptr if there is none.
+  const T *FindLongestPrefix(absl::string_view path) const {
+    const Node *node = &root_;
+    const T *match = node->value ? &*node->value : nullptr;
+    ForEachComponent(path, [&node, &match](absl::string_view component) {
+      auto it = node->children.find(component);
+      if (it == node->children.end()) {
+        return false;
+      }
+      node = it->second.get();
+      if (node->value) {
+        match = &*node->value;
+      }
+      return true;
+    });
+    return match;
+  }
+
+ private:
+  struct Node {
+    absl::optional<T> value;
+    absl::flat_hash_map<std::string, std::unique_ptr<Node>> children;
+  };
+
+  // Calls |visit| with each non-empty component of |path| in order until it
+  // returns false. Returns whether every component was visited.
+  template <typename Visitor>
+  static bool ForEachComponent(absl::string_view path, Visitor visit) {
+    size_t start = 0;
+    while (start < path.size()) {
+      size_t end = path.find('/', start);
+      if (end == absl::string_view::npos) {
+        end = path.size();
+      }
+      if (end > start && !visit(path.substr(start, end - start))) {
+        return false;
+      }
+      start = end + 1;
+    }
+    return true;
+  }
+
+  Node root_;
+};
+
+}  // namespace util
+}  // namespace io
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_POSIX_IO_PATH_TRIE_H_
@@ -0,0 +1,96 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/io/path_trie.h"
+
+#include <string>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace io {
+namespace util {
+namespace {
+
+using ::testing::IsNull;
+using ::testing::Pointee;
+
+TEST(PathTrieTest, MatchesWholeComponents) {
+  PathTrie<std::string> trie;
+  ASSERT_TRUE(trie.Insert("/dev/random", "random"));
+
+  EXPECT_THAT(trie.FindLongestPrefix("/dev/random"),
+              Pointee(std::string("random")));
+  EXPECT_THAT(trie.FindLongestPrefix("/dev/random/x"),
+              Pointee(std::string("random")));
+  EXPECT_THAT(trie.FindLongestPrefix("/dev/randomx"), IsNull());
+  EXPECT_THAT(trie.FindLongestPrefix("/dev"), IsNull());
+  EXPECT_THAT(trie.FindLongestPrefix("/"), IsNull());
+}
+
+TEST(PathTrieTest, PrefersTheLongestPrefix) {
+  PathTrie<std::string> trie;
+  ASSERT_TRUE(trie.Insert("", "root"));
+  ASSERT_TRUE(trie.Insert("/dev", "dev"));
+  ASSERT_TRUE(trie.Insert("/dev/urandom", "urandom"));
+
+  EXPECT_THAT(trie.FindLongestPrefix("/"), Pointee(std::string("root")));
+  EXPECT_THAT(trie.FindLongestPrefix("/tmp/file"),
+              Pointee(std::string("root")));
+  EXPECT_THAT(trie.FindLongestPrefix("/dev/null"), Pointee(std::string("dev")));
+  EXPECT_THAT(trie.FindLongestPrefix("/dev/urandom"),
+              Pointee(std::string("urandom")));
+}
+
+TEST(PathTrieTest, SlashIsTheEmptyPrefix) {
+  PathTrie<std::string> trie;
+  ASSERT_TRUE(trie.Insert("/", "root"));
+  EXPECT_FALSE(trie.Insert("", "empty"));
+
+  EXPECT_THAT(trie.FindLongestPrefix("/tmp/file"),
+              Pointee(std::string("root")));
+}
+
+TEST(PathTrieTest, DoesNotReplaceValues) {
+  PathTrie<std::string> trie;
+  ASSERT_TRUE(trie.Insert("/a", "first"));
+  EXPECT_FALSE(trie.Insert("/a", "second"));
+  EXPECT_THAT(trie.FindLongestPrefix("/a"), Pointee(std::string("first")));
+}
+
+TEST(PathTrieTest, ErasesValues) {
+  PathTrie<std::string> trie;
+  ASSERT_TRUE(trie.Insert("/a", "a"));
+  ASSERT_TRUE(trie.Insert("/a/b", "b"));
+
+  trie.Erase("/a/b");
+  EXPECT_THAT(trie.FindLongestPrefix("/a/b"), Pointee(std::string("a")));
+  trie.Erase("/a");
+  EXPECT_THAT(trie.FindLongestPrefix("/a/b"), IsNull());
+
+  // Erasing a prefix without a value is harmless.
+  trie.Erase("/c/d");
+  EXPECT_TRUE(trie.Insert("/a", "again"));
+  EXPECT_THAT(trie.FindLongestPrefix("/a/b"), Pointee(std::string("again")));
+}
+
+}  // namespace
+}  // namespace util
+}  // namespace io
+}  // namespace asylo
@@ -22,6 +22,8 @@
 #include <sys/ioctl.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
 #include <string>
 #include <vector>
 
@@ -36,6 +38,7 @@
 #include "asylo/test/util/test_flags.h"
 #include "asylo/util/cleansing_types.h"
 #include "asylo/util/status.h"
+#include "asylo/util/thread.h"
 
 namespace asylo {
 namespace {
@@ -176,5 +179,111 @@ TEST_F(ReadWriteTest, ReadWriteSecureTest) {
   EXPECT_EQ(close(fd), 0);
 }
 
+TEST_F(ReadWriteTest, ReadWriteSecureBufferedTest) {
+  CleansingVector<uint8_t> secure_key;
+  secure_key.resize(kKeyLength);
+  ASSERT_EQ(RAND_bytes(secure_key.data(), secure_key.size()), 1)
+      << "RAND_bytes() failed";
+
+  struct key_info ioctl_param;
+  ioctl_param.length = secure_key.size();
+  ioctl_param.data = secure_key.data();
+
+  // Write the text in small unaligned chunks through a write buffer.
+  int fd = open(test_file_.get(), O_CREAT | O_RDWR | O_SECURE, 0644);
+  ASSERT_GE(fd, 0);
+  EXPECT_EQ(ioctl(fd, ENCLAVE_STORAGE_SET_KEY, &ioctl_param), 0);
+  uint64_t buffer_length = 2 * kBlockLength;
+  EXPECT_EQ(ioctl(fd, ENCLAVE_STORAGE_SET_WRITE_BUFFER, &buffer_length), 0);
+  const size_t text_length = strlen(kSecureTestText);
+  constexpr size_t kChunkLength = 7;
+  for (size_t offset = 0; offset < text_length; offset += kChunkLength) {
+    size_t length = std::min(kChunkLength, text_length - offset);
+    EXPECT_EQ(write(fd, kSecureTestText + offset, length), length);
+  }
+  EXPECT_EQ(lseek(fd, 0, SEEK_CUR), text_length);
+  EXPECT_EQ(close(fd), 0);
+
+  // Read the text back in small chunks with read-ahead.
+  fd = open(test_file_.get(), O_RDONLY | O_SECURE);
+  ASSERT_GE(fd, 0);
+  EXPECT_EQ(ioctl(fd, ENCLAVE_STORAGE_SET_KEY, &ioctl_param), 0);
+  uint64_t read_ahead_length = kBlockLength / 2;
+  EXPECT_EQ(ioctl(fd, ENCLAVE_STORAGE_SET_READ_AHEAD, &read_ahead_length), 0);
+  std::string contents;
+  char buf[kChunkLength];
+  ssize_t rc;
+  while ((rc = read(fd, buf, sizeof(buf))) > 0) {
+    contents.append(buf, rc);
+  }
+  EXPECT_EQ(rc, 0);
+  EXPECT_EQ(contents, kSecureTestText);
+
+  // Seeking discards the data read ahead.
+  constexpr off_t kOffset = 10;
+  ASSERT_EQ(lseek(fd, kOffset, SEEK_SET), kOffset);
+  ASSERT_EQ(read(fd, buf, sizeof(buf)), sizeof(buf));
+  EXPECT_EQ(lseek(fd, 0, SEEK_CUR), kOffset + sizeof(buf));
+  EXPECT_EQ(std::string(buf, sizeof(buf)),
+            std::string(kSecureTestText + kOffset, sizeof(buf)));
+
+  uint64_t too_long = 1ull << 40;
+  EXPECT_EQ(ioctl(fd, ENCLAVE_STORAGE_SET_READ_AHEAD, &too_long), -1);
+  EXPECT_EQ(close(fd), 0);
+}
+
+TEST_F(ReadWriteTest, ReadWriteSecureConcurrentPreadTest) {
+  CleansingVector<uint8_t> secure_key;
+  secure_key.resize(kKeyLength);
+  ASSERT_EQ(RAND_bytes(secure_key.data(), secure_key.size()), 1)
+      << "RAND_bytes() failed";
+
+  struct key_info ioctl_param;
+  ioctl_param.length = secure_key.size();
+  ioctl_param.data = secure_key.data();
+
+  int fd = open(test_file_.get(), O_CREAT | O_RDWR | O_SECURE, 0644);
+  ASSERT_GE(fd, 0);
+  EXPECT_EQ(ioctl(fd, ENCLAVE_STORAGE_SET_KEY, &ioctl_param), 0);
+  const size_t text_length = strlen(kSecureTestText);
+  ASSERT_EQ(write(fd, kSecureTestText, text_length), text_length);
+
+  // Positional reads do not move the cursor.
+  constexpr size_t kChunkLength = 13;
+  char buf[kChunkLength];
+  ASSERT_EQ(pread(fd, buf, sizeof(buf), 5), sizeof(buf));
+  EXPECT_EQ(std::string(buf, sizeof(buf)),
+            std::string(kSecureTestText + 5, sizeof(buf)));
+  EXPECT_EQ(lseek(fd, 0, SEEK_CUR), text_length);
+  EXPECT_EQ(pread(fd, buf, sizeof(buf), text_length), 0);
+
+  // Many threads read the descriptor at once, at different offsets.
+  constexpr int kNumThreads = 8;
+  constexpr int kNumReads = 50;
+  std::atomic<int> mismatches(0);
+  std::vector<Thread> threads;
+  threads.reserve(kNumThreads);
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back([fd, i, text_length, &mismatches] {
+      char thread_buf[kChunkLength];
+      for (int j = 0; j < kNumReads; ++j) {
+        size_t offset = (i * kNumReads + j) % (text_length - kChunkLength);
+        if (pread(fd, thread_buf, sizeof(thread_buf), offset) !=
+                sizeof(thread_buf) ||
+            memcmp(thread_buf, kSecureTestText + offset, sizeof(thread_buf)) !=
+                0) {
+          ++mismatches;
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.Join();
+  }
+  EXPECT_EQ(mismatches.load(), 0);
+  EXPECT_EQ(lseek(fd, 0, SEEK_CUR), text_length);
+  EXPECT_EQ(close(fd), 0);
+}
+
 }  // namespace
 }  // namespace asylo
@@ -0,0 +1,134 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_POSIX_IO_READINESS_CACHE_H_
+#define ASYLO_PLATFORM_POSIX_IO_READINESS_CACHE_H_
+
+#include <poll.h>
+
+#include <atomic>
+#include <cstdint>
+
+namespace asylo {
+namespace io {
+
+// Tracks whether an I/O stream is known to be readable or writable, so that
+// poll and select can answer without exiting the enclave.
+//
+// Readiness reported by the host stays true until the enclave consumes it, as
+// long as no one but the enclave drains the host buffers of the file
+// descriptor. The cache therefore only answers once the stream is marked
+// exclusive to the enclave, which it must stop being as soon as another
+// process may share the file descriptor, such as after fork(). Only positive
+// readiness is cached, and it is forgotten whenever the enclave reads from or
+// writes to the stream, including after short or EAGAIN results. POLLERR and
+// POLLHUP reported by the host are kept until the host stops reporting them.
+//
+// A host result may be stale by the time it is recorded if the stream was read
+// or written while the host call was in flight. Callers therefore take a
+// Snapshot() before asking the host and pass it to Update(), which discards
+// the result if the stream was invalidated since.
+//
+// This class is thread safe.
+class ReadinessCache {
+ public:
+  // The poll(2) events tracked by the cache.
+  static constexpr short kTrackedEvents = POLLIN | POLLOUT;
+
+  // The poll(2) conditions reported along with the tracked events.
+  static constexpr short kConditions = POLLERR | POLLHUP;
+
+  // Returns a token identifying the current point in time, to be passed to
+  // Update() with the results of a host call started afterwards.
+  static uint64_t Snapshot() {
+    return clock().load(std::memory_order_acquire);
+  }
+
+  // Sets whether the enclave is the only reader and writer of the host file
+  // descriptor of the stream. The cache answers lookups only while it is.
+  void set_exclusive(bool exclusive) {
+    exclusive_.store(exclusive, std::memory_order_release);
+  }
+
+  // Records that a host call started at |snapshot| found the |returned| events
+  // of the |requested| ones ready, along with the |returned| conditions. Tracked
+  // events which were requested but not returned are no longer known to be
+  // ready.
+  void Update(uint64_t snapshot, short requested, short returned) {
+    uint64_t state = state_.load(std::memory_order_relaxed);
+    uint64_t desired;
+    do {
+      if (Tick(state) > snapshot) {
+        return;
+      }
+      uint64_t events =
+          (Events(state) & ~((requested & kTrackedEvents) | kConditions)) |
+          (returned & (kTrackedEvents | kConditions));
+      desired = (Tick(state) << kTickShift) | events;
+    } while (!state_.compare_exchange_weak(state, desired,
+                                           std::memory_order_acq_rel,
+                                           std::memory_order_relaxed));
+  }
+
+  // Forgets the readiness of the stream for |events|. Must be called after
+  // every operation which may have consumed it.
+  void Invalidate(short events) {
+    uint64_t tick = clock().fetch_add(1, std::memory_order_acq_rel) + 1;
+    uint64_t state = state_.load(std::memory_order_relaxed);
+    uint64_t desired;
+    do {
+      desired = (tick << kTickShift) |
+                (Events(state) & ~static_cast<uint64_t>(events));
+    } while (!state_.compare_exchange_weak(state, desired,
+                                           std::memory_order_acq_rel,
+                                           std::memory_order_relaxed));
+  }
+
+  // Returns the subset of |events| known to be ready, along with the conditions
+  // last reported by the host. Returns 0 unless the stream is exclusive to the
+  // enclave.
+  short Lookup(short events) const {
+    if (!exclusive_.load(std::memory_order_acquire)) {
+      return 0;
+    }
+    return Events(state_.load(std::memory_order_acquire)) &
+           ((events & kTrackedEvents) | kConditions);
+  }
+
+ private:
+  // The state packs the tick of the last invalidation above the known events.
+  static constexpr int kTickShift = 16;
+  static constexpr uint64_t kEventsMask = (uint64_t{1} << kTickShift) - 1;
+
+  static uint64_t Tick(uint64_t state) { return state >> kTickShift; }
+  static uint64_t Events(uint64_t state) { return state & kEventsMask; }
+
+  // Advances on every invalidation of any stream.
+  static std::atomic<uint64_t> &clock() {
+    static std::atomic<uint64_t> clock{0};
+    return clock;
+  }
+
+  std::atomic<uint64_t> state_{0};
+  std::atomic<bool> exclusive_{false};
+};
+
+}  // namespace io
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_POSIX_IO_READINESS_CACHE_H_
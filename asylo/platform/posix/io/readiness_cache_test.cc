@@ -0,0 +1,122 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/io/readiness_cache.h"
+
+#include <poll.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace io {
+namespace {
+
+using ::testing::Eq;
+
+TEST(ReadinessCacheTest, StartsUnknown) {
+  ReadinessCache cache;
+  cache.set_exclusive(true);
+  EXPECT_THAT(cache.Lookup(POLLIN | POLLOUT), Eq(0));
+}
+
+TEST(ReadinessCacheTest, RecordsReportedEvents) {
+  ReadinessCache cache;
+  cache.set_exclusive(true);
+  cache.Update(ReadinessCache::Snapshot(), POLLIN | POLLOUT, POLLIN);
+  EXPECT_THAT(cache.Lookup(POLLIN | POLLOUT), Eq(POLLIN));
+  EXPECT_THAT(cache.Lookup(POLLOUT), Eq(0));
+
+  cache.Update(ReadinessCache::Snapshot(), POLLOUT, POLLOUT);
+  EXPECT_THAT(cache.Lookup(POLLIN | POLLOUT), Eq(POLLIN | POLLOUT));
+}
+
+TEST(ReadinessCacheTest, ForgetsRequestedEventsWhichAreNotReported) {
+  ReadinessCache cache;
+  cache.set_exclusive(true);
+  cache.Update(ReadinessCache::Snapshot(), POLLIN | POLLOUT, POLLIN | POLLOUT);
+  cache.Update(ReadinessCache::Snapshot(), POLLIN, 0);
+  EXPECT_THAT(cache.Lookup(POLLIN | POLLOUT), Eq(POLLOUT));
+}
+
+TEST(ReadinessCacheTest, IgnoresUntrackedEvents) {
+  ReadinessCache cache;
+  cache.set_exclusive(true);
+  cache.Update(ReadinessCache::Snapshot(), POLLIN | POLLPRI, POLLIN | POLLPRI);
+  EXPECT_THAT(cache.Lookup(POLLIN | POLLPRI), Eq(POLLIN));
+}
+
+TEST(ReadinessCacheTest, KeepsConditionsUntilNotReported) {
+  ReadinessCache cache;
+  cache.set_exclusive(true);
+  cache.Update(ReadinessCache::Snapshot(), POLLIN, POLLIN | POLLHUP);
+  EXPECT_THAT(cache.Lookup(POLLIN), Eq(POLLIN | POLLHUP));
+  cache.Invalidate(POLLIN);
+  EXPECT_THAT(cache.Lookup(POLLIN), Eq(POLLHUP));
+
+  cache.Update(ReadinessCache::Snapshot(), POLLOUT, POLLOUT);
+  EXPECT_THAT(cache.Lookup(POLLOUT), Eq(POLLOUT));
+}
+
+TEST(ReadinessCacheTest, AnswersOnlyWhileExclusive) {
+  ReadinessCache cache;
+  cache.Update(ReadinessCache::Snapshot(), POLLIN, POLLIN);
+  EXPECT_THAT(cache.Lookup(POLLIN), Eq(0));
+
+  cache.set_exclusive(true);
+  cache.Update(ReadinessCache::Snapshot(), POLLIN, POLLIN);
+  EXPECT_THAT(cache.Lookup(POLLIN), Eq(POLLIN));
+
+  cache.set_exclusive(false);
+  EXPECT_THAT(cache.Lookup(POLLIN), Eq(0));
+}
+
+TEST(ReadinessCacheTest, InvalidateForgetsEvents) {
+  ReadinessCache cache;
+  cache.set_exclusive(true);
+  cache.Update(ReadinessCache::Snapshot(), POLLIN | POLLOUT, POLLIN | POLLOUT);
+  cache.Invalidate(POLLIN);
+  EXPECT_THAT(cache.Lookup(POLLIN | POLLOUT), Eq(POLLOUT));
+}
+
+TEST(ReadinessCacheTest, DiscardsResultsOlderThanInvalidation) {
+  ReadinessCache cache;
+  cache.set_exclusive(true);
+  uint64_t snapshot = ReadinessCache::Snapshot();
+  cache.Invalidate(POLLIN);
+  cache.Update(snapshot, POLLIN, POLLIN);
+  EXPECT_THAT(cache.Lookup(POLLIN), Eq(0));
+
+  cache.Update(ReadinessCache::Snapshot(), POLLIN, POLLIN);
+  EXPECT_THAT(cache.Lookup(POLLIN), Eq(POLLIN));
+}
+
+TEST(ReadinessCacheTest, InvalidatingOtherStreamsKeepsResults) {
+  ReadinessCache cache;
+  cache.set_exclusive(true);
+  ReadinessCache other;
+  other.set_exclusive(true);
+  uint64_t snapshot = ReadinessCache::Snapshot();
+  other.Invalidate(POLLIN);
+  cache.Update(snapshot, POLLIN, POLLIN);
+  EXPECT_THAT(cache.Lookup(POLLIN), Eq(POLLIN));
+}
+
+}  // namespace
+}  // namespace io
+}  // namespace asylo
@@ -18,8 +18,12 @@
 
 #include "asylo/platform/posix/io/secure_paths.h"
 
+#include <sys/uio.h>
+
+#include <algorithm>
 #include <cerrno>
 #include <cstdint>
+#include <cstring>
 
 #include "asylo/platform/crypto/gcmlib/gcm_cryptor.h"
 #include "asylo/platform/host_call/trusted/host_calls.h"
@@ -30,41 +34,301 @@
 
 using asylo::platform::crypto::gcmlib::kKeyLength;
 using asylo::platform::storage::AeadHandler;
+using asylo::platform::storage::MerkleTreeStorage;
+
+static_assert(static_cast<uint32_t>(MerkleTreeStorage::kPersistent) ==
+                  ENCLAVE_STORAGE_MERKLE_TREE_FILE,
+              "Merkle tree storage does not match the IOCTL argument");
+static_assert(static_cast<uint32_t>(MerkleTreeStorage::kInMemory) ==
+                  ENCLAVE_STORAGE_MERKLE_TREE_IN_MEMORY,
+              "Merkle tree storage does not match the IOCTL argument");
 
 namespace asylo {
 namespace io {
 
+constexpr size_t IOContextSecure::kMaxBufferLength;
+
+int IOContextSecure::FlushWriteBuffer() {
+  if (write_buffer_.empty()) {
+    return 0;
+  }
+  ssize_t result = platform::storage::secure_write(
+      host_fd_, write_buffer_.data(), write_buffer_.size());
+  bool flushed = result == static_cast<ssize_t>(write_buffer_.size());
+  write_buffer_.clear();
+  if (!flushed) {
+    if (result >= 0) {
+      errno = EIO;
+    }
+    return -1;
+  }
+  return 0;
+}
+
+int IOContextSecure::DiscardReadAhead() {
+  if (read_buffer_.empty()) {
+    return 0;
+  }
+  off_t position = read_offset_ + read_position_;
+  read_buffer_.clear();
+  read_position_ = 0;
+  if (platform::storage::secure_lseek(host_fd_, position, SEEK_SET) !=
+      position) {
+    errno = EIO;
+    return -1;
+  }
+  return 0;
+}
+
+int IOContextSecure::Settle() {
+  int flush_result = FlushWriteBuffer();
+  int discard_result = DiscardReadAhead();
+  return (flush_result == 0 && discard_result == 0) ? 0 : -1;
+}
+
 int IOContextSecure::Close() {
-  return platform::storage::secure_close(host_fd_);
+  int settle_result;
+  {
+    absl::MutexLock lock(&lock_);
+    settle_result = Settle();
+  }
+  int close_result = platform::storage::secure_close(host_fd_);
+  return (settle_result == 0 && close_result == 0) ? 0 : -1;
 }
 
 ssize_t IOContextSecure::Read(void *buf, size_t count) {
-  return platform::storage::secure_read(host_fd_, buf, count);
+  absl::MutexLock lock(&lock_);
+  if (FlushWriteBuffer() != 0) {
+    return -1;
+  }
+  if (read_ahead_length_ == 0) {
+    return platform::storage::secure_read(host_fd_, buf, count);
+  }
+
+  // Serve what was read ahead, then read ahead again unless the rest of the
+  // request is at least as large as the read-ahead window.
+  uint8_t *data = static_cast<uint8_t *>(buf);
+  size_t total = std::min(count, read_buffer_.size() - read_position_);
+  if (total > 0) {
+    memcpy(data, read_buffer_.data() + read_position_, total);
+    read_position_ += total;
+  }
+  if (total == count) {
+    return total;
+  }
+
+  read_buffer_.clear();
+  read_position_ = 0;
+  size_t remaining = count - total;
+  if (remaining >= read_ahead_length_) {
+    ssize_t result =
+        platform::storage::secure_read(host_fd_, data + total, remaining);
+    if (result < 0) {
+      return total > 0 ? total : -1;
+    }
+    return total + result;
+  }
+
+  off_t offset = platform::storage::secure_lseek(host_fd_, 0, SEEK_CUR);
+  if (offset < 0) {
+    return total > 0 ? total : -1;
+  }
+  read_buffer_.resize(read_ahead_length_);
+  ssize_t result = platform::storage::secure_read(
+      host_fd_, read_buffer_.data(), read_buffer_.size());
+  if (result < 0) {
+    read_buffer_.clear();
+    return total > 0 ? total : -1;
+  }
+  read_buffer_.resize(result);
+  read_offset_ = offset;
+  read_position_ = std::min(remaining, read_buffer_.size());
+  memcpy(data + total, read_buffer_.data(), read_position_);
+  return total + read_position_;
 }
 
 ssize_t IOContextSecure::Write(const void *buf, size_t count) {
-  return platform::storage::secure_write(host_fd_, buf, count);
+  absl::MutexLock lock(&lock_);
+  if (DiscardReadAhead() != 0) {
+    return -1;
+  }
+  if (write_buffer_.size() + count > write_buffer_capacity_ &&
+      FlushWriteBuffer() != 0) {
+    return -1;
+  }
+  if (count >= write_buffer_capacity_) {
+    return platform::storage::secure_write(host_fd_, buf, count);
+  }
+
+  if (write_buffer_.empty()) {
+    write_offset_ = platform::storage::secure_lseek(host_fd_, 0, SEEK_CUR);
+    if (write_offset_ < 0) {
+      return -1;
+    }
+  }
+  const uint8_t *data = static_cast<const uint8_t *>(buf);
+  write_buffer_.insert(write_buffer_.end(), data, data + count);
+  return count;
+}
+
+// Each iovec is handed to the secure I/O layer directly rather than being
+// staged in a flattened buffer first.
+ssize_t IOContextSecure::Readv(const struct iovec *iov, int iovcnt) {
+  if (iovcnt <= 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  ssize_t total = 0;
+  for (int i = 0; i < iovcnt; ++i) {
+    ssize_t result = Read(iov[i].iov_base, iov[i].iov_len);
+    if (result < 0) {
+      return total > 0 ? total : -1;
+    }
+    total += result;
+    if (static_cast<size_t>(result) < iov[i].iov_len) {
+      break;
+    }
+  }
+  return total;
+}
+
+ssize_t IOContextSecure::Writev(const struct iovec *iov, int iovcnt) {
+  if (iovcnt <= 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  ssize_t total = 0;
+  for (int i = 0; i < iovcnt; ++i) {
+    ssize_t result = Write(iov[i].iov_base, iov[i].iov_len);
+    if (result < 0) {
+      return total > 0 ? total : -1;
+    }
+    total += result;
+    if (static_cast<size_t>(result) < iov[i].iov_len) {
+      break;
+    }
+  }
+  return total;
+}
+
+ssize_t IOContextSecure::PRead(void *buf, size_t count, off_t offset) {
+  if (offset < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // Positional reads must see data written through this descriptor, but need
+  // |lock_| only if there is buffered data.
+  bool needs_flush;
+  {
+    absl::ReaderMutexLock lock(&lock_);
+    needs_flush = !write_buffer_.empty();
+  }
+  if (needs_flush) {
+    absl::MutexLock lock(&lock_);
+    if (FlushWriteBuffer() != 0) {
+      return -1;
+    }
+  }
+  return platform::storage::secure_pread(host_fd_, buf, count, offset);
+}
+
+ssize_t IOContextSecure::PReadv(const struct iovec *iov, int iovcnt,
+                                off_t offset) {
+  if (iovcnt <= 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  ssize_t total = 0;
+  for (int i = 0; i < iovcnt; ++i) {
+    ssize_t result = PRead(iov[i].iov_base, iov[i].iov_len, offset + total);
+    if (result < 0) {
+      return total > 0 ? total : -1;
+    }
+    total += result;
+    if (static_cast<size_t>(result) < iov[i].iov_len) {
+      break;
+    }
+  }
+  return total;
 }
 
 int IOContextSecure::LSeek(off_t offset, int whence) {
+  absl::MutexLock lock(&lock_);
+  if (Settle() != 0) {
+    return -1;
+  }
   return platform::storage::secure_lseek(host_fd_, offset, whence);
 }
 
-int IOContextSecure::FSync() { return enc_untrusted_fsync(host_fd_); }
+int IOContextSecure::FSync() {
+  absl::MutexLock lock(&lock_);
+  if (FlushWriteBuffer() != 0) {
+    return -1;
+  }
+  return platform::storage::secure_fsync(host_fd_);
+}
 
 int IOContextSecure::FStat(struct stat *st) {
+  absl::MutexLock lock(&lock_);
+  if (FlushWriteBuffer() != 0) {
+    return -1;
+  }
   return platform::storage::secure_fstat(host_fd_, st);
 }
 
 int IOContextSecure::Isatty() { return enc_untrusted_isatty(host_fd_); }
 
 int IOContextSecure::Ioctl(int request, void *argp) {
+  absl::MutexLock lock(&lock_);
+  if (Settle() != 0) {
+    return -1;
+  }
   switch (request) {
     case ENCLAVE_STORAGE_SET_KEY: {
       struct key_info *ioctl_param = reinterpret_cast<struct key_info *>(argp);
       return AeadHandler::GetInstance().SetMasterKey(
           host_fd_, ioctl_param->data, ioctl_param->length);
     }
+    case ENCLAVE_STORAGE_SET_DIGEST_WRITE_BACK: {
+      if (!argp) {
+        errno = EINVAL;
+        return -1;
+      }
+      return AeadHandler::GetInstance().SetDigestWriteBack(
+          host_fd_, *reinterpret_cast<uint64_t *>(argp));
+    }
+    case ENCLAVE_STORAGE_SET_WRITE_BUFFER:
+    case ENCLAVE_STORAGE_SET_READ_AHEAD: {
+      if (!argp || *reinterpret_cast<uint64_t *>(argp) > kMaxBufferLength) {
+        errno = EINVAL;
+        return -1;
+      }
+      size_t length = *reinterpret_cast<uint64_t *>(argp);
+      if (request == ENCLAVE_STORAGE_SET_WRITE_BUFFER) {
+        write_buffer_capacity_ = length;
+      } else {
+        read_ahead_length_ = length;
+      }
+      return 0;
+    }
+    case ENCLAVE_STORAGE_SET_BLOCK_LENGTH: {
+      if (!argp) {
+        errno = EINVAL;
+        return -1;
+      }
+      return AeadHandler::GetInstance().SetBlockLength(
+          host_fd_, *reinterpret_cast<uint32_t *>(argp));
+    }
+    case ENCLAVE_STORAGE_SET_MERKLE_TREE_STORAGE: {
+      if (!argp) {
+        errno = EINVAL;
+        return -1;
+      }
+      return AeadHandler::GetInstance().SetMerkleTreeStorage(
+          host_fd_,
+          static_cast<MerkleTreeStorage>(*reinterpret_cast<uint32_t *>(argp)));
+    }
     default:
       if (argp != nullptr) {
         errno = ENOSYS;
@@ -19,14 +19,39 @@
 #ifndef ASYLO_PLATFORM_POSIX_IO_SECURE_PATHS_H_
 #define ASYLO_PLATFORM_POSIX_IO_SECURE_PATHS_H_
 
+#include <sys/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
 #include "asylo/platform/posix/io/io_manager.h"
+#include "asylo/platform/storage/secure/enclave_storage_secure.h"
 
 namespace asylo {
 namespace io {
 
 // IOContext implementation wrapping a stream managed by the secure I/O layer.
+//
+// A descriptor may buffer writes and read ahead in trusted memory, see
+// ENCLAVE_STORAGE_SET_WRITE_BUFFER and ENCLAVE_STORAGE_SET_READ_AHEAD. Buffered
+// writes are coalesced if each continues where the previous one ended, and are
+// handed to the secure I/O layer as a single write, which encrypts the covered
+// blocks and writes them to the host at once. Any other operation on the
+// descriptor flushes the write buffer and discards data read ahead first.
+// Neither buffer is shared with other descriptors of the same file.
+//
+// Positional reads only flush the write buffer, and do not otherwise serialize
+// with each other or with the cursor-based operations of the descriptor, so
+// that many threads can read one descriptor at once.
 class IOContextSecure : public IOManager::IOContext {
  public:
+  // Largest write buffer and read-ahead window a descriptor may select.
+  static constexpr size_t kMaxBufferLength = 16 * 1024 * 1024;
+
   // Factory method to create an instance of the class.
   static std::unique_ptr<IOManager::IOContext> Create(const char *path,
                                                       int flags, mode_t mode) {
@@ -40,6 +65,10 @@ class IOContextSecure : public IOManager::IOContext {
  protected:
   ssize_t Read(void *buf, size_t count) override;
   ssize_t Write(const void *buf, size_t count) override;
+  ssize_t Readv(const struct iovec *iov, int iovcnt) override;
+  ssize_t Writev(const struct iovec *iov, int iovcnt) override;
+  ssize_t PRead(void *buf, size_t count, off_t offset) override;
+  ssize_t PReadv(const struct iovec *iov, int iovcnt, off_t offset) override;
   int Close() override;
   int LSeek(off_t offset, int whence) override;
   int FSync() override;
@@ -50,8 +79,41 @@ class IOContextSecure : public IOManager::IOContext {
  private:
   explicit IOContextSecure(int host_fd) : host_fd_(host_fd) {}
 
+  // Writes the buffered data to the secure I/O layer. The buffer is emptied
+  // even if the write fails. Returns 0 on success, or -1 and sets errno.
+  int FlushWriteBuffer() ABSL_EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Discards data read ahead and moves the cursor of |host_fd_| back to the
+  // position of the reader. Returns 0 on success, or -1 and sets errno.
+  int DiscardReadAhead() ABSL_EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Empties both buffers, leaving the cursor of |host_fd_| at the logical
+  // position of the descriptor. Returns 0 on success, or -1 and sets errno.
+  int Settle() ABSL_EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
   // Host-provided file descriptor of the backing store.
   int host_fd_;
+
+  absl::Mutex lock_;
+
+  // Capacity of the write buffer, or 0 if writes are not buffered.
+  size_t write_buffer_capacity_ ABSL_GUARDED_BY(lock_) = 0;
+
+  // Data written but not yet passed to the secure I/O layer, and its logical
+  // offset in the file. The cursor of |host_fd_| stays at |write_offset_|
+  // while data is buffered.
+  std::vector<uint8_t> write_buffer_ ABSL_GUARDED_BY(lock_);
+  off_t write_offset_ ABSL_GUARDED_BY(lock_) = 0;
+
+  // Number of bytes read ahead, or 0 if reads are not buffered.
+  size_t read_ahead_length_ ABSL_GUARDED_BY(lock_) = 0;
+
+  // Data read ahead of the reader, its logical offset in the file and the
+  // position of the reader in it. The cursor of |host_fd_| is at the end of
+  // the buffered data.
+  std::vector<uint8_t> read_buffer_ ABSL_GUARDED_BY(lock_);
+  off_t read_offset_ ABSL_GUARDED_BY(lock_) = 0;
+  size_t read_position_ ABSL_GUARDED_BY(lock_) = 0;
 };
 
 }  // namespace io
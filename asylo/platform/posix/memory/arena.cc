@@ -0,0 +1,73 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/memory/arena.h"
+
+namespace asylo {
+namespace {
+
+// The innermost ScopedArena of the calling thread.
+thread_local ScopedArena *current_scope = nullptr;
+
+}  // namespace
+
+BumpArena::BumpArena(void *base, size_t size) : BumpArena() {
+  Reset(base, size);
+}
+
+void BumpArena::Reset(void *base, size_t size) {
+  base_ = static_cast<uint8_t *>(base);
+  next_ = base_;
+  end_ = base_ ? base_ + size : nullptr;
+}
+
+void *BumpArena::Allocate(size_t size, size_t alignment) {
+  if (!next_) {
+    return nullptr;
+  }
+  size_t shift =
+      (alignment - (reinterpret_cast<uintptr_t>(next_) % alignment)) %
+      alignment;
+  if (remaining() < shift || remaining() - shift < size) {
+    return nullptr;
+  }
+  void *ret = next_ + shift;
+  next_ += shift + size;
+  return ret;
+}
+
+ScopedArena::ScopedArena(BumpArena *arena)
+    : arena_(arena), mark_(arena->GetMark()), enclosing_(current_scope) {
+  current_scope = this;
+}
+
+ScopedArena::~ScopedArena() {
+  arena_->Release(mark_);
+  current_scope = enclosing_;
+}
+
+BumpArena *ScopedArena::Current() {
+  return current_scope ? current_scope->arena_ : nullptr;
+}
+
+void *ScopedArena::Allocate(size_t size, size_t alignment) {
+  BumpArena *arena = Current();
+  return arena ? arena->Allocate(size, alignment) : nullptr;
+}
+
+}  // namespace asylo
@@ -0,0 +1,123 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_POSIX_MEMORY_ARENA_H_
+#define ASYLO_PLATFORM_POSIX_MEMORY_ARENA_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace asylo {
+
+// A bump-pointer allocator over a caller-provided block of memory. Allocation
+// moves a pointer forward and individual allocations are never freed. Instead,
+// every allocation made after a Mark() is released at once by passing the mark
+// to Release(), which takes constant time.
+//
+// BumpArena does not own its memory and does not run destructors. It is not
+// thread-safe.
+class BumpArena {
+ public:
+  // A position in the arena that allocations can be released back to.
+  using Mark = uint8_t *;
+
+  // Creates an arena with no memory, from which every allocation fails.
+  constexpr BumpArena() : base_(nullptr), next_(nullptr), end_(nullptr) {}
+
+  // Creates an arena that allocates from the |size| bytes at |base|.
+  BumpArena(void *base, size_t size);
+
+  BumpArena(const BumpArena &other) = delete;
+  BumpArena &operator=(const BumpArena &other) = delete;
+
+  // Makes the arena allocate from the |size| bytes at |base|, releasing every
+  // earlier allocation.
+  void Reset(void *base, size_t size);
+
+  // Returns |size| bytes aligned to |alignment|, which must be a power of two,
+  // or nullptr if the arena does not have enough memory left.
+  void *Allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+  // Returns the current position of the arena.
+  Mark GetMark() const { return next_; }
+
+  // Releases every allocation made since |mark| was taken. Marks taken after
+  // |mark| become invalid.
+  void Release(Mark mark) { next_ = mark; }
+
+  // Releases every allocation.
+  void ReleaseAll() { next_ = base_; }
+
+  // Returns the next address that the arena will allocate from.
+  void *next() const { return next_; }
+
+  // Returns the number of bytes that are not allocated.
+  size_t remaining() const { return end_ - next_; }
+
+  // Returns the number of bytes that are allocated, including alignment
+  // padding.
+  size_t used() const { return next_ - base_; }
+
+ private:
+  uint8_t *base_;
+  uint8_t *next_;
+  uint8_t *end_;
+};
+
+// Releases every allocation that is made from a BumpArena during the lifetime
+// of a ScopedArena, and makes that arena the current arena of the calling
+// thread for the same lifetime. Scopes nest: an inner ScopedArena on the same
+// arena releases only the allocations made in the inner scope, and the arena
+// of the enclosing scope becomes current again when the inner scope ends.
+//
+// This makes request-scoped allocation cheap:
+//
+//   ScopedArena request_scope(&request_arena);
+//   void *buffer = ScopedArena::Allocate(1024);
+//   ...
+//   // Everything allocated in the scope is released here.
+//
+// ScopedArena objects must be destroyed on the thread that created them, in
+// the reverse order of their creation.
+class ScopedArena {
+ public:
+  explicit ScopedArena(BumpArena *arena);
+
+  ScopedArena(const ScopedArena &other) = delete;
+  ScopedArena &operator=(const ScopedArena &other) = delete;
+
+  ~ScopedArena();
+
+  // Returns the arena of the innermost ScopedArena of the calling thread, or
+  // nullptr if the thread has none.
+  static BumpArena *Current();
+
+  // Allocates from the current arena of the calling thread. Returns nullptr if
+  // the thread has no current arena or if the arena is exhausted.
+  static void *Allocate(size_t size,
+                        size_t alignment = alignof(std::max_align_t));
+
+ private:
+  BumpArena *const arena_;
+  const BumpArena::Mark mark_;
+  ScopedArena *const enclosing_;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_POSIX_MEMORY_ARENA_H_
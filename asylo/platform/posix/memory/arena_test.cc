@@ -0,0 +1,122 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/memory/arena.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace {
+
+using ::testing::Eq;
+using ::testing::IsNull;
+using ::testing::NotNull;
+
+TEST(BumpArenaTest, AllocationsAreAlignedAndInRange) {
+  alignas(std::max_align_t) uint8_t buffer[256];
+  BumpArena arena(buffer + 1, sizeof(buffer) - 1);
+
+  for (int i = 0; i < 3; ++i) {
+    uint8_t *ptr = static_cast<uint8_t *>(arena.Allocate(3));
+    ASSERT_THAT(ptr, NotNull());
+    EXPECT_THAT(reinterpret_cast<uintptr_t>(ptr) % alignof(std::max_align_t),
+                Eq(0));
+    EXPECT_GE(ptr, buffer);
+    EXPECT_LE(ptr + 3, buffer + sizeof(buffer));
+  }
+  EXPECT_THAT(reinterpret_cast<uintptr_t>(arena.Allocate(1, 64)) % 64, Eq(0));
+}
+
+TEST(BumpArenaTest, AllocationFailsWhenExhausted) {
+  alignas(std::max_align_t) uint8_t buffer[64];
+  BumpArena arena(buffer, sizeof(buffer));
+
+  EXPECT_THAT(arena.Allocate(sizeof(buffer) + 1), IsNull());
+  EXPECT_THAT(arena.Allocate(sizeof(buffer)), NotNull());
+  EXPECT_THAT(arena.remaining(), Eq(0));
+  EXPECT_THAT(arena.Allocate(1), IsNull());
+
+  BumpArena empty;
+  EXPECT_THAT(empty.Allocate(1), IsNull());
+}
+
+TEST(BumpArenaTest, ReleaseRewindsToMark) {
+  alignas(std::max_align_t) uint8_t buffer[256];
+  BumpArena arena(buffer, sizeof(buffer));
+
+  arena.Allocate(16);
+  BumpArena::Mark mark = arena.GetMark();
+  void *first = arena.Allocate(16);
+  arena.Allocate(32);
+  arena.Release(mark);
+  EXPECT_THAT(arena.Allocate(16), Eq(first));
+
+  arena.ReleaseAll();
+  EXPECT_THAT(arena.used(), Eq(0));
+  EXPECT_THAT(arena.Allocate(1), Eq(static_cast<void *>(buffer)));
+}
+
+TEST(ScopedArenaTest, NestedScopesReleaseTheirOwnAllocations) {
+  alignas(std::max_align_t) uint8_t outer_buffer[256];
+  alignas(std::max_align_t) uint8_t inner_buffer[256];
+  BumpArena outer_arena(outer_buffer, sizeof(outer_buffer));
+  BumpArena inner_arena(inner_buffer, sizeof(inner_buffer));
+
+  EXPECT_THAT(ScopedArena::Current(), IsNull());
+  EXPECT_THAT(ScopedArena::Allocate(1), IsNull());
+  {
+    ScopedArena outer(&outer_arena);
+    EXPECT_THAT(ScopedArena::Current(), Eq(&outer_arena));
+    ScopedArena::Allocate(16);
+    size_t outer_used = outer_arena.used();
+    {
+      ScopedArena nested(&outer_arena);
+      ScopedArena::Allocate(16);
+      {
+        ScopedArena inner(&inner_arena);
+        EXPECT_THAT(ScopedArena::Current(), Eq(&inner_arena));
+        ScopedArena::Allocate(16);
+      }
+      EXPECT_THAT(inner_arena.used(), Eq(0));
+      EXPECT_THAT(ScopedArena::Current(), Eq(&outer_arena));
+    }
+    EXPECT_THAT(outer_arena.used(), Eq(outer_used));
+  }
+  EXPECT_THAT(outer_arena.used(), Eq(0));
+  EXPECT_THAT(ScopedArena::Current(), IsNull());
+}
+
+TEST(ScopedArenaTest, CurrentArenaIsPerThread) {
+  alignas(std::max_align_t) uint8_t buffer[64];
+  BumpArena arena(buffer, sizeof(buffer));
+  ScopedArena scope(&arena);
+
+  BumpArena *other_thread_arena = &arena;
+  std::thread thread(
+      [&other_thread_arena] { other_thread_arena = ScopedArena::Current(); });
+  thread.join();
+  EXPECT_THAT(other_thread_arena, IsNull());
+}
+
+}  // namespace
+}  // namespace asylo
@@ -117,5 +117,28 @@ TEST(HeapSwitchTest, MemoryAlignment) {
   heap_switch(/*address=*/nullptr, /*size=*/0);
 }
 
+TEST(HeapSwitchTest, ThreadCacheReusesFreedBlocks) {
+  EnableMallocThreadCache();
+
+  void *first = malloc(40);
+  ASSERT_NE(first, nullptr);
+  free(first);
+  void *second = malloc(40);
+  EXPECT_EQ(second, first);
+
+  // The cache is suspended while the heap is switched, and resumes afterwards.
+  char switched_heap[64];
+  heap_switch(switched_heap, sizeof(switched_heap));
+  void *on_switched_heap = malloc(40);
+  EXPECT_TRUE(
+      IsAddressInRange(on_switched_heap, switched_heap, sizeof(switched_heap)));
+  heap_switch(/*address=*/nullptr, /*size=*/0);
+
+  free(second);
+  void *third = malloc(40);
+  EXPECT_EQ(third, first);
+  free(third);
+}
+
 }  // namespace
 }  // namespace asylo
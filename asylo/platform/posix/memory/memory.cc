@@ -19,10 +19,15 @@
 #include "asylo/platform/posix/memory/memory.h"
 
 #include <malloc.h>
-#include <stdint.h>
 #include <stdlib.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
+
+#include "asylo/platform/posix/memory/arena.h"
+#include "asylo/platform/primitives/trusted_runtime.h"
 
 extern void set_malloc_hook(void*(*hook)(size_t, void *), void *);
 extern void set_realloc_hook(void*(*hook)(void *, size_t, void *), void *);
@@ -30,38 +35,26 @@ extern void set_free_hook(void(*hook)(void *, void *), void *);
 
 namespace {
 
-// The next available address in the switched heap. It's set to the base address
-// of the switched heap when heap_switch is called, and moving forward after
-// each memory allocation on the switched heap.
-uint8_t *switched_heap_next = nullptr;
+// The switched heap. It's reset to the memory provided to heap_switch, and
+// moves forward after each memory allocation on the switched heap. New
+// malloc/realloc on the switched heap fail if the requested size is larger than
+// the remaining size.
+asylo::BumpArena switched_heap;
 
-// The bytes left to be allocated on the switched heap. It's set to the total
-// size of the switched heap when heap_switch is called, and is reduced in each
-// memory allocation. New malloc/realloc on switched heap will fail if the
-// requested size is larger than the remaining size.
-size_t switched_heap_remaining = 0;
+// Serializes allocations on the switched heap. Besides the thread taking or
+// restoring a snapshot, the snapshot workers that help it may allocate, for
+// instance to record a crypto error.
+std::atomic_flag switched_heap_lock = ATOMIC_FLAG_INIT;
 
 // Allocate memory on an address space provided by the user.
-// This function is not thread-safe. This should only be used by fork during
-// snapshotting/restoring while other threads are not allowed to enter the
-// enclave.
+// This should only be used by fork during snapshotting/restoring while other
+// threads are not allowed to enter the enclave.
 void *AllocateMemoryOnSwitchedHeap(size_t size, void *pool) {
-  // Align the memory address.
-  size_t align = alignof(std::max_align_t);
-  int shift =
-      (align - (reinterpret_cast<uintptr_t>(switched_heap_next) % align)) %
-      align;
-
-  size += shift;
-  if (!switched_heap_next || switched_heap_remaining < size) {
-    return nullptr;
+  while (switched_heap_lock.test_and_set(std::memory_order_acquire)) {
   }
-
-  void *ret = switched_heap_next + shift;
-  switched_heap_next += size;
-  switched_heap_remaining -= size;
-
-  return ret;
+  void *address = switched_heap.Allocate(size);
+  switched_heap_lock.clear(std::memory_order_release);
+  return address;
 }
 
 void *MallocHook(size_t size, void *pool) {
@@ -78,25 +71,136 @@ void *ReallocHook(void *ptr, size_t size, void *pool) {
 // mixing use of regular malloc/free with the switched malloc/heap.
 void FreeHook(void *address, void *pool) {}
 
+// Free blocks of the trusted heap are cached by size class, in steps of
+// kSizeClassGranularity bytes up to kMaxCachedSize bytes. A cached block stays
+// allocated in the trusted heap and holds the next block of its list.
+constexpr size_t kSizeClassGranularity = 16;
+constexpr size_t kMaxCachedSize = 256;
+constexpr size_t kNumSizeClasses = kMaxCachedSize / kSizeClassGranularity;
+
+// Bounds the memory held by one cache to about 70 KB.
+constexpr uint32_t kMaxCachedBlocksPerClass = 32;
+
+// Number of threads that can have a cache. Threads beyond this use the trusted
+// heap directly.
+constexpr size_t kMaxThreadCaches = 64;
+
+struct FreeBlock {
+  FreeBlock *next;
+};
+
+// The cache of one enclave thread. Only the owning thread touches the lists,
+// so they need no lock.
+struct ThreadCache {
+  std::atomic<uint64_t> owner;
+  FreeBlock *blocks[kNumSizeClasses];
+  uint32_t num_blocks[kNumSizeClasses];
+};
+
+// The caches live in bss rather than in thread-local storage, so that a fork
+// snapshot captures them together with the heap they point into, and so that
+// a thread finds its cache again on every enclave entry.
+ThreadCache thread_caches[kMaxThreadCaches];
+
+bool thread_cache_enabled = false;
+
+// Returns the cache of the calling thread, claiming a free one if the thread
+// has none. Returns nullptr if every cache is owned by another thread.
+ThreadCache *GetThreadCache() {
+  const uint64_t self = enc_thread_self();
+  const size_t start = (self / alignof(std::max_align_t)) % kMaxThreadCaches;
+  for (size_t i = 0; i < kMaxThreadCaches; ++i) {
+    ThreadCache *cache = &thread_caches[(start + i) % kMaxThreadCaches];
+    uint64_t owner = cache->owner.load(std::memory_order_relaxed);
+    if (owner == self) {
+      return cache;
+    }
+    if (owner == kInvalidThread &&
+        cache->owner.compare_exchange_strong(owner, self,
+                                             std::memory_order_relaxed)) {
+      return cache;
+    }
+  }
+  return nullptr;
+}
+
+// Serves |size| bytes from the calling thread's cache if possible. Misses are
+// rounded up to their size class so that the block can be cached when freed.
+void *CachingMallocHook(size_t size, void *pool) {
+  if (size > kMaxCachedSize) {
+    return _malloc_r(_REENT, size);
+  }
+  size_t size_class = std::max<size_t>(size, 1) - 1;
+  size_class /= kSizeClassGranularity;
+  ThreadCache *cache = GetThreadCache();
+  if (cache && cache->blocks[size_class]) {
+    FreeBlock *block = cache->blocks[size_class];
+    cache->blocks[size_class] = block->next;
+    cache->num_blocks[size_class]--;
+    return block;
+  }
+  return _malloc_r(_REENT, (size_class + 1) * kSizeClassGranularity);
+}
+
+// Caches |address| by its usable size, whichever allocation function returned
+// it, or returns it to the trusted heap if its list is full.
+void CachingFreeHook(void *address, void *pool) {
+  if (!address) {
+    return;
+  }
+  size_t usable = _malloc_usable_size_r(_REENT, address);
+  size_t size_class = usable / kSizeClassGranularity;
+  if (size_class == 0 || size_class > kNumSizeClasses + 1) {
+    _free_r(_REENT, address);
+    return;
+  }
+  size_class = std::min(size_class, kNumSizeClasses) - 1;
+  ThreadCache *cache = GetThreadCache();
+  if (!cache || cache->num_blocks[size_class] >= kMaxCachedBlocksPerClass) {
+    _free_r(_REENT, address);
+    return;
+  }
+  FreeBlock *block = static_cast<FreeBlock *>(address);
+  block->next = cache->blocks[size_class];
+  cache->blocks[size_class] = block;
+  cache->num_blocks[size_class]++;
+}
+
+// Installs the hooks used outside of heap_switch.
+void SetDefaultHooks() {
+  if (thread_cache_enabled) {
+    set_malloc_hook(&CachingMallocHook, /*pool=*/nullptr);
+    set_free_hook(&CachingFreeHook, /*pool=*/nullptr);
+  } else {
+    set_malloc_hook(/*hook=*/nullptr, /*pool=*/nullptr);
+    set_free_hook(/*hook=*/nullptr, /*pool=*/nullptr);
+  }
+  set_realloc_hook(/*hook=*/nullptr, /*pool=*/nullptr);
+}
+
 }  // namespace
 
-void *GetSwitchedHeapNext() { return switched_heap_next; }
+void *GetSwitchedHeapNext() { return switched_heap.next(); }
 
-size_t GetSwitchedHeapRemaining() { return switched_heap_remaining; }
+size_t GetSwitchedHeapRemaining() { return switched_heap.remaining(); }
 
 // This function is not thread-safe.
 void heap_switch(void *base, size_t size) {
   if (base && size > 0) {
-    switched_heap_next = static_cast<uint8_t *>(base);
-    switched_heap_remaining = size;
+    switched_heap.Reset(base, size);
     set_malloc_hook(&MallocHook, /*pool=*/nullptr);
     set_realloc_hook(&ReallocHook, /*pool=*/nullptr);
     set_free_hook(&FreeHook, /*pool=*/nullptr);
   } else {
-    switched_heap_next = nullptr;
-    switched_heap_remaining = 0;
-    set_malloc_hook(/*hook=*/nullptr, /*pool=*/nullptr);
-    set_realloc_hook(/*hook=*/nullptr, /*pool=*/nullptr);
-    set_free_hook(/*hook=*/nullptr, /*pool=*/nullptr);
+    switched_heap.Reset(/*base=*/nullptr, /*size=*/0);
+    SetDefaultHooks();
+  }
+}
+
+// This function is not thread-safe.
+void EnableMallocThreadCache() {
+  thread_cache_enabled = true;
+  if (!switched_heap.next()) {
+    SetDefaultHooks();
   }
 }
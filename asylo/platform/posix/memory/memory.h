@@ -40,6 +40,15 @@ size_t GetSwitchedHeapRemaining();
 // enclave.
 void heap_switch(void *base, size_t size);
 
+// Serves small malloc requests from per-thread caches of free blocks, so that
+// threads that allocate and free small objects rarely contend on the trusted
+// heap lock. Cached blocks stay allocated in the trusted heap, so fork
+// snapshots and heap_switch are unaffected. Caching is suspended while the
+// heap is switched. There is no way to disable caching once enabled.
+// This function is not thread-safe. It should be called once during enclave
+// initialization.
+void EnableMallocThreadCache();
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif
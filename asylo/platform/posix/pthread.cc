@@ -21,9 +21,11 @@
 #include <signal.h>
 #include <sys/mman.h>
 
+#include <algorithm>
 #include <array>
 #include <bitset>
 #include <cerrno>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <functional>
@@ -32,6 +34,7 @@
 #include "asylo/platform/common/enclave_state.h"
 #include "asylo/platform/common/time_util.h"
 #include "asylo/platform/core/atomic.h"
+#include "asylo/platform/core/contention_profiler.h"
 #include "asylo/platform/core/trusted_global_state.h"
 #include "asylo/platform/host_call/trusted/host_calls.h"
 #include "asylo/platform/posix/include/semaphore.h"
@@ -40,15 +43,29 @@
 #include "asylo/platform/posix/threading/thread_manager.h"
 #include "asylo/platform/primitives/trusted_runtime.h"
 #include "asylo/platform/primitives/util/trusted_memory.h"
+#include "asylo/util/pooled_allocator.h"
 
 namespace {
 
 constexpr size_t kNumSpinLockAttempts = 10000;
 
+// Number of times thread-specific data destructors are run for values stored
+// during thread exit, as PTHREAD_DESTRUCTOR_ITERATIONS in POSIX.
+constexpr int kMaxTsdDestructorPasses = 4;
+
 static void (*tsd_destructors[PTHREAD_KEYS_MAX])(void *) = {0};
 static pthread_rwlock_t key_lock = PTHREAD_RWLOCK_INITIALIZER;
 static void NoDestructor(void *dummy) {}
-size_t __pthread_tsd_size = sizeof(void *) * PTHREAD_KEYS_MAX;
+
+// Values of the thread-specific data keys of the calling thread. The array
+// lives in the TLS region of the enclave thread, next to its __pthread_info, so
+// pthread_getspecific() and pthread_setspecific() are a single indexed access
+// which neither locks nor allocates.
+thread_local void *thread_specific_values[PTHREAD_KEYS_MAX] = {nullptr};
+
+// Set once the calling thread stores a non-null value for any key, so that
+// threads which never use thread-specific data skip the destructor pass.
+thread_local bool thread_specific_values_set = false;
 
 inline int pthread_spin_lock(pthread_spinlock_t *lock) {
   constexpr unsigned int kLocked = 1;
@@ -122,74 +139,213 @@ int pthread_mutex_check_parameter(pthread_mutex_t *mutex) {
   return 0;
 }
 
-// Returns locks the mutex and returns 0 if possible. Returns EBUSY if the mutex
-// is taken. |mutex|->_lock must be locked.
+// Number of polls of a contended mutex before sleeping on the host, used until
+// the enclave configuration is available.
+constexpr int64_t kDefaultMutexSpinLimit = 1000;
+
+// Cached EnclaveConfig::mutex_spin_limit, or -1 if it has not been read yet.
+int64_t mutex_spin_limit = -1;
+
+// Estimate of the number of polls after which a contended mutex becomes
+// available to this thread, following the adaptive mutexes of glibc.
+thread_local int64_t mutex_spin_estimate = 0;
+
+// Returns the upper bound on the number of polls of a contended mutex.
+int64_t GetMutexSpinLimit() {
+  int64_t limit = __atomic_load_n(&mutex_spin_limit, __ATOMIC_RELAXED);
+  if (limit >= 0) {
+    return limit;
+  }
+  asylo::StatusOr<const asylo::EnclaveConfig *> config_result =
+      asylo::GetEnclaveConfig();
+  if (!config_result.ok()) {
+    return kDefaultMutexSpinLimit;
+  }
+  limit = config_result.ValueOrDie()->mutex_spin_limit();
+  asylo::AtomicStore(&mutex_spin_limit, limit, std::memory_order_relaxed);
+  return limit;
+}
+
+// Locks |mutex| with a single compare-and-swap of its owner if it is free.
+// Returns true on success.
+inline bool pthread_mutex_try_acquire(pthread_mutex_t *mutex,
+                                      pthread_t self) {
+  pthread_t expected = PTHREAD_T_NULL;
+  if (!asylo::AtomicCompareExchange(&mutex->_owner, &expected, self,
+                                    /*weak=*/false,
+                                    std::memory_order_seq_cst,
+                                    std::memory_order_relaxed)) {
+    return false;
+  }
+  mutex->_refcount = 1;
+  return true;
+}
+
+// Polls |mutex| for a bounded number of iterations, sized by the number of
+// polls which recently sufficed on this thread. Returns true if the mutex was
+// locked.
+bool pthread_mutex_spin_acquire(pthread_mutex_t *mutex, pthread_t self) {
+  const int64_t max_spins =
+      std::min(GetMutexSpinLimit(), 2 * mutex_spin_estimate + 10);
+  for (int64_t spins = 0; spins < max_spins; ++spins) {
+    if (__atomic_load_n(&mutex->_owner, __ATOMIC_RELAXED) == PTHREAD_T_NULL &&
+        pthread_mutex_try_acquire(mutex, self)) {
+      mutex_spin_estimate += (spins - mutex_spin_estimate) / 8;
+      return true;
+    }
+    enc_pause();
+  }
+  mutex_spin_estimate += (max_spins - mutex_spin_estimate) / 8;
+  return false;
+}
+
+// Locks |mutex| and returns 0 if possible. Returns EBUSY if the mutex is taken.
+// Never blocks and does not touch |mutex|->_lock.
 int pthread_mutex_lock_internal(pthread_mutex_t *mutex) {
   const pthread_t self = pthread_self();
 
-  if (mutex->_control == PTHREAD_MUTEX_RECURSIVE && mutex->_owner == self) {
+  if (mutex->_control == PTHREAD_MUTEX_RECURSIVE &&
+      __atomic_load_n(&mutex->_owner, __ATOMIC_RELAXED) == self) {
     mutex->_refcount++;
     return 0;
   }
 
-  if (mutex->_owner != PTHREAD_T_NULL) {
-    return EBUSY;
-  }
-  mutex->_owner = self;
-  mutex->_refcount++;
-  if (mutex->_untrusted_wait_queue) {
-    enc_untrusted_enable_waiting(mutex->_untrusted_wait_queue);
-  }
-  return 0;
+  return pthread_mutex_try_acquire(mutex, self) ? 0 : EBUSY;
 }
 
+// Bit of |rwlock|._reader_count which is set while |rwlock| is write locked.
+// The remaining bits count the readers holding |rwlock|, so that both kinds of
+// acquisition are a single compare-and-swap of the same word.
+constexpr uint32_t kRwlockWriterBit = 1u << 31;
+
 // Read locks the given |rwlock| if possible and returns 0. On success,
-// |rwlock|._readers is incremented. Returns EBUSY if the |rwlock| is write
-// locked. |rwlock|._lock must be locked by the caller.
+// |rwlock|._reader_count is incremented. Returns EBUSY if the |rwlock| is write
+// locked. Never blocks and does not touch |rwlock|._lock.
 int pthread_rwlock_tryrdlock_internal(pthread_rwlock_t *rwlock) {
-  // If |rwlock| is owned by a writer it is not read lockable.
-  if (rwlock->_write_owner != PTHREAD_T_NULL) {
-    return EBUSY;
-  }
-
-  rwlock->_reader_count++;
-#ifdef _ASYLO_PTHREAD_RWLOCK_TRANSITIONAL_FLAG
-  if (rwlock->_untrusted_wait_queue) {
-    enc_untrusted_enable_waiting(rwlock->_untrusted_wait_queue);
+  uint32_t state = __atomic_load_n(&rwlock->_reader_count, __ATOMIC_RELAXED);
+  while (!(state & kRwlockWriterBit)) {
+    if (asylo::AtomicCompareExchange(&rwlock->_reader_count, &state, state + 1,
+                                     /*weak=*/true, std::memory_order_seq_cst,
+                                     std::memory_order_relaxed)) {
+      return 0;
+    }
   }
-#endif
-  return 0;
+  return EBUSY;
 }
 
 // Write locks the given |rwlock| if possible and returns 0. On success,
-// |rwlock|._write_owner is set to pthread_self().  Returns EBUSY if the
-// |rwlock| is write locked or read locked. |rwlock|._lock must be locked by the
-// caller.
+// |rwlock|._write_owner is set to pthread_self(). Returns EBUSY if the
+// |rwlock| is write locked or read locked. Never blocks and does not touch
+// |rwlock|._lock.
 int pthread_rwlock_trywrlock_internal(pthread_rwlock_t *rwlock) {
-  // If |rwlock| is owned by a reader it is not write lockable.
-  if (rwlock->_reader_count != 0) {
-    return EBUSY;
-  }
-
-  // If |rwlock| is owned by the current thread there is a deadlock.
+  // If |rwlock| is owned by the current thread there is a deadlock. Only this
+  // thread stores itself as the owner, so a stale value never matches.
   const pthread_t self = pthread_self();
-  if (rwlock->_write_owner == self) {
+  if (__atomic_load_n(&rwlock->_write_owner, __ATOMIC_RELAXED) == self) {
     return EDEADLK;
   }
 
-  // If |rwlock| is owned by another writer it is not write lockable.
-  if (rwlock->_write_owner != PTHREAD_T_NULL) {
+  uint32_t expected = 0;
+  if (!asylo::AtomicCompareExchange(&rwlock->_reader_count, &expected,
+                                    kRwlockWriterBit, /*weak=*/false,
+                                    std::memory_order_seq_cst,
+                                    std::memory_order_relaxed)) {
     return EBUSY;
   }
+  asylo::AtomicStore(&rwlock->_write_owner, self, std::memory_order_relaxed);
+  return 0;
+}
 
-  rwlock->_write_owner = self;
-#ifdef _ASYLO_PTHREAD_RWLOCK_TRANSITIONAL_FLAG
-  if (rwlock->_untrusted_wait_queue) {
-    enc_untrusted_enable_waiting(rwlock->_untrusted_wait_queue);
+#ifdef _ASYLO_PTHREAD_COND_TRANSITIONAL_FLAG
+// The mutex most recently used to wait on a condition variable. POSIX requires
+// all concurrent waiters on a condition variable to use the same mutex, so this
+// tells pthread_cond_broadcast which mutex its waiters will contend for.
+struct CondMutexEntry {
+  pthread_spinlock_t _lock;
+  const pthread_cond_t *cond;
+  pthread_mutex_t *mutex;
+};
+
+// Direct-mapped table of CondMutexEntry by condition variable address. A
+// condition variable whose entry was taken over by a colliding one is
+// broadcast by waking all its waiters.
+constexpr size_t kCondMutexTableSize = 256;
+CondMutexEntry cond_mutex_table[kCondMutexTableSize];
+
+CondMutexEntry *cond_mutex_entry(const pthread_cond_t *cond) {
+  const uintptr_t address = reinterpret_cast<uintptr_t>(cond);
+  return &cond_mutex_table[((address >> 4) ^ (address >> 12)) %
+                           kCondMutexTableSize];
+}
+
+// Records that threads wait on |cond| with |mutex|.
+void set_cond_mutex(const pthread_cond_t *cond, pthread_mutex_t *mutex) {
+  CondMutexEntry *entry = cond_mutex_entry(cond);
+  LockableGuard lock_guard(entry);
+  entry->cond = cond;
+  entry->mutex = mutex;
+}
+
+// Returns the mutex recorded for |cond|, or nullptr if there is none.
+pthread_mutex_t *get_cond_mutex(const pthread_cond_t *cond) {
+  CondMutexEntry *entry = cond_mutex_entry(cond);
+  LockableGuard lock_guard(entry);
+  return entry->cond == cond ? entry->mutex : nullptr;
+}
+
+// Forgets the mutex recorded for |cond|.
+void clear_cond_mutex(const pthread_cond_t *cond) {
+  CondMutexEntry *entry = cond_mutex_entry(cond);
+  LockableGuard lock_guard(entry);
+  if (entry->cond == cond) {
+    entry->cond = nullptr;
+    entry->mutex = nullptr;
+  }
+}
+
+// Wakes one thread waiting on |cond| and moves the other waiters to the wait
+// queue of their mutex. They are then woken one at a time as the mutex is
+// released, rather than all exiting the enclave at once to contend for it.
+// |cond|->_lock must be held and the state of the wait queue of |cond| must be
+// |value|. Returns false without waking any thread if the waiters could not be
+// moved.
+bool pthread_cond_requeue_waiters(pthread_cond_t *cond, int32_t value) {
+  // A single waiter is woken directly.
+  if (!cond->_queue._first || !cond->_queue._first->_next) {
+    return false;
+  }
+  pthread_mutex_t *mutex = get_cond_mutex(cond);
+  if (!mutex) {
+    return false;
+  }
+
+  // Register the waiters on |mutex| before moving them, so that
+  // pthread_mutex_unlock notifies the mutex wait queue until each of them has
+  // woken up.
+  asylo::pthread_impl::QueueOperations mutex_list(mutex);
+  LockableGuard mutex_guard(mutex);
+  initialize_wait_queue(&mutex->_untrusted_wait_queue);
+  if (!mutex->_untrusted_wait_queue) {
+    return false;
   }
-#endif
-  return 0;
+  for (const __pthread_list_node_t *node = cond->_queue._first; node;
+       node = node->_next) {
+    mutex_list.Enqueue(node->_thread_id);
+  }
+  mutex_guard.Unlock();
+
+  if (enc_untrusted_notify_and_requeue(cond->_untrusted_wait_queue, value,
+                                       mutex->_untrusted_wait_queue) == 0) {
+    return true;
+  }
+  mutex_guard.Lock();
+  for (const __pthread_list_node_t *node = cond->_queue._first; node;
+       node = node->_next) {
+    mutex_list.Remove(node->_thread_id);
+  }
+  return false;
 }
+#endif
 
 // Small utility function to "convert" a return value into an errno value. The
 // sem_* functions indicate errors by returning -1 and setting the global errno
@@ -219,77 +375,73 @@ asylo::ThreadManager::ThreadOptions CreateOptions(
 
 // Acquires |rwlock| with a read lock or a write lock if |TryLockFunc| is
 // set to pthread_rwlock_tryrdlock_internal() or
-// pthread_rwlock_trywrlock_internal() respectively.
+// pthread_rwlock_trywrlock_internal() respectively. An uncontended acquisition
+// takes a single compare-and-swap, so concurrent readers do not serialize on
+// |rwlock|._lock. Only a thread which has to sleep registers on the wait list
+// of |rwlock| and its untrusted wait queue.
 template <int(TryLockFunc)(pthread_rwlock_t *)>
 int pthread_rwlock_lock(pthread_rwlock_t *rwlock) {
   if (!asylo::primitives::IsValidEnclaveAddress<pthread_rwlock_t>(rwlock)) {
     return ConvertToErrno(EFAULT);
   }
 
-#ifdef _ASYLO_PTHREAD_RWLOCK_TRANSITIONAL_FLAG
-  if (!rwlock->_untrusted_wait_queue) {
-    LockableGuard lock_guard(rwlock);
-    initialize_wait_queue(&rwlock->_untrusted_wait_queue);
+  int ret = TryLockFunc(rwlock);
+  if (ret != EBUSY) {
+    return ret;
   }
-#endif
 
   const pthread_t self = pthread_self();
   asylo::pthread_impl::QueueOperations queue(rwlock);
-  int ret = 0;
-  {
-    LockableGuard lock_guard(rwlock);
-    ret = TryLockFunc(rwlock);
-    if (ret == 0) {
-      return 0;
-    }
-    if (queue.Contains(self)) {
-      return EDEADLK;
-    }
-  }
-
-  while (ret == EBUSY) {
+  while (true) {
     for (int i = 0; i < kNumSpinLockAttempts; i++) {
-      {
-        LockableGuard lock_guard(rwlock);
-        ret = TryLockFunc(rwlock);
-        if (ret == 0) {
-          return 0;
-        }
+      ret = TryLockFunc(rwlock);
+      if (ret != EBUSY) {
+        return ret;
       }
+      enc_pause();
     }
-    {
-      LockableGuard lock_guard(rwlock);
-      queue.Enqueue(self);
-    }
+
 #ifdef _ASYLO_PTHREAD_RWLOCK_TRANSITIONAL_FLAG
-    if (rwlock->_untrusted_wait_queue) {
-      enc_untrusted_thread_wait(rwlock->_untrusted_wait_queue);
+    LockableGuard lock_guard(rwlock);
+    initialize_wait_queue(&rwlock->_untrusted_wait_queue);
+    if (!rwlock->_untrusted_wait_queue) {
+      continue;
     }
-#else
-    enc_pause();
-#endif
-    {
-      LockableGuard lock_guard(rwlock);
+
+    // Register as a waiter before the final attempt, so that either the
+    // attempt succeeds or the releasing thread sees the waiter and wakes it.
+    queue.Enqueue(self);
+    enc_untrusted_enable_waiting(rwlock->_untrusted_wait_queue);
+    ret = TryLockFunc(rwlock);
+    if (ret != EBUSY) {
       queue.Remove(self);
+      return ret;
     }
+    lock_guard.Unlock();
+    enc_untrusted_thread_wait(rwlock->_untrusted_wait_queue);
+    lock_guard.Lock();
+    queue.Remove(self);
+#endif
   }
-
-  return ret;
 }
 
 void pthread_tsd_run_destructors() {
-  struct __pthread_info *self =
-      reinterpret_cast<struct __pthread_info *>(pthread_self());
-  pthread_rwlock_rdlock(&key_lock);
-  for (int i = 0; i < PTHREAD_KEYS_MAX; ++i) {
-    void *val = self->tsd[i];
-    void (*destructor)(void *) = tsd_destructors[i];
-    self->tsd[i] = nullptr;
-    if (val && destructor && destructor != NoDestructor) {
-      destructor(val);
+  // Destructors may store new values, which get further passes up to the
+  // bound given by POSIX.
+  for (int pass = 0;
+       thread_specific_values_set && pass < kMaxTsdDestructorPasses; ++pass) {
+    thread_specific_values_set = false;
+    pthread_rwlock_rdlock(&key_lock);
+    for (int i = 0; i < PTHREAD_KEYS_MAX; ++i) {
+      void *val = thread_specific_values[i];
+      void (*destructor)(void *) = tsd_destructors[i];
+      thread_specific_values[i] = nullptr;
+      if (val && destructor && destructor != NoDestructor) {
+        destructor(val);
+      }
     }
+    pthread_rwlock_unlock(&key_lock);
   }
-  pthread_rwlock_unlock(&key_lock);
 }
 
 struct start_args {
@@ -301,29 +453,16 @@ int start(void *p) {
   struct start_args *args = reinterpret_cast<struct start_args *>(p);
   asylo::ThreadManager *const thread_manager =
       asylo::ThreadManager::GetInstance();
-  thread_manager->UpdateThreadResult(pthread_self(),
-                                     args->start_func(args->start_arg));
+  void *result = args->start_func(args->start_arg);
+  // Destroy thread-specific data before the result wakes up any joiner.
   pthread_tsd_run_destructors();
+  // Enclave threads do not run the destructors of thread-local objects, so the
+  // blocks pooled by the thread are returned to the heap here.
+  asylo::internal::PoolReleaseFreeBlocks();
+  thread_manager->UpdateThreadResult(pthread_self(), result);
   return 0;
 }
 
-// Allocate thread specific data for the calling thread if it hasn't yet been
-// allocated.
-bool CheckAndAllocateThreadSpecificData() {
-  auto self = reinterpret_cast<struct __pthread_info *>(pthread_self());
-  // This can only happen in the main thread or the threads created by the host
-  // entering the enclave.
-  if (!self->tsd) {
-    void *tsd = malloc(__pthread_tsd_size);
-    if (tsd == MAP_FAILED) {
-      return false;
-    }
-    memset(tsd, 0, __pthread_tsd_size);
-    self->tsd = reinterpret_cast<void **>(tsd);
-  }
-  return true;
-}
-
 }  // namespace
 
 namespace asylo {
@@ -431,8 +570,7 @@ int pthread_create(pthread_t *thread, const pthread_attr_t *attr,
   // Store the __pthread_info and the start function in the TLS specified by
   // pthread library, so it can be accessed by other pthread functions.
   // The order is __pthread_info struct, then start function.
-  size_t size = sizeof(struct __pthread_info) + sizeof(struct start_args) +
-                __pthread_tsd_size;
+  size_t size = sizeof(struct __pthread_info) + sizeof(struct start_args);
   void *tls = mmap(/*addr=*/nullptr, size, PROT_READ | PROT_WRITE,
                    MAP_PRIVATE | MAP_ANON, /*fd=*/-1, /*offset=*/0);
   if (tls == MAP_FAILED) {
@@ -453,10 +591,6 @@ int pthread_create(pthread_t *thread, const pthread_attr_t *attr,
   args->start_func = start_routine;
   args->start_arg = arg;
 
-  void *tsd = reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(tls) + size -
-                                       __pthread_tsd_size);
-  thread_data->tsd = reinterpret_cast<void **>(tsd);
-
   pid_t parent_tid;
   int ret = enclave_clone(start, /*stack=*/nullptr, CLONE_THREAD | CLONE_SETTLS,
                           args, &parent_tid, tls, /*child_tid=*/nullptr);
@@ -479,9 +613,6 @@ int pthread_detach(pthread_t thread) {
 }
 
 int pthread_key_create(pthread_key_t *key, void (*destructor)(void *)) {
-  if (!CheckAndAllocateThreadSpecificData()) {
-    return -1;
-  }
   if (!destructor) {
     destructor = NoDestructor;
   }
@@ -499,7 +630,7 @@ int pthread_key_create(pthread_key_t *key, void (*destructor)(void *)) {
 }
 
 int pthread_key_delete(pthread_key_t key) {
-  if (key > PTHREAD_KEYS_MAX) {
+  if (key >= PTHREAD_KEYS_MAX) {
     return EINVAL;
   }
   pthread_rwlock_wrlock(&key_lock);
@@ -515,11 +646,7 @@ void *pthread_getspecific(pthread_key_t key) {
     return nullptr;
   }
 
-  if (!CheckAndAllocateThreadSpecificData()) {
-    return nullptr;
-  }
-  auto self = reinterpret_cast<struct __pthread_info *>(pthread_self());
-  return self->tsd[key];
+  return thread_specific_values[key];
 }
 
 int pthread_setspecific(pthread_key_t key, const void *value) {
@@ -528,11 +655,10 @@ int pthread_setspecific(pthread_key_t key, const void *value) {
   if (key >= PTHREAD_KEYS_MAX) {
     return EINVAL;
   }
-  if (!CheckAndAllocateThreadSpecificData()) {
-    return -1;
+  thread_specific_values[key] = const_cast<void *>(value);
+  if (value) {
+    thread_specific_values_set = true;
   }
-  auto self = reinterpret_cast<struct __pthread_info *>(pthread_self());
-  self->tsd[key] = const_cast<void *>(value);
   return 0;
 }
 // Initializes |mutex|, |attr| is unused.
@@ -561,46 +687,51 @@ int pthread_mutex_destroy(pthread_mutex_t *mutex) {
   return 0;
 }
 
-// Locks |mutex|.
+// Locks |mutex|. An uncontended lock takes a single compare-and-swap. A
+// contended lock is polled for a bounded, adaptive number of iterations
+// before the thread registers on the wait list of |mutex| and sleeps on its
+// untrusted wait queue.
 int pthread_mutex_lock(pthread_mutex_t *mutex) {
   int ret = pthread_mutex_check_parameter(mutex);
   if (ret != 0) {
     return ret;
   }
 
+  ret = pthread_mutex_lock_internal(mutex);
+  if (ret != EBUSY) {
+    return ret;
+  }
+
+  asylo::ScopedLockWait wait(mutex);
   const pthread_t self = pthread_self();
   asylo::pthread_impl::QueueOperations list(mutex);
+  while (true) {
+    if (pthread_mutex_spin_acquire(mutex, self)) {
+      return 0;
+    }
 
-  if (!mutex->_untrusted_wait_queue) {
     LockableGuard lock_guard(mutex);
-    // Ensure that the external wait queue is initialized
+    // Ensure that the external wait queue is initialized. Before the enclave
+    // is running there is no wait queue to sleep on, so keep polling.
     initialize_wait_queue(&mutex->_untrusted_wait_queue);
-  }
-
-  while (true) {
-    for (int i = 0; i < kNumSpinLockAttempts; i++) {
-      {
-        LockableGuard lock_guard(mutex);
-        ret = pthread_mutex_lock_internal(mutex);
-      }
-      if (ret == 0) {
-        return ret;
-      }
+    if (!mutex->_untrusted_wait_queue) {
+      continue;
     }
-    // Sleep on an untrusted wait queue until woken up. Waiting will
-    // be enabled if the lock is held, as the holder of the lock is
-    // responsible for enabling and disabling waiting.
-    if (mutex->_untrusted_wait_queue) {
-      {
-        LockableGuard lock_guard(mutex);
-        list.Enqueue(self);
-      }
-      enc_untrusted_thread_wait(mutex->_untrusted_wait_queue);
-      {
-        LockableGuard lock_guard(mutex);
-        list.Remove(self);
-      }
+
+    // Register as a waiter before the final attempt, so that either the
+    // attempt succeeds or the owner sees the waiter when unlocking and wakes
+    // it. The unlocking thread disables waiting on the queue first, so a wake
+    // up which happens before this thread sleeps is not lost.
+    list.Enqueue(self);
+    enc_untrusted_enable_waiting(mutex->_untrusted_wait_queue);
+    if (pthread_mutex_try_acquire(mutex, self)) {
+      list.Remove(self);
+      return 0;
     }
+    lock_guard.Unlock();
+    enc_untrusted_thread_wait(mutex->_untrusted_wait_queue);
+    lock_guard.Lock();
+    list.Remove(self);
   }
 }
 
@@ -610,39 +741,40 @@ int pthread_mutex_trylock(pthread_mutex_t *mutex) {
     return ret;
   }
 
-  LockableGuard lock_guard(mutex);
-  ret = pthread_mutex_lock_internal(mutex);
-  return ret;
+  return pthread_mutex_lock_internal(mutex);
 }
 
-// Unlocks |mutex|.
+// Unlocks |mutex|. Takes |mutex|->_lock only if a thread is waiting.
 int pthread_mutex_unlock(pthread_mutex_t *mutex) {
   int ret = pthread_mutex_check_parameter(mutex);
   if (ret != 0) {
     return ret;
   }
 
-  asylo::pthread_impl::QueueOperations list(mutex);
-  LockableGuard lock_guard(mutex);
-
-  if (mutex->_owner == PTHREAD_T_NULL) {
+  const pthread_t owner = __atomic_load_n(&mutex->_owner, __ATOMIC_RELAXED);
+  if (owner == PTHREAD_T_NULL) {
     return EINVAL;
   }
 
-  if (mutex->_owner != pthread_self()) {
+  if (owner != pthread_self()) {
     return EPERM;
   }
 
-  mutex->_refcount--;
   // If we change state from locked to unlocked
-  if (mutex->_refcount == 0) {
-    mutex->_owner = PTHREAD_T_NULL;
-    if (mutex->_untrusted_wait_queue) {
+  if (--mutex->_refcount > 0) {
+    return 0;
+  }
+  asylo::AtomicStore(&mutex->_owner, PTHREAD_T_NULL,
+                     std::memory_order_seq_cst);
+
+  // Pairs with the registration of waiters in pthread_mutex_lock: a waiter
+  // either locks the mutex after the store above or is visible here.
+  if (__atomic_load_n(&mutex->_queue._first, __ATOMIC_SEQ_CST) != nullptr) {
+    asylo::pthread_impl::QueueOperations list(mutex);
+    LockableGuard lock_guard(mutex);
+    if (mutex->_untrusted_wait_queue && !list.Empty()) {
       enc_untrusted_disable_waiting(mutex->_untrusted_wait_queue);
-      // Only notify if there is a thread to notify
-      if (!list.Empty()) {
-        enc_untrusted_notify(mutex->_untrusted_wait_queue);
-      }
+      enc_untrusted_notify(mutex->_untrusted_wait_queue);
     }
   }
 
@@ -675,6 +807,9 @@ int pthread_cond_destroy(pthread_cond_t *cond) {
     return EFAULT;
   }
 
+#ifdef _ASYLO_PTHREAD_COND_TRANSITIONAL_FLAG
+  clear_cond_mutex(cond);
+#endif
   return 0;
 }
 
@@ -730,6 +865,7 @@ int pthread_cond_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex,
     if (cond->_untrusted_wait_queue) {
       enc_untrusted_wait_queue_set_value(cond->_untrusted_wait_queue, self_32);
     }
+    set_cond_mutex(cond, mutex);
 #endif
     list.Enqueue(self);
   }
@@ -776,6 +912,16 @@ int pthread_cond_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex,
     list.Remove(self);
   }
 
+  // pthread_cond_broadcast may have registered this thread as a waiter on
+  // |mutex| when moving it to the mutex wait queue, possibly more than once if
+  // it was moved again before leaving the list of |cond|.
+  if (__atomic_load_n(&mutex->_queue._first, __ATOMIC_ACQUIRE) != nullptr) {
+    asylo::pthread_impl::QueueOperations mutex_list(mutex);
+    LockableGuard lock_guard(mutex);
+    while (mutex_list.Remove(self)) {
+    }
+  }
+
   if (deadline) {
     // Check if awoken up due to timeout.
     timespec curr_time;
@@ -861,7 +1007,8 @@ int pthread_cond_notify_internal(pthread_cond_t *cond, int num_threads) {
     const int32_t self = static_cast<int32_t>(pthread_self());
     LockableGuard lock_guard(cond);
     enc_untrusted_wait_queue_set_value(cond->_untrusted_wait_queue, self);
-    if (!list.Empty()) {
+    if (!list.Empty() &&
+        (num_threads == 1 || !pthread_cond_requeue_waiters(cond, self))) {
       enc_untrusted_notify(cond->_untrusted_wait_queue, num_threads);
     }
   }
@@ -1022,7 +1169,6 @@ int pthread_rwlock_tryrdlock(pthread_rwlock_t *rwlock) {
     return ConvertToErrno(EFAULT);
   }
 
-  LockableGuard lock_guard(rwlock);
   return pthread_rwlock_tryrdlock_internal(rwlock);
 }
 
@@ -1031,7 +1177,6 @@ int pthread_rwlock_trywrlock(pthread_rwlock_t *rwlock) {
     return ConvertToErrno(EFAULT);
   }
 
-  LockableGuard lock_guard(rwlock);
   return pthread_rwlock_trywrlock_internal(rwlock);
 }
 
@@ -1048,29 +1193,39 @@ int pthread_rwlock_unlock(pthread_rwlock_t *rwlock) {
     return ConvertToErrno(EFAULT);
   }
 
-  asylo::pthread_impl::QueueOperations list(rwlock);
-  LockableGuard lock_guard(rwlock);
-
-  const pthread_t self = pthread_self();
-  if (rwlock->_write_owner == self) {
-    rwlock->_write_owner = PTHREAD_T_NULL;
-#ifdef _ASYLO_PTHREAD_RWLOCK_TRANSITIONAL_FLAG
-    if (rwlock->_untrusted_wait_queue) {
-      enc_untrusted_disable_waiting(rwlock->_untrusted_wait_queue);
-      if (!list.Empty()) {
-        enc_untrusted_notify(rwlock->_untrusted_wait_queue);
-      }
+  // A released write lock may admit every waiting reader, while a released
+  // read lock only admits a single waiting writer.
+  int32_t num_to_wake = 1;
+  const uint32_t state =
+      __atomic_load_n(&rwlock->_reader_count, __ATOMIC_RELAXED);
+  if (state & kRwlockWriterBit) {
+    if (__atomic_load_n(&rwlock->_write_owner, __ATOMIC_RELAXED) !=
+        pthread_self()) {
+      return EPERM;
+    }
+    asylo::AtomicStore(&rwlock->_write_owner, PTHREAD_T_NULL,
+                       std::memory_order_relaxed);
+    asylo::AtomicStore(&rwlock->_reader_count, 0u, std::memory_order_seq_cst);
+    num_to_wake = INT32_MAX;
+  } else {
+    if (state == 0) {
+      return EPERM;
+    }
+    if (asylo::AtomicDecrement(&rwlock->_reader_count,
+                               std::memory_order_seq_cst) != 1) {
+      return 0;
     }
-#endif
-    return 0;
   }
 
-  rwlock->_reader_count--;
 #ifdef _ASYLO_PTHREAD_RWLOCK_TRANSITIONAL_FLAG
-  if (rwlock->_reader_count == 0 && rwlock->_untrusted_wait_queue) {
-    enc_untrusted_disable_waiting(rwlock->_untrusted_wait_queue);
-    if (!list.Empty()) {
-      enc_untrusted_notify(rwlock->_untrusted_wait_queue);
+  // Pairs with the registration of waiters in pthread_rwlock_lock: a waiter
+  // either acquires |rwlock| after the release above or is visible here.
+  if (__atomic_load_n(&rwlock->_queue._first, __ATOMIC_SEQ_CST) != nullptr) {
+    asylo::pthread_impl::QueueOperations list(rwlock);
+    LockableGuard lock_guard(rwlock);
+    if (rwlock->_untrusted_wait_queue && !list.Empty()) {
+      enc_untrusted_disable_waiting(rwlock->_untrusted_wait_queue);
+      enc_untrusted_notify(rwlock->_untrusted_wait_queue, num_to_wake);
     }
   }
 #endif
@@ -1084,7 +1239,7 @@ int pthread_rwlock_destroy(pthread_rwlock_t *rwlock) {
 
   LockableGuard lock_guard(rwlock);
   asylo::pthread_impl::QueueOperations queue(rwlock);
-  if (rwlock->_write_owner == PTHREAD_T_NULL && queue.Empty()) {
+  if (rwlock->_reader_count == 0 && queue.Empty()) {
     return 0;
   }
 
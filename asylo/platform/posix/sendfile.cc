@@ -0,0 +1,45 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#include <unistd.h>
+
+#include "asylo/platform/posix/io/io_manager.h"
+
+using asylo::io::IOManager;
+
+extern "C" {
+
+ssize_t sendfile(int out_fd, int in_fd, off_t *offset, size_t count) {
+  return IOManager::GetInstance().SendFile(out_fd, in_fd, offset, count);
+}
+
+ssize_t splice(int fd_in, off_t *off_in, int fd_out, off_t *off_out,
+               size_t len, unsigned int flags) {
+  return IOManager::GetInstance().Splice(fd_in, off_in, fd_out, off_out, len,
+                                         flags);
+}
+
+ssize_t copy_file_range(int fd_in, off_t *off_in, int fd_out, off_t *off_out,
+                        size_t len, unsigned int flags) {
+  return IOManager::GetInstance().CopyFileRange(fd_in, off_in, fd_out, off_out,
+                                                len, flags);
+}
+
+}  // extern "C"
@@ -26,6 +26,7 @@
 #include "absl/synchronization/mutex.h"
 #include "asylo/platform/core/trusted_global_state.h"
 #include "asylo/platform/host_call/trusted/host_calls.h"
+#include "asylo/platform/posix/io/output_buffer.h"
 #include "asylo/platform/posix/signal/signal_manager.h"
 #include "asylo/platform/posix/syscall/signal_syscalls.h"
 #include "asylo/platform/primitives/trusted_runtime.h"
@@ -69,6 +70,14 @@ sighandler_t signal(int signum, sighandler_t handler) {
 // signal on the host. If a handler has been registered for this signal in the
 // enclave, the signal handler on the host enters the enclave to invoke the
 // registered handler.
-int raise(int sig) { return enc_untrusted_raise(sig); }
+//
+// abort(3) raises SIGABRT, which usually terminates the process on the host, so
+// buffered output is flushed beforehand where possible.
+int raise(int sig) {
+  if (sig == SIGABRT) {
+    asylo::io::OutputBuffer::FlushAllBestEffort();
+  }
+  return enc_untrusted_raise(sig);
+}
 
 }  // extern "C"
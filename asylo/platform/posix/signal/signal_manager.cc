@@ -20,9 +20,6 @@
 
 #include <signal.h>
 
-#include "absl/memory/memory.h"
-#include "absl/strings/str_cat.h"
-#include "absl/synchronization/mutex.h"
 #include "asylo/util/lock_guard.h"
 
 namespace asylo {
@@ -30,12 +27,18 @@ namespace {
 
 constexpr int kMaxSignalsInMask = sizeof(sigset_t) * 8;
 
+// Number of lock-free attempts to read a signal handler before reading it under
+// the lock, for the rare case of a handler updated by the interrupted thread.
+constexpr int kMaxSigActionReadAttempts = 64;
+
 sigset_t EmptySigSet() {
   sigset_t set;
   sigemptyset(&set);
   return set;
 }
 
+bool IsValidSignal(int signum) { return signum > 0 && signum < kNumberSignals; }
+
 }  // namespace
 
 thread_local sigset_t SignalManager::signal_mask_ = EmptySigSet();
@@ -43,7 +46,12 @@ thread_local sigset_t SignalManager::signal_mask_ = EmptySigSet();
 // Initialize the spin locks to be recursive so that signal handling does not
 // cause deadlock if a signal arrives while the thread is registering a signal.
 SignalManager::SignalManager() : signal_maps_lock_(/*is_recursive=*/true) {
-  signal_to_reset_.fill(ResetStatus::NO_RESET);
+  for (auto &reset : signal_to_reset_) {
+    reset.store(ResetStatus::NO_RESET, std::memory_order_relaxed);
+  }
+  for (auto &delivery : signal_to_delivery_) {
+    delivery.store(kIdle, std::memory_order_relaxed);
+  }
 }
 
 SignalManager *SignalManager::GetInstance() {
@@ -58,23 +66,79 @@ void SignalManager::HandleSignal(int signum, siginfo_t *info, void *ucontext) {
       !GetSigAction(signum, &act)) {
     return;
   }
-  // If it's the first time a to-be-reset signal arrives, continue invoking the
-  // handler, but mark the signal as reset.
-  if (GetResetStatus(signum) == ResetStatus::TO_BE_RESET) {
-    SetResetStatus(signum, ResetStatus::RESET);
+  bool coalesce = !(act.sa_flags & SA_NODEFER);
+  if (coalesce && !BeginDelivery(signum)) {
+    return;
   }
-  sigset_t old_mask = GetSignalMask();
-  BlockSignals(act.sa_mask);
-  bool is_siginfo = act.sa_flags & SA_SIGINFO;
-  if (is_siginfo && act.sa_sigaction) {
-    act.sa_sigaction(signum, info, ucontext);
-  } else if (!is_siginfo && act.sa_handler) {
-    act.sa_handler(signum);
+  while (true) {
+    // If it's the first time a to-be-reset signal arrives, continue invoking
+    // the handler, but mark the signal as reset.
+    ResetStatus to_be_reset = ResetStatus::TO_BE_RESET;
+    signal_to_reset_[signum].compare_exchange_strong(
+        to_be_reset, ResetStatus::RESET, std::memory_order_relaxed);
+    sigset_t old_mask = GetSignalMask();
+    BlockSignals(act.sa_mask);
+    bool is_siginfo = act.sa_flags & SA_SIGINFO;
+    if (is_siginfo && act.sa_sigaction) {
+      act.sa_sigaction(signum, info, ucontext);
+    } else if (!is_siginfo && act.sa_handler) {
+      act.sa_handler(signum);
+    }
+    SetSignalMask(old_mask);
+    if (!coalesce || EndDelivery(signum)) {
+      return;
+    }
+    // The signal was delivered again while the handler was running. Call the
+    // handler now registered, if any, once more.
+    if (GetResetStatus(signum) == ResetStatus::RESET ||
+        !GetSigAction(signum, &act)) {
+      signal_to_delivery_[signum].store(kIdle, std::memory_order_release);
+      return;
+    }
+  }
+}
+
+bool SignalManager::BeginDelivery(int signum) {
+  std::atomic<int> &delivery = signal_to_delivery_[signum];
+  int state = delivery.load(std::memory_order_acquire);
+  while (true) {
+    if (state == kPending) {
+      return false;
+    }
+    int next = state == kIdle ? kRunning : kPending;
+    if (delivery.compare_exchange_weak(state, next,
+                                       std::memory_order_acq_rel)) {
+      return state == kIdle;
+    }
+  }
+}
+
+bool SignalManager::EndDelivery(int signum) {
+  std::atomic<int> &delivery = signal_to_delivery_[signum];
+  int state = kRunning;
+  if (delivery.compare_exchange_strong(state, kIdle,
+                                       std::memory_order_acq_rel)) {
+    return true;
   }
-  SetSignalMask(old_mask);
+  delivery.store(kRunning, std::memory_order_relaxed);
+  return false;
+}
+
+void SignalManager::PublishSigAction(int signum, const struct sigaction &act,
+                                     bool registered) {
+  SigActionSlot &slot = signal_to_sigaction_[signum];
+  uint64_t sequence = slot.sequence.load(std::memory_order_relaxed);
+  slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.act = act;
+  slot.registered = registered;
+  slot.sequence.store(sequence + 2, std::memory_order_release);
 }
 
 void SignalManager::SetSigAction(int signum, const struct sigaction &act) {
+  if (!IsValidSignal(signum)) {
+    return;
+  }
   // To avoid deadlock, block all signals before registering a signal handler.
   sigset_t mask;
   sigfillset(&mask);
@@ -82,27 +146,42 @@ void SignalManager::SetSigAction(int signum, const struct sigaction &act) {
   sigprocmask(SIG_SETMASK, &mask, &old_mask);
   {
     LockGuard lock(&signal_maps_lock_);
-    signal_to_sigaction_[signum] = absl::make_unique<struct sigaction>(act);
+    PublishSigAction(signum, act, /*registered=*/true);
   }
   // Set the signal mask back to the original one to unblock the signals.
   sigprocmask(SIG_SETMASK, &old_mask, nullptr);
 }
 
 bool SignalManager::GetSigAction(int signum, struct sigaction *act) {
-  LockGuard lock(&signal_maps_lock_);
-  auto sigaction_iterator = signal_to_sigaction_.find(signum);
-  if (sigaction_iterator == signal_to_sigaction_.end()) {
+  if (!IsValidSignal(signum)) {
     return false;
   }
-  *act = *sigaction_iterator->second;
-  return true;
+  const SigActionSlot &slot = signal_to_sigaction_[signum];
+  for (int attempt = 0; attempt < kMaxSigActionReadAttempts; ++attempt) {
+    uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence & 1) {
+      continue;
+    }
+    bool registered = slot.registered;
+    *act = slot.act;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) == sequence) {
+      return registered;
+    }
+  }
+  LockGuard lock(&signal_maps_lock_);
+  *act = slot.act;
+  return slot.registered;
 }
 
 void SignalManager::ClearSigAction(int signum) {
+  if (!IsValidSignal(signum)) {
+    return;
+  }
   LockGuard lock(&signal_maps_lock_);
-  signal_to_sigaction_.erase(signum);
+  PublishSigAction(signum, signal_to_sigaction_[signum].act,
+                   /*registered=*/false);
 }
-
 void SignalManager::BlockSignals(const sigset_t &set) {
   for (int signum = 0; signum < kMaxSignalsInMask; ++signum) {
     if (sigismember(&set, signum)) {
@@ -139,16 +218,14 @@ void SignalManager::SetResetStatus(int signum,
   if (signum < 0 || signum >= kNumberSignals) {
     return;
   }
-  LockGuard lock(&signal_maps_lock_);
-  signal_to_reset_[signum] = status;
+  signal_to_reset_[signum].store(status, std::memory_order_relaxed);
 }
 
 SignalManager::ResetStatus SignalManager::GetResetStatus(int signum) {
   if (signum < 0 || signum >= kNumberSignals) {
     return ResetStatus::NOT_AVAILABLE;
   }
-  LockGuard lock(&signal_maps_lock_);
-  return signal_to_reset_[signum];
+  return signal_to_reset_[signum].load(std::memory_order_relaxed);
 }
 
 }  // namespace asylo
@@ -21,9 +21,9 @@
 
 #include <signal.h>
 
-#include <memory>
-#include <unordered_map>
-#include <unordered_set>
+#include <array>
+#include <atomic>
+#include <cstdint>
 
 #include "asylo/platform/core/trusted_spin_lock.h"
 #include "asylo/util/status.h"
@@ -47,7 +47,11 @@ class SignalManager {
 
   static SignalManager *GetInstance();
 
-  // Locates and calls the handler registered for |signum|.
+  // Locates and calls the handler registered for |signum| without taking a
+  // lock. Unless the handler was registered with SA_NODEFER, a delivery of
+  // |signum| while its handler is running is coalesced into a single further
+  // call of the handler by the running thread, like a standard signal that is
+  // pending while blocked.
   void HandleSignal(int signum, siginfo_t *info, void *ucontext);
 
   // Sets a signal handler pointer for a specific signal |signum|.
@@ -85,14 +89,45 @@ class SignalManager {
   SignalManager(SignalManager const &) = delete;
   void operator=(SignalManager const &) = delete;
 
+  // The handler registered for a signal. Written under |signal_maps_lock_| and
+  // read without a lock.
+  struct SigActionSlot {
+    // Incremented before and after each update of |act| and |registered|, so
+    // it is odd while an update is in progress.
+    std::atomic<uint64_t> sequence{0};
+    bool registered = false;
+    struct sigaction act;
+  };
+
+  // The delivery state of a signal: whether its handler is running, and
+  // whether it was delivered again meanwhile.
+  enum DeliveryState : int {
+    kIdle = 0,
+    kRunning = 1,
+    kPending = 2,
+  };
+
+  // Stores |act| and |registered| in the slot of |signum|.
+  void PublishSigAction(int signum, const struct sigaction &act,
+                        bool registered);
+
+  // Marks |signum| as running. Returns false if its handler is already running,
+  // in which case the running thread calls it once more.
+  bool BeginDelivery(int signum);
+
+  // Marks |signum| as idle. Returns false if it was delivered again while its
+  // handler was running, in which case it remains running.
+  bool EndDelivery(int signum);
+
   // Use spin lock in SignalManager to avoid exiting the enclave while handling
-  // the signal.
+  // the signal. Serializes updates of the signal handlers.
   TrustedSpinLock signal_maps_lock_;
 
-  std::unordered_map<int, std::unique_ptr<struct sigaction>>
-      signal_to_sigaction_;
+  std::array<SigActionSlot, kNumberSignals> signal_to_sigaction_;
+
+  std::array<std::atomic<ResetStatus>, kNumberSignals> signal_to_reset_;
 
-  std::array<ResetStatus, kNumberSignals> signal_to_reset_;
+  std::array<std::atomic<int>, kNumberSignals> signal_to_delivery_;
 
   thread_local static sigset_t signal_mask_;
 };
@@ -0,0 +1,268 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/sockets/addrinfo_cache.h"
+
+#include <errno.h>
+#include <netdb.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "asylo/util/thread.h"
+
+namespace asylo {
+namespace {
+
+// Releases a list built by AddrinfoCache::CopyOut(), or by
+// enc_untrusted_getaddrinfo().
+void FreeCopy(struct addrinfo *res) {
+  while (res != nullptr) {
+    struct addrinfo *next = res->ai_next;
+    free(res->ai_addr);
+    free(res->ai_canonname);
+    free(res);
+    res = next;
+  }
+}
+
+}  // namespace
+
+bool AddrinfoCache::Key::operator==(const Key &other) const {
+  return has_hints == other.has_hints && has_node == other.has_node &&
+         node == other.node && has_service == other.has_service &&
+         service == other.service && flags == other.flags &&
+         family == other.family && socktype == other.socktype &&
+         protocol == other.protocol;
+}
+
+AddrinfoCache::AddrinfoCache(const AddrinfoCacheOptions &options,
+                             Resolver resolve, Releaser release,
+                             Scheduler schedule, Clock now)
+    : options_(options),
+      resolve_(std::move(resolve)),
+      release_(std::move(release)),
+      schedule_(schedule ? std::move(schedule)
+                         : [](std::function<void()> task) {
+                             Thread::StartDetached(std::move(task));
+                           }),
+      now_(now ? std::move(now) : [] { return absl::Now(); }) {}
+
+AddrinfoCache::~AddrinfoCache() {
+  absl::MutexLock lock(&mu_);
+  mu_.Await(absl::Condition(
+      +[](int *pending_refreshes) { return *pending_refreshes == 0; },
+      &pending_refreshes_));
+}
+
+int AddrinfoCache::GetAddrinfo(const char *node, const char *service,
+                               const struct addrinfo *hints,
+                               struct addrinfo **res) {
+  Key key;
+  key.has_hints = hints != nullptr;
+  key.has_node = node != nullptr;
+  key.node = node ? node : "";
+  key.has_service = service != nullptr;
+  key.service = service ? service : "";
+  key.flags = hints ? hints->ai_flags : 0;
+  key.family = hints ? hints->ai_family : AF_UNSPEC;
+  key.socktype = hints ? hints->ai_socktype : 0;
+  key.protocol = hints ? hints->ai_protocol : 0;
+
+  bool hit = false;
+  bool refresh = false;
+  int result = 0;
+  {
+    absl::MutexLock lock(&mu_);
+    absl::Time now = now_();
+    auto it = entries_.find(key);
+    if (it == entries_.end() || now >= it->second.expiration) {
+      ++stats_.misses;
+    } else {
+      Entry &entry = it->second;
+      lru_.splice(lru_.begin(), lru_, entry.lru_position);
+      if (entry.error != 0) {
+        ++stats_.negative_hits;
+        return entry.error;
+      }
+      ++stats_.hits;
+      if (!entry.refreshing &&
+          entry.expiration - now <= options_.refresh_window) {
+        entry.refreshing = true;
+        ++pending_refreshes_;
+        refresh = true;
+      }
+      hit = true;
+      result = CopyOut(entry.addresses, res);
+    }
+  }
+
+  if (hit) {
+    if (refresh) {
+      schedule_([this, key] { Refresh(key); });
+    }
+    return result;
+  }
+
+  // Misses are resolved without holding the lock, so that a slow lookup does
+  // not hold up the others.
+  std::vector<Address> addresses;
+  result = Resolve(key, &addresses, res);
+  int saved_errno = errno;
+  {
+    absl::MutexLock lock(&mu_);
+    Store(key, result, std::move(addresses));
+  }
+  errno = saved_errno;
+  return result;
+}
+
+void AddrinfoCache::Clear() {
+  absl::MutexLock lock(&mu_);
+  entries_.clear();
+  lru_.clear();
+}
+
+AddrinfoCacheStats AddrinfoCache::GetStats() const {
+  absl::MutexLock lock(&mu_);
+  return stats_;
+}
+
+int AddrinfoCache::CopyOut(const std::vector<Address> &addresses,
+                           struct addrinfo **res) {
+  struct addrinfo *head = nullptr;
+  struct addrinfo **tail = &head;
+  for (const Address &address : addresses) {
+    auto *info =
+        static_cast<struct addrinfo *>(calloc(1, sizeof(struct addrinfo)));
+    if (info == nullptr) {
+      FreeCopy(head);
+      return EAI_MEMORY;
+    }
+    *tail = info;
+    tail = &info->ai_next;
+
+    info->ai_flags = address.flags;
+    info->ai_family = address.family;
+    info->ai_socktype = address.socktype;
+    info->ai_protocol = address.protocol;
+    info->ai_addrlen = address.addr.size();
+    info->ai_addr = static_cast<struct sockaddr *>(malloc(address.addr.size()));
+    if (address.has_canonname) {
+      info->ai_canonname = strdup(address.canonname.c_str());
+    }
+    if (info->ai_addr == nullptr ||
+        (address.has_canonname && info->ai_canonname == nullptr)) {
+      FreeCopy(head);
+      return EAI_MEMORY;
+    }
+    memcpy(info->ai_addr, address.addr.data(), address.addr.size());
+  }
+  *res = head;
+  return 0;
+}
+
+int AddrinfoCache::Resolve(const Key &key, std::vector<Address> *addresses,
+                           struct addrinfo **res) {
+  struct addrinfo hints = {};
+  hints.ai_flags = key.flags;
+  hints.ai_family = key.family;
+  hints.ai_socktype = key.socktype;
+  hints.ai_protocol = key.protocol;
+
+  struct addrinfo *result = nullptr;
+  int error = resolve_(key.has_node ? key.node.c_str() : nullptr,
+                       key.has_service ? key.service.c_str() : nullptr,
+                       key.has_hints ? &hints : nullptr, &result);
+  if (error != 0) {
+    return error;
+  }
+
+  for (const struct addrinfo *info = result; info != nullptr;
+       info = info->ai_next) {
+    Address address;
+    address.flags = info->ai_flags;
+    address.family = info->ai_family;
+    address.socktype = info->ai_socktype;
+    address.protocol = info->ai_protocol;
+    address.addr.assign(reinterpret_cast<const char *>(info->ai_addr),
+                        info->ai_addr ? info->ai_addrlen : 0);
+    address.has_canonname = info->ai_canonname != nullptr;
+    if (address.has_canonname) {
+      address.canonname = info->ai_canonname;
+    }
+    addresses->push_back(std::move(address));
+  }
+
+  if (res != nullptr) {
+    *res = result;
+  } else {
+    release_(result);
+  }
+  return 0;
+}
+
+void AddrinfoCache::Store(const Key &key, int error,
+                          std::vector<Address> addresses) {
+  // Only the absence of a name is worth remembering. Other errors, such as
+  // EAI_AGAIN or EAI_SYSTEM, may not recur on the next attempt.
+  if ((error != 0 && error != EAI_NONAME) || options_.max_entries == 0) {
+    return;
+  }
+
+  auto it = entries_.find(key);
+  if (it == entries_.end()) {
+    while (entries_.size() >= options_.max_entries) {
+      entries_.erase(lru_.back());
+      lru_.pop_back();
+      ++stats_.evictions;
+    }
+    lru_.push_front(key);
+    it = entries_.emplace(key, Entry()).first;
+    it->second.lru_position = lru_.begin();
+  } else {
+    lru_.splice(lru_.begin(), lru_, it->second.lru_position);
+  }
+
+  Entry &entry = it->second;
+  entry.error = error;
+  entry.addresses = std::move(addresses);
+  entry.expiration =
+      now_() + (error == 0 ? options_.ttl : options_.negative_ttl);
+}
+
+void AddrinfoCache::Refresh(const Key &key) {
+  std::vector<Address> addresses;
+  int error = Resolve(key, &addresses, /*res=*/nullptr);
+
+  absl::MutexLock lock(&mu_);
+  ++stats_.refreshes;
+  --pending_refreshes_;
+  auto it = entries_.find(key);
+  // A lookup which was evicted or cleared meanwhile is not brought back, and a
+  // transient error leaves the cached lookup in place until it expires.
+  if (it != entries_.end()) {
+    it->second.refreshing = false;
+    Store(key, error, std::move(addresses));
+  }
+}
+
+}  // namespace asylo
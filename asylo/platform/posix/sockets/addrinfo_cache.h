@@ -0,0 +1,199 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_POSIX_SOCKETS_ADDRINFO_CACHE_H_
+#define ASYLO_PLATFORM_POSIX_SOCKETS_ADDRINFO_CACHE_H_
+
+#include <netdb.h>
+#include <sys/socket.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+
+namespace asylo {
+
+// Limits of an AddrinfoCache.
+struct AddrinfoCacheOptions {
+  // Maximum number of cached lookups. The least recently used lookup is
+  // evicted to make room for a new one.
+  size_t max_entries = 256;
+
+  // How long a successful lookup is served from the cache. getaddrinfo() does
+  // not report the TTL of the DNS records it resolved, so this is a fixed bound
+  // on how stale a cached address may be.
+  absl::Duration ttl = absl::Seconds(30);
+
+  // How long a lookup of a name which does not exist (EAI_NONAME) is served
+  // from the cache. Other errors are transient and never cached.
+  absl::Duration negative_ttl = absl::Seconds(5);
+
+  // A hit on a successful lookup which expires within this window starts a
+  // refresh of the lookup in the background, while the hit is served from the
+  // cache. Lookups in steady use thus never wait for the host.
+  absl::Duration refresh_window = absl::Seconds(5);
+};
+
+// Counters of an AddrinfoCache.
+struct AddrinfoCacheStats {
+  uint64_t hits = 0;
+  uint64_t negative_hits = 0;
+  uint64_t misses = 0;
+  uint64_t refreshes = 0;
+  uint64_t evictions = 0;
+};
+
+// A cache of getaddrinfo() results inside the enclave. Each lookup forwarded to
+// the host is an exit from the enclave plus a round trip to the host resolver,
+// which dominates the cost of connecting to a service by name.
+//
+// Lookups are keyed by node, service and the flags, family, socket type and
+// protocol of the hints. The cache keeps its own copies of the results, and
+// returns each caller a separate malloc()-allocated addrinfo list, in the same
+// layout as the lists built by enc_untrusted_getaddrinfo(), so that they are
+// released by freeaddrinfo() as usual.
+//
+// This class is thread-safe.
+class AddrinfoCache {
+ public:
+  // Resolves a lookup, with the semantics of getaddrinfo().
+  using Resolver =
+      std::function<int(const char *node, const char *service,
+                        const struct addrinfo *hints, struct addrinfo **res)>;
+
+  // Releases a list returned by a Resolver.
+  using Releaser = std::function<void(struct addrinfo *res)>;
+
+  // Runs |task| asynchronously.
+  using Scheduler = std::function<void(std::function<void()> task)>;
+
+  // Returns the current time.
+  using Clock = std::function<absl::Time()>;
+
+  // Creates a cache which resolves misses with |resolve| and releases their
+  // results with |release|. Refreshes are run by |schedule|, on a detached
+  // thread by default, and expiration follows |now|, absl::Now() by default.
+  AddrinfoCache(const AddrinfoCacheOptions &options, Resolver resolve,
+                Releaser release, Scheduler schedule = nullptr,
+                Clock now = nullptr);
+
+  // Waits for the refreshes in progress. A custom |schedule| must therefore run
+  // every task it is given.
+  ~AddrinfoCache();
+
+  AddrinfoCache(const AddrinfoCache &other) = delete;
+  AddrinfoCache &operator=(const AddrinfoCache &other) = delete;
+
+  // Looks up |node| and |service| like getaddrinfo(), from the cache if
+  // possible.
+  int GetAddrinfo(const char *node, const char *service,
+                  const struct addrinfo *hints, struct addrinfo **res);
+
+  // Drops all cached lookups.
+  void Clear();
+
+  AddrinfoCacheStats GetStats() const;
+
+ private:
+  struct Key {
+    bool has_hints;
+    bool has_node;
+    std::string node;
+    bool has_service;
+    std::string service;
+    int flags;
+    int family;
+    int socktype;
+    int protocol;
+
+    bool operator==(const Key &other) const;
+
+    template <typename H>
+    friend H AbslHashValue(H hash, const Key &key) {
+      return H::combine(std::move(hash), key.has_hints, key.has_node,
+                        key.node, key.has_service, key.service, key.flags,
+                        key.family, key.socktype, key.protocol);
+    }
+  };
+
+  // A copy of one element of an addrinfo list.
+  struct Address {
+    int flags;
+    int family;
+    int socktype;
+    int protocol;
+    std::string addr;
+    bool has_canonname;
+    std::string canonname;
+  };
+
+  struct Entry {
+    // Result of the lookup, with |addresses| only set if it is zero.
+    int error;
+    std::vector<Address> addresses;
+    absl::Time expiration;
+    bool refreshing = false;
+    std::list<Key>::iterator lru_position;
+  };
+
+  // Copies |addresses| into a new addrinfo list in |*res|. Returns EAI_MEMORY
+  // if allocating the list fails.
+  static int CopyOut(const std::vector<Address> &addresses,
+                     struct addrinfo **res);
+
+  // Resolves |key| with |resolve_|. On success, copies the result into
+  // |addresses| and then either moves it into |*res|, if |res| is not null, or
+  // releases it.
+  int Resolve(const Key &key, std::vector<Address> *addresses,
+              struct addrinfo **res);
+
+  // Caches the outcome of resolving |key|, unless it is a transient error.
+  void Store(const Key &key, int error, std::vector<Address> addresses)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Refreshes the cached lookup of |key|.
+  void Refresh(const Key &key);
+
+  const AddrinfoCacheOptions options_;
+  const Resolver resolve_;
+  const Releaser release_;
+  const Scheduler schedule_;
+  const Clock now_;
+
+  mutable absl::Mutex mu_;
+  absl::flat_hash_map<Key, Entry> entries_ ABSL_GUARDED_BY(mu_);
+
+  // Keys of |entries_|, from the most to the least recently used.
+  std::list<Key> lru_ ABSL_GUARDED_BY(mu_);
+
+  int pending_refreshes_ ABSL_GUARDED_BY(mu_) = 0;
+  AddrinfoCacheStats stats_ ABSL_GUARDED_BY(mu_);
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_POSIX_SOCKETS_ADDRINFO_CACHE_H_
@@ -0,0 +1,292 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/sockets/addrinfo_cache.h"
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/memory/memory.h"
+#include "absl/time/time.h"
+
+namespace asylo {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::IsEmpty;
+using ::testing::IsNull;
+using ::testing::StrEq;
+
+void FreeList(struct addrinfo *res) {
+  while (res != nullptr) {
+    struct addrinfo *next = res->ai_next;
+    free(res->ai_addr);
+    free(res->ai_canonname);
+    free(res);
+    res = next;
+  }
+}
+
+// Returns the IPv4 addresses of |res| in dotted notation.
+std::vector<std::string> Addresses(const struct addrinfo *res) {
+  std::vector<std::string> addresses;
+  for (; res != nullptr; res = res->ai_next) {
+    char buffer[INET_ADDRSTRLEN];
+    const auto *addr =
+        reinterpret_cast<const struct sockaddr_in *>(res->ai_addr);
+    addresses.push_back(
+        inet_ntop(AF_INET, &addr->sin_addr, buffer, sizeof(buffer)));
+  }
+  return addresses;
+}
+
+class AddrinfoCacheTest : public ::testing::Test {
+ protected:
+  AddrinfoCacheTest() { options_.max_entries = 2; }
+
+  // The cache waits for its pending refreshes when it is destroyed.
+  void TearDown() override { RunTasks(); }
+
+  // Creates the cache under test, which resolves names from |addresses_|.
+  void CreateCache() {
+    cache_ = absl::make_unique<AddrinfoCache>(
+        options_,
+        [this](const char *node, const char *service,
+               const struct addrinfo *hints, struct addrinfo **res) {
+          return Resolve(node, hints, res);
+        },
+        FreeList,
+        [this](std::function<void()> task) {
+          tasks_.push_back(std::move(task));
+        },
+        [this] { return now_; });
+  }
+
+  int Resolve(const char *node, const struct addrinfo *hints,
+              struct addrinfo **res) {
+    ++lookups_;
+    if (transient_failure_) {
+      return EAI_AGAIN;
+    }
+    auto it = addresses_.find(node);
+    if (it == addresses_.end()) {
+      return EAI_NONAME;
+    }
+    struct addrinfo **tail = res;
+    for (const std::string &address : it->second) {
+      auto *info =
+          static_cast<struct addrinfo *>(calloc(1, sizeof(struct addrinfo)));
+      auto *addr = static_cast<struct sockaddr_in *>(
+          calloc(1, sizeof(struct sockaddr_in)));
+      addr->sin_family = AF_INET;
+      inet_pton(AF_INET, address.c_str(), &addr->sin_addr);
+      info->ai_family = AF_INET;
+      info->ai_socktype = hints ? hints->ai_socktype : 0;
+      info->ai_addrlen = sizeof(*addr);
+      info->ai_addr = reinterpret_cast<struct sockaddr *>(addr);
+      info->ai_canonname = tail == res ? strdup(node) : nullptr;
+      *tail = info;
+      tail = &info->ai_next;
+    }
+    return 0;
+  }
+
+  // Looks up |node| through the cache and returns its addresses.
+  std::vector<std::string> Lookup(const char *node, int *error = nullptr) {
+    struct addrinfo hints = {};
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *res = nullptr;
+    int result = cache_->GetAddrinfo(node, "80", &hints, &res);
+    if (error) {
+      *error = result;
+    }
+    std::vector<std::string> addresses = Addresses(res);
+    FreeList(res);
+    return addresses;
+  }
+
+  void RunTasks() {
+    std::vector<std::function<void()>> tasks;
+    tasks.swap(tasks_);
+    for (auto &task : tasks) {
+      task();
+    }
+  }
+
+  AddrinfoCacheOptions options_;
+  std::unique_ptr<AddrinfoCache> cache_;
+  std::map<std::string, std::vector<std::string>> addresses_ = {
+      {"one", {"10.0.0.1", "10.0.0.2"}}, {"two", {"10.0.0.3"}},
+      {"three", {"10.0.0.4"}}};
+  bool transient_failure_ = false;
+  int lookups_ = 0;
+  absl::Time now_ = absl::UnixEpoch();
+  std::vector<std::function<void()>> tasks_;
+};
+
+TEST_F(AddrinfoCacheTest, ServesRepeatedLookupsFromCache) {
+  CreateCache();
+  EXPECT_THAT(Lookup("one"), ElementsAre("10.0.0.1", "10.0.0.2"));
+  EXPECT_THAT(Lookup("one"), ElementsAre("10.0.0.1", "10.0.0.2"));
+  EXPECT_THAT(lookups_, Eq(1));
+
+  AddrinfoCacheStats stats = cache_->GetStats();
+  EXPECT_THAT(stats.misses, Eq(1));
+  EXPECT_THAT(stats.hits, Eq(1));
+}
+
+TEST_F(AddrinfoCacheTest, ReturnsIndependentCopies) {
+  CreateCache();
+  struct addrinfo hints = {};
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo *first = nullptr;
+  struct addrinfo *second = nullptr;
+  ASSERT_THAT(cache_->GetAddrinfo("one", "80", &hints, &first), Eq(0));
+  ASSERT_THAT(cache_->GetAddrinfo("one", "80", &hints, &second), Eq(0));
+  EXPECT_NE(first, second);
+  EXPECT_NE(first->ai_addr, second->ai_addr);
+  EXPECT_THAT(second->ai_socktype, Eq(SOCK_STREAM));
+  EXPECT_THAT(second->ai_canonname, StrEq("one"));
+  EXPECT_THAT(second->ai_next->ai_canonname, IsNull());
+  FreeList(first);
+  EXPECT_THAT(Addresses(second), ElementsAre("10.0.0.1", "10.0.0.2"));
+  FreeList(second);
+}
+
+TEST_F(AddrinfoCacheTest, KeysLookupsByHints) {
+  CreateCache();
+  struct addrinfo hints = {};
+  hints.ai_socktype = SOCK_DGRAM;
+  struct addrinfo *res = nullptr;
+  Lookup("one");
+  ASSERT_THAT(cache_->GetAddrinfo("one", "80", &hints, &res), Eq(0));
+  EXPECT_THAT(res->ai_socktype, Eq(SOCK_DGRAM));
+  FreeList(res);
+  ASSERT_THAT(cache_->GetAddrinfo("one", "80", nullptr, &res), Eq(0));
+  FreeList(res);
+  EXPECT_THAT(lookups_, Eq(3));
+}
+
+TEST_F(AddrinfoCacheTest, ExpiresLookups) {
+  CreateCache();
+  Lookup("one");
+  now_ += options_.ttl;
+  addresses_["one"] = {"10.0.0.9"};
+  EXPECT_THAT(Lookup("one"), ElementsAre("10.0.0.9"));
+  EXPECT_THAT(lookups_, Eq(2));
+}
+
+TEST_F(AddrinfoCacheTest, CachesMissingNames) {
+  CreateCache();
+  int error;
+  EXPECT_THAT(Lookup("missing", &error), IsEmpty());
+  EXPECT_THAT(error, Eq(EAI_NONAME));
+  EXPECT_THAT(Lookup("missing", &error), IsEmpty());
+  EXPECT_THAT(error, Eq(EAI_NONAME));
+  EXPECT_THAT(lookups_, Eq(1));
+  EXPECT_THAT(cache_->GetStats().negative_hits, Eq(1));
+
+  now_ += options_.negative_ttl;
+  addresses_["missing"] = {"10.0.0.5"};
+  EXPECT_THAT(Lookup("missing", &error), ElementsAre("10.0.0.5"));
+  EXPECT_THAT(error, Eq(0));
+}
+
+TEST_F(AddrinfoCacheTest, DoesNotCacheTransientErrors) {
+  CreateCache();
+  transient_failure_ = true;
+  int error;
+  Lookup("one", &error);
+  EXPECT_THAT(error, Eq(EAI_AGAIN));
+  transient_failure_ = false;
+  EXPECT_THAT(Lookup("one", &error), ElementsAre("10.0.0.1", "10.0.0.2"));
+  EXPECT_THAT(lookups_, Eq(2));
+}
+
+TEST_F(AddrinfoCacheTest, EvictsLeastRecentlyUsedLookup) {
+  CreateCache();
+  Lookup("one");
+  Lookup("two");
+  Lookup("one");
+  Lookup("three");
+  EXPECT_THAT(cache_->GetStats().evictions, Eq(1));
+  EXPECT_THAT(lookups_, Eq(3));
+
+  Lookup("one");
+  EXPECT_THAT(lookups_, Eq(3));
+  Lookup("two");
+  EXPECT_THAT(lookups_, Eq(4));
+}
+
+TEST_F(AddrinfoCacheTest, RefreshesLookupsAboutToExpire) {
+  CreateCache();
+  Lookup("one");
+  now_ += options_.ttl - options_.refresh_window;
+  addresses_["one"] = {"10.0.0.9"};
+
+  // The hit is served from the cache and starts a single refresh.
+  EXPECT_THAT(Lookup("one"), ElementsAre("10.0.0.1", "10.0.0.2"));
+  EXPECT_THAT(Lookup("one"), ElementsAre("10.0.0.1", "10.0.0.2"));
+  ASSERT_THAT(tasks_.size(), Eq(1));
+  RunTasks();
+  EXPECT_THAT(cache_->GetStats().refreshes, Eq(1));
+
+  // The refreshed lookup is valid for a full TTL.
+  now_ += options_.ttl - absl::Nanoseconds(1);
+  EXPECT_THAT(Lookup("one"), ElementsAre("10.0.0.9"));
+  EXPECT_THAT(lookups_, Eq(2));
+}
+
+TEST_F(AddrinfoCacheTest, KeepsLookupWhenRefreshFails) {
+  CreateCache();
+  Lookup("one");
+  now_ += options_.ttl - options_.refresh_window;
+  Lookup("one");
+  transient_failure_ = true;
+  RunTasks();
+  EXPECT_THAT(Lookup("one"), ElementsAre("10.0.0.1", "10.0.0.2"));
+
+  // A later hit tries again.
+  transient_failure_ = false;
+  RunTasks();
+  EXPECT_THAT(lookups_, Eq(3));
+}
+
+TEST_F(AddrinfoCacheTest, ClearDropsLookups) {
+  CreateCache();
+  Lookup("one");
+  cache_->Clear();
+  Lookup("one");
+  EXPECT_THAT(lookups_, Eq(2));
+}
+
+}  // namespace
+}  // namespace asylo
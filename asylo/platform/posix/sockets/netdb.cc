@@ -20,6 +20,18 @@
 #include <stdlib.h>
 
 #include "asylo/platform/host_call/trusted/host_calls.h"
+#include "asylo/platform/posix/sockets/addrinfo_cache.h"
+
+namespace {
+
+asylo::AddrinfoCache *GetAddrinfoCache() {
+  static asylo::AddrinfoCache *const cache = new asylo::AddrinfoCache(
+      asylo::AddrinfoCacheOptions(), enc_untrusted_getaddrinfo,
+      enc_freeaddrinfo);
+  return cache;
+}
+
+}  // namespace
 
 extern "C" {
 
@@ -28,7 +40,7 @@ const char *gai_strerror(int ecode) { abort(); }
 
 int getaddrinfo(const char *node, const char *service,
                 const struct addrinfo *hints, struct addrinfo **res) {
-  return enc_untrusted_getaddrinfo(node, service, hints, res);
+  return GetAddrinfoCache()->GetAddrinfo(node, service, hints, res);
 }
 
 void freeaddrinfo(struct addrinfo *res) { enc_freeaddrinfo(res); }
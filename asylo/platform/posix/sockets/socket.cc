@@ -24,7 +24,10 @@
 
 #include "asylo/platform/common/memory.h"
 #include "asylo/platform/posix/io/io_manager.h"
+#include "asylo/platform/posix/sockets/socket_stats.h"
 
+using asylo::SocketCallKind;
+using asylo::SocketCallRecorder;
 using asylo::io::IOManager;
 
 extern "C" {
@@ -36,7 +39,10 @@ int setsockopt(int sockfd, int level, int option_name, const void *option_value,
 }
 
 int connect(int sockfd, const struct sockaddr *addr, socklen_t addrlen) {
-  return IOManager::GetInstance().Connect(sockfd, addr, addrlen);
+  asylo::RecordSocketPeer(sockfd, addr, addrlen);
+  SocketCallRecorder recorder(sockfd, SocketCallKind::kOther);
+  return recorder.Finish(
+      IOManager::GetInstance().Connect(sockfd, addr, addrlen));
 }
 
 int shutdown(int sockfd, int how) {
@@ -44,7 +50,9 @@ int shutdown(int sockfd, int how) {
 }
 
 ssize_t send(int sockfd, const void *buf, size_t len, int flags) {
-  return IOManager::GetInstance().Send(sockfd, buf, len, flags);
+  SocketCallRecorder recorder(sockfd, SocketCallKind::kSend);
+  return recorder.Finish(
+      IOManager::GetInstance().Send(sockfd, buf, len, flags));
 }
 
 int socket(int domain, int type, int protocol) {
@@ -62,7 +70,17 @@ int getsockopt(int sockfd, int level, int optname, void *optval,
 }
 
 int accept(int sockfd, struct sockaddr *addr, socklen_t *addrlen) {
-  return IOManager::GetInstance().Accept(sockfd, addr, addrlen);
+  SocketCallRecorder recorder(sockfd, SocketCallKind::kOther);
+  int fd =
+      recorder.Finish(IOManager::GetInstance().Accept(sockfd, addr, addrlen));
+  if (fd >= 0 && addrlen) {
+    asylo::RecordSocketPeer(fd, addr, *addrlen);
+  }
+  return fd;
+}
+
+int accept4(int sockfd, struct sockaddr *addr, socklen_t *addrlen, int flags) {
+  return IOManager::GetInstance().Accept4(sockfd, addr, addrlen, flags);
 }
 
 int bind(int sockfd, const struct sockaddr *addr, socklen_t addrlen) {
@@ -74,11 +92,13 @@ int listen(int sockfd, int backlog) {
 }
 
 ssize_t sendmsg(int sockfd, const struct msghdr *msg, int flags) {
-  return IOManager::GetInstance().SendMsg(sockfd, msg, flags);
+  SocketCallRecorder recorder(sockfd, SocketCallKind::kSend);
+  return recorder.Finish(IOManager::GetInstance().SendMsg(sockfd, msg, flags));
 }
 
 ssize_t recvmsg(int sockfd, struct msghdr *msg, int flags) {
-  return IOManager::GetInstance().RecvMsg(sockfd, msg, flags);
+  SocketCallRecorder recorder(sockfd, SocketCallKind::kRecv);
+  return recorder.Finish(IOManager::GetInstance().RecvMsg(sockfd, msg, flags));
 }
 
 int getsockname(int sockfd, struct sockaddr *addr, socklen_t *addrlen) {
@@ -186,8 +206,9 @@ int inet_aton(const char *cp, struct in_addr *inp) {
 
 ssize_t recvfrom(int socket, void *buffer, size_t length, int flags,
                  struct sockaddr *address, socklen_t *address_len) {
-  return IOManager::GetInstance().RecvFrom(socket, buffer, length, flags,
-                                           address, address_len);
+  SocketCallRecorder recorder(socket, SocketCallKind::kRecv);
+  return recorder.Finish(IOManager::GetInstance().RecvFrom(
+      socket, buffer, length, flags, address, address_len));
 }
 
 int socketpair(int domain, int type, int protocol, int sv[2]) { abort(); }
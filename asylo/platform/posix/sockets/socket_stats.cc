@@ -0,0 +1,223 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/sockets/socket_stats.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <sys/un.h>
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/synchronization/mutex.h"
+
+namespace asylo {
+namespace {
+
+std::atomic<bool> socket_stats_enabled{false};
+
+// Whether statistics were ever enabled, and so may have to be forgotten when a
+// descriptor is closed.
+std::atomic<bool> socket_stats_used{false};
+
+struct SocketStatsTable {
+  absl::Mutex mu;
+  absl::flat_hash_map<int, SocketIoStats> open ABSL_GUARDED_BY(mu);
+  SocketIoStats closed ABSL_GUARDED_BY(mu);
+};
+
+SocketStatsTable *GetTable() {
+  static SocketStatsTable *const table = new SocketStatsTable;
+  return table;
+}
+
+int64_t MonotonicNanoseconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+uint64_t TotalCalls(const SocketIoStats &stats) {
+  return stats.send_calls + stats.recv_calls + stats.other_calls;
+}
+
+std::string FormatPeer(const struct sockaddr *addr, socklen_t addrlen) {
+  char buffer[INET6_ADDRSTRLEN];
+  if (addr->sa_family == AF_INET && addrlen >= sizeof(struct sockaddr_in)) {
+    auto in = reinterpret_cast<const struct sockaddr_in *>(addr);
+    if (inet_ntop(AF_INET, &in->sin_addr, buffer, sizeof(buffer))) {
+      return absl::StrCat(buffer, ":", ntohs(in->sin_port));
+    }
+  } else if (addr->sa_family == AF_INET6 &&
+             addrlen >= sizeof(struct sockaddr_in6)) {
+    auto in6 = reinterpret_cast<const struct sockaddr_in6 *>(addr);
+    if (inet_ntop(AF_INET6, &in6->sin6_addr, buffer, sizeof(buffer))) {
+      return absl::StrCat("[", buffer, "]:", ntohs(in6->sin6_port));
+    }
+  } else if (addr->sa_family == AF_UNIX &&
+             addrlen > offsetof(struct sockaddr_un, sun_path)) {
+    auto un = reinterpret_cast<const struct sockaddr_un *>(addr);
+    size_t path_size = std::min<size_t>(
+        addrlen - offsetof(struct sockaddr_un, sun_path), sizeof(un->sun_path));
+    return std::string(un->sun_path, strnlen(un->sun_path, path_size));
+  }
+  return "";
+}
+
+std::string FormatStats(const SocketIoStats &stats) {
+  return absl::StrFormat(
+      "send_calls=%d recv_calls=%d other_calls=%d bytes_sent=%d "
+      "bytes_received=%d eagain=%d errors=%d blocked_ms=%.3f "
+      "max_call_ms=%.3f",
+      stats.send_calls, stats.recv_calls, stats.other_calls, stats.bytes_sent,
+      stats.bytes_received, stats.eagain_count, stats.error_count,
+      stats.blocked_nanos / 1e6, stats.max_call_nanos / 1e6);
+}
+
+}  // namespace
+
+void SocketIoStats::Merge(const SocketIoStats &other) {
+  send_calls += other.send_calls;
+  recv_calls += other.recv_calls;
+  other_calls += other.other_calls;
+  bytes_sent += other.bytes_sent;
+  bytes_received += other.bytes_received;
+  eagain_count += other.eagain_count;
+  error_count += other.error_count;
+  blocked_nanos += other.blocked_nanos;
+  max_call_nanos = std::max(max_call_nanos, other.max_call_nanos);
+}
+
+void EnableSocketStats(bool enabled) {
+  if (enabled) {
+    socket_stats_used.store(true, std::memory_order_relaxed);
+  }
+  socket_stats_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+std::vector<std::pair<int, SocketIoStats>> GetSocketStats() {
+  std::vector<std::pair<int, SocketIoStats>> result;
+  {
+    SocketStatsTable *table = GetTable();
+    absl::MutexLock lock(&table->mu);
+    result.assign(table->open.begin(), table->open.end());
+  }
+  std::sort(result.begin(), result.end(),
+            [](const std::pair<int, SocketIoStats> &lhs,
+               const std::pair<int, SocketIoStats> &rhs) {
+              return TotalCalls(lhs.second) > TotalCalls(rhs.second) ||
+                     (TotalCalls(lhs.second) == TotalCalls(rhs.second) &&
+                      lhs.first < rhs.first);
+            });
+  return result;
+}
+
+SocketIoStats GetClosedSocketStats() {
+  SocketStatsTable *table = GetTable();
+  absl::MutexLock lock(&table->mu);
+  return table->closed;
+}
+
+std::string FormatSocketStats(size_t max_sockets) {
+  std::vector<std::pair<int, SocketIoStats>> open = GetSocketStats();
+  std::string report;
+  for (size_t i = 0; i < open.size() && i < max_sockets; ++i) {
+    absl::StrAppend(&report, "fd ", open[i].first,
+                    open[i].second.peer.empty() ? "" : " peer ",
+                    open[i].second.peer, ": ", FormatStats(open[i].second),
+                    "\n");
+  }
+  absl::StrAppend(&report, "closed sockets: ",
+                  FormatStats(GetClosedSocketStats()), "\n");
+  return report;
+}
+
+void RecordSocketPeer(int fd, const struct sockaddr *addr, socklen_t addrlen) {
+  if (!socket_stats_enabled.load(std::memory_order_relaxed) || fd < 0 ||
+      !addr) {
+    return;
+  }
+  std::string peer = FormatPeer(addr, addrlen);
+  SocketStatsTable *table = GetTable();
+  absl::MutexLock lock(&table->mu);
+  table->open[fd].peer = std::move(peer);
+}
+
+void ForgetSocketStats(int fd) {
+  if (!socket_stats_used.load(std::memory_order_relaxed)) {
+    return;
+  }
+  SocketStatsTable *table = GetTable();
+  absl::MutexLock lock(&table->mu);
+  auto it = table->open.find(fd);
+  if (it != table->open.end()) {
+    table->closed.Merge(it->second);
+    table->open.erase(it);
+  }
+}
+
+SocketCallRecorder::SocketCallRecorder(int fd, SocketCallKind kind)
+    : fd_(fd),
+      kind_(kind),
+      start_nanos_(socket_stats_enabled.load(std::memory_order_relaxed)
+                       ? MonotonicNanoseconds()
+                       : -1) {}
+
+void SocketCallRecorder::Record(int64_t result) {
+  int saved_errno = errno;
+  uint64_t elapsed_nanos =
+      static_cast<uint64_t>(std::max<int64_t>(
+          MonotonicNanoseconds() - start_nanos_, 0));
+  {
+    SocketStatsTable *table = GetTable();
+    absl::MutexLock lock(&table->mu);
+    SocketIoStats &stats = table->open[fd_];
+    if (kind_ == SocketCallKind::kSend) {
+      ++stats.send_calls;
+      if (result > 0) {
+        stats.bytes_sent += result;
+      }
+    } else if (kind_ == SocketCallKind::kRecv) {
+      ++stats.recv_calls;
+      if (result > 0) {
+        stats.bytes_received += result;
+      }
+    } else {
+      ++stats.other_calls;
+    }
+    if (result < 0) {
+      if (saved_errno == EAGAIN || saved_errno == EWOULDBLOCK) {
+        ++stats.eagain_count;
+      } else {
+        ++stats.error_count;
+      }
+    }
+    stats.blocked_nanos += elapsed_nanos;
+    stats.max_call_nanos = std::max(stats.max_call_nanos, elapsed_nanos);
+  }
+  errno = saved_errno;
+}
+
+}  // namespace asylo
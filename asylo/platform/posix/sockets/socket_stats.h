@@ -0,0 +1,116 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_POSIX_SOCKETS_SOCKET_STATS_H_
+#define ASYLO_PLATFORM_POSIX_SOCKETS_SOCKET_STATS_H_
+
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace asylo {
+
+// I/O statistics of a socket, counted over the calls made through the socket
+// API (send, recv, sendmsg, recvmsg, recvfrom, accept and connect). Each such
+// call on a host socket is an exit from the enclave.
+struct SocketIoStats {
+  // Address of the peer as "address:port", if it was passed to connect() or
+  // returned by accept().
+  std::string peer;
+
+  // Calls which send data, calls which receive data, and accept() and
+  // connect() calls.
+  uint64_t send_calls = 0;
+  uint64_t recv_calls = 0;
+  uint64_t other_calls = 0;
+  uint64_t bytes_sent = 0;
+  uint64_t bytes_received = 0;
+
+  // Calls which failed with EAGAIN or EWOULDBLOCK, and calls which failed
+  // otherwise.
+  uint64_t eagain_count = 0;
+  uint64_t error_count = 0;
+
+  // Total and longest time spent in a single call, in nanoseconds.
+  uint64_t blocked_nanos = 0;
+  uint64_t max_call_nanos = 0;
+
+  // Adds the counters of |other| to these.
+  void Merge(const SocketIoStats &other);
+};
+
+// Enables or disables the collection of socket statistics, which is initially
+// disabled. While disabled, socket calls only pay for checking this flag.
+void EnableSocketStats(bool enabled);
+
+// Returns the statistics of the open sockets with recorded calls, by enclave
+// file descriptor, in descending order of their number of calls.
+std::vector<std::pair<int, SocketIoStats>> GetSocketStats();
+
+// Returns the accumulated statistics of all closed sockets.
+SocketIoStats GetClosedSocketStats();
+
+// Returns a report of the statistics of the |max_sockets| open sockets with
+// the most calls, followed by the totals of closed sockets.
+std::string FormatSocketStats(size_t max_sockets);
+
+// Records the peer of socket |fd| from |addr|.
+void RecordSocketPeer(int fd, const struct sockaddr *addr, socklen_t addrlen);
+
+// Moves the statistics of socket |fd| to the totals of closed sockets. Called
+// when |fd| is closed, so that a socket reusing the descriptor starts afresh.
+void ForgetSocketStats(int fd);
+
+// The kinds of calls counted by SocketIoStats.
+enum class SocketCallKind { kSend, kRecv, kOther };
+
+// Times a socket call and records its result. Does nothing, and reads no
+// clock, if socket statistics are disabled when it is created.
+class SocketCallRecorder {
+ public:
+  SocketCallRecorder(int fd, SocketCallKind kind);
+
+  SocketCallRecorder(const SocketCallRecorder &other) = delete;
+  SocketCallRecorder &operator=(const SocketCallRecorder &other) = delete;
+
+  // Records the call as having returned |result|, with errno describing a
+  // failure, and returns |result|.
+  template <typename T>
+  T Finish(T result) {
+    if (start_nanos_ >= 0) {
+      Record(static_cast<int64_t>(result));
+    }
+    return result;
+  }
+
+ private:
+  void Record(int64_t result);
+
+  const int fd_;
+  const SocketCallKind kind_;
+  const int64_t start_nanos_;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_POSIX_SOCKETS_SOCKET_STATS_H_
@@ -0,0 +1,136 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/sockets/socket_stats.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace {
+
+using ::testing::HasSubstr;
+using ::testing::IsEmpty;
+
+class SocketStatsTest : public ::testing::Test {
+ protected:
+  void SetUp() override { EnableSocketStats(true); }
+
+  void TearDown() override {
+    for (const auto &entry : GetSocketStats()) {
+      ForgetSocketStats(entry.first);
+    }
+    EnableSocketStats(false);
+  }
+};
+
+ssize_t RecordCall(int fd, SocketCallKind kind, ssize_t result,
+                   int error = 0) {
+  SocketCallRecorder recorder(fd, kind);
+  errno = error;
+  return recorder.Finish(result);
+}
+
+TEST_F(SocketStatsTest, DisabledRecordsNothing) {
+  EnableSocketStats(false);
+  EXPECT_EQ(RecordCall(3, SocketCallKind::kSend, 10), 10);
+  EXPECT_THAT(GetSocketStats(), IsEmpty());
+}
+
+TEST_F(SocketStatsTest, CountsCallsAndBytes) {
+  RecordCall(3, SocketCallKind::kSend, 10);
+  RecordCall(3, SocketCallKind::kSend, 5);
+  RecordCall(3, SocketCallKind::kRecv, 7);
+  RecordCall(3, SocketCallKind::kRecv, 0);
+  RecordCall(3, SocketCallKind::kOther, 0);
+
+  auto stats = GetSocketStats();
+  ASSERT_EQ(stats.size(), 1);
+  EXPECT_EQ(stats[0].first, 3);
+  EXPECT_EQ(stats[0].second.send_calls, 2);
+  EXPECT_EQ(stats[0].second.recv_calls, 2);
+  EXPECT_EQ(stats[0].second.other_calls, 1);
+  EXPECT_EQ(stats[0].second.bytes_sent, 15);
+  EXPECT_EQ(stats[0].second.bytes_received, 7);
+  EXPECT_GE(stats[0].second.blocked_nanos, stats[0].second.max_call_nanos);
+}
+
+TEST_F(SocketStatsTest, SeparatesEagainFromErrors) {
+  RecordCall(4, SocketCallKind::kRecv, -1, EAGAIN);
+  RecordCall(4, SocketCallKind::kRecv, -1, EWOULDBLOCK);
+  RecordCall(4, SocketCallKind::kSend, -1, EPIPE);
+
+  auto stats = GetSocketStats();
+  ASSERT_EQ(stats.size(), 1);
+  EXPECT_EQ(stats[0].second.eagain_count, 2);
+  EXPECT_EQ(stats[0].second.error_count, 1);
+  EXPECT_EQ(stats[0].second.bytes_received, 0);
+  EXPECT_EQ(stats[0].second.bytes_sent, 0);
+}
+
+TEST_F(SocketStatsTest, PreservesErrno) {
+  SocketCallRecorder recorder(5, SocketCallKind::kRecv);
+  errno = EAGAIN;
+  EXPECT_EQ(recorder.Finish(-1), -1);
+  EXPECT_EQ(errno, EAGAIN);
+}
+
+TEST_F(SocketStatsTest, RecordsPeer) {
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(8080);
+  ASSERT_EQ(inet_pton(AF_INET, "10.0.0.1", &addr.sin_addr), 1);
+  RecordSocketPeer(6, reinterpret_cast<struct sockaddr *>(&addr),
+                   sizeof(addr));
+
+  auto stats = GetSocketStats();
+  ASSERT_EQ(stats.size(), 1);
+  EXPECT_EQ(stats[0].second.peer, "10.0.0.1:8080");
+  EXPECT_THAT(FormatSocketStats(1), HasSubstr("fd 6 peer 10.0.0.1:8080"));
+}
+
+TEST_F(SocketStatsTest, ForgetMovesStatsToClosedTotals) {
+  SocketIoStats closed_before = GetClosedSocketStats();
+  RecordCall(7, SocketCallKind::kSend, 100);
+  ForgetSocketStats(7);
+
+  EXPECT_THAT(GetSocketStats(), IsEmpty());
+  SocketIoStats closed_after = GetClosedSocketStats();
+  EXPECT_EQ(closed_after.send_calls, closed_before.send_calls + 1);
+  EXPECT_EQ(closed_after.bytes_sent, closed_before.bytes_sent + 100);
+}
+
+TEST_F(SocketStatsTest, SortsByCalls) {
+  RecordCall(8, SocketCallKind::kSend, 1);
+  RecordCall(9, SocketCallKind::kSend, 1);
+  RecordCall(9, SocketCallKind::kRecv, 1);
+
+  auto stats = GetSocketStats();
+  ASSERT_EQ(stats.size(), 2);
+  EXPECT_EQ(stats[0].first, 9);
+  EXPECT_EQ(stats[1].first, 8);
+}
+
+}  // namespace
+}  // namespace asylo
@@ -29,6 +29,11 @@ int lstat(const char *pathname, struct stat *stat_buffer) {
   return IOManager::GetInstance().LStat(pathname, stat_buffer);
 }
 
+int fstatat(int dirfd, const char *pathname, struct stat *stat_buffer,
+            int flags) {
+  return IOManager::GetInstance().FStatAt(dirfd, pathname, stat_buffer, flags);
+}
+
 mode_t umask(mode_t mask) { return IOManager::GetInstance().Umask(mask); }
 
 int chmod(const char *pathname, mode_t mode) {
@@ -23,6 +23,7 @@
 #include <memory>
 
 #include "asylo/platform/host_call/trusted/host_calls.h"
+#include "asylo/platform/posix/io/io_manager.h"
 
 extern "C" {
 
@@ -36,15 +37,18 @@ void syslog(int priority, const char *format, ...) {
   // Get the size of the formatted string.
   int size = vsnprintf(nullptr, 0, format, args);
   va_end(args);
+  if (size < 0) {
+    return;
+  }
 
   // reset the arg to the input.
   va_start(args, format);
-  // Create a buffer with the same size as the formatted string.
-  std::unique_ptr<char[]> buffer(new char[size]);
+  // Create a buffer large enough for the formatted string and its terminator.
+  std::unique_ptr<char[]> buffer(new char[size + 1]);
   // Reads the formatted string to the buffer.
-  vsnprintf(buffer.get(), size, format, args);
+  vsnprintf(buffer.get(), size + 1, format, args);
   va_end(args);
-  enc_untrusted_syslog(priority, buffer.get(), size);
+  asylo::io::IOManager::GetInstance().Syslog(priority, buffer.get(), size);
 }
 
 }  // extern "C"
@@ -20,12 +20,17 @@
 
 #include <pthread.h>
 #include <sys/mman.h>
+#include <time.h>
 
 #include <algorithm>
 #include <atomic>
+#include <cerrno>
+#include <cstdint>
 #include <cstdlib>
 #include <memory>
 
+#include "asylo/platform/common/time_util.h"
+#include "asylo/platform/core/contention_profiler.h"
 #include "asylo/platform/posix/pthread_impl.h"
 #include "asylo/platform/primitives/trusted_primitives.h"
 #include "asylo/platform/primitives/trusted_runtime.h"
@@ -168,22 +173,34 @@ ThreadManager *ThreadManager::GetInstance() {
 
 std::shared_ptr<ThreadManager::Thread> ThreadManager::EnqueueThread(
     const ThreadOptions &options, const std::function<int()> &start_routine,
-    void *tls) {
+    void *tls, bool *claimed_idle_thread) {
   PthreadMutexLock lock(&threads_lock_);
 
   queued_threads_.emplace(
       std::make_shared<Thread>(options, start_routine, tls));
   std::shared_ptr<Thread> thread = queued_threads_.back();
+  RecordThreadQueueDepth(queued_threads_.size());
 
   // If a Thread object cannot be allocated, abort.
   CHECK(thread != nullptr);
 
+  *claimed_idle_thread = idle_threads_ > 0;
+  if (*claimed_idle_thread) {
+    --idle_threads_;
+    ++claimed_threads_;
+  }
+
   pthread_cond_broadcast(&threads_cond_);
   return thread;
 }
 
 std::shared_ptr<ThreadManager::Thread> ThreadManager::DequeueThread(pid_t tid) {
   PthreadMutexLock lock(&threads_lock_);
+  return DequeueThreadLocked(tid);
+}
+
+std::shared_ptr<ThreadManager::Thread> ThreadManager::DequeueThreadLocked(
+    pid_t tid) {
   // There should be a one-to-one mapping of threads donated to the enclave
   // and threads created from above at the pthread API layer waiting to run.
   // If a thread gets donated and there's no thread waiting to run, something
@@ -214,10 +231,14 @@ int ThreadManager::CreateThread(const std::function<int()> &start_routine,
   if (attr && attr->detach_state == PTHREAD_CREATE_DETACHED) {
     options.detached = true;
   }
-  std::shared_ptr<Thread> thread = EnqueueThread(options, start_routine, tls);
-
-  // Exit and create a thread to enter with EnclaveCall DonateThread.
-  if (asylo::primitives::TrustedPrimitives::CreateThread()) {
+  bool claimed_idle_thread;
+  std::shared_ptr<Thread> thread =
+      EnqueueThread(options, start_routine, tls, &claimed_idle_thread);
+
+  // Unless a parked thread picks up the job, exit and create a thread to enter
+  // with EnclaveCall DonateThread.
+  if (!claimed_idle_thread &&
+      asylo::primitives::TrustedPrimitives::CreateThread()) {
     return ECHILD;
   }
 
@@ -235,7 +256,14 @@ int ThreadManager::CreateThread(const std::function<int()> &start_routine,
 // a new thread is donated to the Enclave.
 int ThreadManager::StartThread(pid_t tid) {
   std::shared_ptr<Thread> thread = DequeueThread(tid);
+  while (thread) {
+    RunThread(thread);
+    thread = WaitForNextThread(tid);
+  }
+  return 0;
+}
 
+void ThreadManager::RunThread(const std::shared_ptr<Thread> &thread) {
   // Update the thread info in pthread_self.
   enc_update_pthread_info(thread->GetThreadTls());
 
@@ -276,7 +304,51 @@ int ThreadManager::StartThread(pid_t tid) {
   // Thread finished execution, reset the thread ID and release the TLS memory.
   munmap(reinterpret_cast<struct __pthread_info *>(pthread_self())->self,
          reinterpret_cast<struct __pthread_info *>(pthread_self())->tls_size);
-  return 0;
+}
+
+std::shared_ptr<ThreadManager::Thread> ThreadManager::WaitForNextThread(
+    pid_t tid) {
+  PthreadMutexLock lock(&threads_lock_);
+  if (finalizing_.load() || idle_threads_ + claimed_threads_ >=
+                                max_idle_threads_) {
+    return nullptr;
+  }
+
+  timespec deadline;
+  if (clock_gettime(CLOCK_REALTIME, &deadline) != 0) {
+    return nullptr;
+  }
+  NanosecondsToTimeSpec(
+      &deadline, TimeSpecToNanoseconds(&deadline) + idle_timeout_nanoseconds_);
+
+  ++idle_threads_;
+  while (claimed_threads_ == 0 && !finalizing_.load()) {
+    if (pthread_cond_timedwait(&threads_cond_, &threads_lock_, &deadline) ==
+        ETIMEDOUT) {
+      break;
+    }
+  }
+
+  // Parked threads are interchangeable, so any of them may run a Thread which
+  // claimed a parked thread.
+  if (claimed_threads_ > 0) {
+    --claimed_threads_;
+    return DequeueThreadLocked(tid);
+  }
+  --idle_threads_;
+  pthread_cond_broadcast(&threads_cond_);
+  return nullptr;
+}
+
+void ThreadManager::SetThreadPoolOptions(size_t max_idle_threads,
+                                         uint64_t idle_timeout_ms) {
+  PthreadMutexLock lock(&threads_lock_);
+  max_idle_threads_ = max_idle_threads;
+  idle_timeout_nanoseconds_ = static_cast<int64_t>(
+      std::min<uint64_t>(idle_timeout_ms, INT64_MAX / 1000000) * 1000000);
+
+  // Let threads parked beyond the new limit leave the enclave.
+  pthread_cond_broadcast(&threads_cond_);
 }
 
 void ThreadManager::UpdateThreadResult(const pthread_t thread_id, void *ret) {
@@ -375,10 +447,17 @@ void ThreadManager::Finalize() {
     thread.second->SignalStateWaiters();
   }
 
-  // Wait for any expected threads to be donated and all threads to return from
-  // start_routine.
-  WaitFor([this]() { return queued_threads_.empty() && threads_.empty(); },
-          &threads_cond_, &threads_lock_);
+  // Wake parked threads so that they leave the enclave.
+  pthread_cond_broadcast(&threads_cond_);
+
+  // Wait for any expected threads to be donated, all threads to return from
+  // start_routine, and all parked threads to leave.
+  WaitFor(
+      [this]() {
+        return queued_threads_.empty() && threads_.empty() &&
+               idle_threads_ == 0 && claimed_threads_ == 0;
+      },
+      &threads_cond_, &threads_lock_);
 }
 
 }  // namespace asylo
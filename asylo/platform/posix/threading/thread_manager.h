@@ -22,6 +22,7 @@
 #include <pthread.h>
 
 #include <atomic>
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <queue>
@@ -75,6 +76,14 @@ class ThreadManager {
   // |execute| is true.
   void PopCleanupRoutine(bool execute);
 
+  // Keeps up to |max_idle_threads| donated threads parked inside the enclave
+  // for up to |idle_timeout_ms| after their start_routine returns. CreateThread
+  // hands start_routines to parked threads rather than exiting to have the host
+  // donate a new thread, which saves the host thread creation and the enclave
+  // entry. A parked thread keeps its enclave thread slot, so the limit should
+  // leave enough slots for entries from the host. Zero disables parking.
+  void SetThreadPoolOptions(size_t max_idle_threads, uint64_t idle_timeout_ms);
+
   // Finalizes the ThreadManager. This means no new threads may be created using
   // pthread_create(). This function will block until all pending
   // pthread_create() created threads have entered the enclave, and all of
@@ -181,17 +190,32 @@ class ThreadManager {
   };
 
   // Adds a Thread object with the given |options| and |start_routine| to
-  // queued_threads_. Guaranteed to return a valid std::shared_ptr or this
-  // function will abort.
+  // queued_threads_. Sets |*claimed_idle_thread| to true if a parked thread
+  // will run it, in which case no thread needs to be donated for it.
+  // Guaranteed to return a valid std::shared_ptr or this function will abort.
   std::shared_ptr<Thread> EnqueueThread(
       const ThreadOptions &options, const std::function<int()> &start_routine,
-      void *tls);
+      void *tls, bool *claimed_idle_thread);
 
   // Removes a Thread object from queued_threads_ and setups up the Thread with
   // pthread_self() as the thread id and adding it to the threads_ map.
   // Guaranteed to return a valid std::shared_ptr or this function will abort.
   std::shared_ptr<Thread> DequeueThread(pid_t tid);
 
+  // As DequeueThread, with threads_lock_ held.
+  std::shared_ptr<Thread> DequeueThreadLocked(pid_t tid);
+
+  // Runs |thread| on the calling donated thread and releases it once it has
+  // been joined or detached.
+  void RunThread(const std::shared_ptr<Thread> &thread);
+
+  // Parks the calling donated thread until a start_routine is handed to it, in
+  // which case the corresponding Thread is returned as by DequeueThread.
+  // Returns nullptr if the thread should leave the enclave instead, because
+  // enough threads are parked already, the idle timeout expired, or the
+  // ThreadManager is finalizing.
+  std::shared_ptr<Thread> WaitForNextThread(pid_t tid);
+
   // Returns a Thread pointer for a given |thread_id|.
   std::shared_ptr<Thread> GetThread(pthread_t thread_id);
 
@@ -219,6 +243,17 @@ class ThreadManager {
   // that don't join all their threads. While finalizing, join becomes a noop
   // and threads are treated as detached as they complete.
   std::atomic<bool> finalizing_{false};
+
+  // Limits set by SetThreadPoolOptions, guarded by threads_lock_.
+  size_t max_idle_threads_ = 0;
+  int64_t idle_timeout_nanoseconds_ = 0;
+
+  // Number of parked threads, guarded by threads_lock_. Parked threads are
+  // either idle, or claimed by a queued Thread which one of them will run.
+  // queued_threads_ holds one Thread per claimed parked thread and per thread
+  // donation requested from the host.
+  size_t idle_threads_ = 0;
+  size_t claimed_threads_ = 0;
 };
 
 }  // namespace asylo
@@ -0,0 +1,157 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/threading/work_stealing_executor.h"
+
+#include <utility>
+
+#include "asylo/util/status.h"
+
+namespace asylo {
+namespace {
+
+// The executor and worker index of the calling thread, if it is a worker.
+thread_local const WorkStealingExecutor *current_executor = nullptr;
+thread_local size_t current_worker = 0;
+
+}  // namespace
+
+StatusOr<std::unique_ptr<WorkStealingExecutor>> WorkStealingExecutor::Create(
+    size_t num_workers) {
+  if (num_workers == 0) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "WorkStealingExecutor requires at least one worker thread");
+  }
+  std::unique_ptr<WorkStealingExecutor> executor(
+      new WorkStealingExecutor(num_workers));
+  executor->workers_.reserve(num_workers);
+  for (size_t i = 0; i < num_workers; ++i) {
+    executor->workers_.emplace_back(&WorkStealingExecutor::WorkerLoop,
+                                    executor.get(), i);
+  }
+  return std::move(executor);
+}
+
+WorkStealingExecutor::WorkStealingExecutor(size_t num_workers) {
+  queues_.reserve(num_workers);
+  for (size_t i = 0; i < num_workers; ++i) {
+    queues_.emplace_back(new TaskQueue);
+  }
+}
+
+WorkStealingExecutor::~WorkStealingExecutor() { Shutdown(); }
+
+void WorkStealingExecutor::Submit(std::function<void()> task) {
+  {
+    absl::MutexLock lock(&state_lock_);
+    ++pending_tasks_;
+  }
+
+  size_t index;
+  if (current_executor == this) {
+    index = current_worker;
+  } else {
+    index = next_queue_.fetch_add(1, std::memory_order_relaxed) %
+            queues_.size();
+  }
+  TaskQueue *queue = queues_[index].get();
+  {
+    absl::MutexLock lock(&queue->lock);
+    queue->tasks.push_back(std::move(task));
+  }
+
+  absl::MutexLock lock(&state_lock_);
+  ++queued_tasks_;
+}
+
+void WorkStealingExecutor::Wait() {
+  absl::MutexLock lock(&state_lock_);
+  state_lock_.Await(absl::Condition(
+      +[](int64_t *pending) { return *pending == 0; }, &pending_tasks_));
+}
+
+void WorkStealingExecutor::Shutdown() {
+  {
+    absl::MutexLock lock(&state_lock_);
+    shutting_down_ = true;
+  }
+  for (auto &worker : workers_) {
+    worker.Join();
+  }
+  workers_.clear();
+}
+
+void WorkStealingExecutor::WorkerLoop(size_t index) {
+  current_executor = this;
+  current_worker = index;
+
+  std::function<void()> task;
+  while (true) {
+    if (PopOrSteal(index, &task)) {
+      {
+        absl::MutexLock lock(&state_lock_);
+        --queued_tasks_;
+      }
+      task();
+      task = nullptr;
+      absl::MutexLock lock(&state_lock_);
+      --pending_tasks_;
+      continue;
+    }
+
+    absl::MutexLock lock(&state_lock_);
+    state_lock_.Await(
+        absl::Condition(this, &WorkStealingExecutor::HasWorkOrShuttingDown));
+    // Tasks a worker submits itself are pushed before they are counted, so a
+    // non-positive count means every deque has been drained.
+    if (shutting_down_ && queued_tasks_ <= 0) {
+      break;
+    }
+  }
+
+  current_executor = nullptr;
+}
+
+bool WorkStealingExecutor::HasWorkOrShuttingDown() const {
+  return queued_tasks_ > 0 || shutting_down_;
+}
+
+bool WorkStealingExecutor::PopOrSteal(size_t index,
+                                      std::function<void()> *task) {
+  {
+    TaskQueue *own = queues_[index].get();
+    absl::MutexLock lock(&own->lock);
+    if (!own->tasks.empty()) {
+      *task = std::move(own->tasks.back());
+      own->tasks.pop_back();
+      return true;
+    }
+  }
+  for (size_t i = 1; i < queues_.size(); ++i) {
+    TaskQueue *victim = queues_[(index + i) % queues_.size()].get();
+    absl::MutexLock lock(&victim->lock);
+    if (!victim->tasks.empty()) {
+      *task = std::move(victim->tasks.front());
+      victim->tasks.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace asylo
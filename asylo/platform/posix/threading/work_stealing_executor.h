@@ -0,0 +1,113 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_POSIX_THREADING_WORK_STEALING_EXECUTOR_H_
+#define ASYLO_PLATFORM_POSIX_THREADING_WORK_STEALING_EXECUTOR_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "asylo/util/statusor.h"
+#include "asylo/util/thread.h"
+
+namespace asylo {
+
+// Runs tasks on a fixed set of worker threads. Each worker has its own task
+// deque: tasks submitted from a worker go to the back of that worker's deque
+// and are run last-in first-out, and a worker which runs out of tasks steals
+// the oldest task from another worker's deque. This keeps recursively spawned
+// tasks on the thread which spawned them while keeping all workers busy.
+//
+// Inside an enclave, the workers are long-lived threads, so tasks do not pay
+// for a thread donation from the host each. Workers with nothing to do sleep
+// until a task is submitted.
+class WorkStealingExecutor {
+ public:
+  // Starts an executor with |num_workers| worker threads. Returns an error if
+  // |num_workers| is zero.
+  static StatusOr<std::unique_ptr<WorkStealingExecutor>> Create(
+      size_t num_workers);
+
+  // Runs the tasks still queued, then stops and joins all workers.
+  ~WorkStealingExecutor();
+
+  WorkStealingExecutor(const WorkStealingExecutor &other) = delete;
+  WorkStealingExecutor &operator=(const WorkStealingExecutor &other) = delete;
+
+  // Queues |task| to be run by one of the workers. Tasks may submit further
+  // tasks. Must not be called from outside the workers once Shutdown() was
+  // called.
+  void Submit(std::function<void()> task);
+
+  // Blocks until every submitted task, including tasks submitted by other
+  // tasks, has finished running. Must not be called from a task.
+  void Wait();
+
+  // Runs the tasks still queued, then stops and joins all workers. Safe to
+  // call more than once. Must not be called from a task.
+  void Shutdown();
+
+  // Returns the number of worker threads.
+  size_t num_workers() const { return queues_.size(); }
+
+ private:
+  struct TaskQueue {
+    absl::Mutex lock;
+    std::deque<std::function<void()>> tasks ABSL_GUARDED_BY(lock);
+  };
+
+  explicit WorkStealingExecutor(size_t num_workers);
+
+  // Body of worker thread |index|.
+  void WorkerLoop(size_t index);
+
+  // Returns true if a sleeping worker should wake up.
+  bool HasWorkOrShuttingDown() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(state_lock_);
+
+  // Takes the newest task of worker |index|, or else the oldest task of
+  // another worker. Returns false if every deque is empty.
+  bool PopOrSteal(size_t index, std::function<void()> *task);
+
+  std::vector<std::unique_ptr<TaskQueue>> queues_;
+  std::vector<Thread> workers_;
+
+  // Selects the deque for tasks submitted from outside the workers.
+  std::atomic<size_t> next_queue_{0};
+
+  absl::Mutex state_lock_;
+
+  // Number of tasks pushed to the deques and not yet taken. Tasks are counted
+  // after they are pushed, so this may briefly be negative.
+  int64_t queued_tasks_ ABSL_GUARDED_BY(state_lock_) = 0;
+
+  // Number of tasks submitted and not yet finished.
+  int64_t pending_tasks_ ABSL_GUARDED_BY(state_lock_) = 0;
+
+  bool shutting_down_ ABSL_GUARDED_BY(state_lock_) = false;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_POSIX_THREADING_WORK_STEALING_EXECUTOR_H_
@@ -0,0 +1,115 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/posix/threading/work_stealing_executor.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/synchronization/notification.h"
+#include "asylo/test/util/status_matchers.h"
+
+namespace asylo {
+namespace {
+
+using ::testing::Eq;
+
+TEST(WorkStealingExecutorTest, RejectsZeroWorkers) {
+  EXPECT_THAT(WorkStealingExecutor::Create(0),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+}
+
+TEST(WorkStealingExecutorTest, RunsSubmittedTasks) {
+  auto executor_result = WorkStealingExecutor::Create(4);
+  ASSERT_THAT(executor_result, IsOk());
+  std::unique_ptr<WorkStealingExecutor> executor =
+      std::move(executor_result).ValueOrDie();
+  EXPECT_THAT(executor->num_workers(), Eq(4));
+
+  std::atomic<int> count{0};
+  for (int i = 0; i < 1000; ++i) {
+    executor->Submit([&count] { ++count; });
+  }
+  executor->Wait();
+  EXPECT_THAT(count.load(), Eq(1000));
+}
+
+TEST(WorkStealingExecutorTest, WaitsForNestedTasks) {
+  auto executor_result = WorkStealingExecutor::Create(3);
+  ASSERT_THAT(executor_result, IsOk());
+  WorkStealingExecutor *executor = executor_result.ValueOrDie().get();
+
+  // Every task with |depth| > 0 spawns two children, giving 2^11 - 1 tasks.
+  std::atomic<int> count{0};
+  std::function<void(int)> spawn = [&](int depth) {
+    ++count;
+    if (depth > 0) {
+      executor->Submit([&spawn, depth] { spawn(depth - 1); });
+      executor->Submit([&spawn, depth] { spawn(depth - 1); });
+    }
+  };
+  executor->Submit([&spawn] { spawn(10); });
+  executor->Wait();
+  EXPECT_THAT(count.load(), Eq((1 << 11) - 1));
+}
+
+TEST(WorkStealingExecutorTest, IdleWorkersStealTasks) {
+  auto executor_result = WorkStealingExecutor::Create(2);
+  ASSERT_THAT(executor_result, IsOk());
+  WorkStealingExecutor *executor = executor_result.ValueOrDie().get();
+
+  // The first task blocks its worker after queueing a second task on that
+  // worker's deque, so the second task only runs if the other worker steals
+  // it.
+  absl::Notification stolen;
+  executor->Submit([executor, &stolen] {
+    executor->Submit([&stolen] { stolen.Notify(); });
+    stolen.WaitForNotification();
+  });
+  executor->Wait();
+  EXPECT_TRUE(stolen.HasBeenNotified());
+}
+
+TEST(WorkStealingExecutorTest, ShutdownRunsQueuedTasks) {
+  auto executor_result = WorkStealingExecutor::Create(1);
+  ASSERT_THAT(executor_result, IsOk());
+  WorkStealingExecutor *executor = executor_result.ValueOrDie().get();
+
+  absl::Notification release;
+  std::atomic<int> count{0};
+  executor->Submit([&release] { release.WaitForNotification(); });
+  for (int i = 0; i < 10; ++i) {
+    executor->Submit([&count] { ++count; });
+  }
+  release.Notify();
+  executor->Shutdown();
+  EXPECT_THAT(count.load(), Eq(10));
+  executor->Shutdown();
+}
+
+TEST(WorkStealingExecutorTest, WaitReturnsWhenIdle) {
+  auto executor_result = WorkStealingExecutor::Create(2);
+  ASSERT_THAT(executor_result, IsOk());
+  executor_result.ValueOrDie()->Wait();
+}
+
+}  // namespace
+}  // namespace asylo
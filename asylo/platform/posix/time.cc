@@ -24,10 +24,12 @@
 
 #include "asylo/platform/common/time_util.h"
 #include "asylo/platform/host_call/trusted/host_calls.h"
+#include "asylo/platform/posix/host_clock.h"
 
 using asylo::NanosecondsToTimeSpec;
 using asylo::NanosecondsToTimeVal;
 using asylo::TimeSpecToNanoseconds;
+using asylo::TimeValToNanoseconds;
 
 namespace {
 
@@ -51,8 +53,18 @@ int enclave_gettimeofday(struct timeval *__restrict time, void *timezone) {
     return -1;
   }
 
+  struct timespec ts;
+  if (asylo::ReadHostClock(CLOCK_REALTIME, &ts)) {
+    NanosecondsToTimeVal(time, TimeSpecToNanoseconds(&ts));
+    return 0;
+  }
+
   struct timeval tval {};
   int result = enc_untrusted_gettimeofday(&tval, nullptr);
+  if (result == 0) {
+    NanosecondsToTimeSpec(&ts, TimeValToNanoseconds(&tval));
+    asylo::ObserveHostClock(CLOCK_REALTIME, &ts);
+  }
   time->tv_sec = tval.tv_sec;
   time->tv_usec = tval.tv_usec;
   return result;
@@ -61,7 +73,15 @@ int enclave_gettimeofday(struct timeval *__restrict time, void *timezone) {
 int enclave_times(struct tms *buf) { return enc_untrusted_times(buf); }
 
 int clock_gettime(clockid_t clock_id, struct timespec *time) {
+  // Serve the clock from the host clock page without exiting the enclave when
+  // possible.
+  if (asylo::ReadHostClock(clock_id, time)) {
+    return 0;
+  }
   int result = enc_untrusted_clock_gettime(clock_id, time);
+  if (result != 0) {
+    return result;
+  }
   if (clock_id == CLOCK_MONOTONIC) {
     int64_t clock_monotonic = TimeSpecToNanoseconds(time);
     thread_local static int64_t last_tick = clock_monotonic;
@@ -69,6 +89,7 @@ int clock_gettime(clockid_t clock_id, struct timespec *time) {
     if (clock_monotonic < last_tick) abort();
     last_tick = clock_monotonic;
   }
+  asylo::ObserveHostClock(clock_id, time);
   return result;
 }
 
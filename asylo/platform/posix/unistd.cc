@@ -27,8 +27,10 @@
 #include "asylo/platform/core/trusted_global_state.h"
 #include "asylo/platform/host_call/trusted/host_calls.h"
 #include "asylo/platform/posix/io/io_manager.h"
+#include "asylo/platform/posix/io/output_buffer.h"
 #include "asylo/platform/primitives/trusted_primitives.h"
 #include "asylo/platform/primitives/trusted_runtime.h"
+#include "asylo/util/logging.h"
 #include "asylo/util/statusor.h"
 
 using asylo::io::IOManager;
@@ -57,7 +59,12 @@ pid_t ForkEnclave() {
     return -1;
   }
 
-  return asylo::enc_fork(asylo::GetEnclaveName().c_str());
+  pid_t pid = asylo::enc_fork(asylo::GetEnclaveName().c_str());
+  if (pid >= 0) {
+    // Parent and child now share the host file descriptors.
+    IOManager::GetInstance().MarkFileDescriptorsShared();
+  }
+  return pid;
 }
 
 }  // namespace
@@ -286,6 +293,8 @@ int enclave_unlink(const char *pathname) {
 }
 
 void enclave_exit(int rc) {
+  ::asylo::io::OutputBuffer::FlushAll();
+  ::asylo::FlushLogs();
   while (true) {
     enc_exit(rc);
   }
@@ -0,0 +1,33 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/primitives/cpuid.h"
+
+#include <cpuid.h>
+
+#include "absl/base/attributes.h"
+
+extern "C" ABSL_ATTRIBUTE_WEAK bool enc_cpuid(uint32_t leaf, uint32_t subleaf,
+                                              uint32_t registers[4]) {
+  if (leaf > __get_cpuid_max(leaf & 0x80000000, nullptr)) {
+    return false;
+  }
+  __cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2],
+                registers[3]);
+  return true;
+}
@@ -0,0 +1,41 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_PRIMITIVES_CPUID_H_
+#define ASYLO_PLATFORM_PRIMITIVES_CPUID_H_
+
+#include <cstdint>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Stores the EAX, EBX, ECX and EDX results of the CPUID instruction for |leaf|
+// and |subleaf| in |registers|, in that order. Returns false if the enclave
+// cannot learn the results.
+//
+// The default definition executes CPUID. Backends in which CPUID faults, such
+// as SGX, override it with one serving the results cached at enclave startup,
+// so that feature detection does not take an exception per query.
+bool enc_cpuid(uint32_t leaf, uint32_t subleaf, uint32_t registers[4]);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // ASYLO_PLATFORM_PRIMITIVES_CPUID_H_
@@ -0,0 +1,102 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/primitives/ctr_drbg.h"
+
+#include <openssl/aes.h>
+#include <openssl/mem.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace asylo {
+namespace {
+
+constexpr size_t kKeySize = 32;
+
+static_assert(CtrDrbg::kSeedSize == kKeySize + AES_BLOCK_SIZE,
+              "The seed length must be the key length plus the block length");
+
+}  // namespace
+
+void CtrDrbg::Seed(const uint8_t seed[kSeedSize]) {
+  static const uint8_t kZeroKey[kKeySize] = {};
+  AES_set_encrypt_key(kZeroKey, 8 * kKeySize, &key_);
+  memset(counter_, 0, sizeof(counter_));
+  Update(seed);
+  reseed_counter_ = 1;
+}
+
+void CtrDrbg::Reseed(const uint8_t seed[kSeedSize]) {
+  Update(seed);
+  reseed_counter_ = 1;
+}
+
+bool CtrDrbg::NeedsReseed() const {
+  return reseed_counter_ == 0 || reseed_counter_ > kReseedInterval;
+}
+
+void CtrDrbg::Generate(uint8_t *buf, size_t size) {
+  uint8_t block[AES_BLOCK_SIZE];
+  while (size >= AES_BLOCK_SIZE) {
+    NextBlock(buf);
+    buf += AES_BLOCK_SIZE;
+    size -= AES_BLOCK_SIZE;
+  }
+  if (size > 0) {
+    NextBlock(block);
+    memcpy(buf, block, size);
+    OPENSSL_cleanse(block, sizeof(block));
+  }
+  Update(/*provided_data=*/nullptr);
+  ++reseed_counter_;
+}
+
+void CtrDrbg::Clear() {
+  OPENSSL_cleanse(&key_, sizeof(key_));
+  OPENSSL_cleanse(counter_, sizeof(counter_));
+  reseed_counter_ = 0;
+}
+
+void CtrDrbg::Update(const uint8_t *provided_data) {
+  uint8_t temp[kSeedSize];
+  for (size_t offset = 0; offset < kSeedSize; offset += AES_BLOCK_SIZE) {
+    NextBlock(temp + offset);
+  }
+  if (provided_data) {
+    for (size_t i = 0; i < kSeedSize; ++i) {
+      temp[i] ^= provided_data[i];
+    }
+  }
+  AES_set_encrypt_key(temp, 8 * kKeySize, &key_);
+  memcpy(counter_, temp + kKeySize, sizeof(counter_));
+  OPENSSL_cleanse(temp, sizeof(temp));
+}
+
+void CtrDrbg::NextBlock(uint8_t block[AES_BLOCK_SIZE]) {
+  // Increment the counter as a big-endian 128-bit integer.
+  for (int i = AES_BLOCK_SIZE - 1; i >= 0; --i) {
+    if (++counter_[i] != 0) {
+      break;
+    }
+  }
+  AES_encrypt(counter_, block, &key_);
+}
+
+}  // namespace asylo
@@ -0,0 +1,87 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_PRIMITIVES_CTR_DRBG_H_
+#define ASYLO_PLATFORM_PRIMITIVES_CTR_DRBG_H_
+
+#include <openssl/aes.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace asylo {
+
+// A deterministic random bit generator using AES-256 in counter mode without a
+// derivation function, as specified by NIST SP 800-90A Rev. 1, section 10.2.1.
+//
+// A default-constructed CtrDrbg is constant-initialized and unseeded, so it may
+// be used as a thread_local in the trusted runtime. It is not thread-safe.
+class CtrDrbg {
+ public:
+  // The number of bytes of entropy input consumed by Seed() and Reseed().
+  static constexpr size_t kSeedSize = 48;
+
+  // The maximum number of bytes returned by a single call to Generate().
+  static constexpr size_t kMaxRequestSize = 1 << 16;
+
+  // The number of calls to Generate() after which the generator must be
+  // reseeded. This is far below the limit of 2^48 allowed by SP 800-90A so that
+  // fresh entropy is mixed in regularly.
+  static constexpr uint64_t kReseedInterval = 1 << 12;
+
+  constexpr CtrDrbg() = default;
+
+  CtrDrbg(const CtrDrbg &other) = delete;
+  CtrDrbg &operator=(const CtrDrbg &other) = delete;
+
+  // Instantiates the generator from |seed|, discarding any previous state.
+  void Seed(const uint8_t seed[kSeedSize]);
+
+  // Mixes |seed| into the state of a seeded generator.
+  void Reseed(const uint8_t seed[kSeedSize]);
+
+  // Returns true if the generator must be seeded or reseeded before the next
+  // call to Generate().
+  bool NeedsReseed() const;
+
+  // Writes |size| pseudorandom bytes to |buf|. The generator must not need a
+  // reseed and |size| must be at most kMaxRequestSize.
+  void Generate(uint8_t *buf, size_t size);
+
+  // Erases the state of the generator, leaving it unseeded.
+  void Clear();
+
+ private:
+  // Updates the key and counter from |provided_data|, which is kSeedSize bytes
+  // long, or from zeros if |provided_data| is nullptr.
+  void Update(const uint8_t *provided_data);
+
+  // Encrypts the next counter block into |block|.
+  void NextBlock(uint8_t block[AES_BLOCK_SIZE]);
+
+  AES_KEY key_ = {};
+  uint8_t counter_[AES_BLOCK_SIZE] = {};
+
+  // The number of calls to Generate() since the last seed, or 0 if the
+  // generator is unseeded.
+  uint64_t reseed_counter_ = 0;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_PRIMITIVES_CTR_DRBG_H_
@@ -0,0 +1,93 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/primitives/ctr_drbg.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/strings/escaping.h"
+
+namespace asylo {
+namespace {
+
+using ::testing::Eq;
+using ::testing::Ne;
+
+// Returns the seed whose bytes are |first|, |first| + 1, ...
+std::vector<uint8_t> SequentialSeed(uint8_t first) {
+  std::vector<uint8_t> seed(CtrDrbg::kSeedSize);
+  for (size_t i = 0; i < seed.size(); ++i) {
+    seed[i] = first + i;
+  }
+  return seed;
+}
+
+std::string GenerateHex(CtrDrbg *drbg, size_t size) {
+  std::string output(size, '\0');
+  drbg->Generate(reinterpret_cast<uint8_t *>(&output[0]), size);
+  return absl::BytesToHexString(output);
+}
+
+TEST(CtrDrbgTest, MatchesKnownAnswers) {
+  CtrDrbg drbg;
+  drbg.Seed(SequentialSeed(0x00).data());
+  EXPECT_THAT(GenerateHex(&drbg, 20),
+              Eq("061550234d158c5ec95595fe04ef7a25767f2e24"));
+  EXPECT_THAT(GenerateHex(&drbg, 32),
+              Eq("1a9fbcbc8da36dff2abe203296170fdb"
+                 "97c3297f67fcb679ac719c9fd00253b0"));
+  drbg.Reseed(SequentialSeed(0x80).data());
+  EXPECT_THAT(GenerateHex(&drbg, 16), Eq("84022c57a01ab9e67632a96620d4ca37"));
+}
+
+TEST(CtrDrbgTest, DifferentSeedsGiveDifferentOutputs) {
+  CtrDrbg drbg1;
+  CtrDrbg drbg2;
+  drbg1.Seed(SequentialSeed(0x00).data());
+  drbg2.Seed(SequentialSeed(0x01).data());
+  EXPECT_THAT(GenerateHex(&drbg1, 32), Ne(GenerateHex(&drbg2, 32)));
+}
+
+TEST(CtrDrbgTest, NeedsSeedBeforeUse) {
+  CtrDrbg drbg;
+  EXPECT_TRUE(drbg.NeedsReseed());
+  drbg.Seed(SequentialSeed(0x00).data());
+  EXPECT_FALSE(drbg.NeedsReseed());
+  drbg.Clear();
+  EXPECT_TRUE(drbg.NeedsReseed());
+}
+
+TEST(CtrDrbgTest, NeedsReseedAfterInterval) {
+  CtrDrbg drbg;
+  drbg.Seed(SequentialSeed(0x00).data());
+  uint8_t byte;
+  for (uint64_t i = 0; i < CtrDrbg::kReseedInterval; ++i) {
+    ASSERT_FALSE(drbg.NeedsReseed());
+    drbg.Generate(&byte, sizeof(byte));
+  }
+  EXPECT_TRUE(drbg.NeedsReseed());
+  drbg.Reseed(SequentialSeed(0x80).data());
+  EXPECT_FALSE(drbg.NeedsReseed());
+}
+
+}  // namespace
+}  // namespace asylo
@@ -26,7 +26,9 @@
 #include "asylo/platform/primitives/primitives.h"
 #include "asylo/platform/primitives/trusted_primitives.h"
 #include "asylo/platform/primitives/trusted_runtime.h"
+#include "asylo/platform/primitives/util/boundary_copy.h"
 #include "asylo/platform/primitives/util/message.h"
+#include "asylo/platform/primitives/util/trace_context.h"
 #include "asylo/platform/primitives/util/trusted_runtime_helper.h"
 
 namespace asylo {
@@ -174,14 +176,25 @@ void TrustedPrimitives::UntrustedLocalFree(void *ptr) noexcept {
   GetDlopenTrampoline()->asylo_local_free_handler(ptr);
 }
 
+// UntrustedCall always copies its input across the trampoline, so messages are
+// not serialized in place.
+void *TrustedPrimitives::UntrustedMessageAlloc(size_t size) noexcept {
+  return nullptr;
+}
+
+void TrustedPrimitives::UntrustedMessageFree(void *ptr) noexcept {}
+
 void *TrustedPrimitives::UntrustedLocalMemcpy(void *dest, const void *src,
                                               size_t size) noexcept {
-  return memcpy(dest, src, size);
+  return BoundaryMemcpy(dest, src, size);
 }
 
 PrimitiveStatus TrustedPrimitives::UntrustedCall(uint64_t untrusted_selector,
                                                  MessageWriter *input,
                                                  MessageReader *output) {
+  TracedCall traced_call(SpanKind::kHostCall, &untrusted_selector, &input,
+                         &output);
+
   size_t input_size = 0;
   void *input_buffer = nullptr;
   if (input) {
@@ -25,6 +25,7 @@
 #include <cstddef>
 #include <cstdlib>
 #include <memory>
+#include <string>
 #include <utility>
 
 #include "absl/base/call_once.h"
@@ -37,6 +38,7 @@
 #include "asylo/platform/primitives/untrusted_primitives.h"
 #include "asylo/platform/primitives/util/message.h"
 #include "asylo/platform/primitives/util/status_conversions.h"
+#include "asylo/util/logging.h"
 #include "asylo/util/status.h"
 #include "asylo/util/status_macros.h"
 #include "asylo/util/statusor.h"
@@ -102,9 +104,29 @@ void InitTrampolineOnce() {
       &dlopen_asylo_local_free_handler;
 }
 
+// Loads the enclave library at |path| in a new link-map namespace, so that
+// every instance of the same enclave gets its own copy of the library's data
+// and bss, as separate enclaves would. The read-only segments of all instances
+// are mapped from the same file and share the same physical pages. glibc only
+// supports 15 additional namespaces, so once they are exhausted this falls back
+// to dlopen(), which shares a single instance of the library between all
+// clients loading it. Returns nullptr on failure, with the error available
+// from dlerror().
+void *OpenEnclaveLibrary(const std::string &path) {
+  void *handle = dlmopen(LM_ID_NEWLM, path.c_str(), RTLD_LAZY | RTLD_LOCAL);
+  if (handle) {
+    return handle;
+  }
+  LOG(WARNING) << "dlmopen of " << path << " failed with: " << dlerror()
+               << "; sharing its instance with other clients";
+  return dlopen(path.c_str(), RTLD_LAZY | RTLD_LOCAL);
+}
+
 }  // namespace
 
 DlopenEnclaveClient::~DlopenEnclaveClient() {
+  // Pending asynchronous calls still enter the enclave through this object.
+  StopAsyncEntryThreads();
   if (dl_handle_) {
     if (enclave_call_) {
       size_t output_size = 0;
@@ -136,7 +158,7 @@ StatusOr<std::shared_ptr<Client>> DlopenBackend::Load(
 
     // dlopen may allocate resources which are not disposed by dlclose.
     absl::LeakCheckDisabler disabler;
-    client->dl_handle_ = dlopen(path.c_str(), RTLD_LAZY | RTLD_LOCAL);
+    client->dl_handle_ = OpenEnclaveLibrary(path);
   }
   if (!client->dl_handle_) {
     return Status{
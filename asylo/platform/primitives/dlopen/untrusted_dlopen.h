@@ -39,6 +39,10 @@
 // call to dlopen(). The enclave library is expected to export "C" linkage
 // symbols `asylo_enclave_init` and `asylo_enclave_fini` which will be called by
 // the runtime to initialize and finalize the enclave respectively.
+//
+// Each load maps the library in its own link-map namespace with dlmopen(), so
+// that many independent instances of the same enclave can run concurrently in
+// one process while sharing their code pages.
 
 namespace asylo {
 namespace primitives {
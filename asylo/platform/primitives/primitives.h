@@ -41,26 +41,44 @@ static constexpr uint64_t kSelectorAsyloDonateThread = 2;
 /// Enclave finalization entry point selector.
 static constexpr uint64_t kSelectorAsyloFini = 3;
 
+/// Switchless host call ring registration entry point selector.
+static constexpr uint64_t kSelectorAsyloSwitchlessInit = 4;
+
+/// Untrusted arena registration entry point selector.
+static constexpr uint64_t kSelectorAsyloUntrustedArenaInit = 5;
+
+/// Host clock page registration entry point selector.
+static constexpr uint64_t kSelectorAsyloHostClockInit = 6;
+
+/// Host io_uring instance registration entry point selector.
+static constexpr uint64_t kSelectorAsyloIoUringInit = 7;
+
 //////////////////////////////////////
 //      Exit handler selectors      //
 //////////////////////////////////////
 
 /// Selector for thread creation handler.
-static constexpr uint64_t kSelectorCreateThread = 87;
+static constexpr uint64_t kSelectorCreateThread = 79;
 
 /// Selector values in [`kSelectorHostCall`, `kSelectorRemote`) range are
 /// reserved for untrusted host call handlers and cannot be used by any other
 /// component.
-static constexpr uint64_t kSelectorHostCall = 88;
+static constexpr uint64_t kSelectorHostCall = 80;
 
 /// Selector values in [`kSelectorRemote`, `kSelectorUser`) range are reserved
 /// for remote backend needs and cannot be used by any other component.
-static constexpr uint64_t kSelectorRemote = 120;
+static constexpr uint64_t kSelectorRemote = 126;
 
 /// Selector values less than `kSelectorUser` are reserved by the runtime and
 /// may not be registered by the applications.
 static constexpr uint64_t kSelectorUser = 128;
 
+static_assert(kSelectorAsyloIoUringInit < kSelectorCreateThread &&
+                  kSelectorCreateThread < kSelectorHostCall &&
+                  kSelectorHostCall < kSelectorRemote &&
+                  kSelectorRemote < kSelectorUser,
+              "Selector ranges must not overlap.");
+
 }  // namespace primitives
 }  // namespace asylo
 
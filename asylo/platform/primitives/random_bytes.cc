@@ -16,12 +16,14 @@
  *
  */
 
-#include <cpuid.h>
 #include <immintrin.h>
 #include <stdlib.h>
 #include <string.h>
 #include <algorithm>
 
+#include "absl/base/attributes.h"
+#include "asylo/platform/primitives/cpuid.h"
+#include "asylo/platform/primitives/ctr_drbg.h"
 #include "asylo/platform/primitives/trusted_runtime.h"
 
 namespace {
@@ -58,11 +60,70 @@ static void CalculateAlignment(const void *buf, size_t size, size_t align_size,
   *partial_bytes = size - *unaligned_bytes - (*aligned_count * align_size);
 }
 
+// Number of pseudorandom bytes generated at once to serve small requests.
+static constexpr size_t kPseudorandomPoolSize = 512;
+
+// Requests at least this large bypass the pool.
+static constexpr size_t kPseudorandomPoolBypassSize = kPseudorandomPoolSize / 4;
+
+// Per-thread state of enc_pseudorandom.
+struct PseudorandomState {
+  asylo::CtrDrbg drbg;
+
+  // Value of |pseudorandom_generation| when |drbg| was seeded, or 0 if it is
+  // unseeded.
+  uint64_t generation = 0;
+
+  // Generated bytes not yet handed out are |pool|[|pool_offset|, end). Bytes
+  // are erased as they are handed out.
+  uint8_t pool[kPseudorandomPoolSize] = {};
+  size_t pool_offset = kPseudorandomPoolSize;
+};
+
+ABSL_CONST_INIT thread_local PseudorandomState pseudorandom_state;
+
+// Incremented by enc_pseudorandom_reset to force every thread to reseed.
+uint64_t pseudorandom_generation = 1;
+
+// Seeds or reseeds the DRBG of the calling thread from RDRAND if required.
+static void MaybeReseedPseudorandom(PseudorandomState *state) {
+  uint64_t generation =
+      __atomic_load_n(&pseudorandom_generation, __ATOMIC_ACQUIRE);
+  if (state->generation == generation && !state->drbg.NeedsReseed()) {
+    return;
+  }
+  uint8_t seed[asylo::CtrDrbg::kSeedSize];
+  enc_hardware_random(seed, sizeof(seed));
+  if (state->generation == generation) {
+    state->drbg.Reseed(seed);
+  } else {
+    // The pool may hold bytes also held by a copy of this enclave.
+    memset(state->pool, 0, sizeof(state->pool));
+    state->pool_offset = kPseudorandomPoolSize;
+    state->drbg.Seed(seed);
+    state->generation = generation;
+  }
+  memset(seed, 0, sizeof(seed));
+}
+
+static void GeneratePseudorandom(PseudorandomState *state, uint8_t *buf,
+                                 size_t count) {
+  while (count > 0) {
+    MaybeReseedPseudorandom(state);
+    size_t chunk = std::min(count, asylo::CtrDrbg::kMaxRequestSize);
+    state->drbg.Generate(buf, chunk);
+    buf += chunk;
+    count -= chunk;
+  }
+}
+
 static bool cpuid_rdrand() {
-  unsigned int eax, ebx, ecx, edx;
-  __cpuid(1, eax, ebx, ecx, edx);
+  uint32_t registers[4];
+  if (!enc_cpuid(1, 0, registers)) {
+    return false;
+  }
   // Bit 30 of ECX is set => machine supports RDRAND.
-  return !!(ecx & (1 << 30));
+  return !!(registers[2] & (1 << 30));
 }
 
 }  // namespace
@@ -117,3 +178,30 @@ extern "C" ssize_t enc_hardware_random(uint8_t *buf, size_t count) {
 
   return count;
 }
+
+extern "C" ssize_t enc_pseudorandom(uint8_t *buf, size_t count) {
+  if (!asylo::rdrand_supported()) {
+    return -1;
+  }
+  PseudorandomState *state = &pseudorandom_state;
+  if (count >= kPseudorandomPoolBypassSize) {
+    GeneratePseudorandom(state, buf, count);
+    return count;
+  }
+
+  // Generation changes are detected when reseeding, which also empties the
+  // pool, so check before serving from it.
+  MaybeReseedPseudorandom(state);
+  if (kPseudorandomPoolSize - state->pool_offset < count) {
+    GeneratePseudorandom(state, state->pool, kPseudorandomPoolSize);
+    state->pool_offset = 0;
+  }
+  memcpy(buf, &state->pool[state->pool_offset], count);
+  memset(&state->pool[state->pool_offset], 0, count);
+  state->pool_offset += count;
+  return count;
+}
+
+extern "C" void enc_pseudorandom_reset() {
+  __atomic_add_fetch(&pseudorandom_generation, 1, __ATOMIC_ACQ_REL);
+}
@@ -18,24 +18,35 @@
 
 #include "asylo/platform/primitives/remote/communicator.h"
 
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
 #include <memory>
-#include <queue>
+#include <string>
 #include <utility>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
+#include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "absl/types/optional.h"
 #include "asylo/util/logging.h"
 #include "include/grpcpp/support/status.h"
+#include "asylo/platform/common/futex.h"
 #include "asylo/platform/primitives/remote/grpc_client_impl.h"
 #include "asylo/platform/primitives/remote/grpc_server_impl.h"
 #include "asylo/platform/primitives/remote/grpc_service.grpc.pb.h"
 #include "asylo/platform/primitives/remote/grpc_service.pb.h"
+#include "asylo/platform/primitives/remote/message_compression.h"
+#include "asylo/platform/primitives/remote/metrics/clients/opencensus_communicator_metrics.h"
+#include "asylo/platform/primitives/remote/shared_memory_transport.h"
 #include "asylo/util/cleanup.h"
 #include "asylo/util/mutex_guarded.h"
+#include "asylo/util/remote/remote_proxy_config.h"
 #include "asylo/util/status.h"
 #include "asylo/util/status_macros.h"
 #include "asylo/util/statusor.h"
@@ -48,6 +59,14 @@
 namespace asylo {
 namespace primitives {
 
+namespace {
+
+// Size of each direction of the shared memory transport. Larger messages are
+// sent over gRPC.
+constexpr size_t kSharedMemoryRingCapacity = 1 << 20;
+
+}  // namespace
+
 ABSL_CONST_INIT thread_local Communicator::ThreadActivityWorkQueue
     *Communicator::current_thread_context_ = nullptr;
 
@@ -64,11 +83,25 @@ MutexGuarded<absl::flat_hash_set<Communicator *>>
 // Encapsulates the necessary information to schedule multiple messages for
 // processing on the same worker thread. Created when host_thread_id shows up
 // for the first time on 'Communicate' RPC.
+//
+// Messages are passed through a lock-free multi-producer, single-consumer
+// queue: any thread receiving messages pushes to it, and only the thread
+// controlled by ThreadActivityWorkQueue pops from it. That thread spins briefly
+// on an empty queue before it sleeps on a futex, which producers only touch
+// when it is actually asleep.
 class Communicator::ThreadActivityWorkQueue {
  public:
   // Pushes a message to be processed in the context of this thread.
   Status QueueMessage(CommunicationMessagePtr wrapped_message) {
-    wrapped_messages_queue_.Lock()->queue.emplace(std::move(wrapped_message));
+    auto *const node = new Node(std::move(wrapped_message));
+    if (OpenCensusCommunicatorMetrics::enabled()) {
+      node->queued_nanos = absl::GetCurrentTimeNanos();
+    }
+    // Link the node after the previous head. Until the link is stored, the
+    // consumer sees the queue end at the previous head.
+    Node *const prev = head_.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node);
+    WakeConsumer();
     return Status::OkStatus();
   }
 
@@ -77,16 +110,12 @@ class Communicator::ThreadActivityWorkQueue {
   StatusOr<CommunicationMessagePtr> MessageLoop(Communicator *communicator) {
     for (;;) {
       CommunicationMessagePtr wrapped_message;
-      {
-        auto locked_message_queue = wrapped_messages_queue_.LockWhen(
-            [](const WrappedMessageQueue &message_queue) {
-              return message_queue.is_exiting || !message_queue.queue.empty();
-            });
-        if (locked_message_queue->is_exiting) {
+      if (!WaitForMessage(&wrapped_message, communicator)) {
+        if (is_exiting_.load()) {
           return Status(error::GoogleError::CANCELLED, "Channel disconnected");
         }
-        wrapped_message = std::move(locked_message_queue->queue.front());
-        locked_message_queue->queue.pop();
+        return Status(error::GoogleError::UNAVAILABLE,
+                      "Connection to the counterpart lost");
       }
       // A message was received, it must have a selector and thread id.
       Status message_status = IsMessageValid(*wrapped_message);
@@ -115,11 +144,20 @@ class Communicator::ThreadActivityWorkQueue {
 
   Thread::Id GetHostThreadId() const { return host_thread_id_; }
 
-  void SignalExit() { wrapped_messages_queue_.Lock()->is_exiting = true; }
+  void SignalExit() {
+    is_exiting_.store(true);
+    Interrupt();
+  }
+
+  // Wakes the thread if it is waiting for a message, so that it checks
+  // whether its communicator has lost the connection.
+  void Interrupt() {
+    wake_sequence_.fetch_add(1);
+    sys_futex_wake(reinterpret_cast<int32_t *>(&wake_sequence_), 1);
+  }
 
   explicit ThreadActivityWorkQueue(Thread::Id host_thread_id)
-      : wrapped_messages_queue_(WrappedMessageQueue()),
-        host_thread_id_(host_thread_id) {}
+      : head_(&stub_), tail_(&stub_), host_thread_id_(host_thread_id) {}
 
   ~ThreadActivityWorkQueue() {
     SignalExit();
@@ -127,9 +165,14 @@ class Communicator::ThreadActivityWorkQueue {
       worker_thread_->Join();
       worker_thread_.reset();
     }
-    auto locked_message_queue = wrapped_messages_queue_.ReaderLock();
-    CHECK(locked_message_queue->is_exiting ||
-          locked_message_queue->queue.empty());
+    // Discard messages never processed, releasing whatever they hold.
+    CommunicationMessagePtr wrapped_message;
+    while (TryPop(&wrapped_message)) {
+      wrapped_message.reset();
+    }
+    if (tail_ != &stub_) {
+      delete tail_;
+    }
   }
 
   ThreadActivityWorkQueue(const ThreadActivityWorkQueue &other) = delete;
@@ -155,23 +198,108 @@ class Communicator::ThreadActivityWorkQueue {
   }
 
  private:
-  // Guarded 'wrapped_messages_queue_' owned by this context.
-  // Thread controlled by ThreadActivityWorkQueue ('worker_thread' for the
-  // target, application thread for the host) is either processing a message
-  // retrieved from the queue, or blocked on this mutex waiting for more
-  // message(s) to arrive.
-  struct WrappedMessageQueue {
-    // Queue of messages to be processed on the thread. When the queue is empty,
-    // the MessageLoop method will wait for messages to be enqueued.
-    // Each message represents either an Invocation request that the counterpart
-    // Communicator sent for processing on this thread, or the response from the
-    // other side to an Invocation that this Communicator's thread sent.
-    std::queue<CommunicationMessagePtr> queue;
-
-    // Flag inidicating that the thread needs to exit.
-    bool is_exiting = false;
+  // Number of times the consumer polls an empty queue before it sleeps.
+  static constexpr int kSpinIterations = 1024;
+
+  // Queue node. The queue always holds one node whose message has already
+  // been consumed (initially |stub_|), which |tail_| points to.
+  struct Node {
+    Node() = default;
+    explicit Node(CommunicationMessagePtr message)
+        : message(std::move(message)) {}
+
+    CommunicationMessagePtr message;
+    std::atomic<Node *> next{nullptr};
+
+    // Time the message was queued, if metrics are being recorded.
+    int64_t queued_nanos = 0;
   };
-  MutexGuarded<WrappedMessageQueue> wrapped_messages_queue_;
+
+  // Pops the oldest message into |wrapped_message|, if any. Called by the
+  // consumer only. If |queued_nanos| is not null, it receives the time the
+  // message was queued.
+  bool TryPop(CommunicationMessagePtr *wrapped_message,
+              int64_t *queued_nanos = nullptr) {
+    Node *const next = tail_->next.load();
+    if (next == nullptr) {
+      return false;
+    }
+    *wrapped_message = std::move(next->message);
+    if (queued_nanos != nullptr) {
+      *queued_nanos = next->queued_nanos;
+    }
+    if (tail_ != &stub_) {
+      delete tail_;
+    }
+    tail_ = next;
+    return true;
+  }
+
+  // Waits for the next message and pops it into |wrapped_message|. Returns
+  // false if the thread is signaled to exit instead, or if |communicator| has
+  // lost the connection and no message is left.
+  bool WaitForMessage(CommunicationMessagePtr *wrapped_message,
+                      const Communicator *communicator) {
+    int spins = 0;
+    for (;;) {
+      if (is_exiting_.load()) {
+        return false;
+      }
+      int64_t queued_nanos;
+      if (TryPop(wrapped_message, &queued_nanos)) {
+        if (queued_nanos != 0) {
+          OpenCensusCommunicatorMetrics::RecordQueueingDelay(absl::Nanoseconds(
+              absl::GetCurrentTimeNanos() - queued_nanos));
+        }
+        return true;
+      }
+      if (communicator->connection_lost()) {
+        return false;
+      }
+      if (++spins < kSpinIterations) {
+        continue;
+      }
+      // Setting |consumer_sleeping_| and then checking the queue pairs with
+      // producers linking a node and then checking |consumer_sleeping_|: with
+      // sequential consistency, at least one side sees the other's write.
+      // Reading |wake_sequence_| first makes the wait return at once if a
+      // wake-up happens before it starts, including an Interrupt() after the
+      // connection is lost.
+      const int32_t sequence = wake_sequence_.load();
+      consumer_sleeping_.store(true);
+      if (tail_->next.load() == nullptr && !is_exiting_.load() &&
+          !communicator->connection_lost()) {
+        sys_futex_wait(reinterpret_cast<int32_t *>(&wake_sequence_), sequence,
+                       /*timeout_microsec=*/0);
+      }
+      consumer_sleeping_.store(false);
+      spins = 0;
+    }
+  }
+
+  void WakeConsumer() {
+    if (consumer_sleeping_.load()) {
+      wake_sequence_.fetch_add(1);
+      sys_futex_wake(reinterpret_cast<int32_t *>(&wake_sequence_), 1);
+    }
+  }
+
+  // Queue of messages to be processed on the thread. Each message represents
+  // either an Invocation request that the counterpart Communicator sent for
+  // processing on this thread, or the response from the other side to an
+  // Invocation that this Communicator's thread sent. Producers push at
+  // |head_|; the thread controlled by ThreadActivityWorkQueue ('worker_thread'
+  // for the target, application thread for the host) pops at |tail_|.
+  Node stub_;
+  std::atomic<Node *> head_;
+  Node *tail_;
+
+  // Futex word the consumer sleeps on, bumped by every wake-up.
+  std::atomic<int32_t> wake_sequence_{0};
+  std::atomic<bool> consumer_sleeping_{false};
+
+  // Flag indicating that the thread needs to exit.
+  std::atomic<bool> is_exiting_{false};
 
   // Host thread id (for host side it matches the current thread).
   const Thread::Id host_thread_id_;
@@ -185,6 +313,16 @@ class Communicator::ThreadActivityWorkQueue {
 StatusOr<Communicator::ThreadActivityWorkQueue *>
 Communicator::LocateOrCreateThreadActivityWorkQueue(
     Thread::Id invocation_thread_id) {
+  // Every message is routed through the map, and threads are only added once,
+  // so look up known threads under a shared lock.
+  {
+    auto reader_locked_threads_map =
+        ThreadActivityWorkQueue::map()->ReaderLock();
+    auto it = reader_locked_threads_map->find(invocation_thread_id);
+    if (it != reader_locked_threads_map->end()) {
+      return it->second.get();
+    }
+  }
   auto locked_threads_map = ThreadActivityWorkQueue::map()->Lock();
   auto it = locked_threads_map->find(invocation_thread_id);
   if (it == locked_threads_map->end()) {
@@ -196,6 +334,10 @@ Communicator::LocateOrCreateThreadActivityWorkQueue(
                     "Failed to add thread to the map");
     }
     it = ins.first;
+    if (OpenCensusCommunicatorMetrics::enabled()) {
+      OpenCensusCommunicatorMetrics::RecordActiveThreads(
+          locked_threads_map->size());
+    }
     if (is_host()) {
       // Before recording current_thread_context_, set a thread exit callback
       // which will signal the target side that the matching thread is no longer
@@ -241,7 +383,32 @@ StatusOr<Communicator::CommunicationMessagePtr> Communicator::MessageLoop() {
 
 void Communicator::QueueMessageForThread(
     CommunicationMessagePtr wrapped_message) {
-  Status message_status = IsMessageValid(*wrapped_message);
+  if (wrapped_message->batch_size() > 0) {
+    // Split coalesced messages. The frame itself is released once they have
+    // all been taken out of it.
+    for (CommunicationMessage &batched : *wrapped_message->mutable_batch()) {
+      auto message = absl::make_unique<CommunicationMessage>();
+      message->Swap(&batched);
+      CommunicationMessage *const raw_message = message.release();
+      QueueMessageForThread(CommunicationMessagePtr(
+          raw_message, WrappedMessageDeleter([raw_message] {
+            delete raw_message;
+          })));
+    }
+    return;
+  }
+  if (OpenCensusCommunicatorMetrics::enabled()) {
+    OpenCensusCommunicatorMetrics::RecordMessage(
+        OpenCensusCommunicatorMetrics::Direction::kReceived,
+        wrapped_message->ByteSizeLong());
+  }
+  Status message_status = DecompressItems(wrapped_message.get());
+  if (!message_status.ok()) {
+    LOG(ERROR) << "Undecodable InvocationParameters message, status="
+               << message_status;
+    return;
+  }
+  message_status = IsMessageValid(*wrapped_message);
   if (!message_status.ok()) {
     LOG(ERROR) << "Malformed InvocationParameters message, status="
                << message_status;
@@ -293,13 +460,128 @@ Status Communicator::Connect(const RemoteProxyConfig &config,
   ASYLO_RETURN_IF_ERROR(CreateStub(config, remote_address));
   // Success.
   is_client_ready_.store(true);
+
+  // Host connects last, so both sides are ready to negotiate the transport.
+  if (is_host() &&
+      dynamic_cast<const RemoteProxyClientConfig &>(config)
+          .shared_memory_transport_enabled()) {
+    const Status shared_memory_status = OfferSharedMemory();
+    LOG_IF(INFO, !shared_memory_status.ok())
+        << "Not using shared memory transport: " << shared_memory_status;
+  }
+
+  const absl::Duration interval = config.health_check_interval();
+  if (interval > absl::ZeroDuration() && !health_check_thread_) {
+    const absl::Duration timeout = config.health_check_timeout();
+    health_check_thread_ = absl::make_unique<Thread>(
+        [this, interval, timeout] { HealthCheckLoop(interval, timeout); });
+  }
+  return Status::OkStatus();
+}
+
+void Communicator::HealthCheckLoop(absl::Duration interval,
+                                   absl::Duration timeout) {
+  while (!stop_health_check_.WaitForNotificationWithTimeout(interval)) {
+    // The heartbeat always travels over gRPC, so that it exercises the
+    // connection even when messages go through shared memory.
+    const Status status = client_->SendHeartbeat(timeout);
+    if (!status.ok()) {
+      MarkConnectionLost(status);
+      return;
+    }
+  }
+}
+
+void Communicator::StopHealthCheck() {
+  if (!health_check_thread_) {
+    return;
+  }
+  if (!stop_health_check_.HasBeenNotified()) {
+    stop_health_check_.Notify();
+  }
+  health_check_thread_->Join();
+  health_check_thread_.reset();
+}
+
+void Communicator::MarkConnectionLost(const Status &status) {
+  LOG(ERROR) << "Connection to the counterpart lost: " << status;
+  connection_lost_.store(true);
+  // Queues are shared by all communicators in the process. Threads waiting
+  // for another communicator go back to sleep.
+  for (const auto &entry : *ThreadActivityWorkQueue::map()->ReaderLock()) {
+    entry.second->Interrupt();
+  }
+}
+
+Status Communicator::OfferSharedMemory() {
+  CHECK(is_host());
+  std::unique_ptr<SharedMemoryTransport> transport;
+  ASYLO_ASSIGN_OR_RETURN(
+      transport, SharedMemoryTransport::Create(kSharedMemoryRingCapacity));
+  bool accepted;
+  ASYLO_ASSIGN_OR_RETURN(accepted, client_->SendSharedMemoryOffer(
+                                       transport->name(), transport->nonce()));
+  // Either way, the segment is no longer needed under its name.
+  transport->Unlink();
+  if (!accepted) {
+    return Status(error::GoogleError::FAILED_PRECONDITION,
+                  "Target could not open the shared memory segment");
+  }
+  ActivateSharedMemory(std::move(transport));
   return Status::OkStatus();
 }
 
+Status Communicator::AcceptSharedMemory(absl::string_view name,
+                                        absl::string_view nonce) {
+  CHECK(!is_host());
+  if (shared_memory_) {
+    return Status(error::GoogleError::ALREADY_EXISTS,
+                  "Shared memory transport already in use");
+  }
+  std::unique_ptr<SharedMemoryTransport> transport;
+  ASYLO_ASSIGN_OR_RETURN(transport, SharedMemoryTransport::Open(name, nonce));
+  ActivateSharedMemory(std::move(transport));
+  return Status::OkStatus();
+}
+
+void Communicator::ActivateSharedMemory(
+    std::unique_ptr<SharedMemoryTransport> transport) {
+  shared_memory_ = std::move(transport);
+  shared_memory_->Start([this](std::string frame) {
+    ReceiveSharedMemoryFrame(std::move(frame));
+  });
+  active_shared_memory_.store(shared_memory_.get());
+}
+
+void Communicator::CloseSharedMemory() {
+  active_shared_memory_.store(nullptr);
+  if (shared_memory_) {
+    shared_memory_->Close();
+  }
+}
+
+void Communicator::ReceiveSharedMemoryFrame(std::string frame) {
+  auto message = absl::make_unique<CommunicationMessage>();
+  if (!message->ParseFromString(frame)) {
+    LOG(ERROR) << "Dropping malformed message received over shared memory";
+    return;
+  }
+  // If received time stamp from host with the message, store it.
+  if (!is_host() && message->has_host_time_nanos()) {
+    set_host_time_nanos(message->host_time_nanos());
+  }
+  CommunicationMessage *const raw_message = message.release();
+  WrappedMessageDeleter deleter([raw_message] { delete raw_message; });
+  QueueMessageForThread(
+      CommunicationMessagePtr(raw_message, std::move(deleter)));
+}
+
 Communicator::Communicator(bool is_host)
     : is_host_(is_host),
+      active_shared_memory_(nullptr),
       is_server_ready_(false),
       is_client_ready_(false),
+      connection_lost_(false),
       last_host_time_nanos_(absl::nullopt) {
   if (is_host) {
     // For host: register communicator in the static set.
@@ -338,7 +620,12 @@ std::string Communicator::WaitForEndPointAddress() {
 }
 
 void Communicator::Disconnect() {
-  if (is_client_ready_.exchange(false)) {
+  StopHealthCheck();
+  // Closing the shared memory transport also stops the counterpart from
+  // receiving over it.
+  CloseSharedMemory();
+  // A lost counterpart would never answer the disconnect request.
+  if (is_client_ready_.exchange(false) && !connection_lost()) {
     client_->SendDisconnect();
   }
   if (is_server_ready_.exchange(false)) {
@@ -357,6 +644,10 @@ void Communicator::DisposeOfThread(Thread::Id exiting_thread_id) {
     }
     thread_context = std::move(it->second);
     locked_threads_map->erase(it);
+    if (OpenCensusCommunicatorMetrics::enabled()) {
+      OpenCensusCommunicatorMetrics::RecordActiveThreads(
+          locked_threads_map->size());
+    }
   }
   if (thread_context) {
     thread_context->SignalExit();
@@ -364,7 +655,8 @@ void Communicator::DisposeOfThread(Thread::Id exiting_thread_id) {
 }
 
 bool Communicator::IsConnected() const {
-  return is_server_ready_.load() && is_client_ready_.load();
+  return is_server_ready_.load() && is_client_ready_.load() &&
+         !connection_lost_.load();
 }
 
 void Communicator::Invoke(
@@ -409,12 +701,21 @@ void Communicator::Invoke(
   invocation->status = client_->RunInvocation(invocation.get());
 }
 
-Status Communicator::SendCommunication(const CommunicationMessage &message) {
+Status Communicator::SendCommunication(CommunicationMessage *message) {
   return client_->SendCommunication(message);
 }
 
 int Communicator::server_port() const { return service_->server_port(); }
 
+void Communicator::MoveItemsToReader(CommunicationMessage *message,
+                                     MessageReader *reader) {
+  std::vector<std::string> items(message->items_size());
+  for (int i = 0; i < message->items_size(); ++i) {
+    items[i].swap(*message->mutable_items(i));
+  }
+  reader->Deserialize(std::move(items));
+}
+
 Status Communicator::IsMessageValid(const CommunicationMessage &message) {
   if (!message.has_request_sequence_number()) {
     return Status{error::GoogleError::FAILED_PRECONDITION,
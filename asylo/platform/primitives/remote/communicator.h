@@ -32,6 +32,7 @@
 #include "absl/container/flat_hash_set.h"
 #include "absl/memory/memory.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/notification.h"
 #include "absl/time/time.h"
 #include "absl/types/optional.h"
 #include "absl/types/span.h"
@@ -39,6 +40,7 @@
 #include "asylo/platform/primitives/primitive_status.h"
 #include "asylo/platform/primitives/remote/grpc_service.grpc.pb.h"
 #include "asylo/platform/primitives/remote/grpc_service.pb.h"
+#include "asylo/platform/primitives/remote/shared_memory_transport.h"
 #include "asylo/platform/primitives/untrusted_primitives.h"
 #include "asylo/platform/primitives/util/message.h"
 #include "asylo/util/asylo_macros.h"
@@ -112,6 +114,11 @@ class Communicator {
   using CommunicationMessagePtr =
       std::unique_ptr<CommunicationMessage, WrappedMessageDeleter>;
 
+  // Moves the items of |message| into |reader| without copying their
+  // contents, leaving the items of |message| empty.
+  static void MoveItemsToReader(CommunicationMessage *message,
+                                MessageReader *reader);
+
   explicit Communicator(bool is_host);
   ~Communicator();
 
@@ -164,10 +171,21 @@ class Communicator {
   // received from the host side that the thread is exiting.
   void DisposeOfThread(Thread::Id exiting_thread_id);
 
+  // Maps the shared memory segment offered by the host side, verifying that
+  // it holds |nonce|, and carries messages over it from now on (on target side
+  // only). Fails if the segment cannot be opened, notably because the host
+  // runs on a different machine.
+  Status AcceptSharedMemory(absl::string_view name, absl::string_view nonce);
+
   // Returns true if the communicator is connected and can be used for both
   // reads and writes.
   ASYLO_MUST_USE_RESULT bool IsConnected() const;
 
+  // Returns true once health checking has found the counterpart unresponsive
+  // (see RemoteProxyConfig::EnableHealthChecking). A lost connection is never
+  // restored: reaching the counterpart again takes a new Communicator.
+  bool connection_lost() const { return connection_lost_.load(); }
+
   // Installs a server-side handler function that processes each incoming RPC.
   // When certain host thread runs a series of Invoke calls with remote backend
   // primitives, target side Communicator needs to run respective handlers on
@@ -218,11 +236,40 @@ class Communicator {
   // takes place on a specific host thread.
   class ThreadActivityWorkQueue;
 
-  // Sends |message| (request or response) to the counterpart Communicator.
-  Status SendCommunication(const CommunicationMessage &message);
+  // Sends |message| (request or response) to the counterpart Communicator. On
+  // host, |message| is stamped with the current host time before it is sent.
+  Status SendCommunication(CommunicationMessage *message);
+
+  // Creates a shared memory segment and offers it to the target side (on host
+  // side only). If the target accepts it, messages are carried over it from
+  // then on.
+  Status OfferSharedMemory();
+
+  // Starts receiving messages over |transport| and makes it the transport for
+  // sent messages.
+  void ActivateSharedMemory(std::unique_ptr<SharedMemoryTransport> transport);
+
+  // Closes the shared memory transport, if there is one, and stops receiving
+  // messages over it.
+  void CloseSharedMemory();
+
+  // Body of the thread that sends a heartbeat to the counterpart every
+  // |interval|, until one is not answered within |timeout|.
+  void HealthCheckLoop(absl::Duration interval, absl::Duration timeout);
+
+  // Stops the health checking thread, if there is one.
+  void StopHealthCheck();
+
+  // Marks the connection lost because of |status|, and wakes every thread
+  // waiting for a message so that invocations in flight fail.
+  void MarkConnectionLost(const Status &status);
+
+  // Handles a message received over the shared memory transport the same way
+  // as one received over gRPC.
+  void ReceiveSharedMemoryFrame(std::string frame);
 
   // Assigns |wrapped_message| to be processed on the thread that matches its
-  // invocation_thread_id.
+  // invocation_thread_id. A frame of coalesced messages is split first.
   void QueueMessageForThread(CommunicationMessagePtr wrapped_message);
 
   // Locates or creates ThreadActivityWorkQueue for the given host thread id
@@ -264,6 +311,12 @@ class Communicator {
   std::unique_ptr<ClientImpl> client_;
   std::unique_ptr<ServiceImpl> service_;
 
+  // Shared memory transport, if negotiated with the counterpart. Set at most
+  // once, while connecting and before any message is sent, and published to
+  // senders through |active_shared_memory_|.
+  std::unique_ptr<SharedMemoryTransport> shared_memory_;
+  std::atomic<SharedMemoryTransport *> active_shared_memory_;
+
   // Flags indicating whether server and client are ready.
   // Set to false by constructor, switched to true when server and client are
   // connected (respectively), reset to false by either Disconnect call or
@@ -271,6 +324,13 @@ class Communicator {
   std::atomic<bool> is_server_ready_;
   std::atomic<bool> is_client_ready_;
 
+  // Set once health checking finds the counterpart unresponsive.
+  std::atomic<bool> connection_lost_;
+
+  // Health checking thread, if enabled, and the notification stopping it.
+  std::unique_ptr<Thread> health_check_thread_;
+  absl::Notification stop_health_check_;
+
   // Last time stamp received from the host (set only on target Communicator).
   // Expires after time specified by --host_time_nanos_expiration flag.
   MutexGuarded<absl::optional<int64_t>> last_host_time_nanos_;
@@ -39,6 +39,7 @@
 #include "absl/base/macros.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/flags/parse.h"
+#include "absl/strings/match.h"
 #include "absl/strings/str_cat.h"
 #include "absl/synchronization/blocking_counter.h"
 #include "absl/time/clock.h"
@@ -159,6 +160,12 @@ class CommunicatorTestFixture : public ::testing::Test {
   // Runs host-side action. Must be overridden.
   virtual void RunAction(Communicator *communicator) = 0;
 
+  // Adjusts host-side client configuration before connecting, if overridden.
+  virtual void ConfigureHost(RemoteProxyClientConfig *config) {}
+
+  // Adjusts target-side configuration before connecting, if overridden.
+  virtual void ConfigureTarget(RemoteProxyConfig *config) {}
+
   // Runs the host or target side of the test, expecting fds_ socketpair
   // to be set for the cross-process communication.
   // Creates Communicator, starts its server, exchanges ports with counterpart,
@@ -196,6 +203,7 @@ class CommunicatorTestFixture : public ::testing::Test {
                                      RemoteProvision::Instantiate()));
       proxy_config->EnableOpenCensusMetricsCollection(absl::Seconds(1),
                                                       "test_name");
+      ConfigureHost(proxy_config.get());
 
       // Establish connection to the target server.
       ASYLO_ASSERT_OK(communicator->Connect(*proxy_config, end_point));
@@ -207,6 +215,7 @@ class CommunicatorTestFixture : public ::testing::Test {
           << strerror(errno);
 
       RemoteProxyConfig proxy_config(std::move(connection_config));
+      ConfigureTarget(&proxy_config);
 
       // Establish connection to the host server.
       ASYLO_ASSERT_OK(communicator->Connect(
@@ -674,6 +683,55 @@ class DuplexNestedMultithreadedInvokesTest : public CommunicatorTestFixture {
   }
 };
 
+// Same as DuplexNestedMultithreadedInvokesTest, with messages passed over
+// shared memory rather than gRPC.
+class DuplexNestedMultithreadedInvokesOverSharedMemoryTest
+    : public DuplexNestedMultithreadedInvokesTest {
+ public:
+  DuplexNestedMultithreadedInvokesOverSharedMemoryTest() = default;
+
+ private:
+  void ConfigureHost(RemoteProxyClientConfig *config) override {
+    config->EnableSharedMemoryTransport();
+  }
+};
+
+// Same as DuplexNestedMultithreadedInvokesTest, with messages coalesced on
+// both sides.
+class DuplexNestedMultithreadedInvokesCoalescedTest
+    : public DuplexNestedMultithreadedInvokesTest {
+ public:
+  DuplexNestedMultithreadedInvokesCoalescedTest() = default;
+
+ private:
+  void ConfigureHost(RemoteProxyClientConfig *config) override {
+    config->EnableMessageCoalescing(absl::Microseconds(200));
+  }
+
+  void ConfigureTarget(RemoteProxyConfig *config) override {
+    config->EnableMessageCoalescing(absl::Microseconds(200));
+  }
+};
+
+// Same as DuplexNestedMultithreadedInvokesTest, with calls and payloads
+// compressed on both sides.
+class DuplexNestedMultithreadedInvokesCompressedTest
+    : public DuplexNestedMultithreadedInvokesTest {
+ public:
+  DuplexNestedMultithreadedInvokesCompressedTest() = default;
+
+ private:
+  void ConfigureHost(RemoteProxyClientConfig *config) override {
+    config->SetChannelCompression(GRPC_COMPRESS_GZIP);
+    config->EnablePayloadCompression(/*threshold=*/0);
+  }
+
+  void ConfigureTarget(RemoteProxyConfig *config) override {
+    config->SetChannelCompression(GRPC_COMPRESS_GZIP);
+    config->EnablePayloadCompression(/*threshold=*/0);
+  }
+};
+
 class UnknownSelectorTest : public CommunicatorTestFixture {
  public:
   UnknownSelectorTest() = default;
@@ -708,6 +766,46 @@ class UnknownSelectorTest : public CommunicatorTestFixture {
   }
 };
 
+class LostCounterpartTest : public CommunicatorTestFixture {
+ public:
+  LostCounterpartTest() = default;
+
+ private:
+  const uint64_t kSelector = 1234;
+
+  void ConfigureHost(RemoteProxyClientConfig *config) override {
+    config->EnableHealthChecking(/*interval=*/absl::Milliseconds(100),
+                                 /*timeout=*/absl::Milliseconds(500));
+  }
+
+  void SetTargetHandler(ServerHandlerMock *handler,
+                        Communicator *communicator) override {
+    EXPECT_CALL(*handler, Call(NotNull()))
+        .WillOnce([communicator](
+                      std::unique_ptr<Communicator::Invocation> invocation) {
+          // Go away without responding, leaving the host waiting.
+          communicator->Disconnect();
+        });
+  }
+
+  void RunAction(Communicator *communicator) override {
+    const absl::Time start = absl::Now();
+    communicator->Invoke(
+        kSelector,
+        [](Communicator::Invocation *invocation) {
+          // No input.
+        },
+        [](std::unique_ptr<Communicator::Invocation> invocation) {
+          EXPECT_THAT(invocation->status,
+                      StatusIs(error::GoogleError::UNAVAILABLE));
+        });
+    // The failed heartbeat ends the wait, rather than a response.
+    EXPECT_THAT(absl::Now() - start, Lt(absl::Seconds(10)));
+    EXPECT_TRUE(communicator->connection_lost());
+    EXPECT_FALSE(communicator->IsConnected());
+  }
+};
+
 class OpenCensusClientTest : public CommunicatorTestFixture {
  public:
   OpenCensusClientTest() = default;
@@ -742,8 +840,9 @@ class OpenCensusClientTest : public CommunicatorTestFixture {
 
   // Tests that metrics are actually collected. The validity of the collected
   // metrics are measured in the unit tests of OpenCensusClient. There are 14
-  // different data points collected by OpenCensusClient, so we wait until at
-  // least one measure of each datapoint is collected.
+  // different /proc/stat data points collected by OpenCensusClient, so we wait
+  // until at least one measure of each datapoint is collected. Views of
+  // Communicator metrics are exported alongside, and are not counted.
   void RunAction(Communicator *communicator) override {
     MutexGuarded<std::vector<std::pair<ViewDescriptor, ViewData>>> output_(
         std::vector<std::pair<ViewDescriptor, ViewData>>({}));
@@ -753,10 +852,19 @@ class OpenCensusClientTest : public CommunicatorTestFixture {
     // collected regularly based on the granularity we've set in the
     // OpenCensusClientConfig- but sent intermittently by the StatsExporter. So
     // we have to just wait for them to arrive.
-    while (output_.ReaderLock()->size() < 14) {
+    auto proc_stat_views = [&output_] {
+      size_t count = 0;
+      for (const auto &datum : *output_.ReaderLock()) {
+        if (absl::StrContains(datum.first.name(), "/proc/stat/")) {
+          ++count;
+        }
+      }
+      return count;
+    };
+    while (proc_stat_views() < 14) {
       absl::SleepFor(absl::Seconds(1));
     }
-    ASSERT_THAT(output_.ReaderLock()->size(), Eq(14));
+    ASSERT_THAT(proc_stat_views(), Eq(14));
   }
 };
 
@@ -770,7 +878,14 @@ void RegisterAllTests() {
   CommunicatorTestFixture::Register<MultithreadedInvokesAndCheckBackTest>();
   CommunicatorTestFixture::Register<MultithreadedWithThreadLocalStorageTest>();
   CommunicatorTestFixture::Register<DuplexNestedMultithreadedInvokesTest>();
+  CommunicatorTestFixture::Register<
+      DuplexNestedMultithreadedInvokesOverSharedMemoryTest>();
+  CommunicatorTestFixture::Register<
+      DuplexNestedMultithreadedInvokesCoalescedTest>();
+  CommunicatorTestFixture::Register<
+      DuplexNestedMultithreadedInvokesCompressedTest>();
   CommunicatorTestFixture::Register<UnknownSelectorTest>();
+  CommunicatorTestFixture::Register<LostCounterpartTest>();
   CommunicatorTestFixture::Register<OpenCensusClientTest>();
 }
 
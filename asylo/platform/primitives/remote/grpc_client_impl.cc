@@ -20,17 +20,26 @@
 
 #include <cstdint>
 #include <iterator>
+#include <memory>
 #include <string>
 #include <utility>
 
+#include "absl/flags/flag.h"
+#include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "asylo/util/logging.h"
 #include "asylo/platform/primitives/extent.h"
 #include "asylo/platform/primitives/remote/communicator.h"
 #include "asylo/platform/primitives/remote/grpc_service.grpc.pb.h"
 #include "asylo/platform/primitives/remote/grpc_service.pb.h"
+#include "asylo/platform/primitives/remote/message_compression.h"
 #include "asylo/platform/primitives/remote/metrics/clients/opencensus_client.h"
+#include "asylo/platform/primitives/remote/metrics/clients/opencensus_communicator_metrics.h"
+#include "asylo/platform/primitives/remote/shared_memory_transport.h"
 #include "asylo/platform/primitives/util/message.h"
 #include "asylo/util/posix_error_space.h"
 #include "asylo/util/remote/remote_proxy_config.h"
@@ -38,17 +47,27 @@
 #include "asylo/util/status_macros.h"
 #include "asylo/util/statusor.h"
 #include "asylo/util/thread.h"
+#include "include/grpc/grpc.h"
 #include "include/grpc/support/time.h"
 #include "include/grpcpp/support/status.h"
+#include "include/grpcpp/client_context.h"
 #include "include/grpcpp/create_channel.h"
 #include "include/grpcpp/security/credentials.h"
 #include "include/grpcpp/support/channel_arguments.h"
 
+ABSL_FLAG(bool, communicator_streaming, true,
+          "Send Communicator messages over a single long-lived streaming RPC "
+          "rather than a unary RPC per message");
+
 namespace asylo {
 namespace primitives {
 
 namespace {
 
+// Largest number of messages coalesced into one frame.
+constexpr int kMaxCoalescedMessages = 64;
+
+
 void SerializeIntoRequest(CommunicationMessage *request,
                           Communicator::Invocation *invocation) {
   Status{error::GoogleError::UNKNOWN, "Invocation request"}.SaveTo(
@@ -65,38 +84,51 @@ void SerializeIntoRequest(CommunicationMessage *request,
   });
 }
 
-void DeserializeFromReply(const CommunicationMessage &reply,
+void DeserializeFromReply(CommunicationMessage *reply,
                           Communicator::Invocation *invocation) {
-  if (reply.has_status()) {
-    invocation->status.RestoreFrom(reply.status());
+  if (reply->has_status()) {
+    invocation->status.RestoreFrom(reply->status());
     return;
   }
 
-  // Derialize results from response.
-  invocation->reader.Deserialize(reply.items_size(), [&reply](size_t i) {
-    const auto &item = reply.items(i);
-    return Extent{item.data(), item.size()};
-  });
+  // Deserialize results from response, taking over the received items.
+  Communicator::MoveItemsToReader(reply, &invocation->reader);
 }
 
 }  // namespace
 
+struct Communicator::ClientImpl::CoalescedFrame {
+  // Returns true once no more messages can be added to |frame|.
+  static bool IsFull(const CoalescedFrame *coalesced) {
+    return coalesced->frame.batch_size() >= kMaxCoalescedMessages;
+  }
+
+  CommunicationMessage frame;
+  bool sent = false;
+  Status status;
+};
+
 Status Communicator::ClientImpl::RunInvocation(
     Communicator::Invocation *invocation) {
   if (!communicator_->is_client_ready_.load()) {
     return Status{error::GoogleError::CANCELLED, "Disconnected"};
   }
+  if (communicator_->connection_lost()) {
+    return Status{error::GoogleError::UNAVAILABLE,
+                  "Connection to the counterpart lost"};
+  }
 
   // Prepare request sequence number to make certain response matches
   // the request.
   const auto request_sequence_number = GenerateSequenceNumber();
+  const absl::Time start = absl::Now();
 
   // Send request to the counterpart.
   {
     CommunicationMessage request;
     SerializeIntoRequest(&request, invocation);
     request.set_request_sequence_number(request_sequence_number);
-    ASYLO_RETURN_IF_ERROR(SendCommunication(request));
+    ASYLO_RETURN_IF_ERROR(SendCommunication(&request));
   }
 
   // Loop until response is received, in a mean time processing requests on the
@@ -104,6 +136,10 @@ Status Communicator::ClientImpl::RunInvocation(
   {
     CommunicationMessagePtr wrapped_message;
     ASYLO_ASSIGN_OR_RETURN(wrapped_message, communicator_->MessageLoop());
+    if (OpenCensusCommunicatorMetrics::enabled()) {
+      OpenCensusCommunicatorMetrics::RecordInvocationLatency(absl::Now() -
+                                                             start);
+    }
 
     // Verify sequence number match.
     if (wrapped_message->request_sequence_number() != request_sequence_number) {
@@ -112,24 +148,46 @@ Status Communicator::ClientImpl::RunInvocation(
     }
 
     // Response received, store it.
-    DeserializeFromReply(*wrapped_message, invocation);
+    DeserializeFromReply(wrapped_message.get(), invocation);
   }
 
   return invocation->status;
 }
 
-Communicator::ClientImpl::~ClientImpl() = default;
+Communicator::ClientImpl::~ClientImpl() { CloseStream(); }
+
 Communicator::ClientImpl::ClientImpl(Communicator *communicator)
-    : sequence_number_(0), communicator_(CHECK_NOTNULL(communicator)) {}
+    : stream_unavailable_(!absl::GetFlag(FLAGS_communicator_streaming)),
+      coalescing_window_(absl::ZeroDuration()),
+      sequence_number_(0),
+      communicator_(CHECK_NOTNULL(communicator)) {}
 
 StatusOr<std::unique_ptr<Communicator::ClientImpl>>
 Communicator::ClientImpl::Create(const RemoteProxyConfig &config,
                                  absl::string_view remote_address,
                                  Communicator *communicator) {
   std::unique_ptr<ClientImpl> client(new ClientImpl(communicator));
+  ::grpc::ChannelArguments channel_args = config.channel_args();
+  if (config.channel_compression() != GRPC_COMPRESS_NONE) {
+    channel_args.SetCompressionAlgorithm(config.channel_compression());
+  }
+  if (config.health_check_interval() > absl::ZeroDuration()) {
+    // Have the transport ping the counterpart even while no call is in flight,
+    // so that a dead connection fails the calls made on it promptly.
+    const int interval_ms = static_cast<int>(
+        absl::ToInt64Milliseconds(config.health_check_interval()));
+    channel_args.SetInt(GRPC_ARG_KEEPALIVE_TIME_MS, interval_ms);
+    channel_args.SetInt(
+        GRPC_ARG_KEEPALIVE_TIMEOUT_MS,
+        static_cast<int>(
+            absl::ToInt64Milliseconds(config.health_check_timeout())));
+    channel_args.SetInt(GRPC_ARG_KEEPALIVE_PERMIT_WITHOUT_CALLS, 1);
+    channel_args.SetInt(GRPC_ARG_HTTP2_MAX_PINGS_WITHOUT_DATA, 0);
+    channel_args.SetInt(GRPC_ARG_HTTP2_MIN_SENT_PING_INTERVAL_WITHOUT_DATA_MS,
+                        interval_ms);
+  }
   client->grpc_channel_ = ::grpc::CreateCustomChannel(
-      std::string(remote_address), config.channel_creds(),
-      config.channel_args());
+      std::string(remote_address), config.channel_creds(), channel_args);
   gpr_timespec absolute_deadline = gpr_time_add(
       gpr_now(GPR_CLOCK_REALTIME), gpr_time_from_seconds(10, GPR_TIMESPAN));
   if (!client->grpc_channel_->WaitForConnected(absolute_deadline)) {
@@ -137,6 +195,9 @@ Communicator::ClientImpl::Create(const RemoteProxyConfig &config,
   }
   client->grpc_stub_ =
       CommunicatorService::NewStub(client->grpc_channel_);
+  client->coalescing_window_ = config.message_coalescing_window();
+  client->payload_compression_threshold_ =
+      config.payload_compression_threshold();
 
   if (communicator->is_host()) {
     const RemoteProxyClientConfig &client_config =
@@ -153,12 +214,124 @@ Communicator::ClientImpl::Create(const RemoteProxyConfig &config,
 }
 
 Status Communicator::ClientImpl::SendCommunication(
-    const CommunicationMessage &message) {
-  ASYLO_RETURN_IF_ERROR(IsMessageValid(message));
-  CommunicationConfirmation confirmation;
+    CommunicationMessage *message) {
+  ASYLO_RETURN_IF_ERROR(IsMessageValid(*message));
+  // Compression only pays off on the network, not over shared memory.
+  if (payload_compression_threshold_.has_value() &&
+      communicator_->active_shared_memory_.load() == nullptr) {
+    CompressItems(*payload_compression_threshold_, message);
+  }
+  if (OpenCensusCommunicatorMetrics::enabled()) {
+    OpenCensusCommunicatorMetrics::RecordMessage(
+        OpenCensusCommunicatorMetrics::Direction::kSent,
+        message->ByteSizeLong());
+  }
+  if (coalescing_window_ > absl::ZeroDuration()) {
+    return SendCoalesced(message);
+  }
+  return SendFrame(message);
+}
+
+Status Communicator::ClientImpl::SendCoalesced(CommunicationMessage *message) {
+  std::shared_ptr<CoalescedFrame> coalesced;
+  {
+    absl::MutexLock lock(&coalesce_mu_);
+    const bool opened = !open_frame_;
+    if (opened) {
+      open_frame_ = std::make_shared<CoalescedFrame>();
+    }
+    coalesced = open_frame_;
+    coalesced->frame.add_batch()->Swap(message);
+    if (!opened) {
+      // The thread that opened the frame sends it.
+      coalesce_mu_.Await(absl::Condition(&coalesced->sent));
+      return coalesced->status;
+    }
+    coalesce_mu_.AwaitWithTimeout(
+        absl::Condition(&CoalescedFrame::IsFull, coalesced.get()),
+        coalescing_window_);
+    // From now on, the frame is only accessed by this thread until it is sent.
+    open_frame_.reset();
+  }
+
+  // A message that nobody joined is sent as is, rather than as a batch of one.
+  const Status status =
+      coalesced->frame.batch_size() == 1
+          ? SendFrame(coalesced->frame.mutable_batch(0))
+          : SendFrame(&coalesced->frame);
+
+  absl::MutexLock lock(&coalesce_mu_);
+  coalesced->status = status;
+  coalesced->sent = true;
+  return status;
+}
+
+Status Communicator::ClientImpl::SendFrame(CommunicationMessage *frame) {
+  // Stream calls carry no confirmation per message, so the host time travels
+  // with the message itself.
   if (communicator_->is_host()) {
-    confirmation.set_host_time_nanos(absl::GetCurrentTimeNanos());
+    frame->set_host_time_nanos(absl::GetCurrentTimeNanos());
+  }
+  // Every thread waits for the response to its message before it sends
+  // another, so messages too large for shared memory can take the gRPC path
+  // without being reordered.
+  SharedMemoryTransport *const shared_memory =
+      communicator_->active_shared_memory_.load();
+  if (shared_memory != nullptr &&
+      shared_memory->Send(frame->SerializeAsString()).ok()) {
+    return Status::OkStatus();
+  }
+  if (WriteToStream(*frame)) {
+    return Status::OkStatus();
+  }
+  return SendUnaryCommunication(*frame);
+}
+
+bool Communicator::ClientImpl::WriteToStream(
+    const CommunicationMessage &message) {
+  absl::MutexLock lock(&stream_mu_);
+  if (stream_unavailable_) {
+    return false;
+  }
+  if (!stream_writer_) {
+    // No deadline: the call lasts as long as the connection.
+    stream_context_ = absl::make_unique<::grpc::ClientContext>();
+    stream_writer_ = grpc_stub_->CommunicateStream(stream_context_.get(),
+                                                   &stream_confirmation_);
+  }
+  if (stream_writer_->Write(message)) {
+    return true;
+  }
+
+  // The call is broken. Collect its status and let the next message open a new
+  // one, unless the counterpart does not support streaming at all.
+  const ::grpc::Status grpc_status = stream_writer_->Finish();
+  stream_writer_.reset();
+  stream_context_.reset();
+  if (grpc_status.error_code() == ::grpc::StatusCode::UNIMPLEMENTED) {
+    stream_unavailable_ = true;
+  }
+  LOG(WARNING) << "CommunicateStream failed, falling back to Communicate: "
+               << Status(grpc_status);
+  return false;
+}
+
+void Communicator::ClientImpl::CloseStream() {
+  absl::MutexLock lock(&stream_mu_);
+  if (!stream_writer_) {
+    return;
   }
+  stream_writer_->WritesDone();
+  const ::grpc::Status grpc_status = stream_writer_->Finish();
+  LOG_IF(WARNING, !grpc_status.ok())
+      << "CommunicateStream finished with error=" << Status(grpc_status);
+  stream_writer_.reset();
+  stream_context_.reset();
+}
+
+Status Communicator::ClientImpl::SendUnaryCommunication(
+    const CommunicationMessage &message) {
+  CommunicationConfirmation confirmation;
   ::grpc::ClientContext context;
   gpr_timespec absolute_deadline = gpr_time_add(
       gpr_now(GPR_CLOCK_REALTIME), gpr_time_from_seconds(5, GPR_TIMESPAN));
@@ -178,6 +351,7 @@ Status Communicator::ClientImpl::SendCommunication(
 }
 
 void Communicator::ClientImpl::SendDisconnect() {
+  CloseStream();
   DisconnectRequest request;
   DisconnectReply reply;
   ::grpc::ClientContext context;
@@ -203,6 +377,42 @@ void Communicator::ClientImpl::SendEndPointAddress(absl::string_view address) {
   }
 }
 
+StatusOr<bool> Communicator::ClientImpl::SendSharedMemoryOffer(
+    absl::string_view name, absl::string_view nonce) {
+  SharedMemoryOffer request;
+  request.set_name(name.data(), name.size());
+  request.set_nonce(nonce.data(), nonce.size());
+  SharedMemoryAnswer reply;
+  ::grpc::ClientContext context;
+  gpr_timespec absolute_deadline = gpr_time_add(
+      gpr_now(GPR_CLOCK_REALTIME), gpr_time_from_seconds(5, GPR_TIMESPAN));
+  context.set_deadline(absolute_deadline);
+  const auto grpc_status =
+      grpc_stub_->OfferSharedMemory(&context, request, &reply);
+  if (!grpc_status.ok()) {
+    return Status(grpc_status);
+  }
+  return reply.accepted();
+}
+
+Status Communicator::ClientImpl::SendHeartbeat(absl::Duration timeout) {
+  HeartbeatRequest request;
+  if (communicator_->is_host()) {
+    request.set_host_time_nanos(absl::GetCurrentTimeNanos());
+  }
+  HeartbeatReply reply;
+  ::grpc::ClientContext context;
+  gpr_timespec absolute_deadline = gpr_time_add(
+      gpr_now(GPR_CLOCK_REALTIME),
+      gpr_time_from_millis(absl::ToInt64Milliseconds(timeout), GPR_TIMESPAN));
+  context.set_deadline(absolute_deadline);
+  const auto grpc_status = grpc_stub_->Heartbeat(&context, request, &reply);
+  if (!grpc_status.ok()) {
+    return Status(grpc_status);
+  }
+  return Status::OkStatus();
+}
+
 void Communicator::ClientImpl::SendDisposeOfThread(
     Thread::Id exiting_thread_id) {
   DisposeOfThreadRequest request;
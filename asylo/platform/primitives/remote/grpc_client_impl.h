@@ -20,10 +20,15 @@
 #define ASYLO_PLATFORM_PRIMITIVES_REMOTE_GRPC_CLIENT_IMPL_H_
 
 #include <atomic>
+#include <cstddef>
 #include <cstdint>
 #include <memory>
 
+#include "absl/base/thread_annotations.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "absl/types/optional.h"
 #include "asylo/platform/primitives/remote/communicator.h"
 #include "asylo/platform/primitives/remote/grpc_service.grpc.pb.h"
 #include "asylo/platform/primitives/remote/grpc_service.pb.h"
@@ -34,6 +39,8 @@
 #include "asylo/util/statusor.h"
 #include "asylo/util/thread.h"
 #include "include/grpcpp/channel.h"
+#include "include/grpcpp/client_context.h"
+#include "include/grpcpp/impl/codegen/sync_stream.h"
 #include "include/grpcpp/security/credentials.h"
 #include "include/grpcpp/support/channel_arguments.h"
 
@@ -54,11 +61,17 @@ class Communicator::ClientImpl {
       Communicator *const communicator);
 
   // Sends CommuncationMessage (request or response) to the counterpart
-  // Communicator.
-  Status SendCommunication(const CommunicationMessage &message);
+  // Communicator. Messages are written to a single CommunicateStream call
+  // shared by all threads, falling back to a unary Communicate call if the
+  // stream cannot be used. On host, |message| is stamped with the host time.
+  // If message coalescing is enabled, the contents of |message| are moved into
+  // a frame shared with other threads, and the call returns once that frame
+  // has been sent.
+  Status SendCommunication(CommunicationMessage *message);
 
   // Sends disconnect request to the Communicator counterpart, triggering it to
-  // shut down.
+  // shut down. Closes the message stream first, so that every message written
+  // to it is delivered before the disconnect request.
   void SendDisconnect();
 
   // Sends end point address to the counterpart. Not mandatory, expected to be
@@ -71,6 +84,15 @@ class Communicator::ClientImpl {
   // make Invoke calls).
   void SendDisposeOfThread(Thread::Id exiting_thread_id);
 
+  // Offers the shared memory segment |name| holding |nonce| to the target
+  // side. Returns whether the target has accepted it.
+  StatusOr<bool> SendSharedMemoryOffer(absl::string_view name,
+                                       absl::string_view nonce);
+
+  // Sends a heartbeat to the counterpart, carrying the host time if sent by
+  // the host. Fails if the counterpart does not answer within |timeout|.
+  Status SendHeartbeat(absl::Duration timeout);
+
   // Runs Invocation
   Status RunInvocation(Communicator::Invocation *invocation);
 
@@ -78,14 +100,65 @@ class Communicator::ClientImpl {
   // Constructor, used by factory method only.
   explicit ClientImpl(Communicator *communicator);
 
+  // Messages coalesced into one frame, and the outcome of sending it.
+  struct CoalescedFrame;
+
   // Generates atomically increasing monotonic sequence number
   // for request-response match verification.
   uint64_t GenerateSequenceNumber();
 
+  // Adds |message| to the frame being coalesced, opening a new frame if there
+  // is none. The thread that opens a frame holds it open for the coalescing
+  // window, or until it is full, and then sends it on behalf of every thread
+  // that has added a message to it.
+  Status SendCoalesced(CommunicationMessage *message)
+      ABSL_LOCKS_EXCLUDED(coalesce_mu_);
+
+  // Sends |frame| over the best transport available.
+  Status SendFrame(CommunicationMessage *frame);
+
+  // Writes |message| to the CommunicateStream call, opening the call if it is
+  // not open yet. Returns false if the message was not written and has to be
+  // sent with a unary call instead.
+  bool WriteToStream(const CommunicationMessage &message)
+      ABSL_LOCKS_EXCLUDED(stream_mu_);
+
+  // Half-closes the CommunicateStream call, if it is open, and waits for the
+  // counterpart to finish it.
+  void CloseStream() ABSL_LOCKS_EXCLUDED(stream_mu_);
+
+  // Sends |message| with a unary Communicate call.
+  Status SendUnaryCommunication(const CommunicationMessage &message);
+
   // gRPC client stub used for writing messages over gRPC.
   std::shared_ptr<::grpc::Channel> grpc_channel_;
   std::unique_ptr<CommunicatorService::Stub> grpc_stub_;
 
+  // Long-lived CommunicateStream call, opened by the first message sent.
+  // Writes from all threads are serialized by |stream_mu_|. The writer is
+  // declared after its context, so that it is destroyed first.
+  absl::Mutex stream_mu_;
+  std::unique_ptr<::grpc::ClientContext> stream_context_
+      ABSL_GUARDED_BY(stream_mu_);
+  CommunicationConfirmation stream_confirmation_ ABSL_GUARDED_BY(stream_mu_);
+  std::unique_ptr<::grpc::ClientWriter<CommunicationMessage>> stream_writer_
+      ABSL_GUARDED_BY(stream_mu_);
+
+  // Set once the counterpart turns out not to implement CommunicateStream, or
+  // if streaming is disabled by --communicator_streaming.
+  bool stream_unavailable_ ABSL_GUARDED_BY(stream_mu_);
+
+  // How long a frame is held open to coalesce messages into it. Zero disables
+  // coalescing.
+  absl::Duration coalescing_window_;
+
+  // Smallest message payload to compress, if payloads are compressed at all.
+  absl::optional<size_t> payload_compression_threshold_;
+
+  // Frame messages are currently coalesced into, if any.
+  absl::Mutex coalesce_mu_;
+  std::shared_ptr<CoalescedFrame> open_frame_ ABSL_GUARDED_BY(coalesce_mu_);
+
   // SequenceNumber generation.
   std::atomic<uint64_t> sequence_number_;
 
@@ -22,9 +22,11 @@
 #include <cstdint>
 #include <ctime>
 #include <iterator>
+#include <memory>
 #include <string>
 
 #include "absl/flags/flag.h"
+#include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "absl/synchronization/notification.h"
@@ -39,11 +41,13 @@
 #include "asylo/util/status_macros.h"
 #include "asylo/util/statusor.h"
 #include "asylo/util/thread.h"
+#include "include/grpc/grpc.h"
 #include "include/grpc/impl/codegen/gpr_types.h"
 #include "include/grpc/support/time.h"
 #include "include/grpcpp/impl/codegen/completion_queue.h"
 #include "include/grpcpp/support/status.h"
 #include "include/grpcpp/create_channel.h"
+#include "include/grpcpp/impl/codegen/async_stream.h"
 #include "include/grpcpp/impl/codegen/async_unary_call.h"
 #include "include/grpcpp/impl/codegen/server_context.h"
 #include "include/grpcpp/security/server_credentials.h"
@@ -63,8 +67,8 @@ namespace {
 class ServerInvocation : public Communicator::Invocation {
  public:
   ServerInvocation(
-      const CommunicationMessage &request,
-      std::function<void(const CommunicationMessage &response)> send_response)
+      CommunicationMessage *request,
+      std::function<void(CommunicationMessage *response)> send_response)
       : send_response_(CHECK_NOTNULL(std::move(send_response))) {
     DeserializeFromRequest(request);
   }
@@ -80,18 +84,16 @@ class ServerInvocation : public Communicator::Invocation {
     }
     SerializeIntoResponse(&response);
     // Send response back.
-    send_response_(response);
+    send_response_(&response);
   }
 
  private:
-  void DeserializeFromRequest(const CommunicationMessage &request) {
-    request_sequence_number_ = request.request_sequence_number();
-    selector = request.selector();
-    invocation_thread_id = request.invocation_thread_id();
-    reader.Deserialize(request.items_size(), [&request](size_t i) {
-      auto const &item = request.items(i);
-      return Extent{item.data(), item.size()};
-    });
+  void DeserializeFromRequest(CommunicationMessage *request) {
+    request_sequence_number_ = request->request_sequence_number();
+    selector = request->selector();
+    invocation_thread_id = request->invocation_thread_id();
+    // Take over the received items rather than copying them.
+    Communicator::MoveItemsToReader(request, &reader);
   }
 
   void SerializeIntoResponse(CommunicationMessage *response) const {
@@ -113,8 +115,7 @@ class ServerInvocation : public Communicator::Invocation {
   }
 
   uint64_t request_sequence_number_;
-  const std::function<void(const CommunicationMessage &response)>
-      send_response_;
+  const std::function<void(CommunicationMessage *response)> send_response_;
 };
 
 }  // namespace
@@ -122,7 +123,7 @@ class ServerInvocation : public Communicator::Invocation {
 void Communicator::ServiceImpl::StartInvocation(
     CommunicationMessagePtr wrapped_message) {
   auto invocation = absl::make_unique<ServerInvocation>(
-      *wrapped_message, [this](const CommunicationMessage &response) {
+      wrapped_message.get(), [this](CommunicationMessage *response) {
         const Status send_status = communicator_->SendCommunication(response);
         LOG_IF(ERROR, !send_status.ok())
             << "Failed to send response, status=" << send_status;
@@ -158,7 +159,7 @@ class Communicator::ServiceImpl::RpcInstance {
     RespondRpc();
   }
 
-  void ProcessRpc(bool ok) {
+  virtual void ProcessRpc(bool ok) {
     if (!ok || completed_) {
       // Once failed or completed, deallocate ourselves (RpcInstance).
       delete this;
@@ -249,6 +250,83 @@ class Communicator::ServiceImpl::CommunicationRpcInstance
   ::grpc::ServerAsyncResponseWriter<CommunicationConfirmation> responder_;
 };
 
+class Communicator::ServiceImpl::CommunicationStreamRpcInstance
+    : public Communicator::ServiceImpl::RpcInstance {
+ public:
+  // Take in the "service" instance (in this case representing an asynchronous
+  // server) and the "completion_queue" used for asynchronous communication
+  // with the gRPC runtime.
+  explicit CommunicationStreamRpcInstance(Communicator::ServiceImpl *service)
+      : Communicator::ServiceImpl::RpcInstance(service), reader_(context()) {
+    // Request that the system start processing CommunicateStream calls, using
+    // the memory address of this instance as the tag for every event of the
+    // call: its start, each frame read, and its finish.
+    service->RequestCommunicateStream(context(), &reader_, completion_queue(),
+                                      completion_queue(), this);
+  }
+
+  ~CommunicationStreamRpcInstance() override {
+    service()->open_streams_.Lock()->erase(context());
+  }
+
+ private:
+  void ProcessRpc(bool ok) override {
+    if (!ok && reading_) {
+      // The client has closed the stream, or the call has been cancelled.
+      reading_ = false;
+      Complete();
+      return;
+    }
+    RpcInstance::ProcessRpc(ok);
+  }
+
+  void RespondRpc() override {
+    if (service()->communicator_->is_host()) {
+      confirmation_.set_host_time_nanos(absl::GetCurrentTimeNanos());
+    }
+    reader_.Finish(confirmation_, ::grpc::Status::OK, this);
+  }
+
+  void ExecuteRpc() override {
+    if (!reading_) {
+      // The call has just started. Spawn a new instance to serve the next
+      // stream, which deallocates itself once completed.
+      new CommunicationStreamRpcInstance(service());
+      service()->open_streams_.Lock()->insert(context());
+      reading_ = true;
+    } else {
+      // A frame has been read. Unlike unary calls, the stream does not wait
+      // for the frame to be consumed, so the frame owns its message.
+      if (!service()->communicator_->is_host() &&
+          message_->has_host_time_nanos()) {
+        service()->communicator_->set_host_time_nanos(
+            message_->host_time_nanos());
+      }
+      CommunicationMessage *const message = message_.release();
+      service()->communicator_->QueueMessageForThread(CommunicationMessagePtr(
+          message, WrappedMessageDeleter([message] { delete message; })));
+    }
+
+    // Wait for the next frame.
+    message_ = absl::make_unique<CommunicationMessage>();
+    reader_.Read(message_.get(), this);
+  }
+
+  // True between the start of the call and the end of its input.
+  bool reading_ = false;
+
+  // The frame being read from the client.
+  std::unique_ptr<CommunicationMessage> message_;
+
+  // What we send back to the client once the stream ends.
+  CommunicationConfirmation confirmation_;
+
+  // The means to get back to the client (must always be the last: destruct
+  // it before message_ and confirmation_).
+  ::grpc::ServerAsyncReader<CommunicationConfirmation, CommunicationMessage>
+      reader_;
+};
+
 class Communicator::ServiceImpl::DisconnectRpcInstance
     : public Communicator::ServiceImpl::RpcInstance {
  public:
@@ -395,6 +473,102 @@ class Communicator::ServiceImpl::EndPointAddressRpcInstance
   ::grpc::ServerAsyncResponseWriter<EndPointAddressReply> responder_;
 };
 
+class Communicator::ServiceImpl::OfferSharedMemoryRpcInstance
+    : public Communicator::ServiceImpl::RpcInstance {
+ public:
+  // Take in the "service" instance (in this case representing an asynchronous
+  // server) and the "completion_queue" used for asynchronous communication
+  // with the gRPC runtime.
+  explicit OfferSharedMemoryRpcInstance(Communicator::ServiceImpl *service)
+      : Communicator::ServiceImpl::RpcInstance(service), responder_(context()) {
+    // Request that the system start processing OfferSharedMemory requests,
+    // using the memory address of this instance as the tag.
+    service->RequestOfferSharedMemory(context(), &request_, &responder_,
+                                      completion_queue(), completion_queue(),
+                                      this);
+  }
+
+ private:
+  void RespondRpc() override {
+    // And we are done! Let the gRPC runtime know we've finished, using the
+    // memory address of this instance as the uniquely identifying tag for
+    // the event.
+    responder_.Finish(answer_, ::grpc::Status::OK, this);
+  }
+
+  void ExecuteRpc() override {
+    // Spawn a new OfferSharedMemoryRpcInstance instance to serve new clients
+    // while we process the one for this OfferSharedMemoryRpcInstance. The
+    // instance will deallocate itself once completed.
+    new OfferSharedMemoryRpcInstance(service());
+
+    // Declining is not an error: the host keeps using gRPC.
+    const Status status = service()->communicator_->AcceptSharedMemory(
+        request_.name(), request_.nonce());
+    LOG_IF(INFO, !status.ok())
+        << "Declining shared memory transport: " << status;
+    answer_.set_accepted(status.ok());
+    Complete();
+  }
+
+  // What we get from the client.
+  SharedMemoryOffer request_;
+
+  // What we send back to the client.
+  SharedMemoryAnswer answer_;
+
+  // The means to get back to the client (must always be the last: destruct
+  // it before request_ and answer_).
+  ::grpc::ServerAsyncResponseWriter<SharedMemoryAnswer> responder_;
+};
+
+class Communicator::ServiceImpl::HeartbeatRpcInstance
+    : public Communicator::ServiceImpl::RpcInstance {
+ public:
+  // Take in the "service" instance (in this case representing an asynchronous
+  // server) and the "completion_queue" used for asynchronous communication
+  // with the gRPC runtime.
+  explicit HeartbeatRpcInstance(Communicator::ServiceImpl *service)
+      : Communicator::ServiceImpl::RpcInstance(service), responder_(context()) {
+    // Request that the system start processing Heartbeat requests, using the
+    // memory address of this instance as the tag.
+    service->RequestHeartbeat(context(), &request_, &responder_,
+                              completion_queue(), completion_queue(), this);
+  }
+
+ private:
+  void RespondRpc() override {
+    // And we are done! Let the gRPC runtime know we've finished, using the
+    // memory address of this instance as the uniquely identifying tag for
+    // the event.
+    responder_.Finish(reply_, ::grpc::Status::OK, this);
+  }
+
+  void ExecuteRpc() override {
+    // Spawn a new HeartbeatRpcInstance instance to serve new clients while we
+    // process the one for this HeartbeatRpcInstance. The instance will
+    // deallocate itself once completed.
+    new HeartbeatRpcInstance(service());
+
+    // Heartbeats keep the host time fresh on an otherwise idle connection.
+    Communicator *const communicator = service()->communicator_;
+    if (!communicator->is_host() && request_.has_host_time_nanos()) {
+      communicator->set_host_time_nanos(request_.host_time_nanos());
+    }
+    Complete();
+  }
+
+  // What we get from the client.
+  HeartbeatRequest request_;
+
+  // What we send back to the client.
+  HeartbeatReply reply_;
+
+  // The means to get back to the client (must always be the last: destruct
+  // it before request_ and reply_).
+  ::grpc::ServerAsyncResponseWriter<HeartbeatReply> responder_;
+};
+
 StatusOr<std::unique_ptr<Communicator::ServiceImpl>>
 Communicator::ServiceImpl::Create(
     int requested_port, const std::shared_ptr<::grpc::ServerCredentials> &creds,
@@ -407,6 +581,10 @@ Communicator::ServiceImpl::Create(
         absl::make_unique<ProcSystemServiceImpl>(getpid());
     builder.RegisterService(service->proc_system_service_.get());
   }
+  // Accept keepalive pings from a counterpart with health checking enabled,
+  // however often it sends them.
+  builder.AddChannelArgument(GRPC_ARG_KEEPALIVE_PERMIT_WITHOUT_CALLS, 1);
+  builder.AddChannelArgument(GRPC_ARG_HTTP2_MAX_PING_STRIKES, 0);
   builder.AddListeningPort(absl::StrCat("[::]:", requested_port), creds,
                            &service->server_port_);
   service->completion_queue_ = builder.AddCompletionQueue();
@@ -429,9 +607,12 @@ Communicator::ServiceImpl::Create(
 void Communicator::ServiceImpl::ServerRpcLoop() {
   // Spawn new RpcInstances for all possible RPCs to serve new clients.
   new CommunicationRpcInstance(this);
+  new CommunicationStreamRpcInstance(this);
   new DisconnectRpcInstance(this);
   new DisposeOfThreadRpcInstance(this);
   new EndPointAddressRpcInstance(this);
+  new HeartbeatRpcInstance(this);
+  new OfferSharedMemoryRpcInstance(this);
 
   void *tag;  // uniquely identifies a request.
   bool ok;
@@ -496,6 +677,11 @@ std::string Communicator::ServiceImpl::WaitForEndPointAddress() {
 }
 
 void Communicator::ServiceImpl::WaitForDisconnect() {
+  // Shutdown() waits for every call in progress, and the counterpart does not
+  // necessarily close its stream before disconnecting.
+  for (::grpc::ServerContext *context : *open_streams_.Lock()) {
+    context->TryCancel();
+  }
   if (server_) {
     server_->Shutdown();
   }
@@ -25,18 +25,21 @@
 #include <string>
 #include <utility>
 
+#include "absl/container/flat_hash_set.h"
 #include "absl/strings/string_view.h"
 #include "asylo/util/logging.h"
 #include "asylo/platform/primitives/remote/communicator.h"
 #include "asylo/platform/primitives/remote/grpc_service.grpc.pb.h"
 #include "asylo/platform/primitives/remote/metrics/proc_system_service.h"
 #include "asylo/util/asylo_macros.h"
+#include "asylo/util/mutex_guarded.h"
 #include "asylo/util/status.h"
 #include "asylo/util/statusor.h"
 #include "asylo/util/thread.h"
 #include "include/grpcpp/impl/codegen/completion_queue.h"
 #include "include/grpcpp/security/server_credentials.h"
 #include "include/grpcpp/server.h"
+#include "include/grpcpp/server_context.h"
 
 namespace asylo {
 namespace primitives {
@@ -60,8 +63,9 @@ class Communicator::ServiceImpl
   void ServerRpcLoop();
 
   // Shuts down server and completion queue, joins ServerRpcLoop thread (thus
-  // waiting for ServerRpcLoop to terminate). When WaitForDisconnect returns,
-  // it is safe to destruct ServiceImpl instance.
+  // waiting for ServerRpcLoop to terminate). Open CommunicateStream calls are
+  // cancelled, since the counterpart may keep them open indefinitely. When
+  // WaitForDisconnect returns, it is safe to destruct ServiceImpl instance.
   void WaitForDisconnect();
 
   // Waits for end point address to be received from the counterpart calling
@@ -86,15 +90,19 @@ class Communicator::ServiceImpl
 
   // Classes for all supported RPC calls.
   class CommunicationRpcInstance;
+  class CommunicationStreamRpcInstance;
   class DisconnectRpcInstance;
   class DisposeOfThreadRpcInstance;
   class EndPointAddressRpcInstance;
+  class HeartbeatRpcInstance;
+  class OfferSharedMemoryRpcInstance;
 
   // Constructor is called by Create() factory only.
   explicit ServiceImpl(Communicator *communicator)
       : end_point_address_callback_(absl::optional<address_callback>()),
         communicator_(CHECK_NOTNULL(communicator)),
-        address_state_(absl::optional<std::string>()) {}
+        address_state_(absl::optional<std::string>()),
+        open_streams_(absl::flat_hash_set<::grpc::ServerContext *>()) {}
 
   void RecordEndPointAddress(absl::string_view address);
 
@@ -117,6 +125,9 @@ class Communicator::ServiceImpl
   Communicator *const communicator_;
 
   MutexGuarded<absl::optional<std::string>> address_state_;
+
+  // Contexts of the CommunicateStream calls currently open.
+  MutexGuarded<absl::flat_hash_set<::grpc::ServerContext *>> open_streams_;
 };
 
 }  // namespace primitives
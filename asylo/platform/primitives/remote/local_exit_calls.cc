@@ -103,6 +103,20 @@ class SysFutexWakeExitCallHandler
   }
 };
 
+class SysFutexWakeBatchExitCallHandler
+    : public LocalExitCallForwarder::LocalExitCallHandler {
+ public:
+  explicit SysFutexWakeBatchExitCallHandler(LocalExitCallForwarder *forwarder)
+      : LocalExitCallForwarder::LocalExitCallHandler(
+            host_call::kSysFutexWakeBatchHandler, forwarder) {}
+
+  absl::optional<Status> AttemptExecute(MessageReader *input,
+                                        MessageWriter *output) override {
+    // Process batched futex_wake selector locally.
+    return host_call::SysFutexWakeBatchHelper(input, output);
+  }
+};
+
 }  // namespace
 
 Status LocalExitCallForwarder::PerformUnknownExit(uint64_t untrusted_selector,
@@ -151,6 +165,10 @@ LocalExitCallForwarder::Create(bool exit_logging,
       absl::make_unique<SysFutexWakeExitCallHandler>(
           exit_call_forwarder.get()));
 
+  exit_call_forwarder->handlers_.emplace_back(
+      absl::make_unique<SysFutexWakeBatchExitCallHandler>(
+          exit_call_forwarder.get()));
+
   // Register all exit call handlers.
   for (const auto &handler : exit_call_forwarder->handlers_) {
     ASYLO_RETURN_IF_ERROR(handler->Register());
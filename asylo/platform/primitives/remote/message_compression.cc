@@ -0,0 +1,109 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/primitives/remote/message_compression.h"
+
+#include <zlib.h>
+
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include "absl/strings/str_cat.h"
+#include "asylo/platform/primitives/remote/grpc_service.pb.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+namespace primitives {
+namespace {
+
+// Largest size of items accepted for decompression, which bounds the memory a
+// malformed message can make the receiver allocate.
+constexpr uint64_t kMaxUncompressedItemsSize = uint64_t{1} << 30;
+
+}  // namespace
+
+bool CompressItems(size_t threshold, CommunicationMessage *message) {
+  size_t items_size = 0;
+  for (const std::string &item : message->items()) {
+    items_size += item.size();
+  }
+  if (items_size == 0 || items_size < threshold) {
+    return false;
+  }
+
+  CommunicationItems items;
+  items.mutable_items()->Swap(message->mutable_items());
+  const std::string serialized = items.SerializeAsString();
+  uLongf compressed_size = compressBound(serialized.size());
+  std::string compressed(compressed_size, '\0');
+  if (compress2(reinterpret_cast<Bytef *>(&compressed[0]), &compressed_size,
+                reinterpret_cast<const Bytef *>(serialized.data()),
+                serialized.size(), Z_BEST_SPEED) != Z_OK ||
+      compressed_size >= serialized.size()) {
+    // Not worth it, send the items as they are.
+    items.mutable_items()->Swap(message->mutable_items());
+    return false;
+  }
+  compressed.resize(compressed_size);
+  message->set_items_compression(PAYLOAD_COMPRESSION_ZLIB);
+  message->set_compressed_items(std::move(compressed));
+  message->set_uncompressed_items_size(serialized.size());
+  return true;
+}
+
+Status DecompressItems(CommunicationMessage *message) {
+  switch (message->items_compression()) {
+    case PAYLOAD_COMPRESSION_NONE:
+      return Status::OkStatus();
+    case PAYLOAD_COMPRESSION_ZLIB:
+      break;
+    default:
+      return Status(error::GoogleError::INVALID_ARGUMENT,
+                    "Message items have an unknown compression");
+  }
+  if (message->uncompressed_items_size() > kMaxUncompressedItemsSize) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Message items are too large");
+  }
+
+  uLongf serialized_size = message->uncompressed_items_size();
+  std::string serialized(serialized_size, '\0');
+  const std::string &compressed = message->compressed_items();
+  const int result =
+      uncompress(reinterpret_cast<Bytef *>(&serialized[0]), &serialized_size,
+                 reinterpret_cast<const Bytef *>(compressed.data()),
+                 compressed.size());
+  if (result != Z_OK || serialized_size != serialized.size()) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  absl::StrCat("Failed to decompress message items: ", result));
+  }
+  CommunicationItems items;
+  if (!items.ParseFromString(serialized)) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Failed to parse decompressed message items");
+  }
+  message->mutable_items()->Swap(items.mutable_items());
+  message->clear_items_compression();
+  message->clear_compressed_items();
+  message->clear_uncompressed_items_size();
+  return Status::OkStatus();
+}
+
+}  // namespace primitives
+}  // namespace asylo
@@ -0,0 +1,42 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_PRIMITIVES_REMOTE_MESSAGE_COMPRESSION_H_
+#define ASYLO_PLATFORM_PRIMITIVES_REMOTE_MESSAGE_COMPRESSION_H_
+
+#include <cstddef>
+
+#include "asylo/platform/primitives/remote/grpc_service.pb.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+namespace primitives {
+
+// Compresses the items of |message| with zlib, if they add up to at least
+// |threshold| bytes and actually shrink. Returns true if |message| now carries
+// its items in compressed form.
+bool CompressItems(size_t threshold, CommunicationMessage *message);
+
+// Restores the items of |message| if they were compressed by CompressItems().
+// Leaves other messages unchanged.
+Status DecompressItems(CommunicationMessage *message);
+
+}  // namespace primitives
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_PRIMITIVES_REMOTE_MESSAGE_COMPRESSION_H_
@@ -0,0 +1,98 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/primitives/remote/message_compression.h"
+
+#include <cstdint>
+#include <string>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "asylo/platform/primitives/remote/grpc_service.pb.h"
+#include "asylo/test/util/status_matchers.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+namespace primitives {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::IsEmpty;
+using ::testing::Lt;
+
+constexpr size_t kThreshold = 1024;
+
+CommunicationMessage MessageWithItems(const std::string &first,
+                                      const std::string &second) {
+  CommunicationMessage message;
+  message.add_items(first);
+  message.add_items(second);
+  return message;
+}
+
+TEST(MessageCompressionTest, RoundTripsLargeItems) {
+  const std::string first(4096, 'a');
+  const std::string second(2048, 'b');
+  CommunicationMessage message = MessageWithItems(first, second);
+
+  EXPECT_TRUE(CompressItems(kThreshold, &message));
+  EXPECT_THAT(message.items(), IsEmpty());
+  EXPECT_THAT(message.items_compression(), Eq(PAYLOAD_COMPRESSION_ZLIB));
+  EXPECT_THAT(message.compressed_items().size(), Lt(first.size()));
+
+  ASYLO_ASSERT_OK(DecompressItems(&message));
+  EXPECT_THAT(message.items(), ElementsAre(first, second));
+  EXPECT_FALSE(message.has_items_compression());
+  EXPECT_FALSE(message.has_compressed_items());
+}
+
+TEST(MessageCompressionTest, LeavesSmallItemsAlone) {
+  CommunicationMessage message = MessageWithItems("small", "items");
+  EXPECT_FALSE(CompressItems(kThreshold, &message));
+  EXPECT_THAT(message.items(), ElementsAre("small", "items"));
+
+  ASYLO_ASSERT_OK(DecompressItems(&message));
+  EXPECT_THAT(message.items(), ElementsAre("small", "items"));
+}
+
+TEST(MessageCompressionTest, LeavesIncompressibleItemsAlone) {
+  std::string noise(kThreshold, '\0');
+  uint32_t state = 1;
+  for (char &c : noise) {
+    state = state * 1103515245 + 12345;
+    c = static_cast<char>(state >> 24);
+  }
+  CommunicationMessage message = MessageWithItems(noise, "");
+  EXPECT_FALSE(CompressItems(kThreshold, &message));
+  EXPECT_THAT(message.items(), ElementsAre(noise, ""));
+}
+
+TEST(MessageCompressionTest, RejectsCorruptedItems) {
+  CommunicationMessage message =
+      MessageWithItems(std::string(4096, 'a'), std::string(4096, 'b'));
+  ASSERT_TRUE(CompressItems(kThreshold, &message));
+  message.mutable_compressed_items()->resize(
+      message.compressed_items().size() / 2);
+  EXPECT_THAT(DecompressItems(&message),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+}
+
+}  // namespace
+}  // namespace primitives
+}  // namespace asylo
@@ -0,0 +1,92 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/primitives/remote/metrics/clients/opencensus_attestation_timing_sink.h"
+
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "asylo/identity/attestation/attestation_timing.h"
+#include "asylo/util/path.h"
+#include "opencensus/stats/stats.h"
+#include "opencensus/tags/tag_key.h"
+
+namespace asylo {
+namespace primitives {
+
+using ::opencensus::stats::Aggregation;
+using ::opencensus::stats::BucketBoundaries;
+using ::opencensus::stats::MeasureDouble;
+using ::opencensus::stats::ViewDescriptor;
+using ::opencensus::tags::TagKey;
+
+constexpr char OpenCensusAttestationTimingSink::kLatencyMeasureName[];
+
+namespace {
+
+constexpr char kLatencyMeasureDescription[] =
+    "The time taken by one phase of assertion generation or verification.";
+
+}  // namespace
+
+OpenCensusAttestationTimingSink::OpenCensusAttestationTimingSink(
+    const OpenCensusClientConfig &config) {
+  LatencyMeasure();
+  // Buckets from 0.1ms to roughly 13s, which covers everything from a local
+  // EREPORT to a cold PCS fetch.
+  view_descriptor_ =
+      ViewDescriptor()
+          .set_name(
+              asylo::JoinPath(config.view_name_root, kLatencyMeasureName))
+          .set_description(kLatencyMeasureDescription)
+          .set_measure(kLatencyMeasureName)
+          .set_aggregation(Aggregation::Distribution(
+              BucketBoundaries::Exponential(/*num_finite_buckets=*/18,
+                                            /*initial_bound=*/0.1,
+                                            /*growth_factor=*/2)))
+          .add_column(AuthorityTypeKey())
+          .add_column(PhaseKey());
+  view_descriptor_.RegisterForExport();
+}
+
+void OpenCensusAttestationTimingSink::Record(absl::string_view authority_type,
+                                             AttestationPhase phase,
+                                             absl::Duration duration) {
+  ::opencensus::stats::Record(
+      {{LatencyMeasure(), absl::ToDoubleMilliseconds(duration)}},
+      {{AuthorityTypeKey(), authority_type},
+       {PhaseKey(), AttestationPhaseName(phase)}});
+}
+
+TagKey OpenCensusAttestationTimingSink::AuthorityTypeKey() {
+  static const auto key = TagKey::Register("authority_type");
+  return key;
+}
+
+TagKey OpenCensusAttestationTimingSink::PhaseKey() {
+  static const auto key = TagKey::Register("phase");
+  return key;
+}
+
+MeasureDouble OpenCensusAttestationTimingSink::LatencyMeasure() {
+  static const auto measure = MeasureDouble::Register(
+      kLatencyMeasureName, kLatencyMeasureDescription, "ms");
+  return measure;
+}
+
+}  // namespace primitives
+}  // namespace asylo
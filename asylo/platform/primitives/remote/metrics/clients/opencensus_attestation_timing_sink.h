@@ -0,0 +1,71 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_PRIMITIVES_REMOTE_METRICS_CLIENTS_OPENCENSUS_ATTESTATION_TIMING_SINK_H_
+#define ASYLO_PLATFORM_PRIMITIVES_REMOTE_METRICS_CLIENTS_OPENCENSUS_ATTESTATION_TIMING_SINK_H_
+
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "asylo/identity/attestation/attestation_timing.h"
+#include "asylo/platform/primitives/remote/metrics/clients/opencensus_client_config.h"
+#include "opencensus/stats/stats.h"
+#include "opencensus/tags/tag_key.h"
+
+namespace asylo {
+namespace primitives {
+
+// An AttestationTimingSink that records attestation phase latencies as an
+// OpenCensus distribution, tagged with the authority type and the phase. The
+// view is exported under |config.view_name_root|, so that it sits next to the
+// views of the OpenCensusClient that shares the same config.
+class OpenCensusAttestationTimingSink : public AttestationTimingSink {
+ public:
+  // Name of the latency measure, in milliseconds.
+  static constexpr char kLatencyMeasureName[] = "attestation/phase_latency";
+
+  explicit OpenCensusAttestationTimingSink(
+      const OpenCensusClientConfig &config);
+
+  OpenCensusAttestationTimingSink(
+      const OpenCensusAttestationTimingSink &other) = delete;
+  OpenCensusAttestationTimingSink &operator=(
+      const OpenCensusAttestationTimingSink &other) = delete;
+
+  // Returns the view aggregating latencies by authority type and phase.
+  const ::opencensus::stats::ViewDescriptor &view_descriptor() const {
+    return view_descriptor_;
+  }
+
+  // From AttestationTimingSink.
+  void Record(absl::string_view authority_type, AttestationPhase phase,
+              absl::Duration duration) override;
+
+  // Tag keys
+  static ::opencensus::tags::TagKey AuthorityTypeKey();
+  static ::opencensus::tags::TagKey PhaseKey();
+
+ private:
+  static ::opencensus::stats::MeasureDouble LatencyMeasure();
+
+  ::opencensus::stats::ViewDescriptor view_descriptor_;
+};
+
+}  // namespace primitives
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_PRIMITIVES_REMOTE_METRICS_CLIENTS_OPENCENSUS_ATTESTATION_TIMING_SINK_H_
@@ -0,0 +1,82 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/primitives/remote/metrics/clients/opencensus_attestation_timing_sink.h"
+
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/time/time.h"
+#include "asylo/identity/attestation/attestation_timing.h"
+#include "asylo/platform/primitives/remote/metrics/clients/opencensus_client_config.h"
+#include "opencensus/stats/stats.h"
+#include "opencensus/stats/testing/test_utils.h"
+
+namespace asylo {
+namespace primitives {
+namespace {
+
+using ::opencensus::stats::testing::TestUtils;
+using ::testing::Eq;
+using ::testing::SizeIs;
+
+TEST(OpenCensusAttestationTimingSinkTest, AggregatesByAuthorityAndPhase) {
+  OpenCensusClientConfig config;
+  config.view_name_root = "test_root";
+  OpenCensusAttestationTimingSink sink(config);
+  ::opencensus::stats::View view(sink.view_descriptor());
+
+  sink.Record("AuthorityA", AttestationPhase::kQeCall, absl::Milliseconds(3));
+  sink.Record("AuthorityA", AttestationPhase::kQeCall, absl::Milliseconds(5));
+  sink.Record("AuthorityA", AttestationPhase::kPcsFetch,
+              absl::Milliseconds(100));
+  sink.Record("AuthorityB", AttestationPhase::kEreport,
+              absl::Microseconds(50));
+  TestUtils::Flush();
+
+  const auto &data = view.GetData().distribution_data();
+  ASSERT_THAT(data, SizeIs(3));
+  EXPECT_THAT(data.at({"AuthorityA", "qe_call"}).count(), Eq(2));
+  EXPECT_THAT(data.at({"AuthorityA", "qe_call"}).mean(), Eq(4.0));
+  EXPECT_THAT(data.at({"AuthorityA", "pcs_fetch"}).count(), Eq(1));
+  EXPECT_THAT(data.at({"AuthorityB", "ereport"}).count(), Eq(1));
+}
+
+TEST(OpenCensusAttestationTimingSinkTest, ReceivesTimingsWhenInstalled) {
+  OpenCensusClientConfig config;
+  config.view_name_root = "installed_root";
+  OpenCensusAttestationTimingSink sink(config);
+  ::opencensus::stats::View view(sink.view_descriptor());
+
+  SetAttestationTimingSink(&sink);
+  {
+    ScopedAttestationTimer timer("AuthorityC", AttestationPhase::kAgeRpc);
+  }
+  SetAttestationTimingSink(nullptr);
+  TestUtils::Flush();
+
+  const auto &data = view.GetData().distribution_data();
+  ASSERT_THAT(data, SizeIs(1));
+  EXPECT_THAT(data.at({"AuthorityC", "age_rpc"}).count(), Eq(1));
+}
+
+}  // namespace
+}  // namespace primitives
+}  // namespace asylo
@@ -25,6 +25,7 @@
 #include "absl/synchronization/notification.h"
 #include "asylo/platform/primitives/remote/metrics/clients/opencensus_client_config.h"
 #include "asylo/platform/primitives/remote/metrics/clients/proc_system_service_client.h"
+#include "asylo/platform/primitives/util/trace_context.h"
 #include "asylo/util/path.h"
 #include "asylo/util/status_macros.h"
 #include "asylo/util/thread.h"
@@ -40,7 +41,12 @@ using ::opencensus::stats::Record;
 using ::opencensus::stats::ViewDescriptor;
 using ::opencensus::tags::TagKey;
 
-OpenCensusClient::~OpenCensusClient() { StopCensus(); }
+OpenCensusClient::~OpenCensusClient() {
+  StopCensus();
+  if (GetSpanSink() == &span_sink_) {
+    SetSpanSink(previous_span_sink_);
+  }
+}
 
 std::unique_ptr<OpenCensusClient> OpenCensusClient::Create(
     const std::shared_ptr<::grpc::Channel> &channel,
@@ -81,6 +87,9 @@ std::unique_ptr<OpenCensusClient> OpenCensusClient::Create(
   client->RegisterGuestTimeView();
   client->RegisterChildrenGuestTimeView();
 
+  // Export the spans of traced enclave calls and exit calls.
+  client->previous_span_sink_ = SetSpanSink(&client->span_sink_);
+
   // Start the census.
   client->StartCensus();
 
@@ -22,6 +22,8 @@
 #include "absl/strings/string_view.h"
 #include "absl/synchronization/notification.h"
 #include "asylo/platform/primitives/remote/metrics/clients/opencensus_client_config.h"
+#include "asylo/platform/primitives/remote/metrics/clients/opencensus_communicator_metrics.h"
+#include "asylo/platform/primitives/remote/metrics/clients/opencensus_span_sink.h"
 #include "asylo/platform/primitives/remote/metrics/clients/proc_system_service_client.h"
 #include "asylo/util/mutex_guarded.h"
 #include "asylo/util/thread.h"
@@ -54,7 +56,9 @@ class OpenCensusClient {
   explicit OpenCensusClient(const std::shared_ptr<::grpc::Channel> &channel,
                             const OpenCensusClientConfig &config)
       : proc_client_(absl::make_unique<ProcSystemServiceClient>(channel)),
-        config_(config) {}
+        config_(config),
+        communicator_metrics_(config),
+        span_sink_(config) {}
 
   // Methods responsible for starting and stopping the Census.
   ::asylo::Status StartCensus();
@@ -191,6 +195,16 @@ class OpenCensusClient {
 
   const OpenCensusClientConfig config_;
 
+  // Views of the traffic through Communicators, which record it for as long
+  // as this client exists.
+  OpenCensusCommunicatorMetrics communicator_metrics_;
+
+  // Aggregates the spans of traced enclave calls and exit calls. It is the
+  // installed SpanSink for as long as this client exists, and the previously
+  // installed sink is restored when the client is destroyed.
+  OpenCensusSpanSink span_sink_;
+  SpanSink *previous_span_sink_ = nullptr;
+
   // record_ is the on-off switch between the main thread and the
   // census_thread_.
   MutexGuarded<bool> record_ = MutexGuarded<bool>(false);
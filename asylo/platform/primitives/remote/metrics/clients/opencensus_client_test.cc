@@ -25,6 +25,7 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include "absl/memory/memory.h"
+#include "absl/strings/match.h"
 #include "absl/strings/str_cat.h"
 #include "asylo/platform/primitives/remote/metrics/clients/opencensus_client_config.h"
 #include "asylo/platform/primitives/remote/metrics/mocks/mock_proc_system_parser.h"
@@ -44,7 +45,6 @@ using ::opencensus::stats::ViewDescriptor;
 
 using ::testing::_;
 using ::testing::Eq;
-using ::testing::Return;
 using ::testing::Test;
 
 class MockExporter : public ::opencensus::stats::StatsExporter::Handler {
@@ -78,8 +78,8 @@ class OpenCensusClientTest : public ::testing::Test {
 
   void SetUp() override {
     auto mock_parser = absl::make_unique<MockProcSystemParser>();
-    EXPECT_CALL(*mock_parser, ReadProcStat(_))
-        .WillRepeatedly(Return(mock_parser->stat_contents()));
+    EXPECT_CALL(*mock_parser, ReadProcStat(_, _))
+        .WillRepeatedly(mock_parser->ReadStatContents());
     // Save raw pointer before std::move for the test to use.
     mock_parser_ = mock_parser.get();
     auto mock_server_request =
@@ -93,6 +93,18 @@ class OpenCensusClientTest : public ::testing::Test {
     MockExporter::Register(&output_);
   }
 
+  // Returns the exported data of /proc/stat views, leaving out the views of
+  // Communicator metrics that OpenCensusClient also registers.
+  std::vector<std::pair<ViewDescriptor, ViewData>> ProcStatOutput() {
+    std::vector<std::pair<ViewDescriptor, ViewData>> proc_stat_output;
+    for (const auto &datum : *output_.ReaderLock()) {
+      if (absl::StrContains(datum.first.name(), "/proc/stat/")) {
+        proc_stat_output.push_back(datum);
+      }
+    }
+    return proc_stat_output;
+  }
+
   MockProcSystemParser *mock_parser_;
   MutexGuarded<std::vector<std::pair<ViewDescriptor, ViewData>>> output_;
 
@@ -116,7 +128,7 @@ TEST_F(OpenCensusClientTest, SuccessfullyGetsMetrics) {
   auto opencensus_client =
       OpenCensusClient::Create(channel_request.ValueOrDie(), config);
 
-  while (output_.ReaderLock()->size() < 14) {
+  while (ProcStatOutput().size() < 14) {
     absl::SleepFor(absl::Seconds(1));
   }
 
@@ -156,9 +168,10 @@ TEST_F(OpenCensusClientTest, SuccessfullyGetsMetrics) {
       {{"OpenCensusClient::RecordChildrenGuestTime"},
        mock_parser_->kExpectedCguestTime});
 
-  ASSERT_THAT(output_.ReaderLock()->size(), Eq(14));
+  const auto proc_stat_output = ProcStatOutput();
+  ASSERT_THAT(proc_stat_output.size(), Eq(14));
   std::vector<std::pair<std::vector<std::string>, int64_t>> collected_metrics;
-  for (const auto &datum : *output_.ReaderLock()) {
+  for (const auto &datum : proc_stat_output) {
     for (const auto &data : datum.second.int_data()) {
       collected_metrics.push_back(data);
     }
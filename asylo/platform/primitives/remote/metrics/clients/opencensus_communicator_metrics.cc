@@ -0,0 +1,196 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/primitives/remote/metrics/clients/opencensus_communicator_metrics.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "asylo/platform/primitives/remote/metrics/clients/opencensus_client_config.h"
+#include "asylo/util/path.h"
+#include "opencensus/stats/stats.h"
+#include "opencensus/tags/tag_key.h"
+
+namespace asylo {
+namespace primitives {
+
+using ::opencensus::stats::Aggregation;
+using ::opencensus::stats::BucketBoundaries;
+using ::opencensus::stats::MeasureDouble;
+using ::opencensus::stats::MeasureInt64;
+using ::opencensus::stats::ViewDescriptor;
+using ::opencensus::tags::TagKey;
+
+constexpr char OpenCensusCommunicatorMetrics::kMessageBytesMeasureName[];
+constexpr char OpenCensusCommunicatorMetrics::kQueueingDelayMeasureName[];
+constexpr char OpenCensusCommunicatorMetrics::kInvocationLatencyMeasureName[];
+constexpr char OpenCensusCommunicatorMetrics::kActiveThreadsMeasureName[];
+
+namespace {
+
+// Name of the view counting messages, aggregated from the message size
+// measure.
+constexpr char kMessagesViewName[] = "communicator/messages";
+
+constexpr char kMessageBytesMeasureDescription[] =
+    "The size of a message sent or received by a Communicator.";
+constexpr char kQueueingDelayMeasureDescription[] =
+    "The time a message waits in the queue of the thread that processes it.";
+constexpr char kInvocationLatencyMeasureDescription[] =
+    "The time from sending an Invoke request to receiving its response.";
+constexpr char kActiveThreadsMeasureDescription[] =
+    "The number of threads known to the Communicators of the process.";
+
+// Number of live OpenCensusCommunicatorMetrics instances.
+std::atomic<int> instances{0};
+
+absl::string_view DirectionName(
+    OpenCensusCommunicatorMetrics::Direction direction) {
+  return direction == OpenCensusCommunicatorMetrics::Direction::kSent
+             ? "sent"
+             : "received";
+}
+
+// Returns a view of the latency measure |measure_name|, in milliseconds.
+ViewDescriptor LatencyView(const OpenCensusClientConfig &config,
+                           absl::string_view measure_name,
+                           absl::string_view description) {
+  // Buckets from 1us to roughly 16s.
+  return ViewDescriptor()
+      .set_name(asylo::JoinPath(config.view_name_root, measure_name))
+      .set_description(description)
+      .set_measure(measure_name)
+      .set_aggregation(Aggregation::Distribution(
+          BucketBoundaries::Exponential(/*num_finite_buckets=*/24,
+                                        /*initial_bound=*/0.001,
+                                        /*growth_factor=*/2)));
+}
+
+}  // namespace
+
+OpenCensusCommunicatorMetrics::OpenCensusCommunicatorMetrics(
+    const OpenCensusClientConfig &config) {
+  MessageBytesMeasure();
+  QueueingDelayMeasure();
+  InvocationLatencyMeasure();
+  ActiveThreadsMeasure();
+
+  view_descriptors_.push_back(
+      ViewDescriptor()
+          .set_name(asylo::JoinPath(config.view_name_root, kMessagesViewName))
+          .set_description("The number of messages sent and received.")
+          .set_measure(kMessageBytesMeasureName)
+          .set_aggregation(Aggregation::Count())
+          .add_column(DirectionKey()));
+  // Buckets from 64 bytes to 32MiB.
+  view_descriptors_.push_back(
+      ViewDescriptor()
+          .set_name(
+              asylo::JoinPath(config.view_name_root, kMessageBytesMeasureName))
+          .set_description(kMessageBytesMeasureDescription)
+          .set_measure(kMessageBytesMeasureName)
+          .set_aggregation(Aggregation::Distribution(
+              BucketBoundaries::Exponential(/*num_finite_buckets=*/20,
+                                            /*initial_bound=*/64,
+                                            /*growth_factor=*/2)))
+          .add_column(DirectionKey()));
+  view_descriptors_.push_back(
+      LatencyView(config, kQueueingDelayMeasureName,
+                  kQueueingDelayMeasureDescription));
+  view_descriptors_.push_back(
+      LatencyView(config, kInvocationLatencyMeasureName,
+                  kInvocationLatencyMeasureDescription));
+  view_descriptors_.push_back(
+      ViewDescriptor()
+          .set_name(
+              asylo::JoinPath(config.view_name_root, kActiveThreadsMeasureName))
+          .set_description(kActiveThreadsMeasureDescription)
+          .set_measure(kActiveThreadsMeasureName)
+          .set_aggregation(Aggregation::LastValue()));
+
+  for (ViewDescriptor &view_descriptor : view_descriptors_) {
+    view_descriptor.RegisterForExport();
+  }
+  instances.fetch_add(1);
+}
+
+OpenCensusCommunicatorMetrics::~OpenCensusCommunicatorMetrics() {
+  instances.fetch_sub(1);
+}
+
+bool OpenCensusCommunicatorMetrics::enabled() {
+  return instances.load(std::memory_order_relaxed) > 0;
+}
+
+void OpenCensusCommunicatorMetrics::RecordMessage(Direction direction,
+                                                  size_t bytes) {
+  ::opencensus::stats::Record(
+      {{MessageBytesMeasure(), static_cast<int64_t>(bytes)}},
+      {{DirectionKey(), DirectionName(direction)}});
+}
+
+void OpenCensusCommunicatorMetrics::RecordQueueingDelay(absl::Duration delay) {
+  ::opencensus::stats::Record(
+      {{QueueingDelayMeasure(), absl::ToDoubleMilliseconds(delay)}});
+}
+
+void OpenCensusCommunicatorMetrics::RecordInvocationLatency(
+    absl::Duration latency) {
+  ::opencensus::stats::Record(
+      {{InvocationLatencyMeasure(), absl::ToDoubleMilliseconds(latency)}});
+}
+
+void OpenCensusCommunicatorMetrics::RecordActiveThreads(int64_t count) {
+  ::opencensus::stats::Record({{ActiveThreadsMeasure(), count}});
+}
+
+TagKey OpenCensusCommunicatorMetrics::DirectionKey() {
+  static const auto key = TagKey::Register("direction");
+  return key;
+}
+
+MeasureInt64 OpenCensusCommunicatorMetrics::MessageBytesMeasure() {
+  static const auto measure = MeasureInt64::Register(
+      kMessageBytesMeasureName, kMessageBytesMeasureDescription, "By");
+  return measure;
+}
+
+MeasureDouble OpenCensusCommunicatorMetrics::QueueingDelayMeasure() {
+  static const auto measure = MeasureDouble::Register(
+      kQueueingDelayMeasureName, kQueueingDelayMeasureDescription, "ms");
+  return measure;
+}
+
+MeasureDouble OpenCensusCommunicatorMetrics::InvocationLatencyMeasure() {
+  static const auto measure = MeasureDouble::Register(
+      kInvocationLatencyMeasureName, kInvocationLatencyMeasureDescription,
+      "ms");
+  return measure;
+}
+
+MeasureInt64 OpenCensusCommunicatorMetrics::ActiveThreadsMeasure() {
+  static const auto measure = MeasureInt64::Register(
+      kActiveThreadsMeasureName, kActiveThreadsMeasureDescription, "1");
+  return measure;
+}
+
+}  // namespace primitives
+}  // namespace asylo
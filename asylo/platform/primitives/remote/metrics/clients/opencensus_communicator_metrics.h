@@ -0,0 +1,106 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_PRIMITIVES_REMOTE_METRICS_CLIENTS_OPENCENSUS_COMMUNICATOR_METRICS_H_
+#define ASYLO_PLATFORM_PRIMITIVES_REMOTE_METRICS_CLIENTS_OPENCENSUS_COMMUNICATOR_METRICS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "asylo/platform/primitives/remote/metrics/clients/opencensus_client_config.h"
+#include "opencensus/stats/stats.h"
+#include "opencensus/tags/tag_key.h"
+
+namespace asylo {
+namespace primitives {
+
+// Records measures of the traffic through remote backend Communicators as
+// OpenCensus measures:
+//   * messages sent and received, and their sizes,
+//   * time messages wait in a thread's queue before they are processed,
+//   * latency of Invoke round trips,
+//   * number of threads known to the Communicators.
+//
+// Recording is skipped while no OpenCensusCommunicatorMetrics instance exists,
+// so that Communicators without metrics collection do not pay for it. Each
+// instance registers views of all the measures for export under
+// |config.view_name_root|, next to the views of the OpenCensusClient that
+// shares the same config.
+class OpenCensusCommunicatorMetrics {
+ public:
+  // Direction of a message relative to the recording Communicator.
+  enum class Direction { kSent, kReceived };
+
+  // Measure names.
+  static constexpr char kMessageBytesMeasureName[] =
+      "communicator/message_bytes";
+  static constexpr char kQueueingDelayMeasureName[] =
+      "communicator/queueing_delay";
+  static constexpr char kInvocationLatencyMeasureName[] =
+      "communicator/invocation_latency";
+  static constexpr char kActiveThreadsMeasureName[] =
+      "communicator/active_threads";
+
+  explicit OpenCensusCommunicatorMetrics(const OpenCensusClientConfig &config);
+  ~OpenCensusCommunicatorMetrics();
+
+  OpenCensusCommunicatorMetrics(const OpenCensusCommunicatorMetrics &other) =
+      delete;
+  OpenCensusCommunicatorMetrics &operator=(
+      const OpenCensusCommunicatorMetrics &other) = delete;
+
+  // Returns the views registered by this instance.
+  const std::vector<::opencensus::stats::ViewDescriptor> &view_descriptors()
+      const {
+    return view_descriptors_;
+  }
+
+  // Returns true if measures are being recorded.
+  static bool enabled();
+
+  // Records a message of |bytes| bytes sent or received.
+  static void RecordMessage(Direction direction, size_t bytes);
+
+  // Records the time a message waited in a thread's queue.
+  static void RecordQueueingDelay(absl::Duration delay);
+
+  // Records the time from sending an Invoke request to receiving its response.
+  static void RecordInvocationLatency(absl::Duration latency);
+
+  // Records the current number of threads known to the Communicators.
+  static void RecordActiveThreads(int64_t count);
+
+  // Tag key
+  static ::opencensus::tags::TagKey DirectionKey();
+
+ private:
+  static ::opencensus::stats::MeasureInt64 MessageBytesMeasure();
+  static ::opencensus::stats::MeasureDouble QueueingDelayMeasure();
+  static ::opencensus::stats::MeasureDouble InvocationLatencyMeasure();
+  static ::opencensus::stats::MeasureInt64 ActiveThreadsMeasure();
+
+  std::vector<::opencensus::stats::ViewDescriptor> view_descriptors_;
+};
+
+}  // namespace primitives
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_PRIMITIVES_REMOTE_METRICS_CLIENTS_OPENCENSUS_COMMUNICATOR_METRICS_H_
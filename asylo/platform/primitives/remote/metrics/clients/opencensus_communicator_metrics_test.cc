@@ -0,0 +1,117 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/primitives/remote/metrics/clients/opencensus_communicator_metrics.h"
+
+#include <memory>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/memory/memory.h"
+#include "absl/time/time.h"
+#include "asylo/platform/primitives/remote/metrics/clients/opencensus_client_config.h"
+#include "opencensus/stats/stats.h"
+#include "opencensus/stats/testing/test_utils.h"
+
+namespace asylo {
+namespace primitives {
+namespace {
+
+using ::opencensus::stats::testing::TestUtils;
+using ::testing::Eq;
+using ::testing::SizeIs;
+
+using Direction = OpenCensusCommunicatorMetrics::Direction;
+
+class OpenCensusCommunicatorMetricsTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    OpenCensusClientConfig config;
+    config.view_name_root = "test_root";
+    metrics_ = absl::make_unique<OpenCensusCommunicatorMetrics>(config);
+  }
+
+  // Returns a view of the |index|-th view registered by |metrics_|.
+  std::unique_ptr<::opencensus::stats::View> View(int index) {
+    return absl::make_unique<::opencensus::stats::View>(
+        metrics_->view_descriptors()[index]);
+  }
+
+  std::unique_ptr<OpenCensusCommunicatorMetrics> metrics_;
+};
+
+TEST_F(OpenCensusCommunicatorMetricsTest, EnabledWhileInstancesExist) {
+  EXPECT_TRUE(OpenCensusCommunicatorMetrics::enabled());
+  metrics_.reset();
+  EXPECT_FALSE(OpenCensusCommunicatorMetrics::enabled());
+}
+
+TEST_F(OpenCensusCommunicatorMetricsTest, CountsAndSizesMessagesByDirection) {
+  auto messages_view = View(0);
+  auto bytes_view = View(1);
+
+  OpenCensusCommunicatorMetrics::RecordMessage(Direction::kSent, 100);
+  OpenCensusCommunicatorMetrics::RecordMessage(Direction::kSent, 300);
+  OpenCensusCommunicatorMetrics::RecordMessage(Direction::kReceived, 50);
+  TestUtils::Flush();
+
+  const auto &counts = messages_view->GetData().int_data();
+  ASSERT_THAT(counts, SizeIs(2));
+  EXPECT_THAT(counts.at({"sent"}), Eq(2));
+  EXPECT_THAT(counts.at({"received"}), Eq(1));
+
+  const auto &sizes = bytes_view->GetData().distribution_data();
+  ASSERT_THAT(sizes, SizeIs(2));
+  EXPECT_THAT(sizes.at({"sent"}).mean(), Eq(200.0));
+  EXPECT_THAT(sizes.at({"received"}).mean(), Eq(50.0));
+}
+
+TEST_F(OpenCensusCommunicatorMetricsTest, RecordsLatenciesInMilliseconds) {
+  auto queueing_view = View(2);
+  auto invocation_view = View(3);
+
+  OpenCensusCommunicatorMetrics::RecordQueueingDelay(absl::Microseconds(500));
+  OpenCensusCommunicatorMetrics::RecordInvocationLatency(absl::Milliseconds(2));
+  OpenCensusCommunicatorMetrics::RecordInvocationLatency(absl::Milliseconds(4));
+  TestUtils::Flush();
+
+  const auto &queueing = queueing_view->GetData().distribution_data();
+  ASSERT_THAT(queueing, SizeIs(1));
+  EXPECT_THAT(queueing.begin()->second.mean(), Eq(0.5));
+
+  const auto &invocation = invocation_view->GetData().distribution_data();
+  ASSERT_THAT(invocation, SizeIs(1));
+  EXPECT_THAT(invocation.begin()->second.count(), Eq(2));
+  EXPECT_THAT(invocation.begin()->second.mean(), Eq(3.0));
+}
+
+TEST_F(OpenCensusCommunicatorMetricsTest, KeepsLastThreadCount) {
+  auto threads_view = View(4);
+
+  OpenCensusCommunicatorMetrics::RecordActiveThreads(3);
+  OpenCensusCommunicatorMetrics::RecordActiveThreads(2);
+  TestUtils::Flush();
+
+  const auto &threads = threads_view->GetData().int_data();
+  ASSERT_THAT(threads, SizeIs(1));
+  EXPECT_THAT(threads.begin()->second, Eq(2));
+}
+
+}  // namespace
+}  // namespace primitives
+}  // namespace asylo
@@ -0,0 +1,89 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/primitives/remote/metrics/clients/opencensus_span_sink.h"
+
+#include "absl/strings/str_cat.h"
+#include "asylo/platform/primitives/util/trace_context.h"
+#include "asylo/util/path.h"
+#include "opencensus/stats/stats.h"
+#include "opencensus/tags/tag_key.h"
+
+namespace asylo {
+namespace primitives {
+
+using ::opencensus::stats::Aggregation;
+using ::opencensus::stats::BucketBoundaries;
+using ::opencensus::stats::MeasureDouble;
+using ::opencensus::stats::ViewDescriptor;
+using ::opencensus::tags::TagKey;
+
+constexpr char OpenCensusSpanSink::kDurationMeasureName[];
+
+namespace {
+
+constexpr char kDurationMeasureDescription[] =
+    "The duration of an enclave call or exit call, or of its handling, on "
+    "behalf of a traced request.";
+
+}  // namespace
+
+OpenCensusSpanSink::OpenCensusSpanSink(const OpenCensusClientConfig &config) {
+  DurationMeasure();
+  // Buckets from 1us to roughly 16s, which covers everything from an exit call
+  // answered by the host right away to a long enclave call.
+  view_descriptor_ =
+      ViewDescriptor()
+          .set_name(
+              asylo::JoinPath(config.view_name_root, kDurationMeasureName))
+          .set_description(kDurationMeasureDescription)
+          .set_measure(kDurationMeasureName)
+          .set_aggregation(Aggregation::Distribution(
+              BucketBoundaries::Exponential(/*num_finite_buckets=*/24,
+                                            /*initial_bound=*/0.001,
+                                            /*growth_factor=*/2)))
+          .add_column(SpanKindKey())
+          .add_column(SelectorKey());
+  view_descriptor_.RegisterForExport();
+}
+
+void OpenCensusSpanSink::Record(const SpanRecord &span) {
+  ::opencensus::stats::Record(
+      {{DurationMeasure(), (span.end_nanos - span.start_nanos) / 1e6}},
+      {{SpanKindKey(), SpanKindName(span.kind)},
+       {SelectorKey(), absl::StrCat(span.selector)}});
+}
+
+TagKey OpenCensusSpanSink::SpanKindKey() {
+  static const auto key = TagKey::Register("span_kind");
+  return key;
+}
+
+TagKey OpenCensusSpanSink::SelectorKey() {
+  static const auto key = TagKey::Register("selector");
+  return key;
+}
+
+MeasureDouble OpenCensusSpanSink::DurationMeasure() {
+  static const auto measure = MeasureDouble::Register(
+      kDurationMeasureName, kDurationMeasureDescription, "ms");
+  return measure;
+}
+
+}  // namespace primitives
+}  // namespace asylo
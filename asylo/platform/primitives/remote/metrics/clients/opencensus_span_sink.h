@@ -0,0 +1,70 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_PRIMITIVES_REMOTE_METRICS_CLIENTS_OPENCENSUS_SPAN_SINK_H_
+#define ASYLO_PLATFORM_PRIMITIVES_REMOTE_METRICS_CLIENTS_OPENCENSUS_SPAN_SINK_H_
+
+#include "asylo/platform/primitives/remote/metrics/clients/opencensus_client_config.h"
+#include "asylo/platform/primitives/util/trace_context.h"
+#include "opencensus/stats/stats.h"
+#include "opencensus/tags/tag_key.h"
+
+namespace asylo {
+namespace primitives {
+
+// A SpanSink that records the durations of the spans of enclave calls and exit
+// calls as an OpenCensus distribution, tagged with the kind of the span and
+// the selector of the call. The view is exported under
+// |config.view_name_root|, so that it sits next to the views of the
+// OpenCensusClient that shares the same config.
+//
+// Subtracting the aggregated durations of kEnclaveEntry spans from those of
+// kEnclaveCall spans, and of kExitHandler spans from kHostCall spans, gives the
+// time spent crossing the enclave boundary per selector.
+class OpenCensusSpanSink : public SpanSink {
+ public:
+  // Name of the span duration measure, in milliseconds.
+  static constexpr char kDurationMeasureName[] = "enclave/span_duration";
+
+  explicit OpenCensusSpanSink(const OpenCensusClientConfig &config);
+
+  OpenCensusSpanSink(const OpenCensusSpanSink &other) = delete;
+  OpenCensusSpanSink &operator=(const OpenCensusSpanSink &other) = delete;
+
+  // Returns the view aggregating span durations by kind and selector.
+  const ::opencensus::stats::ViewDescriptor &view_descriptor() const {
+    return view_descriptor_;
+  }
+
+  // From SpanSink.
+  void Record(const SpanRecord &span) override;
+
+  // Tag keys
+  static ::opencensus::tags::TagKey SpanKindKey();
+  static ::opencensus::tags::TagKey SelectorKey();
+
+ private:
+  static ::opencensus::stats::MeasureDouble DurationMeasure();
+
+  ::opencensus::stats::ViewDescriptor view_descriptor_;
+};
+
+}  // namespace primitives
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_PRIMITIVES_REMOTE_METRICS_CLIENTS_OPENCENSUS_SPAN_SINK_H_
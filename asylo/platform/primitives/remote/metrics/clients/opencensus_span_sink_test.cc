@@ -0,0 +1,89 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/primitives/remote/metrics/clients/opencensus_span_sink.h"
+
+#include <cstdint>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "asylo/platform/primitives/remote/metrics/clients/opencensus_client_config.h"
+#include "asylo/platform/primitives/util/trace_context.h"
+#include "opencensus/stats/stats.h"
+#include "opencensus/stats/testing/test_utils.h"
+
+namespace asylo {
+namespace primitives {
+namespace {
+
+using ::opencensus::stats::testing::TestUtils;
+using ::testing::Eq;
+using ::testing::SizeIs;
+
+SpanRecord Span(SpanKind kind, uint64_t selector, int64_t duration_nanos) {
+  SpanRecord span = {};
+  span.context = TraceContext::NewTrace();
+  span.kind = kind;
+  span.selector = selector;
+  span.start_nanos = 1000;
+  span.end_nanos = 1000 + duration_nanos;
+  return span;
+}
+
+TEST(OpenCensusSpanSinkTest, AggregatesByKindAndSelector) {
+  OpenCensusClientConfig config;
+  config.view_name_root = "test_root";
+  OpenCensusSpanSink sink(config);
+  ::opencensus::stats::View view(sink.view_descriptor());
+
+  sink.Record(Span(SpanKind::kEnclaveCall, 1024, 3000000));
+  sink.Record(Span(SpanKind::kEnclaveCall, 1024, 5000000));
+  sink.Record(Span(SpanKind::kEnclaveEntry, 1024, 2000000));
+  sink.Record(Span(SpanKind::kHostCall, 80, 10000));
+  TestUtils::Flush();
+
+  const auto &data = view.GetData().distribution_data();
+  ASSERT_THAT(data, SizeIs(3));
+  EXPECT_THAT(data.at({"enclave_call", "1024"}).count(), Eq(2));
+  EXPECT_THAT(data.at({"enclave_call", "1024"}).mean(), Eq(4.0));
+  EXPECT_THAT(data.at({"enclave_entry", "1024"}).count(), Eq(1));
+  EXPECT_THAT(data.at({"host_call", "80"}).count(), Eq(1));
+}
+
+TEST(OpenCensusSpanSinkTest, ReceivesSpansWhenInstalled) {
+  OpenCensusClientConfig config;
+  config.view_name_root = "installed_root";
+  OpenCensusSpanSink sink(config);
+  ::opencensus::stats::View view(sink.view_descriptor());
+
+  SpanSink *previous = SetSpanSink(&sink);
+  {
+    ScopedTraceContext scoped_context(TraceContext::NewTrace());
+    ScopedSpan span(SpanKind::kExitHandler, 80);
+  }
+  SetSpanSink(previous);
+  TestUtils::Flush();
+
+  const auto &data = view.GetData().distribution_data();
+  ASSERT_THAT(data, SizeIs(1));
+  EXPECT_THAT(data.at({"exit_handler", "80"}).count(), Eq(1));
+}
+
+}  // namespace
+}  // namespace primitives
+}  // namespace asylo
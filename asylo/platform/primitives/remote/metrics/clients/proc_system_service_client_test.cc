@@ -47,8 +47,8 @@ class ProcSystemServiceClientTest : public ::testing::Test {
  public:
   void SetUp() override {
     auto mock_parser = absl::make_unique<MockProcSystemParser>();
-    EXPECT_CALL(*mock_parser, ReadProcStat(_))
-        .WillOnce(Return(mock_parser->stat_contents()));
+    EXPECT_CALL(*mock_parser, ReadProcStat(_, _))
+        .WillOnce(mock_parser->ReadStatContents());
 
     // |mock_parser| is consumed by |mock_service|. Need a second instance for
     // comparison.
@@ -24,6 +24,7 @@
 #include <gmock/gmock.h>
 #include "absl/strings/str_cat.h"
 #include "asylo/platform/primitives/remote/metrics/proc_system_parser.h"
+#include "asylo/util/status.h"
 
 namespace asylo {
 namespace primitives {
@@ -32,7 +33,7 @@ class MockProcSystemParser : public ProcSystemParser {
  public:
   MockProcSystemParser() : stat_contents_(ComposeStatContents()) {}
 
-  MOCK_METHOD(StatusOr<std::string>, ReadProcStat, (pid_t pid),
+  MOCK_METHOD(Status, ReadProcStat, (pid_t pid, std::string *contents),
               (const, override));
 
   const int64_t kExpectedPid = 12681;
@@ -90,6 +91,15 @@ class MockProcSystemParser : public ProcSystemParser {
 
   const std::string &stat_contents() const { return stat_contents_; }
 
+  // Returns an action for ReadProcStat which reads stat_contents().
+  ::testing::Action<Status(pid_t, std::string *)> ReadStatContents() const {
+    std::string contents = stat_contents_;
+    return [contents](pid_t pid, std::string *buffer) {
+      *buffer = contents;
+      return Status::OkStatus();
+    };
+  }
+
  private:
   std::string ComposeStatContents() const {
     std::string value;
@@ -18,12 +18,13 @@
 
 #include "asylo/platform/primitives/remote/metrics/proc_system_parser.h"
 
+#include <errno.h>
+#include <fcntl.h>
 #include <linux/sched.h>
 #include <sys/types.h>
+#include <unistd.h>
 
-#include <fstream>
-#include <iostream>
-#include <sstream>
+#include <string>
 
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
@@ -45,43 +46,58 @@ namespace asylo {
 namespace primitives {
 namespace {
 
-StatusOr<std::string> GetFileContents(const std::string &filename) {
-  std::ifstream file;
-  Cleanup file_cleanup([&file]() { file.close(); });
-  file.open(filename.c_str());
-  if (!file) {
+// Size of the chunks in which proc files are read.
+constexpr size_t kReadChunkSize = 1024;
+
+}  // namespace
+
+Status ProcSystemParser::ReadProcStat(pid_t pid, std::string *contents) const {
+  char filename[32];
+  absl::SNPrintF(filename, sizeof(filename), "/proc/%d/stat", pid);
+  int fd = open(filename, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
     return Status(error::GoogleError::UNKNOWN,
                   absl::StrCat("Unable to open file with filename=", filename));
   }
-
-  std::stringstream file_contents;
-  file_contents << file.rdbuf();
-  return file_contents.str();
+  Cleanup fd_cleanup([fd]() { close(fd); });
+
+  contents->clear();
+  while (true) {
+    const size_t size = contents->size();
+    contents->resize(size + kReadChunkSize);
+    ssize_t result = read(fd, &(*contents)[size], kReadChunkSize);
+    contents->resize(size + (result > 0 ? result : 0));
+    if (result == 0) {
+      return Status::OkStatus();
+    }
+    if (result < 0 && errno != EINTR) {
+      return Status(error::GoogleError::UNKNOWN,
+                    absl::StrCat("Unable to read file with filename=",
+                                 filename));
+    }
+  }
 }
 
-}  // namespace
-
-StatusOr<std::string> ProcSystemParser::ReadProcStat(pid_t pid) const {
-  std::string stat_contents;
-  ASYLO_ASSIGN_OR_RETURN(stat_contents,
-                         GetFileContents(absl::StrCat("/proc/", pid, "/stat")));
-  return stat_contents;
+StatusOr<ProcSystemStat> ProcSystemParser::GetProcStat(pid_t pid) const {
+  std::string buffer;
+  ProcSystemStat proc_stat;
+  ASYLO_RETURN_IF_ERROR(GetProcStat(pid, &buffer, &proc_stat));
+  return proc_stat;
 }
 
-StatusOr<ProcSystemStat> ProcSystemParser::GetProcStat(pid_t pid) const {
-  std::string stat_contents;
-  ASYLO_ASSIGN_OR_RETURN(stat_contents, ReadProcStat(pid));
+Status ProcSystemParser::GetProcStat(pid_t pid, std::string *buffer,
+                                     ProcSystemStat *proc_stat) const {
+  ASYLO_RETURN_IF_ERROR(ReadProcStat(pid, buffer));
   // Maximum character length of a stat file plus a null character.
   static constexpr uint64_t kStatFileLength = TASK_COMM_LEN + 1002;
   char stat_contents_c_str[kStatFileLength];
   absl::SNPrintF(stat_contents_c_str, sizeof(stat_contents_c_str), "%s",
-                 stat_contents);
-
-  ProcSystemStat proc_stat;
+                 *buffer);
 
   // Get the PID and ensure we got the right file.
-  sscanf(stat_contents_c_str, "%ld ...", &proc_stat.pid);
-  if (proc_stat.pid != pid) {
+  proc_stat->pid = 0;
+  sscanf(stat_contents_c_str, "%ld ...", &proc_stat->pid);
+  if (proc_stat->pid != pid) {
     return Status(
         error::GoogleError::UNKNOWN,
         absl::StrCat("Got wrong pid while parsing /proc/", pid, "/stat"));
@@ -145,22 +161,23 @@ StatusOr<ProcSystemStat> ProcSystemParser::GetProcStat(pid_t pid) const {
 
   char state;
   int check = sscanf(
-      end, kFormatString, &state, &proc_stat.ppid, &proc_stat.pgrp,
-      &proc_stat.session, &proc_stat.tty_nr, &proc_stat.tpgid, &proc_stat.flags,
-      &proc_stat.minflt, &proc_stat.cminflt, &proc_stat.majflt,
-      &proc_stat.cmajflt, &proc_stat.utime, &proc_stat.stime, &proc_stat.cutime,
-      &proc_stat.cstime, &proc_stat.priority, &proc_stat.nice,
-      &proc_stat.num_threads, &proc_stat.itrealvalue, &proc_stat.starttime,
-      &proc_stat.vsize, &proc_stat.rss, &proc_stat.rsslim, &proc_stat.startcode,
-      &proc_stat.endcode, &proc_stat.startstack, &proc_stat.kstkesp,
-      &proc_stat.kstkeip, &proc_stat.signal, &proc_stat.blocked,
-      &proc_stat.sigignore, &proc_stat.sigcatch, &proc_stat.wchan,
-      &proc_stat.nswap, &proc_stat.cnswap, &proc_stat.exit_signal,
-      &proc_stat.processor, &proc_stat.rt_priority, &proc_stat.policy,
-      &proc_stat.delayacct_blkio_ticks, &proc_stat.guest_time,
-      &proc_stat.cguest_time, &proc_stat.start_data, &proc_stat.end_data,
-      &proc_stat.start_brk, &proc_stat.arg_start, &proc_stat.arg_end,
-      &proc_stat.env_start, &proc_stat.env_end, &proc_stat.exit_code);
+      end, kFormatString, &state, &proc_stat->ppid, &proc_stat->pgrp,
+      &proc_stat->session, &proc_stat->tty_nr, &proc_stat->tpgid,
+      &proc_stat->flags, &proc_stat->minflt, &proc_stat->cminflt,
+      &proc_stat->majflt, &proc_stat->cmajflt, &proc_stat->utime,
+      &proc_stat->stime, &proc_stat->cutime, &proc_stat->cstime,
+      &proc_stat->priority, &proc_stat->nice, &proc_stat->num_threads,
+      &proc_stat->itrealvalue, &proc_stat->starttime, &proc_stat->vsize,
+      &proc_stat->rss, &proc_stat->rsslim, &proc_stat->startcode,
+      &proc_stat->endcode, &proc_stat->startstack, &proc_stat->kstkesp,
+      &proc_stat->kstkeip, &proc_stat->signal, &proc_stat->blocked,
+      &proc_stat->sigignore, &proc_stat->sigcatch, &proc_stat->wchan,
+      &proc_stat->nswap, &proc_stat->cnswap, &proc_stat->exit_signal,
+      &proc_stat->processor, &proc_stat->rt_priority, &proc_stat->policy,
+      &proc_stat->delayacct_blkio_ticks, &proc_stat->guest_time,
+      &proc_stat->cguest_time, &proc_stat->start_data, &proc_stat->end_data,
+      &proc_stat->start_brk, &proc_stat->arg_start, &proc_stat->arg_end,
+      &proc_stat->env_start, &proc_stat->env_end, &proc_stat->exit_code);
 
   // The expectation is that 50 values were set by sscanf. If that is not the
   // case, the file was not formatted as expected.
@@ -171,10 +188,10 @@ StatusOr<ProcSystemStat> ProcSystemParser::GetProcStat(pid_t pid) const {
                                "expected. Unable to parse."));
   }
 
-  proc_stat.comm = process_filename;
-  proc_stat.state = std::string(&state, 1);
+  proc_stat->comm = process_filename;
+  proc_stat->state.assign(1, state);
 
-  return proc_stat;
+  return Status::OkStatus();
 }
 
 }  // namespace primitives
@@ -21,6 +21,9 @@
 
 #include <sys/types.h>
 
+#include <string>
+
+#include "asylo/util/status.h"
 #include "asylo/util/statusor.h"
 
 namespace asylo {
@@ -52,8 +55,15 @@ class ProcSystemParser {
   // |ProcSystemStat|.
   StatusOr<ProcSystemStat> GetProcStat(pid_t pid) const;
 
+  // Same as above, but parses into |proc_stat| and reads the file into
+  // |buffer|. Callers which sample the file repeatedly reuse both across calls,
+  // so that a sample does not allocate.
+  Status GetProcStat(pid_t pid, std::string *buffer,
+                     ProcSystemStat *proc_stat) const;
+
  private:
-  virtual StatusOr<std::string> ReadProcStat(pid_t pid) const;
+  // Reads the /proc/[pid]/stat file into |contents|, reusing its capacity.
+  virtual Status ReadProcStat(pid_t pid, std::string *contents) const;
 };
 
 }  // namespace primitives
@@ -20,6 +20,8 @@
 
 #include <unistd.h>
 
+#include <string>
+
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include "absl/memory/memory.h"
@@ -36,7 +38,6 @@ using ::testing::Eq;
 using ::testing::Gt;
 using ::testing::IsEmpty;
 using ::testing::Not;
-using ::testing::Return;
 
 TEST(ProcSystemParserTest, ParsesProcStatFile) {
   const pid_t pid = fork();
@@ -65,12 +66,28 @@ TEST(ProcSystemParserTest, ParsesProcStatFile) {
   EXPECT_THAT(proc_stat.state, Not(IsEmpty()));
 }
 
+TEST(ProcSystemParserTest, ReusesBufferAcrossReads) {
+  ProcSystemParser proc_system_parser;
+  std::string buffer;
+  ProcSystemStat proc_stat;
+
+  ASSERT_THAT(proc_system_parser.GetProcStat(getpid(), &buffer, &proc_stat),
+              IsOk());
+  EXPECT_THAT(proc_stat.pid, Eq(getpid()));
+  const size_t capacity = buffer.capacity();
+
+  ASSERT_THAT(proc_system_parser.GetProcStat(getpid(), &buffer, &proc_stat),
+              IsOk());
+  EXPECT_THAT(proc_stat.pid, Eq(getpid()));
+  EXPECT_THAT(buffer.capacity(), Eq(capacity));
+}
+
 TEST(ProcSystemParserTest, CorrectlyParsesProcStatFile) {
   ProcSystemStat proc_stat;
   MockProcSystemParser mock_parser;
 
-  EXPECT_CALL(mock_parser, ReadProcStat(_))
-      .WillOnce(Return(mock_parser.stat_contents()));
+  EXPECT_CALL(mock_parser, ReadProcStat(_, _))
+      .WillOnce(mock_parser.ReadStatContents());
 
   ASYLO_ASSERT_OK_AND_ASSIGN(proc_stat,
                              mock_parser.GetProcStat(mock_parser.kExpectedPid));
@@ -18,17 +18,86 @@
 
 #include "asylo/platform/primitives/remote/metrics/proc_system_service.h"
 
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
 #include "absl/memory/memory.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "asylo/platform/primitives/remote/metrics/proc_system.grpc.pb.h"
 #include "asylo/platform/primitives/remote/metrics/proc_system.pb.h"
 #include "asylo/platform/primitives/remote/metrics/proc_system_parser.h"
+#include "asylo/platform/primitives/util/exit_profile.h"
 #include "asylo/util/status.h"
 #include "asylo/util/status_macros.h"
 #include "include/grpc/support/time.h"
 #include "include/grpcpp/support/status.h"
+#include "google/protobuf/descriptor.h"
+#include "google/protobuf/message.h"
 
 namespace asylo {
 namespace primitives {
+namespace {
+
+::grpc::Status ToGrpcStatus(const ::asylo::Status &status) {
+  return ::grpc::Status(static_cast<::grpc::StatusCode>(status.error_code()),
+                        std::string(status.error_message()));
+}
+
+void CopyExitCallStats(const ExitCallKey &key, const ExitCallStats &stats,
+                       ExitCallStatsProto *proto) {
+  proto->set_selector(key.selector);
+  proto->set_sub_key(key.sub_key);
+  proto->set_count(stats.count);
+  proto->set_bytes_in(stats.bytes_in);
+  proto->set_bytes_out(stats.bytes_out);
+  proto->set_total_latency_nanos(stats.total_latency_nanos);
+  for (uint64_t bucket : stats.latency_buckets) {
+    proto->add_latency_buckets(bucket);
+  }
+}
+
+// Returns whether |field| has the same value in |first| and |second|. All the
+// fields of ProcStat are singular scalars or strings.
+bool FieldEquals(const ProcStat &first, const ProcStat &second,
+                 const google::protobuf::FieldDescriptor *field) {
+  const google::protobuf::Reflection *reflection = first.GetReflection();
+  if (!reflection->HasField(second, field)) {
+    return false;
+  }
+  switch (field->cpp_type()) {
+    case google::protobuf::FieldDescriptor::CPPTYPE_INT64:
+      return reflection->GetInt64(first, field) ==
+             reflection->GetInt64(second, field);
+    case google::protobuf::FieldDescriptor::CPPTYPE_UINT64:
+      return reflection->GetUInt64(first, field) ==
+             reflection->GetUInt64(second, field);
+    case google::protobuf::FieldDescriptor::CPPTYPE_STRING:
+      return reflection->GetString(first, field) ==
+             reflection->GetString(second, field);
+    default:
+      return false;
+  }
+}
+
+// Sets |delta| to |current| without the fields whose values are the same as
+// in |previous|.
+void ComputeProcStatDelta(const ProcStat &previous, const ProcStat &current,
+                          ProcStat *delta) {
+  delta->CopyFrom(current);
+  const google::protobuf::Reflection *reflection = current.GetReflection();
+  std::vector<const google::protobuf::FieldDescriptor *> fields;
+  reflection->ListFields(current, &fields);
+  for (const google::protobuf::FieldDescriptor *field : fields) {
+    if (FieldEquals(current, previous, field)) {
+      reflection->ClearField(delta, field);
+    }
+  }
+}
+
+}  // namespace
 
 ::grpc::Status ProcSystemServiceImpl::GetProcStat(
     grpc::ServerContext *context, const ProcStatRequest *request,
@@ -36,8 +105,90 @@ namespace primitives {
   auto status = BuildProcStatResponse(response);
   if (!status.ok()) {
     LOG(ERROR) << status;
-    return ::grpc::Status(static_cast<::grpc::StatusCode>(status.error_code()),
-                          std::string(status.error_message()));
+    return ToGrpcStatus(status);
+  }
+  return ::grpc::Status::OK;
+}
+
+::grpc::Status ProcSystemServiceImpl::GetExitProfile(
+    grpc::ServerContext *context, const ExitProfileRequest *request,
+    ExitProfileResponse *response) {
+  if (!exit_profiler_) {
+    return ::grpc::Status(::grpc::StatusCode::FAILED_PRECONDITION,
+                          "Exit call profiling is not enabled");
+  }
+  for (const auto &entry : exit_profiler_->Snapshot()) {
+    CopyExitCallStats(entry.first, entry.second,
+                      response->add_exit_call_stats());
+  }
+  return ::grpc::Status::OK;
+}
+
+::grpc::Status ProcSystemServiceImpl::WatchProcStats(
+    ::grpc::ServerContext *context, const WatchProcStatsRequest *request,
+    ::grpc::ServerWriter<ProcStatsSample> *writer) {
+  return StreamProcStats(context, *request, writer);
+}
+
+::grpc::Status ProcSystemServiceImpl::StreamProcStats(
+    ::grpc::ServerContext *context, const WatchProcStatsRequest &request,
+    ::grpc::ServerWriterInterface<ProcStatsSample> *writer) {
+  if (request.interval_millis() == 0) {
+    return ::grpc::Status(::grpc::StatusCode::INVALID_ARGUMENT,
+                          "Sampling interval must be positive");
+  }
+  const absl::Duration interval = absl::Milliseconds(request.interval_millis());
+
+  std::string buffer;
+  ProcSystemStat proc_system_stat;
+  ProcStat previous;
+  ProcStat current;
+  ExitProfile previous_profile;
+  ProcStatsSample sample;
+  for (uint64_t sequence = 0;
+       request.max_samples() == 0 || sequence < request.max_samples();
+       ++sequence) {
+    if (sequence > 0) {
+      absl::SleepFor(interval);
+    }
+    if (context->IsCancelled()) {
+      return ::grpc::Status::CANCELLED;
+    }
+
+    auto status =
+        proc_system_parser_->GetProcStat(pid_, &buffer, &proc_system_stat);
+    if (!status.ok()) {
+      LOG(ERROR) << status;
+      return ToGrpcStatus(status);
+    }
+    CopyProcStat(proc_system_stat, &current);
+
+    sample.Clear();
+    sample.set_sequence(sequence);
+    if (sequence == 0) {
+      sample.mutable_proc_stat()->CopyFrom(current);
+      sample.set_sc_clk_tck(sysconf(_SC_CLK_TCK));
+    } else {
+      ComputeProcStatDelta(previous, current, sample.mutable_proc_stat());
+    }
+    previous.Swap(&current);
+
+    if (exit_profiler_) {
+      ExitProfile profile = exit_profiler_->Snapshot();
+      for (const auto &entry : profile) {
+        auto previous_entry = previous_profile.find(entry.first);
+        if (previous_entry == previous_profile.end() ||
+            previous_entry->second.count != entry.second.count) {
+          CopyExitCallStats(entry.first, entry.second,
+                            sample.add_exit_call_stats());
+        }
+      }
+      previous_profile.swap(profile);
+    }
+
+    if (!writer->Write(sample)) {
+      return ::grpc::Status::CANCELLED;
+    }
   }
   return ::grpc::Status::OK;
 }
@@ -51,7 +202,12 @@ ProcSystemServiceImpl::CreateProcSystemParser() const {
     ProcStatResponse *response) const {
   ProcSystemStat proc_stat;
   ASYLO_ASSIGN_OR_RETURN(proc_stat, proc_system_parser_->GetProcStat(pid_));
-  auto response_proc_stat = response->mutable_proc_stat();
+  CopyProcStat(proc_stat, response->mutable_proc_stat());
+  return ::asylo::Status::OkStatus();
+}
+
+void ProcSystemServiceImpl::CopyProcStat(const ProcSystemStat &proc_stat,
+                                         ProcStat *response_proc_stat) {
   response_proc_stat->set_pid(proc_stat.pid);
   response_proc_stat->set_comm(proc_stat.comm);
   response_proc_stat->set_state(proc_stat.state);
@@ -105,7 +261,6 @@ ProcSystemServiceImpl::CreateProcSystemParser() const {
   response_proc_stat->set_env_start(proc_stat.env_start);
   response_proc_stat->set_env_end(proc_stat.env_end);
   response_proc_stat->set_exit_code(proc_stat.exit_code);
-  return ::asylo::Status::OkStatus();
 }
 
 }  // namespace primitives
@@ -22,9 +22,12 @@
 #include "asylo/platform/primitives/remote/metrics/proc_system.grpc.pb.h"
 #include "asylo/platform/primitives/remote/metrics/proc_system.pb.h"
 #include "asylo/platform/primitives/remote/metrics/proc_system_parser.h"
+#include "asylo/platform/primitives/util/exit_profile.h"
 #include "asylo/util/status.h"
 #include "include/grpc/support/time.h"
+#include "include/grpcpp/server_context.h"
 #include "include/grpcpp/support/status.h"
+#include "include/grpcpp/support/sync_stream.h"
 
 namespace asylo {
 namespace primitives {
@@ -32,7 +35,14 @@ namespace primitives {
 class ProcSystemServiceImpl : public ProcSystemService::Service {
  public:
   explicit ProcSystemServiceImpl(pid_t pid)
-      : proc_system_parser_(CreateProcSystemParser()), pid_(pid) {}
+      : ProcSystemServiceImpl(pid, /*exit_profiler=*/nullptr) {}
+
+  // Additionally serves the statistics collected by |exit_profiler| through
+  // GetExitProfile. |exit_profiler| must outlive the service.
+  ProcSystemServiceImpl(pid_t pid, const ExitProfiler *exit_profiler)
+      : proc_system_parser_(CreateProcSystemParser()),
+        pid_(pid),
+        exit_profiler_(exit_profiler) {}
   ProcSystemServiceImpl(const ProcSystemServiceImpl &other) = delete;
   ProcSystemServiceImpl &operator=(const ProcSystemServiceImpl &other) = delete;
 
@@ -40,18 +50,39 @@ class ProcSystemServiceImpl : public ProcSystemService::Service {
                              const ProcStatRequest *request,
                              ProcStatResponse *response) override;
 
+  ::grpc::Status GetExitProfile(::grpc::ServerContext *context,
+                                const ExitProfileRequest *request,
+                                ExitProfileResponse *response) override;
+
+  ::grpc::Status WatchProcStats(
+      ::grpc::ServerContext *context, const WatchProcStatsRequest *request,
+      ::grpc::ServerWriter<ProcStatsSample> *writer) override;
+
+  // Implements WatchProcStats on any |writer|. Samples are taken until
+  // |request| is satisfied, the call is cancelled, or a write fails. The
+  // parser buffers and the messages are reused from one sample to the next.
+  ::grpc::Status StreamProcStats(
+      ::grpc::ServerContext *context, const WatchProcStatsRequest &request,
+      ::grpc::ServerWriterInterface<ProcStatsSample> *writer);
+
  protected:
   ProcSystemServiceImpl(std::unique_ptr<ProcSystemParser> proc_system_parser,
                         pid_t pid)
-      : proc_system_parser_(std::move(proc_system_parser)), pid_(pid) {}
+      : proc_system_parser_(std::move(proc_system_parser)),
+        pid_(pid),
+        exit_profiler_(nullptr) {}
 
  private:
   std::unique_ptr<ProcSystemParser> CreateProcSystemParser() const;
 
   ::asylo::Status BuildProcStatResponse(ProcStatResponse *response) const;
 
+  static void CopyProcStat(const ProcSystemStat &proc_stat,
+                           ProcStat *response_proc_stat);
+
   std::unique_ptr<ProcSystemParser> proc_system_parser_;
   const pid_t pid_;
+  const ExitProfiler *const exit_profiler_;
 };
 
 }  // namespace primitives
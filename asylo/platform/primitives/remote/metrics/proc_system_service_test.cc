@@ -18,14 +18,23 @@
 
 #include "asylo/platform/primitives/remote/metrics/proc_system_service.h"
 
+#include <cstddef>
+#include <functional>
+#include <limits>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_replace.h"
 #include "asylo/platform/primitives/remote/metrics/mocks/mock_proc_system_parser.h"
 #include "asylo/platform/primitives/remote/metrics/mocks/mock_proc_system_service.h"
+#include "asylo/platform/primitives/util/exit_profile.h"
 #include "asylo/test/util/status_matchers.h"
+#include "include/grpcpp/support/sync_stream.h"
 
 namespace asylo {
 namespace primitives {
@@ -36,7 +45,50 @@ using ::testing::Eq;
 using ::testing::Gt;
 using ::testing::IsEmpty;
 using ::testing::Not;
-using ::testing::Return;
+using ::testing::SizeIs;
+
+// Records the samples written to a stream. Writes fail once |capacity| samples
+// were written.
+class FakeSampleWriter
+    : public ::grpc::ServerWriterInterface<ProcStatsSample> {
+ public:
+  explicit FakeSampleWriter(
+      size_t capacity = std::numeric_limits<size_t>::max())
+      : capacity_(capacity) {}
+
+  void SendInitialMetadata() override {}
+
+  bool Write(const ProcStatsSample &sample,
+             ::grpc::WriteOptions options) override {
+    if (samples_.size() >= capacity_) {
+      return false;
+    }
+    samples_.push_back(sample);
+    if (on_write_) {
+      on_write_();
+    }
+    return true;
+  }
+
+  // Sets a callback run after each successful write.
+  void set_on_write(std::function<void()> on_write) {
+    on_write_ = std::move(on_write);
+  }
+
+  const std::vector<ProcStatsSample> &samples() const { return samples_; }
+
+ private:
+  const size_t capacity_;
+  std::function<void()> on_write_;
+  std::vector<ProcStatsSample> samples_;
+};
+
+WatchProcStatsRequest WatchRequest(uint64_t max_samples) {
+  WatchProcStatsRequest request;
+  request.set_interval_millis(1);
+  request.set_max_samples(max_samples);
+  return request;
+}
 
 class ProcSystemServiceTest : public ::testing::Test {
  protected:
@@ -73,8 +125,8 @@ TEST_F(ProcSystemServiceTest, SuccessfullyBuildsResponse) {
 
 TEST_F(ProcSystemServiceTest, ResponseIsSuccessfulParse) {
   auto mock_parser = absl::make_unique<MockProcSystemParser>();
-  EXPECT_CALL(*mock_parser, ReadProcStat(_))
-      .WillOnce(Return(mock_parser->stat_contents()));
+  EXPECT_CALL(*mock_parser, ReadProcStat(_, _))
+      .WillOnce(mock_parser->ReadStatContents());
 
   // |mock_parser| is consumed by |mock_service|. Need a second instance for
   // comparison.
@@ -187,6 +239,128 @@ TEST_F(ProcSystemServiceTest, ResponseIsSuccessfulParse) {
               Eq(comparison_parser->kExpectedExitCode));
 }
 
+TEST_F(ProcSystemServiceTest, ExitProfileRequiresProfiler) {
+  ProcSystemServiceImpl proc_system_service(getpid());
+  ExitProfileRequest request;
+  ExitProfileResponse response;
+  EXPECT_THAT(Status(proc_system_service.GetExitProfile(&context_, &request,
+                                                        &response)),
+              StatusIs(error::GoogleError::FAILED_PRECONDITION));
+}
+
+TEST_F(ProcSystemServiceTest, ExitProfileReportsRecordedCalls) {
+  ExitProfiler profiler;
+  profiler.Record({/*selector=*/5, /*sub_key=*/3}, absl::Nanoseconds(4),
+                  /*bytes_in=*/10, /*bytes_out=*/20);
+  profiler.Record({/*selector=*/5, /*sub_key=*/3}, absl::Nanoseconds(5),
+                  /*bytes_in=*/1, /*bytes_out=*/2);
+
+  ProcSystemServiceImpl proc_system_service(getpid(), &profiler);
+  ExitProfileRequest request;
+  ExitProfileResponse response;
+  ASYLO_ASSERT_OK(Status(
+      proc_system_service.GetExitProfile(&context_, &request, &response)));
+
+  ASSERT_THAT(response.exit_call_stats(), SizeIs(1));
+  const ExitCallStatsProto &stats = response.exit_call_stats(0);
+  EXPECT_THAT(stats.selector(), Eq(5));
+  EXPECT_THAT(stats.sub_key(), Eq(3));
+  EXPECT_THAT(stats.count(), Eq(2));
+  EXPECT_THAT(stats.bytes_in(), Eq(11));
+  EXPECT_THAT(stats.bytes_out(), Eq(22));
+  EXPECT_THAT(stats.total_latency_nanos(), Eq(9));
+  ASSERT_THAT(stats.latency_buckets(), SizeIs(kExitLatencyBuckets));
+  EXPECT_THAT(stats.latency_buckets(2), Eq(2));
+}
+
+TEST_F(ProcSystemServiceTest, WatchRejectsZeroInterval) {
+  ProcSystemServiceImpl proc_system_service(getpid());
+  WatchProcStatsRequest request;
+  FakeSampleWriter writer;
+  EXPECT_THAT(
+      Status(proc_system_service.StreamProcStats(&context_, request, &writer)),
+      StatusIs(error::GoogleError::INVALID_ARGUMENT));
+  EXPECT_THAT(writer.samples(), IsEmpty());
+}
+
+TEST_F(ProcSystemServiceTest, WatchSendsOnlyChangedFields) {
+  auto mock_parser = absl::make_unique<MockProcSystemParser>();
+  const auto comparison_parser = mock_parser.get();
+  const std::string changed_contents =
+      absl::StrReplaceAll(mock_parser->stat_contents(),
+                          {{absl::StrCat(" ", mock_parser->kExpectedUTime, " "),
+                            " 13000 "}});
+  EXPECT_CALL(*mock_parser, ReadProcStat(_, _))
+      .WillOnce(mock_parser->ReadStatContents())
+      .WillRepeatedly([&changed_contents](pid_t pid, std::string *buffer) {
+        *buffer = changed_contents;
+        return Status::OkStatus();
+      });
+  MockProcSystemService mock_service(std::move(mock_parser),
+                                     comparison_parser->kExpectedPid);
+
+  FakeSampleWriter writer;
+  ASYLO_ASSERT_OK(Status(
+      mock_service.StreamProcStats(&context_, WatchRequest(3), &writer)));
+  ASSERT_THAT(writer.samples(), SizeIs(3));
+
+  const ProcStatsSample &first = writer.samples()[0];
+  EXPECT_THAT(first.sequence(), Eq(0));
+  EXPECT_THAT(first.sc_clk_tck(), Gt(0));
+  EXPECT_THAT(first.proc_stat().pid(), Eq(comparison_parser->kExpectedPid));
+  EXPECT_THAT(first.proc_stat().utime(),
+              Eq(comparison_parser->kExpectedUTime));
+
+  const ProcStatsSample &second = writer.samples()[1];
+  EXPECT_THAT(second.sequence(), Eq(1));
+  EXPECT_FALSE(second.has_sc_clk_tck());
+  EXPECT_FALSE(second.proc_stat().has_pid());
+  EXPECT_FALSE(second.proc_stat().has_comm());
+  EXPECT_THAT(second.proc_stat().utime(), Eq(13000));
+
+  ProcStat merged = first.proc_stat();
+  merged.MergeFrom(second.proc_stat());
+  EXPECT_THAT(merged.stime(), Eq(comparison_parser->kExpectedSTime));
+  EXPECT_THAT(merged.utime(), Eq(13000));
+
+  EXPECT_THAT(writer.samples()[2].proc_stat().ByteSizeLong(), Eq(0));
+}
+
+TEST_F(ProcSystemServiceTest, WatchSendsChangedExitCallStats) {
+  ExitProfiler profiler;
+  profiler.Record({/*selector=*/5, /*sub_key=*/3}, absl::Nanoseconds(4),
+                  /*bytes_in=*/10, /*bytes_out=*/20);
+  ProcSystemServiceImpl proc_system_service(getpid(), &profiler);
+
+  // A call to selector 6 is made once the first sample is written.
+  FakeSampleWriter writer;
+  writer.set_on_write([&writer, &profiler] {
+    if (writer.samples().size() == 1) {
+      profiler.Record({/*selector=*/6, /*sub_key=*/kUnclassifiedExit},
+                      absl::Nanoseconds(4), /*bytes_in=*/1, /*bytes_out=*/2);
+    }
+  });
+  ASYLO_ASSERT_OK(Status(proc_system_service.StreamProcStats(
+      &context_, WatchRequest(3), &writer)));
+  ASSERT_THAT(writer.samples(), SizeIs(3));
+
+  ASSERT_THAT(writer.samples()[0].exit_call_stats(), SizeIs(1));
+  EXPECT_THAT(writer.samples()[0].exit_call_stats(0).selector(), Eq(5));
+  ASSERT_THAT(writer.samples()[1].exit_call_stats(), SizeIs(1));
+  EXPECT_THAT(writer.samples()[1].exit_call_stats(0).selector(), Eq(6));
+  EXPECT_THAT(writer.samples()[1].exit_call_stats(0).count(), Eq(1));
+  EXPECT_THAT(writer.samples()[2].exit_call_stats(), IsEmpty());
+}
+
+TEST_F(ProcSystemServiceTest, WatchStopsWhenWriteFails) {
+  ProcSystemServiceImpl proc_system_service(getpid());
+  FakeSampleWriter writer(/*capacity=*/2);
+  EXPECT_THAT(Status(proc_system_service.StreamProcStats(
+                  &context_, WatchRequest(/*max_samples=*/0), &writer)),
+              StatusIs(error::GoogleError::CANCELLED));
+  EXPECT_THAT(writer.samples(), SizeIs(2));
+}
+
 }  // namespace
 }  // namespace primitives
 }  // namespace asylo
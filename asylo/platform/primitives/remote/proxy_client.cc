@@ -24,6 +24,7 @@
 #include <utility>
 
 #include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
 #include "asylo/util/logging.h"
 #include "asylo/platform/primitives/dlopen/loader.pb.h"
 #include "asylo/platform/primitives/primitives.h"
@@ -33,6 +34,7 @@
 #include "asylo/platform/primitives/sgx/loader.pb.h"
 #include "asylo/platform/primitives/untrusted_primitives.h"
 #include "asylo/platform/primitives/util/message.h"
+#include "asylo/platform/primitives/util/trace_context.h"
 #include "asylo/util/remote/remote_proxy_config.h"
 #include "asylo/util/status.h"
 #include "asylo/util/status_macros.h"
@@ -47,10 +49,14 @@ RemoteEnclaveProxyClient::RemoteEnclaveProxyClient(
     std::unique_ptr<ExitCallProvider> exit_call_provider)
     : Client(name, std::move(exit_call_provider)),
       config_(std::move(remote_proxy_config)),
-      communicator_(absl::make_unique<Communicator>(/*is_host=*/true)),
+      communicator_(std::make_shared<Communicator>(/*is_host=*/true)),
+      failover_exhausted_(!config_->failover_enabled()),
+      destroyed_(false),
       loader_case_(loader_case) {}
 
 RemoteEnclaveProxyClient::~RemoteEnclaveProxyClient() {
+  // Pending asynchronous calls still go through |communicator_|.
+  StopAsyncEntryThreads();
   if (IsClosed()) {
     return;
   }
@@ -61,12 +67,19 @@ Status RemoteEnclaveProxyClient::Destroy() {
   if (IsClosed()) {
     return Status::OkStatus();
   }
-  MessageReader disconnect_out;
-  const auto status =
-      EnclaveCall(kSelectorRemoteDisconnect, nullptr, &disconnect_out);
-  LOG_IF(WARNING, !status.ok())
-      << "EnclaveCall(kSelectorRemoteDisconnect) failed with status=" << status;
-  communicator_->Disconnect();
+  const std::shared_ptr<Communicator> communicator = current_communicator();
+  // There is no point in launching a new proxy only to disconnect from it.
+  if (!communicator->connection_lost()) {
+    ScopedCurrentClient scoped_client(this);
+    MessageReader disconnect_out;
+    const auto status = InvokeOn(communicator.get(), kSelectorRemoteDisconnect,
+                                 nullptr, &disconnect_out);
+    LOG_IF(WARNING, !status.ok())
+        << "EnclaveCall(kSelectorRemoteDisconnect) failed with status="
+        << status;
+  }
+  destroyed_.store(true);
+  communicator->Disconnect();
   config_->RunFinalize();
   return Status::OkStatus();
 }
@@ -78,10 +91,17 @@ Status RemoteEnclaveProxyClient::EnclaveCallInternal(uint64_t selector,
     return Status{error::GoogleError::FAILED_PRECONDITION,
                   "No connection to remote proxy server"};
   }
+  std::shared_ptr<Communicator> communicator;
+  ASYLO_ASSIGN_OR_RETURN(communicator, ConnectedCommunicator());
+  return InvokeOn(communicator.get(), selector, in, out);
+}
 
+Status RemoteEnclaveProxyClient::InvokeOn(Communicator *communicator,
+                                          uint64_t selector, MessageWriter *in,
+                                          MessageReader *out) {
   Status status;
   // Both callbacks are dispatched to this_thread.
-  communicator_->Invoke(
+  communicator->Invoke(
       selector,
       [in](Communicator::Invocation *invocation) {
         if (in) {
@@ -100,7 +120,69 @@ Status RemoteEnclaveProxyClient::EnclaveCallInternal(uint64_t selector,
 }
 
 bool RemoteEnclaveProxyClient::IsClosed() const {
-  return !communicator_->IsConnected();
+  if (destroyed_.load()) {
+    return true;
+  }
+  const std::shared_ptr<Communicator> communicator = current_communicator();
+  if (communicator->IsConnected()) {
+    return false;
+  }
+  // A lost proxy keeps the enclave open as long as it may be replaced.
+  return !communicator->connection_lost() || failover_exhausted_.load();
+}
+
+StatusOr<std::shared_ptr<Communicator>>
+RemoteEnclaveProxyClient::ConnectedCommunicator() {
+  std::shared_ptr<Communicator> communicator = current_communicator();
+  if (!communicator->connection_lost()) {
+    return communicator;
+  }
+  absl::MutexLock lock(&failover_mu_);
+  // Another thread may have failed over in the meantime.
+  communicator = current_communicator();
+  if (!communicator->connection_lost()) {
+    return communicator;
+  }
+  if (failover_exhausted_.load()) {
+    return Status{error::GoogleError::UNAVAILABLE,
+                  "Connection to remote proxy server lost"};
+  }
+  ASYLO_RETURN_IF_ERROR(FailOver());
+  return current_communicator();
+}
+
+Status RemoteEnclaveProxyClient::FailOver() {
+  Status status{error::GoogleError::UNAVAILABLE,
+                "Connection to remote proxy server lost"};
+  if (config_->reconnect_enabled()) {
+    // Reap the lost proxy before launching its replacement.
+    config_->RunFinalize();
+    status = ReplaceCommunicator();
+    if (status.ok()) {
+      return status;
+    }
+    LOG(WARNING) << "Failed to reconnect to remote proxy server: " << status;
+  }
+  while (config_->SwitchToStandbyProvision()) {
+    status = ReplaceCommunicator();
+    if (status.ok()) {
+      return status;
+    }
+    LOG(WARNING) << "Failed to fail over to standby proxy server: " << status;
+  }
+  failover_exhausted_.store(true);
+  config_->RunFinalize();
+  return status;
+}
+
+Status RemoteEnclaveProxyClient::ReplaceCommunicator() {
+  auto communicator = std::make_shared<Communicator>(/*is_host=*/true);
+  ASYLO_RETURN_IF_ERROR(communicator->StartServer(config_->server_creds()));
+  ASYLO_RETURN_IF_ERROR(ConnectCommunicator(communicator.get(), load_config_));
+  LOG(INFO) << "Enclave " << Name() << " failed over to a new proxy server";
+  // The lost Communicator is destroyed once the calls still holding it return.
+  communicator_.Lock()->swap(communicator);
+  return Status::OkStatus();
 }
 
 Status RemoteEnclaveProxyClient::Connect(const EnclaveLoadConfig &load_config) {
@@ -108,7 +190,15 @@ Status RemoteEnclaveProxyClient::Connect(const EnclaveLoadConfig &load_config) {
     return Status{error::GoogleError::ALREADY_EXISTS,
                   "Client is already connected to server"};
   }
+  {
+    absl::MutexLock lock(&failover_mu_);
+    load_config_ = load_config;
+  }
+  return ConnectCommunicator(current_communicator().get(), load_config);
+}
 
+Status RemoteEnclaveProxyClient::ConnectCommunicator(
+    Communicator *communicator, const EnclaveLoadConfig &load_config) {
   // Make a copy of load configuration, because enclave_path may need to change:
   // for example, if the remote proxy is going to run on a different machine,
   // enclave_path would need to refer to a copy of the enclave binary
@@ -154,31 +244,27 @@ Status RemoteEnclaveProxyClient::Connect(const EnclaveLoadConfig &load_config) {
   }
   ASYLO_ASSIGN_OR_RETURN(
       *enclave_path,
-      config_->RunProvision(communicator()->server_port(), *enclave_path));
+      config_->RunProvision(communicator->server_port(), *enclave_path));
 
   // Receive address of the target server, which client will need to connect to.
-  const std::string target_address = communicator_->WaitForEndPointAddress();
+  const std::string target_address = communicator->WaitForEndPointAddress();
 
   // Establish connection to the target server.
-  ASYLO_RETURN_IF_ERROR(communicator_->Connect(*config_, target_address));
+  ASYLO_RETURN_IF_ERROR(communicator->Connect(*config_, target_address));
 
   // Set up dispatch of ExitCalls calls from remote Enclave server.
-  communicator_->set_handler(
+  communicator->set_handler(
       [this](std::unique_ptr<Communicator::Invocation> invocation) {
-        if (invocation->selector >= kSelectorRemote &&
-            invocation->selector < kSelectorUser) {
+        const uint64_t selector =
+            invocation->selector & ~kTraceContextSelectorBit;
+        if (selector >= kSelectorRemote && selector < kSelectorUser) {
           invocation->status = Status{error::GoogleError::FAILED_PRECONDITION,
                                       "Invalid selector received from proxy"};
           return;
         }
-        if (!exit_call_provider()) {
-          invocation->status = Status{error::GoogleError::FAILED_PRECONDITION,
-                                      "Exit call provider not set yet."};
-          return;
-        }
-        invocation->status = exit_call_provider()->InvokeExitHandler(
-            invocation->selector, &invocation->reader, &invocation->writer,
-            this);
+        invocation->status =
+            InvokeExitHandler(invocation->selector, &invocation->reader,
+                              &invocation->writer);
       });
 
   std::string buffer;
@@ -191,9 +277,10 @@ Status RemoteEnclaveProxyClient::Connect(const EnclaveLoadConfig &load_config) {
   load_in.PushByCopy(Extent(buffer.c_str(), buffer.size()));
 
   // Request proxy server to load the enclave.
+  ScopedCurrentClient scoped_client(this);
   MessageReader load_out;
   ASYLO_RETURN_IF_ERROR(
-      EnclaveCall(kSelectorRemoteConnect, &load_in, &load_out));
+      InvokeOn(communicator, kSelectorRemoteConnect, &load_in, &load_out));
 
   // Ready to forward EnclaveCalls to remote server and receive ExitCalls back.
   return Status::OkStatus();
@@ -19,13 +19,17 @@
 #ifndef ASYLO_PLATFORM_PRIMITIVES_REMOTE_PROXY_CLIENT_H_
 #define ASYLO_PLATFORM_PRIMITIVES_REMOTE_PROXY_CLIENT_H_
 
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
 #include <functional>
 #include <memory>
 #include <string>
 
+#include "absl/base/thread_annotations.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "asylo/enclave.pb.h"
 #include "asylo/platform/primitives/extent.h"
 #include "asylo/platform/primitives/primitive_status.h"
@@ -33,6 +37,7 @@
 #include "asylo/platform/primitives/remote/metrics/clients/opencensus_client.h"
 #include "asylo/platform/primitives/untrusted_primitives.h"
 #include "asylo/platform/primitives/util/message.h"
+#include "asylo/util/mutex_guarded.h"
 #include "asylo/util/remote/remote_loader.pb.h"
 #include "asylo/util/status.h"
 #include "asylo/util/statusor.h"
@@ -77,6 +82,11 @@ namespace primitives {
 // RemoteEnclaveProxyClient-RemoteEnclaveProxyServer pair encapsulates all
 // communications between untrusted primitives in the host process and trusted
 // primitives in the target process.
+//
+// If the configuration enables health checking, a proxy that stops responding
+// is detected within a bounded time, failing the calls in flight. If it also
+// enables reconnecting or standby provisions, the next call then launches a
+// replacement proxy and loads the enclave there anew.
 class RemoteEnclaveProxyClient : public Client {
  public:
   // Prepares RemoteEnclaveProxyClient to connect to the remote process
@@ -95,15 +105,28 @@ class RemoteEnclaveProxyClient : public Client {
                              MessageReader *out) override;
   bool IsClosed() const override;
 
+  // Remote calls spend most of their time waiting on the channel rather than
+  // running, so the pool serving EnclaveCallAsync() is much deeper than for
+  // local backends, keeping that many calls in flight at once.
+  size_t AsyncEntryThreads() const override { return kAsyncEntryThreads; }
+
   // Establishes connection to the remote proxy server, running on another
   // process.
   Status Connect(const EnclaveLoadConfig &load_config);
 
   ASYLO_MUST_USE_RESULT Status RegisterExitHandlers() override;
 
-  Communicator *communicator() const { return communicator_.get(); }
+  // Returns the Communicator connected to the current proxy, which is replaced
+  // when the client fails over to a new proxy.
+  Communicator *communicator() const { return current_communicator().get(); }
 
  private:
+  static constexpr size_t kAsyncEntryThreads = 64;
+
+  // Invokes |selector| on the proxy through |communicator|.
+  static Status InvokeOn(Communicator *communicator, uint64_t selector,
+                         MessageWriter *in, MessageReader *out);
+
   // Constructor is private, so that it can only be called by the Create()
   // factory method.
   RemoteEnclaveProxyClient(
@@ -113,11 +136,46 @@ class RemoteEnclaveProxyClient : public Client {
 
   Status StartServer();
 
+  std::shared_ptr<Communicator> current_communicator() const {
+    return *communicator_.ReaderLock();
+  }
+
+  // Provisions a proxy, connects |communicator| to it and has it load the
+  // enclave with |load_config|.
+  Status ConnectCommunicator(Communicator *communicator,
+                             const EnclaveLoadConfig &load_config);
+
+  // Returns the current Communicator, after replacing it with one connected
+  // to a new proxy if it has lost the connection.
+  StatusOr<std::shared_ptr<Communicator>> ConnectedCommunicator()
+      ABSL_LOCKS_EXCLUDED(failover_mu_);
+
+  // Replaces the Communicator that lost the connection with one connected to
+  // a new proxy: launched by the same provision if reconnecting is enabled,
+  // and failing that by each standby provision in turn.
+  Status FailOver() ABSL_EXCLUSIVE_LOCKS_REQUIRED(failover_mu_);
+
+  // Launches a new proxy with the current provision and makes it current.
+  Status ReplaceCommunicator() ABSL_EXCLUSIVE_LOCKS_REQUIRED(failover_mu_);
+
   // Configuration of RemoteEnclave
   std::unique_ptr<RemoteProxyClientConfig> config_;
 
-  // Host-side instance of Communicator.
-  const std::unique_ptr<Communicator> communicator_;
+  // Host-side instance of Communicator. Calls in flight keep a reference to
+  // the instance they were issued on, which may be replaced in the meantime.
+  MutexGuarded<std::shared_ptr<Communicator>> communicator_;
+
+  // Serializes failovers. The load configuration given to Connect() is kept
+  // to load the enclave again in a replacement proxy.
+  absl::Mutex failover_mu_;
+  EnclaveLoadConfig load_config_ ABSL_GUARDED_BY(failover_mu_);
+
+  // Set once every way to replace a lost proxy has failed, or if none was
+  // configured.
+  std::atomic<bool> failover_exhausted_;
+
+  // Set by Destroy().
+  std::atomic<bool> destroyed_;
 
   // Loader type of the RemoteLoadConfig, eg. kSgxLoadConfig, kDlopenLoadConfig.
   const RemoteLoadConfig::LoaderCase loader_case_;
@@ -20,6 +20,7 @@
 
 #include <cstdint>
 #include <memory>
+#include <utility>
 
 #include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
@@ -170,8 +171,12 @@ Status RemoteEnclaveProxyServer::Start(
             invocation->status = local_enclave_client_->EnclaveCall(
                 invocation->selector, &in, &out);
             if (invocation->status.ok()) {
-              while (out.hasNext()) {
-                invocation->writer.PushByCopy(out.next());
+              // The parameters have been consumed. Keep the results alive in
+              // the invocation instead, so that they are serialized into the
+              // response by reference.
+              invocation->reader = std::move(out);
+              while (invocation->reader.hasNext()) {
+                invocation->writer.PushByReference(invocation->reader.next());
               }
             }
         }
@@ -0,0 +1,364 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/primitives/remote/shared_memory_transport.h"
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/escaping.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "asylo/util/logging.h"
+#include "asylo/util/posix_error_space.h"
+#include "asylo/util/status_macros.h"
+#include "openssl/rand.h"
+
+namespace asylo {
+namespace primitives {
+
+// Header of one ring, followed by |capacity| bytes of data. |head| and |tail|
+// count the bytes ever written and read; their difference is the number of
+// bytes in the ring. Each frame is a 32-bit length followed by that many
+// bytes, and may wrap around the end of the data.
+struct SharedMemoryRing {
+  alignas(64) std::atomic<uint64_t> head;
+  alignas(64) std::atomic<uint64_t> tail;
+  alignas(64) std::atomic<uint32_t> wake_sequence;
+  std::atomic<uint32_t> reader_sleeping;
+  std::atomic<uint32_t> closed;
+  uint64_t capacity;
+
+  char *data() { return reinterpret_cast<char *>(this + 1); }
+};
+
+namespace {
+
+constexpr uint64_t kSegmentMagic = 0x6d68735f6f6c7961;  // "aylo_shm"
+constexpr size_t kNonceSize = 16;
+constexpr size_t kNameRandomSize = 8;
+constexpr size_t kFrameHeaderSize = sizeof(uint32_t);
+
+// Number of times the receiving thread polls an empty ring before it sleeps.
+constexpr int kSpinIterations = 4096;
+
+// Longest time the receiving thread sleeps without checking the ring.
+constexpr absl::Duration kMaxSleep = absl::Milliseconds(100);
+
+// Time a sender waits before checking a full ring again.
+constexpr absl::Duration kFullRingBackoff = absl::Microseconds(20);
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+              "Futex words must be plain 32-bit integers");
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "Ring positions must be lock-free to be shared across processes");
+
+struct SegmentHeader {
+  alignas(64) uint64_t magic;
+  uint64_t ring_capacity;
+  char nonce[kNonceSize];
+};
+
+size_t RingStride(size_t ring_capacity) {
+  return sizeof(SharedMemoryRing) + ring_capacity;
+}
+
+size_t SegmentSize(size_t ring_capacity) {
+  return sizeof(SegmentHeader) + 2 * RingStride(ring_capacity);
+}
+
+void FutexWait(std::atomic<uint32_t> *word, uint32_t expected,
+               absl::Duration timeout) {
+  const timespec ts = absl::ToTimespec(timeout);
+  syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), FUTEX_WAIT, expected,
+          &ts, nullptr, 0);
+}
+
+void FutexWakeAll(std::atomic<uint32_t> *word) {
+  syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), FUTEX_WAKE, INT32_MAX,
+          nullptr, nullptr, 0);
+}
+
+void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
+
+StatusOr<std::string> RandomBytes(size_t size) {
+  std::string bytes(size, '\0');
+  if (RAND_bytes(reinterpret_cast<uint8_t *>(&bytes[0]), bytes.size()) != 1) {
+    return Status(error::GoogleError::INTERNAL, "RAND_bytes failed");
+  }
+  return bytes;
+}
+
+// Copies |size| bytes from |src| into |ring| at position |pos|, wrapping
+// around the end of the ring.
+void CopyIn(SharedMemoryRing *ring, uint64_t pos, const void *src,
+            size_t size) {
+  const size_t offset = pos % ring->capacity;
+  const size_t first = std::min<size_t>(size, ring->capacity - offset);
+  memcpy(ring->data() + offset, src, first);
+  memcpy(ring->data(), static_cast<const char *>(src) + first, size - first);
+}
+
+// Copies |size| bytes from |ring| at position |pos| into |dst|, wrapping
+// around the end of the ring.
+void CopyOut(SharedMemoryRing *ring, uint64_t pos, void *dst,
+             size_t size) {
+  const size_t offset = pos % ring->capacity;
+  const size_t first = std::min<size_t>(size, ring->capacity - offset);
+  memcpy(dst, ring->data() + offset, first);
+  memcpy(static_cast<char *>(dst) + first, ring->data(), size - first);
+}
+
+SharedMemoryRing *RingAt(void *segment, int index) {
+  auto *header = static_cast<SegmentHeader *>(segment);
+  char *base = reinterpret_cast<char *>(header + 1);
+  return reinterpret_cast<SharedMemoryRing *>(
+      base + index * RingStride(header->ring_capacity));
+}
+
+void CloseRing(SharedMemoryRing *ring) {
+  ring->closed.store(1);
+  ring->wake_sequence.fetch_add(1);
+  FutexWakeAll(&ring->wake_sequence);
+}
+
+}  // namespace
+
+StatusOr<std::unique_ptr<SharedMemoryTransport>> SharedMemoryTransport::Create(
+    size_t ring_capacity) {
+  // Keep both rings cache-line aligned.
+  ring_capacity = (ring_capacity + 63) & ~static_cast<size_t>(63);
+  if (ring_capacity <= kFrameHeaderSize) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Shared memory ring is too small");
+  }
+
+  std::string name_random;
+  ASYLO_ASSIGN_OR_RETURN(name_random, RandomBytes(kNameRandomSize));
+  std::string nonce;
+  ASYLO_ASSIGN_OR_RETURN(nonce, RandomBytes(kNonceSize));
+  const std::string name = absl::StrCat("/asylo_communicator_", getpid(), "_",
+                                        absl::BytesToHexString(name_random));
+
+  const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0) {
+    return Status(static_cast<error::PosixError>(errno),
+                  absl::StrCat("shm_open(", name, ") failed"));
+  }
+  const size_t segment_size = SegmentSize(ring_capacity);
+  void *segment = MAP_FAILED;
+  if (ftruncate(fd, segment_size) == 0) {
+    segment = mmap(nullptr, segment_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                   fd, 0);
+  }
+  const int saved_errno = errno;
+  close(fd);
+  if (segment == MAP_FAILED) {
+    shm_unlink(name.c_str());
+    return Status(static_cast<error::PosixError>(saved_errno),
+                  absl::StrCat("Failed to map ", name));
+  }
+
+  // The segment is zero-filled, so only the non-zero fields need to be set.
+  auto *header = new (segment) SegmentHeader();
+  header->ring_capacity = ring_capacity;
+  memcpy(header->nonce, nonce.data(), kNonceSize);
+  for (int i = 0; i < 2; ++i) {
+    new (RingAt(segment, i)) SharedMemoryRing();
+    RingAt(segment, i)->capacity = ring_capacity;
+  }
+  header->magic = kSegmentMagic;
+
+  return absl::WrapUnique(new SharedMemoryTransport(
+      name, std::move(nonce), segment, segment_size, /*is_creator=*/true));
+}
+
+StatusOr<std::unique_ptr<SharedMemoryTransport>> SharedMemoryTransport::Open(
+    absl::string_view name, absl::string_view nonce) {
+  const std::string name_string(name);
+  const int fd = shm_open(name_string.c_str(), O_RDWR, 0);
+  if (fd < 0) {
+    return Status(static_cast<error::PosixError>(errno),
+                  absl::StrCat("shm_open(", name, ") failed"));
+  }
+  struct stat stat_buffer;
+  void *segment = MAP_FAILED;
+  if (fstat(fd, &stat_buffer) == 0 &&
+      stat_buffer.st_size >= static_cast<off_t>(sizeof(SegmentHeader))) {
+    segment = mmap(nullptr, stat_buffer.st_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED, fd, 0);
+  }
+  const int saved_errno = errno;
+  close(fd);
+  if (segment == MAP_FAILED) {
+    return Status(static_cast<error::PosixError>(saved_errno),
+                  absl::StrCat("Failed to map ", name));
+  }
+
+  const auto *header = static_cast<const SegmentHeader *>(segment);
+  const size_t segment_size = stat_buffer.st_size;
+  if (header->magic != kSegmentMagic || nonce.size() != kNonceSize ||
+      memcmp(header->nonce, nonce.data(), kNonceSize) != 0 ||
+      SegmentSize(header->ring_capacity) != segment_size) {
+    munmap(segment, segment_size);
+    return Status(error::GoogleError::FAILED_PRECONDITION,
+                  absl::StrCat(name, " is not the offered segment"));
+  }
+  return absl::WrapUnique(
+      new SharedMemoryTransport(name_string, std::string(nonce), segment,
+                                segment_size, /*is_creator=*/false));
+}
+
+SharedMemoryTransport::SharedMemoryTransport(std::string name,
+                                             std::string nonce, void *segment,
+                                             size_t segment_size,
+                                             bool is_creator)
+    : name_(std::move(name)),
+      nonce_(std::move(nonce)),
+      segment_(segment),
+      segment_size_(segment_size),
+      is_creator_(is_creator),
+      outgoing_(RingAt(segment, is_creator ? 0 : 1)),
+      incoming_(RingAt(segment, is_creator ? 1 : 0)) {}
+
+SharedMemoryTransport::~SharedMemoryTransport() {
+  Close();
+  if (is_creator_) {
+    Unlink();
+  }
+  munmap(segment_, segment_size_);
+}
+
+void SharedMemoryTransport::Unlink() {
+  if (shm_unlink(name_.c_str()) != 0 && errno != ENOENT) {
+    LOG(WARNING) << "shm_unlink(" << name_ << ") failed: " << strerror(errno);
+  }
+}
+
+void SharedMemoryTransport::Start(Receiver receiver) {
+  CHECK(!receive_thread_) << "SharedMemoryTransport already started";
+  receiver_ = std::move(receiver);
+  receive_thread_ = absl::make_unique<Thread>([this] { ReceiveLoop(); });
+}
+
+Status SharedMemoryTransport::Send(absl::string_view frame) {
+  const uint64_t frame_size = kFrameHeaderSize + frame.size();
+  if (frame_size > outgoing_->capacity) {
+    return Status(
+        error::GoogleError::RESOURCE_EXHAUSTED,
+        absl::StrCat("Frame of ", frame.size(),
+                     " bytes does not fit in the shared memory ring"));
+  }
+
+  absl::MutexLock lock(&send_mu_);
+  // Only this side writes |head|, so it cannot change under us.
+  const uint64_t head = outgoing_->head.load(std::memory_order_relaxed);
+  while (outgoing_->capacity -
+             (head - outgoing_->tail.load(std::memory_order_acquire)) <
+         frame_size) {
+    if (outgoing_->closed.load() != 0) {
+      break;
+    }
+    absl::SleepFor(kFullRingBackoff);
+  }
+  if (outgoing_->closed.load() != 0) {
+    return Status(error::GoogleError::CANCELLED,
+                  "Shared memory transport is closed");
+  }
+
+  const uint32_t size = frame.size();
+  CopyIn(outgoing_, head, &size, kFrameHeaderSize);
+  CopyIn(outgoing_, head + kFrameHeaderSize, frame.data(), frame.size());
+
+  // Publishing |head| and then checking |reader_sleeping| pairs with the
+  // reader setting |reader_sleeping| and then checking |head|: with sequential
+  // consistency, at least one of the two sides sees the other's write.
+  outgoing_->head.store(head + frame_size);
+  if (outgoing_->reader_sleeping.load() != 0) {
+    outgoing_->wake_sequence.fetch_add(1);
+    FutexWakeAll(&outgoing_->wake_sequence);
+  }
+  return Status::OkStatus();
+}
+
+void SharedMemoryTransport::Close() {
+  CloseRing(outgoing_);
+  CloseRing(incoming_);
+  if (receive_thread_) {
+    receive_thread_->Join();
+    receive_thread_.reset();
+  }
+}
+
+void SharedMemoryTransport::ReceiveLoop() {
+  int spins = 0;
+  for (;;) {
+    // Only this side writes |tail|, so it cannot change under us.
+    const uint64_t tail = incoming_->tail.load(std::memory_order_relaxed);
+    if (incoming_->head.load(std::memory_order_acquire) != tail) {
+      uint32_t size;
+      CopyOut(incoming_, tail, &size, kFrameHeaderSize);
+      std::string frame(size, '\0');
+      CopyOut(incoming_, tail + kFrameHeaderSize, &frame[0], size);
+      incoming_->tail.store(tail + kFrameHeaderSize + size,
+                            std::memory_order_release);
+      receiver_(std::move(frame));
+      spins = 0;
+      continue;
+    }
+    if (incoming_->closed.load() != 0) {
+      return;
+    }
+    if (++spins < kSpinIterations) {
+      CpuRelax();
+      continue;
+    }
+
+    // The ring has stayed empty: sleep until the sender wakes us up. Reading
+    // |wake_sequence| first makes the wait return at once if a wake-up
+    // happens before it starts.
+    const uint32_t sequence = incoming_->wake_sequence.load();
+    incoming_->reader_sleeping.store(1);
+    if (incoming_->head.load() == tail && incoming_->closed.load() == 0) {
+      FutexWait(&incoming_->wake_sequence, sequence, kMaxSleep);
+    }
+    incoming_->reader_sleeping.store(0);
+    spins = 0;
+  }
+}
+
+}  // namespace primitives
+}  // namespace asylo
@@ -0,0 +1,124 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_PRIMITIVES_REMOTE_SHARED_MEMORY_TRANSPORT_H_
+#define ASYLO_PLATFORM_PRIMITIVES_REMOTE_SHARED_MEMORY_TRANSPORT_H_
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "asylo/util/status.h"
+#include "asylo/util/statusor.h"
+#include "asylo/util/thread.h"
+
+namespace asylo {
+namespace primitives {
+
+// Header of one ring in the shared memory segment of a SharedMemoryTransport.
+struct SharedMemoryRing;
+
+// A pair of byte rings in a POSIX shared memory segment, carrying frames
+// between two processes on the same machine: one ring in each direction.
+//
+// One side creates the segment with Create() and passes its name and nonce to
+// the other side over some other channel. The other side maps the segment with
+// Open(), which fails unless it finds the same nonce in it, proving that both
+// processes share the segment (and thus the machine). Once both sides have
+// mapped it, the segment name can be unlinked.
+//
+// Frames are delivered in order to a receiver callback running on a dedicated
+// thread. The receiving thread spins briefly on an empty ring before it
+// sleeps on a futex, so that back-to-back messages are picked up without a
+// context switch.
+//
+// Send() is thread-safe. Close() marks both rings closed, which stops the
+// receiving threads on both sides.
+class SharedMemoryTransport {
+ public:
+  // Callback receiving every frame sent by the counterpart.
+  using Receiver = std::function<void(std::string frame)>;
+
+  // Creates a new segment holding two rings of |ring_capacity| bytes each.
+  static StatusOr<std::unique_ptr<SharedMemoryTransport>> Create(
+      size_t ring_capacity);
+
+  // Maps the segment named |name| created by the counterpart, and verifies
+  // that it holds |nonce|.
+  static StatusOr<std::unique_ptr<SharedMemoryTransport>> Open(
+      absl::string_view name, absl::string_view nonce);
+
+  SharedMemoryTransport(const SharedMemoryTransport &other) = delete;
+  SharedMemoryTransport &operator=(const SharedMemoryTransport &other) =
+      delete;
+
+  // Closes the transport and unmaps the segment.
+  ~SharedMemoryTransport();
+
+  // Name and nonce of the segment, to be passed to Open() by the counterpart.
+  const std::string &name() const { return name_; }
+  const std::string &nonce() const { return nonce_; }
+
+  // Removes the name of the segment, so that no other process can open it.
+  // The creator also removes it when it is destroyed.
+  void Unlink();
+
+  // Starts delivering frames sent by the counterpart to |receiver|, on a
+  // dedicated thread. Must be called at most once.
+  void Start(Receiver receiver);
+
+  // Writes |frame| to the outgoing ring, waiting for room if the ring is full.
+  // Fails if the frame can never fit in the ring, or if the transport has been
+  // closed by either side.
+  Status Send(absl::string_view frame) ABSL_LOCKS_EXCLUDED(send_mu_);
+
+  // Marks both rings closed and joins the receiving thread.
+  void Close();
+
+ private:
+  SharedMemoryTransport(std::string name, std::string nonce, void *segment,
+                        size_t segment_size, bool is_creator);
+
+  // Body of the receiving thread.
+  void ReceiveLoop();
+
+  const std::string name_;
+  const std::string nonce_;
+  void *const segment_;
+  const size_t segment_size_;
+  const bool is_creator_;
+
+  // Ring this side writes to, and ring it reads from.
+  SharedMemoryRing *const outgoing_;
+  SharedMemoryRing *const incoming_;
+
+  // Serializes writers of |outgoing_|, which is single-producer.
+  absl::Mutex send_mu_;
+
+  Receiver receiver_;
+  std::unique_ptr<Thread> receive_thread_;
+};
+
+}  // namespace primitives
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_PRIMITIVES_REMOTE_SHARED_MEMORY_TRANSPORT_H_
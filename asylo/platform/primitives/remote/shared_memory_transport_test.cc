@@ -0,0 +1,151 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/primitives/remote/shared_memory_transport.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/synchronization/mutex.h"
+#include "asylo/test/util/status_matchers.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+namespace primitives {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::Not;
+using ::testing::SizeIs;
+
+constexpr size_t kRingCapacity = 256;
+
+// Collects the frames delivered by a SharedMemoryTransport.
+class FrameCollector {
+ public:
+  SharedMemoryTransport::Receiver receiver() {
+    return [this](std::string frame) {
+      absl::MutexLock lock(&mu_);
+      frames_.push_back(std::move(frame));
+    };
+  }
+
+  // Waits until |count| frames have been received and returns them.
+  std::vector<std::string> WaitFor(size_t count) {
+    absl::MutexLock lock(&mu_);
+    expected_ = count;
+    mu_.Await(absl::Condition(this, &FrameCollector::HasExpected));
+    return frames_;
+  }
+
+ private:
+  bool HasExpected() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    return frames_.size() >= expected_;
+  }
+
+  absl::Mutex mu_;
+  std::vector<std::string> frames_ ABSL_GUARDED_BY(mu_);
+  size_t expected_ ABSL_GUARDED_BY(mu_) = 0;
+};
+
+class SharedMemoryTransportTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASYLO_ASSERT_OK_AND_ASSIGN(creator_,
+                               SharedMemoryTransport::Create(kRingCapacity));
+    ASYLO_ASSERT_OK_AND_ASSIGN(
+        opener_,
+        SharedMemoryTransport::Open(creator_->name(), creator_->nonce()));
+    creator_->Unlink();
+  }
+
+  std::unique_ptr<SharedMemoryTransport> creator_;
+  std::unique_ptr<SharedMemoryTransport> opener_;
+};
+
+TEST_F(SharedMemoryTransportTest, DeliversFramesInBothDirections) {
+  FrameCollector to_creator;
+  FrameCollector to_opener;
+  creator_->Start(to_creator.receiver());
+  opener_->Start(to_opener.receiver());
+
+  ASYLO_ASSERT_OK(creator_->Send("ping"));
+  EXPECT_THAT(to_opener.WaitFor(1), ElementsAre("ping"));
+  ASYLO_ASSERT_OK(opener_->Send("pong"));
+  EXPECT_THAT(to_creator.WaitFor(1), ElementsAre("pong"));
+}
+
+TEST_F(SharedMemoryTransportTest, FramesWrapAroundTheRing) {
+  FrameCollector to_opener;
+  opener_->Start(to_opener.receiver());
+
+  // Many more bytes than the ring holds, in frames of uneven sizes, so that
+  // both frame headers and payloads straddle the end of the ring.
+  std::vector<std::string> sent;
+  for (int i = 0; i < 100; ++i) {
+    sent.push_back(std::string(i % 97 + 1, 'a' + i % 26));
+    ASYLO_ASSERT_OK(creator_->Send(sent.back()));
+  }
+  EXPECT_THAT(to_opener.WaitFor(sent.size()), Eq(sent));
+}
+
+TEST_F(SharedMemoryTransportTest, RejectsFramesLargerThanTheRing) {
+  EXPECT_THAT(creator_->Send(std::string(kRingCapacity, 'x')),
+              StatusIs(error::GoogleError::RESOURCE_EXHAUSTED));
+}
+
+TEST_F(SharedMemoryTransportTest, CloseStopsBothSides) {
+  FrameCollector to_opener;
+  opener_->Start(to_opener.receiver());
+  creator_->Close();
+  EXPECT_THAT(creator_->Send("late"),
+              StatusIs(error::GoogleError::CANCELLED));
+  EXPECT_THAT(opener_->Send("late"), StatusIs(error::GoogleError::CANCELLED));
+  // Joins the receiving thread, which has seen the rings closed.
+  opener_->Close();
+  EXPECT_THAT(to_opener.WaitFor(0), SizeIs(0));
+}
+
+TEST(SharedMemoryTransportOpenTest, RejectsWrongNonce) {
+  std::unique_ptr<SharedMemoryTransport> creator;
+  ASYLO_ASSERT_OK_AND_ASSIGN(creator,
+                             SharedMemoryTransport::Create(kRingCapacity));
+  std::string nonce = creator->nonce();
+  nonce[0] ^= 1;
+  EXPECT_THAT(SharedMemoryTransport::Open(creator->name(), nonce),
+              StatusIs(error::GoogleError::FAILED_PRECONDITION));
+}
+
+TEST(SharedMemoryTransportOpenTest, UnlinkedSegmentCannotBeOpened) {
+  std::unique_ptr<SharedMemoryTransport> creator;
+  ASYLO_ASSERT_OK_AND_ASSIGN(creator,
+                             SharedMemoryTransport::Create(kRingCapacity));
+  creator->Unlink();
+  EXPECT_THAT(
+      SharedMemoryTransport::Open(creator->name(), creator->nonce()).status(),
+      Not(IsOk()));
+}
+
+}  // namespace
+}  // namespace primitives
+}  // namespace asylo
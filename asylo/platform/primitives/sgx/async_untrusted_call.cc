@@ -0,0 +1,93 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/primitives/sgx/async_untrusted_call.h"
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#include "asylo/platform/core/task_scheduler.h"
+#include "asylo/platform/host_call/trusted/host_calls.h"
+#include "asylo/platform/primitives/trusted_primitives.h"
+
+namespace asylo {
+namespace primitives {
+namespace {
+
+// Upper bound on a single sleep on the completion word. Bounding the sleep lets
+// the waiter notice that the untrusted workers were stopped before servicing
+// the call.
+constexpr uint64_t kCompletionWaitMicros = 10000;
+
+}  // namespace
+
+std::unique_ptr<UntrustedCallFuture> UntrustedCallFuture::Start(
+    uint64_t untrusted_selector, MessageWriter *input) {
+  std::unique_ptr<UntrustedCallFuture> future(new UntrustedCallFuture());
+  future->call_ = AsyncSwitchlessCall::Post(untrusted_selector, input);
+  if (!future->call_) {
+    future->status_ = TrustedPrimitives::UntrustedCall(untrusted_selector,
+                                                       input, &future->output_);
+  }
+  return future;
+}
+
+bool UntrustedCallFuture::Poll() const { return !call_ || call_->IsDone(); }
+
+PrimitiveStatus UntrustedCallFuture::Wait(MessageReader *output) {
+  if (!call_) {
+    *output = std::move(output_);
+    return status_;
+  }
+
+  while (!call_->IsDone()) {
+    if (call_->TryReclaimAfterShutdown()) {
+      call_.reset();
+      return {error::GoogleError::UNAVAILABLE,
+              "Switchless workers stopped before servicing the call."};
+    }
+    // The futex wait is itself a host call. Force it to take a regular exit so
+    // that it cannot occupy the worker which is meant to complete |call_|.
+    ScopedSwitchlessBypass bypass;
+    enc_untrusted_thread_wait_value(call_->completion_word(), /*value=*/0,
+                                    kCompletionWaitMicros);
+  }
+  call_->Collect(output);
+  call_.reset();
+  return PrimitiveStatus::OkStatus();
+}
+
+PrimitiveStatus UntrustedCallFuture::Await(MessageReader *output) {
+  if (call_ && TaskScheduler::InTask()) {
+    bool reclaimed = false;
+    TaskScheduler::WaitUntil([this, &reclaimed] {
+      reclaimed = !call_->IsDone() && call_->TryReclaimAfterShutdown();
+      return reclaimed || call_->IsDone();
+    });
+    if (reclaimed) {
+      call_.reset();
+      return {error::GoogleError::UNAVAILABLE,
+              "Switchless workers stopped before servicing the call."};
+    }
+  }
+  return Wait(output);
+}
+
+}  // namespace primitives
+}  // namespace asylo
@@ -0,0 +1,83 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_PRIMITIVES_SGX_ASYNC_UNTRUSTED_CALL_H_
+#define ASYLO_PLATFORM_PRIMITIVES_SGX_ASYNC_UNTRUSTED_CALL_H_
+
+#include <cstdint>
+#include <memory>
+
+#include "asylo/platform/primitives/primitive_status.h"
+#include "asylo/platform/primitives/sgx/trusted_switchless.h"
+#include "asylo/platform/primitives/util/message.h"
+
+namespace asylo {
+namespace primitives {
+
+// Completion handle for an untrusted call which runs while the calling enclave
+// thread continues. Calls are posted to the switchless request ring, so a
+// single TCS can keep many slow host calls (e.g. blocking reads on pipes or
+// sockets) in flight at once. When the ring cannot take the call, it is made
+// synchronously instead and the future is complete on return from Start().
+//
+// Example:
+//
+//   MessageWriter input;
+//   input.Push(fd);
+//   auto future = UntrustedCallFuture::Start(kReadHandler, &input);
+//   ... do other work ...
+//   MessageReader output;
+//   ASYLO_RETURN_IF_ERROR(future->Wait(&output));
+class UntrustedCallFuture {
+ public:
+  // Starts an untrusted call to |untrusted_selector| with |input|. |input| is
+  // fully consumed before Start() returns and may be destroyed afterwards.
+  static std::unique_ptr<UntrustedCallFuture> Start(uint64_t untrusted_selector,
+                                                    MessageWriter *input);
+
+  UntrustedCallFuture(const UntrustedCallFuture &other) = delete;
+  UntrustedCallFuture &operator=(const UntrustedCallFuture &other) = delete;
+
+  // Returns true if the call has completed and Wait() would not block.
+  bool Poll() const;
+
+  // Blocks until the call completes and moves its results into |output|. The
+  // calling thread sleeps on the completion word of the call using the host
+  // wait queue primitives rather than spinning. Must only be called once.
+  PrimitiveStatus Wait(MessageReader *output);
+
+  // Like Wait(), but when called from a TaskScheduler task, suspends the task
+  // until the call completes so that other tasks run on the enclave thread in
+  // the meantime. Must only be called once, instead of Wait().
+  PrimitiveStatus Await(MessageReader *output);
+
+ private:
+  UntrustedCallFuture() = default;
+
+  // Pending switchless call, or nullptr if the call completed synchronously.
+  std::unique_ptr<AsyncSwitchlessCall> call_;
+
+  // Result of a call made synchronously by Start().
+  PrimitiveStatus status_;
+  MessageReader output_;
+};
+
+}  // namespace primitives
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_PRIMITIVES_SGX_ASYNC_UNTRUSTED_CALL_H_
@@ -103,6 +103,23 @@ int ecall_transfer_secure_snapshot_key(const char *input, uint64_t input_len,
   return result;
 }
 
+// Invokes the enclave snapshot worker entry-point. Returns a non-zero error
+// code on failure.
+int ecall_snapshot_worker(uint64_t avoid_thread_base, int *joined) {
+  if (!asylo::primitives::TrustedPrimitives::IsOutsideEnclave(joined,
+                                                              sizeof(*joined))) {
+    asylo::primitives::TrustedPrimitives::BestEffortAbort(
+        "ecall_snapshot_worker: joined found to not be in untrusted memory.");
+  }
+  int result = 0;
+  try {
+    result = asylo::RunSnapshotWorker(avoid_thread_base, joined);
+  } catch (...) {
+    LOG(FATAL) << "Uncaught exception in enclave";
+  }
+  return result;
+}
+
 // Invokes the trusted entry point designated by |selector|. Returns a
 // non-zero error code on failure.
 int ecall_dispatch_trusted_call(uint64_t selector, void *buffer) {
@@ -0,0 +1,118 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/primitives/sgx/enclave_image_cache.h"
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <cerrno>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "asylo/util/elf_reader.h"
+#include "asylo/util/file_mapping.h"
+#include "asylo/util/posix_error_space.h"
+#include "asylo/util/status.h"
+#include "asylo/util/status_macros.h"
+
+namespace asylo {
+namespace primitives {
+namespace {
+
+bool SameFile(const struct stat &a, const struct stat &b) {
+  return a.st_dev == b.st_dev && a.st_ino == b.st_ino &&
+         a.st_size == b.st_size && a.st_mtim.tv_sec == b.st_mtim.tv_sec &&
+         a.st_mtim.tv_nsec == b.st_mtim.tv_nsec;
+}
+
+}  // namespace
+
+struct EnclaveImageCache::MappedFile {
+  // Identity of the file when it was mapped.
+  struct stat stat_buf;
+  FileMapping mapping;
+
+  // Set by the first GetSection() on this file.
+  std::unique_ptr<ElfReader> reader;
+  absl::flat_hash_map<std::string, absl::Span<const uint8_t>> sections;
+};
+
+EnclaveImageCache *EnclaveImageCache::Instance() {
+  static EnclaveImageCache *const instance = new EnclaveImageCache();
+  return instance;
+}
+
+StatusOr<EnclaveImage> EnclaveImageCache::GetFile(absl::string_view path) {
+  absl::MutexLock lock(&mu_);
+  std::shared_ptr<MappedFile> file;
+  ASYLO_ASSIGN_OR_RETURN(file, GetMappedFile(path));
+  absl::Span<const uint8_t> buffer = file->mapping.buffer();
+  return EnclaveImage(std::move(file), buffer);
+}
+
+StatusOr<EnclaveImage> EnclaveImageCache::GetSection(
+    absl::string_view binary_path, absl::string_view section_name) {
+  absl::MutexLock lock(&mu_);
+  std::shared_ptr<MappedFile> file;
+  ASYLO_ASSIGN_OR_RETURN(file, GetMappedFile(binary_path));
+
+  auto it = file->sections.find(section_name);
+  if (it == file->sections.end()) {
+    if (!file->reader) {
+      ElfReader reader;
+      ASYLO_ASSIGN_OR_RETURN(
+          reader, ElfReader::CreateFromSpan(file->mapping.buffer()));
+      file->reader = absl::make_unique<ElfReader>(std::move(reader));
+    }
+    absl::Span<const uint8_t> section;
+    ASYLO_ASSIGN_OR_RETURN(section, file->reader->GetSectionData(section_name));
+    it = file->sections.emplace(section_name, section).first;
+  }
+  absl::Span<const uint8_t> buffer = it->second;
+  return EnclaveImage(std::move(file), buffer);
+}
+
+void EnclaveImageCache::Clear() {
+  absl::MutexLock lock(&mu_);
+  files_.clear();
+}
+
+StatusOr<std::shared_ptr<EnclaveImageCache::MappedFile>>
+EnclaveImageCache::GetMappedFile(absl::string_view path) {
+  const std::string path_string(path);
+  struct stat stat_buf;
+  if (stat(path_string.c_str(), &stat_buf) != 0) {
+    return Status(static_cast<error::PosixError>(errno),
+                  absl::StrCat("Failed to stat ", path));
+  }
+
+  auto it = files_.find(path_string);
+  if (it != files_.end() && SameFile(it->second->stat_buf, stat_buf)) {
+    return it->second;
+  }
+
+  auto file = std::make_shared<MappedFile>();
+  file->stat_buf = stat_buf;
+  ASYLO_ASSIGN_OR_RETURN(file->mapping, FileMapping::CreateFromFile(path));
+  files_[path_string] = file;
+  return file;
+}
+
+}  // namespace primitives
+}  // namespace asylo
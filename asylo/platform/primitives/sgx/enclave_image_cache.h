@@ -0,0 +1,107 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_PRIMITIVES_SGX_ENCLAVE_IMAGE_CACHE_H_
+#define ASYLO_PLATFORM_PRIMITIVES_SGX_ENCLAVE_IMAGE_CACHE_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include "asylo/util/statusor.h"
+
+namespace asylo {
+namespace primitives {
+
+// A signed enclave image mapped into memory, as expected by
+// sgx_create_enclave_from_buffer_ex(). The image stays mapped for as long as
+// any EnclaveImage referring to it exists, even if it is evicted from the
+// EnclaveImageCache in the meantime.
+class EnclaveImage {
+ public:
+  EnclaveImage() = default;
+
+  absl::Span<const uint8_t> buffer() const { return buffer_; }
+
+ private:
+  friend class EnclaveImageCache;
+
+  EnclaveImage(std::shared_ptr<const void> owner,
+               absl::Span<const uint8_t> buffer)
+      : owner_(std::move(owner)), buffer_(buffer) {}
+
+  std::shared_ptr<const void> owner_;
+  absl::Span<const uint8_t> buffer_;
+};
+
+// A process-wide cache of mapped enclave images, so that loading the same
+// enclave binary many times (for instance, one enclave per tenant) maps and
+// parses it only once.
+//
+// Files are identified by path. Every lookup checks the device, inode, size,
+// and modification time of the file, and maps it again if any of them
+// changed, so a rebuilt enclave is never served stale. Mappings are private,
+// so an enclave file must be replaced rather than rewritten in place while
+// images of it are in use.
+//
+// EnclaveImageCache is thread-safe.
+class EnclaveImageCache {
+ public:
+  // Returns the process-wide instance.
+  static EnclaveImageCache *Instance();
+
+  EnclaveImageCache() = default;
+  EnclaveImageCache(const EnclaveImageCache &other) = delete;
+  EnclaveImageCache &operator=(const EnclaveImageCache &other) = delete;
+
+  // Returns the whole file at |path|, mapping it if needed.
+  StatusOr<EnclaveImage> GetFile(absl::string_view path)
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns the section |section_name| of the ELF file at |binary_path|,
+  // mapping and parsing the file if needed.
+  StatusOr<EnclaveImage> GetSection(absl::string_view binary_path,
+                                    absl::string_view section_name)
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Drops every cached file. Images already handed out stay valid.
+  void Clear() ABSL_LOCKS_EXCLUDED(mu_);
+
+ private:
+  // A mapped file, with its ELF parse if one was requested.
+  struct MappedFile;
+
+  // Returns the up-to-date mapping of |path|.
+  StatusOr<std::shared_ptr<MappedFile>> GetMappedFile(absl::string_view path)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  absl::Mutex mu_;
+  absl::flat_hash_map<std::string, std::shared_ptr<MappedFile>> files_
+      ABSL_GUARDED_BY(mu_);
+};
+
+}  // namespace primitives
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_PRIMITIVES_SGX_ENCLAVE_IMAGE_CACHE_H_
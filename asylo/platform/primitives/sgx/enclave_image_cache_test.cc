@@ -0,0 +1,121 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/primitives/sgx/enclave_image_cache.h"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/flags/flag.h"
+#include "absl/strings/str_cat.h"
+#include "asylo/test/util/status_matchers.h"
+#include "asylo/test/util/test_flags.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+namespace primitives {
+namespace {
+
+using ::testing::Eq;
+using ::testing::Ne;
+using ::testing::Not;
+
+constexpr char kSelfBinary[] = "/proc/self/exe";
+
+std::string AsString(const EnclaveImage &image) {
+  return std::string(reinterpret_cast<const char *>(image.buffer().data()),
+                     image.buffer().size());
+}
+
+class EnclaveImageCacheTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    path_ = absl::StrCat(absl::GetFlag(FLAGS_test_tmpdir), "/enclave_image");
+    WriteFile("first image");
+  }
+
+  // Replaces the file with a new one, the way a build would.
+  void WriteFile(const std::string &contents) {
+    const std::string new_path = absl::StrCat(path_, ".new");
+    {
+      std::ofstream file(new_path, std::ios::trunc);
+      file << contents;
+    }
+    ASSERT_THAT(rename(new_path.c_str(), path_.c_str()), Eq(0));
+  }
+
+  EnclaveImageCache cache_;
+  std::string path_;
+};
+
+TEST_F(EnclaveImageCacheTest, FileIsMappedOnce) {
+  EnclaveImage first;
+  ASYLO_ASSERT_OK_AND_ASSIGN(first, cache_.GetFile(path_));
+  EXPECT_THAT(AsString(first), Eq("first image"));
+
+  EnclaveImage second;
+  ASYLO_ASSERT_OK_AND_ASSIGN(second, cache_.GetFile(path_));
+  EXPECT_THAT(second.buffer().data(), Eq(first.buffer().data()));
+}
+
+TEST_F(EnclaveImageCacheTest, ChangedFileIsMappedAgain) {
+  EnclaveImage first;
+  ASYLO_ASSERT_OK_AND_ASSIGN(first, cache_.GetFile(path_));
+
+  WriteFile("second, longer image");
+  EnclaveImage second;
+  ASYLO_ASSERT_OK_AND_ASSIGN(second, cache_.GetFile(path_));
+  EXPECT_THAT(AsString(second), Eq("second, longer image"));
+
+  // The image handed out earlier is still mapped.
+  EXPECT_THAT(AsString(first), Eq("first image"));
+}
+
+TEST_F(EnclaveImageCacheTest, ImagesOutliveClear) {
+  EnclaveImage image;
+  ASYLO_ASSERT_OK_AND_ASSIGN(image, cache_.GetFile(path_));
+  cache_.Clear();
+  EXPECT_THAT(AsString(image), Eq("first image"));
+}
+
+TEST_F(EnclaveImageCacheTest, MissingFileFails) {
+  EXPECT_THAT(cache_.GetFile(absl::StrCat(path_, ".missing")).status(),
+              Not(IsOk()));
+}
+
+TEST_F(EnclaveImageCacheTest, SectionIsParsedOnce) {
+  EnclaveImage first;
+  ASYLO_ASSERT_OK_AND_ASSIGN(first, cache_.GetSection(kSelfBinary, ".text"));
+  EXPECT_THAT(first.buffer().size(), Ne(0));
+
+  EnclaveImage second;
+  ASYLO_ASSERT_OK_AND_ASSIGN(second, cache_.GetSection(kSelfBinary, ".text"));
+  EXPECT_THAT(second.buffer().data(), Eq(first.buffer().data()));
+}
+
+TEST_F(EnclaveImageCacheTest, MissingSectionFails) {
+  EXPECT_THAT(cache_.GetSection(kSelfBinary, "no_such_section").status(),
+              Not(IsOk()));
+}
+
+}  // namespace
+}  // namespace primitives
+}  // namespace asylo
@@ -18,12 +18,20 @@
 
 #include "asylo/platform/primitives/enclave_loader.h"
 
+#include <memory>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/time/time.h"
 #include "asylo/enclave.pb.h"
+#include "asylo/platform/host_call/untrusted/host_call_handlers_initializer.h"
+#include "asylo/platform/primitives/sgx/host_affinity.h"
 #include "asylo/platform/primitives/sgx/loader.pb.h"
 #include "asylo/platform/primitives/sgx/untrusted_sgx.h"
 #include "asylo/platform/primitives/untrusted_primitives.h"
 #include "asylo/platform/primitives/util/dispatch_table.h"
 #include "asylo/platform/primitives/util/exit_log.h"
+#include "asylo/platform/primitives/util/exit_profile.h"
 #include "asylo/util/status.h"
 #include "asylo/util/status_macros.h"
 #include "asylo/util/statusor.h"
@@ -50,8 +58,17 @@ StatusOr<std::shared_ptr<Client>> LoadEnclave(
   bool debug = sgx_config.debug();
   bool is_embedded_enclave = sgx_config.has_embedded_enclave_config();
   bool is_file_enclave = sgx_config.has_file_enclave_config();
-  auto exit_call_provider = absl::make_unique<LoggingDispatchTable>(
-      /*enable_logging=*/load_config.exit_logging());
+  std::unique_ptr<ExitProfiler> exit_profiler;
+  std::unique_ptr<Client::ExitCallProvider> exit_call_provider;
+  if (!load_config.exit_profile_path().empty()) {
+    exit_profiler =
+        absl::make_unique<ExitProfiler>(host_call::ClassifyHostCallExit);
+    exit_call_provider =
+        absl::make_unique<ProfilingDispatchTable>(exit_profiler.get());
+  } else {
+    exit_call_provider = absl::make_unique<LoggingDispatchTable>(
+        /*enable_logging=*/load_config.exit_logging());
+  }
 
   if (is_embedded_enclave) {
     std::string section_name =
@@ -72,6 +89,67 @@ StatusOr<std::shared_ptr<Client>> LoadEnclave(
     return Status(error::GoogleError::INVALID_ARGUMENT,
                   "SGX enclave source not set");
   }
+
+  if (exit_profiler) {
+    std::static_pointer_cast<SgxEnclaveClient>(primitive_client)
+        ->SetExitProfiler(std::move(exit_profiler),
+                          load_config.exit_profile_path());
+  }
+
+  if (sgx_config.has_affinity_config()) {
+    const auto &affinity_config = sgx_config.affinity_config();
+    HostAffinity enclave_thread_affinity;
+    ASYLO_ASSIGN_OR_RETURN(
+        enclave_thread_affinity,
+        HostAffinity::Create(
+            std::vector<int>(affinity_config.enclave_thread_cpus().begin(),
+                             affinity_config.enclave_thread_cpus().end()),
+            affinity_config.numa_node()));
+    HostAffinity worker_affinity;
+    ASYLO_ASSIGN_OR_RETURN(
+        worker_affinity,
+        HostAffinity::Create(
+            std::vector<int>(affinity_config.switchless_worker_cpus().begin(),
+                             affinity_config.switchless_worker_cpus().end()),
+            affinity_config.numa_node()));
+    ASYLO_RETURN_IF_ERROR(
+        std::static_pointer_cast<SgxEnclaveClient>(primitive_client)
+            ->SetHostAffinity(enclave_thread_affinity, worker_affinity));
+  }
+
+  if (sgx_config.untrusted_arena_size() > 0) {
+    ASYLO_RETURN_IF_ERROR(
+        std::static_pointer_cast<SgxEnclaveClient>(primitive_client)
+            ->ReserveUntrustedArena(sgx_config.untrusted_arena_size()));
+  }
+
+  if (sgx_config.has_switchless_config()) {
+    const auto &switchless_config = sgx_config.switchless_config();
+    ASYLO_RETURN_IF_ERROR(
+        std::static_pointer_cast<SgxEnclaveClient>(primitive_client)
+            ->EnableSwitchlessCalls(switchless_config.worker_threads(),
+                                    switchless_config.ring_slots(),
+                                    switchless_config.idle_spins(),
+                                    switchless_config.shared_workers()));
+  }
+
+  if (sgx_config.has_host_clock_config()) {
+    const auto &host_clock_config = sgx_config.host_clock_config();
+    ASYLO_RETURN_IF_ERROR(
+        std::static_pointer_cast<SgxEnclaveClient>(primitive_client)
+            ->EnableHostClock(
+                absl::Microseconds(host_clock_config.update_interval_us()),
+                absl::Microseconds(host_clock_config.max_staleness_us()),
+                host_clock_config.use_tsc()));
+  }
+
+  if (sgx_config.has_io_uring_config()) {
+    const auto &io_uring_config = sgx_config.io_uring_config();
+    ASYLO_RETURN_IF_ERROR(
+        std::static_pointer_cast<SgxEnclaveClient>(primitive_client)
+            ->EnableIoUring(io_uring_config.entries(),
+                            io_uring_config.buffer_size()));
+  }
   return std::move(primitive_client);
 }
 
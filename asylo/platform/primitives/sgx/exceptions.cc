@@ -19,6 +19,8 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+#include "asylo/platform/posix/host_clock.h"
+#include "asylo/platform/primitives/cpuid.h"
 #include "include/sgx_cpuid.h"
 #include "include/sgx_trts_exception.h"
 
@@ -27,6 +29,8 @@ namespace {
 // Handled opcodes
 constexpr uint16_t kCpuidOpcode = 0xA20F;
 constexpr uint16_t kRdtscOpcode = 0x310F;
+constexpr uint16_t kRdtscpOpcode = 0x010F;
+constexpr uint8_t kRdtscpModRm = 0xF9;
 
 // Only support CPUID leaves 0, 1, 4, and 7.
 // 0: Vender ID
@@ -88,6 +92,20 @@ void initialize_cpuid_results() {
 
 }
 
+// Returns the cached result of CPUID for |leaf| and |subleaf|, or nullptr if it
+// was not cached.
+const CpuidResult *find_cpuid_result(uint64_t leaf, uint64_t subleaf) {
+  if (leaf > kMaxSupportedCpuidLeaf || !cpuid_results[leaf].cached) {
+    return nullptr;
+  }
+
+  // Only subleaf==0 results were cached.  Since subleaf doesn't mean anything
+  // for leaves 0 and 1, allow those to be anything (some code doesn't set RCX
+  // at all when making those CPUID calls).
+  if (leaf != 0 && leaf != 1 && subleaf != 0) return nullptr;
+  return &cpuid_results[leaf];
+}
+
 // Called whenever an SGX exception occurs.  This handler deals with CPUID
 // invalid opcode exceptions by filling in data cached earlier.
 int handle_cpuid_exception(sgx_exception_info_t *info) {
@@ -104,22 +122,17 @@ int handle_cpuid_exception(sgx_exception_info_t *info) {
   }
 
   // This handler only provides results for CPUID calls that were cached.
-  uint64_t leaf = info->cpu_context.rax;
-  if (leaf > kMaxSupportedCpuidLeaf || !cpuid_results[leaf].cached) {
+  const CpuidResult *result =
+      find_cpuid_result(info->cpu_context.rax, info->cpu_context.rcx);
+  if (!result) {
     return EXCEPTION_CONTINUE_SEARCH;
   }
 
-  // Only subleaf==0 results were cached.  Since subleaf doesn't mean anything
-  // for leaves 0 and 1, allow those to be anything (some code doesn't set RCX
-  // at all when making those CPUID calls).
-  uint64_t subleaf = info->cpu_context.rcx;
-  if (leaf != 0 && leaf != 1 && subleaf != 0) return EXCEPTION_CONTINUE_SEARCH;
-
   // Copy the cached result registers into our result registers.
-  info->cpu_context.rax = cpuid_results[leaf].reg[CpuidResult::EAX];
-  info->cpu_context.rbx = cpuid_results[leaf].reg[CpuidResult::EBX];
-  info->cpu_context.rcx = cpuid_results[leaf].reg[CpuidResult::ECX];
-  info->cpu_context.rdx = cpuid_results[leaf].reg[CpuidResult::EDX];
+  info->cpu_context.rax = result->reg[CpuidResult::EAX];
+  info->cpu_context.rbx = result->reg[CpuidResult::EBX];
+  info->cpu_context.rcx = result->reg[CpuidResult::ECX];
+  info->cpu_context.rdx = result->reg[CpuidResult::EDX];
 
   // CPUID instruction is 2 bytes wide, so advance the instruction pointer
   // beyond it. This way the enclave should continue execution as though the
@@ -129,33 +142,48 @@ int handle_cpuid_exception(sgx_exception_info_t *info) {
   return EXCEPTION_CONTINUE_EXECUTION;
 }
 
-// Called whenever an SGX exception occurs.  This handler deals with RDTSC
-// invalid opcode exceptions by filling in dummy data.
+// Called whenever an SGX exception occurs.  This handler deals with RDTSC and
+// RDTSCP invalid opcode exceptions by emulating the time stamp counter from the
+// host clock page, or by filling in dummy data if the page is not in use.
 int handle_rdtsc_exception(sgx_exception_info_t *info) {
   // Grab the opcode for the instruction at the exception's instruction pointer.
-  uint16_t opcode = *reinterpret_cast<uint16_t *>(info->cpu_context.rip);
+  const uint8_t *instruction =
+      reinterpret_cast<const uint8_t *>(info->cpu_context.rip);
+  uint16_t opcode = *reinterpret_cast<const uint16_t *>(instruction);
 
   // This handler is only for invalid opcode (#UD) hardware exceptions caused by
-  // the RDTSC instruction.  For anything else, return indication to keep
-  // looking for other possible handlers.
+  // the RDTSC and RDTSCP instructions.  For anything else, return indication to
+  // keep looking for other possible handlers.
   if (info->exception_vector != SGX_EXCEPTION_VECTOR_UD ||
-      info->exception_type != SGX_EXCEPTION_HARDWARE ||
-      opcode != kRdtscOpcode) {
+      info->exception_type != SGX_EXCEPTION_HARDWARE) {
+    return EXCEPTION_CONTINUE_SEARCH;
+  }
+  bool rdtscp = opcode == kRdtscpOpcode && instruction[2] == kRdtscpModRm;
+  if (opcode != kRdtscOpcode && !rdtscp) {
     return EXCEPTION_CONTINUE_SEARCH;
   }
 
-  // Increment the timestamp value from the last one returned.
-  static uint64_t last_rdtsc = 0;
-  last_rdtsc++;
+  uint64_t tsc;
+  if (!asylo::EmulateTimeStampCounter(&tsc)) {
+    // Increment the timestamp value from the last one returned.
+    static uint64_t last_rdtsc = 0;
+    tsc = ++last_rdtsc;
+  }
 
   // Split the timestamp and return in registers
-  info->cpu_context.rax = last_rdtsc & 0xFFFFFFFF;
-  info->cpu_context.rdx = last_rdtsc >> 32;
-
-  // RDTSC instruction is 2 bytes wide, so advance the instruction pointer
-  // beyond it. This way the enclave should continue execution should continue
-  // as though the CPUID instruction executed normally.
-  info->cpu_context.rip += 2;
+  info->cpu_context.rax = tsc & 0xFFFFFFFF;
+  info->cpu_context.rdx = tsc >> 32;
+
+  // RDTSC instruction is 2 bytes wide and RDTSCP is 3 bytes wide, so advance
+  // the instruction pointer beyond it. This way the enclave should continue
+  // execution as though the instruction executed normally. RDTSCP also returns
+  // the processor signature, which the enclave cannot know, in ecx.
+  if (rdtscp) {
+    info->cpu_context.rcx = 0;
+    info->cpu_context.rip += 3;
+  } else {
+    info->cpu_context.rip += 2;
+  }
 
   return EXCEPTION_CONTINUE_EXECUTION;
 }
@@ -171,3 +199,18 @@ void register_exception_handlers() {
 }
 
 }  // namespace
+
+// Serves CPUID from the cached results, so that callers of enc_cpuid do not
+// take an invalid opcode exception per query.
+extern "C" bool enc_cpuid(uint32_t leaf, uint32_t subleaf,
+                          uint32_t registers[4]) {
+  const CpuidResult *result = find_cpuid_result(leaf, subleaf);
+  if (!result) {
+    return false;
+  }
+  registers[0] = result->reg[CpuidResult::EAX];
+  registers[1] = result->reg[CpuidResult::EBX];
+  registers[2] = result->reg[CpuidResult::ECX];
+  registers[3] = result->reg[CpuidResult::EDX];
+  return true;
+}
@@ -28,7 +28,12 @@ namespace asylo {
 namespace primitives {
 namespace {
 
-void donate_thread(Client *sgx_client) {
+void donate_thread(Client *sgx_client, HostAffinity affinity) {
+  Status pin_status = affinity.PinCurrentThread();
+  if (!pin_status.ok()) {
+    LOG(WARNING) << "Enclave thread runs unpinned: " << pin_status;
+  }
+
   primitives::MessageWriter in;
   in.Push(syscall(SYS_gettid));
   primitives::MessageReader out;
@@ -49,20 +54,27 @@ void donate_thread(Client *sgx_client) {
 Status CreateThreadHandler(const std::shared_ptr<primitives::Client> &client,
                            void *context, primitives::MessageReader *input,
                            primitives::MessageWriter *output) {
-  Thread::StartDetached(donate_thread, client.get());
+  HostAffinity affinity;
+  if (context) {
+    affinity = *static_cast<const HostAffinity *>(context);
+  }
+  Thread::StartDetached(donate_thread, client.get(), affinity);
 
   output->Push<int>(0);
   return Status::OkStatus();
 }
 
-Status RegisterSgxExitHandlers(Client::ExitCallProvider *exit_call_provider) {
+Status RegisterSgxExitHandlers(Client::ExitCallProvider *exit_call_provider,
+                               const HostAffinity *enclave_thread_affinity) {
   if (!exit_call_provider) {
     return {error::GoogleError::INVALID_ARGUMENT,
             "RegisterSgxExitHandlers: Invalid/NULL ExitCallProvider provided."};
   }
 
   ASYLO_RETURN_IF_ERROR(exit_call_provider->RegisterExitHandler(
-      kSelectorCreateThread, ExitHandler{CreateThreadHandler}));
+      kSelectorCreateThread,
+      ExitHandler{CreateThreadHandler,
+                  const_cast<HostAffinity *>(enclave_thread_affinity)}));
 
   return Status::OkStatus();
 }
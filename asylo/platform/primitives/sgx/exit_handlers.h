@@ -19,6 +19,7 @@
 #ifndef ASYLO_PLATFORM_PRIMITIVES_SGX_EXIT_HANDLERS_H_
 #define ASYLO_PLATFORM_PRIMITIVES_SGX_EXIT_HANDLERS_H_
 
+#include "asylo/platform/primitives/sgx/host_affinity.h"
 #include "asylo/platform/primitives/untrusted_primitives.h"
 #include "asylo/platform/primitives/util/message.h"
 #include "asylo/util/status.h"
@@ -28,14 +29,18 @@ namespace asylo {
 namespace primitives {
 
 // Exit call handler for thread creation. Performs an EnclaveCall to register
-// and start the thread this handler creates.
+// and start the thread this handler creates. If |context| is not null, it
+// points to the HostAffinity which the thread is pinned to before entering.
 ASYLO_MUST_USE_RESULT Status CreateThreadHandler(
     const std::shared_ptr<primitives::Client> &client, void *context,
     primitives::MessageReader *input, primitives::MessageWriter *output);
 
-// Registers the exit handlers specific to SGX primitives layer.
-ASYLO_MUST_USE_RESULT Status
-RegisterSgxExitHandlers(Client::ExitCallProvider *exit_call_provider);
+// Registers the exit handlers specific to SGX primitives layer. Threads
+// created for the enclave are pinned to |enclave_thread_affinity| if it is not
+// null, in which case it must outlive the handlers.
+ASYLO_MUST_USE_RESULT Status RegisterSgxExitHandlers(
+    Client::ExitCallProvider *exit_call_provider,
+    const HostAffinity *enclave_thread_affinity = nullptr);
 
 }  // namespace primitives
 }  // namespace asylo
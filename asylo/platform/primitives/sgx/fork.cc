@@ -26,6 +26,7 @@
 #include "asylo/platform/primitives/trusted_primitives.h"
 #include "asylo/platform/primitives/trusted_runtime.h"
 #include "asylo/platform/primitives/util/status_serializer.h"
+#include "asylo/util/cleanup.h"
 #include "asylo/util/status.h"
 
 namespace asylo {
@@ -45,6 +46,8 @@ Status VerifyOutputArguments(char **output, size_t *output_len) {
 }  // namespace
 
 int TakeSnapshot(char **output, size_t *output_len) {
+  // Snapshot workers may have joined even if no snapshot is taken.
+  Cleanup release_snapshot_workers(ReleaseSnapshotWorkers);
   Status status = VerifyOutputArguments(output, output_len);
   if (!status.ok()) {
     return 1;
@@ -78,6 +81,8 @@ int TakeSnapshot(char **output, size_t *output_len) {
 
 int Restore(const char *snapshot_layout, size_t snapshot_layout_len,
             char **output, size_t *output_len) {
+  // Snapshot workers may have joined even if the snapshot is not restored.
+  Cleanup release_snapshot_workers(ReleaseSnapshotWorkers);
   Status status = VerifyOutputArguments(output, output_len);
   if (!status.ok()) {
     return 1;
@@ -107,6 +112,11 @@ int Restore(const char *snapshot_layout, size_t snapshot_layout_len,
   // deallocators using the same heap. Consequently, we wait to deserialize this
   // message until after switching heaps in RestoreForFork().
   status = RestoreForFork(snapshot_layout, snapshot_layout_len);
+  if (status.ok()) {
+    // The child shares the pseudorandom state of the parent. Reseed it so that
+    // the two enclaves do not produce the same random bytes.
+    enc_pseudorandom_reset();
+  }
   int ret = status_serializer.Serialize(status);
 
   if (!status.ok()) {
@@ -150,4 +160,9 @@ int TransferSecureSnapshotKey(const char *input, size_t input_len,
   return status_serializer.Serialize(status);
 }
 
+int RunSnapshotWorker(uint64_t avoid_thread_base, volatile int *joined) {
+  JoinSnapshotWorkers(reinterpret_cast<void *>(avoid_thread_base), joined);
+  return 0;
+}
+
 }  // namespace asylo
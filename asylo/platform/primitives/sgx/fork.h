@@ -21,6 +21,8 @@
 
 #include <sys/types.h>
 
+#include <cstdint>
+
 namespace asylo {
 
 int TakeSnapshot(char **output, size_t *output_len);
@@ -31,6 +33,8 @@ int Restore(const char *snapshot_layout, size_t snapshot_layout_len,
 int TransferSecureSnapshotKey(const char *input, size_t input_len,
                               char **output, size_t *output_len);
 
+int RunSnapshotWorker(uint64_t avoid_thread_base, volatile int *joined);
+
 }  // namespace asylo
 
 #endif  // ASYLO_PLATFORM_PRIMITIVES_SGX_FORK_H_
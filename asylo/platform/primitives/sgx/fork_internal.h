@@ -54,6 +54,17 @@ void SaveThreadLayoutForSnapshot();
 // Sets fork request, which allows a snapshot of the enclave to be taken.
 void SetForkRequested();
 
+// Makes the calling thread a snapshot worker, which encrypts or decrypts chunks
+// of the snapshot being taken or restored, and sets |joined| once it joined.
+// Returns right away if no snapshot is about to be taken or restored, or if the
+// TCS of the calling thread holds the thread data at |avoid_thread_base|.
+// Otherwise returns once the snapshot has been taken or restored.
+void JoinSnapshotWorkers(void *avoid_thread_base, volatile int *joined);
+
+// Releases the snapshot workers that joined, if the snapshot they joined for is
+// not taken or restored.
+void ReleaseSnapshotWorkers();
+
 }  // namespace asylo
 
 #endif  // ASYLO_PLATFORM_PRIMITIVES_SGX_FORK_INTERNAL_H_
@@ -27,14 +27,15 @@
 #include "absl/base/macros.h"
 #include "absl/strings/str_cat.h"
 #include "asylo/crypto/aead_cryptor.h"
+#include "asylo/crypto/aead_key.h"
 #include "asylo/crypto/util/bssl_util.h"
 #include "asylo/crypto/util/byte_container_view.h"
-#include "asylo/crypto/util/trivial_object_util.h"
 #include "asylo/util/logging.h"
 #include "asylo/grpc/auth/core/client_ekep_handshaker.h"
 #include "asylo/grpc/auth/core/server_ekep_handshaker.h"
 #include "asylo/identity/descriptions.h"
 #include "asylo/identity/identity_acl_evaluator.h"
+#include "asylo/identity/platform/sgx/internal/caching_hardware_interface.h"
 #include "asylo/identity/platform/sgx/sgx_identity_expectation_matcher.h"
 #include "asylo/identity/platform/sgx/sgx_identity_util.h"
 #include "asylo/platform/host_call/trusted/host_calls.h"
@@ -69,6 +70,88 @@ const char kSnapshotKeyAssociatedDataBuf[] = "AES256-GCM-SIV snapshot key";
 // AES256-GCM-SIV snapshot key, which is used to encrypt/decrypt snapshot.
 static CleansingVector<uint8_t> *global_snapshot_key(nullptr);
 
+// Size of the chunks that a snapshot is split into. Each chunk is sealed with
+// its own nonce and bound to its address in the enclave, so chunks are
+// encrypted and decrypted independently of each other, in parallel by the
+// snapshot workers.
+constexpr size_t kSnapshotChunkSize = static_cast<size_t>(1) << 20;
+
+// Size of the AES256-GCM-SIV nonce of a snapshot chunk.
+constexpr size_t kSnapshotNonceSize = 12;
+
+// Maximum number of snapshot workers, which are host threads that enter the
+// enclave to help take or restore a snapshot.
+constexpr uint32_t kMaxSnapshotWorkers = 16;
+
+// Set in |snapshot_worker_registration| while snapshot workers can not join.
+constexpr uint32_t kSnapshotWorkersClosed = static_cast<uint32_t>(1) << 31;
+
+// Number of snapshot workers that joined for the snapshot about to be taken or
+// restored. Workers can join from the time fork is requested in the parent, or
+// the snapshot key is received in the child, until the snapshot is taken or
+// restored.
+std::atomic<uint32_t> snapshot_worker_registration(kSnapshotWorkersClosed);
+
+// Untrusted wait queue on which the joined snapshot workers sleep until the
+// registration is closed. Created when the registration is opened, and
+// destroyed once every worker woke up.
+int32_t *snapshot_worker_wait_queue = nullptr;
+
+// Number of joined snapshot workers that woke up after the registration was
+// closed, and are back in the enclave.
+std::atomic<uint32_t> snapshot_workers_awake(0);
+
+// A chunk of enclave memory and its encrypted copy in untrusted memory.
+struct SnapshotChunk {
+  // The chunk in the enclave.
+  uint8_t *plaintext;
+  size_t plaintext_size;
+
+  // The encrypted chunk in untrusted memory.
+  uint8_t *ciphertext;
+  size_t ciphertext_size;
+
+  // The nonce of the chunk, kept in the enclave while the chunk is processed.
+  uint8_t nonce[kSnapshotNonceSize];
+};
+
+// Chunks shared between the thread taking or restoring a snapshot and the
+// snapshot workers. Each thread claims chunks one at a time until none is left.
+// The pool lives on the stack of the thread taking or restoring the snapshot,
+// which waits for every worker to leave it.
+struct SnapshotChunkPool {
+  SnapshotChunkPool(AeadKey *key, bool seal, SnapshotChunk *chunks,
+                    size_t num_chunks)
+      : key(key),
+        seal(seal),
+        chunks(chunks),
+        num_chunks(num_chunks),
+        next_chunk(0),
+        failed(false),
+        joined(0),
+        left(0) {}
+
+  AeadKey *const key;
+
+  // Whether the chunks are sealed into the snapshot, or opened from it.
+  const bool seal;
+
+  SnapshotChunk *const chunks;
+  const size_t num_chunks;
+  std::atomic<size_t> next_chunk;
+  std::atomic<bool> failed;
+
+  // Number of workers that joined and that left the pool, and the base address
+  // of the thread data of each worker that joined.
+  std::atomic<uint32_t> joined;
+  std::atomic<uint32_t> left;
+  void *worker_thread_bases[kMaxSnapshotWorkers];
+};
+
+// The pool that the snapshot workers take chunks from, once published by the
+// thread taking or restoring the snapshot.
+std::atomic<SnapshotChunkPool *> published_snapshot_chunks(nullptr);
+
 // Structure describing the layout of per-thread memory resources.
 struct ThreadMemoryLayout {
   // Base address of the thread data for the current thread, including the stack
@@ -164,89 +247,136 @@ Status BlockAndWaitOnEntries(int calling_thread_entry_count, int timeout) {
   return Status::OkStatus();
 }
 
-// Encrypts the enclave memory from |source_base| with |source_size| with
-// |cryptor|, and saves the encrypted data in untrusted memory |snapshot_entry|,
-// which includes both the ciphertext and nonce. |snapshot_entry| is a protobuf
-// that's passed across enclave boundary. It contains 64-bit integer
-// representations of the pointers to untrusted memory that contains the
-// encrypted data.
-Status EncryptToUntrustedMemory(AeadCryptor *cryptor, const void *source_base,
-                                const size_t source_size,
-                                SnapshotLayoutEntry *snapshot_entry) {
-  ByteContainerView plaintext(source_base, source_size);
-  int maximum_ciphertext_size = source_size + cryptor->MaxSealOverhead();
-  void *destination_base = primitives::TrustedPrimitives::UntrustedLocalAlloc(
-      maximum_ciphertext_size);
-  size_t destination_size;
-  if (!destination_base) {
-    return Status(error::GoogleError::INTERNAL,
-                  "Failed to allocate untrusted memory for snapshot");
+// Returns the number of snapshot chunks a memory region of |size| bytes is
+// split into.
+size_t NumSnapshotChunks(size_t size) {
+  return (size + kSnapshotChunkSize - 1) / kSnapshotChunkSize;
+}
+
+// Seals or opens |chunk| with |key|. The enclave address of the chunk is used
+// as the associated data, to make sure that it is restored to exactly the same
+// address in the child enclave. Returns false on failure.
+//
+// This runs on the snapshot workers as well, so it must not allocate memory
+// except on failure.
+bool ProcessSnapshotChunk(AeadKey *key, bool seal, SnapshotChunk *chunk) {
+  ByteContainerView associated_data(&chunk->plaintext,
+                                    sizeof(chunk->plaintext));
+  ByteContainerView nonce(chunk->nonce, sizeof(chunk->nonce));
+  size_t size;
+  if (seal) {
+    return key->Seal(ByteContainerView(chunk->plaintext,
+                                       chunk->plaintext_size),
+                     associated_data, nonce,
+                     absl::MakeSpan(chunk->ciphertext, chunk->ciphertext_size),
+                     &size)
+               .ok() &&
+           size == chunk->ciphertext_size;
   }
-  size_t nonce_size = cryptor->NonceSize();
-  void *nonce_base =
-      primitives::TrustedPrimitives::UntrustedLocalAlloc(nonce_size);
-  if (!nonce_base) {
-    return Status(error::GoogleError::INTERNAL,
-                  "Failed to allocate untrusted memory for snapshot nonce");
+  return key->Open(ByteContainerView(chunk->ciphertext,
+                                     chunk->ciphertext_size),
+                   associated_data, nonce,
+                   absl::MakeSpan(chunk->plaintext, chunk->plaintext_size),
+                   &size)
+             .ok() &&
+         size == chunk->plaintext_size;
+}
+
+// Claims and processes the chunks of |pool| one at a time, until none is left.
+void ProcessSnapshotChunks(SnapshotChunkPool *pool) {
+  for (size_t i = pool->next_chunk.fetch_add(1); i < pool->num_chunks;
+       i = pool->next_chunk.fetch_add(1)) {
+    if (!ProcessSnapshotChunk(pool->key, pool->seal, &pool->chunks[i])) {
+      pool->failed = true;
+    }
   }
+}
 
-  // Use the enclave address being encrypted as the associated data to make sure
-  // that it's restored to exactly the same address space in the child enclave.
-  ASYLO_RETURN_IF_ERROR(cryptor->Seal(
-      plaintext, ConvertTrivialObjectToBinaryString(source_base),
-      absl::MakeSpan(reinterpret_cast<uint8_t *>(nonce_base), nonce_size),
-      absl::MakeSpan(reinterpret_cast<uint8_t *>(destination_base),
-                     maximum_ciphertext_size),
-      &destination_size));
-
-  snapshot_entry->set_ciphertext_base(
-      reinterpret_cast<uint64_t>(destination_base));
-  snapshot_entry->set_ciphertext_size(static_cast<uint64_t>(destination_size));
-  snapshot_entry->set_nonce_base(reinterpret_cast<uint64_t>(nonce_base));
-  snapshot_entry->set_nonce_size(static_cast<uint64_t>(nonce_size));
+// Returns the status of |pool| once all its chunks have been processed.
+Status SnapshotChunkPoolStatus(const SnapshotChunkPool &pool) {
+  if (pool.failed) {
+    return Status(error::GoogleError::INTERNAL,
+                  pool.seal ? "Failed to encrypt the snapshot"
+                            : "Failed to decrypt the snapshot");
+  }
   return Status::OkStatus();
 }
 
-// Decrypts the untrusted source from |snapshot_entry| with |cryptor| to the
-// enclave memory location at |destination_base| with |destination_size|.
-// |snapshot_entry| is a protobuf that is passed from untrusted side, it
-// contains both the ciphertext and nonce of the data, stored in 64-bit
-// integers. The size of the decrypted memory is returned in
-// |actual_plaintext_size|.
-Status DecryptFromUntrustedMemory(AeadCryptor *cryptor,
-                                  SnapshotLayoutEntry snapshot_entry,
-                                  void *destination_base,
-                                  size_t destination_size,
-                                  size_t *actual_plaintext_size) {
-  // The address stored in snapshot are 64-bit integers, they need to be casted
-  // to pointer type before decryption.
-  void *source_base =
-      reinterpret_cast<void *>(snapshot_entry.ciphertext_base());
-  size_t source_size = static_cast<size_t>(snapshot_entry.ciphertext_size());
-  if (!primitives::TrustedPrimitives::IsOutsideEnclave(source_base,
-                                                       source_size)) {
-    return Status(error::GoogleError::INTERNAL,
-                  "snapshot is not outside the enclave");
+// The snapshot workers that joined for the snapshot being taken or restored by
+// the calling thread. Closes the registration of workers when constructed, and
+// returns once the workers, which sleep on the host until then, are back in the
+// enclave. The workers wait in the enclave until they are given the chunks of
+// one pool by Run(), or until they are released when the object is destroyed.
+class SnapshotWorkers {
+ public:
+  SnapshotWorkers()
+      : count_(snapshot_worker_registration.fetch_or(kSnapshotWorkersClosed) &
+               ~kSnapshotWorkersClosed) {
+    // The workers must return from their host call before enclave entries are
+    // blocked, which would keep them out, and before the heap is switched or
+    // restored, which would change the heap their host call allocates on.
+    int32_t *queue = snapshot_worker_wait_queue;
+    if (queue && count_ > 0) {
+      enc_untrusted_wait_queue_set_value(queue, 1);
+      enc_untrusted_notify(queue, count_);
+    }
+    while (snapshot_workers_awake.load(std::memory_order_acquire) < count_) {
+      enc_pause();
+    }
+    if (queue) {
+      snapshot_worker_wait_queue = nullptr;
+      enc_untrusted_destroy_wait_queue(queue);
+    }
   }
-  void *nonce_base = reinterpret_cast<void *>(snapshot_entry.nonce_base());
-  size_t nonce_size = static_cast<size_t>(snapshot_entry.nonce_size());
-  if (!primitives::TrustedPrimitives::IsOutsideEnclave(nonce_base,
-                                                       nonce_size)) {
-    return Status(error::GoogleError::INTERNAL,
-                  "snapshot nonce is not outside the enclave");
+
+  SnapshotWorkers(const SnapshotWorkers &other) = delete;
+  SnapshotWorkers &operator=(const SnapshotWorkers &other) = delete;
+
+  ~SnapshotWorkers() {
+    if (!released_) {
+      SnapshotChunkPool pool(/*key=*/nullptr, /*seal=*/false,
+                             /*chunks=*/nullptr, /*num_chunks=*/0);
+      Run(&pool);
+    }
+    // The registration may have been overwritten while restoring bss.
+    snapshot_worker_registration = kSnapshotWorkersClosed;
+  }
+
+  // Returns the number of workers in the enclave.
+  uint32_t count() const { return count_; }
+
+  // Processes the chunks of |pool| together with the workers, and returns once
+  // every worker has left |pool|. The workers leave the enclave afterwards, so
+  // later calls process their pool on the calling thread only.
+  Status Run(SnapshotChunkPool *pool) {
+    uint32_t workers = released_ ? 0 : count_;
+    released_ = true;
+    if (workers > 0) {
+      published_snapshot_chunks.store(pool, std::memory_order_release);
+    }
+    ProcessSnapshotChunks(pool);
+    while (pool->left.load(std::memory_order_acquire) < workers) {
+      enc_pause();
+    }
+    published_snapshot_chunks.store(nullptr, std::memory_order_relaxed);
+    return SnapshotChunkPoolStatus(*pool);
   }
-  ByteContainerView ciphertext(source_base, source_size);
-  std::vector<uint8_t> nonce(
-      reinterpret_cast<uint8_t *>(nonce_base),
-      reinterpret_cast<uint8_t *>(nonce_base) + nonce_size);
 
-  // Use the enclave address being restored as the associated data to make sure
-  // that it's restoring from the same address space in the parent enclave.
-  return cryptor->Open(
-      ciphertext, ConvertTrivialObjectToBinaryString(destination_base), nonce,
-      absl::MakeSpan(reinterpret_cast<uint8_t *>(destination_base),
-                     destination_size),
-      actual_plaintext_size);
+ private:
+  const uint32_t count_;
+  bool released_ = false;
+};
+
+// Returns whether a snapshot worker that worked on |pool| runs on the TCS that
+// holds the thread data at |thread_base|.
+bool SnapshotWorkerOccupies(const SnapshotChunkPool &pool, void *thread_base) {
+  uint32_t workers = pool.joined.load(std::memory_order_acquire);
+  for (uint32_t i = 0; i < workers; ++i) {
+    if (pool.worker_thread_bases[i] == thread_base) {
+      return true;
+    }
+  }
+  return false;
 }
 
 void CopyNonOkStatus(const Status &non_ok_status,
@@ -257,65 +387,162 @@ void CopyNonOkStatus(const Status &non_ok_status,
           std::min(message_buffer_size, non_ok_status.error_message().size()));
 }
 
-// Encrypts a whole memory region of size |source_size| at |source_base| in the
-// enclave with |cryptor|. The memory could be data, bss, heap, thread or data.
-// The encryption may result in multiple snapshot entries if the memory size is
-// greater than the maximum message size supported by |cryptor|. The result is
-// written to |entry|.
-Status EncryptToSnapshot(AeadCryptor *cryptor, void *source_base,
-                         size_t source_size,
-                         google::protobuf::RepeatedPtrField<SnapshotLayoutEntry> *entry) {
+// Splits a whole memory region of size |source_size| at |source_base| in the
+// enclave into chunks to be encrypted into a snapshot. The memory could be
+// data, bss, heap, thread or stack. For each chunk, allocates untrusted memory
+// for its ciphertext, whose size is |max_seal_overhead| larger than the chunk,
+// and for its nonce, generates the nonce and adds an entry describing the chunk
+// to |entry|. The chunks are appended to |chunks|, and encrypted later.
+Status PrepareSnapshotChunks(
+    void *source_base, size_t source_size, size_t max_seal_overhead,
+    google::protobuf::RepeatedPtrField<SnapshotLayoutEntry> *entry,
+    std::vector<SnapshotChunk> *chunks) {
   size_t bytes_left = source_size;
   uint8_t *current_position = reinterpret_cast<uint8_t *>(source_base);
 
-  while (bytes_left > 0) {
-    size_t plaintext_size = std::min(cryptor->MaxMessageSize(), bytes_left);
-    ASYLO_RETURN_IF_ERROR(EncryptToUntrustedMemory(
-        cryptor, current_position, plaintext_size, entry->Add()));
+  // Entries are allocated on the switched heap, which never reuses memory, so
+  // avoid growing the repeated field one entry at a time.
+  entry->Reserve(entry->size() + NumSnapshotChunks(source_size));
 
-    bytes_left -= plaintext_size;
-    current_position += plaintext_size;
+  while (bytes_left > 0) {
+    SnapshotChunk chunk;
+    chunk.plaintext = current_position;
+    chunk.plaintext_size = std::min(kSnapshotChunkSize, bytes_left);
+    chunk.ciphertext_size = chunk.plaintext_size + max_seal_overhead;
+    chunk.ciphertext = reinterpret_cast<uint8_t *>(
+        primitives::TrustedPrimitives::UntrustedLocalAlloc(
+            chunk.ciphertext_size));
+    if (!chunk.ciphertext) {
+      return Status(error::GoogleError::INTERNAL,
+                    "Failed to allocate untrusted memory for snapshot");
+    }
+    void *nonce_base =
+        primitives::TrustedPrimitives::UntrustedLocalAlloc(kSnapshotNonceSize);
+    if (!nonce_base) {
+      return Status(error::GoogleError::INTERNAL,
+                    "Failed to allocate untrusted memory for snapshot nonce");
+    }
+    if (!RAND_bytes(chunk.nonce, kSnapshotNonceSize)) {
+      return Status(error::GoogleError::INTERNAL,
+                    absl::StrCat("Can not generate the snapshot nonce: ",
+                                 BsslLastErrorString()));
+    }
+    memcpy(nonce_base, chunk.nonce, kSnapshotNonceSize);
+
+    SnapshotLayoutEntry *snapshot_entry = entry->Add();
+    snapshot_entry->set_ciphertext_base(
+        reinterpret_cast<uint64_t>(chunk.ciphertext));
+    snapshot_entry->set_ciphertext_size(
+        static_cast<uint64_t>(chunk.ciphertext_size));
+    snapshot_entry->set_nonce_base(reinterpret_cast<uint64_t>(nonce_base));
+    snapshot_entry->set_nonce_size(static_cast<uint64_t>(kSnapshotNonceSize));
+    chunks->push_back(chunk);
+
+    bytes_left -= chunk.plaintext_size;
+    current_position += chunk.plaintext_size;
   }
   return Status::OkStatus();
 }
 
-// Decrypts a whole memory region with |cryptor| from |entry|. The memory region
-// can be data, bss, heap, thread or stack. The snapshot may contain one or more
-// entries, and is decrypted in a loop. The decrypted result is saved in
-// |destination_base| with |destination_size|.
-Status DecryptFromSnapshot(
-    AeadCryptor *cryptor, void *destination_base, size_t destination_size,
-    const google::protobuf::RepeatedPtrField<SnapshotLayoutEntry> &entry) {
+// Splits a whole memory region of size |destination_size| at
+// |destination_base| in the enclave into the chunks to be decrypted from
+// |entry|. The memory region can be data, bss, heap, thread or stack. The
+// entries come from the untrusted side, so their ciphertext and nonce are
+// checked to be outside the enclave, and the nonces are copied into the
+// enclave. The chunks are appended to |chunks|, and decrypted later.
+Status PrepareRestoreChunks(
+    void *destination_base, size_t destination_size,
+    const google::protobuf::RepeatedPtrField<SnapshotLayoutEntry> &entry,
+    std::vector<SnapshotChunk> *chunks) {
   uint8_t *current_position = reinterpret_cast<uint8_t *>(destination_base);
   size_t bytes_left = destination_size;
 
   for (int i = 0; i < entry.size() && bytes_left > 0; ++i) {
-    // The expected plaintext size in the current snapshot part. It should be
-    // either the max message size of the cryptor, or the bytes left in the
-    // destination.
-    size_t expected_plaintext_size =
-        std::min(cryptor->MaxMessageSize(), bytes_left);
+    SnapshotChunk chunk;
+    chunk.plaintext = current_position;
+    chunk.plaintext_size = std::min(kSnapshotChunkSize, bytes_left);
     // We should not decrypt to any untrusted memory.
     if (!current_position || !primitives::TrustedPrimitives::IsInsideEnclave(
-                                 current_position, expected_plaintext_size)) {
+                                 current_position, chunk.plaintext_size)) {
       return Status(error::GoogleError::INTERNAL,
                     "enclave memory is not found or unexpected");
     }
 
-    size_t actual_plaintext_size;
-    ASYLO_RETURN_IF_ERROR(DecryptFromUntrustedMemory(
-        cryptor, entry[i], current_position, expected_plaintext_size,
-        &actual_plaintext_size));
-    if (actual_plaintext_size != expected_plaintext_size) {
+    // The address stored in snapshot are 64-bit integers, they need to be
+    // casted to pointer type before decryption.
+    chunk.ciphertext = reinterpret_cast<uint8_t *>(entry[i].ciphertext_base());
+    chunk.ciphertext_size = static_cast<size_t>(entry[i].ciphertext_size());
+    if (!primitives::TrustedPrimitives::IsOutsideEnclave(
+            chunk.ciphertext, chunk.ciphertext_size)) {
+      return Status(error::GoogleError::INTERNAL,
+                    "snapshot is not outside the enclave");
+    }
+    void *nonce_base = reinterpret_cast<void *>(entry[i].nonce_base());
+    if (entry[i].nonce_size() != kSnapshotNonceSize ||
+        !primitives::TrustedPrimitives::IsOutsideEnclave(nonce_base,
+                                                         kSnapshotNonceSize)) {
       return Status(error::GoogleError::INTERNAL,
-                    "The snapshot size does not match expectation");
+                    "snapshot nonce is not outside the enclave");
     }
-    bytes_left -= actual_plaintext_size;
-    current_position += actual_plaintext_size;
+    memcpy(chunk.nonce, nonce_base, kSnapshotNonceSize);
+    chunks->push_back(chunk);
+
+    bytes_left -= chunk.plaintext_size;
+    current_position += chunk.plaintext_size;
+  }
+  if (bytes_left > 0) {
+    return Status(error::GoogleError::INTERNAL,
+                  "The snapshot does not cover the whole memory region");
   }
   return Status::OkStatus();
 }
 
+// Returns the number of bytes at the start of the enclave heap that have ever
+// been allocated.
+size_t GetHeapUsed() {
+  struct EnclaveMemoryLayout enclave_layout;
+  enc_get_memory_layout(&enclave_layout);
+  return enclave_layout.heap_used;
+}
+
+// Opens the registration of snapshot workers, which sleep on an untrusted
+// wait queue until it is closed.
+void OpenSnapshotWorkerRegistration() {
+  if (!snapshot_worker_wait_queue) {
+    snapshot_worker_wait_queue = enc_untrusted_create_wait_queue();
+  }
+  if (snapshot_worker_wait_queue) {
+    enc_untrusted_wait_queue_set_value(snapshot_worker_wait_queue, 0);
+  }
+  snapshot_workers_awake = 0;
+  snapshot_worker_registration = 0;
+}
+
+// Returns the copy of |object| in the reserved data or bss section of
+// |enclave_layout|, or nullptr if |object| is in neither section.
+template <typename T>
+const T *ReservedCopyOf(const T *object,
+                        const EnclaveMemoryLayout &enclave_layout) {
+  const uint8_t *address = reinterpret_cast<const uint8_t *>(object);
+  const uint8_t *data_base =
+      static_cast<const uint8_t *>(enclave_layout.data_base);
+  const uint8_t *bss_base =
+      static_cast<const uint8_t *>(enclave_layout.bss_base);
+  if (address >= data_base &&
+      address + sizeof(T) <= data_base + enclave_layout.data_size) {
+    return reinterpret_cast<const T *>(
+        static_cast<const uint8_t *>(enclave_layout.reserved_data_base) +
+        (address - data_base));
+  }
+  if (address >= bss_base &&
+      address + sizeof(T) <= bss_base + enclave_layout.bss_size) {
+    return reinterpret_cast<const T *>(
+        static_cast<const uint8_t *>(enclave_layout.reserved_bss_base) +
+        (address - bss_base));
+  }
+  return nullptr;
+}
+
 }  // namespace
 
 bool IsSecureForkSupported() { return true; }
@@ -333,7 +560,59 @@ void SaveThreadLayoutForSnapshot() {
   forked_thread_memory_layout = thread_memory_layout;
 }
 
-void SetForkRequested() { fork_requested = true; }
+void SetForkRequested() {
+  fork_requested = true;
+  // Let the host lend threads to encrypt the snapshot.
+  OpenSnapshotWorkerRegistration();
+}
+
+void JoinSnapshotWorkers(void *avoid_thread_base, volatile int *joined) {
+  struct EnclaveMemoryLayout enclave_layout;
+  enc_get_memory_layout(&enclave_layout);
+  if (avoid_thread_base && enclave_layout.thread_base == avoid_thread_base) {
+    return;
+  }
+
+  uint32_t registration = snapshot_worker_registration.load();
+  do {
+    if ((registration & kSnapshotWorkersClosed) ||
+        registration >= kMaxSnapshotWorkers) {
+      return;
+    }
+  } while (!snapshot_worker_registration.compare_exchange_weak(
+      registration, registration + 1));
+  *joined = 1;
+
+  // Sleep on the host, off the TCS, until the registration is closed when the
+  // snapshot is about to be taken or restored, or the workers are released.
+  int32_t *queue = snapshot_worker_wait_queue;
+  while (!(snapshot_worker_registration.load() & kSnapshotWorkersClosed)) {
+    if (queue) {
+      enc_untrusted_thread_wait_value(queue, 0);
+    } else {
+      enc_pause();
+    }
+  }
+  snapshot_workers_awake.fetch_add(1, std::memory_order_release);
+
+  // Wait for the pool, which is published once the snapshot is ready to be
+  // encrypted or decrypted, or when the workers are released. Enclave entries
+  // are blocked meanwhile, so the workers could not return from a host call.
+  SnapshotChunkPool *pool;
+  while (!(pool = published_snapshot_chunks.load(std::memory_order_acquire))) {
+    enc_pause();
+  }
+  pool->worker_thread_bases[pool->joined.fetch_add(1)] =
+      enclave_layout.thread_base;
+  ProcessSnapshotChunks(pool);
+  // |pool| must not be accessed after leaving it.
+  pool->left.fetch_add(1, std::memory_order_release);
+}
+
+void ReleaseSnapshotWorkers() {
+  // Closes the registration, and releases the workers once destroyed.
+  SnapshotWorkers workers;
+}
 
 // Takes a snapshot of the enclave data/bss/heap and stack for the calling
 // thread by copying to untrusted memory.
@@ -344,6 +623,10 @@ Status TakeSnapshotForFork(SnapshotLayout *snapshot_layout) {
                   "Snapshot is not allowed unless fork is requested");
   }
 
+  // Host threads lent to the enclave to encrypt the snapshot in parallel. They
+  // are released on every return below.
+  SnapshotWorkers workers;
+
   if (!snapshot_layout) {
     return Status(error::GoogleError::INVALID_ARGUMENT,
                   "Snapshot layout is nullptr");
@@ -398,12 +681,14 @@ Status TakeSnapshotForFork(SnapshotLayout *snapshot_layout) {
   }
 
   // Block and check for other entries inside the enclave. Currently there
-  // should be two entries inside the enclave: snapshot ecall and the run ecall
-  // which calls fork. If other TCS are running inside the enclave, they may
-  // modify data/bss/heap and cause an inconsistent snapshot. In that case wait
-  // till all other TCS exit the enclave and get blocked from re-entering.
+  // should be two entries inside the enclave besides the snapshot workers:
+  // snapshot ecall and the run ecall which calls fork. If other TCS are running
+  // inside the enclave, they may modify data/bss/heap and cause an inconsistent
+  // snapshot. In that case wait till all other TCS exit the enclave and get
+  // blocked from re-entering.
   // Timeout at 3 seconds.
-  Status status = BlockAndWaitOnEntries(/*allowed_entries=*/2, /*timeout=*/3);
+  Status status = BlockAndWaitOnEntries(
+      /*allowed_entries=*/2 + workers.count(), /*timeout=*/3);
   if (!status.ok()) {
     return status;
   }
@@ -417,6 +702,16 @@ Status TakeSnapshotForFork(SnapshotLayout *snapshot_layout) {
   memcpy(enclave_layout.reserved_bss_base, enclave_layout.bss_base,
          enclave_layout.bss_size);
 
+  // Only the part of the heap that has ever been handed out by enclave_sbrk
+  // needs to be saved. The size is read after copying bss, which holds the
+  // same value, so that the child can tell how much of the heap to restore.
+  size_t heap_used = GetHeapUsed();
+  if (heap_used > enclave_layout.heap_size) {
+    enc_unblock_entries();
+    return Status(error::GoogleError::INTERNAL,
+                  "Used heap is larger than the enclave heap");
+  }
+
   // Stack-allocated error code and error message. A Status object is later
   // created from these components after the heap has been switched back.
   error::GoogleError error_code = error::GoogleError::OK;
@@ -438,68 +733,73 @@ Status TakeSnapshotForFork(SnapshotLayout *snapshot_layout) {
     // Create a temporary snapshot object on the switched heap.
     SnapshotLayout tmp_snapshot_layout;
 
-    // Create a cryptor based on the AES256-GCM-SIV snapshot key to encrypt
-    // the whole enclave memory.
-    auto cryptor_result = AeadCryptor::CreateAesGcmSivCryptor(snapshot_key);
-    if (!cryptor_result.ok()) {
-      CopyNonOkStatus(cryptor_result.status(), &error_code, error_message,
+    // Create a key based on the AES256-GCM-SIV snapshot key to encrypt the
+    // whole enclave memory. Unlike a cryptor, it can be used by the snapshot
+    // workers concurrently.
+    auto key_result = AeadKey::CreateAesGcmSivKey(snapshot_key);
+    if (!key_result.ok()) {
+      CopyNonOkStatus(key_result.status(), &error_code, error_message,
                       ABSL_ARRAYSIZE(error_message));
       break;
     }
-    std::unique_ptr<AeadCryptor> cryptor =
-        std::move(cryptor_result.ValueOrDie());
-
-    // Allocate and encrypt reserved data section to an untrusted snapshot.
-    status = EncryptToSnapshot(cryptor.get(), enclave_layout.reserved_data_base,
-                               enclave_layout.data_size,
-                               tmp_snapshot_layout.mutable_data());
-
-    if (!status.ok()) {
+    std::unique_ptr<AeadKey> key = std::move(key_result.ValueOrDie());
+    if (key->NonceSize() != kSnapshotNonceSize) {
+      status = Status(error::GoogleError::INTERNAL,
+                      "Unexpected nonce size of the snapshot key");
       CopyNonOkStatus(status, &error_code, error_message,
                       ABSL_ARRAYSIZE(error_message));
       break;
     }
 
-    // Allocate and encrypt reserved bss section to an untrusted snapshot.
-    status = EncryptToSnapshot(cryptor.get(), enclave_layout.reserved_bss_base,
-                               enclave_layout.bss_size,
-                               tmp_snapshot_layout.mutable_bss());
+    size_t stack_size = reinterpret_cast<size_t>(thread_layout.stack_base) -
+                        reinterpret_cast<size_t>(thread_layout.stack_limit);
 
-    if (!status.ok()) {
-      CopyNonOkStatus(status, &error_code, error_message,
-                      ABSL_ARRAYSIZE(error_message));
-      break;
+    // Split the reserved data and bss sections, the thread data and stack of
+    // the calling thread and the used part of the heap into chunks.
+    std::vector<SnapshotChunk> chunks;
+    chunks.reserve(NumSnapshotChunks(enclave_layout.data_size) +
+                   NumSnapshotChunks(enclave_layout.bss_size) +
+                   NumSnapshotChunks(thread_layout.thread_size) +
+                   NumSnapshotChunks(heap_used) +
+                   NumSnapshotChunks(stack_size));
+    status = PrepareSnapshotChunks(
+        enclave_layout.reserved_data_base, enclave_layout.data_size,
+        key->MaxSealOverhead(), tmp_snapshot_layout.mutable_data(), &chunks);
+    if (status.ok()) {
+      status = PrepareSnapshotChunks(
+          enclave_layout.reserved_bss_base, enclave_layout.bss_size,
+          key->MaxSealOverhead(), tmp_snapshot_layout.mutable_bss(), &chunks);
     }
-
-    // Allocate and encrypt thread data for the calling thread.
-    status = EncryptToSnapshot(cryptor.get(), thread_layout.thread_base,
-                               thread_layout.thread_size,
-                               tmp_snapshot_layout.mutable_thread());
-
-    if (!status.ok()) {
-      CopyNonOkStatus(status, &error_code, error_message,
-                      ABSL_ARRAYSIZE(error_message));
-      break;
+    if (status.ok()) {
+      status = PrepareSnapshotChunks(
+          thread_layout.thread_base, thread_layout.thread_size,
+          key->MaxSealOverhead(), tmp_snapshot_layout.mutable_thread(),
+          &chunks);
+    }
+    if (status.ok()) {
+      status = PrepareSnapshotChunks(enclave_layout.heap_base, heap_used,
+                                     key->MaxSealOverhead(),
+                                     tmp_snapshot_layout.mutable_heap(),
+                                     &chunks);
+    }
+    if (status.ok()) {
+      status = PrepareSnapshotChunks(
+          thread_layout.stack_limit, stack_size, key->MaxSealOverhead(),
+          tmp_snapshot_layout.mutable_stack(), &chunks);
     }
-
-    // Allocate and encrypt heap to an untrusted snapshot.
-    status = EncryptToSnapshot(cryptor.get(), enclave_layout.heap_base,
-                               enclave_layout.heap_size,
-                               tmp_snapshot_layout.mutable_heap());
-
     if (!status.ok()) {
       CopyNonOkStatus(status, &error_code, error_message,
                       ABSL_ARRAYSIZE(error_message));
       break;
     }
-
-    // Allocate and encrypt stack for the calling thread.
-    size_t stack_size = reinterpret_cast<size_t>(thread_layout.stack_base) -
-                        reinterpret_cast<size_t>(thread_layout.stack_limit);
-
-    status = EncryptToSnapshot(cryptor.get(), thread_layout.stack_limit,
-                               stack_size, tmp_snapshot_layout.mutable_stack());
-
+    tmp_snapshot_layout.set_forked_thread_base(
+        reinterpret_cast<uint64_t>(thread_layout.thread_base));
+    tmp_snapshot_layout.set_snapshot_workers(workers.count());
+
+    // Encrypt the chunks together with the snapshot workers.
+    SnapshotChunkPool pool(key.get(), /*seal=*/true, chunks.data(),
+                           chunks.size());
+    status = workers.Run(&pool);
     if (!status.ok()) {
       CopyNonOkStatus(status, &error_code, error_message,
                       ABSL_ARRAYSIZE(error_message));
@@ -536,39 +836,65 @@ Status TakeSnapshotForFork(SnapshotLayout *snapshot_layout) {
 
 // Decrypts and restores the enclave data/bss section and heap from
 // |snapshot_layout|, restores in enclave address space specified in
-// |enclave_layout|, with a cryptor created with |snapshot_key|.
+// |enclave_layout|, with |key|. Only the part of the heap that the parent had
+// used is restored, and the rest is cleared. The heap is decrypted together
+// with |workers|, which have left the enclave memory they run on alone once
+// this returns.
 Status DecryptAndRestoreEnclaveDataBssHeap(
     const SnapshotLayout &snapshot_layout,
-    const EnclaveMemoryLayout &enclave_layout,
-    const CleansingVector<uint8_t> &snapshot_key) {
-  // Create a cryptor based on the AES256-GCM-SIV snapshot key to decrypt the
-  // snapshot and restore the enclave.
-  std::unique_ptr<AeadCryptor> cryptor;
-  ASYLO_ASSIGN_OR_RETURN(cryptor,
-                         AeadCryptor::CreateAesGcmSivCryptor(snapshot_key));
-
-  // Decrypt the data section to reserved data, to avoid overwriting data used
-  // by the cryptor.
-  ASYLO_RETURN_IF_ERROR(
-      DecryptFromSnapshot(cryptor.get(), enclave_layout.reserved_data_base,
-                          enclave_layout.data_size, snapshot_layout.data()));
-
-  // Decrypt the bss section to reserved bss, to avoid overwriting bss used
-  // by the cryptor.
-  ASYLO_RETURN_IF_ERROR(
-      DecryptFromSnapshot(cryptor.get(), enclave_layout.reserved_bss_base,
-                          enclave_layout.bss_size, snapshot_layout.bss()));
-
-  // Decrypt and restore the heap. It is safe to overwrite the heap here because
-  // the heap used by the cryptor is allocated on the switched heap.
-  ASYLO_RETURN_IF_ERROR(
-      DecryptFromSnapshot(cryptor.get(), enclave_layout.heap_base,
-                          enclave_layout.heap_size, snapshot_layout.heap()));
+    const EnclaveMemoryLayout &enclave_layout, AeadKey *key,
+    SnapshotWorkers *workers) {
+  // Decrypt the data and bss sections to reserved data and bss, to avoid
+  // overwriting data used by the key. The workers wait on bss, which is
+  // restored below, so these are decrypted on the calling thread only.
+  std::vector<SnapshotChunk> chunks;
+  chunks.reserve(NumSnapshotChunks(enclave_layout.data_size) +
+                 NumSnapshotChunks(enclave_layout.bss_size));
+  ASYLO_RETURN_IF_ERROR(PrepareRestoreChunks(enclave_layout.reserved_data_base,
+                                             enclave_layout.data_size,
+                                             snapshot_layout.data(), &chunks));
+  ASYLO_RETURN_IF_ERROR(PrepareRestoreChunks(enclave_layout.reserved_bss_base,
+                                             enclave_layout.bss_size,
+                                             snapshot_layout.bss(), &chunks));
+  SnapshotChunkPool data_bss_pool(key, /*seal=*/false, chunks.data(),
+                                  chunks.size());
+  ProcessSnapshotChunks(&data_bss_pool);
+  ASYLO_RETURN_IF_ERROR(SnapshotChunkPoolStatus(data_bss_pool));
+
+  // The parent's count of enclave entries, which is restored with bss below,
+  // includes its snapshot workers, which were in the enclave just like the
+  // workers here. The count only stays right once the workers here leave if
+  // they are as many. The registration the parent saved holds its count.
+  const std::atomic<uint32_t> *parent_registration =
+      ReservedCopyOf(&snapshot_worker_registration, enclave_layout);
+  if (!parent_registration) {
+    return Status(error::GoogleError::INTERNAL,
+                  "Can't find the snapshot worker registration of the parent");
+  }
+  uint32_t parent_workers =
+      parent_registration->load(std::memory_order_relaxed) &
+      ~kSnapshotWorkersClosed;
+  if (parent_workers != workers->count()) {
+    return Status(error::GoogleError::FAILED_PRECONDITION,
+                  absl::StrCat("The snapshot was taken with ", parent_workers,
+                               " snapshot workers, but ", workers->count(),
+                               " joined to restore it"));
+  }
+
+  // The amount of heap the child has used so far, which must be cleared if
+  // the parent used less.
+  size_t child_heap_used = GetHeapUsed();
 
   void *switched_heap_next = GetSwitchedHeapNext();
   size_t switched_heap_remaining = GetSwitchedHeapRemaining();
 
-  // Copy the restored data and bss section to real data and bss.
+  // The parent may have committed more of its heap than the child, and the
+  // record of it is overwritten with the parent's bss below.
+  size_t child_heap_committed = primitives::GetCommittedHeapSize();
+
+  // Copy the restored data and bss section to real data and bss. The parent
+  // copied them before publishing any chunks to its workers, so the workers
+  // keep waiting for chunks.
   memcpy(enclave_layout.data_base, enclave_layout.reserved_data_base,
          enclave_layout.data_size);
   memcpy(enclave_layout.bss_base, enclave_layout.reserved_bss_base,
@@ -578,51 +904,98 @@ Status DecryptAndRestoreEnclaveDataBssHeap(
   // data and bss. We should set to the memory address before overwriting the
   // data, to avoid overwriting the existing memory on the switched heap.
   heap_switch(switched_heap_next, switched_heap_remaining);
+
+  // The restored bss holds the amount of heap the parent had used, which is
+  // trusted since it was decrypted from the snapshot. Only that part of the
+  // heap was saved. It is safe to overwrite the heap here because the heap used
+  // by the key is allocated on the switched heap.
+  size_t parent_heap_used = GetHeapUsed();
+  if (parent_heap_used > enclave_layout.heap_size) {
+    return Status(error::GoogleError::INTERNAL,
+                  "Used heap in the snapshot is larger than the enclave heap");
+  }
+  if (!primitives::RestoreCommittedHeapSize(child_heap_committed,
+                                            parent_heap_used)) {
+    return Status(error::GoogleError::RESOURCE_EXHAUSTED,
+                  "Failed to commit the enclave heap used by the parent");
+  }
+
+  // Decrypt the heap together with the workers.
+  std::vector<SnapshotChunk> heap_chunks;
+  heap_chunks.reserve(NumSnapshotChunks(parent_heap_used));
+  ASYLO_RETURN_IF_ERROR(PrepareRestoreChunks(enclave_layout.heap_base,
+                                             parent_heap_used,
+                                             snapshot_layout.heap(),
+                                             &heap_chunks));
+  SnapshotChunkPool heap_pool(key, /*seal=*/false, heap_chunks.data(),
+                              heap_chunks.size());
+  ASYLO_RETURN_IF_ERROR(workers->Run(&heap_pool));
+
+  // The thread data and stack of the thread that called fork are restored
+  // next, so no worker may have run on its TCS. The host is asked to keep the
+  // workers off it, which is checked against the restored data section here.
+  if (SnapshotWorkerOccupies(heap_pool,
+                             GetThreadLayoutForSnapshot().thread_base)) {
+    return Status(error::GoogleError::INTERNAL,
+                  "A snapshot worker ran on the TCS of the thread that called "
+                  "fork");
+  }
+
+  // The rest of the parent heap was never allocated, so it holds zeros. Clear
+  // whatever the child allocated beyond it.
+  if (child_heap_used > parent_heap_used) {
+    memset(reinterpret_cast<uint8_t *>(enclave_layout.heap_base) +
+               parent_heap_used,
+           0, child_heap_used - parent_heap_used);
+  }
   return Status::OkStatus();
 }
 
 // Decrypts and restores the thread information and stack of the thread that
-// calls fork. It creates a cryptor with |snapshot_key|, decrypts |thread_entry|
-// and |stack_entry| into the enclave.
-Status DecryptAndRestoreThreadStack(
-    const SnapshotLayout &snapshot_layout,
-    const CleansingVector<uint8_t> &snapshot_key) {
-  std::unique_ptr<AeadCryptor> cryptor;
-  ASYLO_ASSIGN_OR_RETURN(cryptor,
-                         AeadCryptor::CreateAesGcmSivCryptor(snapshot_key));
-
+// calls fork with |key|, from the thread and stack entries of
+// |snapshot_layout|.
+Status DecryptAndRestoreThreadStack(const SnapshotLayout &snapshot_layout,
+                                    AeadKey *key) {
   // Get the information of the thread that calls fork. These are saved in data
   // section, and should be available now since data/bss are restored.
   struct ThreadMemoryLayout thread_layout = GetThreadLayoutForSnapshot();
 
-  // Decrypt and restore the thread information. Restore happens in a different
-  // TCS (enclave thread) from the thread that requests fork(). Therefore it is
-  // OK to overwrite the stack since we are using different stack now.
-  ASYLO_RETURN_IF_ERROR(
-      DecryptFromSnapshot(cryptor.get(), thread_layout.thread_base,
-                          thread_layout.thread_size, snapshot_layout.thread()));
-
-  // are decrypting it in a different TCS from the thread that requests fork().
+  // Decrypt and restore the thread information and the stack. Restore happens
+  // in a different TCS (enclave thread) from the thread that requests fork().
+  // Therefore it is OK to overwrite the stack since we are using different
+  // stack now.
   size_t stack_size = reinterpret_cast<size_t>(thread_layout.stack_base) -
                       reinterpret_cast<size_t>(thread_layout.stack_limit);
-  ASYLO_RETURN_IF_ERROR(
-      DecryptFromSnapshot(cryptor.get(), thread_layout.stack_limit, stack_size,
-                          snapshot_layout.stack()));
-
-  return Status::OkStatus();
+  std::vector<SnapshotChunk> chunks;
+  chunks.reserve(NumSnapshotChunks(thread_layout.thread_size) +
+                 NumSnapshotChunks(stack_size));
+  ASYLO_RETURN_IF_ERROR(PrepareRestoreChunks(thread_layout.thread_base,
+                                             thread_layout.thread_size,
+                                             snapshot_layout.thread(),
+                                             &chunks));
+  ASYLO_RETURN_IF_ERROR(PrepareRestoreChunks(thread_layout.stack_limit,
+                                             stack_size,
+                                             snapshot_layout.stack(), &chunks));
+  SnapshotChunkPool pool(key, /*seal=*/false, chunks.data(), chunks.size());
+  ProcessSnapshotChunks(&pool);
+  return SnapshotChunkPoolStatus(pool);
 }
 
 // Restore the current enclave states from an untrusted snapshot.
 Status RestoreForFork(const char *input, size_t input_len) {
   Cleanup delete_snapshot_key(DeleteSnapshotKey);
 
+  // Host threads lent to the enclave to decrypt the snapshot in parallel. They
+  // are released on every return below.
+  SnapshotWorkers workers;
+
   // Blocks all other enclave entry calls, as there shouldn't be any attempts
   // to enter this enclave.
   enc_block_entries();
 
   // There shouldn't be any other ecalls running inside the child enclave at
-  // this moment.
-  if (active_entry_count() != 1) {
+  // this moment, besides the snapshot workers.
+  if (active_entry_count() != 1 + workers.count()) {
     return Status(
         error::GoogleError::FAILED_PRECONDITION,
         "There are other enclave entries while restoring the enclave");
@@ -636,7 +1009,7 @@ Status RestoreForFork(const char *input, size_t input_len) {
   char error_message[1024];
 
   // Switch heap allocation to a reserved memory section so that we are not
-  // overwriting the heap memory used by the cryptor when restoring heap.
+  // overwriting the heap memory used by the key when restoring heap.
   heap_switch(enclave_layout.reserved_heap_base,
               enclave_layout.reserved_heap_size);
 
@@ -667,10 +1040,18 @@ Status RestoreForFork(const char *input, size_t input_len) {
       break;
     }
 
+    auto key_result = AeadKey::CreateAesGcmSivKey(snapshot_key);
+    if (!key_result.ok()) {
+      CopyNonOkStatus(key_result.status(), &error_code, error_message,
+                      ABSL_ARRAYSIZE(error_message));
+      break;
+    }
+    std::unique_ptr<AeadKey> key = std::move(key_result.ValueOrDie());
+
     // Decrypt and restore data, bss section and heap before restoring thread
     // information and stack.
     Status status = DecryptAndRestoreEnclaveDataBssHeap(
-        snapshot_layout, enclave_layout, snapshot_key);
+        snapshot_layout, enclave_layout, key.get(), &workers);
     if (!status.ok()) {
       CopyNonOkStatus(status, &error_code, error_message,
                       ABSL_ARRAYSIZE(error_message));
@@ -680,7 +1061,7 @@ Status RestoreForFork(const char *input, size_t input_len) {
     // Now that data is restored, the information of the thread and stack
     // address of the calling thread can be retrieved. Decrypts the thread
     // information and stack.
-    status = DecryptAndRestoreThreadStack(snapshot_layout, snapshot_key);
+    status = DecryptAndRestoreThreadStack(snapshot_layout, key.get());
     if (!status.ok()) {
       CopyNonOkStatus(status, &error_code, error_message,
                       ABSL_ARRAYSIZE(error_message));
@@ -694,6 +1075,10 @@ Status RestoreForFork(const char *input, size_t input_len) {
     return Status(error_code, error_message);
   }
 
+  // The restored heap holds the hardware keys cached by the parent. Drop them
+  // so that the child derives its own keys.
+  sgx::CachingHardwareInterface::GetInstance()->ClearKeys();
+
   // Only allow other entries if restoring the child enclave succeeds.
   enc_unblock_entries();
   return Status::OkStatus();
@@ -888,6 +1273,9 @@ Status ReceiveSnapshotKey(std::unique_ptr<AeadCryptor> cryptor, int socket) {
     return Status(error::GoogleError::INTERNAL,
                   "Failed to save snapshot key inside enclave");
   }
+
+  // Let the host lend threads to decrypt the snapshot.
+  OpenSnapshotWorkerRegistration();
   return Status::OkStatus();
 }
 
@@ -54,6 +54,13 @@ void SetForkRequested() {
   abort();
 }
 
+void JoinSnapshotWorkers(void *avoid_thread_base, volatile int *joined) {
+  // Snapshots are only taken in the SGX hardware backend, so there is never
+  // anything to work on.
+}
+
+void ReleaseSnapshotWorkers() {}
+
 pid_t enc_fork(const char *enclave_name) {
   // Block enclave entries while forking to make sure no other threads are
   // holding enclave entry/exit locks during fork().
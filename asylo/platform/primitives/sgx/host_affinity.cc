@@ -0,0 +1,139 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/primitives/sgx/host_affinity.h"
+
+#include <errno.h>
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "asylo/util/posix_error_space.h"
+#include "asylo/util/status_macros.h"
+
+namespace asylo {
+namespace primitives {
+namespace {
+
+constexpr uintptr_t kPageSize = 4096;
+
+// Returns the CPUs of NUMA node |numa_node| as listed by sysfs.
+StatusOr<cpu_set_t> GetNumaNodeCpus(int numa_node) {
+  std::string path =
+      absl::StrCat("/sys/devices/system/node/node", numa_node, "/cpulist");
+  std::ifstream file(path);
+  if (!file) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  absl::StrCat("Cannot read the CPUs of NUMA node ", numa_node,
+                               " from ", path));
+  }
+  std::string cpu_list((std::istreambuf_iterator<char>(file)),
+                       std::istreambuf_iterator<char>());
+  return ParseCpuList(cpu_list);
+}
+
+}  // namespace
+
+StatusOr<cpu_set_t> ParseCpuList(absl::string_view cpu_list) {
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  for (absl::string_view range :
+       absl::StrSplit(absl::StripAsciiWhitespace(cpu_list), ',',
+                      absl::SkipEmpty())) {
+    std::vector<absl::string_view> bounds = absl::StrSplit(range, '-');
+    uint32_t first;
+    uint32_t last;
+    if (bounds.size() > 2 || !absl::SimpleAtoi(bounds.front(), &first) ||
+        !absl::SimpleAtoi(bounds.back(), &last) || first > last ||
+        last >= CPU_SETSIZE) {
+      return Status(error::GoogleError::INVALID_ARGUMENT,
+                    absl::StrCat("Malformed CPU list: ", cpu_list));
+    }
+    for (uint32_t cpu = first; cpu <= last; ++cpu) {
+      CPU_SET(cpu, &cpus);
+    }
+  }
+  return cpus;
+}
+
+StatusOr<HostAffinity> HostAffinity::Create(const std::vector<int> &cpus,
+                                            int numa_node) {
+  HostAffinity affinity;
+  for (int cpu : cpus) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+      return Status(error::GoogleError::INVALID_ARGUMENT,
+                    absl::StrCat("Invalid CPU ", cpu));
+    }
+    CPU_SET(cpu, &affinity.cpus_);
+  }
+  if (numa_node >= 0) {
+    affinity.numa_node_ = numa_node;
+    if (cpus.empty()) {
+      ASYLO_ASSIGN_OR_RETURN(affinity.cpus_, GetNumaNodeCpus(numa_node));
+    }
+  }
+  return affinity;
+}
+
+Status HostAffinity::PinCurrentThread() const {
+  if (!has_cpus()) {
+    return Status::OkStatus();
+  }
+  int result = pthread_setaffinity_np(pthread_self(), sizeof(cpus_), &cpus_);
+  if (result != 0) {
+    return Status(static_cast<error::PosixError>(result),
+                  "Failed to set the CPU affinity of a host thread");
+  }
+  return Status::OkStatus();
+}
+
+Status HostAffinity::BindMemory(void *address, size_t size) const {
+  if (!has_numa_node() || size == 0) {
+    return Status::OkStatus();
+  }
+  // mbind() operates on whole pages, so widen the range to page boundaries.
+  uintptr_t start = reinterpret_cast<uintptr_t>(address) & ~(kPageSize - 1);
+  uintptr_t end = reinterpret_cast<uintptr_t>(address) + size;
+  constexpr size_t kBitsPerMask = 8 * sizeof(unsigned long);
+  std::vector<unsigned long> node_mask(numa_node_ / kBitsPerMask + 1);
+  node_mask[numa_node_ / kBitsPerMask] = 1UL << (numa_node_ % kBitsPerMask);
+  // Called directly rather than through libnuma, which the host does not
+  // otherwise depend on. The kernel only reads the first |maxnode| - 1 bits of
+  // the mask.
+  if (syscall(SYS_mbind, start, end - start, MPOL_PREFERRED, node_mask.data(),
+              node_mask.size() * kBitsPerMask + 1, MPOL_MF_MOVE) != 0) {
+    return Status(static_cast<error::PosixError>(errno),
+                  absl::StrCat("Failed to bind untrusted memory to NUMA node ",
+                               numa_node_));
+  }
+  return Status::OkStatus();
+}
+
+}  // namespace primitives
+}  // namespace asylo
@@ -0,0 +1,73 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_PRIMITIVES_SGX_HOST_AFFINITY_H_
+#define ASYLO_PLATFORM_PRIMITIVES_SGX_HOST_AFFINITY_H_
+
+#include <sched.h>
+
+#include <cstddef>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "asylo/util/status.h"
+#include "asylo/util/statusor.h"
+
+namespace asylo {
+namespace primitives {
+
+// Parses a Linux CPU list such as "0-3,8,10-11", as found in
+// /sys/devices/system/node/node<N>/cpulist, into a CPU set.
+StatusOr<cpu_set_t> ParseCpuList(absl::string_view cpu_list);
+
+// The CPUs on which a group of host threads serving an enclave run, and the
+// NUMA node from which the untrusted memory they share with it is allocated.
+// A default-constructed affinity places no constraint on either.
+class HostAffinity {
+ public:
+  HostAffinity() { CPU_ZERO(&cpus_); }
+
+  // Returns an affinity confining threads to |cpus| and memory to
+  // |numa_node|. If |cpus| is empty, threads are confined to the CPUs of
+  // |numa_node| instead. A negative |numa_node| stands for no node.
+  static StatusOr<HostAffinity> Create(const std::vector<int> &cpus,
+                                       int numa_node);
+
+  // Whether threads are confined to a set of CPUs.
+  bool has_cpus() const { return CPU_COUNT(&cpus_) > 0; }
+
+  // Whether memory is allocated from a particular NUMA node.
+  bool has_numa_node() const { return numa_node_ >= 0; }
+
+  // Confines the calling thread to the CPUs of this affinity, if any.
+  Status PinCurrentThread() const;
+
+  // Makes the NUMA node of this affinity, if any, the preferred node of the
+  // pages spanning |size| bytes at |address|, and moves the pages already
+  // faulted in to it.
+  Status BindMemory(void *address, size_t size) const;
+
+ private:
+  cpu_set_t cpus_;
+  int numa_node_ = -1;
+};
+
+}  // namespace primitives
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_PRIMITIVES_SGX_HOST_AFFINITY_H_
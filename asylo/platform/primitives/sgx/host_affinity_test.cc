@@ -0,0 +1,95 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/primitives/sgx/host_affinity.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "asylo/test/util/status_matchers.h"
+#include "asylo/util/thread.h"
+
+namespace asylo {
+namespace primitives {
+namespace {
+
+using ::testing::Eq;
+
+TEST(HostAffinityTest, ParsesCpuLists) {
+  cpu_set_t cpus;
+  ASYLO_ASSERT_OK_AND_ASSIGN(cpus, ParseCpuList("0-2,5,7-8\n"));
+  EXPECT_THAT(CPU_COUNT(&cpus), Eq(6));
+  for (int cpu : {0, 1, 2, 5, 7, 8}) {
+    EXPECT_TRUE(CPU_ISSET(cpu, &cpus)) << cpu;
+  }
+
+  ASYLO_ASSERT_OK_AND_ASSIGN(cpus, ParseCpuList(""));
+  EXPECT_THAT(CPU_COUNT(&cpus), Eq(0));
+}
+
+TEST(HostAffinityTest, RejectsMalformedCpuLists) {
+  for (const char *cpu_list : {"a", "3-1", "1-2-3", "0,-1", "100000"}) {
+    EXPECT_THAT(ParseCpuList(cpu_list),
+                StatusIs(error::GoogleError::INVALID_ARGUMENT))
+        << cpu_list;
+  }
+}
+
+TEST(HostAffinityTest, DefaultAffinityIsUnconstrained) {
+  HostAffinity affinity;
+  EXPECT_FALSE(affinity.has_cpus());
+  EXPECT_FALSE(affinity.has_numa_node());
+  ASYLO_EXPECT_OK(affinity.PinCurrentThread());
+  int value = 0;
+  ASYLO_EXPECT_OK(affinity.BindMemory(&value, sizeof(value)));
+}
+
+TEST(HostAffinityTest, RejectsInvalidCpus) {
+  EXPECT_THAT(HostAffinity::Create({-1}, /*numa_node=*/-1),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+}
+
+TEST(HostAffinityTest, PinsThreadToCpus) {
+  cpu_set_t allowed;
+  ASSERT_THAT(sched_getaffinity(0, sizeof(allowed), &allowed), Eq(0));
+  int cpu = 0;
+  while (!CPU_ISSET(cpu, &allowed)) {
+    ++cpu;
+  }
+  HostAffinity affinity;
+  ASYLO_ASSERT_OK_AND_ASSIGN(affinity,
+                             HostAffinity::Create({cpu}, /*numa_node=*/-1));
+  EXPECT_TRUE(affinity.has_cpus());
+
+  cpu_set_t pinned;
+  Thread thread([&affinity, &pinned] {
+    ASYLO_EXPECT_OK(affinity.PinCurrentThread());
+    pthread_getaffinity_np(pthread_self(), sizeof(pinned), &pinned);
+  });
+  thread.Join();
+  EXPECT_THAT(CPU_COUNT(&pinned), Eq(1));
+  EXPECT_TRUE(CPU_ISSET(cpu, &pinned));
+}
+
+}  // namespace
+}  // namespace primitives
+}  // namespace asylo
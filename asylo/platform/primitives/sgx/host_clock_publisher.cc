@@ -0,0 +1,124 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/primitives/sgx/host_clock_publisher.h"
+
+#include <time.h>
+#include <x86intrin.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+#include "absl/memory/memory.h"
+#include "absl/numeric/int128.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+namespace primitives {
+namespace {
+
+constexpr size_t kPageSize = 4096;
+
+// Minimum nanoseconds between two samples used to measure the counter rate,
+// so that the scheduling jitter of the publishing thread stays negligible.
+constexpr int64_t kMinCalibrationNanoseconds = 10 * 1000 * 1000;
+
+int64_t ReadClock(clockid_t clock_id) {
+  struct timespec ts;
+  clock_gettime(clock_id, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+}  // namespace
+
+StatusOr<std::unique_ptr<HostClockPublisher>> HostClockPublisher::Create(
+    absl::Duration update_interval, bool publish_tsc) {
+  if (update_interval <= absl::ZeroDuration()) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "HostClockPublisher requires a positive update interval");
+  }
+
+  void *memory = nullptr;
+  if (posix_memalign(&memory, kPageSize, sizeof(HostClockPage)) != 0) {
+    return Status(error::GoogleError::RESOURCE_EXHAUSTED,
+                  "Failed to allocate the host clock page");
+  }
+  memset(memory, 0, sizeof(HostClockPage));
+  auto page = reinterpret_cast<HostClockPage *>(memory);
+  page->update_interval_ns = absl::ToInt64Nanoseconds(update_interval);
+
+  std::unique_ptr<HostClockPublisher> publisher(
+      new HostClockPublisher(page, update_interval, publish_tsc));
+  // Publish once before handing out the page, so that it never holds an
+  // uninitialized sample.
+  publisher->Publish();
+  page->magic = kHostClockPageMagic;
+  publisher->thread_ =
+      absl::make_unique<Thread>(&HostClockPublisher::Run, publisher.get());
+  return std::move(publisher);
+}
+
+HostClockPublisher::HostClockPublisher(HostClockPage *page,
+                                       absl::Duration update_interval,
+                                       bool publish_tsc)
+    : page_(page),
+      update_interval_(update_interval),
+      publish_tsc_(publish_tsc) {
+  memset(&first_sample_, 0, sizeof(first_sample_));
+}
+
+HostClockPublisher::~HostClockPublisher() {
+  stop_.Notify();
+  if (thread_) {
+    thread_->Join();
+  }
+  free(page_);
+}
+
+void HostClockPublisher::Run() {
+  while (!stop_.WaitForNotificationWithTimeout(update_interval_)) {
+    Publish();
+  }
+}
+
+void HostClockPublisher::Publish() {
+  HostClockSample sample;
+  sample.tsc = publish_tsc_ ? __rdtsc() : 0;
+  sample.realtime_ns = ReadClock(CLOCK_REALTIME);
+  sample.monotonic_ns = ReadClock(CLOCK_MONOTONIC);
+  sample.nanoseconds_per_tick_q32 = 0;
+
+  if (publish_tsc_) {
+    if (first_sample_.tsc == 0) {
+      first_sample_ = sample;
+    }
+    int64_t elapsed_ns = sample.monotonic_ns - first_sample_.monotonic_ns;
+    uint64_t elapsed_ticks = sample.tsc - first_sample_.tsc;
+    if (elapsed_ns >= kMinCalibrationNanoseconds && elapsed_ticks > 0) {
+      sample.nanoseconds_per_tick_q32 = absl::Uint128Low64(
+          (absl::uint128(elapsed_ns) << 32) / elapsed_ticks);
+    }
+  }
+
+  PublishHostClockSample(page_, sample);
+}
+
+}  // namespace primitives
+}  // namespace asylo
@@ -0,0 +1,77 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_PRIMITIVES_SGX_HOST_CLOCK_PUBLISHER_H_
+#define ASYLO_PLATFORM_PRIMITIVES_SGX_HOST_CLOCK_PUBLISHER_H_
+
+#include <memory>
+
+#include "absl/synchronization/notification.h"
+#include "absl/time/time.h"
+#include "asylo/platform/common/host_clock_page.h"
+#include "asylo/util/statusor.h"
+#include "asylo/util/thread.h"
+
+namespace asylo {
+namespace primitives {
+
+// Owns a host clock page in untrusted memory together with the host thread
+// publishing the host clocks to it.
+class HostClockPublisher {
+ public:
+  // Allocates a host clock page and starts a thread publishing to it every
+  // |update_interval|. If |publish_tsc| is true, each sample also carries the
+  // time stamp counter and its rate, so that readers able to read the counter
+  // can extrapolate between samples.
+  static StatusOr<std::unique_ptr<HostClockPublisher>> Create(
+      absl::Duration update_interval, bool publish_tsc);
+
+  // Stops the publishing thread and frees the page.
+  ~HostClockPublisher();
+
+  HostClockPublisher(const HostClockPublisher &other) = delete;
+  HostClockPublisher &operator=(const HostClockPublisher &other) = delete;
+
+  // Returns the page shared with the enclave.
+  HostClockPage *page() const { return page_; }
+
+ private:
+  HostClockPublisher(HostClockPage *page, absl::Duration update_interval,
+                     bool publish_tsc);
+
+  // Body of the publishing thread.
+  void Run();
+
+  // Reads the host clocks and publishes them to the page.
+  void Publish();
+
+  HostClockPage *const page_;
+  const absl::Duration update_interval_;
+  const bool publish_tsc_;
+
+  // The first sample published, against which the counter rate is measured.
+  HostClockSample first_sample_;
+
+  absl::Notification stop_;
+  std::unique_ptr<Thread> thread_;
+};
+
+}  // namespace primitives
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_PRIMITIVES_SGX_HOST_CLOCK_PUBLISHER_H_
@@ -0,0 +1,110 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/primitives/sgx/host_clock_publisher.h"
+
+#include <time.h>
+
+#include <cstdint>
+#include <memory>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "asylo/platform/common/host_clock_page.h"
+#include "asylo/test/util/status_matchers.h"
+
+namespace asylo {
+namespace primitives {
+namespace {
+
+using ::testing::Eq;
+using ::testing::Gt;
+using ::testing::Le;
+
+int64_t MonotonicNanoseconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+HostClockSample ReadSample(const HostClockPage *page) {
+  HostClockSample sample;
+  EXPECT_TRUE(ReadHostClockSample(page, &sample));
+  return sample;
+}
+
+TEST(HostClockPublisherTest, RejectsNonPositiveInterval) {
+  EXPECT_THAT(HostClockPublisher::Create(absl::ZeroDuration(),
+                                         /*publish_tsc=*/false),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+}
+
+TEST(HostClockPublisherTest, PageIsInitializedOnCreation) {
+  int64_t before = MonotonicNanoseconds();
+  auto publisher_result =
+      HostClockPublisher::Create(absl::Hours(1), /*publish_tsc=*/false);
+  ASSERT_THAT(publisher_result, IsOk());
+  int64_t after = MonotonicNanoseconds();
+
+  const HostClockPage *page = publisher_result.ValueOrDie()->page();
+  EXPECT_THAT(page->magic, Eq(kHostClockPageMagic));
+  EXPECT_THAT(page->update_interval_ns,
+              Eq(absl::ToInt64Nanoseconds(absl::Hours(1))));
+  EXPECT_THAT(page->sequence % 2, Eq(0));
+
+  HostClockSample sample = ReadSample(page);
+  EXPECT_THAT(sample.monotonic_ns, Gt(before - 1));
+  EXPECT_THAT(sample.monotonic_ns, Le(after));
+  EXPECT_THAT(sample.realtime_ns, Gt(0));
+  EXPECT_THAT(sample.tsc, Eq(0));
+  EXPECT_THAT(sample.nanoseconds_per_tick_q32, Eq(0));
+}
+
+TEST(HostClockPublisherTest, SamplesAdvance) {
+  auto publisher_result =
+      HostClockPublisher::Create(absl::Milliseconds(1), /*publish_tsc=*/false);
+  ASSERT_THAT(publisher_result, IsOk());
+  const HostClockPage *page = publisher_result.ValueOrDie()->page();
+
+  HostClockSample first = ReadSample(page);
+  absl::SleepFor(absl::Milliseconds(50));
+  HostClockSample second = ReadSample(page);
+  EXPECT_THAT(second.monotonic_ns, Gt(first.monotonic_ns));
+  EXPECT_THAT(second.realtime_ns, Gt(first.realtime_ns));
+  EXPECT_THAT(MonotonicNanoseconds() - second.monotonic_ns,
+              Le(absl::ToInt64Nanoseconds(absl::Milliseconds(50))));
+}
+
+TEST(HostClockPublisherTest, CalibratesTimeStampCounter) {
+  auto publisher_result =
+      HostClockPublisher::Create(absl::Milliseconds(1), /*publish_tsc=*/true);
+  ASSERT_THAT(publisher_result, IsOk());
+  const HostClockPage *page = publisher_result.ValueOrDie()->page();
+
+  EXPECT_THAT(ReadSample(page).tsc, Gt(0));
+  absl::SleepFor(absl::Milliseconds(100));
+  HostClockSample sample = ReadSample(page);
+  EXPECT_THAT(sample.tsc, Gt(0));
+  EXPECT_THAT(sample.nanoseconds_per_tick_q32, Gt(0));
+}
+
+}  // namespace
+}  // namespace primitives
+}  // namespace asylo
@@ -0,0 +1,186 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/primitives/sgx/host_io_uring.h"
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#include "absl/strings/str_cat.h"
+#include "asylo/util/posix_error_space.h"
+#include "asylo/util/status.h"
+#include "asylo/util/status_macros.h"
+
+namespace asylo {
+namespace primitives {
+namespace {
+
+static_assert(kIoUringOpAccept == IORING_OP_ACCEPT, "IORING_OP_ACCEPT");
+static_assert(kIoUringOpRead == IORING_OP_READ, "IORING_OP_READ");
+static_assert(kIoUringOpWrite == IORING_OP_WRITE, "IORING_OP_WRITE");
+static_assert(kIoUringOpSend == IORING_OP_SEND, "IORING_OP_SEND");
+static_assert(kIoUringOpRecv == IORING_OP_RECV, "IORING_OP_RECV");
+static_assert(kIoUringEnterGetEvents == IORING_ENTER_GETEVENTS,
+              "IORING_ENTER_GETEVENTS");
+static_assert(kIoUringEnterSqWakeup == IORING_ENTER_SQ_WAKEUP,
+              "IORING_ENTER_SQ_WAKEUP");
+static_assert(kIoUringSqNeedWakeup == IORING_SQ_NEED_WAKEUP,
+              "IORING_SQ_NEED_WAKEUP");
+static_assert(sizeof(IoUringSqe) == sizeof(struct io_uring_sqe),
+              "struct io_uring_sqe");
+static_assert(offsetof(IoUringSqe, off) == offsetof(struct io_uring_sqe, off),
+              "io_uring_sqe::off");
+static_assert(offsetof(IoUringSqe, addr) ==
+                  offsetof(struct io_uring_sqe, addr),
+              "io_uring_sqe::addr");
+static_assert(offsetof(IoUringSqe, op_flags) ==
+                  offsetof(struct io_uring_sqe, msg_flags),
+              "io_uring_sqe::msg_flags");
+static_assert(offsetof(IoUringSqe, user_data) ==
+                  offsetof(struct io_uring_sqe, user_data),
+              "io_uring_sqe::user_data");
+static_assert(sizeof(IoUringCqe) == sizeof(struct io_uring_cqe),
+              "struct io_uring_cqe");
+static_assert(offsetof(IoUringCqe, res) == offsetof(struct io_uring_cqe, res),
+              "io_uring_cqe::res");
+
+// Milliseconds without submissions after which the kernel polling thread goes
+// to sleep.
+constexpr uint32_t kSqThreadIdleMilliseconds = 100;
+
+constexpr size_t kPageSize = 4096;
+
+int IoUringSetup(uint32_t entries, struct io_uring_params *params) {
+  return syscall(__NR_io_uring_setup, entries, params);
+}
+
+template <typename T>
+T *RingField(void *ring, uint32_t offset) {
+  return reinterpret_cast<T *>(static_cast<uint8_t *>(ring) + offset);
+}
+
+}  // namespace
+
+StatusOr<std::unique_ptr<HostIoUring>> HostIoUring::Create(
+    uint32_t entries, uint32_t buffer_size) {
+  if (entries == 0 || buffer_size == 0) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "HostIoUring requires at least one entry and a nonzero "
+                  "buffer size");
+  }
+
+  std::unique_ptr<HostIoUring> ring(new HostIoUring());
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  params.flags = IORING_SETUP_SQPOLL;
+  params.sq_thread_idle = kSqThreadIdleMilliseconds;
+  ring->ring_fd_ = IoUringSetup(entries, &params);
+  if (ring->ring_fd_ == -1 && errno == EPERM) {
+    // Polling threads require privileges before Linux 5.11.
+    memset(&params, 0, sizeof(params));
+    ring->ring_fd_ = IoUringSetup(entries, &params);
+  }
+  if (ring->ring_fd_ == -1) {
+    return Status(static_cast<error::PosixError>(errno),
+                  "Failed to set up an io_uring instance");
+  }
+
+  ASYLO_RETURN_IF_ERROR(ring->MapRing(
+      params.sq_off.array + params.sq_entries * sizeof(uint32_t),
+      IORING_OFF_SQ_RING, &ring->sq_ring_));
+  ASYLO_RETURN_IF_ERROR(ring->MapRing(
+      params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe),
+      IORING_OFF_CQ_RING, &ring->cq_ring_));
+  ASYLO_RETURN_IF_ERROR(
+      ring->MapRing(params.sq_entries * sizeof(struct io_uring_sqe),
+                    IORING_OFF_SQES, &ring->sqes_));
+
+  // The layout takes the first page of the mapping, followed by the buffers.
+  static_assert(sizeof(IoUringLayout) <= kPageSize,
+                "IoUringLayout does not fit a page");
+  ring->buffers_.size =
+      kPageSize + static_cast<size_t>(params.sq_entries) * buffer_size;
+  ring->buffers_.address =
+      mmap(/*addr=*/nullptr, ring->buffers_.size, PROT_READ | PROT_WRITE,
+           MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, /*fd=*/-1,
+           /*offset=*/0);
+  if (ring->buffers_.address == MAP_FAILED) {
+    ring->buffers_.address = nullptr;
+    return Status(error::GoogleError::RESOURCE_EXHAUSTED,
+                  "Failed to allocate the io_uring bounce buffers");
+  }
+
+  auto layout = static_cast<IoUringLayout *>(ring->buffers_.address);
+  auto buffers = static_cast<uint8_t *>(ring->buffers_.address) + kPageSize;
+  layout->ring_fd = ring->ring_fd_;
+  layout->sq_polled = (params.flags & IORING_SETUP_SQPOLL) ? 1 : 0;
+  void *sq_ring = ring->sq_ring_.address;
+  layout->sq_head = RingField<uint32_t>(sq_ring, params.sq_off.head);
+  layout->sq_tail = RingField<uint32_t>(sq_ring, params.sq_off.tail);
+  layout->sq_flags = RingField<uint32_t>(sq_ring, params.sq_off.flags);
+  layout->sq_array = RingField<uint32_t>(sq_ring, params.sq_off.array);
+  layout->sq_entries = params.sq_entries;
+  void *cq_ring = ring->cq_ring_.address;
+  layout->cq_entries = params.cq_entries;
+  layout->cq_head = RingField<uint32_t>(cq_ring, params.cq_off.head);
+  layout->cq_tail = RingField<uint32_t>(cq_ring, params.cq_off.tail);
+  layout->cqes = RingField<IoUringCqe>(cq_ring, params.cq_off.cqes);
+  layout->sqes = static_cast<IoUringSqe *>(ring->sqes_.address);
+  layout->buffers = buffers;
+  layout->buffer_count = params.sq_entries;
+  layout->buffer_size = buffer_size;
+  layout->magic = kIoUringLayoutMagic;
+  ring->layout_ = layout;
+  return std::move(ring);
+}
+
+HostIoUring::~HostIoUring() {
+  for (Mapping *mapping : {&buffers_, &sqes_, &cq_ring_, &sq_ring_}) {
+    if (mapping->address) {
+      munmap(mapping->address, mapping->size);
+    }
+  }
+  if (ring_fd_ != -1) {
+    close(ring_fd_);
+  }
+}
+
+Status HostIoUring::MapRing(size_t size, uint64_t offset, Mapping *mapping) {
+  size = (size + kPageSize - 1) & ~(kPageSize - 1);
+  void *address = mmap(/*addr=*/nullptr, size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ring_fd_, offset);
+  if (address == MAP_FAILED) {
+    return Status(static_cast<error::PosixError>(errno),
+                  absl::StrCat("Failed to map io_uring region at offset ",
+                               offset));
+  }
+  mapping->address = address;
+  mapping->size = size;
+  return Status::OkStatus();
+}
+
+}  // namespace primitives
+}  // namespace asylo
@@ -0,0 +1,76 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_PRIMITIVES_SGX_HOST_IO_URING_H_
+#define ASYLO_PLATFORM_PRIMITIVES_SGX_HOST_IO_URING_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "asylo/platform/common/io_uring_layout.h"
+#include "asylo/util/statusor.h"
+
+namespace asylo {
+namespace primitives {
+
+// Owns an io_uring instance set up on behalf of an enclave, together with the
+// untrusted bounce buffers the enclave exchanges data through and the layout
+// describing both to the enclave.
+class HostIoUring {
+ public:
+  // Sets up an io_uring instance with at least |entries| submission queue
+  // entries, and one bounce buffer of |buffer_size| bytes per entry. The
+  // submission queue is polled by a kernel thread if the kernel allows it, so
+  // that the enclave can submit without a host call while the thread is awake.
+  static StatusOr<std::unique_ptr<HostIoUring>> Create(uint32_t entries,
+                                                       uint32_t buffer_size);
+
+  // Tears down the instance and frees the buffers.
+  ~HostIoUring();
+
+  HostIoUring(const HostIoUring &other) = delete;
+  HostIoUring &operator=(const HostIoUring &other) = delete;
+
+  // Returns the layout shared with the enclave.
+  IoUringLayout *layout() const { return layout_; }
+
+ private:
+  HostIoUring() = default;
+
+  // A memory mapping owned by the instance.
+  struct Mapping {
+    void *address = nullptr;
+    size_t size = 0;
+  };
+
+  // Maps |size| bytes of the ring at |offset| into |mapping|.
+  Status MapRing(size_t size, uint64_t offset, Mapping *mapping);
+
+  int ring_fd_ = -1;
+  Mapping sq_ring_;
+  Mapping cq_ring_;
+  Mapping sqes_;
+  Mapping buffers_;
+  IoUringLayout *layout_ = nullptr;
+};
+
+}  // namespace primitives
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_PRIMITIVES_SGX_HOST_IO_URING_H_
@@ -0,0 +1,143 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/primitives/sgx/host_io_uring.h"
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "asylo/platform/common/io_uring_layout.h"
+#include "asylo/test/util/status_matchers.h"
+#include "asylo/util/posix_error_space.h"
+
+namespace asylo {
+namespace primitives {
+namespace {
+
+using ::testing::Eq;
+using ::testing::Ge;
+
+// Returns a ring, or nullptr if the host does not support io_uring.
+std::unique_ptr<HostIoUring> CreateRingOrSkip(uint32_t entries,
+                                              uint32_t buffer_size) {
+  auto ring_result = HostIoUring::Create(entries, buffer_size);
+  if (!ring_result.ok() &&
+      (ring_result.status().Is(error::PosixError::P_ENOSYS) ||
+       ring_result.status().Is(error::PosixError::P_EPERM))) {
+    return nullptr;
+  }
+  EXPECT_THAT(ring_result, IsOk());
+  return ring_result.ok() ? std::move(ring_result).ValueOrDie() : nullptr;
+}
+
+// Submits |sqe| through |layout| and waits for its completion.
+IoUringCqe SubmitAndWait(IoUringLayout *layout, const IoUringSqe &sqe) {
+  uint32_t mask = layout->sq_entries - 1;
+  uint32_t tail = *layout->sq_tail;
+  uint32_t index = tail & mask;
+  layout->sqes[index] = sqe;
+  layout->sq_array[index] = index;
+  __atomic_store_n(layout->sq_tail, tail + 1, __ATOMIC_RELEASE);
+  uint32_t flags = kIoUringEnterGetEvents;
+  if (layout->sq_polled) {
+    flags |= kIoUringEnterSqWakeup;
+  }
+  EXPECT_THAT(syscall(__NR_io_uring_enter, layout->ring_fd,
+                      layout->sq_polled ? 0 : 1, /*min_complete=*/1, flags,
+                      nullptr, 0),
+              Ge(0));
+
+  uint32_t head = *layout->cq_head;
+  EXPECT_THAT(__atomic_load_n(layout->cq_tail, __ATOMIC_ACQUIRE), Eq(head + 1));
+  IoUringCqe cqe = layout->cqes[head & (layout->cq_entries - 1)];
+  __atomic_store_n(layout->cq_head, head + 1, __ATOMIC_RELEASE);
+  return cqe;
+}
+
+TEST(HostIoUringTest, RejectsEmptyRings) {
+  EXPECT_THAT(HostIoUring::Create(0, 4096),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+  EXPECT_THAT(HostIoUring::Create(8, 0),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+}
+
+TEST(HostIoUringTest, DescribesRingAndBuffers) {
+  auto ring = CreateRingOrSkip(/*entries=*/5, /*buffer_size=*/1000);
+  if (!ring) {
+    return;
+  }
+  IoUringLayout *layout = ring->layout();
+  EXPECT_THAT(layout->magic, Eq(kIoUringLayoutMagic));
+  EXPECT_THAT(layout->sq_entries, Ge(5));
+  EXPECT_THAT(layout->sq_entries & (layout->sq_entries - 1), Eq(0));
+  EXPECT_THAT(layout->cq_entries & (layout->cq_entries - 1), Eq(0));
+  EXPECT_THAT(layout->buffer_count, Eq(layout->sq_entries));
+  EXPECT_THAT(layout->buffer_size, Eq(1000));
+
+  // Every buffer is writable.
+  memset(layout->buffers, 0xab,
+         static_cast<size_t>(layout->buffer_count) * layout->buffer_size);
+}
+
+TEST(HostIoUringTest, ServesReadsAndWritesFromBuffers) {
+  auto ring = CreateRingOrSkip(/*entries=*/4, /*buffer_size=*/64);
+  if (!ring) {
+    return;
+  }
+  IoUringLayout *layout = ring->layout();
+  int pipe_fds[2];
+  ASSERT_THAT(pipe(pipe_fds), Eq(0));
+
+  constexpr char kMessage[] = "through the ring";
+  memcpy(layout->buffers, kMessage, sizeof(kMessage));
+  IoUringSqe sqe = {};
+  sqe.opcode = kIoUringOpWrite;
+  sqe.fd = pipe_fds[1];
+  sqe.off = static_cast<uint64_t>(-1);
+  sqe.addr = reinterpret_cast<uint64_t>(layout->buffers);
+  sqe.len = sizeof(kMessage);
+  sqe.user_data = 1;
+  IoUringCqe cqe = SubmitAndWait(layout, sqe);
+  EXPECT_THAT(cqe.user_data, Eq(1));
+  EXPECT_THAT(cqe.res, Eq(sizeof(kMessage)));
+
+  uint8_t *buffer = layout->buffers + layout->buffer_size;
+  sqe.opcode = kIoUringOpRead;
+  sqe.fd = pipe_fds[0];
+  sqe.addr = reinterpret_cast<uint64_t>(buffer);
+  sqe.len = layout->buffer_size;
+  sqe.user_data = 2;
+  cqe = SubmitAndWait(layout, sqe);
+  EXPECT_THAT(cqe.user_data, Eq(2));
+  ASSERT_THAT(cqe.res, Eq(sizeof(kMessage)));
+  EXPECT_THAT(memcmp(buffer, kMessage, sizeof(kMessage)), Eq(0));
+
+  close(pipe_fds[0]);
+  close(pipe_fds[1]);
+}
+
+}  // namespace
+}  // namespace primitives
+}  // namespace asylo
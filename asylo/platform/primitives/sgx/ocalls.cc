@@ -255,7 +255,17 @@ int ocall_enc_untrusted_register_signal_handler(int klinux_signum,
 //            unistd.h              //
 //////////////////////////////////////
 
-void ocall_enc_untrusted__exit(int rc) { _exit(rc); }
+void ocall_enc_untrusted__exit(int rc) {
+  // The process ends without destroying the enclave, so this is the last
+  // chance to write its exit profile.
+  auto primitive_client = dynamic_cast<asylo::primitives::SgxEnclaveClient *>(
+      asylo::primitives::Client::GetCurrentClient());
+  if (primitive_client) {
+    asylo::Status status = primitive_client->WriteExitProfile();
+    LOG_IF(ERROR, !status.ok()) << "Failed to write exit profile: " << status;
+  }
+  _exit(rc);
+}
 
 int32_t ocall_enc_untrusted_fork(const char *enclave_name,
                                  bool restore_snapshot) {
@@ -429,6 +439,15 @@ int32_t ocall_enc_untrusted_fork(const char *enclave_name,
       return -1;
     }
   } else {
+    // Only the child restores from the snapshot, and it has its own copy of
+    // the snapshot memory. Release the parent's copy now rather than holding it
+    // until the child has finished restoring.
+    data_deleter_.clear();
+    bss_deleter_.clear();
+    heap_deleter_.clear();
+    thread_deleter_.clear();
+    stack_deleter_.clear();
+
     if (close(pipefd[1]) < 0) {
       LOG(ERROR) << "Failed to close pipefd: " << strerror(errno);
       errno = EFAULT;
@@ -482,12 +501,18 @@ int32_t ocall_enc_untrusted_fork(const char *enclave_name,
 int ocall_dispatch_untrusted_call(uint64_t selector, void *buffer) {
   asylo::SgxParams *const sgx_params =
       reinterpret_cast<asylo::SgxParams *>(buffer);
+  sgx_params->output_size = 0;
+  sgx_params->output = nullptr;
+  // The enclave keeps |input| alive and unchanged until the call returns, so
+  // the exit handler can read the extents in place.
   ::asylo::primitives::MessageReader in;
   if (sgx_params->input) {
-    in.Deserialize(sgx_params->input, sgx_params->input_size);
+    auto read_status =
+        in.DeserializeInPlace(sgx_params->input, sgx_params->input_size);
+    if (!read_status.ok()) {
+      return read_status.error_code();
+    }
   }
-  sgx_params->output_size = 0;
-  sgx_params->output = nullptr;
   ::asylo::primitives::MessageWriter out;
   const auto status =
       ::asylo::primitives::Client::ExitCallback(selector, &in, &out);
@@ -525,3 +550,21 @@ uint32_t ocall_enc_untrusted_qe_get_quote(const sgx_report_t *app_report,
                                           uint32_t quote_size, uint8_t *quote) {
   return sgx_qe_get_quote(app_report, quote_size, quote);
 }
+
+uint32_t ocall_enc_untrusted_qe_get_quotes(const sgx_report_t *app_reports,
+                                           uint32_t report_count,
+                                           uint32_t quote_size, uint8_t *quotes,
+                                           uint64_t quotes_size) {
+  if (quotes_size != static_cast<uint64_t>(report_count) * quote_size) {
+    return SGX_QL_ERROR_INVALID_PARAMETER;
+  }
+  for (uint32_t i = 0; i < report_count; ++i) {
+    quote3_error_t result = sgx_qe_get_quote(
+        &app_reports[i], quote_size,
+        quotes + static_cast<uint64_t>(i) * quote_size);
+    if (result != SGX_QL_SUCCESS) {
+      return result;
+    }
+  }
+  return SGX_QL_SUCCESS;
+}
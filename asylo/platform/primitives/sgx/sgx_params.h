@@ -23,8 +23,8 @@
 
 namespace asylo {
 
-// Helper structure needed for passing 4 parameters to and from SGX layer
-// in a single message, referred to as void *buffer.
+// Helper structure needed for passing parameters to and from SGX layer in a
+// single message, referred to as void *buffer.
 struct SgxParams {
   // Serialized input parameters - if input != nullptr, input_size is its size,
   // otherwise input_size = 0.
@@ -34,6 +34,12 @@ struct SgxParams {
   // otherwise output_size = 0.
   void *output;
   uint64_t output_size;
+  // A buffer of output_capacity bytes in which the callee may place results
+  // that fit, in which case output == output_buffer and the buffer remains
+  // owned by the caller. Otherwise output is allocated for the caller to free.
+  // Only used by enclave calls; null for calls out of the enclave.
+  void *output_buffer;
+  uint64_t output_capacity;
 };
 
 }  // namespace asylo
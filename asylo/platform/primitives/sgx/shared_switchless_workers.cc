@@ -0,0 +1,315 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/primitives/sgx/shared_switchless_workers.h"
+
+#include <sched.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "asylo/platform/core/atomic.h"
+#include "asylo/platform/primitives/sgx/switchless_workers.h"
+#include "asylo/util/logging.h"
+#include "asylo/util/status.h"
+#include "asylo/util/status_macros.h"
+
+namespace asylo {
+namespace primitives {
+
+// A registered ring. Workers keep entries alive through the lists they scan,
+// so the ring is freed once the last of them drops the entry.
+struct SharedSwitchlessWorkerPool::Registration::Entry {
+  Entry(Client *client, SwitchlessRing *ring, size_t worker_threads)
+      : client(client), ring(ring), worker_threads(worker_threads) {}
+
+  ~Entry() { free(ring); }
+
+  Client *const client;
+  SwitchlessRing *const ring;
+  const size_t worker_threads;
+
+  // Index of the slot the next scan of the ring starts from, so that slots
+  // are serviced in turn.
+  std::atomic<size_t> next_slot{0};
+
+  // Set once the ring is unregistered, after which workers claim no more of
+  // its requests.
+  std::atomic<bool> unregistered{false};
+
+  // Number of workers between checking |unregistered| and finishing a request
+  // claimed from the ring.
+  std::atomic<size_t> in_flight{0};
+};
+
+SharedSwitchlessWorkerPool::Registration::~Registration() {
+  pool_->Unregister(entry_);
+}
+
+SwitchlessRing *SharedSwitchlessWorkerPool::Registration::ring() const {
+  return entry_->ring;
+}
+
+SharedSwitchlessWorkerPool *SharedSwitchlessWorkerPool::Get() {
+  static SharedSwitchlessWorkerPool *pool =
+      new SharedSwitchlessWorkerPool(Options());
+  return pool;
+}
+
+SharedSwitchlessWorkerPool::SharedSwitchlessWorkerPool(
+    const Options &options, const HostAffinity &affinity)
+    : options_(options),
+      affinity_(affinity),
+      rings_(std::make_shared<const EntryList>()) {}
+
+SharedSwitchlessWorkerPool::~SharedSwitchlessWorkerPool() {
+  std::vector<Thread> workers;
+  {
+    absl::MutexLock lock(&mu_);
+    CHECK(rings_->empty())
+        << "SharedSwitchlessWorkerPool destroyed with registered rings";
+    stopping_.store(true, std::memory_order_relaxed);
+    wake_cv_.SignalAll();
+    workers = std::move(workers_);
+  }
+  for (auto &worker : workers) {
+    worker.Join();
+  }
+}
+
+StatusOr<std::unique_ptr<SharedSwitchlessWorkerPool::Registration>>
+SharedSwitchlessWorkerPool::Register(Client *client, size_t worker_threads,
+                                     size_t ring_slots,
+                                     const HostAffinity &ring_affinity) {
+  if (!client) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "SharedSwitchlessWorkerPool requires a client");
+  }
+  if (worker_threads == 0 || ring_slots == 0) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "SharedSwitchlessWorkerPool requires at least one worker "
+                  "thread and one ring slot per ring");
+  }
+
+  SwitchlessRing *ring;
+  ASYLO_ASSIGN_OR_RETURN(ring,
+                         AllocateSwitchlessRing(ring_slots, ring_affinity));
+  auto entry =
+      std::make_shared<Registration::Entry>(client, ring, worker_threads);
+
+  absl::MutexLock lock(&mu_);
+  auto rings = std::make_shared<EntryList>(*rings_);
+  rings->push_back(entry);
+  rings_ = std::move(rings);
+  rings_generation_.fetch_add(1, std::memory_order_release);
+  contributed_workers_ += worker_threads;
+  worker_limit_.store(std::min(options_.max_workers, contributed_workers_),
+                      std::memory_order_relaxed);
+  if (running_workers_.load(std::memory_order_relaxed) == 0) {
+    AddWorkerLocked();
+  }
+  return absl::WrapUnique(new Registration(this, std::move(entry)));
+}
+
+size_t SharedSwitchlessWorkerPool::worker_count() const {
+  absl::MutexLock lock(&mu_);
+  return workers_.size();
+}
+
+size_t SharedSwitchlessWorkerPool::running_worker_count() const {
+  return running_workers_.load(std::memory_order_relaxed);
+}
+
+void SharedSwitchlessWorkerPool::WorkerLoop() {
+  Status status = affinity_.PinCurrentThread();
+  if (!status.ok()) {
+    LOG(WARNING) << "Shared switchless worker runs unpinned: " << status;
+  }
+
+  std::shared_ptr<const EntryList> rings;
+  uint64_t generation = 0;
+  size_t idle_scans = 0;
+  size_t idle_yields = 0;
+  while (!stopping_.load(std::memory_order_relaxed)) {
+    RefreshRings(&rings, &generation);
+
+    // Start from a different ring on every scan, so that the rings early in
+    // the list do not get the workers first.
+    size_t serviced = 0;
+    if (!rings->empty()) {
+      size_t start = next_ring_.fetch_add(1, std::memory_order_relaxed);
+      for (size_t i = 0; i < rings->size(); ++i) {
+        if (ServiceRing((*rings)[(start + i) % rings->size()].get())) {
+          ++serviced;
+        }
+      }
+    }
+
+    if (serviced > 0) {
+      idle_scans = 0;
+      idle_yields = 0;
+      // Requests in other rings waited while this worker serviced one, so
+      // another worker would have shortened their wait.
+      if (serviced > 1) {
+        AddWorker();
+      }
+    } else if (++idle_scans < options_.idle_spins) {
+      __builtin_ia32_pause();
+    } else {
+      idle_scans = 0;
+      if (++idle_yields < options_.idle_yields) {
+        sched_yield();
+      } else {
+        idle_yields = 0;
+        if (!MaybePark()) {
+          return;
+        }
+      }
+    }
+  }
+}
+
+bool SharedSwitchlessWorkerPool::ServiceRing(Registration::Entry *entry) {
+  // Pairs with Unregister(): either the ring is seen unregistered here, or
+  // Unregister() waits for this worker to finish.
+  entry->in_flight.fetch_add(1, std::memory_order_seq_cst);
+  bool serviced = false;
+  if (!entry->unregistered.load(std::memory_order_seq_cst)) {
+    SwitchlessSlot *slots = entry->ring->slots();
+    const size_t capacity = entry->ring->capacity;
+    const size_t start =
+        entry->next_slot.load(std::memory_order_relaxed) % capacity;
+    SwitchlessSlot *claimed = nullptr;
+    bool backlog = false;
+    for (size_t i = 0; i < capacity && !backlog; ++i) {
+      size_t index = (start + i) % capacity;
+      SwitchlessSlot *slot = &slots[index];
+      if (slot->state != SwitchlessSlot::kPosted) {
+        continue;
+      }
+      if (claimed) {
+        backlog = true;
+      } else if (ClaimSwitchlessSlot(slot)) {
+        claimed = slot;
+        entry->next_slot.store(index + 1, std::memory_order_relaxed);
+      }
+    }
+    if (claimed) {
+      // Requests left posted would wait for this one to be serviced, and host
+      // calls may block, so let another worker take them.
+      if (backlog) {
+        AddWorker();
+      }
+      // Host call handlers may consult the thread-local current client, so
+      // make this worker look like a thread which exited from the enclave.
+      entry->client->SetCurrentClient();
+      ServiceSwitchlessSlot(entry->client, claimed);
+      serviced = true;
+    }
+  }
+  entry->in_flight.fetch_sub(1, std::memory_order_release);
+  return serviced;
+}
+
+void SharedSwitchlessWorkerPool::RefreshRings(
+    std::shared_ptr<const EntryList> *rings, uint64_t *generation) const {
+  uint64_t current = rings_generation_.load(std::memory_order_acquire);
+  if (*rings && current == *generation) {
+    return;
+  }
+  absl::MutexLock lock(&mu_);
+  *rings = rings_;
+  *generation = rings_generation_.load(std::memory_order_relaxed);
+}
+
+void SharedSwitchlessWorkerPool::AddWorker() {
+  // Checked without the lock first, since a saturated pool finds a backlog on
+  // most scans.
+  if (running_workers_.load(std::memory_order_relaxed) >=
+      worker_limit_.load(std::memory_order_relaxed)) {
+    return;
+  }
+  absl::MutexLock lock(&mu_);
+  AddWorkerLocked();
+}
+
+void SharedSwitchlessWorkerPool::AddWorkerLocked() {
+  if (stopping_.load(std::memory_order_relaxed) ||
+      running_workers_.load(std::memory_order_relaxed) >=
+          worker_limit_.load(std::memory_order_relaxed)) {
+    return;
+  }
+  running_workers_.fetch_add(1, std::memory_order_relaxed);
+  if (parked_workers_ > 0) {
+    --parked_workers_;
+    ++wake_tokens_;
+    wake_cv_.Signal();
+  } else {
+    workers_.emplace_back(&SharedSwitchlessWorkerPool::WorkerLoop, this);
+  }
+}
+
+bool SharedSwitchlessWorkerPool::MaybePark() {
+  absl::MutexLock lock(&mu_);
+  size_t min_workers = rings_->empty() ? 0 : options_.min_workers;
+  if (running_workers_.load(std::memory_order_relaxed) <= min_workers) {
+    return true;
+  }
+  running_workers_.fetch_sub(1, std::memory_order_relaxed);
+  ++parked_workers_;
+  while (!stopping_.load(std::memory_order_relaxed) && wake_tokens_ == 0) {
+    wake_cv_.Wait(&mu_);
+  }
+  if (stopping_.load(std::memory_order_relaxed)) {
+    return false;
+  }
+  --wake_tokens_;
+  return true;
+}
+
+void SharedSwitchlessWorkerPool::Unregister(
+    const std::shared_ptr<Registration::Entry> &entry) {
+  // The enclave stops posting to the ring once it observes the shutdown.
+  AtomicStore(&entry->ring->shutdown, uint32_t{1}, std::memory_order_release);
+  {
+    absl::MutexLock lock(&mu_);
+    auto rings = std::make_shared<EntryList>();
+    rings->reserve(rings_->size());
+    for (const auto &ring : *rings_) {
+      if (ring != entry) {
+        rings->push_back(ring);
+      }
+    }
+    rings_ = std::move(rings);
+    rings_generation_.fetch_add(1, std::memory_order_release);
+    contributed_workers_ -= entry->worker_threads;
+    worker_limit_.store(std::min(options_.max_workers, contributed_workers_),
+                        std::memory_order_relaxed);
+  }
+
+  entry->unregistered.store(true, std::memory_order_seq_cst);
+  while (entry->in_flight.load(std::memory_order_seq_cst) != 0) {
+    sched_yield();
+  }
+  DrainSwitchlessRing(entry->client, entry->ring);
+}
+
+}  // namespace primitives
+}  // namespace asylo
@@ -0,0 +1,188 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_PRIMITIVES_SGX_SHARED_SWITCHLESS_WORKERS_H_
+#define ASYLO_PLATFORM_PRIMITIVES_SGX_SHARED_SWITCHLESS_WORKERS_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "asylo/platform/primitives/sgx/host_affinity.h"
+#include "asylo/platform/primitives/sgx/switchless_ring.h"
+#include "asylo/platform/primitives/untrusted_primitives.h"
+#include "asylo/util/statusor.h"
+#include "asylo/util/thread.h"
+
+namespace asylo {
+namespace primitives {
+
+// A pool of host threads servicing the switchless request rings of all the
+// enclaves of a process which opt into it, instead of each enclave busy-polling
+// its own ring with its own workers.
+//
+// Each enclave contributes a number of workers to the pool when it registers
+// its ring, but the pool only runs as many threads as the queued requests
+// need: a worker which finds more requests posted than it claims wakes or
+// starts another worker, up to the total contribution of the registered rings,
+// and a worker which stays idle parks until it is needed again, down to
+// |min_workers|. A scan claims at most one request per ring and
+// starts from a different ring each time, so a busy enclave cannot starve the
+// others of workers.
+//
+// This class is thread-safe.
+class SharedSwitchlessWorkerPool {
+ public:
+  struct Options {
+    // Number of workers kept running while any ring is registered, even when
+    // idle.
+    size_t min_workers = 1;
+
+    // Upper bound on the number of workers, whatever the rings contribute.
+    size_t max_workers = 64;
+
+    // Number of consecutive scans finding no work after which a worker yields
+    // its CPU.
+    size_t idle_spins = 1024;
+
+    // Number of consecutive yields finding no work after which a worker parks,
+    // unless only |min_workers| workers are running.
+    size_t idle_yields = 1024;
+  };
+
+  // A ring registered with the pool. Destroying it unregisters the ring, waits
+  // for the workers to finish the requests they claimed from it, services the
+  // requests still posted on the calling thread, and frees the ring.
+  class Registration {
+   public:
+    ~Registration();
+
+    Registration(const Registration &other) = delete;
+    Registration &operator=(const Registration &other) = delete;
+
+    // Returns the ring shared with the enclave.
+    SwitchlessRing *ring() const;
+
+   private:
+    friend class SharedSwitchlessWorkerPool;
+
+    struct Entry;
+
+    Registration(SharedSwitchlessWorkerPool *pool,
+                 std::shared_ptr<Entry> entry)
+        : pool_(pool), entry_(std::move(entry)) {}
+
+    SharedSwitchlessWorkerPool *const pool_;
+    const std::shared_ptr<Entry> entry_;
+  };
+
+  // Returns the pool shared by the whole process, which runs with the default
+  // Options and unpinned workers.
+  static SharedSwitchlessWorkerPool *Get();
+
+  // Creates a pool with no rings and no workers. Workers run on the CPUs of
+  // |affinity|.
+  explicit SharedSwitchlessWorkerPool(
+      const Options &options, const HostAffinity &affinity = HostAffinity());
+
+  // Stops and joins all workers. All registrations must have been destroyed.
+  ~SharedSwitchlessWorkerPool();
+
+  SharedSwitchlessWorkerPool(const SharedSwitchlessWorkerPool &other) = delete;
+  SharedSwitchlessWorkerPool &operator=(
+      const SharedSwitchlessWorkerPool &other) = delete;
+
+  // Allocates a ring of |ring_slots| slots from the NUMA node of
+  // |ring_affinity| and registers it with the pool, which dispatches its
+  // requests through the exit call provider of |client|. The pool may run up
+  // to |worker_threads| more workers while the ring is registered. |client|
+  // must outlive the returned registration.
+  StatusOr<std::unique_ptr<Registration>> Register(
+      Client *client, size_t worker_threads, size_t ring_slots,
+      const HostAffinity &ring_affinity = HostAffinity());
+
+  // Returns the number of workers started so far, parked or not.
+  size_t worker_count() const;
+
+  // Returns the number of workers which are not parked.
+  size_t running_worker_count() const;
+
+ private:
+  using EntryList = std::vector<std::shared_ptr<Registration::Entry>>;
+
+  // Body of a worker thread.
+  void WorkerLoop();
+
+  // Claims and services at most one request posted to the ring of |entry|,
+  // and adds a worker if more requests are posted. Returns whether a request
+  // was serviced.
+  bool ServiceRing(Registration::Entry *entry);
+
+  // Returns the rings to scan, updating |rings| and |generation| if rings were
+  // registered or unregistered since they were read.
+  void RefreshRings(std::shared_ptr<const EntryList> *rings,
+                    uint64_t *generation) const;
+
+  // Wakes a parked worker or starts a new one, unless the number of running
+  // workers already reaches the limit.
+  void AddWorker();
+  void AddWorkerLocked() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Parks the calling worker until it is woken up or the pool stops, unless
+  // only the minimum number of workers is running, which is none once no ring
+  // is registered. Returns false once the pool stops.
+  bool MaybePark();
+
+  // Removes |entry| from the scanned rings.
+  void Unregister(const std::shared_ptr<Registration::Entry> &entry);
+
+  const Options options_;
+  const HostAffinity affinity_;
+
+  // Incremented whenever |rings_| changes, so that workers only take |mu_| to
+  // reread it when it did.
+  std::atomic<uint64_t> rings_generation_{0};
+
+  // Rotating index of the ring each scan starts from.
+  std::atomic<size_t> next_ring_{0};
+
+  // Number of running workers and the number of workers the registered rings
+  // may use, readable without |mu_| but only updated with it held.
+  std::atomic<size_t> running_workers_{0};
+  std::atomic<size_t> worker_limit_{0};
+
+  // Set when the pool is destroyed, with |mu_| held.
+  std::atomic<bool> stopping_{false};
+
+  mutable absl::Mutex mu_;
+  absl::CondVar wake_cv_;
+  std::shared_ptr<const EntryList> rings_ ABSL_GUARDED_BY(mu_);
+  size_t contributed_workers_ ABSL_GUARDED_BY(mu_) = 0;
+  std::vector<Thread> workers_ ABSL_GUARDED_BY(mu_);
+  size_t parked_workers_ ABSL_GUARDED_BY(mu_) = 0;
+  size_t wake_tokens_ ABSL_GUARDED_BY(mu_) = 0;
+};
+
+}  // namespace primitives
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_PRIMITIVES_SGX_SHARED_SWITCHLESS_WORKERS_H_
@@ -0,0 +1,272 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/primitives/sgx/shared_switchless_workers.h"
+
+#include <memory>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "asylo/platform/common/futex.h"
+#include "asylo/platform/core/atomic.h"
+#include "asylo/platform/primitives/primitives.h"
+#include "asylo/platform/primitives/sgx/switchless_ring.h"
+#include "asylo/platform/primitives/untrusted_primitives.h"
+#include "asylo/platform/primitives/util/dispatch_table.h"
+#include "asylo/platform/primitives/util/message.h"
+#include "asylo/test/util/status_matchers.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+namespace primitives {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::Le;
+using ::testing::Lt;
+
+constexpr uint64_t kRecordSelector = kSelectorHostCall;
+constexpr uint64_t kBlockSelector = kSelectorHostCall + 1;
+
+class MockedEnclaveClient : public Client {
+ public:
+  MockedEnclaveClient()
+      : Client(
+            /*name=*/"mock_enclave", absl::make_unique<DispatchTable>()) {}
+
+  // Virtual methods not used in this test.
+  bool IsClosed() const override { return false; }
+  Status Destroy() override { return Status::OkStatus(); }
+  Status EnclaveCallInternal(uint64_t selector, MessageWriter *in,
+                             MessageReader *out) override {
+    return Status::OkStatus();
+  }
+};
+
+// Records the tag of each serviced request, and blocks requests to
+// kBlockSelector until |release| is notified.
+struct HandlerState {
+  absl::Mutex mu;
+  std::vector<int> serviced ABSL_GUARDED_BY(mu);
+  absl::Notification release;
+};
+
+Status RecordHandler(std::shared_ptr<Client> client, void *context,
+                     MessageReader *input, MessageWriter *output) {
+  auto state = static_cast<HandlerState *>(context);
+  int tag = input->next<int>();
+  {
+    absl::MutexLock lock(&state->mu);
+    state->serviced.push_back(tag);
+  }
+  output->Push<int>(tag);
+  return Status::OkStatus();
+}
+
+Status BlockHandler(std::shared_ptr<Client> client, void *context,
+                    MessageReader *input, MessageWriter *output) {
+  auto state = static_cast<HandlerState *>(context);
+  state->release.WaitForNotification();
+  return RecordHandler(std::move(client), context, input, output);
+}
+
+// Posts a request tagged |tag| to slot |index| of |ring| the way an enclave
+// thread would.
+void Post(SwitchlessRing *ring, size_t index, uint64_t selector, int tag) {
+  SwitchlessSlot *slot = &ring->slots()[index];
+  MessageWriter input;
+  input.Push<int>(tag);
+  input.Serialize(slot->input);
+  slot->input_size = input.MessageSize();
+  slot->selector = selector;
+  slot->async = 1;
+  AtomicStore(&slot->state, static_cast<uint32_t>(SwitchlessSlot::kPosted));
+}
+
+// Waits until slot |index| of |ring| is done and returns the tag it echoed.
+int Wait(SwitchlessRing *ring, size_t index) {
+  SwitchlessSlot *slot = &ring->slots()[index];
+  int32_t *completion = const_cast<int32_t *>(&slot->completion);
+  while (__atomic_load_n(completion, __ATOMIC_ACQUIRE) == 0) {
+    sys_futex_wait(completion, 0, /*timeout_microsec=*/1000);
+  }
+  MessageReader output;
+  output.Deserialize(slot->output_buffer, slot->output_size);
+  return output.next<int>();
+}
+
+// Waits until |predicate| holds, for up to ten seconds.
+template <typename PredicateT>
+bool Eventually(PredicateT predicate) {
+  absl::Time deadline = absl::Now() + absl::Seconds(10);
+  while (!predicate()) {
+    if (absl::Now() > deadline) {
+      return false;
+    }
+    absl::SleepFor(absl::Milliseconds(1));
+  }
+  return true;
+}
+
+class SharedSwitchlessWorkerPoolTest : public ::testing::Test {
+ protected:
+  // Returns a client whose exit handlers record into |state_|.
+  std::shared_ptr<MockedEnclaveClient> CreateClient() {
+    auto client = std::make_shared<MockedEnclaveClient>();
+    EXPECT_THAT(client->exit_call_provider()->RegisterExitHandler(
+                    kRecordSelector, ExitHandler{RecordHandler, &state_}),
+                IsOk());
+    EXPECT_THAT(client->exit_call_provider()->RegisterExitHandler(
+                    kBlockSelector, ExitHandler{BlockHandler, &state_}),
+                IsOk());
+    return client;
+  }
+
+  static SharedSwitchlessWorkerPool::Options FastParkingOptions() {
+    SharedSwitchlessWorkerPool::Options options;
+    options.idle_spins = 1;
+    options.idle_yields = 1;
+    return options;
+  }
+
+  HandlerState state_;
+};
+
+TEST_F(SharedSwitchlessWorkerPoolTest, RejectsInvalidArguments) {
+  SharedSwitchlessWorkerPool pool(FastParkingOptions());
+  auto client = CreateClient();
+  EXPECT_THAT(pool.Register(nullptr, 1, 1),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+  EXPECT_THAT(pool.Register(client.get(), 0, 1),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+  EXPECT_THAT(pool.Register(client.get(), 1, 0),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+}
+
+TEST_F(SharedSwitchlessWorkerPoolTest, ServicesRingsOfSeveralClients) {
+  SharedSwitchlessWorkerPool pool(FastParkingOptions());
+  EXPECT_THAT(pool.worker_count(), Eq(0));
+
+  auto first_client = CreateClient();
+  auto second_client = CreateClient();
+  auto first_result = pool.Register(first_client.get(), 1, 4);
+  ASSERT_THAT(first_result, IsOk());
+  auto second_result = pool.Register(second_client.get(), 1, 4);
+  ASSERT_THAT(second_result, IsOk());
+  SwitchlessRing *first_ring = first_result.ValueOrDie()->ring();
+  SwitchlessRing *second_ring = second_result.ValueOrDie()->ring();
+  EXPECT_THAT(first_ring->magic, Eq(kSwitchlessRingMagic));
+
+  Post(first_ring, 0, kRecordSelector, 1);
+  Post(second_ring, 3, kRecordSelector, 2);
+  EXPECT_THAT(Wait(first_ring, 0), Eq(1));
+  EXPECT_THAT(Wait(second_ring, 3), Eq(2));
+  EXPECT_THAT(pool.worker_count(), Le(2));
+}
+
+TEST_F(SharedSwitchlessWorkerPoolTest, ScalesWithQueueDepth) {
+  SharedSwitchlessWorkerPool pool(FastParkingOptions());
+  auto client = CreateClient();
+  auto result = pool.Register(client.get(), /*worker_threads=*/3, 8);
+  ASSERT_THAT(result, IsOk());
+  SwitchlessRing *ring = result.ValueOrDie()->ring();
+
+  // Each blocked request holds a worker, and the requests queued behind it
+  // call for another, up to the contribution of the ring.
+  for (int i = 0; i < 6; ++i) {
+    Post(ring, i, kBlockSelector, i);
+  }
+  EXPECT_TRUE(Eventually([&pool] { return pool.running_worker_count() == 3; }));
+  EXPECT_THAT(pool.worker_count(), Eq(3));
+
+  state_.release.Notify();
+  for (int i = 0; i < 6; ++i) {
+    EXPECT_THAT(Wait(ring, i), Eq(i));
+  }
+
+  // Idle workers park, down to the minimum.
+  EXPECT_TRUE(Eventually([&pool] { return pool.running_worker_count() == 1; }));
+  result.ValueOrDie().reset();
+  EXPECT_TRUE(Eventually([&pool] { return pool.running_worker_count() == 0; }));
+  EXPECT_THAT(pool.worker_count(), Eq(3));
+}
+
+TEST_F(SharedSwitchlessWorkerPoolTest, ServicesRingsInTurn) {
+  SharedSwitchlessWorkerPool::Options options = FastParkingOptions();
+  options.max_workers = 1;
+  SharedSwitchlessWorkerPool pool(options);
+  auto busy_client = CreateClient();
+  auto quiet_client = CreateClient();
+  auto busy_result = pool.Register(busy_client.get(), 1, 8);
+  ASSERT_THAT(busy_result, IsOk());
+  auto quiet_result = pool.Register(quiet_client.get(), 1, 8);
+  ASSERT_THAT(quiet_result, IsOk());
+  SwitchlessRing *busy_ring = busy_result.ValueOrDie()->ring();
+  SwitchlessRing *quiet_ring = quiet_result.ValueOrDie()->ring();
+
+  // The only worker blocks on the first request of the busy ring while the
+  // rest of its backlog and a request to the quiet ring are posted.
+  Post(busy_ring, 0, kBlockSelector, 0);
+  for (int i = 1; i < 8; ++i) {
+    Post(busy_ring, i, kRecordSelector, i);
+  }
+  Post(quiet_ring, 0, kRecordSelector, 100);
+  state_.release.Notify();
+
+  EXPECT_THAT(Wait(quiet_ring, 0), Eq(100));
+  for (int i = 0; i < 8; ++i) {
+    EXPECT_THAT(Wait(busy_ring, i), Eq(i));
+  }
+  EXPECT_THAT(pool.worker_count(), Eq(1));
+
+  // The quiet ring is serviced within a scan or two of the busy one, instead
+  // of after its whole backlog.
+  absl::MutexLock lock(&state_.mu);
+  size_t quiet_position = 0;
+  while (state_.serviced[quiet_position] != 100) {
+    ++quiet_position;
+  }
+  EXPECT_THAT(quiet_position, Lt(3));
+}
+
+TEST_F(SharedSwitchlessWorkerPoolTest, UnregisterServicesPostedRequests) {
+  SharedSwitchlessWorkerPool pool(FastParkingOptions());
+  auto client = CreateClient();
+  auto result = pool.Register(client.get(), 1, 4);
+  ASSERT_THAT(result, IsOk());
+  std::unique_ptr<SharedSwitchlessWorkerPool::Registration> registration =
+      std::move(result.ValueOrDie());
+
+  // Whether a worker or the unregistration services the request, it must be
+  // done once the registration is destroyed.
+  Post(registration->ring(), 2, kRecordSelector, 7);
+  registration.reset();
+  absl::MutexLock lock(&state_.mu);
+  EXPECT_THAT(state_.serviced, ElementsAre(7));
+}
+
+}  // namespace
+}  // namespace primitives
+}  // namespace asylo
@@ -37,16 +37,17 @@ EnclaveSignalDispatcher *EnclaveSignalDispatcher::GetInstance() {
 
 SgxEnclaveClient *EnclaveSignalDispatcher::GetClientForSignal(
     int signum) const {
-  std::lock_guard<std::recursive_mutex> lock(signal_enclave_map_lock_);
-  auto it = signal_to_client_map_.find(signum);
-  if (it == signal_to_client_map_.end()) {
+  if (signum <= 0 || signum >= NSIG) {
     return nullptr;
   }
-  return it->second;
+  return signal_to_client_[signum].load(std::memory_order_acquire);
 }
 
 const SgxEnclaveClient *EnclaveSignalDispatcher::RegisterSignal(
     int signum, SgxEnclaveClient *client) {
+  if (signum <= 0 || signum >= NSIG) {
+    return nullptr;
+  }
   // Block all signals when registering a signal handler to avoid deadlock.
   sigset_t mask, oldmask;
   sigfillset(&mask);
@@ -55,11 +56,8 @@ const SgxEnclaveClient *EnclaveSignalDispatcher::RegisterSignal(
   {
     std::lock_guard<std::recursive_mutex> lock(signal_enclave_map_lock_);
     // If this signal is registered by another enclave, deregister it first.
-    auto client_iterator = signal_to_client_map_.find(signum);
-    if (client_iterator != signal_to_client_map_.end()) {
-      old_client = client_iterator->second;
-    }
-    signal_to_client_map_[signum] = client;
+    old_client = signal_to_client_[signum].exchange(client,
+                                                    std::memory_order_acq_rel);
   }
   // Set the signal mask back to the original one to unblock the signals.
   sigprocmask(SIG_SETMASK, &oldmask, nullptr);
@@ -76,22 +74,19 @@ Status EnclaveSignalDispatcher::DeregisterAllSignalsForClient(
     std::lock_guard<std::recursive_mutex> lock(signal_enclave_map_lock_);
     // If this enclave has registered any signals, deregister them and set the
     // signal handler to the default one.
-    for (auto iterator = signal_to_client_map_.begin();
-         iterator != signal_to_client_map_.end();) {
-      if (iterator->second == client) {
-        if (signal(iterator->first, SIG_DFL) == SIG_ERR) {
-          status = Status(
-              error::GoogleError::INVALID_ARGUMENT,
-              absl::StrCat(
-                  "Failed to deregister one or more handlers for signal: ",
-                  iterator->first));
-        }
-        auto saved_iterator = iterator;
-        ++iterator;
-        signal_to_client_map_.erase(saved_iterator);
-      } else {
-        ++iterator;
+    for (int signum = 1; signum < NSIG; ++signum) {
+      if (signal_to_client_[signum].load(std::memory_order_relaxed) !=
+          client) {
+        continue;
+      }
+      if (signal(signum, SIG_DFL) == SIG_ERR) {
+        status = Status(
+            error::GoogleError::INVALID_ARGUMENT,
+            absl::StrCat(
+                "Failed to deregister one or more handlers for signal: ",
+                signum));
       }
+      signal_to_client_[signum].store(nullptr, std::memory_order_release);
     }
   }
   sigprocmask(SIG_SETMASK, &oldmask, nullptr);
@@ -21,8 +21,9 @@
 
 #include <signal.h>
 
+#include <array>
+#include <atomic>
 #include <mutex>
-#include <unordered_map>
 
 #include "asylo/platform/primitives/sgx/untrusted_sgx.h"
 #include "asylo/util/status.h"  // IWYU pragma: export
@@ -45,7 +46,8 @@ class EnclaveSignalDispatcher {
   // no enclave has registered |signum| yet.
   const SgxEnclaveClient *RegisterSignal(int signum, SgxEnclaveClient *client);
 
-  // Gets the enclave that registered a handler for |signum|.
+  // Gets the enclave that registered a handler for |signum|. Takes no lock, so
+  // that it is safe to call from a signal handler.
   SgxEnclaveClient *GetClientForSignal(int signum) const;
 
   // Deregisters all the signals registered by |client|.
@@ -61,10 +63,11 @@ class EnclaveSignalDispatcher {
   EnclaveSignalDispatcher(EnclaveSignalDispatcher const &) = delete;
   void operator=(EnclaveSignalDispatcher const &) = delete;
 
-  // Mapping of signal number to the enclave client that registered it.
-  std::unordered_map<int, SgxEnclaveClient *> signal_to_client_map_;
+  // The enclave client that registered each signal number, or nullptr. Read
+  // without a lock by the signal handler.
+  std::array<std::atomic<SgxEnclaveClient *>, NSIG> signal_to_client_{};
 
-  // A mutex that guards signal_to_client_map_ and client_to_signal_map_.
+  // A mutex that serializes updates of signal_to_client_.
   // This is a recursive mutex so that a signal entering the enclave won't cause
   // deadlock while the same thread is holding the lock.
   // This is safe to do because we are masking signals while modifying the map
@@ -0,0 +1,128 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_PRIMITIVES_SGX_SWITCHLESS_RING_H_
+#define ASYLO_PLATFORM_PRIMITIVES_SGX_SWITCHLESS_RING_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "asylo/platform/core/atomic.h"
+
+namespace asylo {
+namespace primitives {
+
+// This file defines the layout of the shared-memory request ring used for
+// switchless (exitless) host calls. The ring is allocated in untrusted memory
+// by the untrusted loader and is shared between enclave threads, which post
+// serialized requests, and a pool of untrusted worker threads, which service
+// those requests through the exit call provider of the enclave. Everything in
+// the ring is writable by untrusted code, so the trusted side must treat every
+// field as attacker controlled.
+
+// Value stored in |SwitchlessRing::magic| by the untrusted loader.
+constexpr uint64_t kSwitchlessRingMagic = 0x41534c5253574c53;  // "ASLRSWLS"
+
+// Number of bytes available inline in each slot for a serialized request and
+// for a serialized response. Requests larger than this always take a regular
+// enclave exit. Responses larger than this are allocated by the untrusted
+// worker and returned by pointer.
+constexpr size_t kSwitchlessSlotBufferSize = 4096;
+
+// A single request slot. A slot moves through the following states:
+//
+//   kFree -> kReserved   (enclave thread, CAS)
+//   kReserved -> kPosted (enclave thread, after writing the request)
+//   kPosted -> kClaimed  (untrusted worker, CAS)
+//   kPosted -> kReserved (enclave thread, CAS, when no worker picked it up)
+//   kClaimed -> kDone    (untrusted worker, after writing the response)
+//   kDone -> kFree       (enclave thread, after consuming the response)
+//
+// For asynchronous requests the worker additionally sets |completion| to 1 and
+// wakes any thread waiting on it after moving the slot to kDone, so that the
+// enclave can sleep on |completion| instead of spinning on |state|.
+struct alignas(kCacheLineSize) SwitchlessSlot {
+  enum State : uint32_t {
+    kFree = 0,
+    kReserved = 1,
+    kPosted = 2,
+    kClaimed = 3,
+    kDone = 4,
+  };
+
+  // Current state of the slot, one of the State values.
+  volatile uint32_t state;
+
+  // Futex word set to 1 by the untrusted worker once an asynchronous request
+  // is done. Reset to 0 by the enclave thread when posting.
+  volatile int32_t completion;
+
+  // Non-zero if the posting enclave thread does not spin waiting for the
+  // response and may be sleeping on |completion| instead.
+  uint32_t async;
+
+  // Exit handler selector for the posted request.
+  uint64_t selector;
+
+  // Number of valid bytes in |input|.
+  uint64_t input_size;
+
+  // Number of bytes of serialized response. If |output| is null, the response
+  // is stored inline in |output_buffer|.
+  uint64_t output_size;
+
+  // Response allocated by the untrusted worker with malloc() when it does not
+  // fit in |output_buffer|, otherwise null.
+  void *output;
+
+  // Serialized MessageWriter contents of the request.
+  alignas(kCacheLineSize) uint8_t input[kSwitchlessSlotBufferSize];
+
+  // Serialized MessageWriter contents of the response.
+  alignas(kCacheLineSize) uint8_t output_buffer[kSwitchlessSlotBufferSize];
+};
+
+// Header of the request ring, followed in memory by |capacity| slots.
+struct alignas(kCacheLineSize) SwitchlessRing {
+  // Always kSwitchlessRingMagic for an initialized ring.
+  uint64_t magic;
+
+  // Number of SwitchlessSlot entries following the header.
+  uint64_t capacity;
+
+  // Monotonic ticket used by enclave threads to pick a starting slot.
+  volatile uint64_t next_slot;
+
+  // Set to non-zero by the untrusted loader to stop the workers.
+  volatile uint32_t shutdown;
+
+  // Returns a pointer to the first slot of the ring.
+  SwitchlessSlot *slots() {
+    return reinterpret_cast<SwitchlessSlot *>(this + 1);
+  }
+};
+
+// Returns the number of bytes needed for a ring holding |capacity| slots.
+constexpr size_t SwitchlessRingSize(size_t capacity) {
+  return sizeof(SwitchlessRing) + capacity * sizeof(SwitchlessSlot);
+}
+
+}  // namespace primitives
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_PRIMITIVES_SGX_SWITCHLESS_RING_H_
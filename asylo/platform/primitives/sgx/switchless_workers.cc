@@ -0,0 +1,202 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/primitives/sgx/switchless_workers.h"
+
+#include <sched.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+#include "asylo/platform/common/futex.h"
+#include "asylo/platform/core/atomic.h"
+#include "asylo/platform/primitives/util/message.h"
+#include "asylo/platform/primitives/util/status_conversions.h"
+#include "asylo/util/logging.h"
+#include "asylo/util/status.h"
+#include "asylo/util/status_macros.h"
+
+namespace asylo {
+namespace primitives {
+namespace {
+
+constexpr size_t kPageSize = 4096;
+
+}  // namespace
+
+StatusOr<SwitchlessRing *> AllocateSwitchlessRing(
+    size_t ring_slots, const HostAffinity &affinity) {
+  void *memory = nullptr;
+  if (posix_memalign(&memory, kPageSize, SwitchlessRingSize(ring_slots)) !=
+      0) {
+    return Status(error::GoogleError::RESOURCE_EXHAUSTED,
+                  "Failed to allocate the switchless request ring");
+  }
+  // Bind the ring before clearing it, so that its pages are faulted in on the
+  // node of the workers polling it.
+  Status status = affinity.BindMemory(memory, SwitchlessRingSize(ring_slots));
+  if (!status.ok()) {
+    free(memory);
+    return status;
+  }
+  memset(memory, 0, SwitchlessRingSize(ring_slots));
+  auto ring = reinterpret_cast<SwitchlessRing *>(memory);
+  ring->capacity = ring_slots;
+  ring->magic = kSwitchlessRingMagic;
+  return ring;
+}
+
+bool ClaimSwitchlessSlot(SwitchlessSlot *slot) {
+  if (slot->state != SwitchlessSlot::kPosted) {
+    return false;
+  }
+  uint32_t expected = SwitchlessSlot::kPosted;
+  return AtomicCompareExchange(&slot->state, &expected,
+                               static_cast<uint32_t>(SwitchlessSlot::kClaimed),
+                               /*weak=*/false, std::memory_order_acquire,
+                               std::memory_order_relaxed);
+}
+
+void ServiceSwitchlessSlot(Client *client, SwitchlessSlot *slot) {
+  // The slot may be reused by the enclave as soon as it is done, so read the
+  // request mode up front.
+  const bool async = slot->async != 0;
+
+  // The posting enclave thread leaves the slot input untouched until the slot
+  // is done, so it can be read in place.
+  MessageReader in;
+  Status status;
+  if (slot->input_size > kSwitchlessSlotBufferSize) {
+    status = Status(error::GoogleError::INVALID_ARGUMENT,
+                    "Switchless request exceeds the slot buffer size");
+  } else {
+    status = MakeStatus(in.DeserializeInPlace(slot->input, slot->input_size));
+  }
+  MessageWriter out;
+  if (status.ok()) {
+    status = client->InvokeExitHandler(slot->selector, &in, &out);
+  }
+
+  // As with ocall_dispatch_untrusted_call, a failed exit handler produces an
+  // empty response.
+  slot->output = nullptr;
+  slot->output_size = 0;
+  if (status.ok()) {
+    slot->output_size = out.MessageSize();
+    if (slot->output_size > kSwitchlessSlotBufferSize) {
+      // The enclave takes ownership of oversized responses and releases them
+      // with UntrustedLocalFree.
+      slot->output = malloc(slot->output_size);
+      out.Serialize(slot->output);
+    } else if (slot->output_size > 0) {
+      out.Serialize(slot->output_buffer);
+    }
+  }
+  AtomicStore(&slot->state, static_cast<uint32_t>(SwitchlessSlot::kDone),
+              std::memory_order_release);
+  if (async) {
+    int32_t *completion = const_cast<int32_t *>(&slot->completion);
+    AtomicStore(completion, int32_t{1}, std::memory_order_release);
+    sys_futex_wake(completion, INT32_MAX);
+  }
+}
+
+void DrainSwitchlessRing(Client *client, SwitchlessRing *ring) {
+  SwitchlessSlot *slots = ring->slots();
+  for (size_t i = 0; i < ring->capacity; ++i) {
+    if (ClaimSwitchlessSlot(&slots[i])) {
+      ServiceSwitchlessSlot(client, &slots[i]);
+    }
+  }
+}
+
+StatusOr<std::unique_ptr<SwitchlessWorkerPool>> SwitchlessWorkerPool::Create(
+    Client *client, size_t worker_threads, size_t ring_slots,
+    size_t idle_spins, const HostAffinity &affinity) {
+  if (!client) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "SwitchlessWorkerPool requires a client");
+  }
+  if (worker_threads == 0 || ring_slots == 0) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "SwitchlessWorkerPool requires at least one worker thread "
+                  "and one ring slot");
+  }
+
+  SwitchlessRing *ring;
+  ASYLO_ASSIGN_OR_RETURN(ring, AllocateSwitchlessRing(ring_slots, affinity));
+
+  std::unique_ptr<SwitchlessWorkerPool> pool(
+      new SwitchlessWorkerPool(client, ring, idle_spins, affinity));
+  pool->workers_.reserve(worker_threads);
+  for (size_t i = 0; i < worker_threads; ++i) {
+    pool->workers_.emplace_back(&SwitchlessWorkerPool::WorkerLoop, pool.get());
+  }
+  return std::move(pool);
+}
+
+SwitchlessWorkerPool::~SwitchlessWorkerPool() {
+  Stop();
+  free(ring_);
+}
+
+void SwitchlessWorkerPool::Stop() {
+  AtomicStore(&ring_->shutdown, uint32_t{1}, std::memory_order_release);
+  for (auto &worker : workers_) {
+    worker.Join();
+  }
+  workers_.clear();
+  DrainSwitchlessRing(client_, ring_);
+}
+
+void SwitchlessWorkerPool::WorkerLoop() {
+  // Host call handlers may consult the thread-local current client, so make
+  // this worker look like a thread which exited from |client_|.
+  client_->SetCurrentClient();
+
+  Status status = affinity_.PinCurrentThread();
+  if (!status.ok()) {
+    LOG(WARNING) << "Switchless worker runs unpinned: " << status;
+  }
+
+  SwitchlessSlot *slots = ring_->slots();
+  const size_t capacity = ring_->capacity;
+  size_t idle_scans = 0;
+  while (!__atomic_load_n(&ring_->shutdown, __ATOMIC_ACQUIRE)) {
+    bool found_work = false;
+    for (size_t i = 0; i < capacity; ++i) {
+      if (ClaimSwitchlessSlot(&slots[i])) {
+        ServiceSwitchlessSlot(client_, &slots[i]);
+        found_work = true;
+      }
+    }
+    if (found_work) {
+      idle_scans = 0;
+    } else if (++idle_scans >= idle_spins_) {
+      idle_scans = 0;
+      sched_yield();
+    } else {
+      __builtin_ia32_pause();
+    }
+  }
+}
+
+}  // namespace primitives
+}  // namespace asylo
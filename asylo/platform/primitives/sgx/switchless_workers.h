@@ -0,0 +1,108 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_PRIMITIVES_SGX_SWITCHLESS_WORKERS_H_
+#define ASYLO_PLATFORM_PRIMITIVES_SGX_SWITCHLESS_WORKERS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "asylo/platform/primitives/sgx/host_affinity.h"
+#include "asylo/platform/primitives/sgx/switchless_ring.h"
+#include "asylo/platform/primitives/untrusted_primitives.h"
+#include "asylo/util/status.h"
+#include "asylo/util/statusor.h"
+#include "asylo/util/thread.h"
+
+namespace asylo {
+namespace primitives {
+
+// Allocates a ring of |ring_slots| slots from the NUMA node of |affinity| and
+// initializes it with no posted requests. The ring must be released with
+// free().
+StatusOr<SwitchlessRing *> AllocateSwitchlessRing(size_t ring_slots,
+                                                  const HostAffinity &affinity);
+
+// Moves |slot| from kPosted to kClaimed. Returns false if the slot is not
+// posted or another worker claimed it first.
+bool ClaimSwitchlessSlot(SwitchlessSlot *slot);
+
+// Services the claimed |slot| through the exit call provider of |client|, as if
+// the enclave had exited through ocall_dispatch_untrusted_call, and marks the
+// slot done.
+void ServiceSwitchlessSlot(Client *client, SwitchlessSlot *slot);
+
+// Claims and services on the calling thread every request still posted to
+// |ring|. Used once no worker services the ring anymore, since asynchronous
+// requests posted before may have an enclave thread sleeping on them.
+void DrainSwitchlessRing(Client *client, SwitchlessRing *ring);
+
+// Owns a switchless request ring in untrusted memory together with the pool of
+// host threads servicing it. Requests posted to the ring by enclave threads are
+// dispatched through the exit call provider of |client|, exactly as if the
+// enclave had exited through ocall_dispatch_untrusted_call.
+class SwitchlessWorkerPool {
+ public:
+  // Allocates a ring of |ring_slots| slots and starts |worker_threads| host
+  // threads servicing it on behalf of |client|, which must outlive the pool.
+  // A worker which finds no work for |idle_spins| consecutive scans of the ring
+  // yields its CPU before scanning again. Workers run on the CPUs of
+  // |affinity| and the ring is allocated from its NUMA node.
+  static StatusOr<std::unique_ptr<SwitchlessWorkerPool>> Create(
+      Client *client, size_t worker_threads, size_t ring_slots,
+      size_t idle_spins, const HostAffinity &affinity = HostAffinity());
+
+  // Stops and joins all workers and frees the ring.
+  ~SwitchlessWorkerPool();
+
+  SwitchlessWorkerPool(const SwitchlessWorkerPool &other) = delete;
+  SwitchlessWorkerPool &operator=(const SwitchlessWorkerPool &other) = delete;
+
+  // Returns the ring shared with the enclave.
+  SwitchlessRing *ring() const { return ring_; }
+
+  // Signals all workers to stop and waits for them to exit. Requests which are
+  // still posted once the workers are gone are serviced by the calling thread
+  // before returning; requests posted afterwards are reclaimed by the enclave.
+  // Safe to call more than once.
+  void Stop();
+
+ private:
+  SwitchlessWorkerPool(Client *client, SwitchlessRing *ring, size_t idle_spins,
+                       const HostAffinity &affinity)
+      : client_(client),
+        ring_(ring),
+        idle_spins_(idle_spins),
+        affinity_(affinity) {}
+
+  // Body of a worker thread.
+  void WorkerLoop();
+
+  Client *const client_;
+  SwitchlessRing *const ring_;
+  const size_t idle_spins_;
+  const HostAffinity affinity_;
+  std::vector<Thread> workers_;
+};
+
+}  // namespace primitives
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_PRIMITIVES_SGX_SWITCHLESS_WORKERS_H_
@@ -0,0 +1,215 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/primitives/sgx/switchless_workers.h"
+
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/memory/memory.h"
+#include "asylo/platform/common/futex.h"
+#include "asylo/platform/core/atomic.h"
+#include "asylo/platform/primitives/primitives.h"
+#include "asylo/platform/primitives/sgx/switchless_ring.h"
+#include "asylo/platform/primitives/untrusted_primitives.h"
+#include "asylo/platform/primitives/util/dispatch_table.h"
+#include "asylo/platform/primitives/util/message.h"
+#include "asylo/test/util/status_matchers.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+namespace primitives {
+namespace {
+
+using ::testing::Eq;
+
+constexpr uint64_t kIncrementSelector = kSelectorHostCall;
+constexpr uint64_t kLargeResponseSelector = kSelectorHostCall + 1;
+
+class MockedEnclaveClient : public Client {
+ public:
+  MockedEnclaveClient()
+      : Client(
+            /*name=*/"mock_enclave", absl::make_unique<DispatchTable>()) {}
+
+  // Virtual methods not used in this test.
+  bool IsClosed() const override { return false; }
+  Status Destroy() override { return Status::OkStatus(); }
+  Status EnclaveCallInternal(uint64_t selector, MessageWriter *in,
+                             MessageReader *out) override {
+    return Status::OkStatus();
+  }
+};
+
+Status IncrementHandler(std::shared_ptr<Client> client, void *context,
+                        MessageReader *input, MessageWriter *output) {
+  output->Push<int>(input->next<int>() + 1);
+  return Status::OkStatus();
+}
+
+Status LargeResponseHandler(std::shared_ptr<Client> client, void *context,
+                            MessageReader *input, MessageWriter *output) {
+  output->PushString(std::string(2 * kSwitchlessSlotBufferSize, 'a'));
+  return Status::OkStatus();
+}
+
+class SwitchlessWorkerPoolTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    client_ = std::make_shared<MockedEnclaveClient>();
+    ASSERT_THAT(client_->exit_call_provider()->RegisterExitHandler(
+                    kIncrementSelector, ExitHandler{IncrementHandler}),
+                IsOk());
+    ASSERT_THAT(client_->exit_call_provider()->RegisterExitHandler(
+                    kLargeResponseSelector, ExitHandler{LargeResponseHandler}),
+                IsOk());
+  }
+
+  // Posts |input| to the first slot of |ring| the way an enclave thread would
+  // and waits for a worker to complete it.
+  SwitchlessSlot *PostAndWait(SwitchlessRing *ring, uint64_t selector,
+                              const MessageWriter &input) {
+    SwitchlessSlot *slot = &ring->slots()[0];
+    input.Serialize(slot->input);
+    slot->input_size = input.MessageSize();
+    slot->selector = selector;
+    AtomicStore(&slot->state, static_cast<uint32_t>(SwitchlessSlot::kPosted));
+    while (__atomic_load_n(&slot->state, __ATOMIC_ACQUIRE) !=
+           SwitchlessSlot::kDone) {
+    }
+    return slot;
+  }
+
+  std::shared_ptr<MockedEnclaveClient> client_;
+};
+
+TEST_F(SwitchlessWorkerPoolTest, RejectsInvalidArguments) {
+  EXPECT_THAT(SwitchlessWorkerPool::Create(nullptr, 1, 1, 1),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+  EXPECT_THAT(SwitchlessWorkerPool::Create(client_.get(), 0, 1, 1),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+  EXPECT_THAT(SwitchlessWorkerPool::Create(client_.get(), 1, 0, 1),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+}
+
+TEST_F(SwitchlessWorkerPoolTest, InitializesRing) {
+  auto pool_result = SwitchlessWorkerPool::Create(client_.get(), 2, 8, 16);
+  ASSERT_THAT(pool_result, IsOk());
+  SwitchlessRing *ring = pool_result.ValueOrDie()->ring();
+  EXPECT_THAT(ring->magic, Eq(kSwitchlessRingMagic));
+  EXPECT_THAT(ring->capacity, Eq(8));
+  for (int i = 0; i < 8; ++i) {
+    EXPECT_THAT(ring->slots()[i].state, Eq(SwitchlessSlot::kFree));
+  }
+}
+
+TEST_F(SwitchlessWorkerPoolTest, ServicesInlineResponse) {
+  auto pool_result = SwitchlessWorkerPool::Create(client_.get(), 1, 4, 16);
+  ASSERT_THAT(pool_result, IsOk());
+  MessageWriter input;
+  input.Push<int>(41);
+  SwitchlessSlot *slot =
+      PostAndWait(pool_result.ValueOrDie()->ring(), kIncrementSelector, input);
+
+  EXPECT_THAT(slot->output, Eq(nullptr));
+  MessageReader output;
+  output.Deserialize(slot->output_buffer, slot->output_size);
+  ASSERT_THAT(output.size(), Eq(1));
+  EXPECT_THAT(output.next<int>(), Eq(42));
+}
+
+TEST_F(SwitchlessWorkerPoolTest, ServicesOversizedResponse) {
+  auto pool_result = SwitchlessWorkerPool::Create(client_.get(), 1, 4, 16);
+  ASSERT_THAT(pool_result, IsOk());
+  MessageWriter input;
+  SwitchlessSlot *slot = PostAndWait(pool_result.ValueOrDie()->ring(),
+                                     kLargeResponseSelector, input);
+
+  ASSERT_NE(slot->output, nullptr);
+  MessageReader output;
+  output.Deserialize(slot->output, slot->output_size);
+  free(slot->output);
+  ASSERT_THAT(output.size(), Eq(1));
+  EXPECT_THAT(output.next().size(), Eq(2 * kSwitchlessSlotBufferSize + 1));
+}
+
+TEST_F(SwitchlessWorkerPoolTest, UnknownSelectorProducesEmptyResponse) {
+  auto pool_result = SwitchlessWorkerPool::Create(client_.get(), 1, 4, 16);
+  ASSERT_THAT(pool_result, IsOk());
+  MessageWriter input;
+  SwitchlessSlot *slot = PostAndWait(pool_result.ValueOrDie()->ring(),
+                                     kSelectorHostCall + 2, input);
+  EXPECT_THAT(slot->output, Eq(nullptr));
+  EXPECT_THAT(slot->output_size, Eq(0));
+}
+
+TEST_F(SwitchlessWorkerPoolTest, SignalsAsyncCompletion) {
+  auto pool_result = SwitchlessWorkerPool::Create(client_.get(), 1, 4, 16);
+  ASSERT_THAT(pool_result, IsOk());
+  MessageWriter input;
+  input.Push<int>(6);
+  SwitchlessSlot *slot = &pool_result.ValueOrDie()->ring()->slots()[0];
+  input.Serialize(slot->input);
+  slot->input_size = input.MessageSize();
+  slot->selector = kIncrementSelector;
+  slot->async = 1;
+  AtomicStore(&slot->state, static_cast<uint32_t>(SwitchlessSlot::kPosted));
+
+  int32_t *completion = const_cast<int32_t *>(&slot->completion);
+  while (__atomic_load_n(completion, __ATOMIC_ACQUIRE) == 0) {
+    sys_futex_wait(completion, 0, /*timeout_microsec=*/1000);
+  }
+  EXPECT_THAT(slot->state, Eq(SwitchlessSlot::kDone));
+  MessageReader output;
+  output.Deserialize(slot->output_buffer, slot->output_size);
+  ASSERT_THAT(output.size(), Eq(1));
+  EXPECT_THAT(output.next<int>(), Eq(7));
+}
+
+TEST_F(SwitchlessWorkerPoolTest, StopServicesPostedRequests) {
+  auto pool_result = SwitchlessWorkerPool::Create(client_.get(), 1, 4, 16);
+  ASSERT_THAT(pool_result, IsOk());
+  MessageWriter input;
+  input.Push<int>(1);
+  SwitchlessSlot *slot = &pool_result.ValueOrDie()->ring()->slots()[2];
+  input.Serialize(slot->input);
+  slot->input_size = input.MessageSize();
+  slot->selector = kIncrementSelector;
+  slot->async = 1;
+  AtomicStore(&slot->state, static_cast<uint32_t>(SwitchlessSlot::kPosted));
+
+  // Whether a worker or Stop() services the request, it must be done once
+  // Stop() returns.
+  pool_result.ValueOrDie()->Stop();
+  EXPECT_THAT(slot->state, Eq(SwitchlessSlot::kDone));
+  EXPECT_THAT(slot->completion, Eq(1));
+}
+
+TEST_F(SwitchlessWorkerPoolTest, StopIsIdempotent) {
+  auto pool_result = SwitchlessWorkerPool::Create(client_.get(), 3, 4, 16);
+  ASSERT_THAT(pool_result, IsOk());
+  pool_result.ValueOrDie()->Stop();
+  pool_result.ValueOrDie()->Stop();
+}
+
+}  // namespace
+}  // namespace primitives
+}  // namespace asylo
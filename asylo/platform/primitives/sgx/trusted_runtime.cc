@@ -19,13 +19,23 @@
 #include "asylo/platform/primitives/trusted_runtime.h"
 
 #include <errno.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <sys/types.h>
 
 #include "asylo/platform/primitives/sgx/generated_bridge_t.h"
+#include "asylo/platform/primitives/sgx/trusted_sgx.h"
 #include "include/sgx_thread.h"
 #include "include/sgx_trts.h"
 
+extern "C" {
+
+// Adds |page_number| pages at |start_address| to the enclave with EAUG, and
+// accepts them with EACCEPT. Defined by the SGX SDK trusted runtime.
+int apply_EPC_pages(void *start_address, size_t page_number);
+
+}  // extern "C"
+
 namespace {
 
 // Pointer to start of the heap.
@@ -37,6 +47,42 @@ size_t heap_max_size = 0;
 // Current size of the heap in bytes.
 size_t heap_size = 0;
 
+// Number of times enclave_sbrk failed for lack of heap.
+uint64_t heap_exhaustions = 0;
+
+// Number of bytes at the start of the heap backed by enclave pages. Only less
+// than |heap_max_size| on hardware supporting EDMM, where the rest of the heap
+// is committed as enclave_sbrk hands it out.
+size_t heap_committed = 0;
+
+// Minimum amount by which the committed heap grows, so that a heap growing in
+// small increments does not exit the enclave for every page.
+constexpr size_t kHeapCommitChunk = 2 * 1024 * 1024;
+
+constexpr size_t kPageSize = 4096;
+
+// Commits enough of the heap to back its first |size| bytes. Returns false if
+// the pages could not be added to the enclave.
+bool CommitHeap(size_t size) {
+  if (size <= heap_committed) {
+    return true;
+  }
+  size_t new_committed = heap_committed + kHeapCommitChunk;
+  if (new_committed < size) {
+    new_committed = (size + kPageSize - 1) & ~(kPageSize - 1);
+  }
+  if (new_committed > heap_max_size) {
+    new_committed = heap_max_size;
+  }
+  void *start = reinterpret_cast<uint8_t *>(heap_base) + heap_committed;
+  if (apply_EPC_pages(start, (new_committed - heap_committed) / kPageSize) !=
+      0) {
+    return false;
+  }
+  heap_committed = new_committed;
+  return true;
+}
+
 }  // namespace
 
 extern "C" {
@@ -47,7 +93,11 @@ int heap_init(void *_heap_base, size_t _heap_max_size, size_t _heap_min_size,
               int _is_edmm_supported) {
   heap_base = _heap_base;
   heap_max_size = _heap_max_size;
-  // EDDM not supported so _heap_min_size and _is_edmm_supported are unused.
+  // On hardware supporting EDMM, only the first |_heap_min_size| bytes of the
+  // heap are added to the enclave when it is loaded.
+  heap_committed = _is_edmm_supported && _heap_min_size < _heap_max_size
+                       ? _heap_min_size
+                       : _heap_max_size;
   return 0;
 }
 
@@ -56,6 +106,15 @@ void *enclave_sbrk(intptr_t increment) {
   ssize_t new_heap_size = heap_size + increment;
   if (heap_base == nullptr || new_heap_size < 0 ||
       new_heap_size > heap_max_size) {
+    if (new_heap_size > 0 && new_heap_size > heap_max_size) {
+      heap_exhaustions++;
+    }
+    errno = ENOMEM;
+    return reinterpret_cast<void *>(-1);
+  }
+
+  if (!CommitHeap(new_heap_size)) {
+    heap_exhaustions++;
     errno = ENOMEM;
     return reinterpret_cast<void *>(-1);
   }
@@ -111,6 +170,9 @@ void enc_get_memory_layout(struct EnclaveMemoryLayout *enclave_memory_layout) {
   enclave_memory_layout->bss_size = memory_layout.bss_size;
   enclave_memory_layout->heap_base = memory_layout.heap_base;
   enclave_memory_layout->heap_size = memory_layout.heap_size;
+  enclave_memory_layout->heap_used = g_peak_heap_used;
+  enclave_memory_layout->heap_in_use = heap_size;
+  enclave_memory_layout->heap_exhaustions = heap_exhaustions;
   enclave_memory_layout->thread_base = memory_layout.thread_base;
   enclave_memory_layout->thread_size = memory_layout.thread_size;
   enclave_memory_layout->stack_base = memory_layout.stack_base;
@@ -130,3 +192,16 @@ int active_exit_count() { return sgx_active_exit_count(); }
 int blocked_entry_count() { return sgx_blocked_entry_count(); }
 
 }  //  extern "C"
+
+namespace asylo {
+namespace primitives {
+
+size_t GetCommittedHeapSize() { return heap_committed; }
+
+bool RestoreCommittedHeapSize(size_t committed, size_t size) {
+  heap_committed = committed;
+  return size <= heap_max_size && CommitHeap(size);
+}
+
+}  // namespace primitives
+}  // namespace asylo
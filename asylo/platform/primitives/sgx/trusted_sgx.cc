@@ -27,6 +27,9 @@
 #include "absl/strings/str_cat.h"
 #include "asylo/enclave.pb.h"
 #include "asylo/util/logging.h"
+#include "asylo/platform/posix/host_clock.h"
+#include "asylo/platform/posix/io/io_uring.h"
+#include "asylo/platform/posix/memory/memory.h"
 #include "asylo/platform/posix/signal/signal_manager.h"
 #include "asylo/platform/posix/threading/thread_manager.h"
 #include "asylo/platform/primitives/extent.h"
@@ -35,10 +38,13 @@
 #include "asylo/platform/primitives/sgx/generated_bridge_t.h"
 #include "asylo/platform/primitives/sgx/sgx_error_space.h"
 #include "asylo/platform/primitives/sgx/sgx_params.h"
+#include "asylo/platform/primitives/sgx/trusted_switchless.h"
 #include "asylo/platform/primitives/sgx/untrusted_cache_malloc.h"
 #include "asylo/platform/primitives/trusted_primitives.h"
 #include "asylo/platform/primitives/trusted_runtime.h"
+#include "asylo/platform/primitives/util/boundary_copy.h"
 #include "asylo/platform/primitives/util/message.h"
+#include "asylo/platform/primitives/util/trace_context.h"
 #include "asylo/platform/primitives/util/trusted_memory.h"
 #include "asylo/platform/primitives/util/trusted_runtime_helper.h"
 #include "asylo/platform/system_call/type_conversions/types_functions.h"
@@ -119,12 +125,67 @@ PrimitiveStatus FinalizeEnclave(void *context, MessageReader *in,
   if (in) {
     ASYLO_RETURN_IF_READER_NOT_EMPTY(*in);
   }
+  // Write the buffered log records while the host calls they take still work.
+  FlushLogs();
+
+  // Stop using the switchless ring, which the untrusted loader releases once
+  // the enclave is finalized.
+  DisableSwitchlessCalls();
+
+  // Likewise for the host clock page.
+  DisableHostClock();
+
   // Delete instance of the global memory pool singleton freeing all memory held
   // by the pool.
   delete UntrustedCacheMalloc::Instance();
   return asylo_enclave_fini();
 }
 
+// Entry handler installed by the runtime to register the switchless host call
+// ring allocated by the untrusted loader.
+PrimitiveStatus InitSwitchless(void *context, MessageReader *in,
+                               MessageWriter *out) {
+  ASYLO_RETURN_IF_INCORRECT_READER_ARGUMENTS(*in, 1);
+  return EnableSwitchlessCalls(reinterpret_cast<void *>(in->next<uint64_t>()));
+}
+
+// Entry handler installed by the runtime to register the pre-faulted untrusted
+// arena reserved by the untrusted loader.
+PrimitiveStatus InitUntrustedArena(void *context, MessageReader *in,
+                                   MessageWriter *out) {
+  ASYLO_RETURN_IF_INCORRECT_READER_ARGUMENTS(*in, 2);
+  void *base = reinterpret_cast<void *>(in->next<uint64_t>());
+  uint64_t size = in->next<uint64_t>();
+  if (!base || size == 0 || !TrustedPrimitives::IsOutsideEnclave(base, size)) {
+    return {error::GoogleError::INVALID_ARGUMENT,
+            "Untrusted arena must lie in untrusted memory."};
+  }
+  if (!UntrustedCacheMalloc::Instance()->UseUntrustedArena(base, size)) {
+    return {error::GoogleError::ALREADY_EXISTS,
+            "An untrusted arena is already in use."};
+  }
+  return PrimitiveStatus::OkStatus();
+}
+
+// Entry handler installed by the runtime to register the host clock page
+// published by the untrusted loader.
+PrimitiveStatus InitHostClock(void *context, MessageReader *in,
+                              MessageWriter *out) {
+  ASYLO_RETURN_IF_INCORRECT_READER_ARGUMENTS(*in, 3);
+  void *page = reinterpret_cast<void *>(in->next<uint64_t>());
+  uint64_t max_staleness_ns = in->next<uint64_t>();
+  bool use_tsc = in->next<uint64_t>() != 0;
+  return EnableHostClock(page, max_staleness_ns, use_tsc);
+}
+
+// Entry handler installed by the runtime to register the io_uring instance set
+// up by the untrusted loader.
+PrimitiveStatus InitIoUring(void *context, MessageReader *in,
+                            MessageWriter *out) {
+  ASYLO_RETURN_IF_INCORRECT_READER_ARGUMENTS(*in, 1);
+  return io::EnableIoUring(reinterpret_cast<void *>(in->next<uint64_t>()));
+}
+
 // Entry handler installed by the runtime to start the created thread.
 PrimitiveStatus DonateThread(void *context, MessageReader *in,
                              MessageWriter *out) {
@@ -145,6 +206,9 @@ PrimitiveStatus DonateThread(void *context, MessageReader *in,
 
 // Registers internal handlers, including entry handlers.
 void RegisterInternalHandlers() {
+  // Reduce contention on the trusted heap lock in multithreaded enclaves.
+  EnableMallocThreadCache();
+
   // Register the enclave donate thread entry handler.
   if (!TrustedPrimitives::RegisterEntryHandler(kSelectorAsyloDonateThread,
                                                EntryHandler{DonateThread})
@@ -160,6 +224,38 @@ void RegisterInternalHandlers() {
     TrustedPrimitives::BestEffortAbort(
         "Could not register entry handler: FinalizeEnclave");
   }
+
+  // Register the switchless ring registration entry handler.
+  if (!TrustedPrimitives::RegisterEntryHandler(kSelectorAsyloSwitchlessInit,
+                                               EntryHandler{InitSwitchless})
+           .ok()) {
+    TrustedPrimitives::BestEffortAbort(
+        "Could not register entry handler: InitSwitchless");
+  }
+
+  // Register the untrusted arena registration entry handler.
+  if (!TrustedPrimitives::RegisterEntryHandler(kSelectorAsyloUntrustedArenaInit,
+                                               EntryHandler{InitUntrustedArena})
+           .ok()) {
+    TrustedPrimitives::BestEffortAbort(
+        "Could not register entry handler: InitUntrustedArena");
+  }
+
+  // Register the host clock page registration entry handler.
+  if (!TrustedPrimitives::RegisterEntryHandler(kSelectorAsyloHostClockInit,
+                                               EntryHandler{InitHostClock})
+           .ok()) {
+    TrustedPrimitives::BestEffortAbort(
+        "Could not register entry handler: InitHostClock");
+  }
+
+  // Register the io_uring registration entry handler.
+  if (!TrustedPrimitives::RegisterEntryHandler(kSelectorAsyloIoUringInit,
+                                               EntryHandler{InitIoUring})
+           .ok()) {
+    TrustedPrimitives::BestEffortAbort(
+        "Could not register entry handler: InitIoUring");
+  }
 }
 
 void TrustedPrimitives::BestEffortAbort(const char *message) {
@@ -185,28 +281,49 @@ int asylo_enclave_call(uint64_t selector, void *buffer) {
 
   const void *input = sgx_params->input;
   size_t input_size = sgx_params->input_size;
-  size_t output_size = 0;
+  void *output_buffer = sgx_params->output_buffer;
+  size_t output_capacity = sgx_params->output_capacity;
+  if (!output_buffer) {
+    output_capacity = 0;
+  } else if (!TrustedPrimitives::IsOutsideEnclave(output_buffer,
+                                                  output_capacity)) {
+    PrimitiveStatus status{error::GoogleError::INVALID_ARGUMENT,
+                           "output buffer should lie within untrusted memory."};
+    return status.error_code();
+  }
 
   MessageReader in;
   MessageWriter out;
   // Copy untrusted input to a trusted buffer before deserializing to prevent
-  // TOC/TOU attacks.
-  auto trusted_input = CopyFromUntrusted(input, input_size);
-  if (trusted_input) {
-    in.Deserialize(trusted_input.get(), input_size);
+  // TOC/TOU attacks. |in| refers to the trusted copy without copying it again.
+  TrustedStagingBuffer staging_buffer;
+  if (input && input_size > 0) {
+    const char *trusted_input =
+        staging_buffer.CopyFromUntrusted(input, input_size);
+    PrimitiveStatus status = in.DeserializeInPlace(trusted_input, input_size);
+    if (!status.ok()) {
+      return status.error_code();
+    }
   }
 
   PrimitiveStatus status = InvokeEntryHandler(selector, &in, &out);
 
-  // Serialize |out| to untrusted memory and pass that as output. The untrusted
-  // caller is still responsible for freeing |*output|, which now points to
-  // untrusted memory.
-  output_size = out.MessageSize();
-  if (out.MessageSize() > 0) {
-    // Serialize to a trusted output buffer first to prevent TOC/TOU attacks.
-    std::unique_ptr<char[]> trusted_output(new char[output_size]);
-    out.Serialize(trusted_output.get());
-    sgx_params->output = CopyToUntrusted(trusted_output.get(), output_size);
+  // Serialize |out| straight to untrusted memory, which the enclave never reads
+  // back: to the caller's output buffer if it fits, otherwise to a new buffer
+  // which the untrusted caller is responsible for freeing.
+  size_t output_size = out.MessageSize();
+  if (output_size > 0) {
+    void *untrusted_output =
+        output_size <= output_capacity
+            ? output_buffer
+            : TrustedPrimitives::UntrustedLocalAlloc(output_size);
+    if (!untrusted_output) {
+      PrimitiveStatus alloc_status{error::GoogleError::RESOURCE_EXHAUSTED,
+                                   "Failed to allocate enclave call output."};
+      return alloc_status.error_code();
+    }
+    out.Serialize(untrusted_output);
+    sgx_params->output = untrusted_output;
   }
   sgx_params->output_size = static_cast<uint64_t>(output_size);
   return status.error_code();
@@ -237,11 +354,33 @@ void TrustedPrimitives::UntrustedLocalFree(void *ptr) noexcept {
   CHECK_OCALL(ocall_untrusted_local_free(ptr));
 }
 
-// Since untrusted memory is directly accessible in SGX, we perform no pointer
-// validation before copying the memory.
+// Messages are serialized into the same pool UntrustedCall would otherwise
+// copy them into.
+void *TrustedPrimitives::UntrustedMessageAlloc(size_t size) noexcept {
+  return UntrustedCacheMalloc::Instance()->Malloc(size);
+}
+
+void TrustedPrimitives::UntrustedMessageFree(void *ptr) noexcept {
+  if (ptr) {
+    UntrustedCacheMalloc::Instance()->Free(ptr);
+  }
+}
+
+// Untrusted memory is directly accessible in SGX, so the ranges are validated
+// once, and copied without further checks.
 void *TrustedPrimitives::UntrustedLocalMemcpy(void *dest, const void *src,
                                               size_t size) noexcept {
-  return memcpy(dest, src, size);
+  if (size == 0) {
+    return dest;
+  }
+  bool dest_outside = IsOutsideEnclave(dest, size);
+  if ((!dest_outside && !IsInsideEnclave(dest, size)) ||
+      (!IsOutsideEnclave(src, size) && !IsInsideEnclave(src, size))) {
+    TrustedPrimitives::BestEffortAbort(
+        "UntrustedLocalMemcpy: range crosses the enclave boundary");
+  }
+  return dest_outside ? BoundaryMemcpy(dest, src, size)
+                      : memcpy(dest, src, size);
 }
 
 bool TrustedPrimitives::IsInsideEnclave(const void *addr, size_t size) {
@@ -263,6 +402,15 @@ void TrustedPrimitives::DebugPuts(const char *message) {
 PrimitiveStatus TrustedPrimitives::UntrustedCall(uint64_t untrusted_selector,
                                                  MessageWriter *input,
                                                  MessageReader *output) {
+  TracedCall traced_call(SpanKind::kHostCall, &untrusted_selector, &input,
+                         &output);
+
+  // Post host calls to the switchless ring when it is enabled, falling back to
+  // a regular exit when the ring is full or all workers are busy.
+  if (TrySwitchlessUntrustedCall(untrusted_selector, input, output)) {
+    return PrimitiveStatus::OkStatus();
+  }
+
   int ret;
 
   UntrustedCacheMalloc *untrusted_cache = UntrustedCacheMalloc::Instance();
@@ -273,19 +421,28 @@ PrimitiveStatus TrustedPrimitives::UntrustedCall(uint64_t untrusted_selector,
       [sgx_params, untrusted_cache] { untrusted_cache->Free(sgx_params); });
   sgx_params->input_size = 0;
   sgx_params->input = nullptr;
+  bool owns_input = false;
   if (input) {
     sgx_params->input_size = input->MessageSize();
-    if (sgx_params->input_size > 0) {
+    const void *serialized_input = input->SerializedInPlace();
+    if (serialized_input &&
+        IsOutsideEnclave(serialized_input, sgx_params->input_size)) {
+      // |input| was already serialized into untrusted memory.
+      sgx_params->input = serialized_input;
+    } else if (sgx_params->input_size > 0) {
       // Allocate and copy data to |input_buffer|.
       sgx_params->input = untrusted_cache->Malloc(sgx_params->input_size);
       input->Serialize(const_cast<void *>(sgx_params->input));
+      owns_input = true;
     }
   }
   sgx_params->output_size = 0;
   sgx_params->output = nullptr;
+  sgx_params->output_buffer = nullptr;
+  sgx_params->output_capacity = 0;
   CHECK_OCALL(
       ocall_dispatch_untrusted_call(&ret, untrusted_selector, sgx_params));
-  if (sgx_params->input) {
+  if (owns_input) {
     untrusted_cache->Free(const_cast<void *>(sgx_params->input));
   }
   if (!TrustedPrimitives::IsOutsideEnclave(sgx_params->output,
@@ -370,5 +527,15 @@ uint32_t enc_untrusted_qe_get_quote(const sgx_report_t *app_report,
   return result;
 }
 
+uint32_t enc_untrusted_qe_get_quotes(const sgx_report_t *app_reports,
+                                     uint32_t report_count,
+                                     uint32_t quote_size, uint8_t *quotes) {
+  uint32_t result;
+  CHECK_OCALL(ocall_enc_untrusted_qe_get_quotes(
+      &result, app_reports, report_count, quote_size, quotes,
+      static_cast<uint64_t>(report_count) * quote_size));
+  return result;
+}
+
 }  // namespace primitives
 }  // namespace asylo
@@ -50,6 +50,17 @@ int RegisterSignalHandler(int signum,
                                                    void *),
                           const sigset_t mask, int flags);
 
+// Returns the number of bytes at the start of the heap that are backed by
+// enclave pages.
+size_t GetCommittedHeapSize();
+
+// Resets the number of heap bytes backed by enclave pages to |committed|, as
+// returned by GetCommittedHeapSize() before the record was overwritten by
+// restoring the data and bss of a fork snapshot, then commits enough pages to
+// back the first |size| bytes of the heap. Returns false if those pages could
+// not be added to the enclave.
+bool RestoreCommittedHeapSize(size_t committed, size_t size);
+
 // Allocates |count| buffers of size |size| on the untrusted heap, returning a
 // pointer to an array of buffer pointers.
 void **AllocateUntrustedBuffers(size_t count, size_t size);
@@ -85,6 +96,15 @@ uint32_t enc_untrusted_qe_get_quote_size(uint32_t *quote_size);
 uint32_t enc_untrusted_qe_get_quote(const sgx_report_t *app_report,
                                     uint32_t quote_size, uint8_t *quote);
 
+// Exits the enclave once and calls into the Intel Data Center Attestation
+// Primitives library to get a quote for each of the |report_count| reports in
+// |app_reports|. Each quote is written to its own |quote_size|-byte slot of
+// |quotes|, in the order of |app_reports|. Stops at the first report for which
+// a quote cannot be generated and returns its error.
+uint32_t enc_untrusted_qe_get_quotes(const sgx_report_t *app_reports,
+                                     uint32_t report_count,
+                                     uint32_t quote_size, uint8_t *quotes);
+
 }  // namespace primitives
 }  // namespace asylo
 
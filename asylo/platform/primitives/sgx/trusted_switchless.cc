@@ -0,0 +1,286 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/primitives/sgx/trusted_switchless.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "absl/base/attributes.h"
+#include "asylo/platform/core/atomic.h"
+#include "asylo/platform/primitives/primitives.h"
+#include "asylo/platform/primitives/sgx/switchless_ring.h"
+#include "asylo/platform/primitives/trusted_primitives.h"
+#include "asylo/platform/primitives/trusted_runtime.h"
+#include "asylo/platform/primitives/util/trusted_runtime_helper.h"
+
+namespace asylo {
+namespace primitives {
+namespace {
+
+// Largest ring accepted from the untrusted loader.
+constexpr uint64_t kMaxSwitchlessRingSlots = 1 << 16;
+
+// Number of pause iterations an enclave thread waits for an untrusted worker to
+// claim a posted request before reclaiming it and exiting the enclave instead.
+constexpr size_t kClaimSpinCount = 1024;
+
+// Trusted copy of the ring geometry. Only |ring| is read concurrently; the
+// remaining fields are written before |ring| is published.
+struct {
+  SwitchlessRing *volatile ring = nullptr;
+  SwitchlessSlot *slots = nullptr;
+  uint64_t capacity = 0;
+} switchless_state;
+
+// Number of live ScopedSwitchlessBypass objects on the calling thread.
+ABSL_CONST_INIT thread_local int switchless_bypass_depth = 0;
+
+bool IsSwitchlessSelector(uint64_t untrusted_selector) {
+  return untrusted_selector >= kSelectorHostCall &&
+         untrusted_selector < kSelectorRemote;
+}
+
+// Claims a free slot for the calling thread, or returns nullptr if every slot
+// is in use.
+SwitchlessSlot *ReserveSlot(SwitchlessRing *ring) {
+  // |next_slot| is untrusted; it only picks where to start probing.
+  uint64_t start = AtomicIncrement(&ring->next_slot, std::memory_order_relaxed);
+  for (uint64_t i = 0; i < switchless_state.capacity; ++i) {
+    SwitchlessSlot *slot =
+        &switchless_state.slots[(start + i) % switchless_state.capacity];
+    if (slot->state != SwitchlessSlot::kFree) {
+      continue;
+    }
+    uint32_t expected = SwitchlessSlot::kFree;
+    if (AtomicCompareExchange(&slot->state, &expected,
+                              static_cast<uint32_t>(SwitchlessSlot::kReserved),
+                              /*weak=*/false, std::memory_order_acquire,
+                              std::memory_order_relaxed)) {
+      return slot;
+    }
+  }
+  return nullptr;
+}
+
+void ReleaseSlot(SwitchlessSlot *slot) {
+  AtomicStore(&slot->state, static_cast<uint32_t>(SwitchlessSlot::kFree),
+              std::memory_order_release);
+}
+
+// Copies the response of a done |slot| into |output| and releases the slot.
+void CollectResponse(SwitchlessSlot *slot, MessageReader *output) {
+  // Read the response descriptors once and copy the response into trusted
+  // memory before deserializing it to prevent TOC/TOU attacks.
+  void *untrusted_output = slot->output;
+  size_t output_size = slot->output_size;
+  std::unique_ptr<char[]> trusted_output;
+  if (untrusted_output) {
+    trusted_output = CopyFromUntrusted(untrusted_output, output_size);
+  } else if (output_size > kSwitchlessSlotBufferSize) {
+    TrustedPrimitives::BestEffortAbort(
+        "Switchless response exceeds the slot buffer size.");
+  } else {
+    trusted_output = CopyFromUntrusted(slot->output_buffer, output_size);
+  }
+  ReleaseSlot(slot);
+  if (untrusted_output) {
+    TrustedPrimitives::UntrustedLocalFree(untrusted_output);
+  }
+  if (output && trusted_output) {
+    output->Deserialize(trusted_output.get(), output_size);
+  }
+}
+
+// Writes |input| for |untrusted_selector| into a free slot of |ring| and posts
+// it. Returns the slot, or nullptr if the request does not fit a slot or the
+// ring is full.
+SwitchlessSlot *PostRequest(SwitchlessRing *ring, uint64_t untrusted_selector,
+                            MessageWriter *input, bool async) {
+  size_t input_size = input ? input->MessageSize() : 0;
+  if (input_size > kSwitchlessSlotBufferSize) {
+    return nullptr;
+  }
+
+  SwitchlessSlot *slot = ReserveSlot(ring);
+  if (!slot) {
+    return nullptr;
+  }
+  if (input_size > 0) {
+    input->Serialize(slot->input);
+  }
+  slot->input_size = input_size;
+  slot->selector = untrusted_selector;
+  slot->async = async ? 1 : 0;
+  slot->completion = 0;
+  AtomicStore(&slot->state, static_cast<uint32_t>(SwitchlessSlot::kPosted),
+              std::memory_order_release);
+  return slot;
+}
+
+}  // namespace
+
+PrimitiveStatus EnableSwitchlessCalls(void *untrusted_ring) {
+  if (switchless_state.ring) {
+    return {error::GoogleError::ALREADY_EXISTS,
+            "Switchless calls are already enabled."};
+  }
+  auto ring = reinterpret_cast<SwitchlessRing *>(untrusted_ring);
+  if (!ring || !TrustedPrimitives::IsOutsideEnclave(ring, sizeof(*ring))) {
+    return {error::GoogleError::INVALID_ARGUMENT,
+            "Switchless ring must lie in untrusted memory."};
+  }
+
+  // Read the geometry once; the untrusted copy may change at any time.
+  uint64_t magic = ring->magic;
+  uint64_t capacity = ring->capacity;
+  if (magic != kSwitchlessRingMagic || capacity == 0 ||
+      capacity > kMaxSwitchlessRingSlots ||
+      !TrustedPrimitives::IsOutsideEnclave(ring,
+                                           SwitchlessRingSize(capacity))) {
+    return {error::GoogleError::INVALID_ARGUMENT,
+            "Malformed switchless ring."};
+  }
+
+  switchless_state.slots = ring->slots();
+  switchless_state.capacity = capacity;
+  AtomicStore(&switchless_state.ring, ring, std::memory_order_release);
+  return PrimitiveStatus::OkStatus();
+}
+
+void DisableSwitchlessCalls() {
+  AtomicStore(&switchless_state.ring, static_cast<SwitchlessRing *>(nullptr),
+              std::memory_order_release);
+}
+
+bool TrySwitchlessUntrustedCall(uint64_t untrusted_selector,
+                                MessageWriter *input, MessageReader *output) {
+  SwitchlessRing *ring =
+      __atomic_load_n(&switchless_state.ring, __ATOMIC_ACQUIRE);
+  if (!ring || !IsSwitchlessSelector(untrusted_selector) ||
+      switchless_bypass_depth > 0) {
+    return false;
+  }
+  SwitchlessSlot *slot =
+      PostRequest(ring, untrusted_selector, input, /*async=*/false);
+  if (!slot) {
+    return false;
+  }
+
+  // Give the workers a bounded amount of time to pick up the request. If they
+  // are all busy, take the request back and let the caller exit instead.
+  for (size_t spins = 0; slot->state == SwitchlessSlot::kPosted; ++spins) {
+    if (spins >= kClaimSpinCount) {
+      uint32_t expected = SwitchlessSlot::kPosted;
+      if (AtomicCompareExchange(
+              &slot->state, &expected,
+              static_cast<uint32_t>(SwitchlessSlot::kReserved),
+              /*weak=*/false, std::memory_order_acquire,
+              std::memory_order_relaxed)) {
+        ReleaseSlot(slot);
+        return false;
+      }
+      break;
+    }
+    enc_pause();
+  }
+  while (__atomic_load_n(&slot->state, __ATOMIC_ACQUIRE) !=
+         SwitchlessSlot::kDone) {
+    enc_pause();
+  }
+
+  CollectResponse(slot, output);
+  return true;
+}
+
+std::unique_ptr<AsyncSwitchlessCall> AsyncSwitchlessCall::Post(
+    uint64_t untrusted_selector, MessageWriter *input) {
+  SwitchlessRing *ring =
+      __atomic_load_n(&switchless_state.ring, __ATOMIC_ACQUIRE);
+  if (!ring || !IsSwitchlessSelector(untrusted_selector) || ring->shutdown) {
+    return nullptr;
+  }
+  SwitchlessSlot *slot =
+      PostRequest(ring, untrusted_selector, input, /*async=*/true);
+  if (!slot) {
+    return nullptr;
+  }
+  return std::unique_ptr<AsyncSwitchlessCall>(new AsyncSwitchlessCall(slot));
+}
+
+AsyncSwitchlessCall::~AsyncSwitchlessCall() {
+  if (!slot_) {
+    return;
+  }
+  while (!IsDone()) {
+    if (TryReclaimAfterShutdown()) {
+      return;
+    }
+    enc_pause();
+  }
+  Collect(nullptr);
+}
+
+bool AsyncSwitchlessCall::IsDone() const {
+  // The worker sets |completion| after marking the slot done and does not
+  // touch the slot afterwards, so once it is set the slot may be collected.
+  return __atomic_load_n(&slot_->completion, __ATOMIC_ACQUIRE) != 0;
+}
+
+int32_t *AsyncSwitchlessCall::completion_word() const {
+  return const_cast<int32_t *>(&slot_->completion);
+}
+
+bool AsyncSwitchlessCall::TryReclaimAfterShutdown() {
+  SwitchlessRing *ring =
+      __atomic_load_n(&switchless_state.ring, __ATOMIC_ACQUIRE);
+  if (ring && !__atomic_load_n(&ring->shutdown, __ATOMIC_ACQUIRE)) {
+    return false;
+  }
+  uint32_t expected = SwitchlessSlot::kPosted;
+  if (!AtomicCompareExchange(&slot_->state, &expected,
+                             static_cast<uint32_t>(SwitchlessSlot::kReserved),
+                             /*weak=*/false, std::memory_order_acquire,
+                             std::memory_order_relaxed)) {
+    return false;
+  }
+  ReleaseSlot(slot_);
+  slot_ = nullptr;
+  return true;
+}
+
+void AsyncSwitchlessCall::Collect(MessageReader *output) {
+  // The untrusted side controls both |completion| and |state|, so do not let a
+  // premature |completion| hand out a response which is still being written.
+  while (__atomic_load_n(&slot_->state, __ATOMIC_ACQUIRE) !=
+         SwitchlessSlot::kDone) {
+    enc_pause();
+  }
+  CollectResponse(slot_, output);
+  slot_ = nullptr;
+}
+
+ScopedSwitchlessBypass::ScopedSwitchlessBypass() { ++switchless_bypass_depth; }
+
+ScopedSwitchlessBypass::~ScopedSwitchlessBypass() {
+  --switchless_bypass_depth;
+}
+
+}  // namespace primitives
+}  // namespace asylo
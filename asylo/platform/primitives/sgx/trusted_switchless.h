@@ -0,0 +1,113 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_PRIMITIVES_SGX_TRUSTED_SWITCHLESS_H_
+#define ASYLO_PLATFORM_PRIMITIVES_SGX_TRUSTED_SWITCHLESS_H_
+
+#include <cstdint>
+#include <memory>
+
+#include "asylo/platform/primitives/primitive_status.h"
+#include "asylo/platform/primitives/sgx/switchless_ring.h"
+#include "asylo/platform/primitives/util/message.h"
+
+namespace asylo {
+namespace primitives {
+
+// Starts posting eligible untrusted calls to the switchless request ring
+// located at |untrusted_ring|. The ring is validated to lie entirely outside
+// the enclave. Returns an error if the ring is malformed or if switchless calls
+// are already enabled.
+PrimitiveStatus EnableSwitchlessCalls(void *untrusted_ring);
+
+// Stops posting untrusted calls to the switchless request ring. Calls already
+// in flight complete normally.
+void DisableSwitchlessCalls();
+
+// Attempts to service an untrusted call through the switchless request ring
+// instead of exiting the enclave. Only host call selectors in the range
+// [kSelectorHostCall, kSelectorRemote) are eligible. Returns true if the call
+// was serviced and |output| holds the results. Returns false if switchless
+// calls are disabled, the request does not fit a ring slot, the ring is full,
+// or no untrusted worker claimed the request in time; the caller must then
+// perform a regular exit.
+bool TrySwitchlessUntrustedCall(uint64_t untrusted_selector,
+                                MessageWriter *input, MessageReader *output);
+
+// An untrusted call posted to the switchless request ring whose response is
+// collected later, letting the posting thread do other work or post further
+// calls in the meantime.
+class AsyncSwitchlessCall {
+ public:
+  // Posts |input| for |untrusted_selector| to the switchless request ring and
+  // returns without waiting for a response. Returns nullptr if switchless
+  // calls are disabled or stopping, the selector is not eligible, the request
+  // does not fit a ring slot, or the ring is full; the caller must then perform
+  // a regular call.
+  static std::unique_ptr<AsyncSwitchlessCall> Post(uint64_t untrusted_selector,
+                                                   MessageWriter *input);
+
+  // Waits for the call to complete if it has not been collected, discarding
+  // its response.
+  ~AsyncSwitchlessCall();
+
+  AsyncSwitchlessCall(const AsyncSwitchlessCall &other) = delete;
+  AsyncSwitchlessCall &operator=(const AsyncSwitchlessCall &other) = delete;
+
+  // Returns true once an untrusted worker has produced the response.
+  bool IsDone() const;
+
+  // Returns the untrusted futex word signalled on completion. It holds 0 while
+  // the call is pending and 1 once it is done, so a thread may sleep on it with
+  // enc_untrusted_thread_wait_value(completion_word(), 0).
+  int32_t *completion_word() const;
+
+  // Takes the request back if the untrusted workers were stopped before
+  // claiming it. Returns true if the request was reclaimed, in which case it
+  // was never executed and there is no response to collect.
+  bool TryReclaimAfterShutdown();
+
+  // Copies the response into trusted memory, deserializes it into |output| and
+  // releases the ring slot. Must only be called once, after IsDone() returned
+  // true.
+  void Collect(MessageReader *output);
+
+ private:
+  explicit AsyncSwitchlessCall(SwitchlessSlot *slot) : slot_(slot) {}
+
+  // Slot holding the request, or nullptr once it was collected or reclaimed.
+  SwitchlessSlot *slot_;
+};
+
+// Forces untrusted calls made by the calling thread to take a regular exit for
+// the lifetime of the object. Used around host calls which may block on the
+// host, so that they do not hold a switchless worker hostage.
+class ScopedSwitchlessBypass {
+ public:
+  ScopedSwitchlessBypass();
+  ~ScopedSwitchlessBypass();
+
+  ScopedSwitchlessBypass(const ScopedSwitchlessBypass &other) = delete;
+  ScopedSwitchlessBypass &operator=(const ScopedSwitchlessBypass &other) =
+      delete;
+};
+
+}  // namespace primitives
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_PRIMITIVES_SGX_TRUSTED_SWITCHLESS_H_
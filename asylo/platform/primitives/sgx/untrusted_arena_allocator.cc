@@ -0,0 +1,100 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/primitives/sgx/untrusted_arena_allocator.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+
+namespace asylo {
+namespace {
+
+uintptr_t AlignUp(uintptr_t value) {
+  return (value + UntrustedArenaAllocator::kAlignment - 1) &
+         ~(uintptr_t{UntrustedArenaAllocator::kAlignment} - 1);
+}
+
+uintptr_t AlignDown(uintptr_t value) {
+  return value & ~(uintptr_t{UntrustedArenaAllocator::kAlignment} - 1);
+}
+
+}  // namespace
+
+UntrustedArenaAllocator::UntrustedArenaAllocator(void *base, size_t size) {
+  uintptr_t address = reinterpret_cast<uintptr_t>(base);
+  begin_ = AlignUp(address);
+  end_ = AlignDown(address + size);
+  if (size == 0 || address + size < address || end_ <= begin_) {
+    begin_ = end_ = 0;
+    return;
+  }
+  available_ = end_ - begin_;
+  free_ranges_.emplace(begin_, available_);
+}
+
+void *UntrustedArenaAllocator::Allocate(size_t size) {
+  if (size == 0 || size > available_) {
+    return nullptr;
+  }
+  size = AlignUp(size);
+  for (auto it = free_ranges_.begin(); it != free_ranges_.end(); ++it) {
+    if (it->second < size) {
+      continue;
+    }
+    uintptr_t address = it->first;
+    size_t remaining = it->second - size;
+    free_ranges_.erase(it);
+    if (remaining > 0) {
+      free_ranges_.emplace(address + size, remaining);
+    }
+    allocations_.emplace(address, size);
+    available_ -= size;
+    return reinterpret_cast<void *>(address);
+  }
+  return nullptr;
+}
+
+bool UntrustedArenaAllocator::Free(void *buffer) {
+  auto allocation = allocations_.find(reinterpret_cast<uintptr_t>(buffer));
+  if (allocation == allocations_.end()) {
+    return false;
+  }
+  uintptr_t address = allocation->first;
+  size_t size = allocation->second;
+  allocations_.erase(allocation);
+  available_ += size;
+
+  // Merge with the free ranges immediately following and preceding the buffer.
+  auto next = free_ranges_.lower_bound(address);
+  if (next != free_ranges_.end() && next->first == address + size) {
+    size += next->second;
+    next = free_ranges_.erase(next);
+  }
+  if (next != free_ranges_.begin()) {
+    auto previous = std::prev(next);
+    if (previous->first + previous->second == address) {
+      previous->second += size;
+      return true;
+    }
+  }
+  free_ranges_.emplace_hint(next, address, size);
+  return true;
+}
+
+}  // namespace asylo
@@ -0,0 +1,79 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_PRIMITIVES_SGX_UNTRUSTED_ARENA_ALLOCATOR_H_
+#define ASYLO_PLATFORM_PRIMITIVES_SGX_UNTRUSTED_ARENA_ALLOCATOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+
+namespace asylo {
+
+// Carves buffers out of a fixed range of untrusted memory which was reserved
+// by the untrusted loader ahead of time, so that allocating from it requires no
+// enclave exit. All bookkeeping lives in trusted memory; the contents of the
+// range itself are never trusted or read.
+//
+// This class is not thread-safe. Callers must serialize access.
+class UntrustedArenaAllocator {
+ public:
+  // Alignment of every buffer handed out, chosen to keep buffers used by
+  // different threads on separate cache lines.
+  static constexpr size_t kAlignment = 64;
+
+  // Manages the |size| bytes starting at |base|. The caller is responsible for
+  // validating that the range lies outside the enclave.
+  UntrustedArenaAllocator(void *base, size_t size);
+
+  UntrustedArenaAllocator(const UntrustedArenaAllocator &) = delete;
+  UntrustedArenaAllocator &operator=(const UntrustedArenaAllocator &) = delete;
+
+  // Returns a buffer of at least |size| bytes from the arena, or nullptr if no
+  // free range is large enough.
+  void *Allocate(size_t size);
+
+  // Returns a buffer previously returned by Allocate to the arena. Returns
+  // false if |buffer| is not a live allocation of this arena.
+  bool Free(void *buffer);
+
+  // Returns true if |buffer| points into the managed range.
+  bool Contains(const void *buffer) const {
+    uintptr_t address = reinterpret_cast<uintptr_t>(buffer);
+    return address >= begin_ && address < end_;
+  }
+
+  // Returns the number of bytes not currently allocated.
+  size_t available() const { return available_; }
+
+ private:
+  uintptr_t begin_;
+  uintptr_t end_;
+  size_t available_ = 0;
+
+  // Free ranges keyed by start address, mapped to their size. Adjacent free
+  // ranges are always coalesced.
+  std::map<uintptr_t, size_t> free_ranges_;
+
+  // Live allocations keyed by start address, mapped to their size.
+  std::map<uintptr_t, size_t> allocations_;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_PRIMITIVES_SGX_UNTRUSTED_ARENA_ALLOCATOR_H_
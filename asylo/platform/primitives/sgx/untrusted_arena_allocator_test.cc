@@ -0,0 +1,113 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/primitives/sgx/untrusted_arena_allocator.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace {
+
+using ::testing::Eq;
+using ::testing::IsNull;
+using ::testing::NotNull;
+
+constexpr size_t kArenaSize = 64 * UntrustedArenaAllocator::kAlignment;
+
+class UntrustedArenaAllocatorTest : public ::testing::Test {
+ protected:
+  UntrustedArenaAllocatorTest()
+      : memory_(new char[kArenaSize + UntrustedArenaAllocator::kAlignment]) {
+    // Align the arena so that its full size is usable.
+    uintptr_t address = reinterpret_cast<uintptr_t>(memory_.get());
+    uintptr_t aligned = (address + UntrustedArenaAllocator::kAlignment - 1) &
+                        ~(UntrustedArenaAllocator::kAlignment - 1);
+    base_ = reinterpret_cast<char *>(aligned);
+  }
+
+  std::unique_ptr<char[]> memory_;
+  char *base_;
+};
+
+TEST_F(UntrustedArenaAllocatorTest, AllocatesAlignedBuffersInRange) {
+  UntrustedArenaAllocator arena(base_, kArenaSize);
+  EXPECT_THAT(arena.available(), Eq(kArenaSize));
+  for (size_t size : {1, 63, 64, 65, 200}) {
+    void *buffer = arena.Allocate(size);
+    ASSERT_THAT(buffer, NotNull());
+    EXPECT_TRUE(arena.Contains(buffer));
+    EXPECT_THAT(reinterpret_cast<uintptr_t>(buffer) %
+                    UntrustedArenaAllocator::kAlignment,
+                Eq(0));
+  }
+  EXPECT_FALSE(arena.Contains(base_ + kArenaSize));
+  EXPECT_FALSE(arena.Contains(base_ - 1));
+}
+
+TEST_F(UntrustedArenaAllocatorTest, FailsWhenExhausted) {
+  UntrustedArenaAllocator arena(base_, kArenaSize);
+  EXPECT_THAT(arena.Allocate(kArenaSize + 1), IsNull());
+  void *buffer = arena.Allocate(kArenaSize);
+  ASSERT_THAT(buffer, NotNull());
+  EXPECT_THAT(arena.available(), Eq(0));
+  EXPECT_THAT(arena.Allocate(1), IsNull());
+  EXPECT_TRUE(arena.Free(buffer));
+  EXPECT_THAT(arena.Allocate(kArenaSize), Eq(buffer));
+}
+
+TEST_F(UntrustedArenaAllocatorTest, CoalescesFreedRanges) {
+  UntrustedArenaAllocator arena(base_, kArenaSize);
+  std::vector<void *> buffers;
+  for (size_t i = 0; i < 4; ++i) {
+    buffers.push_back(arena.Allocate(kArenaSize / 4));
+    ASSERT_THAT(buffers.back(), NotNull());
+  }
+
+  // Free the buffers out of order so that merges happen on both sides.
+  EXPECT_TRUE(arena.Free(buffers[1]));
+  EXPECT_TRUE(arena.Free(buffers[3]));
+  EXPECT_THAT(arena.Allocate(kArenaSize / 2), IsNull());
+  EXPECT_TRUE(arena.Free(buffers[2]));
+  EXPECT_TRUE(arena.Free(buffers[0]));
+  EXPECT_THAT(arena.available(), Eq(kArenaSize));
+  EXPECT_THAT(arena.Allocate(kArenaSize), Eq(base_));
+}
+
+TEST_F(UntrustedArenaAllocatorTest, RejectsUnknownBuffers) {
+  UntrustedArenaAllocator arena(base_, kArenaSize);
+  char *buffer = static_cast<char *>(arena.Allocate(128));
+  ASSERT_THAT(buffer, NotNull());
+  EXPECT_FALSE(arena.Free(buffer + 1));
+  EXPECT_TRUE(arena.Free(buffer));
+  EXPECT_FALSE(arena.Free(buffer));
+}
+
+TEST_F(UntrustedArenaAllocatorTest, EmptyArenaAllocatesNothing) {
+  UntrustedArenaAllocator arena(base_, UntrustedArenaAllocator::kAlignment - 1);
+  EXPECT_THAT(arena.available(), Eq(0));
+  EXPECT_THAT(arena.Allocate(1), IsNull());
+  EXPECT_FALSE(arena.Contains(base_));
+}
+
+}  // namespace
+}  // namespace asylo
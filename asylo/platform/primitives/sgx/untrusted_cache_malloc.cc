@@ -17,10 +17,13 @@
  */
 #include "asylo/platform/primitives/sgx/untrusted_cache_malloc.h"
 
+#include <cstdint>
 #include <cstdlib>
 #include <memory>
 
+#include "absl/base/attributes.h"
 #include "absl/memory/memory.h"
+#include "asylo/platform/core/atomic.h"
 #include "asylo/platform/core/trusted_spin_lock.h"
 #include "asylo/platform/posix/memory/memory.h"
 #include "asylo/platform/primitives/trusted_primitives.h"
@@ -46,10 +49,33 @@ void untrusted_cache_free(void *buffer) {
 }  // extern "C"
 
 namespace asylo {
+namespace {
 
 using primitives::TrustedPrimitives;
 
+// Entry sizes in bytes of each size class, in increasing order.
+constexpr size_t kSizeClassBytes[UntrustedCacheMalloc::kNumSizeClasses] = {
+    256, 1024, 4096, 16384, UntrustedCacheMalloc::kMaxPoolEntrySize};
+
+// Number of entries in a slab of each size class.
+constexpr size_t kSlabEntries[UntrustedCacheMalloc::kNumSizeClasses] = {
+    256, 64, 64, 16, 8};
+
+// Free entries cached by the running enclave thread. Enclave thread-local
+// storage is bound to a TCS and persists across enclave entries.
+struct ThreadCache {
+  void *entries[UntrustedCacheMalloc::kNumSizeClasses]
+               [UntrustedCacheMalloc::kThreadCacheCapacity];
+  size_t counts[UntrustedCacheMalloc::kNumSizeClasses];
+};
+
+ABSL_CONST_INIT thread_local ThreadCache thread_cache = {};
+
+}  // namespace
+
 bool UntrustedCacheMalloc::is_destroyed_ = false;
+uintptr_t UntrustedCacheMalloc::arena_begin_ = 0;
+uintptr_t UntrustedCacheMalloc::arena_end_ = 0;
 
 UntrustedCacheMalloc *UntrustedCacheMalloc::Instance() {
   static TrustedSpinLock lock(/*is_recursive=*/false);
@@ -63,7 +89,8 @@ UntrustedCacheMalloc *UntrustedCacheMalloc::Instance() {
   return instance;
 }
 
-UntrustedCacheMalloc::UntrustedCacheMalloc() : lock_(/*is_recursive=*/true) {
+UntrustedCacheMalloc::UntrustedCacheMalloc()
+    : lock_(/*is_recursive=*/true), arena_lock_(/*is_recursive=*/false) {
   if (is_destroyed_) {
     return;
   }
@@ -74,12 +101,18 @@ UntrustedCacheMalloc::UntrustedCacheMalloc() : lock_(/*is_recursive=*/true) {
       primitives::TrustedPrimitives::UntrustedLocalAlloc(sizeof(void *) *
                                                          kFreeListCapacity)));
   free_list_->count = 0;
+  slabs_ = absl::make_unique<Slab[]>(kMaxSlabs);
+  slab_index_ = absl::make_unique<uint16_t[]>(kMaxSlabs);
 }
 
 UntrustedCacheMalloc::~UntrustedCacheMalloc() {
-  while (!buffer_pool_.empty()) {
-    PushToFreeList(buffer_pool_.top());
-    buffer_pool_.pop();
+  // Entries held by depots and thread caches point into the slabs, so
+  // releasing the slabs releases them as well.
+  // Slabs carved out of the untrusted arena are released with the arena.
+  for (size_t i = 0; i < slab_count_; i++) {
+    if (!slabs_[i].from_arena) {
+      PushToFreeList(reinterpret_cast<void *>(slabs_[i].begin));
+    }
   }
 
   // Free remaining elements in the free_list_.
@@ -92,49 +125,188 @@ UntrustedCacheMalloc::~UntrustedCacheMalloc() {
   is_destroyed_ = true;
 }
 
-void *UntrustedCacheMalloc::GetBuffer() {
-  void **buffers = nullptr;
-  void *buffer;
-  bool is_pool_empty;
+size_t UntrustedCacheMalloc::SizeClassFor(size_t size) {
+  size_t size_class = 0;
+  while (kSizeClassBytes[size_class] < size) {
+    size_class++;
+  }
+  return size_class;
+}
 
+bool UntrustedCacheMalloc::AddSlab(size_t size_class, Depot *depot) {
+  const size_t entry_size = kSizeClassBytes[size_class];
+  const size_t entries = kSlabEntries[size_class];
+  const size_t slab_size = entry_size * entries;
+
+  // The depot must be able to take back every entry of its size class, so grow
+  // it before publishing the new slab.
+  size_t new_capacity = depot->capacity + entries;
+  std::unique_ptr<void *[]> new_entries(new void *[new_capacity]);
+  for (size_t i = 0; i < depot->count; i++) {
+    new_entries[i] = depot->entries[i];
+  }
+
+  void **buffers = nullptr;
+  void *slab_base;
   {
     LockGuard spin_lock(&lock_);
-    is_pool_empty = buffer_pool_.empty();
-    if (is_pool_empty) {
-      buffers =
-          primitives::AllocateUntrustedBuffers(kPoolIncrement, kPoolEntrySize);
-      for (int i = 0; i < kPoolIncrement; i++) {
-        if (!buffers[i] ||
-            !TrustedPrimitives::IsOutsideEnclave(buffers[i], kPoolEntrySize)) {
-          abort();
-        }
-        buffer_pool_.push(buffers[i]);
+    if (slab_count_ == kMaxSlabs) {
+      return false;
+    }
+    slab_base = AllocateFromArena(slab_size);
+    if (!slab_base) {
+      buffers = primitives::AllocateUntrustedBuffers(/*count=*/1, slab_size);
+      slab_base = buffers[0];
+      if (!slab_base ||
+          !TrustedPrimitives::IsOutsideEnclave(slab_base, slab_size)) {
+        abort();
       }
     }
-    buffer = buffer_pool_.top();
-    buffer_pool_.pop();
-    busy_buffers_.insert(buffer);
+    Slab *slab = &slabs_[slab_count_];
+    slab->begin = reinterpret_cast<uintptr_t>(slab_base);
+    slab->end = slab->begin + slab_size;
+    slab->size_class = size_class;
+    slab->from_arena = !buffers;
+
+    // Insert the new slab into the sorted index, shifting the entries of slabs
+    // at higher addresses up by one.
+    AtomicStore(&slab_index_sequence_, slab_index_sequence_ + 1,
+                std::memory_order_relaxed);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    size_t position = slab_count_;
+    while (position > 0 &&
+           slabs_[slab_index_[position - 1]].begin > slab->begin) {
+      AtomicStore(&slab_index_[position], slab_index_[position - 1],
+                  std::memory_order_relaxed);
+      position--;
+    }
+    AtomicStore(&slab_index_[position], static_cast<uint16_t>(slab_count_),
+                std::memory_order_relaxed);
+    AtomicStore(&slab_count_, slab_count_ + 1, std::memory_order_release);
+    AtomicStore(&slab_index_sequence_, slab_index_sequence_ + 1,
+                std::memory_order_release);
+  }
+
+  for (size_t i = 0; i < entries; i++) {
+    new_entries[depot->count++] = static_cast<char *>(slab_base) +
+                                  i * entry_size;
   }
+  depot->entries = std::move(new_entries);
+  depot->capacity = new_capacity;
 
-  if (is_pool_empty) {
-    // Free memory held by the array of buffer pointers returned by
-    // AllocateUntrustedBuffers.
+  // Free memory held by the array of buffer pointers returned by
+  // AllocateUntrustedBuffers.
+  if (buffers) {
     Free(buffers);
   }
-  return buffer;
+  return true;
+}
+
+bool UntrustedCacheMalloc::Refill(size_t size_class, void **cache,
+                                  size_t *count) {
+  Depot *depot = &depots_[size_class];
+  LockGuard depot_lock(&depot->lock);
+  if (depot->count == 0 && !AddSlab(size_class, depot)) {
+    return false;
+  }
+  while (*count < kTransferBatch && depot->count > 0) {
+    cache[(*count)++] = depot->entries[--depot->count];
+  }
+  return true;
+}
+
+void UntrustedCacheMalloc::Drain(size_t size_class, void **cache,
+                                 size_t *count) {
+  Depot *depot = &depots_[size_class];
+  LockGuard depot_lock(&depot->lock);
+  for (size_t i = 0; i < kTransferBatch; i++) {
+    depot->entries[depot->count++] = cache[--(*count)];
+  }
+}
+
+const UntrustedCacheMalloc::Slab *UntrustedCacheMalloc::FindSlab(
+    const void *buffer) const {
+  uintptr_t address = reinterpret_cast<uintptr_t>(buffer);
+  while (true) {
+    uint64_t sequence =
+        __atomic_load_n(&slab_index_sequence_, __ATOMIC_ACQUIRE);
+    if (sequence & 1) {
+      // A slab is being added; wait for the index to be consistent again.
+      continue;
+    }
+    size_t slab_count = __atomic_load_n(&slab_count_, __ATOMIC_ACQUIRE);
+
+    // Find the last slab beginning at or below |address|.
+    const Slab *slab = nullptr;
+    size_t low = 0;
+    size_t high = slab_count;
+    while (low < high) {
+      size_t middle = low + (high - low) / 2;
+      uint16_t index = __atomic_load_n(&slab_index_[middle], __ATOMIC_RELAXED);
+      if (index >= slab_count) {
+        // Torn read of an index being rewritten; the check below retries.
+        break;
+      }
+      if (slabs_[index].begin <= address) {
+        slab = &slabs_[index];
+        low = middle + 1;
+      } else {
+        high = middle;
+      }
+    }
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&slab_index_sequence_, __ATOMIC_RELAXED) == sequence) {
+      return slab && address < slab->end ? slab : nullptr;
+    }
+  }
 }
 
 void *UntrustedCacheMalloc::Malloc(size_t size) {
   // Don't access UnturstedCacheMalloc if not running on normal heap, otherwise
   // it will cause error when UntrustedCacheMalloc tries to free the memory on
   // the normal heap.
-  if (is_destroyed_ || (size > kPoolEntrySize) || GetSwitchedHeapNext()) {
+  if (is_destroyed_ || GetSwitchedHeapNext()) {
     return primitives::TrustedPrimitives::UntrustedLocalAlloc(size);
   }
-  return GetBuffer();
+  if (size <= kMaxPoolEntrySize) {
+    size_t size_class = SizeClassFor(size);
+    void **cache = thread_cache.entries[size_class];
+    size_t *count = &thread_cache.counts[size_class];
+    if (*count > 0 || Refill(size_class, cache, count)) {
+      return cache[--(*count)];
+    }
+  }
+  void *buffer = AllocateFromArena(size);
+  if (buffer) {
+    return buffer;
+  }
+  return primitives::TrustedPrimitives::UntrustedLocalAlloc(size);
+}
+
+bool UntrustedCacheMalloc::UseUntrustedArena(void *base, size_t size) {
+  LockGuard arena_lock(&arena_lock_);
+  if (arena_ || is_destroyed_) {
+    return false;
+  }
+  arena_ = absl::make_unique<UntrustedArenaAllocator>(base, size);
+  arena_begin_ = reinterpret_cast<uintptr_t>(base);
+  arena_end_ = arena_begin_ + size;
+  return true;
+}
+
+void *UntrustedCacheMalloc::AllocateFromArena(size_t size) {
+  LockGuard arena_lock(&arena_lock_);
+  return arena_ ? arena_->Allocate(size) : nullptr;
+}
+
+bool UntrustedCacheMalloc::InArena(const void *buffer) {
+  uintptr_t address = reinterpret_cast<uintptr_t>(buffer);
+  return address >= arena_begin_ && address < arena_end_;
 }
 
 void UntrustedCacheMalloc::PushToFreeList(void *buffer) {
+  LockGuard spin_lock(&lock_);
   free_list_->buffers.get()[free_list_->count] = buffer;
   free_list_->count++;
 
@@ -146,21 +318,47 @@ void UntrustedCacheMalloc::PushToFreeList(void *buffer) {
 }
 
 void UntrustedCacheMalloc::Free(void *buffer) {
+  if (InArena(buffer)) {
+    // Slab entries from the arena are handled as any other slab entry below.
+    // Once the pool is gone, or while running on a switched heap where the
+    // trusted bookkeeping must not be touched, arena buffers are simply
+    // abandoned; the loader releases the arena as a whole.
+    if (is_destroyed_ || GetSwitchedHeapNext()) {
+      return;
+    }
+    if (!FindSlab(buffer)) {
+      LockGuard arena_lock(&arena_lock_);
+      if (!arena_->Free(buffer)) {
+        TrustedPrimitives::BestEffortAbort(
+            "UntrustedCacheMalloc::Free called on an invalid arena buffer.");
+      }
+      return;
+    }
+  }
   if (is_destroyed_ || GetSwitchedHeapNext()) {
     primitives::TrustedPrimitives::UntrustedLocalFree(buffer);
     return;
   }
-  LockGuard spin_lock(&lock_);
 
   // Add the buffer to the free list if it was not allocated from the buffer
-  // pool and was allocated via UntrustedLocalAlloc. If the
-  // buffer was allocated from the buffer pool push it back to the pool.
-  if (busy_buffers_.find(buffer) == busy_buffers_.end()) {
+  // pool and was allocated via UntrustedLocalAlloc. If the buffer was allocated
+  // from the buffer pool push it back to the thread cache.
+  const Slab *slab = FindSlab(buffer);
+  if (!slab) {
     PushToFreeList(buffer);
     return;
   }
-  busy_buffers_.erase(buffer);
-  buffer_pool_.push(buffer);
+  const size_t entry_size = kSizeClassBytes[slab->size_class];
+  if ((reinterpret_cast<uintptr_t>(buffer) - slab->begin) % entry_size != 0) {
+    TrustedPrimitives::BestEffortAbort(
+        "UntrustedCacheMalloc::Free called on a misaligned buffer.");
+  }
+  void **cache = thread_cache.entries[slab->size_class];
+  size_t *count = &thread_cache.counts[slab->size_class];
+  if (*count == kThreadCacheCapacity) {
+    Drain(slab->size_class, cache, count);
+  }
+  cache[(*count)++] = buffer;
 }
 
 }  // namespace asylo
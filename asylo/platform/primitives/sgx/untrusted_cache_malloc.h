@@ -20,11 +20,12 @@
 #define ASYLO_PLATFORM_PRIMITIVES_SGX_UNTRUSTED_CACHE_MALLOC_H_
 
 #include <cstddef>
-#include <stack>
-#include <unordered_set>
+#include <cstdint>
+#include <memory>
 
-#include "asylo/platform/core/trusted_spin_lock.h"
+#include "asylo/platform/core/trusted_ticket_lock.h"
 #include "asylo/platform/primitives/sgx/trusted_sgx.h"
+#include "asylo/platform/primitives/sgx/untrusted_arena_allocator.h"
 #include "asylo/platform/primitives/trusted_primitives.h"
 
 namespace asylo {
@@ -33,20 +34,27 @@ namespace asylo {
 // class optimizes the common case of small allocations on backends where the
 // trusted and untrusted application partitions share an address space.
 //
-// For smaller allocations, the implementation allocates memory from a buffer
-// pool maintained by the class. The buffer pool is implemented as a stack
-// of untrusted buffers.
+// Allocations of up to kMaxPoolEntrySize bytes are served from one of several
+// size classes. Each size class carves fixed-size entries out of untrusted
+// slabs, which are allocated in bulk through AllocateUntrustedBuffers. Every
+// enclave thread keeps a small cache of free entries per size class, so the
+// common Malloc/Free path touches only thread-local state. Threads exchange
+// entries in batches with a per-size-class depot shared by all threads when
+// their cache runs empty or full.
 //
-// This class is initialized in the trusted space and manages the buffers
-// in untrusted memory 1) assigning buffers to threads requesting memory and
-// 2) pushing back buffers to the pool (for reuse) when they are requested to
-// be freed.
+// If the untrusted loader reserved an untrusted arena for the enclave, slabs
+// and allocations which miss the pool are carved out of the arena before
+// falling back to UntrustedLocalAlloc, so that they require no enclave exit.
+//
+// The slab table recording which slab (and so which size class) an entry
+// belongs to lives in trusted memory and is append-only, so Free needs no lock
+// to classify a buffer.
 class UntrustedCacheMalloc {
  public:
   UntrustedCacheMalloc(UntrustedCacheMalloc const &) = delete;
   UntrustedCacheMalloc &operator=(UntrustedCacheMalloc const &) = delete;
 
-  // The destructor frees all buffers in the buffer pool and the free list.
+  // The destructor frees all slabs and the free list.
   ~UntrustedCacheMalloc();
 
   // Returns the UntrustedCacheMalloc singleton instance.
@@ -62,19 +70,53 @@ class UntrustedCacheMalloc {
   // Releases memory on the untrusted heap.
   void Free(void *buffer);
 
+  // Serves subsequent slab and large allocations from the |size| bytes of
+  // pre-faulted untrusted memory at |base|. The range must lie outside the
+  // enclave and remain mapped until the pool is destroyed. Returns false if an
+  // arena is already in use.
+  bool UseUntrustedArena(void *base, size_t size);
+
+  // Number of size classes served by the pool.
+  static constexpr size_t kNumSizeClasses = 5;
+
+  // Size in bytes of the largest allocation served by the pool. Larger
+  // allocations go directly to UntrustedLocalAlloc.
+  static constexpr size_t kMaxPoolEntrySize = 65536;
+
+  // Maximum number of free entries an enclave thread caches per size class.
+  static constexpr size_t kThreadCacheCapacity = 32;
+
  private:
   struct FreeList {
     primitives::UntrustedUniquePtr<void *> buffers;
     int count;
   };
 
-  TrustedSpinLock lock_;
+  // A range of untrusted memory carved into entries of one size class.
+  struct Slab {
+    uintptr_t begin;
+    uintptr_t end;
+    size_t size_class;
+    bool from_arena;
+  };
+
+  // Free entries of one size class shared by all threads.
+  struct Depot {
+    Depot() : lock(/*is_recursive=*/false) {}
 
-  // Number of entries added to the buffer pool when it's depleted.
-  static constexpr size_t kPoolIncrement = 1024;
+    TrustedTicketLock lock;
+    std::unique_ptr<void *[]> entries;
+    size_t count = 0;
+    size_t capacity = 0;
+  };
 
-  // Size of a buffer pool entry in bytes.
-  static constexpr size_t kPoolEntrySize = 4096;
+  // Number of entries moved between a thread cache and a depot at once.
+  static constexpr size_t kTransferBatch = kThreadCacheCapacity / 2;
+
+  // Maximum number of slabs the pool may allocate. Once reached, allocations
+  // which cannot be served from existing slabs fall back to
+  // UntrustedLocalAlloc.
+  static constexpr size_t kMaxSlabs = 1024;
 
   // Maximum entries in the free list. When this limit is reached, all memory
   // held by the pointers in the free list is freed.
@@ -87,10 +129,33 @@ class UntrustedCacheMalloc {
 
   UntrustedCacheMalloc();
 
-  // Returns a buffer from the pool. If no buffers are available in the pool,
-  // this function is responsible for adding new buffers to the pool before
-  // returning the buffer.
-  void *GetBuffer();
+  // Returns the index of the smallest size class holding |size| bytes.
+  static size_t SizeClassFor(size_t size);
+
+  // Moves up to kTransferBatch entries of |size_class| from the depot into
+  // |cache|, allocating a new slab if the depot is empty. Returns false if no
+  // entries could be provided.
+  bool Refill(size_t size_class, void **cache, size_t *count);
+
+  // Moves kTransferBatch entries of |size_class| from |cache| to the depot.
+  void Drain(size_t size_class, void **cache, size_t *count);
+
+  // Allocates a slab for |size_class| and pushes its entries to the depot,
+  // which must be locked by the caller. Returns false if the slab table is
+  // full.
+  bool AddSlab(size_t size_class, Depot *depot);
+
+  // Returns the slab containing |buffer|, or nullptr if |buffer| was not
+  // allocated from the pool.
+  const Slab *FindSlab(const void *buffer) const;
+
+  // Returns a buffer of |size| bytes from the untrusted arena, or nullptr if no
+  // arena is in use or it is exhausted.
+  void *AllocateFromArena(size_t size);
+
+  // Returns true if |buffer| lies in the untrusted arena. Safe to call after
+  // the pool was destroyed.
+  static bool InArena(const void *buffer);
 
   // Pushes |buffer| to the free list. If the free list capacity is reached,
   // this function is also responsible for first emptying the free list by
@@ -98,17 +163,38 @@ class UntrustedCacheMalloc {
   // the list.
   void PushToFreeList(void *buffer);
 
+  // Lock protecting |free_list_| and writes to |slabs_|.
+  TrustedTicketLock lock_;
+
   // List of pointers to untrusted buffers which need to be freed.
   std::unique_ptr<FreeList> free_list_;
 
-  // Pool of pointers to free buffers allocated on the untrusted heap. The
-  // buffer pool is implemented as a stack. This allows for a warmer cache as a
-  // recently returned buffer which is hot in the cache is the first to get
-  // reassigned to a thread requesting a buffer.
-  std::stack<void *> buffer_pool_;
+  // Per size class depots of free entries.
+  Depot depots_[kNumSizeClasses];
+
+  // Append-only table of slabs. Entries below |slab_count_| are immutable and
+  // may be read without holding |lock_|.
+  std::unique_ptr<Slab[]> slabs_;
+  volatile size_t slab_count_ = 0;
+
+  // Indices into |slabs_| sorted by slab address, searched by FindSlab(). The
+  // index is rewritten under |lock_| when a slab is added, with
+  // |slab_index_sequence_| odd while it is being rewritten; readers retry a
+  // search that overlapped a rewrite.
+  std::unique_ptr<uint16_t[]> slab_index_;
+  volatile uint64_t slab_index_sequence_ = 0;
+
+  // Lock protecting |arena_|.
+  TrustedTicketLock arena_lock_;
+
+  // Allocator over the untrusted arena, if one is in use.
+  std::unique_ptr<UntrustedArenaAllocator> arena_;
 
-  // Set of buffers returned to and owned by buffer pool clients.
-  std::unordered_set<void *> busy_buffers_;
+  // Bounds of the untrusted arena. They outlive the pool so that buffers
+  // released after its destruction are still recognized as arena memory, which
+  // is returned to the host as a whole by the untrusted loader.
+  static uintptr_t arena_begin_;
+  static uintptr_t arena_end_;
 };
 
 }  // namespace asylo
@@ -18,14 +18,19 @@
 
 #include "asylo/platform/primitives/sgx/untrusted_cache_malloc.h"
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdlib>
+#include <cstring>
 #include <random>
 #include <thread>
 #include <vector>
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include "asylo/platform/primitives/trusted_primitives.h"
+#include "asylo/platform/primitives/util/message.h"
+#include "asylo/platform/primitives/util/untrusted_message_writer.h"
 
 namespace asylo {
 namespace {
@@ -67,5 +72,66 @@ TEST_F(UntrustedCacheMallocTest, StressTest) {
   }
 }
 
+TEST_F(UntrustedCacheMallocTest, ReusesBuffersAcrossSizeClasses) {
+  constexpr int kNumThreads = 8;
+  constexpr int kIterations = 1000;
+
+  // Each thread repeatedly allocates one buffer per size class, including
+  // sizes larger than the largest pool entry, writes to it, and frees it.
+  auto try_size_classes = [](UntrustedCacheMalloc *untrusted_cache_malloc) {
+    const size_t kSizes[] = {1,     256,   257,   1024,  4096,
+                             4097,  16384, 65536, 65537, 131072};
+    for (int i = 0; i < kIterations; i++) {
+      std::vector<void *> buffers;
+      for (size_t size : kSizes) {
+        void *buffer = untrusted_cache_malloc->Malloc(size);
+        ASSERT_NE(buffer, nullptr);
+        memset(buffer, 0, size);
+        buffers.push_back(buffer);
+      }
+      for (void *buffer : buffers) {
+        untrusted_cache_malloc->Free(buffer);
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads; i++) {
+    threads.emplace_back(try_size_classes, untrusted_cache_malloc_);
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+
+TEST_F(UntrustedCacheMallocTest, ReturnsDistinctBuffers) {
+  constexpr int kAllocations = 4 * UntrustedCacheMalloc::kThreadCacheCapacity;
+  std::vector<void *> buffers;
+  for (int i = 0; i < kAllocations; i++) {
+    buffers.push_back(untrusted_cache_malloc_->Malloc(1024));
+  }
+  std::sort(buffers.begin(), buffers.end());
+  EXPECT_EQ(std::adjacent_find(buffers.begin(), buffers.end()), buffers.end());
+  for (void *buffer : buffers) {
+    untrusted_cache_malloc_->Free(buffer);
+  }
+}
+
+TEST_F(UntrustedCacheMallocTest, ArenaWriterSerializesIntoUntrustedMemory) {
+  primitives::UntrustedArenaMessageWriter writer(/*capacity=*/256);
+  writer.Push<int>(7);
+  writer.PushString("arena");
+  const void *serialized = writer.SerializedInPlace();
+  ASSERT_NE(serialized, nullptr);
+  EXPECT_TRUE(primitives::TrustedPrimitives::IsOutsideEnclave(
+      serialized, writer.MessageSize()));
+
+  primitives::MessageReader reader;
+  reader.Deserialize(serialized, writer.MessageSize());
+  ASSERT_EQ(reader.size(), 2);
+  EXPECT_EQ(reader.next<int>(), 7);
+  EXPECT_STREQ(reader.next().As<char>(), "arena");
+}
+
 }  // namespace
 }  // namespace asylo
@@ -18,17 +18,25 @@
 
 #include "asylo/platform/primitives/sgx/untrusted_sgx.h"
 
+#include <fcntl.h>
 #include <sys/mman.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <deque>
 #include <memory>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "absl/strings/str_cat.h"
+#include "asylo/platform/primitives/sgx/enclave_image_cache.h"
 #include "asylo/platform/primitives/sgx/exit_handlers.h"
 #include "asylo/platform/primitives/sgx/generated_bridge_u.h"
 #include "asylo/platform/primitives/sgx/sgx_error_space.h"
@@ -37,8 +45,7 @@
 #include "asylo/platform/primitives/untrusted_primitives.h"
 #include "asylo/platform/primitives/util/message.h"
 #include "asylo/util/cleanup.h"
-#include "asylo/util/elf_reader.h"
-#include "asylo/util/file_mapping.h"
+#include "asylo/util/logging.h"
 #include "asylo/util/function_deleter.h"
 #include "asylo/util/posix_error_space.h"
 #include "asylo/util/status.h"
@@ -63,8 +70,64 @@ constexpr absl::string_view kCallingProcessBinaryFile = "/proc/self/exe";
 forked_loader_callback_t forked_loader_callback;
 
 constexpr int kMaxEnclaveCreateAttempts = 5;
+
+// Maximum number of host threads lent to an enclave while it takes or restores
+// a snapshot.
+constexpr unsigned int kMaxSnapshotWorkers = 8;
+
+// Number of times a host thread that left the enclave without joining the
+// snapshot workers is replaced.
+constexpr int kMaxSnapshotWorkerRetries = 3;
 constexpr size_t kPageSize = 4096;
 
+// Initial and largest retained sizes of the buffers in which a thread passes
+// the inputs and receives the results of its enclave calls.
+constexpr size_t kInitialCallBufferSize = 4096;
+constexpr size_t kMaxRetainedCallBufferSize = 256 * 1024;
+
+// A buffer reused across the enclave calls of a thread.
+class CallBuffer {
+ public:
+  // Returns the buffer after growing it to at least |size| bytes.
+  void *Reserve(size_t size) {
+    if (capacity_ < size) {
+      data_.reset(new char[size]);
+      capacity_ = size;
+    }
+    return data_.get();
+  }
+
+  // Releases the buffer if it grew beyond the retained size.
+  void Trim() {
+    if (capacity_ > kMaxRetainedCallBufferSize) {
+      data_.reset();
+      capacity_ = 0;
+    }
+  }
+
+  void *data() { return data_.get(); }
+  size_t capacity() const { return capacity_; }
+
+ private:
+  std::unique_ptr<char[]> data_;
+  size_t capacity_ = 0;
+};
+
+// The input and output buffers of the enclave calls of a thread. A call made
+// while the buffers of its thread are in use, from a host call handler of an
+// enclosing call, allocates buffers of its own instead, since the enclosing
+// call may still write its results to the output buffer.
+struct ThreadCallBuffers {
+  CallBuffer input;
+  CallBuffer output;
+  bool in_use = false;
+};
+
+ThreadCallBuffers *GetThreadCallBuffers() {
+  static thread_local ThreadCallBuffers buffers;
+  return &buffers;
+}
+
 // Enters the enclave and invokes the secure snapshot key transfer entry-point.
 // If the ecall fails, return a non-OK status.
 static Status TransferSecureSnapshotKey(sgx_enclave_id_t eid, const char *input,
@@ -139,9 +202,91 @@ static Status Restore(sgx_enclave_id_t eid, const char *input, size_t input_len,
   return Status::OkStatus();
 }
 
+// Returns the number of host threads to lend to an enclave taking a snapshot.
+size_t NumSnapshotWorkers() {
+  unsigned int cpus = std::thread::hardware_concurrency();
+  return cpus > 1 ? std::min(cpus - 1, kMaxSnapshotWorkers) : 0;
+}
+
+// Host threads lent to an enclave as snapshot workers, which encrypt or decrypt
+// the snapshot in parallel while the enclave takes or restores it. Each thread
+// enters the enclave, which decides whether the thread joins the workers. The
+// constructor returns once every thread has either joined or left the enclave.
+// The joined threads leave once the snapshot has been taken or restored, and
+// the destructor waits for them.
+class ScopedSnapshotWorkers {
+ public:
+  // Lends |count| threads to the enclave |eid|, pinned to |affinity|. The
+  // threads do not join on the TCS whose thread data is at |avoid_thread_base|,
+  // if any, and are replaced by other threads when they leave without joining.
+  ScopedSnapshotWorkers(sgx_enclave_id_t eid, uint64_t avoid_thread_base,
+                        size_t count, const HostAffinity &affinity) {
+    count = std::min<size_t>(count, kMaxSnapshotWorkers);
+    size_t joined = 0;
+    for (int retry = 0; retry <= kMaxSnapshotWorkerRetries && joined < count;
+         ++retry) {
+      size_t first = threads_.size();
+      for (size_t i = joined; i < count; ++i) {
+        flags_.emplace_back();
+        WorkerFlags *flags = &flags_.back();
+        threads_.emplace_back([eid, avoid_thread_base, affinity, flags] {
+          Status pin_status = affinity.PinCurrentThread();
+          if (!pin_status.ok()) {
+            LOG(WARNING) << "Snapshot worker runs unpinned: " << pin_status;
+          }
+          // The enclave sets |joined| once the thread joined the workers.
+          int retval = 0;
+          ecall_snapshot_worker(eid, &retval, avoid_thread_base,
+                                reinterpret_cast<int *>(&flags->joined));
+          flags->left.store(1);
+        });
+      }
+      for (size_t i = first; i < threads_.size(); ++i) {
+        while (flags_[i].joined.load() == 0 && flags_[i].left.load() == 0) {
+          std::this_thread::yield();
+        }
+        if (flags_[i].joined.load() != 0) {
+          ++joined;
+        }
+      }
+    }
+    if (joined < count) {
+      LOG(WARNING) << "Only " << joined << " of " << count
+                   << " snapshot workers joined";
+    }
+  }
+
+  ScopedSnapshotWorkers(const ScopedSnapshotWorkers &other) = delete;
+  ScopedSnapshotWorkers &operator=(const ScopedSnapshotWorkers &other) =
+      delete;
+
+  ~ScopedSnapshotWorkers() {
+    for (std::thread &thread : threads_) {
+      thread.join();
+    }
+  }
+
+ private:
+  // Whether a thread joined the workers, and whether it left the enclave.
+  struct WorkerFlags {
+    std::atomic<int> joined{0};
+    std::atomic<int> left{0};
+  };
+
+  static_assert(sizeof(std::atomic<int>) == sizeof(int),
+                "The enclave sets the flags of the workers as ints");
+
+  // A deque, so that the flags of running threads never move.
+  std::deque<WorkerFlags> flags_;
+  std::vector<std::thread> threads_;
+};
+
 }  // namespace
 
-SgxEnclaveClient::~SgxEnclaveClient() = default;
+SgxEnclaveClient::~SgxEnclaveClient() {
+  // Pending asynchronous calls still enter the enclave through this object.
+  StopAsyncEntryThreads();
+}
 
 StatusOr<std::shared_ptr<Client>> SgxBackend::Load(
     const absl::string_view enclave_name, void *base_address,
@@ -153,7 +298,6 @@ StatusOr<std::shared_ptr<Client>> SgxBackend::Load(
   client->RegisterExitHandlers();
   client->base_address_ = base_address;
 
-  int updated;
   sgx_status_t status;
   const uint32_t ex_features = SGX_CREATE_ENCLAVE_EX_ASYLO;
   asylo_sgx_config_t create_config = {
@@ -162,10 +306,15 @@ StatusOr<std::shared_ptr<Client>> SgxBackend::Load(
       .enable_user_utility = config.enable_fork()};
   const void *ex_features_p[32] = {nullptr};
   ex_features_p[SGX_CREATE_ENCLAVE_EX_ASYLO_BIT_IDX] = &create_config;
+  // Repeated loads of the same enclave file share one mapping of it.
+  EnclaveImage image;
+  ASYLO_ASSIGN_OR_RETURN(image,
+                         EnclaveImageCache::Instance()->GetFile(enclave_path));
   for (int i = 0; i < kMaxEnclaveCreateAttempts; ++i) {
-    status = sgx_create_enclave_ex(
-        std::string(enclave_path).c_str(), debug, &client->token_, &updated,
-        &client->id_, /*misc_attr=*/nullptr, ex_features, ex_features_p);
+    status = sgx_create_enclave_from_buffer_ex(
+        const_cast<uint8_t *>(image.buffer().data()), image.buffer().size(),
+        debug, &client->id_, /*misc_attr=*/nullptr, ex_features,
+        ex_features_p);
 
     LOG_IF(WARNING, status != SGX_SUCCESS)
         << "Failed to create an enclave, attempt=" << i
@@ -212,17 +361,11 @@ StatusOr<std::shared_ptr<Client>> SgxEmbeddedBackend::Load(
     }
   }
 
-  FileMapping self_binary_mapping;
-  ASYLO_ASSIGN_OR_RETURN(self_binary_mapping, FileMapping::CreateFromFile(
-                                                  kCallingProcessBinaryFile));
-
-  ElfReader self_binary_reader;
-  ASYLO_ASSIGN_OR_RETURN(self_binary_reader, ElfReader::CreateFromSpan(
-                                                 self_binary_mapping.buffer()));
-
-  absl::Span<const uint8_t> enclave_buffer;
-  ASYLO_ASSIGN_OR_RETURN(enclave_buffer,
-                         self_binary_reader.GetSectionData(section_name));
+  // The calling binary is mapped and parsed once for all embedded enclaves.
+  EnclaveImage image;
+  ASYLO_ASSIGN_OR_RETURN(image, EnclaveImageCache::Instance()->GetSection(
+                                    kCallingProcessBinaryFile, section_name));
+  absl::Span<const uint8_t> enclave_buffer = image.buffer();
   // The enclave section should be page-aligned, which is ensured by the
   // embed_enclaves rule.
   if ((reinterpret_cast<uintptr_t>(enclave_buffer.data()) & (kPageSize - 1))) {
@@ -269,12 +412,25 @@ StatusOr<std::shared_ptr<Client>> SgxEmbeddedBackend::Load(
 Status SgxEnclaveClient::Destroy() {
   MessageReader output;
   ASYLO_RETURN_IF_ERROR(EnclaveCall(kSelectorAsyloFini, nullptr, &output));
+  // The enclave no longer posts to the switchless ring once finalized.
+  switchless_workers_.reset();
+  shared_switchless_ring_.reset();
+  host_clock_publisher_.reset();
   ScopedCurrentClient scoped_client(this);
   sgx_status_t status = sgx_destroy_enclave(id_);
   if (status != SGX_SUCCESS) {
     return Status(status, "Failed to destroy enclave");
   }
+  if (untrusted_arena_) {
+    munmap(untrusted_arena_, untrusted_arena_size_);
+    untrusted_arena_ = nullptr;
+    untrusted_arena_size_ = 0;
+  }
+  // Closing the instance cancels any operation still in flight, which may
+  // otherwise write to the buffers.
+  io_uring_.reset();
   is_destroyed_ = true;
+  ASYLO_RETURN_IF_ERROR(WriteExitProfile());
   ASYLO_RETURN_IF_ERROR(
       EnclaveSignalDispatcher::GetInstance()->DeregisterAllSignalsForClient(
           this));
@@ -282,7 +438,8 @@ Status SgxEnclaveClient::Destroy() {
 }
 
 Status SgxEnclaveClient::RegisterExitHandlers() {
-  return RegisterSgxExitHandlers(exit_call_provider());
+  return RegisterSgxExitHandlers(exit_call_provider(),
+                                 &enclave_thread_affinity_);
 }
 
 sgx_enclave_id_t SgxEnclaveClient::GetEnclaveId() const { return id_; }
@@ -297,6 +454,175 @@ void SgxEnclaveClient::GetLaunchToken(sgx_launch_token_t *token) const {
 
 bool SgxEnclaveClient::IsClosed() const { return is_destroyed_; }
 
+Status SgxEnclaveClient::SetHostAffinity(const HostAffinity &enclave_threads,
+                                         const HostAffinity &workers) {
+  if (switchless_workers_ || shared_switchless_ring_ || untrusted_arena_) {
+    return Status(error::GoogleError::FAILED_PRECONDITION,
+                  "The host affinity must be set before switchless calls are "
+                  "enabled and an untrusted arena is reserved");
+  }
+  enclave_thread_affinity_ = enclave_threads;
+  worker_affinity_ = workers;
+  return Status::OkStatus();
+}
+
+Status SgxEnclaveClient::EnableSwitchlessCalls(size_t worker_threads,
+                                               size_t ring_slots,
+                                               size_t idle_spins,
+                                               bool shared_workers) {
+  if (switchless_workers_ || shared_switchless_ring_) {
+    return Status(error::GoogleError::ALREADY_EXISTS,
+                  "Switchless calls are already enabled");
+  }
+  SwitchlessRing *ring;
+  if (shared_workers) {
+    ASYLO_ASSIGN_OR_RETURN(
+        shared_switchless_ring_,
+        SharedSwitchlessWorkerPool::Get()->Register(
+            this, worker_threads, ring_slots, worker_affinity_));
+    ring = shared_switchless_ring_->ring();
+  } else {
+    ASYLO_ASSIGN_OR_RETURN(switchless_workers_,
+                           SwitchlessWorkerPool::Create(this, worker_threads,
+                                                        ring_slots, idle_spins,
+                                                        worker_affinity_));
+    ring = switchless_workers_->ring();
+  }
+
+  MessageWriter input;
+  input.Push(reinterpret_cast<uint64_t>(ring));
+  MessageReader output;
+  Status status = EnclaveCall(kSelectorAsyloSwitchlessInit, &input, &output);
+  if (!status.ok()) {
+    switchless_workers_.reset();
+    shared_switchless_ring_.reset();
+  }
+  return status;
+}
+
+Status SgxEnclaveClient::EnableHostClock(absl::Duration update_interval,
+                                         absl::Duration max_staleness,
+                                         bool use_tsc) {
+  if (host_clock_publisher_) {
+    return Status(error::GoogleError::ALREADY_EXISTS,
+                  "The host clock is already enabled");
+  }
+  if (max_staleness <= update_interval) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "The host clock staleness bound must exceed its update "
+                  "interval");
+  }
+  ASYLO_ASSIGN_OR_RETURN(host_clock_publisher_,
+                         HostClockPublisher::Create(update_interval, use_tsc));
+
+  MessageWriter input;
+  input.Push(reinterpret_cast<uint64_t>(host_clock_publisher_->page()));
+  input.Push(static_cast<uint64_t>(absl::ToInt64Nanoseconds(max_staleness)));
+  input.Push(static_cast<uint64_t>(use_tsc));
+  MessageReader output;
+  Status status = EnclaveCall(kSelectorAsyloHostClockInit, &input, &output);
+  if (!status.ok()) {
+    host_clock_publisher_.reset();
+  }
+  return status;
+}
+
+Status SgxEnclaveClient::EnableIoUring(uint32_t entries, uint32_t buffer_size) {
+  if (io_uring_) {
+    return Status(error::GoogleError::ALREADY_EXISTS,
+                  "io_uring is already enabled");
+  }
+  ASYLO_ASSIGN_OR_RETURN(io_uring_, HostIoUring::Create(entries, buffer_size));
+
+  MessageWriter input;
+  input.Push(reinterpret_cast<uint64_t>(io_uring_->layout()));
+  MessageReader output;
+  Status status = EnclaveCall(kSelectorAsyloIoUringInit, &input, &output);
+  if (!status.ok()) {
+    io_uring_.reset();
+  }
+  return status;
+}
+
+void SgxEnclaveClient::SetExitProfiler(std::unique_ptr<ExitProfiler> profiler,
+                                       std::string path) {
+  exit_profiler_ = std::move(profiler);
+  exit_profile_path_ = std::move(path);
+}
+
+Status SgxEnclaveClient::WriteExitProfile() const {
+  if (!exit_profiler_) {
+    return Status::OkStatus();
+  }
+  std::string profile = FormatExitProfile(exit_profiler_->Snapshot());
+  int fd = open(exit_profile_path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return Status(static_cast<error::PosixError>(errno),
+                  absl::StrCat("Failed to open ", exit_profile_path_));
+  }
+  size_t written = 0;
+  while (written < profile.size()) {
+    ssize_t result =
+        write(fd, profile.data() + written, profile.size() - written);
+    if (result < 0 && errno == EINTR) {
+      continue;
+    }
+    if (result < 0) {
+      int write_errno = errno;
+      close(fd);
+      return Status(static_cast<error::PosixError>(write_errno),
+                    absl::StrCat("Failed to write ", exit_profile_path_));
+    }
+    written += result;
+  }
+  close(fd);
+  return Status::OkStatus();
+}
+
+Status SgxEnclaveClient::ReserveUntrustedArena(size_t size) {
+  if (untrusted_arena_) {
+    return Status(error::GoogleError::ALREADY_EXISTS,
+                  "An untrusted arena is already reserved");
+  }
+  // Populate the mapping up front so that the enclave does not take page
+  // faults, and with them enclave exits, on first use of the arena. When the
+  // arena is bound to a NUMA node, it is populated by hand once bound instead,
+  // so that its pages are allocated on that node in the first place.
+  bool bind = worker_affinity_.has_numa_node();
+  void *arena = mmap(/*addr=*/nullptr, size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | (bind ? 0 : MAP_POPULATE),
+                     /*fd=*/-1, /*offset=*/0);
+  if (arena == MAP_FAILED) {
+    return Status(error::GoogleError::RESOURCE_EXHAUSTED,
+                  "Failed to reserve the untrusted arena");
+  }
+  if (bind) {
+    Status status = worker_affinity_.BindMemory(arena, size);
+    if (!status.ok()) {
+      munmap(arena, size);
+      return status;
+    }
+    const size_t page_size = sysconf(_SC_PAGESIZE);
+    for (size_t offset = 0; offset < size; offset += page_size) {
+      static_cast<volatile char *>(arena)[offset] = 0;
+    }
+  }
+
+  MessageWriter input;
+  input.Push(reinterpret_cast<uint64_t>(arena));
+  input.Push(static_cast<uint64_t>(size));
+  MessageReader output;
+  Status status =
+      EnclaveCall(kSelectorAsyloUntrustedArenaInit, &input, &output);
+  if (!status.ok()) {
+    munmap(arena, size);
+    return status;
+  }
+  untrusted_arena_ = arena;
+  untrusted_arena_size_ = size;
+  return Status::OkStatus();
+}
+
 Status SgxEnclaveClient::EnclaveCallInternal(uint64_t selector,
                                              MessageWriter *input,
                                              MessageReader *output) {
@@ -305,19 +631,40 @@ Status SgxEnclaveClient::EnclaveCallInternal(uint64_t selector,
   params.input = nullptr;
   params.output = nullptr;
   params.output_size = 0;
-  Cleanup clean_up([&params] {
-    if (params.input) {
-      free(const_cast<void *>(params.input));
-    }
-    if (params.output) {
+  params.output_buffer = nullptr;
+  params.output_capacity = 0;
+
+  ThreadCallBuffers *buffers = GetThreadCallBuffers();
+  bool reuse_buffers = !buffers->in_use;
+  if (reuse_buffers) {
+    buffers->in_use = true;
+    params.output_buffer = buffers->output.Reserve(kInitialCallBufferSize);
+    params.output_capacity = buffers->output.capacity();
+  }
+  Cleanup clean_up([&params, buffers, reuse_buffers] {
+    if (params.output && params.output != params.output_buffer) {
       free(params.output);
     }
+    if (reuse_buffers) {
+      // Results which did not fit were allocated by the enclave; grow the
+      // buffer so that the next such results fit.
+      if (params.output && params.output != params.output_buffer) {
+        buffers->output.Reserve(
+            std::min<size_t>(params.output_size, kMaxRetainedCallBufferSize));
+      }
+      buffers->input.Trim();
+      buffers->in_use = false;
+    } else if (params.input) {
+      free(const_cast<void *>(params.input));
+    }
   });
 
   if (input) {
     params.input_size = input->MessageSize();
     if (params.input_size > 0) {
-      params.input = malloc(static_cast<size_t>(params.input_size));
+      size_t input_size = static_cast<size_t>(params.input_size);
+      params.input = reuse_buffers ? buffers->input.Reserve(input_size)
+                                   : malloc(input_size);
       input->Serialize(const_cast<void *>(params.input));
     }
   }
@@ -358,7 +705,12 @@ Status SgxEnclaveClient::EnterAndTakeSnapshot(SnapshotLayout *snapshot_layout) {
   size_t output_len = 0;
 
   ScopedCurrentClient scoped_client(this);
-  ASYLO_RETURN_IF_ERROR(TakeSnapshot(id_, &output_buf, &output_len));
+  {
+    ScopedSnapshotWorkers workers(id_, /*avoid_thread_base=*/0,
+                                  NumSnapshotWorkers(),
+                                  enclave_thread_affinity_);
+    ASYLO_RETURN_IF_ERROR(TakeSnapshot(id_, &output_buf, &output_len));
+  }
 
   // Enclave entry-point was successfully invoked. |output_buf| is guaranteed to
   // have a value.
@@ -393,8 +745,16 @@ Status SgxEnclaveClient::EnterAndRestore(
   size_t output_len = 0;
 
   ScopedCurrentClient scoped_client(this);
-  ASYLO_RETURN_IF_ERROR(
-      Restore(id_, buf.data(), buf.size(), &output, &output_len));
+  {
+    // The thread that called fork is restored last, on its own TCS, which the
+    // workers must stay off. The enclave requires as many workers as the
+    // parent had.
+    ScopedSnapshotWorkers workers(id_, snapshot_layout.forked_thread_base(),
+                                  snapshot_layout.snapshot_workers(),
+                                  enclave_thread_affinity_);
+    ASYLO_RETURN_IF_ERROR(
+        Restore(id_, buf.data(), buf.size(), &output, &output_len));
+  }
 
   // Enclave entry-point was successfully invoked. |output| is guaranteed to
   // have a value.
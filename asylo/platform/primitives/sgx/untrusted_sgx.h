@@ -21,11 +21,19 @@
 
 #include <cstddef>
 #include <memory>
+#include <string>
 
 #include "absl/strings/string_view.h"
+#include "absl/time/time.h"
 #include "asylo/enclave.pb.h"  // IWYU pragma: export
 #include "asylo/platform/primitives/sgx/fork.pb.h"
+#include "asylo/platform/primitives/sgx/host_affinity.h"
+#include "asylo/platform/primitives/sgx/host_clock_publisher.h"
+#include "asylo/platform/primitives/sgx/host_io_uring.h"
+#include "asylo/platform/primitives/sgx/shared_switchless_workers.h"
+#include "asylo/platform/primitives/sgx/switchless_workers.h"
 #include "asylo/platform/primitives/untrusted_primitives.h"
+#include "asylo/platform/primitives/util/exit_profile.h"
 #include "asylo/platform/primitives/util/message.h"
 #include "asylo/util/status.h"
 #include "asylo/util/statusor.h"
@@ -106,6 +114,59 @@ class SgxEnclaveClient : public Client {
   // Sets a new expected process ID for an existing SGX enclave.
   void SetProcessId();
 
+  // Pins the host threads created for enclave threads to the CPUs of
+  // |enclave_threads|, and the switchless workers to those of |workers|, whose
+  // NUMA node also backs the switchless ring and the untrusted arena. Must be
+  // called before the enclave creates threads, and before switchless calls are
+  // enabled or an untrusted arena is reserved.
+  Status SetHostAffinity(const HostAffinity &enclave_threads,
+                         const HostAffinity &workers);
+
+  // Starts |worker_threads| host threads servicing a switchless request ring of
+  // |ring_slots| slots and registers the ring with the enclave. Once enabled,
+  // host calls made by the enclave are posted to the ring instead of exiting
+  // the enclave whenever a slot and a worker are available. Workers yield their
+  // CPU after |idle_spins| consecutive scans of the ring that found no work.
+  //
+  // If |shared_workers| is true, the ring is instead serviced by the
+  // SharedSwitchlessWorkerPool of the process, to which the enclave contributes
+  // up to |worker_threads| workers, and |idle_spins| is ignored.
+  Status EnableSwitchlessCalls(size_t worker_threads, size_t ring_slots,
+                               size_t idle_spins, bool shared_workers = false);
+
+  // Maps and pre-faults |size| bytes of untrusted memory and registers them
+  // with the enclave, which then serves untrusted allocations from them
+  // without exiting. The memory is released when the enclave is destroyed.
+  Status ReserveUntrustedArena(size_t size);
+
+  // Starts a host thread publishing the host clocks every |update_interval| to
+  // a page registered with the enclave, which then reads CLOCK_REALTIME and
+  // CLOCK_MONOTONIC from the page without exiting. The enclave stops using the
+  // page once it trails the host clocks by more than |max_staleness|. If
+  // |use_tsc| is true, the enclave extrapolates readings from the time stamp
+  // counter when it can read it.
+  Status EnableHostClock(absl::Duration update_interval,
+                         absl::Duration max_staleness, bool use_tsc);
+
+  // Sets up an io_uring instance with |entries| submission queue entries and
+  // as many bounce buffers of |buffer_size| bytes, and registers it with the
+  // enclave, which then serves reads, writes and socket I/O on host file
+  // descriptors through it.
+  Status EnableIoUring(uint32_t entries, uint32_t buffer_size);
+
+  // Takes ownership of |profiler|, which the exit call provider of this enclave
+  // records into, and arranges for its profile to be written to |path| when
+  // the enclave is destroyed or exits the process.
+  void SetExitProfiler(std::unique_ptr<ExitProfiler> profiler,
+                       std::string path);
+
+  // Writes the profile of the profiler set by SetExitProfiler(), if any.
+  Status WriteExitProfile() const;
+
+  // Returns the profiler set by SetExitProfiler(), or nullptr if exits are not
+  // profiled.
+  const ExitProfiler *exit_profiler() const { return exit_profiler_.get(); }
+
   // Sets the callback function which loads a new child enclave based on the
   // parent when fork() is called.
   static void SetForkedEnclaveLoader(forked_loader_callback_t callback);
@@ -133,6 +194,32 @@ class SgxEnclaveClient : public Client {
   void *base_address_;              // Enclave base address.
   size_t size_;                     // Enclave size.
   bool is_destroyed_ = true;        // Whether enclave is destroyed.
+
+  // Host threads servicing switchless host calls, if enabled, or the
+  // registration of the switchless ring with the shared worker pool.
+  std::unique_ptr<SwitchlessWorkerPool> switchless_workers_;
+  std::unique_ptr<SharedSwitchlessWorkerPool::Registration>
+      shared_switchless_ring_;
+
+  // Host thread publishing the host clocks, if enabled.
+  std::unique_ptr<HostClockPublisher> host_clock_publisher_;
+
+  // io_uring instance serving enclave I/O, if enabled.
+  std::unique_ptr<HostIoUring> io_uring_;
+
+  // Profiler of the exit calls of the enclave and the file its profile is
+  // written to, if enabled.
+  std::unique_ptr<ExitProfiler> exit_profiler_;
+  std::string exit_profile_path_;
+
+  // Placement of the host threads created for enclave threads, and of the
+  // switchless workers and untrusted memory.
+  HostAffinity enclave_thread_affinity_;
+  HostAffinity worker_affinity_;
+
+  // Untrusted arena registered with the enclave, if any.
+  void *untrusted_arena_ = nullptr;
+  size_t untrusted_arena_size_ = 0;
 };
 
 }  // namespace primitives
@@ -0,0 +1,85 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Enclave side of the primitives benchmark suite. Handlers do as little work
+// as possible beyond moving their payload, so that measurements are dominated
+// by the cost of crossing the enclave boundary.
+
+#include <cstdint>
+#include <memory>
+
+#include "asylo/platform/primitives/extent.h"
+#include "asylo/platform/primitives/primitive_status.h"
+#include "asylo/platform/primitives/test/test_selectors.h"
+#include "asylo/platform/primitives/trusted_primitives.h"
+#include "asylo/platform/primitives/util/message.h"
+#include "asylo/util/status_macros.h"
+
+using ::asylo::primitives::EntryHandler;
+using ::asylo::primitives::PrimitiveStatus;
+using ::asylo::primitives::TrustedPrimitives;
+
+namespace asylo {
+namespace primitives {
+namespace {
+
+// Returns the only input item as the only output item.
+PrimitiveStatus Echo(void *context, MessageReader *in, MessageWriter *out) {
+  ASYLO_RETURN_IF_INCORRECT_READER_ARGUMENTS(*in, 1);
+  out->PushByCopy(in->next());
+  return PrimitiveStatus::OkStatus();
+}
+
+// Expects [uint64_t count, uint64_t payload_size] and makes |count| untrusted
+// calls to the echo exit handler, each carrying |payload_size| bytes.
+PrimitiveStatus UntrustedCallLoop(void *context, MessageReader *in,
+                                  MessageWriter *out) {
+  ASYLO_RETURN_IF_INCORRECT_READER_ARGUMENTS(*in, 2);
+  const uint64_t count = in->next<uint64_t>();
+  const uint64_t payload_size = in->next<uint64_t>();
+  std::unique_ptr<char[]> payload(new char[payload_size]());
+  for (uint64_t i = 0; i < count; ++i) {
+    MessageWriter input;
+    input.PushByReference(Extent{payload.get(), payload_size});
+    MessageReader output;
+    ASYLO_RETURN_IF_ERROR(TrustedPrimitives::UntrustedCall(
+        kUntrustedBenchmarkEcho, &input, &output));
+    ASYLO_RETURN_IF_INCORRECT_READER_ARGUMENTS(output, 1);
+  }
+  return PrimitiveStatus::OkStatus();
+}
+
+}  // namespace
+}  // namespace primitives
+}  // namespace asylo
+
+// Implements the required enclave initialization function.
+extern "C" PrimitiveStatus asylo_enclave_init() {
+  ASYLO_RETURN_IF_ERROR(TrustedPrimitives::RegisterEntryHandler(
+      asylo::primitives::kBenchmarkEchoSelector,
+      EntryHandler{asylo::primitives::Echo}));
+  ASYLO_RETURN_IF_ERROR(TrustedPrimitives::RegisterEntryHandler(
+      asylo::primitives::kBenchmarkUntrustedCallSelector,
+      EntryHandler{asylo::primitives::UntrustedCallLoop}));
+  return PrimitiveStatus::OkStatus();
+}
+
+// Implements the required enclave finalization function.
+extern "C" PrimitiveStatus asylo_enclave_fini() {
+  return PrimitiveStatus::OkStatus();
+}
@@ -0,0 +1,150 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Benchmarks measuring the cost of crossing the enclave boundary through the
+// primitives layer. The suite is linked against one test backend per target,
+// so results of different backends are directly comparable. Pass
+// --benchmark_format=json or --benchmark_out=<file> to collect results in a
+// machine-readable form.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "absl/flags/parse.h"
+#include "absl/memory/memory.h"
+#include "asylo/platform/primitives/extent.h"
+#include "asylo/platform/primitives/test/test_backend.h"
+#include "asylo/platform/primitives/test/test_selectors.h"
+#include "asylo/platform/primitives/untrusted_primitives.h"
+#include "asylo/platform/primitives/util/dispatch_table.h"
+#include "asylo/platform/primitives/util/message.h"
+#include "asylo/util/logging.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+namespace primitives {
+namespace {
+
+// Number of untrusted calls made by the enclave per benchmark iteration, which
+// amortizes the cost of the enclave call driving them.
+constexpr uint64_t kUntrustedCallsPerIteration = 100;
+
+// Largest payload of the payload size sweeps.
+constexpr int64_t kMaxPayloadSize = 1 << 20;
+
+// Largest number of threads of the contention benchmarks.
+constexpr int kMaxThreads = 64;
+
+// Returns the only input item as the only output item.
+Status EchoExitHandler(std::shared_ptr<Client> client, void *context,
+                       MessageReader *input, MessageWriter *output) {
+  if (input->size() != 1) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Echo expects a single item");
+  }
+  output->PushByCopy(input->next());
+  return Status::OkStatus();
+}
+
+// Returns the benchmark enclave, loading it on first use. The enclave is
+// shared by all benchmarks and threads and is never unloaded.
+Client *BenchmarkEnclave() {
+  static Client *const client = [] {
+    auto exit_call_provider = absl::make_unique<DispatchTable>();
+    Status status = exit_call_provider->RegisterExitHandler(
+        kUntrustedBenchmarkEcho, ExitHandler{EchoExitHandler});
+    if (!status.ok()) {
+      LOG(FATAL) << status;
+    }
+    auto client = test::TestBackend::Get()->LoadTestEnclaveOrDie(
+        "primitives_benchmark", std::move(exit_call_provider));
+    if (!client) {
+      LOG(FATAL) << "Failed to load the benchmark enclave";
+    }
+    return new std::shared_ptr<Client>(std::move(client));
+  }()->get();
+  return client;
+}
+
+// Measures an enclave call carrying state.range(0) bytes into the enclave and
+// back out.
+void BM_EnclaveCall(benchmark::State &state) {
+  Client *client = BenchmarkEnclave();
+  const std::string payload(state.range(0), 'a');
+  for (auto _ : state) {
+    MessageWriter in;
+    in.PushByReference(Extent{payload.data(), payload.size()});
+    MessageReader out;
+    Status status = client->EnclaveCall(kBenchmarkEchoSelector, &in, &out);
+    if (!status.ok()) {
+      state.SkipWithError(status.ToString().c_str());
+      break;
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(2 * state.iterations() * payload.size());
+}
+BENCHMARK(BM_EnclaveCall)
+    ->Arg(0)
+    ->RangeMultiplier(4)
+    ->Range(64, kMaxPayloadSize);
+BENCHMARK(BM_EnclaveCall)->Arg(0)->ThreadRange(1, kMaxThreads)->UseRealTime();
+
+// Measures an untrusted call carrying state.range(0) bytes out of the enclave
+// and back in.
+void BM_UntrustedCall(benchmark::State &state) {
+  Client *client = BenchmarkEnclave();
+  const uint64_t payload_size = state.range(0);
+  for (auto _ : state) {
+    MessageWriter in;
+    in.Push(kUntrustedCallsPerIteration);
+    in.Push(payload_size);
+    MessageReader out;
+    Status status =
+        client->EnclaveCall(kBenchmarkUntrustedCallSelector, &in, &out);
+    if (!status.ok()) {
+      state.SkipWithError(status.ToString().c_str());
+      break;
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kUntrustedCallsPerIteration);
+  state.SetBytesProcessed(2 * state.iterations() *
+                          kUntrustedCallsPerIteration * payload_size);
+}
+BENCHMARK(BM_UntrustedCall)
+    ->Arg(0)
+    ->RangeMultiplier(4)
+    ->Range(64, kMaxPayloadSize);
+BENCHMARK(BM_UntrustedCall)
+    ->Arg(0)
+    ->ThreadRange(1, kMaxThreads)
+    ->UseRealTime();
+
+}  // namespace
+}  // namespace primitives
+}  // namespace asylo
+
+int main(int argc, char *argv[]) {
+  benchmark::Initialize(&argc, argv);
+  absl::ParseCommandLine(argc, argv);
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
@@ -0,0 +1,113 @@
+#
+#
+# Copyright 2020 Asylo authors
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+#
+"""Compares primitives benchmark results across backends.
+
+Each *_primitives_benchmark target writes its results as JSON. This script
+reads one result file per backend and prints a table with one row per
+benchmark, giving the real time per iteration on every backend and its ratio to
+the first backend listed, which serves as the baseline:
+
+  primitives_benchmark_report dlopen=dlopen.json remote_dlopen=remote.json
+"""
+
+import json
+import sys
+
+# Nanoseconds per time unit reported by Google Benchmark.
+_NANOSECONDS_PER_UNIT = {'ns': 1, 'us': 1e3, 'ms': 1e6, 's': 1e9}
+
+
+def load_results(results_json):
+  """Returns the real time per iteration, in ns, of every benchmark run.
+
+  Args:
+    results_json: Contents of a Google Benchmark JSON output file.
+
+  Returns:
+    A dict from benchmark name to real time in nanoseconds. Aggregates of
+    repeated runs are left out, so that every row compares single runs.
+  """
+  results = {}
+  for benchmark in json.loads(results_json)['benchmarks']:
+    if benchmark.get('run_type', 'iteration') != 'iteration':
+      continue
+    unit = _NANOSECONDS_PER_UNIT[benchmark.get('time_unit', 'ns')]
+    results[benchmark['name']] = benchmark['real_time'] * unit
+  return results
+
+
+def format_report(results_by_backend):
+  """Formats a comparison of benchmark results.
+
+  Args:
+    results_by_backend: A list of (backend, results) pairs, as returned by
+      load_results(). The first backend is the baseline.
+
+  Returns:
+    The comparison table, as a string.
+  """
+  backends = [backend for backend, _ in results_by_backend]
+  baseline = results_by_backend[0][1]
+  names = []
+  for _, results in results_by_backend:
+    names.extend(name for name in results if name not in names)
+
+  header = ['benchmark'] + [
+      '{} ns'.format(backend) if i == 0 else '{} ns (x)'.format(backend)
+      for i, backend in enumerate(backends)
+  ]
+  rows = [header]
+  for name in names:
+    row = [name]
+    for i, (_, results) in enumerate(results_by_backend):
+      if name not in results:
+        row.append('-')
+      elif i == 0 or not baseline.get(name):
+        row.append('{:.0f}'.format(results[name]))
+      else:
+        row.append('{:.0f} ({:.1f})'.format(results[name],
+                                            results[name] / baseline[name]))
+    rows.append(row)
+
+  widths = [max(len(row[i]) for row in rows) for i in range(len(header))]
+  lines = []
+  for row in rows:
+    cells = [row[0].ljust(widths[0])]
+    cells.extend(cell.rjust(width) for cell, width in zip(row[1:], widths[1:]))
+    lines.append('  '.join(cells).rstrip())
+  return '\n'.join(lines) + '\n'
+
+
+def main(argv):
+  if len(argv) < 2:
+    sys.stderr.write(__doc__)
+    return 1
+  results_by_backend = []
+  for arg in argv[1:]:
+    backend, _, path = arg.partition('=')
+    if not path:
+      sys.stderr.write('Expected <backend>=<results.json>, got {}\n'.format(arg))
+      return 1
+    with open(path) as results_file:
+      results_by_backend.append((backend, load_results(results_file.read())))
+  sys.stdout.write(format_report(results_by_backend))
+  return 0
+
+
+if __name__ == '__main__':
+  sys.exit(main(sys.argv))
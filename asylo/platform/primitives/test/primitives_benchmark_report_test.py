@@ -0,0 +1,56 @@
+#
+#
+# Copyright 2020 Asylo authors
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+#
+"""Tests for primitives_benchmark_report."""
+
+import json
+import unittest
+
+from asylo.platform.primitives.test import primitives_benchmark_report
+
+
+def _results_json(*benchmarks):
+  return json.dumps({'context': {}, 'benchmarks': list(benchmarks)})
+
+
+class PrimitivesBenchmarkReportTest(unittest.TestCase):
+
+  def test_load_results_normalizes_units_and_skips_aggregates(self):
+    results = primitives_benchmark_report.load_results(
+        _results_json(
+            {'name': 'BM_A/0', 'real_time': 2.5, 'time_unit': 'us'},
+            {'name': 'BM_B/0', 'real_time': 40, 'time_unit': 'ns',
+             'run_type': 'iteration'},
+            {'name': 'BM_B/0_mean', 'real_time': 41, 'time_unit': 'ns',
+             'run_type': 'aggregate'}))
+    self.assertEqual(results, {'BM_A/0': 2500, 'BM_B/0': 40})
+
+  def test_format_report_compares_with_baseline(self):
+    report = primitives_benchmark_report.format_report([
+        ('dlopen', {'BM_A/0': 1000, 'BM_B/0': 10}),
+        ('remote', {'BM_A/0': 50000}),
+    ])
+    self.assertEqual(
+        report.splitlines(), [
+            'benchmark  dlopen ns  remote ns (x)',
+            'BM_A/0          1000   50000 (50.0)',
+            'BM_B/0            10              -',
+        ])
+
+
+if __name__ == '__main__':
+  unittest.main()
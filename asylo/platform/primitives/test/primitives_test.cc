@@ -18,9 +18,11 @@
 
 #include <array>
 #include <cstdint>
+#include <future>
 #include <memory>
 #include <thread>
 #include <utility>
+#include <vector>
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
@@ -107,6 +109,16 @@ int32_t MultiplyByTwoOrDie(const std::shared_ptr<Client> &client,
   return res;
 }
 
+// Increments the counter of an instance of the test enclave and returns its
+// new value.
+int32_t IncrementCounterOrDie(const std::shared_ptr<Client> &client) {
+  MessageWriter in;
+  MessageReader out;
+  ASYLO_EXPECT_OK(client->EnclaveCall(kIncrementCounterSelector, &in, &out));
+  EXPECT_THAT(out, SizeIs(1));
+  return out.next<int32_t>();
+}
+
 // Enter an instance of the test enclave with a number and get back with the
 // running average, aborting on failure.
 int64_t AveragePerThreadOrDie(const std::shared_ptr<Client> &client,
@@ -199,6 +211,20 @@ TEST_F(PrimitivesTest, EnclaveLifetime) {
   EXPECT_TRUE(second_instance->IsClosed());
 }
 
+// Ensure that concurrent instances of the same enclave do not share state.
+TEST_F(PrimitivesTest, InstancesHaveIndependentState) {
+  auto first_instance = LoadTestEnclaveOrDie(/*reload=*/true);
+  auto second_instance = LoadTestEnclaveOrDie(/*reload=*/true);
+
+  EXPECT_THAT(IncrementCounterOrDie(first_instance), Eq(1));
+  EXPECT_THAT(IncrementCounterOrDie(first_instance), Eq(2));
+  EXPECT_THAT(IncrementCounterOrDie(second_instance), Eq(1));
+  EXPECT_THAT(IncrementCounterOrDie(first_instance), Eq(3));
+
+  first_instance->Destroy();
+  second_instance->Destroy();
+}
+
 // Test basic enclave load, send message, and destroy.
 TEST_F(PrimitivesTest, LoadEnclave) {
   auto client = LoadTestEnclaveOrDie(/*reload=*/false);
@@ -306,6 +332,34 @@ TEST_F(PrimitivesTest, ThreadedTest) {
   }
 }
 
+// Ensure many asynchronous calls can be in flight from a single thread, and
+// each of them completes with its own results.
+TEST_F(PrimitivesTest, AsyncCallsTest) {
+  constexpr int kNumCalls = 256;
+  auto client = LoadTestEnclaveOrDie(/*reload=*/false);
+  std::vector<MessageWriter> inputs(kNumCalls);
+  std::vector<MessageReader> outputs(kNumCalls);
+  std::vector<std::future<Status>> results;
+  for (int i = 0; i < kNumCalls; i++) {
+    inputs[i].Push<int32_t>(i);
+    results.push_back(
+        client->EnclaveCallAsync(kTimesTwoSelector, &inputs[i], &outputs[i]));
+  }
+  for (int i = 0; i < kNumCalls; i++) {
+    ASYLO_EXPECT_OK(results[i].get());
+    ASSERT_THAT(outputs[i], SizeIs(1));
+    EXPECT_THAT(outputs[i].next<int32_t>(), Eq(2 * i));
+  }
+
+  // Calls to a destroyed enclave fail without being issued.
+  client->Destroy();
+  MessageWriter in;
+  in.Push<int32_t>(1);
+  MessageReader out;
+  EXPECT_THAT(client->EnclaveCallAsync(kTimesTwoSelector, &in, &out).get(),
+              StatusIs(error::GoogleError::FAILED_PRECONDITION));
+}
+
 TEST_F(PrimitivesTest, ThreadedStressMallocsTest) {
   constexpr int kNumThreads = 64;
   constexpr uint64_t kMallocCount = 64;
@@ -18,11 +18,13 @@
 
 #include "asylo/platform/primitives/test/remote_test_backend.h"
 
+#include <cstdint>
 #include <memory>
 #include <string>
 
 #include "absl/flags/flag.h"
 #include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
 #include "asylo/enclave.pb.h"
 #include "asylo/util/logging.h"
 #include "asylo/platform/primitives/remote/proxy_client.h"
@@ -32,6 +34,7 @@
 #include "asylo/util/path.h"
 #include "asylo/util/remote/provision.h"
 #include "asylo/util/remote/remote_loader.pb.h"
+#include "asylo/util/remote/remote_proxy_config.h"
 #include "asylo/util/status_macros.h"
 #include "asylo/util/statusor.h"
 #include "include/grpcpp/security/credentials.h"
@@ -41,6 +44,16 @@
 ABSL_FLAG(std::string, enclave_binary, "",
           "Path to the enclave binary to be loaded remotely");
 
+// Host-side transport options, so that benchmarks can compare them.
+ABSL_FLAG(bool, remote_shared_memory, false,
+          "Negotiate the shared memory transport with the remote proxy");
+ABSL_FLAG(absl::Duration, remote_coalescing_window, absl::ZeroDuration(),
+          "Window to coalesce messages sent to the remote proxy in, or zero "
+          "to send every message on its own");
+ABSL_FLAG(int64_t, remote_payload_compression_threshold, -1,
+          "Smallest message payload to compress before sending it to the "
+          "remote proxy, or a negative value to never compress payloads");
+
 namespace asylo {
 namespace primitives {
 namespace test {
@@ -61,6 +74,16 @@ StatusOr<std::shared_ptr<Client>> RemoteTestBackend::LoadTestEnclave(
   std::unique_ptr<RemoteProxyClientConfig> config;
   ASYLO_ASSIGN_OR_RETURN(config, RemoteProxyClientConfig::DefaultsWithProvision(
                                      RemoteProvision::Instantiate()));
+  if (absl::GetFlag(FLAGS_remote_shared_memory)) {
+    config->EnableSharedMemoryTransport();
+  }
+  config->EnableMessageCoalescing(
+      absl::GetFlag(FLAGS_remote_coalescing_window));
+  const int64_t compression_threshold =
+      absl::GetFlag(FLAGS_remote_payload_compression_threshold);
+  if (compression_threshold >= 0) {
+    config->EnablePayloadCompression(compression_threshold);
+  }
 
   EnclaveLoadConfig load_config;
   PrepareLoaderParameters(&load_config);
@@ -78,6 +78,16 @@ PrimitiveStatus MultiplyByTwo(void *context, MessageReader *in,
   return PrimitiveStatus::OkStatus();
 }
 
+// Message handler incrementing a counter in static storage and returning its
+// new value, to tell instances of the enclave apart.
+PrimitiveStatus IncrementCounter(void *context, MessageReader *in,
+                                 MessageWriter *out) {
+  ASYLO_RETURN_IF_READER_NOT_EMPTY(*in);
+  static int32_t counter = 0;
+  out->Push(++counter);
+  return PrimitiveStatus::OkStatus();
+}
+
 // Message handler receiving incoming numbers and returning a running average,
 // using thread-local storage.
 PrimitiveStatus AveragePerThread(void *context, MessageReader *in,
@@ -299,6 +309,9 @@ extern "C" PrimitiveStatus asylo_enclave_init() {
   ASYLO_RETURN_IF_ERROR(TrustedPrimitives::RegisterEntryHandler(
       asylo::primitives::kInsideOutsideTest,
       EntryHandler{asylo::primitives::InsideOutsideTest}));
+  ASYLO_RETURN_IF_ERROR(TrustedPrimitives::RegisterEntryHandler(
+      asylo::primitives::kIncrementCounterSelector,
+      EntryHandler{asylo::primitives::IncrementCounter}));
   return asylo::primitives::initialized
              ? PrimitiveStatus::OkStatus()
              : PrimitiveStatus{::asylo::error::GoogleError::FAILED_PRECONDITION,
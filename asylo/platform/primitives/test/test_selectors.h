@@ -36,6 +36,11 @@ constexpr uint64_t kAveragePerThreadSelector = kSelectorUser + 6;
 constexpr uint64_t kCopyMultipleParamsSelector = kSelectorUser + 7;
 constexpr uint64_t kStressMallocs = kSelectorUser + 8;
 constexpr uint64_t kInsideOutsideTest = kSelectorUser + 9;
+constexpr uint64_t kIncrementCounterSelector = kSelectorUser + 10;
+
+// Entry points registered by the benchmark enclave.
+constexpr uint64_t kBenchmarkEchoSelector = kSelectorUser + 20;
+constexpr uint64_t kBenchmarkUntrustedCallSelector = kSelectorUser + 21;
 
 // Entry point with no registered handler.
 constexpr uint64_t kNotRegisteredSelector = kSelectorUser + 100;
@@ -43,6 +48,7 @@ constexpr uint64_t kNotRegisteredSelector = kSelectorUser + 100;
 // Exit points registered by untrusted code.
 constexpr uint64_t kUntrustedInit = kSelectorUser + 1;
 constexpr uint64_t kUntrustedFibonacci = kSelectorUser + 2;
+constexpr uint64_t kUntrustedBenchmarkEcho = kSelectorUser + 3;
 
 }  // namespace primitives
 }  // namespace asylo
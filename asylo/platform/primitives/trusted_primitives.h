@@ -102,11 +102,29 @@ class TrustedPrimitives {
   /// \param ptr The pointer to untrusted memory to free.
   static void UntrustedLocalFree(void *ptr) noexcept;
 
+  /// Allocates `size` bytes of untrusted local memory for a MessageWriter to
+  /// serialize the input of an UntrustedCall into as it is built, which
+  /// UntrustedCall then passes on without copying. Backends which cannot pass
+  /// such memory on as is return nullptr, in which case the MessageWriter
+  /// keeps its extents as usual.
+  ///
+  /// \param size The number of bytes to allocate.
+  /// \returns A pointer to the allocated memory, or nullptr.
+  static void *UntrustedMessageAlloc(size_t size) noexcept;
+
+  /// Frees memory returned by UntrustedMessageAlloc. Does nothing if `ptr` is
+  /// nullptr.
+  ///
+  /// \param ptr The pointer to untrusted memory to free.
+  static void UntrustedMessageFree(void *ptr) noexcept;
+
   /// Copies `size` bytes of memory from `src` to `dest`.
   ///
   /// Backends seeking to access or copy untrusted local memory should not
   /// assume direct memory access, and instead use this function to copy to/from
-  /// the untrusted local memory.
+  /// the untrusted local memory. Neither range may cross the enclave boundary.
+  /// Large copies into untrusted memory use non-temporal stores, which do not
+  /// evict the working set of the enclave from the cache.
   ///
   /// \param dest The trusted or untrusted local destination memory.
   /// \param src The trusted or untrusted local source memory.
@@ -50,6 +50,17 @@ ssize_t enc_hardware_random(uint8_t *buf, size_t count);
 // enc_hardware_random.
 int enc_hardware_random_entropy();
 
+// Writes `count`-many cryptographically secure pseudorandom bytes into `buf`
+// from a per-thread CTR_DRBG, which is seeded and periodically reseeded with
+// enc_hardware_random. Small requests are served from a per-thread pool of
+// generated bytes. Returns -1 if there is no hardware source of randomness.
+ssize_t enc_pseudorandom(uint8_t *buf, size_t count);
+
+// Forces every thread to reseed the generator behind enc_pseudorandom and to
+// discard its pool before the next use. Must be called after the enclave state
+// was duplicated, such as when restoring a fork snapshot.
+void enc_pseudorandom_reset();
+
 // Registers a signal handler on the host.
 int enc_register_signal(int signum, const sigset_t mask, int flags);
 
@@ -91,6 +102,15 @@ struct EnclaveMemoryLayout {
   void *heap_base;
   // size of heap in the current enclave.
   size_t heap_size;
+  // Number of bytes at the start of the heap that have been handed out by
+  // enclave_sbrk at any point. The rest of the heap has never been allocated,
+  // and still holds the zeros it was loaded with.
+  size_t heap_used;
+  // Number of bytes at the start of the heap that are currently handed out by
+  // enclave_sbrk.
+  size_t heap_in_use;
+  // Number of times enclave_sbrk refused to grow the heap.
+  uint64_t heap_exhaustions;
   // Base address of the thread data for the current thread.
   void *thread_base;
   // Size of the thread data for the current thread.
@@ -21,15 +21,19 @@
 #include <unistd.h>
 
 #include <cstdint>
+#include <future>
 #include <memory>
 #include <utility>
 
+#include "absl/memory/memory.h"
 #include "asylo/platform/primitives/extent.h"
 #include "asylo/platform/primitives/primitive_status.h"
 #include "asylo/platform/primitives/primitives.h"
 #include "asylo/platform/primitives/util/status_conversions.h"
+#include "asylo/platform/primitives/util/trace_context.h"
 #include "asylo/util/asylo_macros.h"
 #include "asylo/util/status.h"
+#include "asylo/util/status_macros.h"
 #include "asylo/util/statusor.h"
 
 namespace asylo {
@@ -37,6 +41,13 @@ namespace primitives {
 
 thread_local Client *Client::current_client_ = nullptr;
 
+constexpr size_t Client::kDefaultAsyncEntryThreads;
+
+Client::~Client() {
+  StopAsyncEntryThreads();
+  ReleaseMemory();
+}
+
 Client::ScopedCurrentClient::~ScopedCurrentClient() {
   if (pid_ != getpid()) {
     // This is a process forked during an enclave entry, we should not restore
@@ -58,18 +69,69 @@ Status Client::EnclaveCall(uint64_t selector, MessageWriter *input,
                   "Cannot make an enclave call to a closed enclave."};
   }
   ScopedCurrentClient scoped_client(this);
-  return EnclaveCallInternal(selector, input, output);
+  TracedCall traced_call(SpanKind::kEnclaveCall, &selector, &input, &output);
+  ASYLO_RETURN_IF_ERROR(EnclaveCallInternal(selector, input, output));
+  return MakeStatus(traced_call.ReceiveSpans(output));
+}
+
+std::future<Status> Client::EnclaveCallAsync(uint64_t selector,
+                                             MessageWriter *input,
+                                             MessageReader *output) {
+  if (IsClosed()) {
+    std::promise<Status> closed;
+    closed.set_value(
+        Status{error::GoogleError::FAILED_PRECONDITION,
+               "Cannot make an enclave call to a closed enclave."});
+    return closed.get_future();
+  }
+  return EnclaveCallAsyncInternal(selector, input, output);
+}
+
+std::future<Status> Client::EnclaveCallAsyncInternal(uint64_t selector,
+                                                     MessageWriter *input,
+                                                     MessageReader *output) {
+  // std::function requires a copyable callable, hence the shared promise.
+  auto promise = std::make_shared<std::promise<Status>>();
+  std::future<Status> result = promise->get_future();
+  auto pool = async_entry_threads_.Lock();
+  if (!*pool) {
+    *pool = absl::make_unique<EntryThreadPool>(AsyncEntryThreads());
+  }
+  // The call continues the trace of the calling thread on the entry thread.
+  TraceContext trace_context = CurrentTraceContext();
+  (*pool)->Schedule([this, promise, selector, input, output, trace_context] {
+    ScopedTraceContext scoped_trace_context(trace_context);
+    promise->set_value(EnclaveCall(selector, input, output));
+  });
+  return result;
+}
+
+void Client::StopAsyncEntryThreads() {
+  std::unique_ptr<EntryThreadPool> pool;
+  async_entry_threads_.Lock()->swap(pool);
+  // Join outside of the lock, so that pending calls issuing further
+  // asynchronous calls do not deadlock.
+  pool.reset();
 }
 
 PrimitiveStatus Client::ExitCallback(uint64_t untrusted_selector,
                                      MessageReader *in, MessageWriter *out) {
-  if (!current_client_->exit_call_provider()) {
-    return PrimitiveStatus{error::GoogleError::FAILED_PRECONDITION,
-                           "Exit call provider not set yet"};
-  }
   return MakePrimitiveStatus(
-      current_client_->exit_call_provider()->InvokeExitHandler(
-          untrusted_selector, in, out, current_client_));
+      current_client_->InvokeExitHandler(untrusted_selector, in, out));
+}
+
+Status Client::InvokeExitHandler(uint64_t untrusted_selector,
+                                 MessageReader *in, MessageWriter *out) {
+  if (!exit_call_provider()) {
+    return Status{error::GoogleError::FAILED_PRECONDITION,
+                  "Exit call provider not set yet"};
+  }
+  TraceContext caller;
+  ASYLO_RETURN_IF_ERROR(
+      MakeStatus(DetachTraceContext(&untrusted_selector, in, &caller)));
+  ScopedSpan span(SpanKind::kExitHandler, untrusted_selector, caller);
+  return exit_call_provider()->InvokeExitHandler(untrusted_selector, in, out,
+                                                 this);
 }
 
 // This provides a default, no-op implementation if this function is not
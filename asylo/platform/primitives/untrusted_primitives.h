@@ -21,7 +21,9 @@
 
 #include <unistd.h>
 
+#include <cstddef>
 #include <cstdint>
+#include <future>
 #include <memory>
 #include <utility>
 
@@ -29,6 +31,7 @@
 #include "asylo/platform/primitives/extent.h"
 #include "asylo/platform/primitives/primitive_status.h"
 #include "asylo/platform/primitives/primitives.h"
+#include "asylo/platform/primitives/util/entry_thread_pool.h"
 #include "asylo/platform/primitives/util/message.h"
 #include "asylo/util/asylo_macros.h"
 #include "asylo/util/mutex_guarded.h"
@@ -160,7 +163,7 @@ class Client : public std::enable_shared_from_this<Client> {
     const pid_t pid_;
   };
 
-  virtual ~Client() { ReleaseMemory(); }
+  virtual ~Client();
 
   /// An overridable handler registration method.
   ///
@@ -218,6 +221,29 @@ class Client : public std::enable_shared_from_this<Client> {
   Status EnclaveCall(uint64_t selector, MessageWriter *input,
                      MessageReader *output) ASYLO_MUST_USE_RESULT;
 
+  /// Enters the enclave at an entry point to trusted code designated by
+  /// `selector`, without blocking the calling thread.
+  ///
+  /// The call behaves as EnclaveCall() does, except that it completes in the
+  /// background: the returned future becomes ready with the status of the
+  /// call once `output` holds its results. This lets a host keep many calls in
+  /// flight without dedicating a thread to each of them. Calls issued
+  /// concurrently may complete in any order.
+  ///
+  /// Every future returned by this method must be ready before the client is
+  /// destroyed.
+  ///
+  /// \param selector The identification number to select a registered
+  ///    handler in the enclave.
+  /// \param input A pointer to a MessageWriter, into which all call inputs must
+  ///    be pushed. It must remain valid until the returned future is ready.
+  /// \param output A pointer to a MessageReader from which to read outputs from
+  ///    the call. It must remain valid, and must not be read, until the
+  ///    returned future is ready.
+  /// \returns A future holding the status of the call.
+  std::future<Status> EnclaveCallAsync(uint64_t selector, MessageWriter *input,
+                                       MessageReader *output);
+
   /// Enclave exit callback function shared with the enclave.
   ///
   /// \param untrusted_selector The identification number to select a registered
@@ -230,6 +256,22 @@ class Client : public std::enable_shared_from_this<Client> {
   static PrimitiveStatus ExitCallback(uint64_t untrusted_selector,
                                       MessageReader *in, MessageWriter *out);
 
+  /// Invokes the handler of an exit call made by the enclave of this client,
+  /// as found by its exit call provider.
+  ///
+  /// Backends pass every exit call received from their enclave through this
+  /// method, which strips the trace context the enclave may have attached to
+  /// the call and records the span of the handler.
+  ///
+  /// \param untrusted_selector The selector of the exit call, as received from
+  ///    the enclave.
+  /// \param in A pointer to a MessageReader, from which all inputs are read.
+  /// \param out A pointer to a MessageWriter, into which all call outputs are
+  ///    written.
+  /// \returns An error status on failure, otherwise Ok.
+  Status InvokeExitHandler(uint64_t untrusted_selector, MessageReader *in,
+                           MessageWriter *out) ASYLO_MUST_USE_RESULT;
+
   /// Accessor to the client's exit call provider.
   ///
   /// \returns A mutable pointer to the client's ExitCallProvider.
@@ -279,7 +321,39 @@ class Client : public std::enable_shared_from_this<Client> {
                                      MessageReader *output)
       ASYLO_MUST_USE_RESULT = 0;
 
+  /// Provides implementation of EnclaveCallAsync.
+  ///
+  /// The default implementation runs EnclaveCall() on a pool of
+  /// AsyncEntryThreads() host threads, created on the first asynchronous
+  /// call. Backends able to issue calls without blocking a host thread may
+  /// override it.
+  ///
+  /// \param selector The identification number to select a registered
+  ///    handler in the enclave.
+  /// \param input A pointer to a MessageWriter, into which all call inputs must
+  ///    be pushed.
+  /// \param output A pointer to a MessageReader from which to read outputs from
+  ///    the call.
+  /// \returns A future holding the status of the call.
+  virtual std::future<Status> EnclaveCallAsyncInternal(uint64_t selector,
+                                                       MessageWriter *input,
+                                                       MessageReader *output);
+
+  /// The number of host threads entering the enclave on behalf of
+  /// EnclaveCallAsync() in the default implementation, which bounds the number
+  /// of asynchronous calls running in the enclave at once.
+  ///
+  /// \returns The size of the pool of entry threads.
+  virtual size_t AsyncEntryThreads() const { return kDefaultAsyncEntryThreads; }
+
+  /// Joins the entry threads serving EnclaveCallAsync(), after they have
+  /// completed every pending call. Backends call this before tearing down
+  /// state those calls depend on.
+  void StopAsyncEntryThreads();
+
  private:
+  static constexpr size_t kDefaultAsyncEntryThreads = 4;
+
   // Exit call provider for the enclave.
   const std::unique_ptr<ExitCallProvider> exit_call_provider_;
 
@@ -292,6 +366,9 @@ class Client : public std::enable_shared_from_this<Client> {
 
   // A collection of memory to free upon enclave exit.
   MutexGuarded<std::vector<void *>> memory_to_free_;
+
+  // Entry threads serving EnclaveCallAsync(), created on first use.
+  MutexGuarded<std::unique_ptr<EntryThreadPool>> async_entry_threads_;
 };
 
 }  // namespace primitives
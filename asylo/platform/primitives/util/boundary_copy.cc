@@ -0,0 +1,131 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/primitives/util/boundary_copy.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "asylo/platform/primitives/cpuid.h"
+
+namespace asylo {
+namespace primitives {
+namespace {
+
+#if defined(__x86_64__)
+
+// Returns true if AVX instructions can be used: the CPU supports them, and the
+// OS, or for an SGX enclave its XFRM attribute, saves the AVX state.
+bool AvxUsable() {
+  uint32_t registers[4];
+  if (!enc_cpuid(1, 0, registers)) {
+    return false;
+  }
+  // Bit 27 of ECX is OSXSAVE and bit 28 is AVX.
+  constexpr uint32_t kOsxsaveAndAvx = (1u << 27) | (1u << 28);
+  if ((registers[2] & kOsxsaveAndAvx) != kOsxsaveAndAvx) {
+    return false;
+  }
+  // Bits 1 and 2 of XCR0 enable the SSE and AVX state.
+  uint32_t xcr0_low;
+  uint32_t xcr0_high;
+  asm volatile("xgetbv" : "=a"(xcr0_low), "=d"(xcr0_high) : "c"(0));
+  return (xcr0_low & 0x6) == 0x6;
+}
+
+// Copies the |size| bytes at |src| to |dest|, which is 32-byte aligned, with
+// 32-byte non-temporal stores. |size| is a multiple of 128.
+__attribute__((target("avx"))) void StreamAvx(char *dest, const char *src,
+                                              size_t size) {
+  for (size_t i = 0; i < size; i += 128) {
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+    __m256i b =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i + 32));
+    __m256i c =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i + 64));
+    __m256i d =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i + 96));
+    _mm256_stream_si256(reinterpret_cast<__m256i *>(dest + i), a);
+    _mm256_stream_si256(reinterpret_cast<__m256i *>(dest + i + 32), b);
+    _mm256_stream_si256(reinterpret_cast<__m256i *>(dest + i + 64), c);
+    _mm256_stream_si256(reinterpret_cast<__m256i *>(dest + i + 96), d);
+  }
+  _mm256_zeroupper();
+}
+
+// Same as StreamAvx, with 16-byte SSE2 stores.
+void StreamSse2(char *dest, const char *src, size_t size) {
+  for (size_t i = 0; i < size; i += 64) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+    __m128i b =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + 16));
+    __m128i c =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + 32));
+    __m128i d =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + 48));
+    _mm_stream_si128(reinterpret_cast<__m128i *>(dest + i), a);
+    _mm_stream_si128(reinterpret_cast<__m128i *>(dest + i + 16), b);
+    _mm_stream_si128(reinterpret_cast<__m128i *>(dest + i + 32), c);
+    _mm_stream_si128(reinterpret_cast<__m128i *>(dest + i + 48), d);
+  }
+}
+
+void NonTemporalCopy(char *dest, const char *src, size_t size) {
+  static const bool avx_usable = AvxUsable();
+  const size_t alignment = avx_usable ? 32 : 16;
+  const size_t block = avx_usable ? 128 : 64;
+
+  // Copy the unaligned head and the tail that does not fill a block with
+  // regular stores, and stream the aligned blocks in between.
+  size_t head = (alignment - reinterpret_cast<uintptr_t>(dest) % alignment) %
+                alignment;
+  memcpy(dest, src, head);
+  size_t streamed = (size - head) / block * block;
+  if (avx_usable) {
+    StreamAvx(dest + head, src + head, streamed);
+  } else {
+    StreamSse2(dest + head, src + head, streamed);
+  }
+  memcpy(dest + head + streamed, src + head + streamed,
+         size - head - streamed);
+
+  // Non-temporal stores are weakly ordered.
+  _mm_sfence();
+}
+
+#endif  // defined(__x86_64__)
+
+}  // namespace
+
+void *BoundaryMemcpy(void *dest, const void *src, size_t size) {
+#if defined(__x86_64__)
+  if (size >= kNonTemporalCopyThreshold) {
+    NonTemporalCopy(static_cast<char *>(dest), static_cast<const char *>(src),
+                    size);
+    return dest;
+  }
+#endif
+  return memcpy(dest, src, size);
+}
+
+}  // namespace primitives
+}  // namespace asylo
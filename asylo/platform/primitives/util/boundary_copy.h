@@ -0,0 +1,43 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_PRIMITIVES_UTIL_BOUNDARY_COPY_H_
+#define ASYLO_PLATFORM_PRIMITIVES_UTIL_BOUNDARY_COPY_H_
+
+#include <cstddef>
+
+namespace asylo {
+namespace primitives {
+
+// Copies of at least this many bytes are made with non-temporal stores.
+constexpr size_t kNonTemporalCopyThreshold = 64 * 1024;
+
+// Copies |size| bytes from |src| to |dest|, which must not overlap, for a
+// transfer across the enclave boundary. The copying side is not expected to
+// read |dest| again, so copies of at least kNonTemporalCopyThreshold bytes are
+// made with non-temporal stores, which write around the cache instead of
+// evicting the working set of the enclave. The stores use AVX if both the CPU
+// and the enclave support it, and SSE2 otherwise. The stores are fenced before
+// returning, so |dest| can be handed to another thread right away. Returns
+// |dest|.
+void *BoundaryMemcpy(void *dest, const void *src, size_t size);
+
+}  // namespace primitives
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_PRIMITIVES_UTIL_BOUNDARY_COPY_H_
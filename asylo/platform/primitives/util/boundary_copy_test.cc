@@ -0,0 +1,84 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/primitives/util/boundary_copy.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace primitives {
+namespace {
+
+using ::testing::Eq;
+
+// Copies |size| bytes between buffers at the given offsets from a 64-byte
+// boundary, and verifies the copy and the bytes around it.
+void VerifyCopy(size_t size, size_t src_offset, size_t dest_offset) {
+  std::vector<uint8_t> src(size + 128);
+  std::vector<uint8_t> dest(size + 128, 0xaa);
+  for (size_t i = 0; i < src.size(); ++i) {
+    src[i] = static_cast<uint8_t>(i * 31 + 7);
+  }
+  uint8_t *src_start = src.data() + (64 - reinterpret_cast<uintptr_t>(
+                                              src.data()) % 64) % 64 +
+                       src_offset;
+  uint8_t *dest_start = dest.data() + (64 - reinterpret_cast<uintptr_t>(
+                                                dest.data()) % 64) % 64 +
+                        dest_offset;
+  ASSERT_LE(dest_start + size + 1, dest.data() + dest.size());
+
+  EXPECT_THAT(BoundaryMemcpy(dest_start, src_start, size), Eq(dest_start));
+  for (size_t i = 0; i < size; ++i) {
+    ASSERT_THAT(dest_start[i], Eq(src_start[i]))
+        << "size " << size << ", offsets " << src_offset << " and "
+        << dest_offset << ", byte " << i;
+  }
+  for (uint8_t *byte = dest.data(); byte < dest_start; ++byte) {
+    ASSERT_THAT(*byte, Eq(0xaa));
+  }
+  for (uint8_t *byte = dest_start + size; byte < dest.data() + dest.size();
+       ++byte) {
+    ASSERT_THAT(*byte, Eq(0xaa));
+  }
+}
+
+TEST(BoundaryCopyTest, CopiesSmallBuffers) {
+  for (size_t size : {0, 1, 15, 64, 4096}) {
+    VerifyCopy(size, 0, 0);
+    VerifyCopy(size, 3, 7);
+  }
+}
+
+TEST(BoundaryCopyTest, CopiesLargeBuffersAtAnyAlignment) {
+  for (size_t size :
+       {kNonTemporalCopyThreshold, kNonTemporalCopyThreshold + 1,
+        kNonTemporalCopyThreshold + 127, 3 * kNonTemporalCopyThreshold + 45}) {
+    for (size_t dest_offset : {0, 1, 16, 31, 32, 63}) {
+      VerifyCopy(size, 5, dest_offset);
+    }
+  }
+}
+
+}  // namespace
+}  // namespace primitives
+}  // namespace asylo
@@ -20,7 +20,7 @@
 
 #include <memory>
 
-#include "absl/types/optional.h"
+#include "absl/memory/memory.h"
 #include "asylo/platform/primitives/util/message.h"
 #include "asylo/util/status.h"
 #include "asylo/util/status_macros.h"
@@ -28,6 +28,8 @@
 namespace asylo {
 namespace primitives {
 
+constexpr uint64_t DispatchTable::kFlatSelectors;
+
 Status DispatchTable::RegisterExitHandler(uint64_t untrusted_selector,
                                           const ExitHandler &handler) {
   // Ensure no handler is installed for untrusted_selector.
@@ -36,10 +38,26 @@ Status DispatchTable::RegisterExitHandler(uint64_t untrusted_selector,
     return {error::GoogleError::ALREADY_EXISTS,
             "Invalid selector in RegisterExitHandler."};
   }
-  locked_exit_table->emplace(untrusted_selector, handler);
+  const ExitHandler *registered =
+      locked_exit_table
+          ->emplace(untrusted_selector, absl::make_unique<ExitHandler>(handler))
+          .first->second.get();
+  if (untrusted_selector < kFlatSelectors) {
+    flat_table_[untrusted_selector].store(registered,
+                                          std::memory_order_release);
+  }
   return Status::OkStatus();
 }
 
+const ExitHandler *DispatchTable::FindExitHandler(uint64_t untrusted_selector) {
+  if (untrusted_selector < kFlatSelectors) {
+    return flat_table_[untrusted_selector].load(std::memory_order_acquire);
+  }
+  auto locked_exit_table = exit_table_.ReaderLock();
+  auto it = locked_exit_table->find(untrusted_selector);
+  return it == locked_exit_table->end() ? nullptr : it->second.get();
+}
+
 Status DispatchTable::PerformUnknownExit(uint64_t untrusted_selector,
                                          MessageReader *input,
                                          MessageWriter *output,
@@ -51,19 +69,12 @@ Status DispatchTable::PerformUnknownExit(uint64_t untrusted_selector,
 Status DispatchTable::PerformExit(uint64_t untrusted_selector,
                                   MessageReader *input, MessageWriter *output,
                                   Client *client) {
-  absl::optional<ExitHandler> handler;
-  {
-    auto locked_exit_table = exit_table_.ReaderLock();
-    auto it = locked_exit_table->find(untrusted_selector);
-    if (it != locked_exit_table->end()) {
-      handler = it->second;
-    }
-  }
-  if (!handler.has_value()) {
+  const ExitHandler *handler = FindExitHandler(untrusted_selector);
+  if (!handler) {
     return PerformUnknownExit(untrusted_selector, input, output, client);
   }
-  return handler.value().callback(client->shared_from_this(),
-                                  handler.value().context, input, output);
+  return handler->callback(client->shared_from_this(), handler->context, input,
+                           output);
 }
 
 // Finds and invokes an exit handler, setting an error status on failure.
@@ -72,9 +83,9 @@ Status DispatchTable::InvokeExitHandler(uint64_t untrusted_selector,
                                         MessageWriter *output, Client *client) {
   if (exit_hook_factory_) {
     auto hook = exit_hook_factory_->CreateExitHook();
-    ASYLO_RETURN_IF_ERROR(hook->PreExit(untrusted_selector));
+    ASYLO_RETURN_IF_ERROR(hook->PreExit(untrusted_selector, input));
     return hook->PostExit(
-        PerformExit(untrusted_selector, input, output, client));
+        PerformExit(untrusted_selector, input, output, client), output);
   } else {
     return PerformExit(untrusted_selector, input, output, client);
   }
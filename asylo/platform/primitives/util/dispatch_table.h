@@ -19,6 +19,9 @@
 #ifndef ASYLO_PLATFORM_PRIMITIVES_UTIL_DISPATCH_TABLE_H_
 #define ASYLO_PLATFORM_PRIMITIVES_UTIL_DISPATCH_TABLE_H_
 
+#include <atomic>
+#include <cstdint>
+#include <memory>
 #include <unordered_map>
 
 #include "asylo/platform/primitives/untrusted_primitives.h"
@@ -31,6 +34,8 @@ namespace asylo {
 namespace primitives {
 
 // Implementation of ExitCallProvider based on dispatch table (thread safe).
+// Handlers of selectors below kFlatSelectors, which include every runtime
+// selector, are found without taking a lock.
 class DispatchTable : public Client::ExitCallProvider {
  public:
   // A hook class which gives users a callback mechanism to inspect
@@ -51,6 +56,18 @@ class DispatchTable : public Client::ExitCallProvider {
     // through and return it.
     virtual Status PostExit(Status result) = 0;
 
+    // Variants of PreExit and PostExit which additionally receive the input
+    // and output messages of the exit call, either of which may be null, for
+    // hooks which inspect the payload. By default they forward to the variants
+    // above.
+    virtual Status PreExit(uint64_t untrusted_selector,
+                           const MessageReader *input) {
+      return PreExit(untrusted_selector);
+    }
+    virtual Status PostExit(Status result, const MessageWriter *output) {
+      return PostExit(std::move(result));
+    }
+
     virtual ~ExitHook() = default;
   };
 
@@ -64,12 +81,15 @@ class DispatchTable : public Client::ExitCallProvider {
     virtual ~ExitHookFactory() = default;
   };
 
-  DispatchTable()
-      : exit_table_(std::unordered_map<uint64_t, ExitHandler>()),
-        exit_hook_factory_() {}
+  // Number of selectors, counting from zero, whose handlers are kept in a flat
+  // array.
+  static constexpr uint64_t kFlatSelectors = 256;
+
+  DispatchTable() : DispatchTable(/*exit_hook_factory=*/nullptr) {}
 
   explicit DispatchTable(std::unique_ptr<ExitHookFactory> exit_hook_factory)
-      : exit_table_(std::unordered_map<uint64_t, ExitHandler>()),
+      : flat_table_(),
+        exit_table_(ExitTable()),
         exit_hook_factory_(std::move(exit_hook_factory)) {}
 
   // Registers a callback as the handler routine for an enclave exit point
@@ -96,10 +116,22 @@ class DispatchTable : public Client::ExitCallProvider {
                                     MessageReader *input, MessageWriter *output,
                                     Client *client);
 
+  // Returns the handler registered for |untrusted_selector|, or nullptr.
+  const ExitHandler *FindExitHandler(uint64_t untrusted_selector);
+
   // DispatchTable is used in trusted primitives layer where system calls might
   // not be available; avoid using absl based containers which may perform
   // system calls.
-  MutexGuarded<std::unordered_map<uint64_t, ExitHandler>> exit_table_;
+  using ExitTable =
+      std::unordered_map<uint64_t, std::unique_ptr<const ExitHandler>>;
+
+  // The handlers of selectors below kFlatSelectors, each published once with
+  // release semantics after it is added to |exit_table_|.
+  std::atomic<const ExitHandler *> flat_table_[kFlatSelectors];
+
+  // All registered handlers. Handlers are never removed, so pointers to them
+  // stay valid for the lifetime of the table.
+  MutexGuarded<ExitTable> exit_table_;
   const std::unique_ptr<ExitHookFactory> exit_hook_factory_;
 };
 
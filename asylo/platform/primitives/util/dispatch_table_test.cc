@@ -110,6 +110,38 @@ TEST(DispatchTableTest, HandlersInvocation) {
               StatusIs(error::GoogleError::OUT_OF_RANGE));
 }
 
+TEST(DispatchTableTest, HandlersBeyondFlatTable) {
+  const auto client = std::make_shared<MockedEnclaveClient>();
+  const uint64_t kLastFlat = DispatchTable::kFlatSelectors - 1;
+  const uint64_t kFirstMapped = DispatchTable::kFlatSelectors;
+  const uint64_t kLargest = UINT64_MAX;
+  MockedEnclaveClient::MockExitHandlerCallback callbacks[3];
+  for (auto &callback : callbacks) {
+    EXPECT_CALL(callback, Call(Eq(client), _, _, _)).Times(1);
+  }
+  MessageWriter out;
+  EXPECT_THAT(client->exit_call_provider()->InvokeExitHandler(
+                  kFirstMapped, nullptr, &out, client.get()),
+              StatusIs(error::GoogleError::OUT_OF_RANGE));
+  ASSERT_THAT(client->exit_call_provider()->RegisterExitHandler(
+                  kLastFlat, ExitHandler{callbacks[0].AsStdFunction()}),
+              IsOk());
+  ASSERT_THAT(client->exit_call_provider()->RegisterExitHandler(
+                  kFirstMapped, ExitHandler{callbacks[1].AsStdFunction()}),
+              IsOk());
+  ASSERT_THAT(client->exit_call_provider()->RegisterExitHandler(
+                  kLargest, ExitHandler{callbacks[2].AsStdFunction()}),
+              IsOk());
+  EXPECT_THAT(client->exit_call_provider()->RegisterExitHandler(
+                  kFirstMapped, ExitHandler{callbacks[1].AsStdFunction()}),
+              StatusIs(error::GoogleError::ALREADY_EXISTS));
+  for (uint64_t selector : {kLastFlat, kFirstMapped, kLargest}) {
+    EXPECT_THAT(client->exit_call_provider()->InvokeExitHandler(
+                    selector, nullptr, &out, client.get()),
+                IsOk());
+  }
+}
+
 TEST(DispatchTableTest, HandlersInMultipleThreads) {
   const size_t kThreads = 64;
   const size_t kCount = 256;
@@ -0,0 +1,76 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_PRIMITIVES_UTIL_ENTRY_THREAD_POOL_H_
+#define ASYLO_PLATFORM_PRIMITIVES_UTIL_ENTRY_THREAD_POOL_H_
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "asylo/util/thread.h"
+
+namespace asylo {
+namespace primitives {
+
+// A fixed set of host threads that run enclave calls on behalf of callers that
+// do not want to block on them.
+//
+// Tasks are run in the order they are scheduled, by whichever thread is free
+// first. The destructor runs every task already scheduled before joining the
+// threads. EntryThreadPool is thread-safe.
+class EntryThreadPool {
+ public:
+  using Task = std::function<void()>;
+
+  // Starts |num_threads| threads, at least one.
+  explicit EntryThreadPool(size_t num_threads);
+
+  EntryThreadPool(const EntryThreadPool &other) = delete;
+  EntryThreadPool &operator=(const EntryThreadPool &other) = delete;
+
+  // Runs the remaining tasks and joins the threads.
+  ~EntryThreadPool();
+
+  // Queues |task| to run on one of the threads of the pool.
+  void Schedule(Task task) ABSL_LOCKS_EXCLUDED(mu_);
+
+  size_t num_threads() const { return threads_.size(); }
+
+ private:
+  // Body of each thread of the pool.
+  void Run() ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns true if a thread has a task to run or must exit.
+  bool HasWork() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  absl::Mutex mu_;
+  std::deque<Task> tasks_ ABSL_GUARDED_BY(mu_);
+  bool stopping_ ABSL_GUARDED_BY(mu_) = false;
+
+  std::vector<std::unique_ptr<Thread>> threads_;
+};
+
+}  // namespace primitives
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_PRIMITIVES_UTIL_ENTRY_THREAD_POOL_H_
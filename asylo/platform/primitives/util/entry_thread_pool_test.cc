@@ -0,0 +1,88 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/primitives/util/entry_thread_pool.h"
+
+#include <atomic>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+
+namespace asylo {
+namespace primitives {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+
+TEST(EntryThreadPoolTest, StartsAtLeastOneThread) {
+  EntryThreadPool pool(/*num_threads=*/0);
+  EXPECT_THAT(pool.num_threads(), Eq(1));
+}
+
+TEST(EntryThreadPoolTest, SingleThreadRunsTasksInOrder) {
+  absl::Mutex mu;
+  std::vector<int> order;
+  {
+    EntryThreadPool pool(/*num_threads=*/1);
+    for (int i = 0; i < 4; ++i) {
+      pool.Schedule([&mu, &order, i] {
+        absl::MutexLock lock(&mu);
+        order.push_back(i);
+      });
+    }
+  }
+  EXPECT_THAT(order, ElementsAre(0, 1, 2, 3));
+}
+
+TEST(EntryThreadPoolTest, TasksRunConcurrently) {
+  // Every task blocks until all of them have started, which only completes if
+  // each one has a thread of its own.
+  constexpr int kThreads = 8;
+  std::atomic<int> started(0);
+  absl::Notification all_started;
+  EntryThreadPool pool(kThreads);
+  for (int i = 0; i < kThreads; ++i) {
+    pool.Schedule([&started, &all_started] {
+      if (started.fetch_add(1) + 1 == kThreads) {
+        all_started.Notify();
+      }
+      all_started.WaitForNotification();
+    });
+  }
+  all_started.WaitForNotification();
+  EXPECT_THAT(started.load(), Eq(kThreads));
+}
+
+TEST(EntryThreadPoolTest, DestructorRunsPendingTasks) {
+  std::atomic<int> completed(0);
+  {
+    EntryThreadPool pool(/*num_threads=*/2);
+    for (int i = 0; i < 100; ++i) {
+      pool.Schedule([&completed] { completed.fetch_add(1); });
+    }
+  }
+  EXPECT_THAT(completed.load(), Eq(100));
+}
+
+}  // namespace
+}  // namespace primitives
+}  // namespace asylo
@@ -0,0 +1,261 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/primitives/util/exit_profile.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+
+#include "absl/base/attributes.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "asylo/platform/primitives/util/dispatch_table.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+namespace primitives {
+namespace {
+
+// Number of distinct keys each thread can record before falling back to
+// kOverflowExitSelector.
+constexpr size_t kShardEntries = 128;
+
+std::atomic<uint64_t> next_profiler_id{1};
+
+// Adds |value| to a counter which only the calling thread writes to. A plain
+// load and store suffices and avoids a locked instruction on every exit.
+void AddToCounter(std::atomic<uint64_t> *counter, uint64_t value) {
+  counter->store(counter->load(std::memory_order_relaxed) + value,
+                 std::memory_order_relaxed);
+}
+
+}  // namespace
+
+// Counters written by a single thread and read by snapshots. Entries form an
+// open-addressed hash table; an entry is published by setting |used| after its
+// key is written and is never removed.
+class ExitProfiler::Shard {
+ public:
+  void Record(const ExitCallKey &key, absl::Duration latency, size_t bytes_in,
+              size_t bytes_out) {
+    Entry *entry = FindOrInsert(key);
+    AddToCounter(&entry->count, 1);
+    AddToCounter(&entry->bytes_in, bytes_in);
+    AddToCounter(&entry->bytes_out, bytes_out);
+    AddToCounter(&entry->total_latency_nanos,
+                 absl::ToInt64Nanoseconds(latency));
+    AddToCounter(&entry->latency_buckets[ExitLatencyBucket(latency)], 1);
+  }
+
+  void AddTo(ExitProfile *profile) const {
+    AddEntryTo(overflow_, profile);
+    for (const Entry &entry : entries_) {
+      AddEntryTo(entry, profile);
+    }
+  }
+
+ private:
+  struct Entry {
+    std::atomic<bool> used{false};
+    ExitCallKey key;
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> bytes_in{0};
+    std::atomic<uint64_t> bytes_out{0};
+    std::atomic<uint64_t> total_latency_nanos{0};
+    std::array<std::atomic<uint64_t>, kExitLatencyBuckets> latency_buckets{};
+  };
+
+  Entry *FindOrInsert(const ExitCallKey &key) {
+    size_t hash = std::hash<uint64_t>()(key.selector * 31 + key.sub_key);
+    for (size_t i = 0; i < kShardEntries; ++i) {
+      Entry *entry = &entries_[(hash + i) % kShardEntries];
+      if (!entry->used.load(std::memory_order_relaxed)) {
+        entry->key = key;
+        entry->used.store(true, std::memory_order_release);
+        return entry;
+      }
+      if (entry->key == key) {
+        return entry;
+      }
+    }
+    if (!overflow_.used.load(std::memory_order_relaxed)) {
+      overflow_.key = {kOverflowExitSelector, kUnclassifiedExit};
+      overflow_.used.store(true, std::memory_order_release);
+    }
+    return &overflow_;
+  }
+
+  static void AddEntryTo(const Entry &entry, ExitProfile *profile) {
+    if (!entry.used.load(std::memory_order_acquire)) {
+      return;
+    }
+    ExitCallStats &stats = (*profile)[entry.key];
+    stats.count += entry.count.load(std::memory_order_relaxed);
+    stats.bytes_in += entry.bytes_in.load(std::memory_order_relaxed);
+    stats.bytes_out += entry.bytes_out.load(std::memory_order_relaxed);
+    stats.total_latency_nanos +=
+        entry.total_latency_nanos.load(std::memory_order_relaxed);
+    for (int i = 0; i < kExitLatencyBuckets; ++i) {
+      stats.latency_buckets[i] +=
+          entry.latency_buckets[i].load(std::memory_order_relaxed);
+    }
+  }
+
+  std::array<Entry, kShardEntries> entries_;
+  Entry overflow_;
+};
+
+namespace {
+
+// Per-thread cache of the shard last used by the calling thread.
+struct ThreadShardCache {
+  uint64_t profiler_id;
+  void *shard;
+};
+
+ABSL_CONST_INIT thread_local ThreadShardCache thread_shard_cache = {0,
+                                                                    nullptr};
+
+// A hook which times a single exit call and records it into a profiler.
+class ExitProfileHook : public DispatchTable::ExitHook {
+ public:
+  explicit ExitProfileHook(ExitProfiler *profiler) : profiler_(profiler) {}
+
+  Status PreExit(uint64_t untrusted_selector) override {
+    return PreExit(untrusted_selector, nullptr);
+  }
+
+  Status PreExit(uint64_t untrusted_selector,
+                 const MessageReader *input) override {
+    key_ = {untrusted_selector,
+            profiler_->Classify(untrusted_selector, input)};
+    bytes_in_ = input ? input->MessageSize() : 0;
+    start_ = absl::Now();
+    return Status::OkStatus();
+  }
+
+  Status PostExit(Status result) override {
+    return PostExit(std::move(result), nullptr);
+  }
+
+  Status PostExit(Status result, const MessageWriter *output) override {
+    absl::Duration latency = absl::Now() - start_;
+    profiler_->Record(key_, latency, bytes_in_,
+                      output ? output->MessageSize() : 0);
+    return result;
+  }
+
+ private:
+  ExitProfiler *const profiler_;
+  ExitCallKey key_;
+  size_t bytes_in_;
+  absl::Time start_;
+};
+
+// A hook factory which will generate one hook object per exit call.
+class ExitProfileHookFactory : public DispatchTable::ExitHookFactory {
+ public:
+  explicit ExitProfileHookFactory(ExitProfiler *profiler)
+      : profiler_(profiler) {}
+
+  std::unique_ptr<DispatchTable::ExitHook> CreateExitHook() override {
+    return absl::make_unique<ExitProfileHook>(profiler_);
+  }
+
+ private:
+  ExitProfiler *const profiler_;
+};
+
+}  // namespace
+
+int ExitLatencyBucket(absl::Duration latency) {
+  int64_t nanos = absl::ToInt64Nanoseconds(latency);
+  if (nanos < 2) {
+    return 0;
+  }
+  int bucket = 63 - __builtin_clzll(static_cast<uint64_t>(nanos));
+  return bucket < kExitLatencyBuckets ? bucket : kExitLatencyBuckets - 1;
+}
+
+std::string FormatExitProfile(const ExitProfile &profile) {
+  std::string text =
+      "# selector sub_key count bytes_in bytes_out total_latency_ns\n";
+  for (const auto &entry : profile) {
+    absl::StrAppend(&text, entry.first.selector, " ", entry.first.sub_key, " ",
+                    entry.second.count, " ", entry.second.bytes_in, " ",
+                    entry.second.bytes_out, " ",
+                    entry.second.total_latency_nanos, "\n");
+  }
+  return text;
+}
+
+ExitProfiler::ExitProfiler(Classifier classifier)
+    : classifier_(std::move(classifier)), id_(next_profiler_id++) {}
+
+ExitProfiler::~ExitProfiler() = default;
+
+std::unique_ptr<DispatchTable::ExitHookFactory>
+ExitProfiler::CreateExitHookFactory() {
+  return absl::make_unique<ExitProfileHookFactory>(this);
+}
+
+int64_t ExitProfiler::Classify(uint64_t untrusted_selector,
+                               const MessageReader *input) const {
+  if (!classifier_ || !input) {
+    return kUnclassifiedExit;
+  }
+  return classifier_(untrusted_selector, *input);
+}
+
+void ExitProfiler::Record(const ExitCallKey &key, absl::Duration latency,
+                          size_t bytes_in, size_t bytes_out) {
+  GetThreadShard()->Record(key, latency, bytes_in, bytes_out);
+}
+
+ExitProfile ExitProfiler::Snapshot() const {
+  ExitProfile profile;
+  auto locked_shards = shards_.ReaderLock();
+  for (const auto &shard : *locked_shards) {
+    shard.second->AddTo(&profile);
+  }
+  return profile;
+}
+
+ExitProfiler::Shard *ExitProfiler::GetThreadShard() {
+  if (thread_shard_cache.profiler_id == id_) {
+    return static_cast<Shard *>(thread_shard_cache.shard);
+  }
+  auto locked_shards = shards_.Lock();
+  auto &shard = (*locked_shards)[std::this_thread::get_id()];
+  if (!shard) {
+    shard = absl::make_unique<Shard>();
+  }
+  thread_shard_cache = {id_, shard.get()};
+  return shard.get();
+}
+
+ProfilingDispatchTable::ProfilingDispatchTable(ExitProfiler *profiler)
+    : DispatchTable(profiler->CreateExitHookFactory()) {}
+
+}  // namespace primitives
+}  // namespace asylo
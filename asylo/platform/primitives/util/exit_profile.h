@@ -0,0 +1,148 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_PRIMITIVES_UTIL_EXIT_PROFILE_H_
+#define ASYLO_PLATFORM_PRIMITIVES_UTIL_EXIT_PROFILE_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+
+#include "absl/time/time.h"
+#include "asylo/platform/primitives/util/dispatch_table.h"
+#include "asylo/platform/primitives/util/message.h"
+#include "asylo/util/mutex_guarded.h"
+
+namespace asylo {
+namespace primitives {
+
+// Number of buckets in an exit call latency histogram. Bucket 0 counts calls
+// which took less than 2 nanoseconds and bucket i > 0 counts calls which took
+// [2^i, 2^(i+1)) nanoseconds. The last bucket also counts all slower calls.
+constexpr int kExitLatencyBuckets = 32;
+
+// Sub key of exit calls which were not classified.
+constexpr int64_t kUnclassifiedExit = -1;
+
+// Selector under which exit calls are accounted once a thread has recorded
+// more distinct keys than its counters can hold.
+constexpr uint64_t kOverflowExitSelector = UINT64_MAX;
+
+// Identifies a group of profiled exit calls: the exit selector together with an
+// optional sub key, such as the system call number of a system call host call.
+struct ExitCallKey {
+  uint64_t selector;
+  int64_t sub_key;
+
+  bool operator<(const ExitCallKey &other) const {
+    return std::tie(selector, sub_key) <
+           std::tie(other.selector, other.sub_key);
+  }
+  bool operator==(const ExitCallKey &other) const {
+    return selector == other.selector && sub_key == other.sub_key;
+  }
+};
+
+// Aggregated statistics for one ExitCallKey.
+struct ExitCallStats {
+  uint64_t count = 0;
+  uint64_t bytes_in = 0;
+  uint64_t bytes_out = 0;
+  uint64_t total_latency_nanos = 0;
+  std::array<uint64_t, kExitLatencyBuckets> latency_buckets{};
+};
+
+using ExitProfile = std::map<ExitCallKey, ExitCallStats>;
+
+// Returns the latency histogram bucket for a call which took |latency|.
+int ExitLatencyBucket(absl::Duration latency);
+
+// Returns |profile| as text, one line per key in the order of the keys. Each
+// line holds the selector, sub key, count, bytes in, bytes out and total
+// latency in nanoseconds of the key, separated by spaces. A leading line
+// starting with '#' names the columns.
+std::string FormatExitProfile(const ExitProfile &profile);
+
+// Collects call counts, byte volumes and latency histograms of exit calls.
+// Each thread records into counters only it writes to, so recording takes no
+// locks and issues no atomic read-modify-write instructions once a thread has
+// seen a key. Snapshots aggregate the counters of all threads and may be taken
+// concurrently with recording.
+class ExitProfiler {
+ public:
+  // Computes the sub key of an exit call from its selector and input, or
+  // returns kUnclassifiedExit. Must not advance |input|.
+  using Classifier = std::function<int64_t(uint64_t untrusted_selector,
+                                           const MessageReader &input)>;
+
+  explicit ExitProfiler(Classifier classifier = nullptr);
+  ~ExitProfiler();
+
+  ExitProfiler(const ExitProfiler &other) = delete;
+  ExitProfiler &operator=(const ExitProfiler &other) = delete;
+
+  // Returns a hook factory which records every exit call into this profiler,
+  // which must outlive it.
+  std::unique_ptr<DispatchTable::ExitHookFactory> CreateExitHookFactory();
+
+  // Returns the sub key of an exit call to |untrusted_selector| with |input|,
+  // which may be null.
+  int64_t Classify(uint64_t untrusted_selector,
+                   const MessageReader *input) const;
+
+  // Records a single exit call on behalf of the calling thread.
+  void Record(const ExitCallKey &key, absl::Duration latency, size_t bytes_in,
+              size_t bytes_out);
+
+  // Returns the statistics recorded so far by all threads.
+  ExitProfile Snapshot() const;
+
+ private:
+  class Shard;
+
+  // Returns the counters of the calling thread, creating them if needed.
+  Shard *GetThreadShard();
+
+  const Classifier classifier_;
+
+  // Distinguishes this profiler from any other in thread-local caches, even
+  // one allocated at the same address after this one is destroyed.
+  const uint64_t id_;
+
+  MutexGuarded<std::unordered_map<std::thread::id, std::unique_ptr<Shard>>>
+      shards_;
+};
+
+// A variation of DispatchTable which records every exit call into |profiler|,
+// which must outlive the table.
+class ProfilingDispatchTable : public DispatchTable {
+ public:
+  explicit ProfilingDispatchTable(ExitProfiler *profiler);
+};
+
+}  // namespace primitives
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_PRIMITIVES_UTIL_EXIT_PROFILE_H_
@@ -0,0 +1,203 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/primitives/util/exit_profile.h"
+
+#include <memory>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/memory/memory.h"
+#include "absl/time/time.h"
+#include "asylo/platform/primitives/untrusted_primitives.h"
+#include "asylo/platform/primitives/util/message.h"
+#include "asylo/test/util/status_matchers.h"
+#include "asylo/util/status.h"
+#include "asylo/util/thread.h"
+
+using ::testing::Eq;
+using ::testing::SizeIs;
+
+namespace asylo {
+namespace primitives {
+namespace {
+
+constexpr uint64_t kEchoSelector = 5;
+constexpr uint64_t kClassifiedSelector = 6;
+
+class MockedEnclaveClient : public Client {
+ public:
+  explicit MockedEnclaveClient(ExitProfiler *profiler)
+      : Client(
+            /*name=*/"mock_enclave",
+            absl::make_unique<ProfilingDispatchTable>(profiler)) {}
+
+  // Virtual methods not used in this test.
+  bool IsClosed() const override { return false; }
+  Status Destroy() override { return Status::OkStatus(); }
+  Status EnclaveCallInternal(uint64_t selector, MessageWriter *in,
+                             MessageReader *out) override {
+    return Status::OkStatus();
+  }
+};
+
+Status EchoHandler(std::shared_ptr<Client> client, void *context,
+                   MessageReader *input, MessageWriter *output) {
+  while (input->hasNext()) {
+    output->PushByCopy(input->next());
+  }
+  return Status::OkStatus();
+}
+
+// Builds a reader holding a single extent of |size| bytes.
+MessageReader MakeInput(size_t size) {
+  MessageWriter writer;
+  writer.PushByCopy(Extent{std::vector<char>(size).data(), size});
+  auto buffer = absl::make_unique<char[]>(writer.MessageSize());
+  writer.Serialize(buffer.get());
+  MessageReader reader;
+  reader.Deserialize(buffer.get(), writer.MessageSize());
+  return reader;
+}
+
+TEST(ExitProfileTest, LatencyBuckets) {
+  EXPECT_THAT(ExitLatencyBucket(absl::ZeroDuration()), Eq(0));
+  EXPECT_THAT(ExitLatencyBucket(absl::Nanoseconds(1)), Eq(0));
+  EXPECT_THAT(ExitLatencyBucket(absl::Nanoseconds(2)), Eq(1));
+  EXPECT_THAT(ExitLatencyBucket(absl::Nanoseconds(1023)), Eq(9));
+  EXPECT_THAT(ExitLatencyBucket(absl::Nanoseconds(1024)), Eq(10));
+  EXPECT_THAT(ExitLatencyBucket(absl::Hours(1)), Eq(kExitLatencyBuckets - 1));
+}
+
+TEST(ExitProfileTest, RecordsExitCalls) {
+  ExitProfiler profiler;
+  auto client = std::make_shared<MockedEnclaveClient>(&profiler);
+  ASSERT_THAT(client->exit_call_provider()->RegisterExitHandler(
+                  kEchoSelector, ExitHandler{EchoHandler}),
+              IsOk());
+
+  for (int i = 0; i < 3; ++i) {
+    MessageReader input = MakeInput(100);
+    MessageWriter output;
+    ASSERT_THAT(client->exit_call_provider()->InvokeExitHandler(
+                    kEchoSelector, &input, &output, client.get()),
+                IsOk());
+  }
+
+  ExitProfile profile = profiler.Snapshot();
+  ASSERT_THAT(profile, SizeIs(1));
+  const ExitCallStats &stats =
+      profile[ExitCallKey{kEchoSelector, kUnclassifiedExit}];
+  EXPECT_THAT(stats.count, Eq(3));
+  EXPECT_THAT(stats.bytes_in, Eq(3 * (100 + sizeof(uint64_t))));
+  EXPECT_THAT(stats.bytes_out, Eq(3 * (100 + sizeof(uint64_t))));
+  uint64_t histogram_total = 0;
+  for (uint64_t bucket : stats.latency_buckets) {
+    histogram_total += bucket;
+  }
+  EXPECT_THAT(histogram_total, Eq(3));
+}
+
+TEST(ExitProfileTest, ClassifiesExitCalls) {
+  ExitProfiler profiler(
+      [](uint64_t untrusted_selector, const MessageReader &input) -> int64_t {
+        if (untrusted_selector != kClassifiedSelector || !input.hasNext()) {
+          return kUnclassifiedExit;
+        }
+        return input.peek().size();
+      });
+  auto client = std::make_shared<MockedEnclaveClient>(&profiler);
+  ASSERT_THAT(client->exit_call_provider()->RegisterExitHandler(
+                  kClassifiedSelector, ExitHandler{EchoHandler}),
+              IsOk());
+
+  for (size_t size : {1, 2, 2}) {
+    MessageReader input = MakeInput(size);
+    MessageWriter output;
+    ASSERT_THAT(client->exit_call_provider()->InvokeExitHandler(
+                    kClassifiedSelector, &input, &output, client.get()),
+                IsOk());
+  }
+
+  ExitProfile profile = profiler.Snapshot();
+  ASSERT_THAT(profile, SizeIs(2));
+  EXPECT_THAT((profile[ExitCallKey{kClassifiedSelector, 1}].count), Eq(1));
+  EXPECT_THAT((profile[ExitCallKey{kClassifiedSelector, 2}].count), Eq(2));
+}
+
+TEST(ExitProfileTest, AggregatesThreads) {
+  constexpr int kThreads = 8;
+  constexpr int kCallsPerThread = 1000;
+  ExitProfiler profiler;
+  std::vector<Thread> threads;
+  for (int i = 0; i < kThreads; ++i) {
+    threads.emplace_back([&profiler, i] {
+      for (int j = 0; j < kCallsPerThread; ++j) {
+        profiler.Record({static_cast<uint64_t>(j % 2), kUnclassifiedExit},
+                        absl::Nanoseconds(i), 1, 2);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.Join();
+  }
+
+  ExitProfile profile = profiler.Snapshot();
+  ASSERT_THAT(profile, SizeIs(2));
+  for (uint64_t selector : {0, 1}) {
+    const ExitCallStats &stats = profile[ExitCallKey{selector, -1}];
+    EXPECT_THAT(stats.count, Eq(kThreads * kCallsPerThread / 2));
+    EXPECT_THAT(stats.bytes_in, Eq(kThreads * kCallsPerThread / 2));
+    EXPECT_THAT(stats.bytes_out, Eq(kThreads * kCallsPerThread));
+  }
+}
+
+TEST(ExitProfileTest, OverflowsIntoReservedSelector) {
+  ExitProfiler profiler;
+  for (uint64_t selector = 0; selector < 1000; ++selector) {
+    profiler.Record({selector, kUnclassifiedExit}, absl::Nanoseconds(1), 0, 0);
+  }
+
+  ExitProfile profile = profiler.Snapshot();
+  uint64_t total = 0;
+  for (const auto &entry : profile) {
+    total += entry.second.count;
+  }
+  EXPECT_THAT(total, Eq(1000));
+  EXPECT_THAT(
+      (profile[ExitCallKey{kOverflowExitSelector, kUnclassifiedExit}].count),
+      Eq(1000 - profile.size() + 1));
+}
+
+TEST(ExitProfileTest, FormatsProfile) {
+  ExitProfiler profiler;
+  profiler.Record({7, kUnclassifiedExit}, absl::Nanoseconds(10), 1, 2);
+  profiler.Record({7, kUnclassifiedExit}, absl::Nanoseconds(20), 3, 4);
+  profiler.Record({3, 42}, absl::Nanoseconds(5), 6, 0);
+
+  EXPECT_THAT(
+      FormatExitProfile(profiler.Snapshot()),
+      Eq("# selector sub_key count bytes_in bytes_out total_latency_ns\n"
+         "3 42 1 6 0 5\n"
+         "7 -1 2 4 6 30\n"));
+}
+
+}  // namespace
+}  // namespace primitives
+}  // namespace asylo
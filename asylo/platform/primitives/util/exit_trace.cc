@@ -0,0 +1,266 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/primitives/util/exit_trace.h"
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <google/protobuf/io/coded_stream.h>
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "asylo/util/status_macros.h"
+
+namespace asylo {
+namespace primitives {
+namespace {
+
+// Maximum length of the varint preceding each record.
+constexpr size_t kMaxSizeBytes = 5;
+
+// A hook which records a single exit call.
+class ExitTraceHook : public DispatchTable::ExitHook {
+ public:
+  explicit ExitTraceHook(ExitTraceRecorder *recorder) : recorder_(recorder) {}
+
+  Status PreExit(uint64_t untrusted_selector) override {
+    return PreExit(untrusted_selector, nullptr);
+  }
+
+  Status PreExit(uint64_t untrusted_selector,
+                 const MessageReader *input) override {
+    record_.set_selector(untrusted_selector);
+    if (input) {
+      input->Serialize([this](Extent extent) {
+        record_.add_input(static_cast<const char *>(extent.data()),
+                          extent.size());
+      });
+    }
+    start_ = absl::Now();
+    return Status::OkStatus();
+  }
+
+  Status PostExit(Status result) override {
+    return PostExit(std::move(result), nullptr);
+  }
+
+  Status PostExit(Status result, const MessageWriter *output) override {
+    absl::Time end = absl::Now();
+    record_.set_start_offset_ns(
+        absl::ToInt64Nanoseconds(recorder_->Offset(start_)));
+    record_.set_duration_ns(absl::ToInt64Nanoseconds(end - start_));
+    if (output) {
+      output->Serialize([this](Extent extent) {
+        record_.add_output(static_cast<const char *>(extent.data()),
+                           extent.size());
+      });
+    }
+    if (!result.ok()) {
+      result.SaveTo(record_.mutable_status());
+    }
+    recorder_->Record(&record_);
+    return result;
+  }
+
+ private:
+  ExitTraceRecorder *const recorder_;
+  ExitTraceRecord record_;
+  absl::Time start_;
+};
+
+// A hook factory which will generate one hook object per exit call.
+class ExitTraceHookFactory : public DispatchTable::ExitHookFactory {
+ public:
+  explicit ExitTraceHookFactory(ExitTraceRecorder *recorder)
+      : recorder_(recorder) {}
+
+  std::unique_ptr<DispatchTable::ExitHook> CreateExitHook() override {
+    return absl::make_unique<ExitTraceHook>(recorder_);
+  }
+
+ private:
+  ExitTraceRecorder *const recorder_;
+};
+
+// Returns whether the extents of |input| are |expected|.
+bool InputMatches(const MessageReader &input,
+                  const google::protobuf::RepeatedPtrField<std::string>
+                      &expected) {
+  int index = 0;
+  bool matches = true;
+  input.Serialize([&](Extent extent) {
+    matches = matches && index < expected.size() &&
+              expected.Get(index).size() == extent.size() &&
+              memcmp(expected.Get(index).data(), extent.data(),
+                     extent.size()) == 0;
+    ++index;
+  });
+  return matches && index == expected.size();
+}
+
+}  // namespace
+
+ExitTraceRecorder::ExitTraceRecorder(std::ostream *output)
+    : start_(absl::Now()), trace_(Trace{output, {}}) {}
+
+std::unique_ptr<DispatchTable::ExitHookFactory>
+ExitTraceRecorder::CreateExitHookFactory() {
+  return absl::make_unique<ExitTraceHookFactory>(this);
+}
+
+void ExitTraceRecorder::Record(ExitTraceRecord *record) {
+  auto trace = trace_.Lock();
+  auto thread =
+      trace->threads.emplace(std::this_thread::get_id(), trace->threads.size());
+  record->set_thread(thread.first->second);
+
+  std::string serialized = record->SerializeAsString();
+  uint8_t size[kMaxSizeBytes];
+  uint8_t *size_end =
+      google::protobuf::io::CodedOutputStream::WriteVarint32ToArray(
+          serialized.size(), size);
+  trace->output->write(reinterpret_cast<const char *>(size), size_end - size);
+  trace->output->write(serialized.data(), serialized.size());
+}
+
+Status ExitTraceRecorder::status() const {
+  if (!trace_.ReaderLock()->output->good()) {
+    return Status(error::GoogleError::INTERNAL,
+                  "Failed to write the exit trace");
+  }
+  return Status::OkStatus();
+}
+
+RecordingDispatchTable::RecordingDispatchTable(ExitTraceRecorder *recorder)
+    : DispatchTable(recorder->CreateExitHookFactory()) {}
+
+StatusOr<std::vector<ExitTraceRecord>> ParseExitTrace(
+    absl::string_view trace) {
+  std::vector<ExitTraceRecord> records;
+  while (!trace.empty()) {
+    // Decode the varint size of the next record.
+    uint64_t size = 0;
+    size_t length = 0;
+    bool more = true;
+    while (more && length < trace.size() && length < kMaxSizeBytes) {
+      uint8_t byte = trace[length];
+      size |= static_cast<uint64_t>(byte & 0x7f) << (7 * length);
+      more = byte & 0x80;
+      ++length;
+    }
+    if (more || size > trace.size() - length) {
+      return Status(error::GoogleError::INVALID_ARGUMENT,
+                    absl::StrCat("Truncated exit trace record ",
+                                 records.size()));
+    }
+    trace.remove_prefix(length);
+    records.emplace_back();
+    if (!records.back().ParseFromArray(trace.data(), size)) {
+      return Status(error::GoogleError::INVALID_ARGUMENT,
+                    absl::StrCat("Malformed exit trace record ",
+                                 records.size() - 1));
+    }
+    trace.remove_prefix(size);
+  }
+  return records;
+}
+
+ReplayDispatchTable::ReplayDispatchTable(std::vector<ExitTraceRecord> records,
+                                         ExitReplayOptions options)
+    : records_(std::move(records)),
+      options_(std::move(options)),
+      replay_(Replay{{}, {}, records_.size()}) {
+  auto replay = replay_.Lock();
+  for (size_t i = 0; i < records_.size(); ++i) {
+    uint32_t thread = records_[i].thread();
+    if (thread >= replay->pending.size()) {
+      replay->pending.resize(thread + 1);
+    }
+    replay->pending[thread].push_back(i);
+  }
+}
+
+StatusOr<const ExitTraceRecord *> ReplayDispatchTable::NextRecord() {
+  auto replay = replay_.Lock();
+  auto thread = replay->threads.emplace(std::this_thread::get_id(),
+                                        replay->threads.size());
+  size_t recorded_thread = thread.first->second;
+  if (recorded_thread >= replay->pending.size() ||
+      replay->pending[recorded_thread].empty()) {
+    return Status(error::GoogleError::OUT_OF_RANGE,
+                  absl::StrCat("Exit trace has no more calls for thread ",
+                               recorded_thread));
+  }
+  size_t index = replay->pending[recorded_thread].front();
+  replay->pending[recorded_thread].pop_front();
+  --replay->remaining;
+  return &records_[index];
+}
+
+Status ReplayDispatchTable::InvokeExitHandler(uint64_t untrusted_selector,
+                                              MessageReader *input,
+                                              MessageWriter *output,
+                                              Client *client) {
+  const ExitTraceRecord *record;
+  ASYLO_ASSIGN_OR_RETURN(record, NextRecord());
+  if (record->selector() != untrusted_selector) {
+    return Status(error::GoogleError::FAILED_PRECONDITION,
+                  absl::StrCat("Exit call to selector ", untrusted_selector,
+                               " diverged from the trace, which expected "
+                               "selector ",
+                               record->selector()));
+  }
+  if (options_.passthrough_selectors.contains(untrusted_selector)) {
+    return DispatchTable::InvokeExitHandler(untrusted_selector, input, output,
+                                            client);
+  }
+  if (options_.verify_inputs && input &&
+      !InputMatches(*input, record->input())) {
+    return Status(error::GoogleError::FAILED_PRECONDITION,
+                  absl::StrCat("Input of exit call to selector ",
+                               untrusted_selector,
+                               " differs from the trace"));
+  }
+
+  const absl::Time deadline =
+      absl::Now() + absl::Nanoseconds(record->duration_ns());
+  if (output) {
+    for (const std::string &extent : record->output()) {
+      output->PushByCopy(Extent{extent.data(), extent.size()});
+    }
+  }
+  if (options_.replay_latency) {
+    absl::SleepFor(deadline - absl::Now());
+  }
+  Status status;
+  if (record->has_status()) {
+    status.RestoreFrom(record->status());
+  }
+  return status;
+}
+
+size_t ReplayDispatchTable::remaining() const {
+  return replay_.ReaderLock()->remaining;
+}
+
+}  // namespace primitives
+}  // namespace asylo
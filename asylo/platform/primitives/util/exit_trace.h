@@ -0,0 +1,153 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_PRIMITIVES_UTIL_EXIT_TRACE_H_
+#define ASYLO_PLATFORM_PRIMITIVES_UTIL_EXIT_TRACE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "asylo/platform/primitives/util/dispatch_table.h"
+#include "asylo/platform/primitives/util/exit_trace.pb.h"
+#include "asylo/platform/primitives/util/message.h"
+#include "asylo/util/mutex_guarded.h"
+#include "asylo/util/status.h"
+#include "asylo/util/statusor.h"
+
+namespace asylo {
+namespace primitives {
+
+// Record and replay of the exit calls of an enclave. A RecordingDispatchTable
+// writes every exit call, with its input and output messages, its status and
+// its timing, to a trace. A ReplayDispatchTable then answers the exit calls of
+// another run of the same enclave from the trace instead of calling the host,
+// so that marshalling, dispatch and trusted code can be measured without the
+// noise of the network and disks the recorded run used. For instance, a
+// benchmark passes a ReplayDispatchTable as the exit call provider of
+// TestBackend::LoadTestEnclaveOrDie().
+//
+// A trace is a sequence of ExitTraceRecord messages, each preceded by its size
+// as a varint.
+
+// Writes exit calls to a trace.
+class ExitTraceRecorder {
+ public:
+  // Writes the trace to |output|, which must outlive the recorder.
+  explicit ExitTraceRecorder(std::ostream *output);
+
+  ExitTraceRecorder(const ExitTraceRecorder &other) = delete;
+  ExitTraceRecorder &operator=(const ExitTraceRecorder &other) = delete;
+
+  // Returns a hook factory which records every exit call into this recorder,
+  // which must outlive it.
+  std::unique_ptr<DispatchTable::ExitHookFactory> CreateExitHookFactory();
+
+  // Returns the offset of |time| from the start of the recording.
+  absl::Duration Offset(absl::Time time) const { return time - start_; }
+
+  // Sets the thread of |record| to the calling thread and appends |record| to
+  // the trace.
+  void Record(ExitTraceRecord *record);
+
+  // Returns an error if writing the trace failed.
+  Status status() const;
+
+ private:
+  struct Trace {
+    std::ostream *output;
+    absl::flat_hash_map<std::thread::id, uint32_t> threads;
+  };
+
+  const absl::Time start_;
+  MutexGuarded<Trace> trace_;
+};
+
+// A variation of DispatchTable which records every exit call into |recorder|,
+// which must outlive the table.
+class RecordingDispatchTable : public DispatchTable {
+ public:
+  explicit RecordingDispatchTable(ExitTraceRecorder *recorder);
+};
+
+// Parses a trace written by an ExitTraceRecorder.
+StatusOr<std::vector<ExitTraceRecord>> ParseExitTrace(absl::string_view trace);
+
+struct ExitReplayOptions {
+  // Whether each replayed call lasts at least as long as the recorded call,
+  // to reproduce the timing of the recorded run rather than to isolate the
+  // trusted side.
+  bool replay_latency = false;
+
+  // Whether the inputs of replayed calls must match the recorded inputs.
+  // Inputs holding pointers, times or random data differ between runs.
+  bool verify_inputs = false;
+
+  // Selectors whose calls are made to the registered handlers instead of being
+  // replayed, such as allocations of untrusted memory, whose recorded results
+  // are addresses in the recorded process. Their records are still consumed.
+  absl::flat_hash_set<uint64_t> passthrough_selectors;
+};
+
+// A variation of DispatchTable which answers exit calls from a recorded trace.
+// The threads of the replaying process are matched to the threads of the trace
+// in the order in which they make their first exit call, and each thread
+// replays the calls of its recorded thread in order. A call which does not
+// match the next recorded call of its thread fails with FAILED_PRECONDITION,
+// and calls past the end of the trace fail with OUT_OF_RANGE.
+class ReplayDispatchTable : public DispatchTable {
+ public:
+  explicit ReplayDispatchTable(std::vector<ExitTraceRecord> records,
+                               ExitReplayOptions options = {});
+
+  Status InvokeExitHandler(uint64_t untrusted_selector, MessageReader *input,
+                           MessageWriter *output,
+                           Client *client) override ASYLO_MUST_USE_RESULT;
+
+  // Returns the number of recorded calls not replayed yet.
+  size_t remaining() const;
+
+ private:
+  struct Replay {
+    // Indices of the records of each recorded thread not replayed yet.
+    std::vector<std::deque<size_t>> pending;
+    // The recorded thread of each replaying thread.
+    absl::flat_hash_map<std::thread::id, size_t> threads;
+    size_t remaining;
+  };
+
+  // Removes the next record of the calling thread and returns it.
+  StatusOr<const ExitTraceRecord *> NextRecord();
+
+  const std::vector<ExitTraceRecord> records_;
+  const ExitReplayOptions options_;
+  MutexGuarded<Replay> replay_;
+};
+
+}  // namespace primitives
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_PRIMITIVES_UTIL_EXIT_TRACE_H_
@@ -0,0 +1,276 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/primitives/util/exit_trace.h"
+
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/memory/memory.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "asylo/platform/primitives/untrusted_primitives.h"
+#include "asylo/platform/primitives/util/message.h"
+#include "asylo/test/util/status_matchers.h"
+#include "asylo/util/status.h"
+#include "asylo/util/thread.h"
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::Ge;
+using ::testing::SizeIs;
+
+namespace asylo {
+namespace primitives {
+namespace {
+
+constexpr uint64_t kEchoSelector = 5;
+constexpr uint64_t kFailingSelector = 6;
+constexpr uint64_t kCountingSelector = 7;
+
+class MockedEnclaveClient : public Client {
+ public:
+  explicit MockedEnclaveClient(std::unique_ptr<DispatchTable> dispatch_table)
+      : Client(/*name=*/"mock_enclave", std::move(dispatch_table)) {}
+
+  // Virtual methods not used in this test.
+  bool IsClosed() const override { return false; }
+  Status Destroy() override { return Status::OkStatus(); }
+  Status EnclaveCallInternal(uint64_t selector, MessageWriter *in,
+                             MessageReader *out) override {
+    return Status::OkStatus();
+  }
+};
+
+Status EchoHandler(std::shared_ptr<Client> client, void *context,
+                   MessageReader *input, MessageWriter *output) {
+  while (input->hasNext()) {
+    output->PushByCopy(input->next());
+  }
+  return Status::OkStatus();
+}
+
+Status FailingHandler(std::shared_ptr<Client> client, void *context,
+                      MessageReader *input, MessageWriter *output) {
+  return Status(error::GoogleError::UNAVAILABLE, "Host is down");
+}
+
+// Pushes the number of calls made so far, counted by the int at |context|.
+Status CountingHandler(std::shared_ptr<Client> client, void *context,
+                       MessageReader *input, MessageWriter *output) {
+  output->Push(++*static_cast<int *>(context));
+  return Status::OkStatus();
+}
+
+MessageReader MakeInput(const std::string &value) {
+  MessageWriter writer;
+  writer.PushString(value);
+  auto buffer = absl::make_unique<char[]>(writer.MessageSize());
+  writer.Serialize(buffer.get());
+  MessageReader reader;
+  reader.Deserialize(buffer.get(), writer.MessageSize());
+  return reader;
+}
+
+// Makes an exit call to |selector| with |value| as input and returns the
+// status and the first output extent, if any.
+Status Call(Client *client, uint64_t selector, const std::string &value,
+            std::string *output_value = nullptr) {
+  MessageReader input = MakeInput(value);
+  MessageWriter output;
+  Status status = client->exit_call_provider()->InvokeExitHandler(
+      selector, &input, &output, client);
+  if (output_value) {
+    output_value->clear();
+    output.Serialize([output_value](Extent extent) {
+      if (output_value->empty()) {
+        output_value->assign(static_cast<const char *>(extent.data()),
+                             extent.size());
+      }
+    });
+  }
+  return status;
+}
+
+class ExitTraceTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    recorder_ = absl::make_unique<ExitTraceRecorder>(&trace_);
+    recording_client_ = std::make_shared<MockedEnclaveClient>(
+        absl::make_unique<RecordingDispatchTable>(recorder_.get()));
+    ASSERT_THAT(recording_client_->exit_call_provider()->RegisterExitHandler(
+                    kEchoSelector, ExitHandler{EchoHandler}),
+                IsOk());
+    ASSERT_THAT(recording_client_->exit_call_provider()->RegisterExitHandler(
+                    kFailingSelector, ExitHandler{FailingHandler}),
+                IsOk());
+  }
+
+  std::vector<ExitTraceRecord> Records() {
+    EXPECT_THAT(recorder_->status(), IsOk());
+    auto records = ParseExitTrace(trace_.str());
+    EXPECT_THAT(records, IsOk());
+    return records.ok() ? records.ValueOrDie()
+                        : std::vector<ExitTraceRecord>();
+  }
+
+  std::shared_ptr<Client> ReplayClient(ExitReplayOptions options = {}) {
+    return std::make_shared<MockedEnclaveClient>(
+        absl::make_unique<ReplayDispatchTable>(Records(), std::move(options)));
+  }
+
+  std::stringstream trace_;
+  std::unique_ptr<ExitTraceRecorder> recorder_;
+  std::shared_ptr<Client> recording_client_;
+};
+
+TEST_F(ExitTraceTest, RecordsExitCalls) {
+  std::string output;
+  ASSERT_THAT(Call(recording_client_.get(), kEchoSelector, "hello", &output),
+              IsOk());
+  EXPECT_THAT(output, Eq(std::string("hello\0", 6)));
+  EXPECT_THAT(Call(recording_client_.get(), kFailingSelector, "world"),
+              StatusIs(error::GoogleError::UNAVAILABLE));
+
+  std::vector<ExitTraceRecord> records = Records();
+  ASSERT_THAT(records, SizeIs(2));
+  EXPECT_THAT(records[0].selector(), Eq(kEchoSelector));
+  EXPECT_THAT(records[0].thread(), Eq(0));
+  EXPECT_THAT(records[0].input(), ElementsAre(std::string("hello\0", 6)));
+  EXPECT_THAT(records[0].output(), ElementsAre(std::string("hello\0", 6)));
+  EXPECT_FALSE(records[0].has_status());
+  EXPECT_THAT(records[1].selector(), Eq(kFailingSelector));
+  EXPECT_THAT(records[1].output(), SizeIs(0));
+  EXPECT_TRUE(records[1].has_status());
+  EXPECT_THAT(records[1].start_offset_ns(), Ge(records[0].start_offset_ns()));
+}
+
+TEST_F(ExitTraceTest, ReplaysExitCallsWithoutHandlers) {
+  ASSERT_THAT(Call(recording_client_.get(), kEchoSelector, "hello"), IsOk());
+  ASSERT_THAT(Call(recording_client_.get(), kFailingSelector, "world"),
+              StatusIs(error::GoogleError::UNAVAILABLE));
+
+  std::shared_ptr<Client> client = ReplayClient();
+  std::string output;
+  // The input need not match unless verified.
+  EXPECT_THAT(Call(client.get(), kEchoSelector, "other", &output), IsOk());
+  EXPECT_THAT(output, Eq(std::string("hello\0", 6)));
+  EXPECT_THAT(Call(client.get(), kFailingSelector, "world"),
+              StatusIs(error::GoogleError::UNAVAILABLE, "Host is down"));
+  EXPECT_THAT(Call(client.get(), kEchoSelector, "hello"),
+              StatusIs(error::GoogleError::OUT_OF_RANGE));
+}
+
+TEST_F(ExitTraceTest, RejectsDivergingCalls) {
+  ASSERT_THAT(Call(recording_client_.get(), kEchoSelector, "hello"), IsOk());
+  ASSERT_THAT(Call(recording_client_.get(), kEchoSelector, "again"), IsOk());
+
+  ExitReplayOptions options;
+  options.verify_inputs = true;
+  std::shared_ptr<Client> client = ReplayClient(options);
+  EXPECT_THAT(Call(client.get(), kFailingSelector, "hello"),
+              StatusIs(error::GoogleError::FAILED_PRECONDITION));
+  EXPECT_THAT(Call(client.get(), kEchoSelector, "other"),
+              StatusIs(error::GoogleError::FAILED_PRECONDITION));
+  EXPECT_THAT(static_cast<ReplayDispatchTable *>(client->exit_call_provider())
+                  ->remaining(),
+              Eq(0));
+}
+
+TEST_F(ExitTraceTest, PassesThroughSelectedCalls) {
+  int recorded_calls = 0;
+  ASSERT_THAT(recording_client_->exit_call_provider()->RegisterExitHandler(
+                  kCountingSelector,
+                  ExitHandler{CountingHandler, &recorded_calls}),
+              IsOk());
+  ASSERT_THAT(Call(recording_client_.get(), kCountingSelector, ""), IsOk());
+  ASSERT_THAT(Call(recording_client_.get(), kCountingSelector, ""), IsOk());
+
+  ExitReplayOptions options;
+  options.passthrough_selectors.insert(kCountingSelector);
+  std::shared_ptr<Client> client = ReplayClient(options);
+  int replayed_calls = 10;
+  ASSERT_THAT(client->exit_call_provider()->RegisterExitHandler(
+                  kCountingSelector,
+                  ExitHandler{CountingHandler, &replayed_calls}),
+              IsOk());
+  EXPECT_THAT(Call(client.get(), kCountingSelector, ""), IsOk());
+  EXPECT_THAT(replayed_calls, Eq(11));
+  EXPECT_THAT(Call(client.get(), kCountingSelector, ""), IsOk());
+  EXPECT_THAT(Call(client.get(), kCountingSelector, ""),
+              StatusIs(error::GoogleError::OUT_OF_RANGE));
+  EXPECT_THAT(replayed_calls, Eq(12));
+}
+
+TEST_F(ExitTraceTest, ReplaysThreadsSeparately) {
+  ASSERT_THAT(Call(recording_client_.get(), kEchoSelector, "main"), IsOk());
+  Thread recording_thread([this] {
+    ASSERT_THAT(Call(recording_client_.get(), kFailingSelector, "thread"),
+                StatusIs(error::GoogleError::UNAVAILABLE));
+  });
+  recording_thread.Join();
+  ASSERT_THAT(Call(recording_client_.get(), kEchoSelector, "main again"),
+              IsOk());
+
+  // Each replaying thread gets the calls of the recorded thread which started
+  // in the same position, whatever the interleaving.
+  std::shared_ptr<Client> client = ReplayClient();
+  std::string output;
+  EXPECT_THAT(Call(client.get(), kEchoSelector, "", &output), IsOk());
+  EXPECT_THAT(output, Eq(std::string("main\0", 5)));
+  EXPECT_THAT(Call(client.get(), kEchoSelector, "", &output), IsOk());
+  EXPECT_THAT(output, Eq(std::string("main again\0", 11)));
+  Thread replaying_thread([&client] {
+    EXPECT_THAT(Call(client.get(), kFailingSelector, ""),
+                StatusIs(error::GoogleError::UNAVAILABLE));
+  });
+  replaying_thread.Join();
+}
+
+TEST_F(ExitTraceTest, ReplaysLatency) {
+  ExitTraceRecord record;
+  record.set_selector(kEchoSelector);
+  record.set_duration_ns(absl::ToInt64Nanoseconds(absl::Milliseconds(20)));
+  ExitReplayOptions options;
+  options.replay_latency = true;
+  auto client = std::make_shared<MockedEnclaveClient>(
+      absl::make_unique<ReplayDispatchTable>(
+          std::vector<ExitTraceRecord>{record}, options));
+
+  absl::Time start = absl::Now();
+  EXPECT_THAT(Call(client.get(), kEchoSelector, ""), IsOk());
+  EXPECT_THAT(absl::Now() - start, Ge(absl::Milliseconds(20)));
+}
+
+TEST(ExitTraceParseTest, RejectsMalformedTraces) {
+  EXPECT_THAT(ParseExitTrace(""), IsOkAndHolds(SizeIs(0)));
+  EXPECT_THAT(ParseExitTrace("\x05\x08"),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+  EXPECT_THAT(ParseExitTrace("\x80"),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+  EXPECT_THAT(ParseExitTrace(std::string("\x01\xff", 2)),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+}
+
+}  // namespace
+}  // namespace primitives
+}  // namespace asylo
@@ -0,0 +1,358 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/primitives/util/memory_checkpoint.h"
+
+#include <openssl/rand.h>
+#include <openssl/sha.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "asylo/crypto/aead_cryptor.h"
+#include "asylo/crypto/util/bssl_util.h"
+#include "asylo/crypto/util/byte_container_view.h"
+#include "asylo/crypto/util/trivial_object_util.h"
+#include "asylo/platform/primitives/util/memory_checkpoint.pb.h"
+#include "asylo/util/status.h"
+#include "asylo/util/status_macros.h"
+#include "asylo/util/statusor.h"
+
+namespace asylo {
+namespace primitives {
+namespace {
+
+constexpr size_t kChainIdSize = 16;
+
+// Returns the associated data that binds a sealed manifest or extent to its
+// chain and to its position in the chain. |chain_id| has a fixed size, so the
+// encoding is unambiguous.
+std::string CheckpointAssociatedData(absl::string_view chain_id,
+                                     uint64_t sequence,
+                                     absl::string_view purpose,
+                                     uint64_t index) {
+  return absl::StrCat(chain_id, ConvertTrivialObjectToBinaryString(sequence),
+                      purpose, ConvertTrivialObjectToBinaryString(index));
+}
+
+std::string ManifestAssociatedData(absl::string_view chain_id,
+                                   uint64_t sequence) {
+  return CheckpointAssociatedData(chain_id, sequence, "manifest", /*index=*/0);
+}
+
+std::string ExtentAssociatedData(absl::string_view chain_id, uint64_t sequence,
+                                 uint64_t index) {
+  return CheckpointAssociatedData(chain_id, sequence, "extent", index);
+}
+
+// Seals |plaintext| with |associated_data| into |sealed|.
+Status SealData(AeadCryptor *cryptor, ByteContainerView plaintext,
+                ByteContainerView associated_data,
+                MemoryCheckpointSealedData *sealed) {
+  std::vector<uint8_t> nonce(cryptor->NonceSize());
+  std::vector<uint8_t> ciphertext(plaintext.size() +
+                                  cryptor->MaxSealOverhead());
+  size_t ciphertext_size;
+  ASYLO_RETURN_IF_ERROR(cryptor->Seal(plaintext, associated_data,
+                                      absl::MakeSpan(nonce),
+                                      absl::MakeSpan(ciphertext),
+                                      &ciphertext_size));
+  sealed->set_nonce(nonce.data(), nonce.size());
+  sealed->set_ciphertext(ciphertext.data(), ciphertext_size);
+  return Status::OkStatus();
+}
+
+// Opens |sealed| with |associated_data| into |plaintext|, which must be filled
+// exactly.
+Status OpenData(AeadCryptor *cryptor, const MemoryCheckpointSealedData &sealed,
+                ByteContainerView associated_data,
+                absl::Span<uint8_t> plaintext) {
+  size_t plaintext_size;
+  ASYLO_RETURN_IF_ERROR(cryptor->Open(sealed.ciphertext(), associated_data,
+                                      sealed.nonce(), plaintext,
+                                      &plaintext_size));
+  if (plaintext_size != plaintext.size()) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  absl::StrCat("Checkpoint data has size ", plaintext_size,
+                               ", but ", plaintext.size(), " was expected"));
+  }
+  return Status::OkStatus();
+}
+
+// Compresses |data| with zlib into |compressed|. Returns false if |data| does
+// not get smaller.
+bool ZlibCompress(ByteContainerView data, std::vector<uint8_t> *compressed) {
+  uLongf compressed_size = compressBound(data.size());
+  compressed->resize(compressed_size);
+  if (compress2(compressed->data(), &compressed_size, data.data(), data.size(),
+                Z_BEST_SPEED) != Z_OK ||
+      compressed_size >= data.size()) {
+    return false;
+  }
+  compressed->resize(compressed_size);
+  return true;
+}
+
+// Decompresses |compressed| with zlib into |data|, which must be filled
+// exactly.
+Status ZlibDecompress(ByteContainerView compressed, absl::Span<uint8_t> data) {
+  uLongf data_size = data.size();
+  int result =
+      uncompress(data.data(), &data_size, compressed.data(), compressed.size());
+  if (result != Z_OK || data_size != data.size()) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  absl::StrCat("Failed to decompress checkpoint data: ",
+                               zError(result)));
+  }
+  return Status::OkStatus();
+}
+
+}  // namespace
+
+StatusOr<std::unique_ptr<MemoryCheckpointWriter>>
+MemoryCheckpointWriter::Create(ByteContainerView key,
+                               MemoryCheckpointCompression compression) {
+  if (!MemoryCheckpointCompression_IsValid(compression)) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Unknown checkpoint compression");
+  }
+  std::unique_ptr<AeadCryptor> cryptor;
+  ASYLO_ASSIGN_OR_RETURN(cryptor, AeadCryptor::CreateAesGcmSivCryptor(key));
+
+  std::string chain_id(kChainIdSize, '\0');
+  if (RAND_bytes(reinterpret_cast<uint8_t *>(&chain_id[0]), chain_id.size()) !=
+      1) {
+    return Status(error::GoogleError::INTERNAL,
+                  absl::StrCat("Failed to generate a checkpoint chain ID: ",
+                               BsslLastErrorString()));
+  }
+  return absl::WrapUnique(new MemoryCheckpointWriter(
+      std::move(cryptor), compression, std::move(chain_id)));
+}
+
+MemoryCheckpointWriter::MemoryCheckpointWriter(
+    std::unique_ptr<AeadCryptor> cryptor,
+    MemoryCheckpointCompression compression, std::string chain_id)
+    : cryptor_(std::move(cryptor)),
+      compression_(compression),
+      chain_id_(std::move(chain_id)) {}
+
+StatusOr<MemoryCheckpoint> MemoryCheckpointWriter::Checkpoint(
+    absl::Span<const ByteContainerView> regions) {
+  bool is_base = next_sequence_ == 0;
+  if (!is_base && regions.size() != page_digests_.size()) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  absl::StrCat("Expected ", page_digests_.size(),
+                               " regions, but got ", regions.size()));
+  }
+
+  // Extents are sealed as single messages, so they are limited to the largest
+  // whole number of pages that the cryptor can seal at once.
+  size_t max_extent_size = cryptor_->MaxMessageSize() /
+                           kMemoryCheckpointPageSize *
+                           kMemoryCheckpointPageSize;
+
+  MemoryCheckpointManifest manifest;
+  manifest.set_sequence(next_sequence_);
+  std::vector<std::vector<PageDigest>> page_digests(regions.size());
+  for (uint32_t region = 0; region < regions.size(); ++region) {
+    const ByteContainerView &memory = regions[region];
+    manifest.add_region_sizes(memory.size());
+
+    size_t num_pages = (memory.size() + kMemoryCheckpointPageSize - 1) /
+                       kMemoryCheckpointPageSize;
+    std::vector<PageDigest> &digests = page_digests[region];
+    digests.resize(num_pages);
+
+    // The extent that the current page extends, if the previous page changed
+    // as well.
+    MemoryCheckpointExtent *extent = nullptr;
+    for (size_t page = 0; page < num_pages; ++page) {
+      size_t offset = page * kMemoryCheckpointPageSize;
+      size_t size = std::min(kMemoryCheckpointPageSize, memory.size() - offset);
+      SHA256(memory.data() + offset, size, digests[page].data());
+
+      bool changed = is_base || page >= page_digests_[region].size() ||
+                     page_digests_[region][page] != digests[page];
+      if (!changed) {
+        extent = nullptr;
+        continue;
+      }
+      if (extent != nullptr && extent->size() + size <= max_extent_size) {
+        extent->set_size(extent->size() + size);
+      } else {
+        extent = manifest.add_extents();
+        extent->set_region(region);
+        extent->set_offset(offset);
+        extent->set_size(size);
+      }
+    }
+  }
+
+  MemoryCheckpoint checkpoint;
+  checkpoint.set_chain_id(chain_id_);
+  std::vector<uint8_t> compressed;
+  for (int i = 0; i < manifest.extents_size(); ++i) {
+    MemoryCheckpointExtent *extent = manifest.mutable_extents(i);
+    ByteContainerView plaintext(
+        regions[extent->region()].data() + extent->offset(), extent->size());
+    if (compression_ == MEMORY_CHECKPOINT_COMPRESSION_ZLIB &&
+        ZlibCompress(plaintext, &compressed)) {
+      extent->set_compression(MEMORY_CHECKPOINT_COMPRESSION_ZLIB);
+      plaintext = compressed;
+    }
+    ASYLO_RETURN_IF_ERROR(
+        SealData(cryptor_.get(), plaintext,
+                 ExtentAssociatedData(chain_id_, next_sequence_, i),
+                 checkpoint.add_sealed_extents()));
+  }
+
+  std::string serialized_manifest;
+  if (!manifest.SerializeToString(&serialized_manifest)) {
+    return Status(error::GoogleError::INTERNAL,
+                  "Failed to serialize checkpoint manifest");
+  }
+  ASYLO_RETURN_IF_ERROR(
+      SealData(cryptor_.get(), serialized_manifest,
+               ManifestAssociatedData(chain_id_, next_sequence_),
+               checkpoint.mutable_manifest()));
+
+  page_digests_ = std::move(page_digests);
+  ++next_sequence_;
+  return checkpoint;
+}
+
+StatusOr<std::unique_ptr<MemoryCheckpointReader>>
+MemoryCheckpointReader::Create(ByteContainerView key) {
+  std::unique_ptr<AeadCryptor> cryptor;
+  ASYLO_ASSIGN_OR_RETURN(cryptor, AeadCryptor::CreateAesGcmSivCryptor(key));
+  return absl::WrapUnique(new MemoryCheckpointReader(std::move(cryptor)));
+}
+
+MemoryCheckpointReader::MemoryCheckpointReader(
+    std::unique_ptr<AeadCryptor> cryptor)
+    : cryptor_(std::move(cryptor)) {}
+
+Status MemoryCheckpointReader::Apply(
+    const MemoryCheckpoint &checkpoint,
+    absl::Span<const absl::Span<uint8_t>> regions) {
+  if (checkpoint.chain_id().size() != kChainIdSize) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Checkpoint has an invalid chain ID");
+  }
+  if (!chain_id_.empty() && checkpoint.chain_id() != chain_id_) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Checkpoint belongs to a different chain");
+  }
+
+  // The manifest only opens with the associated data of the expected
+  // position, so checkpoints that are replayed, skipped or reordered are
+  // rejected here.
+  uint64_t sequence = chain_id_.empty() ? 0 : next_sequence_;
+  std::vector<uint8_t> serialized_manifest(
+      checkpoint.manifest().ciphertext().size());
+  size_t manifest_size;
+  ASYLO_RETURN_IF_ERROR(cryptor_->Open(
+      checkpoint.manifest().ciphertext(),
+      ManifestAssociatedData(checkpoint.chain_id(), sequence),
+      checkpoint.manifest().nonce(), absl::MakeSpan(serialized_manifest),
+      &manifest_size));
+  MemoryCheckpointManifest manifest;
+  if (!manifest.ParseFromArray(serialized_manifest.data(), manifest_size) ||
+      manifest.sequence() != sequence) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Checkpoint has an invalid manifest");
+  }
+
+  if (static_cast<size_t>(manifest.region_sizes_size()) != regions.size()) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  absl::StrCat("Checkpoint has ", manifest.region_sizes_size(),
+                               " regions, but ", regions.size(),
+                               " were given"));
+  }
+  for (int region = 0; region < manifest.region_sizes_size(); ++region) {
+    if (manifest.region_sizes(region) > regions[region].size()) {
+      return Status(error::GoogleError::INVALID_ARGUMENT,
+                    absl::StrCat("Region ", region, " is too small for the ",
+                                 manifest.region_sizes(region),
+                                 " checkpointed bytes"));
+    }
+  }
+  if (manifest.extents_size() != checkpoint.sealed_extents_size()) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Checkpoint does not match its manifest");
+  }
+  for (const MemoryCheckpointExtent &extent : manifest.extents()) {
+    if (extent.region() >= regions.size() ||
+        extent.offset() > manifest.region_sizes(extent.region()) ||
+        extent.size() >
+            manifest.region_sizes(extent.region()) - extent.offset()) {
+      return Status(error::GoogleError::INVALID_ARGUMENT,
+                    "Checkpoint extent is outside of its region");
+    }
+  }
+
+  // From here on, a failure leaves the regions partially restored, so the
+  // chain has to be restarted from its base checkpoint.
+  chain_id_.clear();
+  std::vector<uint8_t> compressed;
+  for (int i = 0; i < manifest.extents_size(); ++i) {
+    const MemoryCheckpointExtent &extent = manifest.extents(i);
+    const MemoryCheckpointSealedData &sealed = checkpoint.sealed_extents(i);
+    std::string associated_data =
+        ExtentAssociatedData(checkpoint.chain_id(), sequence, i);
+    absl::Span<uint8_t> destination =
+        regions[extent.region()].subspan(extent.offset(), extent.size());
+    switch (extent.compression()) {
+      case MEMORY_CHECKPOINT_COMPRESSION_NONE:
+        ASYLO_RETURN_IF_ERROR(
+            OpenData(cryptor_.get(), sealed, associated_data, destination));
+        break;
+      case MEMORY_CHECKPOINT_COMPRESSION_ZLIB: {
+        compressed.resize(sealed.ciphertext().size());
+        size_t compressed_size;
+        ASYLO_RETURN_IF_ERROR(cryptor_->Open(
+            sealed.ciphertext(), associated_data, sealed.nonce(),
+            absl::MakeSpan(compressed), &compressed_size));
+        ASYLO_RETURN_IF_ERROR(ZlibDecompress(
+            ByteContainerView(compressed.data(), compressed_size),
+            destination));
+        break;
+      }
+      default:
+        return Status(error::GoogleError::INVALID_ARGUMENT,
+                      "Checkpoint extent has an unknown compression");
+    }
+  }
+
+  chain_id_ = checkpoint.chain_id();
+  next_sequence_ = sequence + 1;
+  return Status::OkStatus();
+}
+
+}  // namespace primitives
+}  // namespace asylo
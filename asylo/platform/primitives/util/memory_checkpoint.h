@@ -0,0 +1,137 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_PRIMITIVES_UTIL_MEMORY_CHECKPOINT_H_
+#define ASYLO_PLATFORM_PRIMITIVES_UTIL_MEMORY_CHECKPOINT_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "asylo/crypto/aead_cryptor.h"
+#include "asylo/crypto/util/byte_container_view.h"
+#include "asylo/platform/primitives/util/memory_checkpoint.pb.h"
+#include "asylo/util/status.h"
+#include "asylo/util/statusor.h"
+
+namespace asylo {
+namespace primitives {
+
+// Granularity at which changes between checkpoints are tracked.
+constexpr size_t kMemoryCheckpointPageSize = 4096;
+
+// Takes a chain of encrypted checkpoints of a set of memory regions, such as
+// the data, bss and used heap of an enclave. The first checkpoint of a chain
+// holds the full contents of every region. Each later checkpoint holds only
+// the pages whose contents changed since the previous checkpoint, which are
+// found by comparing SHA-256 digests of every page.
+//
+// Checkpoints are sealed with AES-GCM-SIV, like fork snapshots. Each
+// checkpoint is bound to its chain and to its position in the chain, so a
+// MemoryCheckpointReader only accepts the checkpoints of one chain, in order.
+//
+// Extents can optionally be compressed before they are sealed. Extents that do
+// not get smaller are sealed uncompressed.
+//
+// A key can seal a limited number of extents. Once Checkpoint() fails because
+// the limit is reached, a new chain must be started with a new key.
+//
+// MemoryCheckpointWriter is not thread-safe. The checkpointed regions must not
+// change while Checkpoint() runs.
+class MemoryCheckpointWriter {
+ public:
+  // Creates a writer that starts a new chain of checkpoints sealed with the
+  // AES-GCM-SIV key |key|. Extents are compressed with |compression| before
+  // they are sealed.
+  static StatusOr<std::unique_ptr<MemoryCheckpointWriter>> Create(
+      ByteContainerView key, MemoryCheckpointCompression compression =
+                                 MEMORY_CHECKPOINT_COMPRESSION_NONE);
+
+  MemoryCheckpointWriter(const MemoryCheckpointWriter &other) = delete;
+  MemoryCheckpointWriter &operator=(const MemoryCheckpointWriter &other) =
+      delete;
+
+  // Takes the next checkpoint of |regions|. Every checkpoint of a chain must
+  // be given the same number of regions, but a region may grow or shrink
+  // between checkpoints. If taking the checkpoint fails, the next checkpoint
+  // holds every page that changed since the last successful one.
+  StatusOr<MemoryCheckpoint> Checkpoint(
+      absl::Span<const ByteContainerView> regions);
+
+ private:
+  using PageDigest = std::array<uint8_t, 32>;
+
+  MemoryCheckpointWriter(std::unique_ptr<AeadCryptor> cryptor,
+                         MemoryCheckpointCompression compression,
+                         std::string chain_id);
+
+  const std::unique_ptr<AeadCryptor> cryptor_;
+  const MemoryCheckpointCompression compression_;
+  const std::string chain_id_;
+  uint64_t next_sequence_ = 0;
+
+  // Digests of the pages of every region at the last successful checkpoint.
+  std::vector<std::vector<PageDigest>> page_digests_;
+};
+
+// Restores memory regions from a chain of checkpoints taken by a
+// MemoryCheckpointWriter. The base checkpoint is applied first, followed by
+// every later checkpoint of the same chain, in order.
+//
+// MemoryCheckpointReader is not thread-safe.
+class MemoryCheckpointReader {
+ public:
+  // Creates a reader for checkpoints sealed with the AES-GCM-SIV key |key|.
+  static StatusOr<std::unique_ptr<MemoryCheckpointReader>> Create(
+      ByteContainerView key);
+
+  MemoryCheckpointReader(const MemoryCheckpointReader &other) = delete;
+  MemoryCheckpointReader &operator=(const MemoryCheckpointReader &other) =
+      delete;
+
+  // Writes the contents of |checkpoint| to |regions|, which must be at least
+  // as large as the regions were when the checkpoint was taken. Only the
+  // checkpointed bytes of each region are written.
+  //
+  // If the reader has not applied a checkpoint yet, |checkpoint| must be the
+  // base checkpoint of a chain. Otherwise, it must be the next checkpoint of
+  // the chain that the reader was started with. If Apply() fails after it has
+  // started writing to |regions|, the regions are left in an unspecified state
+  // and the reader must be restarted from a base checkpoint.
+  Status Apply(const MemoryCheckpoint &checkpoint,
+               absl::Span<const absl::Span<uint8_t>> regions);
+
+ private:
+  explicit MemoryCheckpointReader(std::unique_ptr<AeadCryptor> cryptor);
+
+  const std::unique_ptr<AeadCryptor> cryptor_;
+
+  // Identifier of the chain being restored. Empty until a base checkpoint has
+  // been applied.
+  std::string chain_id_;
+  uint64_t next_sequence_ = 0;
+};
+
+}  // namespace primitives
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_PRIMITIVES_UTIL_MEMORY_CHECKPOINT_H_
@@ -0,0 +1,194 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/primitives/util/memory_checkpoint.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/types/span.h"
+#include "asylo/crypto/util/byte_container_view.h"
+#include "asylo/platform/primitives/util/memory_checkpoint.pb.h"
+#include "asylo/test/util/status_matchers.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+namespace primitives {
+namespace {
+
+using ::testing::Eq;
+using ::testing::Lt;
+using ::testing::Not;
+using ::testing::SizeIs;
+
+constexpr size_t kRegionPages = 16;
+
+class MemoryCheckpointTest : public ::testing::Test {
+ protected:
+  MemoryCheckpointTest()
+      : key_(32, 0x42),
+        data_(kRegionPages * kMemoryCheckpointPageSize, 0),
+        heap_(kRegionPages * kMemoryCheckpointPageSize, 0),
+        restored_data_(data_.size(), 0xff),
+        restored_heap_(heap_.size(), 0xff) {}
+
+  void SetUp() override {
+    ASYLO_ASSERT_OK_AND_ASSIGN(writer_, MemoryCheckpointWriter::Create(key_));
+    ASYLO_ASSERT_OK_AND_ASSIGN(reader_, MemoryCheckpointReader::Create(key_));
+    for (size_t i = 0; i < data_.size(); ++i) {
+      data_[i] = static_cast<uint8_t>(i);
+      heap_[i] = static_cast<uint8_t>(i * 7);
+    }
+  }
+
+  StatusOr<MemoryCheckpoint> TakeCheckpoint() {
+    std::vector<ByteContainerView> regions = {data_, heap_};
+    return writer_->Checkpoint(regions);
+  }
+
+  Status ApplyCheckpoint(const MemoryCheckpoint &checkpoint) {
+    std::vector<absl::Span<uint8_t>> regions = {
+        absl::MakeSpan(restored_data_), absl::MakeSpan(restored_heap_)};
+    return reader_->Apply(checkpoint, regions);
+  }
+
+  std::vector<uint8_t> key_;
+  std::vector<uint8_t> data_;
+  std::vector<uint8_t> heap_;
+  std::vector<uint8_t> restored_data_;
+  std::vector<uint8_t> restored_heap_;
+  std::unique_ptr<MemoryCheckpointWriter> writer_;
+  std::unique_ptr<MemoryCheckpointReader> reader_;
+};
+
+TEST_F(MemoryCheckpointTest, BaseAndDeltasRestoreTheRegions) {
+  MemoryCheckpoint base;
+  ASYLO_ASSERT_OK_AND_ASSIGN(base, TakeCheckpoint());
+  ASYLO_ASSERT_OK(ApplyCheckpoint(base));
+  EXPECT_THAT(restored_data_, Eq(data_));
+  EXPECT_THAT(restored_heap_, Eq(heap_));
+
+  data_[3 * kMemoryCheckpointPageSize] ^= 1;
+  heap_[10 * kMemoryCheckpointPageSize + 5] ^= 1;
+  MemoryCheckpoint delta;
+  ASYLO_ASSERT_OK_AND_ASSIGN(delta, TakeCheckpoint());
+  ASYLO_ASSERT_OK(ApplyCheckpoint(delta));
+  EXPECT_THAT(restored_data_, Eq(data_));
+  EXPECT_THAT(restored_heap_, Eq(heap_));
+}
+
+TEST_F(MemoryCheckpointTest, DeltasOnlyHoldChangedPages) {
+  MemoryCheckpoint base;
+  ASYLO_ASSERT_OK_AND_ASSIGN(base, TakeCheckpoint());
+  EXPECT_THAT(base.sealed_extents(), SizeIs(2));
+
+  MemoryCheckpoint unchanged;
+  ASYLO_ASSERT_OK_AND_ASSIGN(unchanged, TakeCheckpoint());
+  EXPECT_THAT(unchanged.sealed_extents(), SizeIs(0));
+
+  // Two adjacent pages and one separate page change.
+  heap_[2 * kMemoryCheckpointPageSize] ^= 1;
+  heap_[3 * kMemoryCheckpointPageSize] ^= 1;
+  heap_[8 * kMemoryCheckpointPageSize] ^= 1;
+  MemoryCheckpoint delta;
+  ASYLO_ASSERT_OK_AND_ASSIGN(delta, TakeCheckpoint());
+  EXPECT_THAT(delta.sealed_extents(), SizeIs(2));
+}
+
+TEST_F(MemoryCheckpointTest, ReaderRequiresChainOrder) {
+  MemoryCheckpoint base;
+  ASYLO_ASSERT_OK_AND_ASSIGN(base, TakeCheckpoint());
+  data_[0] ^= 1;
+  MemoryCheckpoint first;
+  ASYLO_ASSERT_OK_AND_ASSIGN(first, TakeCheckpoint());
+  data_[0] ^= 1;
+  MemoryCheckpoint second;
+  ASYLO_ASSERT_OK_AND_ASSIGN(second, TakeCheckpoint());
+
+  // A delta cannot be applied before the base.
+  EXPECT_THAT(ApplyCheckpoint(first), Not(IsOk()));
+
+  ASYLO_ASSERT_OK(ApplyCheckpoint(base));
+  EXPECT_THAT(ApplyCheckpoint(second), Not(IsOk()));
+  ASYLO_ASSERT_OK(ApplyCheckpoint(first));
+  EXPECT_THAT(ApplyCheckpoint(first), Not(IsOk()));
+  ASYLO_ASSERT_OK(ApplyCheckpoint(second));
+  EXPECT_THAT(restored_data_, Eq(data_));
+}
+
+TEST_F(MemoryCheckpointTest, DroppedExtentsAreDetected) {
+  MemoryCheckpoint base;
+  ASYLO_ASSERT_OK_AND_ASSIGN(base, TakeCheckpoint());
+  base.mutable_sealed_extents()->RemoveLast();
+  EXPECT_THAT(ApplyCheckpoint(base), Not(IsOk()));
+}
+
+TEST_F(MemoryCheckpointTest, WrongKeyIsRejected) {
+  MemoryCheckpoint base;
+  ASYLO_ASSERT_OK_AND_ASSIGN(base, TakeCheckpoint());
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      reader_, MemoryCheckpointReader::Create(std::vector<uint8_t>(32, 0x24)));
+  EXPECT_THAT(ApplyCheckpoint(base), Not(IsOk()));
+}
+
+TEST_F(MemoryCheckpointTest, GrownRegionsAreSavedInTheDelta) {
+  heap_.resize(4 * kMemoryCheckpointPageSize);
+  MemoryCheckpoint base;
+  ASYLO_ASSERT_OK_AND_ASSIGN(base, TakeCheckpoint());
+  ASYLO_ASSERT_OK(ApplyCheckpoint(base));
+
+  heap_.resize(6 * kMemoryCheckpointPageSize, 0x11);
+  MemoryCheckpoint delta;
+  ASYLO_ASSERT_OK_AND_ASSIGN(delta, TakeCheckpoint());
+  ASYLO_ASSERT_OK(ApplyCheckpoint(delta));
+  EXPECT_THAT(std::vector<uint8_t>(restored_heap_.begin(),
+                                   restored_heap_.begin() + heap_.size()),
+              Eq(heap_));
+}
+
+TEST_F(MemoryCheckpointTest, CompressedCheckpointsRestoreTheRegions) {
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      writer_, MemoryCheckpointWriter::Create(
+                   key_, MEMORY_CHECKPOINT_COMPRESSION_ZLIB));
+  std::fill(heap_.begin(), heap_.end(), 0);
+
+  MemoryCheckpoint base;
+  ASYLO_ASSERT_OK_AND_ASSIGN(base, TakeCheckpoint());
+  ASYLO_ASSERT_OK(ApplyCheckpoint(base));
+  EXPECT_THAT(restored_data_, Eq(data_));
+  EXPECT_THAT(restored_heap_, Eq(heap_));
+
+  // The zeroed heap is sealed in far fewer bytes than it holds.
+  ASSERT_THAT(base.sealed_extents(), SizeIs(2));
+  EXPECT_THAT(base.sealed_extents(1).ciphertext().size(),
+              Lt(heap_.size() / 16));
+
+  heap_[5 * kMemoryCheckpointPageSize] = 1;
+  MemoryCheckpoint delta;
+  ASYLO_ASSERT_OK_AND_ASSIGN(delta, TakeCheckpoint());
+  ASYLO_ASSERT_OK(ApplyCheckpoint(delta));
+  EXPECT_THAT(restored_heap_, Eq(heap_));
+}
+
+}  // namespace
+}  // namespace primitives
+}  // namespace asylo
@@ -34,6 +34,7 @@
 #include "absl/strings/str_cat.h"
 #include "asylo/platform/primitives/extent.h"
 #include "asylo/platform/primitives/primitive_status.h"
+#include "asylo/platform/primitives/util/boundary_copy.h"
 
 namespace asylo {
 namespace primitives {
@@ -50,10 +51,23 @@ namespace primitives {
 // from the writer is disallowed. The message writer does not perform memory
 // allocation for the serialized message. Extents can be pushed by reference or
 // by copy, in which case they are owned by the MessageWriter.
+//
+// A MessageWriter may instead be constructed over a caller-provided arena, in
+// which case every pushed extent is serialized into the arena as soon as it is
+// pushed, with no intermediate copy. Once all extents are pushed, the arena
+// holds the complete serialized message and can be handed across the enclave
+// boundary as is. Extents which no longer fit the arena are kept by the writer
+// as usual and the message has to be serialized with |Serialize()| instead.
 class MessageWriter {
  public:
   MessageWriter() = default;
 
+  // Constructs a MessageWriter serializing pushed extents directly into
+  // |arena|, which is owned by the caller, holds |capacity| bytes and must
+  // outlive the MessageWriter.
+  MessageWriter(void *arena, size_t capacity)
+      : arena_(reinterpret_cast<char *>(arena)), arena_capacity_(capacity) {}
+
   // Disallow copying.
   MessageWriter(const MessageWriter &other) = delete;
   MessageWriter operator=(const MessageWriter &other) = delete;
@@ -77,8 +91,17 @@ class MessageWriter {
     return result;
   }
 
+  // Returns the arena holding the complete serialized message if every extent
+  // pushed so far was serialized in place, or nullptr otherwise. The message
+  // spans MessageSize() bytes.
+  const void *SerializedInPlace() const {
+    return arena_overflowed_ ? nullptr : arena_;
+  }
+
   // Generates and writes a serialized message into |buffer| owned by
-  // the caller, which must accommodate at least MessageSize() bytes.
+  // the caller, which must accommodate at least MessageSize() bytes. |buffer|
+  // must not overlap the arena of this MessageWriter. Large extents are copied
+  // with BoundaryMemcpy, since |buffer| is meant to cross the enclave boundary.
   void Serialize(void *buffer) const {
     if (extents_.empty()) {
       return;
@@ -88,7 +111,7 @@ class MessageWriter {
       uint64_t size = extent.size();
       memcpy(ptr, &size, sizeof(uint64_t));  // Copy data size.
       ptr += sizeof(uint64_t);
-      memcpy(ptr, extent.data(), size);  // Copy data.
+      BoundaryMemcpy(ptr, extent.data(), size);  // Copy data.
       ptr += size;
     }
   }
@@ -100,16 +123,38 @@ class MessageWriter {
     }
   }
 
-  // Pushes an extent to the MessageWriter by reference.
-  void PushByReference(Extent extent) { extents_.emplace_back(extent); }
+  // Pushes an extent to the MessageWriter by reference. In arena mode the
+  // extent is copied into the arena instead, if it fits.
+  void PushByReference(Extent extent) {
+    if (!PushToArena(extent)) {
+      extents_.emplace_back(extent);
+    }
+  }
 
   // Pushes an extent to the MessageWriter by copy. Data is copied and owned by
-  // the MessageWriter.
+  // the MessageWriter, or serialized into the arena in arena mode.
   void PushByCopy(Extent extent) {
+    if (PushToArena(extent)) {
+      return;
+    }
     char *extent_data = new char[extent.size()];
     copied_data_owner_.emplace_back(extent_data);
     memcpy(extent_data, extent.data(), extent.size());
-    PushByReference(Extent{extent_data, extent.size()});
+    extents_.emplace_back(extent_data, extent.size());
+  }
+
+  // Pushes an extent of |size| bytes for the caller to fill in, and returns a
+  // pointer to its data. The data is owned by the MessageWriter, or lies in the
+  // arena in arena mode. This lets a caller serialize a payload directly into
+  // the message rather than into a temporary buffer pushed by copy.
+  char *Allocate(size_t size) {
+    char *extent_data = ReserveInArena(size);
+    if (!extent_data) {
+      extent_data = new char[size];
+      copied_data_owner_.emplace_back(extent_data);
+    }
+    extents_.emplace_back(extent_data, size);
+    return extent_data;
   }
 
   // Pushes non-pointer data types (eg. ints, structs) by value. Internally
@@ -171,13 +216,51 @@ class MessageWriter {
   }
 
  private:
+  // Serializes |extent| at the end of the arena and records the serialized
+  // copy. Returns false if there is no arena or |extent| does not fit, in which
+  // case this and all following extents are kept outside the arena.
+  bool PushToArena(Extent extent) {
+    char *ptr = ReserveInArena(extent.size());
+    if (!ptr) {
+      return false;
+    }
+    if (extent.size() > 0) {
+      BoundaryMemcpy(ptr, extent.data(), extent.size());
+    }
+    extents_.emplace_back(ptr, extent.size());
+    return true;
+  }
+
+  // Writes the size header of a |size|-byte extent to the arena and returns a
+  // pointer to the space reserved for its data, or nullptr if the writer is
+  // not in arena mode or the extent does not fit.
+  char *ReserveInArena(uint64_t size) {
+    if (!arena_ || arena_overflowed_) {
+      return nullptr;
+    }
+    if (arena_capacity_ - arena_used_ < sizeof(uint64_t) ||
+        arena_capacity_ - arena_used_ - sizeof(uint64_t) < size) {
+      arena_overflowed_ = true;
+      return nullptr;
+    }
+    char *ptr = arena_ + arena_used_;
+    memcpy(ptr, &size, sizeof(uint64_t));
+    arena_used_ += sizeof(uint64_t) + size;
+    return ptr + sizeof(uint64_t);
+  }
+
   std::vector<Extent> extents_;
   std::vector<std::unique_ptr<char[]>> copied_data_owner_;
+  char *arena_ = nullptr;
+  size_t arena_capacity_ = 0;
+  size_t arena_used_ = 0;
+  bool arena_overflowed_ = false;
 };
 
 // A message reader that consumes a serialized message and generates extents.
-// The extent memory is owned by the class and freed with the destructor.
-// Extents can be read from the MessageReader only once, and never written.
+// The extent memory is owned by the class and freed with the destructor, unless
+// the message was deserialized in place. Extents can be read from the
+// MessageReader only once, and never written.
 class MessageReader {
  public:
   MessageReader() = default;
@@ -206,29 +289,91 @@ class MessageReader {
       memcpy(&extent_len, ptr, sizeof(uint64_t));
       ptr += sizeof(uint64_t);
       char *extent_data = new char[extent_len];
-      extents_.emplace_back(std::unique_ptr<char[]>(extent_data), extent_len);
+      owned_data_.emplace_back(extent_data);
+      extents_.emplace_back(extent_data, extent_len);
       memcpy(extent_data, ptr, extent_len);
       ptr += extent_len;
     }
   }
 
+  // Deserializes a data buffer of provided size without copying it. The
+  // extents returned by the MessageReader point into |buffer|, which must
+  // outlive the MessageReader and must not be modified while it is in use.
+  // Trusted code must therefore never deserialize untrusted memory in place.
+  // Returns an error and leaves the MessageReader empty if |buffer| is not a
+  // well-formed message.
+  PrimitiveStatus DeserializeInPlace(const void *buffer, size_t size) {
+    const char *ptr = reinterpret_cast<const char *>(buffer);
+    size_t remaining = size;
+    while (remaining > 0) {
+      uint64_t extent_len;
+      if (remaining < sizeof(uint64_t)) {
+        extents_.clear();
+        return {error::GoogleError::INVALID_ARGUMENT,
+                "DeserializeInPlace: Truncated extent size."};
+      }
+      memcpy(&extent_len, ptr, sizeof(uint64_t));
+      ptr += sizeof(uint64_t);
+      remaining -= sizeof(uint64_t);
+      if (extent_len > remaining) {
+        extents_.clear();
+        return {error::GoogleError::INVALID_ARGUMENT,
+                "DeserializeInPlace: Extent exceeds the message size."};
+      }
+      extents_.emplace_back(const_cast<char *>(ptr), extent_len);
+      ptr += extent_len;
+      remaining -= extent_len;
+    }
+    return PrimitiveStatus::OkStatus();
+  }
+
   // Deserializes data using a given deserializer.
   void Deserialize(const size_t size,
                    const std::function<Extent(size_t i)> &deserializer) {
     extents_.reserve(size);
     for (size_t i = 0; i < size; ++i) {
       auto extent = deserializer(i);
-      extents_.emplace_back(absl::make_unique<char[]>(extent.size()),
-                            extent.size());
+      owned_data_.emplace_back(absl::make_unique<char[]>(extent.size()));
+      extents_.emplace_back(owned_data_.back().get(), extent.size());
       if (extent.size() > 0) {
-        memcpy(extents_.back().first.get(), extent.data(), extent.size());
+        memcpy(owned_data_.back().get(), extent.data(), extent.size());
       }
     }
   }
 
+  // Deserializes |items| without copying their contents: the MessageReader
+  // takes ownership of the strings, each of which becomes one extent. Useful
+  // when the extents arrive as separately allocated buffers, for example
+  // parsed protobuf fields, which can be swapped into |items| in O(1).
+  void Deserialize(std::vector<std::string> items) {
+    // Moving a vector keeps its buffer, so the strings never move once owned.
+    owned_strings_.emplace_back(std::move(items));
+    extents_.reserve(extents_.size() + owned_strings_.back().size());
+    for (auto &item : owned_strings_.back()) {
+      extents_.emplace_back(item.empty() ? nullptr : &item[0], item.size());
+    }
+  }
+
+  // Passes every extent of the message, including those already read, to
+  // |serializer|, without advancing the reader.
+  void Serialize(const std::function<void(Extent)> &serializer) const {
+    for (const auto &extent : extents_) {
+      serializer(extent);
+    }
+  }
+
   // Returns the number of extents read.
   size_t size() const { return extents_.size(); }
 
+  // Returns the size of the serialized message this reader was built from.
+  size_t MessageSize() const {
+    size_t result = sizeof(uint64_t) * extents_.size();
+    for (const auto &extent : extents_) {
+      result += extent.size();
+    }
+    return result;
+  }
+
   // Returns the next extent in the MessageReader. The MessageReader may only be
   // traversed once. The returned extent remains owned by the MessageReader and
   // its lifetime is the lifetime of the MessageReader.
@@ -249,9 +394,7 @@ class MessageReader {
   // Peeks at the next extent in the MessageReader; the ensuing next() call will
   // return the same extent. The extent remains owned by the MessageReader and
   // its lifetime is the lifetime of the MessageReader.
-  Extent peek() {
-    return Extent{extents_[pos_].first.get(), extents_[pos_].second};
-  }
+  Extent peek() const { return extents_[pos_]; }
 
   // Interprets the peek item in the MessageReader as a pointer to a value of
   // type T, consumes it, and returns its value by const reference.
@@ -267,6 +410,16 @@ class MessageReader {
   // Returns if the reader traversal has reached the end.
   bool hasNext() const { return pos_ != size(); }
 
+  // Removes the last extent, which must not have been read yet, from the
+  // message and returns it. Lets a receiver strip a trailer appended to a
+  // message before the message is handed on. The extent remains owned by the
+  // MessageReader and its lifetime is the lifetime of the MessageReader.
+  Extent TakeLast() {
+    Extent result = extents_.back();
+    extents_.pop_back();
+    return result;
+  }
+
 #define ASYLO_RETURN_IF_INCORRECT_READER_ARGUMENTS(reader, expected_args) \
   do {                                                                    \
     if ((reader).size() != expected_args) {                               \
@@ -302,7 +455,9 @@ class MessageReader {
   } while (false)
 
  private:
-  std::vector<std::pair<std::unique_ptr<char[]>, size_t>> extents_;
+  std::vector<Extent> extents_;
+  std::vector<std::unique_ptr<char[]>> owned_data_;
+  std::vector<std::vector<std::string>> owned_strings_;
   size_t pos_ = 0;
 };
 
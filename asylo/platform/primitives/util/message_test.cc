@@ -19,7 +19,11 @@
 #include "asylo/platform/primitives/util/message.h"
 
 #include <cstddef>
+#include <cstring>
 #include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
@@ -190,6 +194,112 @@ TEST(MessageTest, PushPopStrings) {
   EXPECT_THAT(reader.next().As<char>(), StrEq("moon"));
 }
 
+// Ensure an arena writer serializes extents in place and that the message can
+// be read back without copying.
+TEST(MessageTest, SerializeAndDeserializeInPlace) {
+  char arena[128];
+  MessageWriter writer(arena, sizeof(arena));
+  const char hello[] = "hello";
+  writer.PushByReference(Extent{hello, sizeof(hello)});
+  writer.Push<int>(42);
+  writer.PushString("world");
+  ASSERT_THAT(writer.SerializedInPlace(), Eq(arena));
+
+  MessageReader reader;
+  ASSERT_TRUE(reader.DeserializeInPlace(arena, writer.MessageSize()).ok());
+  ASSERT_THAT(reader, SizeIs(3));
+  Extent extent = reader.next();
+  EXPECT_THAT(extent.As<char>(), StrEq(hello));
+  EXPECT_THAT(extent.As<char>(), Eq(arena + sizeof(uint64_t)));
+  EXPECT_THAT(reader.next<int>(), Eq(42));
+  EXPECT_THAT(reader.next().As<char>(), StrEq("world"));
+}
+
+// Ensure extents which do not fit the arena are still serialized correctly.
+TEST(MessageTest, ArenaOverflowFallsBackToSerialize) {
+  char arena[16];
+  MessageWriter writer(arena, sizeof(arena));
+  writer.Push<int>(1);
+  writer.PushString(std::string(32, 'a'));
+  writer.Push<int>(2);
+  EXPECT_THAT(writer.SerializedInPlace(), Eq(nullptr));
+
+  MessageReader reader = BuildMessageReader(writer);
+  ASSERT_THAT(reader, SizeIs(3));
+  EXPECT_THAT(reader.next<int>(), Eq(1));
+  EXPECT_THAT(reader.next().As<char>(), StrEq(std::string(32, 'a')));
+  EXPECT_THAT(reader.next<int>(), Eq(2));
+}
+
+// Ensure extents allocated by the writer are filled in by the caller, both in
+// and out of arena mode.
+TEST(MessageTest, AllocatedExtentsAreSerialized) {
+  char arena[32];
+  MessageWriter writer(arena, sizeof(arena));
+  memcpy(writer.Allocate(6), "hello", 6);
+  EXPECT_THAT(writer.SerializedInPlace(), Eq(arena));
+  memset(writer.Allocate(32), 'a', 32);
+  EXPECT_THAT(writer.SerializedInPlace(), Eq(nullptr));
+
+  MessageReader reader = BuildMessageReader(writer);
+  ASSERT_THAT(reader, SizeIs(2));
+  EXPECT_THAT(reader.next().As<char>(), StrEq("hello"));
+  Extent extent = reader.next();
+  EXPECT_THAT(std::string(extent.As<char>(), extent.size()),
+              Eq(std::string(32, 'a')));
+}
+
+// Ensure malformed messages are rejected by DeserializeInPlace.
+TEST(MessageTest, DeserializeInPlaceRejectsTruncatedMessage) {
+  MessageWriter writer;
+  writer.PushString("hello");
+  const size_t size = writer.MessageSize();
+  const auto buffer = absl::make_unique<char[]>(size);
+  writer.Serialize(buffer.get());
+
+  MessageReader truncated_data;
+  EXPECT_FALSE(truncated_data.DeserializeInPlace(buffer.get(), size - 1).ok());
+  EXPECT_THAT(truncated_data, IsEmpty());
+
+  MessageReader truncated_size;
+  EXPECT_FALSE(truncated_size.DeserializeInPlace(buffer.get(), 4).ok());
+  EXPECT_THAT(truncated_size, IsEmpty());
+}
+
+// Ensure a reader built from strings adopts them instead of copying, and that
+// its extents survive moving the reader.
+TEST(MessageTest, DeserializeAdoptsStrings) {
+  std::vector<std::string> items;
+  items.emplace_back("short");
+  items.emplace_back(1024, 'x');
+  items.emplace_back();
+  const char *const long_data = items[1].data();
+
+  MessageReader reader;
+  reader.Deserialize(std::move(items));
+  MessageReader moved = std::move(reader);
+  ASSERT_THAT(moved, SizeIs(3));
+  EXPECT_THAT(moved.next().As<char>(), StrEq("short"));
+  Extent extent = moved.next();
+  EXPECT_THAT(extent.As<char>(), Eq(long_data));
+  EXPECT_THAT(extent.size(), Eq(1024));
+  EXPECT_THAT(moved.next().size(), Eq(0));
+}
+
+// Ensure a trailer taken off the end of a message leaves the rest readable.
+TEST(MessageTest, TakeLastStripsTrailer) {
+  MessageWriter writer;
+  writer.PushString("payload");
+  writer.Push<uint64_t>(42);
+  MessageReader reader = BuildMessageReader(writer);
+
+  Extent trailer = reader.TakeLast();
+  EXPECT_THAT(*trailer.As<uint64_t>(), Eq(42));
+  ASSERT_THAT(reader, SizeIs(1));
+  EXPECT_THAT(reader.next().As<char>(), StrEq("payload"));
+  EXPECT_FALSE(reader.hasNext());
+}
+
 }  // namespace
 }  // namespace primitives
 }  // namespace asylo
@@ -24,6 +24,10 @@ namespace asylo {
 namespace primitives {
 
 PrimitiveStatus MakePrimitiveStatus(const Status& status) {
+  if (status.ok() &&
+      status.error_space() == error::GoogleErrorSpace::GetInstance()) {
+    return PrimitiveStatus::OkStatus();
+  }
   if (status.error_space() != error::GoogleErrorSpace::GetInstance()) {
     std::string error_message = absl::StrCat(
         "Could not convert error space '", status.error_space()->SpaceName(),
@@ -38,6 +42,9 @@ PrimitiveStatus MakePrimitiveStatus(const Status& status) {
 }
 
 Status MakeStatus(const PrimitiveStatus& primitiveStatus) {
+  if (primitiveStatus.ok()) {
+    return Status::OkStatus();
+  }
   return Status{error::GoogleErrorSpace::GetInstance(),
                 primitiveStatus.error_code(), primitiveStatus.error_message()};
 }
@@ -25,7 +25,9 @@
 namespace asylo {
 namespace primitives {
 
-// Constructs a primitive status object from an Asylo status.
+// Constructs a primitive status object from an Asylo status. Neither this
+// function nor MakeStatus allocates for OK statuses or statuses with an error
+// code and no message.
 PrimitiveStatus MakePrimitiveStatus(const Status &status);
 
 // Constructs an Asylo status object from a primitive status.
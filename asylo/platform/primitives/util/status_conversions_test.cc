@@ -105,6 +105,22 @@ TEST_F(StatusConversionsTest, PrimitiveStatusTestForStatusNotInGoogleError) {
                   reference_non_google_error_status_.ToString())));
 }
 
+// Validate OK statuses and statuses without messages round-trip.
+TEST_F(StatusConversionsTest, OkAndCodeOnlyStatusesRoundTrip) {
+  EXPECT_TRUE(MakeStatus(PrimitiveStatus::OkStatus()).ok());
+  EXPECT_TRUE(MakePrimitiveStatus(Status::OkStatus()).ok());
+
+  Status status = MakeStatus(PrimitiveStatus(error::GoogleError::UNAVAILABLE));
+  EXPECT_THAT(status.error_code(), Eq(error::GoogleError::UNAVAILABLE));
+  EXPECT_THAT(status.error_space(), Eq(google_error_space_));
+  EXPECT_TRUE(status.error_message().empty());
+
+  PrimitiveStatus primitive_status = MakePrimitiveStatus(status);
+  EXPECT_THAT(primitive_status.error_code(),
+              Eq(error::GoogleError::UNAVAILABLE));
+  EXPECT_THAT(primitive_status.error_message(), StrEq(""));
+}
+
 }  // namespace
 }  // namespace primitives
 }  // namespace asylo
@@ -0,0 +1,252 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/primitives/util/trace_context.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "absl/base/attributes.h"
+#include "absl/time/clock.h"
+#include "asylo/platform/primitives/primitive_status.h"
+#include "asylo/platform/primitives/util/message.h"
+
+namespace asylo {
+namespace primitives {
+namespace {
+
+struct ThreadTraceState {
+  TraceContext current;
+  ScopedSpanCollector *collector;
+  // State of the generator of span and trace ids.
+  uint64_t id_state;
+  // Set while the thread reads the clock, which may exit the enclave, so that
+  // the exit is not traced in turn.
+  bool reading_clock;
+};
+
+ABSL_CONST_INIT thread_local ThreadTraceState thread_state = {
+    {}, nullptr, 0, false};
+
+int64_t NowNanos() {
+  thread_state.reading_clock = true;
+  int64_t now = absl::GetCurrentTimeNanos();
+  thread_state.reading_clock = false;
+  return now;
+}
+
+// Returns true if a span with parent |parent| is recorded.
+bool Recorded(const TraceContext &parent) {
+  return parent.valid() && parent.sampled && !thread_state.reading_clock;
+}
+
+std::atomic<SpanSink *> &InstalledSink() {
+  static std::atomic<SpanSink *> sink(nullptr);
+  return sink;
+}
+
+// Returns a random nonzero id. Ids only need to be unique, so they are drawn
+// from a SplitMix64 generator per thread, seeded from the clock, the thread
+// and a process-wide counter.
+uint64_t NewId() {
+  static std::atomic<uint64_t> seeds(0);
+  if (thread_state.id_state == 0) {
+    thread_state.id_state =
+        static_cast<uint64_t>(NowNanos()) ^
+        reinterpret_cast<uintptr_t>(&thread_state) ^
+        (seeds.fetch_add(1, std::memory_order_relaxed) << 32);
+  }
+  uint64_t id;
+  do {
+    uint64_t z = (thread_state.id_state += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    id = z ^ (z >> 31);
+  } while (id == 0);
+  return id;
+}
+
+}  // namespace
+
+constexpr size_t ScopedSpanCollector::kMaxSpans;
+
+TraceContext TraceContext::NewTrace(bool sampled) {
+  TraceContext context;
+  context.trace_id_high = NewId();
+  context.trace_id_low = NewId();
+  context.span_id = NewId();
+  context.sampled = sampled;
+  return context;
+}
+
+const char *SpanKindName(SpanKind kind) {
+  switch (kind) {
+    case SpanKind::kEnclaveCall:
+      return "enclave_call";
+    case SpanKind::kEnclaveEntry:
+      return "enclave_entry";
+    case SpanKind::kHostCall:
+      return "host_call";
+    case SpanKind::kExitHandler:
+      return "exit_handler";
+  }
+  return "unknown";
+}
+
+SpanSink *SetSpanSink(SpanSink *sink) { return InstalledSink().exchange(sink); }
+
+SpanSink *GetSpanSink() { return InstalledSink().load(); }
+
+TraceContext CurrentTraceContext() { return thread_state.current; }
+
+ScopedTraceContext::ScopedTraceContext(const TraceContext &context)
+    : saved_(thread_state.current) {
+  thread_state.current = context;
+}
+
+ScopedTraceContext::~ScopedTraceContext() { thread_state.current = saved_; }
+
+ScopedSpan::ScopedSpan(SpanKind kind, uint64_t selector)
+    : ScopedSpan(kind, selector, thread_state.current) {}
+
+ScopedSpan::ScopedSpan(SpanKind kind, uint64_t selector,
+                       const TraceContext &parent)
+    : recording_(Recorded(parent)) {
+  if (!recording_) {
+    return;
+  }
+  record_.context = parent;
+  record_.context.span_id = NewId();
+  record_.parent_span_id = parent.span_id;
+  record_.kind = kind;
+  record_.selector = selector & ~kTraceContextSelectorBit;
+  record_.end_nanos = 0;
+  saved_ = thread_state.current;
+  thread_state.current = record_.context;
+  record_.start_nanos = NowNanos();
+}
+
+ScopedSpan::~ScopedSpan() {
+  if (!recording_) {
+    return;
+  }
+  record_.end_nanos = NowNanos();
+  thread_state.current = saved_;
+  FinishSpan(record_);
+}
+
+ScopedSpanCollector::ScopedSpanCollector() : saved_(thread_state.collector) {
+  thread_state.collector = this;
+}
+
+ScopedSpanCollector::~ScopedSpanCollector() {
+  thread_state.collector = saved_;
+}
+
+void FinishSpan(const SpanRecord &span) {
+  ScopedSpanCollector *collector = thread_state.collector;
+  if (collector) {
+    if (collector->spans_.size() < ScopedSpanCollector::kMaxSpans) {
+      collector->spans_.push_back(span);
+    } else {
+      ++collector->dropped_;
+    }
+    return;
+  }
+  SpanSink *sink = GetSpanSink();
+  if (sink) {
+    sink->Record(span);
+  }
+}
+
+TracedCall::TracedCall(SpanKind kind, uint64_t *selector,
+                       MessageWriter **input, MessageReader **output) {
+  const TraceContext &current = thread_state.current;
+  if ((*selector & kTraceContextSelectorBit) || !Recorded(current)) {
+    return;
+  }
+  span_.emplace(kind, *selector, current);
+  if (!*input) {
+    *input = &scratch_input_;
+  }
+  if (!*output) {
+    *output = &scratch_output_;
+  }
+  (*input)->Push(span_->context());
+  *selector |= kTraceContextSelectorBit;
+}
+
+PrimitiveStatus TracedCall::ReceiveSpans(MessageReader *output) {
+  if (!attached()) {
+    return PrimitiveStatus::OkStatus();
+  }
+  if (output->empty()) {
+    return {error::GoogleError::INTERNAL, "Traced call returned no spans."};
+  }
+  Extent spans = output->TakeLast();
+  if (spans.size() % sizeof(SpanRecord) != 0) {
+    return {error::GoogleError::INTERNAL,
+            "Traced call returned malformed spans."};
+  }
+  const char *data = spans.As<char>();
+  for (size_t offset = 0; offset < spans.size(); offset += sizeof(SpanRecord)) {
+    SpanRecord span;
+    memcpy(&span, data + offset, sizeof(span));
+    FinishSpan(span);
+  }
+  return PrimitiveStatus::OkStatus();
+}
+
+PrimitiveStatus DetachTraceContext(uint64_t *selector, MessageReader *input,
+                                   TraceContext *caller) {
+  *caller = TraceContext();
+  if (!(*selector & kTraceContextSelectorBit)) {
+    return PrimitiveStatus::OkStatus();
+  }
+  *selector &= ~kTraceContextSelectorBit;
+  if (!input || input->empty()) {
+    return {error::GoogleError::INVALID_ARGUMENT,
+            "Traced call carries no trace context."};
+  }
+  Extent context = input->TakeLast();
+  if (context.size() != sizeof(TraceContext)) {
+    return {error::GoogleError::INVALID_ARGUMENT,
+            "Traced call carries a malformed trace context."};
+  }
+  memcpy(caller, context.data(), sizeof(*caller));
+  if (!caller->valid()) {
+    *caller = TraceContext();
+    return {error::GoogleError::INVALID_ARGUMENT,
+            "Traced call carries an invalid trace context."};
+  }
+  return PrimitiveStatus::OkStatus();
+}
+
+void AttachSpans(const ScopedSpanCollector &collector, MessageWriter *output) {
+  const std::vector<SpanRecord> &spans = collector.spans();
+  size_t size = spans.size() * sizeof(SpanRecord);
+  char *data = output->Allocate(size);
+  if (size > 0) {
+    memcpy(data, spans.data(), size);
+  }
+}
+
+}  // namespace primitives
+}  // namespace asylo
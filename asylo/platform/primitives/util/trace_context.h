@@ -0,0 +1,243 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_PRIMITIVES_UTIL_TRACE_CONTEXT_H_
+#define ASYLO_PLATFORM_PRIMITIVES_UTIL_TRACE_CONTEXT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "absl/types/optional.h"
+#include "asylo/platform/primitives/primitive_status.h"
+#include "asylo/platform/primitives/util/message.h"
+
+namespace asylo {
+namespace primitives {
+
+// Propagation of distributed trace contexts across the enclave boundary, and
+// lightweight recording of the spans of enclave calls and exit calls, so that
+// the time spent crossing the boundary and in host calls can be attributed to
+// the traced request that caused it.
+//
+// Each thread has a current TraceContext, which is invalid unless the thread
+// is serving a traced request. A call across the boundary made by a thread in
+// a sampled trace is recorded as a span, and the context of that span is
+// appended to the input of the call as its last extent. The selector of the
+// call is marked with kTraceContextSelectorBit so that the receiving side
+// strips the extent and makes the context current while it handles the call:
+//
+//   * Client::EnclaveCall records a kEnclaveCall span on the host, and the
+//     trusted runtime records a kEnclaveEntry span for the time spent inside
+//     the enclave.
+//   * TrustedPrimitives::UntrustedCall records a kHostCall span inside the
+//     enclave, and the host records a kExitHandler span for the time spent in
+//     the exit handler.
+//
+// The spans recorded inside the enclave while it handles a traced enclave call
+// are returned to the host in the last extent of the call's output, and are
+// passed to the SpanSink installed on the host together with the spans of the
+// host. The time spent crossing the boundary is the duration of a kEnclaveCall
+// or kHostCall span less the duration of its child span.
+
+// Bit of the selector of an enclave call or an exit call which marks that the
+// last extent of the input of the call is the TraceContext of its caller.
+constexpr uint64_t kTraceContextSelectorBit = uint64_t{1} << 63;
+
+// Identifies a span within a distributed trace. Trivially copyable, so that it
+// crosses the enclave boundary as a single extent.
+struct TraceContext {
+  // Returns the context of the root span of a new trace, with random ids.
+  static TraceContext NewTrace(bool sampled = true);
+
+  // Returns true if the context identifies a span.
+  bool valid() const {
+    return (trace_id_high != 0 || trace_id_low != 0) && span_id != 0;
+  }
+
+  uint64_t trace_id_high = 0;
+  uint64_t trace_id_low = 0;
+  uint64_t span_id = 0;
+
+  // Whether the spans of the trace are recorded.
+  bool sampled = false;
+};
+
+// The kinds of spans recorded at the enclave boundary.
+enum class SpanKind : uint32_t {
+  // An enclave call, as seen by the host.
+  kEnclaveCall,
+  // The handling of an enclave call inside the enclave.
+  kEnclaveEntry,
+  // An exit call, as seen by the enclave.
+  kHostCall,
+  // The handling of an exit call by the host.
+  kExitHandler,
+};
+
+// Returns a short, stable name for |kind|, suitable for use as a metric label.
+const char *SpanKindName(SpanKind kind);
+
+// A finished span. Trivially copyable, so that the spans recorded inside the
+// enclave are returned to the host as an array.
+struct SpanRecord {
+  // The trace of the span and the id of the span itself.
+  TraceContext context;
+  uint64_t parent_span_id;
+  SpanKind kind;
+  // The selector of the call the span covers, without kTraceContextSelectorBit.
+  uint64_t selector;
+  // Start and end of the span, in nanoseconds since the Unix epoch.
+  int64_t start_nanos;
+  int64_t end_nanos;
+};
+
+// Receives the spans finished on the host, including the spans returned by
+// enclaves. Implementations must be thread-safe.
+class SpanSink {
+ public:
+  virtual ~SpanSink() = default;
+
+  virtual void Record(const SpanRecord &span) = 0;
+};
+
+// Installs |sink| as the process-wide destination of finished spans, and
+// returns the previously installed sink. Passing nullptr drops finished spans,
+// which is the initial state. The caller retains ownership of |sink|, which
+// must outlive its installation.
+SpanSink *SetSpanSink(SpanSink *sink);
+
+// Returns the installed sink, or nullptr if there is none.
+SpanSink *GetSpanSink();
+
+// Returns the current trace context of the calling thread.
+TraceContext CurrentTraceContext();
+
+// Makes |context| the current trace context of the calling thread for the
+// lifetime of the object, for instance to continue a trace received from a
+// remote caller.
+class ScopedTraceContext {
+ public:
+  explicit ScopedTraceContext(const TraceContext &context);
+  ~ScopedTraceContext();
+
+  ScopedTraceContext(const ScopedTraceContext &other) = delete;
+  ScopedTraceContext &operator=(const ScopedTraceContext &other) = delete;
+
+ private:
+  const TraceContext saved_;
+};
+
+// Records a span of |kind| covering the lifetime of the object, as a child of
+// |parent|, which defaults to the current trace context. The context of the
+// span is current for the lifetime of the object. Does nothing, without
+// reading the clock, unless |parent| is a valid and sampled context.
+class ScopedSpan {
+ public:
+  ScopedSpan(SpanKind kind, uint64_t selector);
+  ScopedSpan(SpanKind kind, uint64_t selector, const TraceContext &parent);
+  ~ScopedSpan();
+
+  ScopedSpan(const ScopedSpan &other) = delete;
+  ScopedSpan &operator=(const ScopedSpan &other) = delete;
+
+  // Returns true if the span is being recorded.
+  bool recording() const { return recording_; }
+
+  // Returns the context of the span.
+  const TraceContext &context() const { return record_.context; }
+
+ private:
+  SpanRecord record_;
+  TraceContext saved_;
+  bool recording_;
+};
+
+// Collects the spans finished on the calling thread for the lifetime of the
+// object, instead of passing them to the installed sink. The trusted runtime
+// collects the spans of a traced enclave call to return them to the host. At
+// most kMaxSpans spans are kept, and the rest are counted as dropped.
+class ScopedSpanCollector {
+ public:
+  static constexpr size_t kMaxSpans = 64;
+
+  ScopedSpanCollector();
+  ~ScopedSpanCollector();
+
+  ScopedSpanCollector(const ScopedSpanCollector &other) = delete;
+  ScopedSpanCollector &operator=(const ScopedSpanCollector &other) = delete;
+
+  const std::vector<SpanRecord> &spans() const { return spans_; }
+  size_t dropped() const { return dropped_; }
+
+ private:
+  friend void FinishSpan(const SpanRecord &span);
+
+  std::vector<SpanRecord> spans_;
+  size_t dropped_ = 0;
+  ScopedSpanCollector *const saved_;
+};
+
+// Passes |span| to the collector of the calling thread if there is one, or to
+// the installed sink otherwise.
+void FinishSpan(const SpanRecord &span);
+
+// The sending side of a traced call across the enclave boundary. If the calling
+// thread is in a sampled trace, and |*selector| is not marked already because
+// the call is relayed on behalf of another caller, starts a span of |kind|,
+// appends its context to |*input| and marks |*selector|. A null |*input| or
+// |*output| is then replaced by a message owned by the TracedCall, since the
+// receiving side of an enclave call always returns the spans it recorded in
+// the output. The host records the spans of exit calls itself, so exit calls
+// return none.
+class TracedCall {
+ public:
+  TracedCall(SpanKind kind, uint64_t *selector, MessageWriter **input,
+             MessageReader **output);
+
+  TracedCall(const TracedCall &other) = delete;
+  TracedCall &operator=(const TracedCall &other) = delete;
+
+  // Returns true if the trace context was attached to the call.
+  bool attached() const { return span_.has_value(); }
+
+  // Strips the spans returned by the enclave from the last extent of |output|,
+  // which holds the output of the successful enclave call, and finishes them.
+  // Does nothing unless the context was attached.
+  PrimitiveStatus ReceiveSpans(MessageReader *output);
+
+ private:
+  absl::optional<ScopedSpan> span_;
+  MessageWriter scratch_input_;
+  MessageReader scratch_output_;
+};
+
+// The receiving side of a call across the enclave boundary. If |*selector| is
+// marked, clears the mark and strips the context of the caller from the last
+// extent of |input| into |*caller|. Otherwise leaves |*caller| invalid.
+PrimitiveStatus DetachTraceContext(uint64_t *selector, MessageReader *input,
+                                   TraceContext *caller);
+
+// Appends the spans of |collector| to |output|, as the last extent of the
+// output of a call whose input carried a trace context.
+void AttachSpans(const ScopedSpanCollector &collector, MessageWriter *output);
+
+}  // namespace primitives
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_PRIMITIVES_UTIL_TRACE_CONTEXT_H_
@@ -0,0 +1,230 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/primitives/util/trace_context.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "asylo/platform/primitives/util/message.h"
+
+namespace asylo {
+namespace primitives {
+namespace {
+
+using ::testing::Eq;
+using ::testing::IsFalse;
+using ::testing::IsTrue;
+using ::testing::Le;
+using ::testing::Ne;
+using ::testing::SizeIs;
+
+constexpr uint64_t kSelector = 1234;
+
+class RecordingSink : public SpanSink {
+ public:
+  void Record(const SpanRecord &span) override { spans.push_back(span); }
+
+  std::vector<SpanRecord> spans;
+};
+
+class TraceContextTest : public ::testing::Test {
+ protected:
+  void SetUp() override { previous_sink_ = SetSpanSink(&sink_); }
+  void TearDown() override { SetSpanSink(previous_sink_); }
+
+  RecordingSink sink_;
+
+ private:
+  SpanSink *previous_sink_;
+};
+
+// Passes the message written to |writer| across a simulated boundary.
+std::unique_ptr<MessageReader> Transfer(const MessageWriter &writer) {
+  std::vector<char> buffer(writer.MessageSize());
+  writer.Serialize(buffer.data());
+  auto reader = std::unique_ptr<MessageReader>(new MessageReader());
+  reader->Deserialize(buffer.data(), buffer.size());
+  return reader;
+}
+
+TEST_F(TraceContextTest, CallsOutsideTraceAreNotTraced) {
+  uint64_t selector = kSelector;
+  MessageWriter writer;
+  MessageWriter *input = &writer;
+  MessageReader *output = nullptr;
+  TracedCall traced_call(SpanKind::kEnclaveCall, &selector, &input, &output);
+
+  EXPECT_THAT(traced_call.attached(), IsFalse());
+  EXPECT_THAT(selector, Eq(kSelector));
+  EXPECT_THAT(input, Eq(&writer));
+  EXPECT_THAT(output, Eq(nullptr));
+  EXPECT_THAT(writer.empty(), IsTrue());
+}
+
+TEST_F(TraceContextTest, UnsampledTracesAreNotTraced) {
+  ScopedTraceContext scoped_context(TraceContext::NewTrace(/*sampled=*/false));
+  uint64_t selector = kSelector;
+  MessageWriter *input = nullptr;
+  MessageReader *output = nullptr;
+  {
+    TracedCall traced_call(SpanKind::kEnclaveCall, &selector, &input, &output);
+    EXPECT_THAT(traced_call.attached(), IsFalse());
+  }
+  EXPECT_THAT(selector, Eq(kSelector));
+  EXPECT_THAT(sink_.spans, SizeIs(0));
+}
+
+TEST_F(TraceContextTest, RelayedCallsAreNotTracedTwice) {
+  ScopedTraceContext scoped_context(TraceContext::NewTrace());
+  uint64_t selector = kSelector | kTraceContextSelectorBit;
+  MessageWriter writer;
+  MessageWriter *input = &writer;
+  MessageReader *output = nullptr;
+  TracedCall traced_call(SpanKind::kEnclaveCall, &selector, &input, &output);
+
+  EXPECT_THAT(traced_call.attached(), IsFalse());
+  EXPECT_THAT(writer.empty(), IsTrue());
+}
+
+TEST_F(TraceContextTest, PropagatesContextAndReturnsSpans) {
+  const TraceContext root = TraceContext::NewTrace();
+  ScopedTraceContext scoped_context(root);
+
+  uint64_t selector = kSelector;
+  MessageWriter writer;
+  writer.Push<int>(42);
+  MessageWriter *input = &writer;
+  MessageReader reader;
+  MessageReader *output = &reader;
+  TraceContext call_context;
+  {
+    TracedCall traced_call(SpanKind::kEnclaveCall, &selector, &input, &output);
+    ASSERT_THAT(traced_call.attached(), IsTrue());
+    EXPECT_THAT(selector, Eq(kSelector | kTraceContextSelectorBit));
+    call_context = CurrentTraceContext();
+
+    // The receiving side of the call.
+    std::unique_ptr<MessageReader> in = Transfer(*input);
+    MessageWriter out;
+    {
+      // The receiving thread starts outside of any trace.
+      ScopedTraceContext receiving_thread((TraceContext()));
+      uint64_t received_selector = selector;
+      TraceContext caller;
+      ASSERT_THAT(DetachTraceContext(&received_selector, in.get(), &caller)
+                      .ok(),
+                  IsTrue());
+      EXPECT_THAT(received_selector, Eq(kSelector));
+      EXPECT_THAT(*in, SizeIs(1));
+      EXPECT_THAT(in->next<int>(), Eq(42));
+      EXPECT_THAT(caller.span_id, Eq(call_context.span_id));
+
+      ScopedSpanCollector collector;
+      {
+        ScopedSpan entry(SpanKind::kEnclaveEntry, received_selector, caller);
+        ScopedSpan host_call(SpanKind::kHostCall, 7);
+      }
+      EXPECT_THAT(collector.spans(), SizeIs(2));
+      out.Push<int>(43);
+      AttachSpans(collector, &out);
+    }
+    reader = std::move(*Transfer(out));
+
+    ASSERT_THAT(traced_call.ReceiveSpans(output).ok(), IsTrue());
+    EXPECT_THAT(reader, SizeIs(1));
+    EXPECT_THAT(reader.next<int>(), Eq(43));
+  }
+  EXPECT_THAT(CurrentTraceContext().span_id, Eq(root.span_id));
+
+  // The spans of the enclave finish first, then the span of the call.
+  ASSERT_THAT(sink_.spans, SizeIs(3));
+  const SpanRecord &host_call = sink_.spans[0];
+  const SpanRecord &entry = sink_.spans[1];
+  const SpanRecord &call = sink_.spans[2];
+  for (const SpanRecord &span : sink_.spans) {
+    EXPECT_THAT(span.context.trace_id_high, Eq(root.trace_id_high));
+    EXPECT_THAT(span.context.trace_id_low, Eq(root.trace_id_low));
+    EXPECT_THAT(span.start_nanos, Le(span.end_nanos));
+  }
+  EXPECT_THAT(call.kind, Eq(SpanKind::kEnclaveCall));
+  EXPECT_THAT(call.selector, Eq(kSelector));
+  EXPECT_THAT(call.parent_span_id, Eq(root.span_id));
+  EXPECT_THAT(call.context.span_id, Eq(call_context.span_id));
+  EXPECT_THAT(entry.kind, Eq(SpanKind::kEnclaveEntry));
+  EXPECT_THAT(entry.parent_span_id, Eq(call.context.span_id));
+  EXPECT_THAT(host_call.kind, Eq(SpanKind::kHostCall));
+  EXPECT_THAT(host_call.selector, Eq(7));
+  EXPECT_THAT(host_call.parent_span_id, Eq(entry.context.span_id));
+  EXPECT_THAT(host_call.context.span_id, Ne(entry.context.span_id));
+}
+
+TEST_F(TraceContextTest, ReplacesNullMessagesOfTracedCalls) {
+  ScopedTraceContext scoped_context(TraceContext::NewTrace());
+  uint64_t selector = kSelector;
+  MessageWriter *input = nullptr;
+  MessageReader *output = nullptr;
+  TracedCall traced_call(SpanKind::kHostCall, &selector, &input, &output);
+
+  ASSERT_THAT(input, Ne(nullptr));
+  ASSERT_THAT(output, Ne(nullptr));
+  EXPECT_THAT(input->size(), Eq(1));
+}
+
+TEST_F(TraceContextTest, RejectsMalformedContexts) {
+  uint64_t selector = kSelector | kTraceContextSelectorBit;
+  TraceContext caller;
+  MessageReader empty;
+  EXPECT_THAT(DetachTraceContext(&selector, &empty, &caller).error_code(),
+              Eq(error::GoogleError::INVALID_ARGUMENT));
+
+  selector = kSelector | kTraceContextSelectorBit;
+  MessageWriter writer;
+  writer.Push<int>(1);
+  EXPECT_THAT(
+      DetachTraceContext(&selector, Transfer(writer).get(), &caller)
+          .error_code(),
+      Eq(error::GoogleError::INVALID_ARGUMENT));
+
+  selector = kSelector | kTraceContextSelectorBit;
+  MessageWriter invalid;
+  invalid.Push(TraceContext());
+  EXPECT_THAT(
+      DetachTraceContext(&selector, Transfer(invalid).get(), &caller)
+          .error_code(),
+      Eq(error::GoogleError::INVALID_ARGUMENT));
+  EXPECT_THAT(caller.valid(), IsFalse());
+}
+
+TEST_F(TraceContextTest, CollectorDropsExcessSpans) {
+  ScopedTraceContext scoped_context(TraceContext::NewTrace());
+  ScopedSpanCollector collector;
+  for (size_t i = 0; i < ScopedSpanCollector::kMaxSpans + 3; ++i) {
+    ScopedSpan span(SpanKind::kHostCall, i);
+  }
+  EXPECT_THAT(collector.spans(), SizeIs(ScopedSpanCollector::kMaxSpans));
+  EXPECT_THAT(collector.dropped(), Eq(3));
+  EXPECT_THAT(sink_.spans, SizeIs(0));
+}
+
+}  // namespace
+}  // namespace primitives
+}  // namespace asylo
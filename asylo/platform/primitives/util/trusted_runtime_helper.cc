@@ -29,8 +29,9 @@
 #include "asylo/platform/primitives/trusted_primitives.h"
 #include "asylo/platform/primitives/trusted_runtime.h"
 #include "asylo/platform/primitives/util/message.h"
+#include "asylo/platform/primitives/util/trace_context.h"
 #include "asylo/util/lock_guard.h"
-#include "asylo/util/status_macros.h"
+#include "asylo/util/logging.h"
 
 namespace asylo {
 namespace primitives {
@@ -40,6 +41,9 @@ namespace {
 // Maximum number of supported enclave entry points.
 static constexpr size_t kEntryPointMax = 4096;
 
+// Largest staging buffer kept by a thread between enclave calls.
+constexpr size_t kMaxRetainedStagingSize = 64 * 1024;
+
 // Enclave status flag bits.
 enum Flag : uint64_t { kInitialized = 0x1, kAborted = 0x2 };
 
@@ -78,7 +82,8 @@ void EnsureInitialized() {
   LockGuard lock(&enclave_state.initialization_lock);
   if (!(enclave_state.flags & Flag::kInitialized)) {
     // Register placeholder handlers for reserved entry points.
-    for (uint64_t i = kSelectorAsyloFini + 1; i < kSelectorUser; i++) {
+    for (uint64_t i = kSelectorAsyloSwitchlessInit + 1; i < kSelectorUser;
+         i++) {
       EntryHandler handler{ReservedEntry};
       if (!TrustedPrimitives::RegisterEntryHandler(i, handler).ok()) {
         TrustedPrimitives::BestEffortAbort("Could not register entry handler");
@@ -124,6 +129,12 @@ PrimitiveStatus InvokeEntryHandler(uint64_t selector, MessageReader *in,
     return {error::GoogleError::ABORTED, "Invalid call to aborted enclave."};
   }
 
+  TraceContext caller;
+  PrimitiveStatus status = DetachTraceContext(&selector, in, &caller);
+  if (!status.ok()) {
+    return status;
+  }
+
   // Bounds check the passed selector.
   if (selector >= kEntryPointMax ||
       enclave_state.entry_table[selector].IsNull()) {
@@ -134,8 +145,21 @@ PrimitiveStatus InvokeEntryHandler(uint64_t selector, MessageReader *in,
   // Invoke the entry point handler.
   auto &handler = enclave_state.entry_table[selector];
 
-  ASYLO_RETURN_IF_ERROR(handler.callback(handler.context, in, out));
-  return PrimitiveStatus::OkStatus();
+  if (caller.valid()) {
+    // Return the spans recorded while handling the call to the traced caller.
+    ScopedSpanCollector collector;
+    {
+      ScopedSpan span(SpanKind::kEnclaveEntry, selector, caller);
+      status = handler.callback(handler.context, in, out);
+    }
+    AttachSpans(collector, out);
+  } else {
+    status = handler.callback(handler.context, in, out);
+  }
+
+  // Write the records buffered during the call before leaving the enclave.
+  FlushLogs();
+  return status;
 }
 
 void MarkEnclaveInitialized() { UpdateEnclaveState(Flag::kInitialized); }
@@ -156,6 +180,40 @@ std::unique_ptr<char[]> CopyFromUntrusted(const void *untrusted_data,
   return nullptr;
 }
 
+TrustedStagingBuffer::TrustedStagingBuffer() : storage_(ThreadStorage()) {
+  if (storage_->in_use) {
+    storage_ = &owned_storage_;
+  }
+  storage_->in_use = true;
+}
+
+TrustedStagingBuffer::~TrustedStagingBuffer() {
+  storage_->in_use = false;
+  if (storage_->capacity > kMaxRetainedStagingSize) {
+    storage_->data.reset();
+    storage_->capacity = 0;
+  }
+}
+
+char *TrustedStagingBuffer::CopyFromUntrusted(const void *untrusted_data,
+                                              size_t size) {
+  if (!TrustedPrimitives::IsOutsideEnclave(untrusted_data, size)) {
+    TrustedPrimitives::BestEffortAbort(
+        "Input should lie within untrusted memory.");
+  }
+  if (storage_->capacity < size) {
+    storage_->data.reset(new char[size]);
+    storage_->capacity = size;
+  }
+  memcpy(storage_->data.get(), untrusted_data, size);
+  return storage_->data.get();
+}
+
+TrustedStagingBuffer::Storage *TrustedStagingBuffer::ThreadStorage() {
+  static thread_local Storage storage;
+  return &storage;
+}
+
 void *CopyToUntrusted(void *trusted_data, size_t size) {
   if (trusted_data && size > 0) {
     if (!TrustedPrimitives::IsInsideEnclave(trusted_data, size)) {
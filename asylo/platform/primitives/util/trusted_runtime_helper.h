@@ -19,7 +19,9 @@
 #ifndef ASYLO_PLATFORM_PRIMITIVES_UTIL_TRUSTED_RUNTIME_HELPER_H_
 #define ASYLO_PLATFORM_PRIMITIVES_UTIL_TRUSTED_RUNTIME_HELPER_H_
 
+#include <cstddef>
 #include <cstdio>
+#include <memory>
 
 #include "asylo/platform/primitives/primitive_status.h"
 #include "asylo/platform/primitives/trusted_primitives.h"
@@ -59,6 +61,37 @@ void MarkEnclaveAborted();
 std::unique_ptr<char[]> CopyFromUntrusted(const void *untrusted_data,
                                           size_t size);
 
+// A trusted buffer into which the input of an enclave call is staged. Successive
+// calls on a thread reuse the same buffer, so staging does not allocate once
+// the buffer has grown to the size of the inputs. A call nested in another on
+// the same thread gets a buffer of its own.
+class TrustedStagingBuffer {
+ public:
+  TrustedStagingBuffer();
+  ~TrustedStagingBuffer();
+
+  TrustedStagingBuffer(const TrustedStagingBuffer &other) = delete;
+  TrustedStagingBuffer &operator=(const TrustedStagingBuffer &other) = delete;
+
+  // Copies |size| bytes of untrusted data into the buffer and returns the
+  // trusted copy, which is valid until this object is destroyed. Aborts if the
+  // data is not in untrusted memory.
+  char *CopyFromUntrusted(const void *untrusted_data, size_t size);
+
+ private:
+  struct Storage {
+    std::unique_ptr<char[]> data;
+    size_t capacity = 0;
+    bool in_use = false;
+  };
+
+  // Returns the storage of the calling thread.
+  static Storage *ThreadStorage();
+
+  Storage *storage_;
+  Storage owned_storage_;
+};
+
 // Copies trusted data to untrusted memory, returning raw pointer to the
 // untrusted memory. Aborts if input data is found to not be in trusted memory.
 // The caller (or untrusted code) is responsible for freeing the untrusted data.
@@ -0,0 +1,71 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_PRIMITIVES_UTIL_UNTRUSTED_MESSAGE_WRITER_H_
+#define ASYLO_PLATFORM_PRIMITIVES_UTIL_UNTRUSTED_MESSAGE_WRITER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "asylo/platform/primitives/trusted_primitives.h"
+#include "asylo/platform/primitives/util/message.h"
+
+namespace asylo {
+namespace primitives {
+
+// A MessageWriter which serializes pushed extents directly into an untrusted
+// arena from TrustedPrimitives::UntrustedMessageAlloc. Passing it to
+// TrustedPrimitives::UntrustedCall hands the arena to the host as is instead of
+// copying the message into untrusted memory a second time. Pushed extents are
+// visible to the host as soon as they are pushed, so only data which is about
+// to leave the enclave anyway should be pushed.
+class UntrustedArenaMessageWriter : public MessageWriter {
+ public:
+  // Allocates an arena of |capacity| bytes. Extents beyond |capacity| are
+  // accepted, but are then copied when the message is serialized, as are all
+  // extents if the backend provides no arena.
+  explicit UntrustedArenaMessageWriter(size_t capacity)
+      : UntrustedArenaMessageWriter(
+            TrustedPrimitives::UntrustedMessageAlloc(capacity), capacity) {}
+
+  // Releases the arena.
+  ~UntrustedArenaMessageWriter() {
+    TrustedPrimitives::UntrustedMessageFree(arena_);
+  }
+
+  UntrustedArenaMessageWriter(const UntrustedArenaMessageWriter &) = delete;
+  UntrustedArenaMessageWriter &operator=(const UntrustedArenaMessageWriter &) =
+      delete;
+
+  // Returns the arena capacity needed to hold |size| bytes of extent data
+  // pushed as |count| extents.
+  static constexpr size_t CapacityFor(size_t count, size_t size) {
+    return count * sizeof(uint64_t) + size;
+  }
+
+ private:
+  UntrustedArenaMessageWriter(void *arena, size_t capacity)
+      : MessageWriter(arena, capacity), arena_(arena) {}
+
+  void *const arena_;
+};
+
+}  // namespace primitives
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_PRIMITIVES_UTIL_UNTRUSTED_MESSAGE_WRITER_H_
@@ -0,0 +1,360 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/storage/kv/secure_key_value_store.h"
+
+#include <cstring>
+#include <utility>
+
+#include "absl/base/attributes.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
+#include "asylo/crypto/sha256_hash.h"
+#include "asylo/util/logging.h"
+#include "asylo/util/status_macros.h"
+
+namespace asylo {
+namespace {
+
+// Fixed-size prefix of every batch in the log. It is followed by the nonce and
+// by |ciphertext_size| bytes of ciphertext.
+struct BatchHeader {
+  uint64_t sequence;
+  uint32_t ciphertext_size;
+} ABSL_ATTRIBUTE_PACKED;
+
+// Prefix of every record in the plaintext of a batch. It is followed by
+// |key_size| bytes of key and |value_size| bytes of value.
+struct RecordHeader {
+  uint8_t type;
+  uint32_t key_size;
+  uint32_t value_size;
+} ABSL_ATTRIBUTE_PACKED;
+
+constexpr uint8_t kPutRecord = 1;
+constexpr uint8_t kDeleteRecord = 2;
+
+// Chain digest preceding the first batch of a log.
+constexpr size_t kHeadSize = 32;
+
+// Returns the size of the serialized record for |key| and |value|.
+size_t RecordSize(absl::string_view key, absl::string_view value) {
+  return sizeof(RecordHeader) + key.size() + value.size();
+}
+
+}  // namespace
+
+SecureKeyValueStore::SecureKeyValueStore(
+    std::unique_ptr<RandomAccessStorage> storage,
+    std::unique_ptr<AeadCryptor> cryptor, const Options &options)
+    : storage_(std::move(storage)),
+      cryptor_(std::move(cryptor)),
+      options_(options),
+      live_bytes_(0),
+      end_{0, 0, std::vector<uint8_t>(kHeadSize, 0)} {}
+
+StatusOr<std::unique_ptr<SecureKeyValueStore>> SecureKeyValueStore::Open(
+    std::unique_ptr<RandomAccessStorage> storage, ByteContainerView key,
+    const Options &options) {
+  if (!storage) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Storage must not be null");
+  }
+  std::unique_ptr<AeadCryptor> cryptor;
+  ASYLO_ASSIGN_OR_RETURN(cryptor, AeadCryptor::CreateAesGcmSivCryptor(key));
+  if (options.max_batch_size == 0 ||
+      options.max_batch_size > cryptor->MaxMessageSize()) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  absl::StrCat("Batch size must be between 1 and ",
+                               cryptor->MaxMessageSize()));
+  }
+
+  auto store = absl::WrapUnique(
+      new SecureKeyValueStore(std::move(storage), std::move(cryptor), options));
+  ASYLO_RETURN_IF_ERROR(store->Replay());
+  return std::move(store);
+}
+
+StatusOr<std::string> SecureKeyValueStore::Get(absl::string_view key) const {
+  ASYLO_RETURN_IF_ERROR(status_);
+  auto it = records_.find(key);
+  if (it == records_.end()) {
+    return Status(error::GoogleError::NOT_FOUND, "Key not found");
+  }
+  return it->second;
+}
+
+Status SecureKeyValueStore::Put(absl::string_view key,
+                                absl::string_view value) {
+  ASYLO_RETURN_IF_ERROR(AppendRecord(kPutRecord, key, value));
+  auto it = records_.find(key);
+  if (it != records_.end()) {
+    live_bytes_ -= RecordSize(it->first, it->second);
+    it->second.assign(value.data(), value.size());
+  } else {
+    records_.emplace(key, value);
+  }
+  live_bytes_ += RecordSize(key, value);
+  return Status::OkStatus();
+}
+
+Status SecureKeyValueStore::Delete(absl::string_view key) {
+  auto it = records_.find(key);
+  if (it == records_.end()) {
+    return status_;
+  }
+  ASYLO_RETURN_IF_ERROR(AppendRecord(kDeleteRecord, key, ""));
+  live_bytes_ -= RecordSize(it->first, it->second);
+  records_.erase(it);
+  return Status::OkStatus();
+}
+
+Status SecureKeyValueStore::Commit() {
+  ASYLO_RETURN_IF_ERROR(status_);
+  if (pending_.empty()) {
+    return Status::OkStatus();
+  }
+  status_ = WriteBatch(pending_, storage_.get(), &end_);
+  if (status_.ok()) {
+    status_ = storage_->Sync();
+  }
+  pending_.clear();
+  return status_;
+}
+
+Status SecureKeyValueStore::CompactTo(
+    std::unique_ptr<RandomAccessStorage> destination) {
+  if (!destination) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Destination must not be null");
+  }
+  ASYLO_RETURN_IF_ERROR(Commit());
+  ASYLO_RETURN_IF_ERROR(destination->Truncate(0));
+
+  LogPosition position{0, 0, std::vector<uint8_t>(kHeadSize, 0)};
+  std::vector<uint8_t> batch;
+  for (const auto &record : records_) {
+    size_t record_size = RecordSize(record.first, record.second);
+    if (!batch.empty() &&
+        batch.size() + record_size > options_.max_batch_size) {
+      ASYLO_RETURN_IF_ERROR(WriteBatch(batch, destination.get(), &position));
+      batch.clear();
+    }
+    RecordHeader header = {kPutRecord,
+                           static_cast<uint32_t>(record.first.size()),
+                           static_cast<uint32_t>(record.second.size())};
+    const uint8_t *header_bytes = reinterpret_cast<const uint8_t *>(&header);
+    batch.insert(batch.end(), header_bytes, header_bytes + sizeof(header));
+    batch.insert(batch.end(), record.first.begin(), record.first.end());
+    batch.insert(batch.end(), record.second.begin(), record.second.end());
+  }
+  if (!batch.empty()) {
+    ASYLO_RETURN_IF_ERROR(WriteBatch(batch, destination.get(), &position));
+  }
+  ASYLO_RETURN_IF_ERROR(destination->Sync());
+
+  storage_ = std::move(destination);
+  end_ = std::move(position);
+  return Status::OkStatus();
+}
+
+bool SecureKeyValueStore::NeedsCompaction() const {
+  return end_.offset > options_.compaction_ratio * live_bytes_ &&
+         end_.offset > options_.max_batch_size;
+}
+
+Status SecureKeyValueStore::Replay() {
+  size_t storage_size;
+  ASYLO_ASSIGN_OR_RETURN(storage_size, storage_->Size());
+
+  const size_t nonce_size = cryptor_->NonceSize();
+  const size_t max_ciphertext_size =
+      options_.max_batch_size + cryptor_->MaxSealOverhead();
+  std::vector<uint8_t> batch;
+  std::vector<uint8_t> plaintext;
+  while (end_.offset < storage_size) {
+    size_t remaining = storage_size - end_.offset;
+    BatchHeader header;
+    if (remaining < sizeof(header) + nonce_size) {
+      break;
+    }
+    ASYLO_RETURN_IF_ERROR(storage_->Read(&header, end_.offset, sizeof(header)));
+    if (header.sequence != end_.sequence ||
+        header.ciphertext_size > max_ciphertext_size) {
+      return Status(error::GoogleError::DATA_LOSS,
+                    absl::StrCat("Malformed batch header at offset ",
+                                 end_.offset));
+    }
+    size_t batch_size = sizeof(header) + nonce_size + header.ciphertext_size;
+    if (remaining < batch_size) {
+      break;
+    }
+
+    batch.resize(batch_size);
+    ASYLO_RETURN_IF_ERROR(
+        storage_->Read(batch.data(), end_.offset, batch_size));
+    ByteContainerView nonce(batch.data() + sizeof(header), nonce_size);
+    ByteContainerView ciphertext(batch.data() + sizeof(header) + nonce_size,
+                                 header.ciphertext_size);
+    plaintext.resize(header.ciphertext_size);
+    size_t plaintext_size;
+    Status status = cryptor_->Open(
+        ciphertext, AssociatedData(end_, header.ciphertext_size), nonce,
+        absl::MakeSpan(plaintext), &plaintext_size);
+    if (!status.ok()) {
+      return Status(error::GoogleError::DATA_LOSS,
+                    absl::StrCat("Batch at offset ", end_.offset,
+                                 " failed authentication: ",
+                                 status.ToString()));
+    }
+    ASYLO_RETURN_IF_ERROR(
+        ApplyBatch(ByteContainerView(plaintext.data(), plaintext_size)));
+
+    ASYLO_ASSIGN_OR_RETURN(end_.head, ChainDigest(end_.head, batch));
+    end_.offset += batch_size;
+    end_.sequence++;
+  }
+
+  if (end_.offset < storage_size) {
+    LOG(WARNING) << "Discarding " << storage_size - end_.offset
+                 << " bytes of incomplete batch at the end of the log";
+    ASYLO_RETURN_IF_ERROR(storage_->Truncate(end_.offset));
+  }
+  return Status::OkStatus();
+}
+
+Status SecureKeyValueStore::ApplyBatch(ByteContainerView records) {
+  size_t offset = 0;
+  while (offset < records.size()) {
+    RecordHeader header;
+    if (records.size() - offset < sizeof(header)) {
+      return Status(error::GoogleError::DATA_LOSS, "Truncated record header");
+    }
+    memcpy(&header, records.data() + offset, sizeof(header));
+    offset += sizeof(header);
+    if (records.size() - offset <
+        static_cast<size_t>(header.key_size) + header.value_size) {
+      return Status(error::GoogleError::DATA_LOSS, "Truncated record");
+    }
+    std::string key(reinterpret_cast<const char *>(records.data()) + offset,
+                    header.key_size);
+    offset += header.key_size;
+    absl::string_view value(
+        reinterpret_cast<const char *>(records.data()) + offset,
+        header.value_size);
+    offset += header.value_size;
+
+    auto it = records_.find(key);
+    if (it != records_.end()) {
+      live_bytes_ -= RecordSize(it->first, it->second);
+    }
+    switch (header.type) {
+      case kPutRecord:
+        live_bytes_ += RecordSize(key, value);
+        records_[std::move(key)].assign(value.data(), value.size());
+        break;
+      case kDeleteRecord:
+        if (it != records_.end()) {
+          records_.erase(it);
+        }
+        break;
+      default:
+        return Status(error::GoogleError::DATA_LOSS,
+                      absl::StrCat("Unknown record type ", header.type));
+    }
+  }
+  return Status::OkStatus();
+}
+
+Status SecureKeyValueStore::AppendRecord(uint8_t type, absl::string_view key,
+                                         absl::string_view value) {
+  ASYLO_RETURN_IF_ERROR(status_);
+  size_t record_size = RecordSize(key, value);
+  if (record_size > options_.max_batch_size) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  "Record exceeds the maximum batch size");
+  }
+  if (pending_.size() + record_size > options_.max_batch_size) {
+    ASYLO_RETURN_IF_ERROR(Commit());
+  }
+
+  RecordHeader header = {type, static_cast<uint32_t>(key.size()),
+                         static_cast<uint32_t>(value.size())};
+  const uint8_t *header_bytes = reinterpret_cast<const uint8_t *>(&header);
+  pending_.insert(pending_.end(), header_bytes, header_bytes + sizeof(header));
+  pending_.insert(pending_.end(), key.begin(), key.end());
+  pending_.insert(pending_.end(), value.begin(), value.end());
+  return Status::OkStatus();
+}
+
+Status SecureKeyValueStore::WriteBatch(ByteContainerView records,
+                                       RandomAccessStorage *storage,
+                                       LogPosition *position) {
+  const size_t nonce_size = cryptor_->NonceSize();
+  std::vector<uint8_t> batch(sizeof(BatchHeader) + nonce_size +
+                             records.size() + cryptor_->MaxSealOverhead());
+  absl::Span<uint8_t> nonce(batch.data() + sizeof(BatchHeader), nonce_size);
+  absl::Span<uint8_t> ciphertext(
+      batch.data() + sizeof(BatchHeader) + nonce_size,
+      batch.size() - sizeof(BatchHeader) - nonce_size);
+
+  // The ciphertext size is known before sealing: AES-GCM-SIV adds a tag of
+  // exactly MaxSealOverhead() bytes.
+  BatchHeader header = {position->sequence,
+                        static_cast<uint32_t>(ciphertext.size())};
+  size_t ciphertext_size;
+  ASYLO_RETURN_IF_ERROR(cryptor_->Seal(
+      records, AssociatedData(*position, header.ciphertext_size), nonce,
+      ciphertext, &ciphertext_size));
+  if (ciphertext_size != header.ciphertext_size) {
+    return Status(error::GoogleError::INTERNAL,
+                  "Unexpected sealed batch size");
+  }
+  memcpy(batch.data(), &header, sizeof(header));
+
+  ASYLO_RETURN_IF_ERROR(
+      storage->Write(batch.data(), position->offset, batch.size()));
+  ASYLO_ASSIGN_OR_RETURN(position->head, ChainDigest(position->head, batch));
+  position->offset += batch.size();
+  position->sequence++;
+  return Status::OkStatus();
+}
+
+std::vector<uint8_t> SecureKeyValueStore::AssociatedData(
+    const LogPosition &position, uint32_t ciphertext_size) {
+  BatchHeader header = {position.sequence, ciphertext_size};
+  const uint8_t *header_bytes = reinterpret_cast<const uint8_t *>(&header);
+  std::vector<uint8_t> associated_data(header_bytes,
+                                       header_bytes + sizeof(header));
+  associated_data.insert(associated_data.end(), position.head.begin(),
+                         position.head.end());
+  return associated_data;
+}
+
+StatusOr<std::vector<uint8_t>> SecureKeyValueStore::ChainDigest(
+    const std::vector<uint8_t> &head, ByteContainerView batch) {
+  Sha256Hash hash;
+  hash.Update(head);
+  hash.Update(batch);
+  std::vector<uint8_t> digest;
+  ASYLO_RETURN_IF_ERROR(hash.CumulativeHash(&digest));
+  return digest;
+}
+
+}  // namespace asylo
@@ -0,0 +1,179 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_STORAGE_KV_SECURE_KEY_VALUE_STORE_H_
+#define ASYLO_PLATFORM_STORAGE_KV_SECURE_KEY_VALUE_STORE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "asylo/crypto/aead_cryptor.h"
+#include "asylo/crypto/util/byte_container_view.h"
+#include "asylo/platform/storage/utils/random_access_storage.h"
+#include "asylo/util/status.h"
+#include "asylo/util/statusor.h"
+
+namespace asylo {
+
+// A key-value store kept as an append-only log of sealed batches in untrusted
+// storage. All live records are held in enclave memory; the log is only read
+// back when the store is opened, so the store suits data sets which fit in the
+// enclave and are made of many small records.
+//
+// Put() and Delete() are buffered in a pending batch which Commit() seals with
+// a single AEAD operation and appends to the log. Each batch is bound to its
+// position in the log by its sequence number and by the chain digest of all
+// preceding batches, both of which are part of its associated data, so batches
+// cannot be modified, reordered or spliced from another log without Open()
+// failing. Dropping batches from the end of the log cannot be detected from the
+// log alone: callers requiring freshness should persist head() in trusted
+// storage (e.g. sealed next to a monotonic counter) after each Commit() and
+// compare it after Open().
+//
+// Superseded records are reclaimed by CompactTo(), which writes the live
+// records to a fresh log. Instances are not thread-safe.
+class SecureKeyValueStore {
+ public:
+  struct Options {
+    // Largest size in bytes of the serialized records of a single batch. A
+    // batch reaching this size is committed automatically.
+    size_t max_batch_size = 64 * 1024;
+
+    // NeedsCompaction() returns true once the log is this many times larger
+    // than the live records it holds.
+    double compaction_ratio = 2.0;
+  };
+
+  // Opens the store logged to |storage| under the AES-GCM-SIV key |key|,
+  // replaying every batch of the log. A batch which was only partially written
+  // at the end of the log, for instance because of a crash during Commit(), is
+  // discarded and truncated from |storage|. Returns DATA_LOSS if any complete
+  // batch fails authentication.
+  static StatusOr<std::unique_ptr<SecureKeyValueStore>> Open(
+      std::unique_ptr<RandomAccessStorage> storage, ByteContainerView key,
+      const Options &options);
+
+  static StatusOr<std::unique_ptr<SecureKeyValueStore>> Open(
+      std::unique_ptr<RandomAccessStorage> storage, ByteContainerView key) {
+    return Open(std::move(storage), key, Options());
+  }
+
+  SecureKeyValueStore(const SecureKeyValueStore &other) = delete;
+  SecureKeyValueStore &operator=(const SecureKeyValueStore &other) = delete;
+
+  // Returns the value stored under |key|, including uncommitted writes, or
+  // NOT_FOUND if there is none.
+  StatusOr<std::string> Get(absl::string_view key) const;
+
+  // Stores |value| under |key|, replacing any previous value.
+  Status Put(absl::string_view key, absl::string_view value);
+
+  // Removes |key| from the store. Deleting an absent key is not an error.
+  Status Delete(absl::string_view key);
+
+  // Seals the pending batch, appends it to the log and syncs the log. Does
+  // nothing if no writes are pending. If Commit() fails the in-memory state
+  // may be ahead of the log, so every later operation returns the same error
+  // and the store must be reopened.
+  Status Commit();
+
+  // Commits pending writes, then writes the live records to |destination| as a
+  // new log and continues logging there. On failure the store keeps using its
+  // current log. The caller is responsible for replacing the old log by
+  // |destination| atomically, for example by renaming the file backing it.
+  Status CompactTo(std::unique_ptr<RandomAccessStorage> destination);
+
+  // Returns true if the log is large enough compared to the live records that
+  // CompactTo() should be called.
+  bool NeedsCompaction() const;
+
+  // Returns the chain digest covering every batch committed to the log.
+  const std::vector<uint8_t> &head() const { return end_.head; }
+
+  // Returns the number of live records.
+  size_t size() const { return records_.size(); }
+
+  // Returns the size in bytes of the committed log.
+  size_t log_size() const { return end_.offset; }
+
+ private:
+  // Position of the end of a log: the next batch to append and the digest of
+  // the batches before it.
+  struct LogPosition {
+    size_t offset;
+    uint64_t sequence;
+    std::vector<uint8_t> head;
+  };
+
+  SecureKeyValueStore(std::unique_ptr<RandomAccessStorage> storage,
+                      std::unique_ptr<AeadCryptor> cryptor,
+                      const Options &options);
+
+  // Replays the log of |storage_| into |records_|.
+  Status Replay();
+
+  // Applies the serialized records of a batch to |records_|.
+  Status ApplyBatch(ByteContainerView records);
+
+  // Appends a record to the pending batch, committing the batch first if the
+  // record would make it exceed the maximum batch size.
+  Status AppendRecord(uint8_t type, absl::string_view key,
+                      absl::string_view value);
+
+  // Seals |records| as the batch at |position| of |storage| and advances
+  // |position| past it.
+  Status WriteBatch(ByteContainerView records, RandomAccessStorage *storage,
+                    LogPosition *position);
+
+  // Returns the associated data authenticating a batch at |position| whose
+  // ciphertext is |ciphertext_size| bytes long.
+  static std::vector<uint8_t> AssociatedData(const LogPosition &position,
+                                             uint32_t ciphertext_size);
+
+  // Returns the chain digest following |head| after the batch |batch|.
+  static StatusOr<std::vector<uint8_t>> ChainDigest(
+      const std::vector<uint8_t> &head, ByteContainerView batch);
+
+  std::unique_ptr<RandomAccessStorage> storage_;
+  std::unique_ptr<AeadCryptor> cryptor_;
+  const Options options_;
+
+  // Live records, in enclave memory.
+  absl::flat_hash_map<std::string, std::string> records_;
+
+  // Serialized size of the live records.
+  size_t live_bytes_;
+
+  // Serialized records not yet committed.
+  std::vector<uint8_t> pending_;
+
+  // End of the committed log.
+  LogPosition end_;
+
+  // First Commit() error, after which the store is unusable.
+  Status status_;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_STORAGE_KV_SECURE_KEY_VALUE_STORE_H_
@@ -0,0 +1,274 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/storage/kv/secure_key_value_store.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "asylo/platform/storage/utils/fd_closer.h"
+#include "asylo/platform/storage/utils/test_utils.h"
+#include "asylo/platform/storage/utils/untrusted_file.h"
+#include "asylo/test/util/status_matchers.h"
+
+namespace asylo {
+namespace {
+
+using ::testing::Eq;
+using ::testing::Gt;
+using ::testing::Lt;
+using ::testing::Ne;
+
+constexpr char kKey[] = "0123456789abcdef0123456789abcdef";
+
+class SecureKeyValueStoreTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    fd_ = CreateEmptyTempFileOrDie("secure_key_value_store.tmp");
+    closer_.reset(fd_);
+  }
+
+  StatusOr<std::unique_ptr<SecureKeyValueStore>> OpenStore(
+      int fd,
+      const SecureKeyValueStore::Options &options =
+          SecureKeyValueStore::Options()) {
+    return SecureKeyValueStore::Open(absl::make_unique<UntrustedFile>(fd),
+                                     kKey, options);
+  }
+
+  // Flips a bit of the log at |offset|.
+  void CorruptLog(off_t offset) {
+    UntrustedFile file(fd_);
+    uint8_t byte;
+    ASYLO_ASSERT_OK(file.Read(&byte, offset, 1));
+    byte ^= 1;
+    ASYLO_ASSERT_OK(file.Write(&byte, offset, 1));
+  }
+
+  int fd_;
+  platform::storage::FdCloser closer_;
+};
+
+TEST_F(SecureKeyValueStoreTest, PutGetDelete) {
+  auto store_result = OpenStore(fd_);
+  ASSERT_THAT(store_result, IsOk());
+  auto store = std::move(store_result).ValueOrDie();
+
+  EXPECT_THAT(store->Get("a"), StatusIs(error::GoogleError::NOT_FOUND));
+  ASYLO_ASSERT_OK(store->Put("a", "1"));
+  ASYLO_ASSERT_OK(store->Put("b", "2"));
+  ASYLO_ASSERT_OK(store->Put("a", "3"));
+  EXPECT_THAT(store->Get("a"), IsOkAndHolds("3"));
+  EXPECT_THAT(store->Get("b"), IsOkAndHolds("2"));
+  ASYLO_ASSERT_OK(store->Delete("b"));
+  ASYLO_ASSERT_OK(store->Delete("c"));
+  EXPECT_THAT(store->Get("b"), StatusIs(error::GoogleError::NOT_FOUND));
+  EXPECT_THAT(store->size(), Eq(1));
+}
+
+// Committed writes are replayed by Open(); uncommitted ones are lost.
+TEST_F(SecureKeyValueStoreTest, ReopenReplaysCommittedBatches) {
+  std::vector<uint8_t> head;
+  {
+    auto store_result = OpenStore(fd_);
+    ASSERT_THAT(store_result, IsOk());
+    auto store = std::move(store_result).ValueOrDie();
+    for (int i = 0; i < 100; i++) {
+      ASYLO_ASSERT_OK(store->Put(absl::StrCat("key", i), absl::StrCat(i)));
+    }
+    ASYLO_ASSERT_OK(store->Delete("key7"));
+    ASYLO_ASSERT_OK(store->Commit());
+    head = store->head();
+    ASYLO_ASSERT_OK(store->Put("uncommitted", "value"));
+  }
+
+  auto store_result = OpenStore(fd_);
+  ASSERT_THAT(store_result, IsOk());
+  auto store = std::move(store_result).ValueOrDie();
+  EXPECT_THAT(store->head(), Eq(head));
+  EXPECT_THAT(store->size(), Eq(99));
+  EXPECT_THAT(store->Get("key42"), IsOkAndHolds("42"));
+  EXPECT_THAT(store->Get("key7"), StatusIs(error::GoogleError::NOT_FOUND));
+  EXPECT_THAT(store->Get("uncommitted"),
+              StatusIs(error::GoogleError::NOT_FOUND));
+}
+
+// Writes past the maximum batch size are committed as several batches.
+TEST_F(SecureKeyValueStoreTest, LargeBatchesAreSplit) {
+  SecureKeyValueStore::Options options;
+  options.max_batch_size = 256;
+  auto store_result = OpenStore(fd_, options);
+  ASSERT_THAT(store_result, IsOk());
+  auto store = std::move(store_result).ValueOrDie();
+  EXPECT_THAT(store->Put("key", std::string(512, 'x')),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+  for (int i = 0; i < 64; i++) {
+    ASYLO_ASSERT_OK(store->Put(absl::StrCat("key", i), std::string(16, 'x')));
+  }
+  EXPECT_THAT(store->log_size(), Gt(0));
+  ASYLO_ASSERT_OK(store->Commit());
+  std::vector<uint8_t> head = store->head();
+  store.reset();
+
+  store_result = OpenStore(fd_, options);
+  ASSERT_THAT(store_result, IsOk());
+  EXPECT_THAT(store_result.ValueOrDie()->size(), Eq(64));
+  EXPECT_THAT(store_result.ValueOrDie()->head(), Eq(head));
+}
+
+TEST_F(SecureKeyValueStoreTest, TamperedBatchFailsToOpen) {
+  {
+    auto store_result = OpenStore(fd_);
+    ASSERT_THAT(store_result, IsOk());
+    ASYLO_ASSERT_OK(store_result.ValueOrDie()->Put("key", "value"));
+    ASYLO_ASSERT_OK(store_result.ValueOrDie()->Commit());
+  }
+  UntrustedFile file(fd_);
+  size_t size;
+  ASYLO_ASSERT_OK_AND_ASSIGN(size, file.Size());
+  CorruptLog(size - 1);
+  EXPECT_THAT(OpenStore(fd_), StatusIs(error::GoogleError::DATA_LOSS));
+}
+
+TEST_F(SecureKeyValueStoreTest, WrongKeyFailsToOpen) {
+  {
+    auto store_result = OpenStore(fd_);
+    ASSERT_THAT(store_result, IsOk());
+    ASYLO_ASSERT_OK(store_result.ValueOrDie()->Put("key", "value"));
+    ASYLO_ASSERT_OK(store_result.ValueOrDie()->Commit());
+  }
+  EXPECT_THAT(SecureKeyValueStore::Open(absl::make_unique<UntrustedFile>(fd_),
+                                        "fedcba9876543210fedcba9876543210"),
+              StatusIs(error::GoogleError::DATA_LOSS));
+}
+
+// Batches are chained, so a log spliced together from two logs written with
+// the same key does not open.
+TEST_F(SecureKeyValueStoreTest, SplicedBatchFailsToOpen) {
+  int other_fd = CreateEmptyTempFileOrDie("secure_key_value_store_other.tmp");
+  platform::storage::FdCloser other_closer(other_fd);
+  size_t first_batch_size;
+  for (int fd : {fd_, other_fd}) {
+    auto store_result = OpenStore(fd);
+    ASSERT_THAT(store_result, IsOk());
+    auto store = std::move(store_result).ValueOrDie();
+    ASYLO_ASSERT_OK(store->Put("first", absl::StrCat(fd)));
+    ASYLO_ASSERT_OK(store->Commit());
+    first_batch_size = store->log_size();
+    ASYLO_ASSERT_OK(store->Put("second", absl::StrCat(fd)));
+    ASYLO_ASSERT_OK(store->Commit());
+  }
+
+  UntrustedFile file(fd_);
+  UntrustedFile other_file(other_fd);
+  size_t size;
+  ASYLO_ASSERT_OK_AND_ASSIGN(size, file.Size());
+  std::vector<uint8_t> second_batch(size - first_batch_size);
+  ASYLO_ASSERT_OK(other_file.Read(second_batch.data(), first_batch_size,
+                                  second_batch.size()));
+  ASYLO_ASSERT_OK(
+      file.Write(second_batch.data(), first_batch_size, second_batch.size()));
+  EXPECT_THAT(OpenStore(fd_), StatusIs(error::GoogleError::DATA_LOSS));
+}
+
+// A batch cut short at the end of the log is discarded, and the resulting head
+// reveals the lost batch.
+TEST_F(SecureKeyValueStoreTest, TornBatchIsDiscarded) {
+  std::vector<uint8_t> first_head;
+  std::vector<uint8_t> second_head;
+  {
+    auto store_result = OpenStore(fd_);
+    ASSERT_THAT(store_result, IsOk());
+    auto store = std::move(store_result).ValueOrDie();
+    ASYLO_ASSERT_OK(store->Put("first", "1"));
+    ASYLO_ASSERT_OK(store->Commit());
+    first_head = store->head();
+    ASYLO_ASSERT_OK(store->Put("second", "2"));
+    ASYLO_ASSERT_OK(store->Commit());
+    second_head = store->head();
+  }
+  UntrustedFile file(fd_);
+  size_t size;
+  ASYLO_ASSERT_OK_AND_ASSIGN(size, file.Size());
+  ASYLO_ASSERT_OK(file.Truncate(size - 4));
+
+  auto store_result = OpenStore(fd_);
+  ASSERT_THAT(store_result, IsOk());
+  auto store = std::move(store_result).ValueOrDie();
+  EXPECT_THAT(store->head(), Eq(first_head));
+  EXPECT_THAT(store->head(), Ne(second_head));
+  EXPECT_THAT(store->Get("first"), IsOkAndHolds("1"));
+  EXPECT_THAT(store->Get("second"), StatusIs(error::GoogleError::NOT_FOUND));
+  EXPECT_THAT(file.Size(), IsOkAndHolds(store->log_size()));
+
+  // The store keeps appending after the discarded batch.
+  ASYLO_ASSERT_OK(store->Put("third", "3"));
+  ASYLO_ASSERT_OK(store->Commit());
+  store.reset();
+  store_result = OpenStore(fd_);
+  ASSERT_THAT(store_result, IsOk());
+  EXPECT_THAT(store_result.ValueOrDie()->Get("third"), IsOkAndHolds("3"));
+}
+
+TEST_F(SecureKeyValueStoreTest, CompactTo) {
+  int compacted_fd = CreateEmptyTempFileOrDie("secure_key_value_store_new.tmp");
+  platform::storage::FdCloser compacted_closer(compacted_fd);
+  SecureKeyValueStore::Options options;
+  options.max_batch_size = 1024;
+
+  std::vector<uint8_t> head;
+  {
+    auto store_result = OpenStore(fd_, options);
+    ASSERT_THAT(store_result, IsOk());
+    auto store = std::move(store_result).ValueOrDie();
+    for (int round = 0; round < 10; round++) {
+      for (int i = 0; i < 50; i++) {
+        ASYLO_ASSERT_OK(store->Put(absl::StrCat("key", i),
+                                   absl::StrCat("value", round)));
+      }
+      ASYLO_ASSERT_OK(store->Commit());
+    }
+    EXPECT_TRUE(store->NeedsCompaction());
+
+    size_t log_size = store->log_size();
+    ASYLO_ASSERT_OK(
+        store->CompactTo(absl::make_unique<UntrustedFile>(compacted_fd)));
+    EXPECT_THAT(store->log_size(), Lt(log_size));
+    EXPECT_FALSE(store->NeedsCompaction());
+    ASYLO_ASSERT_OK(store->Put("key0", "latest"));
+    ASYLO_ASSERT_OK(store->Commit());
+    head = store->head();
+  }
+
+  auto store_result = OpenStore(compacted_fd, options);
+  ASSERT_THAT(store_result, IsOk());
+  auto store = std::move(store_result).ValueOrDie();
+  EXPECT_THAT(store->head(), Eq(head));
+  EXPECT_THAT(store->size(), Eq(50));
+  EXPECT_THAT(store->Get("key0"), IsOkAndHolds("latest"));
+  EXPECT_THAT(store->Get("key49"), IsOkAndHolds("value9"));
+}
+
+}  // namespace
+}  // namespace asylo
@@ -22,16 +22,28 @@
 
 // IO syscall interface constants.
 #include <fcntl.h>
+#include <sys/stat.h>
 
+#include <algorithm>
 #include <iomanip>
 #include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
+#include "absl/memory/memory.h"
 #include "absl/strings/escaping.h"
 #include "absl/synchronization/mutex.h"
 #include "asylo/crypto/util/byte_container_view.h"
 #include "asylo/crypto/util/bytes.h"
 #include "asylo/platform/host_call/trusted/host_calls.h"
+#include "asylo/platform/storage/secure/flat_authenticated_dictionary.h"
 #include "asylo/platform/storage/utils/fd_closer.h"
+#include "asylo/platform/storage/utils/random_access_storage.h"
+#include "asylo/util/posix_error_space.h"
+#include "asylo/util/status.h"
+#include "asylo/util/status_macros.h"
+#include "asylo/util/statusor.h"
 
 namespace asylo {
 namespace platform {
@@ -101,9 +113,113 @@ ssize_t write_all(int fd, const void *buf, size_t len) {
   return offset;
 }
 
+// Host file holding the Merkle tree nodes of a secure file. The file is opened
+// on first access, so that it is only created once there are nodes to write.
+class MerkleTreeFile : public RandomAccessStorage {
+ public:
+  explicit MerkleTreeFile(std::string path) : path_(std::move(path)) {}
+
+  ~MerkleTreeFile() override {
+    if (fd_ != -1) {
+      enc_untrusted_close(fd_);
+    }
+  }
+
+  StatusOr<size_t> Size() const override {
+    ASYLO_RETURN_IF_ERROR(Open());
+    off_t size = enc_untrusted_lseek(fd_, 0, SEEK_END);
+    if (size == -1) {
+      return PosixError("lseek() failed in MerkleTreeFile::Size()");
+    }
+    return static_cast<size_t>(size);
+  }
+
+  Status Read(void *buffer, off_t offset, size_t size) override {
+    ASYLO_RETURN_IF_ERROR(Open());
+    uint8_t *data = static_cast<uint8_t *>(buffer);
+    while (size > 0) {
+      int bytes_read = enc_untrusted_pread64(fd_, data, size, offset);
+      if (bytes_read == -1 && is_transient_error(errno)) {
+        continue;
+      }
+      if (bytes_read == -1) {
+        return PosixError("pread() failed in MerkleTreeFile::Read()");
+      }
+      if (bytes_read == 0) {
+        return Status{error::NOT_FOUND,
+                      "Read past the end of the Merkle tree file"};
+      }
+      data += bytes_read;
+      offset += bytes_read;
+      size -= bytes_read;
+    }
+    return Status::OkStatus();
+  }
+
+  Status Write(const void *buffer, off_t offset, size_t size) override {
+    ASYLO_RETURN_IF_ERROR(Open());
+    const uint8_t *data = static_cast<const uint8_t *>(buffer);
+    while (size > 0) {
+      int bytes_written = enc_untrusted_pwrite64(fd_, data, size, offset);
+      if (bytes_written == -1 && is_transient_error(errno)) {
+        continue;
+      }
+      if (bytes_written <= 0) {
+        return PosixError("pwrite() failed in MerkleTreeFile::Write()");
+      }
+      data += bytes_written;
+      offset += bytes_written;
+      size -= bytes_written;
+    }
+    return Status::OkStatus();
+  }
+
+  Status Sync() override {
+    ASYLO_RETURN_IF_ERROR(Open());
+    if (enc_untrusted_fsync(fd_) == -1) {
+      return PosixError("fsync() failed in MerkleTreeFile::Sync()");
+    }
+    return Status::OkStatus();
+  }
+
+  Status Truncate(size_t size) override {
+    ASYLO_RETURN_IF_ERROR(Open());
+    if (enc_untrusted_ftruncate(fd_, size) == -1) {
+      return PosixError("ftruncate() failed in MerkleTreeFile::Truncate()");
+    }
+    return Status::OkStatus();
+  }
+
+ private:
+  static Status PosixError(const char *message) {
+    return Status{static_cast<error::PosixError>(errno), message};
+  }
+
+  // Opens the file unless it is already open. Falls back to read-only access
+  // if the file cannot be opened for writing.
+  Status Open() const {
+    if (fd_ != -1) {
+      return Status::OkStatus();
+    }
+    fd_ = enc_untrusted_open(path_.c_str(), O_RDWR | O_CREAT,
+                             S_IRUSR | S_IWUSR);
+    if (fd_ == -1) {
+      fd_ = enc_untrusted_open(path_.c_str(), O_RDONLY);
+    }
+    if (fd_ == -1) {
+      return PosixError("open() failed in MerkleTreeFile::Open()");
+    }
+    return Status::OkStatus();
+  }
+
+  const std::string path_;
+  mutable int fd_ = -1;
+};
+
 // Returns offset to the plaintext buffer associated with the |block_index| of
-// a full block.
-const uint8_t *GetPlaintextBuffer(size_t first_partial_block_bytes_count,
+// a full block of |block_length| bytes.
+const uint8_t *GetPlaintextBuffer(size_t block_length,
+                                  size_t first_partial_block_bytes_count,
                                   int64_t block_index, const void *buf) {
   const uint8_t *plaintext_data = reinterpret_cast<const uint8_t *>(buf);
   if (first_partial_block_bytes_count > 0) {
@@ -111,29 +227,27 @@ const uint8_t *GetPlaintextBuffer(size_t first_partial_block_bytes_count,
       plaintext_data += first_partial_block_bytes_count;
     }
     if (block_index > 1) {
-      plaintext_data += (block_index - 1) * kBlockLength;
+      plaintext_data += (block_index - 1) * block_length;
     }
   } else {
-    plaintext_data += block_index * kBlockLength;
+    plaintext_data += block_index * block_length;
   }
 
   return plaintext_data;
 }
 
-uint8_t *GetPlaintextBuffer(size_t first_partial_block_bytes_count,
+uint8_t *GetPlaintextBuffer(size_t block_length,
+                            size_t first_partial_block_bytes_count,
                             int64_t block_index, void *buf) {
   return const_cast<uint8_t *>(
-      GetPlaintextBuffer(first_partial_block_bytes_count, block_index,
-                         const_cast<const void *>(buf)));
+      GetPlaintextBuffer(block_length, first_partial_block_bytes_count,
+                         block_index, const_cast<const void *>(buf)));
 }
 
 }  // namespace
 
 using Tag = UnsafeBytes<kTagLength>;
 using Token = UnsafeBytes<kTokenLength>;
-using Block = UnsafeBytes<kBlockLength>;
-using Ciphertext = UnsafeBytes<kCipherBlockLength>;
-using SecureBlock = UnsafeBytes<kSecureBlockLength>;
 
 using TagView = ByteContainerView;
 using TokenView = ByteContainerView;
@@ -141,9 +255,38 @@ using BlockView = ByteContainerView;
 using CiphertextView = ByteContainerView;
 using SecureBlockView = ByteContainerView;
 
-AeadHandler::AeadHandler()
-    : offset_translator_(OffsetTranslator::Create(
-          sizeof(FileHeader), kBlockLength, kSecureBlockLength)) {}
+AeadHandler::FileControl::FileControl(const char *path_name, bool is_new_file)
+    : path(path_name),
+      logical_size(0),
+      is_new(is_new_file),
+      is_deserialized(false),
+      max_dirty_bytes(0),
+      dirty_bytes(0) {
+  set_tree_storage(MerkleTreeStorage::kPersistent);
+  UnsafeBytes<kTagLength> tag;
+  memset(tag.data(), 0, kTagLength);
+  std::string tag_string(reinterpret_cast<char *>(tag.data()), kTagLength);
+  zero_hash = ad->LeafHash(tag_string);
+  set_layout(kCurrentHeaderVersion, kDefaultBlockLength);
+}
+
+void AeadHandler::FileControl::set_tree_storage(MerkleTreeStorage storage) {
+  tree_storage = storage;
+  if (storage == MerkleTreeStorage::kPersistent) {
+    auto dictionary = absl::make_unique<PersistentAuthenticatedDictionary>(
+        absl::make_unique<MerkleTreeFile>(path + kMerkleTreeFileSuffix));
+    persistent_ad = dictionary.get();
+    ad = std::move(dictionary);
+  } else {
+    persistent_ad = nullptr;
+    ad = absl::make_unique<FlatAuthenticatedDictionary>();
+  }
+}
+
+bool AeadHandler::IsValidBlockLength(size_t block_length) {
+  return block_length >= kMinBlockLength && block_length <= kMaxBlockLength &&
+         (block_length & (block_length - 1)) == 0;
+}
 
 bool AeadHandler::Deserialize(FileControl *file_ctrl) {
   if (!file_ctrl) {
@@ -152,12 +295,12 @@ bool AeadHandler::Deserialize(FileControl *file_ctrl) {
   }
   file_ctrl->mu.AssertHeld();
 
-  const GcmCryptor *cryptor = GetGcmCryptor(*file_ctrl);
-  if (!cryptor) {
-    return false;
-  }
-
   if (file_ctrl->is_new) {
+    const GcmCryptor *cryptor = GetGcmCryptor(*file_ctrl);
+    if (!cryptor) {
+      return false;
+    }
+
     if (!UpdateDigest(file_ctrl, *cryptor)) {
       LOG(ERROR) << "Failed to update header on a new file, path="
                  << file_ctrl->path << ", errno = " << errno;
@@ -180,62 +323,103 @@ bool AeadHandler::Deserialize(FileControl *file_ctrl) {
 
   FdCloser fd_closer(fd, &enc_untrusted_close);
 
-  // Read the header with digest.
+  // Read the header with digest. A legacy header is shorter, and is followed
+  // by the first block if there is one.
   FileHeader file_header;
   ssize_t bytes_read = read_all(fd, file_header.data(), sizeof(FileHeader));
-  if (bytes_read != sizeof(FileHeader)) {
+  if (bytes_read < static_cast<ssize_t>(HeaderLength(kLegacyHeaderVersion))) {
+    LOG(ERROR) << "Failed to read the file header, bytes read = " << bytes_read;
+    return false;
+  }
+  const uint8_t header_version = file_header.versioned_size >> kFileSizeBits;
+  const size_t file_size = file_header.versioned_size & kFileSizeMask;
+  if (header_version > kCurrentHeaderVersion) {
+    LOG(ERROR) << "Unsupported file header version, path=" << file_ctrl->path
+               << ", version = " << static_cast<int>(header_version);
+    return false;
+  }
+  if (header_version == kLegacyHeaderVersion) {
+    // Legacy files have no Merkle tree file, their tree is rebuilt from the
+    // block tags as it was when they were written.
+    file_header.block_length = kDefaultBlockLength;
+    file_header.tree_storage =
+        static_cast<uint32_t>(MerkleTreeStorage::kInMemory);
+  } else if (bytes_read != sizeof(FileHeader)) {
     LOG(ERROR) << "Failed to read the file header, bytes read = " << bytes_read;
     return false;
   }
 
-  // In order to validate the integrity metadata and the file size have to first
-  // collect integrity metadata across the file using the initially untrusted
-  // value of the file size - then validation of the hash of the file digest
-  // confirms validity of both the file size and the integrity metadata.
-  const int64_t blocks_count =
-      (file_header.file_size + kBlockLength - 1) / kBlockLength;
-  Tag tag;
-  for (int64_t block_index = 0; block_index < blocks_count; block_index++) {
-    off_t offset = enc_untrusted_lseek(fd, kBlockLength, SEEK_CUR);
-    if (offset == -1) {
-      LOG(ERROR)
-          << "Failed lseek past block when collecting integrity metadata.";
-      return false;
-    }
+  // The block length is validated along with the file size below, but has to
+  // be sane before it is used to walk the file.
+  if (!IsValidBlockLength(file_header.block_length)) {
+    LOG(ERROR) << "Unsupported block length in the file header, path="
+               << file_ctrl->path
+               << ", block length = " << file_header.block_length;
+    return false;
+  }
+  file_ctrl->set_layout(header_version, file_header.block_length);
+  const size_t block_length = file_ctrl->block_length;
+  if (enc_untrusted_lseek(fd, HeaderLength(header_version), SEEK_SET) == -1) {
+    LOG(ERROR) << "Failed lseek past the file header, path="
+               << file_ctrl->path;
+    return false;
+  }
 
-    bytes_read = read_all(fd, tag.data(), kTagLength);
-    if (bytes_read != kTagLength) {
-      LOG(ERROR) << "Failed to read integrity metadata, bytes_read="
-                 << bytes_read;
-      return false;
-    }
+  const auto tree_storage =
+      static_cast<MerkleTreeStorage>(file_header.tree_storage);
+  if (tree_storage != MerkleTreeStorage::kPersistent &&
+      tree_storage != MerkleTreeStorage::kInMemory) {
+    LOG(ERROR) << "Unsupported Merkle tree storage in the file header, path="
+               << file_ctrl->path
+               << ", tree storage = " << file_header.tree_storage;
+    return false;
+  }
+  file_ctrl->set_tree_storage(tree_storage);
 
-    std::string tag_string(reinterpret_cast<char *>(tag.data()), kTagLength);
-    VLOG(2) << "Adding auth tag as leaf to rebuild Merkle tree: "
-            << absl::BytesToHexString(tag_string);
-    file_ctrl->ad->AddLeaf(tag_string);
+  const GcmCryptor *cryptor = GetGcmCryptor(*file_ctrl);
+  if (!cryptor) {
+    return false;
+  }
 
-    offset = enc_untrusted_lseek(fd, kTokenLength, SEEK_CUR);
-    if (offset == -1) {
-      LOG(ERROR)
-          << "Failed lseek past token when collecting integrity metadata.";
-      return false;
+  // In order to validate the integrity metadata and the file size have to first
+  // load the Merkle tree using the initially untrusted value of the file size -
+  // then validation of the hash of the file digest confirms validity of both
+  // the file size and the roots of the tree. The remaining nodes of a
+  // persistent tree are verified against those roots as they are loaded.
+  const size_t blocks_count = (file_size + block_length - 1) / block_length;
+  bool tree_rebuilt = false;
+  if (file_ctrl->persistent_ad) {
+    if (!file_ctrl->persistent_ad->Load(blocks_count)) {
+      // The Merkle tree file is missing or truncated, for instance because the
+      // file was copied without it. The tree rebuilt from the block tags is
+      // verified against the digest like a loaded one.
+      LOG(WARNING) << "Rebuilding the Merkle tree from the file, path="
+                   << file_ctrl->path;
+      if (!file_ctrl->persistent_ad->Load(0) ||
+          !RebuildTree(fd, blocks_count, file_ctrl)) {
+        return false;
+      }
+      tree_rebuilt = true;
     }
+  } else if (!RebuildTree(fd, blocks_count, file_ctrl)) {
+    return false;
   }
 
-  VLOG(2) << "Pushed block auth tags on initialization.";
+  VLOG(2) << "Loaded Merkle tree on initialization.";
 
   // Prepare file data digest.
   DataDigest data_digest;
   std::copy_n(
       reinterpret_cast<const uint8_t *>(file_ctrl->ad->CurrentRoot().data()),
       kRootHashLength, data_digest.data());
-  data_digest.file_size = file_header.file_size;
+  data_digest.versioned_size = file_header.versioned_size;
+  data_digest.block_length = file_header.block_length;
+  data_digest.tree_storage = file_header.tree_storage;
 
-  // Validate AD root and the file size.
+  // Validate AD root, the file size, the header version and the layout.
   FileHash new_hash;
   if (!cryptor->GetAuthTag(new_hash.data(), data_digest.data(),
-                           sizeof(DataDigest))) {
+                           DigestLength(header_version))) {
     LOG(ERROR) << "Failed to generate CMAC for integrity verification, root="
                << file_ctrl->ad->CurrentRoot();
     return false;
@@ -248,7 +432,55 @@ bool AeadHandler::Deserialize(FileControl *file_ctrl) {
     return false;
   }
 
-  file_ctrl->logical_size = file_header.file_size;
+  // Write out the rebuilt tree only once it is known to be authentic. If it
+  // cannot be written, its nodes stay in trusted memory until the next flush.
+  if (tree_rebuilt && !file_ctrl->persistent_ad->Flush()) {
+    LOG(WARNING) << "Failed to write the rebuilt Merkle tree, path="
+                 << file_ctrl->path;
+  }
+
+  file_ctrl->logical_size = file_size;
+  return true;
+}
+
+bool AeadHandler::RebuildTree(int fd, size_t blocks_count,
+                              FileControl *file_ctrl) const {
+  file_ctrl->mu.AssertHeld();
+  const size_t block_length = file_ctrl->block_length;
+  PersistentAuthenticatedDictionary *persistent_ad =
+      file_ctrl->persistent_ad;
+  FlatAuthenticatedDictionary *flat_ad = nullptr;
+  if (!persistent_ad) {
+    flat_ad = static_cast<FlatAuthenticatedDictionary *>(file_ctrl->ad.get());
+    flat_ad->Reserve(blocks_count);
+  }
+
+  Tag tag;
+  for (size_t block_index = 0; block_index < blocks_count; block_index++) {
+    if (enc_untrusted_lseek(fd, block_length, SEEK_CUR) == -1) {
+      LOG(ERROR) << "Failed lseek past block when rebuilding the Merkle tree.";
+      return false;
+    }
+
+    ssize_t bytes_read = read_all(fd, tag.data(), kTagLength);
+    if (bytes_read != kTagLength) {
+      LOG(ERROR) << "Failed to read integrity metadata, bytes_read="
+                 << bytes_read;
+      return false;
+    }
+    if (persistent_ad) {
+      persistent_ad->AddLeafHash(persistent_ad->LeafHash(std::string(
+          reinterpret_cast<const char *>(tag.data()), kTagLength)));
+    } else {
+      flat_ad->AddLeafDigest(
+          FlatAuthenticatedDictionary::HashLeaf(tag.data(), kTagLength));
+    }
+
+    if (enc_untrusted_lseek(fd, kTokenLength, SEEK_CUR) == -1) {
+      LOG(ERROR) << "Failed lseek past token when rebuilding the Merkle tree.";
+      return false;
+    }
+  }
   return true;
 }
 
@@ -285,7 +517,9 @@ bool AeadHandler::InitializeFile(int fd, const char *path_name,
   return true;
 }
 
-bool AeadHandler::RetrieveLogicalOffset(int fd, off_t *logical_offset) const {
+bool AeadHandler::RetrieveLogicalOffset(int fd, const FileControl &file_ctrl,
+                                        off_t *logical_offset) const {
+  file_ctrl.mu.AssertReaderHeld();
   if (fd < 0) {
     errno = EINVAL;
     return false;
@@ -297,7 +531,8 @@ bool AeadHandler::RetrieveLogicalOffset(int fd, off_t *logical_offset) const {
     return false;
   }
 
-  *logical_offset = offset_translator_->PhysicalToLogical(physical_offset);
+  *logical_offset =
+      file_ctrl.offset_translator->PhysicalToLogical(physical_offset);
   if (*logical_offset == OffsetTranslator::kInvalidOffset) {
     LOG(ERROR) << "The file is corrupted, fd = " << fd;
     return false;
@@ -307,14 +542,14 @@ bool AeadHandler::RetrieveLogicalOffset(int fd, off_t *logical_offset) const {
 }
 
 GcmCryptor *AeadHandler::GetGcmCryptor(const FileControl &file_ctrl) const {
-  file_ctrl.mu.AssertHeld();
+  file_ctrl.mu.AssertReaderHeld();
   if (!file_ctrl.master_key) {
     LOG(ERROR) << "Master key has not been set, path = " << file_ctrl.path;
     return nullptr;
   }
 
   GcmCryptor *cryptor = GcmCryptorRegistry::GetInstance().GetGcmCryptor(
-      kBlockLength, *file_ctrl.master_key);
+      file_ctrl.block_length, *file_ctrl.master_key);
   if (!cryptor) {
     LOG(ERROR) << "Unable to instantiate GCM cryptor.";
   }
@@ -328,33 +563,47 @@ ssize_t AeadHandler::DecryptAndVerify(int fd, void *buf, size_t count) {
     return -1;
   }
 
+  std::shared_ptr<FileControl> file_ctrl = FindFileControl(fd);
+  if (!file_ctrl) {
+    LOG(ERROR) << "Attempt made to read from an unopened file, fd = " << fd;
+    return -1;
+  }
+
+  // Descriptors of the same file have separate cursors, and the caller
+  // serializes uses of one descriptor, so a shared lock suffices.
+  absl::ReaderMutexLock lock(&file_ctrl->mu);
   off_t logical_offset;
-  if (!RetrieveLogicalOffset(fd, &logical_offset)) {
+  if (!RetrieveLogicalOffset(fd, *file_ctrl, &logical_offset)) {
     return -1;
   }
 
-  std::shared_ptr<FileControl> file_ctrl;
-  {
-    absl::MutexLock global_lock(&mu_);
+  return DecryptAndVerifyInternal(fd, buf, count, *file_ctrl, logical_offset,
+                                  /*move_cursor=*/true);
+}
 
-    auto entry = fmap_.find(fd);
-    if (entry == fmap_.end()) {
-      LOG(ERROR) << "Attempt made to read from an unopened file, fd = " << fd;
-      errno = ENOENT;
-      return -1;
-    }
+ssize_t AeadHandler::DecryptAndVerifyAt(int fd, void *buf, size_t count,
+                                        off_t logical_offset) {
+  if (!buf || logical_offset < 0) {
+    errno = EINVAL;
+    return -1;
+  }
 
-    file_ctrl = entry->second;
+  std::shared_ptr<FileControl> file_ctrl = FindFileControl(fd);
+  if (!file_ctrl) {
+    LOG(ERROR) << "Attempt made to read from an unopened file, fd = " << fd;
+    return -1;
   }
 
-  absl::MutexLock lock(&file_ctrl->mu);
-  return DecryptAndVerifyInternal(fd, buf, count, *file_ctrl, logical_offset);
+  absl::ReaderMutexLock lock(&file_ctrl->mu);
+  return DecryptAndVerifyInternal(fd, buf, count, *file_ctrl, logical_offset,
+                                  /*move_cursor=*/false);
 }
 
 ssize_t AeadHandler::DecryptAndVerifyInternal(int fd, void *buf, size_t count,
                                               const FileControl &file_ctrl,
-                                              off_t logical_offset) const {
-  file_ctrl.mu.AssertHeld();
+                                              off_t logical_offset,
+                                              bool move_cursor) const {
+  file_ctrl.mu.AssertReaderHeld();
   if (count == 0) {
     return 0;
   }
@@ -369,42 +618,39 @@ ssize_t AeadHandler::DecryptAndVerifyInternal(int fd, void *buf, size_t count,
     count = file_ctrl.logical_size - logical_offset;
   }
 
+  const size_t block_length = file_ctrl.block_length;
+  const size_t cipher_block_length = CipherBlockLength(block_length);
+  const size_t secure_block_length = SecureBlockLength(block_length);
+  const OffsetTranslator &offset_translator = *file_ctrl.offset_translator;
+
   // Determine data breakdown into logical blocks.
   size_t first_partial_block_bytes_count;
   size_t last_partial_block_bytes_count;
   size_t full_inclusive_blocks_bytes_count;
-  offset_translator_->ReduceLogicalRangeToFullLogicalBlocks(
+  offset_translator.ReduceLogicalRangeToFullLogicalBlocks(
       logical_offset, count, &first_partial_block_bytes_count,
       &last_partial_block_bytes_count, &full_inclusive_blocks_bytes_count);
 
   // Use single read buffer to minimize the number of read calls to the host.
   std::vector<uint8_t> buffer;
   const size_t physical_bytes_count =
-      (full_inclusive_blocks_bytes_count / kBlockLength) * kSecureBlockLength;
+      (full_inclusive_blocks_bytes_count / block_length) * secure_block_length;
   buffer.resize(physical_bytes_count);
 
-  // Move cursor to the first full block to read.
+  // Locate the first full block to read.
   const off_t first_logical_block_offset =
       (first_partial_block_bytes_count > 0)
-          ? (logical_offset + first_partial_block_bytes_count - kBlockLength)
+          ? (logical_offset + first_partial_block_bytes_count - block_length)
           : logical_offset;
   const off_t first_physical_block_offset =
-      offset_translator_->LogicalToPhysical(first_logical_block_offset);
-  if (first_partial_block_bytes_count > 0) {
-    off_t offset =
-        enc_untrusted_lseek(fd, first_physical_block_offset, SEEK_SET);
-    if (offset == -1) {
-      LOG(ERROR)
-          << "Failed lseek to the fist block offset when reading file data.";
-      return -1;
-    }
-  }
+      offset_translator.LogicalToPhysical(first_logical_block_offset);
 
   // Perform the read. Read may have been requested beyond EOF - cannot require
   // that bytes_read is equal to physical_bytes_count. The read was not
-  // requested at EOF - checked this above.
-  ssize_t bytes_read =
-      enc_untrusted_read(fd, buffer.data(), physical_bytes_count);
+  // requested at EOF - checked this above. The read is positional, so that
+  // concurrent readers of |fd| do not depend on its cursor.
+  ssize_t bytes_read = enc_untrusted_pread64(
+      fd, buffer.data(), physical_bytes_count, first_physical_block_offset);
   if (bytes_read <= 0) {
     LOG(ERROR) << "Cannot verify data - data has not been read, fd = " << fd;
     return -1;
@@ -412,7 +658,7 @@ ssize_t AeadHandler::DecryptAndVerifyInternal(int fd, void *buf, size_t count,
 
   // Process only complete blocks read, since need per-block metadata to decrypt
   // the block.
-  bytes_read = (bytes_read / kSecureBlockLength) * kSecureBlockLength;
+  bytes_read = (bytes_read / secure_block_length) * secure_block_length;
   if (bytes_read == 0) {
     LOG(ERROR) << "Cannot verify data - data has not been read, fd = " << fd;
     return -1;
@@ -422,19 +668,21 @@ ssize_t AeadHandler::DecryptAndVerifyInternal(int fd, void *buf, size_t count,
   off_t new_cur_logical_offset = logical_offset + count;
   if (bytes_read != physical_bytes_count) {
     int64_t blocks_not_read =
-        (physical_bytes_count - bytes_read) / kSecureBlockLength;
+        (physical_bytes_count - bytes_read) / secure_block_length;
     if (last_partial_block_bytes_count > 0) {
       new_cur_logical_offset -= last_partial_block_bytes_count;
       blocks_not_read--;
     }
-    new_cur_logical_offset -= blocks_not_read * kBlockLength;
+    new_cur_logical_offset -= blocks_not_read * block_length;
   }
-  const off_t new_cur_physical_offset =
-      offset_translator_->LogicalToPhysical(new_cur_logical_offset);
-  off_t offset = enc_untrusted_lseek(fd, new_cur_physical_offset, SEEK_SET);
-  if (offset == -1) {
-    LOG(ERROR) << "Failed lseek to the end of read range.";
-    return -1;
+  if (move_cursor) {
+    const off_t new_cur_physical_offset =
+        offset_translator.LogicalToPhysical(new_cur_logical_offset);
+    off_t offset = enc_untrusted_lseek(fd, new_cur_physical_offset, SEEK_SET);
+    if (offset == -1) {
+      LOG(ERROR) << "Failed lseek to the end of read range.";
+      return -1;
+    }
   }
 
   GcmCryptor *cryptor = GetGcmCryptor(file_ctrl);
@@ -443,58 +691,64 @@ ssize_t AeadHandler::DecryptAndVerifyInternal(int fd, void *buf, size_t count,
   }
 
   // Cycle through blocks.
-  const int64_t blocks_read = bytes_read / kSecureBlockLength;
-  const int64_t blocks_read_max = physical_bytes_count / kSecureBlockLength;
+  const int64_t blocks_read = bytes_read / secure_block_length;
+  const int64_t blocks_read_max = physical_bytes_count / secure_block_length;
   const off_t first_block_index =
-      (first_physical_block_offset - sizeof(FileHeader)) / kSecureBlockLength;
+      (first_physical_block_offset - HeaderLength(file_ctrl.header_version)) /
+      secure_block_length;
   size_t read_count = 0;
+  // Bounce block for reading partial blocks at the ends of the full range.
+  std::vector<uint8_t> bounce_block;
   for (int64_t block_index = 0; block_index < blocks_read; block_index++) {
     const size_t merkle_block_idx = first_block_index + block_index + 1;
 
-    uint8_t *plaintext_data =
-        GetPlaintextBuffer(first_partial_block_bytes_count, block_index, buf);
+    uint8_t *plaintext_data = GetPlaintextBuffer(
+        block_length, first_partial_block_bytes_count, block_index, buf);
+
+    // Loading the leaf verifies it, and the tree nodes on its path, against the
+    // file digest.
+    const std::string leaf_hash = file_ctrl.ad->LeafHash(merkle_block_idx);
+    if (leaf_hash.empty()) {
+      LOG(ERROR) << "Failed to load integrity metadata, fd = " << fd;
+      return -1;
+    }
 
     // Detect full blocks that belong to sparse regions in the file - no need to
     // decrypt.
-    if (file_ctrl.ad->LeafHash(merkle_block_idx) == file_ctrl.zero_hash) {
+    if (leaf_hash == file_ctrl.zero_hash) {
       VLOG(2) << "A sparse region block detected.";
-      memset(plaintext_data, 0, kBlockLength);
-      read_count += kBlockLength;
+      memset(plaintext_data, 0, block_length);
+      read_count += block_length;
       continue;
     }
 
-    CiphertextView ciphertext(buffer.data() + block_index * kSecureBlockLength,
-                              kCipherBlockLength);
+    CiphertextView ciphertext(buffer.data() + block_index * secure_block_length,
+                              cipher_block_length);
     VLOG(2) << "Ciphertext read: "
             << absl::BytesToHexString(absl::string_view(
                    reinterpret_cast<const char *>(ciphertext.data()),
-                   kCipherBlockLength));
+                   cipher_block_length));
 
-    TagView tag(buffer.data() + block_index * kSecureBlockLength + kBlockLength,
-                kTagLength);
+    TagView tag(
+        buffer.data() + block_index * secure_block_length + block_length,
+        kTagLength);
     VLOG(2) << "Auth tag read: "
             << absl::BytesToHexString(absl::string_view(
                    reinterpret_cast<const char *>(tag.data()), kTagLength));
 
     TokenView token(
-        buffer.data() + block_index * kSecureBlockLength + kCipherBlockLength,
+        buffer.data() + block_index * secure_block_length + cipher_block_length,
         kTokenLength);
     VLOG(2) << "Token read: "
             << absl::BytesToHexString(absl::string_view(
                    reinterpret_cast<const char *>(token.data()), kTokenLength));
 
-    // Note: Verifying integrity tag will be replaced with integrity
-    // verification against AD root if/when AD tree will be stored in a file
-    // (i.e. if/when optimizing integrity assurance for large files).
-    if (file_ctrl.ad->LeafHash(merkle_block_idx) !=
-        file_ctrl.ad->LeafHash(std::string(
+    if (leaf_hash != file_ctrl.ad->LeafHash(std::string(
             reinterpret_cast<const char *>(tag.data()), kTagLength))) {
       LOG(ERROR) << "Integrity verification failed, fd = " << fd;
       return -1;
     }
 
-    // Bounce block for reading partial blocks at the ends of the full range.
-    Block bounce_block;
     // Target for decryption - bounce block or the supplied buffer.
     uint8_t *decrypt_target;
     // Determine the target depending on whether the read block is at the end of
@@ -502,6 +756,7 @@ ssize_t AeadHandler::DecryptAndVerifyInternal(int fd, void *buf, size_t count,
     if ((block_index == 0 && first_partial_block_bytes_count > 0) ||
         (block_index == blocks_read_max - 1 &&
          last_partial_block_bytes_count > 0)) {
+      bounce_block.resize(block_length);
       decrypt_target = bounce_block.data();
     } else {
       decrypt_target = plaintext_data;
@@ -518,7 +773,7 @@ ssize_t AeadHandler::DecryptAndVerifyInternal(int fd, void *buf, size_t count,
     // bytes.
     if (block_index == 0 && first_partial_block_bytes_count > 0) {
       std::copy_n(
-          bounce_block.begin() + kBlockLength - first_partial_block_bytes_count,
+          bounce_block.begin() + block_length - first_partial_block_bytes_count,
           first_partial_block_bytes_count, plaintext_data);
       read_count += first_partial_block_bytes_count;
     } else if (block_index == blocks_read_max - 1 &&
@@ -527,7 +782,7 @@ ssize_t AeadHandler::DecryptAndVerifyInternal(int fd, void *buf, size_t count,
                   plaintext_data);
       read_count += last_partial_block_bytes_count;
     } else {
-      read_count += kBlockLength;
+      read_count += block_length;
     }
   }
 
@@ -553,6 +808,12 @@ bool AeadHandler::UpdateDigest(FileControl *file_ctrl,
 
   FdCloser fd_closer(fd, &enc_untrusted_close);
 
+  // The tree has to be persisted before the digest which covers it.
+  if (file_ctrl->persistent_ad && !file_ctrl->persistent_ad->Flush()) {
+    LOG(ERROR) << "Failed to persist the Merkle tree, path=" << file_ctrl->path;
+    return false;
+  }
+
   std::string root = file_ctrl->ad->CurrentRoot();
   if (root.size() != kRootHashLength) {
     LOG(ERROR) << "Unexpected size of root hash encountered, size="
@@ -560,24 +821,38 @@ bool AeadHandler::UpdateDigest(FileControl *file_ctrl,
     return false;
   }
 
-  // Prepare file data digest.
+  if (file_ctrl->logical_size > kFileSizeMask) {
+    LOG(ERROR) << "File size exceeds the header limit, path="
+               << file_ctrl->path;
+    errno = EFBIG;
+    return false;
+  }
+
+  // Prepare file data digest, in the layout of the header version of the file.
+  const uint8_t version = file_ctrl->header_version;
   DataDigest data_digest;
   std::copy_n(reinterpret_cast<const uint8_t *>(root.data()), kRootHashLength,
               data_digest.data());
-  data_digest.file_size = file_ctrl->logical_size;
+  data_digest.versioned_size =
+      file_ctrl->logical_size | (uint64_t{version} << kFileSizeBits);
+  data_digest.block_length = file_ctrl->block_length;
+  data_digest.tree_storage = static_cast<uint32_t>(file_ctrl->tree_storage);
 
   FileHeader header;
   if (!cryptor.GetAuthTag(header.data(), data_digest.data(),
-                          sizeof(DataDigest))) {
+                          DigestLength(version))) {
     LOG(ERROR) << "Failed to generate CMAC, root = " << root;
     return false;
   }
-  header.file_size = file_ctrl->logical_size;
+  header.versioned_size = data_digest.versioned_size;
+  header.block_length = data_digest.block_length;
+  header.tree_storage = data_digest.tree_storage;
 
   VLOG(2) << "Updating the digest for file: " << file_ctrl->path
           << ", root hash: " << absl::BytesToHexString(root);
-  ssize_t bytes_written = write_all(fd, header.data(), sizeof(FileHeader));
-  if (bytes_written != sizeof(FileHeader)) {
+  const ssize_t header_length = HeaderLength(version);
+  ssize_t bytes_written = write_all(fd, header.data(), header_length);
+  if (bytes_written != header_length) {
     LOG(ERROR) << "Failed to write full digest to file, path="
                << file_ctrl->path << ", bytes written = " << bytes_written;
     return false;
@@ -592,10 +867,26 @@ bool AeadHandler::UpdateDigest(FileControl *file_ctrl,
   return true;
 }
 
+bool AeadHandler::FlushDigest(FileControl *file_ctrl) const {
+  file_ctrl->mu.AssertHeld();
+  if (file_ctrl->dirty_bytes == 0) {
+    return true;
+  }
+
+  GcmCryptor *cryptor = GetGcmCryptor(*file_ctrl);
+  if (!cryptor || !UpdateDigest(file_ctrl, *cryptor)) {
+    return false;
+  }
+
+  file_ctrl->dirty_bytes = 0;
+  return true;
+}
+
 bool AeadHandler::ReadFullBlock(const FileControl &file_ctrl,
-                                off_t logical_offset, Block *block) const {
+                                off_t logical_offset, uint8_t *block) const {
   file_ctrl.mu.AssertHeld();
-  if (logical_offset < 0 || logical_offset % kBlockLength != 0) {
+  const size_t block_length = file_ctrl.block_length;
+  if (logical_offset < 0 || logical_offset % block_length != 0) {
     errno = EINVAL;
     return false;
   }
@@ -609,21 +900,15 @@ bool AeadHandler::ReadFullBlock(const FileControl &file_ctrl,
 
   FdCloser fd_closer(fd, &enc_untrusted_close);
 
-  off_t physical_offset = offset_translator_->LogicalToPhysical(logical_offset);
-  off_t offset = enc_untrusted_lseek(fd, physical_offset, SEEK_SET);
-  if (offset == -1) {
-    LOG(ERROR) << "Failed lseek when reading a full block.";
-    return false;
-  }
-
-  ssize_t bytes_read = DecryptAndVerifyInternal(fd, block->data(), kBlockLength,
-                                                file_ctrl, logical_offset);
+  ssize_t bytes_read =
+      DecryptAndVerifyInternal(fd, block, block_length, file_ctrl,
+                               logical_offset, /*move_cursor=*/false);
   if (bytes_read == -1) {
     return -1;
   }
 
-  if (bytes_read < kBlockLength) {
-    memset(block->data() + bytes_read, 0, kBlockLength - bytes_read);
+  if (bytes_read < block_length) {
+    memset(block + bytes_read, 0, block_length - bytes_read);
   }
 
   return true;
@@ -635,46 +920,43 @@ ssize_t AeadHandler::EncryptAndPersist(int fd, const void *buf, size_t count) {
     return -1;
   }
 
-  off_t logical_offset;
-  if (!RetrieveLogicalOffset(fd, &logical_offset)) {
+  std::shared_ptr<FileControl> file_ctrl = FindFileControl(fd);
+  if (!file_ctrl) {
+    LOG(ERROR) << "Attempt made to write to an unopened file, fd = " << fd;
     return -1;
   }
 
-  std::shared_ptr<FileControl> file_ctrl;
-  {
-    absl::MutexLock global_lock(&mu_);
-
-    auto entry = fmap_.find(fd);
-    if (entry == fmap_.end()) {
-      LOG(ERROR) << "Attempt made to write to an unopened file, fd = " << fd;
-      errno = ENOENT;
-      return -1;
-    }
-
-    file_ctrl = entry->second;
+  absl::MutexLock lock(&file_ctrl->mu);
+  off_t logical_offset;
+  if (!RetrieveLogicalOffset(fd, *file_ctrl, &logical_offset)) {
+    return -1;
   }
 
   if (count == 0) {
     return 0;
   }
 
-  absl::MutexLock lock(&file_ctrl->mu);
+  const size_t block_length = file_ctrl->block_length;
+  const size_t cipher_block_length = CipherBlockLength(block_length);
+  const size_t secure_block_length = SecureBlockLength(block_length);
+  const OffsetTranslator &offset_translator = *file_ctrl->offset_translator;
 
   // Determine data breakdown into logical blocks.
   size_t first_partial_block_bytes_count;
   size_t last_partial_block_bytes_count;
   size_t full_inclusive_blocks_bytes_count;
-  offset_translator_->ReduceLogicalRangeToFullLogicalBlocks(
+  offset_translator.ReduceLogicalRangeToFullLogicalBlocks(
       logical_offset, count, &first_partial_block_bytes_count,
       &last_partial_block_bytes_count, &full_inclusive_blocks_bytes_count);
 
   // Bounce block for writing the first partial block in the range, if any.
-  Block first_block;
+  std::vector<uint8_t> first_block;
   if (first_partial_block_bytes_count > 0) {
+    first_block.resize(block_length);
     if (!ReadFullBlock(
             *file_ctrl,
-            logical_offset + first_partial_block_bytes_count - kBlockLength,
-            &first_block)) {
+            logical_offset + first_partial_block_bytes_count - block_length,
+            first_block.data())) {
       LOG(ERROR)
           << "failed to read the first misaligned block when writing, fd = "
           << fd;
@@ -683,15 +965,16 @@ ssize_t AeadHandler::EncryptAndPersist(int fd, const void *buf, size_t count) {
 
     std::copy_n(
         reinterpret_cast<const uint8_t *>(buf), first_partial_block_bytes_count,
-        first_block.data() + kBlockLength - first_partial_block_bytes_count);
+        first_block.data() + block_length - first_partial_block_bytes_count);
   }
 
   // Bounce block for writing the last partial block in the range, if any.
-  Block last_block;
+  std::vector<uint8_t> last_block;
   if (last_partial_block_bytes_count > 0) {
+    last_block.resize(block_length);
     if (!ReadFullBlock(*file_ctrl,
                        logical_offset + count - last_partial_block_bytes_count,
-                       &last_block)) {
+                       last_block.data())) {
       LOG(ERROR)
           << "failed to read the last misaligned block when writing, fd = "
           << fd;
@@ -705,17 +988,17 @@ ssize_t AeadHandler::EncryptAndPersist(int fd, const void *buf, size_t count) {
 
   const off_t first_logical_block_offset =
       (first_partial_block_bytes_count > 0)
-          ? (logical_offset + first_partial_block_bytes_count - kBlockLength)
+          ? (logical_offset + first_partial_block_bytes_count - block_length)
           : logical_offset;
   const off_t first_physical_block_offset =
-      offset_translator_->LogicalToPhysical(first_logical_block_offset);
+      offset_translator.LogicalToPhysical(first_logical_block_offset);
   const int64_t eof_block_index = file_ctrl->ad->LeafCount();
   int64_t start_block_to_write = 0;
   if (first_physical_block_offset > file_ctrl->physical_size()) {
     // Append leafs to the Merkle Tree to account for sparse region blocks.
     int64_t sparse_blocks_count =
         (first_physical_block_offset - file_ctrl->physical_size()) /
-        kSecureBlockLength;
+        secure_block_length;
     for (int64_t idx = 0; idx < sparse_blocks_count; idx++) {
       VLOG(2) << "Adding an empty auth tag to AD for a block "
                  "from a sparse region: "
@@ -726,7 +1009,7 @@ ssize_t AeadHandler::EncryptAndPersist(int fd, const void *buf, size_t count) {
   } else {
     int64_t blocks_to_eof =
         (file_ctrl->physical_size() - first_physical_block_offset) /
-        kSecureBlockLength;
+        secure_block_length;
     start_block_to_write = eof_block_index - blocks_to_eof;
   }
 
@@ -740,15 +1023,15 @@ ssize_t AeadHandler::EncryptAndPersist(int fd, const void *buf, size_t count) {
   // Use single write buffer to minimize the number of write calls to the host.
   std::vector<uint8_t> buffer;
   const int64_t blocks_to_write =
-      full_inclusive_blocks_bytes_count / kBlockLength;
-  const size_t physical_bytes_count = blocks_to_write * kSecureBlockLength;
+      full_inclusive_blocks_bytes_count / block_length;
+  const size_t physical_bytes_count = blocks_to_write * secure_block_length;
   buffer.resize(physical_bytes_count);
 
   // Cycle through blocks.
   std::vector<Tag> tags;
   for (int64_t block_index = 0; block_index < blocks_to_write; block_index++) {
-    const uint8_t *plaintext_data =
-        GetPlaintextBuffer(first_partial_block_bytes_count, block_index, buf);
+    const uint8_t *plaintext_data = GetPlaintextBuffer(
+        block_length, first_partial_block_bytes_count, block_index, buf);
 
     // Source for encryption - bounce block or the supplied buffer.
     const uint8_t *encrypt_source;
@@ -763,27 +1046,24 @@ ssize_t AeadHandler::EncryptAndPersist(int fd, const void *buf, size_t count) {
       encrypt_source = plaintext_data;
     }
 
-    Ciphertext *ciphertext =
-        Ciphertext::Place(&buffer, block_index * kSecureBlockLength);
+    uint8_t *ciphertext = buffer.data() + block_index * secure_block_length;
     Token *token = Token::Place(
-        &buffer, block_index * kSecureBlockLength + kCipherBlockLength);
+        &buffer, block_index * secure_block_length + cipher_block_length);
 
     // Encrypt the block.
-    if (!cryptor->EncryptBlock(encrypt_source, token->data(),
-                               ciphertext->data())) {
+    if (!cryptor->EncryptBlock(encrypt_source, token->data(), ciphertext)) {
       LOG(ERROR) << "Encryption failed, fd = " << fd;
       return -1;
     }
     VLOG(2) << "Ciphertext generated: "
             << absl::BytesToHexString(absl::string_view(
-                   reinterpret_cast<const char *>(ciphertext->data()),
-                   kBlockLength));
+                   reinterpret_cast<const char *>(ciphertext), block_length));
     VLOG(2) << "Token generated: "
             << absl::BytesToHexString(absl::string_view(
                    reinterpret_cast<const char *>(token->data()),
                    kTokenLength));
 
-    TagView tag(ciphertext->data() + kBlockLength, kTagLength);
+    TagView tag(ciphertext + block_length, kTagLength);
     tags.push_back(tag);
     VLOG(2) << "Auth tag generated: "
             << absl::BytesToHexString(absl::string_view(
@@ -820,7 +1100,7 @@ ssize_t AeadHandler::EncryptAndPersist(int fd, const void *buf, size_t count) {
   if (last_partial_block_bytes_count > 0) {
     off_t new_cur_logical_offset = logical_offset + count;
     off_t new_cur_physical_offset =
-        offset_translator_->LogicalToPhysical(new_cur_logical_offset);
+        offset_translator.LogicalToPhysical(new_cur_logical_offset);
     off_t offset = enc_untrusted_lseek(fd, new_cur_physical_offset, SEEK_SET);
     if (offset == -1) {
       LOG(ERROR)
@@ -836,7 +1116,11 @@ ssize_t AeadHandler::EncryptAndPersist(int fd, const void *buf, size_t count) {
     if (block_index < eof_block_index) {
       VLOG(2) << "Updating auth tag on AD: "
               << absl::BytesToHexString(tag_string);
-      file_ctrl->ad->UpdateLeaf(block_index + 1, tag_string);
+      if (!file_ctrl->ad->UpdateLeaf(block_index + 1, tag_string)) {
+        LOG(ERROR) << "Failed to update integrity metadata, path="
+                   << file_ctrl->path;
+        return -1;
+      }
     } else {
       VLOG(2) << "Appending auth tag to AD: "
               << absl::BytesToHexString(tag_string);
@@ -844,10 +1128,18 @@ ssize_t AeadHandler::EncryptAndPersist(int fd, const void *buf, size_t count) {
     }
   }
 
-  file_ctrl->logical_size = logical_offset + count;
+  // Overwriting data inside the file does not shrink it.
+  file_ctrl->logical_size =
+      std::max(file_ctrl->logical_size, static_cast<size_t>(logical_offset) +
+                                            count);
 
-  if (!UpdateDigest(file_ctrl.get(), *cryptor)) {
-    return -1;
+  // In write-back mode defer the digest update until enough data is written.
+  file_ctrl->dirty_bytes += count;
+  if (file_ctrl->dirty_bytes >= file_ctrl->max_dirty_bytes) {
+    if (!UpdateDigest(file_ctrl.get(), *cryptor)) {
+      return -1;
+    }
+    file_ctrl->dirty_bytes = 0;
   }
 
   VLOG(2) << "Wrote data to file, bytes_written = " << bytes_written;
@@ -895,18 +1187,10 @@ int AeadHandler::SetMasterKey(int fd, const uint8_t *key_data,
     return -1;
   }
 
-  std::shared_ptr<FileControl> file_ctrl;
-  {
-    absl::MutexLock global_lock(&mu_);
-
-    auto entry = fmap_.find(fd);
-    if (entry == fmap_.end()) {
-      LOG(ERROR) << "Attempt made to set key on an unopened file, fd = " << fd;
-      errno = ENOENT;
-      return -1;
-    }
-
-    file_ctrl = entry->second;
+  std::shared_ptr<FileControl> file_ctrl = FindFileControl(fd);
+  if (!file_ctrl) {
+    LOG(ERROR) << "Attempt made to set key on an unopened file, fd = " << fd;
+    return -1;
   }
 
   absl::MutexLock lock(&file_ctrl->mu);
@@ -933,12 +1217,140 @@ int AeadHandler::SetMasterKey(int fd, const uint8_t *key_data,
   return 0;
 }
 
-const OffsetTranslator &AeadHandler::GetOffsetTranslator() const {
-  return *offset_translator_;
+int AeadHandler::SetBlockLength(int fd, size_t block_length) {
+  if (!IsValidBlockLength(block_length)) {
+    LOG(ERROR) << "Attempt made to set an invalid block length: "
+               << block_length;
+    errno = EINVAL;
+    return -1;
+  }
+
+  std::shared_ptr<FileControl> file_ctrl = FindFileControl(fd);
+  if (!file_ctrl) {
+    LOG(ERROR) << "Attempt made to set block length on an unopened file, fd = "
+               << fd;
+    return -1;
+  }
+
+  absl::MutexLock lock(&file_ctrl->mu);
+
+  // Once the metadata is loaded the layout of the file is fixed.
+  if (file_ctrl->is_deserialized) {
+    if (file_ctrl->block_length != block_length) {
+      LOG(ERROR) << "Attempt made to change the block length of a file in use, "
+                    "fd = "
+                 << fd;
+      errno = EBUSY;
+      return -1;
+    }
+    return 0;
+  }
+
+  // The block length of an existing file is read from its header when the
+  // master key is set.
+  if (file_ctrl->is_new) {
+    file_ctrl->set_layout(kCurrentHeaderVersion, block_length);
+  }
+  return 0;
+}
+
+int AeadHandler::SetMerkleTreeStorage(int fd, MerkleTreeStorage storage) {
+  if (storage != MerkleTreeStorage::kPersistent &&
+      storage != MerkleTreeStorage::kInMemory) {
+    LOG(ERROR) << "Attempt made to set an invalid Merkle tree storage: "
+               << static_cast<uint32_t>(storage);
+    errno = EINVAL;
+    return -1;
+  }
+
+  std::shared_ptr<FileControl> file_ctrl = FindFileControl(fd);
+  if (!file_ctrl) {
+    LOG(ERROR) << "Attempt made to set Merkle tree storage on an unopened "
+                  "file, fd = "
+               << fd;
+    return -1;
+  }
+
+  absl::MutexLock lock(&file_ctrl->mu);
+  if (file_ctrl->is_deserialized) {
+    if (file_ctrl->tree_storage != storage) {
+      LOG(ERROR) << "Attempt made to change the Merkle tree storage of a file "
+                    "in use, fd = "
+                 << fd;
+      errno = EBUSY;
+      return -1;
+    }
+    return 0;
+  }
+
+  // The storage of an existing file is read from its header when the master
+  // key is set.
+  if (file_ctrl->is_new) {
+    file_ctrl->set_tree_storage(storage);
+  }
+  return 0;
+}
+
+int AeadHandler::SetDigestWriteBack(int fd, size_t max_dirty_bytes) {
+  std::shared_ptr<FileControl> file_ctrl = FindFileControl(fd);
+  if (!file_ctrl) {
+    LOG(ERROR) << "Attempt made to set digest write-back on an unopened file, "
+                  "fd = "
+               << fd;
+    return -1;
+  }
+
+  absl::MutexLock lock(&file_ctrl->mu);
+  file_ctrl->max_dirty_bytes = max_dirty_bytes;
+  if (max_dirty_bytes == 0 && !FlushDigest(file_ctrl.get())) {
+    return -1;
+  }
+  return 0;
+}
+
+int AeadHandler::SyncDigest(int fd) {
+  std::shared_ptr<FileControl> file_ctrl = FindFileControl(fd);
+  if (!file_ctrl) {
+    LOG(ERROR) << "Attempt made to sync the digest of an unopened file, fd = "
+               << fd;
+    return -1;
+  }
+
+  absl::MutexLock lock(&file_ctrl->mu);
+  return FlushDigest(file_ctrl.get()) ? 0 : -1;
+}
+
+std::shared_ptr<AeadHandler::FileControl> AeadHandler::FindFileControl(
+    int fd) {
+  absl::ReaderMutexLock global_lock(&mu_);
+  auto entry = fmap_.find(fd);
+  if (entry == fmap_.end()) {
+    errno = ENOENT;
+    return nullptr;
+  }
+  return entry->second;
+}
+
+off_t AeadHandler::LogicalToPhysical(int fd, off_t logical_offset) {
+  std::shared_ptr<FileControl> file_ctrl = FindFileControl(fd);
+  if (!file_ctrl) {
+    return OffsetTranslator::kInvalidOffset;
+  }
+  absl::ReaderMutexLock lock(&file_ctrl->mu);
+  return file_ctrl->offset_translator->LogicalToPhysical(logical_offset);
+}
+
+off_t AeadHandler::PhysicalToLogical(int fd, off_t physical_offset) {
+  std::shared_ptr<FileControl> file_ctrl = FindFileControl(fd);
+  if (!file_ctrl) {
+    return OffsetTranslator::kInvalidOffset;
+  }
+  absl::ReaderMutexLock lock(&file_ctrl->mu);
+  return file_ctrl->offset_translator->PhysicalToLogical(physical_offset);
 }
 
 off_t AeadHandler::GetLogicalFileSize(int fd) {
-  absl::MutexLock global_lock(&mu_);
+  absl::ReaderMutexLock global_lock(&mu_);
   auto entry = fmap_.find(fd);
   if (entry == fmap_.end()) {
     LOG(ERROR)
@@ -30,8 +30,9 @@
 #include "asylo/crypto/util/bytes.h"
 #include "asylo/platform/crypto/gcmlib/gcm_cryptor.h"
 #include "asylo/platform/storage/secure/authenticated_dictionary.h"
-#include "asylo/platform/storage/secure/ctmmt_authenticated_dictionary.h"
+#include "asylo/platform/storage/secure/persistent_authenticated_dictionary.h"
 #include "asylo/platform/storage/utils/offset_translator.h"
+#include "asylo/secure_storage.h"
 
 namespace asylo {
 namespace platform {
@@ -43,9 +44,14 @@ using crypto::gcmlib::kKeyLength;
 using crypto::gcmlib::kTagLength;
 using crypto::gcmlib::kTokenLength;
 
-// Length of file blocks to encrypt/decrypt.
-constexpr size_t kBlockLength = 128;
-using Block = UnsafeBytes<kBlockLength>;
+// Length of file blocks to encrypt/decrypt, unless a different length is
+// selected for a new file with AeadHandler::SetBlockLength.
+constexpr size_t kDefaultBlockLength = 128;
+
+// Bounds on the block length of a file. Block lengths must be a power of two
+// within these bounds.
+constexpr size_t kMinBlockLength = 128;
+constexpr size_t kMaxBlockLength = 64 * 1024;
 
 // Length of the file digest (of the AD root).
 constexpr int64_t kRootHashLength = 32;
@@ -53,11 +59,37 @@ constexpr int64_t kRootHashLength = 32;
 // Length of the hash of the file digest (of the AD root).
 constexpr int64_t kFileHashLength = 16;
 
-// Constants for the secure block structure - the secure block consists of
-// the ciphertext of the same length as the original plaintext, followed by the
-// integrity tag, followed by the encryption token.
-constexpr size_t kCipherBlockLength = kBlockLength + kTagLength;
-constexpr size_t kSecureBlockLength = kCipherBlockLength + kTokenLength;
+// Suffix appended to the path of a secure file to name the host file holding
+// the nodes of its Merkle tree.
+constexpr char kMerkleTreeFileSuffix[] =
+    ENCLAVE_STORAGE_MERKLE_TREE_FILE_SUFFIX;
+
+// Where the Merkle tree of a secure file is kept. The choice is made when the
+// file is created and is recorded in its header. Files with a header of the
+// legacy version record no choice, and keep their tree in memory.
+enum class MerkleTreeStorage : uint32_t {
+  // In a host file named by appending kMerkleTreeFileSuffix to the path of the
+  // secure file, loaded on demand by a PersistentAuthenticatedDictionary. The
+  // nodes cached in trusted memory for all open files share the bound of
+  // MerkleNodeCache::Shared().
+  kPersistent = 0,
+
+  // In trusted memory only, in a FlatAuthenticatedDictionary rebuilt from the
+  // block tags whenever the file is opened. Opening costs a pass over the file,
+  // while reads and writes do not touch the host to verify a block.
+  kInMemory = 1,
+};
+
+// Lengths of the secure block structure for a block of |block_length| bytes -
+// the secure block consists of the ciphertext of the same length as the
+// original plaintext, followed by the integrity tag, followed by the encryption
+// token.
+constexpr size_t CipherBlockLength(size_t block_length) {
+  return block_length + kTagLength;
+}
+constexpr size_t SecureBlockLength(size_t block_length) {
+  return CipherBlockLength(block_length) + kTokenLength;
+}
 
 using FileHash = UnsafeBytes<kFileHashLength>;
 using FileDigest = UnsafeBytes<kRootHashLength>;
@@ -68,6 +100,25 @@ using FileDigest = UnsafeBytes<kRootHashLength>;
 // supplied file data. Uses enclave-to-host IO delegates to propagate IO calls
 // over the enclave boundary to access file storage outside the enclave.
 //
+// The root of the Merkle tree over the block tags is covered by the digest in
+// the file header. By default the tree is kept on the host in a file named by
+// appending kMerkleTreeFileSuffix to the path of the secure file. Opening a
+// file only loads the roots of the tree; the path to a block is loaded and
+// verified against them when the block is first accessed. If the tree file is
+// missing or truncated, the tree is rebuilt from the block tags and written
+// out again. A new file may instead keep its tree in trusted memory, see
+// SetMerkleTreeStorage.
+//
+// By default the file header holding the digest of the file data is rewritten
+// on every write, so that a file is consistent on disk whenever a write call
+// returns. A file may instead be switched to digest write-back with
+// SetDigestWriteBack, in which case the header is only rewritten once enough
+// data has been written, when the file is synced with SyncDigest, and when a
+// descriptor of the file is closed. Data blocks are still written through to
+// the host on every write. If the enclave stops before the next digest update,
+// a file whose existing blocks were left untouched reads back as of the last
+// update, while reads of a rewritten block fail verification.
+//
 // Tracked feature work:
 //
 class AeadHandler {
@@ -89,6 +140,13 @@ class AeadHandler {
   ssize_t DecryptAndVerify(int fd, void *buf, size_t count)
       ABSL_LOCKS_EXCLUDED(mu_);
 
+  // Similar to DecryptAndVerify, but reads from |logical_offset| and neither
+  // uses nor moves the cursor of |fd|. Reads take the lock of the file in
+  // shared mode, so any number of threads may read the same file concurrently,
+  // through one descriptor or several. Returns -1 with errno set on failure.
+  ssize_t DecryptAndVerifyAt(int fd, void *buf, size_t count,
+                             off_t logical_offset) ABSL_LOCKS_EXCLUDED(mu_);
+
   // Encrypts data and generates integrity metadata for it in memory, writes
   // encrypted data to disk, returns the size of data written, or -1 on failure.
   ssize_t EncryptAndPersist(int fd, const void *buf, size_t count)
@@ -96,45 +154,131 @@ class AeadHandler {
 
   // Frees resources used to assure integrity of an opened file, persists
   // integrity metadata to a designated location on disk, returns false on
-  // failure. Does not modify the state of the file descriptor.
+  // failure. Does not modify the state of the file descriptor. A deferred
+  // digest update must be persisted with SyncDigest beforehand.
   bool FinalizeFile(int fd) ABSL_LOCKS_EXCLUDED(mu_);
 
   // Sets the master key for a newly opened file.
   int SetMasterKey(int fd, const uint8_t *key_data, uint32_t key_length)
       ABSL_LOCKS_EXCLUDED(mu_);
 
+  // Selects the length of the blocks a newly created file is encrypted in. Must
+  // be called before the master key is set. Has no effect on an existing file,
+  // whose block length is recorded in its header, and fails with EBUSY if the
+  // file is already in use with a different block length. Returns 0 on
+  // success, or -1 with errno set on failure.
+  int SetBlockLength(int fd, size_t block_length) ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Selects where the Merkle tree of a newly created file is kept. Like the
+  // block length, must be selected before the master key is set, has no effect
+  // on an existing file, and fails with EBUSY if the file is already in use
+  // with a different selection. Returns 0 on success, or -1 with errno set on
+  // failure.
+  int SetMerkleTreeStorage(int fd, MerkleTreeStorage storage)
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Switches the file opened as |fd| to digest write-back, deferring the update
+  // of the file header until at least |max_dirty_bytes| bytes were written
+  // since the last update. A |max_dirty_bytes| of 0 restores the default of
+  // updating the header on every write, persisting a pending update first.
+  // Applies to every descriptor of the file. Returns 0 on success, or -1 with
+  // errno set on failure.
+  int SetDigestWriteBack(int fd, size_t max_dirty_bytes)
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Persists a pending digest update of the file opened as |fd|, if any.
+  // Returns 0 on success, or -1 with errno set on failure.
+  int SyncDigest(int fd) ABSL_LOCKS_EXCLUDED(mu_);
+
   // Returns the logical file size, or -1 on failure.
   off_t GetLogicalFileSize(int fd) ABSL_LOCKS_EXCLUDED(mu_);
 
-  const OffsetTranslator &GetOffsetTranslator() const;
+  // Translate between logical offsets and physical offsets in the layout of the
+  // file opened as |fd|. Return OffsetTranslator::kInvalidOffset on failure.
+  off_t LogicalToPhysical(int fd, off_t logical_offset)
+      ABSL_LOCKS_EXCLUDED(mu_);
+  off_t PhysicalToLogical(int fd, off_t physical_offset)
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+  // Returns true if |block_length| is a supported block length.
+  static bool IsValidBlockLength(size_t block_length);
 
  private:
-  // Structure represents the file header layout.
+  // Versions of the layout of the file header. The version is kept in the top
+  // byte of the size field of the header, which is zero in the unversioned
+  // header of files written before the block length was recorded. Such files
+  // are read as version kLegacyHeaderVersion:
+  //  * kLegacyHeaderVersion: the file hash and the file size only. The file is
+  //    encrypted in blocks of kDefaultBlockLength bytes.
+  //  * kHeaderVersion1: additionally the block length and the Merkle tree
+  //    storage of the file.
+  // New files are written with kCurrentHeaderVersion. Existing files keep the
+  // version they were written with, since the length of the header determines
+  // the position of every block.
+  static constexpr uint8_t kLegacyHeaderVersion = 0;
+  static constexpr uint8_t kHeaderVersion1 = 1;
+  static constexpr uint8_t kCurrentHeaderVersion = kHeaderVersion1;
+
+  // Bits of the size field of the header holding the logical file size, below
+  // the version.
+  static constexpr int kFileSizeBits = 56;
+  static constexpr uint64_t kFileSizeMask = (uint64_t{1} << kFileSizeBits) - 1;
+
+  // Structure represents the file header layout. A header of version
+  // kLegacyHeaderVersion ends before |block_length|.
   struct FileHeader {
     // Hash of the DataDigest.
     FileHash file_hash;
 
-    // Logical file size - is incorporated into DataDigest and is protected by
-    // FileHash.
-    size_t file_size;
+    // Logical file size and header version - are incorporated into DataDigest
+    // and are protected by FileHash.
+    uint64_t versioned_size;
+
+    // Length of the file blocks - is incorporated into DataDigest and is
+    // protected by FileHash.
+    uint32_t block_length;
+
+    // MerkleTreeStorage of the file - is incorporated into DataDigest and is
+    // protected by FileHash.
+    uint32_t tree_storage;
 
     // Returns the address of the FileHeader instance.
     uint8_t *data() { return file_hash.data(); }
   } ABSL_ATTRIBUTE_PACKED;
 
   // Structure represents the file data digest from which the file hash used for
-  // integrity validation is calculated.
+  // integrity validation is calculated. Like the header, the digest of a file
+  // of version kLegacyHeaderVersion ends before |block_length|.
   struct DataDigest {
     // AD digest of the file data.
     FileDigest file_digest;
 
-    // Logical file size.
-    size_t file_size;
+    // Logical file size and header version.
+    uint64_t versioned_size;
+
+    // Length of the file blocks.
+    uint32_t block_length;
+
+    // MerkleTreeStorage of the file.
+    uint32_t tree_storage;
 
     // Returns the address of the DataDigest instance.
     uint8_t *data() { return file_digest.data(); }
   } ABSL_ATTRIBUTE_PACKED;
 
+  // Returns the length of the header, and of the digest, of a file whose
+  // header has version |version|.
+  static size_t HeaderLength(uint8_t version) {
+    return version == kLegacyHeaderVersion
+               ? sizeof(FileHash) + sizeof(uint64_t)
+               : sizeof(FileHeader);
+  }
+  static size_t DigestLength(uint8_t version) {
+    return version == kLegacyHeaderVersion
+               ? sizeof(FileDigest) + sizeof(uint64_t)
+               : sizeof(DataDigest);
+  }
+
   // File (data set) control structure for an opened file.
   struct FileControl {
     const std::string path;
@@ -142,33 +286,54 @@ class AeadHandler {
     bool is_new;
     bool is_deserialized;
     std::unique_ptr<AuthenticatedDictionary> ad;
+
+    // Where the tree of |ad| is kept, and |ad| itself if it is persistent.
+    MerkleTreeStorage tree_storage;
+    PersistentAuthenticatedDictionary *persistent_ad;
     std::string zero_hash;
     std::unique_ptr<GcmCryptorKey> master_key;
 
-    // Mutex for protecting FileControl instance.
+    // Version of the header layout of the file.
+    uint8_t header_version;
+
+    // Length of the file blocks, and the translator for the resulting layout.
+    size_t block_length;
+    std::unique_ptr<OffsetTranslator> offset_translator;
+
+    // Number of bytes written to the file after which the digest must be
+    // persisted, or 0 to persist it on every write, and the number of bytes
+    // written since it was last persisted.
+    size_t max_dirty_bytes;
+    size_t dirty_bytes;
+
+    // Mutex for protecting FileControl instance. Reads hold it in shared mode,
+    // and anything which modifies the file holds it exclusively.
     absl::Mutex mu;
 
-    FileControl(const char *path_name, bool is_new_file)
-        : path(path_name),
-          logical_size(0),
-          is_new(is_new_file),
-          is_deserialized(false),
-          ad(absl::make_unique<CTMMTAuthenticatedDictionary>()) {
-      UnsafeBytes<kTagLength> tag;
-      memset(tag.data(), 0, kTagLength);
-      std::string tag_string(reinterpret_cast<char *>(tag.data()), kTagLength);
-      zero_hash = ad->LeafHash(tag_string);
+    FileControl(const char *path_name, bool is_new_file);
+
+    // Switches the file to blocks of |length| bytes after a header of version
+    // |version|. |length| must be valid.
+    void set_layout(uint8_t version, size_t length) {
+      header_version = version;
+      block_length = length;
+      offset_translator = OffsetTranslator::Create(
+          HeaderLength(version), length, SecureBlockLength(length));
     }
 
+    // Replaces |ad| with an empty tree kept in |storage|.
+    void set_tree_storage(MerkleTreeStorage storage);
+
     // NOTE: The physical_size is on block granularity because the block
     // metadata is placed after the block data, hence, only full blocks are
     // written - there are no partial blocks.
     size_t physical_size() {
-      return sizeof(FileHeader) + ad->LeafCount() * kSecureBlockLength;
+      return HeaderLength(header_version) +
+             ad->LeafCount() * SecureBlockLength(block_length);
     }
   };
 
-  AeadHandler();
+  AeadHandler() = default;
   AeadHandler(AeadHandler const &) = delete;
   void operator=(AeadHandler const &) = delete;
 
@@ -176,31 +341,52 @@ class AeadHandler {
   bool Deserialize(FileControl *file_ctrl)
       ABSL_EXCLUSIVE_LOCKS_REQUIRED(file_ctrl->mu);
 
-  // Retrieves logical cursor offset associated with a file descriptor |fd|.
-  // Returns false on failure.
-  bool RetrieveLogicalOffset(int fd, off_t *logical_offset) const;
+  // Rebuilds the empty Merkle tree of |file_ctrl| from the tags of its first
+  // |blocks_count| blocks, read from |fd| positioned past the header. A
+  // persistent tree is not flushed. Returns false on failure.
+  bool RebuildTree(int fd, size_t blocks_count, FileControl *file_ctrl) const
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(file_ctrl->mu);
+
+  // Retrieves logical cursor offset associated with a file descriptor |fd| in
+  // the layout of |file_ctrl|. Returns false on failure.
+  bool RetrieveLogicalOffset(int fd, const FileControl &file_ctrl,
+                             off_t *logical_offset) const
+      ABSL_SHARED_LOCKS_REQUIRED(file_ctrl.mu);
+
+  // Returns the control structure of the file opened as |fd|, or nullptr with
+  // errno set to ENOENT if |fd| is not a secure file.
+  std::shared_ptr<FileControl> FindFileControl(int fd)
+      ABSL_LOCKS_EXCLUDED(mu_);
 
   // Updates digest of the file data in the secure file header.
   bool UpdateDigest(FileControl *file_ctrl, const GcmCryptor &cryptor) const
       ABSL_EXCLUSIVE_LOCKS_REQUIRED(file_ctrl->mu);
 
+  // Updates the digest of the file data if writes since the last update have
+  // not been covered by it yet. Returns false on failure.
+  bool FlushDigest(FileControl *file_ctrl) const
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(file_ctrl->mu);
+
   // Returns an instance of GcmCryptor associated with a file, or nullptr if was
   // not able to retrieve. The caller does not own the instance.
   GcmCryptor *GetGcmCryptor(const FileControl &file_ctrl) const
-      ABSL_EXCLUSIVE_LOCKS_REQUIRED(file_ctrl.mu);
+      ABSL_SHARED_LOCKS_REQUIRED(file_ctrl.mu);
 
-  // Similar to DecryptAndVerify, but is called by internal implementation, and
-  // as such does not take a file lock. The cursor associated with the file
-  // descriptor |fd| is expected to be at the position of |logical_offset|.
+  // Similar to DecryptAndVerifyAt, but is called by internal implementation,
+  // and as such does not take a file lock. If |move_cursor| is true, the
+  // cursor associated with the file descriptor |fd| is moved to the end of the
+  // data read.
   ssize_t DecryptAndVerifyInternal(int fd, void *buf, size_t count,
                                    const FileControl &file_ctrl,
-                                   off_t logical_offset) const
-      ABSL_EXCLUSIVE_LOCKS_REQUIRED(file_ctrl.mu);
+                                   off_t logical_offset,
+                                   bool move_cursor) const
+      ABSL_SHARED_LOCKS_REQUIRED(file_ctrl.mu);
 
-  // Reads a single full block of a file at a specified logical offset. Returns
-  // false on failure.
+  // Reads a single full block of a file at a specified logical offset into
+  // |block|, which holds |file_ctrl.block_length| bytes. Returns false on
+  // failure.
   bool ReadFullBlock(const FileControl &file_ctrl, off_t logical_offset,
-                     Block *block) const
+                     uint8_t *block) const
       ABSL_EXCLUSIVE_LOCKS_REQUIRED(file_ctrl.mu);
 
   // Map of file (data set) controls for opened files keyed on int identity of
@@ -217,10 +403,9 @@ class AeadHandler {
   std::unordered_map<std::string, std::shared_ptr<FileControl>> opened_files_
       ABSL_GUARDED_BY(mu_);
 
-  // An instance that performs operations on untrusted file offset.
-  std::unique_ptr<OffsetTranslator> offset_translator_;
-
-  // Mutex for protecting map members of the class.
+  // Mutex for protecting map members of the class. Lookups of a file by
+  // descriptor hold it in shared mode, so that they do not serialize I/O on
+  // different files.
   absl::Mutex mu_;
 };
 
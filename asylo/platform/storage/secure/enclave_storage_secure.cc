@@ -22,9 +22,13 @@
 #include <sys/types.h>
 
 // IO syscall interface constants.
+#include <errno.h>
 #include <fcntl.h>
 #include <stdarg.h>
 
+#include <string>
+
+#include "absl/strings/str_cat.h"
 #include "asylo/util/logging.h"
 #include "asylo/platform/host_call/trusted/host_calls.h"
 #include "asylo/platform/storage/secure/aead_handler.h"
@@ -59,15 +63,17 @@ int secure_open(const char *pathname, int flags, ...) {
 
   FdCloser fd_closer(fd, &enc_untrusted_close);
 
-  // Set cursor to the logical offset of 0.
-  if (secure_lseek(fd, 0, SEEK_SET) == -1) {
-    LOG(ERROR) << "Failed to initialize cursor to the logical offset of 0, fd="
-               << fd;
+  if (!AeadHandler::GetInstance().InitializeFile(fd, pathname, is_new_file)) {
+    LOG(ERROR) << "Failed to initialize secure handling of file: " << pathname;
     return -1;
   }
 
-  if (!AeadHandler::GetInstance().InitializeFile(fd, pathname, is_new_file)) {
-    LOG(ERROR) << "Failed to initialize secure handling of file: " << pathname;
+  // Set cursor to the logical offset of 0. The physical offset of the first
+  // block does not depend on the block length of the file.
+  if (secure_lseek(fd, 0, SEEK_SET) == -1) {
+    LOG(ERROR) << "Failed to initialize cursor to the logical offset of 0, fd="
+               << fd;
+    AeadHandler::GetInstance().FinalizeFile(fd);
     return -1;
   }
 
@@ -79,13 +85,31 @@ ssize_t secure_read(int fd, void *buf, size_t count) {
   return AeadHandler::GetInstance().DecryptAndVerify(fd, buf, count);
 }
 
+ssize_t secure_pread(int fd, void *buf, size_t count, off_t offset) {
+  return AeadHandler::GetInstance().DecryptAndVerifyAt(fd, buf, count, offset);
+}
+
 ssize_t secure_write(int fd, const void *buf, size_t count) {
   return AeadHandler::GetInstance().EncryptAndPersist(fd, buf, count);
 }
 
 int secure_close(int fd) {
-  bool finalize_result = AeadHandler::GetInstance().FinalizeFile(fd);
-  return (finalize_result && enc_untrusted_close(fd) == 0) ? 0 : -1;
+  AeadHandler &aead_handler = AeadHandler::GetInstance();
+  // Persist a deferred digest update first. The descriptor is released even if
+  // that fails, but the failure is reported.
+  bool sync_result = (aead_handler.SyncDigest(fd) == 0);
+  if (!aead_handler.FinalizeFile(fd)) {
+    return -1;
+  }
+  int close_result = enc_untrusted_close(fd);
+  return (sync_result && close_result == 0) ? 0 : -1;
+}
+
+int secure_fsync(int fd) {
+  if (AeadHandler::GetInstance().SyncDigest(fd) != 0) {
+    return -1;
+  }
+  return enc_untrusted_fsync(fd);
 }
 
 off_t secure_lseek(int fd, off_t offset, int whence) {
@@ -93,8 +117,7 @@ off_t secure_lseek(int fd, off_t offset, int whence) {
     return -1;
   }
 
-  const OffsetTranslator &offset_translator =
-      AeadHandler::GetInstance().GetOffsetTranslator();
+  AeadHandler &aead_handler = AeadHandler::GetInstance();
 
   // The net logical offset to which lseek has been requested.
   off_t logical_offset;
@@ -109,26 +132,30 @@ off_t secure_lseek(int fd, off_t offset, int whence) {
         return -1;
       }
       off_t logical_cur_offset =
-          offset_translator.PhysicalToLogical(physical_cur_offset);
+          aead_handler.PhysicalToLogical(fd, physical_cur_offset);
       logical_offset = logical_cur_offset + offset;
     } break;
     case SEEK_END: {
-      off_t logical_eof_offset =
-          AeadHandler::GetInstance().GetLogicalFileSize(fd);
+      off_t logical_eof_offset = aead_handler.GetLogicalFileSize(fd);
       logical_offset = logical_eof_offset + offset;
     } break;
     default: logical_offset = 0;  // Satisfy -Wmaybe-uninitialized
   }
 
   // The net physical offset that corresponds to the requested logical offset.
-  off_t physical_offset = offset_translator.LogicalToPhysical(logical_offset);
+  off_t physical_offset = aead_handler.LogicalToPhysical(fd, logical_offset);
+  if (physical_offset == OffsetTranslator::kInvalidOffset) {
+    LOG(ERROR) << "Invalid logical offset for lseek, fd = " << fd
+               << ", offset = " << logical_offset;
+    return -1;
+  }
   physical_offset = enc_untrusted_lseek(fd, physical_offset, SEEK_SET);
   if (physical_offset == -1) {
     LOG(ERROR) << "enclave_lseek failed, fd = " << fd
                << ", offset = " << offset;
     return -1;
   }
-  return offset_translator.PhysicalToLogical(physical_offset);
+  return aead_handler.PhysicalToLogical(fd, physical_offset);
 }
 
 int secure_fstat(int fd, struct stat *st) {
@@ -140,6 +167,37 @@ int secure_fstat(int fd, struct stat *st) {
   return ret;
 }
 
+int secure_unlink(const char *pathname) {
+  if (enc_untrusted_unlink(pathname) == -1) {
+    return -1;
+  }
+
+  // Whether or not |pathname| was a secure file which kept a Merkle tree file,
+  // the outcome is that no tree file is left.
+  int saved_errno = errno;
+  enc_untrusted_unlink(absl::StrCat(pathname, kMerkleTreeFileSuffix).c_str());
+  errno = saved_errno;
+  return 0;
+}
+
+int secure_rename(const char *oldpath, const char *newpath) {
+  if (enc_untrusted_rename(oldpath, newpath) == -1) {
+    return -1;
+  }
+
+  // A tree file left at |newpath| would not match the file now there, and a
+  // missing one is rebuilt when the file is opened.
+  int saved_errno = errno;
+  const std::string new_tree_path =
+      absl::StrCat(newpath, kMerkleTreeFileSuffix);
+  if (enc_untrusted_rename(absl::StrCat(oldpath, kMerkleTreeFileSuffix).c_str(),
+                           new_tree_path.c_str()) == -1) {
+    enc_untrusted_unlink(new_tree_path.c_str());
+  }
+  errno = saved_errno;
+  return 0;
+}
+
 }  // namespace storage
 }  // namespace platform
 }  // namespace asylo
@@ -39,17 +39,35 @@ int secure_open(const char *pathname, int flags, ...);
 // responsibility to explicitly set file offset on error as the client desires.
 ssize_t secure_read(int fd, void *buf, size_t count);
 
+// Reads from |offset| without moving the file offset. May be called from many
+// threads at once on the same descriptor.
+ssize_t secure_pread(int fd, void *buf, size_t count, off_t offset);
+
 // Note: POSIX leaves file offset on error undefined - thus, it is the client's
 // responsibility to explicitly set file offset on error as the client desires.
 ssize_t secure_write(int fd, const void *buf, size_t count);
 
+// Persists a deferred digest update of the file before closing it.
 int secure_close(int fd);
 
+// Persists a deferred digest update of the file, then syncs it on the host.
+int secure_fsync(int fd);
+
 off_t secure_lseek(int fd, off_t offset, int whence);
 
 // |st->st_size| will be set to logical file size on success.
 int secure_fstat(int fd, struct stat* st);
 
+// Removes |pathname| along with the Merkle tree file of a secure file at that
+// path, if any. Fails only if |pathname| itself cannot be removed.
+int secure_unlink(const char *pathname);
+
+// Renames |oldpath| to |newpath| along with the Merkle tree file of a secure
+// file at |oldpath|, if any. A Merkle tree file left at |newpath| by the file
+// being replaced is removed otherwise. Fails only if |oldpath| itself cannot be
+// renamed.
+int secure_rename(const char *oldpath, const char *newpath);
+
 }  // namespace storage
 }  // namespace platform
 }  // namespace asylo
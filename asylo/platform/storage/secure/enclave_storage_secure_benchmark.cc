@@ -0,0 +1,494 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Benchmarks of file I/O through the secure path handler, run inside an
+// enclave by the test shim. Every benchmark has a counterpart on a plain host
+// file accessed through UntrustedFile, so the cost of encryption and integrity
+// checking is the difference between the two. Benchmarks only run when the
+// test is passed --benchmarks=all, or --benchmarks=<regex> to select some of
+// them.
+
+#include <fcntl.h>
+#include <openssl/rand.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "asylo/platform/storage/secure/aead_handler.h"
+#include "asylo/platform/storage/utils/untrusted_file.h"
+#include "asylo/secure_storage.h"
+#include "asylo/test/util/test_flags.h"
+#include "asylo/util/cleansing_types.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+namespace {
+
+using platform::storage::kMerkleTreeFileSuffix;
+
+constexpr size_t kKeyLength = 32;
+
+// Payload size of the throughput benchmarks.
+constexpr int64_t kFileSize = 1 << 20;
+
+// Largest file of the open latency sweep.
+constexpr int64_t kMaxOpenFileSize = 16 << 20;
+
+// Seed of the offsets of the random access benchmarks, fixed so that secure and
+// untrusted runs access the same sequence of offsets.
+constexpr uint32_t kRandomSeed = 42;
+
+std::string BenchmarkPath(absl::string_view name) {
+  return absl::StrCat(absl::GetFlag(FLAGS_test_tmpdir), "/", name);
+}
+
+// Returns the host size of |path|, or 0 if it does not exist.
+int64_t HostFileSize(const std::string &path) {
+  struct stat file_stat;
+  if (stat(path.c_str(), &file_stat) != 0) {
+    return 0;
+  }
+  return file_stat.st_size;
+}
+
+// Returns the key of all secure files, generated on first use.
+CleansingVector<uint8_t> *BenchmarkKey() {
+  static CleansingVector<uint8_t> *const key = [] {
+    auto key = new CleansingVector<uint8_t>(kKeyLength);
+    RAND_bytes(key->data(), key->size());
+    return key;
+  }();
+  return key;
+}
+
+// Opens |path| through the secure path handler and sets its key. A file created
+// by the call uses |block_length| and keeps its Merkle tree as selected by
+// |tree_storage|. Returns a file descriptor, or -1 on failure.
+int OpenSecureFile(const std::string &path, int flags, uint32_t block_length,
+                   uint32_t tree_storage) {
+  int fd = open(path.c_str(), flags | O_SECURE, 0644);
+  if (fd < 0) {
+    return -1;
+  }
+  struct key_info key_param;
+  key_param.length = BenchmarkKey()->size();
+  key_param.data = BenchmarkKey()->data();
+  if (ioctl(fd, ENCLAVE_STORAGE_SET_BLOCK_LENGTH, &block_length) != 0 ||
+      ioctl(fd, ENCLAVE_STORAGE_SET_MERKLE_TREE_STORAGE, &tree_storage) != 0 ||
+      ioctl(fd, ENCLAVE_STORAGE_SET_KEY, &key_param) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// Writes |size| bytes of |buffer| to |fd| in chunks of |io_size| bytes.
+bool WriteFully(int fd, const char *buffer, size_t size, size_t io_size) {
+  for (size_t offset = 0; offset < size; offset += io_size) {
+    size_t count = std::min(io_size, size - offset);
+    if (write(fd, buffer + offset, count) != count) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Reads |size| bytes from |fd| into |buffer| in chunks of |io_size| bytes.
+bool ReadFully(int fd, char *buffer, size_t size, size_t io_size) {
+  for (size_t offset = 0; offset < size; offset += io_size) {
+    size_t count = std::min(io_size, size - offset);
+    if (read(fd, buffer + offset, count) != count) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Creates a secure file of |size| bytes at |path|.
+bool CreateSecureFile(const std::string &path, size_t size,
+                      uint32_t block_length, uint32_t tree_storage) {
+  unlink(path.c_str());
+  int fd = OpenSecureFile(path, O_CREAT | O_RDWR, block_length, tree_storage);
+  if (fd < 0) {
+    return false;
+  }
+  std::vector<char> payload(size, 'a');
+  bool written = WriteFully(fd, payload.data(), payload.size(), 64 << 10);
+  return close(fd) == 0 && written;
+}
+
+// Returns the offsets of |count| random accesses of |io_size| bytes, aligned to
+// |io_size|, within a file of kFileSize bytes.
+std::vector<off_t> RandomOffsets(size_t count, size_t io_size) {
+  std::mt19937 generator(kRandomSeed);
+  std::uniform_int_distribution<off_t> block(0, kFileSize / io_size - 1);
+  std::vector<off_t> offsets(count);
+  for (off_t &offset : offsets) {
+    offset = block(generator) * io_size;
+  }
+  return offsets;
+}
+
+// Records the host storage spent on a secure file at |path| holding |payload|
+// bytes, beyond the payload itself, as a fraction of |payload|.
+void ReportMetadataOverhead(benchmark::State &state, const std::string &path,
+                            int64_t payload) {
+  int64_t stored = HostFileSize(path) +
+                   HostFileSize(absl::StrCat(path, kMerkleTreeFileSuffix));
+  state.counters["metadata_bytes_per_byte"] =
+      static_cast<double>(stored - payload) / payload;
+}
+
+// Measures writing a new secure file of kFileSize bytes with a block length of
+// state.range(0) bytes, in writes of state.range(1) bytes, including the final
+// close which persists the digest.
+void BM_SecureSequentialWrite(benchmark::State &state) {
+  const std::string path = BenchmarkPath("secure_sequential_write");
+  const std::vector<char> payload(kFileSize, 'a');
+  for (auto _ : state) {
+    state.PauseTiming();
+    unlink(path.c_str());
+    state.ResumeTiming();
+    int fd = OpenSecureFile(path, O_CREAT | O_RDWR, state.range(0),
+                            ENCLAVE_STORAGE_MERKLE_TREE_FILE);
+    if (fd < 0 ||
+        !WriteFully(fd, payload.data(), payload.size(), state.range(1)) ||
+        close(fd) != 0) {
+      state.SkipWithError("Secure write failed");
+      break;
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * kFileSize);
+  ReportMetadataOverhead(state, path, kFileSize);
+  unlink(path.c_str());
+}
+BENCHMARK(BM_SecureSequentialWrite)
+    ->RangeMultiplier(8)
+    ->Ranges({{128, 64 << 10}, {4 << 10, 64 << 10}});
+
+// Measures reading a secure file of kFileSize bytes with a block length of
+// state.range(0) bytes from start to end, in reads of state.range(1) bytes.
+void BM_SecureSequentialRead(benchmark::State &state) {
+  const std::string path = BenchmarkPath("secure_sequential_read");
+  if (!CreateSecureFile(path, kFileSize, state.range(0),
+                        ENCLAVE_STORAGE_MERKLE_TREE_FILE)) {
+    state.SkipWithError("Creating the secure file failed");
+    return;
+  }
+  int fd = OpenSecureFile(path, O_RDONLY, state.range(0),
+                          ENCLAVE_STORAGE_MERKLE_TREE_FILE);
+  std::vector<char> buffer(kFileSize);
+  for (auto _ : state) {
+    if (fd < 0 || lseek(fd, 0, SEEK_SET) != 0 ||
+        !ReadFully(fd, buffer.data(), buffer.size(), state.range(1))) {
+      state.SkipWithError("Secure read failed");
+      break;
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * kFileSize);
+  ReportMetadataOverhead(state, path, kFileSize);
+  if (fd >= 0) {
+    close(fd);
+  }
+  unlink(path.c_str());
+}
+BENCHMARK(BM_SecureSequentialRead)
+    ->RangeMultiplier(8)
+    ->Ranges({{128, 64 << 10}, {4 << 10, 64 << 10}});
+
+// Measures reads of state.range(1) bytes at random offsets of a secure file
+// with a block length of state.range(0) bytes.
+void BM_SecureRandomRead(benchmark::State &state) {
+  const std::string path = BenchmarkPath("secure_random_read");
+  if (!CreateSecureFile(path, kFileSize, state.range(0),
+                        ENCLAVE_STORAGE_MERKLE_TREE_FILE)) {
+    state.SkipWithError("Creating the secure file failed");
+    return;
+  }
+  int fd = OpenSecureFile(path, O_RDONLY, state.range(0),
+                          ENCLAVE_STORAGE_MERKLE_TREE_FILE);
+  const size_t io_size = state.range(1);
+  const std::vector<off_t> offsets = RandomOffsets(1024, io_size);
+  std::vector<char> buffer(io_size);
+  size_t next = 0;
+  for (auto _ : state) {
+    off_t offset = offsets[next++ % offsets.size()];
+    if (fd < 0 || pread(fd, buffer.data(), io_size, offset) != io_size) {
+      state.SkipWithError("Secure read failed");
+      break;
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * io_size);
+  if (fd >= 0) {
+    close(fd);
+  }
+  unlink(path.c_str());
+}
+BENCHMARK(BM_SecureRandomRead)
+    ->RangeMultiplier(8)
+    ->Ranges({{128, 64 << 10}, {4 << 10, 64 << 10}});
+
+// Measures overwrites of state.range(1) bytes at random offsets of a secure
+// file with a block length of state.range(0) bytes. Every write updates the
+// Merkle tree and the digest of the file.
+void BM_SecureRandomWrite(benchmark::State &state) {
+  const std::string path = BenchmarkPath("secure_random_write");
+  if (!CreateSecureFile(path, kFileSize, state.range(0),
+                        ENCLAVE_STORAGE_MERKLE_TREE_FILE)) {
+    state.SkipWithError("Creating the secure file failed");
+    return;
+  }
+  int fd = OpenSecureFile(path, O_RDWR, state.range(0),
+                          ENCLAVE_STORAGE_MERKLE_TREE_FILE);
+  const size_t io_size = state.range(1);
+  const std::vector<off_t> offsets = RandomOffsets(1024, io_size);
+  const std::vector<char> buffer(io_size, 'b');
+  size_t next = 0;
+  for (auto _ : state) {
+    off_t offset = offsets[next++ % offsets.size()];
+    if (fd < 0 || lseek(fd, offset, SEEK_SET) != offset ||
+        write(fd, buffer.data(), io_size) != io_size) {
+      state.SkipWithError("Secure write failed");
+      break;
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * io_size);
+  if (fd >= 0) {
+    close(fd);
+  }
+  unlink(path.c_str());
+}
+BENCHMARK(BM_SecureRandomWrite)
+    ->RangeMultiplier(8)
+    ->Ranges({{128, 64 << 10}, {4 << 10, 64 << 10}});
+
+// Measures opening and closing a secure file of state.range(0) bytes whose
+// Merkle tree is kept as selected by state.range(1). Opening reads the file
+// header and either loads the Merkle tree file or rebuilds the tree from every
+// block of the file.
+void BM_SecureOpen(benchmark::State &state) {
+  const std::string path = BenchmarkPath("secure_open");
+  const uint32_t tree_storage = state.range(1);
+  if (!CreateSecureFile(path, state.range(0),
+                        platform::storage::kDefaultBlockLength,
+                        tree_storage)) {
+    state.SkipWithError("Creating the secure file failed");
+    return;
+  }
+  char byte;
+  for (auto _ : state) {
+    int fd = OpenSecureFile(path, O_RDONLY,
+                            platform::storage::kDefaultBlockLength,
+                            tree_storage);
+    if (fd < 0 || read(fd, &byte, 1) != 1 || close(fd) != 0) {
+      state.SkipWithError("Secure open failed");
+      break;
+    }
+  }
+  ReportMetadataOverhead(state, path, state.range(0));
+  unlink(path.c_str());
+}
+BENCHMARK(BM_SecureOpen)
+    ->RangeMultiplier(16)
+    ->Ranges({{4 << 10, kMaxOpenFileSize},
+              {ENCLAVE_STORAGE_MERKLE_TREE_FILE,
+               ENCLAVE_STORAGE_MERKLE_TREE_IN_MEMORY}});
+
+// Opens a plain host file at |path|, bypassing the secure path handler.
+// Returns a file descriptor, or -1 on failure.
+int OpenUntrustedFile(const std::string &path, int flags) {
+  return open(path.c_str(), flags, 0644);
+}
+
+// Creates a plain host file of |size| bytes at |path|.
+bool CreateUntrustedFile(const std::string &path, size_t size) {
+  unlink(path.c_str());
+  int fd = OpenUntrustedFile(path, O_CREAT | O_RDWR);
+  if (fd < 0) {
+    return false;
+  }
+  std::vector<char> payload(size, 'a');
+  bool written;
+  {
+    UntrustedFile file(fd);
+    written = file.Write(payload.data(), 0, size).ok();
+  }
+  return close(fd) == 0 && written;
+}
+
+// Runs |body| on an UntrustedFile opened on a plain host file of kFileSize
+// bytes at |path|. The file is synced once |body| returns, as UntrustedFile
+// does on destruction.
+template <typename Body>
+void WithUntrustedFile(benchmark::State &state, const std::string &path,
+                       int flags, Body body) {
+  if (!CreateUntrustedFile(path, kFileSize)) {
+    state.SkipWithError("Creating the untrusted file failed");
+    return;
+  }
+  int fd = OpenUntrustedFile(path, flags);
+  if (fd < 0) {
+    state.SkipWithError("Untrusted open failed");
+  } else {
+    {
+      UntrustedFile file(fd);
+      body(&file);
+    }
+    close(fd);
+  }
+  unlink(path.c_str());
+}
+
+// Measures writing a new host file of kFileSize bytes through UntrustedFile in
+// writes of state.range(0) bytes, including the sync when the file is closed.
+void BM_UntrustedSequentialWrite(benchmark::State &state) {
+  const std::string path = BenchmarkPath("untrusted_sequential_write");
+  const std::vector<char> payload(kFileSize, 'a');
+  const size_t io_size = state.range(0);
+  for (auto _ : state) {
+    state.PauseTiming();
+    unlink(path.c_str());
+    state.ResumeTiming();
+    int fd = OpenUntrustedFile(path, O_CREAT | O_RDWR);
+    if (fd < 0) {
+      state.SkipWithError("Untrusted open failed");
+      break;
+    }
+    Status status;
+    {
+      UntrustedFile file(fd);
+      for (size_t offset = 0; status.ok() && offset < payload.size();
+           offset += io_size) {
+        status = file.Write(payload.data() + offset, offset, io_size);
+      }
+    }
+    if (close(fd) != 0 || !status.ok()) {
+      state.SkipWithError("Untrusted write failed");
+      break;
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * kFileSize);
+  unlink(path.c_str());
+}
+BENCHMARK(BM_UntrustedSequentialWrite)->RangeMultiplier(8)->Range(4 << 10,
+                                                                  64 << 10);
+
+// Measures reading a host file of kFileSize bytes through UntrustedFile from
+// start to end, in reads of state.range(0) bytes.
+void BM_UntrustedSequentialRead(benchmark::State &state) {
+  const size_t io_size = state.range(0);
+  std::vector<char> buffer(kFileSize);
+  WithUntrustedFile(
+      state, BenchmarkPath("untrusted_sequential_read"), O_RDONLY,
+      [&](UntrustedFile *file) {
+        for (auto _ : state) {
+          Status status;
+          for (size_t offset = 0; status.ok() && offset < buffer.size();
+               offset += io_size) {
+            status = file->Read(buffer.data() + offset, offset, io_size);
+          }
+          if (!status.ok()) {
+            state.SkipWithError("Untrusted read failed");
+            break;
+          }
+        }
+      });
+  state.SetBytesProcessed(state.iterations() * kFileSize);
+}
+BENCHMARK(BM_UntrustedSequentialRead)->RangeMultiplier(8)->Range(4 << 10,
+                                                                 64 << 10);
+
+// Measures reads of state.range(0) bytes at random offsets of a host file
+// through UntrustedFile.
+void BM_UntrustedRandomRead(benchmark::State &state) {
+  const size_t io_size = state.range(0);
+  const std::vector<off_t> offsets = RandomOffsets(1024, io_size);
+  std::vector<char> buffer(io_size);
+  WithUntrustedFile(
+      state, BenchmarkPath("untrusted_random_read"), O_RDONLY,
+      [&](UntrustedFile *file) {
+        size_t next = 0;
+        for (auto _ : state) {
+          off_t offset = offsets[next++ % offsets.size()];
+          if (!file->Read(buffer.data(), offset, io_size).ok()) {
+            state.SkipWithError("Untrusted read failed");
+            break;
+          }
+        }
+      });
+  state.SetBytesProcessed(state.iterations() * io_size);
+}
+BENCHMARK(BM_UntrustedRandomRead)->RangeMultiplier(8)->Range(4 << 10,
+                                                             64 << 10);
+
+// Measures overwrites of state.range(0) bytes at random offsets of a host file
+// through UntrustedFile.
+void BM_UntrustedRandomWrite(benchmark::State &state) {
+  const size_t io_size = state.range(0);
+  const std::vector<off_t> offsets = RandomOffsets(1024, io_size);
+  const std::vector<char> buffer(io_size, 'b');
+  WithUntrustedFile(
+      state, BenchmarkPath("untrusted_random_write"), O_RDWR,
+      [&](UntrustedFile *file) {
+        size_t next = 0;
+        for (auto _ : state) {
+          off_t offset = offsets[next++ % offsets.size()];
+          if (!file->Write(buffer.data(), offset, io_size).ok()) {
+            state.SkipWithError("Untrusted write failed");
+            break;
+          }
+        }
+      });
+  state.SetBytesProcessed(state.iterations() * io_size);
+}
+BENCHMARK(BM_UntrustedRandomWrite)->RangeMultiplier(8)->Range(4 << 10,
+                                                              64 << 10);
+
+// Measures opening and closing a host file of state.range(0) bytes.
+void BM_UntrustedOpen(benchmark::State &state) {
+  const std::string path = BenchmarkPath("untrusted_open");
+  if (!CreateUntrustedFile(path, state.range(0))) {
+    state.SkipWithError("Creating the untrusted file failed");
+    return;
+  }
+  char byte;
+  for (auto _ : state) {
+    int fd = OpenUntrustedFile(path, O_RDONLY);
+    if (fd < 0 || read(fd, &byte, 1) != 1 || close(fd) != 0) {
+      state.SkipWithError("Untrusted open failed");
+      break;
+    }
+  }
+  unlink(path.c_str());
+}
+BENCHMARK(BM_UntrustedOpen)->RangeMultiplier(16)->Range(4 << 10,
+                                                        kMaxOpenFileSize);
+
+}  // namespace
+}  // namespace asylo
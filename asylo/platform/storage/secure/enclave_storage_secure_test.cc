@@ -30,8 +30,10 @@
 #include "absl/flags/flag.h"
 #include "absl/strings/str_cat.h"
 #include "asylo/util/logging.h"
+#include "asylo/platform/crypto/gcmlib/gcm_cryptor.h"
 #include "asylo/platform/host_call/trusted/host_calls.h"
 #include "asylo/platform/storage/secure/aead_handler.h"
+#include "asylo/platform/storage/secure/flat_authenticated_dictionary.h"
 #include "asylo/platform/storage/utils/fd_closer.h"
 #include "asylo/test/util/status_matchers.h"
 #include "asylo/test/util/test_flags.h"
@@ -41,16 +43,28 @@
 namespace asylo {
 namespace {
 
+using platform::crypto::gcmlib::GcmCryptor;
+using platform::crypto::gcmlib::GcmCryptorKey;
+using platform::crypto::gcmlib::GcmCryptorRegistry;
 using platform::crypto::gcmlib::kKeyLength;
+using platform::crypto::gcmlib::kTagLength;
 using platform::storage::AeadHandler;
-using platform::storage::kBlockLength;
-using platform::storage::kCipherBlockLength;
+using platform::storage::CipherBlockLength;
+using platform::storage::FlatAuthenticatedDictionary;
+using platform::storage::kDefaultBlockLength;
 using platform::storage::kFileHashLength;
+using platform::storage::kMaxBlockLength;
+using platform::storage::kMerkleTreeFileSuffix;
+using platform::storage::MerkleTreeStorage;
+using platform::storage::SecureBlockLength;
 using platform::storage::secure_close;
 using platform::storage::secure_fstat;
+using platform::storage::secure_fsync;
 using platform::storage::secure_lseek;
 using platform::storage::secure_open;
 using platform::storage::secure_read;
+using platform::storage::secure_rename;
+using platform::storage::secure_unlink;
 using platform::storage::secure_write;
 using ::testing::Not;
 
@@ -65,7 +79,13 @@ class EnclaveStorageSecureTest : public ::testing::Test,
   Status OpenWriteClose(off_t offset);
   Status OpenReadVerifyClose(off_t offset, size_t bytes_expected);
 
-  const int64_t kFileHeaderLength = kFileHashLength + sizeof(size_t);
+  // Rewrites the file, which must have the default block length and keep its
+  // Merkle tree in memory, with the unversioned header of the files written
+  // before the block length and the tree storage were recorded.
+  Status RewriteWithLegacyHeader();
+
+  const int64_t kFileHeaderLength =
+      kFileHashLength + sizeof(uint64_t) + 2 * sizeof(uint32_t);
   const std::string &GetPath() const { return path_; }
   const void *GetWriteBuffer() const {
     return reinterpret_cast<const void *>(write_buffer_);
@@ -78,6 +98,34 @@ class EnclaveStorageSecureTest : public ::testing::Test,
     return AeadHandler::GetInstance().SetMasterKey(fd, key_.data(),
                                                    key_.size());
   }
+  int EmulateSetBlockLengthIoctl(int fd, uint32_t block_length) const {
+    return AeadHandler::GetInstance().SetBlockLength(fd, block_length);
+  }
+  int EmulateSetMerkleTreeStorageIoctl(int fd,
+                                       MerkleTreeStorage storage) const {
+    return AeadHandler::GetInstance().SetMerkleTreeStorage(fd, storage);
+  }
+  int EmulateSetDigestWriteBackIoctl(int fd, uint64_t max_dirty_bytes) const {
+    return AeadHandler::GetInstance().SetDigestWriteBack(fd, max_dirty_bytes);
+  }
+
+  // Returns the logical file size recorded in the header of the file on disk,
+  // or -1 on failure.
+  int64_t ReadPersistedFileSize() const {
+    int fd = enc_untrusted_open(GetPath().c_str(), O_RDONLY);
+    if (fd < 0) {
+      return -1;
+    }
+    platform::storage::FdCloser fd_closer(fd, &enc_untrusted_close);
+    uint64_t versioned_size;
+    if (enc_untrusted_lseek(fd, kFileHashLength, SEEK_SET) != kFileHashLength ||
+        enc_untrusted_read(fd, &versioned_size, sizeof(versioned_size)) !=
+            sizeof(versioned_size)) {
+      return -1;
+    }
+    // The top byte of the size field holds the version of the header.
+    return versioned_size & ((uint64_t{1} << 56) - 1);
+  }
 
   size_t test_buf_len_;
   std::string path_;
@@ -100,6 +148,7 @@ void EnclaveStorageSecureTest::PrepareTest() {
   // occasionally the test is executed on the same (virtual) machine.
   LOG(INFO) << "Cleaning up test file if present, path = " << path_;
   remove(path_.c_str());
+  remove(absl::StrCat(path_, kMerkleTreeFileSuffix).c_str());
 
   // Generate the test key.
   key_.resize(kKeyLength);
@@ -212,6 +261,57 @@ Status EnclaveStorageSecureTest::OpenReadVerifyClose(off_t offset,
   return Status::OkStatus();
 }
 
+Status EnclaveStorageSecureTest::RewriteWithLegacyHeader() {
+  int fd = enc_untrusted_open(GetPath().c_str(), O_RDWR);
+  if (fd < 0) {
+    return Status(error::GoogleError::INTERNAL, "Open failed.");
+  }
+  platform::storage::FdCloser fd_closer(fd, &enc_untrusted_close);
+  std::string contents;
+  char buffer[4096];
+  ssize_t bytes_read;
+  while ((bytes_read = enc_untrusted_read(fd, buffer, sizeof(buffer))) > 0) {
+    contents.append(buffer, bytes_read);
+  }
+  if (bytes_read < 0 ||
+      contents.size() < static_cast<size_t>(kFileHeaderLength)) {
+    return Status(error::GoogleError::INTERNAL, "Read failed.");
+  }
+
+  // The legacy digest is the root of the tree over the block tags followed by
+  // the file size, which the legacy header holds without a version.
+  FlatAuthenticatedDictionary dictionary;
+  const size_t secure_block_length = SecureBlockLength(kDefaultBlockLength);
+  for (size_t offset = kFileHeaderLength;
+       offset + secure_block_length <= contents.size();
+       offset += secure_block_length) {
+    dictionary.AddLeafDigest(FlatAuthenticatedDictionary::HashLeaf(
+        &contents[offset + kDefaultBlockLength], kTagLength));
+  }
+  const uint64_t file_size = ReadPersistedFileSize();
+  std::string digest = dictionary.CurrentRoot();
+  digest.append(reinterpret_cast<const char *>(&file_size), sizeof(file_size));
+
+  GcmCryptor *cryptor = GcmCryptorRegistry::GetInstance().GetGcmCryptor(
+      kDefaultBlockLength, GcmCryptorKey(key_.data(), key_.size()));
+  std::string header(kFileHashLength, '\0');
+  if (!cryptor ||
+      !cryptor->GetAuthTag(reinterpret_cast<uint8_t *>(&header[0]),
+                           reinterpret_cast<const uint8_t *>(digest.data()),
+                           digest.size())) {
+    return Status(error::GoogleError::INTERNAL, "Digest failed.");
+  }
+  header.append(reinterpret_cast<const char *>(&file_size), sizeof(file_size));
+  contents.replace(0, kFileHeaderLength, header);
+
+  if (enc_untrusted_ftruncate(fd, 0) != 0 ||
+      enc_untrusted_pwrite64(fd, contents.data(), contents.size(), 0) !=
+          static_cast<ssize_t>(contents.size())) {
+    return Status(error::GoogleError::INTERNAL, "Write failed.");
+  }
+  return Status::OkStatus();
+}
+
 //
 // Success cases.
 //
@@ -439,7 +539,7 @@ TEST_P(EnclaveStorageSecureTest, ModificationWriteSuccessTest) {
   EXPECT_THAT(OpenWriteClose(0), IsOk());
   EXPECT_THAT(OpenReadVerifyClose(0, test_buf_len_), IsOk());
 
-  if (test_buf_len_ / kBlockLength != 1) {
+  if (test_buf_len_ / kDefaultBlockLength != 1) {
     // Test mixed update-append write: lseek to the middle of written range -
     // the next write will include both updated and appended file data.
     off_t offset = test_buf_len_ / 2;
@@ -471,14 +571,14 @@ TEST_P(EnclaveStorageSecureTest, ModificationWriteSuccessTest) {
 TEST_P(EnclaveStorageSecureTest, SimpleMisalignedWriteSuccess) {
   EXPECT_THAT(OpenWriteClose(0), IsOk());
   // Lseek to the middle of the last block.
-  off_t offset = test_buf_len_ - kBlockLength / 2;
+  off_t offset = test_buf_len_ - kDefaultBlockLength / 2;
   EXPECT_THAT(OpenWriteClose(offset), IsOk());
 }
 
 TEST_P(EnclaveStorageSecureTest, SimpleMisalignedReadSuccess) {
   EXPECT_THAT(OpenWriteClose(0), IsOk());
   // Lseek to the middle of the first block.
-  off_t offset = kBlockLength / 2;
+  off_t offset = kDefaultBlockLength / 2;
   EXPECT_THAT(OpenReadVerifyClose(offset, test_buf_len_ - offset), IsOk());
 }
 
@@ -503,10 +603,296 @@ TEST_P(EnclaveStorageSecureTest, LseekEndSuccess) {
   EXPECT_EQ(secure_close(fd), 0);
 }
 
+TEST_P(EnclaveStorageSecureTest, LargeBlockLengthReadWriteSuccess) {
+  constexpr uint32_t kLargeBlockLength = 4096;
+
+  int fd = secure_open(GetPath().c_str(), O_WRONLY | O_CREAT,
+                       S_IRWXU | S_IRWXG | S_IRWXO);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(EmulateSetBlockLengthIoctl(fd, kLargeBlockLength), 0);
+  ASSERT_EQ(EmulateSetKeyIoctl(fd), 0);
+  EXPECT_EQ(secure_write(fd, GetWriteBuffer(), test_buf_len_), test_buf_len_);
+  EXPECT_EQ(secure_close(fd), 0);
+
+  // The whole test buffer fits into a single block.
+  struct stat file_stat;
+  ASSERT_EQ(enc_untrusted_stat(GetPath().c_str(), &file_stat), 0);
+  EXPECT_EQ(file_stat.st_size,
+            kFileHeaderLength + SecureBlockLength(kLargeBlockLength));
+
+  // The block length is read back from the file header, so a request for a
+  // different block length on an existing file is ignored.
+  fd = secure_open(GetPath().c_str(), O_RDWR);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(EmulateSetBlockLengthIoctl(fd, kMaxBlockLength), 0);
+  ASSERT_EQ(EmulateSetKeyIoctl(fd), 0);
+  EXPECT_EQ(secure_lseek(fd, test_buf_len_ / 2, SEEK_SET), test_buf_len_ / 2);
+  EXPECT_EQ(secure_write(fd, GetWriteBuffer(), test_buf_len_), test_buf_len_);
+  EXPECT_EQ(secure_close(fd), 0);
+
+  // The test buffer repeats a pattern which evenly divides half its length.
+  EXPECT_THAT(OpenReadVerifyClose(0, test_buf_len_), IsOk());
+  EXPECT_THAT(OpenReadVerifyClose(test_buf_len_ / 2, test_buf_len_), IsOk());
+}
+
+TEST_P(EnclaveStorageSecureTest, InMemoryMerkleTreeReadWriteSuccess) {
+  int fd = secure_open(GetPath().c_str(), O_WRONLY | O_CREAT,
+                       S_IRWXU | S_IRWXG | S_IRWXO);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(EmulateSetMerkleTreeStorageIoctl(fd, MerkleTreeStorage::kInMemory),
+            0);
+  ASSERT_EQ(EmulateSetKeyIoctl(fd), 0);
+  EXPECT_EQ(secure_write(fd, GetWriteBuffer(), test_buf_len_), test_buf_len_);
+  EXPECT_EQ(secure_write(fd, GetWriteBuffer(), test_buf_len_), test_buf_len_);
+  EXPECT_EQ(secure_close(fd), 0);
+
+  // No tree is kept on the host.
+  struct stat file_stat;
+  EXPECT_EQ(enc_untrusted_stat(
+                absl::StrCat(GetPath(), kMerkleTreeFileSuffix).c_str(),
+                &file_stat),
+            -1);
+
+  // The selection is read back from the file header, so a request for the
+  // persistent tree on an existing file is ignored.
+  fd = secure_open(GetPath().c_str(), O_RDWR);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(
+      EmulateSetMerkleTreeStorageIoctl(fd, MerkleTreeStorage::kPersistent), 0);
+  ASSERT_EQ(EmulateSetKeyIoctl(fd), 0);
+  EXPECT_EQ(
+      EmulateSetMerkleTreeStorageIoctl(fd, MerkleTreeStorage::kPersistent), -1);
+  EXPECT_EQ(errno, EBUSY);
+  EXPECT_EQ(secure_lseek(fd, test_buf_len_ / 2, SEEK_SET), test_buf_len_ / 2);
+  EXPECT_EQ(secure_write(fd, GetWriteBuffer(), test_buf_len_), test_buf_len_);
+  EXPECT_EQ(secure_close(fd), 0);
+
+  EXPECT_THAT(OpenReadVerifyClose(0, test_buf_len_), IsOk());
+  EXPECT_THAT(OpenReadVerifyClose(test_buf_len_ / 2, test_buf_len_), IsOk());
+  EXPECT_THAT(OpenReadVerifyClose(test_buf_len_, test_buf_len_), IsOk());
+}
+
+TEST_P(EnclaveStorageSecureTest, InMemoryMerkleTreeAuthTagsModified) {
+  int fd = secure_open(GetPath().c_str(), O_WRONLY | O_CREAT,
+                       S_IRWXU | S_IRWXG | S_IRWXO);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(EmulateSetMerkleTreeStorageIoctl(fd, MerkleTreeStorage::kInMemory),
+            0);
+  ASSERT_EQ(EmulateSetKeyIoctl(fd), 0);
+  EXPECT_EQ(secure_write(fd, GetWriteBuffer(), test_buf_len_), test_buf_len_);
+  EXPECT_EQ(secure_close(fd), 0);
+
+  // Modify an auth tag - form of tampering. The tree rebuilt from the tags no
+  // longer matches the digest.
+  fd = enc_untrusted_open(GetPath().c_str(), O_WRONLY);
+  ASSERT_GE(fd, 0);
+  EXPECT_GT(enc_untrusted_lseek(fd, kFileHeaderLength + kDefaultBlockLength,
+                                SEEK_SET),
+            0);
+  EXPECT_GT(enc_untrusted_write(fd, kTamperData, ABSL_ARRAYSIZE(kTamperData)),
+            0);
+  ASSERT_EQ(enc_untrusted_close(fd), 0) << strerror(errno);
+  EXPECT_THAT(OpenReadVerifyClose(0, test_buf_len_),
+              StatusIs(error::GoogleError::INTERNAL, "Set master Key failed."));
+}
+
+TEST_P(EnclaveStorageSecureTest, LegacyHeaderReadWriteSuccess) {
+  int fd = secure_open(GetPath().c_str(), O_WRONLY | O_CREAT,
+                       S_IRWXU | S_IRWXG | S_IRWXO);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(EmulateSetMerkleTreeStorageIoctl(fd, MerkleTreeStorage::kInMemory),
+            0);
+  ASSERT_EQ(EmulateSetKeyIoctl(fd), 0);
+  EXPECT_EQ(secure_write(fd, GetWriteBuffer(), test_buf_len_), test_buf_len_);
+  EXPECT_EQ(secure_close(fd), 0);
+  ASSERT_THAT(RewriteWithLegacyHeader(), IsOk());
+
+  // The file is read with the default block length and a tree rebuilt in
+  // memory, and keeps its legacy header when written.
+  EXPECT_THAT(OpenReadVerifyClose(0, test_buf_len_), IsOk());
+  EXPECT_THAT(OpenWriteClose(test_buf_len_), IsOk());
+  EXPECT_EQ(ReadPersistedFileSize(), 2 * test_buf_len_);
+  const size_t blocks_count =
+      (2 * test_buf_len_ + kDefaultBlockLength - 1) / kDefaultBlockLength;
+  struct stat file_stat;
+  ASSERT_EQ(enc_untrusted_stat(GetPath().c_str(), &file_stat), 0);
+  EXPECT_EQ(file_stat.st_size,
+            kFileHashLength + sizeof(uint64_t) +
+                blocks_count * SecureBlockLength(kDefaultBlockLength));
+  EXPECT_EQ(enc_untrusted_stat(
+                absl::StrCat(GetPath(), kMerkleTreeFileSuffix).c_str(),
+                &file_stat),
+            -1);
+  EXPECT_THAT(OpenReadVerifyClose(test_buf_len_, test_buf_len_), IsOk());
+}
+
+TEST_P(EnclaveStorageSecureTest, MissingMerkleTreeFileRebuiltSuccess) {
+  EXPECT_THAT(OpenWriteClose(0), IsOk());
+  const std::string tree_path = absl::StrCat(GetPath(), kMerkleTreeFileSuffix);
+  ASSERT_EQ(enc_untrusted_unlink(tree_path.c_str()), 0) << strerror(errno);
+
+  // The tree is rebuilt from the block tags and written out again.
+  EXPECT_THAT(OpenReadVerifyClose(0, test_buf_len_), IsOk());
+  struct stat file_stat;
+  ASSERT_EQ(enc_untrusted_stat(tree_path.c_str(), &file_stat), 0);
+  EXPECT_GT(file_stat.st_size, 0);
+  EXPECT_THAT(OpenReadVerifyClose(test_buf_len_ / 2, test_buf_len_), IsOk());
+}
+
+TEST_P(EnclaveStorageSecureTest, RenameAndUnlinkMerkleTreeFileSuccess) {
+  EXPECT_THAT(OpenWriteClose(0), IsOk());
+  const std::string new_path = absl::StrCat(GetPath(), ".renamed");
+  const std::string tree_path = absl::StrCat(GetPath(), kMerkleTreeFileSuffix);
+  const std::string new_tree_path =
+      absl::StrCat(new_path, kMerkleTreeFileSuffix);
+
+  // The tree file moves along with the file.
+  ASSERT_EQ(secure_rename(GetPath().c_str(), new_path.c_str()), 0)
+      << strerror(errno);
+  struct stat file_stat;
+  EXPECT_EQ(enc_untrusted_stat(tree_path.c_str(), &file_stat), -1);
+  EXPECT_EQ(enc_untrusted_stat(new_tree_path.c_str(), &file_stat), 0);
+  ASSERT_EQ(secure_rename(new_path.c_str(), GetPath().c_str()), 0)
+      << strerror(errno);
+  EXPECT_THAT(OpenReadVerifyClose(0, test_buf_len_), IsOk());
+
+  // Removing the file also removes its tree file.
+  ASSERT_EQ(secure_unlink(GetPath().c_str()), 0) << strerror(errno);
+  EXPECT_EQ(enc_untrusted_stat(GetPath().c_str(), &file_stat), -1);
+  EXPECT_EQ(enc_untrusted_stat(tree_path.c_str(), &file_stat), -1);
+}
+
+TEST_P(EnclaveStorageSecureTest, DigestWriteBackPersistedOnCloseSuccess) {
+  int fd = secure_open(GetPath().c_str(), O_WRONLY | O_CREAT,
+                       S_IRWXU | S_IRWXG | S_IRWXO);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(EmulateSetKeyIoctl(fd), 0);
+  ASSERT_EQ(EmulateSetDigestWriteBackIoctl(fd, 4 * test_buf_len_), 0);
+
+  EXPECT_EQ(secure_write(fd, GetWriteBuffer(), test_buf_len_), test_buf_len_);
+  EXPECT_EQ(secure_write(fd, GetWriteBuffer(), test_buf_len_), test_buf_len_);
+  EXPECT_EQ(ReadPersistedFileSize(), 0);
+
+  EXPECT_EQ(secure_close(fd), 0);
+  EXPECT_EQ(ReadPersistedFileSize(), 2 * test_buf_len_);
+  EXPECT_THAT(OpenReadVerifyClose(test_buf_len_, test_buf_len_), IsOk());
+}
+
+TEST_P(EnclaveStorageSecureTest, DigestWriteBackPersistedOnSyncSuccess) {
+  int fd = secure_open(GetPath().c_str(), O_WRONLY | O_CREAT,
+                       S_IRWXU | S_IRWXG | S_IRWXO);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(EmulateSetKeyIoctl(fd), 0);
+  ASSERT_EQ(EmulateSetDigestWriteBackIoctl(fd, 4 * test_buf_len_), 0);
+
+  EXPECT_EQ(secure_write(fd, GetWriteBuffer(), test_buf_len_), test_buf_len_);
+  EXPECT_EQ(ReadPersistedFileSize(), 0);
+  EXPECT_EQ(secure_fsync(fd), 0);
+  EXPECT_EQ(ReadPersistedFileSize(), test_buf_len_);
+
+  // Restoring write-through persists pending updates, then every write.
+  EXPECT_EQ(secure_write(fd, GetWriteBuffer(), test_buf_len_), test_buf_len_);
+  EXPECT_EQ(EmulateSetDigestWriteBackIoctl(fd, 0), 0);
+  EXPECT_EQ(ReadPersistedFileSize(), 2 * test_buf_len_);
+  EXPECT_EQ(secure_write(fd, GetWriteBuffer(), test_buf_len_), test_buf_len_);
+  EXPECT_EQ(ReadPersistedFileSize(), 3 * test_buf_len_);
+
+  EXPECT_EQ(secure_close(fd), 0);
+}
+
+TEST_P(EnclaveStorageSecureTest, DigestWriteBackPersistedOnThresholdSuccess) {
+  int fd = secure_open(GetPath().c_str(), O_WRONLY | O_CREAT,
+                       S_IRWXU | S_IRWXG | S_IRWXO);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(EmulateSetKeyIoctl(fd), 0);
+  ASSERT_EQ(EmulateSetDigestWriteBackIoctl(fd, test_buf_len_), 0);
+
+  EXPECT_EQ(secure_write(fd, GetWriteBuffer(), test_buf_len_ / 2),
+            test_buf_len_ / 2);
+  EXPECT_EQ(ReadPersistedFileSize(), 0);
+  EXPECT_EQ(secure_write(fd, GetWriteBuffer(), test_buf_len_ / 2),
+            test_buf_len_ / 2);
+  EXPECT_EQ(ReadPersistedFileSize(), test_buf_len_);
+
+  EXPECT_EQ(secure_close(fd), 0);
+}
+
 //
 // Failure cases.
 //
 
+TEST_P(EnclaveStorageSecureTest, DigestWriteBackCrashRevertsAppends) {
+  EXPECT_THAT(OpenWriteClose(0), IsOk());
+
+  int fd = secure_open(GetPath().c_str(), O_WRONLY);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(EmulateSetKeyIoctl(fd), 0);
+  ASSERT_EQ(EmulateSetDigestWriteBackIoctl(fd, 4 * test_buf_len_), 0);
+  ASSERT_EQ(secure_lseek(fd, 0, SEEK_END), test_buf_len_);
+  EXPECT_EQ(secure_write(fd, GetWriteBuffer(), test_buf_len_), test_buf_len_);
+
+  // Emulate a crash by dropping the descriptor without persisting the digest.
+  EXPECT_TRUE(AeadHandler::GetInstance().FinalizeFile(fd));
+  EXPECT_EQ(enc_untrusted_close(fd), 0);
+
+  // The header still describes the file before the append. Appending to a
+  // partially filled last block rewrites it, which fails verification.
+  EXPECT_EQ(ReadPersistedFileSize(), test_buf_len_);
+  if (test_buf_len_ % kDefaultBlockLength == 0) {
+    EXPECT_THAT(OpenReadVerifyClose(0, test_buf_len_), IsOk());
+  } else {
+    EXPECT_THAT(OpenReadVerifyClose(0, test_buf_len_),
+                StatusIs(error::GoogleError::INTERNAL, "Secure read failed."));
+  }
+}
+
+TEST_P(EnclaveStorageSecureTest, DigestWriteBackCrashFailsRewrittenBlocks) {
+  EXPECT_THAT(OpenWriteClose(0), IsOk());
+
+  int fd = secure_open(GetPath().c_str(), O_WRONLY);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(EmulateSetKeyIoctl(fd), 0);
+  ASSERT_EQ(EmulateSetDigestWriteBackIoctl(fd, 4 * test_buf_len_), 0);
+  EXPECT_EQ(secure_write(fd, GetWriteBuffer(), test_buf_len_), test_buf_len_);
+
+  // Emulate a crash by dropping the descriptor without persisting the digest.
+  EXPECT_TRUE(AeadHandler::GetInstance().FinalizeFile(fd));
+  EXPECT_EQ(enc_untrusted_close(fd), 0);
+
+  // The rewritten blocks no longer match the Merkle tree covered by the digest
+  // in the header.
+  EXPECT_THAT(OpenReadVerifyClose(0, test_buf_len_),
+              StatusIs(error::GoogleError::INTERNAL, "Secure read failed."));
+}
+
+TEST_P(EnclaveStorageSecureTest, InvalidBlockLengthFailure) {
+  int fd = secure_open(GetPath().c_str(), O_WRONLY | O_CREAT,
+                       S_IRWXU | S_IRWXG | S_IRWXO);
+  ASSERT_GE(fd, 0);
+
+  EXPECT_EQ(EmulateSetBlockLengthIoctl(fd, kDefaultBlockLength / 2), -1);
+  EXPECT_EQ(errno, EINVAL);
+  EXPECT_EQ(EmulateSetBlockLengthIoctl(fd, 3 * kDefaultBlockLength), -1);
+  EXPECT_EQ(errno, EINVAL);
+  EXPECT_EQ(EmulateSetBlockLengthIoctl(fd, 2 * kMaxBlockLength), -1);
+  EXPECT_EQ(errno, EINVAL);
+
+  EXPECT_EQ(secure_close(fd), 0);
+}
+
+TEST_P(EnclaveStorageSecureTest, BlockLengthChangeAfterKeyFailure) {
+  int fd = secure_open(GetPath().c_str(), O_WRONLY | O_CREAT,
+                       S_IRWXU | S_IRWXG | S_IRWXO);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(EmulateSetKeyIoctl(fd), 0);
+
+  EXPECT_EQ(EmulateSetBlockLengthIoctl(fd, kDefaultBlockLength), 0);
+  EXPECT_EQ(EmulateSetBlockLengthIoctl(fd, 2 * kDefaultBlockLength), -1);
+  EXPECT_EQ(errno, EBUSY);
+
+  EXPECT_EQ(secure_close(fd), 0);
+}
+
 TEST_P(EnclaveStorageSecureTest, ReadWriteDataModified) {
   EXPECT_THAT(OpenWriteClose(0), IsOk());
   // Modify file data - form of tampering.
@@ -540,14 +926,37 @@ TEST_P(EnclaveStorageSecureTest, ReadWriteAuthTagsModified) {
   // Modify an auth tag - form of tampering.
   int fd = enc_untrusted_open(GetPath().c_str(), O_WRONLY);
   ASSERT_GE(fd, 0);
-  EXPECT_GT(enc_untrusted_lseek(fd, kFileHeaderLength + kBlockLength, SEEK_SET),
+  EXPECT_GT(enc_untrusted_lseek(fd, kFileHeaderLength + kDefaultBlockLength,
+                                SEEK_SET),
             0);
   EXPECT_GT(enc_untrusted_write(fd, kTamperData, ABSL_ARRAYSIZE(kTamperData)),
             0);
   ASSERT_EQ(enc_untrusted_fsync(fd), 0) << strerror(errno);
   ASSERT_EQ(enc_untrusted_close(fd), 0) << strerror(errno);
   EXPECT_THAT(OpenReadVerifyClose(0, test_buf_len_),
-              StatusIs(error::GoogleError::INTERNAL, "Set master Key failed."));
+              StatusIs(error::GoogleError::INTERNAL, "Secure read failed."));
+}
+
+TEST_P(EnclaveStorageSecureTest, MerkleTreeNodesModified) {
+  EXPECT_THAT(OpenWriteClose(0), IsOk());
+
+  // Modify the hash stored for the first block - form of tampering. It is also
+  // the root of the tree when the file holds a single block.
+  int fd = enc_untrusted_open(
+      absl::StrCat(GetPath(), kMerkleTreeFileSuffix).c_str(), O_WRONLY);
+  ASSERT_GE(fd, 0);
+  EXPECT_GT(enc_untrusted_write(fd, kTamperData, ABSL_ARRAYSIZE(kTamperData)),
+            0);
+  ASSERT_EQ(enc_untrusted_fsync(fd), 0) << strerror(errno);
+  ASSERT_EQ(enc_untrusted_close(fd), 0) << strerror(errno);
+  if (test_buf_len_ <= kDefaultBlockLength) {
+    EXPECT_THAT(
+        OpenReadVerifyClose(0, test_buf_len_),
+        StatusIs(error::GoogleError::INTERNAL, "Set master Key failed."));
+  } else {
+    EXPECT_THAT(OpenReadVerifyClose(0, test_buf_len_),
+                StatusIs(error::GoogleError::INTERNAL, "Secure read failed."));
+  }
 }
 
 TEST_P(EnclaveStorageSecureTest, ReadWriteTokensModified) {
@@ -556,9 +965,10 @@ TEST_P(EnclaveStorageSecureTest, ReadWriteTokensModified) {
   // Modify a token - form of tampering.
   int fd = enc_untrusted_open(GetPath().c_str(), O_WRONLY);
   ASSERT_GE(fd, 0);
-  EXPECT_GT(
-      enc_untrusted_lseek(fd, kFileHeaderLength + kCipherBlockLength, SEEK_SET),
-      0);
+  EXPECT_GT(enc_untrusted_lseek(
+                fd, kFileHeaderLength + CipherBlockLength(kDefaultBlockLength),
+                SEEK_SET),
+            0);
   EXPECT_GT(enc_untrusted_write(fd, kTamperData, ABSL_ARRAYSIZE(kTamperData)),
             0);
   ASSERT_EQ(enc_untrusted_fsync(fd), 0) << strerror(errno);
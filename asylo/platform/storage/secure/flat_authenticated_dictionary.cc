@@ -0,0 +1,180 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/storage/secure/flat_authenticated_dictionary.h"
+
+#include <algorithm>
+
+#include "asylo/platform/storage/secure/merkle_tree_layout.h"
+
+namespace asylo {
+namespace platform {
+namespace storage {
+
+using merkle_tree_layout::HasParent;
+using merkle_tree_layout::IsLeftChild;
+using merkle_tree_layout::kMaxDepth;
+using merkle_tree_layout::Parent;
+using merkle_tree_layout::Sibling;
+using merkle_tree_layout::SubtreeRoot;
+
+namespace {
+
+// Domain separation prefixes of RFC 6962.
+constexpr uint8_t kLeafPrefix = 0x00;
+constexpr uint8_t kNodePrefix = 0x01;
+
+}  // namespace
+
+constexpr size_t FlatAuthenticatedDictionary::kDigestLength;
+
+FlatAuthenticatedDictionary::FlatAuthenticatedDictionary()
+    : leaf_count_(0), root_is_stale_(false) {
+  SHA256(nullptr, 0, root_.data());
+}
+
+void FlatAuthenticatedDictionary::Reserve(size_t leaf_count) {
+  if (leaf_count > 0) {
+    nodes_.reserve(2 * leaf_count - 1);
+  }
+}
+
+FlatAuthenticatedDictionary::Digest FlatAuthenticatedDictionary::HashLeaf(
+    const void *data, size_t size) {
+  Digest digest;
+  SHA256_CTX context;
+  SHA256_Init(&context);
+  SHA256_Update(&context, &kLeafPrefix, sizeof(kLeafPrefix));
+  SHA256_Update(&context, data, size);
+  SHA256_Final(digest.data(), &context);
+  return digest;
+}
+
+void FlatAuthenticatedDictionary::HashChildren(const Digest &left,
+                                               const Digest &right,
+                                               Digest *parent) {
+  // Hash both children from a single contiguous buffer, so that the whole
+  // input goes through one run of the SHA-256 block function.
+  uint8_t input[1 + 2 * kDigestLength];
+  input[0] = kNodePrefix;
+  std::copy(left.begin(), left.end(), input + 1);
+  std::copy(right.begin(), right.end(), input + 1 + kDigestLength);
+  SHA256(input, sizeof(input), parent->data());
+}
+
+size_t FlatAuthenticatedDictionary::AddLeafDigest(const Digest &digest) {
+  uint64_t node = 2 * leaf_count_;
+  leaf_count_++;
+  nodes_.resize(node + 1);
+  nodes_[node] = digest;
+
+  // The new leaf completes the subtrees whose left halves were complete before.
+  // Their roots precede the new leaf, so they are already in |nodes_|.
+  while (HasParent(node, leaf_count_)) {
+    uint64_t parent = Parent(node);
+    HashChildren(nodes_[Sibling(node)], nodes_[node], &nodes_[parent]);
+    node = parent;
+  }
+  root_is_stale_ = true;
+  return leaf_count_;
+}
+
+bool FlatAuthenticatedDictionary::UpdateLeafDigest(size_t leaf,
+                                                   const Digest &digest) {
+  if (leaf == 0 || leaf > leaf_count_) {
+    return false;
+  }
+
+  uint64_t node = 2 * (leaf - 1);
+  nodes_[node] = digest;
+  while (HasParent(node, leaf_count_)) {
+    uint64_t parent = Parent(node);
+    if (IsLeftChild(node)) {
+      HashChildren(nodes_[node], nodes_[Sibling(node)], &nodes_[parent]);
+    } else {
+      HashChildren(nodes_[Sibling(node)], nodes_[node], &nodes_[parent]);
+    }
+    node = parent;
+  }
+  root_is_stale_ = true;
+  return true;
+}
+
+const FlatAuthenticatedDictionary::Digest &
+FlatAuthenticatedDictionary::RootDigest() {
+  if (!root_is_stale_) {
+    return root_;
+  }
+
+  if (leaf_count_ == 0) {
+    SHA256(nullptr, 0, root_.data());
+  } else {
+    // Fold the roots of the complete subtrees, starting from the rightmost,
+    // which is the smallest.
+    int depth = __builtin_ctzll(leaf_count_);
+    root_ = nodes_[SubtreeRoot(depth, leaf_count_)];
+    for (depth++; depth < kMaxDepth; depth++) {
+      if (leaf_count_ & (uint64_t{1} << depth)) {
+        HashChildren(nodes_[SubtreeRoot(depth, leaf_count_)], root_, &root_);
+      }
+    }
+  }
+  root_is_stale_ = false;
+  return root_;
+}
+
+size_t FlatAuthenticatedDictionary::AddLeaf(const std::string &data) {
+  return AddLeafDigest(HashLeaf(data.data(), data.size()));
+}
+
+size_t FlatAuthenticatedDictionary::AddLeafHash(const std::string &hash) {
+  if (hash.size() != kDigestLength) {
+    return 0;
+  }
+  Digest digest;
+  std::copy(hash.begin(), hash.end(), digest.begin());
+  return AddLeafDigest(digest);
+}
+
+std::string FlatAuthenticatedDictionary::CurrentRoot() {
+  const Digest &root = RootDigest();
+  return std::string(root.begin(), root.end());
+}
+
+std::string FlatAuthenticatedDictionary::LeafHash(size_t leaf) const {
+  if (leaf == 0 || leaf > leaf_count_) {
+    return "";
+  }
+  const Digest &digest = LeafDigest(leaf);
+  return std::string(digest.begin(), digest.end());
+}
+
+std::string FlatAuthenticatedDictionary::LeafHash(
+    const std::string &data) const {
+  Digest digest = HashLeaf(data.data(), data.size());
+  return std::string(digest.begin(), digest.end());
+}
+
+bool FlatAuthenticatedDictionary::UpdateLeaf(size_t leaf,
+                                             const std::string &data) {
+  return UpdateLeafDigest(leaf, HashLeaf(data.data(), data.size()));
+}
+
+}  // namespace storage
+}  // namespace platform
+}  // namespace asylo
@@ -0,0 +1,115 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_STORAGE_SECURE_FLAT_AUTHENTICATED_DICTIONARY_H_
+#define ASYLO_PLATFORM_STORAGE_SECURE_FLAT_AUTHENTICATED_DICTIONARY_H_
+
+#include <openssl/sha.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "asylo/platform/storage/secure/authenticated_dictionary.h"
+
+namespace asylo {
+namespace platform {
+namespace storage {
+
+// Authenticated Dictionary implementation which keeps its whole Merkle tree in
+// trusted memory, as a flat array of fixed-size SHA-256 digests in the in-order
+// layout described in merkle_tree_layout.h. Leaves and inner nodes are hashed
+// as specified by RFC 6962, so the roots match those of
+// CTMMTAuthenticatedDictionary and PersistentAuthenticatedDictionary.
+//
+// Unlike the other implementations, hashing and tree maintenance do not
+// allocate: the Digest methods below work on std::array values, and the tree
+// only grows when leaves are appended. The std::string methods of the
+// AuthenticatedDictionary interface are implemented on top of them.
+//
+// The const methods may be called concurrently with each other.
+class FlatAuthenticatedDictionary : public AuthenticatedDictionary {
+ public:
+  static constexpr size_t kDigestLength = SHA256_DIGEST_LENGTH;
+
+  using Digest = std::array<uint8_t, kDigestLength>;
+
+  FlatAuthenticatedDictionary();
+
+  // Reserves memory for a tree of |leaf_count| leaves.
+  void Reserve(size_t leaf_count);
+
+  // Returns the hash of a leaf holding |size| bytes of |data|.
+  static Digest HashLeaf(const void *data, size_t size);
+
+  // Appends a leaf of hash |digest|. Returns the position of the leaf in the
+  // tree, starting from 1.
+  size_t AddLeafDigest(const Digest &digest);
+
+  // Sets the hash of the |leaf|th leaf to |digest|. Indexing starts from 1.
+  // Returns false if the leaf does not exist.
+  bool UpdateLeafDigest(size_t leaf, const Digest &digest);
+
+  // Returns the hash of the |leaf|th leaf. Indexing starts from 1. |leaf| must
+  // exist.
+  const Digest &LeafDigest(size_t leaf) const { return nodes_[2 * (leaf - 1)]; }
+
+  // Returns the current root of the tree, or the hash of an empty string if the
+  // tree is empty.
+  const Digest &RootDigest();
+
+  size_t LeafCount() const final { return leaf_count_; }
+
+  size_t AddLeaf(const std::string &data) final;
+
+  // Returns 0 and leaves the tree untouched if |hash| is not a digest.
+  size_t AddLeafHash(const std::string &hash) final;
+
+  std::string CurrentRoot() final;
+
+  // Returns an empty string if the leaf does not exist.
+  std::string LeafHash(size_t leaf) const final;
+
+  std::string LeafHash(const std::string &data) const final;
+
+  bool UpdateLeaf(size_t leaf, const std::string &data) final;
+
+ private:
+  // Sets |parent| to the hash of the inner node with children |left| and
+  // |right|.
+  static void HashChildren(const Digest &left, const Digest &right,
+                           Digest *parent);
+
+  size_t leaf_count_;
+
+  // Nodes keyed on their in-order position. Positions which do not hold a
+  // node of the current tree are unused.
+  std::vector<Digest> nodes_;
+
+  // Root of the tree, valid unless |root_is_stale_| is set.
+  Digest root_;
+  bool root_is_stale_;
+};
+
+}  // namespace storage
+}  // namespace platform
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_STORAGE_SECURE_FLAT_AUTHENTICATED_DICTIONARY_H_
@@ -0,0 +1,138 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/storage/secure/flat_authenticated_dictionary.h"
+
+#include <algorithm>
+#include <string>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/strings/str_cat.h"
+#include "asylo/platform/storage/secure/ctmmt_authenticated_dictionary.h"
+
+namespace asylo {
+namespace platform {
+namespace storage {
+namespace {
+
+using ::testing::Eq;
+using ::testing::IsEmpty;
+using ::testing::Ne;
+
+using Digest = FlatAuthenticatedDictionary::Digest;
+
+// Returns the digest of the inner node with children |left| and |right|.
+Digest HashChildren(const Digest &left, const Digest &right) {
+  uint8_t input[1 + 2 * SHA256_DIGEST_LENGTH];
+  input[0] = 0x01;
+  std::copy(left.begin(), left.end(), input + 1);
+  std::copy(right.begin(), right.end(), input + 1 + SHA256_DIGEST_LENGTH);
+  Digest digest;
+  SHA256(input, sizeof(input), digest.data());
+  return digest;
+}
+
+// Computes the root of the leaves |first|, ..., |first| + |count| - 1 with the
+// recursive definition of RFC 6962, splitting at the largest power of two
+// smaller than |count|.
+Digest ReferenceRoot(const FlatAuthenticatedDictionary &dictionary,
+                     size_t first, size_t count) {
+  if (count == 1) {
+    return dictionary.LeafDigest(first);
+  }
+  size_t split = 1;
+  while (2 * split < count) {
+    split *= 2;
+  }
+  return HashChildren(ReferenceRoot(dictionary, first, split),
+                      ReferenceRoot(dictionary, first + split, count - split));
+}
+
+TEST(FlatAuthenticatedDictionaryTest, EmptyTree) {
+  FlatAuthenticatedDictionary dictionary;
+  EXPECT_THAT(dictionary.LeafCount(), Eq(0));
+  EXPECT_THAT(dictionary.LeafHash(1), IsEmpty());
+  EXPECT_FALSE(dictionary.UpdateLeaf(1, "leaf"));
+
+  Digest empty;
+  SHA256(nullptr, 0, empty.data());
+  EXPECT_THAT(dictionary.RootDigest(), Eq(empty));
+}
+
+TEST(FlatAuthenticatedDictionaryTest, RootsMatchReference) {
+  FlatAuthenticatedDictionary dictionary;
+  for (size_t count = 1; count <= 70; count++) {
+    dictionary.AddLeaf(absl::StrCat("leaf", count - 1));
+    EXPECT_THAT(dictionary.RootDigest(),
+                Eq(ReferenceRoot(dictionary, 1, count)))
+        << count << " leaves";
+  }
+}
+
+TEST(FlatAuthenticatedDictionaryTest, UpdatesMatchReference) {
+  constexpr size_t kLeafCount = 37;
+  FlatAuthenticatedDictionary dictionary;
+  dictionary.Reserve(kLeafCount);
+  for (size_t i = 0; i < kLeafCount; i++) {
+    dictionary.AddLeaf(absl::StrCat("old", i));
+  }
+
+  Digest root = dictionary.RootDigest();
+  for (size_t leaf = 1; leaf <= kLeafCount; leaf++) {
+    ASSERT_TRUE(dictionary.UpdateLeaf(leaf, absl::StrCat("new", leaf - 1)));
+    EXPECT_THAT(dictionary.RootDigest(), Ne(root)) << "leaf " << leaf;
+    root = dictionary.RootDigest();
+    EXPECT_THAT(root, Eq(ReferenceRoot(dictionary, 1, kLeafCount)));
+  }
+  EXPECT_FALSE(dictionary.UpdateLeaf(kLeafCount + 1, "leaf"));
+}
+
+TEST(FlatAuthenticatedDictionaryTest, LeafHashes) {
+  FlatAuthenticatedDictionary dictionary;
+  EXPECT_THAT(dictionary.AddLeaf("leaf"), Eq(1));
+  EXPECT_THAT(dictionary.AddLeafHash(dictionary.LeafHash("other")), Eq(2));
+  EXPECT_THAT(dictionary.AddLeafHash("short"), Eq(0));
+  EXPECT_THAT(dictionary.LeafCount(), Eq(2));
+  EXPECT_THAT(dictionary.LeafHash(1), Eq(dictionary.LeafHash("leaf")));
+  EXPECT_THAT(dictionary.LeafHash(2), Eq(dictionary.LeafHash("other")));
+  EXPECT_THAT(dictionary.LeafHash(3), IsEmpty());
+}
+
+TEST(FlatAuthenticatedDictionaryTest, MatchesCTMMTAuthenticatedDictionary) {
+  FlatAuthenticatedDictionary flat;
+  CTMMTAuthenticatedDictionary ctmmt;
+  EXPECT_THAT(flat.CurrentRoot(), Eq(ctmmt.CurrentRoot()));
+  for (size_t i = 0; i < 45; i++) {
+    std::string data = absl::StrCat("leaf", i);
+    flat.AddLeaf(data);
+    ctmmt.AddLeaf(data);
+    EXPECT_THAT(flat.LeafHash(i + 1), Eq(ctmmt.LeafHash(i + 1)));
+    EXPECT_THAT(flat.CurrentRoot(), Eq(ctmmt.CurrentRoot()));
+  }
+  for (size_t leaf = 1; leaf <= 45; leaf += 4) {
+    ASSERT_TRUE(flat.UpdateLeaf(leaf, "other"));
+    ASSERT_TRUE(ctmmt.UpdateLeaf(leaf, "other"));
+    EXPECT_THAT(flat.CurrentRoot(), Eq(ctmmt.CurrentRoot()));
+  }
+}
+
+}  // namespace
+}  // namespace storage
+}  // namespace platform
+}  // namespace asylo
@@ -0,0 +1,81 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_STORAGE_SECURE_MERKLE_TREE_LAYOUT_H_
+#define ASYLO_PLATFORM_STORAGE_SECURE_MERKLE_TREE_LAYOUT_H_
+
+#include <cstdint>
+
+namespace asylo {
+namespace platform {
+namespace storage {
+namespace merkle_tree_layout {
+
+// Helpers for the in-order layout of a Merkle tree: leaf i is node 2i, and the
+// parent of two sibling subtrees of 2^d leaves each sits between them. The
+// position of a node does not change as leaves are appended. A tree of n leaves
+// is a sequence of complete subtrees, one per bit set in n, and its root is
+// accumulated from the roots of those subtrees, right to left.
+
+// Largest supported tree depth, which bounds the number of leaves.
+constexpr int kMaxDepth = 48;
+
+// Returns the depth of |node| above the leaves.
+inline int Depth(uint64_t node) { return __builtin_ctzll(~node); }
+
+// Returns the position of |node| among the nodes of the same depth.
+inline uint64_t Offset(uint64_t node) { return node >> (Depth(node) + 1); }
+
+// Returns the node at |offset| among the nodes of |depth|.
+inline uint64_t NodeAt(int depth, uint64_t offset) {
+  return (offset << (depth + 1)) | ((uint64_t{1} << depth) - 1);
+}
+
+inline uint64_t Parent(uint64_t node) {
+  return NodeAt(Depth(node) + 1, Offset(node) >> 1);
+}
+
+inline uint64_t Sibling(uint64_t node) {
+  return NodeAt(Depth(node), Offset(node) ^ 1);
+}
+
+inline bool IsLeftChild(uint64_t node) { return (Offset(node) & 1) == 0; }
+
+// Returns the number of leaves up to and including the last leaf below |node|.
+inline uint64_t LeafEnd(uint64_t node) {
+  return (Offset(node) + 1) << Depth(node);
+}
+
+// Returns true if the parent of |node| is part of a tree of |leaf_count|
+// leaves, that is if |node| is not the root of one of its complete subtrees.
+inline bool HasParent(uint64_t node, uint64_t leaf_count) {
+  return LeafEnd(Parent(node)) <= leaf_count;
+}
+
+// Returns the root of the complete subtree of 2^|depth| leaves in a tree of
+// |leaf_count| leaves. Bit |depth| must be set in |leaf_count|.
+inline uint64_t SubtreeRoot(int depth, uint64_t leaf_count) {
+  return NodeAt(depth, leaf_count >> (depth + 1) << 1);
+}
+
+}  // namespace merkle_tree_layout
+}  // namespace storage
+}  // namespace platform
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_STORAGE_SECURE_MERKLE_TREE_LAYOUT_H_
@@ -0,0 +1,380 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/storage/secure/persistent_authenticated_dictionary.h"
+
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "asylo/platform/storage/secure/merkle_tree_layout.h"
+#include "asylo/util/logging.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+namespace platform {
+namespace storage {
+
+using merkle_tree_layout::IsLeftChild;
+using merkle_tree_layout::kMaxDepth;
+using merkle_tree_layout::LeafEnd;
+using merkle_tree_layout::NodeAt;
+using merkle_tree_layout::Parent;
+using merkle_tree_layout::Sibling;
+
+constexpr size_t MerkleNodeCache::kDefaultMaxNodes;
+
+MerkleNodeCache::MerkleNodeCache(size_t max_nodes)
+    : max_nodes_(max_nodes), size_(0) {}
+
+MerkleNodeCache *MerkleNodeCache::Shared() {
+  static MerkleNodeCache *cache = new MerkleNodeCache(kDefaultMaxNodes);
+  return cache;
+}
+
+size_t MerkleNodeCache::size() const {
+  absl::MutexLock lock(&mu_);
+  return size_;
+}
+
+void MerkleNodeCache::Register(
+    const PersistentAuthenticatedDictionary *dictionary) {
+  absl::MutexLock lock(&mu_);
+  entries_.push_front({dictionary, 0});
+  positions_.emplace(dictionary, entries_.begin());
+}
+
+void MerkleNodeCache::Unregister(
+    const PersistentAuthenticatedDictionary *dictionary) {
+  absl::MutexLock lock(&mu_);
+  auto position = positions_.find(dictionary);
+  size_ -= position->second->nodes;
+  entries_.erase(position->second);
+  positions_.erase(position);
+}
+
+void MerkleNodeCache::Update(
+    const PersistentAuthenticatedDictionary *dictionary, size_t nodes) {
+  absl::MutexLock lock(&mu_);
+  auto entry = positions_.at(dictionary);
+  size_ = size_ - entry->nodes + nodes;
+  entry->nodes = nodes;
+  entries_.splice(entries_.begin(), entries_, entry);
+
+  // Only try-lock the other dictionaries: their owners may be waiting for |mu_|
+  // while holding their own mutex.
+  for (auto victim = entries_.rbegin();
+       size_ > max_nodes_ && victim != entries_.rend(); ++victim) {
+    size_t remaining;
+    if (victim->dictionary == dictionary) {
+      remaining = dictionary->EvictNodes();
+    } else if (victim->dictionary->mu_.TryLock()) {
+      remaining = victim->dictionary->EvictNodes();
+      victim->dictionary->mu_.Unlock();
+    } else {
+      continue;
+    }
+    size_ = size_ - victim->nodes + remaining;
+    victim->nodes = remaining;
+  }
+}
+
+PersistentAuthenticatedDictionary::PersistentAuthenticatedDictionary(
+    std::unique_ptr<RandomAccessStorage> storage, MerkleNodeCache *cache)
+    : hasher_(absl::make_unique<Sha256Hasher>()),
+      storage_(std::move(storage)),
+      cache_(cache),
+      leaf_count_(0) {
+  cache_->Register(this);
+}
+
+PersistentAuthenticatedDictionary::~PersistentAuthenticatedDictionary() {
+  cache_->Unregister(this);
+}
+
+bool PersistentAuthenticatedDictionary::Load(size_t leaf_count) {
+  absl::MutexLock lock(&mu_);
+  nodes_.clear();
+  dirty_nodes_.clear();
+  leaf_count_ = 0;
+  if (leaf_count >= (uint64_t{1} << kMaxDepth)) {
+    LOG(ERROR) << "Merkle tree too large, leaf count = " << leaf_count;
+    return false;
+  }
+
+  leaf_count_ = leaf_count;
+  const size_t hash_length = hasher_.DigestSize();
+  for (uint64_t root : SubtreeRoots()) {
+    std::string hash(hash_length, '\0');
+    Status status = storage_->Read(&hash[0], root * hash_length, hash_length);
+    if (!status.ok()) {
+      LOG(ERROR) << "Failed to read Merkle tree node " << root << ": "
+                 << status;
+      nodes_.clear();
+      leaf_count_ = 0;
+      UpdateCache();
+      return false;
+    }
+    nodes_.emplace(root, std::move(hash));
+  }
+  UpdateCache();
+  return true;
+}
+
+bool PersistentAuthenticatedDictionary::Flush() {
+  absl::MutexLock lock(&mu_);
+  // Coalesce runs of adjacent nodes into single writes.
+  const size_t hash_length = hasher_.DigestSize();
+  std::string run;
+  uint64_t run_start = 0;
+  auto write_run = [&]() {
+    Status status = storage_->Write(run.data(), run_start * hash_length,
+                                    run.size());
+    if (!status.ok()) {
+      LOG(ERROR) << "Failed to write Merkle tree nodes: " << status;
+      return false;
+    }
+    return true;
+  };
+  for (uint64_t node : dirty_nodes_) {
+    if (!run.empty() && node != run_start + run.size() / hash_length) {
+      if (!write_run()) {
+        return false;
+      }
+      run.clear();
+    }
+    if (run.empty()) {
+      run_start = node;
+    }
+    run += nodes_[node];
+  }
+  if (!run.empty() && !write_run()) {
+    return false;
+  }
+
+  dirty_nodes_.clear();
+  UpdateCache();
+  return true;
+}
+
+size_t PersistentAuthenticatedDictionary::AddLeaf(const std::string &data) {
+  absl::MutexLock lock(&mu_);
+  size_t leaf = AddLeafHashLocked(hasher_.HashLeaf(data));
+  UpdateCache();
+  return leaf;
+}
+
+size_t PersistentAuthenticatedDictionary::AddLeafHash(const std::string &hash) {
+  absl::MutexLock lock(&mu_);
+  size_t leaf = AddLeafHashLocked(hash);
+  UpdateCache();
+  return leaf;
+}
+
+size_t PersistentAuthenticatedDictionary::AddLeafHashLocked(
+    const std::string &hash) {
+  uint64_t node = 2 * leaf_count_;
+  leaf_count_++;
+  std::string current = hash;
+  SetNode(node, current);
+
+  // The new leaf completes the subtrees whose left halves were complete before,
+  // and the roots of those are always cached.
+  while (HasParent(node)) {
+    current = hasher_.HashChildren(nodes_[Sibling(node)], current);
+    node = Parent(node);
+    SetNode(node, current);
+  }
+  return leaf_count_;
+}
+
+std::string PersistentAuthenticatedDictionary::CurrentRoot() {
+  absl::MutexLock lock(&mu_);
+  if (leaf_count_ == 0) {
+    return hasher_.HashEmpty();
+  }
+
+  std::vector<uint64_t> roots = SubtreeRoots();
+  std::string root = nodes_[roots.back()];
+  for (size_t i = roots.size() - 1; i > 0; i--) {
+    root = hasher_.HashChildren(nodes_[roots[i - 1]], root);
+  }
+  return root;
+}
+
+std::string PersistentAuthenticatedDictionary::LeafHash(size_t leaf) const {
+  absl::MutexLock lock(&mu_);
+  std::string hash;
+  bool fetched =
+      leaf != 0 && leaf <= leaf_count_ && FetchNode(2 * (leaf - 1), &hash);
+  UpdateCache();
+  return fetched ? hash : "";
+}
+
+std::string PersistentAuthenticatedDictionary::LeafHash(
+    const std::string &data) const {
+  absl::MutexLock lock(&mu_);
+  return hasher_.HashLeaf(data);
+}
+
+bool PersistentAuthenticatedDictionary::UpdateLeaf(size_t leaf,
+                                                   const std::string &data) {
+  absl::MutexLock lock(&mu_);
+  if (leaf == 0 || leaf > leaf_count_) {
+    return false;
+  }
+
+  // Collect the authentic siblings along the path to the root of the complete
+  // subtree before modifying anything.
+  uint64_t node = 2 * (leaf - 1);
+  std::vector<std::string> siblings;
+  for (uint64_t current = node; HasParent(current);
+       current = Parent(current)) {
+    std::string sibling;
+    if (!FetchNode(Sibling(current), &sibling)) {
+      UpdateCache();
+      return false;
+    }
+    siblings.push_back(std::move(sibling));
+  }
+
+  std::string current = hasher_.HashLeaf(data);
+  SetNode(node, current);
+  for (const std::string &sibling : siblings) {
+    current = IsLeftChild(node) ? hasher_.HashChildren(current, sibling)
+                                : hasher_.HashChildren(sibling, current);
+    node = Parent(node);
+    SetNode(node, current);
+  }
+  UpdateCache();
+  return true;
+}
+
+bool PersistentAuthenticatedDictionary::HasParent(uint64_t node) const {
+  return merkle_tree_layout::HasParent(node, leaf_count_);
+}
+
+std::vector<uint64_t> PersistentAuthenticatedDictionary::SubtreeRoots() const {
+  std::vector<uint64_t> roots;
+  uint64_t first_leaf = 0;
+  for (int depth = kMaxDepth - 1; depth >= 0; depth--) {
+    const uint64_t width = uint64_t{1} << depth;
+    if (leaf_count_ & width) {
+      roots.push_back(NodeAt(depth, first_leaf >> depth));
+      first_leaf += width;
+    }
+  }
+  return roots;
+}
+
+bool PersistentAuthenticatedDictionary::FetchNode(uint64_t node,
+                                                  std::string *hash) const {
+  auto it = nodes_.find(node);
+  if (it != nodes_.end()) {
+    *hash = it->second;
+    return true;
+  }
+  if (LeafEnd(node) > leaf_count_) {
+    return false;
+  }
+
+  const size_t hash_length = hasher_.DigestSize();
+  auto read_node = [&](uint64_t position, std::string *value) {
+    value->resize(hash_length);
+    Status status =
+        storage_->Read(&(*value)[0], position * hash_length, hash_length);
+    if (!status.ok()) {
+      LOG(ERROR) << "Failed to read Merkle tree node " << position << ": "
+                 << status;
+      return false;
+    }
+    return true;
+  };
+
+  // Walk up from |node| until reaching a cached ancestor, and check that the
+  // nodes read on the way hash up to it.
+  std::vector<std::pair<uint64_t, std::string>> path;
+  std::string current;
+  if (!read_node(node, &current)) {
+    return false;
+  }
+  path.emplace_back(node, current);
+  for (uint64_t position = node;; position = Parent(position)) {
+    // The roots of all complete subtrees are cached, so an uncached node must
+    // have a parent.
+    if (!HasParent(position)) {
+      return false;
+    }
+
+    std::string sibling;
+    auto sibling_it = nodes_.find(Sibling(position));
+    if (sibling_it != nodes_.end()) {
+      sibling = sibling_it->second;
+    } else {
+      if (!read_node(Sibling(position), &sibling)) {
+        return false;
+      }
+      path.emplace_back(Sibling(position), sibling);
+    }
+
+    current = IsLeftChild(position) ? hasher_.HashChildren(current, sibling)
+                                    : hasher_.HashChildren(sibling, current);
+    auto parent_it = nodes_.find(Parent(position));
+    if (parent_it != nodes_.end()) {
+      if (parent_it->second != current) {
+        LOG(ERROR) << "Merkle tree node " << node << " failed verification.";
+        return false;
+      }
+      break;
+    }
+    path.emplace_back(Parent(position), current);
+  }
+
+  *hash = path.front().second;
+  for (auto &entry : path) {
+    nodes_.emplace(entry.first, std::move(entry.second));
+  }
+  return true;
+}
+
+void PersistentAuthenticatedDictionary::SetNode(uint64_t node,
+                                                const std::string &hash) {
+  nodes_[node] = hash;
+  dirty_nodes_.insert(node);
+}
+
+void PersistentAuthenticatedDictionary::UpdateCache() const {
+  cache_->Update(this, nodes_.size());
+}
+
+size_t PersistentAuthenticatedDictionary::EvictNodes() const {
+  std::vector<uint64_t> roots = SubtreeRoots();
+  std::set<uint64_t> keep(roots.begin(), roots.end());
+  keep.insert(dirty_nodes_.begin(), dirty_nodes_.end());
+  for (auto it = nodes_.begin(); it != nodes_.end();) {
+    if (keep.count(it->first) == 0) {
+      it = nodes_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  return nodes_.size();
+}
+
+}  // namespace storage
+}  // namespace platform
+}  // namespace asylo
@@ -0,0 +1,205 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_STORAGE_SECURE_PERSISTENT_AUTHENTICATED_DICTIONARY_H_
+#define ASYLO_PLATFORM_STORAGE_SECURE_PERSISTENT_AUTHENTICATED_DICTIONARY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "asylo/platform/storage/secure/authenticated_dictionary.h"
+#include "asylo/platform/storage/utils/random_access_storage.h"
+#include <merkletree/merkle_tree.h>
+
+namespace asylo {
+namespace platform {
+namespace storage {
+
+class PersistentAuthenticatedDictionary;
+
+// Bounds the number of Merkle tree nodes cached in trusted memory by all the
+// PersistentAuthenticatedDictionary instances that share it, so that the memory
+// they use does not grow with the number of open data sets. Once the bound is
+// exceeded, the nodes which can be read back from storage are evicted from the
+// least recently used dictionaries first. Dictionaries which are in use by
+// another thread are skipped.
+//
+// The roots of the complete subtrees and the nodes not yet written to storage
+// cannot be evicted, so the bound may be exceeded by the nodes which have to
+// stay in memory.
+//
+// All methods are thread-safe.
+class MerkleNodeCache {
+ public:
+  // Bound of the cache shared by default, in nodes.
+  static constexpr size_t kDefaultMaxNodes = 1 << 16;
+
+  explicit MerkleNodeCache(size_t max_nodes);
+
+  MerkleNodeCache(const MerkleNodeCache &other) = delete;
+  MerkleNodeCache &operator=(const MerkleNodeCache &other) = delete;
+
+  // Returns the cache of kDefaultMaxNodes nodes shared by all dictionaries
+  // which are not given a cache of their own.
+  static MerkleNodeCache *Shared();
+
+  // Returns the number of nodes cached by all dictionaries.
+  size_t size() const;
+
+ private:
+  friend class PersistentAuthenticatedDictionary;
+
+  struct Entry {
+    const PersistentAuthenticatedDictionary *dictionary;
+    size_t nodes;
+  };
+
+  void Register(const PersistentAuthenticatedDictionary *dictionary);
+  void Unregister(const PersistentAuthenticatedDictionary *dictionary);
+
+  // Records that |dictionary| caches |nodes| nodes and was just used, then
+  // evicts nodes until the cache fits in its bound. The caller must hold the
+  // mutex of |dictionary|, which is evicted from last.
+  void Update(const PersistentAuthenticatedDictionary *dictionary,
+              size_t nodes) ABSL_NO_THREAD_SAFETY_ANALYSIS;
+
+  const size_t max_nodes_;
+
+  mutable absl::Mutex mu_;
+  size_t size_ ABSL_GUARDED_BY(mu_);
+
+  // Registered dictionaries, from the most to the least recently used.
+  std::list<Entry> entries_ ABSL_GUARDED_BY(mu_);
+  std::unordered_map<const PersistentAuthenticatedDictionary *,
+                     std::list<Entry>::iterator>
+      positions_ ABSL_GUARDED_BY(mu_);
+};
+
+// Authenticated Dictionary implementation which keeps the nodes of its Merkle
+// tree in untrusted storage and loads them on demand, so that neither opening
+// a data set nor verifying a block requires hashing the whole data set.
+//
+// Nodes are stored in the in-order layout described in merkle_tree_layout.h, at
+// a byte offset of their position times the digest size.
+//
+// Only the roots of the complete subtrees are read when the tree is loaded.
+// Every other node read from storage is verified against its closest ancestor
+// already known to be authentic, and is then cached in trusted memory until
+// the MerkleNodeCache of the dictionary evicts it. The
+// caller is expected to verify CurrentRoot() against a trusted copy after
+// Load(), and to persist the tree with Flush() before persisting that copy.
+//
+// The const methods may be called concurrently with each other. The other
+// methods must not be called concurrently with any method.
+class PersistentAuthenticatedDictionary : public AuthenticatedDictionary {
+ public:
+  // Creates an empty dictionary whose nodes are kept in |storage|, and cached
+  // in |cache|, which must outlive the dictionary.
+  explicit PersistentAuthenticatedDictionary(
+      std::unique_ptr<RandomAccessStorage> storage,
+      MerkleNodeCache *cache = MerkleNodeCache::Shared());
+
+  ~PersistentAuthenticatedDictionary() override;
+
+  // Discards the state of the dictionary and loads a tree of |leaf_count|
+  // leaves from storage. Returns false if storage cannot be read.
+  bool Load(size_t leaf_count);
+
+  // Writes the nodes modified since the last call to storage. Returns false on
+  // failure.
+  bool Flush();
+
+  size_t LeafCount() const final { return leaf_count_; }
+
+  size_t AddLeaf(const std::string &data) final;
+
+  size_t AddLeafHash(const std::string &hash) final;
+
+  std::string CurrentRoot() final;
+
+  // Returns an empty string if the leaf does not exist, cannot be read, or
+  // fails verification.
+  std::string LeafHash(size_t leaf) const final;
+
+  std::string LeafHash(const std::string &data) const final;
+
+  // Returns false if the nodes needed to recompute the root cannot be read or
+  // fail verification.
+  bool UpdateLeaf(size_t leaf, const std::string &data) final;
+
+ private:
+  friend class MerkleNodeCache;
+
+  size_t AddLeafHashLocked(const std::string &hash)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Returns true if the parent of |node| is part of the tree, that is if |node|
+  // is not the root of one of the complete subtrees.
+  bool HasParent(uint64_t node) const ABSL_SHARED_LOCKS_REQUIRED(mu_);
+
+  // Returns the roots of the complete subtrees, left to right.
+  std::vector<uint64_t> SubtreeRoots() const ABSL_SHARED_LOCKS_REQUIRED(mu_);
+
+  // Retrieves the authentic value of |node|, reading it and the nodes needed
+  // to verify it from storage if it is not cached. Returns false on failure.
+  bool FetchNode(uint64_t node, std::string *hash) const
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Caches |hash| as the new value of |node| and marks it for writing.
+  void SetNode(uint64_t node, const std::string &hash)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Reports the number of cached nodes to |cache_|, which may evict nodes of
+  // this or other dictionaries. Called at the end of every method which may
+  // have cached nodes, since |nodes_| shrinks when it is called.
+  void UpdateCache() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Evicts the cached nodes which can be read back from storage, and returns
+  // the number of nodes left. Nodes which were not written to storage yet and
+  // the roots of the complete subtrees are kept.
+  size_t EvictNodes() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Guards the cached nodes, which the const methods update and |cache_| may
+  // evict from any thread, and the state of |hasher_|, which they share.
+  mutable absl::Mutex mu_;
+
+  TreeHasher hasher_ ABSL_GUARDED_BY(mu_);
+  std::unique_ptr<RandomAccessStorage> storage_;
+  MerkleNodeCache *const cache_;
+  size_t leaf_count_;
+
+  // Authentic node values keyed on node position.
+  mutable std::unordered_map<uint64_t, std::string> nodes_ ABSL_GUARDED_BY(mu_);
+
+  // Positions of the nodes modified since the last Flush(), in order.
+  std::set<uint64_t> dirty_nodes_ ABSL_GUARDED_BY(mu_);
+};
+
+}  // namespace storage
+}  // namespace platform
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_STORAGE_SECURE_PERSISTENT_AUTHENTICATED_DICTIONARY_H_
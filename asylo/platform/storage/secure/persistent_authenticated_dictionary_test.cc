@@ -0,0 +1,325 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/storage/secure/persistent_authenticated_dictionary.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "asylo/platform/storage/utils/fd_closer.h"
+#include "asylo/platform/storage/utils/random_access_storage.h"
+#include "asylo/platform/storage/utils/test_utils.h"
+#include "asylo/platform/storage/utils/untrusted_file.h"
+#include "asylo/test/util/status_matchers.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+namespace platform {
+namespace storage {
+namespace {
+
+using ::testing::Eq;
+using ::testing::IsEmpty;
+using ::testing::Le;
+using ::testing::Ne;
+
+// RandomAccessStorage wrapping an UntrustedFile which counts the reads made.
+class CountingStorage : public RandomAccessStorage {
+ public:
+  explicit CountingStorage(int fd) : file_(fd), reads_(0) {}
+
+  StatusOr<size_t> Size() const override { return file_.Size(); }
+
+  Status Read(void *buffer, off_t offset, size_t size) override {
+    reads_++;
+    return file_.Read(buffer, offset, size);
+  }
+
+  Status Write(const void *buffer, off_t offset, size_t size) override {
+    return file_.Write(buffer, offset, size);
+  }
+
+  Status Sync() override { return file_.Sync(); }
+
+  Status Truncate(size_t size) override { return file_.Truncate(size); }
+
+  int reads() const { return reads_; }
+
+ private:
+  UntrustedFile file_;
+  int reads_;
+};
+
+class PersistentAuthenticatedDictionaryTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    fd_ = CreateEmptyTempFileOrDie(
+        absl::StrCat(::testing::UnitTest::GetInstance()
+                         ->current_test_info()
+                         ->name(),
+                     ".merkle"));
+    fd_closer_.reset(fd_);
+  }
+
+  // Returns a dictionary backed by the test file, whose nodes are cached in
+  // |cache|. If |storage| is not null, it is set to the storage of the
+  // dictionary.
+  std::unique_ptr<PersistentAuthenticatedDictionary> CreateDictionary(
+      CountingStorage **storage = nullptr,
+      MerkleNodeCache *cache = MerkleNodeCache::Shared()) {
+    auto counting_storage = absl::make_unique<CountingStorage>(fd_);
+    if (storage) {
+      *storage = counting_storage.get();
+    }
+    return absl::make_unique<PersistentAuthenticatedDictionary>(
+        std::move(counting_storage), cache);
+  }
+
+  // Returns a dictionary of |count| leaves which is not backed by the test
+  // file, built from leaf data |prefix|0, |prefix|1, ...
+  std::unique_ptr<PersistentAuthenticatedDictionary> BuildReference(
+      size_t count, const std::string &prefix) {
+    int fd = CreateEmptyTempFileOrDie(
+        absl::StrCat(::testing::UnitTest::GetInstance()
+                         ->current_test_info()
+                         ->name(),
+                     ".reference", reference_closers_.size()));
+    reference_closers_.push_back(absl::make_unique<FdCloser>(fd));
+    auto dictionary = absl::make_unique<PersistentAuthenticatedDictionary>(
+        absl::make_unique<UntrustedFile>(fd));
+    for (size_t i = 0; i < count; i++) {
+      dictionary->AddLeaf(absl::StrCat(prefix, i));
+    }
+    return dictionary;
+  }
+
+  // Overwrites the first byte of the node at |position| in the test file.
+  void CorruptNode(uint64_t position) {
+    UntrustedFile file(fd_);
+    const size_t hash_length = LeafHashLength();
+    std::string hash(hash_length, '\0');
+    ASYLO_ASSERT_OK(file.Read(&hash[0], position * hash_length, hash_length));
+    hash[0] ^= 0x01;
+    ASYLO_ASSERT_OK(file.Write(hash.data(), position * hash_length, 1));
+  }
+
+  size_t LeafHashLength() {
+    return CreateDictionary()->LeafHash(std::string("leaf")).size();
+  }
+
+  int fd_;
+  FdCloser fd_closer_;
+  std::vector<std::unique_ptr<FdCloser>> reference_closers_;
+};
+
+TEST_F(PersistentAuthenticatedDictionaryTest, EmptyTree) {
+  auto dictionary = CreateDictionary();
+  EXPECT_THAT(dictionary->LeafCount(), Eq(0));
+  EXPECT_THAT(dictionary->LeafHash(1), IsEmpty());
+  EXPECT_FALSE(dictionary->UpdateLeaf(1, "leaf"));
+  EXPECT_THAT(dictionary->CurrentRoot(), Ne(""));
+}
+
+TEST_F(PersistentAuthenticatedDictionaryTest, RootDependsOnEveryLeaf) {
+  constexpr size_t kLeafCount = 13;
+  std::string root = BuildReference(kLeafCount, "leaf")->CurrentRoot();
+  for (size_t leaf = 1; leaf <= kLeafCount; leaf++) {
+    auto dictionary = BuildReference(kLeafCount, "leaf");
+    ASSERT_TRUE(dictionary->UpdateLeaf(leaf, "other"));
+    EXPECT_THAT(dictionary->CurrentRoot(), Ne(root)) << "leaf " << leaf;
+  }
+  EXPECT_THAT(BuildReference(kLeafCount + 1, "leaf")->CurrentRoot(),
+              Ne(root));
+}
+
+TEST_F(PersistentAuthenticatedDictionaryTest, ReloadsFlushedTree) {
+  for (size_t count = 1; count <= 40; count++) {
+    auto dictionary = CreateDictionary();
+    ASSERT_TRUE(dictionary->Load(0));
+    for (size_t i = 0; i < count; i++) {
+      dictionary->AddLeaf(absl::StrCat("leaf", i));
+    }
+    ASSERT_TRUE(dictionary->Flush());
+    std::string root = dictionary->CurrentRoot();
+    EXPECT_THAT(root, Eq(BuildReference(count, "leaf")->CurrentRoot()));
+
+    auto reloaded = CreateDictionary();
+    ASSERT_TRUE(reloaded->Load(count));
+    EXPECT_THAT(reloaded->CurrentRoot(), Eq(root));
+    for (size_t leaf = 1; leaf <= count; leaf++) {
+      EXPECT_THAT(reloaded->LeafHash(leaf),
+                  Eq(reloaded->LeafHash(absl::StrCat("leaf", leaf - 1))));
+    }
+  }
+}
+
+TEST_F(PersistentAuthenticatedDictionaryTest, UpdatesMatchRebuiltTree) {
+  constexpr size_t kLeafCount = 37;
+  {
+    auto dictionary = CreateDictionary();
+    for (size_t i = 0; i < kLeafCount; i++) {
+      dictionary->AddLeaf(absl::StrCat("old", i));
+    }
+    ASSERT_TRUE(dictionary->Flush());
+  }
+
+  // Update every leaf of a reloaded tree, flushing in between.
+  auto dictionary = CreateDictionary();
+  ASSERT_TRUE(dictionary->Load(kLeafCount));
+  for (size_t leaf = 1; leaf <= kLeafCount; leaf++) {
+    ASSERT_TRUE(dictionary->UpdateLeaf(leaf, absl::StrCat("new", leaf - 1)));
+    if (leaf % 5 == 0) {
+      ASSERT_TRUE(dictionary->Flush());
+    }
+  }
+  ASSERT_TRUE(dictionary->Flush());
+  std::string root = BuildReference(kLeafCount, "new")->CurrentRoot();
+  EXPECT_THAT(dictionary->CurrentRoot(), Eq(root));
+
+  auto reloaded = CreateDictionary();
+  ASSERT_TRUE(reloaded->Load(kLeafCount));
+  EXPECT_THAT(reloaded->CurrentRoot(), Eq(root));
+}
+
+TEST_F(PersistentAuthenticatedDictionaryTest, LoadsNodesOnDemand) {
+  constexpr size_t kLeafCount = 1000;
+  {
+    auto dictionary = CreateDictionary();
+    for (size_t i = 0; i < kLeafCount; i++) {
+      dictionary->AddLeaf(absl::StrCat("leaf", i));
+    }
+    ASSERT_TRUE(dictionary->Flush());
+  }
+
+  // 1000 leaves form 6 complete subtrees, the largest of which has depth 9.
+  CountingStorage *storage;
+  auto dictionary = CreateDictionary(&storage);
+  ASSERT_TRUE(dictionary->Load(kLeafCount));
+  EXPECT_THAT(storage->reads(), Eq(6));
+
+  // Verifying a leaf reads at most the leaf and one sibling per level.
+  EXPECT_THAT(dictionary->LeafHash(1), Eq(dictionary->LeafHash("leaf0")));
+  EXPECT_THAT(storage->reads(), Le(6 + 1 + 9));
+
+  // Its sibling is then known to be authentic.
+  int reads = storage->reads();
+  EXPECT_THAT(dictionary->LeafHash(2), Eq(dictionary->LeafHash("leaf1")));
+  EXPECT_THAT(storage->reads(), Eq(reads));
+}
+
+TEST_F(PersistentAuthenticatedDictionaryTest, EvictsCachedNodes) {
+  constexpr size_t kLeafCount = 1000;
+  constexpr size_t kMaxNodes = 64;
+  MerkleNodeCache cache(kMaxNodes);
+  auto dictionary = CreateDictionary(/*storage=*/nullptr, &cache);
+  for (size_t i = 0; i < kLeafCount; i++) {
+    dictionary->AddLeaf(absl::StrCat("leaf", i));
+  }
+  ASSERT_TRUE(dictionary->Flush());
+  std::string root = dictionary->CurrentRoot();
+  EXPECT_THAT(cache.size(), Le(kMaxNodes));
+
+  for (size_t leaf = 1; leaf <= kLeafCount; leaf += 7) {
+    ASSERT_THAT(dictionary->LeafHash(leaf),
+                Eq(dictionary->LeafHash(absl::StrCat("leaf", leaf - 1))));
+    ASSERT_THAT(cache.size(), Le(kMaxNodes));
+  }
+  ASSERT_TRUE(dictionary->UpdateLeaf(1, "leaf0"));
+  EXPECT_THAT(dictionary->CurrentRoot(), Eq(root));
+}
+
+TEST_F(PersistentAuthenticatedDictionaryTest, SharesCacheBetweenDictionaries) {
+  constexpr size_t kLeafCount = 1024;
+  constexpr size_t kMaxNodes = 32;
+  {
+    auto dictionary = CreateDictionary();
+    for (size_t i = 0; i < kLeafCount; i++) {
+      dictionary->AddLeaf(absl::StrCat("leaf", i));
+    }
+    ASSERT_TRUE(dictionary->Flush());
+  }
+
+  // Verifying a leaf caches 20 nodes besides the root of the tree, so verifying
+  // a leaf in one dictionary evicts the nodes cached by the other.
+  MerkleNodeCache cache(kMaxNodes);
+  CountingStorage *first_storage;
+  CountingStorage *second_storage;
+  auto first = CreateDictionary(&first_storage, &cache);
+  auto second = CreateDictionary(&second_storage, &cache);
+  ASSERT_TRUE(first->Load(kLeafCount));
+  ASSERT_TRUE(second->Load(kLeafCount));
+
+  EXPECT_THAT(first->LeafHash(1), Eq(first->LeafHash("leaf0")));
+  int first_reads = first_storage->reads();
+  EXPECT_THAT(second->LeafHash(1), Eq(second->LeafHash("leaf0")));
+  EXPECT_THAT(cache.size(), Le(kMaxNodes));
+
+  // The evicted nodes are read back and verified again on demand.
+  EXPECT_THAT(first->LeafHash(2), Eq(first->LeafHash("leaf1")));
+  EXPECT_THAT(first_storage->reads(), Ne(first_reads));
+  EXPECT_THAT(cache.size(), Le(kMaxNodes));
+
+  // Destroying a dictionary releases its share of the cache.
+  second.reset();
+  first.reset();
+  EXPECT_THAT(cache.size(), Eq(0));
+}
+
+TEST_F(PersistentAuthenticatedDictionaryTest, DetectsTamperedNodes) {
+  constexpr size_t kLeafCount = 8;
+  std::string root;
+  {
+    auto dictionary = CreateDictionary();
+    for (size_t i = 0; i < kLeafCount; i++) {
+      dictionary->AddLeaf(absl::StrCat("leaf", i));
+    }
+    ASSERT_TRUE(dictionary->Flush());
+    root = dictionary->CurrentRoot();
+  }
+
+  // Leaf 3 is node 4 and its sibling is node 6.
+  CorruptNode(4);
+  auto dictionary = CreateDictionary();
+  ASSERT_TRUE(dictionary->Load(kLeafCount));
+  EXPECT_THAT(dictionary->CurrentRoot(), Eq(root));
+  EXPECT_THAT(dictionary->LeafHash(3), IsEmpty());
+  EXPECT_FALSE(dictionary->UpdateLeaf(4, "other"));
+  EXPECT_THAT(dictionary->LeafHash(1), Eq(dictionary->LeafHash("leaf0")));
+
+  // The root of the single complete subtree is only checked by the caller.
+  CorruptNode(7);
+  auto tampered = CreateDictionary();
+  ASSERT_TRUE(tampered->Load(kLeafCount));
+  EXPECT_THAT(tampered->CurrentRoot(), Ne(root));
+}
+
+TEST_F(PersistentAuthenticatedDictionaryTest, FailsToLoadMissingNodes) {
+  auto dictionary = CreateDictionary();
+  EXPECT_FALSE(dictionary->Load(3));
+  EXPECT_THAT(dictionary->LeafCount(), Eq(0));
+}
+
+}  // namespace
+}  // namespace storage
+}  // namespace platform
+}  // namespace asylo
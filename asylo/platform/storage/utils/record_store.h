@@ -20,9 +20,11 @@
 #define ASYLO_PLATFORM_STORAGE_UTILS_RECORD_STORE_H_
 
 #include <algorithm>
-#include <iterator>
-#include <list>
+#include <atomic>
+#include <limits>
 #include <type_traits>
+#include <utility>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "asylo/util/logging.h"
@@ -34,6 +36,52 @@
 
 namespace asylo {
 
+// A budget of cache entries shared by several RecordStores, bounding the number
+// of records they cache in total. A RecordStore grows its cache only while the
+// budget allows, and otherwise recycles its own least-recently-used entries.
+// The first entry of each RecordStore is not charged to the budget, so that
+// every store can make progress.
+//
+// This class is thread-safe. The RecordStores sharing it may be used from
+// different threads.
+class RecordCacheBudget {
+ public:
+  // Creates a budget of |capacity| cache entries.
+  explicit RecordCacheBudget(size_t capacity)
+      : capacity_(capacity), used_(0) {}
+
+  RecordCacheBudget(const RecordCacheBudget &) = delete;
+
+  RecordCacheBudget &operator=(const RecordCacheBudget &) = delete;
+
+  // Returns the number of entries in the budget.
+  size_t capacity() const { return capacity_; }
+
+  // Returns the number of entries currently charged to the budget.
+  size_t used() const { return used_.load(std::memory_order_relaxed); }
+
+  // Charges one entry to the budget. Returns false if the budget is spent.
+  bool TryAcquire() {
+    size_t used = used_.load(std::memory_order_relaxed);
+    do {
+      if (used >= capacity_) {
+        return false;
+      }
+    } while (!used_.compare_exchange_weak(used, used + 1,
+                                          std::memory_order_relaxed));
+    return true;
+  }
+
+  // Returns |count| entries to the budget.
+  void Release(size_t count) {
+    used_.fetch_sub(count, std::memory_order_relaxed);
+  }
+
+ private:
+  const size_t capacity_;
+  std::atomic<size_t> used_;
+};
+
 // A persistent collection of records of a generic type T. T must be a POD type.
 //
 // This class provides methods to access a storage resource as a collection of
@@ -48,7 +96,8 @@ namespace asylo {
 // Read and write operations are performed via a fixed-size cache using a least-
 // recently-used eviction policy. The cache may be flushed to disk explicitly
 // via Flush(), and is automatically flushed when the RecordStore passes out of
-// scope.
+// scope. Dirty records which are adjacent in storage are written together,
+// both by Flush() and when one of them is evicted.
 //
 // This class is not thread-safe. It is the responsibility of the caller to
 // ensure that its methods are not called concurrently.
@@ -62,33 +111,73 @@ class RecordStore {
                 "T must satisfy std::is_trivially_copy_assignable");
 
   // Initializes a RecordStore backed by a storage resource |io| and configures
-  // a cache with a |capacity| specified as a count of elements of type T. The
-  // RecordStore does not take ownership of |io| and it is the responsibility of
-  // the caller to ensure it remains valid over the lifetime of the RecordStore.
-  RecordStore(size_t capacity, RandomAccessStorage *io)
-      : capacity_(std::max<size_t>(capacity, 1)), count_(0), io_(io) {}
+  // a cache with a |capacity| specified as a count of elements of type T. If
+  // |budget| is not null, the cache additionally draws its entries from it. The
+  // RecordStore does not take ownership of |io| or |budget| and it is the
+  // responsibility of the caller to ensure they remain valid over the lifetime
+  // of the RecordStore.
+  RecordStore(size_t capacity, RandomAccessStorage *io,
+              RecordCacheBudget *budget = nullptr)
+      : capacity_(std::max<size_t>(capacity, 1)), io_(io), budget_(budget) {}
 
   RecordStore(const RecordStore<T> &) = delete;
 
-  RecordStore(RecordStore<T> &&) = default;
+  RecordStore(RecordStore<T> &&other) : RecordStore(1, nullptr) {
+    *this = std::move(other);
+  }
 
   RecordStore &operator=(const RecordStore<T> &) = delete;
 
-  RecordStore &operator=(RecordStore<T> &&) = default;
+  // Exchanges the state of the two stores, so that the cache previously held
+  // by this instance is flushed when |other| is destroyed.
+  RecordStore &operator=(RecordStore<T> &&other) {
+    std::swap(capacity_, other.capacity_);
+    std::swap(io_, other.io_);
+    std::swap(budget_, other.budget_);
+    entries_.swap(other.entries_);
+    std::swap(head_, other.head_);
+    std::swap(tail_, other.tail_);
+    index_.swap(other.index_);
+    return *this;
+  }
 
-  // Flush the cache to disk and finalizes the RecordStore.
+  // Flush the cache to disk and finalizes the RecordStore. A RecordStore which
+  // was moved from holds no storage resource and flushes nothing.
   ~RecordStore() {
     Status status = Flush();
     LOG_IF(ERROR, !status.ok()) << "Could not flush cache: " << status;
-    status = io_->Sync();
-    LOG_IF(ERROR, !status.ok()) << "Could not synchronize file: " << status;
+    if (budget_ && entries_.size() > 1) {
+      budget_->Release(entries_.size() - 1);
+    }
   }
 
   // Flushes the cache to persistent storage and ensures the underlying storage
   // resource has been synchronized. Returns an error status on failure.
   ASYLO_MUST_USE_RESULT Status Flush() {
-    for (auto it = cache_.begin(); it != cache_.end(); it++) {
-      ASYLO_RETURN_IF_ERROR(Commit(it));
+    if (!io_) {
+      return Status::OkStatus();
+    }
+    flush_order_.clear();
+    for (size_t i = 0; i < entries_.size(); i++) {
+      if (entries_[i].dirty) {
+        flush_order_.push_back(i);
+      }
+    }
+    std::sort(flush_order_.begin(), flush_order_.end(),
+              [this](size_t lhs, size_t rhs) {
+                return entries_[lhs].offset < entries_[rhs].offset;
+              });
+    for (size_t i = 0; i < flush_order_.size();) {
+      // Each run of records stored back to back is written at once.
+      size_t end = i + 1;
+      while (end < flush_order_.size() &&
+             entries_[flush_order_[end]].offset ==
+                 entries_[flush_order_[end - 1]].offset + sizeof(T)) {
+        end++;
+      }
+      ASYLO_RETURN_IF_ERROR(CommitRun(flush_order_.begin() + i,
+                                      flush_order_.begin() + end));
+      i = end;
     }
     ASYLO_RETURN_IF_ERROR(io_->Sync());
     return Status::OkStatus();
@@ -103,28 +192,19 @@ class RecordStore {
     auto it = index_.find(offset);
     if (it != index_.end()) {
       MoveToFront(it->second);
-    } else {
-      if (count_ < capacity_) {
-        cache_.emplace_front();
-        count_++;
-      } else {
-        ASYLO_RETURN_IF_ERROR(Evict());
-      }
-      auto first = cache_.begin();
-      Status status = io_->Read(&first->value, offset, sizeof(T));
-      if (!status.ok()) {
-        // On read failure, the contents of the head node are undefined. Discard
-        // the cache head node to ensure garbage data is not evicted and written
-        // back to disk.
-        cache_.pop_front();
-        count_--;
-        return status;
-      }
-      first->offset = offset;
-      first->dirty = false;
-      index_[offset] = first;
+      *item = entries_[it->second].value;
+      return Status::OkStatus();
     }
-    *item = cache_.begin()->value;
+
+    // Read the record before claiming a cache entry for it, so that a failed
+    // read leaves the cache untouched.
+    T value;
+    ASYLO_RETURN_IF_ERROR(io_->Read(&value, offset, sizeof(T)));
+    size_t entry;
+    ASYLO_ASSIGN_OR_RETURN(entry, AllocateEntry(offset));
+    entries_[entry].value = value;
+    entries_[entry].dirty = false;
+    *item = value;
     return Status::OkStatus();
   }
 
@@ -135,24 +215,16 @@ class RecordStore {
   // RecordStore. Writes are cached and may not be persisted to storage until
   // Flush() is called or the RecordStore is destroyed.
   ASYLO_MUST_USE_RESULT Status Write(off_t offset, const T &item) {
+    size_t entry;
     auto it = index_.find(offset);
     if (it != index_.end()) {
-      MoveToFront(it->second);
+      entry = it->second;
+      MoveToFront(entry);
     } else {
-      if (count_ < capacity_) {
-        // Allocate a new cache entry. Note that existing iterators into cache_
-        // are not invalidated.
-        cache_.emplace_front();
-        count_++;
-      } else {
-        ASYLO_RETURN_IF_ERROR(Evict());
-      }
-      cache_.begin()->offset = offset;
-      index_[offset] = cache_.begin();
+      ASYLO_ASSIGN_OR_RETURN(entry, AllocateEntry(offset));
     }
-    auto first = cache_.begin();
-    first->value = item;
-    first->dirty = true;
+    entries_[entry].value = item;
+    entries_[entry].dirty = true;
     return Status::OkStatus();
   }
 
@@ -161,61 +233,152 @@ class RecordStore {
   bool IsCached(off_t offset) const { return index_.contains(offset); }
 
  private:
+  // Marks the absence of a cache entry in the LRU list.
+  static constexpr size_t kNoEntry = std::numeric_limits<size_t>::max();
+
   struct CacheEntry {
     off_t offset;  // Byte offset of this record.
     T value;       // Cached record value.
     bool dirty;    // True if this entry has been modified.
+    size_t prev;   // Next more recently used entry, or kNoEntry.
+    size_t next;   // Next less recently used entry, or kNoEntry.
   };
 
-  using NodeRef = typename std::list<CacheEntry>::iterator;
-  using ConstNodeRef = typename std::list<CacheEntry>::const_iterator;
+  // Claims a cache entry for the record at |offset| and places it at the front
+  // of the LRU list, evicting the least recently used entry if the cache is
+  // full. Returns the index of the entry, or an error status on failure.
+  StatusOr<size_t> AllocateEntry(off_t offset) {
+    size_t entry;
+    if (entries_.size() < capacity_ &&
+        (entries_.empty() || !budget_ || budget_->TryAcquire())) {
+      entry = entries_.size();
+      entries_.emplace_back();
+    } else {
+      entry = tail_;
+      ASYLO_RETURN_IF_ERROR(Evict(entry));
+      Unlink(entry);
+    }
+    entries_[entry].offset = offset;
+    PushFront(entry);
+    index_[offset] = entry;
+    return entry;
+  }
 
-  // Writes a cache entry to storage, returning an error status on failure.
-  ASYLO_MUST_USE_RESULT Status Commit(NodeRef entry) {
-    ASYLO_RETURN_IF_ERROR(io_->Write(&entry->value, entry->offset, sizeof(T)));
-    entry->dirty = false;
+  // Writes the cache entry |entry| to storage if it is dirty, together with the
+  // dirty entries stored next to it, and removes it from the index. Returns an
+  // error status on failure.
+  ASYLO_MUST_USE_RESULT Status Evict(size_t entry) {
+    if (entries_[entry].dirty) {
+      // Gather the run of dirty records around the evicted one.
+      flush_order_.clear();
+      off_t first = entries_[entry].offset;
+      for (auto it = index_.find(first - sizeof(T));
+           it != index_.end() && entries_[it->second].dirty;
+           it = index_.find(first - sizeof(T))) {
+        first -= sizeof(T);
+      }
+      off_t last = entries_[entry].offset;
+      for (auto it = index_.find(last + sizeof(T));
+           it != index_.end() && entries_[it->second].dirty;
+           it = index_.find(last + sizeof(T))) {
+        last += sizeof(T);
+      }
+      for (off_t offset = first; offset <= last; offset += sizeof(T)) {
+        flush_order_.push_back(index_.find(offset)->second);
+      }
+      ASYLO_RETURN_IF_ERROR(
+          CommitRun(flush_order_.begin(), flush_order_.end()));
+    }
+    index_.erase(entries_[entry].offset);
     return Status::OkStatus();
   }
 
-  // Evicts an entry from the cache and moves the evicted cache node to the
-  // front of the LRU list. Returns an error status on failure.
-  ASYLO_MUST_USE_RESULT Status Evict() {
-    auto last = std::prev(cache_.end());
-    ASYLO_RETURN_IF_ERROR(Commit(last));
-    index_.erase(last->offset);
-    MoveToFront(last);
+  // Writes the cache entries in [|begin|, |end|), which hold records stored
+  // back to back in order of their offsets, with a single write. Returns an
+  // error status on failure.
+  ASYLO_MUST_USE_RESULT Status CommitRun(
+      std::vector<size_t>::const_iterator begin,
+      std::vector<size_t>::const_iterator end) {
+    const off_t offset = entries_[*begin].offset;
+    const size_t count = end - begin;
+    if (count == 1) {
+      ASYLO_RETURN_IF_ERROR(
+          io_->Write(&entries_[*begin].value, offset, sizeof(T)));
+    } else {
+      run_buffer_.clear();
+      for (auto it = begin; it != end; ++it) {
+        run_buffer_.push_back(entries_[*it].value);
+      }
+      ASYLO_RETURN_IF_ERROR(
+          io_->Write(run_buffer_.data(), offset, count * sizeof(T)));
+    }
+    for (auto it = begin; it != end; ++it) {
+      entries_[*it].dirty = false;
+    }
     return Status::OkStatus();
   }
 
-  // Moves an LRU list node to the front of the list.
-  void MoveToFront(ConstNodeRef node) {
-    if (node != cache_.begin()) {
-      // Splice node onto the front of the list. Note that splice does not
-      // invalidate existing iterators into cache_.
-      cache_.splice(cache_.begin(), cache_, node);
+  // Removes |entry| from the LRU list.
+  void Unlink(size_t entry) {
+    CacheEntry &node = entries_[entry];
+    if (node.prev != kNoEntry) {
+      entries_[node.prev].next = node.next;
+    } else {
+      head_ = node.next;
+    }
+    if (node.next != kNoEntry) {
+      entries_[node.next].prev = node.prev;
+    } else {
+      tail_ = node.prev;
     }
   }
 
-  size_t capacity_;  // Size of the cache in items of type T.
+  // Inserts |entry| at the front of the LRU list.
+  void PushFront(size_t entry) {
+    CacheEntry &node = entries_[entry];
+    node.prev = kNoEntry;
+    node.next = head_;
+    if (head_ != kNoEntry) {
+      entries_[head_].prev = entry;
+    } else {
+      tail_ = entry;
+    }
+    head_ = entry;
+  }
 
-  // Number of items present in the cache. Although std::list::size() is
-  // required to have constant time complexity since C++11, not all library
-  // implementions conform to this requirement. In particular, libstdc++
-  // versions <= 4.8 implement size() as std::distance(head, tail).
-  size_t count_;
+  // Moves |entry| to the front of the LRU list.
+  void MoveToFront(size_t entry) {
+    if (entry != head_) {
+      Unlink(entry);
+      PushFront(entry);
+    }
+  }
+
+  size_t capacity_;  // Size of the cache in items of type T.
 
   RandomAccessStorage *io_;  // Record backing store.
 
-  // Entries in the cache, maintained in LRU order. This implementation does not
-  // preallocate the cache at the time it is created, opting instead to allocate
-  // entries and add them to a list lazily as they are referenced. This enables
-  // overcommitment of heap capacity at the cost of greater overhead incurred
-  // by the default allocator.
-  std::list<CacheEntry> cache_;
+  RecordCacheBudget *budget_;  // Shared cache budget, or nullptr.
+
+  // Cache entries, linked into a list in LRU order through their |prev| and
+  // |next| indices. The array is not preallocated when the RecordStore is
+  // created, but grows as records are referenced until it holds |capacity_|
+  // entries, after which entries are recycled without further allocation.
+  std::vector<CacheEntry> entries_;
+  size_t head_ = kNoEntry;  // Most recently used entry.
+  size_t tail_ = kNoEntry;  // Least recently used entry.
 
-  absl::flat_hash_map<off_t, ConstNodeRef> index_;  // Index by record offset.
+  absl::flat_hash_map<off_t, size_t> index_;  // Index by record offset.
+
+  // Scratch space for writing runs of records, kept to avoid allocating it on
+  // every write.
+  std::vector<size_t> flush_order_;
+  std::vector<T> run_buffer_;
 };
 
+template <typename T>
+constexpr size_t RecordStore<T>::kNoEntry;
+
 }  // namespace asylo
 
 #endif  // ASYLO_PLATFORM_STORAGE_UTILS_RECORD_STORE_H_
@@ -22,6 +22,7 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include "asylo/platform/storage/utils/fd_closer.h"
+#include "asylo/platform/storage/utils/random_access_storage.h"
 #include "asylo/platform/storage/utils/record_store.h"
 #include "asylo/platform/storage/utils/test_utils.h"
 #include "asylo/platform/storage/utils/untrusted_file.h"
@@ -30,6 +31,33 @@
 namespace asylo {
 namespace {
 
+// RandomAccessStorage wrapping an UntrustedFile which counts the writes made.
+class CountingStorage : public RandomAccessStorage {
+ public:
+  explicit CountingStorage(int fd) : file_(fd), writes_(0) {}
+
+  StatusOr<size_t> Size() const override { return file_.Size(); }
+
+  Status Read(void *buffer, off_t offset, size_t size) override {
+    return file_.Read(buffer, offset, size);
+  }
+
+  Status Write(const void *buffer, off_t offset, size_t size) override {
+    writes_++;
+    return file_.Write(buffer, offset, size);
+  }
+
+  Status Sync() override { return file_.Sync(); }
+
+  Status Truncate(size_t size) override { return file_.Truncate(size); }
+
+  int writes() const { return writes_; }
+
+ private:
+  UntrustedFile file_;
+  int writes_;
+};
+
 // Ensure that reading and writing records through a RecordStore returns the
 // expected values.
 TEST(RecordStoreTest, WriteRead) {
@@ -119,5 +147,97 @@ TEST(RecordStoreTest, Flush) {
   }
 }
 
+// Ensure that records which were only read are not written back.
+TEST(RecordStoreTest, CleanRecordsNotWritten) {
+  int fd = CreateEmptyTempFileOrDie("clean_records.tmp");
+  platform::storage::FdCloser closer(fd);
+  CountingStorage storage(fd);
+
+  constexpr size_t kCapacity = 16;
+  constexpr size_t kRecordCount = 256;
+  {
+    RecordStore<size_t> records(kRecordCount, &storage);
+    for (size_t i = 0; i < kRecordCount; i++) {
+      ASYLO_EXPECT_OK(records.Write(i * sizeof(size_t), i));
+    }
+  }
+  int writes = storage.writes();
+
+  RecordStore<size_t> records(kCapacity, &storage);
+  for (size_t i = 0; i < kRecordCount; i++) {
+    size_t record;
+    ASYLO_EXPECT_OK(records.Read(i * sizeof(size_t), &record));
+    EXPECT_EQ(record, i);
+  }
+  ASYLO_ASSERT_OK(records.Flush());
+  EXPECT_EQ(storage.writes(), writes);
+}
+
+// Ensure that dirty records stored back to back are written together.
+TEST(RecordStoreTest, CoalescedWrites) {
+  int fd = CreateEmptyTempFileOrDie("coalesced_writes.tmp");
+  platform::storage::FdCloser closer(fd);
+  CountingStorage storage(fd);
+
+  constexpr size_t kCapacity = 64;
+  constexpr size_t kRecordCount = 32;
+
+  RecordStore<size_t> records(kCapacity, &storage);
+  // Write two runs of records in reverse order, separated by a gap.
+  for (size_t i = kRecordCount; i > 0; i--) {
+    ASYLO_EXPECT_OK(records.Write((i - 1) * sizeof(size_t), i - 1));
+    ASYLO_EXPECT_OK(
+        records.Write((kRecordCount + i) * sizeof(size_t), kRecordCount + i));
+  }
+  ASYLO_ASSERT_OK(records.Flush());
+  EXPECT_EQ(storage.writes(), 2);
+
+  for (size_t i = 0; i <= 2 * kRecordCount; i++) {
+    size_t record;
+    ASYLO_EXPECT_OK(storage.Read(&record, i * sizeof(size_t), sizeof(size_t)));
+    EXPECT_EQ(record, i == kRecordCount ? 0 : i);
+  }
+}
+
+// Ensure that RecordStores sharing a budget cache no more records in total than
+// the budget allows, and that the budget is returned when they are destroyed.
+TEST(RecordStoreTest, SharedBudget) {
+  int fd = CreateEmptyTempFileOrDie("shared_budget.tmp");
+  platform::storage::FdCloser closer(fd);
+  UntrustedFile file(fd);
+
+  constexpr size_t kCapacity = 64;
+  constexpr size_t kBudget = 16;
+  constexpr size_t kRecordCount = 128;
+
+  RecordCacheBudget budget(kBudget);
+  {
+    RecordStore<size_t> first(kCapacity, &file, &budget);
+    RecordStore<size_t> second(kCapacity, &file, &budget);
+    for (size_t i = 0; i < kRecordCount; i++) {
+      ASYLO_EXPECT_OK(first.Write(i * sizeof(size_t), i));
+      ASYLO_EXPECT_OK(second.Write((kRecordCount + i) * sizeof(size_t),
+                                   kRecordCount + i));
+    }
+    EXPECT_EQ(budget.used(), kBudget);
+
+    size_t cached = 0;
+    for (size_t i = 0; i < 2 * kRecordCount; i++) {
+      off_t offset = i * sizeof(size_t);
+      cached += first.IsCached(offset) + second.IsCached(offset);
+    }
+    // The first entry of each store is not charged to the budget.
+    EXPECT_EQ(cached, kBudget + 2);
+
+    for (size_t i = 0; i < 2 * kRecordCount; i++) {
+      size_t record;
+      RecordStore<size_t> &records = i < kRecordCount ? first : second;
+      ASYLO_EXPECT_OK(records.Read(i * sizeof(size_t), &record));
+      EXPECT_EQ(record, i);
+    }
+  }
+  EXPECT_EQ(budget.used(), 0);
+}
+
 }  // namespace
 }  // namespace asylo
@@ -0,0 +1,281 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/system_call/compact_message.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#include "absl/strings/str_cat.h"
+#include "asylo/platform/system_call/message.h"
+
+namespace asylo {
+namespace system_call {
+
+// Defines kCompactLayouts and FindCompactLayout.
+#include "asylo/platform/system_call/generated_compact_layouts.inc"
+
+namespace {
+
+// Size of the result and error number fields following the header of a
+// compact response.
+constexpr size_t kResponseValuesSize = 2 * sizeof(uint64_t);
+
+// Largest buffer accepted in a compact message. Larger buffers fall back to
+// the general encoding.
+constexpr size_t kMaxCompactBufferSize = size_t{1} << 30;
+
+size_t Pad(size_t size) { return (size + 7) & ~size_t{7}; }
+
+const CompactMessageHeader *Header(primitives::Extent message) {
+  return reinterpret_cast<const CompactMessageHeader *>(message.data());
+}
+
+primitives::PrimitiveStatus InvalidMessage(const char *reason) {
+  return {error::GoogleError::INVALID_ARGUMENT,
+          absl::StrCat("Invalid compact system call message: ", reason)};
+}
+
+// Computes the size in bytes of the buffer parameter |index| of |layout| given
+// the scalar |parameters|. Returns false if the size is out of range.
+bool BufferSize(const CompactLayout &layout, int index,
+                const std::array<uint64_t, kParameterMax> &parameters,
+                size_t *size) {
+  const CompactParameterLayout &parameter = layout.parameters[index];
+  if (parameter.bound_index < 0) {
+    *size = parameter.size;
+    return true;
+  }
+  uint64_t count = parameters[parameter.bound_index];
+  return !__builtin_mul_overflow(count, uint64_t{parameter.size}, size) &&
+         *size <= kMaxCompactBufferSize;
+}
+
+// Computes the sizes of all buffer parameters of |layout|. Returns false if
+// any size is out of range.
+bool BufferSizes(const CompactLayout &layout,
+                 const std::array<uint64_t, kParameterMax> &parameters,
+                 std::array<size_t, kParameterMax> *sizes) {
+  sizes->fill(0);
+  for (int i = 0; i < layout.parameter_count; i++) {
+    if (layout.parameters[i].kind != kCompactScalar &&
+        !BufferSize(layout, i, parameters, &(*sizes)[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Writes a compact message header to |buffer| and returns a pointer to the
+// first byte past it.
+uint8_t *WriteHeader(int sysno, uint16_t flags, uint8_t *buffer) {
+  CompactMessageHeader header = {kCompactMessageMagic,
+                                 static_cast<uint16_t>(sysno), flags};
+  memcpy(buffer, &header, sizeof(header));
+  return buffer + sizeof(header);
+}
+
+}  // namespace
+
+bool IsCompactMessage(primitives::Extent message) {
+  return message.data() && message.size() >= sizeof(CompactMessageHeader) &&
+         Header(message)->magic == kCompactMessageMagic;
+}
+
+int CompactMessageSysno(primitives::Extent message) {
+  return Header(message)->sysno;
+}
+
+bool IsCompactRequest(primitives::Extent message) {
+  return IsCompactMessage(message) &&
+         Header(message)->flags == kSystemCallRequest;
+}
+
+bool SerializeCompactRequest(
+    const CompactLayout &layout,
+    const std::array<uint64_t, kParameterMax> &parameters,
+    primitives::Extent *request) {
+  std::array<size_t, kParameterMax> sizes;
+  if (!BufferSizes(layout, parameters, &sizes)) {
+    return false;
+  }
+  size_t size = sizeof(CompactMessageHeader);
+  for (int i = 0; i < layout.parameter_count; i++) {
+    switch (layout.parameters[i].kind) {
+      case kCompactScalar:
+        size += sizeof(uint64_t);
+        break;
+      case kCompactInBuffer:
+        size += Pad(sizes[i]);
+        ABSL_FALLTHROUGH_INTENDED;
+      case kCompactOutBuffer:
+        if (!parameters[i] && sizes[i] > 0) {
+          return false;
+        }
+        break;
+    }
+  }
+
+  auto buffer = static_cast<uint8_t *>(malloc(size));
+  uint8_t *next = WriteHeader(layout.sysno, kSystemCallRequest, buffer);
+  for (int i = 0; i < layout.parameter_count; i++) {
+    if (layout.parameters[i].kind == kCompactScalar) {
+      memcpy(next, &parameters[i], sizeof(uint64_t));
+      next += sizeof(uint64_t);
+    }
+  }
+  for (int i = 0; i < layout.parameter_count; i++) {
+    if (layout.parameters[i].kind == kCompactInBuffer && sizes[i] > 0) {
+      memcpy(next, reinterpret_cast<const void *>(parameters[i]), sizes[i]);
+      memset(next + sizes[i], 0, Pad(sizes[i]) - sizes[i]);
+      next += Pad(sizes[i]);
+    }
+  }
+  *request = primitives::Extent{buffer, size};
+  return true;
+}
+
+primitives::PrimitiveStatus DeserializeCompactResponse(
+    const CompactLayout &layout,
+    const std::array<uint64_t, kParameterMax> &parameters,
+    primitives::Extent response, uint64_t *result, uint64_t *error_number) {
+  if (!IsCompactMessage(response) ||
+      Header(response)->flags != kSystemCallResponse ||
+      Header(response)->sysno != layout.sysno) {
+    return {error::GoogleError::INVALID_ARGUMENT,
+            absl::StrCat("Response does not match the request for sysno (",
+                         layout.sysno, ").")};
+  }
+
+  // The expected size is derived from the request alone, so a response of any
+  // other size is rejected before it is read.
+  std::array<size_t, kParameterMax> sizes;
+  if (!BufferSizes(layout, parameters, &sizes)) {
+    return InvalidMessage("buffer size out of range");
+  }
+  size_t expected_size = sizeof(CompactMessageHeader) + kResponseValuesSize;
+  for (int i = 0; i < layout.parameter_count; i++) {
+    if (layout.parameters[i].kind == kCompactOutBuffer) {
+      expected_size += Pad(sizes[i]);
+    }
+  }
+  if (response.size() != expected_size) {
+    return InvalidMessage("unexpected response size");
+  }
+
+  const uint8_t *next =
+      response.As<uint8_t>() + sizeof(CompactMessageHeader);
+  memcpy(result, next, sizeof(uint64_t));
+  memcpy(error_number, next + sizeof(uint64_t), sizeof(uint64_t));
+  next += kResponseValuesSize;
+  for (int i = 0; i < layout.parameter_count; i++) {
+    if (layout.parameters[i].kind != kCompactOutBuffer) {
+      continue;
+    }
+    void *dst = reinterpret_cast<void *>(parameters[i]);
+    if (dst && sizes[i] > 0) {
+      memcpy(dst, next, sizes[i]);
+    }
+    next += Pad(sizes[i]);
+  }
+  return primitives::PrimitiveStatus::OkStatus();
+}
+
+primitives::PrimitiveStatus DeserializeCompactRequest(
+    primitives::Extent request, const CompactLayout **layout,
+    std::array<uint64_t, kParameterMax> *parameters,
+    std::array<size_t, kParameterMax> *buffer_sizes) {
+  if (!IsCompactRequest(request)) {
+    return InvalidMessage("not a request");
+  }
+  *layout = FindCompactLayout(CompactMessageSysno(request));
+  if (!*layout) {
+    return InvalidMessage("system call has no compact encoding");
+  }
+  parameters->fill(0);
+
+  // The scalars, which determine the sizes of the buffers, come first.
+  const uint8_t *next = request.As<uint8_t>() + sizeof(CompactMessageHeader);
+  const uint8_t *end = request.As<uint8_t>() + request.size();
+  for (int i = 0; i < (*layout)->parameter_count; i++) {
+    if ((*layout)->parameters[i].kind != kCompactScalar) {
+      continue;
+    }
+    if (static_cast<size_t>(end - next) < sizeof(uint64_t)) {
+      return InvalidMessage("truncated request");
+    }
+    memcpy(&(*parameters)[i], next, sizeof(uint64_t));
+    next += sizeof(uint64_t);
+  }
+  if (!BufferSizes(**layout, *parameters, buffer_sizes)) {
+    return InvalidMessage("buffer size out of range");
+  }
+  for (int i = 0; i < (*layout)->parameter_count; i++) {
+    if ((*layout)->parameters[i].kind != kCompactInBuffer ||
+        (*buffer_sizes)[i] == 0) {
+      continue;
+    }
+    size_t padded = Pad((*buffer_sizes)[i]);
+    if (static_cast<size_t>(end - next) < padded) {
+      return InvalidMessage("truncated request");
+    }
+    (*parameters)[i] = reinterpret_cast<uint64_t>(next);
+    next += padded;
+  }
+  if (next != end) {
+    return InvalidMessage("unexpected request size");
+  }
+  return primitives::PrimitiveStatus::OkStatus();
+}
+
+primitives::PrimitiveStatus SerializeCompactResponse(
+    const CompactLayout &layout,
+    const std::array<uint64_t, kParameterMax> &parameters, uint64_t result,
+    uint64_t error_number, primitives::Extent *response) {
+  std::array<size_t, kParameterMax> sizes;
+  if (!BufferSizes(layout, parameters, &sizes)) {
+    return InvalidMessage("buffer size out of range");
+  }
+  size_t size = sizeof(CompactMessageHeader) + kResponseValuesSize;
+  for (int i = 0; i < layout.parameter_count; i++) {
+    if (layout.parameters[i].kind == kCompactOutBuffer) {
+      size += Pad(sizes[i]);
+    }
+  }
+
+  auto buffer = static_cast<uint8_t *>(malloc(size));
+  uint8_t *next = WriteHeader(layout.sysno, kSystemCallResponse, buffer);
+  memcpy(next, &result, sizeof(uint64_t));
+  memcpy(next + sizeof(uint64_t), &error_number, sizeof(uint64_t));
+  next += kResponseValuesSize;
+  for (int i = 0; i < layout.parameter_count; i++) {
+    if (layout.parameters[i].kind != kCompactOutBuffer) {
+      continue;
+    }
+    memset(next, 0, Pad(sizes[i]));
+    if (parameters[i] && sizes[i] > 0) {
+      memcpy(next, reinterpret_cast<const void *>(parameters[i]), sizes[i]);
+    }
+    next += Pad(sizes[i]);
+  }
+  *response = primitives::Extent{buffer, size};
+  return primitives::PrimitiveStatus::OkStatus();
+}
+
+}  // namespace system_call
+}  // namespace asylo
@@ -0,0 +1,140 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_SYSTEM_CALL_COMPACT_MESSAGE_H_
+#define ASYLO_PLATFORM_SYSTEM_CALL_COMPACT_MESSAGE_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "absl/base/attributes.h"
+#include "asylo/platform/primitives/extent.h"
+#include "asylo/platform/primitives/primitive_status.h"
+#include "asylo/platform/system_call/metadata.h"
+
+namespace asylo {
+namespace system_call {
+
+// Frequently invoked system calls with small, fixed signatures are serialized
+// with a compact encoding instead of the general MessageHeader format. Their
+// layouts are emitted by the generate_tables tool, so encoding and decoding
+// them needs neither a metadata table lookup nor per-parameter offsets and
+// sizes in the message.
+//
+// A compact request is a CompactMessageHeader followed, in parameter order,
+// by each scalar parameter as a 64-bit value and then by the contents of each
+// non-empty input buffer. A compact response is a CompactMessageHeader, the
+// 64-bit result and error number, and, in parameter order, the contents of
+// each output buffer. Buffers are padded to a multiple of 8 bytes. Buffer
+// sizes are implied by the layout and the scalar parameters of the request.
+// All values are little-endian.
+
+// Compact message magic number = "sysC".
+constexpr uint32_t kCompactMessageMagic = 0x43737973;
+
+// Compact message header format.
+struct CompactMessageHeader {
+  /* byte: 0 .. 3 */ uint32_t magic;  // Magic number.
+  /* byte: 4 .. 5 */ uint16_t sysno;  // System call number.
+  /* byte: 6 .. 7 */ uint16_t flags;  // MessageFlags bitmap.
+} ABSL_ATTRIBUTE_PACKED;
+
+static_assert(sizeof(CompactMessageHeader) == 8,
+              "Unexpected layout for CompactMessageHeader.");
+
+// The encoding of a single system call parameter in a compact message.
+enum CompactParameterKind : uint8_t {
+  kCompactScalar,     // Passed by value in the request.
+  kCompactInBuffer,   // Buffer copied into the request.
+  kCompactOutBuffer,  // Buffer copied out into the response.
+};
+
+struct CompactParameterLayout {
+  CompactParameterKind kind;
+
+  // For a buffer parameter, the index of the scalar parameter holding its
+  // element count, or -1 if the buffer has a fixed size.
+  int8_t bound_index;
+
+  // For a buffer parameter, its element size if |bound_index| is set, and its
+  // size in bytes otherwise.
+  uint32_t size;
+};
+
+// The compact encoding of a system call.
+struct CompactLayout {
+  int sysno;
+  int parameter_count;
+  CompactParameterLayout parameters[kParameterMax];
+};
+
+// Returns the compact layout of the system call |sysno|, or nullptr if the
+// system call has no compact encoding.
+const CompactLayout *FindCompactLayout(int sysno);
+
+// Returns true if |message| begins with a compact message header.
+bool IsCompactMessage(primitives::Extent message);
+
+// Returns the system call number of a compact message. The message must have
+// been checked with IsCompactMessage.
+int CompactMessageSysno(primitives::Extent message);
+
+// Returns true if |message| is a compact message flagged as a request.
+bool IsCompactRequest(primitives::Extent message);
+
+// Serializes a request for a system call with the compact |layout| into a
+// buffer allocated by malloc and owned by the caller. Returns false without
+// allocating if |parameters| cannot be encoded compactly, for instance
+// because a null buffer is passed with a non-zero size, in which case the
+// caller should use the general encoding.
+bool SerializeCompactRequest(
+    const CompactLayout &layout,
+    const std::array<uint64_t, kParameterMax> &parameters,
+    primitives::Extent *request);
+
+// Deserializes a compact response to a request serialized from |layout| and
+// |parameters|. On success, output buffers are copied to the locations
+// designated by |parameters|, and |result| and |error_number| are populated.
+primitives::PrimitiveStatus DeserializeCompactResponse(
+    const CompactLayout &layout,
+    const std::array<uint64_t, kParameterMax> &parameters,
+    primitives::Extent response, uint64_t *result, uint64_t *error_number);
+
+// Deserializes a compact |request| on the host. On success, |layout| points to
+// the layout of the requested system call, and |parameters| holds its scalar
+// parameters and pointers into |request| for its input buffers. Output buffer
+// parameters are left zero, with their required sizes reported in
+// |buffer_sizes|.
+primitives::PrimitiveStatus DeserializeCompactRequest(
+    primitives::Extent request, const CompactLayout **layout,
+    std::array<uint64_t, kParameterMax> *parameters,
+    std::array<size_t, kParameterMax> *buffer_sizes);
+
+// Serializes a compact response for a system call with the compact |layout|
+// into a buffer allocated by malloc and owned by the caller. Output buffers
+// are read from the locations designated by |parameters|.
+primitives::PrimitiveStatus SerializeCompactResponse(
+    const CompactLayout &layout,
+    const std::array<uint64_t, kParameterMax> &parameters, uint64_t result,
+    uint64_t error_number, primitives::Extent *response);
+
+}  // namespace system_call
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_SYSTEM_CALL_COMPACT_MESSAGE_H_
@@ -0,0 +1,199 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/system_call/compact_message.h"
+
+#include <sys/syscall.h>
+
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "asylo/platform/system_call/message.h"
+
+namespace asylo {
+namespace system_call {
+namespace {
+
+using ::testing::Eq;
+using ::testing::IsNull;
+using ::testing::Lt;
+using ::testing::NotNull;
+using ::testing::StrEq;
+
+using ParameterList = std::array<uint64_t, kParameterMax>;
+
+TEST(CompactMessageTest, HotSystemCallsHaveLayouts) {
+  for (int sysno : {SYS_read, SYS_write, SYS_pread64, SYS_pwrite64, SYS_lseek,
+                    SYS_close, SYS_epoll_wait}) {
+    const CompactLayout *layout = FindCompactLayout(sysno);
+    ASSERT_THAT(layout, NotNull());
+    EXPECT_THAT(layout->sysno, Eq(sysno));
+    EXPECT_THAT(layout->parameter_count,
+                Eq(SystemCallDescriptor{sysno}.parameter_count()));
+  }
+  EXPECT_THAT(FindCompactLayout(SYS_getcwd), IsNull());
+  EXPECT_THAT(FindCompactLayout(-1), IsNull());
+}
+
+TEST(CompactMessageTest, RequestRoundTrip) {
+  const CompactLayout *layout = FindCompactLayout(SYS_write);
+  ASSERT_THAT(layout, NotNull());
+  const char kData[] = "hello, world";
+  ParameterList parameters = {5, reinterpret_cast<uint64_t>(kData),
+                              sizeof(kData)};
+  primitives::Extent request;
+  ASSERT_TRUE(SerializeCompactRequest(*layout, parameters, &request));
+  EXPECT_TRUE(IsCompactRequest(request));
+  EXPECT_THAT(CompactMessageSysno(request), Eq(SYS_write));
+
+  const CompactLayout *decoded_layout;
+  ParameterList decoded;
+  std::array<size_t, kParameterMax> sizes;
+  ASSERT_TRUE(
+      DeserializeCompactRequest(request, &decoded_layout, &decoded, &sizes)
+          .ok());
+  EXPECT_THAT(decoded_layout, Eq(layout));
+  EXPECT_THAT(decoded[0], Eq(5));
+  EXPECT_THAT(decoded[2], Eq(sizeof(kData)));
+  EXPECT_THAT(sizes[1], Eq(sizeof(kData)));
+  EXPECT_THAT(reinterpret_cast<const char *>(decoded[1]), StrEq(kData));
+  free(request.data());
+}
+
+TEST(CompactMessageTest, RequestIsSmallerThanGeneralEncoding) {
+  const CompactLayout *layout = FindCompactLayout(SYS_write);
+  ASSERT_THAT(layout, NotNull());
+  char data[16] = {};
+  ParameterList parameters = {1, reinterpret_cast<uint64_t>(data),
+                              sizeof(data)};
+  primitives::Extent request;
+  ASSERT_TRUE(SerializeCompactRequest(*layout, parameters, &request));
+  EXPECT_THAT(request.size(),
+              Lt(MessageWriter::RequestWriter(SYS_write, parameters)
+                     .MessageSize()));
+  free(request.data());
+}
+
+TEST(CompactMessageTest, ResponseRoundTrip) {
+  const CompactLayout *layout = FindCompactLayout(SYS_read);
+  ASSERT_THAT(layout, NotNull());
+  const char kData[] = "some bytes";
+  ParameterList host_parameters = {7, reinterpret_cast<uint64_t>(kData),
+                                   sizeof(kData)};
+  primitives::Extent response;
+  ASSERT_TRUE(SerializeCompactResponse(*layout, host_parameters,
+                                       /*result=*/sizeof(kData),
+                                       /*error_number=*/0, &response)
+                  .ok());
+
+  char buffer[sizeof(kData)] = {};
+  ParameterList parameters = {7, reinterpret_cast<uint64_t>(buffer),
+                              sizeof(buffer)};
+  uint64_t result;
+  uint64_t error_number;
+  ASSERT_TRUE(DeserializeCompactResponse(*layout, parameters, response,
+                                         &result, &error_number)
+                  .ok());
+  EXPECT_THAT(result, Eq(sizeof(kData)));
+  EXPECT_THAT(error_number, Eq(0));
+  EXPECT_THAT(buffer, StrEq(kData));
+  free(response.data());
+}
+
+TEST(CompactMessageTest, RejectsMismatchedResponse) {
+  const CompactLayout *layout = FindCompactLayout(SYS_read);
+  ASSERT_THAT(layout, NotNull());
+  char buffer[32];
+  ParameterList parameters = {0, reinterpret_cast<uint64_t>(buffer),
+                              sizeof(buffer)};
+  primitives::Extent response;
+  ASSERT_TRUE(
+      SerializeCompactResponse(*layout, parameters, 0, 0, &response).ok());
+
+  // A response for a shorter read must not be accepted.
+  ParameterList longer_parameters = parameters;
+  longer_parameters[2] = sizeof(buffer) + 8;
+  uint64_t result;
+  uint64_t error_number;
+  EXPECT_FALSE(DeserializeCompactResponse(*layout, longer_parameters, response,
+                                          &result, &error_number)
+                   .ok());
+
+  // Nor may a response to a different system call.
+  EXPECT_FALSE(DeserializeCompactResponse(*FindCompactLayout(SYS_pread64),
+                                          parameters, response, &result,
+                                          &error_number)
+                   .ok());
+
+  // Nor a truncated response.
+  EXPECT_FALSE(DeserializeCompactResponse(
+                   *layout, parameters,
+                   primitives::Extent{response.data(), response.size() - 8},
+                   &result, &error_number)
+                   .ok());
+  free(response.data());
+}
+
+TEST(CompactMessageTest, RejectsTruncatedRequest) {
+  const CompactLayout *layout = FindCompactLayout(SYS_write);
+  ASSERT_THAT(layout, NotNull());
+  char data[24] = {};
+  ParameterList parameters = {1, reinterpret_cast<uint64_t>(data),
+                              sizeof(data)};
+  primitives::Extent request;
+  ASSERT_TRUE(SerializeCompactRequest(*layout, parameters, &request));
+
+  const CompactLayout *decoded_layout;
+  ParameterList decoded;
+  std::array<size_t, kParameterMax> sizes;
+  EXPECT_FALSE(DeserializeCompactRequest(
+                   primitives::Extent{request.data(), request.size() - 8},
+                   &decoded_layout, &decoded, &sizes)
+                   .ok());
+  free(request.data());
+}
+
+TEST(CompactMessageTest, FallsBackForUnencodableParameters) {
+  const CompactLayout *layout = FindCompactLayout(SYS_read);
+  ASSERT_THAT(layout, NotNull());
+  primitives::Extent request;
+
+  // A null buffer with a non-zero size.
+  EXPECT_FALSE(SerializeCompactRequest(*layout, {0, 0, 16}, &request));
+
+  // A buffer size which overflows.
+  char buffer[8];
+  const CompactLayout *epoll_layout = FindCompactLayout(SYS_epoll_wait);
+  ASSERT_THAT(epoll_layout, NotNull());
+  EXPECT_FALSE(SerializeCompactRequest(
+      *epoll_layout,
+      {0, reinterpret_cast<uint64_t>(buffer), static_cast<uint64_t>(-1), 0},
+      &request));
+
+  // A null buffer with a zero size is encoded normally.
+  ASSERT_TRUE(SerializeCompactRequest(*layout, {0, 0, 0}, &request));
+  free(request.data());
+}
+
+}  // namespace
+}  // namespace system_call
+}  // namespace asylo
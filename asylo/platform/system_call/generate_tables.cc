@@ -27,6 +27,8 @@
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_join.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
 #include "asylo/platform/system_call/syscalls.inc"
 
 // This file implements a code generation tool built with a native Linux
@@ -339,7 +341,101 @@ void EmitParameterTable(std::ostream *os) {
   *os << "};\n";
 }
 
+// Frequently invoked system calls which are given a compact message encoding.
+// Each must take only scalar parameters and pointers to buffers which are
+// either copied in or copied out, and whose size is fixed or given by a scalar
+// parameter.
+const char *const kCompactSystemCalls[] = {
+    "read", "write", "pread64", "pwrite64", "lseek", "close", "epoll_wait",
+};
+
+// Returns true if the flags string |flags| contains the flag |flag|.
+bool HasFlag(const std::string &flags, const std::string &flag) {
+  for (absl::string_view token : absl::StrSplit(flags, " | ")) {
+    if (token == flag) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Formats the compact layout of the parameter described by |desc| as a
+// CompactParameterLayout initializer, exiting on parameters which cannot be
+// encoded compactly.
+std::string CompactParameterLayout(const ParameterDescription &desc) {
+  const std::string &flags = desc.flags;
+  if (!HasFlag(flags, "kPointer")) {
+    return "{kCompactScalar, -1, 0}";
+  }
+
+  bool in = HasFlag(flags, "kIn");
+  bool out = HasFlag(flags, "kOut");
+  if (in == out || !(HasFlag(flags, "kBounded") || HasFlag(flags, "kFixed"))) {
+    std::cerr << absl::StreamFormat(
+                     "Error: Parameter \"%s\" of system call \"%s\" cannot "
+                     "be encoded compactly.",
+                     desc.name, desc.syscall)
+              << std::endl;
+    exit(1);
+  }
+  const char *kind = in ? "kCompactInBuffer" : "kCompactOutBuffer";
+  if (HasFlag(flags, "kBounded")) {
+    return absl::StrFormat("{%s, %llu, %llu}", kind, desc.size,
+                           desc.element_size);
+  }
+  return absl::StrFormat("{%s, -1, %llu}", kind, desc.size);
+}
+
+// Emits a table of compact message layouts for kCompactSystemCalls, together
+// with a lookup function resolving a system call number to its layout at
+// compile time.
+void EmitCompactLayoutTable(std::ostream *os) {
+  std::map<std::string, int> sysnos;
+  for (const auto &entry : *SystemCallTable()) {
+    sysnos[entry.second.name] = entry.first;
+  }
+
+  std::vector<int> compact_sysnos;
+  *os << "const CompactLayout kCompactLayouts[] = {\n";
+  for (const char *name : kCompactSystemCalls) {
+    auto it = sysnos.find(name);
+    if (it == sysnos.end()) {
+      std::cerr << absl::StreamFormat(
+                       "Error: Compact system call \"%s\" is not defined.",
+                       name)
+                << std::endl;
+      exit(1);
+    }
+    const SystemCallDescription &call = SystemCallTable()->at(it->second);
+    std::vector<std::string> parameters;
+    for (int i = 0; i < call.parameter_count; i++) {
+      parameters.push_back(CompactParameterLayout(
+          (*ParameterTable())[call.parameter_index + i]));
+    }
+    *os << absl::StreamFormat("  /* %s */ {%i, %i, {%s}},\n", name,
+                              it->second, call.parameter_count,
+                              absl::StrJoin(parameters, ", "));
+    compact_sysnos.push_back(it->second);
+  }
+  *os << "};\n";
+  *os << "\n";
+  *os << "const CompactLayout *FindCompactLayout(int sysno) {\n";
+  *os << "  switch (sysno) {\n";
+  for (size_t i = 0; i < compact_sysnos.size(); i++) {
+    *os << absl::StreamFormat("    case %i:\n", compact_sysnos[i]);
+    *os << absl::StreamFormat("      return &kCompactLayouts[%i];\n", i);
+  }
+  *os << "    default:\n";
+  *os << "      return nullptr;\n";
+  *os << "  }\n";
+  *os << "}\n";
+}
+
 int main(int argc, char **argv) {
+  if (argc > 1 && std::string(argv[1]) == "--compact_layouts") {
+    EmitCompactLayoutTable(&std::cout);
+    return 0;
+  }
   EmitSystemCallTable(&std::cout);
   std::cout << std::endl;
   EmitParameterTable(&std::cout);
@@ -20,11 +20,14 @@
 
 #include <algorithm>
 #include <cstddef>
+#include <cstring>
 #include <numeric>
 
 #include "absl/strings/str_cat.h"
+#include "asylo/platform/system_call/compact_message.h"
 #include "asylo/platform/system_call/message.h"
 #include "asylo/platform/system_call/metadata.h"
+#include "asylo/util/status_macros.h"
 
 namespace asylo {
 namespace system_call {
@@ -49,6 +52,13 @@ primitives::PrimitiveStatus SerializeRequest(
                      sysno, ") provided.")};
   }
 
+  // Use the compact encoding for the system calls which have one, unless the
+  // parameters cannot be encoded compactly.
+  const CompactLayout *layout = FindCompactLayout(sysno);
+  if (layout && SerializeCompactRequest(*layout, parameters, request)) {
+    return primitives::PrimitiveStatus::OkStatus();
+  }
+
   auto writer = MessageWriter::RequestWriter(sysno, parameters);
   size_t size = writer.MessageSize();
 
@@ -81,5 +91,52 @@ primitives::PrimitiveStatus SerializeResponse(
   return primitives::PrimitiveStatus::OkStatus();
 }
 
+primitives::PrimitiveStatus DeserializeResponse(
+    int sysno, const std::array<uint64_t, kParameterMax> &parameters,
+    primitives::Extent response, uint64_t *result, uint64_t *error_number) {
+  if (IsCompactMessage(response)) {
+    const CompactLayout *layout = FindCompactLayout(sysno);
+    if (!layout) {
+      return primitives::PrimitiveStatus{
+          error::GoogleError::INVALID_ARGUMENT,
+          absl::StrCat("Response does not match the request for sysno (",
+                       sysno, ").")};
+    }
+    return DeserializeCompactResponse(*layout, parameters, response, result,
+                                      error_number);
+  }
+
+  MessageReader reader(response);
+  ASYLO_RETURN_IF_ERROR(reader.Validate());
+  if (!reader.is_response() || reader.sysno() != sysno) {
+    return primitives::PrimitiveStatus{
+        error::GoogleError::INVALID_ARGUMENT,
+        absl::StrCat("Response does not match the request for sysno (", sysno,
+                     ").")};
+  }
+
+  SystemCallDescriptor descriptor{sysno};
+  for (int i = 0; i < kParameterMax; i++) {
+    ParameterDescriptor parameter = descriptor.parameter(i);
+    if (parameter.is_out()) {
+      size_t size;
+      if (parameter.is_fixed()) {
+        size = parameter.size();
+      } else {
+        size = parameters[parameter.size()] * parameter.element_size();
+      }
+      const void *src = reader.parameter_address(i);
+      void *dst = reinterpret_cast<void *>(parameters[i]);
+      if (dst != nullptr) {
+        memcpy(dst, src, size);
+      }
+    }
+  }
+
+  *result = reader.result();
+  *error_number = reader.error_number();
+  return primitives::PrimitiveStatus::OkStatus();
+}
+
 }  // namespace system_call
 }  // namespace asylo
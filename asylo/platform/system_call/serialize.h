@@ -46,6 +46,16 @@ primitives::PrimitiveStatus SerializeResponse(int sysno, uint64_t result,
                                               const ParameterList &parameters,
                                               primitives::Extent *response);
 
+// Deserializes a system call response to a request serialized from `sysno` and
+// `parameters`. On success, the output parameters are copied into the buffers
+// designated by `parameters`, and `result` and `error_number` are populated
+// with the return value and the kLinux error number reported by the host.
+primitives::PrimitiveStatus DeserializeResponse(int sysno,
+                                                const ParameterList &parameters,
+                                                primitives::Extent response,
+                                                uint64_t *result,
+                                                uint64_t *error_number);
+
 }  // namespace system_call
 }  // namespace asylo
 
@@ -0,0 +1,337 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Benchmarks of the serialization of every system call in syscalls.txt. For
+// each system call, BM_Request serializes a request in the enclave and decodes
+// it on the host, and BM_Response serializes the response on the host and
+// decodes it in the enclave. Both report the encoded bytes per call and the
+// overhead of the encoding over the parameters it carries. With
+// --syscall_corpus=<dir>, BM_Corpus also validates each message of a
+// system_call_message_fuzzer corpus, grouped by system call.
+//
+// After the run, system calls whose encoding takes more than
+// --slow_factor times the median time of their benchmark are listed as
+// unexpectedly expensive.
+
+#include <dirent.h>
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/strings/str_cat.h"
+#include "asylo/platform/primitives/extent.h"
+#include "asylo/platform/system_call/compact_message.h"
+#include "asylo/platform/system_call/message.h"
+#include "asylo/platform/system_call/metadata.h"
+#include "asylo/platform/system_call/serialize.h"
+
+ABSL_FLAG(std::string, syscall_corpus, "",
+          "Directory of system_call_message_fuzzer inputs to validate.");
+ABSL_FLAG(double, slow_factor, 4.0,
+          "Factor of the median time per call above which a system call is "
+          "reported as unexpectedly expensive.");
+
+namespace asylo {
+namespace system_call {
+namespace {
+
+// Size in bytes of the contents of each bounded buffer parameter.
+constexpr size_t kBoundedBufferSize = 256;
+
+// Size in bytes of the storage backing each buffer parameter.
+constexpr size_t kBufferStorageSize = 4096;
+
+constexpr char kPathParameter[] = "/tmp/asylo/system_call_benchmark";
+
+// Parameters of a system call, with the buffers they point to.
+struct SystemCallArguments {
+  int sysno;
+  ParameterList parameters;
+  std::vector<std::unique_ptr<uint8_t[]>> buffers;
+
+  // Bytes of the parameters copied into the request and out of the response.
+  size_t request_payload = 0;
+  size_t response_payload = 0;
+};
+
+// Returns the size of the buffer passed for |parameter| in |arguments|.
+size_t BufferSize(const ParameterDescriptor &parameter,
+                  const SystemCallArguments &arguments) {
+  if (parameter.is_string()) {
+    return sizeof(kPathParameter);
+  }
+  if (parameter.is_fixed()) {
+    return parameter.size();
+  }
+  if (parameter.is_bounded()) {
+    return arguments.parameters[parameter.bounding_parameter().index()] *
+           parameter.element_size();
+  }
+  return 0;
+}
+
+// Returns arguments for |sysno| in which scalars are small, bounded buffers
+// hold kBoundedBufferSize bytes and strings hold a short path.
+SystemCallArguments MakeArguments(int sysno) {
+  SystemCallDescriptor descriptor(sysno);
+  SystemCallArguments arguments;
+  arguments.sysno = sysno;
+  arguments.parameters.fill(0);
+
+  // Scalars default to 1, and bounding scalars to the element count filling
+  // kBoundedBufferSize bytes.
+  for (int i = 0; i < descriptor.parameter_count(); ++i) {
+    ParameterDescriptor parameter = descriptor.parameter(i);
+    if (!parameter.is_pointer()) {
+      arguments.parameters[i] = 1;
+    }
+  }
+  for (int i = 0; i < descriptor.parameter_count(); ++i) {
+    ParameterDescriptor parameter = descriptor.parameter(i);
+    if (parameter.is_bounded()) {
+      arguments.parameters[parameter.bounding_parameter().index()] =
+          std::max<size_t>(1,
+                           kBoundedBufferSize / parameter.element_size());
+    }
+  }
+
+  for (int i = 0; i < descriptor.parameter_count(); ++i) {
+    ParameterDescriptor parameter = descriptor.parameter(i);
+    size_t payload = sizeof(uint64_t);
+    if (parameter.is_pointer()) {
+      payload = BufferSize(parameter, arguments);
+      arguments.buffers.emplace_back(
+          new uint8_t[std::max(payload, kBufferStorageSize)]());
+      uint8_t *buffer = arguments.buffers.back().get();
+      if (parameter.is_string()) {
+        memcpy(buffer, kPathParameter, sizeof(kPathParameter));
+      }
+      arguments.parameters[i] = reinterpret_cast<uint64_t>(buffer);
+    }
+    if (parameter.is_in()) {
+      arguments.request_payload += payload;
+    }
+    if (parameter.is_out()) {
+      arguments.response_payload += payload;
+    }
+  }
+  return arguments;
+}
+
+void SetCounters(benchmark::State &state, size_t bytes, size_t payload) {
+  state.counters["bytes"] = bytes;
+  state.counters["overhead"] = bytes - std::min(bytes, payload);
+  state.SetBytesProcessed(state.iterations() * bytes);
+}
+
+void BM_Request(benchmark::State &state, int sysno) {
+  SystemCallArguments arguments = MakeArguments(sysno);
+  const CompactLayout *compact_layout;
+  ParameterList decoded;
+  std::array<size_t, kParameterMax> buffer_sizes;
+  size_t bytes = 0;
+  for (auto _ : state) {
+    primitives::Extent request;
+    if (!SerializeRequest(sysno, arguments.parameters, &request).ok()) {
+      state.SkipWithError("SerializeRequest failed");
+      return;
+    }
+    bool decoded_ok =
+        IsCompactMessage(request)
+            ? DeserializeCompactRequest(request, &compact_layout, &decoded,
+                                        &buffer_sizes)
+                  .ok()
+            : MessageReader(request).Validate().ok();
+    bytes = request.size();
+    free(request.data());
+    if (!decoded_ok) {
+      state.SkipWithError("Request does not decode");
+      return;
+    }
+  }
+  SetCounters(state, bytes, arguments.request_payload);
+}
+
+void BM_Response(benchmark::State &state, int sysno) {
+  SystemCallArguments arguments = MakeArguments(sysno);
+  const CompactLayout *compact_layout = FindCompactLayout(sysno);
+  size_t bytes = 0;
+  for (auto _ : state) {
+    primitives::Extent response;
+    primitives::PrimitiveStatus status =
+        compact_layout
+            ? SerializeCompactResponse(*compact_layout, arguments.parameters,
+                                       /*result=*/0, /*error_number=*/0,
+                                       &response)
+            : SerializeResponse(sysno, /*result=*/0, /*error_number=*/0,
+                                arguments.parameters, &response);
+    if (!status.ok()) {
+      state.SkipWithError("SerializeResponse failed");
+      return;
+    }
+    uint64_t result;
+    uint64_t error_number;
+    status = DeserializeResponse(sysno, arguments.parameters, response, &result,
+                                 &error_number);
+    bytes = response.size();
+    free(response.data());
+    if (!status.ok()) {
+      state.SkipWithError("DeserializeResponse failed");
+      return;
+    }
+  }
+  SetCounters(state, bytes, arguments.response_payload);
+}
+
+void BM_Corpus(benchmark::State &state,
+               const std::vector<std::string> *messages) {
+  size_t bytes = 0;
+  for (auto _ : state) {
+    for (const std::string &message : *messages) {
+      MessageReader reader({message.data(), message.size()});
+      benchmark::DoNotOptimize(reader.Validate().ok());
+    }
+  }
+  for (const std::string &message : *messages) {
+    bytes += message.size();
+  }
+  state.counters["messages"] = messages->size();
+  state.SetBytesProcessed(state.iterations() * bytes);
+}
+
+// Returns the valid system call messages in the files of |directory|, grouped
+// by system call number.
+std::map<int, std::vector<std::string>> ReadCorpus(
+    const std::string &directory) {
+  std::map<int, std::vector<std::string>> corpus;
+  DIR *dir = opendir(directory.c_str());
+  if (!dir) {
+    std::cerr << "Cannot open corpus directory " << directory << std::endl;
+    return corpus;
+  }
+  while (struct dirent *entry = readdir(dir)) {
+    if (entry->d_name[0] == '.') {
+      continue;
+    }
+    std::ifstream file(absl::StrCat(directory, "/", entry->d_name),
+                       std::ios::binary);
+    std::string message((std::istreambuf_iterator<char>(file)),
+                        std::istreambuf_iterator<char>());
+    if (message.size() < sizeof(MessageHeader)) {
+      continue;
+    }
+    MessageReader reader({message.data(), message.size()});
+    if (reader.Validate().ok()) {
+      corpus[reader.sysno()].push_back(std::move(message));
+    }
+  }
+  closedir(dir);
+  return corpus;
+}
+
+// Console reporter which, once all benchmarks ran, lists the system calls
+// slower than --slow_factor times the median of their benchmark.
+class ExpensiveSystemCallReporter : public benchmark::ConsoleReporter {
+ public:
+  void ReportRuns(const std::vector<Run> &runs) override {
+    for (const Run &run : runs) {
+      if (run.error_occurred || run.iterations == 0) {
+        continue;
+      }
+      std::string name = run.benchmark_name();
+      std::string family = name.substr(0, name.find('/'));
+      times_[family].emplace_back(name, run.GetAdjustedRealTime());
+    }
+    ConsoleReporter::ReportRuns(runs);
+  }
+
+  void Finalize() override {
+    ConsoleReporter::Finalize();
+    double slow_factor = absl::GetFlag(FLAGS_slow_factor);
+    for (auto &family : times_) {
+      std::vector<std::pair<std::string, double>> &times = family.second;
+      std::vector<double> sorted;
+      for (const auto &time : times) {
+        sorted.push_back(time.second);
+      }
+      std::sort(sorted.begin(), sorted.end());
+      double median = sorted[sorted.size() / 2];
+      for (const auto &time : times) {
+        if (time.second > slow_factor * median) {
+          GetOutputStream() << "Unexpectedly expensive: " << time.first << " ("
+                            << time.second << " vs. median " << median
+                            << ")\n";
+        }
+      }
+    }
+  }
+
+ private:
+  std::map<std::string, std::vector<std::pair<std::string, double>>> times_;
+};
+
+}  // namespace
+}  // namespace system_call
+}  // namespace asylo
+
+int main(int argc, char **argv) {
+  using asylo::system_call::SystemCallDescriptor;
+
+  benchmark::Initialize(&argc, argv);
+  absl::ParseCommandLine(argc, argv);
+
+  for (int sysno = 0; sysno <= asylo::system_call::LastSystemCall(); ++sysno) {
+    SystemCallDescriptor descriptor(sysno);
+    if (!descriptor.is_valid()) {
+      continue;
+    }
+    std::string name(descriptor.name());
+    benchmark::RegisterBenchmark(absl::StrCat("BM_Request/", name).c_str(),
+                                 asylo::system_call::BM_Request, sysno);
+    benchmark::RegisterBenchmark(absl::StrCat("BM_Response/", name).c_str(),
+                                 asylo::system_call::BM_Response, sysno);
+  }
+
+  static auto *corpus = new std::map<int, std::vector<std::string>>;
+  if (!absl::GetFlag(FLAGS_syscall_corpus).empty()) {
+    *corpus =
+        asylo::system_call::ReadCorpus(absl::GetFlag(FLAGS_syscall_corpus));
+  }
+  for (const auto &messages : *corpus) {
+    std::string name(SystemCallDescriptor(messages.first).name());
+    benchmark::RegisterBenchmark(absl::StrCat("BM_Corpus/", name).c_str(),
+                                 asylo::system_call::BM_Corpus,
+                                 &messages.second);
+  }
+
+  asylo::system_call::ExpensiveSystemCallReporter reporter;
+  benchmark::RunSpecifiedBenchmarks(&reporter);
+  return 0;
+}
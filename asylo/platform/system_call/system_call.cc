@@ -40,20 +40,66 @@ struct MallocDeleter {
 void default_error_handler(const char *message) { abort(); }
 
 syscall_dispatch_callback global_syscall_callback = nullptr;
+syscall_batch_dispatch_callback global_syscall_batch_callback = nullptr;
+syscall_dispatch_in_place_callback global_syscall_in_place_callback = nullptr;
 void (*error_handler)(const char *message) = nullptr;
 
+// The state of a system call whose response is read in place.
+struct InPlaceSyscall {
+  int sysno;
+  const asylo::system_call::ParameterList *parameters;
+  uint64_t result;
+  uint64_t klinux_errno;
+
+  // Whether the response was passed to DeserializeInPlace.
+  bool response_received;
+};
+
+// Deserializes a response read in place into the InPlaceSyscall |context|,
+// copying the output parameters directly into the buffers of the caller.
+asylo::primitives::PrimitiveStatus DeserializeInPlace(
+    void *context, const uint8_t *response_buffer, size_t response_size) {
+  auto *syscall = static_cast<InPlaceSyscall *>(context);
+  syscall->response_received = true;
+  if (!response_buffer) {
+    error_handler(
+        "system_call.cc: null response buffer received for the syscall.");
+  }
+  return asylo::system_call::DeserializeResponse(
+      syscall->sysno, *syscall->parameters, {response_buffer, response_size},
+      &syscall->result, &syscall->klinux_errno);
+}
+
 }  // namespace
 
 extern "C" bool enc_is_syscall_dispatcher_set() {
   return global_syscall_callback != nullptr;
 }
 
+extern "C" bool enc_is_syscall_batch_dispatcher_set() {
+  return global_syscall_batch_callback != nullptr;
+}
+
+extern "C" bool enc_is_syscall_in_place_dispatcher_set() {
+  return global_syscall_in_place_callback != nullptr;
+}
+
 extern "C" bool enc_is_error_handler_set() { return error_handler != nullptr; }
 
 extern "C" void enc_set_dispatch_syscall(syscall_dispatch_callback callback) {
   global_syscall_callback = callback;
 }
 
+extern "C" void enc_set_dispatch_syscall_batch(
+    syscall_batch_dispatch_callback callback) {
+  global_syscall_batch_callback = callback;
+}
+
+extern "C" void enc_set_dispatch_syscall_in_place(
+    syscall_dispatch_in_place_callback callback) {
+  global_syscall_in_place_callback = callback;
+}
+
 extern "C" void enc_set_error_handler(
     void (*abort_handler)(const char *message)) {
   error_handler = abort_handler;
@@ -90,59 +136,60 @@ extern "C" int64_t enc_untrusted_syscall(int sysno, ...) {
 
   std::unique_ptr<uint8_t, MallocDeleter> request_owner(request.As<uint8_t>());
 
-  // Invoke the system call dispatch callback to execute the system call.
-  uint8_t *response_buffer;
-  size_t response_size;
-
-  if (!enc_is_syscall_dispatcher_set()) {
-    error_handler("system_.cc: system call dispatcher not set.");
-  }
-  status = global_syscall_callback(request.As<uint8_t>(), request.size(),
-                                   &response_buffer, &response_size);
-  if (!status.ok()) {
-    error_handler(
-        "system_call.cc: Callback from syscall dispatcher was unsuccessful.");
-  }
+  uint64_t result;
+  uint64_t klinux_errno;
+  if (enc_is_syscall_in_place_dispatcher_set()) {
+    // Deserialize the response where the dispatcher received it, which copies
+    // the outputs straight into the pointer parameters.
+    InPlaceSyscall syscall{sysno, &parameters, 0, 0, false};
+    status = global_syscall_in_place_callback(
+        request.As<uint8_t>(), request.size(), DeserializeInPlace, &syscall);
+    if (!status.ok() && syscall.response_received) {
+      error_handler(
+          "system_call.cc: Error deserializing response buffer into response "
+          "reader.");
+    }
+    if (!status.ok()) {
+      error_handler(
+          "system_call.cc: Callback from syscall dispatcher was unsuccessful.");
+    }
+    result = syscall.result;
+    klinux_errno = syscall.klinux_errno;
+  } else {
+    // Invoke the system call dispatch callback to execute the system call.
+    uint8_t *response_buffer;
+    size_t response_size;
+
+    if (!enc_is_syscall_dispatcher_set()) {
+      error_handler("system_.cc: system call dispatcher not set.");
+    }
+    status = global_syscall_callback(request.As<uint8_t>(), request.size(),
+                                     &response_buffer, &response_size);
+    if (!status.ok()) {
+      error_handler(
+          "system_call.cc: Callback from syscall dispatcher was "
+          "unsuccessful.");
+    }
 
-  std::unique_ptr<uint8_t, MallocDeleter> response_owner(response_buffer);
+    std::unique_ptr<uint8_t, MallocDeleter> response_owner(response_buffer);
 
-  if (!response_buffer) {
-    error_handler(
-        "system_call.cc: null response buffer received for the syscall.");
-  }
-
-  // Copy outputs back into pointer parameters.
-  auto response_reader =
-      asylo::system_call::MessageReader({response_buffer, response_size});
-  const asylo::primitives::PrimitiveStatus response_status =
-      response_reader.Validate();
-  if (!response_status.ok()) {
-    error_handler(
-        "system_call.cc: Error deserializing response buffer into response "
-        "reader.");
-  }
+    if (!response_buffer) {
+      error_handler(
+          "system_call.cc: null response buffer received for the syscall.");
+    }
 
-  for (int i = 0; i < asylo::system_call::kParameterMax; i++) {
-    asylo::system_call::ParameterDescriptor parameter = descriptor.parameter(i);
-    if (parameter.is_out()) {
-      size_t size;
-      if (parameter.is_fixed()) {
-        size = parameter.size();
-      } else {
-        size = parameters[parameter.size()] * parameter.element_size();
-      }
-      const void *src = response_reader.parameter_address(i);
-      void *dst = reinterpret_cast<void *>(parameters[i]);
-      if (dst != nullptr) {
-        memcpy(dst, src, size);
-      }
+    // Copy outputs back into pointer parameters.
+    status = asylo::system_call::DeserializeResponse(
+        sysno, parameters, {response_buffer, response_size}, &result,
+        &klinux_errno);
+    if (!status.ok()) {
+      error_handler(
+          "system_call.cc: Error deserializing response buffer into response "
+          "reader.");
     }
   }
 
-  uint64_t result = response_reader.header()->result;
   if (static_cast<int64_t>(result) == -1) {
-    int klinux_errno = response_reader.header()->error_number;
-
     // Simply having a return value of -1 from a syscall is not a necessary
     // condition that the syscall failed. Some syscalls can return -1 when
     // successful (eg., lseek). The reliable way to check for syscall failure is
@@ -153,3 +200,27 @@ extern "C" int64_t enc_untrusted_syscall(int sysno, ...) {
   }
   return result;
 }
+
+extern "C" asylo::primitives::PrimitiveStatus enc_untrusted_syscall_batch(
+    size_t count, const asylo::primitives::Extent *requests,
+    asylo::primitives::Extent *responses) {
+  if (enc_is_syscall_batch_dispatcher_set()) {
+    return global_syscall_batch_callback(count, requests, responses);
+  }
+  if (!enc_is_syscall_dispatcher_set()) {
+    return {asylo::error::GoogleError::FAILED_PRECONDITION,
+            "system_call.cc: system call dispatcher not set."};
+  }
+  for (size_t i = 0; i < count; i++) {
+    uint8_t *response_buffer = nullptr;
+    size_t response_size = 0;
+    if (!global_syscall_callback(requests[i].As<uint8_t>(), requests[i].size(),
+                                 &response_buffer, &response_size)
+             .ok()) {
+      response_buffer = nullptr;
+      response_size = 0;
+    }
+    responses[i] = {response_buffer, response_size};
+  }
+  return asylo::primitives::PrimitiveStatus::OkStatus();
+}
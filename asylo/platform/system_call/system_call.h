@@ -22,6 +22,7 @@
 #include <cstddef>
 #include <cstdint>
 
+#include "asylo/platform/primitives/extent.h"
 #include "asylo/platform/primitives/primitive_status.h"
 
 #ifdef __cplusplus
@@ -37,9 +38,47 @@ typedef asylo::primitives::PrimitiveStatus (*syscall_dispatch_callback)(
     const uint8_t *request_buffer, size_t request_size,
     uint8_t **response_buffer, size_t *response_size);
 
+// Callback type invoked by a syscall_dispatch_in_place_callback with the
+// response to a system call. `response_buffer` and `response_size` designate
+// the response, which is only valid for the duration of the call, and `context`
+// is the context passed to the dispatch callback.
+typedef asylo::primitives::PrimitiveStatus (*syscall_response_callback)(
+    void *context, const uint8_t *response_buffer, size_t response_size);
+
+// Callback type installed at runtime to dispatch a system call across the
+// enclave boundary without copying its response to a separate buffer.
+// `request_buffer` and `request_size` designate a system call request owned by
+// the caller. On success, `response_callback` is invoked with `context` and the
+// response, where it was received, and its status is returned.
+typedef asylo::primitives::PrimitiveStatus (
+    *syscall_dispatch_in_place_callback)(
+    const uint8_t *request_buffer, size_t request_size,
+    syscall_response_callback response_callback, void *context);
+
+// Callback type installed at runtime to dispatch a batch of independent system
+// calls across the enclave boundary at once. `requests` designates `count`
+// system call requests owned by the caller, which are executed in order. On
+// success, each element of `responses` is populated with the response to the
+// corresponding request, allocated by malloc() on the trusted heap, or with an
+// empty extent if the host failed to execute that request.
+typedef asylo::primitives::PrimitiveStatus (*syscall_batch_dispatch_callback)(
+    size_t count, const asylo::primitives::Extent *requests,
+    asylo::primitives::Extent *responses);
+
 // Installs a callback as dispatch function for serialized system calls.
 void enc_set_dispatch_syscall(syscall_dispatch_callback callback);
 
+// Installs a callback as dispatch function for batches of serialized system
+// calls.
+void enc_set_dispatch_syscall_batch(syscall_batch_dispatch_callback callback);
+
+// Installs a callback as dispatch function for serialized system calls whose
+// responses are read in place. When installed, it is used by
+// enc_untrusted_syscall instead of the callback installed by
+// enc_set_dispatch_syscall.
+void enc_set_dispatch_syscall_in_place(
+    syscall_dispatch_in_place_callback callback);
+
 // Installs an error handler function that aborts with a message in case of a
 // failure.
 void enc_set_error_handler(void (*abort_handler)(const char *message));
@@ -48,6 +87,14 @@ void enc_set_error_handler(void (*abort_handler)(const char *message));
 // calls.
 bool enc_is_syscall_dispatcher_set();
 
+// Returns whether a dispatch function has been registered for making batches of
+// system calls.
+bool enc_is_syscall_batch_dispatcher_set();
+
+// Returns whether a dispatch function has been registered for making system
+// calls whose responses are read in place.
+bool enc_is_syscall_in_place_dispatcher_set();
+
 // Returns whether an error handler function has been registered.
 bool enc_is_error_handler_set();
 
@@ -55,6 +102,14 @@ bool enc_is_error_handler_set();
 // callback.
 int64_t enc_untrusted_syscall(int sysno, ...);
 
+// Dispatches a batch of serialized system call requests via the installed batch
+// dispatch callback, with the semantics of syscall_batch_dispatch_callback. If
+// no batch dispatch callback is installed, the requests are dispatched one at a
+// time via the system call dispatch callback instead.
+asylo::primitives::PrimitiveStatus enc_untrusted_syscall_batch(
+    size_t count, const asylo::primitives::Extent *requests,
+    asylo::primitives::Extent *responses);
+
 #ifdef __cplusplus
 }
 #endif
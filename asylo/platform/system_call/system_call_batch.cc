@@ -0,0 +1,95 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/platform/system_call/system_call_batch.h"
+
+#include <cstdlib>
+#include <vector>
+
+#include "asylo/platform/system_call/system_call.h"
+#include "asylo/platform/system_call/type_conversions/types_functions.h"
+#include "asylo/util/status_macros.h"
+
+namespace asylo {
+namespace system_call {
+
+SystemCallBatch::~SystemCallBatch() {
+  for (auto &call : calls_) {
+    free(call.request.data());
+  }
+}
+
+primitives::PrimitiveStatus SystemCallBatch::AddRequest(
+    int sysno, const ParameterList &parameters) {
+  if (dispatched_) {
+    return {error::GoogleError::FAILED_PRECONDITION,
+            "SystemCallBatch has already been dispatched."};
+  }
+  primitives::Extent request;
+  ASYLO_RETURN_IF_ERROR(SerializeRequest(sysno, parameters, &request));
+  calls_.push_back(Call{sysno, parameters, request,
+                        {error::GoogleError::UNAVAILABLE, "Not dispatched."},
+                        -1, 0});
+  return primitives::PrimitiveStatus::OkStatus();
+}
+
+primitives::PrimitiveStatus SystemCallBatch::Dispatch() {
+  if (dispatched_) {
+    return {error::GoogleError::FAILED_PRECONDITION,
+            "SystemCallBatch has already been dispatched."};
+  }
+  dispatched_ = true;
+  if (calls_.empty()) {
+    return primitives::PrimitiveStatus::OkStatus();
+  }
+
+  std::vector<primitives::Extent> requests;
+  requests.reserve(calls_.size());
+  for (const auto &call : calls_) {
+    requests.push_back(call.request);
+  }
+  std::vector<primitives::Extent> responses(calls_.size());
+  ASYLO_RETURN_IF_ERROR(enc_untrusted_syscall_batch(
+      calls_.size(), requests.data(), responses.data()));
+
+  for (size_t i = 0; i < calls_.size(); i++) {
+    Call *call = &calls_[i];
+    primitives::Extent response = responses[i];
+    if (!response.data()) {
+      call->status = {error::GoogleError::INTERNAL,
+                      "Host failed to execute the system call."};
+      continue;
+    }
+    uint64_t result;
+    uint64_t klinux_errno;
+    call->status = DeserializeResponse(call->sysno, call->parameters, response,
+                                       &result, &klinux_errno);
+    free(response.data());
+    if (!call->status.ok()) {
+      continue;
+    }
+    call->result = static_cast<int64_t>(result);
+    if (call->result == -1 && klinux_errno != 0) {
+      call->error_number = FromkLinuxErrorNumber(klinux_errno);
+    }
+  }
+  return primitives::PrimitiveStatus::OkStatus();
+}
+
+}  // namespace system_call
+}  // namespace asylo
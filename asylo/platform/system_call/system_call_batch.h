@@ -0,0 +1,127 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_PLATFORM_SYSTEM_CALL_SYSTEM_CALL_BATCH_H_
+#define ASYLO_PLATFORM_SYSTEM_CALL_SYSTEM_CALL_BATCH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include "asylo/platform/primitives/extent.h"
+#include "asylo/platform/primitives/primitive_status.h"
+#include "asylo/platform/system_call/serialize.h"
+
+namespace asylo {
+namespace system_call {
+
+// Accumulates independent system calls and dispatches them to the host with a
+// single crossing of the enclave boundary, via enc_untrusted_syscall_batch().
+// Calls are executed by the host in the order they were added. Since no call
+// observes the results of another, only calls which do not depend on each
+// other should be batched.
+//
+// A SystemCallBatch may be dispatched only once. Example:
+//
+//   SystemCallBatch batch;
+//   batch.Add(SYS_fcntl, fd, F_SETFL, O_NONBLOCK);
+//   batch.Add(SYS_clock_gettime, CLOCK_MONOTONIC, &ts);
+//   ASYLO_RETURN_IF_ERROR(batch.Dispatch());
+//   if (batch.result(0) == -1) { ... batch.error_number(0) ... }
+class SystemCallBatch {
+ public:
+  SystemCallBatch() = default;
+  ~SystemCallBatch();
+
+  SystemCallBatch(const SystemCallBatch &other) = delete;
+  SystemCallBatch &operator=(const SystemCallBatch &other) = delete;
+
+  // Queues system call `sysno` with the given arguments. Input buffers passed
+  // by pointer are captured when the call is queued. Output buffers passed by
+  // pointer must remain valid until Dispatch() returns, and are written by
+  // Dispatch().
+  template <class... Ts>
+  primitives::PrimitiveStatus Add(int sysno, Ts... args) {
+    static_assert(sizeof...(Ts) <= kParameterMax,
+                  "Too many system call parameters.");
+    const uint64_t values[] = {0, ToParameter(args)...};
+    ParameterList parameters{};
+    for (size_t i = 0; i < sizeof...(Ts); i++) {
+      parameters[i] = values[i + 1];
+    }
+    return AddRequest(sysno, parameters);
+  }
+
+  // Queues system call `sysno` with an explicit parameter list.
+  primitives::PrimitiveStatus AddRequest(int sysno,
+                                         const ParameterList &parameters);
+
+  // Returns the number of queued system calls.
+  size_t size() const { return calls_.size(); }
+
+  // Dispatches all queued system calls to the host. Returns an error if the
+  // batch could not be dispatched as a whole; the outcome of each individual
+  // call is reported by status(), result() and error_number().
+  primitives::PrimitiveStatus Dispatch();
+
+  // Returns whether call `index` was executed by the host and its response
+  // was successfully deserialized.
+  const primitives::PrimitiveStatus &status(size_t index) const {
+    return calls_[index].status;
+  }
+
+  // Returns the return value of call `index`, or -1 if it failed to execute.
+  int64_t result(size_t index) const { return calls_[index].result; }
+
+  // Returns the errno value reported for call `index` if it returned -1, and 0
+  // otherwise.
+  int error_number(size_t index) const { return calls_[index].error_number; }
+
+ private:
+  struct Call {
+    int sysno;
+    ParameterList parameters;
+    primitives::Extent request;
+    primitives::PrimitiveStatus status;
+    int64_t result;
+    int error_number;
+  };
+
+  static uint64_t ToParameter(std::nullptr_t value) { return 0; }
+
+  template <typename T>
+  static uint64_t ToParameter(T *value) {
+    return reinterpret_cast<uint64_t>(value);
+  }
+
+  template <typename T>
+  static uint64_t ToParameter(T value) {
+    static_assert(std::is_integral<T>::value || std::is_enum<T>::value,
+                  "System call parameters must be integers or pointers.");
+    return static_cast<uint64_t>(value);
+  }
+
+  std::vector<Call> calls_;
+  bool dispatched_ = false;
+};
+
+}  // namespace system_call
+}  // namespace asylo
+
+#endif  // ASYLO_PLATFORM_SYSTEM_CALL_SYSTEM_CALL_BATCH_H_
@@ -19,6 +19,8 @@
 #include "asylo/platform/system_call/system_call.h"
 
 #include <fcntl.h>
+#include <linux/futex.h>
+#include <sched.h>
 #include <sys/poll.h>
 #include <sys/stat.h>
 #include <sys/syscall.h>
@@ -28,6 +30,7 @@
 #include <cerrno>
 #include <cstring>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <gmock/gmock.h>
@@ -36,6 +39,7 @@
 #include "absl/strings/str_cat.h"
 #include "asylo/platform/primitives/untrusted_primitives.h"
 #include "asylo/platform/system_call/sysno.h"
+#include "asylo/platform/system_call/system_call_batch.h"
 #include "asylo/platform/system_call/type_conversions/types.h"
 #include "asylo/platform/system_call/type_conversions/types_functions.h"
 #include "asylo/platform/system_call/untrusted_invoke.h"
@@ -50,6 +54,7 @@ using testing::Eq;
 using testing::IsNull;
 using testing::Not;
 using testing::StrEq;
+using testing::UnorderedElementsAre;
 
 // A system call dispatch function which invokes a request message locally.
 asylo::primitives::PrimitiveStatus SystemCallDispatcher(
@@ -66,6 +71,34 @@ asylo::primitives::PrimitiveStatus SystemCallDispatcher(
   return asylo::primitives::PrimitiveStatus::OkStatus();
 }
 
+// A system call dispatch function which invokes a request message locally and
+// passes the response to |response_callback| in place.
+asylo::primitives::PrimitiveStatus SystemCallInPlaceDispatcher(
+    const uint8_t *request_buffer, size_t request_size,
+    syscall_response_callback response_callback, void *context) {
+  primitives::Extent response;
+
+  ASYLO_RETURN_IF_ERROR(
+      UntrustedInvoke({request_buffer, request_size}, &response));
+
+  asylo::primitives::PrimitiveStatus status =
+      response_callback(context, response.As<uint8_t>(), response.size());
+  free(response.data());
+  return status;
+}
+
+// A system call batch dispatch function which invokes request messages locally.
+asylo::primitives::PrimitiveStatus SystemCallBatchDispatcher(
+    size_t count, const primitives::Extent *requests,
+    primitives::Extent *responses) {
+  for (size_t i = 0; i < count; i++) {
+    if (!UntrustedInvoke(requests[i], &responses[i]).ok()) {
+      responses[i] = primitives::Extent{nullptr, 0};
+    }
+  }
+  return asylo::primitives::PrimitiveStatus::OkStatus();
+}
+
 void error_handler(const char *message) {
   fprintf(stderr, "%s\n", message);
   fflush(stderr);
@@ -114,6 +147,25 @@ TEST(SystemCallTest, BufferOutTest) {
   EXPECT_THAT(&buffer_expected[0], StrEq(buffer_actual));
 }
 
+// Invokes a system call which copies a buffer out of the kernel, reading its
+// response in place.
+TEST(SystemCallTest, InPlaceBufferOutTest) {
+  enc_set_dispatch_syscall_in_place(SystemCallInPlaceDispatcher);
+  EXPECT_TRUE(enc_is_syscall_in_place_dispatcher_set());
+  char buffer_expected[2048];
+  char buffer_actual[2048];
+  EXPECT_THAT(getcwd(buffer_expected, sizeof(buffer_expected)), Not(IsNull()));
+
+  enc_untrusted_syscall(SYS_getcwd, buffer_actual, sizeof(buffer_actual));
+  EXPECT_THAT(&buffer_expected[0], StrEq(buffer_actual));
+
+  // A failed system call reports its error number in place too.
+  errno = 0;
+  EXPECT_THAT(enc_untrusted_syscall(SYS_close, -1), Eq(-1));
+  EXPECT_THAT(errno, Eq(EBADF));
+  enc_set_dispatch_syscall_in_place(nullptr);
+}
+
 // Invokes a system call which takes a scalar input parameter.
 TEST(SystemCallTest, ScalarInTest) {
   enc_set_dispatch_syscall(SystemCallDispatcher);
@@ -201,6 +253,130 @@ TEST(SystemCallTest, ArrayOutTest) {
   close(fd[1]);
 }
 
+// Invokes a system call which returns an address in the host address space.
+TEST(SystemCallTest, MapFileTest) {
+  enc_set_dispatch_syscall(SystemCallDispatcher);
+  std::string path =
+      absl::StrCat(absl::GetFlag(FLAGS_test_tmpdir), "/map_file_test.tmp");
+  int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+  ASSERT_GE(fd, 0);
+  const char message[] = "mapped contents";
+  ssize_t message_len = sizeof(message);
+  ASSERT_THAT(write(fd, message, message_len), Eq(message_len));
+
+  int64_t result = enc_untrusted_syscall(SYS_mmap, nullptr, sizeof(message),
+                                         kLinux_PROT_READ, kLinux_MAP_PRIVATE,
+                                         fd, 0);
+  ASSERT_THAT(result, Not(Eq(-1)));
+  const char *mapping = reinterpret_cast<const char *>(result);
+  EXPECT_THAT(mapping, StrEq(message));
+  EXPECT_THAT(enc_untrusted_syscall(SYS_munmap, mapping, sizeof(message)),
+              Eq(0));
+  close(fd);
+}
+
+// Invokes a system call which takes host addresses by value, moving a thread
+// waiting on one futex word to another.
+TEST(SystemCallTest, FutexRequeueTest) {
+  enc_set_dispatch_syscall(SystemCallDispatcher);
+  int32_t source = 0;
+  int32_t target = 0;
+  EXPECT_THAT(enc_untrusted_syscall(SYS_futex, &source,
+                                    kLinux_FUTEX_CMP_REQUEUE, 0, 1, &target,
+                                    /*val3=*/1),
+              Eq(-1));
+  EXPECT_THAT(errno, Eq(EAGAIN));
+
+  std::thread waiter([&source] {
+    syscall(SYS_futex, &source, FUTEX_WAIT, 0, nullptr, nullptr, 0);
+  });
+  // Retry until the waiter sleeps on |source| and is moved to |target|.
+  while (enc_untrusted_syscall(SYS_futex, &source, kLinux_FUTEX_CMP_REQUEUE, 0,
+                               1, &target, /*val3=*/0) != 1) {
+    sched_yield();
+  }
+  EXPECT_THAT(syscall(SYS_futex, &target, FUTEX_WAKE, 1, nullptr, nullptr, 0),
+              Eq(1));
+  waiter.join();
+}
+
+// Invokes a system call which moves data between two host file descriptors and
+// updates an offset passed in and out of the kernel.
+TEST(SystemCallTest, SendfileTest) {
+  enc_set_dispatch_syscall(SystemCallDispatcher);
+  std::string path =
+      absl::StrCat(absl::GetFlag(FLAGS_test_tmpdir), "/sendfile_test.tmp");
+  int in_fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+  ASSERT_GE(in_fd, 0);
+  const char message[] = "skipped, then sent";
+  ssize_t message_len = sizeof(message);
+  ASSERT_THAT(write(in_fd, message, message_len), Eq(message_len));
+  int pipe_fds[2];
+  ASSERT_THAT(pipe(pipe_fds), Eq(0));
+
+  off_t offset = 9;
+  EXPECT_THAT(enc_untrusted_syscall(SYS_sendfile, pipe_fds[1], in_fd, &offset,
+                                    message_len),
+              Eq(message_len - 9));
+  EXPECT_THAT(offset, Eq(message_len));
+  char buf[sizeof(message)];
+  EXPECT_THAT(read(pipe_fds[0], buf, sizeof(buf)), Eq(message_len - 9));
+  EXPECT_THAT(buf, StrEq(message + 9));
+  close(pipe_fds[0]);
+  close(pipe_fds[1]);
+  close(in_fd);
+}
+
+// Reads the entries of a directory and fetches their attributes relative to
+// the directory in a single batch, as directory scans do.
+TEST(SystemCallTest, DirectoryBatchTest) {
+  enc_set_dispatch_syscall(SystemCallDispatcher);
+  enc_set_dispatch_syscall_batch(SystemCallBatchDispatcher);
+  std::string directory =
+      absl::StrCat(absl::GetFlag(FLAGS_test_tmpdir), "/directory_batch_test");
+  ASSERT_THAT(mkdir(directory.c_str(), S_IRWXU), Eq(0));
+  const std::vector<std::string> names = {"first", "second"};
+  for (size_t i = 0; i < names.size(); ++i) {
+    std::string path = absl::StrCat(directory, "/", names[i]);
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT, S_IRUSR | S_IWUSR);
+    ASSERT_GE(fd, 0);
+    ASSERT_THAT(write(fd, "data", i + 1), Eq(i + 1));
+    close(fd);
+  }
+  int dir_fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+  ASSERT_GE(dir_fd, 0);
+
+  char buffer[4096];
+  int64_t size =
+      enc_untrusted_syscall(SYS_getdents64, dir_fd, buffer, sizeof(buffer));
+  ASSERT_GT(size, 0);
+  std::vector<std::string> entries;
+  for (int64_t position = 0; position < size;) {
+    struct klinux_dirent64 header;
+    memcpy(&header, buffer + position, sizeof(header));
+    entries.emplace_back(buffer + position + sizeof(header));
+    position += header.klinux_d_reclen;
+  }
+  EXPECT_THAT(entries, UnorderedElementsAre(".", "..", "first", "second"));
+
+  struct klinux_stat stats[2];
+  SystemCallBatch batch;
+  for (size_t i = 0; i < names.size(); ++i) {
+    ASSERT_TRUE(batch
+                    .Add(SYS_newfstatat, dir_fd, names[i].c_str(), &stats[i],
+                         kLinux_AT_SYMLINK_NOFOLLOW)
+                    .ok());
+  }
+  ASSERT_TRUE(batch.Dispatch().ok());
+  for (size_t i = 0; i < names.size(); ++i) {
+    ASSERT_TRUE(batch.status(i).ok());
+    EXPECT_THAT(batch.result(i), Eq(0));
+    EXPECT_THAT(stats[i].klinux_st_size, Eq(i + 1));
+  }
+  close(dir_fd);
+  enc_set_dispatch_syscall_batch(nullptr);
+}
+
 // Ensure that a header file containing system call numbers was generated
 // correctly.
 TEST(SystemCallTest, SysCallNumbers) {
@@ -296,6 +472,60 @@ TEST(SystemCallTest, BoundedBufferByParamLenTest) {
   EXPECT_THAT(fds_actual[1].revents, Eq(fds_actual[1].revents));
 }
 
+// Dispatches a batch of independent system calls and checks each result,
+// output buffer and errno is reported for the corresponding call.
+TEST(SystemCallTest, BatchTest) {
+  enc_set_dispatch_syscall_batch(SystemCallBatchDispatcher);
+  char buffer_expected[2048];
+  char buffer_actual[2048];
+  EXPECT_THAT(getcwd(buffer_expected, sizeof(buffer_expected)), Not(IsNull()));
+
+  SystemCallBatch batch;
+  ASSERT_TRUE(batch.Add(SYS_getpid).ok());
+  ASSERT_TRUE(
+      batch.Add(SYS_getcwd, buffer_actual, sizeof(buffer_actual)).ok());
+  ASSERT_TRUE(batch.Add(SYS_getcwd, nullptr, 1).ok());
+  ASSERT_THAT(batch.size(), Eq(3));
+  ASSERT_TRUE(batch.Dispatch().ok());
+
+  ASSERT_TRUE(batch.status(0).ok());
+  EXPECT_THAT(batch.result(0), Eq(getpid()));
+  EXPECT_THAT(batch.error_number(0), Eq(0));
+  ASSERT_TRUE(batch.status(1).ok());
+  EXPECT_THAT(&buffer_expected[0], StrEq(buffer_actual));
+  ASSERT_TRUE(batch.status(2).ok());
+  EXPECT_THAT(batch.result(2), Eq(-1));
+  EXPECT_THAT(batch.error_number(2), Eq(ERANGE));
+
+  EXPECT_FALSE(batch.Dispatch().ok());
+  enc_set_dispatch_syscall_batch(nullptr);
+}
+
+// Ensures a batch is dispatched one call at a time when no batch dispatch
+// function is installed.
+TEST(SystemCallTest, BatchFallsBackToSystemCallDispatcher) {
+  enc_set_dispatch_syscall_batch(nullptr);
+  enc_set_dispatch_syscall(SystemCallDispatcher);
+  SystemCallBatch batch;
+  ASSERT_TRUE(batch.Add(SYS_getpid).ok());
+  ASSERT_TRUE(batch.Add(SYS_getppid).ok());
+  ASSERT_TRUE(batch.Dispatch().ok());
+  EXPECT_THAT(batch.result(0), Eq(getpid()));
+  EXPECT_THAT(batch.result(1), Eq(getppid()));
+}
+
+// Ensures a failure to execute one call of a batch is reported for that call
+// only.
+TEST(SystemCallTest, BatchReportsFailedCalls) {
+  enc_set_dispatch_syscall_batch(nullptr);
+  enc_set_dispatch_syscall(AlwaysFailingDispatcher);
+  SystemCallBatch batch;
+  ASSERT_TRUE(batch.Add(SYS_getpid).ok());
+  ASSERT_TRUE(batch.Dispatch().ok());
+  EXPECT_FALSE(batch.status(0).ok());
+  EXPECT_THAT(batch.result(0), Eq(-1));
+}
+
 }  // namespace
 }  // namespace system_call
 }  // namespace asylo
@@ -61,6 +61,15 @@ struct klinux_stat {
   int64_t klinux_unused[3];
 };
 
+// Fixed-size header of a record returned by getdents64. It is followed by the
+// NUL-terminated entry name and padding up to |klinux_d_reclen| bytes.
+struct klinux_dirent64 {
+  uint64_t klinux_d_ino;
+  int64_t klinux_d_off;
+  uint16_t klinux_d_reclen;
+  uint8_t klinux_d_type;
+} ABSL_ATTRIBUTE_PACKED;
+
 struct klinux_sockaddr {
   int16_t klinux_sa_family;
   char klinux_sa_data[14];
@@ -132,6 +141,30 @@ enum klinux_statfs_flag {
   kLinux_ST_RELATIME = (1 << 12),
 };
 
+// Protection and mapping flags used when mapping host files into untrusted
+// memory.
+enum klinux_mmap_flag {
+  kLinux_PROT_READ = 0x1,
+  kLinux_MAP_PRIVATE = 0x02,
+};
+
+// Futex operations used to move waiters between untrusted wait queues.
+enum klinux_futex_op {
+  kLinux_FUTEX_CMP_REQUEUE = 4,
+};
+
+enum klinux_splice_flag {
+  kLinux_SPLICE_F_MOVE = 0x01,
+  kLinux_SPLICE_F_NONBLOCK = 0x02,
+  kLinux_SPLICE_F_MORE = 0x04,
+  kLinux_SPLICE_F_GIFT = 0x08,
+};
+
+enum klinux_at_flag {
+  kLinux_AT_FDCWD = -100,
+  kLinux_AT_SYMLINK_NOFOLLOW = 0x100,
+};
+
 struct klinux_fd_set {
   uint64_t fds_bits[(KLINUX_FD_SETSIZE / (8 * sizeof(uint64_t)))];
 };
@@ -25,6 +25,7 @@
 #include <sys/statvfs.h>
 
 #include <algorithm>
+#include <cstddef>
 #include <cstring>
 
 #include "absl/strings/str_cat.h"
@@ -32,6 +33,30 @@
 
 namespace {
 
+// Whether arrays of enclave and kernel pollfd structs can be copied as is.
+constexpr bool kPollfdMatchesKernel =
+    sizeof(struct pollfd) == sizeof(struct klinux_pollfd) &&
+    offsetof(struct pollfd, fd) == offsetof(struct klinux_pollfd, klinux_fd) &&
+    offsetof(struct pollfd, events) ==
+        offsetof(struct klinux_pollfd, klinux_events) &&
+    offsetof(struct pollfd, revents) ==
+        offsetof(struct klinux_pollfd, klinux_revents) &&
+    sizeof(pollfd::fd) == sizeof(klinux_pollfd::klinux_fd) &&
+    sizeof(pollfd::events) == sizeof(klinux_pollfd::klinux_events) &&
+    sizeof(pollfd::revents) == sizeof(klinux_pollfd::klinux_revents) &&
+    kPollEventMatchesKernel;
+
+// Whether arrays of enclave and kernel epoll events can be copied as is.
+constexpr bool kEpollEventMatchesKernel =
+    sizeof(struct epoll_event) == sizeof(struct klinux_epoll_event) &&
+    offsetof(struct epoll_event, events) ==
+        offsetof(struct klinux_epoll_event, events) &&
+    offsetof(struct epoll_event, data) ==
+        offsetof(struct klinux_epoll_event, data) &&
+    sizeof(epoll_event::events) == sizeof(klinux_epoll_event::events) &&
+    sizeof(epoll_event::data) == sizeof(klinux_epoll_event::data) &&
+    kEpollEventsMatchesKernel;
+
 template <typename T, typename U>
 void ReinterpretCopySingle(T *dst, const U *src) {
   memcpy(dst, src, std::min(sizeof(T), sizeof(U)));
@@ -690,6 +715,36 @@ bool FromkLinuxPollfd(const struct klinux_pollfd *input,
   return true;
 }
 
+bool TokLinuxPollfdArray(const struct pollfd *input, size_t count,
+                         struct klinux_pollfd *output) {
+  if (!input || !output) return false;
+  if (kPollfdMatchesKernel) {
+    memcpy(output, input, count * sizeof(struct pollfd));
+    return true;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    output[i].klinux_fd = input[i].fd;
+    output[i].klinux_events = TokLinuxPollEvent(input[i].events);
+    output[i].klinux_revents = TokLinuxPollEvent(input[i].revents);
+  }
+  return true;
+}
+
+bool FromkLinuxPollfdArray(const struct klinux_pollfd *input, size_t count,
+                           struct pollfd *output) {
+  if (!input || !output) return false;
+  if (kPollfdMatchesKernel) {
+    memcpy(output, input, count * sizeof(struct pollfd));
+    return true;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    output[i].fd = input[i].klinux_fd;
+    output[i].events = FromkLinuxPollEvent(input[i].klinux_events);
+    output[i].revents = FromkLinuxPollEvent(input[i].klinux_revents);
+  }
+  return true;
+}
+
 bool TokLinuxEpollEvent(const struct epoll_event *input,
                         struct klinux_epoll_event *output) {
   if (!input || !output) return false;
@@ -712,6 +767,27 @@ bool FromkLinuxEpollEvent(const struct klinux_epoll_event *input,
   return true;
 }
 
+bool FromkLinuxEpollEventArray(const struct klinux_epoll_event *input,
+                               size_t count, struct epoll_event *output) {
+  if (!input || !output) return false;
+  if (kEpollEventMatchesKernel) {
+    if (static_cast<const void *>(input) != output) {
+      memmove(output, input, count * sizeof(struct epoll_event));
+    }
+    return true;
+  }
+  // Convert back to front: when converting in place, enclave event i never
+  // overlaps kernel events before i, which are still to be read.
+  for (size_t i = count; i > 0; --i) {
+    struct klinux_epoll_event klinux_event;
+    memcpy(&klinux_event, &input[i - 1], sizeof(klinux_event));
+    if (!FromkLinuxEpollEvent(&klinux_event, &output[i - 1])) {
+      return false;
+    }
+  }
+  return true;
+}
+
 bool FromkLinuxRusage(const struct klinux_rusage *input,
                       struct rusage *output) {
   if (!input || !output) {
@@ -162,6 +162,18 @@ bool TokLinuxPollfd(const struct pollfd *input, struct klinux_pollfd *output);
 // poll event counterparts.
 bool FromkLinuxPollfd(const struct klinux_pollfd *input, struct pollfd *output);
 
+// Converts |count| enclave based pollfd structs in |input| to kernel based
+// pollfd structs in |output|. Copies the array as is if both structs have the
+// same layout and all poll events have the same value in both.
+bool TokLinuxPollfdArray(const struct pollfd *input, size_t count,
+                         struct klinux_pollfd *output);
+
+// Converts |count| kernel based pollfd structs in |input| to enclave based
+// pollfd structs in |output|. Copies the array as is if both structs have the
+// same layout and all poll events have the same value in both.
+bool FromkLinuxPollfdArray(const struct klinux_pollfd *input, size_t count,
+                           struct pollfd *output);
+
 // Converts an enclave based sigset to a kernel based sigset.
 bool TokLinuxSigset(const sigset_t *input, klinux_sigset_t *output);
 
@@ -176,6 +188,14 @@ bool TokLinuxEpollEvent(const struct epoll_event *input,
 bool FromkLinuxEpollEvent(const struct klinux_epoll_event *input,
                           struct epoll_event *output);
 
+// Converts |count| kernel based epoll events in |input| to enclave based epoll
+// events in |output|. Copies the array as is if both structs have the same
+// layout and all epoll events have the same value in both. |input| may point
+// to the same memory as |output|, since kernel epoll events are no larger than
+// enclave epoll events.
+bool FromkLinuxEpollEventArray(const struct klinux_epoll_event *input,
+                               size_t count, struct epoll_event *output);
+
 // Converts a kernel based rusage to an enclave based rusage.
 bool FromkLinuxRusage(const struct klinux_rusage *input, struct rusage *output);
 
@@ -23,6 +23,8 @@
 #include <sys/un.h>
 #include <sys/utsname.h>
 
+#include <cstring>
+
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
@@ -299,6 +301,47 @@ TEST(ManualTypesFunctionsTest, FromPollFdTest) {
   EXPECT_THAT(poll_fd.revents, Eq(POLLOUT));
 }
 
+TEST(ManualTypesFunctionsTest, PollFdArrayTest) {
+  struct pollfd poll_fds[3] = {
+      {1, POLLIN, 0}, {2, POLLOUT, POLLHUP}, {3, POLLIN | POLLPRI, POLLERR}};
+  struct klinux_pollfd klinux_poll_fds[3] = {};
+
+  EXPECT_THAT(TokLinuxPollfdArray(poll_fds, 3, klinux_poll_fds), Eq(true));
+  for (int i = 0; i < 3; ++i) {
+    struct klinux_pollfd expected {};
+    ASSERT_THAT(TokLinuxPollfd(&poll_fds[i], &expected), Eq(true));
+    EXPECT_THAT(klinux_poll_fds[i].klinux_fd, Eq(expected.klinux_fd));
+    EXPECT_THAT(klinux_poll_fds[i].klinux_events, Eq(expected.klinux_events));
+    EXPECT_THAT(klinux_poll_fds[i].klinux_revents,
+                Eq(expected.klinux_revents));
+  }
+
+  struct pollfd round_trip[3] = {};
+  EXPECT_THAT(FromkLinuxPollfdArray(klinux_poll_fds, 3, round_trip), Eq(true));
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_THAT(round_trip[i].fd, Eq(poll_fds[i].fd));
+    EXPECT_THAT(round_trip[i].events, Eq(poll_fds[i].events));
+    EXPECT_THAT(round_trip[i].revents, Eq(poll_fds[i].revents));
+  }
+}
+
+TEST(ManualTypesFunctionsTest, EpollEventArrayInPlaceTest) {
+  struct epoll_event events[3] = {};
+  auto klinux_events = reinterpret_cast<struct klinux_epoll_event *>(events);
+  for (int i = 0; i < 3; ++i) {
+    struct klinux_epoll_event klinux_event {};
+    klinux_event.events = kLinux_EPOLLIN | kLinux_EPOLLET;
+    klinux_event.data.u64 = 100 + i;
+    memcpy(&klinux_events[i], &klinux_event, sizeof(klinux_event));
+  }
+
+  EXPECT_THAT(FromkLinuxEpollEventArray(klinux_events, 3, events), Eq(true));
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_THAT(events[i].events, Eq(EPOLLIN | EPOLLET));
+    EXPECT_THAT(events[i].data.u64, Eq(100 + i));
+  }
+}
+
 TEST(ManualTypesFunctionsTest, UtsnameTest) {
   const char *sysname = "abc";
   const char *nodename = "def";
@@ -189,6 +189,31 @@ std::string GetStructConversionsFuncBody(
   return os.str();
 }
 
+// Generates the declaration of a constant that is true if every value of a
+// multi-valued enum is the same in the enclave and the kernel, in which case
+// the conversions of the enum leave any combination of its values unchanged.
+// Returns an empty string for enums whose conversions may change their input
+// whatever the values.
+std::string GetEnumIdentityDeclaration(const std::string &enum_name,
+                                       const EnumProperties &enum_properties) {
+  if (!enum_properties.multi_valued ||
+      enum_properties.wrap_macros_with_if_defined ||
+      enum_properties.default_value_host != 0 ||
+      enum_properties.default_value_enclave != 0) {
+    return "";
+  }
+  std::ostringstream os;
+  os << "constexpr bool k" << enum_name << "MatchesKernel =";
+  for (const auto &enum_pair : enum_properties.values) {
+    // Compare as integers, since the enclave value may itself be an enum.
+    os << "\n    static_cast<int64_t>(" << enum_pair.first
+       << ") == static_cast<int64_t>(" << klinux_prefix << "_"
+       << enum_pair.first << ") &&";
+  }
+  os << "\n    true;\n";
+  return os.str();
+}
+
 // Generate and write enum conversion function declarations and definitions to
 // provided output streams for .h and .cc files.
 void WriteEnumConversions(
@@ -218,6 +243,13 @@ void WriteEnumConversions(
     *os_h << "\n" << to_prefix_decl << "; \n";
     *os_h << "\n" << from_prefix_decl << "; \n";
 
+    // Write the identity check to the header file, so that bulk conversions
+    // can copy arrays of types holding the enum as is.
+    std::string identity_decl = GetEnumIdentityDeclaration(it.first, it.second);
+    if (!identity_decl.empty()) {
+      *os_h << "\n" << identity_decl;
+    }
+
     // Write the function body to the cc file.
     if (it.second.multi_valued) {
       *os_cc << "\n"
@@ -26,14 +26,49 @@
 #include <memory>
 #include <vector>
 
+#include "asylo/platform/system_call/compact_message.h"
 #include "asylo/platform/system_call/metadata.h"
 #include "asylo/platform/system_call/serialize.h"
+#include "asylo/util/status_macros.h"
 
 namespace asylo {
 namespace system_call {
+namespace {
+
+// Invokes a system call from a request in the compact encoding.
+primitives::PrimitiveStatus CompactUntrustedInvoke(
+    primitives::Extent request, primitives::Extent *response) {
+  const CompactLayout *layout;
+  std::array<uint64_t, kParameterMax> params;
+  std::array<size_t, kParameterMax> sizes;
+  ASYLO_RETURN_IF_ERROR(
+      DeserializeCompactRequest(request, &layout, &params, &sizes));
+
+  // Allocate storage for the results.
+  std::vector<std::unique_ptr<char[]>> output_buffers;
+  for (int i = 0; i < layout->parameter_count; i++) {
+    if (layout->parameters[i].kind == kCompactOutBuffer && sizes[i] > 0) {
+      output_buffers.emplace_back(new char[sizes[i]]());
+      params[i] = reinterpret_cast<uint64_t>(output_buffers.back().get());
+    }
+  }
+
+  // Invoke the native system call.
+  uint64_t result = syscall(layout->sysno, params[0], params[1], params[2],
+                            params[3], params[4], params[5]);
+
+  // Build the response message.
+  return SerializeCompactResponse(*layout, params, result, errno, response);
+}
+
+}  // namespace
 
 primitives::PrimitiveStatus UntrustedInvoke(primitives::Extent request,
                                             primitives::Extent *response) {
+  if (IsCompactMessage(request)) {
+    return CompactUntrustedInvoke(request, response);
+  }
+
   MessageReader reader(request);
   SystemCallDescriptor descriptor(reader.sysno());
 
@@ -35,6 +35,72 @@
 #define ENCLAVE_STORAGE_SET_KEY (ENCLAVE_STORAGE_IOCTL_TYPE | 0x00000001)
 #endif
 
+// IOCTL to select the block length of a newly created secure file. The
+// argument points to a uint32_t holding a power of two between 128 bytes and
+// 64KiB. Must be issued before ENCLAVE_STORAGE_SET_KEY; existing files keep the
+// block length recorded in their header, or 128 bytes if they were written
+// before it was recorded.
+#ifndef ENCLAVE_STORAGE_SET_BLOCK_LENGTH
+#define ENCLAVE_STORAGE_SET_BLOCK_LENGTH \
+  (ENCLAVE_STORAGE_IOCTL_TYPE | 0x00000002)
+#endif
+
+// IOCTL to defer updates of the digest of a secure file. The argument points
+// to a uint64_t holding the number of bytes which may be written before the
+// digest is persisted, or 0 to persist it on every write, which is the default.
+// A deferred update is also persisted by fsync and close. If the enclave stops
+// before that, appended blocks are lost and reads of a rewritten block fail
+// verification.
+#ifndef ENCLAVE_STORAGE_SET_DIGEST_WRITE_BACK
+#define ENCLAVE_STORAGE_SET_DIGEST_WRITE_BACK \
+  (ENCLAVE_STORAGE_IOCTL_TYPE | 0x00000003)
+#endif
+
+// IOCTL to buffer writes to a secure file descriptor in trusted memory. The
+// argument points to a uint64_t holding the capacity of the buffer, at most
+// 16MiB, or 0 to disable buffering, which is the default. Writes which continue
+// where the previous one ended are coalesced and encrypted together once the
+// buffer fills up, or when the descriptor is used for anything else. A failure
+// to write buffered data is reported by the operation which flushes it, and
+// the data is lost. Other descriptors of the file only see buffered data once
+// it is flushed.
+#ifndef ENCLAVE_STORAGE_SET_WRITE_BUFFER
+#define ENCLAVE_STORAGE_SET_WRITE_BUFFER \
+  (ENCLAVE_STORAGE_IOCTL_TYPE | 0x00000004)
+#endif
+
+// IOCTL to read ahead of the reader of a secure file descriptor. The argument
+// points to a uint64_t holding the number of bytes read and decrypted at once,
+// at most 16MiB, or 0 to disable read-ahead, which is the default. Reads are
+// served from data read ahead until it is used up or the descriptor is used
+// for anything else, so they do not see writes through other descriptors of
+// the file in the meantime.
+#ifndef ENCLAVE_STORAGE_SET_READ_AHEAD
+#define ENCLAVE_STORAGE_SET_READ_AHEAD (ENCLAVE_STORAGE_IOCTL_TYPE | 0x00000005)
+#endif
+
+// IOCTL to select where the Merkle tree of a newly created secure file is kept.
+// The argument points to a uint32_t holding ENCLAVE_STORAGE_MERKLE_TREE_FILE,
+// the default, to keep the tree in a host file next to the secure file, or
+// ENCLAVE_STORAGE_MERKLE_TREE_IN_MEMORY to keep it in trusted memory only and
+// rebuild it from the whole file whenever the file is opened. Must be issued
+// before ENCLAVE_STORAGE_SET_KEY; existing files keep the selection recorded in
+// their header. Files written before the selection was recorded keep their
+// tree in memory.
+#ifndef ENCLAVE_STORAGE_SET_MERKLE_TREE_STORAGE
+#define ENCLAVE_STORAGE_SET_MERKLE_TREE_STORAGE \
+  (ENCLAVE_STORAGE_IOCTL_TYPE | 0x00000006)
+#endif
+
+#define ENCLAVE_STORAGE_MERKLE_TREE_FILE 0
+#define ENCLAVE_STORAGE_MERKLE_TREE_IN_MEMORY 1
+
+// Suffix appended to the path of a secure file to name the host file holding
+// its Merkle tree. unlink() and rename() of a path in the enclave apply to the
+// Merkle tree file as well, and a secure file whose Merkle tree file is
+// missing rebuilds it when it is opened.
+#define ENCLAVE_STORAGE_MERKLE_TREE_FILE_SUFFIX ".merkle"
+
 struct key_info {
   uint32_t length;
   uint8_t *data;
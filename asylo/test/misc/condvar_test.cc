@@ -228,6 +228,68 @@ TEST_F(BroadcastTest, Broadcast) {
   ASSERT_EQ(pthread_cond_destroy(&broadcast_cv_), 0);
 }
 
+// This test releases a group of threads with a broadcast sent while holding
+// the mutex, over several rounds. The broadcast can wake at most one waiter
+// directly, since the others still need the mutex, so this checks that the
+// remaining waiters are handed the mutex one after another as it is released.
+class BroadcastUnderMutexTest : public ::testing::Test {
+ protected:
+  static constexpr int kNumThreads = 8;
+  static constexpr int kNumRounds = 50;
+
+  void WaitForRounds() {
+    CHECK_EQ(pthread_mutex_lock(&mu_), 0);
+    for (int round = 0; round < kNumRounds; ++round) {
+      num_waiting_++;
+      CHECK_EQ(pthread_cond_signal(&waiting_cv_), 0);
+      int generation = generation_;
+      while (generation_ == generation) {
+        CHECK_EQ(pthread_cond_wait(&broadcast_cv_, &mu_), 0);
+      }
+    }
+    CHECK_EQ(pthread_mutex_unlock(&mu_), 0);
+  }
+
+  static void *WaitForRoundsTrampoline(void *arg) {
+    BroadcastUnderMutexTest *test = static_cast<BroadcastUnderMutexTest *>(arg);
+    CHECK(test != nullptr) << "Corrupt test pointer";
+    test->WaitForRounds();
+    return nullptr;
+  }
+
+  // Number of threads waiting for the current round to end.
+  volatile int num_waiting_ = 0;
+
+  // Incremented at the end of each round.
+  volatile int generation_ = 0;
+
+  pthread_mutex_t mu_ = PTHREAD_MUTEX_INITIALIZER;
+  pthread_cond_t broadcast_cv_ = PTHREAD_COND_INITIALIZER;
+  pthread_cond_t waiting_cv_ = PTHREAD_COND_INITIALIZER;
+};
+
+TEST_F(BroadcastUnderMutexTest, AllWaitersWake) {
+  std::vector<pthread_t> threads;
+  ASYLO_ASSERT_OK(
+      LaunchThreads(kNumThreads, WaitForRoundsTrampoline, this, &threads));
+
+  ASSERT_EQ(pthread_mutex_lock(&mu_), 0);
+  for (int round = 0; round < kNumRounds; ++round) {
+    while (num_waiting_ != kNumThreads) {
+      ASSERT_EQ(pthread_cond_wait(&waiting_cv_, &mu_), 0);
+    }
+    num_waiting_ = 0;
+    generation_++;
+    ASSERT_EQ(pthread_cond_broadcast(&broadcast_cv_), 0);
+  }
+  ASSERT_EQ(pthread_mutex_unlock(&mu_), 0);
+  ASYLO_ASSERT_OK(JoinThreads(threads));
+
+  ASSERT_EQ(pthread_mutex_destroy(&mu_), 0);
+  ASSERT_EQ(pthread_cond_destroy(&broadcast_cv_), 0);
+  ASSERT_EQ(pthread_cond_destroy(&waiting_cv_), 0);
+}
+
 TEST(EnclaveCondVar, Timeout) {
   constexpr int kDeadlineSeconds = 3;
 
@@ -0,0 +1,330 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <sys/syscall.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "asylo/client.h"
+#include "asylo/enclave.pb.h"
+#include "asylo/grpc/auth/enclave_channel_credentials.h"
+#include "asylo/grpc/auth/null_credentials_options.h"
+#include "asylo/identity/init.h"
+#include "asylo/platform/core/generic_enclave_client.h"
+#include "asylo/platform/host_call/exit_handler_constants.h"
+#include "asylo/platform/primitives/sgx/loader.pb.h"
+#include "asylo/platform/primitives/sgx/untrusted_sgx.h"
+#include "asylo/platform/primitives/util/exit_profile.h"
+#include "asylo/test/grpc/service.grpc.pb.h"
+#include "asylo/test/misc/request_overhead_benchmark.pb.h"
+#include "asylo/test/util/enclave_assertion_authority_configs.h"
+#include "asylo/test/util/test_flags.h"
+#include "asylo/util/status.h"
+#include "asylo/util/status_macros.h"
+#include "asylo/util/statusor.h"
+#include "include/grpcpp/grpcpp.h"
+
+ABSL_FLAG(std::string, enclave_path, "",
+          "Path to the request overhead benchmark enclave");
+
+ABSL_FLAG(bool, binary_logging, true,
+          "Whether the enclave logs in binary rather than as text");
+
+namespace asylo {
+namespace {
+
+constexpr char kEnclaveName[] = "/request_overhead_benchmark";
+
+constexpr absl::Duration kConnectTimeout = absl::Seconds(10);
+
+// The loaded benchmark enclave.
+struct BenchmarkEnclave {
+  EnclaveClient *client;
+
+  // Profiler of the exits of the enclave.
+  const primitives::ExitProfiler *exit_profiler;
+
+  // Address of the gRPC server of the enclave.
+  std::string server_address;
+};
+
+// Enters the enclave, and returns the time spent in each layer by the requests
+// handled since the previous entry. The first entry starts the server.
+StatusOr<RequestOverheadBenchmarkOutput> TakeLayerTimes(
+    EnclaveClient *client) {
+  EnclaveInput input;
+  input.MutableExtension(request_overhead_benchmark_input)
+      ->set_data_directory(absl::GetFlag(FLAGS_test_tmpdir));
+  EnclaveOutput output;
+  ASYLO_RETURN_IF_ERROR(client->EnterAndRun(input, &output));
+  return output.GetExtension(request_overhead_benchmark_output);
+}
+
+StatusOr<BenchmarkEnclave> LoadBenchmarkEnclave() {
+  std::vector<EnclaveAssertionAuthorityConfig> authority_configs = {
+      GetNullAssertionAuthorityTestConfig(),
+  };
+  ASYLO_RETURN_IF_ERROR(InitializeEnclaveAssertionAuthorities(
+      authority_configs.cbegin(), authority_configs.cend()));
+
+  EnclaveManager::Configure(EnclaveManagerOptions());
+  EnclaveManager *manager;
+  ASYLO_ASSIGN_OR_RETURN(manager, EnclaveManager::Instance());
+
+  std::string tmpdir = absl::GetFlag(FLAGS_test_tmpdir);
+  EnclaveLoadConfig load_config;
+  load_config.set_name(kEnclaveName);
+  // Profiling the exits also makes their profile available to the driver.
+  load_config.set_exit_profile_path(absl::StrCat(tmpdir, "/exit_profile"));
+  EnclaveConfig *config = load_config.mutable_config();
+  *config->add_enclave_assertion_authority_configs() =
+      GetNullAssertionAuthorityTestConfig();
+  config->set_enable_contention_profiling(true);
+  config->mutable_logging_config()->set_log_directory(tmpdir);
+  config->mutable_logging_config()->set_binary_logging(
+      absl::GetFlag(FLAGS_binary_logging));
+  SgxLoadConfig sgx_config;
+  sgx_config.mutable_file_enclave_config()->set_enclave_path(
+      absl::GetFlag(FLAGS_enclave_path));
+  sgx_config.set_debug(true);
+  *load_config.MutableExtension(sgx_load_config) = sgx_config;
+  ASYLO_RETURN_IF_ERROR(manager->LoadEnclave(load_config));
+
+  BenchmarkEnclave enclave;
+  enclave.client = manager->GetClient(kEnclaveName);
+  enclave.exit_profiler =
+      std::static_pointer_cast<primitives::SgxEnclaveClient>(
+          static_cast<GenericEnclaveClient *>(enclave.client)
+              ->GetPrimitiveClient())
+          ->exit_profiler();
+  RequestOverheadBenchmarkOutput output;
+  ASYLO_ASSIGN_OR_RETURN(output, TakeLayerTimes(enclave.client));
+  enclave.server_address = output.server_address();
+  return enclave;
+}
+
+// Loads the benchmark enclave on first use and returns it.
+StatusOr<const BenchmarkEnclave *> GetBenchmarkEnclave() {
+  static StatusOr<const BenchmarkEnclave *> *enclave = [] {
+    StatusOr<BenchmarkEnclave> enclave_result = LoadBenchmarkEnclave();
+    if (!enclave_result.ok()) {
+      return new StatusOr<const BenchmarkEnclave *>(enclave_result.status());
+    }
+    return new StatusOr<const BenchmarkEnclave *>(
+        new BenchmarkEnclave(std::move(enclave_result).ValueOrDie()));
+  }();
+  return *enclave;
+}
+
+// Returns whether exits with |key| block waiting for an event or a timeout,
+// like those of idle gRPC pollers, rather than do work for a request.
+bool IsBlockingExit(const primitives::ExitCallKey &key) {
+  switch (key.selector) {
+    case host_call::kSysFutexWaitHandler:
+    case host_call::kSleepHandler:
+    case host_call::kUSleepHandler:
+      return true;
+    case host_call::kSystemCallHandler:
+      switch (key.sub_key) {
+        case SYS_epoll_pwait:
+        case SYS_epoll_wait:
+        case SYS_futex:
+        case SYS_nanosleep:
+        case SYS_clock_nanosleep:
+        case SYS_poll:
+        case SYS_ppoll:
+        case SYS_pselect6:
+        case SYS_select:
+          return true;
+        default:
+          return false;
+      }
+    default:
+      return false;
+  }
+}
+
+// Exits of the enclave, split into blocking exits and the others.
+struct ExitTotals {
+  uint64_t exits = 0;
+  int64_t exit_nanos = 0;
+  uint64_t blocking_exits = 0;
+};
+
+ExitTotals SumExits(const primitives::ExitProfile &profile) {
+  ExitTotals totals;
+  for (const auto &entry : profile) {
+    if (IsBlockingExit(entry.first)) {
+      totals.blocking_exits += entry.second.count;
+    } else {
+      totals.exits += entry.second.count;
+      totals.exit_nanos += entry.second.total_latency_nanos;
+    }
+  }
+  return totals;
+}
+
+// Opens a channel to |address| over EKEP with null assertions and waits for it
+// to connect. The channel does not share connections with other channels, so
+// that every channel performs its own handshake. Returns nullptr if the
+// channel failed to connect.
+std::shared_ptr<::grpc::Channel> Connect(const std::string &address) {
+  ::grpc::ChannelArguments args;
+  args.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+  std::shared_ptr<::grpc::Channel> channel = ::grpc::CreateCustomChannel(
+      address,
+      EnclaveChannelCredentials(BidirectionalNullCredentialsOptions()), args);
+  if (!channel->WaitForConnected(
+          absl::ToChronoTime(absl::Now() + kConnectTimeout))) {
+    return nullptr;
+  }
+  return channel;
+}
+
+// Sends one request per iteration to the gRPC server of the enclave, over a
+// channel connected beforehand, or over a new channel per request if
+// state.range(0) is 1. Every request reads a secure file, updates and seals the
+// enclave state and logs. Reports, in microseconds per request:
+//  * handler_us: time spent in the request handler inside the enclave, of
+//    which marshalling_us, crypto_us, storage_us and logging_us were spent in
+//    each layer,
+//  * locks_us: time enclave threads waited for contended locks,
+//  * exits_us: time spent in exits that do not block, of which exits counts
+//    the number, and
+//  * handshake_us: time to establish new channels, which includes the EKEP
+//    handshake.
+// The layers timed inside the enclave include their own exits, so exits_us
+// overlaps storage_us and logging_us. The remainder of exits_us is mostly the
+// socket I/O of gRPC, and the remainder of the wall time is spent in gRPC and
+// the client. Exits that block, such as those of idle pollers, are left out of
+// exits_us and counted in blocking_exits.
+void BM_Request(benchmark::State &state) {
+  StatusOr<const BenchmarkEnclave *> enclave_result = GetBenchmarkEnclave();
+  if (!enclave_result.ok()) {
+    state.SkipWithError(enclave_result.status().ToString().c_str());
+    return;
+  }
+  const BenchmarkEnclave *enclave = enclave_result.ValueOrDie();
+  if (!enclave->exit_profiler) {
+    state.SkipWithError("Exits of the enclave are not profiled");
+    return;
+  }
+
+  bool new_channel = state.range(0) != 0;
+  std::shared_ptr<::grpc::Channel> channel;
+  if (!new_channel) {
+    channel = Connect(enclave->server_address);
+    if (!channel) {
+      state.SkipWithError("Failed to connect to the enclave");
+      return;
+    }
+  }
+
+  // Leave out the work done by the enclave before the first iteration.
+  Status status = TakeLayerTimes(enclave->client).status();
+  if (!status.ok()) {
+    state.SkipWithError(status.ToString().c_str());
+    return;
+  }
+  ExitTotals exits_before = SumExits(enclave->exit_profiler->Snapshot());
+
+  absl::Duration handshake = absl::ZeroDuration();
+  test::HelloRequest request;
+  request.set_name("benchmark");
+  for (auto _ : state) {
+    if (new_channel) {
+      absl::Time start = absl::Now();
+      channel = Connect(enclave->server_address);
+      if (!channel) {
+        state.SkipWithError("Failed to connect to the enclave");
+        return;
+      }
+      handshake += absl::Now() - start;
+    }
+    std::unique_ptr<test::Messenger1::Stub> stub =
+        test::Messenger1::NewStub(channel);
+    ::grpc::ClientContext context;
+    test::HelloResponse response;
+    ::grpc::Status rpc_status = stub->Hello(&context, request, &response);
+    if (!rpc_status.ok()) {
+      state.SkipWithError(rpc_status.error_message().c_str());
+      return;
+    }
+  }
+
+  ExitTotals exits_after = SumExits(enclave->exit_profiler->Snapshot());
+  StatusOr<RequestOverheadBenchmarkOutput> output_result =
+      TakeLayerTimes(enclave->client);
+  if (!output_result.ok()) {
+    state.SkipWithError(output_result.status().ToString().c_str());
+    return;
+  }
+  const RequestOverheadBenchmarkOutput &output = output_result.ValueOrDie();
+  if (output.requests() != static_cast<uint64_t>(state.iterations())) {
+    state.SkipWithError("The enclave handled an unexpected number of requests");
+    return;
+  }
+
+  auto per_request_micros = [](double nanos) {
+    return benchmark::Counter(nanos / 1000, benchmark::Counter::kAvgIterations);
+  };
+  state.counters["handler_us"] = per_request_micros(output.handler_ns());
+  state.counters["marshalling_us"] =
+      per_request_micros(output.marshalling_ns());
+  state.counters["crypto_us"] = per_request_micros(output.crypto_ns());
+  state.counters["storage_us"] = per_request_micros(output.storage_ns());
+  state.counters["logging_us"] = per_request_micros(output.logging_ns());
+  state.counters["locks_us"] = per_request_micros(output.lock_wait_ns());
+  state.counters["exits_us"] =
+      per_request_micros(exits_after.exit_nanos - exits_before.exit_nanos);
+  state.counters["exits"] = benchmark::Counter(
+      exits_after.exits - exits_before.exits,
+      benchmark::Counter::kAvgIterations);
+  state.counters["blocking_exits"] = benchmark::Counter(
+      exits_after.blocking_exits - exits_before.blocking_exits,
+      benchmark::Counter::kAvgIterations);
+  if (new_channel) {
+    state.counters["handshake_us"] =
+        per_request_micros(absl::ToDoubleNanoseconds(handshake));
+  }
+}
+
+BENCHMARK(BM_Request)
+    ->ArgName("new_channel")
+    ->Arg(0)
+    ->Arg(1)
+    ->Unit(benchmark::kMicrosecond);
+
+}  // namespace
+}  // namespace asylo
+
+int main(int argc, char *argv[]) {
+  benchmark::Initialize(&argc, argv);
+  absl::ParseCommandLine(argc, argv);
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
@@ -0,0 +1,355 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <fcntl.h>
+#include <openssl/rand.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "asylo/grpc/auth/enclave_server_credentials.h"
+#include "asylo/grpc/auth/null_credentials_options.h"
+#include "asylo/identity/sealing/sealed_secret.pb.h"
+#include "asylo/identity/sealing/sgx/sgx_local_secret_sealer.h"
+#include "asylo/platform/core/contention_profiler.h"
+#include "asylo/secure_storage.h"
+#include "asylo/test/grpc/service.grpc.pb.h"
+#include "asylo/test/misc/request_overhead_benchmark.pb.h"
+#include "asylo/trusted_application.h"
+#include "asylo/util/binary_log.h"
+#include "asylo/util/cleansing_types.h"
+#include "asylo/util/posix_error_space.h"
+#include "asylo/util/status.h"
+#include "asylo/util/status_macros.h"
+#include "asylo/util/statusor.h"
+#include "include/grpcpp/server.h"
+#include "include/grpcpp/server_builder.h"
+
+namespace asylo {
+namespace {
+
+constexpr char kServerHost[] = "127.0.0.1";
+
+// Size of the secure file read by the requests, and of the block each of them
+// reads.
+constexpr size_t kSecureFileSize = 1 << 20;
+constexpr size_t kBlockSize = 4096;
+
+constexpr size_t kKeyLength = 32;
+
+constexpr int64_t kNanoSecondsPerSecond = 1000000000;
+
+int64_t MonotonicNanos() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * kNanoSecondsPerSecond + ts.tv_nsec;
+}
+
+Status PosixErrorStatus(absl::string_view what) {
+  return Status(static_cast<error::PosixError>(errno),
+                absl::StrCat(what, ": ", strerror(errno)));
+}
+
+// Creates a secure file of kSecureFileSize random bytes at |path|, and returns
+// a file descriptor to read it.
+StatusOr<int> CreateSecureFile(const std::string &path) {
+  // Also removes the Merkle tree file of a secure file left at |path|.
+  unlink(path.c_str());
+  int fd = open(path.c_str(), O_CREAT | O_RDWR | O_SECURE, 0644);
+  if (fd < 0) {
+    return PosixErrorStatus(absl::StrCat("Cannot open ", path));
+  }
+  CleansingVector<uint8_t> key(kKeyLength);
+  RAND_bytes(key.data(), key.size());
+  struct key_info key_param;
+  key_param.length = key.size();
+  key_param.data = key.data();
+  if (ioctl(fd, ENCLAVE_STORAGE_SET_KEY, &key_param) != 0) {
+    Status status = PosixErrorStatus("Cannot set the secure file key");
+    close(fd);
+    return status;
+  }
+  std::vector<uint8_t> data(kSecureFileSize);
+  RAND_bytes(data.data(), data.size());
+  if (write(fd, data.data(), data.size()) !=
+      static_cast<ssize_t>(data.size())) {
+    Status status = PosixErrorStatus("Cannot write the secure file");
+    close(fd);
+    return status;
+  }
+  return fd;
+}
+
+// Time spent in each layer by request handlers.
+struct LayerTimes {
+  uint64_t requests = 0;
+  int64_t handler_ns = 0;
+  int64_t marshalling_ns = 0;
+  int64_t crypto_ns = 0;
+  int64_t storage_ns = 0;
+  int64_t logging_ns = 0;
+};
+
+// Messenger1 service whose requests each do the work of a typical stateful
+// enclave request: reading a block of a secure file, updating the enclave
+// state and writing it sealed to a host file, and logging a few messages. The
+// time spent in each of these is accumulated per layer.
+class RequestOverheadService final : public test::Messenger1::Service {
+ public:
+  RequestOverheadService(int secure_fd, int state_fd,
+                         std::unique_ptr<SecretSealer> sealer,
+                         SealedSecretHeader header)
+      : secure_fd_(secure_fd),
+        state_fd_(state_fd),
+        sealer_(std::move(sealer)),
+        header_(std::move(header)),
+        next_block_(0) {}
+
+  ~RequestOverheadService() override {
+    close(secure_fd_);
+    close(state_fd_);
+  }
+
+  // Returns the time spent in each layer by the requests handled since the
+  // previous call.
+  LayerTimes TakeLayerTimes() {
+    absl::MutexLock lock(&times_mu_);
+    LayerTimes times = times_;
+    times_ = LayerTimes();
+    return times;
+  }
+
+ private:
+  ::grpc::Status Hello(::grpc::ServerContext *context,
+                       const test::HelloRequest *request,
+                       test::HelloResponse *response) override {
+    int64_t handler_start = MonotonicNanos();
+    LayerTimes times;
+    times.requests = 1;
+
+    int64_t start = MonotonicNanos();
+    std::string block(kBlockSize, '\0');
+    off_t offset =
+        (next_block_++ % (kSecureFileSize / kBlockSize)) * kBlockSize;
+    ssize_t read_size = pread(secure_fd_, &block[0], block.size(), offset);
+    times.storage_ns += MonotonicNanos() - start;
+    if (read_size != static_cast<ssize_t>(block.size())) {
+      return ::grpc::Status(::grpc::StatusCode::INTERNAL,
+                            "Cannot read the secure file");
+    }
+
+    start = MonotonicNanos();
+    BLOG(INFO, "Read block at {} for {}", static_cast<int64_t>(offset),
+         request->name());
+    times.logging_ns += MonotonicNanos() - start;
+
+    uint64_t requests;
+    {
+      absl::MutexLock lock(&state_mu_);
+      state_.set_requests(state_.requests() + 1);
+      state_.set_last_name(request->name());
+      state_.set_last_block(block);
+      requests = state_.requests();
+
+      start = MonotonicNanos();
+      std::string serialized_state;
+      state_.SerializeToString(&serialized_state);
+      times.marshalling_ns += MonotonicNanos() - start;
+
+      start = MonotonicNanos();
+      SealedSecret sealed_state;
+      Status status =
+          sealer_->Seal(header_, /*additional_authenticated_data=*/"",
+                        serialized_state, &sealed_state);
+      times.crypto_ns += MonotonicNanos() - start;
+      if (!status.ok()) {
+        return status.ToOtherStatus<::grpc::Status>();
+      }
+
+      start = MonotonicNanos();
+      std::string serialized_sealed_state;
+      sealed_state.SerializeToString(&serialized_sealed_state);
+      times.marshalling_ns += MonotonicNanos() - start;
+
+      start = MonotonicNanos();
+      bool written =
+          pwrite(state_fd_, serialized_sealed_state.data(),
+                 serialized_sealed_state.size(), /*offset=*/0) ==
+              static_cast<ssize_t>(serialized_sealed_state.size()) &&
+          ftruncate(state_fd_, serialized_sealed_state.size()) == 0;
+      times.storage_ns += MonotonicNanos() - start;
+      if (!written) {
+        return ::grpc::Status(::grpc::StatusCode::INTERNAL,
+                              "Cannot write the sealed state");
+      }
+    }
+
+    start = MonotonicNanos();
+    BLOG(INFO, "Sealed the state after {} requests", requests);
+    BLOG(INFO, "Answering {}", request->name());
+    times.logging_ns += MonotonicNanos() - start;
+
+    response->set_message(absl::StrCat("Hello ", request->name()));
+    times.handler_ns = MonotonicNanos() - handler_start;
+
+    absl::MutexLock lock(&times_mu_);
+    times_.requests += times.requests;
+    times_.handler_ns += times.handler_ns;
+    times_.marshalling_ns += times.marshalling_ns;
+    times_.crypto_ns += times.crypto_ns;
+    times_.storage_ns += times.storage_ns;
+    times_.logging_ns += times.logging_ns;
+    return ::grpc::Status::OK;
+  }
+
+  const int secure_fd_;
+  const int state_fd_;
+  const std::unique_ptr<SecretSealer> sealer_;
+  const SealedSecretHeader header_;
+
+  // Index of the next block of the secure file to read.
+  std::atomic<uint64_t> next_block_;
+
+  absl::Mutex state_mu_;
+  RequestOverheadBenchmarkState state_ ABSL_GUARDED_BY(state_mu_);
+
+  absl::Mutex times_mu_;
+  LayerTimes times_ ABSL_GUARDED_BY(times_mu_);
+};
+
+// Returns the time enclave threads waited for contended locks since the
+// previous call.
+int64_t TakeLockWaitNanos() {
+  ContentionProfile profile = GetContentionProfile();
+  ResetContentionProfile();
+  uint64_t wait_nanos = profile.untracked_wait_nanos;
+  for (const LockContentionStats &site : profile.sites) {
+    wait_nanos += site.total_wait_nanos;
+  }
+  return wait_nanos;
+}
+
+}  // namespace
+
+// Hosts a gRPC server over EKEP with null assertions, whose requests each read
+// a secure file, update and seal the enclave state, and log. The first entry
+// starts the server, and every entry reports the server address and the time
+// the requests handled since the previous entry spent in each layer.
+class RequestOverheadBenchmark : public TrustedApplication {
+ public:
+  Status Run(const EnclaveInput &input, EnclaveOutput *output) override {
+    if (!server_) {
+      ASYLO_RETURN_IF_ERROR(
+          StartServer(input.GetExtension(request_overhead_benchmark_input)
+                          .data_directory()));
+    }
+
+    LayerTimes times = service_->TakeLayerTimes();
+    RequestOverheadBenchmarkOutput *benchmark_output =
+        output->MutableExtension(request_overhead_benchmark_output);
+    benchmark_output->set_server_address(server_address_);
+    benchmark_output->set_requests(times.requests);
+    benchmark_output->set_handler_ns(times.handler_ns);
+    benchmark_output->set_marshalling_ns(times.marshalling_ns);
+    benchmark_output->set_crypto_ns(times.crypto_ns);
+    benchmark_output->set_storage_ns(times.storage_ns);
+    benchmark_output->set_logging_ns(times.logging_ns);
+    benchmark_output->set_lock_wait_ns(TakeLockWaitNanos());
+    return Status::OkStatus();
+  }
+
+  Status Finalize(const EnclaveFinal &final_input) override {
+    if (server_) {
+      server_->Shutdown();
+    }
+    return Status::OkStatus();
+  }
+
+ private:
+  Status StartServer(const std::string &data_directory) {
+    if (data_directory.empty()) {
+      return Status(error::GoogleError::INVALID_ARGUMENT,
+                    "The first entry must set the data directory");
+    }
+
+    int secure_fd;
+    ASYLO_ASSIGN_OR_RETURN(
+        secure_fd, CreateSecureFile(absl::StrCat(data_directory, "/data")));
+    std::string state_path = absl::StrCat(data_directory, "/sealed_state");
+    int state_fd = open(state_path.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (state_fd < 0) {
+      Status status =
+          PosixErrorStatus(absl::StrCat("Cannot open ", state_path));
+      close(secure_fd);
+      return status;
+    }
+
+    std::unique_ptr<SecretSealer> sealer =
+        SgxLocalSecretSealer::CreateMrenclaveSecretSealer();
+    SealedSecretHeader header;
+    header.set_secret_name("request_overhead_benchmark_state");
+    header.set_secret_version("1");
+    header.set_secret_purpose("Request overhead benchmark state");
+    Status status = sealer->SetDefaultHeader(&header);
+    if (!status.ok()) {
+      close(secure_fd);
+      close(state_fd);
+      return status;
+    }
+    service_ = absl::make_unique<RequestOverheadService>(
+        secure_fd, state_fd, std::move(sealer), std::move(header));
+
+    int port = 0;
+    ::grpc::ServerBuilder builder;
+    builder.AddListeningPort(
+        absl::StrCat(kServerHost, ":0"),
+        EnclaveServerCredentials(BidirectionalNullCredentialsOptions()), &port);
+    builder.RegisterService(service_.get());
+    server_ = builder.BuildAndStart();
+    if (!server_) {
+      return Status(error::GoogleError::INTERNAL,
+                    "Failed to start gRPC server");
+    }
+    server_address_ = absl::StrCat(kServerHost, ":", port);
+
+    // Leave out the lock waits of the setup.
+    ResetContentionProfile();
+    return Status::OkStatus();
+  }
+
+  std::unique_ptr<RequestOverheadService> service_;
+  std::unique_ptr<::grpc::Server> server_;
+  std::string server_address_;
+};
+
+TrustedApplication *BuildTrustedApplication() {
+  return new RequestOverheadBenchmark;
+}
+
+}  // namespace asylo
@@ -0,0 +1,125 @@
+#
+#
+# Copyright 2020 Asylo authors
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+#
+"""Compares request overhead benchmark results across commits.
+
+The request_overhead_benchmark target writes its results as JSON when passed
+--benchmark_format=json. This script reads one result file per commit and
+prints a table with one row per benchmark and layer, giving the wall time or
+the time spent in the layer per request, in microseconds, for every commit, and
+its change relative to the first commit listed, which serves as the baseline:
+
+  request_overhead_report before=before.json after=after.json
+"""
+
+import json
+import sys
+
+# Microseconds per time unit reported by Google Benchmark.
+_MICROSECONDS_PER_UNIT = {'ns': 1e-3, 'us': 1, 'ms': 1e3, 's': 1e6}
+
+# Suffix of the counters of the benchmark that are times per request, in
+# microseconds.
+_LAYER_SUFFIX = '_us'
+
+
+def load_results(results_json):
+  """Returns the wall time and the layer times of every benchmark run.
+
+  Args:
+    results_json: Contents of a Google Benchmark JSON output file.
+
+  Returns:
+    A dict from '<benchmark> <layer>' to microseconds per request, where layer
+    is 'wall' for the real time per iteration or the name of a counter of
+    layer time. Aggregates of repeated runs are left out, so that every row
+    compares single runs.
+  """
+  results = {}
+  for benchmark in json.loads(results_json)['benchmarks']:
+    if benchmark.get('run_type', 'iteration') != 'iteration':
+      continue
+    name = benchmark['name']
+    unit = _MICROSECONDS_PER_UNIT[benchmark.get('time_unit', 'ns')]
+    results['{} wall'.format(name)] = benchmark['real_time'] * unit
+    for key in sorted(benchmark):
+      if key.endswith(_LAYER_SUFFIX):
+        results['{} {}'.format(name, key[:-len(_LAYER_SUFFIX)])] = (
+            benchmark[key])
+  return results
+
+
+def format_report(results_by_commit):
+  """Formats a comparison of benchmark results.
+
+  Args:
+    results_by_commit: A list of (commit, results) pairs, as returned by
+      load_results(). The first commit is the baseline.
+
+  Returns:
+    The comparison table, as a string.
+  """
+  commits = [commit for commit, _ in results_by_commit]
+  baseline = results_by_commit[0][1]
+  names = []
+  for _, results in results_by_commit:
+    names.extend(name for name in results if name not in names)
+
+  header = ['benchmark layer'] + [
+      '{} us'.format(commit) if i == 0 else '{} us (%)'.format(commit)
+      for i, commit in enumerate(commits)
+  ]
+  rows = [header]
+  for name in names:
+    row = [name]
+    for i, (_, results) in enumerate(results_by_commit):
+      if name not in results:
+        row.append('-')
+      elif i == 0 or not baseline.get(name):
+        row.append('{:.1f}'.format(results[name]))
+      else:
+        row.append('{:.1f} ({:+.1f})'.format(
+            results[name], 100 * (results[name] / baseline[name] - 1)))
+    rows.append(row)
+
+  widths = [max(len(row[i]) for row in rows) for i in range(len(header))]
+  lines = []
+  for row in rows:
+    cells = [row[0].ljust(widths[0])]
+    cells.extend(cell.rjust(width) for cell, width in zip(row[1:], widths[1:]))
+    lines.append('  '.join(cells).rstrip())
+  return '\n'.join(lines) + '\n'
+
+
+def main(argv):
+  if len(argv) < 2:
+    sys.stderr.write(__doc__)
+    return 1
+  results_by_commit = []
+  for arg in argv[1:]:
+    commit, _, path = arg.partition('=')
+    if not path:
+      sys.stderr.write('Expected <commit>=<results.json>, got {}\n'.format(arg))
+      return 1
+    with open(path) as results_file:
+      results_by_commit.append((commit, load_results(results_file.read())))
+  sys.stdout.write(format_report(results_by_commit))
+  return 0
+
+
+if __name__ == '__main__':
+  sys.exit(main(sys.argv))
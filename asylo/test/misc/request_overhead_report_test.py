@@ -0,0 +1,66 @@
+#
+#
+# Copyright 2020 Asylo authors
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+"""Tests for request_overhead_report."""
+
+import json
+import unittest
+
+from asylo.test.misc import request_overhead_report
+
+
+def _results_json(*benchmarks):
+  return json.dumps({'context': {}, 'benchmarks': list(benchmarks)})
+
+
+class RequestOverheadReportTest(unittest.TestCase):
+
+  def test_load_results_reads_wall_and_layer_times(self):
+    results = request_overhead_report.load_results(
+        _results_json(
+            {'name': 'BM_Request/new_channel:0', 'real_time': 250,
+             'time_unit': 'us', 'storage_us': 40, 'crypto_us': 10,
+             'exits': 12},
+            {'name': 'BM_Request/new_channel:0_mean', 'real_time': 260,
+             'time_unit': 'us', 'run_type': 'aggregate'}))
+    self.assertEqual(results, {
+        'BM_Request/new_channel:0 wall': 250,
+        'BM_Request/new_channel:0 crypto': 10,
+        'BM_Request/new_channel:0 storage': 40,
+    })
+
+  def test_load_results_normalizes_units(self):
+    results = request_overhead_report.load_results(
+        _results_json({'name': 'BM_Request/new_channel:1', 'real_time': 2.5,
+                       'time_unit': 'ms'}))
+    self.assertEqual(results, {'BM_Request/new_channel:1 wall': 2500})
+
+  def test_format_report_compares_with_baseline(self):
+    report = request_overhead_report.format_report([
+        ('before', {'BM_A wall': 200, 'BM_A storage': 40}),
+        ('after', {'BM_A wall': 150, 'BM_A crypto': 10}),
+    ])
+    self.assertEqual(
+        report.splitlines(), [
+            'benchmark layer  before us   after us (%)',
+            'BM_A wall            200.0  150.0 (-25.0)',
+            'BM_A storage          40.0              -',
+            'BM_A crypto              -           10.0',
+        ])
+
+
+if __name__ == '__main__':
+  unittest.main()
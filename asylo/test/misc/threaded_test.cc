@@ -18,6 +18,7 @@
 
 #include <pthread.h>
 
+#include <cerrno>
 #include <cstdio>
 #include <thread>
 
@@ -58,6 +59,21 @@ void *cycle_all_locks(void *arg) {
   return nullptr;
 }
 
+static constexpr int kNumContendedIncrements = 20000;
+static pthread_mutex_t contended_lock = PTHREAD_MUTEX_INITIALIZER;
+static int contended_counter = 0;
+
+// Increment contended_counter many times in short critical sections, so that
+// threads both spin on and sleep on contended_lock.
+void *increment_contended_counter(void *arg) {
+  for (int i = 0; i < kNumContendedIncrements; i++) {
+    EXPECT_EQ(pthread_mutex_lock(&contended_lock), 0);
+    contended_counter = contended_counter + 1;
+    EXPECT_EQ(pthread_mutex_unlock(&contended_lock), 0);
+  }
+  return nullptr;
+}
+
 void once_function() { ++once_count; }
 
 // Acquire the lock guarding many_thread_counter, increment the counter,
@@ -222,6 +238,32 @@ TEST(ThreadedTest, PthreadMutexTest) {
   }
 }
 
+// Tests that a mutex under heavy contention admits one thread at a time.
+TEST(ThreadedTest, ContendedMutexTest) {
+  pthread_t threads[kNumThreads];
+  for (int i = 0; i < kNumThreads; i++) {
+    ASSERT_EQ(pthread_create(&threads[i], nullptr, increment_contended_counter,
+                             nullptr),
+              0);
+  }
+
+  for (int i = 0; i < kNumThreads; i++) {
+    EXPECT_EQ(pthread_join(threads[i], nullptr), 0);
+  }
+  EXPECT_EQ(contended_counter, kNumThreads * kNumContendedIncrements);
+}
+
+// Tests the error cases of locking and unlocking a mutex.
+TEST(ThreadedTest, MutexErrors) {
+  pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+  EXPECT_EQ(pthread_mutex_unlock(&mutex), EINVAL);
+  ASSERT_EQ(pthread_mutex_trylock(&mutex), 0);
+  EXPECT_EQ(pthread_mutex_trylock(&mutex), EBUSY);
+  EXPECT_EQ(pthread_mutex_unlock(&mutex), 0);
+  EXPECT_EQ(pthread_mutex_unlock(&mutex), EINVAL);
+  EXPECT_EQ(pthread_mutex_destroy(&mutex), 0);
+}
+
 // Tests that multiple mutexes work together. Also uses dynamic mutex
 // initialization.
 TEST(ThreadedTest, MultipleMutexTest) {
@@ -307,6 +349,38 @@ TEST(ThreadedTest, ThreadSpecific) {
   }
 }
 
+static int tsd_destructor_calls = 0;
+
+void count_tsd_destructor_call(void *value) {
+  ++tsd_destructor_calls;
+  EXPECT_EQ(value, &tsd_destructor_calls);
+}
+
+void *set_destructed_specific(void *arg) {
+  pthread_key_t tls_key = *static_cast<pthread_key_t *>(arg);
+  EXPECT_EQ(pthread_getspecific(tls_key), nullptr);
+  EXPECT_EQ(pthread_setspecific(tls_key, &tsd_destructor_calls), 0);
+  return nullptr;
+}
+
+// Tests that values stored by a thread are destroyed when it exits and are not
+// visible to a later thread.
+TEST(ThreadedTest, ThreadSpecificDestructors) {
+  pthread_key_t tls_key;
+  ASSERT_EQ(pthread_key_create(&tls_key, count_tsd_destructor_call), 0);
+  EXPECT_EQ(pthread_setspecific(PTHREAD_KEYS_MAX, nullptr), EINVAL);
+  EXPECT_EQ(pthread_key_delete(PTHREAD_KEYS_MAX), EINVAL);
+
+  for (int i = 1; i <= 3; ++i) {
+    pthread_t thread;
+    ASSERT_EQ(
+        pthread_create(&thread, nullptr, set_destructed_specific, &tls_key), 0);
+    EXPECT_EQ(pthread_join(thread, nullptr), 0);
+    EXPECT_EQ(tsd_destructor_calls, i);
+  }
+  EXPECT_EQ(pthread_key_delete(tls_key), 0);
+}
+
 // Tests that pthread_self() returns distinct values for different threads, and
 // that thread ID generated by pthread_create matches thread ID in
 // pthread_self().
@@ -0,0 +1,426 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/util/binary_log.h"
+
+#include <time.h>
+
+#include <cstring>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "asylo/util/status.h"
+#include "asylo/util/status_macros.h"
+
+// A binary log file is a sequence of sessions, one for each time a process
+// opened the file. A session starts with kMagic, followed by records. Each
+// record is a varint length followed by that many bytes, starting with a
+// RecordType:
+//
+//   kDefinition: varint id, string file, varint line, string format
+//   kEntry:      varint id, varint severity, varint seconds since the epoch,
+//                then the arguments up to the end of the record, each an
+//                ArgumentType followed by its value.
+//
+// Strings are a varint length followed by the bytes. Ids are only meaningful
+// within a session, and every session repeats the definitions of the ids it
+// uses, though not necessarily before the entries that use them.
+
+namespace asylo {
+namespace binary_log_internal {
+namespace {
+
+constexpr char kMagic[] = "ASYLOBLOG1";
+
+enum RecordType : uint8_t {
+  kDefinition = 1,
+  kEntry = 2,
+};
+
+// The definitions of the format ids assigned in this process.
+struct Registry {
+  absl::Mutex mu;
+  uint32_t last_id ABSL_GUARDED_BY(mu) = 0;
+  std::string definitions ABSL_GUARDED_BY(mu);
+};
+
+Registry *GetRegistry() {
+  static Registry *registry = new Registry;
+  return registry;
+}
+
+void AppendString(absl::string_view value, std::string *record) {
+  AppendVarint(value.size(), record);
+  record->append(value.data(), value.size());
+}
+
+// Returns |payload| prefixed by its length.
+std::string MakeRecord(const std::string &payload) {
+  std::string record;
+  record.reserve(payload.size() + 5);
+  AppendVarint(payload.size(), &record);
+  record.append(payload);
+  return record;
+}
+
+// Returns the header of binary log files, which repeats every definition made
+// so far.
+std::string FileHeader() {
+  Registry *registry = GetRegistry();
+  absl::MutexLock lock(&registry->mu);
+  return absl::StrCat(absl::string_view(kMagic, sizeof(kMagic) - 1),
+                      registry->definitions);
+}
+
+// Assigns an id to |site| if it has none yet, and returns it.
+uint32_t Register(FormatSite *site, const char *file, int line,
+                  const char *format) {
+  Registry *registry = GetRegistry();
+  std::string definition;
+  uint32_t id;
+  {
+    absl::MutexLock lock(&registry->mu);
+    id = site->id.load(std::memory_order_relaxed);
+    if (id != 0) {
+      return id;
+    }
+    id = ++registry->last_id;
+    std::string payload(1, kDefinition);
+    AppendVarint(id, &payload);
+    AppendString(file, &payload);
+    AppendVarint(line, &payload);
+    AppendString(format, &payload);
+    definition = MakeRecord(payload);
+    registry->definitions.append(definition);
+    site->id.store(id, std::memory_order_release);
+  }
+
+  // Appending outside |registry->mu| since the binary log file takes it to
+  // write FileHeader().
+  logging_internal::AppendToBinaryLog(definition, /*record_time=*/0,
+                                      /*flush=*/false, FileHeader);
+  return id;
+}
+
+// A cursor over the bytes of a binary log file.
+class Reader {
+ public:
+  explicit Reader(absl::string_view data) : data_(data) {}
+
+  bool empty() const { return data_.empty(); }
+
+  bool ConsumePrefix(absl::string_view prefix) {
+    if (data_.substr(0, prefix.size()) != prefix) {
+      return false;
+    }
+    data_.remove_prefix(prefix.size());
+    return true;
+  }
+
+  bool ReadByte(uint8_t *value) {
+    if (data_.empty()) {
+      return false;
+    }
+    *value = static_cast<uint8_t>(data_[0]);
+    data_.remove_prefix(1);
+    return true;
+  }
+
+  bool ReadVarint(uint64_t *value) {
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      uint8_t byte;
+      if (!ReadByte(&byte)) {
+        return false;
+      }
+      *value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool ReadBytes(size_t size, absl::string_view *value) {
+    if (data_.size() < size) {
+      return false;
+    }
+    *value = data_.substr(0, size);
+    data_.remove_prefix(size);
+    return true;
+  }
+
+  bool ReadString(absl::string_view *value) {
+    uint64_t size;
+    return ReadVarint(&size) && ReadBytes(size, value);
+  }
+
+ private:
+  absl::string_view data_;
+};
+
+struct Definition {
+  absl::string_view file;
+  uint64_t line;
+  absl::string_view format;
+};
+
+Status MalformedError(absl::string_view what) {
+  return Status(error::GoogleError::DATA_LOSS,
+                absl::StrCat("Malformed binary log: ", what));
+}
+
+// Formats the value of the next argument in |reader|.
+StatusOr<std::string> DecodeArgument(Reader *reader) {
+  uint8_t type;
+  if (!reader->ReadByte(&type)) {
+    return MalformedError("missing argument type");
+  }
+  uint64_t value;
+  absl::string_view bytes;
+  switch (static_cast<ArgumentType>(type)) {
+    case ArgumentType::kSigned:
+      if (!reader->ReadVarint(&value)) break;
+      return FormatArgument(static_cast<int64_t>(value >> 1) ^
+                            -static_cast<int64_t>(value & 1));
+    case ArgumentType::kUnsigned:
+      if (!reader->ReadVarint(&value)) break;
+      return FormatArgument(value);
+    case ArgumentType::kDouble: {
+      if (!reader->ReadBytes(sizeof(double), &bytes)) break;
+      double double_value;
+      memcpy(&double_value, bytes.data(), sizeof(double_value));
+      return FormatArgument(double_value);
+    }
+    case ArgumentType::kBool:
+      if (!reader->ReadVarint(&value)) break;
+      return FormatArgument(value != 0);
+    case ArgumentType::kString:
+      if (!reader->ReadString(&bytes)) break;
+      return std::string(bytes);
+    case ArgumentType::kPointer:
+      if (!reader->ReadVarint(&value)) break;
+      return FormatArgument(
+          reinterpret_cast<const void *>(static_cast<uintptr_t>(value)));
+    default:
+      return MalformedError(absl::StrCat("unknown argument type ", type));
+  }
+  return MalformedError("truncated argument");
+}
+
+// Formats the entry in |reader| as LogMessage would.
+StatusOr<std::string> DecodeEntry(
+    const absl::flat_hash_map<uint64_t, Definition> &definitions,
+    Reader *reader) {
+  uint64_t id;
+  uint64_t severity;
+  uint64_t seconds;
+  if (!reader->ReadVarint(&id) || !reader->ReadVarint(&severity) ||
+      !reader->ReadVarint(&seconds)) {
+    return MalformedError("truncated entry");
+  }
+  auto it = definitions.find(id);
+  if (it == definitions.end()) {
+    return MalformedError(absl::StrCat("undefined format id ", id));
+  }
+  if (severity > QFATAL) {
+    return MalformedError(absl::StrCat("unknown severity ", severity));
+  }
+  const Definition &definition = it->second;
+
+  std::vector<std::string> arguments;
+  while (!reader->empty()) {
+    std::string argument;
+    ASYLO_ASSIGN_OR_RETURN(argument, DecodeArgument(reader));
+    arguments.push_back(std::move(argument));
+  }
+
+  constexpr int kTimeMessageSize = 22;
+  char time_buffer[kTimeMessageSize] = "";
+  time_t time = static_cast<time_t>(seconds);
+  struct tm datetime;
+  if (localtime_r(&time, &datetime)) {
+    strftime(time_buffer, kTimeMessageSize, "%Y-%m-%d %H:%M:%S  ", &datetime);
+  }
+  absl::string_view file = definition.file;
+  size_t slash = file.rfind('/');
+  if (slash != absl::string_view::npos) {
+    file.remove_prefix(slash + 1);
+  }
+  static const char *const kSeverityNames[] = {"INFO", "WARNING", "ERROR",
+                                               "FATAL", "QFATAL"};
+  return absl::StrCat(time_buffer, kSeverityNames[severity], "  ", file, " : ",
+                      definition.line, " : ",
+                      FormatMessage(definition.format, arguments));
+}
+
+}  // namespace
+
+std::atomic<bool> binary_logging_enabled(false);
+
+void AppendVarint(uint64_t value, std::string *entry) {
+  while (value >= 0x80) {
+    entry->push_back(static_cast<char>(value | 0x80));
+    value >>= 7;
+  }
+  entry->push_back(static_cast<char>(value));
+}
+
+std::string FormatMessage(absl::string_view format,
+                          const std::vector<std::string> &arguments) {
+  std::string message;
+  size_t next_argument = 0;
+  size_t position;
+  while ((position = format.find("{}")) != absl::string_view::npos &&
+         next_argument < arguments.size()) {
+    absl::StrAppend(&message, format.substr(0, position),
+                    arguments[next_argument++]);
+    format.remove_prefix(position + 2);
+  }
+  absl::StrAppend(&message, format);
+  return message;
+}
+
+void StartEntry(FormatSite *site, LogSeverity severity, const char *file,
+                int line, const char *format, std::string *entry) {
+  uint32_t id = site->id.load(std::memory_order_acquire);
+  if (id == 0) {
+    id = Register(site, file, line, format);
+  }
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  entry->push_back(kEntry);
+  AppendVarint(id, entry);
+  AppendVarint(severity, entry);
+  AppendVarint(now.tv_sec, entry);
+}
+
+void FinishEntry(LogSeverity severity, std::string *entry) {
+  // The time of the entry follows its kind, id and severity.
+  Reader reader(*entry);
+  uint8_t kind;
+  uint64_t id;
+  uint64_t entry_severity;
+  uint64_t seconds = 0;
+  if (!reader.ReadByte(&kind) || !reader.ReadVarint(&id) ||
+      !reader.ReadVarint(&entry_severity) || !reader.ReadVarint(&seconds)) {
+    seconds = 0;
+  }
+  logging_internal::AppendToBinaryLog(MakeRecord(*entry),
+                                      static_cast<int64_t>(seconds),
+                                      /*flush=*/severity >= ERROR, FileHeader);
+}
+
+void EncodeArgument(bool value, std::string *entry) {
+  entry->push_back(static_cast<char>(ArgumentType::kBool));
+  entry->push_back(value ? 1 : 0);
+}
+
+void EncodeArgument(char value, std::string *entry) {
+  EncodeArgument(absl::string_view(&value, 1), entry);
+}
+
+void EncodeArgument(absl::string_view value, std::string *entry) {
+  entry->push_back(static_cast<char>(ArgumentType::kString));
+  AppendString(value, entry);
+}
+
+void EncodeArgument(const char *value, std::string *entry) {
+  EncodeArgument(absl::string_view(value ? value : "(null)"), entry);
+}
+
+void EncodeArgument(const std::string &value, std::string *entry) {
+  EncodeArgument(absl::string_view(value), entry);
+}
+
+void EncodeArgument(const void *value, std::string *entry) {
+  entry->push_back(static_cast<char>(ArgumentType::kPointer));
+  AppendVarint(reinterpret_cast<uintptr_t>(value), entry);
+}
+
+void LogText(LogSeverity severity, const char *file, int line,
+             const std::string &message) {
+  if (severity >= FATAL) {
+    LogMessageFatal(file, line, severity).stream() << message;
+  }
+  LogMessage(file, line, severity).stream() << message;
+}
+
+}  // namespace binary_log_internal
+
+void SetBinaryLoggingEnabled(bool enabled) {
+  binary_log_internal::binary_logging_enabled.store(enabled,
+                                                    std::memory_order_relaxed);
+}
+
+StatusOr<std::vector<std::string>> DecodeBinaryLog(absl::string_view contents) {
+  const absl::string_view magic(binary_log_internal::kMagic,
+                                sizeof(binary_log_internal::kMagic) - 1);
+  binary_log_internal::Reader reader(contents);
+  std::vector<std::string> messages;
+  if (!reader.empty() && !reader.ConsumePrefix(magic)) {
+    return binary_log_internal::MalformedError("missing session header");
+  }
+  while (!reader.empty()) {
+    // Definitions may follow the entries that use them, so a session is read
+    // in two passes.
+    absl::flat_hash_map<uint64_t, binary_log_internal::Definition> definitions;
+    std::vector<absl::string_view> entries;
+    while (!reader.empty() && !reader.ConsumePrefix(magic)) {
+      absl::string_view record;
+      if (!reader.ReadString(&record)) {
+        return binary_log_internal::MalformedError("truncated record");
+      }
+      binary_log_internal::Reader record_reader(record);
+      uint8_t type;
+      if (!record_reader.ReadByte(&type)) {
+        return binary_log_internal::MalformedError("empty record");
+      }
+      if (type == binary_log_internal::kEntry) {
+        entries.push_back(record.substr(1));
+        continue;
+      }
+      if (type != binary_log_internal::kDefinition) {
+        return binary_log_internal::MalformedError(
+            absl::StrCat("unknown record type ", type));
+      }
+      uint64_t id;
+      binary_log_internal::Definition definition;
+      if (!record_reader.ReadVarint(&id) ||
+          !record_reader.ReadString(&definition.file) ||
+          !record_reader.ReadVarint(&definition.line) ||
+          !record_reader.ReadString(&definition.format)) {
+        return binary_log_internal::MalformedError("truncated definition");
+      }
+      definitions[id] = definition;
+    }
+
+    for (absl::string_view entry : entries) {
+      binary_log_internal::Reader entry_reader(entry);
+      std::string message;
+      ASYLO_ASSIGN_OR_RETURN(
+          message, binary_log_internal::DecodeEntry(definitions, &entry_reader));
+      messages.push_back(std::move(message));
+    }
+  }
+  return messages;
+}
+
+}  // namespace asylo
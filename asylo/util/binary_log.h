@@ -0,0 +1,176 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_UTIL_BINARY_LOG_H_
+#define ASYLO_UTIL_BINARY_LOG_H_
+
+#include <atomic>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "asylo/util/logging.h"
+#include "asylo/util/statusor.h"
+
+/// Logs a message built from a format string and arguments, either as text or
+/// in a compact binary encoding.
+///
+/// The first argument after `severity` is the format, a string literal in
+/// which each `{}` stands for the next argument. Arguments may be integers,
+/// booleans, floating-point numbers, characters, strings and pointers.
+/// Example:
+///
+/// ```
+/// BLOG(INFO, "Sealed {} bytes for {}", size, secret_name);
+/// ```
+///
+/// When binary logging is enabled with `SetBinaryLoggingEnabled`, the message
+/// is not formatted. Instead, the id of the format and the raw arguments are
+/// appended to the log file named like the text log file with a `.blog`
+/// suffix, which `DecodeBinaryLog` and the `binary_log_decoder` tool turn back
+/// into text. Otherwise, and always for `FATAL` and `QFATAL` messages, the
+/// message is formatted and logged as by `LOG(severity)`.
+///
+/// \param severity The severity of the log message, one of `LogSeverity`.
+#define BLOG(severity, ...)                                                   \
+  do {                                                                        \
+    static ::asylo::binary_log_internal::FormatSite asylo_blog_site;          \
+    ::asylo::binary_log_internal::Log(&asylo_blog_site, severity, __FILE__, \
+                                      __LINE__, __VA_ARGS__);                 \
+  } while (0)
+
+namespace asylo {
+
+/// Sets whether `BLOG` statements are logged in binary.
+///
+/// \param enabled Whether to log `BLOG` statements in binary.
+void SetBinaryLoggingEnabled(bool enabled);
+
+/// Decodes the contents of binary log files.
+///
+/// \param contents The contents of a binary log file.
+/// \return The decoded messages, formatted like the lines of the text log
+///         file, or an error if `contents` is malformed.
+StatusOr<std::vector<std::string>> DecodeBinaryLog(absl::string_view contents);
+
+/// \cond Internal
+namespace binary_log_internal {
+
+// The types of the arguments of binary log entries.
+enum class ArgumentType : uint8_t {
+  kSigned = 1,
+  kUnsigned = 2,
+  kDouble = 3,
+  kBool = 4,
+  kString = 5,
+  kPointer = 6,
+};
+
+// A BLOG statement. Its id is assigned the first time it is logged in binary.
+struct FormatSite {
+  std::atomic<uint32_t> id{0};
+};
+
+extern std::atomic<bool> binary_logging_enabled;
+
+// Returns |format| with each {} replaced by the next of |arguments|.
+std::string FormatMessage(absl::string_view format,
+                          const std::vector<std::string> &arguments);
+
+// Starts a binary log entry for |site| in |entry|.
+void StartEntry(FormatSite *site, LogSeverity severity, const char *file,
+                int line, const char *format, std::string *entry);
+
+// Appends the binary log entry to the binary log.
+void FinishEntry(LogSeverity severity, std::string *entry);
+
+void AppendVarint(uint64_t value, std::string *entry);
+
+// Appends |value| to the binary log |entry|.
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value &&
+                        std::is_signed<T>::value>::type
+EncodeArgument(T value, std::string *entry) {
+  entry->push_back(static_cast<char>(ArgumentType::kSigned));
+  int64_t signed_value = value;
+  AppendVarint((static_cast<uint64_t>(signed_value) << 1) ^
+                   static_cast<uint64_t>(signed_value >> 63),
+               entry);
+}
+
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value &&
+                        std::is_unsigned<T>::value>::type
+EncodeArgument(T value, std::string *entry) {
+  entry->push_back(static_cast<char>(ArgumentType::kUnsigned));
+  AppendVarint(value, entry);
+}
+
+template <typename T>
+typename std::enable_if<std::is_floating_point<T>::value>::type EncodeArgument(
+    T value, std::string *entry) {
+  entry->push_back(static_cast<char>(ArgumentType::kDouble));
+  double double_value = value;
+  entry->append(reinterpret_cast<const char *>(&double_value),
+                sizeof(double_value));
+}
+
+void EncodeArgument(bool value, std::string *entry);
+void EncodeArgument(char value, std::string *entry);
+void EncodeArgument(absl::string_view value, std::string *entry);
+void EncodeArgument(const char *value, std::string *entry);
+void EncodeArgument(const std::string &value, std::string *entry);
+void EncodeArgument(const void *value, std::string *entry);
+
+// Formats |value| as LOG would.
+template <typename T>
+std::string FormatArgument(const T &value) {
+  std::ostringstream stream;
+  stream << value;
+  return stream.str();
+}
+
+// Logs the formatted |message| as LOG(severity) would.
+void LogText(LogSeverity severity, const char *file, int line,
+             const std::string &message);
+
+template <typename... Args>
+void Log(FormatSite *site, LogSeverity severity, const char *file, int line,
+         const char *format, const Args &... args) {
+  if (severity < FATAL &&
+      binary_logging_enabled.load(std::memory_order_relaxed)) {
+    std::string entry;
+    StartEntry(site, severity, file, line, format, &entry);
+    int unused[] = {0, (EncodeArgument(args, &entry), 0)...};
+    (void)unused;
+    FinishEntry(severity, &entry);
+  } else {
+    LogText(severity, file, line,
+            FormatMessage(format, {FormatArgument(args)...}));
+  }
+}
+
+}  // namespace binary_log_internal
+/// \endcond
+
+}  // namespace asylo
+
+#endif  // ASYLO_UTIL_BINARY_LOG_H_
@@ -0,0 +1,60 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Prints the messages in binary log files as text.
+//
+// Usage: binary_log_decoder <file>.blog...
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "asylo/util/binary_log.h"
+#include "asylo/util/statusor.h"
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <file>.blog..." << std::endl;
+    return 1;
+  }
+
+  int exit_code = 0;
+  for (int i = 1; i < argc; ++i) {
+    std::ifstream file(argv[i], std::ios::binary);
+    if (!file) {
+      std::cerr << "Failed to open " << argv[i] << std::endl;
+      exit_code = 1;
+      continue;
+    }
+    std::stringstream contents;
+    contents << file.rdbuf();
+
+    auto messages_result = asylo::DecodeBinaryLog(contents.str());
+    if (!messages_result.ok()) {
+      std::cerr << argv[i] << ": " << messages_result.status() << std::endl;
+      exit_code = 1;
+      continue;
+    }
+    for (const std::string &message : messages_result.ValueOrDie()) {
+      std::cout << message << "\n";
+    }
+  }
+  return exit_code;
+}
@@ -0,0 +1,141 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/util/binary_log.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/flags/flag.h"
+#include "absl/strings/str_cat.h"
+#include "asylo/test/util/status_matchers.h"
+#include "asylo/test/util/test_flags.h"
+#include "asylo/util/logging.h"
+
+namespace asylo {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::EndsWith;
+using ::testing::HasSubstr;
+using ::testing::IsEmpty;
+using ::testing::Not;
+
+std::string ReadFile(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  std::stringstream contents;
+  contents << file.rdbuf();
+  return contents.str();
+}
+
+class BinaryLogTest : public ::testing::Test {
+ protected:
+  static void SetUpTestSuite() {
+    ASSERT_TRUE(InitLogging(
+        absl::StrCat(absl::GetFlag(FLAGS_test_tmpdir), "/").c_str(),
+        "binary_log_test", /*level=*/0));
+  }
+
+  void SetUp() override {
+    log_path_ = absl::StrCat(absl::GetFlag(FLAGS_test_tmpdir),
+                             "/binary_log_test");
+    ReopenLogFile();
+    remove(log_path_.c_str());
+    remove(BinaryLogPath().c_str());
+  }
+
+  void TearDown() override { SetBinaryLoggingEnabled(false); }
+
+  std::string BinaryLogPath() const { return log_path_ + ".blog"; }
+
+  std::string log_path_;
+};
+
+TEST_F(BinaryLogTest, LogsTextWhenDisabled) {
+  BLOG(WARNING, "{} plus {} is {}", 1, 2u, "three");
+  FlushLogs();
+
+  std::string contents = ReadFile(log_path_);
+  EXPECT_THAT(contents, HasSubstr("WARNING  binary_log_test.cc : "));
+  EXPECT_THAT(contents, HasSubstr(" : 1 plus 2 is three\n"));
+  EXPECT_THAT(ReadFile(BinaryLogPath()), IsEmpty());
+}
+
+TEST_F(BinaryLogTest, DecodesBinaryEntries) {
+  SetBinaryLoggingEnabled(true);
+  std::string name = "sealer";
+  for (int i = -1; i <= 1; ++i) {
+    BLOG(INFO, "{}: {} {} {} {}", name, i, 0.5, true, 'x');
+  }
+  BLOG(ERROR, "no arguments");
+  FlushLogs();
+
+  EXPECT_THAT(ReadFile(log_path_), IsEmpty());
+  std::vector<std::string> messages;
+  ASYLO_ASSERT_OK_AND_ASSIGN(messages,
+                             DecodeBinaryLog(ReadFile(BinaryLogPath())));
+  EXPECT_THAT(messages, ElementsAre(EndsWith(" : sealer: -1 0.5 1 x"),
+                                    EndsWith(" : sealer: 0 0.5 1 x"),
+                                    EndsWith(" : sealer: 1 0.5 1 x"),
+                                    EndsWith(" : no arguments")));
+  EXPECT_THAT(messages[0], HasSubstr("INFO  binary_log_test.cc : "));
+  EXPECT_THAT(messages[3], HasSubstr("ERROR  binary_log_test.cc : "));
+}
+
+TEST_F(BinaryLogTest, ReopenedFileRepeatsDefinitions) {
+  SetBinaryLoggingEnabled(true);
+  for (int i = 0; i < 2; ++i) {
+    BLOG(INFO, "session {}", i);
+    FlushLogs();
+    ReopenLogFile();
+  }
+
+  // Each session can be decoded on its own, as after log rotation.
+  std::string contents = ReadFile(BinaryLogPath());
+  size_t second_session = contents.find("ASYLOBLOG1", 1);
+  ASSERT_NE(second_session, std::string::npos);
+  std::vector<std::string> messages;
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      messages, DecodeBinaryLog(contents.substr(second_session)));
+  EXPECT_THAT(messages, ElementsAre(EndsWith("session 1")));
+
+  ASYLO_ASSERT_OK_AND_ASSIGN(messages, DecodeBinaryLog(contents));
+  EXPECT_THAT(messages,
+              ElementsAre(EndsWith("session 0"), EndsWith("session 1")));
+}
+
+TEST_F(BinaryLogTest, MalformedContentsFail) {
+  EXPECT_THAT(DecodeBinaryLog("not a binary log"),
+              StatusIs(error::GoogleError::DATA_LOSS));
+
+  SetBinaryLoggingEnabled(true);
+  BLOG(INFO, "truncated {}", std::string(100, 'a'));
+  FlushLogs();
+  std::string contents = ReadFile(BinaryLogPath());
+  ASSERT_THAT(contents, Not(IsEmpty()));
+  EXPECT_THAT(DecodeBinaryLog(contents.substr(0, contents.size() - 1)),
+              StatusIs(error::GoogleError::DATA_LOSS));
+}
+
+}  // namespace
+}  // namespace asylo
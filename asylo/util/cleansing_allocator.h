@@ -25,6 +25,8 @@
 #include <memory>
 #include <type_traits>
 
+#include "asylo/util/pooled_allocator.h"
+
 namespace asylo {
 
 /// CleansingAllocator is a minimal C++11
@@ -38,7 +40,11 @@ namespace asylo {
 /// underlying allocator in a passthrough fashion. It however cleanses the
 /// memory being deallocated before passing it to the deallocate method of
 /// the underlying allocator.
-template <typename T, class A = std::allocator<T>>
+///
+/// By default, the underlying allocator is a PooledAllocator, so that secret
+/// buffers which are frequently created and destroyed reuse cleansed blocks of
+/// a per-thread pool instead of allocating from the heap each time.
+template <typename T, class A = PooledAllocator<T>>
 class CleansingAllocator {
  public:
   using value_type = typename std::allocator_traits<A>::value_type;
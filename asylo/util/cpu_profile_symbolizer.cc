@@ -0,0 +1,320 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/util/cpu_profile_symbolizer.h"
+
+#include <cxxabi.h>
+#include <elf.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "asylo/util/status_macros.h"
+
+namespace asylo {
+namespace {
+
+// Wire types of the protocol buffer encoding.
+constexpr uint32_t kVarint = 0;
+constexpr uint32_t kLengthDelimited = 2;
+
+// Pseudo-functions standing for the samples without a symbolized stack.
+constexpr char kOutsideFunction[] = "[outside enclave]";
+constexpr char kUnattributedFunction[] = "[unattributed]";
+constexpr char kUntrackedFunction[] = "[untracked stack]";
+
+// Appends fields of a protocol buffer message to a string.
+class MessageWriter {
+ public:
+  explicit MessageWriter(std::string *out) : stream_(out), coded_(&stream_) {}
+
+  void Varint(uint32_t field, uint64_t value) {
+    coded_.WriteTag(field << 3 | kVarint);
+    coded_.WriteVarint64(value);
+  }
+
+  void Bytes(uint32_t field, absl::string_view bytes) {
+    coded_.WriteTag(field << 3 | kLengthDelimited);
+    coded_.WriteVarint32(bytes.size());
+    coded_.WriteRaw(bytes.data(), bytes.size());
+  }
+
+  void Packed(uint32_t field, const std::vector<uint64_t> &values) {
+    std::string packed;
+    {
+      google::protobuf::io::StringOutputStream stream(&packed);
+      google::protobuf::io::CodedOutputStream coded(&stream);
+      for (uint64_t value : values) {
+        coded.WriteVarint64(value);
+      }
+    }
+    Bytes(field, packed);
+  }
+
+ private:
+  google::protobuf::io::StringOutputStream stream_;
+  google::protobuf::io::CodedOutputStream coded_;
+};
+
+// Builds a perftools.profiles.Profile, interning its strings, functions and
+// locations.
+class ProfileBuilder {
+ public:
+  ProfileBuilder() { String(""); }
+
+  int64_t String(const std::string &value) {
+    auto result = strings_.emplace(value, string_table_.size());
+    if (result.second) {
+      string_table_.push_back(value);
+    }
+    return result.first->second;
+  }
+
+  // Returns the location of a single frame of the function |name| at
+  // |address|, with |system_name| as its mangled name.
+  uint64_t Location(uint64_t address, const std::string &name,
+                    const std::string &system_name) {
+    auto location = locations_.find(address);
+    if (location != locations_.end()) {
+      return location->second;
+    }
+    auto function = functions_.find(system_name);
+    if (function == functions_.end()) {
+      function = functions_.emplace(system_name, functions_.size() + 1).first;
+      std::string message;
+      {
+        MessageWriter writer(&message);
+        writer.Varint(1, function->second);
+        writer.Varint(2, String(name));
+        writer.Varint(3, String(system_name));
+      }
+      MessageWriter(&functions_message_).Bytes(5, message);
+    }
+
+    uint64_t id = locations_.size() + 1;
+    locations_.emplace(address, id);
+    std::string line;
+    MessageWriter(&line).Varint(1, function->second);
+    std::string message;
+    {
+      MessageWriter writer(&message);
+      writer.Varint(1, id);
+      writer.Varint(2, 1);
+      writer.Varint(3, address);
+      writer.Bytes(4, line);
+    }
+    MessageWriter(&locations_message_).Bytes(4, message);
+    return id;
+  }
+
+  void Sample(const std::vector<uint64_t> &location_ids, uint64_t samples,
+              uint64_t period_nanos) {
+    std::string message;
+    {
+      MessageWriter writer(&message);
+      writer.Packed(1, location_ids);
+      writer.Packed(2, {samples, samples * period_nanos});
+    }
+    MessageWriter(&samples_message_).Bytes(2, message);
+  }
+
+  std::string Build(uint64_t period_nanos, uint64_t memory_start,
+                    uint64_t memory_limit) {
+    std::string sample_type = ValueType("samples", "count");
+    std::string period_type = ValueType("cpu", "nanoseconds");
+    std::string mapping;
+    {
+      MessageWriter writer(&mapping);
+      writer.Varint(1, 1);
+      writer.Varint(2, memory_start);
+      writer.Varint(3, memory_limit);
+      writer.Varint(5, String("enclave"));
+      // has_functions, so that pprof does not symbolize the profile again.
+      writer.Varint(7, 1);
+    }
+
+    std::string profile;
+    {
+      MessageWriter writer(&profile);
+      writer.Bytes(1, sample_type);
+      writer.Bytes(1, period_type);
+      writer.Bytes(3, mapping);
+      writer.Bytes(11, period_type);
+      writer.Varint(12, period_nanos);
+      for (const std::string &value : string_table_) {
+        writer.Bytes(6, value);
+      }
+    }
+    return absl::StrCat(profile, samples_message_, locations_message_,
+                        functions_message_);
+  }
+
+ private:
+  std::string ValueType(const std::string &type, const std::string &unit) {
+    std::string message;
+    MessageWriter writer(&message);
+    writer.Varint(1, String(type));
+    writer.Varint(2, String(unit));
+    return message;
+  }
+
+  absl::flat_hash_map<std::string, int64_t> strings_;
+  std::vector<std::string> string_table_;
+  absl::flat_hash_map<std::string, uint64_t> functions_;
+  absl::flat_hash_map<uint64_t, uint64_t> locations_;
+  std::string samples_message_;
+  std::string locations_message_;
+  std::string functions_message_;
+};
+
+std::string Demangle(const std::string &name) {
+  int status = 0;
+  char *demangled =
+      abi::__cxa_demangle(name.c_str(), nullptr, nullptr, &status);
+  if (status != 0 || !demangled) {
+    return name;
+  }
+  std::string result(demangled);
+  free(demangled);
+  return result;
+}
+
+}  // namespace
+
+StatusOr<CpuProfileSymbolizer> CpuProfileSymbolizer::Create(
+    const ElfReader &elf_reader) {
+  absl::Span<const uint8_t> symtab;
+  absl::Span<const uint8_t> strtab;
+  ASYLO_ASSIGN_OR_RETURN(symtab, elf_reader.GetSectionData(".symtab"));
+  ASYLO_ASSIGN_OR_RETURN(strtab, elf_reader.GetSectionData(".strtab"));
+
+  std::vector<Symbol> symbols;
+  for (size_t offset = 0; offset + sizeof(Elf64_Sym) <= symtab.size();
+       offset += sizeof(Elf64_Sym)) {
+    Elf64_Sym symbol;
+    memcpy(&symbol, symtab.data() + offset, sizeof(symbol));
+    if (ELF64_ST_TYPE(symbol.st_info) != STT_FUNC ||
+        symbol.st_shndx == SHN_UNDEF || symbol.st_value == 0) {
+      continue;
+    }
+    if (symbol.st_name >= strtab.size()) {
+      return Status(error::GoogleError::INVALID_ARGUMENT,
+                    "Malformed ELF file: symbol has invalid st_name");
+    }
+    const char *name = reinterpret_cast<const char *>(strtab.data()) +
+                       symbol.st_name;
+    symbols.push_back({symbol.st_value, symbol.st_size,
+                       std::string(name, strnlen(name, strtab.size() -
+                                                           symbol.st_name))});
+  }
+  std::sort(symbols.begin(), symbols.end(),
+            [](const Symbol &a, const Symbol &b) {
+              return a.address < b.address;
+            });
+  return CpuProfileSymbolizer(std::move(symbols));
+}
+
+CpuProfileSymbolizer::CpuProfileSymbolizer(std::vector<Symbol> symbols)
+    : symbols_(std::move(symbols)) {}
+
+const CpuProfileSymbolizer::Symbol *CpuProfileSymbolizer::Find(
+    uint64_t address) const {
+  auto next = std::upper_bound(
+      symbols_.begin(), symbols_.end(), address,
+      [](uint64_t value, const Symbol &symbol) {
+        return value < symbol.address;
+      });
+  if (next == symbols_.begin()) {
+    return nullptr;
+  }
+  const Symbol &symbol = *(next - 1);
+  // Symbols without a size extend to the next symbol.
+  if (symbol.size != 0 && address - symbol.address >= symbol.size) {
+    return nullptr;
+  }
+  return &symbol;
+}
+
+std::string CpuProfileSymbolizer::Symbolize(uint64_t address) const {
+  const Symbol *symbol = Find(address);
+  return symbol ? Demangle(symbol->name) : std::string();
+}
+
+StatusOr<std::string> CpuProfileSymbolizer::ToPprof(
+    const CpuProfile &profile) const {
+  auto anchor = std::find_if(symbols_.begin(), symbols_.end(),
+                             [](const Symbol &symbol) {
+                               return symbol.name == kCpuProfileAnchorSymbol;
+                             });
+  if (anchor == symbols_.end()) {
+    return Status(error::GoogleError::FAILED_PRECONDITION,
+                  absl::StrCat("Enclave image does not define ",
+                               kCpuProfileAnchorSymbol));
+  }
+  // Offset of runtime addresses from link-time addresses.
+  const uint64_t load_bias = profile.anchor_address - anchor->address;
+  const uint64_t period_nanos = profile.period_micros * 1000;
+
+  ProfileBuilder builder;
+  for (const CpuProfileStack &stack : profile.stacks) {
+    std::vector<uint64_t> location_ids;
+    for (size_t i = 0; i < stack.frames.size(); ++i) {
+      uint64_t address = stack.frames[i] - load_bias;
+      // Return addresses may point past the end of the calling function, so
+      // callers are looked up at the call instruction.
+      const Symbol *symbol = Find(i == 0 ? address : address - 1);
+      std::string system_name =
+          symbol ? symbol->name : absl::StrCat("0x", absl::Hex(address));
+      location_ids.push_back(builder.Location(
+          address, symbol ? Demangle(symbol->name) : system_name,
+          system_name));
+    }
+    builder.Sample(location_ids, stack.samples, period_nanos);
+  }
+
+  // Pseudo-locations live at addresses no instruction can have.
+  uint64_t pseudo_address = ~uint64_t{0};
+  for (const auto &pseudo :
+       std::vector<std::pair<const char *, uint64_t>>{
+           {kOutsideFunction, profile.outside_samples},
+           {kUnattributedFunction, profile.unattributed_samples},
+           {kUntrackedFunction, profile.untracked_samples}}) {
+    if (pseudo.second != 0) {
+      builder.Sample({builder.Location(pseudo_address, pseudo.first,
+                                       pseudo.first)},
+                     pseudo.second, period_nanos);
+    }
+    --pseudo_address;
+  }
+
+  uint64_t memory_limit =
+      symbols_.empty()
+          ? 0
+          : symbols_.back().address + symbols_.back().size;
+  return builder.Build(period_nanos, load_bias, memory_limit + load_bias);
+}
+
+}  // namespace asylo
@@ -0,0 +1,71 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_UTIL_CPU_PROFILE_SYMBOLIZER_H_
+#define ASYLO_UTIL_CPU_PROFILE_SYMBOLIZER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "asylo/platform/core/cpu_profiler.h"
+#include "asylo/util/elf_reader.h"
+#include "asylo/util/statusor.h"
+
+namespace asylo {
+
+// Symbolizes the CPU profiles recorded inside an enclave with the symbol table
+// of the enclave image, and converts them to the pprof profile format. The
+// image must not be stripped, which debug enclaves normally are not.
+class CpuProfileSymbolizer {
+ public:
+  // Reads the function symbols of the ELF file read by |elf_reader|. The
+  // symbols are copied, so |elf_reader| need not outlive the symbolizer.
+  static StatusOr<CpuProfileSymbolizer> Create(const ElfReader &elf_reader);
+
+  // Returns the name of the function containing the link-time address
+  // |address|, or an empty string if no function contains it.
+  std::string Symbolize(uint64_t address) const;
+
+  // Returns |profile| as a serialized, uncompressed perftools.profiles.Profile
+  // message, as read by pprof. Samples taken outside the enclave, samples
+  // without context and samples whose stacks did not fit the stack table each
+  // get a pseudo-function of their own, so that pprof accounts for all of the
+  // sampled CPU time. Fails if the image does not define the anchor function
+  // of the profile.
+  StatusOr<std::string> ToPprof(const CpuProfile &profile) const;
+
+ private:
+  struct Symbol {
+    uint64_t address;
+    uint64_t size;
+    std::string name;
+  };
+
+  explicit CpuProfileSymbolizer(std::vector<Symbol> symbols);
+
+  // Returns the function containing |address|, or nullptr.
+  const Symbol *Find(uint64_t address) const;
+
+  // Function symbols sorted by address.
+  std::vector<Symbol> symbols_;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_UTIL_CPU_PROFILE_SYMBOLIZER_H_
@@ -0,0 +1,213 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/util/cpu_profile_symbolizer.h"
+
+#include <elf.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <google/protobuf/unknown_field_set.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/types/span.h"
+#include "asylo/platform/core/cpu_profiler.h"
+#include "asylo/test/util/status_matchers.h"
+#include "asylo/util/elf_reader.h"
+
+namespace asylo {
+namespace {
+
+using ::google::protobuf::UnknownField;
+using ::google::protobuf::UnknownFieldSet;
+using ::testing::Contains;
+using ::testing::Eq;
+using ::testing::IsEmpty;
+using ::testing::Not;
+
+struct TestSymbol {
+  const char *name;
+  uint64_t address;
+  uint64_t size;
+  unsigned char type;
+};
+
+template <typename T>
+void Append(std::string *out, const T &value) {
+  out->append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+// Returns an ELF file with a symbol table holding |symbols|, and no code.
+std::string MakeElfFile(const std::vector<TestSymbol> &symbols) {
+  std::string section_names =
+      std::string("\0.shstrtab\0.symtab\0.strtab\0", 27);
+  std::string strtab(1, '\0');
+  std::string symtab(sizeof(Elf64_Sym), '\0');
+  for (const TestSymbol &test_symbol : symbols) {
+    Elf64_Sym symbol = {};
+    symbol.st_name = strtab.size();
+    symbol.st_info = ELF64_ST_INFO(STB_GLOBAL, test_symbol.type);
+    symbol.st_shndx = 1;
+    symbol.st_value = test_symbol.address;
+    symbol.st_size = test_symbol.size;
+    Append(&symtab, symbol);
+    strtab.append(test_symbol.name);
+    strtab.push_back('\0');
+  }
+
+  Elf64_Ehdr header = {};
+  memcpy(header.e_ident, ELFMAG, SELFMAG);
+  header.e_ident[EI_CLASS] = ELFCLASS64;
+  header.e_ident[EI_DATA] = ELFDATA2LSB;
+  header.e_ident[EI_VERSION] = EV_CURRENT;
+  header.e_version = EV_CURRENT;
+  header.e_shentsize = sizeof(Elf64_Shdr);
+  header.e_shnum = 4;
+  header.e_shstrndx = 1;
+
+  std::vector<Elf64_Shdr> sections(4);
+  std::string contents;
+  size_t offset = sizeof(header);
+  const std::pair<uint32_t, const std::string *> section_data[] = {
+      {1, &section_names}, {11, &symtab}, {19, &strtab}};
+  for (int i = 0; i < 3; ++i) {
+    Elf64_Shdr &section = sections[i + 1];
+    section.sh_name = section_data[i].first;
+    section.sh_type = i == 1 ? SHT_SYMTAB : SHT_STRTAB;
+    section.sh_offset = offset + contents.size();
+    section.sh_size = section_data[i].second->size();
+    contents += *section_data[i].second;
+    // Keep the next section and the section header table aligned.
+    contents.resize((contents.size() + 7) / 8 * 8, '\0');
+  }
+  header.e_shoff = offset + contents.size();
+
+  std::string elf_file;
+  Append(&elf_file, header);
+  elf_file += contents;
+  for (const Elf64_Shdr &section : sections) {
+    Append(&elf_file, section);
+  }
+  return elf_file;
+}
+
+class CpuProfileSymbolizerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    elf_file_ = MakeElfFile({
+        {kCpuProfileAnchorSymbol, 0x1000, 0x10, STT_FUNC},
+        {"_ZN5asylo3FooEv", 0x2000, 0x100, STT_FUNC},
+        {"main", 0x3000, 0x80, STT_FUNC},
+        {"data", 0x4000, 0x100, STT_OBJECT},
+    });
+    ElfReader reader;
+    ASYLO_ASSERT_OK_AND_ASSIGN(
+        reader, ElfReader::CreateFromSpan(absl::MakeConstSpan(
+                    reinterpret_cast<const uint8_t *>(elf_file_.data()),
+                    elf_file_.size())));
+    ASYLO_ASSERT_OK_AND_ASSIGN(symbolizer_,
+                               CpuProfileSymbolizer::Create(reader));
+  }
+
+  std::string elf_file_;
+  StatusOr<CpuProfileSymbolizer> symbolizer_ =
+      Status(error::GoogleError::UNKNOWN, "Not created");
+};
+
+// Returns the strings of the string table of a serialized pprof profile.
+std::vector<std::string> StringTable(const std::string &pprof) {
+  UnknownFieldSet fields;
+  EXPECT_TRUE(fields.ParseFromString(pprof));
+  std::vector<std::string> strings;
+  for (int i = 0; i < fields.field_count(); ++i) {
+    const UnknownField &field = fields.field(i);
+    if (field.number() == 6) {
+      strings.push_back(field.length_delimited());
+    }
+  }
+  return strings;
+}
+
+// Returns the number of |field_number| fields of a serialized pprof profile.
+int CountFields(const std::string &pprof, int field_number) {
+  UnknownFieldSet fields;
+  EXPECT_TRUE(fields.ParseFromString(pprof));
+  int count = 0;
+  for (int i = 0; i < fields.field_count(); ++i) {
+    count += fields.field(i).number() == field_number;
+  }
+  return count;
+}
+
+TEST_F(CpuProfileSymbolizerTest, SymbolizesFunctions) {
+  const CpuProfileSymbolizer &symbolizer = symbolizer_.ValueOrDie();
+  EXPECT_THAT(symbolizer.Symbolize(0x2000), Eq("asylo::Foo()"));
+  EXPECT_THAT(symbolizer.Symbolize(0x20ff), Eq("asylo::Foo()"));
+  EXPECT_THAT(symbolizer.Symbolize(0x2100), IsEmpty());
+  EXPECT_THAT(symbolizer.Symbolize(0x3010), Eq("main"));
+  EXPECT_THAT(symbolizer.Symbolize(0x4010), IsEmpty());
+  EXPECT_THAT(symbolizer.Symbolize(0x10), IsEmpty());
+}
+
+TEST_F(CpuProfileSymbolizerTest, ConvertsProfilesToPprof) {
+  // The enclave was loaded 0x7f0000000000 bytes above its link-time address.
+  constexpr uint64_t kBias = 0x7f0000000000;
+  CpuProfile profile = {};
+  profile.period_micros = 1000;
+  profile.anchor_address = kBias + 0x1000;
+  // The return address into main() is the end of main(), which only belongs
+  // to it as a return address.
+  profile.stacks.push_back({{kBias + 0x2010, kBias + 0x3080}, 5});
+  profile.stacks.push_back({{kBias + 0x5000}, 1});
+  profile.outside_samples = 3;
+
+  std::string pprof;
+  ASYLO_ASSERT_OK_AND_ASSIGN(pprof, symbolizer_.ValueOrDie().ToPprof(profile));
+  std::vector<std::string> strings = StringTable(pprof);
+  EXPECT_THAT(strings[0], IsEmpty());
+  EXPECT_THAT(strings, Contains("asylo::Foo()"));
+  EXPECT_THAT(strings, Contains("_ZN5asylo3FooEv"));
+  EXPECT_THAT(strings, Contains("main"));
+  EXPECT_THAT(strings, Contains("0x5000"));
+  EXPECT_THAT(strings, Contains("[outside enclave]"));
+  EXPECT_THAT(strings, Not(Contains("[unattributed]")));
+
+  // Three samples, four locations and four functions.
+  EXPECT_THAT(CountFields(pprof, 2), Eq(3));
+  EXPECT_THAT(CountFields(pprof, 4), Eq(4));
+  EXPECT_THAT(CountFields(pprof, 5), Eq(4));
+}
+
+TEST_F(CpuProfileSymbolizerTest, RequiresAnchorSymbol) {
+  std::string elf_file = MakeElfFile({{"main", 0x3000, 0x80, STT_FUNC}});
+  ElfReader reader;
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      reader, ElfReader::CreateFromSpan(absl::MakeConstSpan(
+                  reinterpret_cast<const uint8_t *>(elf_file.data()),
+                  elf_file.size())));
+  auto symbolizer_result = CpuProfileSymbolizer::Create(reader);
+  ASSERT_THAT(symbolizer_result, IsOk());
+  EXPECT_THAT(symbolizer_result.ValueOrDie().ToPprof(CpuProfile{}),
+              StatusIs(error::GoogleError::FAILED_PRECONDITION));
+}
+
+}  // namespace
+}  // namespace asylo
@@ -0,0 +1,85 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Symbolizes a CPU profile written by an enclave and converts it to the pprof
+// profile format.
+//
+// Usage: cpu_profile_to_pprof <enclave image> <cpu profile> <pprof output>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "asylo/platform/core/cpu_profiler.h"
+#include "asylo/util/cpu_profile_symbolizer.h"
+#include "asylo/util/elf_reader.h"
+#include "asylo/util/file_mapping.h"
+#include "asylo/util/status_macros.h"
+#include "asylo/util/statusor.h"
+
+namespace asylo {
+namespace {
+
+Status ConvertProfile(const std::string &enclave_path,
+                      const std::string &profile_path,
+                      const std::string &output_path) {
+  FileMapping enclave;
+  ASYLO_ASSIGN_OR_RETURN(enclave, FileMapping::CreateFromFile(enclave_path));
+  ElfReader reader;
+  ASYLO_ASSIGN_OR_RETURN(reader, ElfReader::CreateFromSpan(enclave.buffer()));
+  auto symbolizer_result = CpuProfileSymbolizer::Create(reader);
+  ASYLO_RETURN_IF_ERROR(symbolizer_result.status());
+
+  std::ifstream profile_file(profile_path, std::ios::binary);
+  if (!profile_file) {
+    return Status(error::GoogleError::NOT_FOUND,
+                  "Failed to open " + profile_path);
+  }
+  std::stringstream contents;
+  contents << profile_file.rdbuf();
+  CpuProfile profile;
+  ASYLO_ASSIGN_OR_RETURN(profile, DecodeCpuProfile(contents.str()));
+
+  std::string pprof;
+  ASYLO_ASSIGN_OR_RETURN(pprof,
+                         symbolizer_result.ValueOrDie().ToPprof(profile));
+  std::ofstream output(output_path, std::ios::binary);
+  if (!output.write(pprof.data(), pprof.size())) {
+    return Status(error::GoogleError::INTERNAL,
+                  "Failed to write " + output_path);
+  }
+  return Status::OkStatus();
+}
+
+}  // namespace
+}  // namespace asylo
+
+int main(int argc, char *argv[]) {
+  if (argc != 4) {
+    std::cerr << "Usage: " << argv[0]
+              << " <enclave image> <cpu profile> <pprof output>" << std::endl;
+    return 1;
+  }
+  asylo::Status status = asylo::ConvertProfile(argv[1], argv[2], argv[3]);
+  if (!status.ok()) {
+    std::cerr << status << std::endl;
+    return 1;
+  }
+  return 0;
+}
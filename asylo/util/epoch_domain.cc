@@ -0,0 +1,181 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/util/epoch_domain.h"
+
+#include <sched.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "absl/base/attributes.h"
+
+namespace asylo {
+namespace {
+
+// Source of unique domain identifiers.
+std::atomic<uint64_t> next_domain_id{1};
+
+// The reader slot most recently used by this thread, and its domain.
+struct CachedReader {
+  uint64_t domain_id;
+  void *reader;
+};
+
+ABSL_CONST_INIT thread_local CachedReader cached_reader = {0, nullptr};
+
+// Set once this thread returned its reader slots. Read sections the thread
+// starts afterwards, e.g. from other thread-local destructors, use the shared
+// reader count.
+ABSL_CONST_INIT thread_local bool reader_slots_released = false;
+
+}  // namespace
+
+constexpr size_t EpochDomain::kMaxReaders;
+
+// The reader slots owned by a thread, which it returns to their domains when
+// it exits.
+class EpochDomain::ThreadReaders {
+ public:
+  ~ThreadReaders() {
+    cached_reader = {0, nullptr};
+    reader_slots_released = true;
+    for (const Claim &claim : claims_) {
+      std::shared_ptr<ReaderTable> table = claim.table.lock();
+      if (table) {
+        absl::MutexLock lock(&table->lock);
+        table->free_readers.push_back(claim.reader);
+      }
+    }
+  }
+
+  // Returns the slot this thread owns in the domain |domain_id|, or nullptr if
+  // it owns none.
+  Reader *Find(uint64_t domain_id) const {
+    for (const Claim &claim : claims_) {
+      if (claim.domain_id == domain_id) {
+        return claim.reader;
+      }
+    }
+    return nullptr;
+  }
+
+  // Records that this thread owns |reader| in the domain |domain_id|, whose
+  // slots are held by |table|.
+  void Add(uint64_t domain_id, const std::shared_ptr<ReaderTable> &table,
+           Reader *reader) {
+    // Forget the slots of domains which no longer exist.
+    claims_.erase(std::remove_if(claims_.begin(), claims_.end(),
+                                 [](const Claim &claim) {
+                                   return claim.table.expired();
+                                 }),
+                  claims_.end());
+    claims_.push_back({domain_id, table, reader});
+  }
+
+ private:
+  struct Claim {
+    uint64_t domain_id;
+    std::weak_ptr<ReaderTable> table;
+    Reader *reader;
+  };
+
+  std::vector<Claim> claims_;
+};
+
+EpochDomain::ReaderTable::ReaderTable() : readers(new Reader[kMaxReaders]) {
+  free_readers.reserve(kMaxReaders);
+  for (size_t i = kMaxReaders; i > 0; --i) {
+    free_readers.push_back(&readers[i - 1]);
+  }
+}
+
+EpochDomain::EpochDomain()
+    : id_(next_domain_id.fetch_add(1)),
+      epoch_(1),
+      overflow_readers_(0),
+      readers_(std::make_shared<ReaderTable>()) {}
+
+EpochDomain::Reader *EpochDomain::ReaderForThisThread() {
+  if (cached_reader.domain_id == id_) {
+    return static_cast<Reader *>(cached_reader.reader);
+  }
+  if (reader_slots_released) {
+    return nullptr;
+  }
+  static thread_local ThreadReaders thread_readers;
+  Reader *reader = thread_readers.Find(id_);
+  if (!reader) {
+    {
+      absl::MutexLock lock(&readers_->lock);
+      if (readers_->free_readers.empty()) {
+        return nullptr;
+      }
+      reader = readers_->free_readers.back();
+      readers_->free_readers.pop_back();
+    }
+    thread_readers.Add(id_, readers_, reader);
+  }
+  cached_reader = {id_, reader};
+  return reader;
+}
+
+EpochDomain::ReadSection::ReadSection(EpochDomain *domain)
+    : domain_(domain), reader_(domain->ReaderForThisThread()) {
+  if (!reader_) {
+    domain_->overflow_readers_.fetch_add(1);
+    return;
+  }
+  if (reader_->depth++ == 0) {
+    // Sequentially consistent so that a concurrent Synchronize() either sees
+    // this announcement or finished unlinking before the reads that follow.
+    reader_->epoch.store(domain_->epoch_.load());
+  }
+}
+
+EpochDomain::ReadSection::~ReadSection() {
+  if (!reader_) {
+    domain_->overflow_readers_.fetch_sub(1);
+    return;
+  }
+  if (--reader_->depth == 0) {
+    reader_->epoch.store(0, std::memory_order_release);
+  }
+}
+
+void EpochDomain::Synchronize() {
+  absl::MutexLock lock(&synchronize_lock_);
+  const uint64_t target = epoch_.fetch_add(1) + 1;
+  for (size_t i = 0; i < kMaxReaders; ++i) {
+    for (;;) {
+      uint64_t epoch = readers_->readers[i].epoch.load();
+      if (epoch == 0 || epoch >= target) {
+        break;
+      }
+      sched_yield();
+    }
+  }
+  while (overflow_readers_.load() != 0) {
+    sched_yield();
+  }
+}
+
+}  // namespace asylo
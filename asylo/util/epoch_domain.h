@@ -0,0 +1,128 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_UTIL_EPOCH_DOMAIN_H_
+#define ASYLO_UTIL_EPOCH_DOMAIN_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+
+namespace asylo {
+
+// An EpochDomain lets readers access shared objects without taking a lock,
+// while writers which unlink an object from a shared structure wait for every
+// reader that may still observe it before destroying it.
+//
+// Readers wrap each access in a ReadSection. A writer publishes its change,
+// calls Synchronize(), and may then destroy whatever it unlinked. Read sections
+// are expected to be short, since Synchronize() waits for them to end.
+//
+// Each thread that reads from a domain announces its epoch in a slot of a
+// fixed table owned by the domain. A thread keeps its slot until it exits, when
+// the slot returns to the domain's free list. Threads which do not find a free
+// slot fall back to a shared reader count, which is correct but contended.
+class EpochDomain {
+ private:
+  struct Reader;
+
+ public:
+  // Number of reader slots in a domain.
+  static constexpr size_t kMaxReaders = 256;
+
+  // Marks the calling thread as reading from |domain| for the lifetime of the
+  // object. Read sections may nest.
+  class ReadSection {
+   public:
+    explicit ReadSection(EpochDomain *domain);
+    ~ReadSection();
+
+    ReadSection(const ReadSection &other) = delete;
+    ReadSection &operator=(const ReadSection &other) = delete;
+
+   private:
+    EpochDomain *const domain_;
+    Reader *const reader_;
+  };
+
+  EpochDomain();
+
+  EpochDomain(const EpochDomain &other) = delete;
+  EpochDomain &operator=(const EpochDomain &other) = delete;
+
+  // Waits until every read section which started before the call has ended.
+  // Objects unlinked before the call are no longer observable by readers once
+  // it returns.
+  void Synchronize();
+
+ private:
+  friend class EpochDomainForTest;
+
+  class ThreadReaders;
+
+  // A reader slot, kept on its own cache line so that readers on different
+  // threads do not contend.
+  struct alignas(64) Reader {
+    // The epoch in which the owner's outermost read section started, or zero
+    // if the owner is not reading.
+    std::atomic<uint64_t> epoch{0};
+
+    // Nesting depth of the owner's read sections. Only accessed by the owner.
+    int depth = 0;
+  };
+
+  // The reader slots of a domain. Threads which own a slot keep a weak
+  // reference to the table, through which they return the slot when they exit
+  // if the domain still exists.
+  struct ReaderTable {
+    ReaderTable();
+
+    const std::unique_ptr<Reader[]> readers;
+
+    // Slots not owned by any thread.
+    absl::Mutex lock;
+    std::vector<Reader *> free_readers ABSL_GUARDED_BY(lock);
+  };
+
+  // Returns the reader slot owned by the calling thread, claiming a free one if
+  // needed. Returns nullptr if every slot is owned by another thread.
+  Reader *ReaderForThisThread();
+
+  // A unique identifier of this domain, used to key thread-local caches.
+  const uint64_t id_;
+
+  // The current epoch. Epoch zero is reserved to mark inactive readers.
+  std::atomic<uint64_t> epoch_;
+
+  // Number of read sections held by threads without a reader slot.
+  std::atomic<uint64_t> overflow_readers_;
+
+  // Serializes Synchronize() calls.
+  absl::Mutex synchronize_lock_;
+
+  const std::shared_ptr<ReaderTable> readers_;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_UTIL_EPOCH_DOMAIN_H_
@@ -0,0 +1,202 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/util/epoch_domain.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
+
+namespace asylo {
+
+class EpochDomainForTest {
+ public:
+  // Returns the number of reader slots of |domain| not owned by any thread.
+  static size_t FreeReaders(EpochDomain *domain) {
+    absl::MutexLock lock(&domain->readers_->lock);
+    return domain->readers_->free_readers.size();
+  }
+};
+
+namespace {
+
+using ::testing::Eq;
+
+// A published value which readers dereference and writers replace. A reader
+// that observes a retired value after Synchronize() returned fails the test.
+struct Value {
+  std::atomic<bool> retired{false};
+};
+
+TEST(EpochDomainTest, SynchronizeWithoutReadersReturns) {
+  EpochDomain domain;
+  domain.Synchronize();
+  domain.Synchronize();
+}
+
+TEST(EpochDomainTest, NestedReadSections) {
+  EpochDomain domain;
+  {
+    EpochDomain::ReadSection outer(&domain);
+    EpochDomain::ReadSection inner(&domain);
+  }
+  domain.Synchronize();
+}
+
+TEST(EpochDomainTest, SynchronizeWaitsForActiveReader) {
+  EpochDomain domain;
+  std::atomic<bool> reading{false};
+  std::atomic<bool> release{false};
+  std::atomic<bool> synchronized{false};
+
+  std::thread reader([&] {
+    EpochDomain::ReadSection section(&domain);
+    reading = true;
+    while (!release) {
+      std::this_thread::yield();
+    }
+    EXPECT_FALSE(synchronized);
+  });
+  while (!reading) {
+    std::this_thread::yield();
+  }
+  std::thread writer([&] {
+    domain.Synchronize();
+    synchronized = true;
+  });
+  release = true;
+  reader.join();
+  writer.join();
+  EXPECT_TRUE(synchronized);
+}
+
+TEST(EpochDomainTest, ReadersNeverObserveRetiredValues) {
+  constexpr int kReaders = 8;
+  constexpr int kUpdates = 2000;
+  EpochDomain domain;
+  std::atomic<Value *> published(new Value);
+  std::atomic<bool> done{false};
+  std::atomic<int> violations{0};
+
+  std::vector<std::thread> readers;
+  for (int i = 0; i < kReaders; ++i) {
+    readers.emplace_back([&] {
+      while (!done) {
+        EpochDomain::ReadSection section(&domain);
+        if (published.load()->retired) {
+          ++violations;
+        }
+      }
+    });
+  }
+  std::vector<std::unique_ptr<Value>> retired;
+  for (int i = 0; i < kUpdates; ++i) {
+    Value *old = published.exchange(new Value);
+    domain.Synchronize();
+    old->retired = true;
+    retired.emplace_back(old);
+  }
+  done = true;
+  for (auto &reader : readers) {
+    reader.join();
+  }
+  delete published.load();
+  EXPECT_THAT(violations.load(), Eq(0));
+}
+
+TEST(EpochDomainTest, ReadersWithoutSlotsAreTracked) {
+  EpochDomain domain;
+  std::atomic<int> claimed{0};
+  std::atomic<bool> release{false};
+
+  // Occupy every reader slot so that the calling thread overflows.
+  std::vector<std::thread> holders;
+  for (size_t i = 0; i < EpochDomain::kMaxReaders; ++i) {
+    holders.emplace_back([&] {
+      { EpochDomain::ReadSection section(&domain); }
+      ++claimed;
+      while (!release) {
+        std::this_thread::yield();
+      }
+    });
+  }
+  while (claimed < static_cast<int>(EpochDomain::kMaxReaders)) {
+    std::this_thread::yield();
+  }
+
+  std::atomic<bool> synchronized{false};
+  std::thread writer;
+  {
+    EpochDomain::ReadSection section(&domain);
+    writer = std::thread([&] {
+      domain.Synchronize();
+      synchronized = true;
+    });
+    for (int i = 0; i < 1000; ++i) {
+      std::this_thread::yield();
+    }
+    EXPECT_FALSE(synchronized);
+  }
+  writer.join();
+  EXPECT_TRUE(synchronized);
+  release = true;
+  for (auto &holder : holders) {
+    holder.join();
+  }
+}
+
+TEST(EpochDomainTest, ExitingThreadsReturnTheirSlots) {
+  EpochDomain domain;
+  for (size_t i = 0; i < 2 * EpochDomain::kMaxReaders; ++i) {
+    std::thread([&] {
+      EpochDomain::ReadSection section(&domain);
+      EXPECT_THAT(EpochDomainForTest::FreeReaders(&domain),
+                  Eq(EpochDomain::kMaxReaders - 1));
+    }).join();
+  }
+  EXPECT_THAT(EpochDomainForTest::FreeReaders(&domain),
+              Eq(EpochDomain::kMaxReaders));
+}
+
+TEST(EpochDomainTest, ThreadsMayOutliveTheDomain) {
+  auto domain = absl::make_unique<EpochDomain>();
+  std::atomic<bool> read{false};
+  std::atomic<bool> destroyed{false};
+  std::thread reader([&] {
+    { EpochDomain::ReadSection section(domain.get()); }
+    read = true;
+    while (!destroyed) {
+      std::this_thread::yield();
+    }
+  });
+  while (!read) {
+    std::this_thread::yield();
+  }
+  domain.reset();
+  destroyed = true;
+  reader.join();
+}
+
+}  // namespace
+}  // namespace asylo
@@ -57,12 +57,33 @@ class HttpFetcher {
     }
   };
 
+  // An HTTP(S) GET request for |url| with custom header fields specified in
+  // |custom_headers|.
+  struct HttpRequest {
+    std::string url;
+    std::vector<HttpHeaderField> custom_headers;
+  };
+
   // Fetches |url| through a HTTP(S) GET with custom header fields specified in
   // |custom_headers| and returns an HttpResponse. Returns a non-OK Status if
   // errors arise during fetching. Thread safe. Synchronous.
   virtual StatusOr<HttpResponse> Get(
       absl::string_view url,
       const std::vector<HttpHeaderField> &custom_headers) = 0;
+
+  // Fetches all of |requests| and returns their responses in the same order.
+  // Implementations may fetch the requests concurrently. The default
+  // implementation fetches them one after the other with Get(). Thread safe.
+  // Returns once every request has completed.
+  virtual std::vector<StatusOr<HttpResponse>> GetMany(
+      const std::vector<HttpRequest> &requests) {
+    std::vector<StatusOr<HttpResponse>> responses;
+    responses.reserve(requests.size());
+    for (const auto &request : requests) {
+      responses.push_back(Get(request.url, request.custom_headers));
+    }
+    return responses;
+  }
 };
 
 }  // namespace asylo
@@ -19,7 +19,10 @@
 
 #include <cstddef>
 #include <cstring>
+#include <utility>
 
+#include "absl/container/flat_hash_map.h"
+#include "absl/memory/memory.h"
 #include "absl/strings/ascii.h"
 #include "absl/strings/match.h"
 #include "absl/strings/string_view.h"
@@ -29,6 +32,7 @@
 #include "asylo/util/status_macros.h"
 #include <curl/curl.h>
 #include <curl/easy.h>
+#include <curl/multi.h>
 #include "re2/re2.h"
 
 namespace asylo {
@@ -36,6 +40,12 @@ namespace {
 
 const LazyRE2 kHttpResponseStatusLineRegexp = {"^HTTP[^ ]* *(\\d+)[^\\d]*\r\n"};
 
+// Maximum number of idle Curl objects kept by an HttpFetcherImpl.
+constexpr size_t kMaxIdleCurls = 8;
+
+// Maximum milliseconds to wait for activity on the transfers of a CurlMulti.
+constexpr int kCurlMultiPollTimeoutMs = 1000;
+
 size_t ReadToString(const char *buffer, size_t size, size_t nitems,
                     std::string *stream) {
   stream->append(buffer, size * nitems);
@@ -65,9 +75,56 @@ void CurlCleanup(void *curl) {
   curl_easy_cleanup(reinterpret_cast<CURL *>(curl));
 }
 
+void CurlMultiCleanup(void *multi) {
+  curl_multi_cleanup(reinterpret_cast<CURLM *>(multi));
+}
+
+// The libcurl share handle through which all CurlImpl objects share their DNS
+// cache, TLS sessions and connection cache, so that a new CurlImpl does not
+// repeat the DNS lookup and TLS handshake made by another.
+struct CurlShare {
+  CURLSH *share;
+  absl::Mutex mutexes[CURL_LOCK_DATA_LAST];
+};
+
+void LockCurlShare(CURL *curl, curl_lock_data data, curl_lock_access access,
+                   void *user_data) {
+  static_cast<CurlShare *>(user_data)->mutexes[data].Lock();
+}
+
+void UnlockCurlShare(CURL *curl, curl_lock_data data, void *user_data) {
+  static_cast<CurlShare *>(user_data)->mutexes[data].Unlock();
+}
+
+CURLSH *GetCurlShare() {
+  static CurlShare *const curl_share = [] {
+    auto curl_share = new CurlShare;
+    curl_share->share = curl_share_init();
+    curl_share_setopt(curl_share->share, CURLSHOPT_LOCKFUNC, LockCurlShare);
+    curl_share_setopt(curl_share->share, CURLSHOPT_UNLOCKFUNC,
+                      UnlockCurlShare);
+    curl_share_setopt(curl_share->share, CURLSHOPT_USERDATA, curl_share);
+    curl_share_setopt(curl_share->share, CURLSHOPT_SHARE,
+                      CURL_LOCK_DATA_DNS);
+    curl_share_setopt(curl_share->share, CURLSHOPT_SHARE,
+                      CURL_LOCK_DATA_SSL_SESSION);
+    curl_share_setopt(curl_share->share, CURLSHOPT_SHARE,
+                      CURL_LOCK_DATA_CONNECT);
+    return curl_share;
+  }();
+  return curl_share->share;
+}
+
+// Returns whether libcurl was built with HTTP/2 support.
+bool CurlSupportsHttp2() {
+  static const bool supports_http2 =
+      (curl_version_info(CURLVERSION_NOW)->features & CURL_VERSION_HTTP2) != 0;
+  return supports_http2;
+}
+
 class CurlImpl : public Curl {
  public:
-  CurlImpl() : curl_(nullptr) { Reset(); }
+  CurlImpl() : curl_(curl_easy_init()) { Reset(); }
   ~CurlImpl() override {}
 
   Status SetOpt(CURLoption option, void *value) override {
@@ -77,18 +134,33 @@ class CurlImpl : public Curl {
   Status Perform() override { return ToStatus(curl_easy_perform(curl_.get())); }
 
   void Reset() override {
-    curl_.reset(curl_easy_init());
+    // Unlike re-creating the handle, curl_easy_reset() keeps its connections
+    // open for the next request.
+    curl_easy_reset(curl_.get());
     memset(err_msg_, 0, sizeof(err_msg_));
     ASYLO_CHECK_OK(SetOpt(CURLOPT_ERRORBUFFER, err_msg_));
+    ASYLO_CHECK_OK(SetOpt(CURLOPT_SHARE, GetCurlShare()));
+    ASYLO_CHECK_OK(
+        ToStatus(curl_easy_setopt(curl_.get(), CURLOPT_TCP_KEEPALIVE, 1L)));
+    if (CurlSupportsHttp2()) {
+      ASYLO_CHECK_OK(ToStatus(curl_easy_setopt(
+          curl_.get(), CURLOPT_HTTP_VERSION,
+          static_cast<long>(CURL_HTTP_VERSION_2TLS))));
+      // Wait for a connection being set up to the same host rather than
+      // opening another, so that concurrent transfers are multiplexed.
+      ASYLO_CHECK_OK(
+          ToStatus(curl_easy_setopt(curl_.get(), CURLOPT_PIPEWAIT, 1L)));
+    }
   }
 
+  CURL *handle() const { return curl_.get(); }
+
   // Not copyable or movable.
   CurlImpl(const CurlImpl &) = delete;
   CurlImpl &operator=(const CurlImpl &) = delete;
   CurlImpl(CurlImpl &&) = delete;
   CurlImpl &operator=(CurlImpl &&) = delete;
 
- private:
   // Return a Status based on |error_code|. Populate error message from
   // |err_msg_|.
   Status ToStatus(CURLcode error_code) {
@@ -105,14 +177,123 @@ class CurlImpl : public Curl {
   char err_msg_[CURL_ERROR_SIZE];
 };
 
+class CurlMultiImpl : public CurlMulti {
+ public:
+  CurlMultiImpl() : multi_(curl_multi_init()) {
+    curl_multi_setopt(multi_.get(), CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+  }
+  ~CurlMultiImpl() override {}
+
+  std::vector<Status> Perform(const std::vector<Curl *> &curls) override {
+    absl::MutexLock lock(&mu_);
+    std::vector<Status> results(curls.size());
+    absl::flat_hash_map<CURL *, size_t> indices;
+    for (size_t i = 0; i < curls.size(); ++i) {
+      CURL *handle = static_cast<CurlImpl *>(curls[i])->handle();
+      indices[handle] = i;
+      CURLMcode code = curl_multi_add_handle(multi_.get(), handle);
+      if (code != CURLM_OK) {
+        results[i] = MultiError(code);
+        indices.erase(handle);
+      }
+    }
+
+    int running = static_cast<int>(indices.size());
+    while (running > 0) {
+      CURLMcode code = curl_multi_perform(multi_.get(), &running);
+      if (code == CURLM_OK && running > 0) {
+        code = curl_multi_poll(multi_.get(), /*extra_fds=*/nullptr,
+                               /*extra_nfds=*/0, kCurlMultiPollTimeoutMs,
+                               /*numfds=*/nullptr);
+      }
+      if (code != CURLM_OK) {
+        for (const auto &handle_index : indices) {
+          results[handle_index.second] = MultiError(code);
+        }
+        break;
+      }
+    }
+
+    int messages_left = 0;
+    while (CURLMsg *message =
+               curl_multi_info_read(multi_.get(), &messages_left)) {
+      auto it = indices.find(message->easy_handle);
+      if (message->msg == CURLMSG_DONE && it != indices.end()) {
+        results[it->second] = static_cast<CurlImpl *>(curls[it->second])
+                                  ->ToStatus(message->data.result);
+      }
+    }
+    for (const auto &handle_index : indices) {
+      curl_multi_remove_handle(multi_.get(), handle_index.first);
+    }
+    return results;
+  }
+
+  // Not copyable or movable.
+  CurlMultiImpl(const CurlMultiImpl &) = delete;
+  CurlMultiImpl &operator=(const CurlMultiImpl &) = delete;
+  CurlMultiImpl(CurlMultiImpl &&) = delete;
+  CurlMultiImpl &operator=(CurlMultiImpl &&) = delete;
+
+ private:
+  static Status MultiError(CURLMcode error_code) {
+    return Status(
+        error::GoogleError::INTERNAL,
+        absl::StrFormat("Call to libcurl failed with error code %s",
+                        curl_multi_strerror(error_code)));
+  }
+
+  absl::Mutex mu_;
+  std::unique_ptr<CURLM, FunctionDeleter<CurlMultiCleanup>> multi_
+      ABSL_GUARDED_BY(mu_);
+};
+
 void FreeCurlList(void *headers) {
   curl_slist_free_all(reinterpret_cast<curl_slist *>(headers));
 }
 
+using CurlList = std::unique_ptr<curl_slist, FunctionDeleter<FreeCurlList>>;
+
+// Sets up |curl| to fetch |url| with |custom_headers| into |response|. The
+// headers are held in |headers|, which must outlive the transfer.
+Status SetUpGet(
+    Curl *curl, absl::string_view url,
+    const std::vector<HttpFetcher::HttpHeaderField> &custom_headers,
+    const std::string &ca_cert_filename, HttpFetcher::HttpResponse *response,
+    CurlList *headers) {
+  curl->Reset();
+  if (!ca_cert_filename.empty()) {
+    ASYLO_RETURN_IF_ERROR(curl->SetOpt(
+        CURLOPT_CAINFO, const_cast<char *>(ca_cert_filename.c_str())));
+  }
+  ASYLO_RETURN_IF_ERROR(curl->SetOpt(
+      CURLOPT_URL,
+      reinterpret_cast<void *>(const_cast<char *>(std::string(url).c_str()))));
+  for (const auto &header : custom_headers) {
+    // curl_slist_append() returns the head of the list it was given, so the
+    // list must be released before it is reset to the result.
+    headers->reset(curl_slist_append(
+        headers->release(),
+        absl::StrFormat("%s: %s", header.first, header.second).c_str()));
+  }
+  ASYLO_RETURN_IF_ERROR(curl->SetOpt(CURLOPT_HTTPHEADER, headers->get()));
+  ASYLO_RETURN_IF_ERROR(curl->SetOpt(CURLOPT_WRITEFUNCTION,
+                                     reinterpret_cast<void *>(ReadToString)));
+  ASYLO_RETURN_IF_ERROR(curl->SetOpt(CURLOPT_WRITEDATA, &response->body));
+  ASYLO_RETURN_IF_ERROR(curl->SetOpt(CURLOPT_HEADERDATA, response));
+  ASYLO_RETURN_IF_ERROR(curl->SetOpt(
+      CURLOPT_HEADERFUNCTION, reinterpret_cast<void *>(ParseHttpHeader)));
+  return Status::OkStatus();
+}
+
 }  // namespace
 
 std::unique_ptr<Curl> CreateCurl() { return absl::make_unique<CurlImpl>(); }
 
+std::unique_ptr<CurlMulti> CreateCurlMulti() {
+  return absl::make_unique<CurlMultiImpl>();
+}
+
 size_t ParseHttpHeader(const char *buffer, size_t size, size_t nitems,
                        HttpFetcher::HttpResponse *response) {
   if (nitems == 0) {
@@ -142,33 +323,101 @@ size_t ParseHttpHeader(const char *buffer, size_t size, size_t nitems,
   return data_len;
 }
 
+HttpFetcherImpl::HttpFetcherImpl(std::unique_ptr<Curl> curl,
+                                 absl::string_view ca_cert_filename)
+    : ca_cert_filename_(ca_cert_filename) {
+  idle_curls_.push_back(std::move(curl));
+}
+
+HttpFetcherImpl::HttpFetcherImpl(
+    std::function<std::unique_ptr<Curl>()> curl_factory,
+    std::unique_ptr<CurlMulti> curl_multi, absl::string_view ca_cert_filename)
+    : curl_factory_(std::move(curl_factory)),
+      curl_multi_(std::move(curl_multi)),
+      ca_cert_filename_(ca_cert_filename) {}
+
 StatusOr<HttpFetcher::HttpResponse> HttpFetcherImpl::Get(
     absl::string_view url,
     const std::vector<HttpFetcher::HttpHeaderField> &custom_headers) {
-  curl_->Reset();
-  if (!ca_cert_filename_.empty()) {
-    ASYLO_RETURN_IF_ERROR(curl_->SetOpt(
-        CURLOPT_CAINFO, const_cast<char *>(ca_cert_filename_.c_str())));
-  }
-  ASYLO_RETURN_IF_ERROR(curl_->SetOpt(
-      CURLOPT_URL,
-      reinterpret_cast<void *>(const_cast<char *>(std::string(url).c_str()))));
-  std::unique_ptr<curl_slist, FunctionDeleter<FreeCurlList>> headers;
-  for (const auto &header : custom_headers) {
-    headers.reset(curl_slist_append(
-        headers.get(),
-        absl::StrFormat("%s: %s", header.first, header.second).c_str()));
-  }
-  ASYLO_RETURN_IF_ERROR(curl_->SetOpt(CURLOPT_HTTPHEADER, headers.get()));
+  std::unique_ptr<Curl> curl = AcquireCurl();
+  Cleanup release_curl([this, &curl] { ReleaseCurl(std::move(curl)); });
+
   HttpFetcher::HttpResponse result;
-  ASYLO_RETURN_IF_ERROR(curl_->SetOpt(CURLOPT_WRITEFUNCTION,
-                                      reinterpret_cast<void *>(ReadToString)));
-  ASYLO_RETURN_IF_ERROR(curl_->SetOpt(CURLOPT_WRITEDATA, &result.body));
-  ASYLO_RETURN_IF_ERROR(curl_->SetOpt(CURLOPT_HEADERDATA, &result));
-  ASYLO_RETURN_IF_ERROR(curl_->SetOpt(
-      CURLOPT_HEADERFUNCTION, reinterpret_cast<void *>(ParseHttpHeader)));
-  ASYLO_RETURN_IF_ERROR(curl_->Perform());
+  CurlList headers;
+  ASYLO_RETURN_IF_ERROR(SetUpGet(curl.get(), url, custom_headers,
+                                 ca_cert_filename_, &result, &headers));
+  ASYLO_RETURN_IF_ERROR(curl->Perform());
   return result;
 }
 
+std::vector<StatusOr<HttpFetcher::HttpResponse>> HttpFetcherImpl::GetMany(
+    const std::vector<HttpFetcher::HttpRequest> &requests) {
+  if (!curl_multi_ || requests.size() <= 1) {
+    return HttpFetcher::GetMany(requests);
+  }
+
+  std::vector<std::unique_ptr<Curl>> curls;
+  std::vector<HttpFetcher::HttpResponse> responses(requests.size());
+  std::vector<CurlList> headers(requests.size());
+  std::vector<Status> statuses(requests.size());
+  std::vector<Curl *> transfers;
+  std::vector<size_t> transfer_requests;
+  for (size_t i = 0; i < requests.size(); ++i) {
+    curls.push_back(AcquireCurl());
+    statuses[i] = SetUpGet(curls.back().get(), requests[i].url,
+                           requests[i].custom_headers, ca_cert_filename_,
+                           &responses[i], &headers[i]);
+    if (statuses[i].ok()) {
+      transfers.push_back(curls.back().get());
+      transfer_requests.push_back(i);
+    }
+  }
+
+  std::vector<Status> transfer_statuses = curl_multi_->Perform(transfers);
+  for (size_t i = 0; i < transfer_requests.size(); ++i) {
+    statuses[transfer_requests[i]] = std::move(transfer_statuses[i]);
+  }
+  for (auto &curl : curls) {
+    ReleaseCurl(std::move(curl));
+  }
+
+  std::vector<StatusOr<HttpFetcher::HttpResponse>> results;
+  results.reserve(requests.size());
+  for (size_t i = 0; i < requests.size(); ++i) {
+    if (statuses[i].ok()) {
+      results.push_back(std::move(responses[i]));
+    } else {
+      results.push_back(std::move(statuses[i]));
+    }
+  }
+  return results;
+}
+
+std::unique_ptr<Curl> HttpFetcherImpl::AcquireCurl() {
+  {
+    absl::MutexLock lock(&mu_);
+    if (!curl_factory_) {
+      mu_.Await(absl::Condition(
+          +[](std::vector<std::unique_ptr<Curl>> *idle_curls) {
+            return !idle_curls->empty();
+          },
+          &idle_curls_));
+    }
+    if (!idle_curls_.empty()) {
+      std::unique_ptr<Curl> curl = std::move(idle_curls_.back());
+      idle_curls_.pop_back();
+      return curl;
+    }
+  }
+  return curl_factory_();
+}
+
+void HttpFetcherImpl::ReleaseCurl(std::unique_ptr<Curl> curl) {
+  absl::MutexLock lock(&mu_);
+  // Always keep the only Curl object of a fetcher without a factory.
+  if (!curl_factory_ || idle_curls_.size() < kMaxIdleCurls) {
+    idle_curls_.push_back(std::move(curl));
+  }
+}
+
 }  // namespace asylo
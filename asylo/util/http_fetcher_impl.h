@@ -18,11 +18,15 @@
 #ifndef ASYLO_UTIL_HTTP_FETCHER_IMPL_H_
 #define ASYLO_UTIL_HTTP_FETCHER_IMPL_H_
 
+#include <functional>
 #include <memory>
+#include <string>
 #include <vector>
 
+#include "absl/base/thread_annotations.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "asylo/util/http_fetcher.h"
 #include "asylo/util/statusor.h"
 #include <curl/curl.h>
@@ -40,21 +44,40 @@ class Curl {
   // Wraps libcurl's curl_easy_perform call.
   virtual Status Perform() = 0;
 
-  // Resets the Curl object before each use. Wraps libcurl's curl_easy_init
-  // call.
+  // Resets the Curl object before each use. Wraps libcurl's curl_easy_reset
+  // call, which keeps the open connections of the object for reuse.
   virtual void Reset() = 0;
 };
 
-// Creates an instance of Curl implementation.
+// Creates an instance of Curl implementation. All instances share their DNS
+// cache, TLS sessions and connection cache, and negotiate HTTP/2 when libcurl
+// supports it.
 std::unique_ptr<Curl> CreateCurl();
 
+// A interface abstracting libcurl functions used to perform several transfers
+// concurrently.
+class CurlMulti {
+ public:
+  virtual ~CurlMulti() {}
+
+  // Performs the transfers set up on |curls| concurrently and returns the
+  // result of each. Wraps libcurl's curl_multi_perform loop.
+  virtual std::vector<Status> Perform(const std::vector<Curl *> &curls) = 0;
+};
+
+// Creates an instance of CurlMulti implementation, which multiplexes transfers
+// to the same host over a single HTTP/2 connection when possible. Only accepts
+// Curl objects created by CreateCurl().
+std::unique_ptr<CurlMulti> CreateCurlMulti();
+
 // Helper function used by libcurl to parse HTTP headers. See
 // https://curl.haxx.se/libcurl/c/CURLOPT_HEADERFUNCTION.html for more details.
 // Expose for tests only. Do not use.
 size_t ParseHttpHeader(const char *buffer, size_t size, size_t nitems,
                        HttpFetcher::HttpResponse *response);
 
-// Implements HttpFetcher using libcurl.
+// Implements HttpFetcher using libcurl. Curl objects are kept across requests,
+// so that connections to the same server are reused.
 class HttpFetcherImpl : public HttpFetcher {
  public:
   HttpFetcherImpl() : HttpFetcherImpl("") {}
@@ -62,20 +85,43 @@ class HttpFetcherImpl : public HttpFetcher {
   // Constructs an HttpFetcherImpl object that will use |ca_cert_filename| as
   // the trusted root for validating the TLS connection with the remote server.
   explicit HttpFetcherImpl(absl::string_view ca_cert_filename)
-      : HttpFetcherImpl(CreateCurl(), ca_cert_filename) {}
+      : HttpFetcherImpl(&CreateCurl, CreateCurlMulti(), ca_cert_filename) {}
 
+  // Constructs an HttpFetcherImpl object that performs all requests, one at a
+  // time, with |curl|.
   explicit HttpFetcherImpl(std::unique_ptr<Curl> curl,
-                           absl::string_view ca_cert_filename)
-      : curl_(std::move(curl)), ca_cert_filename_(ca_cert_filename) {}
+                           absl::string_view ca_cert_filename);
+
+  // Constructs an HttpFetcherImpl object that creates Curl objects with
+  // |curl_factory| as concurrent requests need them, and performs the requests
+  // passed to GetMany() with |curl_multi|.
+  HttpFetcherImpl(std::function<std::unique_ptr<Curl>()> curl_factory,
+                  std::unique_ptr<CurlMulti> curl_multi,
+                  absl::string_view ca_cert_filename);
+
   ~HttpFetcherImpl() override {}
 
   StatusOr<HttpFetcher::HttpResponse> Get(
       absl::string_view url,
       const std::vector<HttpFetcher::HttpHeaderField> &custom_headers) override;
 
+  std::vector<StatusOr<HttpFetcher::HttpResponse>> GetMany(
+      const std::vector<HttpFetcher::HttpRequest> &requests) override;
+
  private:
-  std::unique_ptr<Curl> curl_;
-  std::string ca_cert_filename_;
+  // Takes an idle Curl object. Creates one if none is idle, or waits for one if
+  // there is no |curl_factory_|.
+  std::unique_ptr<Curl> AcquireCurl();
+
+  // Returns |curl| to the idle Curl objects.
+  void ReleaseCurl(std::unique_ptr<Curl> curl);
+
+  const std::function<std::unique_ptr<Curl>()> curl_factory_;
+  const std::unique_ptr<CurlMulti> curl_multi_;
+  const std::string ca_cert_filename_;
+
+  absl::Mutex mu_;
+  std::vector<std::unique_ptr<Curl>> idle_curls_ ABSL_GUARDED_BY(mu_);
 };
 
 }  // namespace asylo
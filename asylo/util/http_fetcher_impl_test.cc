@@ -23,6 +23,7 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include "absl/container/flat_hash_set.h"
+#include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_split.h"
 #include "absl/strings/string_view.h"
@@ -280,6 +281,86 @@ TEST(HttpFetcherImplTest, Perform_Failure) {
   EXPECT_THAT(fetcher.Get(kUrl, {}), StatusIs(error::GoogleError::INTERNAL));
 }
 
+// Performs each transfer in turn.
+class FakeCurlMulti : public CurlMulti {
+ public:
+  std::vector<Status> Perform(const std::vector<Curl *> &curls) override {
+    ++perform_calls_;
+    std::vector<Status> results;
+    for (Curl *curl : curls) {
+      results.push_back(curl->Perform());
+    }
+    return results;
+  }
+
+  int perform_calls() const { return perform_calls_; }
+
+ private:
+  int perform_calls_ = 0;
+};
+
+TEST(HttpFetcherImplTest, ReusesCurl) {
+  constexpr char kRawResponse[] =
+      "HTTP/1.1 200 OK\r\n"
+      "\r\n"
+      "lorem ipsum dolor sit\r\n";
+  std::unique_ptr<FakeCurl> curl;
+  ASYLO_ASSERT_OK_AND_ASSIGN(curl, FakeCurl::Create(kRawResponse));
+  FakeCurl *curlptr = curl.get();
+  HttpFetcherImpl fetcher(std::move(curl), /*ca_cert_filename=*/"");
+  HttpFetcher::HttpResponse response;
+  ASYLO_ASSERT_OK_AND_ASSIGN(response, fetcher.Get("http://lorem.ipsum", {}));
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      response, fetcher.Get("http://dolor.sit", {{"Accept", "text/plain"},
+                                                 {"Custom-Header", "test"}}));
+
+  EXPECT_THAT(curlptr->last_url(), Eq("http://dolor.sit"));
+  EXPECT_THAT(response.body, Eq("lorem ipsum dolor sit\r\n"));
+}
+
+TEST(HttpFetcherImplTest, GetMany) {
+  constexpr char kRawResponse[] =
+      "HTTP/1.1 200 OK\r\n"
+      "\r\n"
+      "lorem ipsum dolor sit\r\n";
+  std::vector<FakeCurl *> curls;
+  auto curl_multi = absl::make_unique<FakeCurlMulti>();
+  FakeCurlMulti *curl_multi_ptr = curl_multi.get();
+  HttpFetcherImpl fetcher(
+      [&curls, kRawResponse]() -> std::unique_ptr<Curl> {
+        std::unique_ptr<FakeCurl> curl =
+            FakeCurl::Create(kRawResponse).ValueOrDie();
+        if (curls.size() == 1) {
+          curl->set_perform_failure();
+        }
+        curls.push_back(curl.get());
+        return std::move(curl);
+      },
+      std::move(curl_multi), /*ca_cert_filename=*/"");
+
+  std::vector<StatusOr<HttpFetcher::HttpResponse>> responses =
+      fetcher.GetMany({{"http://lorem.ipsum", {}},
+                       {"http://dolor.sit", {}},
+                       {"http://amet.consectetur", {{"Custom-Header", "test"}}}});
+
+  EXPECT_THAT(curl_multi_ptr->perform_calls(), Eq(1));
+  ASSERT_THAT(curls.size(), Eq(3));
+  EXPECT_THAT(curls[0]->last_url(), Eq("http://lorem.ipsum"));
+  EXPECT_THAT(curls[1]->last_url(), Eq("http://dolor.sit"));
+  EXPECT_THAT(curls[2]->last_url(), Eq("http://amet.consectetur"));
+  ASSERT_THAT(responses.size(), Eq(3));
+  ASSERT_THAT(responses[0], IsOk());
+  EXPECT_THAT(responses[0].ValueOrDie().body, Eq("lorem ipsum dolor sit\r\n"));
+  EXPECT_THAT(responses[1], StatusIs(error::GoogleError::INTERNAL));
+  ASSERT_THAT(responses[2], IsOk());
+  EXPECT_THAT(responses[2].ValueOrDie().status_code, Eq(200));
+
+  // Idle Curl objects are reused rather than created anew.
+  HttpFetcher::HttpResponse response;
+  ASYLO_ASSERT_OK_AND_ASSIGN(response, fetcher.Get("http://lorem.ipsum", {}));
+  EXPECT_THAT(curls.size(), Eq(3));
+}
+
 class HttpFetcherImplSetOptErrorTest
     : public ::testing::Test,
       public ::testing::WithParamInterface<CURLoption> {};
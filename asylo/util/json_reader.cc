@@ -0,0 +1,426 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/util/json_reader.h"
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "asylo/util/status_macros.h"
+
+namespace asylo {
+namespace {
+
+// Returns the value of the hex digit |c|, or -1 if it is not one.
+int HexDigitValue(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+// Appends the UTF-8 encoding of |code_point| to |output|.
+void AppendUtf8(uint32_t code_point, std::string *output) {
+  if (code_point < 0x80) {
+    output->push_back(static_cast<char>(code_point));
+  } else if (code_point < 0x800) {
+    output->push_back(static_cast<char>(0xc0 | (code_point >> 6)));
+    output->push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+  } else if (code_point < 0x10000) {
+    output->push_back(static_cast<char>(0xe0 | (code_point >> 12)));
+    output->push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3f)));
+    output->push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+  } else {
+    output->push_back(static_cast<char>(0xf0 | (code_point >> 18)));
+    output->push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3f)));
+    output->push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3f)));
+    output->push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+  }
+}
+
+bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+
+}  // namespace
+
+constexpr size_t JsonReader::kMaxDepth;
+
+JsonReader::JsonReader(absl::string_view json) : json_(json) {}
+
+StatusOr<JsonType> JsonReader::PeekType() {
+  SkipWhitespace();
+  if (position_ == json_.size()) {
+    return Error("Unexpected end of JSON, expected a value");
+  }
+  switch (json_[position_]) {
+    case '{':
+      return JsonType::kObject;
+    case '[':
+      return JsonType::kArray;
+    case '"':
+      return JsonType::kString;
+    case 't':
+    case 'f':
+      return JsonType::kBoolean;
+    case 'n':
+      return JsonType::kNull;
+    default:
+      if (json_[position_] == '-' || IsDigit(json_[position_])) {
+        return JsonType::kNumber;
+      }
+      return Error("Unexpected character, expected a value");
+  }
+}
+
+Status JsonReader::BeginObject() {
+  JsonType type;
+  ASYLO_ASSIGN_OR_RETURN(type, PeekType());
+  if (type != JsonType::kObject) {
+    return Error("JSON value is not an object");
+  }
+  if (first_in_container_.size() == kMaxDepth) {
+    return Error("JSON nesting is too deep");
+  }
+  ++position_;
+  first_in_container_.push_back(true);
+  return Status::OkStatus();
+}
+
+StatusOr<bool> JsonReader::NextField(std::string *name) {
+  bool has_field;
+  ASYLO_ASSIGN_OR_RETURN(has_field, NextInContainer('}'));
+  if (!has_field) {
+    return false;
+  }
+  SkipWhitespace();
+  if (position_ == json_.size() || json_[position_] != '"') {
+    return Error("Expected the name of a field");
+  }
+  name->clear();
+  ASYLO_RETURN_IF_ERROR(ParseString(name));
+  ASYLO_RETURN_IF_ERROR(Expect(':', "after the name of a field"));
+  return true;
+}
+
+Status JsonReader::BeginArray() {
+  JsonType type;
+  ASYLO_ASSIGN_OR_RETURN(type, PeekType());
+  if (type != JsonType::kArray) {
+    return Error("JSON value is not an array");
+  }
+  if (first_in_container_.size() == kMaxDepth) {
+    return Error("JSON nesting is too deep");
+  }
+  ++position_;
+  first_in_container_.push_back(true);
+  return Status::OkStatus();
+}
+
+StatusOr<bool> JsonReader::NextElement() { return NextInContainer(']'); }
+
+StatusOr<std::string> JsonReader::ReadString() {
+  JsonType type;
+  ASYLO_ASSIGN_OR_RETURN(type, PeekType());
+  if (type != JsonType::kString) {
+    return Error("JSON value is not a string");
+  }
+  std::string value;
+  ASYLO_RETURN_IF_ERROR(ParseString(&value));
+  return value;
+}
+
+StatusOr<double> JsonReader::ReadNumber() {
+  JsonType type;
+  ASYLO_ASSIGN_OR_RETURN(type, PeekType());
+  if (type != JsonType::kNumber) {
+    return Error("JSON value is not a number");
+  }
+  double value;
+  ASYLO_RETURN_IF_ERROR(ParseNumber(&value));
+  return value;
+}
+
+StatusOr<absl::string_view> JsonReader::ReadRawValue() {
+  SkipWhitespace();
+  size_t start = position_;
+  ASYLO_RETURN_IF_ERROR(SkipValueAtDepth(first_in_container_.size()));
+  return json_.substr(start, position_ - start);
+}
+
+Status JsonReader::SkipValue() { return ReadRawValue().status(); }
+
+Status JsonReader::Finish() {
+  if (!first_in_container_.empty()) {
+    return Error("Unexpected end of JSON, expected the end of a container");
+  }
+  SkipWhitespace();
+  if (position_ != json_.size()) {
+    return Error("Unexpected characters after the JSON value");
+  }
+  return Status::OkStatus();
+}
+
+void JsonReader::SkipWhitespace() {
+  while (position_ < json_.size() &&
+         (json_[position_] == ' ' || json_[position_] == '\t' ||
+          json_[position_] == '\n' || json_[position_] == '\r')) {
+    ++position_;
+  }
+}
+
+Status JsonReader::Expect(char c, absl::string_view context) {
+  SkipWhitespace();
+  if (position_ == json_.size() || json_[position_] != c) {
+    return Error(absl::StrCat("Expected '", absl::string_view(&c, 1), "' ",
+                              context));
+  }
+  ++position_;
+  return Status::OkStatus();
+}
+
+StatusOr<bool> JsonReader::NextInContainer(char close) {
+  if (first_in_container_.empty()) {
+    return Error("Not inside a JSON object or array");
+  }
+  SkipWhitespace();
+  if (position_ < json_.size() && json_[position_] == close) {
+    ++position_;
+    first_in_container_.pop_back();
+    return false;
+  }
+  if (first_in_container_.back()) {
+    first_in_container_.back() = false;
+  } else {
+    ASYLO_RETURN_IF_ERROR(Expect(',', "between values"));
+  }
+  return true;
+}
+
+Status JsonReader::ParseString(std::string *value) {
+  // Skip the opening quotation mark.
+  ++position_;
+  while (true) {
+    // Copy the longest run of characters which need no unescaping at once.
+    size_t run_end = position_;
+    while (run_end < json_.size() && json_[run_end] != '"' &&
+           json_[run_end] != '\\' &&
+           static_cast<unsigned char>(json_[run_end]) >= 0x20) {
+      ++run_end;
+    }
+    value->append(json_.data() + position_, run_end - position_);
+    position_ = run_end;
+
+    if (position_ == json_.size()) {
+      return Error("Unterminated JSON string");
+    }
+    char c = json_[position_++];
+    if (c == '"') {
+      return Status::OkStatus();
+    }
+    if (c != '\\') {
+      return Error("Unescaped control character in JSON string");
+    }
+    if (position_ == json_.size()) {
+      return Error("Unterminated JSON string");
+    }
+    c = json_[position_++];
+    switch (c) {
+      case '"':
+      case '\\':
+      case '/':
+        value->push_back(c);
+        break;
+      case 'b':
+        value->push_back('\b');
+        break;
+      case 'f':
+        value->push_back('\f');
+        break;
+      case 'n':
+        value->push_back('\n');
+        break;
+      case 'r':
+        value->push_back('\r');
+        break;
+      case 't':
+        value->push_back('\t');
+        break;
+      case 'u': {
+        uint32_t code_point = 0;
+        for (int escape = 0; escape < 2; ++escape) {
+          uint32_t code_unit = 0;
+          for (int i = 0; i < 4; ++i) {
+            int digit = position_ < json_.size()
+                            ? HexDigitValue(json_[position_++])
+                            : -1;
+            if (digit < 0) {
+              return Error("Invalid \\u escape in JSON string");
+            }
+            code_unit = (code_unit << 4) | digit;
+          }
+          if (escape == 0) {
+            if (code_unit >= 0xdc00 && code_unit <= 0xdfff) {
+              return Error("Unpaired surrogate in JSON string");
+            }
+            code_point = code_unit;
+            if (code_unit < 0xd800 || code_unit > 0xdbff) {
+              break;
+            }
+            // A high surrogate must be followed by an escaped low surrogate.
+            if (json_.substr(position_, 2) != "\\u") {
+              return Error("Unpaired surrogate in JSON string");
+            }
+            position_ += 2;
+          } else {
+            if (code_unit < 0xdc00 || code_unit > 0xdfff) {
+              return Error("Unpaired surrogate in JSON string");
+            }
+            code_point =
+                0x10000 + ((code_point - 0xd800) << 10) + (code_unit - 0xdc00);
+          }
+        }
+        AppendUtf8(code_point, value);
+        break;
+      }
+      default:
+        return Error("Invalid escape sequence in JSON string");
+    }
+  }
+}
+
+Status JsonReader::ParseNumber(double *value) {
+  // Validate the number against the JSON grammar, which is stricter than the
+  // one of the conversion below.
+  size_t start = position_;
+  if (json_[position_] == '-') {
+    ++position_;
+  }
+  if (position_ < json_.size() && json_[position_] == '0') {
+    ++position_;
+  } else if (position_ < json_.size() && IsDigit(json_[position_])) {
+    while (position_ < json_.size() && IsDigit(json_[position_])) {
+      ++position_;
+    }
+  } else {
+    return Error("Invalid JSON number");
+  }
+  if (position_ < json_.size() && json_[position_] == '.') {
+    ++position_;
+    if (position_ == json_.size() || !IsDigit(json_[position_])) {
+      return Error("Invalid JSON number");
+    }
+    while (position_ < json_.size() && IsDigit(json_[position_])) {
+      ++position_;
+    }
+  }
+  if (position_ < json_.size() &&
+      (json_[position_] == 'e' || json_[position_] == 'E')) {
+    ++position_;
+    if (position_ < json_.size() &&
+        (json_[position_] == '+' || json_[position_] == '-')) {
+      ++position_;
+    }
+    if (position_ == json_.size() || !IsDigit(json_[position_])) {
+      return Error("Invalid JSON number");
+    }
+    while (position_ < json_.size() && IsDigit(json_[position_])) {
+      ++position_;
+    }
+  }
+
+  if (!absl::SimpleAtod(json_.substr(start, position_ - start), value) ||
+      !std::isfinite(*value)) {
+    return Error("JSON number is out of range");
+  }
+  return Status::OkStatus();
+}
+
+Status JsonReader::ParseLiteral(absl::string_view literal) {
+  if (json_.substr(position_, literal.size()) != literal) {
+    return Error("Invalid JSON literal");
+  }
+  position_ += literal.size();
+  return Status::OkStatus();
+}
+
+Status JsonReader::SkipValueAtDepth(size_t depth) {
+  JsonType type;
+  ASYLO_ASSIGN_OR_RETURN(type, PeekType());
+  switch (type) {
+    case JsonType::kObject:
+    case JsonType::kArray: {
+      if (depth == kMaxDepth) {
+        return Error("JSON nesting is too deep");
+      }
+      bool is_object = type == JsonType::kObject;
+      char close = is_object ? '}' : ']';
+      ++position_;
+      bool first = true;
+      while (true) {
+        SkipWhitespace();
+        if (position_ < json_.size() && json_[position_] == close) {
+          ++position_;
+          return Status::OkStatus();
+        }
+        if (!first) {
+          ASYLO_RETURN_IF_ERROR(Expect(',', "between values"));
+        }
+        first = false;
+        if (is_object) {
+          SkipWhitespace();
+          if (position_ == json_.size() || json_[position_] != '"') {
+            return Error("Expected the name of a field");
+          }
+          std::string name;
+          ASYLO_RETURN_IF_ERROR(ParseString(&name));
+          ASYLO_RETURN_IF_ERROR(Expect(':', "after the name of a field"));
+        }
+        ASYLO_RETURN_IF_ERROR(SkipValueAtDepth(depth + 1));
+      }
+    }
+    case JsonType::kString: {
+      std::string value;
+      return ParseString(&value);
+    }
+    case JsonType::kNumber: {
+      double value;
+      return ParseNumber(&value);
+    }
+    case JsonType::kBoolean:
+      return ParseLiteral(json_[position_] == 't' ? "true" : "false");
+    case JsonType::kNull:
+      return ParseLiteral("null");
+  }
+  return Error("Unexpected JSON value");
+}
+
+Status JsonReader::Error(absl::string_view message) const {
+  return Status(error::GoogleError::INVALID_ARGUMENT,
+                absl::StrCat(message, " at offset ", position_));
+}
+
+}  // namespace asylo
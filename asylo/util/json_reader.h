@@ -0,0 +1,121 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_UTIL_JSON_READER_H_
+#define ASYLO_UTIL_JSON_READER_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "asylo/util/status.h"
+#include "asylo/util/statusor.h"
+
+namespace asylo {
+
+// The types of JSON values.
+enum class JsonType { kObject, kArray, kString, kNumber, kBoolean, kNull };
+
+// A reader which decodes a JSON text (RFC 8259) in a single pass, one value at
+// a time, without building a tree of its values. It is intended for decoders of
+// JSON documents with a known schema, which read each value straight into its
+// destination, and skip the values they do not recognize. The caller reads the
+// values in the order in which they appear: for instance, an object is read by
+// calling BeginObject, then NextField followed by a read of the field's value
+// until NextField returns false, and a whole document is followed by a call to
+// Finish.
+//
+// All errors, including type mismatches, are INVALID_ARGUMENT errors. After an
+// error, the reader must not be used anymore.
+//
+// The reader does not copy the text, which must outlive it.
+class JsonReader {
+ public:
+  explicit JsonReader(absl::string_view json);
+
+  JsonReader(const JsonReader &other) = delete;
+  JsonReader &operator=(const JsonReader &other) = delete;
+
+  // Returns the type of the next value, without consuming it.
+  StatusOr<JsonType> PeekType();
+
+  // Consumes the start of an object. Its fields are then read with NextField.
+  Status BeginObject();
+
+  // Consumes the name of the next field of the current object into |name|, and
+  // returns true. The value of the field must be consumed next. Returns false
+  // and consumes the end of the object if it has no more fields.
+  StatusOr<bool> NextField(std::string *name);
+
+  // Consumes the start of an array. Its elements are then read with
+  // NextElement.
+  Status BeginArray();
+
+  // Returns true if the current array has another element, which must be
+  // consumed next. Returns false and consumes the end of the array otherwise.
+  StatusOr<bool> NextElement();
+
+  // Consumes a string value and returns it unescaped.
+  StatusOr<std::string> ReadString();
+
+  // Consumes a number value.
+  StatusOr<double> ReadNumber();
+
+  // Consumes a value of any type, and returns its text as it appears in the
+  // input.
+  StatusOr<absl::string_view> ReadRawValue();
+
+  // Consumes a value of any type.
+  Status SkipValue();
+
+  // Verifies that the whole input was consumed, except for whitespace.
+  Status Finish();
+
+ private:
+  // The maximum nesting of objects and arrays, which also bounds the recursion
+  // of SkipValue.
+  static constexpr size_t kMaxDepth = 100;
+
+  void SkipWhitespace();
+
+  // Skips whitespace and consumes |c|, or returns an error naming |context|.
+  Status Expect(char c, absl::string_view context);
+
+  // Consumes the value separator before the next field or element of the
+  // current container, unless it is the first one. Returns false and consumes
+  // the end of the container if it ends with |close|.
+  StatusOr<bool> NextInContainer(char close);
+
+  Status ParseString(std::string *value);
+  Status ParseNumber(double *value);
+  Status ParseLiteral(absl::string_view literal);
+  Status SkipValueAtDepth(size_t depth);
+
+  Status Error(absl::string_view message) const;
+
+  const absl::string_view json_;
+  size_t position_ = 0;
+
+  // Whether the next field or element of each open container is its first.
+  std::vector<bool> first_in_container_;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_UTIL_JSON_READER_H_
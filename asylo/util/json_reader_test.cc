@@ -0,0 +1,154 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/util/json_reader.h"
+
+#include <string>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/strings/str_cat.h"
+#include "asylo/test/util/status_matchers.h"
+#include "asylo/util/status.h"
+
+namespace asylo {
+namespace {
+
+using ::testing::Eq;
+using ::testing::IsFalse;
+using ::testing::IsTrue;
+
+TEST(JsonReaderTest, ReadsNestedValues) {
+  JsonReader reader(
+      R"json( {"name": "value", "list": [1, -2.5e2], "empty": {}} )json");
+  std::string name;
+  ASSERT_THAT(reader.BeginObject(), IsOk());
+
+  EXPECT_THAT(reader.NextField(&name), IsOkAndHolds(IsTrue()));
+  EXPECT_THAT(name, Eq("name"));
+  EXPECT_THAT(reader.ReadString(), IsOkAndHolds("value"));
+
+  EXPECT_THAT(reader.NextField(&name), IsOkAndHolds(IsTrue()));
+  EXPECT_THAT(name, Eq("list"));
+  ASSERT_THAT(reader.BeginArray(), IsOk());
+  EXPECT_THAT(reader.NextElement(), IsOkAndHolds(IsTrue()));
+  EXPECT_THAT(reader.ReadNumber(), IsOkAndHolds(1.));
+  EXPECT_THAT(reader.NextElement(), IsOkAndHolds(IsTrue()));
+  EXPECT_THAT(reader.ReadNumber(), IsOkAndHolds(-250.));
+  EXPECT_THAT(reader.NextElement(), IsOkAndHolds(IsFalse()));
+
+  EXPECT_THAT(reader.NextField(&name), IsOkAndHolds(IsTrue()));
+  EXPECT_THAT(name, Eq("empty"));
+  ASSERT_THAT(reader.BeginObject(), IsOk());
+  EXPECT_THAT(reader.NextField(&name), IsOkAndHolds(IsFalse()));
+
+  EXPECT_THAT(reader.NextField(&name), IsOkAndHolds(IsFalse()));
+  EXPECT_THAT(reader.Finish(), IsOk());
+}
+
+TEST(JsonReaderTest, UnescapesStrings) {
+  JsonReader reader(R"json("a\"\\\/\b\f\n\r\t\u00e9\u20ac\ud83d\ude00")json");
+  EXPECT_THAT(reader.ReadString(),
+              IsOkAndHolds("a\"\\/\b\f\n\r\t"
+                           "\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80"));
+  EXPECT_THAT(reader.Finish(), IsOk());
+}
+
+TEST(JsonReaderTest, RejectsInvalidStrings) {
+  for (const char *json :
+       {R"json("unterminated)json", R"json("\x")json", R"json("\u12")json",
+        R"json("\ud83d")json", R"json("\ude00")json", "\"\n\""}) {
+    JsonReader reader(json);
+    EXPECT_THAT(reader.ReadString(),
+                StatusIs(error::GoogleError::INVALID_ARGUMENT))
+        << json;
+  }
+}
+
+TEST(JsonReaderTest, RejectsInvalidNumbers) {
+  for (const char *json : {"-", "01", "1.", ".5", "1e", "1e+", "1e999"}) {
+    JsonReader reader(json);
+    Status status = reader.ReadNumber().status();
+    if (status.ok()) {
+      status = reader.Finish();
+    }
+    EXPECT_THAT(status, StatusIs(error::GoogleError::INVALID_ARGUMENT)) << json;
+  }
+}
+
+TEST(JsonReaderTest, RejectsMismatchedTypes) {
+  JsonReader reader(R"json(["string"])json");
+  EXPECT_THAT(reader.BeginObject(),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+  ASSERT_THAT(reader.BeginArray(), IsOk());
+  EXPECT_THAT(reader.NextElement(), IsOkAndHolds(IsTrue()));
+  EXPECT_THAT(reader.ReadNumber(),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+}
+
+TEST(JsonReaderTest, RejectsMalformedContainers) {
+  for (const char *json : {R"json({"a": 1,})json", R"json({"a" 1})json",
+                           R"json({1: 1})json", R"json({"a": 1 "b": 2})json",
+                           R"json({"a": 1)json"}) {
+    JsonReader reader(json);
+    Status status = reader.BeginObject();
+    std::string name;
+    while (status.ok()) {
+      auto has_field = reader.NextField(&name);
+      status = has_field.status();
+      if (!status.ok() || !has_field.ValueOrDie()) {
+        break;
+      }
+      status = reader.SkipValue();
+    }
+    EXPECT_THAT(status, StatusIs(error::GoogleError::INVALID_ARGUMENT))
+        << json;
+  }
+}
+
+TEST(JsonReaderTest, ReadsRawValues) {
+  JsonReader reader(
+      R"json({"skipped": [true, false, null, {"a": "]"}], "next": 1})json");
+  std::string name;
+  ASSERT_THAT(reader.BeginObject(), IsOk());
+  EXPECT_THAT(reader.NextField(&name), IsOkAndHolds(IsTrue()));
+  EXPECT_THAT(reader.ReadRawValue(),
+              IsOkAndHolds(R"json([true, false, null, {"a": "]"}])json"));
+  EXPECT_THAT(reader.NextField(&name), IsOkAndHolds(IsTrue()));
+  EXPECT_THAT(name, Eq("next"));
+  EXPECT_THAT(reader.ReadNumber(), IsOkAndHolds(1.));
+  EXPECT_THAT(reader.NextField(&name), IsOkAndHolds(IsFalse()));
+  EXPECT_THAT(reader.Finish(), IsOk());
+}
+
+TEST(JsonReaderTest, RejectsTrailingCharacters) {
+  JsonReader reader("1 2");
+  EXPECT_THAT(reader.ReadNumber(), IsOkAndHolds(1.));
+  EXPECT_THAT(reader.Finish(), StatusIs(error::GoogleError::INVALID_ARGUMENT));
+}
+
+TEST(JsonReaderTest, RejectsDeepNesting) {
+  std::string json =
+      absl::StrCat(std::string(1000, '['), std::string(1000, ']'));
+  JsonReader reader(json);
+  EXPECT_THAT(reader.SkipValue(),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+}
+
+}  // namespace
+}  // namespace asylo
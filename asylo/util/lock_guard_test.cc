@@ -25,6 +25,7 @@
 #include "absl/synchronization/mutex.h"
 #include "asylo/platform/core/trusted_mutex.h"
 #include "asylo/platform/core/trusted_spin_lock.h"
+#include "asylo/platform/core/trusted_ticket_lock.h"
 #include "asylo/util/thread.h"
 
 namespace asylo {
@@ -127,7 +128,8 @@ TYPED_TEST_P(OneArgLockGuardTest, OneArgOneLockRecursive) {
 REGISTER_TYPED_TEST_SUITE_P(OneArgLockGuardTest, OneArgOneLockRecursive,
                             OneArgOneLockNonrecursive);
 
-typedef testing::Types<TrustedMutex, TrustedSpinLock> OneArgLockTypes;
+typedef testing::Types<TrustedMutex, TrustedSpinLock,
+                       TrustedTicketLock> OneArgLockTypes;
 INSTANTIATE_TYPED_TEST_SUITE_P(LockGuardAllLocksTest, OneArgLockGuardTest,
                                OneArgLockTypes);
 
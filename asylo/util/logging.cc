@@ -25,13 +25,18 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <atomic>
 #include <cctype>
 #include <cstdio>
 #include <cstdlib>
 #include <ctime>
+#include <initializer_list>
 #include <sstream>
 #include <string>
 
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+
 namespace asylo {
 
 #ifdef __ASYLO__
@@ -42,6 +47,12 @@ constexpr bool kInsideEnclave = false;
 
 constexpr char kDefaultDirectory[] = "/tmp/";
 
+namespace logging_internal {
+
+std::atomic<int> vlog_level(0);
+
+}  // namespace logging_internal
+
 namespace {
 
 // The logging directory, specified at the time the enclave is initialized.
@@ -51,10 +62,6 @@ std::string *log_file_directory = nullptr;
 // enclave name (enclave log).
 std::string *log_basename = nullptr;
 
-// The VLOG level, only VLOG with level equal to or below this level is logged,
-// specified at the time the enclave is initialized.
-int vlog_level = 0;
-
 // A flag to ensure that LOG(FATAL) doesn't lead to an infinite loop of
 // failures.
 thread_local bool log_panic = false;
@@ -89,8 +96,141 @@ const std::string get_log_basename() {
   return *log_basename;
 }
 
+// Buffered records are written once they take this many bytes...
+constexpr size_t kLogBufferFlushSize = 64 * 1024;
+
+// ...or once the oldest of them is this many seconds old.
+constexpr int64_t kLogBufferFlushAgeSeconds = 1;
+
+// A log file, which is kept open across records. Inside an enclave, where
+// every write to it is a host call, records below ERROR severity are buffered
+// and written in batches.
+struct LogFile {
+  explicit LogFile(const char *suffix) : suffix(suffix) {}
+
+  // Appended to the log path to name this file.
+  const char *const suffix;
+
+  absl::Mutex mu;
+  int fd ABSL_GUARDED_BY(mu) = -1;
+  std::string path ABSL_GUARDED_BY(mu);
+  std::string buffer ABSL_GUARDED_BY(mu);
+
+  // Time of the oldest record in |buffer| that has a time, or 0 if none has.
+  int64_t buffer_start ABSL_GUARDED_BY(mu) = 0;
+
+  // If set, returns the bytes to write each time the file is opened.
+  std::string (*file_header)() ABSL_GUARDED_BY(mu) = nullptr;
+};
+
+// The log file of text records.
+LogFile *GetLogFile() {
+  static LogFile *log_file = new LogFile("");
+  return log_file;
+}
+
+// The log file of binary records, see binary_log.h.
+LogFile *GetBinaryLogFile() {
+  static LogFile *log_file = new LogFile(".blog");
+  return log_file;
+}
+
+bool WriteFully(int fd, const char *data, size_t size) {
+  while (size > 0) {
+    ssize_t written = write(fd, data, size);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data += written;
+    size -= written;
+  }
+  return true;
+}
+
+// Writes the buffered records to the log file, opening it if needed.
+void FlushLogFile(LogFile *log_file)
+    ABSL_EXCLUSIVE_LOCKS_REQUIRED(log_file->mu) {
+  if (log_file->buffer.empty()) {
+    return;
+  }
+  std::string log_path =
+      get_log_directory() + get_log_basename() + log_file->suffix;
+  if (log_file->fd >= 0 && log_file->path != log_path) {
+    close(log_file->fd);
+    log_file->fd = -1;
+  }
+  if (log_file->fd < 0) {
+    log_file->fd = open(log_path.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0666);
+    log_file->path = log_path;
+    if (log_file->fd >= 0 && log_file->file_header) {
+      log_file->buffer.insert(0, log_file->file_header());
+    }
+  }
+  if (log_file->fd < 0) {
+    fprintf(stderr, "Failed to open log file : %s!\n", log_path.c_str());
+  } else if (!WriteFully(log_file->fd, log_file->buffer.data(),
+                         log_file->buffer.size())) {
+    fprintf(stderr, "Failed to write to log file : %s!\n", log_path.c_str());
+  }
+  log_file->buffer.clear();
+  log_file->buffer_start = 0;
+}
+
+// Appends |record|, logged at |record_time| in seconds since the Epoch or at 0
+// if it has no time, to |log_file|, or to its buffer of records to write. The
+// age of the buffer is measured with the times of its records, which callers
+// read anyway, so that appending does not read the clock again.
+void AppendToLogFile(LogFile *log_file, const std::string &record,
+                     int64_t record_time, bool flush) {
+  absl::MutexLock lock(&log_file->mu);
+  if (log_file->buffer_start == 0) {
+    log_file->buffer_start = record_time;
+  }
+  log_file->buffer.append(record);
+  if (flush || log_file->buffer.size() >= kLogBufferFlushSize ||
+      (record_time != 0 &&
+       record_time - log_file->buffer_start >= kLogBufferFlushAgeSeconds)) {
+    FlushLogFile(log_file);
+  }
+}
+
 }  // namespace
 
+namespace logging_internal {
+
+void AppendToBinaryLog(const std::string &record, int64_t record_time,
+                       bool flush, std::string (*file_header)()) {
+  LogFile *log_file = GetBinaryLogFile();
+  {
+    absl::MutexLock lock(&log_file->mu);
+    log_file->file_header = file_header;
+  }
+  AppendToLogFile(log_file, record, record_time, !kInsideEnclave || flush);
+}
+
+}  // namespace logging_internal
+
+void FlushLogs() {
+  for (LogFile *log_file : {GetLogFile(), GetBinaryLogFile()}) {
+    absl::MutexLock lock(&log_file->mu);
+    FlushLogFile(log_file);
+  }
+}
+
+void ReopenLogFile() {
+  for (LogFile *log_file : {GetLogFile(), GetBinaryLogFile()}) {
+    absl::MutexLock lock(&log_file->mu);
+    FlushLogFile(log_file);
+    if (log_file->fd >= 0) {
+      close(log_file->fd);
+      log_file->fd = -1;
+    }
+  }
+}
+
 bool set_log_directory(const std::string &log_directory) {
   std::string tmp_directory = log_directory;
   if (tmp_directory.empty()) {
@@ -114,9 +254,13 @@ const std::string get_log_directory() {
   return *log_file_directory;
 }
 
-void set_vlog_level(int level) { vlog_level = level; }
+void set_vlog_level(int level) {
+  logging_internal::vlog_level.store(level, std::memory_order_relaxed);
+}
 
-int get_vlog_level() { return vlog_level; }
+int get_vlog_level() {
+  return logging_internal::vlog_level.load(std::memory_order_relaxed);
+}
 
 bool EnsureDirectory(const char *path) {
   struct stat dirStat;
@@ -185,6 +329,7 @@ void LogMessage::Init(const char *file, int line, LogSeverity severity) {
   // level, filename, and line number.
   struct timespec time_stamp;
   clock_gettime(CLOCK_REALTIME, &time_stamp);
+  time_seconds_ = time_stamp.tv_sec;
 
   constexpr int kTimeMessageSize = 22;
   struct tm datetime;
@@ -217,21 +362,15 @@ LogMessageFatal::~LogMessageFatal() {
 }
 
 void LogMessage::SendToLog(const std::string &message_text) {
-  std::string log_path = get_log_directory() + get_log_basename();
-
-  FILE *file = fopen(log_path.c_str(), "ab");
-  if (file) {
-    if (fprintf(file, "%s", message_text.c_str()) > 0) {
-      if (message_text.back() != '\n') {
-        fprintf(file, "\n");
-      }
-    } else {
-      fprintf(stderr, "Failed to write to log file : %s!\n", log_path.c_str());
-    }
-    fclose(file);
-  } else {
-    fprintf(stderr, "Failed to open log file : %s!\n", log_path.c_str());
+  std::string record = message_text;
+  if (record.empty() || record.back() != '\n') {
+    record.push_back('\n');
   }
+  // Records that may precede a crash are written right away, together with
+  // any buffered ones.
+  AppendToLogFile(GetLogFile(), record, time_seconds_,
+                  /*flush=*/!kInsideEnclave || severity_ >= ERROR);
+
   if (severity_ >= ERROR) {
     fprintf(stderr, "%s\n", message_text.c_str());
     fflush(stderr);
@@ -19,6 +19,7 @@
 #ifndef ASYLO_UTIL_LOGGING_H_
 #define ASYLO_UTIL_LOGGING_H_
 
+#include <atomic>
 #include <cstdint>
 #include <cstdlib>
 #include <memory>
@@ -73,11 +74,40 @@
 #define LOG_IF(severity, condition) \
   !(condition) ? (void)0 : asylo::LogMessageVoidify() & LOG(severity)
 
+/// \cond Internal
+#ifndef ASYLO_MAX_VLOG_LEVEL
+/// The highest verbosity level that `VLOG` statements are compiled in for.
+/// Statements of a higher constant level compile to nothing, regardless of the
+/// level set at runtime. Builds may lower it with `-DASYLO_MAX_VLOG_LEVEL=n`.
+#define ASYLO_MAX_VLOG_LEVEL 2147483647
+#endif
+/// \endcond
+
+/// Evaluates to true if `VLOG` statements at verbosity `level` are logged.
+///
+/// Use it to guard work that is only needed for verbose logging:
+///
+/// ```
+/// if (VLOG_IS_ON(2)) {
+///   VLOG(2) << "Digest input: " << BytesToHexString(input);
+/// }
+/// ```
+///
+/// When the statement is disabled, this costs one predictable branch.
+///
+/// \param level The numeric level to check.
+#define VLOG_IS_ON(level)                                                      \
+  ((level) <= ASYLO_MAX_VLOG_LEVEL &&                                          \
+   ABSL_PREDICT_FALSE(                                                         \
+       (level) <= ::asylo::logging_internal::vlog_level.load(                  \
+                      std::memory_order_relaxed)))
+
 /// A `LOG` command with an associated verbosity level. The verbosity threshold
 /// may be configured at runtime with `set_vlog_level` and `InitLogging`.
 ///
 /// `VLOG` statements are logged at `INFO` severity if they are logged at all.
-/// The numeric levels are on a different scale than the severity levels.
+/// The numeric levels are on a different scale than the severity levels. The
+/// message is only built if the statement is logged.
 /// Example:
 ///
 /// ```
@@ -85,7 +115,7 @@
 /// ```
 ///
 /// \param level The numeric level that determines whether to log the message.
-#define VLOG(level) LOG_IF(INFO, (level) <= get_vlog_level())
+#define VLOG(level) LOG_IF(INFO, VLOG_IS_ON(level))
 
 /// Terminates the program with a fatal error if the specified condition is
 /// false.
@@ -281,6 +311,23 @@ inline uint64_t GetReferenceableValue(uint64_t t) { return t; }
 #define CHECK_NOTNULL(val) \
   asylo::CheckNotNull(__FILE__, __LINE__, "'" #val "' Must be non NULL", (val))
 
+/// \cond Internal
+namespace logging_internal {
+
+// The VLOG level, read inline by VLOG_IS_ON. Only VLOG with level equal to or
+// below this level is logged.
+extern std::atomic<int> vlog_level;
+
+// Appends the binary log |record|, logged at |record_time| in seconds since the
+// Epoch or at 0 if it has no time, to the binary log file. Records are
+// buffered inside an enclave unless |flush| is true. Each time the file is
+// opened, |file_header()| is written to it before any record.
+void AppendToBinaryLog(const std::string &record, int64_t record_time,
+                       bool flush, std::string (*file_header)());
+
+}  // namespace logging_internal
+/// \endcond
+
 /// Sets the verbosity threshold for VLOG. A VLOG command with a level greater
 /// than this will be ignored.
 ///
@@ -326,6 +373,18 @@ bool EnsureDirectory(const char *path);
 ///        a level equal to or lower than it will be logged.
 bool InitLogging(const char *directory, const char *file_name, int level);
 
+/// Writes log records that are buffered but not yet in the log file.
+///
+/// Inside an enclave, records below `ERROR` severity are buffered and written
+/// in batches, at the latest when the enclave returns from an entry point.
+/// Records logged outside an enclave are never buffered.
+void FlushLogs();
+
+/// Flushes buffered log records and closes the log file, so that the next
+/// record is written to a newly-opened log file. Call this after the log file
+/// is rotated.
+void ReopenLogFile();
+
 /// Class representing a log message created by a log macro.
 class LogMessage {
  public:
@@ -364,6 +423,9 @@ class LogMessage {
 
   LogSeverity severity_;
 
+  // The time of the message, in seconds since the Epoch.
+  int64_t time_seconds_ = 0;
+
   // stream_ reads all the input messages into a stringstream, then it's
   // converted into a string in the destructor for printing.
   std::ostringstream stream_;
@@ -0,0 +1,167 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_UTIL_MPMC_QUEUE_H_
+#define ASYLO_UTIL_MPMC_QUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+
+namespace asylo {
+
+// A bounded multi-producer, multi-consumer queue which never takes a lock.
+//
+// Each slot of the ring carries a sequence number which tells producers and
+// consumers whose turn it is to use the slot. A thread claims a position with
+// a single compare-and-swap of the shared head or tail index, then hands the
+// slot over by publishing the next sequence number. Producers and consumers
+// only contend with their own kind, and only on the index they advance.
+//
+// The queue relies on nothing but std::atomic, so it may be used both inside
+// and outside an enclave. TryPush and TryPop never block; callers which need
+// to wait for space or elements should use an adaptor such as
+// BlockingMpmcQueue in asylo/platform/core.
+template <typename T>
+class MpmcQueue {
+ public:
+  // Creates an empty queue holding at least |capacity| elements. The capacity
+  // is rounded up to a power of two no smaller than two.
+  explicit MpmcQueue(size_t capacity)
+      : mask_(RoundUpCapacity(capacity) - 1), cells_(new Cell[mask_ + 1]) {
+    for (size_t i = 0; i <= mask_; ++i) {
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  // Destroys the elements left in the queue. Must not race with any other
+  // operation on the queue.
+  ~MpmcQueue() {
+    size_t end = enqueue_position_.load(std::memory_order_relaxed);
+    for (size_t position = dequeue_position_.load(std::memory_order_relaxed);
+         position != end; ++position) {
+      cells_[position & mask_].item()->~T();
+    }
+  }
+
+  MpmcQueue(const MpmcQueue &other) = delete;
+  MpmcQueue &operator=(const MpmcQueue &other) = delete;
+
+  // Appends |value| to the queue. Returns false without modifying |value| if
+  // the queue is full.
+  bool TryPush(const T &value) { return TryEmplace(value); }
+  bool TryPush(T &&value) { return TryEmplace(std::move(value)); }
+
+  // Constructs an element from |args| at the end of the queue. Returns false
+  // without consuming |args| if the queue is full.
+  template <typename... Args>
+  bool TryEmplace(Args &&... args) {
+    Cell *cell;
+    size_t position = enqueue_position_.load(std::memory_order_relaxed);
+    while (true) {
+      cell = &cells_[position & mask_];
+      size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      intptr_t difference = static_cast<intptr_t>(sequence) -
+                            static_cast<intptr_t>(position);
+      if (difference == 0) {
+        if (enqueue_position_.compare_exchange_weak(
+                position, position + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (difference < 0) {
+        // The slot still holds the element pushed one lap earlier.
+        return false;
+      } else {
+        position = enqueue_position_.load(std::memory_order_relaxed);
+      }
+    }
+    new (&cell->storage) T(std::forward<Args>(args)...);
+    cell->sequence.store(position + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Moves the element at the front of the queue into |value|. Returns false
+  // without modifying |value| if the queue is empty.
+  bool TryPop(T *value) {
+    Cell *cell;
+    size_t position = dequeue_position_.load(std::memory_order_relaxed);
+    while (true) {
+      cell = &cells_[position & mask_];
+      size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      intptr_t difference = static_cast<intptr_t>(sequence) -
+                            static_cast<intptr_t>(position + 1);
+      if (difference == 0) {
+        if (dequeue_position_.compare_exchange_weak(
+                position, position + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (difference < 0) {
+        // The slot has not been filled for this lap yet.
+        return false;
+      } else {
+        position = dequeue_position_.load(std::memory_order_relaxed);
+      }
+    }
+    T *item = cell->item();
+    *value = std::move(*item);
+    item->~T();
+    cell->sequence.store(position + mask_ + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Returns the number of elements the queue can hold.
+  size_t capacity() const { return mask_ + 1; }
+
+  // Returns true if the queue held no elements at some point during the call.
+  // The result may be stale by the time it is used.
+  bool IsEmptyApproximate() const {
+    return dequeue_position_.load(std::memory_order_acquire) ==
+           enqueue_position_.load(std::memory_order_acquire);
+  }
+
+ private:
+  struct Cell {
+    T *item() { return reinterpret_cast<T *>(&storage); }
+
+    std::atomic<size_t> sequence;
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+  };
+
+  static size_t RoundUpCapacity(size_t capacity) {
+    size_t rounded = 2;
+    while (rounded < capacity) {
+      rounded <<= 1;
+    }
+    return rounded;
+  }
+
+  const size_t mask_;
+  const std::unique_ptr<Cell[]> cells_;
+
+  // Producers and consumers advance different indices, so keep them on
+  // separate cache lines.
+  alignas(64) std::atomic<size_t> enqueue_position_{0};
+  alignas(64) std::atomic<size_t> dequeue_position_{0};
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_UTIL_MPMC_QUEUE_H_
@@ -0,0 +1,153 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/util/mpmc_queue.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace asylo {
+namespace {
+
+using ::testing::Eq;
+using ::testing::Pointee;
+
+constexpr int kNumProducers = 4;
+constexpr int kNumConsumers = 4;
+constexpr int kItemsPerProducer = 20000;
+
+TEST(MpmcQueueTest, RoundsCapacityUpToPowerOfTwo) {
+  EXPECT_THAT(MpmcQueue<int>(0).capacity(), Eq(2));
+  EXPECT_THAT(MpmcQueue<int>(2).capacity(), Eq(2));
+  EXPECT_THAT(MpmcQueue<int>(5).capacity(), Eq(8));
+  EXPECT_THAT(MpmcQueue<int>(64).capacity(), Eq(64));
+}
+
+TEST(MpmcQueueTest, PopsInPushOrder) {
+  MpmcQueue<int> queue(4);
+  EXPECT_TRUE(queue.IsEmptyApproximate());
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_TRUE(queue.TryPush(i));
+  }
+  EXPECT_FALSE(queue.IsEmptyApproximate());
+  for (int i = 0; i < 4; ++i) {
+    int value = -1;
+    ASSERT_TRUE(queue.TryPop(&value));
+    EXPECT_THAT(value, Eq(i));
+  }
+  EXPECT_TRUE(queue.IsEmptyApproximate());
+}
+
+TEST(MpmcQueueTest, FailsWhenFullOrEmpty) {
+  MpmcQueue<int> queue(2);
+  int value = 7;
+  EXPECT_FALSE(queue.TryPop(&value));
+  EXPECT_THAT(value, Eq(7));
+
+  EXPECT_TRUE(queue.TryPush(1));
+  EXPECT_TRUE(queue.TryPush(2));
+  EXPECT_FALSE(queue.TryPush(3));
+
+  // Wrap around the ring a few times.
+  for (int i = 3; i < 10; ++i) {
+    ASSERT_TRUE(queue.TryPop(&value));
+    EXPECT_THAT(value, Eq(i - 2));
+    EXPECT_TRUE(queue.TryPush(i));
+  }
+}
+
+TEST(MpmcQueueTest, FailedPushDoesNotConsumeValue) {
+  MpmcQueue<std::unique_ptr<int>> queue(2);
+  EXPECT_TRUE(queue.TryPush(std::unique_ptr<int>(new int(1))));
+  EXPECT_TRUE(queue.TryEmplace(new int(2)));
+
+  std::unique_ptr<int> value(new int(3));
+  EXPECT_FALSE(queue.TryPush(std::move(value)));
+  EXPECT_THAT(value, Pointee(3));
+
+  ASSERT_TRUE(queue.TryPop(&value));
+  EXPECT_THAT(value, Pointee(1));
+  ASSERT_TRUE(queue.TryPop(&value));
+  EXPECT_THAT(value, Pointee(2));
+}
+
+// Elements left in a queue are destroyed with it.
+TEST(MpmcQueueTest, DestroysRemainingElements) {
+  std::shared_ptr<int> value = std::make_shared<int>(1);
+  {
+    MpmcQueue<std::shared_ptr<int>> queue(4);
+    EXPECT_TRUE(queue.TryPush(value));
+    EXPECT_TRUE(queue.TryPush(value));
+    std::shared_ptr<int> popped;
+    ASSERT_TRUE(queue.TryPop(&popped));
+    popped.reset();
+    EXPECT_THAT(value.use_count(), Eq(2));
+  }
+  EXPECT_THAT(value.use_count(), Eq(1));
+}
+
+// Every element pushed by concurrent producers is popped exactly once by the
+// concurrent consumers.
+TEST(MpmcQueueTest, ConcurrentProducersAndConsumers) {
+  MpmcQueue<int> queue(64);
+  std::vector<std::atomic<int>> seen(kNumProducers * kItemsPerProducer);
+  for (auto &count : seen) {
+    count = 0;
+  }
+  std::atomic<int> popped{0};
+
+  std::vector<std::thread> threads;
+  for (int producer = 0; producer < kNumProducers; ++producer) {
+    threads.emplace_back([&queue, producer] {
+      for (int i = 0; i < kItemsPerProducer; ++i) {
+        while (!queue.TryPush(producer * kItemsPerProducer + i)) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  for (int consumer = 0; consumer < kNumConsumers; ++consumer) {
+    threads.emplace_back([&queue, &seen, &popped] {
+      int value;
+      while (popped.load() < kNumProducers * kItemsPerProducer) {
+        if (queue.TryPop(&value)) {
+          seen[value]++;
+          popped++;
+        } else {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  for (const auto &count : seen) {
+    EXPECT_THAT(count.load(), Eq(1));
+  }
+  EXPECT_TRUE(queue.IsEmptyApproximate());
+}
+
+}  // namespace
+}  // namespace asylo
@@ -20,7 +20,6 @@
 #define ASYLO_UTIL_MUTEX_GUARDED_H_
 
 #include <cassert>
-#include <functional>
 #include <type_traits>
 #include <utility>
 
@@ -32,10 +31,10 @@
 
 namespace asylo {
 
-template <typename T>
+template <typename T, typename MutexT = absl::Mutex>
 class LockView;
 
-template <typename T>
+template <typename T, typename MutexT = absl::Mutex>
 class ReaderLockView;
 
 // MutexGuarded<T> protects an object of type T with a mutex. MutexGuarded<T>
@@ -151,10 +150,22 @@ class ReaderLockView;
 // locking methods.
 //
 // The conditions passed to MutexGuarded<T>'s LockWhen() methods and the Await()
-// methods on the locked view objects have type std::function<bool(const T &)>,
-// rather than absl::Condition. The const T & argument in these functions is a
-// reference to the object guarded by a MutexGuarded<T>.
-template <typename T>
+// methods on the locked view objects are callables taking a const T &, rather
+// than absl::Condition. The const T & argument is a reference to the object
+// guarded by a MutexGuarded<T>. Any callable type is accepted as is, without
+// being wrapped in a std::function, so waiting on a condition does not allocate
+// and each evaluation of the condition is a direct call. The condition is only
+// called while its method runs, so it may capture locals by reference.
+//
+// The optional |MutexT| parameter replaces absl::Mutex by another mutex type
+// with the same locking API, such as ReadMostlyMutex for data that is rarely
+// written. The LockWhen() methods and the Await() methods on the locked view
+// objects are only available if |MutexT| supports absl::Condition like
+// absl::Mutex does:
+//
+//     MutexGuarded<Config, ReadMostlyMutex> config(LoadConfig());
+//     ReaderLockView<Config, ReadMostlyMutex> view = config.ReaderLock();
+template <typename T, typename MutexT = absl::Mutex>
 class MutexGuarded {
   static_assert(std::is_move_constructible<T>::value,
                 "T must be a move-constructible type");
@@ -184,7 +195,7 @@ class MutexGuarded {
   // Move assignment operator for MutexGuarded<T>. Does not move the mutex from
   // |other| into *this. Locks *this and |other| before moving.
   MutexGuarded &operator=(MutexGuarded &&other) ABSL_LOCKS_EXCLUDED(mu_) {
-    absl::MutexLock lock(&mu_);
+    LockView<T, MutexT> lock = Lock();
     value_ = other.Release();
     return *this;
   }
@@ -192,29 +203,29 @@ class MutexGuarded {
   // Releases ownership of the contained value to the caller. Exclusively locks
   // the contained mutex before doing so.
   T &&Release() ABSL_LOCKS_EXCLUDED(mu_) {
-    absl::MutexLock lock(&mu_);
+    LockView<T, MutexT> lock = Lock();
     return std::move(value_);
   }
 
   // Returns a smart pointer to the contained value. The smart pointer is also
   // an RAII writer lock on the contained mutex.
-  LockView<T> Lock() ABSL_LOCKS_EXCLUDED(mu_) {
+  LockView<T, MutexT> Lock() ABSL_LOCKS_EXCLUDED(mu_) {
     mu_.Lock();
-    return LockView<T>(&mu_, &value_);
+    return LockView<T, MutexT>(&mu_, &value_);
   }
 
   // Returns a read-only smart pointer to the contained value. The smart pointer
   // is also an RAII reader lock on the contained mutex.
-  ReaderLockView<T> ReaderLock() const ABSL_LOCKS_EXCLUDED(mu_) {
+  ReaderLockView<T, MutexT> ReaderLock() const ABSL_LOCKS_EXCLUDED(mu_) {
     mu_.ReaderLock();
-    return ReaderLockView<T>(&mu_, &value_);
+    return ReaderLockView<T, MutexT>(&mu_, &value_);
   }
 
   // Tries to acquire the contained mutex exclusively. If successful, behaves as
   // Lock(). Otherwise, returns absl::nullopt.
-  absl::optional<LockView<T>> TryLock() ABSL_LOCKS_EXCLUDED(mu_) {
+  absl::optional<LockView<T, MutexT>> TryLock() ABSL_LOCKS_EXCLUDED(mu_) {
     if (mu_.TryLock()) {
-      return LockView<T>(&mu_, &value_);
+      return LockView<T, MutexT>(&mu_, &value_);
     } else {
       return absl::nullopt;
     }
@@ -222,10 +233,10 @@ class MutexGuarded {
 
   // Tries to acquire a shared lock on the contained mutex. If successful,
   // behaves as ReaderLock(). Otherwise, returns absl::nullopt.
-  absl::optional<ReaderLockView<T>> ReaderTryLock() const
+  absl::optional<ReaderLockView<T, MutexT>> ReaderTryLock() const
       ABSL_LOCKS_EXCLUDED(mu_) {
     if (mu_.ReaderTryLock()) {
-      return ReaderLockView<T>(&mu_, &value_);
+      return ReaderLockView<T, MutexT>(&mu_, &value_);
     } else {
       return absl::nullopt;
     }
@@ -243,21 +254,22 @@ class MutexGuarded {
   // Returns a smart pointer to the contained value once |cond| is true and the
   // contained mutex can be acquired exclusively. The smart pointer is also an
   // RAII writer lock on the contained mutex.
-  LockView<T> LockWhen(std::function<bool(const T &)> cond)
-      ABSL_LOCKS_EXCLUDED(mu_) {
-    auto condition_function = [this, cond] { return cond(value_); };
+  template <typename Predicate>
+  LockView<T, MutexT> LockWhen(Predicate &&cond) ABSL_LOCKS_EXCLUDED(mu_) {
+    auto condition_function = [this, &cond] { return cond(value_); };
     mu_.LockWhen(absl::Condition(&condition_function));
-    return LockView<T>(&mu_, &value_);
+    return LockView<T, MutexT>(&mu_, &value_);
   }
 
   // Returns a smart pointer to the contained value once |cond| is true and the
   // contained mutex can be acquired in shared mode. The smart pointer is also
   // an RAII reader lock on the contained mutex.
-  ReaderLockView<T> ReaderLockWhen(std::function<bool(const T &)> cond) const
+  template <typename Predicate>
+  ReaderLockView<T, MutexT> ReaderLockWhen(Predicate &&cond) const
       ABSL_LOCKS_EXCLUDED(mu_) {
-    auto condition_function = [this, cond] { return cond(value_); };
+    auto condition_function = [this, &cond] { return cond(value_); };
     mu_.ReaderLockWhen(absl::Condition(&condition_function));
-    return ReaderLockView<T>(&mu_, &value_);
+    return ReaderLockView<T, MutexT>(&mu_, &value_);
   }
 
   // Returns a bool and a smart pointer to the contained value once the
@@ -271,13 +283,13 @@ class MutexGuarded {
   //
   // The returned smart pointer is also an RAII writer lock on the contained
   // mutex.
-  std::pair<bool, LockView<T>> LockWhenWithTimeout(
-      std::function<bool(const T &)> cond, absl::Duration timeout)
-      ABSL_LOCKS_EXCLUDED(mu_) {
-    auto condition_function = [this, cond] { return cond(value_); };
+  template <typename Predicate>
+  std::pair<bool, LockView<T, MutexT>> LockWhenWithTimeout(
+      Predicate &&cond, absl::Duration timeout) ABSL_LOCKS_EXCLUDED(mu_) {
+    auto condition_function = [this, &cond] { return cond(value_); };
     bool cond_is_true =
         mu_.LockWhenWithTimeout(absl::Condition(&condition_function), timeout);
-    return std::make_pair(cond_is_true, LockView<T>(&mu_, &value_));
+    return std::make_pair(cond_is_true, LockView<T, MutexT>(&mu_, &value_));
   }
 
   // Returns a bool and a smart pointer to the contained value once the
@@ -291,44 +303,48 @@ class MutexGuarded {
   //
   // The returned smart pointer is also an RAII reader lock on the contained
   // mutex.
-  std::pair<bool, ReaderLockView<T>> ReaderLockWhenWithTimeout(
-      std::function<bool(const T &)> cond, absl::Duration timeout) const
+  template <typename Predicate>
+  std::pair<bool, ReaderLockView<T, MutexT>> ReaderLockWhenWithTimeout(
+      Predicate &&cond, absl::Duration timeout) const
       ABSL_LOCKS_EXCLUDED(mu_) {
-    auto condition_function = [this, cond] { return cond(value_); };
+    auto condition_function = [this, &cond] { return cond(value_); };
     bool cond_is_true = mu_.ReaderLockWhenWithTimeout(
         absl::Condition(&condition_function), timeout);
-    return std::make_pair(cond_is_true, ReaderLockView<T>(&mu_, &value_));
+    return std::make_pair(cond_is_true,
+                          ReaderLockView<T, MutexT>(&mu_, &value_));
   }
 
   // As LockWhenWithTimeout(), but uses a deadline instead of a timeout.
-  std::pair<bool, LockView<T>> LockWhenWithDeadline(
-      std::function<bool(const T &)> cond, absl::Time deadline)
-      ABSL_LOCKS_EXCLUDED(mu_) {
-    auto condition_function = [this, cond] { return cond(value_); };
+  template <typename Predicate>
+  std::pair<bool, LockView<T, MutexT>> LockWhenWithDeadline(
+      Predicate &&cond, absl::Time deadline) ABSL_LOCKS_EXCLUDED(mu_) {
+    auto condition_function = [this, &cond] { return cond(value_); };
     bool cond_is_true = mu_.LockWhenWithDeadline(
         absl::Condition(&condition_function), deadline);
-    return std::make_pair(cond_is_true, LockView<T>(&mu_, &value_));
+    return std::make_pair(cond_is_true, LockView<T, MutexT>(&mu_, &value_));
   }
 
   // As ReaderLockWhenWithTimeout(), but uses a deadline instead of a timeout.
-  std::pair<bool, ReaderLockView<T>> ReaderLockWhenWithDeadline(
-      std::function<bool(const T &)> cond, absl::Time deadline) const
+  template <typename Predicate>
+  std::pair<bool, ReaderLockView<T, MutexT>> ReaderLockWhenWithDeadline(
+      Predicate &&cond, absl::Time deadline) const
       ABSL_LOCKS_EXCLUDED(mu_) {
-    auto condition_function = [this, cond] { return cond(value_); };
+    auto condition_function = [this, &cond] { return cond(value_); };
     bool cond_is_true = mu_.ReaderLockWhenWithDeadline(
         absl::Condition(&condition_function), deadline);
-    return std::make_pair(cond_is_true, ReaderLockView<T>(&mu_, &value_));
+    return std::make_pair(cond_is_true,
+                          ReaderLockView<T, MutexT>(&mu_, &value_));
   }
 
  private:
-  mutable absl::Mutex mu_;
+  mutable MutexT mu_;
   T value_ ABSL_GUARDED_BY(mu_);
 };
 
 // A writeable view of a mutex-guarded object of type T. The view object
 // maintains a writer lock on the guarding mutex during its lifetime. The view
 // object can be dereferenced to the guarded object.
-template <typename T>
+template <typename T, typename MutexT>
 class LockView {
  public:
   LockView() = delete;
@@ -372,8 +388,9 @@ class LockView {
 
   // Releases the lock on the referened mutex and reacquires it when |cond| is
   // true and the mutex can be acquired exclusively again.
-  void Await(std::function<bool(const T &)> cond) {
-    auto condition_function = [this, cond] { return cond(*value_); };
+  template <typename Predicate>
+  void Await(Predicate &&cond) {
+    auto condition_function = [this, &cond] { return cond(*value_); };
     mu_->Await(absl::Condition(&condition_function));
   }
 
@@ -385,25 +402,25 @@ class LockView {
   //
   // The returned bool indicates whether |cond| was true when the mutex was
   // reacquired.
-  bool AwaitWithTimeout(std::function<bool(const T &)> cond,
-                        absl::Duration timeout) {
-    auto condition_function = [this, cond] { return cond(*value_); };
+  template <typename Predicate>
+  bool AwaitWithTimeout(Predicate &&cond, absl::Duration timeout) {
+    auto condition_function = [this, &cond] { return cond(*value_); };
     return mu_->AwaitWithTimeout(absl::Condition(&condition_function), timeout);
   }
 
   // As AwaitWithTimeout(), but uses a deadline instead of a timeout.
-  bool AwaitWithDeadline(std::function<bool(const T &)> cond,
-                         absl::Time deadline) {
-    auto condition_function = [this, cond] { return cond(*value_); };
+  template <typename Predicate>
+  bool AwaitWithDeadline(Predicate &&cond, absl::Time deadline) {
+    auto condition_function = [this, &cond] { return cond(*value_); };
     return mu_->AwaitWithDeadline(absl::Condition(&condition_function),
                                   deadline);
   }
 
  protected:
-  template <typename U>
+  template <typename U, typename V>
   friend class MutexGuarded;
 
-  LockView(absl::Mutex *mu, T *value) : mu_(mu), value_(value) {}
+  LockView(MutexT *mu, T *value) : mu_(mu), value_(value) {}
 
  private:
   // Sets all internal pointers to nullptr.
@@ -412,14 +429,14 @@ class LockView {
     value_ = nullptr;
   }
 
-  absl::Mutex *mu_;
+  MutexT *mu_;
   T *value_;
 };
 
 // A read-only view of a mutex-guarded object of type T. The view object
 // maintains a reader lock on the guarding mutex during its lifetime. The view
 // object dereferences to the guarded object.
-template <typename T>
+template <typename T, typename MutexT>
 class ReaderLockView {
  public:
   ReaderLockView() = delete;
@@ -464,8 +481,9 @@ class ReaderLockView {
 
   // Releases the lock on the referened mutex and reacquires it when |cond| is
   // true and the mutex can be acquired in shared mode again.
-  void Await(std::function<bool(const T &)> cond) {
-    auto condition_function = [this, cond] { return cond(*value_); };
+  template <typename Predicate>
+  void Await(Predicate &&cond) {
+    auto condition_function = [this, &cond] { return cond(*value_); };
     mu_->Await(absl::Condition(&condition_function));
   }
 
@@ -477,25 +495,25 @@ class ReaderLockView {
   //
   // The returned bool indicates whether |cond| was true when the mutex was
   // reacquired.
-  bool AwaitWithTimeout(std::function<bool(const T &)> cond,
-                        absl::Duration timeout) {
-    auto condition_function = [this, cond] { return cond(*value_); };
+  template <typename Predicate>
+  bool AwaitWithTimeout(Predicate &&cond, absl::Duration timeout) {
+    auto condition_function = [this, &cond] { return cond(*value_); };
     return mu_->AwaitWithTimeout(absl::Condition(&condition_function), timeout);
   }
 
   // As AwaitWithTimeout(), but uses a deadline instead of a timeout.
-  bool AwaitWithDeadline(std::function<bool(const T &)> cond,
-                         absl::Time deadline) {
-    auto condition_function = [this, cond] { return cond(*value_); };
+  template <typename Predicate>
+  bool AwaitWithDeadline(Predicate &&cond, absl::Time deadline) {
+    auto condition_function = [this, &cond] { return cond(*value_); };
     return mu_->AwaitWithDeadline(absl::Condition(&condition_function),
                                   deadline);
   }
 
  protected:
-  template <typename U>
+  template <typename U, typename V>
   friend class MutexGuarded;
 
-  ReaderLockView(absl::Mutex *mu, const T *value) : mu_(mu), value_(value) {}
+  ReaderLockView(MutexT *mu, const T *value) : mu_(mu), value_(value) {}
 
  private:
   // Sets all internal pointers to nullptr.
@@ -504,7 +522,7 @@ class ReaderLockView {
     value_ = nullptr;
   }
 
-  absl::Mutex *mu_;
+  MutexT *mu_;
   const T *value_;
 };
 
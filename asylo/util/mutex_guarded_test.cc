@@ -19,6 +19,7 @@
 #include "asylo/util/mutex_guarded.h"
 
 #include <atomic>
+#include <functional>
 #include <memory>
 #include <thread>
 #include <utility>
@@ -37,6 +38,7 @@ namespace {
 using ::testing::Eq;
 using ::testing::Ge;
 using ::testing::Gt;
+using ::testing::IsTrue;
 
 constexpr int kNumThreads = 100;
 constexpr absl::Duration kLongEnoughForThreadSwitch = absl::Milliseconds(500);
@@ -506,6 +508,28 @@ TEST(MutexGuardedTest,
   increment_safe_int.join();
 }
 
+TEST(MutexGuardedTest, ConditionsNeedNotBeCopyable) {
+  MutexGuarded<int> safe_int(1);
+  auto expected = absl::make_unique<int>(1);
+
+  // A condition with a move-only capture cannot be held by a std::function.
+  auto cond = [expected = std::move(expected)](int value) {
+    return value == *expected;
+  };
+  auto writeable_view = safe_int.LockWhen(cond);
+  writeable_view.Await(cond);
+  EXPECT_THAT(writeable_view.AwaitWithTimeout(cond, absl::ZeroDuration()),
+              IsTrue());
+}
+
+TEST(MutexGuardedTest, ConditionsMayBeStdFunctions) {
+  MutexGuarded<int> safe_int(1);
+  std::function<bool(const int &)> cond = [](int value) { return value > 0; };
+  EXPECT_THAT(*safe_int.ReaderLockWhen(cond), Eq(1));
+  EXPECT_THAT(safe_int.LockWhenWithTimeout(cond, absl::ZeroDuration()).first,
+              IsTrue());
+}
+
 TEST(MutexGuardedTest, LockingStressTest) {
   constexpr int kNumIncrementsPerThread = 10000;
 
@@ -0,0 +1,136 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/util/pooled_allocator.h"
+
+#include <cstddef>
+#include <new>
+
+#include "absl/base/attributes.h"
+
+namespace asylo {
+namespace internal {
+namespace {
+
+// Blocks of 16, 32, ..., 1024 bytes are pooled.
+constexpr size_t kMinBlockSize = 16;
+constexpr int kNumSizeClasses = 7;
+
+// The number of free blocks of each size class that a thread keeps, which
+// bounds the memory held by the pool of a thread to 16 KiB.
+constexpr size_t kMaxFreeBlocks = 8;
+
+// A free block, which stores the link of its free list in its first bytes.
+struct FreeBlock {
+  FreeBlock *next;
+};
+
+struct FreeList {
+  FreeBlock *head;
+  size_t length;
+};
+
+// Plain thread-local data, since threads of the trusted runtime do not run the
+// destructors of thread-local objects. Enclave threads release their free
+// blocks on exit from the pthread runtime instead.
+ABSL_CONST_INIT thread_local FreeList free_lists[kNumSizeClasses] = {};
+
+// Whether the calling thread released its pool on exit, after which blocks it
+// deallocates, for instance from the destructors of other thread-local
+// objects, go to the heap.
+ABSL_CONST_INIT thread_local bool pool_released = false;
+
+#ifndef __ASYLO__
+// Releases the pool of a host thread when the thread exits.
+struct PoolReleaser {
+  ~PoolReleaser() {
+    PoolReleaseFreeBlocks();
+    pool_released = true;
+  }
+};
+
+// Registers the release of the pool of the calling thread on exit.
+void ReleasePoolOnExit() {
+  static thread_local PoolReleaser releaser;
+  (void)releaser;
+}
+#endif  // __ASYLO__
+
+// Returns the size class of blocks of |size| bytes, or kNumSizeClasses if they
+// are not pooled.
+int SizeClass(size_t size) {
+  int size_class = 0;
+  for (size_t block_size = kMinBlockSize; block_size < size;
+       block_size <<= 1) {
+    if (++size_class == kNumSizeClasses) {
+      break;
+    }
+  }
+  return size_class;
+}
+
+}  // namespace
+
+void *PoolAllocate(size_t size) {
+  int size_class = SizeClass(size);
+  if (size_class == kNumSizeClasses) {
+    return ::operator new(size);
+  }
+  FreeList &free_list = free_lists[size_class];
+  FreeBlock *block = free_list.head;
+  if (block == nullptr) {
+    return ::operator new(kMinBlockSize << size_class);
+  }
+  free_list.head = block->next;
+  --free_list.length;
+  // Clear the link, so that a block freed by a CleansingAllocator is handed out
+  // entirely zeroed.
+  block->next = nullptr;
+  return block;
+}
+
+void PoolDeallocate(void *ptr, size_t size) {
+  int size_class = SizeClass(size);
+  if (size_class == kNumSizeClasses || pool_released ||
+      free_lists[size_class].length == kMaxFreeBlocks) {
+    ::operator delete(ptr);
+    return;
+  }
+  FreeList &free_list = free_lists[size_class];
+#ifndef __ASYLO__
+  if (free_list.head == nullptr) {
+    ReleasePoolOnExit();
+  }
+#endif  // __ASYLO__
+  free_list.head = new (ptr) FreeBlock{free_list.head};
+  ++free_list.length;
+}
+
+void PoolReleaseFreeBlocks() {
+  for (FreeList &free_list : free_lists) {
+    while (free_list.head != nullptr) {
+      FreeBlock *block = free_list.head;
+      free_list.head = block->next;
+      ::operator delete(block);
+    }
+    free_list.length = 0;
+  }
+}
+
+}  // namespace internal
+}  // namespace asylo
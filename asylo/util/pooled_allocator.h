@@ -0,0 +1,108 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_UTIL_POOLED_ALLOCATOR_H_
+#define ASYLO_UTIL_POOLED_ALLOCATOR_H_
+
+#include <cstddef>
+#include <memory>
+
+namespace asylo {
+namespace internal {
+
+// Returns a block of at least |size| bytes, aligned for any fundamental type.
+// Small blocks are reused from a pool owned by the calling thread, with one
+// free list per power-of-two size class, and larger blocks come from the heap.
+void *PoolAllocate(size_t size);
+
+// Returns |ptr|, a block obtained from PoolAllocate(|size|), to the pool of
+// the calling thread, or to the heap if that pool is full. The block may have
+// been allocated by another thread.
+void PoolDeallocate(void *ptr, size_t size);
+
+// Returns the free blocks of the pool of the calling thread to the heap. Host
+// threads call it when they exit, and enclave threads when their start routine
+// returns.
+void PoolReleaseFreeBlocks();
+
+}  // namespace internal
+
+/// PooledAllocator is a stateless C++11
+/// [allocator](http://en.cppreference.com/w/cpp/concept/Allocator) that reuses
+/// small blocks from per-thread size-class pools, so that containers which are
+/// frequently created and destroyed do not allocate from the heap each time.
+///
+/// PooledAllocator does not clear the blocks that it recycles. It is the
+/// default underlying allocator of CleansingAllocator, which cleanses every
+/// block before returning it to the pool.
+template <typename T>
+class PooledAllocator {
+ public:
+  using value_type = T;
+  using pointer = T *;
+  using const_pointer = const T *;
+  using reference = T &;
+  using const_reference = const T &;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+
+  PooledAllocator() = default;
+  template <typename U>
+  PooledAllocator(const PooledAllocator<U> &other) {}
+
+  template <typename U>
+  struct rebind {
+    using other = PooledAllocator<U>;
+  };
+
+  pointer allocate(size_type n) {
+    if (!IsPooled(n)) {
+      return std::allocator<T>().allocate(n);
+    }
+    return static_cast<pointer>(internal::PoolAllocate(n * sizeof(T)));
+  }
+
+  void deallocate(pointer ptr, size_type n) {
+    if (!IsPooled(n)) {
+      std::allocator<T>().deallocate(ptr, n);
+      return;
+    }
+    internal::PoolDeallocate(ptr, n * sizeof(T));
+  }
+
+ private:
+  // Over-aligned types and sizes that overflow are left to std::allocator.
+  static bool IsPooled(size_type n) {
+    return alignof(T) <= alignof(std::max_align_t) &&
+           n <= static_cast<size_type>(-1) / sizeof(T);
+  }
+};
+
+template <typename T, typename U>
+bool operator==(const PooledAllocator<T> &lhs, const PooledAllocator<U> &rhs) {
+  return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const PooledAllocator<T> &lhs, const PooledAllocator<U> &rhs) {
+  return false;
+}
+
+}  // namespace asylo
+
+#endif  // ASYLO_UTIL_POOLED_ALLOCATOR_H_
@@ -0,0 +1,119 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/util/pooled_allocator.h"
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "asylo/util/cleansing_types.h"
+
+namespace asylo {
+namespace {
+
+using ::testing::Each;
+using ::testing::Eq;
+using ::testing::Ne;
+
+TEST(PooledAllocatorTest, ReusesFreedBlocks) {
+  PooledAllocator<uint64_t> allocator;
+  uint64_t *first = allocator.allocate(8);
+  allocator.deallocate(first, 8);
+
+  // Blocks of the same size class are recycled, whatever their exact size.
+  uint64_t *second = allocator.allocate(5);
+  EXPECT_THAT(second, Eq(first));
+  allocator.deallocate(second, 5);
+}
+
+TEST(PooledAllocatorTest, SeparatesSizeClasses) {
+  PooledAllocator<uint64_t> allocator;
+  uint64_t *small = allocator.allocate(2);
+  allocator.deallocate(small, 2);
+
+  uint64_t *large = allocator.allocate(128);
+  EXPECT_THAT(large, Ne(small));
+  allocator.deallocate(large, 128);
+}
+
+TEST(PooledAllocatorTest, AllocatesLargeBlocksFromHeap) {
+  std::vector<char, PooledAllocator<char>> buffer(1 << 20, 'x');
+  EXPECT_THAT(buffer, Each(Eq('x')));
+}
+
+TEST(PooledAllocatorTest, BoundsFreeBlocksPerThread) {
+  // A fresh thread starts with an empty pool.
+  std::thread thread([] {
+    PooledAllocator<uint64_t> allocator;
+    std::vector<uint64_t *> blocks;
+    for (int i = 0; i < 100; ++i) {
+      blocks.push_back(allocator.allocate(8));
+    }
+    for (uint64_t *block : blocks) {
+      allocator.deallocate(block, 8);
+    }
+
+    // Blocks freed once the pool of the thread is full go back to the heap.
+    for (int i = 7; i >= 0; --i) {
+      EXPECT_THAT(allocator.allocate(8), Eq(blocks[i]));
+    }
+    // The pool is released when the thread exits.
+    for (int i = 0; i < 8; ++i) {
+      allocator.deallocate(blocks[i], 8);
+    }
+  });
+  thread.join();
+}
+
+TEST(PooledAllocatorTest, KeepsPoolsPerThread) {
+  PooledAllocator<uint32_t> allocator;
+  uint32_t *block = allocator.allocate(8);
+  allocator.deallocate(block, 8);
+
+  uint32_t *other_thread_block = nullptr;
+  std::thread thread([&allocator, &other_thread_block] {
+    other_thread_block = allocator.allocate(8);
+  });
+  thread.join();
+  EXPECT_THAT(other_thread_block, Ne(block));
+
+  // A block may be freed by a thread other than the one which allocated it.
+  allocator.deallocate(other_thread_block, 8);
+  EXPECT_THAT(allocator.allocate(8), Eq(other_thread_block));
+  allocator.deallocate(other_thread_block, 8);
+}
+
+TEST(PooledAllocatorTest, CleansingContainersRecycleZeroedBlocks) {
+  const uint8_t *data;
+  {
+    CleansingVector<uint8_t> secret(48, 0xa5);
+    data = secret.data();
+  }
+
+  PooledAllocator<uint8_t> allocator;
+  uint8_t *block = allocator.allocate(48);
+  ASSERT_THAT(block, Eq(data));
+  EXPECT_THAT(std::vector<uint8_t>(block, block + 48), Each(Eq(0)));
+  allocator.deallocate(block, 48);
+}
+
+}  // namespace
+}  // namespace asylo
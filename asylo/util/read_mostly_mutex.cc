@@ -0,0 +1,131 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/util/read_mostly_mutex.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+
+#include "absl/base/attributes.h"
+#include "absl/synchronization/mutex.h"
+
+namespace asylo {
+namespace {
+
+// Next reader counter to hand out to a thread.
+std::atomic<uint32_t> next_reader_slot{0};
+
+// Reader counter of the calling thread, or -1 if it has not been assigned yet.
+ABSL_CONST_INIT thread_local int reader_slot = -1;
+
+}  // namespace
+
+constexpr int ReadMostlyMutex::kNumReaderSlots;
+
+void ReadMostlyMutex::Lock() {
+  writer_mu_.Lock();
+  writer_pending_.store(true, std::memory_order_seq_cst);
+  absl::MutexLock lock(&wait_mu_);
+  wait_mu_.Await(absl::Condition(&ReadersDrained, this));
+}
+
+void ReadMostlyMutex::Unlock() {
+  writer_pending_.store(false, std::memory_order_seq_cst);
+  {
+    // Releasing |wait_mu_| re-evaluates the conditions of the readers waiting
+    // on it.
+    absl::MutexLock lock(&wait_mu_);
+  }
+  writer_mu_.Unlock();
+}
+
+bool ReadMostlyMutex::TryLock() {
+  if (!writer_mu_.TryLock()) {
+    return false;
+  }
+  writer_pending_.store(true, std::memory_order_seq_cst);
+  if (ReadersDrained(this)) {
+    return true;
+  }
+  Unlock();
+  return false;
+}
+
+void ReadMostlyMutex::ReaderLock() {
+  ReaderSlot *slot = CurrentReaderSlot();
+  while (!ReaderTryAcquire(slot)) {
+    absl::MutexLock lock(&wait_mu_);
+    wait_mu_.Await(absl::Condition(&WriterAbsent, this));
+  }
+}
+
+void ReadMostlyMutex::ReaderUnlock() { ReaderRelease(CurrentReaderSlot()); }
+
+bool ReadMostlyMutex::ReaderTryLock() {
+  return ReaderTryAcquire(CurrentReaderSlot());
+}
+
+void ReadMostlyMutex::AssertReaderHeld() const {
+  assert(reader_slot >= 0 &&
+         reader_slots_[reader_slot].count.load(std::memory_order_relaxed) > 0);
+}
+
+ReadMostlyMutex::ReaderSlot *ReadMostlyMutex::CurrentReaderSlot() {
+  if (reader_slot < 0) {
+    reader_slot = next_reader_slot.fetch_add(1, std::memory_order_relaxed) %
+                  kNumReaderSlots;
+  }
+  return &reader_slots_[reader_slot];
+}
+
+bool ReadMostlyMutex::ReaderTryAcquire(ReaderSlot *slot) {
+  // Pairs with the store to |writer_pending_| in Lock(): either the writer
+  // sees this reader while waiting for readers to drain, or this reader sees
+  // the writer and backs off.
+  slot->count.fetch_add(1, std::memory_order_seq_cst);
+  if (!writer_pending_.load(std::memory_order_seq_cst)) {
+    return true;
+  }
+  ReaderRelease(slot);
+  return false;
+}
+
+void ReadMostlyMutex::ReaderRelease(ReaderSlot *slot) {
+  slot->count.fetch_sub(1, std::memory_order_seq_cst);
+  if (writer_pending_.load(std::memory_order_seq_cst)) {
+    // Releasing |wait_mu_| re-evaluates the condition of the writer waiting on
+    // it.
+    absl::MutexLock lock(&wait_mu_);
+  }
+}
+
+bool ReadMostlyMutex::ReadersDrained(ReadMostlyMutex *mu) {
+  for (const ReaderSlot &slot : mu->reader_slots_) {
+    if (slot.count.load(std::memory_order_seq_cst) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ReadMostlyMutex::WriterAbsent(ReadMostlyMutex *mu) {
+  return !mu->writer_pending_.load(std::memory_order_seq_cst);
+}
+
+}  // namespace asylo
@@ -0,0 +1,135 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_UTIL_READ_MOSTLY_MUTEX_H_
+#define ASYLO_UTIL_READ_MOSTLY_MUTEX_H_
+
+#include <atomic>
+#include <cstdint>
+
+#include "absl/base/const_init.h"
+#include "absl/base/optimization.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+
+namespace asylo {
+
+// A reader-writer mutex for data which is read far more often than it is
+// written. Readers announce themselves on one of several cache-line-sized
+// counters chosen per thread, so that concurrent readers neither contend on a
+// shared lock word nor sleep unless a writer is present. Writers are
+// serialized by an absl::Mutex and take priority over newly arriving readers:
+// once a writer is waiting, readers back off until it has released the mutex.
+//
+// ReadMostlyMutex exposes the locking subset of the absl::Mutex API, which
+// makes it usable as the mutex of MutexGuarded<T, ReadMostlyMutex>. It does
+// not support conditions, so the LockWhen() and Await() families are not
+// available with it.
+//
+// As with absl::Mutex, reader locks are not reentrant: a thread which already
+// holds a reader lock deadlocks if it tries to acquire another one while a
+// writer is waiting. A reader lock must be released by the thread which
+// acquired it.
+class ABSL_LOCKABLE ReadMostlyMutex {
+ public:
+  ReadMostlyMutex() = default;
+
+  // Creates a mutex with static storage duration.
+  explicit constexpr ReadMostlyMutex(absl::ConstInitType const_init)
+      : writer_mu_(const_init), wait_mu_(const_init) {}
+
+  ReadMostlyMutex(const ReadMostlyMutex &other) = delete;
+  ReadMostlyMutex &operator=(const ReadMostlyMutex &other) = delete;
+
+  // Acquires the mutex exclusively, blocking until all readers have released
+  // it.
+  void Lock() ABSL_EXCLUSIVE_LOCK_FUNCTION();
+
+  // Releases an exclusive lock and wakes any readers which backed off.
+  void Unlock() ABSL_UNLOCK_FUNCTION();
+
+  // Acquires the mutex exclusively if no other thread holds it in any mode.
+  // Returns true on success.
+  bool TryLock() ABSL_EXCLUSIVE_TRYLOCK_FUNCTION(true);
+
+  // Acquires the mutex in shared mode. Takes a single atomic increment unless
+  // a writer holds or is waiting for the mutex.
+  void ReaderLock() ABSL_SHARED_LOCK_FUNCTION();
+
+  // Releases a shared lock.
+  void ReaderUnlock() ABSL_UNLOCK_FUNCTION();
+
+  // Acquires the mutex in shared mode if no writer holds or is waiting for it.
+  // Returns true on success.
+  bool ReaderTryLock() ABSL_SHARED_TRYLOCK_FUNCTION(true);
+
+  // Aliases for Lock() and Unlock(), as provided by absl::Mutex.
+  void WriterLock() ABSL_EXCLUSIVE_LOCK_FUNCTION() { Lock(); }
+  void WriterUnlock() ABSL_UNLOCK_FUNCTION() { Unlock(); }
+
+  // Behaves as absl::Mutex::AssertHeld().
+  void AssertHeld() const ABSL_ASSERT_EXCLUSIVE_LOCK() {
+    writer_mu_.AssertHeld();
+  }
+
+  // Asserts in debug builds that the calling thread may hold a shared lock.
+  // Readers are not tracked individually, so this only detects that no thread
+  // sharing the reader counter of the calling thread holds a shared lock.
+  void AssertReaderHeld() const ABSL_ASSERT_SHARED_LOCK();
+
+ private:
+  // Number of reader counters. Threads are assigned to counters round-robin on
+  // their first shared acquisition of any ReadMostlyMutex.
+  static constexpr int kNumReaderSlots = 16;
+
+  struct ABSL_CACHELINE_ALIGNED ReaderSlot {
+    std::atomic<int64_t> count{0};
+  };
+
+  // Returns the reader counter of the calling thread.
+  ReaderSlot *CurrentReaderSlot();
+
+  // Announces a reader on |slot| and returns true if no writer is present.
+  // Otherwise withdraws the announcement and returns false.
+  bool ReaderTryAcquire(ReaderSlot *slot);
+
+  // Withdraws a reader from |slot|, waking a waiting writer if needed.
+  void ReaderRelease(ReaderSlot *slot);
+
+  // Returns true if no reader is announced on any counter.
+  static bool ReadersDrained(ReadMostlyMutex *mu);
+
+  // Returns true if no writer holds or waits for the mutex.
+  static bool WriterAbsent(ReadMostlyMutex *mu);
+
+  ReaderSlot reader_slots_[kNumReaderSlots];
+
+  // Set while a writer holds or waits for the mutex.
+  std::atomic<bool> writer_pending_{false};
+
+  // Serializes writers.
+  mutable absl::Mutex writer_mu_;
+
+  // Mutex on which writers wait for readers to drain and readers wait for
+  // writers to leave. Only taken on the contended paths.
+  absl::Mutex wait_mu_;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_UTIL_READ_MOSTLY_MUTEX_H_
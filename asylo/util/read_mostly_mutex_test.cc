@@ -0,0 +1,152 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/util/read_mostly_mutex.h"
+
+#include <atomic>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "asylo/util/mutex_guarded.h"
+
+namespace asylo {
+namespace {
+
+using ::testing::Eq;
+using ::testing::IsFalse;
+using ::testing::IsTrue;
+
+constexpr int kNumThreads = 16;
+constexpr int kNumIterations = 10000;
+constexpr absl::Duration kLongEnoughForThreadSwitch = absl::Milliseconds(100);
+
+TEST(ReadMostlyMutexTest, ReadersShareTheMutex) {
+  ReadMostlyMutex mu;
+  mu.ReaderLock();
+  std::thread reader([&mu] {
+    EXPECT_THAT(mu.ReaderTryLock(), IsTrue());
+    mu.ReaderUnlock();
+  });
+  reader.join();
+  EXPECT_THAT(mu.TryLock(), IsFalse());
+  mu.ReaderUnlock();
+  EXPECT_THAT(mu.TryLock(), IsTrue());
+  mu.Unlock();
+}
+
+TEST(ReadMostlyMutexTest, WriterExcludesReaders) {
+  ReadMostlyMutex mu;
+  mu.Lock();
+  std::thread other([&mu] {
+    EXPECT_THAT(mu.ReaderTryLock(), IsFalse());
+    EXPECT_THAT(mu.TryLock(), IsFalse());
+  });
+  other.join();
+  mu.Unlock();
+  EXPECT_THAT(mu.ReaderTryLock(), IsTrue());
+  mu.ReaderUnlock();
+}
+
+TEST(ReadMostlyMutexTest, WriterWaitsForReaders) {
+  ReadMostlyMutex mu;
+  std::atomic<bool> reader_done(false);
+  mu.ReaderLock();
+  absl::Notification writer_started;
+  std::thread writer([&] {
+    writer_started.Notify();
+    mu.Lock();
+    EXPECT_THAT(reader_done.load(), IsTrue());
+    mu.Unlock();
+  });
+  writer_started.WaitForNotification();
+  absl::SleepFor(kLongEnoughForThreadSwitch);
+  reader_done = true;
+  mu.ReaderUnlock();
+  writer.join();
+}
+
+TEST(ReadMostlyMutexTest, ReadersWaitForWriter) {
+  ReadMostlyMutex mu;
+  std::atomic<bool> writer_done(false);
+  mu.Lock();
+  std::vector<std::thread> readers;
+  for (int i = 0; i < kNumThreads; ++i) {
+    readers.emplace_back([&] {
+      mu.ReaderLock();
+      EXPECT_THAT(writer_done.load(), IsTrue());
+      mu.ReaderUnlock();
+    });
+  }
+  absl::SleepFor(kLongEnoughForThreadSwitch);
+  writer_done = true;
+  mu.Unlock();
+  for (auto &reader : readers) {
+    reader.join();
+  }
+}
+
+TEST(ReadMostlyMutexTest, ReadersObserveConsistentWrites) {
+  MutexGuarded<std::pair<int, int>, ReadMostlyMutex> guarded({0, 0});
+  std::atomic<int> inconsistent_reads(0);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back([&guarded, &inconsistent_reads, i] {
+      for (int j = 0; j < kNumIterations; ++j) {
+        if (j % kNumThreads == i) {
+          auto view = guarded.Lock();
+          ++view->first;
+          ++view->second;
+        } else {
+          auto view = guarded.ReaderLock();
+          if (view->first != view->second) {
+            ++inconsistent_reads;
+          }
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_THAT(inconsistent_reads.load(), Eq(0));
+  EXPECT_THAT(guarded.ReaderLock()->first,
+              Eq(kNumThreads * (kNumIterations / kNumThreads)));
+}
+
+TEST(ReadMostlyMutexTest, SupportsMutexGuardedTryLocks) {
+  MutexGuarded<int, ReadMostlyMutex> guarded(7);
+  {
+    auto reader_view = guarded.ReaderTryLock();
+    ASSERT_THAT(reader_view.has_value(), IsTrue());
+    EXPECT_THAT(**reader_view, Eq(7));
+    EXPECT_THAT(guarded.TryLock().has_value(), IsFalse());
+  }
+  auto writer_view = guarded.TryLock();
+  ASSERT_THAT(writer_view.has_value(), IsTrue());
+  **writer_view = 8;
+  guarded.AssertHeld();
+}
+
+}  // namespace
+}  // namespace asylo
@@ -0,0 +1,267 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/util/remote/enclave_cache.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/strings/escaping.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "asylo/crypto/sha256_hash.h"
+#include "asylo/util/logging.h"
+#include "asylo/util/path.h"
+#include "asylo/util/posix_error_space.h"
+#include "asylo/util/status_macros.h"
+
+namespace asylo {
+namespace {
+
+// Size of the blocks in which a partial upload is read back to resume it.
+constexpr size_t kReadBufferLength = 1024 * 1024;
+
+Status PosixStatus(absl::string_view message, absl::string_view path) {
+  return Status(static_cast<error::PosixError>(errno),
+                absl::StrCat(message, " ", path));
+}
+
+Status CheckDigestLength(ByteContainerView sha256) {
+  if (sha256.size() != kSha256DigestLength) {
+    return Status(error::GoogleError::INVALID_ARGUMENT,
+                  absl::StrCat("Enclave SHA256 digest must be ",
+                               kSha256DigestLength, " bytes long"));
+  }
+  return Status::OkStatus();
+}
+
+// Returns the size of the file at |path|, or -1 if it does not exist.
+StatusOr<int64_t> FileSize(const std::string &path) {
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0) {
+    if (errno == ENOENT) {
+      return -1;
+    }
+    return PosixStatus("Failed to stat", path);
+  }
+  return st.st_size;
+}
+
+Status CheckCachedSize(int64_t cached_size, uint64_t size) {
+  if (static_cast<uint64_t>(cached_size) != size) {
+    return Status(error::GoogleError::FAILED_PRECONDITION,
+                  absl::StrCat("Cached enclave with the same digest has ",
+                               cached_size, " bytes instead of ", size));
+  }
+  return Status::OkStatus();
+}
+
+}  // namespace
+
+EnclaveCache::Upload::Upload(EnclaveCache *cache, std::string sha256,
+                             uint64_t size)
+    : cache_(cache), sha256_(std::move(sha256)), size_(size) {}
+
+EnclaveCache::Upload::~Upload() {
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+  if (claimed_) {
+    cache_->uploads_.Lock()->erase(sha256_);
+  }
+}
+
+Status EnclaveCache::Upload::Discard() {
+  hasher_.Init();
+  offset_ = 0;
+  if (ftruncate(fd_, 0) != 0 || lseek(fd_, 0, SEEK_SET) != 0) {
+    return PosixStatus("Failed to discard",
+                       cache_->PartialPath(sha256_));
+  }
+  return Status::OkStatus();
+}
+
+Status EnclaveCache::Upload::Append(ByteContainerView data,
+                                    ByteContainerView cumulative_sha256) {
+  if (cached_) {
+    return Status(error::GoogleError::FAILED_PRECONDITION,
+                  "Enclave is already cached");
+  }
+  if (data.size() > size_ - offset_) {
+    return Status(error::GoogleError::OUT_OF_RANGE,
+                  absl::StrCat("Enclave binary exceeds its size of ", size_,
+                               " bytes"));
+  }
+
+  hasher_.Update(data);
+  std::vector<uint8_t> hash;
+  ASYLO_RETURN_IF_ERROR(hasher_.CumulativeHash(&hash));
+  if (ByteContainerView(hash) != cumulative_sha256) {
+    ASYLO_RETURN_IF_ERROR(Discard());
+    return Status(error::GoogleError::DATA_LOSS, "SHA256 hash mismatch");
+  }
+
+  const uint8_t *buffer = data.data();
+  size_t remaining = data.size();
+  while (remaining > 0) {
+    ssize_t result = write(fd_, buffer, remaining);
+    if (result < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return PosixStatus("Failed to write into file",
+                         cache_->PartialPath(sha256_));
+    }
+    buffer += result;
+    remaining -= result;
+  }
+  offset_ += data.size();
+  return Status::OkStatus();
+}
+
+StatusOr<std::string> EnclaveCache::Upload::Finish() {
+  const std::string cached_path = cache_->CachedPath(sha256_);
+  if (cached_) {
+    return cached_path;
+  }
+  if (offset_ != size_) {
+    return Status(error::GoogleError::FAILED_PRECONDITION,
+                  absl::StrCat("Received ", offset_, " of ", size_,
+                               " bytes of the enclave binary"));
+  }
+
+  std::vector<uint8_t> hash;
+  ASYLO_RETURN_IF_ERROR(hasher_.CumulativeHash(&hash));
+  if (ByteContainerView(hash) != ByteContainerView(sha256_)) {
+    ASYLO_RETURN_IF_ERROR(Discard());
+    return Status(error::GoogleError::DATA_LOSS,
+                  "Enclave binary does not match its SHA256 digest");
+  }
+
+  // The enclave only enters the cache once it is durable, so that a cached
+  // enclave is always complete.
+  const std::string partial_path = cache_->PartialPath(sha256_);
+  if (fsync(fd_) != 0) {
+    return PosixStatus("Failed to sync", partial_path);
+  }
+  if (rename(partial_path.c_str(), cached_path.c_str()) != 0) {
+    return PosixStatus("Failed to rename", partial_path);
+  }
+  LOG(INFO) << "Enclave cached, filename=" << cached_path;
+  return cached_path;
+}
+
+EnclaveCache::EnclaveCache(absl::string_view directory)
+    : directory_(directory), uploads_(absl::flat_hash_set<std::string>()) {}
+
+StatusOr<uint64_t> EnclaveCache::StoredBytes(ByteContainerView sha256,
+                                             uint64_t size) const {
+  ASYLO_RETURN_IF_ERROR(CheckDigestLength(sha256));
+  std::string digest(sha256.begin(), sha256.end());
+
+  int64_t cached_size;
+  ASYLO_ASSIGN_OR_RETURN(cached_size, FileSize(CachedPath(digest)));
+  if (cached_size >= 0) {
+    ASYLO_RETURN_IF_ERROR(CheckCachedSize(cached_size, size));
+    return size;
+  }
+  int64_t partial_size;
+  ASYLO_ASSIGN_OR_RETURN(partial_size, FileSize(PartialPath(digest)));
+  return partial_size >= 0 && static_cast<uint64_t>(partial_size) <= size
+             ? partial_size
+             : 0;
+}
+
+StatusOr<std::unique_ptr<EnclaveCache::Upload>> EnclaveCache::StartUpload(
+    ByteContainerView sha256, uint64_t size, uint64_t offset) {
+  ASYLO_RETURN_IF_ERROR(CheckDigestLength(sha256));
+  std::string digest(sha256.begin(), sha256.end());
+  std::unique_ptr<Upload> upload(new Upload(this, digest, size));
+
+  int64_t cached_size;
+  ASYLO_ASSIGN_OR_RETURN(cached_size, FileSize(CachedPath(digest)));
+  if (cached_size >= 0) {
+    ASYLO_RETURN_IF_ERROR(CheckCachedSize(cached_size, size));
+    if (offset != size) {
+      return Status(error::GoogleError::FAILED_PRECONDITION,
+                    absl::StrCat("Upload offset ", offset,
+                                 " does not match the cached enclave"));
+    }
+    upload->cached_ = true;
+    upload->offset_ = size;
+    return std::move(upload);
+  }
+
+  if (!uploads_.Lock()->insert(digest).second) {
+    return Status(error::GoogleError::ABORTED,
+                  "Enclave is already being uploaded");
+  }
+  upload->claimed_ = true;
+
+  const std::string partial_path = PartialPath(digest);
+  upload->fd_ = open(partial_path.c_str(), O_CREAT | O_RDWR,
+                     S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+  if (upload->fd_ < 0) {
+    return PosixStatus("Failed to open file", partial_path);
+  }
+  if (offset == 0) {
+    ASYLO_RETURN_IF_ERROR(upload->Discard());
+    return std::move(upload);
+  }
+
+  // Restore the digest of the bytes received so far, which are then verified
+  // along with the first cumulative digest of the resumed upload.
+  std::vector<uint8_t> buffer(kReadBufferLength);
+  uint64_t stored = 0;
+  ssize_t result;
+  while ((result = read(upload->fd_, buffer.data(), buffer.size())) != 0) {
+    if (result < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return PosixStatus("Failed to read file", partial_path);
+    }
+    upload->hasher_.Update(ByteContainerView(buffer.data(), result));
+    stored += result;
+  }
+  if (stored != offset || offset > size) {
+    return Status(error::GoogleError::FAILED_PRECONDITION,
+                  absl::StrCat("Upload offset ", offset, " does not match ",
+                               "the ", stored, " bytes stored"));
+  }
+  upload->offset_ = offset;
+  return std::move(upload);
+}
+
+std::string EnclaveCache::CachedPath(absl::string_view sha256) const {
+  return JoinPath(directory_,
+                  absl::StrCat("enclave_", absl::BytesToHexString(sha256)));
+}
+
+std::string EnclaveCache::PartialPath(absl::string_view sha256) const {
+  return absl::StrCat(CachedPath(sha256), ".partial");
+}
+
+}  // namespace asylo
@@ -0,0 +1,123 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef ASYLO_UTIL_REMOTE_ENCLAVE_CACHE_H_
+#define ASYLO_UTIL_REMOTE_ENCLAVE_CACHE_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/string_view.h"
+#include "asylo/crypto/sha256_hash.h"
+#include "asylo/crypto/util/byte_container_view.h"
+#include "asylo/util/mutex_guarded.h"
+#include "asylo/util/status.h"
+#include "asylo/util/statusor.h"
+
+namespace asylo {
+
+// A content-addressed store of the enclave binaries uploaded to the remote
+// provision server. An enclave is stored as "enclave_<SHA256 in hex>" in the
+// directory of the cache, once its upload is complete and verified. Until
+// then, the bytes received so far are written through to a ".partial" file
+// next to it, from which an interrupted upload can be resumed, even after the
+// server restarts. Stored enclaves are never evicted, since proxies may still
+// load them.
+class EnclaveCache {
+ public:
+  // An upload of one enclave binary. Only one upload of an enclave may be in
+  // progress at any time. Destroying an unfinished upload keeps the bytes it
+  // received, so that a later upload can resume from there.
+  class Upload {
+   public:
+    ~Upload();
+
+    Upload(const Upload &other) = delete;
+    Upload &operator=(const Upload &other) = delete;
+
+    // Appends |data| to the enclave binary. |cumulative_sha256| must be the
+    // SHA256 digest of the binary from its start up to and including |data|.
+    // A mismatch discards all bytes received, since they cannot be trusted to
+    // match the enclave anymore.
+    Status Append(ByteContainerView data, ByteContainerView cumulative_sha256);
+
+    // Verifies the complete enclave binary against its digest and moves it to
+    // the cache. Returns the path of the cached enclave.
+    StatusOr<std::string> Finish();
+
+    // Returns the number of bytes of the binary stored so far.
+    uint64_t offset() const { return offset_; }
+
+    // Returns whether the enclave was already cached when the upload started.
+    bool cached() const { return cached_; }
+
+   private:
+    friend class EnclaveCache;
+
+    Upload(EnclaveCache *cache, std::string sha256, uint64_t size);
+
+    // Discards all bytes received so far.
+    Status Discard();
+
+    EnclaveCache *const cache_;
+    const std::string sha256_;
+    const uint64_t size_;
+    uint64_t offset_ = 0;
+    bool cached_ = false;
+    bool claimed_ = false;
+    int fd_ = -1;
+    Sha256Hash hasher_;
+  };
+
+  // Creates a cache storing enclaves in |directory|, which must exist.
+  explicit EnclaveCache(absl::string_view directory);
+
+  EnclaveCache(const EnclaveCache &other) = delete;
+  EnclaveCache &operator=(const EnclaveCache &other) = delete;
+
+  // Returns the number of bytes stored of the enclave binary with digest
+  // |sha256| and |size| bytes: |size| if it is cached, the bytes received by
+  // an interrupted upload, or 0.
+  StatusOr<uint64_t> StoredBytes(ByteContainerView sha256,
+                                 uint64_t size) const;
+
+  // Starts uploading the enclave binary with digest |sha256| and |size|
+  // bytes, from |offset| on. |offset| must be the value returned by
+  // StoredBytes, or 0 to restart the upload from scratch. The returned upload
+  // must not outlive the cache.
+  StatusOr<std::unique_ptr<Upload>> StartUpload(ByteContainerView sha256,
+                                                uint64_t size,
+                                                uint64_t offset);
+
+ private:
+  // Returns the path of the cached enclave with digest |sha256|, and of its
+  // partial upload.
+  std::string CachedPath(absl::string_view sha256) const;
+  std::string PartialPath(absl::string_view sha256) const;
+
+  const std::string directory_;
+
+  // Digests of the enclaves being uploaded.
+  MutexGuarded<absl::flat_hash_set<std::string>> uploads_;
+};
+
+}  // namespace asylo
+
+#endif  // ASYLO_UTIL_REMOTE_ENCLAVE_CACHE_H_
@@ -0,0 +1,202 @@
+/*
+ *
+ * Copyright 2020 Asylo authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "asylo/util/remote/enclave_cache.h"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/flags/flag.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/string_view.h"
+#include "asylo/crypto/sha256_hash.h"
+#include "asylo/test/util/status_matchers.h"
+#include "asylo/test/util/test_flags.h"
+#include "asylo/util/path.h"
+#include "asylo/util/status_macros.h"
+
+namespace asylo {
+namespace {
+
+using ::testing::Eq;
+using ::testing::HasSubstr;
+using ::testing::IsFalse;
+using ::testing::IsTrue;
+
+constexpr size_t kEnclaveSize = 3000;
+constexpr size_t kChunkSize = 1024;
+
+std::vector<uint8_t> Digest(absl::string_view data) {
+  Sha256Hash hasher;
+  hasher.Update(data);
+  std::vector<uint8_t> digest;
+  hasher.CumulativeHash(&digest);
+  return digest;
+}
+
+std::string ReadFile(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  std::stringstream contents;
+  contents << file.rdbuf();
+  return contents.str();
+}
+
+class EnclaveCacheTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    directory_ = JoinPath(
+        absl::GetFlag(FLAGS_test_tmpdir),
+        ::testing::UnitTest::GetInstance()->current_test_info()->name());
+    ASSERT_EQ(mkdir(directory_.c_str(), 0700), 0);
+    cache_ = absl::make_unique<EnclaveCache>(directory_);
+
+    for (size_t i = 0; i < kEnclaveSize; ++i) {
+      enclave_.push_back(static_cast<char>(i * 7));
+    }
+    sha256_ = Digest(enclave_);
+  }
+
+  // Sends the bytes of the enclave in [|begin|, |end|) to |upload| in chunks.
+  Status Send(EnclaveCache::Upload *upload, size_t begin, size_t end) {
+    for (size_t offset = begin; offset < end; offset += kChunkSize) {
+      size_t length = std::min(kChunkSize, end - offset);
+      absl::string_view chunk(enclave_.data() + offset, length);
+      std::vector<uint8_t> cumulative =
+          Digest(absl::string_view(enclave_.data(), offset + length));
+      ASYLO_RETURN_IF_ERROR(upload->Append(chunk, cumulative));
+    }
+    return Status::OkStatus();
+  }
+
+  std::string directory_;
+  std::unique_ptr<EnclaveCache> cache_;
+  std::string enclave_;
+  std::vector<uint8_t> sha256_;
+};
+
+TEST_F(EnclaveCacheTest, UploadsAndCachesEnclave) {
+  EXPECT_THAT(cache_->StoredBytes(sha256_, kEnclaveSize), IsOkAndHolds(0));
+
+  std::unique_ptr<EnclaveCache::Upload> upload;
+  ASYLO_ASSERT_OK_AND_ASSIGN(upload,
+                             cache_->StartUpload(sha256_, kEnclaveSize, 0));
+  EXPECT_THAT(upload->cached(), IsFalse());
+  ASSERT_THAT(Send(upload.get(), 0, kEnclaveSize), IsOk());
+  std::string path;
+  ASYLO_ASSERT_OK_AND_ASSIGN(path, upload->Finish());
+  upload.reset();
+
+  EXPECT_THAT(ReadFile(path), Eq(enclave_));
+  EXPECT_THAT(cache_->StoredBytes(sha256_, kEnclaveSize),
+              IsOkAndHolds(kEnclaveSize));
+
+  // Provisioning the same enclave again needs no bytes.
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      upload, cache_->StartUpload(sha256_, kEnclaveSize, kEnclaveSize));
+  EXPECT_THAT(upload->cached(), IsTrue());
+  EXPECT_THAT(upload->Finish(), IsOkAndHolds(path));
+}
+
+TEST_F(EnclaveCacheTest, ResumesInterruptedUpload) {
+  std::unique_ptr<EnclaveCache::Upload> upload;
+  ASYLO_ASSERT_OK_AND_ASSIGN(upload,
+                             cache_->StartUpload(sha256_, kEnclaveSize, 0));
+  ASSERT_THAT(Send(upload.get(), 0, kChunkSize), IsOk());
+  upload.reset();
+
+  EXPECT_THAT(cache_->StoredBytes(sha256_, kEnclaveSize),
+              IsOkAndHolds(kChunkSize));
+  EXPECT_THAT(cache_->StartUpload(sha256_, kEnclaveSize, 2 * kChunkSize),
+              StatusIs(error::GoogleError::FAILED_PRECONDITION));
+
+  // A fresh cache over the same directory resumes it too, as after a restart.
+  cache_ = absl::make_unique<EnclaveCache>(directory_);
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      upload, cache_->StartUpload(sha256_, kEnclaveSize, kChunkSize));
+  EXPECT_THAT(upload->offset(), Eq(kChunkSize));
+  ASSERT_THAT(Send(upload.get(), kChunkSize, kEnclaveSize), IsOk());
+  std::string path;
+  ASYLO_ASSERT_OK_AND_ASSIGN(path, upload->Finish());
+  EXPECT_THAT(ReadFile(path), Eq(enclave_));
+}
+
+TEST_F(EnclaveCacheTest, RejectsConcurrentUpload) {
+  std::unique_ptr<EnclaveCache::Upload> upload;
+  ASYLO_ASSERT_OK_AND_ASSIGN(upload,
+                             cache_->StartUpload(sha256_, kEnclaveSize, 0));
+  EXPECT_THAT(cache_->StartUpload(sha256_, kEnclaveSize, 0),
+              StatusIs(error::GoogleError::ABORTED));
+  upload.reset();
+  EXPECT_THAT(cache_->StartUpload(sha256_, kEnclaveSize, 0), IsOk());
+}
+
+TEST_F(EnclaveCacheTest, DiscardsCorruptUpload) {
+  std::unique_ptr<EnclaveCache::Upload> upload;
+  ASYLO_ASSERT_OK_AND_ASSIGN(upload,
+                             cache_->StartUpload(sha256_, kEnclaveSize, 0));
+  ASSERT_THAT(Send(upload.get(), 0, kChunkSize), IsOk());
+
+  std::string corrupt(kChunkSize, 'x');
+  EXPECT_THAT(upload->Append(corrupt, Digest(enclave_)),
+              StatusIs(error::GoogleError::DATA_LOSS));
+  EXPECT_THAT(upload->offset(), Eq(0));
+  upload.reset();
+  EXPECT_THAT(cache_->StoredBytes(sha256_, kEnclaveSize), IsOkAndHolds(0));
+}
+
+TEST_F(EnclaveCacheTest, RejectsEnclaveNotMatchingDigest) {
+  std::string other(kEnclaveSize, 'y');
+  std::unique_ptr<EnclaveCache::Upload> upload;
+  ASYLO_ASSERT_OK_AND_ASSIGN(upload,
+                             cache_->StartUpload(sha256_, kEnclaveSize, 0));
+  ASSERT_THAT(upload->Append(other, Digest(other)), IsOk());
+  EXPECT_THAT(upload->Finish(), StatusIs(error::GoogleError::DATA_LOSS));
+  EXPECT_THAT(upload->Append("z", Digest("z")),
+              IsOk());  // The upload restarts from scratch.
+  EXPECT_THAT(upload->Finish(),
+              StatusIs(error::GoogleError::FAILED_PRECONDITION,
+                       HasSubstr("Received 1 of")));
+}
+
+TEST_F(EnclaveCacheTest, RejectsOversizedUpload) {
+  std::unique_ptr<EnclaveCache::Upload> upload;
+  ASYLO_ASSERT_OK_AND_ASSIGN(upload,
+                             cache_->StartUpload(sha256_, kChunkSize, 0));
+  EXPECT_THAT(Send(upload.get(), 0, kEnclaveSize),
+              StatusIs(error::GoogleError::OUT_OF_RANGE));
+}
+
+TEST_F(EnclaveCacheTest, RejectsInvalidDigest) {
+  std::vector<uint8_t> digest(16, 0);
+  EXPECT_THAT(cache_->StoredBytes(digest, kEnclaveSize),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+  EXPECT_THAT(cache_->StartUpload(digest, kEnclaveSize, 0),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT));
+}
+
+}  // namespace
+}  // namespace asylo
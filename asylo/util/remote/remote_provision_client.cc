@@ -17,9 +17,14 @@
  */
 
 #include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
 
 #include <cstdint>
 #include <string>
+#include <vector>
 
 #include "absl/flags/flag.h"
 #include "absl/memory/memory.h"
@@ -49,6 +54,10 @@ ABSL_FLAG(std::string, remote_provision_server, "",
 ABSL_FLAG(std::string, local_client_name, "",
           "Network name of local client (IP)");
 
+ABSL_FLAG(int32_t, remote_provision_attempts, 3,
+          "Number of attempts to send the enclave to the remote provisioning "
+          "server, each resuming the upload where the previous one stopped");
+
 namespace asylo {
 namespace {
 
@@ -102,6 +111,95 @@ class RemoteProvisionClient : public RemoteProvision {
     }
     Cleanup closer([fd] { close(fd); });
 
+    // The server identifies the enclave by its size and digest, so that it can
+    // reuse an enclave it already holds and resume an interrupted upload.
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      return Status{static_cast<error::PosixError>(errno),
+                    absl::StrCat("Failed to stat file ", enclave_file_path)};
+    }
+    const uint64_t enclave_size = st.st_size;
+    Sha256Hash hasher;
+    ASYLO_RETURN_IF_ERROR(
+        HashFile(fd, enclave_file_path, enclave_size, &hasher));
+    std::vector<uint8_t> enclave_sha256;
+    ASYLO_RETURN_IF_ERROR(hasher.CumulativeHash(&enclave_sha256));
+
+    const int32_t attempts =
+        std::max(absl::GetFlag(FLAGS_remote_provision_attempts), 1);
+    Status status;
+    for (int32_t attempt = 1; attempt <= attempts; ++attempt) {
+      auto result_or = SendEnclaveFrom(fd, enclave_file_path, enclave_size,
+                                       enclave_sha256, client_address,
+                                       grpc_stub);
+      if (result_or.ok()) {
+        return result_or;
+      }
+      status = result_or.status();
+      const auto code = status.CanonicalCode();
+      if (code != error::GoogleError::UNAVAILABLE &&
+          code != error::GoogleError::ABORTED &&
+          code != error::GoogleError::DATA_LOSS) {
+        break;
+      }
+      LOG(WARNING) << "Attempt " << attempt << " of " << attempts
+                   << " to send the enclave failed: " << status;
+    }
+    return status;
+  }
+
+  // Feeds the first |length| bytes of the file |fd| into |hasher|.
+  static Status HashFile(int fd, absl::string_view enclave_file_path,
+                         uint64_t length, Sha256Hash *hasher) {
+    std::vector<uint8_t> buffer(kBufferLength);
+    uint64_t offset = 0;
+    while (offset < length) {
+      ssize_t len = pread(
+          fd, buffer.data(),
+          std::min<uint64_t>(buffer.size(), length - offset), offset);
+      if (len == 0) {
+        return Status{error::GoogleError::DATA_LOSS,
+                      absl::StrCat("File ", enclave_file_path,
+                                   " changed while being sent")};
+      } else if (len < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+          continue;
+        }
+        return Status{static_cast<error::PosixError>(errno),
+                      absl::StrCat("Failed to read file ", enclave_file_path)};
+      }
+      hasher->Update(ByteContainerView(buffer.data(), len));
+      offset += len;
+    }
+    return Status::OkStatus();
+  }
+
+  // Sends the part of the enclave binary which the server does not hold yet.
+  StatusOr<std::string> SendEnclaveFrom(
+      int fd, absl::string_view enclave_file_path, uint64_t enclave_size,
+      const std::vector<uint8_t> &enclave_sha256,
+      absl::string_view client_address, ProvisionService::Stub *grpc_stub) {
+    const std::string sha256(enclave_sha256.begin(), enclave_sha256.end());
+    uint64_t offset;
+    {
+      ::grpc::ClientContext context;
+      QueryEnclaveRequest query;
+      query.set_enclave_sha256(sha256);
+      query.set_enclave_size(enclave_size);
+      QueryEnclaveResponse stored;
+      ASYLO_RETURN_IF_ERROR(
+          Status(grpc_stub->QueryEnclave(&context, query, &stored)));
+      offset = std::min<uint64_t>(stored.stored_bytes(), enclave_size);
+    }
+    if (offset > 0 && offset < enclave_size) {
+      LOG(INFO) << "Resuming enclave upload at byte " << offset;
+    }
+
+    // The cumulative digests cover the binary from its start, including the
+    // bytes which the server already holds.
+    Sha256Hash hasher;
+    ASYLO_RETURN_IF_ERROR(HashFile(fd, enclave_file_path, offset, &hasher));
+
     ::grpc::ClientContext context;
     ProvisionResponse response;
     auto stream = grpc_stub->Provision(&context, &response);
@@ -113,22 +211,30 @@ class RemoteProvisionClient : public RemoteProvision {
       });
       ProvisionRequest request;
       request.set_client_address(client_address.data(), client_address.size());
+      request.set_enclave_sha256(sha256);
+      request.set_enclave_size(enclave_size);
+      request.set_offset(offset);
+
+      // A cached enclave needs a single request without any data.
+      if (offset == enclave_size) {
+        stream->Write(request);
+      }
 
-      // One megabyte determined to be good buffer length.
-      static constexpr int kBufferLength = 1024 * 1024;
       request.mutable_enclave_binary()->resize(kBufferLength);
       auto read_buf =
           const_cast<char *>(request.mutable_enclave_binary()->data());
-
-      Sha256Hash hasher;
       std::vector<uint8_t> cumulative_hash;
 
       // Read enclave binary block by block, calculate cumulative SHA256 and
       // send.
-      while (true) {
-        ssize_t len = read(fd, read_buf, kBufferLength);
+      while (offset < enclave_size) {
+        ssize_t len = pread(
+            fd, read_buf,
+            std::min<uint64_t>(kBufferLength, enclave_size - offset), offset);
         if (len == 0) {
-          break;
+          return Status{error::GoogleError::DATA_LOSS,
+                        absl::StrCat("File ", enclave_file_path,
+                                     " changed while being sent")};
         } else if (len < 0) {
           if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
             continue;
@@ -148,8 +254,14 @@ class RemoteProvisionClient : public RemoteProvision {
           LOG(ERROR) << "Write failed";
           break;
         }
-        // No client address after the first block.
+        offset += len;
+        request.mutable_enclave_binary()->resize(kBufferLength);
+        read_buf = const_cast<char *>(request.mutable_enclave_binary()->data());
+        // Only the first block identifies the client and the enclave.
         request.clear_client_address();
+        request.clear_enclave_sha256();
+        request.clear_enclave_size();
+        request.clear_offset();
       }
     }
 
@@ -157,9 +269,18 @@ class RemoteProvisionClient : public RemoteProvision {
     if (response.enclave_path().empty()) {
       return Status{error::GoogleError::NOT_FOUND, "No enclave file path"};
     }
-    LOG(INFO) << "Enclave sent successfully, path=" << response.enclave_path();
+    if (response.cached()) {
+      LOG(INFO) << "Enclave already cached by the server, path="
+                << response.enclave_path();
+    } else {
+      LOG(INFO) << "Enclave sent successfully, path="
+                << response.enclave_path();
+    }
     return response.enclave_path();
   }
+
+  // One megabyte determined to be good buffer length.
+  static constexpr int kBufferLength = 1024 * 1024;
 };
 
 }  // namespace
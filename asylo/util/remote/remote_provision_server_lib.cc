@@ -59,85 +59,136 @@ grpc::Status ProvisionServiceImpl::Provision(
     grpc::ServerContext *context,
     grpc::ServerReader<ProvisionRequest> *reader,
     ProvisionResponse *response) {
-  auto filename_or_status = PrepareEnclave(reader);
+  ProvisionRequest request;
+  if (!reader->Read(&request)) {
+    return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT,
+                        "Could not read the request.");
+  }
+  if (request.client_address().empty()) {
+    return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT,
+                        "Client_address absent");
+  }
+  const std::string client_address = request.client_address();
+  request.clear_client_address();
+
+  bool cached = false;
+  auto filename_or_status =
+      request.has_enclave_sha256()
+          ? PrepareCachedEnclave(&request, reader, &cached)
+          : PrepareEnclave(&request, reader);
   if (!filename_or_status.ok()) {
     return filename_or_status.status().ToOtherStatus<grpc::Status>();
   }
+
+  // Launch the proxy only once the enclave is in place, so that an upload
+  // which fails and is resumed later does not leave a proxy behind.
+  Status status = LaunchRemoteTarget(client_address);
+  if (!status.ok()) {
+    return status.ToOtherStatus<grpc::Status>();
+  }
+
   // Return location of the enclave in the file system, accessible by the
   // proxy.
   response->set_enclave_path(filename_or_status.ValueOrDie());
+  response->set_cached(cached);
   return grpc::Status::OK;
 }
 
+grpc::Status ProvisionServiceImpl::QueryEnclave(
+    grpc::ServerContext *context, const QueryEnclaveRequest *request,
+    QueryEnclaveResponse *response) {
+  auto stored_bytes_or_status = enclave_cache_.StoredBytes(
+      request->enclave_sha256(), request->enclave_size());
+  if (!stored_bytes_or_status.ok()) {
+    return stored_bytes_or_status.status().ToOtherStatus<grpc::Status>();
+  }
+  response->set_stored_bytes(stored_bytes_or_status.ValueOrDie());
+  return grpc::Status::OK;
+}
+
+Status ProvisionServiceImpl::LaunchRemoteTarget(
+    const std::string &client_address) {
+  pid_t remote_target_pid;
+  ASYLO_ASSIGN_OR_RETURN(
+      remote_target_pid,
+      LaunchProxy(client_address, absl::GetFlag(FLAGS_remote_proxy)));
+  remote_targets_pids_.Lock()->emplace(remote_target_pid);
+
+  // Create a thread to wait for the forked process to finish.
+  Thread::StartDetached([remote_target_pid, this] {
+    WaitProxyTermination(remote_target_pid);
+    remote_targets_pids_.Lock()->erase(remote_target_pid);
+  });
+  return Status::OkStatus();
+}
+
 StatusOr<std::string> ProvisionServiceImpl::PrepareEnclave(
-    grpc::ServerReader<ProvisionRequest> *reader) {
+    ProvisionRequest *request, grpc::ServerReader<ProvisionRequest> *reader) {
   const std::string filename =
       JoinPath(storage_dir_, absl::StrCat("enclave_", ++enclave_index_));
   Sha256Hash hasher;
-  {
-    ProvisionRequest request;
-    if (!reader->Read(&request)) {
-      return Status{error::GoogleError::INVALID_ARGUMENT,
-                    "Could not read the request."};
-    }
 
-    if (request.client_address().empty()) {
-      return Status{error::GoogleError::INVALID_ARGUMENT,
-                    "Client_address absent"};
-    }
-    pid_t remote_target_pid;
-    ASYLO_ASSIGN_OR_RETURN(remote_target_pid,
-                           LaunchProxy(request.client_address(),
-                                       absl::GetFlag(FLAGS_remote_proxy)));
-    request.clear_client_address();
-    remote_targets_pids_.Lock()->emplace(remote_target_pid);
-
-    // Create a thread to wait for the forked process to finish.
-    Thread::StartDetached([remote_target_pid, this] {
-      WaitProxyTermination(remote_target_pid);
-      remote_targets_pids_.Lock()->erase(remote_target_pid);
-    });
-
-    // Read and store the enclave binary.
-    int fd = open(filename.c_str(), O_CREAT | O_WRONLY,
-                  S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
-    if (fd < 0) {
-      return Status{static_cast<error::PosixError>(errno),
-                    absl::StrCat("Failed to open file ", filename)};
-    }
-    Cleanup closer([fd] { close(fd); });
-
-    do {
-      if (!request.enclave_binary().empty()) {
-        hasher.Update(request.enclave_binary());
-        std::vector<uint8_t> hash(kSha256DigestLength, '\0');
-        hasher.CumulativeHash(&hash);
-        if (ByteContainerView(request.cumulative_sha256()) !=
-            ByteContainerView(hash)) {
-          return Status{error::GoogleError::DATA_LOSS,
-                        "SHA256 hash mismatch"};
-        }
-        int write_res = write(fd, request.enclave_binary().data(),
-                              request.enclave_binary().size());
-        if (write_res < request.enclave_binary().size()) {
-          return Status{static_cast<error::PosixError>(errno),
-                        absl::StrCat("Failed to write into file ", filename)};
-        }
+  // Read and store the enclave binary.
+  int fd = open(filename.c_str(), O_CREAT | O_WRONLY,
+                S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+  if (fd < 0) {
+    return Status{static_cast<error::PosixError>(errno),
+                  absl::StrCat("Failed to open file ", filename)};
+  }
+  Cleanup closer([fd] { close(fd); });
+
+  do {
+    if (!request->enclave_binary().empty()) {
+      hasher.Update(request->enclave_binary());
+      std::vector<uint8_t> hash(kSha256DigestLength, '\0');
+      hasher.CumulativeHash(&hash);
+      if (ByteContainerView(request->cumulative_sha256()) !=
+          ByteContainerView(hash)) {
+        return Status{error::GoogleError::DATA_LOSS, "SHA256 hash mismatch"};
       }
-      if (!request.client_address().empty()) {
-        return Status{
-            error::GoogleError::FAILED_PRECONDITION,
-            "Client address present in more than on streamed request"};
+      int write_res = write(fd, request->enclave_binary().data(),
+                            request->enclave_binary().size());
+      if (write_res < request->enclave_binary().size()) {
+        return Status{static_cast<error::PosixError>(errno),
+                      absl::StrCat("Failed to write into file ", filename)};
       }
-    } while (reader->Read(&request));
-  }
+    }
+    if (!request->client_address().empty()) {
+      return Status{error::GoogleError::FAILED_PRECONDITION,
+                    "Client address present in more than on streamed request"};
+    }
+  } while (reader->Read(request));
 
-  // Return location of the enclave in the file system, accessible by the
-  // proxy.
   LOG(INFO) << "Enclave successfully uploaded, filename=" << filename;
   return filename;
 }
 
+StatusOr<std::string> ProvisionServiceImpl::PrepareCachedEnclave(
+    ProvisionRequest *request, grpc::ServerReader<ProvisionRequest> *reader,
+    bool *cached) {
+  std::unique_ptr<EnclaveCache::Upload> upload;
+  ASYLO_ASSIGN_OR_RETURN(
+      upload,
+      enclave_cache_.StartUpload(request->enclave_sha256(),
+                                 request->enclave_size(), request->offset()));
+  *cached = upload->cached();
+
+  // Each block is written through to the cache as it arrives, so that an
+  // interrupted upload keeps the blocks received so far.
+  do {
+    if (!request->enclave_binary().empty()) {
+      ASYLO_RETURN_IF_ERROR(upload->Append(request->enclave_binary(),
+                                           request->cumulative_sha256()));
+    }
+    if (!request->client_address().empty()) {
+      return Status{error::GoogleError::FAILED_PRECONDITION,
+                    "Client address present in more than on streamed request"};
+    }
+  } while (reader->Read(request));
+
+  return upload->Finish();
+}
+
 StatusOr<std::unique_ptr<RemoteProvisionServer>> RemoteProvisionServer::Create(
       ::grpc::ServerBuilder *builder, absl::string_view temporary_directory) {
   // Check flags.
@@ -21,6 +21,7 @@
 
 #include "absl/container/flat_hash_set.h"
 #include "asylo/util/mutex_guarded.h"
+#include "asylo/util/remote/enclave_cache.h"
 #include "asylo/util/remote/remote_provision.grpc.pb.h"
 #include "asylo/util/remote/remote_provision.pb.h"
 #include "asylo/util/statusor.h"
@@ -37,6 +38,7 @@ class ProvisionServiceImpl : public ProvisionService::Service {
  public:
   explicit ProvisionServiceImpl(absl::string_view storage_dir)
       : storage_dir_(storage_dir),
+        enclave_cache_(storage_dir),
         remote_targets_pids_(absl::flat_hash_set<pid_t>()) {}
   ProvisionServiceImpl(const ProvisionServiceImpl &other) = delete;
   ProvisionServiceImpl &operator=(const ProvisionServiceImpl &other) = delete;
@@ -45,12 +47,28 @@ class ProvisionServiceImpl : public ProvisionService::Service {
                          grpc::ServerReader<ProvisionRequest> *reader,
                          ProvisionResponse *response) override;
 
+  grpc::Status QueryEnclave(grpc::ServerContext *context,
+                            const QueryEnclaveRequest *request,
+                            QueryEnclaveResponse *response) override;
+
  private:
+  // Receives the enclave binary streamed by |reader|, starting with the
+  // contents of |request|, and stores it in a new file.
   StatusOr<std::string> PrepareEnclave(
-      grpc::ServerReader<ProvisionRequest> *reader);
+      ProvisionRequest *request, grpc::ServerReader<ProvisionRequest> *reader);
+
+  // Like PrepareEnclave, but stores the enclave in |enclave_cache_|, or finds
+  // it there. Sets |cached| to whether it was found.
+  StatusOr<std::string> PrepareCachedEnclave(
+      ProvisionRequest *request, grpc::ServerReader<ProvisionRequest> *reader,
+      bool *cached);
+
+  // Launches a proxy which connects to |client_address| to load the enclave.
+  Status LaunchRemoteTarget(const std::string &client_address);
 
   std::atomic<uint64_t> enclave_index_{0};
   const std::string storage_dir_;
+  EnclaveCache enclave_cache_;
   MutexGuarded<absl::flat_hash_set<pid_t>> remote_targets_pids_;
 };
 
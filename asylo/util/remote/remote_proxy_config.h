@@ -19,10 +19,13 @@
 #ifndef ASYLO_UTIL_REMOTE_REMOTE_PROXY_CONFIG_H_
 #define ASYLO_UTIL_REMOTE_REMOTE_PROXY_CONFIG_H_
 
+#include <cstddef>
 #include <cstdint>
+#include <deque>
 #include <functional>
 #include <memory>
 #include <string>
+#include <utility>
 
 #include "absl/strings/string_view.h"
 #include "absl/time/time.h"
@@ -31,6 +34,7 @@
 #include "asylo/util/remote/provision.h"
 #include "asylo/util/status.h"
 #include "asylo/util/statusor.h"
+#include "include/grpc/compression.h"
 #include "include/grpcpp/security/credentials.h"
 #include "include/grpcpp/security/server_credentials.h"
 #include "include/grpcpp/support/channel_arguments.h"
@@ -97,8 +101,81 @@ class RemoteProxyConfig {
     return connection_config_->server_creds();
   }
 
+  // EnableMessageCoalescing lets this side hold outgoing messages for up to
+  // |window|, so that messages sent by several threads within that time travel
+  // to the counterpart in a single frame. Each message may be delayed by up to
+  // |window|, in exchange for far fewer frames when many threads send small
+  // messages over a slow connection.
+  void EnableMessageCoalescing(absl::Duration window) {
+    message_coalescing_window_ = window;
+  }
+
+  // Returns the coalescing window, which is zero if coalescing is disabled.
+  absl::Duration message_coalescing_window() const {
+    return message_coalescing_window_;
+  }
+
+  // SetChannelCompression makes gRPC compress every call this side makes to
+  // the counterpart with |algorithm|. gRPC negotiates the algorithm with the
+  // counterpart, and sends uncompressed calls if it is not supported there.
+  void SetChannelCompression(grpc_compression_algorithm algorithm) {
+    channel_compression_ = algorithm;
+  }
+
+  grpc_compression_algorithm channel_compression() const {
+    return channel_compression_;
+  }
+
+  // EnablePayloadCompression makes this side compress the payload of every
+  // message it sends with zlib, if the payload is at least |threshold| bytes
+  // and shrinks. Unlike channel compression, this spares small messages the
+  // cost of compression, and also applies to coalesced messages individually.
+  void EnablePayloadCompression(size_t threshold) {
+    payload_compression_threshold_ = threshold;
+  }
+
+  // Returns the payload compression threshold, if payload compression is
+  // enabled.
+  absl::optional<size_t> payload_compression_threshold() const {
+    return payload_compression_threshold_;
+  }
+
+  // EnableHealthChecking makes this side check the connection to the
+  // counterpart every |interval|, with both HTTP/2 keepalive pings and a
+  // heartbeat call, which also carries the current time when sent by the host.
+  // If the counterpart does not answer within |timeout|, the connection is
+  // considered lost: invocations in flight and later ones fail with
+  // UNAVAILABLE instead of waiting for the counterpart, so that a dead
+  // counterpart is noticed within |interval| + |timeout|.
+  void EnableHealthChecking(absl::Duration interval, absl::Duration timeout) {
+    health_check_interval_ = interval;
+    health_check_timeout_ = timeout;
+  }
+
+  // Returns the health checking interval, which is zero if health checking is
+  // disabled.
+  absl::Duration health_check_interval() const {
+    return health_check_interval_;
+  }
+
+  absl::Duration health_check_timeout() const { return health_check_timeout_; }
+
  private:
   std::unique_ptr<RemoteProxyConnectionConfig> connection_config_;
+
+  // How long to hold outgoing messages to coalesce them, if at all.
+  absl::Duration message_coalescing_window_ = absl::ZeroDuration();
+
+  // Compression of outgoing gRPC calls.
+  grpc_compression_algorithm channel_compression_ = GRPC_COMPRESS_NONE;
+
+  // Smallest payload to compress, if payloads are compressed at all.
+  absl::optional<size_t> payload_compression_threshold_;
+
+  // How often to check the connection, if at all, and how long to wait for
+  // the counterpart to answer.
+  absl::Duration health_check_interval_ = absl::ZeroDuration();
+  absl::Duration health_check_timeout_ = absl::ZeroDuration();
 };
 
 // |RemoteProxyClientConfig| provides |RemoteEnclaveProxyClient| with the
@@ -155,6 +232,40 @@ class RemoteProxyClientConfig : public RemoteProxyConfig {
   }
   void RunFinalize() { provision_->Finalize(); }
 
+  // EnableReconnect lets the client replace a proxy it has lost the connection
+  // to (see EnableHealthChecking) with a new one, launched by the same
+  // RemoteProvision. The enclave is loaded anew in the new proxy: whatever
+  // state it held is gone, and calls in flight when the connection was lost
+  // fail with UNAVAILABLE.
+  void EnableReconnect() { reconnect_ = true; }
+
+  bool reconnect_enabled() const { return reconnect_; }
+
+  // AddStandbyProvision adds |provision| to the standbys used, in the order
+  // they were added, to launch a replacement proxy when the connection to the
+  // current one is lost and cannot be re-established. As with
+  // EnableReconnect, the enclave is loaded anew in the replacement proxy.
+  void AddStandbyProvision(std::unique_ptr<RemoteProvision> provision) {
+    standby_provisions_.push_back(std::move(provision));
+  }
+
+  // Returns true if a lost proxy may be replaced at all.
+  bool failover_enabled() const {
+    return reconnect_ || !standby_provisions_.empty();
+  }
+
+  // Finalizes the current provision and replaces it with the next standby.
+  // Returns false, keeping the current provision, if there is none left.
+  bool SwitchToStandbyProvision() {
+    if (standby_provisions_.empty()) {
+      return false;
+    }
+    provision_->Finalize();
+    provision_ = std::move(standby_provisions_.front());
+    standby_provisions_.pop_front();
+    return true;
+  }
+
   // EnableMetricsCollection allows a user to turn on OpenCensus metrics
   // collection of enclave process metrics.
   // Note: Metrics will be collected, but an exporter needs to be setup per the
@@ -180,6 +291,17 @@ class RemoteProxyClientConfig : public RemoteProxyConfig {
     return *open_census_config_;
   }
 
+  // EnableSharedMemoryTransport lets the host negotiate a shared memory
+  // transport with the enclave proxy. Messages are then passed through a
+  // shared memory segment instead of gRPC, which is much faster but only
+  // possible when the proxy runs on the same machine. If it does not, the
+  // negotiation fails and gRPC is used as before.
+  void EnableSharedMemoryTransport() { shared_memory_transport_ = true; }
+
+  bool shared_memory_transport_enabled() const {
+    return shared_memory_transport_;
+  }
+
  private:
   RemoteProxyClientConfig(
       std::unique_ptr<RemoteProxyConnectionConfig> connection_config,
@@ -187,10 +309,18 @@ class RemoteProxyClientConfig : public RemoteProxyConfig {
       : RemoteProxyConfig(std::move(connection_config)),
         provision_(std::move(provision)) {}
 
-  const std::unique_ptr<RemoteProvision> provision_;
+  // Provision of the current proxy, followed by the standbys not used yet.
+  std::unique_ptr<RemoteProvision> provision_;
+  std::deque<std::unique_ptr<RemoteProvision>> standby_provisions_;
+
+  // Whether to replace a lost proxy using |provision_| again.
+  bool reconnect_ = false;
 
   // Configuration for OpenCensus.
   absl::optional<OpenCensusClientConfig> open_census_config_;
+
+  // Whether to negotiate a shared memory transport.
+  bool shared_memory_transport_ = false;
 };
 
 // |RemoteProxyServerConfig| provides a |RemoteEnclaveProxyServer| with the
@@ -103,6 +103,66 @@ TEST(RemoteProxyClientConfigTest, OpenCensusMetricsConfigAddedCorrectly) {
   EXPECT_THAT(config_result.ValueOrDie().view_name_root, StrEq(kViewNameRoot));
 }
 
+TEST(RemoteProxyClientConfigTest, SharedMemoryTransportIsOptIn) {
+  std::unique_ptr<RemoteProxyClientConfig> config;
+  ASYLO_ASSERT_OK_AND_ASSIGN(config,
+                             RemoteProxyClientConfig::DefaultsWithProvision(
+                                 absl::make_unique<MockProvision>()));
+  EXPECT_THAT(config->shared_memory_transport_enabled(), Eq(false));
+
+  config->EnableSharedMemoryTransport();
+  EXPECT_THAT(config->shared_memory_transport_enabled(), Eq(true));
+}
+
+TEST(RemoteProxyClientConfigTest, FailoverIsOptIn) {
+  std::unique_ptr<RemoteProxyClientConfig> config;
+  ASYLO_ASSERT_OK_AND_ASSIGN(config,
+                             RemoteProxyClientConfig::DefaultsWithProvision(
+                                 absl::make_unique<MockProvision>()));
+  EXPECT_THAT(config->reconnect_enabled(), Eq(false));
+  EXPECT_THAT(config->failover_enabled(), Eq(false));
+  EXPECT_THAT(config->SwitchToStandbyProvision(), Eq(false));
+
+  config->EnableReconnect();
+  EXPECT_THAT(config->reconnect_enabled(), Eq(true));
+  EXPECT_THAT(config->failover_enabled(), Eq(true));
+}
+
+TEST(RemoteProxyClientConfigTest, StandbyProvisionsAreUsedInOrder) {
+  auto primary = absl::make_unique<MockProvision>();
+  auto first_standby = absl::make_unique<MockProvision>();
+  auto second_standby = absl::make_unique<MockProvision>();
+  auto raw_primary = primary.get();
+  auto raw_first_standby = first_standby.get();
+  auto raw_second_standby = second_standby.get();
+  std::unique_ptr<RemoteProxyClientConfig> config;
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      config,
+      RemoteProxyClientConfig::DefaultsWithProvision(std::move(primary)));
+  config->AddStandbyProvision(std::move(first_standby));
+  config->AddStandbyProvision(std::move(second_standby));
+  EXPECT_THAT(config->failover_enabled(), Eq(true));
+
+  // Switching finalizes the provision being replaced.
+  EXPECT_CALL(*raw_primary, Finalize()).WillOnce(Return());
+  ASSERT_THAT(config->SwitchToStandbyProvision(), Eq(true));
+  EXPECT_CALL(*raw_first_standby, Provision(1234, absl::string_view("path")))
+      .WillOnce(Return(std::string("first")));
+  std::string provisioned_path;
+  ASYLO_ASSERT_OK_AND_ASSIGN(provisioned_path,
+                             config->RunProvision(1234, "path"));
+  EXPECT_THAT(provisioned_path, StrEq("first"));
+
+  EXPECT_CALL(*raw_first_standby, Finalize()).WillOnce(Return());
+  ASSERT_THAT(config->SwitchToStandbyProvision(), Eq(true));
+  EXPECT_THAT(config->failover_enabled(), Eq(false));
+
+  // The last standby remains in use once there is none left.
+  EXPECT_THAT(config->SwitchToStandbyProvision(), Eq(false));
+  EXPECT_CALL(*raw_second_standby, Finalize()).WillOnce(Return());
+  config->RunFinalize();
+}
+
 TEST(RemoteProxyServerConfigTest, DefaultsAreAsExpected) {
   std::unique_ptr<RemoteProxyServerConfig> config;
   ASYLO_ASSERT_OK_AND_ASSIGN(
@@ -113,5 +173,39 @@ TEST(RemoteProxyServerConfigTest, DefaultsAreAsExpected) {
   EXPECT_THAT(config->server_creds(), Not(IsNull()));
 }
 
+TEST(RemoteProxyServerConfigTest, MessageCoalescingIsOptIn) {
+  std::unique_ptr<RemoteProxyServerConfig> config;
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      config, RemoteProxyServerConfig::DefaultsWithHostAddress(kHostAddress));
+  EXPECT_THAT(config->message_coalescing_window(), Eq(absl::ZeroDuration()));
+
+  config->EnableMessageCoalescing(absl::Microseconds(50));
+  EXPECT_THAT(config->message_coalescing_window(), Eq(absl::Microseconds(50)));
+}
+
+TEST(RemoteProxyServerConfigTest, CompressionIsOptIn) {
+  std::unique_ptr<RemoteProxyServerConfig> config;
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      config, RemoteProxyServerConfig::DefaultsWithHostAddress(kHostAddress));
+  EXPECT_THAT(config->channel_compression(), Eq(GRPC_COMPRESS_NONE));
+  EXPECT_THAT(config->payload_compression_threshold(), Eq(absl::nullopt));
+
+  config->SetChannelCompression(GRPC_COMPRESS_GZIP);
+  config->EnablePayloadCompression(4096);
+  EXPECT_THAT(config->channel_compression(), Eq(GRPC_COMPRESS_GZIP));
+  EXPECT_THAT(config->payload_compression_threshold(), Eq(4096));
+}
+
+TEST(RemoteProxyServerConfigTest, HealthCheckingIsOptIn) {
+  std::unique_ptr<RemoteProxyServerConfig> config;
+  ASYLO_ASSERT_OK_AND_ASSIGN(
+      config, RemoteProxyServerConfig::DefaultsWithHostAddress(kHostAddress));
+  EXPECT_THAT(config->health_check_interval(), Eq(absl::ZeroDuration()));
+
+  config->EnableHealthChecking(absl::Seconds(1), absl::Milliseconds(500));
+  EXPECT_THAT(config->health_check_interval(), Eq(absl::Seconds(1)));
+  EXPECT_THAT(config->health_check_timeout(), Eq(absl::Milliseconds(500)));
+}
+
 }  // namespace
 }  // namespace asylo
@@ -38,49 +38,87 @@ constexpr char kStatusProtoOkMismatchMsg[] =
     "The ErrorSpace error_code equivalent of GoogleError::OK should be zero";
 #endif
 
-Status::Status()
-    : error_space_(
-          error::error_enum_traits<error::GoogleError>::get_error_space()),
-      error_code_(error::GoogleError::OK) {}
-
 Status::Status(const error::ErrorSpace *space, int code,
                absl::string_view message)
-    : error_space_(space), error_code_(code) {
-  if (code != 0) {
-    message_ = std::string(message);
-  }
+    : rep_(kOkRep) {
+  Set(space, code, message);
 }
 
-Status::Status(Status &&other)
-    : error_space_(other.error_space_),
-      error_code_(other.error_code_),
-      message_(std::move(other.message_)) {
-  other.Set(error::StatusError::MOVED, kMovedByConstructorErrorMsg);
+Status &Status::operator=(const Status &other) {
+  if (rep_ != other.rep_) {
+    uintptr_t rep = other.IsAllocated() ? CopyRep(other.rep_) : other.rep_;
+    if (IsAllocated()) {
+      DeleteRep(rep_);
+    }
+    rep_ = rep;
+  }
+  return *this;
 }
 
 Status &Status::operator=(Status &&other) {
-  error_space_ = other.error_space_;
-  error_code_ = other.error_code_;
-  message_ = std::move(other.message_);
-  other.Set(error::StatusError::MOVED, kMovedByAssignmentErrorMsg);
+  uintptr_t rep = other.rep_;
+  other.rep_ = kMovedByAssignmentRep;
+  if (IsAllocated() && rep_ != rep) {
+    DeleteRep(rep_);
+  }
+  rep_ = rep;
   return *this;
 }
 
 Status Status::OkStatus() { return Status(); }
 
-int Status::error_code() const { return error_code_; }
-
-absl::string_view Status::error_message() const { return message_; }
+int Status::error_code() const {
+  switch (rep_) {
+    case kOkRep:
+      return error::GoogleError::OK;
+    case kMovedByConstructorRep:
+    case kMovedByAssignmentRep:
+      return static_cast<int>(error::StatusError::MOVED);
+    default:
+      if ((rep_ & kTagMask) == kInlineCodeTag) {
+        return static_cast<int>(rep_ >> 3);
+      }
+      return reinterpret_cast<const Rep *>(rep_)->error_code;
+  }
+}
 
-const error::ErrorSpace *Status::error_space() const { return error_space_; }
+absl::string_view Status::error_message() const {
+  switch (rep_) {
+    case kOkRep:
+      return absl::string_view();
+    case kMovedByConstructorRep:
+      return kMovedByConstructorErrorMsg;
+    case kMovedByAssignmentRep:
+      return kMovedByAssignmentErrorMsg;
+    default:
+      if ((rep_ & kTagMask) == kInlineCodeTag) {
+        return absl::string_view();
+      }
+      return reinterpret_cast<const Rep *>(rep_)->message;
+  }
+}
 
-bool Status::ok() const { return error_code_ == 0; }
+const error::ErrorSpace *Status::error_space() const {
+  switch (rep_) {
+    case kOkRep:
+      return error::error_enum_traits<error::GoogleError>::get_error_space();
+    case kMovedByConstructorRep:
+    case kMovedByAssignmentRep:
+      return error::error_enum_traits<error::StatusError>::get_error_space();
+    default:
+      if ((rep_ & kTagMask) == kInlineCodeTag) {
+        return error::error_enum_traits<error::GoogleError>::get_error_space();
+      }
+      return reinterpret_cast<const Rep *>(rep_)->error_space;
+  }
+}
 
 std::string Status::ToString() const {
-  return ok() ? error_space_->String(error_code_)
-              : absl::StrCat(error_space_->SpaceName(),
-                             "::", error_space_->String(error_code_), ": ",
-                             message_);
+  const error::ErrorSpace *space = error_space();
+  return ok() ? space->String(error_code())
+              : absl::StrCat(space->SpaceName(),
+                             "::", space->String(error_code()), ": ",
+                             error_message());
 }
 
 Status Status::ToCanonical() const {
@@ -89,34 +127,34 @@ Status Status::ToCanonical() const {
 }
 
 error::GoogleError Status::CanonicalCode() const {
-  return error_space_->GoogleErrorCode(error_code_);
+  return error_space()->GoogleErrorCode(error_code());
 }
 
 void Status::SaveTo(StatusProto *status_proto) const {
-  status_proto->set_code(error_code_);
-  status_proto->set_error_message(message_);
-  status_proto->set_space(error_space_->SpaceName());
+  status_proto->set_code(error_code());
+  status_proto->set_error_message(std::string(error_message()));
+  status_proto->set_space(error_space()->SpaceName());
   status_proto->set_canonical_code(CanonicalCode());
 }
 
 void Status::RestoreFrom(const StatusProto &status_proto) {
   // Set the error code from the error space, if recognized.
-  error_space_ = error::ErrorSpace::Find(status_proto.space());
-  if (error_space_) {
+  const error::ErrorSpace *space = error::ErrorSpace::Find(status_proto.space());
+  int code;
+  if (space) {
     // The canonical code must match the canonical code as computed by the
     // error space.
     if (status_proto.has_canonical_code() &&
-        (error_space_->GoogleErrorCode(status_proto.code()) !=
+        (space->GoogleErrorCode(status_proto.code()) !=
          status_proto.canonical_code())) {
       Set(error::StatusError::RESTORE_ERROR, kStatusProtoErrorSpaceMsg);
       return;
     } else {
-      error_code_ = status_proto.code();
+      code = status_proto.code();
     }
   } else {
     // Error space lookup failed. Use the canonical error space.
-    error_space_ =
-        error::error_enum_traits<error::GoogleError>::get_error_space();
+    space = error::error_enum_traits<error::GoogleError>::get_error_space();
 
     // Both error code and canonical code must be OK, or neither.
     if (status_proto.has_canonical_code() &&
@@ -125,26 +163,55 @@ void Status::RestoreFrom(const StatusProto &status_proto) {
       return;
     }
     if (status_proto.has_canonical_code()) {
-      error_code_ = status_proto.canonical_code();
+      code = status_proto.canonical_code();
     } else {
       // Default to error::GoogleError::UNKNOWN.
-      error_code_ = error::GoogleError::UNKNOWN;
+      code = error::GoogleError::UNKNOWN;
     }
   }
-  if (error_code_ != 0) {
-    message_ = status_proto.error_message();
-  } else {
-    message_.clear();
-  }
+  Set(space, code, status_proto.error_message());
 }
 
 Status Status::WithPrependedContext(absl::string_view context) {
-  message_ = absl::StrCat(context, ": ", message_);
+  Set(error_space(), error_code(),
+      absl::StrCat(context, ": ", error_message()));
   return *this;
 }
 
+void Status::Set(const error::ErrorSpace *space, int code,
+                 absl::string_view message) {
+  if (space == error::error_enum_traits<error::GoogleError>::get_error_space() &&
+      code >= 0 && static_cast<uintptr_t>(code) < kMaxInlineCode &&
+      (code == 0 || message.empty())) {
+    if (IsAllocated()) {
+      DeleteRep(rep_);
+    }
+    rep_ = code == 0 ? kOkRep
+                     : (static_cast<uintptr_t>(code) << 3) | kInlineCodeTag;
+    return;
+  }
+  if (!IsAllocated()) {
+    rep_ = reinterpret_cast<uintptr_t>(new Rep);
+  }
+  Rep *rep = reinterpret_cast<Rep *>(rep_);
+  rep->error_space = space;
+  rep->error_code = code;
+  if (code != 0) {
+    rep->message.assign(message.data(), message.size());
+  } else {
+    rep->message.clear();
+  }
+}
+
+uintptr_t Status::CopyRep(uintptr_t rep) {
+  return reinterpret_cast<uintptr_t>(
+      new Rep(*reinterpret_cast<const Rep *>(rep)));
+}
+
+void Status::DeleteRep(uintptr_t rep) { delete reinterpret_cast<Rep *>(rep); }
+
 bool Status::IsCanonical() const {
-  return error_space_->SpaceName() == error::kCanonicalErrorSpaceName;
+  return error_space()->SpaceName() == error::kCanonicalErrorSpaceName;
 }
 
 bool operator==(const Status &lhs, const Status &rhs) {
@@ -19,6 +19,7 @@
 #ifndef ASYLO_UTIL_STATUS_H_
 #define ASYLO_UTIL_STATUS_H_
 
+#include <cstdint>
 #include <ostream>
 #include <string>
 #include <type_traits>
@@ -40,10 +41,14 @@ namespace asylo {
 /// Status contains information about an error. Status contains an error code
 /// from some error space and a message string suitable for logging or
 /// debugging.
+///
+/// A Status takes a single pointer-sized word. Creating, copying, moving and
+/// destroying an OK Status, or a Status with a canonical error code and no
+/// message, does not allocate.
 class Status {
  public:
   /// Builds an OK Status in the canonical error space.
-  Status();
+  Status() : rep_(kOkRep) {}
 
   /// Constructs a Status object containing an error code and message.
   ///
@@ -58,15 +63,24 @@ class Status {
   /// \param code A symbolic error code.
   /// \param message The associated error message.
   template <typename Enum>
-  Status(Enum code, absl::string_view message) {
+  Status(Enum code, absl::string_view message) : rep_(kOkRep) {
     Set(code, message);
   }
 
-  Status(const Status &other) = default;
+  Status(const Status &other)
+      : rep_(other.IsAllocated() ? CopyRep(other.rep_) : other.rep_) {}
 
   // Non-default move constructor since the moved status should be set to
   // indicate an invalid state, which changes the code and error_space.
-  Status(Status &&other);
+  Status(Status &&other) : rep_(other.rep_) {
+    other.rep_ = kMovedByConstructorRep;
+  }
+
+  ~Status() {
+    if (IsAllocated()) {
+      DeleteRep(rep_);
+    }
+  }
 
   /// Constructs a Status object from `StatusT`. `StatusT` must be a status-type
   /// object. I.e.,
@@ -83,16 +97,16 @@ class Status {
   template <typename StatusT,
             typename E = typename absl::enable_if_t<
                 status_internal::status_type_traits<StatusT>::is_status>>
-  explicit Status(const StatusT &other) {
+  explicit Status(const StatusT &other) : rep_(kOkRep) {
     Set(status_internal::status_type_traits<StatusT>::CanonicalCode(other),
         other.error_message());
   }
 
-  explicit Status(const absl::Status &other) {
+  explicit Status(const absl::Status &other) : rep_(kOkRep) {
     Set(static_cast<error::GoogleError>(other.raw_code()), other.message());
   }
 
-  Status &operator=(const Status &other) = default;
+  Status &operator=(const Status &other);
 
   // Non-default move assignment operator since the moved status should be set
   // to indicate an invalid state, which changes the code and error_space.
@@ -122,8 +136,8 @@ class Status {
                 status_internal::status_type_traits<StatusT>::is_status>>
   StatusT ToOtherStatus() {
     Status status = ToCanonical();
-    return StatusT(status_internal::ErrorCodeHolder(status.error_code_),
-                   status.message_);
+    return StatusT(status_internal::ErrorCodeHolder(status.error_code()),
+                   std::string(status.error_message()));
   }
 
   // Type-cast operators from
@@ -153,8 +167,9 @@ class Status {
   //  }
   operator ::absl::Status() {
     Status status = ToCanonical();
-    return ::absl::Status(static_cast<::absl::StatusCode>(status.error_code_),
-                          status.message_);
+    return ::absl::Status(
+        static_cast<::absl::StatusCode>(status.error_code()),
+        status.error_message());
   }
 
   template <class T>
@@ -180,7 +195,10 @@ class Status {
   /// Indicates whether this object is OK (indicates no error).
   ///
   /// \return True if this object indicates no error.
-  bool ok() const;
+  bool ok() const {
+    return rep_ == kOkRep ||
+           (IsAllocated() && reinterpret_cast<Rep *>(rep_)->error_code == 0);
+  }
 
   /// Gets a string representation of this object.
   ///
@@ -243,8 +261,9 @@ class Status {
   /// \return True if this object matches `code`.
   template <typename Enum>
   bool Is(Enum code) const {
-    return (static_cast<int>(code) == error_code_) &&
-           (error::error_enum_traits<Enum>::get_error_space() == error_space_);
+    return (static_cast<int>(code) == error_code()) &&
+           (error::error_enum_traits<Enum>::get_error_space() ==
+            error_space());
   }
 
   /// Modifies this object to have `context` prepended to the error message.
@@ -256,28 +275,52 @@ class Status {
   Status WithPrependedContext(absl::string_view context);
 
  private:
+  // The contents of a Status that is neither OK in the canonical error space
+  // nor moved-from.
+  struct Rep {
+    const error::ErrorSpace *error_space;
+    int error_code;
+
+    // An optional error-message if error_code is non-zero. If error_code is
+    // zero, then message is empty.
+    std::string message;
+  };
+
+  // Values of |rep_| that do not point to a Rep. Rep pointers have their low
+  // three bits clear.
+  enum : uintptr_t {
+    kOkRep = 0,
+    kMovedByConstructorRep = 1,
+    kMovedByAssignmentRep = 2,
+
+    // Tags a canonical error code below kMaxInlineCode, stored in the bits
+    // above the low three, for a Status without a message.
+    kInlineCodeTag = 4,
+    kTagMask = 7,
+    kMaxInlineCode = 1 << 16,
+  };
+
   // Sets this object to hold an error code |code| and error message |message|.
-  template <typename Enum, typename StringT>
-  void Set(Enum code, StringT &&message) {
-    error_space_ = error::error_enum_traits<Enum>::get_error_space();
-    error_code_ = static_cast<int>(code);
-    if (error_code_ != 0) {
-      message_ = std::string(std::forward<StringT>(message));
-    } else {
-      message_.clear();
-    }
+  template <typename Enum>
+  void Set(Enum code, absl::string_view message) {
+    Set(error::error_enum_traits<Enum>::get_error_space(),
+        static_cast<int>(code), message);
   }
 
+  void Set(const error::ErrorSpace *space, int code, absl::string_view message);
+
+  // Returns true if |rep_| points to a Rep.
+  bool IsAllocated() const { return rep_ != kOkRep && (rep_ & kTagMask) == 0; }
+
+  static uintptr_t CopyRep(uintptr_t rep);
+  static void DeleteRep(uintptr_t rep);
+
   // Returns true if the error code for this object is in the canonical error
   // space.
   bool IsCanonical() const;
 
-  const error::ErrorSpace *error_space_;
-  int error_code_;
-
-  // An optional error-message if error_code_ is non-zero. If error_code_ is
-  // zero, then message_ is empty.
-  std::string message_;
+  // Either one of the values above, or a pointer to the Rep of this object.
+  uintptr_t rep_;
 };
 
 bool operator==(const Status &lhs, const Status &rhs);
@@ -42,15 +42,16 @@ inline constexpr bool HasStatus(...) {
 // `StatusOr`-like overload which returns a wrapped `Status`-like value.
 template <typename T,
           typename std::enable_if<HasStatus<T>(nullptr), int>::type = 0>
-inline auto ToStatus(T&& status_or) -> decltype(status_or.status()) {
-  return status_or.status();
+inline auto ToStatus(T&& status_or)
+    -> decltype(std::forward<T>(status_or).status()) {
+  return std::forward<T>(status_or).status();
 }
 
 // Identity function for all `Status`-like objects.
 template <typename T,
           typename std::enable_if<!HasStatus<T>(nullptr), int>::type = 0>
 inline T ToStatus(T&& status_like) {
-  return status_like;
+  return std::forward<T>(status_like);
 }
 
 }  // namespace internal
@@ -115,7 +116,7 @@ do {                                                                        \
 do {                                                      \
   auto _asylo_status_or_value = (rexpr);                  \
   if (ABSL_PREDICT_FALSE(!_asylo_status_or_value.ok())) { \
-    return _asylo_status_or_value.status();               \
+    return std::move(_asylo_status_or_value).status();    \
   }                                                       \
   lhs = std::move(_asylo_status_or_value).ValueOrDie();   \
 } while (false)
@@ -515,6 +515,43 @@ TEST(StatusTest, MoveAssignmentTestOk) {
   EXPECT_THAT(ok, StatusIs(error::StatusError::MOVED));
 }
 
+TEST(StatusTest, StatusIsOneWord) {
+  EXPECT_EQ(sizeof(Status), sizeof(void *));
+}
+
+TEST(StatusTest, CanonicalCodeWithoutMessage) {
+  Status status(error::GoogleError::UNAVAILABLE, "");
+  Status that = status;
+
+  EXPECT_THAT(that, StatusIs(error::GoogleError::UNAVAILABLE, ""));
+  EXPECT_EQ(that, status);
+  EXPECT_THAT(that.WithPrependedContext(kContext),
+              StatusIs(error::GoogleError::UNAVAILABLE, "At index 1: "));
+}
+
+TEST(StatusTest, MovedStatusCanBeReassigned) {
+  Status status(error::GoogleError::INVALID_ARGUMENT, kErrorMessage1);
+  Status that(std::move(status));
+  status = that;
+
+  EXPECT_THAT(status,
+              StatusIs(error::GoogleError::INVALID_ARGUMENT, kErrorMessage1));
+  EXPECT_THAT(status.WithPrependedContext(kContext),
+              StatusIs(error::GoogleError::INVALID_ARGUMENT,
+                       kErrorMessage1WithPrependedContext));
+}
+
+TEST(StatusTest, OkStatusInOtherErrorSpaceIsKept) {
+  Status status(error::error_enum_traits<error::PosixError>::get_error_space(),
+                0, kErrorMessage1);
+  Status that = status;
+
+  EXPECT_THAT(that, IsOk());
+  EXPECT_EQ(that.error_space(),
+            error::error_enum_traits<error::PosixError>::get_error_space());
+  EXPECT_TRUE(that.error_message().empty());
+}
+
 TEST(StatusTest, CopyConstructorTestOk) {
   Status that(Status::OkStatus());
 
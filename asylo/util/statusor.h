@@ -297,7 +297,18 @@ class StatusOr {
   ///
   /// \return The stored non-OK status object, or an OK status if this object
   ///         has a value.
-  Status status() const { return ok() ? Status::OkStatus() : variant_.status_; }
+  Status status() const & {
+    return ok() ? Status::OkStatus() : variant_.status_;
+  }
+
+  /// Moves out the stored status object, or gets an OK status if a `T` value is
+  /// stored.
+  ///
+  /// \return The stored non-OK status object, or an OK status if this object
+  ///         has a value.
+  Status status() && {
+    return ok() ? Status::OkStatus() : std::move(variant_.status_);
+  }
 
   /// Gets the stored `T` value.
   ///
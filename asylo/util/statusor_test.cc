@@ -424,6 +424,12 @@ TYPED_TEST(StatusOrTest, IsOkMatcher) {
 //   tests that verify ValueOrDie() functionality using equality comparisons.
 
 // Verify that a StatusOr object can be constructed from a move-only type.
+// A StatusOr of a small type takes no more than a Status and a flag.
+TEST(StatusOrTest, SmallTypesAreTwoWords) {
+  EXPECT_LE(sizeof(StatusOr<int>), 2 * sizeof(void *));
+  EXPECT_LE(sizeof(StatusOr<void *>), 2 * sizeof(void *));
+}
+
 TEST(StatusOrTest, InitializationMoveOnlyType) {
   std::string *str = new std::string(kStringElement);
   std::unique_ptr<std::string> value(str);